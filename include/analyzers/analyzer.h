@@ -11,10 +11,19 @@
 #ifndef META_ANALYZER_H_
 #define META_ANALYZER_H_
 
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <future>
+#include <iterator>
 #include <stdexcept>
 #include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "io/parser.h"
+#include "parallel/thread_pool.h"
 
 namespace cpptoml
 {
@@ -41,6 +50,14 @@ class token_stream;
 class analyzer
 {
   public:
+    /**
+     * Maps each term in a document to the positions at which it occurs,
+     * in increasing order. A position is the index of the term occurrence
+     * in the sequence of terms produced for the document.
+     */
+    using position_map
+        = std::unordered_map<std::string, std::vector<uint64_t>>;
+
     /**
      * A default virtual destructor.
      */
@@ -52,6 +69,39 @@ class analyzer
      */
     virtual void tokenize(corpus::document& doc) = 0;
 
+    /**
+     * Tokenizes a document, additionally recording the position of every
+     * term occurrence. The default implementation throws, since not every
+     * analyzer produces its terms in a meaningful order.
+     * @param doc The document to store the tokenized information in
+     * @param positions The map to store the term positions in
+     */
+    virtual void tokenize_positions(corpus::document& doc,
+                                    position_map& positions);
+
+    /**
+     * Tokenizes many documents concurrently, in place, so that the
+     * results are in the order of the documents. Each thread of the pool
+     * tokenizes with its own clone of this analyzer, taking documents a
+     * few at a time until none are left.
+     * @param begin An iterator to the first document to tokenize
+     * @param end An iterator past the last document to tokenize
+     * @param pool The threads to tokenize with
+     */
+    template <class RandomAccessIterator>
+    void tokenize_all(RandomAccessIterator begin, RandomAccessIterator end,
+                      parallel::thread_pool& pool) const;
+
+    /**
+     * Tokenizes many documents concurrently, in place, with a thread for
+     * each core.
+     * @param begin An iterator to the first document to tokenize
+     * @param end An iterator past the last document to tokenize
+     */
+    template <class RandomAccessIterator>
+    void tokenize_all(RandomAccessIterator begin,
+                      RandomAccessIterator end) const;
+
     /**
      * Clones this analyzer.
      */
@@ -111,10 +161,22 @@ class analyzer
 
     /**
      * @param doc The document to get content for
-     * @return the contents of the document, as a string
+     * @return the contents of the document, as a utf-8 string. Content
+     * that is already valid utf-8 is copied as it is, without converting
+     * it through ICU.
      */
     static std::string get_content(const corpus::document& doc);
 
+    /**
+     * Sets the content of a token stream to the contents of a document,
+     * as get_content() would give them, but without copying the content
+     * the document holds if it is already valid utf-8.
+     * @param stream The token stream to set the content of
+     * @param doc The document to get content for
+     */
+    static void set_content(token_stream& stream,
+                            const corpus::document& doc);
+
   public:
     /**
      * Basic exception for analyzer interactions.
@@ -125,6 +187,60 @@ class analyzer
         using std::runtime_error::runtime_error;
     };
 };
+
+template <class RandomAccessIterator>
+void analyzer::tokenize_all(RandomAccessIterator begin,
+                            RandomAccessIterator end,
+                            parallel::thread_pool& pool) const
+{
+    using difference_type =
+        typename std::iterator_traits<RandomAccessIterator>::difference_type;
+    const difference_type num_docs = std::distance(begin, end);
+    const difference_type block_size = 16;
+    std::atomic<difference_type> next{0};
+
+    auto task = [&]()
+    {
+        auto ana = clone();
+        while (true)
+        {
+            auto first = next.fetch_add(block_size);
+            if (first >= num_docs)
+                return;
+            auto last = std::min(first + block_size, num_docs);
+            for (auto it = begin + first; it != begin + last; ++it)
+                ana->tokenize(*it);
+        }
+    };
+
+    auto num_tasks = std::min(
+        static_cast<difference_type>(pool.thread_ids().size()),
+        (num_docs + block_size - 1) / block_size);
+    if (num_tasks <= 1)
+    {
+        task();
+        return;
+    }
+
+    std::vector<std::future<void>> futures;
+    for (difference_type i = 0; i < num_tasks; ++i)
+        futures.emplace_back(pool.submit_task(task));
+
+    // every task reads the state on this stack, so all of them must have
+    // finished before an exception from one of them is rethrown
+    for (auto& fut : futures)
+        fut.wait();
+    for (auto& fut : futures)
+        fut.get();
+}
+
+template <class RandomAccessIterator>
+void analyzer::tokenize_all(RandomAccessIterator begin,
+                            RandomAccessIterator end) const
+{
+    parallel::thread_pool pool;
+    tokenize_all(begin, end, pool);
+}
 }
 }
 #endif
@@ -1,4 +1,6 @@
 #include "analyzers/filters/lowercase_filter.h"
+#include "analyzers/filters/lowercase_alpha_filter.h"
+#include "analyzers/filters/fused_chain.h"
 #include "analyzers/filters/porter2_stemmer.h"
 #include "analyzers/filters/empty_sentence_filter.h"
 #include "analyzers/filters/list_filter.h"
@@ -50,6 +50,12 @@ class alpha_filter : public util::clonable<token_stream, alpha_filter>
      */
     std::string next() override;
 
+    /**
+     * Obtains the next token in the sequence, in place.
+     * @param token The buffer to write the token to
+     */
+    void next_into(std::string& token) override;
+
     /**
      * Determines whether there are more tokens available in the stream.
      */
@@ -52,6 +52,12 @@ class empty_sentence_filter
      */
     std::string next() override;
 
+    /**
+     * Obtains the next token in the sequence, in place.
+     * @param token The buffer to write the token to
+     */
+    void next_into(std::string& token) override;
+
     /**
      * Determines whether there are more tokens available in the stream.
      */
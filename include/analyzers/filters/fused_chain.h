@@ -0,0 +1,152 @@
+/**
+ * @file fused_chain.h
+ *
+ * All files in META are released under the MIT license. For more details,
+ * consult the file LICENSE in the root of the project.
+ */
+
+#ifndef META_FILTER_FUSED_CHAIN_H_
+#define META_FILTER_FUSED_CHAIN_H_
+
+#include <memory>
+#include <unordered_set>
+#include <vector>
+
+#include "analyzers/token_stream.h"
+#include "analyzers/filters/list_filter.h"
+#include "util/clonable.h"
+#include "util/optional.h"
+
+namespace cpptoml
+{
+class table;
+}
+
+namespace meta
+{
+namespace analyzers
+{
+namespace filters
+{
+
+/**
+ * Filter that runs a common sequence of filters over its source in one
+ * loop, giving exactly the tokens the separate filters would without a
+ * pair of virtual calls per filter for every token. The filters it can
+ * stand for are, in this order and each optional:
+ *
+ * - a lowercase_filter followed by an alpha_filter, or a
+ *   lowercase_alpha_filter
+ * - a length_filter
+ * - a list_filter
+ * - a porter2_stemmer without a stem cache
+ * - an empty_sentence_filter
+ *
+ * which covers the default filter chains. analyzer::load_filters compiles
+ * the filters of a configuration into a fused_chain wherever they follow
+ * this sequence, so configurations need not name it.
+ */
+class fused_chain : public util::clonable<token_stream, fused_chain>
+{
+  public:
+    /**
+     * The filters a fused_chain runs.
+     */
+    struct stages
+    {
+        /// Whether to lowercase tokens and remove their non-letters
+        bool lowercase_alpha = false;
+        /// Whether to keep only tokens whose length is within a range
+        bool length = false;
+        /// The shortest token kept, if length is set
+        uint64_t min_length = 0;
+        /// The longest token kept, if length is set
+        uint64_t max_length = 0;
+        /// The list of tokens to accept or reject, if any
+        std::shared_ptr<const std::unordered_set<std::string>> list;
+        /// Whether to accept or reject the tokens of the list
+        list_filter::type list_method = list_filter::type::REJECT;
+        /// Whether to stem tokens with the porter2 stemmer
+        bool stem = false;
+        /// Whether to remove sentences with no tokens
+        bool drop_empty_sentences = false;
+    };
+
+    /**
+     * Constructs a fused_chain reading tokens from the given source.
+     * @param source The source to construct the filter from
+     * @param stgs The filters to run
+     */
+    fused_chain(std::unique_ptr<token_stream> source, stages stgs);
+
+    /**
+     * Copy constructor.
+     * @param other The fused_chain to copy into this one
+     */
+    fused_chain(const fused_chain& other);
+
+    /**
+     * Sets the content for the beginning of the filter chain.
+     * @param content The string content to set
+     */
+    void set_content(const std::string& content) override;
+
+    /**
+     * @return the next token in the sequence.
+     */
+    std::string next() override;
+
+    /**
+     * Obtains the next token in the sequence, in place.
+     * @param token The buffer to write the token to
+     */
+    void next_into(std::string& token) override;
+
+    /**
+     * Determines whether there are more tokens available in the stream.
+     */
+    operator bool() const override;
+
+    /**
+     * Finds the filters of a configuration, starting at a given one,
+     * that a fused_chain can run in their place.
+     * @param filters The configuration of each filter of a chain
+     * @param first The position of the first filter to consider
+     * @param stgs Where to store the filters found
+     * @return the number of filters found, which is zero if the filter
+     * at first cannot be fused
+     */
+    static uint64_t
+        compile(const std::vector<std::shared_ptr<cpptoml::table>>& filters,
+                uint64_t first, stages& stgs);
+
+  private:
+    /**
+     * Reads tokens from the source until one passes every filter before
+     * the empty sentence filter.
+     * @param token The buffer to write the token to
+     * @return whether a token was found before the source ran out
+     */
+    bool advance(std::string& token);
+
+    /**
+     * Finds the next valid token for this filter.
+     */
+    void next_token();
+
+    /// The stream to read tokens from
+    std::unique_ptr<token_stream> source_;
+
+    /// The filters to run
+    stages stages_;
+
+    /// The next buffered token
+    util::optional<std::string> first_;
+
+    /// The token after first_, read past an opening "<s>"
+    util::optional<std::string> second_;
+};
+}
+}
+}
+#endif
@@ -62,6 +62,12 @@ class length_filter : public util::clonable<token_stream, length_filter>
      */
     std::string next() override;
 
+    /**
+     * Obtains the next token in the sequence, in place.
+     * @param token The buffer to write the token to
+     */
+    void next_into(std::string& token) override;
+
     /**
      * Determines whether there are more tokens available in the stream.
      */
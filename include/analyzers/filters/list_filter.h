@@ -75,11 +75,25 @@ class list_filter : public util::clonable<token_stream, list_filter>
      */
     std::string next() override;
 
+    /**
+     * Obtains the next token in the sequence, in place.
+     * @param token The buffer to write the token to
+     */
+    void next_into(std::string& token) override;
+
     /**
      * Determines whether there are more tokens available in the stream.
      */
     operator bool() const override;
 
+    /**
+     * Reads a list of tokens, one per line.
+     * @param filename The file to read
+     * @return the tokens of the file
+     */
+    static std::unordered_set<std::string>
+        read_list(const std::string& filename);
+
     /// Identifier for this filter
     const static std::string id;
 
@@ -0,0 +1,93 @@
+/**
+ * @file lowercase_alpha_filter.h
+ *
+ * All files in META are released under the MIT license. For more details,
+ * consult the file LICENSE in the root of the project.
+ */
+
+#ifndef META_LOWERCASE_ALPHA_FILTER_H_
+#define META_LOWERCASE_ALPHA_FILTER_H_
+
+#include "analyzers/token_stream.h"
+#include "util/clonable.h"
+#include "util/optional.h"
+
+namespace meta
+{
+namespace analyzers
+{
+namespace filters
+{
+
+/**
+ * Filter that lowercases tokens and removes their "non-letter" characters,
+ * exactly as a lowercase_filter followed by an alpha_filter would, in a
+ * single pass over each token. ASCII tokens are folded and filtered in
+ * place through a lookup table; any other token falls back to the Unicode
+ * properties of its codepoints.
+ */
+class lowercase_alpha_filter
+    : public util::clonable<token_stream, lowercase_alpha_filter>
+{
+  public:
+    /**
+     * Constructs a lowercase_alpha_filter reading tokens from the given
+     * source.
+     * @param source The source to construct the filter from
+     */
+    lowercase_alpha_filter(std::unique_ptr<token_stream> source);
+
+    /**
+     * Copy constructor.
+     * @param other The lowercase_alpha_filter to copy into this one
+     */
+    lowercase_alpha_filter(const lowercase_alpha_filter& other);
+
+    /**
+     * Sets the content for the beginning of the filter chain.
+     * @param content The string content to set
+     */
+    void set_content(const std::string& content) override;
+
+    /**
+     * Obtains the next token in the sequence.
+     */
+    std::string next() override;
+
+    /**
+     * Obtains the next token in the sequence, in place.
+     * @param token The buffer to write the token to
+     */
+    void next_into(std::string& token) override;
+
+    /**
+     * Determines whether there are more tokens available in the stream.
+     */
+    operator bool() const override;
+
+    /**
+     * Lowercases a token and removes its "non-letter" characters, as this
+     * filter does to every token other than "<s>" and "</s>".
+     * @param token The token to filter in place
+     */
+    static void fold(std::string& token);
+
+    /// Identifier for this filter
+    const static std::string id;
+
+  private:
+    /**
+     * Finds the next valid token for this filter.
+     */
+    void next_token();
+
+    /// The source to read tokens from
+    std::unique_ptr<token_stream> source_;
+
+    /// The buffered token.
+    util::optional<std::string> token_;
+};
+}
+}
+}
+#endif
@@ -10,7 +10,11 @@
 #define META_FILTER_PORTER2_STEMMER_H_
 
 #include <memory>
+#include <unordered_map>
+
 #include "analyzers/token_stream.h"
+#include "analyzers/filter_factory.h"
+#include "caching/cache_stats.h"
 #include "util/clonable.h"
 #include "util/optional.h"
 
@@ -24,6 +28,21 @@ namespace filters
 /**
  * Filter that stems words according to the porter2 stemmer algorithm.
  * Requires that the porter2 stemmer project submodule be downloaded.
+ *
+ * The filter can remember the stems of the tokens it has seen, so that a
+ * frequent word is stemmed only once. The cache belongs to one filter and
+ * is not shared with its clones, so each thread analyzing documents with
+ * its own copy of the filter chain keeps its own cache without locking.
+ * When the cache is full it is emptied and filled again with the tokens
+ * that follow, which keeps the frequent words in it.
+ *
+ * Optional config parameters:
+ *
+ * ~~~toml
+ * [[analyzers.filter]]
+ * type = "porter2-stemmer"
+ * cache-size = 10000 # the most stems to remember; default is 0 (off)
+ * ~~~
  */
 class porter2_stemmer : public util::clonable<token_stream, porter2_stemmer>
 {
@@ -32,11 +51,15 @@ class porter2_stemmer : public util::clonable<token_stream, porter2_stemmer>
      * Constructs a new porter2 stemmer filter, reading tokens from
      * the given source.
      * @param source The source to construct the filter from
+     * @param cache_size The most stems to remember, or zero to stem every
+     * token
      */
-    porter2_stemmer(std::unique_ptr<token_stream> source);
+    porter2_stemmer(std::unique_ptr<token_stream> source,
+                    uint64_t cache_size = 0);
 
     /**
-     * Copy constructor.
+     * Copy constructor. The copy remembers as many stems as other, but
+     * starts with an empty cache of its own.
      * @param other The porter2_stemmer to copy into this one
      */
     porter2_stemmer(const porter2_stemmer& other);
@@ -52,11 +75,29 @@ class porter2_stemmer : public util::clonable<token_stream, porter2_stemmer>
      */
     std::string next() override;
 
+    /**
+     * Obtains the next token in the sequence, in place.
+     * @param token The buffer to write the token to
+     */
+    void next_into(std::string& token) override;
+
     /**
      * Determines if there are more tokens available in the stream.
      */
     operator bool() const override;
 
+    /**
+     * @return the most stems this filter remembers
+     */
+    uint64_t cache_size() const;
+
+    /**
+     * @return the activity of this filter's stem cache, where each token
+     * looked up is a hit or a miss and each emptying of the full cache
+     * evicts all of its entries
+     */
+    caching::cache_stats cache_stats() const;
+
     /// Identifier for this filter
     const static std::string id;
 
@@ -66,12 +107,35 @@ class porter2_stemmer : public util::clonable<token_stream, porter2_stemmer>
      */
     void next_token();
 
+    /**
+     * Stems a token, using and filling the cache if there is one.
+     * @param token The token to stem in place
+     */
+    void stem(std::string& token);
+
     /// The stream to read tokens from
     std::unique_ptr<token_stream> source_;
 
     /// The buffered next token.
     util::optional<std::string> token_;
+
+    /// The most stems to remember
+    uint64_t cache_size_;
+
+    /// token -> stem
+    std::unordered_map<std::string, std::string> cache_;
+
+    /// The activity of cache_
+    caching::cache_stats stats_;
 };
+
+/**
+ * Specialization of the factory method for creating porter2_stemmers.
+ */
+template <>
+std::unique_ptr<token_stream>
+    make_filter<porter2_stemmer>(std::unique_ptr<token_stream>,
+                                 const cpptoml::table&);
 }
 }
 }
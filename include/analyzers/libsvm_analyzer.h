@@ -10,7 +10,11 @@
 #ifndef META_LIBSVM_ANALYZER_
 #define META_LIBSVM_ANALYZER_
 
+#include <utility>
+#include <vector>
+
 #include "analyzers/analyzer.h"
+#include "meta.h"
 #include "util/clonable.h"
 
 namespace meta
@@ -34,6 +38,11 @@ class libsvm_analyzer : public util::clonable<analyzer, libsvm_analyzer>
 
     /// Identifier for this analyzer.
     const static std::string id;
+
+  private:
+    /// The (feature, count) pairs of the document being tokenized, kept
+    /// so that their memory is reused from one document to the next
+    std::vector<std::pair<term_id, double>> counts_;
 };
 }
 }
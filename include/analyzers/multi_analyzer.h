@@ -50,6 +50,16 @@ class multi_analyzer : public util::clonable<analyzer, multi_analyzer>
      */
     virtual void tokenize(corpus::document& doc) override;
 
+    /**
+     * Tokenizes a file into a document, recording term positions. Only
+     * possible when this multi_analyzer wraps a single analyzer, since the
+     * terms of different analyzers do not share a sequence.
+     * @param doc The document to store the tokenized information in
+     * @param positions The map to store the term positions in
+     */
+    virtual void tokenize_positions(corpus::document& doc,
+                                    position_map& positions) override;
+
   private:
     /// Holds all the analyzers in this multi_analyzer
     std::vector<std::unique_ptr<analyzer>> analyzers_;
@@ -9,6 +9,9 @@
 #ifndef META_NGRAM_WORD_ANALYZER_H_
 #define META_NGRAM_WORD_ANALYZER_H_
 
+#include <string>
+#include <vector>
+
 #include "analyzers/analyzer_factory.h"
 #include "analyzers/ngram/ngram_analyzer.h"
 #include "util/clonable.h"
@@ -19,7 +22,9 @@ namespace analyzers
 {
 
 /**
- * Analyzes documents using their tokenized words.
+ * Analyzes documents using their tokenized words. Any number of ngram
+ * orders may be produced from a single pass over the tokens, with
+ * `ngram = [1, 2, 3]` in the configuration instead of a single value.
  */
 class ngram_word_analyzer
     : public util::multilevel_clonable<analyzer, ngram_analyzer,
@@ -36,6 +41,15 @@ class ngram_word_analyzer
      */
     ngram_word_analyzer(uint16_t n, std::unique_ptr<token_stream> stream);
 
+    /**
+     * Constructor for several ngram orders at once.
+     * @param orders The values of n to use for the ngrams, of which
+     * n_value() is the largest
+     * @param stream The stream to read tokens from.
+     */
+    ngram_word_analyzer(std::vector<uint16_t> orders,
+                        std::unique_ptr<token_stream> stream);
+
     /**
      * Copy constructor.
      * @param other The other ngram_word_analyzer to copy from
@@ -48,12 +62,44 @@ class ngram_word_analyzer
      */
     virtual void tokenize(corpus::document& doc) override;
 
+    /**
+     * Tokenizes a file into a document, recording the position of each
+     * ngram. The position of an ngram is the index of its first word.
+     * @param doc The document to store the tokenized information in
+     * @param positions The map to store the ngram positions in
+     */
+    virtual void tokenize_positions(corpus::document& doc,
+                                    position_map& positions) override;
+
     /// Identifier for this analyzer.
     const static std::string id;
 
   private:
+    /**
+     * Creates the ngrams for a document.
+     * @param doc The document to store the tokenized information in
+     * @param positions The map to store the ngram positions in, if any
+     */
+    void ngramify(corpus::document& doc, position_map* positions);
+
+    /// The values of n to use for the ngrams, in increasing order
+    std::vector<uint16_t> orders_;
+
     /// The token stream to be used for extracting tokens
     std::unique_ptr<token_stream> stream_;
+
+    /// The buffer tokens are read into
+    std::string token_;
+
+    /// The tokens of the current document, joined by underscores, so that
+    /// every ngram is a substring of it
+    std::string text_;
+
+    /// The offset of each token in text_
+    std::vector<size_t> starts_;
+
+    /// The buffer ngrams are copied into to be counted
+    std::string ngram_;
 };
 
 /**
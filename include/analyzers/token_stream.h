@@ -32,6 +32,20 @@ class token_stream
      */
     virtual std::string next() = 0;
 
+    /**
+     * Obtains the next token in the sequence, writing it into a buffer
+     * the caller owns. Tokenizers and filters that support it fill and
+     * edit the buffer in place, so a caller that keeps reusing its buffers
+     * allocates only for a token longer than any they have held; by
+     * default, the result of next() is moved into it.
+     * @param token The buffer to write the token to; whatever it held is
+     * replaced
+     */
+    virtual void next_into(std::string& token)
+    {
+        token = next();
+    }
+
     /**
      * Determines whether there are more tokens available in the
      * stream.
@@ -49,6 +49,11 @@ namespace tokenizers
  * # whether to suppress the generation of "<s>" or "</s>"; useful for
  * # information retrieval with unigrams. Default is false.
  * suppress-tags = true
+ *
+ * # whether to segment documents that are entirely ASCII without ICU,
+ * # which gives the same tokens faster. Only used when no language is
+ * # specified. Default is true.
+ * ascii-fast-path = false
  * ~~~
  */
 class icu_tokenizer : public util::clonable<token_stream, icu_tokenizer>
@@ -57,8 +62,11 @@ class icu_tokenizer : public util::clonable<token_stream, icu_tokenizer>
     /**
      * Creates an icu_tokenizer.
      * @param suppress_tags Whether to suppress "<s>" and "</s"> generation
+     * @param ascii_fast_path Whether to segment ASCII content without ICU,
+     * by the same rules
      */
-    explicit icu_tokenizer(bool suppress_tags = false);
+    explicit icu_tokenizer(bool suppress_tags = false,
+                           bool ascii_fast_path = true);
 
     /**
      * Creates an icu_tokenizer with a specific segmenter.
@@ -102,6 +110,12 @@ class icu_tokenizer : public util::clonable<token_stream, icu_tokenizer>
      */
     std::string next() override;
 
+    /**
+     * Obtains the next token in the sequence, in place.
+     * @param token The buffer to write the token to
+     */
+    void next_into(std::string& token) override;
+
     /**
      * Determines if there are more tokens in the document.
      */
@@ -54,6 +54,12 @@ class whitespace_tokenizer : public util::clonable<token_stream,
      */
     std::string next() override;
 
+    /**
+     * Obtains the next token in the sequence, in place.
+     * @param token The buffer to write the token to
+     */
+    void next_into(std::string& token) override;
+
     /**
      * Determines if there are more tokens in the document.
      */
@@ -0,0 +1,144 @@
+/**
+ * @file benchmark.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_BENCH_BENCHMARK_H_
+#define META_BENCH_BENCHMARK_H_
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace meta
+{
+namespace bench
+{
+
+/**
+ * The timings of one benchmark.
+ */
+struct result
+{
+    /// the name of the benchmark
+    std::string name;
+    /// the number of items (postings, tokens, documents, ...) processed by
+    /// each repetition
+    uint64_t items;
+    /// the time taken by each repetition, in nanoseconds
+    std::vector<uint64_t> times;
+};
+
+/**
+ * Runs benchmarks and writes their results, one JSON object per line, so
+ * that the results of two commits can be compared with a script. Every
+ * benchmark is run once to warm up and then a fixed number of times, and
+ * its fastest, median and mean times are reported.
+ */
+class runner
+{
+  public:
+    /**
+     * @param out The stream to write the results to
+     * @param label A label written with every result, such as the commit
+     * being measured
+     * @param repetitions The number of timed runs of each benchmark
+     * @param filter Only benchmarks whose names contain this are run
+     */
+    runner(std::ostream& out, const std::string& label, uint64_t repetitions,
+           const std::string& filter = "");
+
+    /**
+     * @param name The name of a benchmark
+     * @return whether the benchmark is to be run
+     */
+    bool selected(const std::string& name) const;
+
+    /**
+     * Times a benchmark, if it is selected.
+     * @param name The name of the benchmark
+     * @param items The number of items each call of fn processes
+     * @param fn The benchmark
+     */
+    template <class Function>
+    void run(const std::string& name, uint64_t items, Function&& fn)
+    {
+        run(name, items, [](){}, fn);
+    }
+
+    /**
+     * Times a benchmark, if it is selected, leaving out the time taken to
+     * set up each repetition.
+     * @param name The name of the benchmark
+     * @param items The number of items each call of fn processes
+     * @param setup Called, untimed, before every call of fn
+     * @param fn The benchmark
+     */
+    template <class Setup, class Function>
+    void run(const std::string& name, uint64_t items, Setup&& setup,
+             Function&& fn)
+    {
+        if (!selected(name))
+            return;
+
+        result res{name, items, {}};
+        for (uint64_t i = 0; i <= repetitions_; ++i)
+        {
+            setup();
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            auto time = std::chrono::steady_clock::now() - start;
+            // the first run only warms up
+            if (i > 0)
+                res.times.push_back(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(time)
+                        .count()));
+        }
+        report(res);
+    }
+
+    /**
+     * @return the number of benchmarks run so far
+     */
+    uint64_t num_run() const;
+
+  private:
+    /**
+     * Writes a result.
+     * @param res The result to write
+     */
+    void report(result& res);
+
+    /// The stream to write the results to
+    std::ostream& out_;
+    /// The label written with every result
+    const std::string label_;
+    /// The number of timed runs of each benchmark
+    const uint64_t repetitions_;
+    /// Only benchmarks whose names contain this are run
+    const std::string filter_;
+    /// The number of benchmarks run so far
+    uint64_t num_run_;
+};
+
+/**
+ * Keeps the compiler from optimizing away the computation of a number
+ * that a benchmark does not otherwise use, such as a checksum of what it
+ * read.
+ * @param value The number
+ */
+template <class T>
+void keep(T value)
+{
+    static T sink;
+    *static_cast<volatile T*>(&sink) = value;
+}
+}
+}
+
+#endif
@@ -0,0 +1,90 @@
+/**
+ * @file corpus_generator.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_BENCH_CORPUS_GENERATOR_H_
+#define META_BENCH_CORPUS_GENERATOR_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace meta
+{
+namespace bench
+{
+
+/**
+ * The shape of a generated corpus.
+ */
+struct corpus_options
+{
+    /// the number of documents
+    uint64_t num_docs = 10000;
+    /// the number of distinct words
+    uint64_t vocab_size = 50000;
+    /// the number of words in each document
+    uint64_t doc_length = 200;
+    /// the number of class labels
+    uint64_t num_labels = 4;
+    /// the seed of the random number generator, so that the same options
+    /// give the same corpus
+    uint64_t seed = 47;
+};
+
+/**
+ * @param idx The index of a word
+ * @return the spelling of the word: a lowercase string that is different
+ * for every index
+ */
+std::string word(uint64_t idx);
+
+/**
+ * Draws words from a Zipfian distribution over a vocabulary, as words in
+ * natural text are. Each label prefers its own share of the vocabulary, so
+ * that classifiers and topic models have something to find.
+ */
+class word_generator
+{
+  public:
+    /**
+     * @param opts The shape of the corpus
+     */
+    word_generator(const corpus_options& opts);
+
+    /**
+     * @param label The label of the document being generated
+     * @param num_words The number of words to generate
+     * @return the words, separated by spaces
+     */
+    std::string text(uint64_t label, uint64_t num_words);
+
+  private:
+    /// The shape of the corpus
+    corpus_options opts_;
+    /// The random number generator
+    uint64_t state_;
+    /// The cumulative probability of each word's rank
+    std::vector<double> cumulative_;
+};
+
+/**
+ * Writes a generated line corpus, with labels, to
+ * prefix/dataset/dataset.dat and prefix/dataset/dataset.labels, along with
+ * a configuration file that indexes it.
+ * @param prefix The directory to write to
+ * @param dataset The name of the corpus
+ * @param opts The shape of the corpus
+ * @return the path of the configuration file
+ */
+std::string generate_corpus(const std::string& prefix,
+                            const std::string& dataset,
+                            const corpus_options& opts);
+}
+}
+
+#endif
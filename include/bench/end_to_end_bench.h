@@ -0,0 +1,35 @@
+/**
+ * @file end_to_end_bench.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_BENCH_END_TO_END_BENCH_H_
+#define META_BENCH_END_TO_END_BENCH_H_
+
+#include <string>
+
+#include "bench/benchmark.h"
+#include "bench/corpus_generator.h"
+
+namespace meta
+{
+namespace bench
+{
+
+/**
+ * Runs the benchmarks of whole tasks on a generated corpus: building an
+ * inverted index, scoring queries with ranker::score one at a time and
+ * from several threads, classifying, and fitting an LDA model.
+ * @param run The runner to time the benchmarks with
+ * @param config_file The configuration file of the generated corpus
+ * @param opts The shape of the generated corpus
+ */
+void end_to_end_benchmarks(runner& run, const std::string& config_file,
+                           const corpus_options& opts);
+}
+}
+
+#endif
@@ -0,0 +1,35 @@
+/**
+ * @file micro_bench.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_BENCH_MICRO_BENCH_H_
+#define META_BENCH_MICRO_BENCH_H_
+
+#include <string>
+
+#include "bench/benchmark.h"
+#include "bench/corpus_generator.h"
+
+namespace meta
+{
+namespace bench
+{
+
+/**
+ * Runs the benchmarks of single operations that need no index: decoding
+ * a compressed file, looking up terms in a vocabulary_map, tokenizing
+ * with filter chains, sparse vector arithmetic and thread_pool overhead.
+ * @param run The runner to time the benchmarks with
+ * @param prefix A directory for the files the benchmarks write
+ * @param opts The shape of the generated text
+ */
+void micro_benchmarks(runner& run, const std::string& prefix,
+                      const corpus_options& opts);
+}
+}
+
+#endif
@@ -1,4 +1,5 @@
 #include "caching/dblru_cache.h"
+#include "caching/gdsf_cache.h"
 #include "caching/no_evict_cache.h"
 #include "caching/shard_cache.h"
 #include "caching/splay_cache.h"
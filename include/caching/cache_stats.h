@@ -0,0 +1,273 @@
+/**
+ * @file cache_stats.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_CACHE_STATS_H_
+#define META_CACHE_STATS_H_
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <ostream>
+
+#include "meta.h"
+#include "util/metrics.h"
+
+namespace meta
+{
+namespace caching
+{
+
+namespace internal
+{
+/**
+ * @param value A value that reports its own size
+ * @return the memory used by the object the value points to
+ */
+template <class T>
+auto value_bytes(const std::shared_ptr<T>& value, int)
+    -> decltype(uint64_t{value->bytes_used()})
+{
+    return sizeof(T) + value->bytes_used();
+}
+
+/**
+ * @param value Any other value
+ * @return the memory used by the value itself
+ */
+template <class Value>
+uint64_t value_bytes(const Value&, long)
+{
+    return sizeof(Value);
+}
+}
+
+/**
+ * A snapshot of the activity of a cache.
+ */
+struct cache_stats
+{
+    /// the number of lookups that found their key
+    uint64_t hits = 0;
+    /// the number of lookups that did not find their key
+    uint64_t misses = 0;
+    /// the number of values inserted
+    uint64_t insertions = 0;
+    /// the number of values evicted to make room for others
+    uint64_t evictions = 0;
+    /// the number of values in the cache
+    uint64_t entries = 0;
+    /// the memory used by the values in the cache
+    uint64_t bytes = 0;
+    /// the time spent reading the values of missed keys
+    std::chrono::nanoseconds decode_time{0};
+
+    /**
+     * @return the fraction of lookups that found their key
+     */
+    double hit_rate() const
+    {
+        auto lookups = hits + misses;
+        return lookups == 0 ? 0.0 : static_cast<double>(hits) / lookups;
+    }
+
+    /**
+     * Adds the activity of another cache, such as another shard.
+     * @param other The statistics to add
+     * @return this cache_stats
+     */
+    cache_stats& operator+=(const cache_stats& other)
+    {
+        hits += other.hits;
+        misses += other.misses;
+        insertions += other.insertions;
+        evictions += other.evictions;
+        entries += other.entries;
+        bytes += other.bytes;
+        decode_time += other.decode_time;
+        return *this;
+    }
+};
+
+/**
+ * Prints the statistics of a cache on one line.
+ * @param out The stream to write to
+ * @param stats The statistics to print
+ * @return out
+ */
+inline std::ostream& operator<<(std::ostream& out, const cache_stats& stats)
+{
+    auto decode_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        stats.decode_time);
+    return out << "hits: " << stats.hits << ", misses: " << stats.misses
+               << " (hit rate " << stats.hit_rate() * 100
+               << "%), insertions: " << stats.insertions
+               << ", evictions: " << stats.evictions
+               << ", entries: " << stats.entries
+               << ", bytes: " << stats.bytes
+               << ", decode time: " << decode_ms.count() << "ms";
+}
+
+/**
+ * The counters a cache keeps of its activity. The counts are spread over
+ * several cache-line sized slots, and each thread adds to the slot it is
+ * assigned, so that threads hitting the same cache do not contend on the
+ * counters; reading them sums every slot. Hits and misses are also
+ * counted, over every cache, in the cache_hits and cache_misses metrics.
+ */
+class cache_counters
+{
+  public:
+    /**
+     * Starts every count at zero.
+     */
+    cache_counters() : slots_{new slot[num_slots]}
+    {
+        reset();
+    }
+
+    /**
+     * Counts a lookup that found its key.
+     */
+    void hit()
+    {
+        add(hits_idx, 1);
+        if (metrics::enabled())
+        {
+            static auto& hits = metrics::get_counter("cache_hits");
+            hits.add();
+        }
+    }
+
+    /**
+     * Counts a lookup that did not find its key.
+     */
+    void miss()
+    {
+        add(misses_idx, 1);
+        if (metrics::enabled())
+        {
+            static auto& misses = metrics::get_counter("cache_misses");
+            misses.add();
+        }
+    }
+
+    /**
+     * Counts an inserted value.
+     */
+    void insertion()
+    {
+        add(insertions_idx, 1);
+    }
+
+    /**
+     * Counts evicted values.
+     * @param num The number of values evicted
+     */
+    void evictions(uint64_t num = 1)
+    {
+        add(evictions_idx, num);
+    }
+
+    /**
+     * Adds time spent reading the value of a missed key.
+     * @param time The time spent
+     */
+    void decode_time(std::chrono::nanoseconds time)
+    {
+        add(decode_idx, static_cast<uint64_t>(time.count()));
+    }
+
+    /**
+     * @return the counts so far; the entries and bytes are left zero for
+     * the cache to fill in
+     */
+    cache_stats stats() const
+    {
+        cache_stats stats;
+        stats.hits = sum(hits_idx);
+        stats.misses = sum(misses_idx);
+        stats.insertions = sum(insertions_idx);
+        stats.evictions = sum(evictions_idx);
+        stats.decode_time = std::chrono::nanoseconds{sum(decode_idx)};
+        return stats;
+    }
+
+    /**
+     * Sets every count back to zero.
+     */
+    void reset()
+    {
+        for (uint64_t i = 0; i < num_slots; ++i)
+        {
+            for (auto& count : slots_[i].counts)
+                count.store(0, std::memory_order_relaxed);
+        }
+    }
+
+  private:
+    /// The number of slots the counts are spread over
+    const static uint64_t num_slots = 16;
+
+    /// The positions of the counts within a slot
+    enum : uint64_t
+    {
+        hits_idx,
+        misses_idx,
+        insertions_idx,
+        evictions_idx,
+        decode_idx
+    };
+
+    /**
+     * One set of counts, padded to a cache line.
+     */
+    struct slot
+    {
+        /// the counts, of which only the first few are used
+        std::atomic<uint64_t> counts[8];
+    };
+
+    /**
+     * @return the slot the calling thread adds to
+     */
+    static uint64_t thread_slot()
+    {
+        static std::atomic<uint64_t> next_slot{0};
+        thread_local uint64_t slot_idx = next_slot++ % num_slots;
+        return slot_idx;
+    }
+
+    /**
+     * @param idx The position of a count
+     * @param amount The amount to add to it
+     */
+    void add(uint64_t idx, uint64_t amount)
+    {
+        slots_[thread_slot()].counts[idx].fetch_add(
+            amount, std::memory_order_relaxed);
+    }
+
+    /**
+     * @param idx The position of a count
+     * @return the count summed over every slot
+     */
+    uint64_t sum(uint64_t idx) const
+    {
+        uint64_t total = 0;
+        for (uint64_t i = 0; i < num_slots; ++i)
+            total += slots_[i].counts[idx].load(std::memory_order_relaxed);
+        return total;
+    }
+
+    /// The slots holding the counts
+    std::unique_ptr<slot[]> slots_;
+};
+}
+}
+
+#endif
@@ -17,8 +17,11 @@
 #include "util/shim.h"
 #endif
 #include <functional>
+#include <unordered_set>
 #include <vector>
 
+#include "caching/cache_stats.h"
+#include "caching/maps/concurrent_map.h"
 #include "caching/maps/locking_map.h"
 #include "util/optional.h"
 
@@ -104,6 +107,17 @@ class dblru_cache
      */
     util::optional<Value> find(const Key& key);
 
+    /**
+     * @return the keys in the cache, the most recently used ones (those
+     * in the primary map) first
+     */
+    std::vector<Key> keys() const;
+
+    /**
+     * @return the activity of the cache so far
+     */
+    cache_stats stats() const;
+
     /** Empties the cache. */
     void clear();
 
@@ -114,6 +128,15 @@ class dblru_cache
      */
     void handle_insert();
 
+    /**
+     * Counts the entries of a map being dropped that are not kept in
+     * another, as evictions.
+     * @param dropped The map being dropped
+     * @param kept The map being kept
+     */
+    void count_evictions(const Map<Key, Value>& dropped,
+                         const Map<Key, Value>& kept);
+
     /**
      * Gets the primary map.
      */
@@ -149,6 +172,11 @@ class dblru_cache
      * The secondary map.
      */
     std::shared_ptr<Map<Key, Value>> secondary_;
+
+    /**
+     * The activity of the cache.
+     */
+    cache_counters counters_;
 };
 
 /**
@@ -156,6 +184,13 @@ class dblru_cache
  */
 template <class Key, class Value>
 using default_dblru_cache = dblru_cache<Key, Value>;
+
+/**
+ * A dblru_cache whose lookups do not lock, for caches shared by many
+ * query threads.
+ */
+template <class Key, class Value>
+using concurrent_dblru_cache = dblru_cache<Key, Value, concurrent_map>;
 }
 }
 
@@ -25,7 +25,8 @@ dblru_cache<Key, Value, Map>::dblru_cache(dblru_cache&& other)
     : max_size_{std::move(other.max_size_)},
       current_size_{other.current_size_.load()},
       primary_{std::atomic_load(&other.primary_)},
-      secondary_{std::atomic_load(&other.secondary_)}
+      secondary_{std::atomic_load(&other.secondary_)},
+      counters_{std::move(other.counters_)}
 {
     /* nothing */
 }
@@ -33,7 +34,8 @@ dblru_cache<Key, Value, Map>::dblru_cache(dblru_cache&& other)
 template <class Key, class Value, template <class, class> class Map>
 dblru_cache<Key, Value, Map>::dblru_cache(dblru_cache&& other)
     : max_size_{std::move(other.max_size_)},
-      current_size_{std::move(other.current_size_)}
+      current_size_{std::move(other.current_size_)},
+      counters_{std::move(other.counters_)}
 {
     std::lock_guard<std::mutex> lock{*other.mutables_};
     primary_ = std::move(other.primary_);
@@ -57,6 +59,7 @@ void dblru_cache<Key, Value, Map>::swap(dblru_cache& other)
     current_size_.store(other.current_size_.exchange(current_size_.load()));
     std::atomic_exchange(&primary_, other.primary_);
     std::atomic_exchange(&secondary_, other.secondary_);
+    std::swap(counters_, other.counters_);
 }
 #else
 template <class Key, class Value, template <class, class> class Map>
@@ -68,6 +71,7 @@ void dblru_cache<Key, Value, Map>::swap(dblru_cache& other)
     std::swap(current_size_, other.current_size_);
     std::swap(primary_, other.primary_);
     std::swap(secondary_, other.secondary_);
+    std::swap(counters_, other.counters_);
 }
 #endif
 
@@ -100,6 +104,7 @@ void dblru_cache<Key, Value, Map>::insert(const Key& key, const Value& value)
 {
     auto map = get_primary_map();
     map->insert(key, value);
+    counters_.insertion();
     handle_insert();
 }
 
@@ -109,6 +114,7 @@ void dblru_cache<Key, Value, Map>::emplace(Args&&... args)
 {
     auto map = get_primary_map();
     map->emplace(std::forward<Args...>(args...));
+    counters_.insertion();
     handle_insert();
 }
 
@@ -118,14 +124,22 @@ util::optional<Value> dblru_cache<Key, Value, Map>::find(const Key& key)
     auto primary = get_primary_map();
     auto opt = primary->find(key);
     if (opt)
+    {
+        counters_.hit();
         return opt;
+    }
     auto secondary = get_secondary_map();
     opt = secondary->find(key);
     if (opt)
     {
+        counters_.hit();
         primary->insert(key, *opt);
         handle_insert();
     }
+    else
+    {
+        counters_.miss();
+    }
     return opt;
 }
 
@@ -136,12 +150,14 @@ void dblru_cache<Key, Value, Map>::handle_insert()
     if (current_size_.fetch_add(1) == max_size_)
     {
         auto secondary = std::atomic_load(&secondary_);
+        auto primary = std::atomic_load(&primary_);
         // leaves primary_ empty, with secondary_ containing what used to
         // be in primary_
-        std::atomic_exchange(&secondary_, primary_);
+        std::atomic_exchange(&secondary_, primary);
         std::atomic_store(&primary_, std::make_shared<Map<Key, Value>>());
         // reset counter
         current_size_.store(0);
+        count_evictions(*secondary, *primary);
     }
 }
 #else
@@ -162,9 +178,56 @@ void dblru_cache<Key, Value, Map>::handle_insert()
             current_size_ = 0;
         }
     }
+    if (old_secondary)
+        count_evictions(*old_secondary, *get_secondary_map());
 }
 #endif
 
+template <class Key, class Value, template <class, class> class Map>
+void dblru_cache<Key, Value, Map>::count_evictions(
+    const Map<Key, Value>& dropped, const Map<Key, Value>& kept)
+{
+    // entries found in the secondary map were copied into the primary one,
+    // so only those that were not are lost
+    uint64_t evicted = 0;
+    dropped.for_each([&](const Key& key, const Value&)
+                     {
+        if (!kept.find(key))
+            ++evicted;
+    });
+    counters_.evictions(evicted);
+}
+
+template <class Key, class Value, template <class, class> class Map>
+cache_stats dblru_cache<Key, Value, Map>::stats() const
+{
+    auto stats = counters_.stats();
+    std::unordered_set<Key> seen;
+    auto count = [&](const Key& key, const Value& value)
+    {
+        if (!seen.insert(key).second)
+            return;
+        ++stats.entries;
+        stats.bytes += internal::value_bytes(value, 0);
+    };
+    get_primary_map()->for_each(count);
+    get_secondary_map()->for_each(count);
+    return stats;
+}
+
+template <class Key, class Value, template <class, class> class Map>
+std::vector<Key> dblru_cache<Key, Value, Map>::keys() const
+{
+    auto keys = get_primary_map()->keys();
+    std::unordered_set<Key> seen{keys.begin(), keys.end()};
+    for (const auto& key : get_secondary_map()->keys())
+    {
+        if (seen.insert(key).second)
+            keys.push_back(key);
+    }
+    return keys;
+}
+
 template <class Key, class Value, template <class, class> class Map>
 void dblru_cache<Key, Value, Map>::clear()
 {
@@ -0,0 +1,197 @@
+/**
+ * @file gdsf_cache.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_GDSF_CACHE_H_
+#define META_GDSF_CACHE_H_
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "caching/cache_stats.h"
+#include "meta.h"
+#include "util/optional.h"
+#include "util/shim.h"
+
+namespace meta
+{
+namespace caching
+{
+
+/**
+ * A cache bounded by the memory its values use rather than by their
+ * number, so one very long posting list cannot crowd out thousands of
+ * short ones unnoticed. The size of a value is its bytes_used() if it is a
+ * pointer to an object that has one (like postings_data), and its own size
+ * otherwise; values still referenced after eviction are not counted.
+ *
+ * Values are evicted by the Greedy-Dual-Size-Frequency policy: each entry
+ * has the priority L + F * C / S, where S is its size, C is the cost of
+ * reading it again (a fixed cost per miss plus one per byte decoded), F is
+ * how often it has been looked up, and L is the priority of the entry
+ * evicted last, so that entries that were popular long ago eventually age
+ * out. The lowest priority entries are evicted first.
+ *
+ * F is an estimate from a count-min sketch of recent lookups, hits and
+ * misses alike, whose counters are halved periodically. A new value is
+ * only admitted if its priority is at least that of every entry it would
+ * displace, so a one-off lookup of a huge posting list does not flush the
+ * cache.
+ */
+template <class Key, class Value>
+class gdsf_cache
+{
+  public:
+    /**
+     * @param max_bytes The maximum number of bytes of values to hold
+     * @param miss_cost The cost of a miss beyond reading the value's
+     * bytes, in bytes; larger values favor keeping small entries
+     * @param sketch_width The number of counters in each row of the
+     * frequency sketch; rounded up to a power of two
+     */
+    gdsf_cache(uint64_t max_bytes, uint64_t miss_cost = 4096,
+               uint64_t sketch_width = 1 << 16);
+
+    /**
+     * gdsf_cache may be move constructed.
+     */
+    gdsf_cache(gdsf_cache&&) = default;
+
+    /**
+     * gdsf_cache may be move assigned.
+     * @return the current gdsf_cache
+     */
+    gdsf_cache& operator=(gdsf_cache&&) = default;
+
+    /**
+     * Inserts a (key, value) pair into the cache, unless the value is
+     * larger than the cache or less valuable than what it would evict.
+     * @param key The key to insert
+     * @param value The value to insert
+     */
+    void insert(const Key& key, const Value& value);
+
+    /**
+     * Finds a value in the cache, counting the lookup toward the key's
+     * frequency whether or not it is found.
+     * @param key The key to find the corresponding value for
+     * @return an optional that may contain the value, if found
+     */
+    util::optional<Value> find(const Key& key);
+
+    /**
+     * @return the keys in the cache, highest priority first
+     */
+    std::vector<Key> keys() const;
+
+    /**
+     * @return the number of entries in the cache
+     */
+    uint64_t size() const;
+
+    /**
+     * @return the number of bytes of values in the cache
+     */
+    uint64_t bytes_used() const;
+
+    /**
+     * @return the activity of the cache so far
+     */
+    cache_stats stats() const;
+
+    /**
+     * Empties the cache. The lookup frequencies are kept.
+     */
+    void clear();
+
+  private:
+    /// The entries ordered by priority
+    using queue_type = std::multimap<double, Key>;
+
+    /**
+     * A value in the cache.
+     */
+    struct entry
+    {
+        /// the value
+        Value value;
+        /// the size of the value
+        uint64_t bytes;
+        /// the entry's position in queue_
+        typename queue_type::iterator pos;
+    };
+
+    /**
+     * @param key A key
+     * @param bytes The size of the key's value
+     * @return the priority of the key's entry
+     */
+    double priority(const Key& key, uint64_t bytes) const;
+
+    /**
+     * Counts a lookup of a key in the frequency sketch.
+     * @param key The key looked up
+     */
+    void record(const Key& key);
+
+    /**
+     * @param key A key
+     * @return the estimated number of recent lookups of the key
+     */
+    uint64_t frequency(const Key& key) const;
+
+    /**
+     * @param key A key
+     * @param row A row of the sketch
+     * @return the position of the key's counter in the row
+     */
+    uint64_t slot(const Key& key, uint64_t row) const;
+
+    /// The number of rows in the frequency sketch
+    const static uint64_t sketch_rows = 4;
+
+    /// The maximum number of bytes of values to hold
+    uint64_t max_bytes_;
+
+    /// The cost of a miss beyond reading the value's bytes
+    uint64_t miss_cost_;
+
+    /// The number of bytes of values held
+    uint64_t bytes_;
+
+    /// The priority of the entry evicted last
+    double clock_;
+
+    /// The entries, by key
+    std::unordered_map<Key, entry> entries_;
+
+    /// The entries, by priority
+    queue_type queue_;
+
+    /// The counters of the frequency sketch, row after row
+    std::vector<uint8_t> sketch_;
+
+    /// One less than the width of a row of the sketch
+    uint64_t sketch_mask_;
+
+    /// The number of lookups counted since the sketch was last halved
+    uint64_t lookups_;
+
+    /// The activity of the cache
+    cache_counters counters_;
+
+    /// The mutex that synchronizes access to the cache
+    std::unique_ptr<std::mutex> mutables_{make_unique<std::mutex>()};
+};
+}
+}
+
+#include "caching/gdsf_cache.tcc"
+#endif
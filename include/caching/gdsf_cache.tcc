@@ -0,0 +1,196 @@
+/**
+ * @file gdsf_cache.tcc
+ */
+
+#include <algorithm>
+#include <functional>
+
+#include "caching/gdsf_cache.h"
+
+namespace meta
+{
+namespace caching
+{
+
+template <class Key, class Value>
+const uint64_t gdsf_cache<Key, Value>::sketch_rows;
+
+template <class Key, class Value>
+gdsf_cache<Key, Value>::gdsf_cache(uint64_t max_bytes, uint64_t miss_cost,
+                                   uint64_t sketch_width)
+    : max_bytes_{max_bytes},
+      miss_cost_{miss_cost},
+      bytes_{0},
+      clock_{0},
+      lookups_{0}
+{
+    uint64_t width = 1;
+    while (width < sketch_width)
+        width *= 2;
+    sketch_.resize(sketch_rows * width, 0);
+    sketch_mask_ = width - 1;
+}
+
+template <class Key, class Value>
+uint64_t gdsf_cache<Key, Value>::slot(const Key& key, uint64_t row) const
+{
+    // each row mixes the hash with a different odd multiplier
+    uint64_t hash = std::hash<Key>{}(key);
+    hash = (hash + row) * (0x9E3779B97F4A7C15ull + 2 * row);
+    hash ^= hash >> 29;
+    return row * (sketch_mask_ + 1) + (hash & sketch_mask_);
+}
+
+template <class Key, class Value>
+void gdsf_cache<Key, Value>::record(const Key& key)
+{
+    // only the smallest counters are incremented, which keeps keys that
+    // share a counter with a popular one from being overestimated
+    auto freq = frequency(key);
+    if (freq < 255)
+    {
+        for (uint64_t row = 0; row < sketch_rows; ++row)
+        {
+            auto& count = sketch_[slot(key, row)];
+            if (count == freq)
+                ++count;
+        }
+    }
+
+    // halving the counters now and then lets the estimates follow
+    // changes in what is popular
+    if (++lookups_ >= 10 * (sketch_mask_ + 1))
+    {
+        for (auto& count : sketch_)
+            count /= 2;
+        lookups_ = 0;
+    }
+}
+
+template <class Key, class Value>
+uint64_t gdsf_cache<Key, Value>::frequency(const Key& key) const
+{
+    uint64_t freq = 255;
+    for (uint64_t row = 0; row < sketch_rows; ++row)
+        freq = std::min<uint64_t>(freq, sketch_[slot(key, row)]);
+    return freq;
+}
+
+template <class Key, class Value>
+double gdsf_cache<Key, Value>::priority(const Key& key, uint64_t bytes) const
+{
+    auto freq = std::max<uint64_t>(1, frequency(key));
+    auto size = std::max<uint64_t>(1, bytes);
+    return clock_ + static_cast<double>(freq) * (size + miss_cost_) / size;
+}
+
+template <class Key, class Value>
+void gdsf_cache<Key, Value>::insert(const Key& key, const Value& value)
+{
+    auto bytes = internal::value_bytes(value, 0);
+    std::lock_guard<std::mutex> lock{*mutables_};
+
+    auto it = entries_.find(key);
+    if (it != entries_.end())
+    {
+        bytes_ -= it->second.bytes;
+        queue_.erase(it->second.pos);
+        entries_.erase(it);
+    }
+
+    if (bytes > max_bytes_)
+        return;
+
+    // find the entries that would have to go to make room, and keep the
+    // cache as it is if any of them is worth more than the new value
+    auto prio = priority(key, bytes);
+    auto freed = uint64_t{0};
+    auto last = queue_.begin();
+    while (bytes_ - freed + bytes > max_bytes_)
+    {
+        if (last->first > prio)
+            return;
+        freed += entries_.find(last->second)->second.bytes;
+        ++last;
+    }
+
+    for (auto victim = queue_.begin(); victim != last;)
+    {
+        clock_ = std::max(clock_, victim->first);
+        entries_.erase(victim->second);
+        victim = queue_.erase(victim);
+        counters_.evictions();
+    }
+    bytes_ -= freed;
+
+    auto pos = queue_.emplace(priority(key, bytes), key);
+    entries_.emplace(key, entry{value, bytes, pos});
+    bytes_ += bytes;
+    counters_.insertion();
+}
+
+template <class Key, class Value>
+util::optional<Value> gdsf_cache<Key, Value>::find(const Key& key)
+{
+    std::lock_guard<std::mutex> lock{*mutables_};
+    record(key);
+
+    auto it = entries_.find(key);
+    if (it == entries_.end())
+    {
+        counters_.miss();
+        return util::nullopt;
+    }
+
+    counters_.hit();
+    queue_.erase(it->second.pos);
+    it->second.pos = queue_.emplace(priority(key, it->second.bytes), key);
+    return it->second.value;
+}
+
+template <class Key, class Value>
+std::vector<Key> gdsf_cache<Key, Value>::keys() const
+{
+    std::lock_guard<std::mutex> lock{*mutables_};
+    std::vector<Key> keys;
+    keys.reserve(queue_.size());
+    for (auto it = queue_.rbegin(); it != queue_.rend(); ++it)
+        keys.push_back(it->second);
+    return keys;
+}
+
+template <class Key, class Value>
+uint64_t gdsf_cache<Key, Value>::size() const
+{
+    std::lock_guard<std::mutex> lock{*mutables_};
+    return entries_.size();
+}
+
+template <class Key, class Value>
+uint64_t gdsf_cache<Key, Value>::bytes_used() const
+{
+    std::lock_guard<std::mutex> lock{*mutables_};
+    return bytes_;
+}
+
+template <class Key, class Value>
+cache_stats gdsf_cache<Key, Value>::stats() const
+{
+    auto stats = counters_.stats();
+    std::lock_guard<std::mutex> lock{*mutables_};
+    stats.entries = entries_.size();
+    stats.bytes = bytes_;
+    return stats;
+}
+
+template <class Key, class Value>
+void gdsf_cache<Key, Value>::clear()
+{
+    std::lock_guard<std::mutex> lock{*mutables_};
+    entries_.clear();
+    queue_.clear();
+    bytes_ = 0;
+    clock_ = 0;
+}
+}
+}
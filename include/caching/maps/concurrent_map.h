@@ -0,0 +1,147 @@
+/**
+ * @file concurrent_map.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_CONCURRENT_MAP_H_
+#define META_CONCURRENT_MAP_H_
+
+#include <memory>
+#include <utility>
+#include <vector>
+#if !META_HAS_STD_SHARED_PTR_ATOMICS
+#include <mutex>
+#endif
+
+#include "meta.h"
+#include "util/optional.h"
+
+namespace meta
+{
+namespace caching
+{
+
+/**
+ * A hash map for caches that are read far more often than they are
+ * written, usable as the Map of a dblru_cache in place of locking_map.
+ *
+ * The map is a fixed number of buckets, each an immutable list of
+ * entries. A lookup loads the current list of one bucket and searches it
+ * without taking a lock, so lookups never wait for each other or for
+ * writers. A write copies the bucket's list, changes the copy, and
+ * publishes it with a compare-and-swap, retrying if another write to the
+ * same bucket got there first; readers still holding the old list keep it
+ * alive until they are done. Without atomic operations on shared_ptr,
+ * each bucket has its own mutex instead, which still spreads contention
+ * over all of the buckets.
+ *
+ * Writes cost time proportional to the length of a bucket, so the number
+ * of buckets should be about the number of entries the map will hold.
+ */
+template <class Key, class Value>
+class concurrent_map
+{
+  public:
+    /**
+     * @param num_buckets The number of buckets; rounded up to a power of
+     * two
+     */
+    concurrent_map(uint64_t num_buckets = 4096);
+
+    /**
+     * concurrent_map may be move constructed.
+     */
+    concurrent_map(concurrent_map&&) = default;
+
+    /**
+     * concurrent_map may be move assigned.
+     * @return the current concurrent_map
+     */
+    concurrent_map& operator=(concurrent_map&&) = default;
+
+    /**
+     * Inserts a (key, value) pair into the map, replacing the value of the
+     * key if it is already present.
+     * @param key The key to insert
+     * @param value The value to insert
+     */
+    void insert(const Key& key, const Value& value);
+
+    /**
+     * Inserts a (key, value) pair into the map if the key is not already
+     * present.
+     * @param args The parameters to construct the (key, value) pair with
+     */
+    template <class... Args>
+    void emplace(Args&&... args);
+
+    /**
+     * Finds a value in the map without locking.
+     * @param key The key to find the corresponding value for
+     * @return an optional that may contain the value, if found
+     */
+    util::optional<Value> find(const Key& key) const;
+
+    /**
+     * @return the keys currently in the map
+     */
+    std::vector<Key> keys() const;
+
+    /**
+     * Calls a function with each (key, value) pair in the map.
+     * @param fn The function to call
+     */
+    template <class Function>
+    void for_each(Function&& fn) const;
+
+  private:
+    /// The entries of one bucket
+    using entry_list = std::vector<std::pair<Key, Value>>;
+
+    /**
+     * A bucket of the map.
+     */
+    struct bucket
+    {
+        /// the current entries of the bucket; null if it has none
+        std::shared_ptr<const entry_list> entries;
+#if !META_HAS_STD_SHARED_PTR_ATOMICS
+        /// protects entries
+        std::mutex mutex;
+#endif
+    };
+
+    /**
+     * @param key A key
+     * @return the bucket holding the key
+     */
+    bucket& bucket_for(const Key& key) const;
+
+    /**
+     * @param b A bucket
+     * @return the current entries of the bucket
+     */
+    static std::shared_ptr<const entry_list> load(bucket& b);
+
+    /**
+     * Adds an entry to a bucket.
+     * @param entry The entry to add
+     * @param replace Whether to replace the value of a key that is
+     * already present
+     */
+    void insert(std::pair<Key, Value> entry, bool replace);
+
+    /// One less than the number of buckets
+    uint64_t mask_;
+
+    /// The buckets
+    std::unique_ptr<bucket[]> buckets_;
+};
+}
+}
+
+#include "caching/maps/concurrent_map.tcc"
+#endif
@@ -0,0 +1,142 @@
+/**
+ * @file concurrent_map.tcc
+ */
+
+#include <algorithm>
+#include <functional>
+
+#include "caching/maps/concurrent_map.h"
+
+namespace meta
+{
+namespace caching
+{
+
+template <class Key, class Value>
+concurrent_map<Key, Value>::concurrent_map(uint64_t num_buckets)
+{
+    uint64_t size = 1;
+    while (size < num_buckets)
+        size *= 2;
+    mask_ = size - 1;
+    buckets_.reset(new bucket[size]);
+}
+
+template <class Key, class Value>
+auto concurrent_map<Key, Value>::bucket_for(const Key& key) const -> bucket &
+{
+    // mix the high bits of the hash into the low ones used to pick a
+    // bucket, since std::hash is often the identity for integers
+    uint64_t hash = std::hash<Key>{}(key);
+    hash *= 0x9E3779B97F4A7C15ull;
+    return buckets_[(hash ^ (hash >> 32)) & mask_];
+}
+
+template <class Key, class Value>
+auto concurrent_map<Key, Value>::load(bucket& b)
+    -> std::shared_ptr<const entry_list>
+{
+#if META_HAS_STD_SHARED_PTR_ATOMICS
+    return std::atomic_load(&b.entries);
+#else
+    std::lock_guard<std::mutex> lock{b.mutex};
+    return b.entries;
+#endif
+}
+
+template <class Key, class Value>
+void concurrent_map<Key, Value>::insert(std::pair<Key, Value> entry,
+                                        bool replace)
+{
+    auto& b = bucket_for(entry.first);
+#if !META_HAS_STD_SHARED_PTR_ATOMICS
+    std::lock_guard<std::mutex> lock{b.mutex};
+    auto current = b.entries;
+#else
+    auto current = std::atomic_load(&b.entries);
+#endif
+    while (true)
+    {
+        auto entries = current ? std::make_shared<entry_list>(*current)
+                               : std::make_shared<entry_list>();
+        auto it = std::find_if(entries->begin(), entries->end(),
+                               [&](const std::pair<Key, Value>& e)
+                               {
+            return e.first == entry.first;
+        });
+        if (it == entries->end())
+            entries->push_back(entry);
+        else if (replace)
+            it->second = entry.second;
+        else
+            return;
+
+        std::shared_ptr<const entry_list> next{std::move(entries)};
+#if META_HAS_STD_SHARED_PTR_ATOMICS
+        // on failure, current is updated to the list that won
+        if (std::atomic_compare_exchange_weak(&b.entries, &current, next))
+            return;
+#else
+        b.entries = std::move(next);
+        return;
+#endif
+    }
+}
+
+template <class Key, class Value>
+void concurrent_map<Key, Value>::insert(const Key& key, const Value& value)
+{
+    insert(std::make_pair(key, value), true);
+}
+
+template <class Key, class Value>
+template <class... Args>
+void concurrent_map<Key, Value>::emplace(Args&&... args)
+{
+    insert(std::pair<Key, Value>(std::forward<Args>(args)...), false);
+}
+
+template <class Key, class Value>
+util::optional<Value> concurrent_map<Key, Value>::find(const Key& key) const
+{
+    auto entries = load(bucket_for(key));
+    if (!entries)
+        return util::nullopt;
+    for (const auto& entry : *entries)
+    {
+        if (entry.first == key)
+            return entry.second;
+    }
+    return util::nullopt;
+}
+
+template <class Key, class Value>
+std::vector<Key> concurrent_map<Key, Value>::keys() const
+{
+    std::vector<Key> keys;
+    for (uint64_t i = 0; i <= mask_; ++i)
+    {
+        auto entries = load(buckets_[i]);
+        if (!entries)
+            continue;
+        for (const auto& entry : *entries)
+            keys.push_back(entry.first);
+    }
+    return keys;
+}
+
+template <class Key, class Value>
+template <class Function>
+void concurrent_map<Key, Value>::for_each(Function&& fn) const
+{
+    for (uint64_t i = 0; i <= mask_; ++i)
+    {
+        auto entries = load(buckets_[i]);
+        if (!entries)
+            continue;
+        for (const auto& entry : *entries)
+            fn(entry.first, entry.second);
+    }
+}
+}
+}
@@ -12,6 +12,7 @@
 #include <unordered_map>
 #include <memory>
 #include <mutex>
+#include <vector>
 
 #include "util/optional.h"
 
@@ -75,6 +76,18 @@ class locking_map
      */
     util::optional<Value> find(const Key& key) const;
 
+    /**
+     * @return the keys currently in the map
+     */
+    std::vector<Key> keys() const;
+
+    /**
+     * Calls a function with each (key, value) pair in the map.
+     * @param fn The function to call
+     */
+    template <class Function>
+    void for_each(Function&& fn) const;
+
     /// iterator type for locking_maps
     using iterator = typename std::unordered_map<Key, Value>::iterator;
     /// const_iterator type for locking_maps
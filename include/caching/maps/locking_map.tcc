@@ -53,6 +53,26 @@ util::optional<Value> locking_map<Key, Value>::find(const Key& key) const
     return {it->second};
 }
 
+template <class Key, class Value>
+std::vector<Key> locking_map<Key, Value>::keys() const
+{
+    std::lock_guard<std::mutex> lock{mutables_};
+    std::vector<Key> keys;
+    keys.reserve(map_.size());
+    for (const auto& pr : map_)
+        keys.push_back(pr.first);
+    return keys;
+}
+
+template <class Key, class Value>
+template <class Function>
+void locking_map<Key, Value>::for_each(Function&& fn) const
+{
+    std::lock_guard<std::mutex> lock{mutables_};
+    for (const auto& pr : map_)
+        fn(pr.first, pr.second);
+}
+
 template <class Key, class Value>
 auto locking_map<Key, Value>::begin() -> iterator
 {
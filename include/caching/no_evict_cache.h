@@ -13,7 +13,9 @@
 #include <deque>
 #include <memory>
 #include <mutex>
+#include <vector>
 
+#include "caching/cache_stats.h"
 #include "meta.h"
 #include "util/optional.h"
 #include "util/shim.h"
@@ -52,6 +54,16 @@ class no_evict_cache
      */
     util::optional<Value> find(const Key& key) const;
 
+    /**
+     * @return the keys in the cache, in increasing order
+     */
+    std::vector<Key> keys() const;
+
+    /**
+     * @return the activity of the cache so far
+     */
+    cache_stats stats() const;
+
     /**
      * Clears the cache.
      */
@@ -67,6 +79,21 @@ class no_evict_cache
      * Contains all of the values inserted thus far. Never shrinks.
      */
     std::deque<util::optional<Value>> values_;
+
+    /**
+     * The number of values in the cache.
+     */
+    uint64_t entries_ = 0;
+
+    /**
+     * The memory used by the values in the cache.
+     */
+    uint64_t bytes_ = 0;
+
+    /**
+     * The activity of the cache.
+     */
+    mutable cache_counters counters_;
 };
 }
 }
@@ -11,21 +11,57 @@ void no_evict_cache<Key, Value>::insert(const Key& key, const Value& value)
     std::lock_guard<std::mutex> lock{*mutables_};
     if (key >= values_.size())
         values_.resize(key + 1);
-    values_[key] = util::optional<Value>{value};
+    auto& slot = values_[key];
+    if (slot)
+        bytes_ -= internal::value_bytes(*slot, 0);
+    else
+        ++entries_;
+    bytes_ += internal::value_bytes(value, 0);
+    slot = util::optional<Value>{value};
+    counters_.insertion();
 }
 
 template <class Key, class Value>
 util::optional<Value> no_evict_cache<Key, Value>::find(const Key& key) const
 {
-    if (key >= values_.size())
+    if (key >= values_.size() || !values_[key])
+    {
+        counters_.miss();
         return util::nullopt;
+    }
+    counters_.hit();
     return values_[key];
 }
 
+template <class Key, class Value>
+std::vector<Key> no_evict_cache<Key, Value>::keys() const
+{
+    std::lock_guard<std::mutex> lock{*mutables_};
+    std::vector<Key> keys;
+    for (uint64_t i = 0; i < values_.size(); ++i)
+    {
+        if (values_[i])
+            keys.push_back(static_cast<Key>(i));
+    }
+    return keys;
+}
+
+template <class Key, class Value>
+cache_stats no_evict_cache<Key, Value>::stats() const
+{
+    auto stats = counters_.stats();
+    std::lock_guard<std::mutex> lock{*mutables_};
+    stats.entries = entries_;
+    stats.bytes = bytes_;
+    return stats;
+}
+
 template <class Key, class Value>
 void no_evict_cache<Key, Value>::clear()
 {
     values_.clear();
+    entries_ = 0;
+    bytes_ = 0;
 }
 }
 }
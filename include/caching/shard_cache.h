@@ -13,6 +13,7 @@
 #include <mutex>
 #include <vector>
 
+#include "caching/cache_stats.h"
 #include "caching/dblru_cache.h"
 #include "caching/splay_cache.h"
 #include "util/optional.h"
@@ -74,6 +75,16 @@ class generic_shard_cache
      */
     util::optional<Value> find(const Key& key);
 
+    /**
+     * @return the keys in every shard of the cache
+     */
+    std::vector<Key> keys() const;
+
+    /**
+     * @return the activity of every shard of the cache, summed
+     */
+    cache_stats stats() const;
+
   private:
     /**
      * The Map for each shard.
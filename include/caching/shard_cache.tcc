@@ -32,5 +32,26 @@ util::optional<Value> generic_shard_cache<Key, Value, Map>::find(const Key& key)
     auto shard = hasher_(key) % shards_.size();
     return shards_[shard].find(key);
 }
+
+template <class Key, class Value, template <class, class> class Map>
+std::vector<Key> generic_shard_cache<Key, Value, Map>::keys() const
+{
+    std::vector<Key> keys;
+    for (const auto& shard : shards_)
+    {
+        auto part = shard.keys();
+        keys.insert(keys.end(), part.begin(), part.end());
+    }
+    return keys;
+}
+
+template <class Key, class Value, template <class, class> class Map>
+cache_stats generic_shard_cache<Key, Value, Map>::stats() const
+{
+    cache_stats stats;
+    for (const auto& shard : shards_)
+        stats += shard.stats();
+    return stats;
+}
 }
 }
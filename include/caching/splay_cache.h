@@ -14,6 +14,7 @@
 #include <mutex>
 #include <vector>
 
+#include "caching/cache_stats.h"
 #include "meta.h"
 #include "util/optional.h"
 
@@ -74,6 +75,18 @@ class splay_cache
      */
     uint64_t size() const;
 
+    /**
+     * @return the keys in the cache in breadth-first order, so that
+     * the most recently used ones, which are splayed to the top of the
+     * tree, tend to come first
+     */
+    std::vector<Key> keys() const;
+
+    /**
+     * @return the activity of the cache so far
+     */
+    cache_stats stats() const;
+
     /**
      * Empties the cache.
      */
@@ -119,6 +132,10 @@ class splay_cache
     uint64_t max_size_;
     /// the root of the tree
     node* root_;
+    /// the memory used by the values in the cache
+    uint64_t bytes_;
+    /// the activity of the cache
+    cache_counters counters_;
     /// the mutex that synchronizes access to the cache
     mutable std::mutex mutables_;
 
@@ -11,7 +11,7 @@ namespace caching
 
 template <class Key, class Value>
 splay_cache<Key, Value>::splay_cache(uint64_t max_size)
-    : size_{0}, max_size_(max_size), root_(nullptr)
+    : size_{0}, max_size_(max_size), root_(nullptr), bytes_{0}
 {
     /* nothing */
 }
@@ -20,7 +20,9 @@ template <class Key, class Value>
 splay_cache<Key, Value>::splay_cache(splay_cache&& other)
     : size_{std::move(other.size_)},
       max_size_{std::move(other.max_size_)},
-      root_{std::move(other.root_)}
+      root_{std::move(other.root_)},
+      bytes_{other.bytes_},
+      counters_{std::move(other.counters_)}
 {
     /* nothing */
 }
@@ -33,6 +35,8 @@ splay_cache<Key, Value>& splay_cache<Key, Value>::operator=(splay_cache&& rhs)
         size_ = std::move(rhs.size_);
         max_size_ = std::move(rhs.max_size_);
         root_ = std::move(rhs.root_);
+        bytes_ = rhs.bytes_;
+        counters_ = std::move(rhs.counters_);
     }
     return *this;
 }
@@ -48,6 +52,7 @@ void splay_cache<Key, Value>::insert(const Key& key, const Value& value)
 {
     std::lock_guard<std::mutex> lock{mutables_};
     insert(root_, key, value);
+    counters_.insertion();
 }
 
 template <class Key, class Value>
@@ -57,6 +62,7 @@ void splay_cache
     if (subroot == nullptr)
     {
         subroot = new node{key, value};
+        bytes_ += internal::value_bytes(value, 0);
         ++size_;
     }
     else if (key < subroot->key)
@@ -85,6 +91,8 @@ void splay_cache
     }
     else if (key == subroot->key)
     {
+        bytes_ -= internal::value_bytes(subroot->value, 0);
+        bytes_ += internal::value_bytes(value, 0);
         subroot->value = value;
     }
 }
@@ -93,6 +101,10 @@ template <class Key, class Value>
 void splay_cache
     <Key, Value>::replace(node* subroot, const Key& key, const Value& value)
 {
+    // the key being replaced is evicted
+    bytes_ -= internal::value_bytes(subroot->value, 0);
+    bytes_ += internal::value_bytes(value, 0);
+    counters_.evictions();
     subroot->key = key;
     subroot->value = value;
 }
@@ -105,8 +117,12 @@ util::optional<Value> splay_cache<Key, Value>::find(const Key& key)
     {
         find(root_, key);
         if (root_->key == key)
+        {
+            counters_.hit();
             return {root_->value};
+        }
     }
+    counters_.miss();
     return {util::nullopt};
 }
 
@@ -171,11 +187,47 @@ uint64_t splay_cache<Key, Value>::size() const
     return size_;
 }
 
+template <class Key, class Value>
+std::vector<Key> splay_cache<Key, Value>::keys() const
+{
+    std::lock_guard<std::mutex> lock{mutables_};
+    std::vector<Key> keys;
+    std::vector<const node*> level;
+    if (root_ != nullptr)
+        level.push_back(root_);
+    while (!level.empty())
+    {
+        std::vector<const node*> next;
+        for (const auto& n : level)
+        {
+            keys.push_back(n->key);
+            if (n->left != nullptr)
+                next.push_back(n->left);
+            if (n->right != nullptr)
+                next.push_back(n->right);
+        }
+        level.swap(next);
+    }
+    return keys;
+}
+
+template <class Key, class Value>
+cache_stats splay_cache<Key, Value>::stats() const
+{
+    auto stats = counters_.stats();
+    std::lock_guard<std::mutex> lock{mutables_};
+    stats.entries = size_;
+    stats.bytes = bytes_;
+    return stats;
+}
+
 template <class Key, class Value>
 void splay_cache<Key, Value>::clear()
 {
     std::lock_guard<std::mutex> lock{mutables_};
     clear(root_);
+    size_ = 0;
+    bytes_ = 0;
 }
 }
 }
@@ -8,3 +8,4 @@
 #include "classify/classifier/winnow.h"
 #include "classify/classifier/dual_perceptron.h"
 #include "classify/classifier/logistic_regression.h"
+#include "classify/classifier/softmax_regression.h"
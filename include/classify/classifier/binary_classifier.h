@@ -63,6 +63,26 @@ class binary_classifier : public classifier
      */
     const class_label& negative_label() const;
 
+    /**
+     * @return the id of the "positive" label in the index, which is
+     * label_id{0} if no document has that label
+     */
+    label_id positive_id() const;
+
+    /**
+     * @return the id of the "negative" label in the index, which is
+     * label_id{0} if no document has that label
+     */
+    label_id negative_id() const;
+
+    /**
+     * Classifies a document like classify(), but by label id.
+     *
+     * @param d_id The document to classify
+     * @return the id of the class it belongs to
+     */
+    label_id classify_id(doc_id d_id) const;
+
   private:
     /**
      * The label that marks positive examples
@@ -73,6 +93,17 @@ class binary_classifier : public classifier
      * The label to return when an example is classified as "negative"
      */
     const class_label negative_;
+
+    /**
+     * The id of the positive label, compared against the labels of the
+     * training documents instead of the label itself
+     */
+    const label_id positive_id_;
+
+    /**
+     * The id of the negative label
+     */
+    const label_id negative_id_;
 };
 
 }
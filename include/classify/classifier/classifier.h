@@ -9,6 +9,9 @@
 #ifndef META_CLASSIFIER_H_
 #define META_CLASSIFIER_H_
 
+#include <functional>
+#include <memory>
+#include <thread>
 #include <vector>
 #include "classify/confusion_matrix.h"
 
@@ -20,6 +23,10 @@ namespace classify
 /**
  * A classifier uses a document's feature space to identify which group it
  * belongs to.
+ *
+ * Once trained, a classifier may be asked to classify() several documents
+ * from different threads at once; classifiers for which this is not safe
+ * override classify_batch() and test().
  */
 class classifier
 {
@@ -43,10 +50,23 @@ class classifier
      */
     virtual void train(const std::vector<doc_id>& docs) = 0;
 
+    /**
+     * Classifies a collection of documents, calling classify() for
+     * different documents on a shared pool of threads.
+     * @param docs The documents to classify
+     * @param num_threads The number of threads to classify with
+     * @return the class of each document, in the order of docs
+     */
+    virtual std::vector<class_label>
+        classify_batch(const std::vector<doc_id>& docs,
+                       uint64_t num_threads
+                       = std::thread::hardware_concurrency());
+
     /**
      * Classifies a collection document into specific groups, as determined
      * by training data; this function will make repeated calls to
-     * classify().
+     * classify(), on several threads, each of which fills its own
+     * confusion_matrix.
      * @param docs The documents to classify
      * @return a confusion_matrix detailing the performance of the
      * classifier
@@ -67,6 +87,36 @@ class classifier
         cross_validate(const std::vector<doc_id>& input_docs, size_t k,
                        bool even_split = false, int seed = 1);
 
+    /**
+     * Creates the classifier for one fold of a parallel cross-validation.
+     * It may be called from several threads at once, and classifiers that
+     * store their models in files must be given a different prefix for
+     * each fold.
+     */
+    using fold_factory
+        = std::function<std::unique_ptr<classifier>(uint64_t fold)>;
+
+    /**
+     * Performs k-fold cross-validation with several folds running at once,
+     * each on its own classifier, which all share the same read-only
+     * index. The folds hold the same documents as those of the sequential
+     * cross_validate() with the same seed.
+     * @param make_fold Creates the classifier of each fold
+     * @param input_docs Testing documents
+     * @param k The number of folds
+     * @param even_split Whether to evenly split the data by class for a fair
+     * baseline
+     * @param seed The seed for the RNG used to shuffle the documents
+     * @param num_threads The number of folds to run at once
+     * @return a confusion_matrix containing the results over all the folds
+     */
+    static confusion_matrix
+        cross_validate(const fold_factory& make_fold,
+                       const std::vector<doc_id>& input_docs, size_t k,
+                       bool even_split = false, int seed = 1,
+                       uint64_t num_threads
+                       = std::thread::hardware_concurrency());
+
     /**
      * Clears any learning data associated with this classifier.
      */
@@ -77,6 +127,16 @@ class classifier
     std::shared_ptr<index::forward_index> idx_;
 
   private:
+    /**
+     * Copies and shuffles the documents to cross-validate on.
+     * @param input_docs Testing documents
+     * @param even_split Whether to evenly split the data by class
+     * @param seed The seed for the RNG used to shuffle the documents
+     * @return the documents in the order their folds are cut from
+     */
+    std::vector<doc_id> fold_order(const std::vector<doc_id>& input_docs,
+                                   bool even_split, int seed) const;
+
     /**
      * Modifies input_docs to be a vector of size <= the original vector size
      * with an even distribution of class labels per document
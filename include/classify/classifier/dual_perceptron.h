@@ -9,10 +9,13 @@
 #ifndef META_CLASSIFY_DUAL_PERCEPTRON_H_
 #define META_CLASSIFY_DUAL_PERCEPTRON_H_
 
+#include <algorithm>
+#include <functional>
+
+#include "caching/dblru_cache.h"
 #include "classify/classifier_factory.h"
 #include "classify/classifier/classifier.h"
 #include "classify/kernel/polynomial.h"
-#include "util/functional.h"
 #include "meta.h"
 
 namespace meta
@@ -40,6 +43,9 @@ class dual_perceptron : public classifier
     /// The default number of allowed iterations
     const static constexpr uint64_t default_max_iter = 100;
 
+    /// The default number of kernel values cached during training
+    const static constexpr uint64_t default_cache_size = 1 << 20;
+
     /// The identifier for this classifier
     const static std::string id;
 
@@ -54,24 +60,28 @@ class dual_perceptron : public classifier
      *  percentage of mistakes on one training run)
      * @param bias \f$b\f$, the bias
      * @param max_iter The maximum allowed iterations for training.
+     * @param cache_size The number of kernel values between training
+     *  documents to cache during training
      */
     template <class Kernel>
     dual_perceptron(std::shared_ptr<index::forward_index> idx,
                     Kernel&& kernel_fn = kernel::polynomial{},
                     double alpha = default_alpha, double gamma = default_gamma,
                     double bias = default_bias,
-                    uint64_t max_iter = default_max_iter)
+                    uint64_t max_iter = default_max_iter,
+                    uint64_t cache_size = default_cache_size)
         : classifier{std::move(idx)},
+          kernel_{[=](const sparse_doc& a, const sparse_doc& b)
+                  {
+              return kernel_fn(a, b);
+          }},
           alpha_{alpha},
           gamma_{gamma},
           bias_{bias},
-          max_iter_{max_iter}
+          max_iter_{max_iter},
+          cache_{std::max<uint64_t>(cache_size, 1)}
     {
-        std::function<double(pdata, pdata)> fun
-            = [=](const pdata& a, const pdata& b) {
-                return kernel_fn(a, b);
-            };
-        kernel_ = functional::memoize(fun);
+        // nothing
     }
 
     /**
@@ -86,6 +96,11 @@ class dual_perceptron : public classifier
      * formulation, its vectors are "mistake vectors" that keep track
      * of how often a given training instance was misclassified.
      *
+     * The training documents are read from the index once, into one
+     * contiguous array, and the kernel values between them are cached;
+     * afterwards only the support vectors (the documents with mistakes)
+     * are kept.
+     *
      * @param docs The training set
      */
     void train(const std::vector<doc_id>& docs) override;
@@ -108,30 +123,130 @@ class dual_perceptron : public classifier
     void reset() override;
 
   private:
+    /// A (term id, count) pair of a document.
+    using count_t = std::pair<term_id, double>;
+
+    /// The slot of a document that is not in the arena.
+    const static constexpr uint64_t no_slot = static_cast<uint64_t>(-1);
+
+    /**
+     * A view of a document's counts, sorted by term id, that the kernels
+     * can use in place of its postings data.
+     */
+    class sparse_doc
+    {
+      public:
+        /**
+         * @param first The first count
+         * @param last Just past the last count
+         */
+        sparse_doc(const count_t* first, const count_t* last)
+            : first_{first}, last_{last}
+        {
+            // nothing
+        }
+
+        /**
+         * @return this view, for the kernels' pointer-like access
+         */
+        const sparse_doc* operator->() const
+        {
+            return this;
+        }
+
+        /**
+         * @return this view, which iterates over the counts
+         */
+        const sparse_doc& counts() const
+        {
+            return *this;
+        }
+
+        /// @return the first count
+        const count_t* begin() const
+        {
+            return first_;
+        }
+
+        /// @return just past the last count
+        const count_t* end() const
+        {
+            return last_;
+        }
+
+        /**
+         * @param t_id A term id
+         * @return the count of the term in the document
+         */
+        double count(term_id t_id) const
+        {
+            auto it = std::lower_bound(first_, last_, t_id,
+                                       [](const count_t& c, term_id t)
+                                       {
+                return c.first < t;
+            });
+            return it != last_ && it->first == t_id ? it->second : 0;
+        }
+
+      private:
+        /// The first count
+        const count_t* first_;
+        /// Just past the last count
+        const count_t* last_;
+    };
+
+    /**
+     * Classifies a document against the support vectors.
+     *
+     * @param doc The document
+     * @param slot The document's slot, if it is a training document, so
+     *  that its kernel values are cached, or no_slot
+     * @return the class label determined for the document
+     */
+    class_label classify(const sparse_doc& doc, uint64_t slot);
+
+    /**
+     * @param slot The slot of a document in the arena
+     * @return the document
+     */
+    sparse_doc doc(uint64_t slot) const;
+
     /**
      * Decreases the "weight" (mistake count) for a given class label
      * and document.
      *
      * @param label The class label
-     * @param id The document
+     * @param slot The document's slot
+     */
+    void decrease_weight(const class_label& label, uint64_t slot);
+
+    /**
+     * Keeps only the support vectors in the arena.
      */
-    void decrease_weight(const class_label& label, const doc_id& id);
+    void compact();
 
     /**
-     * The "weight" (mistake count) vectors for each class label.
+     * The "weight" (mistake count) vectors for each class label, by the
+     * slot of each document.
      */
-    std::unordered_map<class_label, std::unordered_map<doc_id, uint64_t>>
+    std::unordered_map<class_label, std::unordered_map<uint64_t, uint64_t>>
         weights_;
 
     /**
-     * Convenience typedef for the postings data type.
+     * The counts of the documents, one after another.
+     */
+    std::vector<count_t> arena_;
+
+    /**
+     * Where the counts of each slot start in arena_, followed by the end
+     * of the last slot.
      */
-    using pdata = decltype(idx_->search_primary(doc_id{}));
+    std::vector<uint64_t> offsets_;
 
     /**
      * The kernel function to be used in lieu of a dot product.
      */
-    std::function<double(pdata, pdata)> kernel_;
+    std::function<double(const sparse_doc&, const sparse_doc&)> kernel_;
 
     /**
      * \f$\alpha\f$, the learning rate
@@ -153,6 +268,11 @@ class dual_perceptron : public classifier
      * The maximum number of iterations for training.
      */
     const uint64_t max_iter_;
+
+    /**
+     * The kernel values of pairs of training documents, by their slots.
+     */
+    caching::default_dblru_cache<uint64_t, double> cache_;
 };
 
 /**
@@ -12,9 +12,11 @@
 #include <unordered_set>
 #include "index/inverted_index.h"
 #include "index/forward_index.h"
+#include "index/hnsw_index.h"
 #include "index/ranker/ranker.h"
 #include "classify/classifier_factory.h"
 #include "classify/classifier/classifier.h"
+#include "util/optional.h"
 
 namespace meta
 {
@@ -23,6 +25,20 @@ namespace classify
 
 /**
  * Implements the k-Nearest Neighbor lazy learning classification algorithm.
+ *
+ * By default, the neighbors of a document are found by ranking every
+ * training document against it. Otherwise they are found approximately,
+ * by cosine similarity of TF-IDF vectors, from an hnsw_index built over
+ * the training documents.
+ *
+ * Optional config parameters:
+ * ~~~toml
+ * [classifier]
+ * neighbors = "hnsw" # default is "ranker"
+ * hnsw-links = 16
+ * hnsw-ef-construction = 100
+ * hnsw-ef-search = 50
+ * ~~~
  */
 class knn : public classifier
 {
@@ -38,10 +54,13 @@ class knn : public classifier
      * @param k The value of k in k-NN
      * @param args Arguments to the chosen ranker constructor
      * @param weighted Whether to weight the neighbors by distance to the query
+     * @param ann The parameters of an hnsw_index to find the neighbors
+     * with, if they are not to be found with the ranker
      */
     knn(std::shared_ptr<index::inverted_index> idx,
         std::shared_ptr<index::forward_index> f_idx, uint16_t k,
-        std::unique_ptr<index::ranker> ranker, bool weighted = false);
+        std::unique_ptr<index::ranker> ranker, bool weighted = false,
+        util::optional<index::hnsw_options> ann = util::nullopt);
 
     /**
      * Creates a classification model based on training documents.
@@ -66,11 +85,11 @@ class knn : public classifier
     /**
      * @param scored
      * @param sorted
-     * @return the best label
+     * @return the id of the best label
      */
-    class_label select_best_label(
+    label_id select_best_label(
         const std::vector<std::pair<doc_id, double>>& scored,
-        const std::vector<std::pair<class_label, uint16_t>>& sorted) const;
+        const std::vector<std::pair<label_id, uint16_t>>& sorted) const;
 
     /** the inverted index used for ranking */
     std::shared_ptr<index::inverted_index> inv_idx_;
@@ -89,6 +108,12 @@ class knn : public classifier
     /** Whether we want the neighbors to be weighted by distance or not */
     const bool weighted_;
 
+    /** the parameters of the hnsw_index, if one is used */
+    const util::optional<index::hnsw_options> ann_;
+
+    /** the approximate neighbors of the training documents, if used */
+    std::unique_ptr<index::hnsw_index> hnsw_;
+
   public:
     /**
      * Basic exception for knn interactions.
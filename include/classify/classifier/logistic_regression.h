@@ -48,6 +48,10 @@ namespace classify
  * The individual class probabilities may be recovered by using the
  * `predict` function: this returns an `unordered_map` of `class_label` to
  * probability.
+ *
+ * The regressions are trained at the same time, on their rows of a single
+ * in-memory copy of the training documents, and a document being
+ * classified is read from the index once for all of them.
  */
 class logistic_regression : public classifier
 {
@@ -60,6 +60,15 @@ class naive_bayes : public classifier
      */
     class_label classify(doc_id d_id) override;
 
+    /**
+     * Classifies a collection of documents, decoding them all at once and
+     * scoring every class of a document in a single pass over its terms.
+     * @param docs The documents to classify
+     * @return a confusion_matrix detailing the performance of the
+     * classifier
+     */
+    confusion_matrix test(const std::vector<doc_id>& docs) override;
+
     /**
      * Resets any learning information associated with this classifier.
      */
@@ -72,14 +81,39 @@ class naive_bayes : public classifier
 
   private:
     /**
-     * Contains P(term|class) for each class.
+     * Fills the log-probability tables from the current class models.
+     * Called whenever the models change, so that classify() only reads
+     * them.
+     */
+    void finalize();
+
+    /**
+     * @param doc The (term id, count) pairs of a document
+     * @return the id of the most likely class of the document
      */
-    util::sparse_vector<class_label, stats::multinomial<term_id>> term_probs_;
+    template <class Row>
+    label_id best_label(const Row& doc) const;
+
+    /**
+     * Contains P(term|class) for each class, by label id.
+     */
+    util::sparse_vector<label_id, stats::multinomial<term_id>> term_probs_;
 
     /**
      * Contains the number of documents in each class
      */
-    stats::multinomial<class_label> class_probs_;
+    stats::multinomial<label_id> class_probs_;
+
+    /**
+     * \f$\log P(term|class)\f$, with the classes of a term contiguous and
+     * in the order of term_probs_.
+     */
+    std::vector<float> log_term_probs_;
+
+    /**
+     * \f$\log P(class)\f$ for each class, in the order of term_probs_.
+     */
+    std::vector<double> log_class_probs_;
 };
 
 /**
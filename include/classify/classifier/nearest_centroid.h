@@ -60,20 +60,21 @@ class nearest_centroid : public classifier
     void reset() override;
 
   private:
-    /**
-     * @param d_id
-     * @param centroid
-     * @return the cosine similarity between the query and a centroid
-     */
-    double cosine_sim(const std::vector<std::pair<term_id, double>>& doc,
-                      const std::unordered_map<term_id, double>& centroid);
-
     /// Inverted index used for ranking
     std::shared_ptr<index::inverted_index> inv_idx_;
 
-    /// The document centroids for this learner
-    std::unordered_map<class_label, std::unordered_map<term_id, double>>
-        centroids_;
+    /// The inverse document frequency of each term, filled on first use
+    std::vector<double> idf_;
+
+    /// The classes that have a centroid
+    std::vector<class_label> classes_;
+
+    /// The TF-IDF weight of each term in each centroid, with the classes
+    /// of a term contiguous and in the order of classes_
+    std::vector<double> centroids_;
+
+    /// The length of each centroid, in the order of classes_
+    std::vector<double> norms_;
 
   public:
     /**
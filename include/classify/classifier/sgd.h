@@ -11,8 +11,10 @@
 
 #include "classify/binary_classifier_factory.h"
 #include "classify/classifier/binary_classifier.h"
+#include "classify/feature_selector.h"
 #include "classify/loss/loss_function.h"
 #include "util/disk_vector.h"
+#include "util/optional.h"
 #include "meta.h"
 
 namespace meta
@@ -38,6 +40,33 @@ class sgd : public binary_classifier
     const static constexpr double default_lambda = 0.0001;
     /// The default number of allowed iterations.
     const static constexpr size_t default_max_iter = 50;
+    /// The default number of training threads.
+    const static constexpr size_t default_num_threads = 1;
+    /// The default number of documents per update.
+    const static constexpr uint64_t default_batch_size = 1;
+
+    /**
+     * The rules the weights can be updated by.
+     */
+    enum class update_rule
+    {
+        /// Every weight has the learning rate \f$\alpha\f$.
+        standard,
+        /// AdaGrad (Duchi et al., 2011): each weight has the learning
+        /// rate \f$\alpha\f$ divided by the square root of the sum of
+        /// the squares of its gradients.
+        adagrad,
+        /// FTRL-Proximal (McMahan et al., 2013): each weight is computed
+        /// from the sums of its gradients and their squares, and is 0
+        /// while the sum is within the L1 regularization constant.
+        ftrl
+    };
+
+    /**
+     * @param name "sgd", "adagrad", or "ftrl"
+     * @return the update_rule with the given name
+     */
+    static update_rule parse_update_rule(const std::string& name);
 
     /**
      * @param prefix The prefix for the model file
@@ -50,12 +79,30 @@ class sgd : public binary_classifier
      * @param bias \f$b\f$, the bias
      * @param lambda \f$\lambda\f$, the regularization constant
      * @param max_iter The maximum number of iterations for training.
+     * @param num_threads The number of threads to train with; with more
+     *  than one, training is lock-free ("Hogwild"), see train()
+     * @param num_features The number of terms to learn weights for,
+     *  chosen by feature selection on the training documents, or 0 to
+     *  learn weights for every term of the index
+     * @param selection The statistic the terms are chosen by
+     * @param rule The rule the weights are updated by; with AdaGrad and
+     *  FTRL-Proximal, \f$\alpha\f$ is the learning rate of a weight's
+     *  first update, and is best much larger than the default
+     * @param batch_size The number of documents whose gradients are
+     *  summed for each update; with more than one, or with a rule other
+     *  than the standard one, see train()
+     * @param l1 The L1 regularization constant, used by AdaGrad and
+     *  FTRL-Proximal; \f$\lambda\f$ is the L2 constant
      */
     sgd(const std::string& prefix, std::shared_ptr<index::forward_index> idx,
         class_label positive, class_label negative,
         std::unique_ptr<loss::loss_function> loss, double alpha = default_alpha,
         double gamma = default_gamma, double bias = default_bias,
-        double lambda = default_lambda, size_t max_iter = default_max_iter);
+        double lambda = default_lambda, size_t max_iter = default_max_iter,
+        size_t num_threads = default_num_threads, uint64_t num_features = 0,
+        selection_method selection = selection_method::chi_square,
+        update_rule rule = update_rule::standard,
+        uint64_t batch_size = default_batch_size, double l1 = 0);
 
     /**
      * Returns the dot product with the current weight vector. Used
@@ -67,8 +114,61 @@ class sgd : public binary_classifier
      */
     double predict(doc_id d_id) const override;
 
+    /**
+     * Returns the dot product of a document's counts with the current
+     * weight vector, as predict(doc_id) does for a document of the index.
+     * Classifiers made of several sgds, like logistic_regression, read a
+     * document once and then predict with each of them.
+     *
+     * @param doc The (term id, count) pairs of the document
+     * @return the dot product with the current weight vector
+     */
+    double predict(const std::vector<std::pair<term_id, double>>& doc) const;
+
+    /**
+     * Trains the classifier. With several threads, each tenth of a
+     * shuffled pass over the documents is split among them, and every
+     * thread updates the shared weights without locking, as in Hogwild
+     * (Niu et al., 2011): updates for sparse documents rarely touch the
+     * same weights. The regularization coefficient and the bias are only
+     * changed between these blocks, when the threads are joined, and the
+     * loss of each block is summed over the threads for the convergence
+     * check.
+     *
+     * With mini-batches, or with AdaGrad or FTRL-Proximal, the weights
+     * are instead updated once per batch of the shuffled documents, by
+     * the mean of their gradients; the threads split each batch, and
+     * none of them writes to the weights. Only the weights of the terms
+     * in a batch are updated, and regularized: a weight that AdaGrad
+     * skipped is regularized for every skipped batch when it is next
+     * updated (or when training ends), and FTRL-Proximal needs no such
+     * catching up.
+     *
+     * When a number of features was given, they are selected from the
+     * training documents first, and the weights cover only them.
+     *
+     * @param docs The training documents
+     */
     void train(const std::vector<doc_id>& docs) override;
 
+    /**
+     * Trains the classifier, as train() does, on some of the rows of a
+     * matrix of training documents. Classifiers made of several sgds,
+     * like logistic_regression, materialize their training documents
+     * once and train every sgd on its rows of the same matrix, at the
+     * same time. When a number of features was given, the terms are
+     * selected from the documents of the rows, which are then read again
+     * from the index.
+     *
+     * @param matrix The training documents, materialized from the index
+     * @param rows The rows of the matrix to train on
+     * @param labels The label of each row of the matrix, +1 or -1; the
+     *  labels of the rows not trained on are ignored
+     */
+    void train(const index::csr_matrix& matrix,
+               const std::vector<uint64_t>& rows,
+               const std::vector<int>& labels);
+
     void reset() override;
 
     /**
@@ -104,19 +204,72 @@ class sgd : public binary_classifier
     /// The loss function to be used for the update.
     std::unique_ptr<loss::loss_function> loss_;
 
+    /// The number of threads to train with.
+    const size_t num_threads_;
+
+    /// The number of terms to select, or 0 to use all of them.
+    const uint64_t num_features_;
+
+    /// The statistic terms are selected by.
+    const selection_method selection_;
+
+    /// Maps the selected terms onto weights, once they are selected.
+    util::optional<feature_projection> projection_;
+
+    /// The rule the weights are updated by.
+    const update_rule rule_;
+
+    /// The number of documents per update.
+    const uint64_t batch_size_;
+
+    /// The L1 regularization constant.
+    const double l1_;
+
     /**
      * Typedef for the sparse vector training/test instances.
      */
     using counts_t = std::vector<std::pair<term_id, double>>;
 
     /**
-     * Helper function that takes a sparse vector. Used as a
-     * performance optimization during training.
+     * Helper function that takes a row of a training matrix.
      *
      * @param doc the document to form a prediction for
      * @return the dot product with the current weight vector
      */
-    double predict(const counts_t& doc) const;
+    double predict(const index::csr_matrix::row& doc) const;
+
+    /**
+     * Trains on rows of a matrix whose terms are those of the weights.
+     *
+     * @param matrix The training documents
+     * @param rows The rows of the matrix to train on
+     * @param labels The label of each row, +1 or -1
+     */
+    void train_rows(const index::csr_matrix& matrix,
+                    const std::vector<uint64_t>& rows,
+                    const std::vector<int>& labels);
+
+    /**
+     * Trains on the rows with several threads at once.
+     *
+     * @param matrix The training documents
+     * @param rows The rows of the matrix to train on
+     * @param labels The label of each row, +1 or -1
+     */
+    void train_parallel(const index::csr_matrix& matrix,
+                        const std::vector<uint64_t>& rows,
+                        const std::vector<int>& labels);
+
+    /**
+     * Trains on mini-batches of the rows, with any update rule.
+     *
+     * @param matrix The training documents
+     * @param rows The rows of the matrix to train on
+     * @param labels The label of each row, +1 or -1
+     */
+    void train_batches(const index::csr_matrix& matrix,
+                       const std::vector<uint64_t>& rows,
+                       const std::vector<int>& labels);
 };
 
 /**
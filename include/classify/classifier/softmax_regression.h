@@ -0,0 +1,152 @@
+/**
+ * @file softmax_regression.h
+ *
+ * All files in META are released under the MIT license. For more details,
+ * consult the file LICENSE in the root of the project.
+ */
+
+#ifndef META_CLASSIFY_SOFTMAX_REGRESSION_H_
+#define META_CLASSIFY_SOFTMAX_REGRESSION_H_
+
+#include <unordered_map>
+#include <vector>
+
+#include "classify/classifier/classifier.h"
+#include "classify/classifier_factory.h"
+#include "index/forward_index.h"
+#include "util/disk_vector.h"
+#include "meta.h"
+
+namespace meta
+{
+namespace classify
+{
+
+/**
+ * Multinomial logistic (softmax) regression over all \f$K\f$ classes at
+ * once, learned with SGD. Unlike one_vs_all or logistic_regression, which
+ * train one binary model per class and so pass over the documents once
+ * per class, every document updates the weights of all the classes it
+ * affects in a single pass.
+ *
+ * The weights of a term for all \f$K\f$ classes are stored next to each
+ * other, so scoring a document is one sparse-times-dense product: each of
+ * its terms adds a contiguous block of \f$K\f$ weights to the scores. The
+ * probability of class \f$k\f$ is then
+ *
+ * \f[
+ *   P(y_i = k) = \frac{\exp(s_k(x_i))}{\sum_{j=1}^K \exp(s_j(x_i))}
+ * \f]
+ *
+ * where \f$s_k(x_i)\f$ is the score of class \f$k\f$ for the \f$i\f$-th
+ * example.
+ *
+ * Required config parameters:
+ * ~~~toml
+ * [classifier]
+ * method = "softmax-regression"
+ * prefix = "path/to/model"
+ * ~~~
+ *
+ * Optional config parameters: `alpha`, `gamma`, `bias`, `lambda` and
+ * `max-iter`, as for sgd.
+ */
+class softmax_regression : public classifier
+{
+  public:
+    /// The default \f$\alpha\f$ parameter.
+    const static constexpr double default_alpha = 0.001;
+    /// The default \f$\gamma\f$ parameter.
+    const static constexpr double default_gamma = 1e-6;
+    /// The default \f$b\f$ parameter.
+    const static constexpr double default_bias = 1;
+    /// The default \f$\lambda\f$ parameter.
+    const static constexpr double default_lambda = 0.0001;
+    /// The default number of allowed iterations.
+    const static constexpr uint64_t default_max_iter = 50;
+
+    /**
+     * @param prefix The prefix for the model file
+     * @param idx The index to run the classifier on
+     * @param alpha \f$\alpha\f$, the learning rate
+     * @param gamma \f$\gamma\f$, the error threshold
+     * @param bias \f$b\f$, the bias
+     * @param lambda \f$\lambda\f$, the regularization constant
+     * @param max_iter The maximum number of iterations for training
+     */
+    softmax_regression(const std::string& prefix,
+                       std::shared_ptr<index::forward_index> idx,
+                       double alpha = default_alpha,
+                       double gamma = default_gamma,
+                       double bias = default_bias,
+                       double lambda = default_lambda,
+                       uint64_t max_iter = default_max_iter);
+
+    /**
+     * Obtains the probability that the given document belongs to each
+     * class.
+     *
+     * @param d_id The document to obtain class-membership probabilities for
+     * @return a map from class label to probability of membership
+     */
+    std::unordered_map<class_label, double> predict(doc_id d_id) const;
+
+    class_label classify(doc_id d_id) override;
+
+    void train(const std::vector<doc_id>& docs) override;
+
+    void reset() override;
+
+    /// the identifier for this classifier
+    const static std::string id;
+
+  private:
+    /**
+     * Computes the probability of each class for a document.
+     *
+     * @param doc The (term id, value) pairs of the document
+     * @param probs Where to store the probability of each class
+     */
+    template <class Row>
+    void probabilities(const Row& doc, std::vector<double>& probs) const;
+
+    /// the classes, in the order of their weights
+    std::vector<class_label> classes_;
+
+    /// class label -> its position in classes_
+    std::unordered_map<class_label, uint64_t> class_ids_;
+
+    /// the weight of each (term, class) pair, the classes of a term
+    /// being contiguous, followed by the bias of each class
+    util::disk_vector<double> weights_;
+
+    /// the scalar coefficient for the weights
+    double coeff_;
+
+    /// \f$\alpha\f$, the learning rate
+    const double alpha_;
+
+    /// \f$\gamma\f$, the error threshold
+    const double gamma_;
+
+    /// the value of the bias feature of each document
+    const double bias_weight_;
+
+    /// \f$\lambda\f$, the regularization constant
+    const double lambda_;
+
+    /// the maximum number of iterations for training
+    const uint64_t max_iter_;
+};
+
+/**
+ * Specialization of the factory method used for creating
+ * softmax_regression classifiers.
+ */
+template <>
+std::unique_ptr<classifier>
+    make_classifier<softmax_regression>(const cpptoml::table&,
+                                        std::shared_ptr<index::forward_index>);
+}
+}
+#endif
@@ -9,6 +9,7 @@
 #ifndef META_SVM_WRAPPER_H_
 #define META_SVM_WRAPPER_H_
 
+#include <stdexcept>
 #include <unordered_map>
 #include "classify/classifier_factory.h"
 #include "classify/classifier/classifier.h"
@@ -29,6 +30,10 @@ namespace classify
  * submodule and have compiled both libsvm and liblinear.
  *
  * If no kernel is selected, liblinear is used. Otherwise, libsvm is used.
+ *
+ * Training runs the liblinear or libsvm train program; the model it writes
+ * is then read into memory, and documents are classified from it without
+ * running another program, from several threads at once if need be.
  */
 class svm_wrapper : public classifier
 {
@@ -53,9 +58,12 @@ class svm_wrapper : public classifier
      * @param svm_path The path to the liblinear/libsvm library
      * @param kernel_opt Which kind of kernel you want to use (default:
      * None)
+     * @param prefix The prefix of the files the training data and the
+     * model are written to
      */
     svm_wrapper(std::shared_ptr<index::forward_index> idx,
-                const std::string& svm_path, kernel kernel_opt = kernel::None);
+                const std::string& svm_path, kernel kernel_opt = kernel::None,
+                const std::string& prefix = "svm");
 
     /**
      * Classifies a document into a specific group, as determined by
@@ -72,29 +80,63 @@ class svm_wrapper : public classifier
     void train(const std::vector<doc_id>& docs) override;
 
     /**
-     * Classifies a collection document into specific groups, as determined
-     * by training data; this function will make repeated calls to
-     * classify().
-     * @param docs The documents to classify
-     * @return a confusion_matrix detailing the performance of the
-     * classifier
+     * Clears any learned data from this classifier.
      */
-    confusion_matrix test(const std::vector<doc_id>& docs) override;
+    void reset() override;
 
     /**
-     * Clears any learned data from this classifier.
+     * Reads a model written by the liblinear or libsvm train program
+     * into memory, in place of any learned one.
+     * @param filename The file holding the model
      */
-    void reset() override;
+    void load_model(const std::string& filename);
 
     /**
      * The identifier for this classifier.
      */
     const static std::string id;
 
+    /**
+     * Basic exception for svm_wrapper interactions.
+     */
+    class svm_wrapper_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
   private:
+    /** a document's (term id, count) pairs, in increasing order of term id */
+    using counts_t = std::vector<std::pair<term_id, double>>;
+
+    /**
+     * @param counts A document's (term id, count) pairs
+     * @return the index in labels_ of the class liblinear's model gives
+     * the document
+     */
+    uint64_t linear_class(const counts_t& counts) const;
+
+    /**
+     * @param counts A document's (term id, count) pairs
+     * @return the index in labels_ of the class libsvm's model gives the
+     * document, by a vote of each pair of classes
+     */
+    uint64_t kernel_class(const counts_t& counts) const;
+
+    /**
+     * @param counts A document's (term id, count) pairs
+     * @param sv A support vector of libsvm's model
+     * @return the value of the kernel function for the document and the
+     * support vector
+     */
+    double kernel_value(const counts_t& counts, const counts_t& sv) const;
+
     /** the path to the liblinear/libsvm library */
     const std::string svm_path_;
 
+    /** the prefix of the files the training data and model are written to */
+    const std::string prefix_;
+
     /** keeps track of which arguments are necessary for which kernel
      * function */
     const static std::unordered_map<kernel, std::string, std::hash<int>>
@@ -105,6 +147,45 @@ class svm_wrapper : public classifier
 
     /** used to select which executable to use (libsvm or liblinear) */
     std::string executable_;
+
+    /** the label ids of the classes, in the order of the model */
+    std::vector<uint32_t> labels_;
+
+    /**
+     * liblinear's weights of each feature for each class, with the
+     * weights of a feature contiguous; the last feature is the bias
+     */
+    std::vector<double> weights_;
+
+    /** the number of weights of each feature in weights_ */
+    uint64_t num_weights_;
+
+    /** the value of liblinear's bias feature, negative if it has none */
+    double bias_;
+
+    /** libsvm's support vectors, grouped by class */
+    std::vector<counts_t> support_vectors_;
+
+    /**
+     * libsvm's coefficients of the support vectors, one row for each
+     * class but one
+     */
+    std::vector<std::vector<double>> coefficients_;
+
+    /** libsvm's constant term of each pair of classes */
+    std::vector<double> rho_;
+
+    /** the number of support vectors of each class */
+    std::vector<uint64_t> num_svs_;
+
+    /** the scale of the dot products in libsvm's kernel function */
+    double gamma_;
+
+    /** the constant term of libsvm's polynomial and sigmoid kernels */
+    double coef0_;
+
+    /** the degree of libsvm's polynomial kernel */
+    uint64_t degree_;
 };
 
 /**
@@ -26,6 +26,11 @@ namespace classify
  * Implements the Winnow classifier, a simplistic linear classifier for
  * linearly-separable data. As opposed to winnow (which uses an additive
  * update rule), winnow uses a multiplicative update rule.
+ *
+ * The weights of every class for a term are kept together, so that a
+ * document is scored against all of the classes in one pass over its
+ * terms, and the training documents are decoded from the index once for
+ * all of the iterations.
  */
 class winnow : public classifier
 {
@@ -84,26 +89,38 @@ class winnow : public classifier
 
   private:
     /**
-     * @return the given term's weight in the weight vector for the given
-     * class
+     * Scores a document against the weight vector of every class.
      *
-     * @param label The class label for the weight vector we want
-     * @param term The term whose weight should be returned
+     * @param doc The (term id, count) pairs of the document
+     * @return the index in classes_ of the class whose weight vector
+     * gives the highest result
      */
-    double get_weight(const class_label& label, const term_id& term) const;
+    template <class Row>
+    uint64_t best_class(const Row& doc) const;
 
     /**
-     * Initializes the weight vectors to zero for every class label.
+     * Initializes the weight vectors to one for every class label.
      *
      * @param docs The set of documents to collect class labels from.
      */
     void zero_weights(const std::vector<doc_id>& docs);
 
     /**
-     * The weight vectors for each class label.
+     * The class labels of the training documents, in the order they
+     * were first seen.
+     */
+    std::vector<class_label> classes_;
+
+    /**
+     * The index of each class label in classes_.
+     */
+    std::unordered_map<class_label, uint64_t> class_ids_;
+
+    /**
+     * The weight vectors of the classes, term-major: the weights of term
+     * t for every class start at t * classes_.size().
      */
-    std::unordered_map<class_label, std::unordered_map<term_id, double>>
-        weights_;
+    std::vector<double> weights_;
 
     /// \f$m\f$, the multiplicative learning rate.
     const double m_;
@@ -0,0 +1,174 @@
+/**
+ * @file feature_selector.h
+ *
+ * All files in META are released under the MIT license. For more details,
+ * consult the file LICENSE in the root of the project.
+ */
+
+#ifndef META_CLASSIFY_FEATURE_SELECTOR_H_
+#define META_CLASSIFY_FEATURE_SELECTOR_H_
+
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "index/csr_matrix.h"
+#include "meta.h"
+
+namespace meta
+{
+namespace index
+{
+class forward_index;
+}
+
+namespace classify
+{
+
+/**
+ * The statistics a feature_selector can rank features by.
+ */
+enum class selection_method
+{
+    chi_square,
+    information_gain,
+    doc_freq
+};
+
+/**
+ * @param name "chi-square", "info-gain", or "doc-freq"
+ * @return the selection_method with the given name
+ */
+selection_method parse_selection_method(const std::string& name);
+
+/**
+ * Ranks the terms of a forward_index by how much they tell about the class
+ * of the training documents that contain them, so that classifiers can
+ * learn from a few of them rather than the whole vocabulary.
+ *
+ * The number of training documents of each class that contain each term
+ * is counted in one parallel pass over the documents, after which any of
+ * the selection_methods can be used to score and select terms.
+ */
+class feature_selector
+{
+  public:
+    /**
+     * Counts the documents of each class that contain each term.
+     * @param idx The index holding the documents
+     * @param docs The training documents
+     * @param num_threads The number of threads to count with; each keeps
+     * a table of unique_terms() by the number of classes
+     */
+    feature_selector(const index::forward_index& idx,
+                     const std::vector<doc_id>& docs,
+                     uint64_t num_threads
+                     = std::thread::hardware_concurrency());
+
+    /**
+     * The score of a term is the largest of its \f$\chi^2\f$ statistics
+     * for the split of the documents into one class and the rest, its
+     * information gain about the class of a document, or the number of
+     * documents that contain it.
+     * @param term A term
+     * @param method The statistic to score the term with
+     * @return the score of the term; larger is better
+     */
+    double score(term_id term, selection_method method) const;
+
+    /**
+     * @param method The statistic to score the terms with
+     * @param num The number of terms to select
+     * @return the num terms with the highest scores, sorted by term id
+     */
+    std::vector<term_id> select(selection_method method, uint64_t num) const;
+
+    /**
+     * Basic exception for feature_selector interactions.
+     */
+    class feature_selector_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /**
+     * @param term A term
+     * @return the largest \f$\chi^2\f$ statistic of the term for one class
+     */
+    double chi_square(term_id term) const;
+
+    /**
+     * @param term A term
+     * @return the information gain of the term
+     */
+    double information_gain(term_id term) const;
+
+    /// The number of training documents
+    uint64_t num_docs_;
+
+    /// The number of training documents of each class
+    std::vector<uint64_t> class_docs_;
+
+    /// The number of training documents that contain each term
+    std::vector<uint64_t> term_docs_;
+
+    /// The number of training documents of each class that contain each
+    /// term, with the classes of a term contiguous
+    std::vector<uint32_t> counts_;
+};
+
+/**
+ * Maps a set of selected terms onto the ids 0, 1, ... in increasing order
+ * of term id, dropping every other term, so that a model over the
+ * selected terms needs only as many weights as there are of them.
+ */
+class feature_projection
+{
+  public:
+    /**
+     * @param features The selected terms, sorted by term id
+     * @param num_terms The number of terms in the index
+     */
+    feature_projection(const std::vector<term_id>& features,
+                       uint64_t num_terms);
+
+    /**
+     * @return the number of selected terms
+     */
+    uint64_t size() const;
+
+    /**
+     * @param term A term
+     * @return the projected id of the term, or size() if it is not one of
+     * the selected terms
+     */
+    uint64_t operator()(term_id term) const;
+
+    /**
+     * @param counts A document's (term id, count) pairs
+     * @return the pairs of the selected terms, with their projected ids
+     */
+    std::vector<std::pair<term_id, double>>
+        project(const std::vector<std::pair<term_id, double>>& counts) const;
+
+    /**
+     * @param matrix Documents' (term id, count) pairs
+     * @return the pairs of the selected terms, with their projected ids
+     */
+    index::csr_matrix project(const index::csr_matrix& matrix) const;
+
+  private:
+    /// The number of selected terms
+    uint64_t size_;
+
+    /// The projected id of each term of the index, or size_
+    std::vector<uint32_t> ids_;
+};
+}
+}
+
+#endif
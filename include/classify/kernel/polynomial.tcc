@@ -6,6 +6,7 @@
 #include <cmath>
 
 #include "classify/kernel/polynomial.h"
+#include "util/sparse_ops.h"
 
 namespace meta
 {
@@ -18,9 +19,7 @@ template <class PostingsData>
 double polynomial::operator()(const PostingsData& first,
                               const PostingsData& second) const
 {
-    double dot = c_;
-    for (const auto& w : first->counts())
-        dot += w.second * second->count(w.first);
+    auto dot = c_ + util::sparse::dot(first->counts(), second->counts());
     return std::pow(dot, power_);
 }
 }
@@ -4,9 +4,9 @@
  */
 
 #include <cmath>
-#include <unordered_set>
 
 #include "classify/kernel/radial_basis.h"
+#include "util/sparse_ops.h"
 
 namespace meta
 {
@@ -19,17 +19,8 @@ template <class PostingsData>
 double radial_basis::operator()(const PostingsData& first,
                                 const PostingsData& second) const
 {
-    double dist = 0;
-    std::unordered_set<term_id> keyspace;
-    for (const auto& p : first->counts())
-        keyspace.insert(p.first);
-    for (const auto& p : second->counts())
-        keyspace.insert(p.first);
-    for (const auto& t_id : keyspace)
-    {
-        auto delta = first->count(t_id) - second->count(t_id);
-        dist += delta * delta;
-    }
+    auto dist
+        = util::sparse::squared_distance(first->counts(), second->counts());
     return std::exp(gamma_ * dist);
 }
 }
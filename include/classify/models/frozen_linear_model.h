@@ -0,0 +1,306 @@
+/**
+ * @file frozen_linear_model.h
+ *
+ * All files in META are released under the MIT license. For more details,
+ * consult the file LICENSE in the root of the project.
+ */
+
+#ifndef META_CLASSIFY_MODEL_FROZEN_LINEAR_MODEL_H_
+#define META_CLASSIFY_MODEL_FROZEN_LINEAR_MODEL_H_
+
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include "classify/models/linear_model.h"
+#include "io/mmap_file.h"
+#include "meta.h"
+#include "util/sparse_vector.h"
+
+namespace meta
+{
+namespace classify
+{
+
+/**
+ * A read-only multiclass linear model, stored in a file that is memory
+ * mapped rather than read, so that loading it takes no time and no memory
+ * beyond the pages that are used, and several processes loading the same
+ * file share one copy of it.
+ *
+ * The features are sorted and their weights stored contiguously, as in a
+ * compressed sparse row matrix with one row per feature; a weight is a
+ * float, or, in a quantized model, a byte scaled by a factor per feature.
+ * A frozen_linear_model is created from a trained linear_model with
+ * save(), and scores feature vectors exactly as the linear_model does,
+ * apart from the precision of its weights.
+ */
+template <class FeatureId, class ClassId>
+class frozen_linear_model
+{
+  public:
+    /**
+     * The identifier for features.
+     */
+    using feature_id = FeatureId;
+
+    /**
+     * The value type for weights and scores.
+     */
+    using feature_value = float;
+
+    /**
+     * The ids for the classes.
+     */
+    using class_id = ClassId;
+
+    /**
+     * A class_id with an associated score.
+     */
+    using scored_class = std::pair<class_id, feature_value>;
+
+    /**
+     * A vector of class ids and associated scores.
+     */
+    using scored_classes = std::vector<scored_class>;
+
+    /**
+     * The exception thrown during interactions with frozen_linear_models.
+     */
+    using exception = linear_model_exception;
+
+    /**
+     * Writes a linear model to a file in the frozen format.
+     *
+     * @param model The model to write
+     * @param filename The file to write to
+     * @param quantize Whether to store each weight in a single byte
+     * rather than as a float
+     */
+    template <class FeatureValue>
+    static void
+        save(const linear_model<FeatureId, FeatureValue, ClassId>& model,
+             const std::string& filename, bool quantize = false);
+
+    /**
+     * Maps a model written by save() into memory.
+     *
+     * @param filename The file to load the model from
+     */
+    frozen_linear_model(const std::string& filename);
+
+    /**
+     * Determines the highest scoring class that satisfies a filter
+     * predicate for a given feature vector. Any class id that does not
+     * return true when passed to the filter will not be considered. If no
+     * classes satisfy the filter predicate, the default class id will be
+     * returned.
+     *
+     * @param features The feature vector to score
+     * @param filter The filter predicate to use
+     * @return the highest scoring class that passes the filter predicate
+     */
+    template <class FeatureVector, class Filter>
+    class_id best_class(FeatureVector&& features, Filter&& filter) const;
+
+    /**
+     * Determines the highest scoring class for a given feature vector.
+     *
+     * @param features The feature vector to score
+     * @return the highest scoring class
+     */
+    template <class FeatureVector>
+    class_id best_class(FeatureVector&& features) const;
+
+    /**
+     * Determines the top \f$k\f$ classes for a given feature vector that
+     * satisfy the filter predicate. Any class id that does not return true
+     * when passed to the filter will not be considered. If no classes
+     * satisfy the filter predicate, the returned vector will be empty.
+     *
+     * @param features The feature vector to score
+     * @param num The number of classes to return (\f$k\f$)
+     * @param filter The filter predicate
+     * @return a vector of (up to) \f$k\f$ scored classes sorted by score
+     */
+    template <class FeatureVector, class Filter>
+    scored_classes best_classes(FeatureVector&& features, uint64_t num,
+                                Filter&& filter) const;
+
+    /**
+     * Determines the top \f$k\f$ classes for a given feature vector.
+     *
+     * @param features The feature vector to score
+     * @param num The number of classes to return (\f$k\f$)
+     * @return a vector of (up to) \f$k\f$ scored classes sorted by score
+     */
+    template <class FeatureVector>
+    scored_classes best_classes(FeatureVector&& features, uint64_t num) const;
+
+    /**
+     * Adds the weights of this model to a linear_model, which can
+     * then be trained further or saved.
+     *
+     * @param model The model to add the weights to
+     */
+    template <class FeatureValue>
+    void thaw(linear_model<FeatureId, FeatureValue, ClassId>& model) const;
+
+    /**
+     * @return the number of features with a nonzero weight
+     */
+    uint64_t num_features() const;
+
+    /**
+     * @return whether the weights are quantized to single bytes
+     */
+    bool quantized() const;
+
+    /**
+     * @return the memory used by the mapped model file
+     */
+    util::memory_report memory_usage() const;
+
+  private:
+    /// The first eight bytes of a frozen model file
+    static constexpr uint64_t magic = 0x4c444f4d4e5a5246; // "FRZNMODL"
+
+    /// Whether the features are strings, which are stored separately
+    using string_features = std::is_same<FeatureId, std::string>;
+
+    /**
+     * @param features The feature vector to score
+     * @return the score of each class with a weight for any of the
+     * features
+     */
+    template <class FeatureVector>
+    util::sparse_vector<class_id, feature_value>
+        scores(FeatureVector&& features) const;
+
+    /**
+     * @param feature A feature
+     * @return the position of the feature in the model, or num_features()
+     * if it has no weights
+     */
+    uint64_t find(const feature_id& feature) const;
+
+    /**
+     * @param pos A position in the model
+     * @param i The index of one of the weights of the feature there
+     * @return the weight
+     */
+    feature_value weight(uint64_t pos, uint64_t i) const;
+
+    /**
+     * @param pos A position in the model
+     * @return the feature at that position
+     */
+    feature_id feature(uint64_t pos, std::true_type) const;
+
+    /**
+     * @param pos A position in the model
+     * @return the feature at that position
+     */
+    feature_id feature(uint64_t pos, std::false_type) const;
+
+    /**
+     * @param pos A position in the model
+     * @param feature A feature
+     * @return a negative number, zero, or a positive number if the feature
+     * at the position sorts before, with, or after the given one
+     */
+    int compare(uint64_t pos, const feature_id& feature,
+                std::true_type) const;
+
+    /**
+     * @param pos A position in the model
+     * @param feature A feature
+     * @return a negative number, zero, or a positive number if the feature
+     * at the position sorts before, with, or after the given one
+     */
+    int compare(uint64_t pos, const feature_id& feature,
+                std::false_type) const;
+
+    /**
+     * Writes the sorted features of a model.
+     */
+    static void write_features(std::ostream& os,
+                               const std::vector<feature_id>& features,
+                               std::true_type);
+
+    /**
+     * Writes the sorted features of a model.
+     */
+    static void write_features(std::ostream& os,
+                               const std::vector<feature_id>& features,
+                               std::false_type);
+
+    /**
+     * Points the feature arrays into the mapped file.
+     * @param pos The offset of the features in the file
+     * @return the offset just past the features
+     */
+    uint64_t map_features(uint64_t pos, std::true_type);
+
+    /**
+     * Points the feature arrays into the mapped file.
+     * @param pos The offset of the features in the file
+     * @return the offset just past the features
+     */
+    uint64_t map_features(uint64_t pos, std::false_type);
+
+    /**
+     * Points an array into the mapped file.
+     * @param pos The offset of the array in the file, advanced past it to
+     * the next eight-byte boundary
+     * @param count The number of elements in the array
+     * @return the array
+     */
+    template <class T>
+    const T* map_array(uint64_t& pos, uint64_t count) const;
+
+    /**
+     * Pads a file being written to the next eight-byte boundary.
+     * @param os The stream being written to
+     * @param bytes The number of bytes written since the last boundary
+     */
+    static void pad(std::ostream& os, uint64_t bytes);
+
+    /// The mapped model file
+    io::mmap_file file_;
+
+    /// The number of features
+    uint64_t num_features_;
+
+    /// Whether the weights are quantized
+    bool quantized_;
+
+    /// The sorted features, if they are not strings
+    const feature_id* features_ = nullptr;
+
+    /// Where each string feature starts in feature_chars_
+    const uint64_t* feature_offsets_ = nullptr;
+
+    /// The characters of the sorted string features
+    const char* feature_chars_ = nullptr;
+
+    /// Where the weights of each feature start
+    const uint64_t* offsets_;
+
+    /// The class of each weight
+    const class_id* classes_;
+
+    /// The weights, if they are not quantized
+    const float* weights_ = nullptr;
+
+    /// The quantized weights
+    const int8_t* quantized_weights_ = nullptr;
+
+    /// The factor each quantized weight of a feature is multiplied by
+    const float* scales_ = nullptr;
+};
+}
+}
+
+#include "classify/models/frozen_linear_model.tcc"
+#endif
@@ -0,0 +1,414 @@
+/**
+ * @file frozen_linear_model.tcc
+ *
+ * All files in META are released under the MIT license. For more details,
+ * consult the file LICENSE in the root of the project.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+
+#include "classify/models/frozen_linear_model.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace classify
+{
+
+// The file is a header of four uint64_ts---a magic number, whether the
+// weights are quantized, the number of features, and the number of
+// weights---followed by arrays, each starting on an eight-byte boundary:
+// the sorted features, the offset of each feature's first weight (and the
+// total number of weights), the class of each weight, and either the
+// weights or the scale of each feature and the quantized weights. String
+// features are stored as the offset of each string's first character (and
+// the total number of characters) followed by the characters.
+
+template <class FeatureId, class ClassId>
+template <class FeatureValue>
+void frozen_linear_model<FeatureId, ClassId>::save(
+    const linear_model<FeatureId, FeatureValue, ClassId>& model,
+    const std::string& filename, bool quantize /* = false */)
+{
+    std::vector<feature_id> features;
+    features.reserve(model.weights().size());
+    for (const auto& feat_vec : model.weights())
+        features.push_back(feat_vec.first);
+    std::sort(features.begin(), features.end());
+
+    std::vector<uint64_t> offsets{0};
+    offsets.reserve(features.size() + 1);
+    std::vector<class_id> classes;
+    std::vector<float> weights;
+    for (const auto& feat : features)
+    {
+        for (const auto& weight : model.weights().at(feat))
+        {
+            classes.push_back(weight.first);
+            weights.push_back(static_cast<float>(weight.second));
+        }
+        offsets.push_back(classes.size());
+    }
+
+    // each feature's weights are scaled so that the largest in magnitude
+    // is stored as +/-127
+    std::vector<float> scales;
+    std::vector<int8_t> quantized;
+    if (quantize)
+    {
+        scales.resize(features.size(), 0.0f);
+        quantized.resize(weights.size(), 0);
+        for (uint64_t f = 0; f < features.size(); ++f)
+        {
+            for (auto i = offsets[f]; i < offsets[f + 1]; ++i)
+                scales[f] = std::max(scales[f], std::abs(weights[i]));
+            scales[f] /= 127;
+            if (scales[f] == 0)
+                continue;
+            for (auto i = offsets[f]; i < offsets[f + 1]; ++i)
+                quantized[i] = static_cast<int8_t>(std::max(
+                    -127.0f,
+                    std::min(127.0f, std::round(weights[i] / scales[f]))));
+        }
+    }
+
+    // the model is written beside the file and then renamed over it, so
+    // that a model mapped from the file is not overwritten while in use
+    auto tmp_name = filename + ".tmp";
+    {
+        std::ofstream os{tmp_name, std::ios::binary};
+        if (!os)
+            throw exception{"could not write frozen model to " + filename};
+        uint64_t header[]
+            = {magic, quantize, features.size(), classes.size()};
+        os.write(reinterpret_cast<const char*>(header), sizeof(header));
+        write_features(os, features, string_features{});
+
+        os.write(reinterpret_cast<const char*>(offsets.data()),
+                 offsets.size() * sizeof(uint64_t));
+        os.write(reinterpret_cast<const char*>(classes.data()),
+                 classes.size() * sizeof(class_id));
+        pad(os, classes.size() * sizeof(class_id));
+
+        if (quantize)
+        {
+            os.write(reinterpret_cast<const char*>(scales.data()),
+                     scales.size() * sizeof(float));
+            pad(os, scales.size() * sizeof(float));
+            os.write(reinterpret_cast<const char*>(quantized.data()),
+                     quantized.size());
+            pad(os, quantized.size());
+        }
+        else
+        {
+            os.write(reinterpret_cast<const char*>(weights.data()),
+                     weights.size() * sizeof(float));
+            pad(os, weights.size() * sizeof(float));
+        }
+    }
+    filesystem::rename_file(tmp_name, filename);
+}
+
+template <class FeatureId, class ClassId>
+void frozen_linear_model<FeatureId, ClassId>::write_features(
+    std::ostream& os, const std::vector<feature_id>& features,
+    std::true_type)
+{
+    uint64_t offset = 0;
+    os.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    for (const auto& feat : features)
+    {
+        offset += feat.size();
+        os.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    }
+    for (const auto& feat : features)
+        os.write(feat.data(), feat.size());
+    pad(os, offset);
+}
+
+template <class FeatureId, class ClassId>
+void frozen_linear_model<FeatureId, ClassId>::write_features(
+    std::ostream& os, const std::vector<feature_id>& features,
+    std::false_type)
+{
+    os.write(reinterpret_cast<const char*>(features.data()),
+             features.size() * sizeof(feature_id));
+    pad(os, features.size() * sizeof(feature_id));
+}
+
+template <class FeatureId, class ClassId>
+void frozen_linear_model<FeatureId, ClassId>::pad(std::ostream& os,
+                                                  uint64_t bytes)
+{
+    static const char zeros[8] = {};
+    os.write(zeros, (8 - bytes % 8) % 8);
+}
+
+template <class FeatureId, class ClassId>
+frozen_linear_model<FeatureId, ClassId>::frozen_linear_model(
+    const std::string& filename)
+    : file_{filename}
+{
+    uint64_t pos = 0;
+    auto header = map_array<uint64_t>(pos, 4);
+    if (header[0] != magic)
+        throw exception{filename + " is not a frozen model"};
+    quantized_ = header[1] != 0;
+    num_features_ = header[2];
+    auto num_weights = header[3];
+
+    pos = map_features(pos, string_features{});
+    offsets_ = map_array<uint64_t>(pos, num_features_ + 1);
+    if (offsets_[num_features_] != num_weights)
+        throw exception{"malformed frozen model file " + filename};
+    classes_ = map_array<class_id>(pos, num_weights);
+    if (quantized_)
+    {
+        scales_ = map_array<float>(pos, num_features_);
+        quantized_weights_ = map_array<int8_t>(pos, num_weights);
+    }
+    else
+    {
+        weights_ = map_array<float>(pos, num_weights);
+    }
+}
+
+template <class FeatureId, class ClassId>
+uint64_t frozen_linear_model<FeatureId, ClassId>::map_features(uint64_t pos,
+                                                               std::true_type)
+{
+    feature_offsets_ = map_array<uint64_t>(pos, num_features_ + 1);
+    feature_chars_ = map_array<char>(pos, feature_offsets_[num_features_]);
+    return pos;
+}
+
+template <class FeatureId, class ClassId>
+uint64_t frozen_linear_model<FeatureId, ClassId>::map_features(uint64_t pos,
+                                                               std::false_type)
+{
+    features_ = map_array<feature_id>(pos, num_features_);
+    return pos;
+}
+
+template <class FeatureId, class ClassId>
+template <class T>
+const T* frozen_linear_model<FeatureId, ClassId>::map_array(
+    uint64_t& pos, uint64_t count) const
+{
+    auto bytes = count * sizeof(T);
+    if (pos + bytes > file_.size())
+        throw exception{"malformed frozen model file " + file_.path()};
+    auto array = reinterpret_cast<const T*>(file_.begin() + pos);
+    pos += bytes + (8 - bytes % 8) % 8;
+    return array;
+}
+
+template <class FeatureId, class ClassId>
+auto frozen_linear_model<FeatureId, ClassId>::weight(uint64_t pos,
+                                                     uint64_t i) const
+    -> feature_value
+{
+    if (quantized_)
+        return quantized_weights_[i] * scales_[pos];
+    return weights_[i];
+}
+
+template <class FeatureId, class ClassId>
+auto frozen_linear_model<FeatureId, ClassId>::feature(
+    uint64_t pos, std::true_type) const -> feature_id
+{
+    return {feature_chars_ + feature_offsets_[pos],
+            feature_offsets_[pos + 1] - feature_offsets_[pos]};
+}
+
+template <class FeatureId, class ClassId>
+auto frozen_linear_model<FeatureId, ClassId>::feature(
+    uint64_t pos, std::false_type) const -> feature_id
+{
+    return features_[pos];
+}
+
+template <class FeatureId, class ClassId>
+int frozen_linear_model<FeatureId, ClassId>::compare(
+    uint64_t pos, const feature_id& feature, std::true_type) const
+{
+    auto start = feature_offsets_[pos];
+    auto length = feature_offsets_[pos + 1] - start;
+    auto cmp = std::char_traits<char>::compare(
+        feature_chars_ + start, feature.data(),
+        std::min<uint64_t>(length, feature.size()));
+    if (cmp != 0)
+        return cmp;
+    if (length == feature.size())
+        return 0;
+    return length < feature.size() ? -1 : 1;
+}
+
+template <class FeatureId, class ClassId>
+int frozen_linear_model<FeatureId, ClassId>::compare(
+    uint64_t pos, const feature_id& feature, std::false_type) const
+{
+    if (features_[pos] < feature)
+        return -1;
+    return feature < features_[pos] ? 1 : 0;
+}
+
+template <class FeatureId, class ClassId>
+uint64_t frozen_linear_model<FeatureId, ClassId>::find(
+    const feature_id& feature) const
+{
+    uint64_t first = 0;
+    uint64_t last = num_features_;
+    while (first < last)
+    {
+        auto mid = first + (last - first) / 2;
+        auto cmp = compare(mid, feature, string_features{});
+        if (cmp == 0)
+            return mid;
+        if (cmp < 0)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+    return num_features_;
+}
+
+template <class FeatureId, class ClassId>
+template <class FeatureVector>
+auto frozen_linear_model<FeatureId, ClassId>::scores(
+    FeatureVector&& features) const
+    -> util::sparse_vector<class_id, feature_value>
+{
+    util::sparse_vector<class_id, feature_value> class_scores;
+    for (const auto& feat : features)
+    {
+        auto pos = find(feat.first);
+        if (pos == num_features_)
+            continue;
+
+        auto val = feat.second;
+        for (auto i = offsets_[pos]; i < offsets_[pos + 1]; ++i)
+            class_scores[classes_[i]] += val * weight(pos, i);
+    }
+    return class_scores;
+}
+
+template <class FeatureId, class ClassId>
+template <class FeatureVector, class Filter>
+auto frozen_linear_model<FeatureId, ClassId>::best_class(
+    FeatureVector&& features, Filter&& filter) const -> class_id
+{
+    auto class_scores = scores(std::forward<FeatureVector>(features));
+
+    auto best_score = std::numeric_limits<feature_value>::lowest();
+    class_id best_class{};
+    for (const auto& score : class_scores)
+    {
+        auto cid = score.first;
+        if (score.second > best_score && filter(cid))
+        {
+            best_class = score.first;
+            best_score = score.second;
+        }
+    }
+
+    return best_class;
+}
+
+template <class FeatureId, class ClassId>
+template <class FeatureVector>
+auto frozen_linear_model<FeatureId, ClassId>::best_class(
+    FeatureVector&& features) const -> class_id
+{
+    return best_class(std::forward<FeatureVector>(features), [](const class_id&)
+                      {
+        return true;
+    });
+}
+
+template <class FeatureId, class ClassId>
+template <class FeatureVector, class Filter>
+auto frozen_linear_model<FeatureId, ClassId>::best_classes(
+    FeatureVector&& features, uint64_t num,
+    Filter&& filter) const -> scored_classes
+{
+    auto class_scores = scores(std::forward<FeatureVector>(features));
+
+    auto comp = [](const scored_class& lhs, const scored_class& rhs)
+    {
+        return lhs.second > rhs.second;
+    };
+
+    std::vector<scored_class> result;
+    for (const auto& score : class_scores)
+    {
+        auto cid = score.first;
+        if (filter(cid))
+            result.push_back(score);
+    }
+
+    std::make_heap(result.begin(), result.end(), comp);
+    while (result.size() > num)
+    {
+        std::pop_heap(result.begin(), result.end(), comp);
+        result.pop_back();
+    }
+
+    std::sort(result.begin(), result.end(),
+              [](const scored_class& lhs, const scored_class& rhs)
+              {
+        return lhs.second < rhs.second;
+    });
+    return result;
+}
+
+template <class FeatureId, class ClassId>
+template <class FeatureVector>
+auto frozen_linear_model<FeatureId, ClassId>::best_classes(
+    FeatureVector&& features, uint64_t num) const -> scored_classes
+{
+    return best_classes(std::forward<FeatureVector>(features), num,
+                        [](const class_id&)
+                        {
+        return true;
+    });
+}
+
+template <class FeatureId, class ClassId>
+template <class FeatureValue>
+void frozen_linear_model<FeatureId, ClassId>::thaw(
+    linear_model<FeatureId, FeatureValue, ClassId>& model) const
+{
+    for (uint64_t pos = 0; pos < num_features_; ++pos)
+    {
+        auto feat = feature(pos, string_features{});
+        for (auto i = offsets_[pos]; i < offsets_[pos + 1]; ++i)
+            model.update(classes_[i], feat, weight(pos, i));
+    }
+}
+
+template <class FeatureId, class ClassId>
+uint64_t frozen_linear_model<FeatureId, ClassId>::num_features() const
+{
+    return num_features_;
+}
+
+template <class FeatureId, class ClassId>
+bool frozen_linear_model<FeatureId, ClassId>::quantized() const
+{
+    return quantized_;
+}
+
+template <class FeatureId, class ClassId>
+util::memory_report
+    frozen_linear_model<FeatureId, ClassId>::memory_usage() const
+{
+    util::memory_report report;
+    report.add("weights", file_.memory_usage());
+    return report;
+}
+}
+}
@@ -14,6 +14,7 @@
 #include <unordered_map>
 
 #include "meta.h"
+#include "util/memory_usage.h"
 #include "util/sparse_vector.h"
 
 namespace meta
@@ -178,6 +179,12 @@ class linear_model
      */
     const weight_vectors& weights() const;
 
+    /**
+     * @return the memory used by the weights, estimated from the nodes
+     * and buckets of the map and the capacity of each weight vector
+     */
+    util::memory_report memory_usage() const;
+
   private:
     /**
      * The weights for the model
@@ -245,5 +245,23 @@ auto linear_model<FeatureId, FeatureValue, ClassId>::weights() const -> const
 {
     return weights_;
 }
+
+template <class FeatureId, class FeatureValue, class ClassId>
+util::memory_report
+    linear_model<FeatureId, FeatureValue, ClassId>::memory_usage() const
+{
+    // each node of the map holds its pair and a link to the next node
+    util::memory_usage usage;
+    usage.heap_bytes = weights_.bucket_count() * sizeof(void*);
+    for (const auto& pair : weights_)
+    {
+        usage.heap_bytes += sizeof(pair) + sizeof(void*);
+        usage += util::heap_memory(pair.second.contents());
+    }
+
+    util::memory_report report;
+    report.add("weights", usage);
+    return report;
+}
 }
 }
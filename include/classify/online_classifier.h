@@ -0,0 +1,185 @@
+/**
+ * @file online_classifier.h
+ *
+ * All files in META are released under the MIT license. For more details,
+ * consult the file LICENSE in the root of the project.
+ */
+
+#ifndef META_CLASSIFY_ONLINE_CLASSIFIER_H_
+#define META_CLASSIFY_ONLINE_CLASSIFIER_H_
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "classify/loss/loss_function.h"
+#include "meta.h"
+
+namespace cpptoml
+{
+class table;
+}
+
+namespace meta
+{
+namespace classify
+{
+
+/**
+ * A multiclass linear classifier that learns from a stream of labeled
+ * feature vectors, one at a time, rather than from the documents of an
+ * index, and that can classify from other threads while it learns.
+ *
+ * Every class has a binary linear model, trained against all the other
+ * classes by stochastic gradient descent with L2 regularization, as in
+ * one_vs_all over sgd; classes are added as they first appear in the
+ * stream. Training updates a private copy of the weights, and classify()
+ * reads an immutable snapshot of them, which is replaced every so many
+ * updates (or by publish()), so predictions never wait for training and
+ * never see a half-applied update.
+ */
+class online_classifier
+{
+  public:
+    /// A sparse feature vector of (feature id, value) pairs.
+    using feature_vector = std::vector<std::pair<term_id, double>>;
+
+    /// The default learning rate.
+    const static constexpr double default_alpha = 0.001;
+    /// The default regularization constant.
+    const static constexpr double default_lambda = 0.0001;
+    /// The default number of updates between snapshots.
+    const static constexpr uint64_t default_snapshot_interval = 1000;
+
+    /**
+     * @param loss The loss function of the binary models
+     * @param alpha The learning rate
+     * @param lambda The L2 regularization constant
+     * @param snapshot_interval The number of updates after which the
+     *  weights are published to classify(); 0 publishes only on publish()
+     */
+    online_classifier(std::unique_ptr<loss::loss_function> loss,
+                      double alpha = default_alpha,
+                      double lambda = default_lambda,
+                      uint64_t snapshot_interval
+                      = default_snapshot_interval);
+
+    /**
+     * Updates the model with one labeled feature vector. Calls from
+     * several threads are serialized.
+     *
+     * @param features The feature vector
+     * @param label Its class
+     */
+    void train(const feature_vector& features, const class_label& label);
+
+    /**
+     * Classifies a feature vector with the last published weights; safe
+     * to call from any number of threads, concurrently with train().
+     *
+     * @param features The feature vector
+     * @return the class with the highest score, or an empty label if
+     *  nothing has been published yet
+     */
+    class_label classify(const feature_vector& features) const;
+
+    /**
+     * Makes every update so far visible to classify().
+     */
+    void publish();
+
+    /**
+     * @return the number of updates so far
+     */
+    uint64_t num_updates() const;
+
+    /**
+     * Basic exception for online_classifier interactions.
+     */
+    class online_classifier_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /**
+     * The weights of the binary models of all the classes.
+     */
+    struct model
+    {
+        /// The classes, in order of appearance.
+        std::vector<class_label> classes;
+
+        /// The position of each class in classes.
+        std::unordered_map<class_label, uint64_t> class_ids;
+
+        /// The weights of each feature, one per class; a feature's vector
+        /// may be shorter than the number of classes, the missing weights
+        /// being 0.
+        std::unordered_map<term_id, std::vector<double>> weights;
+
+        /// The bias of each class.
+        std::vector<double> bias;
+
+        /// The scalar coefficient of all the weights and biases.
+        double coeff = 1.0;
+
+        /**
+         * @param features A feature vector
+         * @return the score of each class, with the coefficient applied
+         */
+        std::vector<double> scores(const feature_vector& features) const;
+    };
+
+    /// The loss function of the binary models.
+    std::unique_ptr<loss::loss_function> loss_;
+
+    /// The learning rate.
+    const double alpha_;
+
+    /// The L2 regularization constant.
+    const double lambda_;
+
+    /// The number of updates between snapshots.
+    const uint64_t snapshot_interval_;
+
+    /// Serializes training and publishing.
+    mutable std::mutex mutex_;
+
+    /// The weights being trained.
+    model model_;
+
+    /// The number of updates so far.
+    uint64_t num_updates_ = 0;
+
+    /// The last published weights.
+    std::shared_ptr<const model> snapshot_;
+
+#if !META_HAS_STD_SHARED_PTR_ATOMICS
+    /// Guards snapshot_ where shared_ptrs have no atomic operations.
+    mutable std::mutex snapshot_mutex_;
+#endif
+
+    /**
+     * Publishes the weights; the mutex must be held.
+     */
+    void publish_locked();
+};
+
+/**
+ * Creates an online_classifier from the "loss", "alpha", "lambda", and
+ * "snapshot-interval" keys of a configuration group; the loss defaults to
+ * the hinge loss.
+ *
+ * @param config The configuration group
+ * @return the online_classifier
+ */
+std::unique_ptr<online_classifier>
+    make_online_classifier(const cpptoml::table& config);
+}
+}
+#endif
@@ -1,6 +1,7 @@
 #include "corpus.h"
 #include "file_corpus.h"
 #include "line_corpus.h"
+#include "tokenized_corpus.h"
 #if META_HAS_ZLIB
 #include "gz_corpus.h"
 #endif
@@ -0,0 +1,107 @@
+/**
+ * @file batch_reader.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_CORPUS_BATCH_READER_H_
+#define META_CORPUS_BATCH_READER_H_
+
+#include <exception>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "corpus/corpus.h"
+#include "parallel/bounded_queue.h"
+#include "parallel/stage_counter.h"
+#include "util/progress.h"
+
+namespace meta
+{
+namespace corpus
+{
+
+/**
+ * Reads the documents of a corpus on a thread of its own and hands them
+ * out in batches, so that the threads processing them do not have to
+ * take turns reading one document at a time. Finished batches wait in a
+ * bounded queue, which limits how far reading can get ahead of the
+ * consumers.
+ */
+class batch_reader
+{
+  public:
+    /**
+     * Starts reading the corpus.
+     * @param docs The corpus to read; it must outlive the batch_reader
+     * @param progress_prefix The prefix of the progress bar for reading
+     * @param batch_size The number of documents in each batch
+     * @param max_batches The number of batches that may wait to be taken
+     */
+    batch_reader(corpus& docs, const std::string& progress_prefix,
+                 uint64_t batch_size = 256, uint64_t max_batches = 64);
+
+    /**
+     * Stops reading the corpus and waits for the reading thread to exit.
+     */
+    ~batch_reader();
+
+    /**
+     * Takes the next batch of documents, waiting for one if necessary.
+     * This may be called from any number of threads at once.
+     * @param batch Where to store the documents
+     * @return false once every document has been handed out
+     */
+    bool next(std::vector<document>& batch);
+
+    /**
+     * @return the throughput counters for reading: the time spent reading
+     * documents and the time spent waiting for the consumers to make room
+     * in the queue
+     */
+    const parallel::stage_counter& counter() const;
+
+    /**
+     * Basic exception for batch_reader interactions.
+     */
+    class batch_reader_exception : public corpus::corpus_exception
+    {
+      public:
+        using corpus::corpus_exception::corpus_exception;
+    };
+
+  private:
+    /**
+     * Reads the corpus into batches until it is exhausted or the queue is
+     * closed.
+     */
+    void read();
+
+    /// the corpus being read
+    corpus& docs_;
+
+    /// the number of documents in each batch
+    const uint64_t batch_size_;
+
+    /// the batches that are ready to be taken
+    parallel::bounded_queue<std::vector<document>> queue_;
+
+    /// the throughput counters for reading
+    parallel::stage_counter counter_;
+
+    /// the progress bar for reading
+    printing::progress progress_;
+
+    /// an exception thrown while reading, rethrown by next()
+    std::exception_ptr error_;
+
+    /// the thread reading the corpus
+    std::thread reader_;
+};
+}
+}
+
+#endif
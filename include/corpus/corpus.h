@@ -10,12 +10,18 @@
 #ifndef META_CORPUS_H_
 #define META_CORPUS_H_
 
+#include <fstream>
 #include <stdexcept>
 #include <memory>
 
 #include "meta.h"
 #include "corpus/document.h"
 
+namespace cpptoml
+{
+class table;
+}
+
 namespace meta
 {
 namespace corpus
@@ -58,6 +64,14 @@ class corpus
      */
     const std::string& encoding() const;
 
+    /**
+     * Reads the typed fields of the documents from a file alongside the
+     * corpus: line i holds the tab-separated field values of document i.
+     * @param path The file to read the fields from
+     * @param num_fields The number of values on each line
+     */
+    void fields_file(const std::string& path, uint64_t num_fields);
+
     /**
      * @param config_file The cpptoml config file containing what type of
      * corpus to load
@@ -74,9 +88,30 @@ class corpus
         using std::runtime_error::runtime_error;
     };
 
+  protected:
+    /**
+     * Sets the field values of a document from the next line of the fields
+     * file, if there is one. Corpora call this on each document they
+     * return.
+     * @param doc The document
+     */
+    void read_fields(document& doc);
+
   private:
+    /**
+     * @param config The configuration naming the corpus to create
+     * @return the corpus, without its fields
+     */
+    static std::unique_ptr<corpus> make_corpus(const cpptoml::table& config);
+
     /// The type of encoding this document uses
     std::string encoding_;
+
+    /// The file the documents' fields are read from, if any
+    std::unique_ptr<std::ifstream> fields_;
+
+    /// The number of fields on each line of fields_
+    uint64_t num_fields_ = 0;
 };
 }
 }
@@ -12,9 +12,13 @@
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 
+#include "corpus/feature_vocabulary.h"
 #include "meta.h"
+#include "util/arena.h"
 #include "util/optional.h"
+#include "util/sparse_vector.h"
 
 namespace meta
 {
@@ -27,10 +31,24 @@ namespace corpus
  *
  * Once tokenized, a document contains a mapping of term -> frequency. This
  * mapping is empty upon creation.
+ *
+ * A document may instead be given a shared feature_vocabulary, in which
+ * case the terms it is incremented with are interned in the vocabulary
+ * and counted by feature id in features(), and counts() stays empty.
  */
 class document
 {
   public:
+    /// The sparse vector of (feature id, count) pairs of a document
+    using feature_vector
+        = util::sparse_vector<feature_vocabulary::feature_id, double>;
+
+    /// The map of a document's term counts, which may live in an arena
+    using count_map = std::unordered_map<
+        std::string, double, std::hash<std::string>,
+        std::equal_to<std::string>,
+        util::arena_allocator<std::pair<const std::string, double>>>;
+
     /**
      * Constructor.
      * @param path The path to the document
@@ -47,6 +65,27 @@ class document
      */
     void increment(const std::string& term, double amount);
 
+    /**
+     * Increment the count of a feature of the document's vocabulary.
+     * @param id The feature id of the term whose count to increment
+     * @param amount The amount to increment by
+     */
+    void increment(feature_vocabulary::feature_id id, double amount);
+
+    /**
+     * Makes the document count the terms it is incremented with from now
+     * on by their feature ids in a vocabulary, or by their text again.
+     * @param vocab The vocabulary, which must outlive the document's use
+     * of it, or nullptr
+     */
+    void vocabulary(feature_vocabulary* vocab);
+
+    /**
+     * @return the vocabulary the document's features are interned in, or
+     * nullptr if its terms are counted by their text
+     */
+    feature_vocabulary* vocabulary() const;
+
     /**
      * @return the path to this document (the argument to the constructor)
      */
@@ -83,7 +122,30 @@ class document
     /**
      * @return the map of counts for this document.
      */
-    const std::unordered_map<std::string, double>& counts() const;
+    const count_map& counts() const;
+
+    /**
+     * Makes the document allocate its counts from an arena, or from the
+     * heap again; the counts it has already are kept. A document using an
+     * arena must be destroyed before the arena is reset; copies of it use
+     * the heap.
+     * @param a The arena, or nullptr for the heap
+     */
+    void arena(util::arena* a);
+
+    /**
+     * @return the counts of the document's features, sorted by feature id
+     * and with one entry per feature; reading them the first time after
+     * an increment sorts them, so the document must not be read from
+     * several threads at once
+     */
+    const feature_vector& features() const;
+
+    /**
+     * @return the number of unique terms in the document, whether they are
+     * counted by text or by feature id
+     */
+    uint64_t unique_terms() const;
 
     /**
      * Sets the content of the document to be the parameter
@@ -128,6 +190,30 @@ class document
      */
     void label(class_label label);
 
+    /**
+     * @return whether the document's counts were read already tokenized,
+     * from a tokenized_corpus, so that it must not be tokenized again
+     */
+    bool pretokenized() const;
+
+    /**
+     * Marks the document's counts as already tokenized, or not.
+     * @param pretok Whether the counts are already tokenized
+     */
+    void pretokenized(bool pretok);
+
+    /**
+     * @return the values of the document's typed fields, as read from the
+     * corpus, in the order the fields are declared in the configuration
+     */
+    const std::vector<std::string>& fields() const;
+
+    /**
+     * Sets the values of the document's typed fields.
+     * @param values The new values
+     */
+    void fields(std::vector<std::string> values);
+
   private:
     /// Where this document is on disk
     std::string path_;
@@ -145,13 +231,29 @@ class document
     size_t length_;
 
     /// Counts of how many times each token appears
-    std::unordered_map<std::string, double> counts_;
+    count_map counts_;
+
+    /// The vocabulary features are interned in, if any
+    feature_vocabulary* vocab_;
+
+    /// Counts of each feature, in the order they were incremented until
+    /// features() sorts and combines them
+    mutable feature_vector features_;
+
+    /// Whether features_ is sorted with one entry per feature
+    mutable bool condensed_;
 
     /// What the document contains
     util::optional<std::string> content_;
 
     /// The encoding for the content
     std::string encoding_;
+
+    /// The values of the document's typed fields
+    std::vector<std::string> fields_;
+
+    /// Whether the counts were read already tokenized
+    bool pretokenized_;
 };
 }
 }
@@ -0,0 +1,115 @@
+/**
+ * @file feature_vocabulary.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_FEATURE_VOCABULARY_H_
+#define META_FEATURE_VOCABULARY_H_
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace meta
+{
+namespace corpus
+{
+
+/**
+ * A vocabulary shared by any number of documents (and threads) that gives
+ * each term a feature id the first time it is seen, keeping the text of
+ * every term only once.
+ *
+ * Terms are spread over independently locked shards by a hash of their
+ * text, and a term's feature id is its shard plus the number of shards
+ * times its position within the shard, so that ids stay small and nearly
+ * dense. Feature ids depend on the order terms are first seen in, and are
+ * only meaningful within one vocabulary.
+ */
+class feature_vocabulary
+{
+  public:
+    /// The id of an interned term
+    using feature_id = uint64_t;
+
+    /**
+     * Creates an empty vocabulary.
+     * @param num_shards The number of independently locked parts the
+     * vocabulary is split into, which bounds how many threads may intern
+     * terms at once
+     */
+    feature_vocabulary(uint64_t num_shards = 64);
+
+    /**
+     * Finds the feature id of a term, adding the term to the vocabulary
+     * if it has not been seen before. Only a term's first occurrence
+     * copies its text.
+     * @param term The term
+     * @return the term's feature id
+     */
+    feature_id intern(const std::string& term);
+
+    /**
+     * @param id A feature id returned by intern()
+     * @return the text of the term, which stays valid as long as the
+     * vocabulary does
+     */
+    const std::string& term(feature_id id) const;
+
+    /**
+     * @return the number of terms in the vocabulary
+     */
+    uint64_t size() const;
+
+    /**
+     * @return a number larger than every feature id given out so far
+     */
+    uint64_t id_bound() const;
+
+    /**
+     * @return the feature ids of every term in the vocabulary, in sorted
+     * order of the terms' text
+     */
+    std::vector<feature_id> ids_by_term() const;
+
+    /**
+     * Basic exception for feature_vocabulary interactions.
+     */
+    class feature_vocabulary_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /**
+     * The terms whose feature ids are the same modulo the number of
+     * shards.
+     */
+    struct shard
+    {
+        /// Guards ids and terms
+        mutable std::mutex mutex;
+        /// term -> feature id
+        std::unordered_map<std::string, feature_id> ids;
+        /// position within the shard -> term, pointing into ids
+        std::vector<const std::string*> terms;
+    };
+
+    /// The shards of the vocabulary
+    std::vector<shard> shards_;
+
+    /// The number of terms in the vocabulary
+    std::atomic<uint64_t> size_;
+};
+}
+}
+
+#endif
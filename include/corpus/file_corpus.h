@@ -10,10 +10,14 @@
 #ifndef META_FILE_CORPUS_H_
 #define META_FILE_CORPUS_H_
 
+#include <deque>
+#include <future>
+#include <memory>
 #include <string>
 #include <vector>
 #include <utility>
 #include "corpus/corpus.h"
+#include "parallel/thread_pool.h"
 
 namespace meta
 {
@@ -23,6 +27,20 @@ namespace corpus
 /**
  * Creates document objects from individual files, each representing a single
  * document.
+ *
+ * With read-ahead, a pool of I/O threads keeps the files of the next few
+ * documents loaded, and next() returns documents that already hold their
+ * content, so that the threads tokenizing them do not wait on opening and
+ * reading files. A file that cannot be read is left for the analyzer to
+ * open, so that it fails as it would without read-ahead.
+ *
+ * Optional config parameters:
+ *
+ * ~~~toml
+ * corpus-type = "file-corpus"
+ * prefetch = 64   # the number of documents to read ahead; default is 0
+ * io-threads = 8  # the threads that read them; default is 8
+ * ~~~
  */
 class file_corpus : public corpus
 {
@@ -32,9 +50,13 @@ class file_corpus : public corpus
      * @param doc_list A file containing the path to each document in the
      * corpus preceded by a class label (or "[none]")
      * @param encoding The encoding of the corpus
+     * @param prefetch The number of documents to read ahead of next(), or
+     * zero to leave reading each file to the analyzer
+     * @param io_threads The number of threads that read ahead
      */
     file_corpus(const std::string& prefix, const std::string& doc_list,
-                std::string encoding);
+                std::string encoding, uint64_t prefetch = 0,
+                uint64_t io_threads = 8);
 
     /**
      * @return whether there is another document in this corpus
@@ -60,6 +82,24 @@ class file_corpus : public corpus
 
     /// contains doc class labels and paths
     std::vector<std::pair<std::string, class_label>> docs_;
+
+    /**
+     * Starts reading files until the window of documents read ahead is
+     * full or every document has been started.
+     */
+    void fill();
+
+    /// the number of documents to read ahead
+    uint64_t prefetch_;
+
+    /// the index of the next document to start reading
+    uint64_t next_read_;
+
+    /// the threads that read ahead, if there are any
+    std::unique_ptr<parallel::thread_pool> pool_;
+
+    /// the contents of the documents being read, in order from cur_
+    std::deque<std::future<std::string>> pending_;
 };
 }
 }
@@ -10,7 +10,11 @@
 #ifndef META_GZ_CORPUS_H_
 #define META_GZ_CORPUS_H_
 
+#include <memory>
+#include <thread>
+
 #include "corpus/corpus.h"
+#include "io/bgzf.h"
 #include "io/gzstream.h"
 
 namespace meta
@@ -21,6 +25,11 @@ namespace corpus
 /**
  * Fills document objects with content line-by-line from gzip-compressed
  * input files.
+ *
+ * A corpus file written in the blocked gzip format (BGZF) of bgzip or
+ * `corpus-gen --bgzf` is inflated on several threads ahead of the
+ * documents being read; any other gzip file is inflated on the thread that
+ * reads the documents.
  */
 class gz_corpus : public corpus
 {
@@ -29,8 +38,11 @@ class gz_corpus : public corpus
      * @param file The path to the compressed corpus file, where each line
      * represents a document
      * @param encoding The encoding for the file
+     * @param num_threads The number of threads to inflate a BGZF corpus
+     * file with
      */
-    gz_corpus(const std::string& file, std::string encoding);
+    gz_corpus(const std::string& file, std::string encoding,
+              uint64_t num_threads = std::thread::hardware_concurrency());
 
     /**
      * @return whether there is another document in this corpus
@@ -54,8 +66,11 @@ class gz_corpus : public corpus
     /// The number of lines in the file
     uint64_t num_lines_;
 
-    /// The stream for reading the corpus
-    io::gzifstream corpus_stream_;
+    /// The reader of a BGZF corpus file, if it is one
+    std::unique_ptr<io::bgzf_reader> corpus_reader_;
+
+    /// The stream for reading the corpus, if it is not a BGZF file
+    std::unique_ptr<io::gzifstream> corpus_stream_;
 
     /// The stream to read the class labels
     io::gzifstream class_stream_;
@@ -10,9 +10,11 @@
 #ifndef META_LINE_CORPUS_H_
 #define META_LINE_CORPUS_H_
 
+#include <memory>
 #include <string>
 #include <vector>
 #include <utility>
+#include "io/mmap_file.h"
 #include "io/parser.h"
 #include "corpus/corpus.h"
 
@@ -55,7 +57,52 @@ class line_corpus : public corpus
      */
     uint64_t size() const override;
 
+    /**
+     * A run of consecutive documents of a line corpus, located by byte
+     * offsets so that it can be read without reading the documents
+     * before it.
+     */
+    struct partition
+    {
+        /// The id of the first document of the partition
+        doc_id first_id;
+        /// The number of documents in the partition
+        uint64_t num_docs;
+        /// The offset of the first document in the corpus file
+        uint64_t begin;
+        /// The offset past the last document in the corpus file
+        uint64_t end;
+        /// The offset of the first document's label in the labels file
+        uint64_t labels_begin;
+        /// The offset of the first document's name in the names file
+        uint64_t names_begin;
+    };
+
+    /**
+     * Splits the corpus file into byte ranges of about the same size that
+     * each start at the beginning of a line, and finds where each range's
+     * labels and names start in the files alongside the corpus. This reads
+     * through the files once, but does not change what next() returns.
+     * @param num_partitions The number of partitions to split into
+     * @return the partitions, in order; together they hold every document
+     * once, and some may be empty when the lines are long
+     */
+    std::vector<partition> partitions(uint64_t num_partitions) const;
+
+    /**
+     * Opens one partition of this corpus, which reads its documents
+     * independently of this corpus and of any other partition, giving
+     * them the ids they have in this corpus. The fields of the documents,
+     * if any, are not read.
+     * @param part A partition returned by partitions()
+     * @return a corpus of the documents of the partition
+     */
+    std::unique_ptr<corpus> open(const partition& part) const;
+
   private:
+    /// The path to the corpus file
+    std::string file_;
+
     /// The current document we are on
     doc_id cur_id_;
 
@@ -71,6 +118,83 @@ class line_corpus : public corpus
     /// Parser to read the document names
     std::unique_ptr<io::parser> name_parser_;
 };
+
+/**
+ * Reads the documents of one partition of a line corpus.
+ */
+class line_corpus_partition : public corpus
+{
+  public:
+    /**
+     * @param file The path to the corpus file
+     * @param encoding The encoding for the file
+     * @param part The partition to read
+     * @param labels Whether the corpus has a labels file
+     * @param names Whether the corpus has a names file
+     */
+    line_corpus_partition(const std::string& file, std::string encoding,
+                          const line_corpus::partition& part, bool labels,
+                          bool names);
+
+    /**
+     * @return whether there is another document in this partition
+     */
+    bool has_next() const override;
+
+    /**
+     * @return the next document from this partition
+     */
+    document next() override;
+
+    /**
+     * @return the number of documents in this partition
+     */
+    uint64_t size() const override;
+
+  private:
+    /**
+     * A file read a line at a time from an offset.
+     */
+    struct line_reader
+    {
+        /// The mapped file, if it is not empty
+        std::unique_ptr<io::mmap_file> file;
+        /// The offset of the next line
+        uint64_t pos;
+        /// The offset past the last line to read
+        uint64_t end;
+
+        /**
+         * @return the next line, without its newline
+         */
+        std::string next();
+    };
+
+    /**
+     * @param path The file to read
+     * @param begin The offset of the first line to read
+     * @param end The offset past the last line to read, which is capped
+     * at the size of the file
+     * @return a reader of the lines of the file between the offsets
+     */
+    static line_reader make_reader(const std::string& path, uint64_t begin,
+                                   uint64_t end);
+
+    /// The partition being read
+    line_corpus::partition part_;
+
+    /// The id of the next document
+    doc_id cur_id_;
+
+    /// Reads the documents
+    line_reader content_;
+
+    /// Reads the class labels, if there are any
+    std::unique_ptr<line_reader> labels_;
+
+    /// Reads the document names, if there are any
+    std::unique_ptr<line_reader> names_;
+};
 }
 }
 
@@ -0,0 +1,194 @@
+/**
+ * @file tokenized_corpus.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_TOKENIZED_CORPUS_H_
+#define META_TOKENIZED_CORPUS_H_
+
+#include <fstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "corpus/corpus.h"
+
+namespace meta
+{
+namespace corpus
+{
+
+/**
+ * Reads a corpus that has already been tokenized, from a binary file
+ * written by a tokenized_corpus_writer, so that the documents it returns
+ * hold their counts and need not be analyzed again. The file holds a
+ * vocabulary and, for each document, either a bag of (term id, count)
+ * pairs or the sequence of term ids of its tokens.
+ *
+ * The returned documents are marked pretokenized(), and the index
+ * builders use their counts as they are; the file must therefore be
+ * written again whenever the analyzers of the configuration change.
+ *
+ * Required config parameters:
+ *
+ * ~~~toml
+ * corpus-type = "tokenized-corpus"
+ * ~~~
+ *
+ * Optional config parameters:
+ *
+ * ~~~toml
+ * # the file to read; default is prefix/dataset/dataset.tok
+ * tokenized-file = "path/to/corpus.tok"
+ * ~~~
+ */
+class tokenized_corpus : public corpus
+{
+  public:
+    /**
+     * @param file The path to the tokenized corpus
+     */
+    tokenized_corpus(const std::string& file);
+
+    /**
+     * @return whether there is another document in this corpus
+     */
+    bool has_next() const override;
+
+    /**
+     * @return the next document from this corpus
+     */
+    document next() override;
+
+    /**
+     * @return the number of documents in this corpus
+     */
+    uint64_t size() const override;
+
+    /**
+     * @return whether the file holds the token sequences of the
+     * documents rather than their bags of terms
+     */
+    bool sequences() const;
+
+    /**
+     * @return the term ids of the tokens of the document last returned by
+     * next(), in order, which is empty if the file holds bags
+     */
+    const std::vector<uint64_t>& sequence() const;
+
+    /**
+     * @param id A term id of the file
+     * @return the text of the term
+     */
+    const std::string& term(uint64_t id) const;
+
+    /**
+     * Basic exception for tokenized_corpus interactions.
+     */
+    class tokenized_corpus_exception : public corpus::corpus_exception
+    {
+      public:
+        using corpus::corpus_exception::corpus_exception;
+    };
+
+  private:
+    /// the tokenized corpus
+    std::ifstream input_;
+
+    /// the current document we are on
+    uint64_t cur_id_;
+
+    /// the number of documents in the corpus
+    uint64_t num_docs_;
+
+    /// whether the file holds sequences rather than bags
+    bool sequences_;
+
+    /// term id -> the text of the term
+    std::vector<std::string> terms_;
+
+    /// the token sequence of the last document read
+    std::vector<uint64_t> sequence_;
+};
+
+/**
+ * Writes the documents of a corpus, once they are tokenized, in the binary
+ * format of tokenized_corpus. Documents are written in the order of their
+ * ids, keeping their paths, names and labels; their fields stay in the
+ * fields file of the corpus.
+ */
+class tokenized_corpus_writer
+{
+  public:
+    /**
+     * Creates the file.
+     * @param file The path to write the tokenized corpus to
+     * @param sequences Whether to write the token sequences of the
+     * documents rather than their counts
+     */
+    tokenized_corpus_writer(const std::string& file, bool sequences = false);
+
+    /**
+     * Finishes the file if close() has not been called.
+     */
+    ~tokenized_corpus_writer();
+
+    /**
+     * Writes the counts of a tokenized document to a file of bags.
+     * @param doc The document
+     */
+    void write(const document& doc);
+
+    /**
+     * Writes the tokens of a document to a file of sequences.
+     * @param doc The document, whose counts are not used
+     * @param tokens The tokens of the document, in order
+     */
+    void write(const document& doc, const std::vector<std::string>& tokens);
+
+    /**
+     * Writes the vocabulary and the number of documents, completing the
+     * file.
+     */
+    void close();
+
+  private:
+    /**
+     * Writes the metadata that starts every document.
+     * @param doc The document
+     */
+    void write_header(const document& doc);
+
+    /**
+     * @param term A term
+     * @return the term id of the term, assigning it the next id if it is
+     * new
+     */
+    uint64_t intern(const std::string& term);
+
+    /// the tokenized corpus
+    std::ofstream output_;
+
+    /// whether the file holds sequences rather than bags
+    bool sequences_;
+
+    /// the number of documents written
+    uint64_t num_docs_;
+
+    /// term -> term id
+    std::unordered_map<std::string, uint64_t> ids_;
+
+    /// term id -> the text of the term
+    std::vector<std::string> terms_;
+
+    /// whether close() has been called
+    bool closed_;
+};
+}
+}
+
+#endif
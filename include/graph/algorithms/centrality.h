@@ -10,9 +10,10 @@
 #ifndef META_GRAPH_ALGORITHMS_CENTRALITY_H_
 #define META_GRAPH_ALGORITHMS_CENTRALITY_H_
 
-#include <mutex>
+#include <string>
 #include "graph/undirected_graph.h"
 #include "graph/directed_graph.h"
+#include "graph/algorithms/internal.h"
 
 #include <vector>
 
@@ -44,16 +45,68 @@ centrality_result degree_centrality(const Graph& g);
 template <class Graph>
 centrality_result betweenness_centrality(const Graph& g);
 
+/**
+ * Estimates the betweenness centrality of each node in the graph from the
+ * shortest paths out of a uniform sample of source nodes, scaled up to
+ * the whole graph, as in Brandes and Pich, 2007. This is for graphs on
+ * which the exact computation is infeasible; see betweenness_error_bound
+ * for the accuracy of the estimate.
+ * @see http://www.inf.uni-konstanz.de/algo/publications/bp-celn-06.pdf
+ * @param g
+ * @param num_samples The number of source nodes to sample; if it is at
+ * least the number of nodes, the exact centrality is computed
+ * @param seed The seed for sampling the sources
+ * @return a collection of (id, centrality) pairs
+ */
+template <class Graph>
+centrality_result betweenness_centrality(const Graph& g, uint64_t num_samples,
+                                         uint64_t seed = 1);
+
+/**
+ * Bounds the error of sampled betweenness centrality. By Hoeffding's
+ * inequality, the estimate for any one node is within the returned
+ * distance of its exact centrality with probability at least 1 - delta;
+ * pass delta / n to bound all n nodes at once.
+ * @param num_nodes The number of nodes in the graph
+ * @param num_samples The number of sampled source nodes
+ * @param delta The probability that the bound may fail
+ * @return the absolute error bound
+ */
+inline double betweenness_error_bound(uint64_t num_nodes,
+                                      uint64_t num_samples, double delta);
+
 /**
  * Finds the eigenvector centrality of each node (i.e. "prestige") using power
- * iteration.
+ * iteration. Each iteration pulls every node's score from the nodes with
+ * edges to it, in parallel, and normalizes the scores to sum to one.
+ * Graphs other than a compressed_graph are compressed first.
  * @param g
  * @param max_iters The maximum number of iterations to run the power iteration
+ * @param tolerance Iteration stops once the L1 distance between the scores
+ * of two iterations is below this
  * @return a collection of (id, centrality) pairs
  */
 template <class Graph>
 centrality_result eigenvector_centrality(const Graph& g,
-                                         uint64_t max_iters = 100);
+                                         uint64_t max_iters = 100,
+                                         double tolerance = 1e-6);
+
+/**
+ * Finds the PageRank of each node using power iteration, pulling every
+ * node's score from the nodes with edges to it, in parallel. The score of
+ * nodes with no outgoing edges is spread evenly over the graph. Graphs
+ * other than a compressed_graph are compressed first.
+ * @param g
+ * @param damping The probability of following an edge rather than jumping
+ * to a random node
+ * @param max_iters The maximum number of iterations to run the power iteration
+ * @param tolerance Iteration stops once the L1 distance between the scores
+ * of two iterations is below this
+ * @return a collection of (id, PageRank) pairs
+ */
+template <class Graph>
+centrality_result pagerank(const Graph& g, double damping = 0.85,
+                           uint64_t max_iters = 100, double tolerance = 1e-6);
 
 /**
  * Contains helper functions used by the centrality measures.
@@ -61,11 +114,31 @@ centrality_result eigenvector_centrality(const Graph& g,
 namespace internal
 {
 /**
- * Helper function for betweenness_centrality.
+ * @param scores The score of each node_id
+ * @return a collection of (id, score) pairs, highest score first
+ */
+inline centrality_result ranked(const std::vector<double>& scores);
+
+/**
+ * Computes betweenness centrality from the shortest paths out of the given
+ * sources, in parallel.
+ * @param g
+ * @param sources The source nodes
+ * @param scale The factor to scale the summed dependencies by
+ * @param prefix The prefix for the progress output
+ * @return a collection of (id, centrality) pairs
+ */
+template <class Graph>
+centrality_result betweenness(const Graph& g,
+                              const std::vector<node_id>& sources,
+                              double scale, const std::string& prefix);
+
+/**
+ * Helper function for betweenness_centrality: adds the dependencies of
+ * every node on the source n to cb.
  */
 template <class Graph>
-void betweenness_step(const Graph& g, centrality_result& cb, node_id n,
-                      std::mutex& calc_mut);
+void betweenness_step(const Graph& g, std::vector<double>& cb, node_id n);
 }
 }
 }
@@ -3,12 +3,17 @@
  * @author Sean Massung
  */
 
+#include <cmath>
+#include <numeric>
+#include <random>
 #include <stack>
 #include <queue>
 #include <vector>
 #include <unordered_map>
 
+#include "parallel/algorithm.h"
 #include "parallel/parallel_for.h"
+#include "util/progress.h"
 
 namespace meta
 {
@@ -21,12 +26,13 @@ centrality_result degree_centrality(const Graph& g)
 {
     centrality_result res;
     res.reserve(g.size());
-    for (auto& n : g)
+    for (const auto& n : g)
         res.emplace_back(n.id, g.adjacent(n.id).size());
 
     using pair_t = std::pair<node_id, double>;
-    std::sort(res.begin(), res.end(), [&](const pair_t& a, const pair_t& b)
-              {
+    parallel::sort(res.begin(), res.end(),
+                   [&](const pair_t& a, const pair_t& b)
+                   {
         return a.second > b.second;
     });
     return res;
@@ -35,71 +41,244 @@ centrality_result degree_centrality(const Graph& g)
 template <class Graph>
 centrality_result betweenness_centrality(const Graph& g)
 {
-    centrality_result cb;
-    cb.reserve(g.size());
-    for (auto& n : g)
-        cb.emplace_back(n.id, 0.0);
-
-    std::mutex print_mut; // progress mutex
-    std::mutex calc_mut;  // centrality calculation mutex
-
-    printing::progress prog{" Calculating betweenness centrality ", g.size()};
-    size_t done = 0;
-    parallel::parallel_for(g.begin(), g.end(), [&](decltype(*g.begin()) n)
-                           {
-        internal::betweenness_step(g, cb, n.id, calc_mut);
-        std::lock_guard<std::mutex> lock{print_mut};
-        prog(++done);
-    });
-    prog.end();
+    std::vector<node_id> sources;
+    sources.reserve(g.size());
+    for (const auto& n : g)
+        sources.push_back(n.id);
 
-    using pair_t = std::pair<node_id, double>;
-    std::sort(cb.begin(), cb.end(), [&](const pair_t& a, const pair_t& b)
-              {
-        return a.second > b.second;
-    });
-    return cb;
+    return internal::betweenness(g, sources, 1.0,
+                                 " Calculating betweenness centrality ");
+}
+
+template <class Graph>
+centrality_result betweenness_centrality(const Graph& g, uint64_t num_samples,
+                                         uint64_t seed /* = 1 */)
+{
+    if (num_samples >= g.size())
+        return betweenness_centrality(g);
+    if (num_samples == 0)
+        throw graph_algorithm_exception{
+            "betweenness centrality needs at least one sample"};
+
+    // sample sources uniformly without replacement; the sum of their
+    // dependencies, scaled by n / k, is an unbiased estimate (Brandes and
+    // Pich, 2007)
+    std::vector<node_id> sources;
+    sources.reserve(g.size());
+    for (const auto& n : g)
+        sources.push_back(n.id);
+    std::mt19937_64 gen{seed};
+    for (uint64_t i = 0; i < num_samples; ++i)
+    {
+        std::uniform_int_distribution<uint64_t> dist{i, sources.size() - 1};
+        std::swap(sources[i], sources[dist(gen)]);
+    }
+    sources.resize(num_samples);
+
+    return internal::betweenness(
+        g, sources, static_cast<double>(g.size()) / num_samples,
+        " Estimating betweenness centrality ");
+}
+
+inline double betweenness_error_bound(uint64_t num_nodes,
+                                      uint64_t num_samples, double delta)
+{
+    if (num_samples >= num_nodes)
+        return 0.0;
+    if (num_samples == 0 || num_nodes < 2)
+        throw graph_algorithm_exception{
+            "error bound needs at least one sample and two nodes"};
+
+    // Hoeffding's bound over the sampled sources, each of whose dependency
+    // on a node is in [0, n - 2]
+    auto xi = std::sqrt(std::log(2.0 / delta) / (2.0 * num_samples));
+    return xi * num_nodes * (num_nodes - 2);
 }
 
 template <class Graph>
 centrality_result eigenvector_centrality(const Graph& g,
-                                         uint64_t max_iters /* = 100 */)
+                                         uint64_t max_iters /* = 100 */,
+                                         double tolerance /* = 1e-6 */)
 {
-    std::vector<double> v(g.size(), 1.0);
-    std::vector<double> w(g.size(), 0.0);
+    const auto& cg = internal::compressed(g);
+    auto n = cg.size();
+    std::vector<double> v(n, 1.0 / n);
+    std::vector<double> w(n, 0.0);
 
+    auto& pool = parallel::default_pool();
     printing::progress prog{" Calculating eigenvector centrality ", max_iters};
     for (uint64_t iter = 0; iter < max_iters; ++iter)
     {
         prog(iter);
-        w.assign(w.size(), 0.0);
-        for (uint64_t i = 0; i < g.size(); ++i)
-            for (auto& n : g.adjacent(node_id{i}))
-                w[n.first] += v[i];
+        auto sum = internal::parallel_sum<double>(
+            pool, n, [&](uint64_t begin, uint64_t end)
+            {
+                double total = 0.0;
+                for (auto i = begin; i < end; ++i)
+                {
+                    double score = 0.0;
+                    for (const auto& in : cg.incoming(node_id{i}))
+                        score += v[in.first];
+                    w[i] = score;
+                    total += score;
+                }
+                return total;
+            });
+
+        // without edges, every node stays equally central
+        if (sum == 0.0)
+            break;
+
+        auto delta = internal::parallel_sum<double>(
+            pool, n, [&](uint64_t begin, uint64_t end)
+            {
+                double total = 0.0;
+                for (auto i = begin; i < end; ++i)
+                {
+                    w[i] /= sum;
+                    total += std::abs(w[i] - v[i]);
+                }
+                return total;
+            });
+
         v.swap(w);
+        if (delta < tolerance)
+            break;
     }
     prog.end();
 
-    centrality_result evc;
-    evc.reserve(g.size());
-    node_id id{0};
-    double sum = std::accumulate(v.begin(), v.end(), 0.0);
-    for (auto& n : v)
-        evc.emplace_back(id++, n / sum);
+    return internal::ranked(v);
+}
+
+template <class Graph>
+centrality_result pagerank(const Graph& g, double damping /* = 0.85 */,
+                           uint64_t max_iters /* = 100 */,
+                           double tolerance /* = 1e-6 */)
+{
+    const auto& cg = internal::compressed(g);
+    auto n = cg.size();
+    std::vector<double> v(n, 1.0 / n);
+    std::vector<double> w(n, 0.0);
+    std::vector<double> share(n, 0.0);
+
+    auto& pool = parallel::default_pool();
+    printing::progress prog{" Calculating PageRank ", max_iters};
+    for (uint64_t iter = 0; iter < max_iters; ++iter)
+    {
+        prog(iter);
+
+        // each node's score is split over its outgoing edges; the score of
+        // nodes without any is spread over the whole graph
+        auto dangling = internal::parallel_sum<double>(
+            pool, n, [&](uint64_t begin, uint64_t end)
+            {
+                double total = 0.0;
+                for (auto i = begin; i < end; ++i)
+                {
+                    auto degree = cg.adjacent(node_id{i}).size();
+                    if (degree == 0)
+                    {
+                        share[i] = 0.0;
+                        total += v[i];
+                    }
+                    else
+                    {
+                        share[i] = v[i] / degree;
+                    }
+                }
+                return total;
+            });
+
+        auto base = (1.0 - damping + damping * dangling) / n;
+        auto delta = internal::parallel_sum<double>(
+            pool, n, [&](uint64_t begin, uint64_t end)
+            {
+                double total = 0.0;
+                for (auto i = begin; i < end; ++i)
+                {
+                    double score = 0.0;
+                    for (const auto& in : cg.incoming(node_id{i}))
+                        score += share[in.first];
+                    w[i] = base + damping * score;
+                    total += std::abs(w[i] - v[i]);
+                }
+                return total;
+            });
+
+        v.swap(w);
+        if (delta < tolerance)
+            break;
+    }
+    prog.end();
+
+    return internal::ranked(v);
+}
+
+namespace internal
+{
+inline centrality_result ranked(const std::vector<double>& scores)
+{
+    centrality_result res;
+    res.reserve(scores.size());
+    for (uint64_t i = 0; i < scores.size(); ++i)
+        res.emplace_back(node_id{i}, scores[i]);
 
     using pair_t = std::pair<node_id, double>;
-    std::sort(evc.begin(), evc.end(), [&](const pair_t& a, const pair_t& b)
-              {
+    parallel::sort(res.begin(), res.end(),
+                   [&](const pair_t& a, const pair_t& b)
+                   {
         return a.second > b.second;
     });
-    return evc;
+    return res;
 }
 
-namespace internal
+template <class Graph>
+centrality_result betweenness(const Graph& g,
+                              const std::vector<node_id>& sources,
+                              double scale, const std::string& prefix)
 {
+    // each task adds the dependencies of its sources into an array of its
+    // own, made when it claims its first source, so the threads share
+    // nothing but the counter of sources; the arrays are summed at the end
+    auto& pool = parallel::default_pool();
+    std::vector<std::vector<double>> partial(pool.thread_ids().size());
+    printing::concurrent_progress prog{prefix, sources.size()};
+    parallel::parallel_chunks(pool, sources.size(), 1,
+                              [&](uint64_t task, uint64_t first, uint64_t last)
+                              {
+        auto& cb = partial[task];
+        if (cb.empty())
+            cb.assign(g.size(), 0.0);
+        for (auto i = first; i < last; ++i)
+        {
+            betweenness_step(g, cb, sources[i]);
+            prog.increment();
+        }
+    });
+    prog.end();
+
+    centrality_result cb;
+    cb.reserve(g.size());
+    for (const auto& n : g)
+    {
+        double total = 0.0;
+        for (const auto& part : partial)
+            if (!part.empty())
+                total += part[n.id];
+        cb.emplace_back(n.id, total * scale);
+    }
+
+    using pair_t = std::pair<node_id, double>;
+    parallel::sort(cb.begin(), cb.end(),
+                   [&](const pair_t& a, const pair_t& b)
+                   {
+        return a.second > b.second;
+    });
+    return cb;
+}
+
 template <class Graph>
-void betweenness_step(const Graph& g, centrality_result& cb, node_id n,
-                      std::mutex& calc_mut)
+void betweenness_step(const Graph& g, std::vector<double>& cb, node_id n)
 {
     std::stack<node_id> stack;
     std::unordered_map<node_id, std::vector<node_id>> parent;
@@ -114,7 +293,7 @@ void betweenness_step(const Graph& g, centrality_result& cb, node_id n,
         auto v = queue.front();
         queue.pop();
         stack.push(v);
-        for (auto& neighbor : g.adjacent(v))
+        for (const auto& neighbor : g.adjacent(v))
         {
             auto w = neighbor.first;
             // w found for the first time?
@@ -141,10 +320,7 @@ void betweenness_step(const Graph& g, centrality_result& cb, node_id n,
         for (auto& v : parent[w])
             delta[v] += (sigma[v] / sigma[w]) * (1.0 + delta[w]);
         if (w != n)
-        {
-            std::lock_guard<std::mutex> lock{calc_mut};
-            cb[w].second += delta[w];
-        }
+            cb[w] += delta[w];
     }
 }
 }
@@ -0,0 +1,72 @@
+/**
+ * @file internal.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_GRAPH_ALGORITHMS_INTERNAL_H_
+#define META_GRAPH_ALGORITHMS_INTERNAL_H_
+
+#include "graph/compressed_graph.h"
+#include "graph/directed_graph.h"
+#include "graph/disk_graph.h"
+#include "graph/undirected_graph.h"
+#include "parallel/default_pool.h"
+#include "parallel/thread_pool.h"
+
+namespace meta
+{
+namespace graph
+{
+namespace algorithms
+{
+/**
+ * Contains helper functions shared by the parallel graph algorithms.
+ */
+namespace internal
+{
+/// The number of nodes in a block of parallel_sum; a multiple of 64, so
+/// that no two blocks share a word of a bitmap over the nodes
+const uint64_t parallel_block_size = 4096;
+
+/**
+ * @param g
+ * @return the graph in compressed form; a compressed_graph is returned as
+ * it is
+ */
+template <class Node, class Edge>
+const compressed_graph<Node, Edge>&
+    compressed(const compressed_graph<Node, Edge>& g);
+
+template <class Node, class Edge>
+compressed_graph<Node, Edge> compressed(const directed_graph<Node, Edge>& g);
+
+template <class Node, class Edge>
+compressed_graph<Node, Edge> compressed(const undirected_graph<Node, Edge>& g);
+
+/**
+ * @param g
+ * @return the graph as it is; a disk_graph is already compressed
+ */
+inline const disk_graph& compressed(const disk_graph& g);
+
+/**
+ * Calls fn(begin, end) on consecutive blocks of parallel_block_size
+ * elements of the range [0, size), on the threads of the pool.
+ * @param pool
+ * @param size The size of the range
+ * @param fn Returns a partial sum for its block
+ * @return the sum of the partial sums, added in block order so that it
+ * does not depend on the scheduling of the threads
+ */
+template <class T, class Function>
+T parallel_sum(parallel::thread_pool& pool, uint64_t size, Function&& fn);
+}
+}
+}
+}
+
+#include "graph/algorithms/internal.tcc"
+#endif
@@ -0,0 +1,59 @@
+/**
+ * @file internal.tcc
+ */
+
+#include <vector>
+#include "parallel/parallel_for.h"
+
+namespace meta
+{
+namespace graph
+{
+namespace algorithms
+{
+namespace internal
+{
+template <class Node, class Edge>
+const compressed_graph<Node, Edge>&
+    compressed(const compressed_graph<Node, Edge>& g)
+{
+    return g;
+}
+
+template <class Node, class Edge>
+compressed_graph<Node, Edge> compressed(const directed_graph<Node, Edge>& g)
+{
+    return compressed_graph<Node, Edge>{g};
+}
+
+template <class Node, class Edge>
+compressed_graph<Node, Edge> compressed(const undirected_graph<Node, Edge>& g)
+{
+    return compressed_graph<Node, Edge>{g};
+}
+
+inline const disk_graph& compressed(const disk_graph& g)
+{
+    return g;
+}
+
+template <class T, class Function>
+T parallel_sum(parallel::thread_pool& pool, uint64_t size, Function&& fn)
+{
+    auto num_blocks = (size + parallel_block_size - 1) / parallel_block_size;
+    std::vector<T> partial(num_blocks);
+    parallel::parallel_chunks(pool, size, parallel_block_size,
+                              [&](uint64_t, uint64_t begin, uint64_t end)
+                              {
+        partial[begin / parallel_block_size] = fn(begin, end);
+    });
+
+    T total{};
+    for (const auto& part : partial)
+        total += part;
+    return total;
+}
+}
+}
+}
+}
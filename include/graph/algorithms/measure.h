@@ -10,8 +10,10 @@
 #ifndef META_GRAPH_ALGORITHMS_MEASURE_H_
 #define META_GRAPH_ALGORITHMS_MEASURE_H_
 
+#include <vector>
 #include "graph/undirected_graph.h"
 #include "graph/directed_graph.h"
+#include "graph/algorithms/internal.h"
 
 namespace meta
 {
@@ -33,12 +35,41 @@ double clustering_coefficient(const Graph& graph, node_id id);
 
 /**
  * Computes the clustering coefficient of the entire graph as the average
- * clustering coefficient of each node.
+ * clustering coefficient of each node, from triangle_counts.
  * @return the graph's clustering coefficient
  */
 template <class Graph>
 double clustering_coefficient(const Graph& graph);
 
+/**
+ * @param graph An undirected graph
+ * @return the clustering coefficient of each node_id, from triangle_counts
+ */
+template <class Graph>
+std::vector<double> clustering_coefficients(const Graph& graph);
+
+/**
+ * Counts the triangles each node of an undirected graph is part of, in
+ * parallel. Each edge is directed from the endpoint of lower degree to the
+ * one of higher degree, so that every triangle is found once, from its
+ * lowest node, by intersecting the sorted rows of two of its nodes; the
+ * rows that are searched are short even when the degrees are skewed.
+ * Graphs other than a compressed_graph are compressed first.
+ * @param graph An undirected graph
+ * @return the number of triangles containing each node_id
+ */
+template <class Graph>
+std::vector<uint64_t> triangle_counts(const Graph& graph);
+
+/**
+ * Counts the triangles of an undirected graph in parallel, as
+ * triangle_counts does, without keeping a count per node.
+ * @param graph An undirected graph
+ * @return the number of triangles in the graph
+ */
+template <class Graph>
+uint64_t num_triangles(const Graph& graph);
+
 /**
  * The neighborhood overlap is the ratio of shared neighbors between src and
  * dest, ranging from 0 (no shared neighbors; a local bridge) to 1.
@@ -49,6 +80,48 @@ double clustering_coefficient(const Graph& graph);
  */
 template <class Graph>
 double neighborhood_overlap(const Graph& graph, node_id src, node_id dest);
+
+namespace internal
+{
+/**
+ * Counts the elements two sorted arrays of distinct ids have in common,
+ * comparing blocks of each with SIMD instructions where they are
+ * available.
+ * @param a The first array
+ * @param a_len Its length
+ * @param b The second array
+ * @param b_len Its length
+ * @return the size of the intersection
+ */
+inline uint64_t intersection_size(const uint64_t* a, uint64_t a_len,
+                                  const uint64_t* b, uint64_t b_len);
+
+/**
+ * @param graph
+ * @param id
+ * @return the neighbors of the node, sorted
+ */
+template <class Graph>
+std::vector<uint64_t> sorted_neighbors(const Graph& graph, node_id id);
+
+/**
+ * The rows of each node's neighbors of higher degree (ties broken by
+ * node_id), in compressed sparse row form, sorted.
+ */
+struct oriented_rows
+{
+    std::vector<uint64_t> offsets;
+    std::vector<uint64_t> ids;
+};
+
+/**
+ * @param graph An undirected compressed graph
+ * @param pool
+ * @return the rows of each node's neighbors of higher degree
+ */
+template <class Graph>
+oriented_rows orient(const Graph& graph, parallel::thread_pool& pool);
+}
 }
 }
 }
@@ -3,7 +3,14 @@
  * @author Sean Massung
  */
 
-#include <unordered_set>
+#include <algorithm>
+#include <atomic>
+#include <numeric>
+#include <vector>
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
 
 namespace meta
 {
@@ -14,34 +21,142 @@ namespace algorithms
 template <class Graph>
 double clustering_coefficient(const Graph& graph, node_id id)
 {
-    auto adj = graph.adjacent(id);
+    auto adj = internal::sorted_neighbors(graph, id);
     if (adj.empty())
         return 0.0;
 
     if (adj.size() == 1)
         return 1.0;
 
-    double numerator = 0.0;
-    for (size_t i = 0; i < adj.size(); ++i)
+    // every connection between two neighbors is seen from both of them
+    uint64_t links = 0;
+    for (const auto& n : adj)
     {
-        for (size_t j = i; j < adj.size(); ++j)
-        {
-            if (graph.edge(adj[i].first, adj[j].first))
-                ++numerator;
-        }
+        auto next = internal::sorted_neighbors(graph, node_id{n});
+        links += internal::intersection_size(adj.data(), adj.size(),
+                                             next.data(), next.size());
     }
 
-    return (2.0 * numerator) / (adj.size() * (adj.size() - 1));
+    return static_cast<double>(links) / (adj.size() * (adj.size() - 1));
 }
 
 template <class Graph>
 double clustering_coefficient(const Graph& graph)
 {
-    double total = 0.0;
-    for (auto& n : graph)
-        total += clustering_coefficient(graph, n.id);
+    auto coeffs = clustering_coefficients(graph);
+    return std::accumulate(coeffs.begin(), coeffs.end(), 0.0) / graph.size();
+}
+
+template <class Graph>
+std::vector<double> clustering_coefficients(const Graph& graph)
+{
+    const auto& cg = internal::compressed(graph);
+    auto triangles = triangle_counts(cg);
 
-    return total / graph.size();
+    std::vector<double> coeffs(cg.size(), 0.0);
+    for (uint64_t i = 0; i < cg.size(); ++i)
+    {
+        auto degree = cg.adjacent(node_id{i}).size();
+        if (degree == 1)
+            coeffs[i] = 1.0;
+        else if (degree > 1)
+            coeffs[i] = (2.0 * triangles[i]) / (degree * (degree - 1));
+    }
+    return coeffs;
+}
+
+template <class Graph>
+std::vector<uint64_t> triangle_counts(const Graph& graph)
+{
+    const auto& cg = internal::compressed(graph);
+    if (cg.directed())
+        throw graph_algorithm_exception{
+            "triangles can only be counted in undirected graphs"};
+
+    auto& pool = parallel::default_pool();
+    auto rows = internal::orient(cg, pool);
+
+    std::vector<std::atomic<uint64_t>> counts(cg.size());
+    for (auto& count : counts)
+        count.store(0, std::memory_order_relaxed);
+
+    internal::parallel_sum<uint64_t>(
+        pool, cg.size(), [&](uint64_t begin, uint64_t end)
+        {
+            for (auto u = begin; u < end; ++u)
+            {
+                // each triangle is found once, from its lowest node; the
+                // other two are credited through the shared counts
+                uint64_t found = 0;
+                auto u_first = rows.offsets[u];
+                auto u_last = rows.offsets[u + 1];
+                for (auto k = u_first; k < u_last; ++k)
+                {
+                    auto v = rows.ids[k];
+                    auto i = u_first;
+                    auto j = rows.offsets[v];
+                    auto v_last = rows.offsets[v + 1];
+                    uint64_t common = 0;
+                    while (i < u_last && j < v_last)
+                    {
+                        if (rows.ids[i] < rows.ids[j])
+                            ++i;
+                        else if (rows.ids[j] < rows.ids[i])
+                            ++j;
+                        else
+                        {
+                            counts[rows.ids[i]].fetch_add(
+                                1, std::memory_order_relaxed);
+                            ++common;
+                            ++i;
+                            ++j;
+                        }
+                    }
+                    if (common > 0)
+                        counts[v].fetch_add(common, std::memory_order_relaxed);
+                    found += common;
+                }
+                counts[u].fetch_add(found, std::memory_order_relaxed);
+            }
+            return 0;
+        });
+
+    std::vector<uint64_t> result(cg.size());
+    for (uint64_t i = 0; i < cg.size(); ++i)
+        result[i] = counts[i].load(std::memory_order_relaxed);
+    return result;
+}
+
+template <class Graph>
+uint64_t num_triangles(const Graph& graph)
+{
+    const auto& cg = internal::compressed(graph);
+    if (cg.directed())
+        throw graph_algorithm_exception{
+            "triangles can only be counted in undirected graphs"};
+
+    auto& pool = parallel::default_pool();
+    auto rows = internal::orient(cg, pool);
+    return internal::parallel_sum<uint64_t>(
+        pool, cg.size(), [&](uint64_t begin, uint64_t end)
+        {
+            uint64_t total = 0;
+            for (auto u = begin; u < end; ++u)
+            {
+                auto u_first = rows.offsets[u];
+                auto u_len = rows.offsets[u + 1] - u_first;
+                for (auto k = u_first; k < u_first + u_len; ++k)
+                {
+                    auto v = rows.ids[k];
+                    auto v_first = rows.offsets[v];
+                    total += internal::intersection_size(
+                        rows.ids.data() + u_first, u_len,
+                        rows.ids.data() + v_first,
+                        rows.offsets[v + 1] - v_first);
+                }
+            }
+            return total;
+        });
 }
 
 template <class Graph>
@@ -51,23 +166,146 @@ double neighborhood_overlap(const Graph& graph, node_id src, node_id dest)
         throw graph_algorithm_exception{
             "neighborhood_overlap must be called on neighboring nodes"};
 
-    double num_shared = 0.0;
-    std::unordered_set<node_id> total;
-    for (auto& p : graph.adjacent(src))
+    auto src_adj = internal::sorted_neighbors(graph, src);
+    auto dest_adj = internal::sorted_neighbors(graph, dest);
+    auto num_shared = internal::intersection_size(
+        src_adj.data(), src_adj.size(), dest_adj.data(), dest_adj.size());
+
+    if (num_shared == 0)
+        return 0.0;
+
+    // minus 2 so src doesn't count dest and vice versa
+    auto total = src_adj.size() + dest_adj.size() - num_shared;
+    return static_cast<double>(num_shared) / (total - 2);
+}
+
+namespace internal
+{
+inline uint64_t intersection_size(const uint64_t* a, uint64_t a_len,
+                                  const uint64_t* b, uint64_t b_len)
+{
+    uint64_t count = 0;
+    uint64_t i = 0;
+    uint64_t j = 0;
+
+    // compare every element of a block of a with every element of a block
+    // of b by rotating b's block, then move past whichever block ends
+    // first; no element of it can match anything further on
+#if defined(__AVX2__)
+    while (i + 4 <= a_len && j + 4 <= b_len)
     {
-        total.insert(p.first);
-        if (graph.edge(dest, p.first))
-            ++num_shared;
+        auto va = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+        auto vb = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + j));
+        auto eq = _mm256_or_si256(
+            _mm256_or_si256(
+                _mm256_cmpeq_epi64(va, vb),
+                _mm256_cmpeq_epi64(
+                    va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(0, 3, 2, 1)))),
+            _mm256_or_si256(
+                _mm256_cmpeq_epi64(
+                    va, _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(1, 0, 3, 2))),
+                _mm256_cmpeq_epi64(
+                    va,
+                    _mm256_permute4x64_epi64(vb, _MM_SHUFFLE(2, 1, 0, 3)))));
+        count += static_cast<uint64_t>(
+            __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(eq))));
+
+        auto a_max = a[i + 3];
+        auto b_max = b[j + 3];
+        if (a_max <= b_max)
+            i += 4;
+        if (b_max <= a_max)
+            j += 4;
     }
+#elif defined(__SSE4_2__)
+    while (i + 2 <= a_len && j + 2 <= b_len)
+    {
+        auto va = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+        auto vb = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + j));
+        auto eq = _mm_or_si128(
+            _mm_cmpeq_epi64(va, vb),
+            _mm_cmpeq_epi64(va,
+                            _mm_shuffle_epi32(vb, _MM_SHUFFLE(1, 0, 3, 2))));
+        count += static_cast<uint64_t>(
+            __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(eq))));
 
-    if (num_shared == 0.0)
-        return 0.0;
+        auto a_max = a[i + 1];
+        auto b_max = b[j + 1];
+        if (a_max <= b_max)
+            i += 2;
+        if (b_max <= a_max)
+            j += 2;
+    }
+#endif
+    while (i < a_len && j < b_len)
+    {
+        if (a[i] < b[j])
+            ++i;
+        else if (b[j] < a[i])
+            ++j;
+        else
+        {
+            ++count;
+            ++i;
+            ++j;
+        }
+    }
+    return count;
+}
 
-    for (auto& p : graph.adjacent(dest))
-        total.insert(p.first);
+template <class Graph>
+std::vector<uint64_t> sorted_neighbors(const Graph& graph, node_id id)
+{
+    std::vector<uint64_t> ids;
+    const auto& adj = graph.adjacent(id);
+    ids.reserve(adj.size());
+    for (const auto& n : adj)
+        ids.push_back(n.first);
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
 
-    // minus 2 so src doesn't count dest and vice versa
-    return num_shared / (total.size() - 2);
+template <class Graph>
+oriented_rows orient(const Graph& graph, parallel::thread_pool& pool)
+{
+    auto n = graph.size();
+    std::vector<uint64_t> degree(n);
+    for (uint64_t i = 0; i < n; ++i)
+        degree[i] = graph.adjacent(node_id{i}).size();
+
+    auto higher = [&](uint64_t u, uint64_t v)
+    {
+        return degree[u] < degree[v] || (degree[u] == degree[v] && u < v);
+    };
+
+    oriented_rows rows;
+    rows.offsets.assign(n + 1, 0);
+    parallel_sum<uint64_t>(pool, n, [&](uint64_t begin, uint64_t end)
+                           {
+        for (auto u = begin; u < end; ++u)
+            for (const auto& p : graph.adjacent(node_id{u}))
+                if (higher(u, p.first))
+                    ++rows.offsets[u + 1];
+        return 0;
+    });
+    std::partial_sum(rows.offsets.begin(), rows.offsets.end(),
+                     rows.offsets.begin());
+
+    // the adjacency rows are sorted, so these are too
+    rows.ids.resize(rows.offsets[n]);
+    parallel_sum<uint64_t>(pool, n, [&](uint64_t begin, uint64_t end)
+                           {
+        for (auto u = begin; u < end; ++u)
+        {
+            auto pos = rows.offsets[u];
+            for (const auto& p : graph.adjacent(node_id{u}))
+                if (higher(u, p.first))
+                    rows.ids[pos++] = p.first;
+        }
+        return 0;
+    });
+    return rows;
+}
 }
 }
 }
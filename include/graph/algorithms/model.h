@@ -10,8 +10,12 @@
 #ifndef META_GRAPH_ALGORITHMS_MODEL_H_
 #define META_GRAPH_ALGORITHMS_MODEL_H_
 
+#include <utility>
+#include <vector>
+#include "graph/compressed_graph.h"
 #include "graph/undirected_graph.h"
 #include "graph/directed_graph.h"
+#include "parallel/thread_pool.h"
 
 namespace meta
 {
@@ -50,6 +54,92 @@ void watts_strogatz(Graph& g, uint64_t num_nodes, uint64_t num_neighbors,
 template <class Graph>
 void preferential_attachment(Graph& g, uint64_t num_nodes, uint64_t node_edges,
         std::function<double(node_id)> attr = [](node_id) { return 1.0; });
+
+/**
+ * Generates a G(n, p) random graph in parallel, straight into compressed
+ * form. Each possible edge is present with probability prob; instead of
+ * testing every pair, the gap to the next present edge of each node is
+ * drawn from a geometric distribution, so the time taken is proportional
+ * to the number of edges made. The graph depends only on the arguments,
+ * not on the number of threads. Pass the result to disk_graph::save to
+ * write it to disk.
+ * @param num_nodes The number of nodes in the graph
+ * @param prob The probability of each edge
+ * @param directed Whether to make a directed graph
+ * @param seed The seed for the random number generators
+ * @return the graph
+ */
+template <class Node = default_node, class Edge = default_edge>
+compressed_graph<Node, Edge> erdos_renyi_graph(uint64_t num_nodes, double prob,
+                                               bool directed = false,
+                                               uint64_t seed = 1);
+
+/**
+ * Generates a recursive matrix (R-MAT) graph in parallel, straight into
+ * compressed form. The graph has 2^scale nodes; each edge is placed by
+ * choosing, scale times, one quadrant of the adjacency matrix with
+ * probabilities a, b, c and 1 - a - b - c, which gives the skewed degrees
+ * of real networks. Repeated edges and self-loops are dropped, so the
+ * graph has at most num_edges edges.
+ * @param scale The log (base 2) of the number of nodes
+ * @param num_edges The number of edges to draw
+ * @param directed Whether to make a directed graph
+ * @param a The probability of the top left quadrant
+ * @param b The probability of the top right quadrant
+ * @param c The probability of the bottom left quadrant
+ * @param seed The seed for the random number generators
+ * @return the graph
+ */
+template <class Node = default_node, class Edge = default_edge>
+compressed_graph<Node, Edge> rmat_graph(uint64_t scale, uint64_t num_edges,
+                                        bool directed = false, double a = 0.57,
+                                        double b = 0.19, double c = 0.19,
+                                        uint64_t seed = 1);
+
+/**
+ * Generates an undirected Barabasi-Albert (preferential attachment) graph
+ * in parallel, straight into compressed form. Node i links to node_edges
+ * earlier nodes, each chosen with probability proportional to its degree.
+ * Following Sanders and Schulz, the choice is made by picking a random
+ * earlier position in the list of edge endpoints: the random number for
+ * each position is a hash of the position, so every edge can be resolved
+ * independently of the others. Repeated edges and self-loops are dropped.
+ * @param num_nodes The number of nodes in the graph
+ * @param node_edges How many edges to create per node
+ * @param seed The seed for the hash
+ * @return the graph
+ */
+template <class Node = default_node, class Edge = default_edge>
+compressed_graph<Node, Edge> barabasi_albert_graph(uint64_t num_nodes,
+                                                   uint64_t node_edges,
+                                                   uint64_t seed = 1);
+
+namespace internal
+{
+/// An edge, as the ids of the nodes it connects
+using node_pair = std::pair<node_id, node_id>;
+
+/**
+ * @param x
+ * @return a well-mixed hash of x (the splitmix64 finalizer)
+ */
+inline uint64_t mix(uint64_t x);
+
+/**
+ * Builds a compressed_graph from edges generated in blocks, dropping
+ * repeated edges and self-loops.
+ * @param pool The pool to sort the rows on
+ * @param num_nodes The number of nodes in the graph
+ * @param blocks The edges
+ * @param directed Whether the graph is directed
+ * @return the graph
+ */
+template <class Node, class Edge>
+compressed_graph<Node, Edge>
+    from_pairs(parallel::thread_pool& pool, uint64_t num_nodes,
+               const std::vector<std::vector<node_pair>>& blocks,
+               bool directed);
+}
 }
 }
 }
@@ -3,8 +3,13 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
 #include <random>
+#include "graph/algorithms/internal.h"
 #include "util/progress.h"
+#include "stats/frozen_multinomial.h"
 #include "stats/multinomial.h"
 
 namespace meta
@@ -105,9 +110,11 @@ void preferential_attachment(
         prog(i);
         g.emplace(std::to_string(i));
         auto src = node_id{i};
+        // the distribution is fixed while this node's edges are drawn
+        stats::frozen_multinomial<node_id> dests{probs};
         for (uint64_t j = 0; j < node_edges; ++j)
         {
-            auto dest = probs(gen);
+            auto dest = dests(gen);
             try
             {
                 g.add_edge(src, dest);
@@ -120,6 +127,239 @@ void preferential_attachment(
     }
     prog.end();
 }
+
+template <class Node, class Edge>
+compressed_graph<Node, Edge> erdos_renyi_graph(uint64_t num_nodes, double prob,
+                                               bool directed /* = false */,
+                                               uint64_t seed /* = 1 */)
+{
+    if (prob < 0 || prob > 1)
+        throw graph_algorithm_exception{"edge probability must be in [0, 1]"};
+
+    auto& pool = parallel::default_pool();
+    auto num_blocks = (num_nodes + internal::parallel_block_size - 1)
+                      / internal::parallel_block_size;
+    std::vector<std::vector<internal::node_pair>> blocks(num_blocks);
+    auto log_q = std::log1p(-prob);
+    internal::parallel_sum<uint64_t>(pool, num_nodes,
+                                     [&](uint64_t begin, uint64_t end)
+                                     {
+        // each block has its own generator, so that the graph does not
+        // depend on which thread made it
+        auto block = begin / internal::parallel_block_size;
+        std::mt19937_64 gen{internal::mix(seed + block)};
+        std::uniform_real_distribution<double> dist;
+        auto& edges = blocks[block];
+        for (auto u = begin; u < end; ++u)
+        {
+            // an undirected graph only draws the edges to lower ids; the
+            // candidates of a directed graph are all nodes but u itself
+            auto len = directed ? num_nodes - 1 : u;
+            uint64_t k = 0;
+            while (k < len)
+            {
+                if (prob < 1)
+                {
+                    auto skip = std::floor(std::log(1.0 - dist(gen)) / log_q);
+                    if (skip >= static_cast<double>(len - k))
+                        break;
+                    k += static_cast<uint64_t>(skip);
+                }
+                auto v = (directed && k >= u) ? k + 1 : k;
+                edges.emplace_back(node_id{u}, node_id{v});
+                ++k;
+            }
+        }
+        return static_cast<uint64_t>(edges.size());
+    });
+
+    return internal::from_pairs<Node, Edge>(pool, num_nodes, blocks,
+                                            directed);
+}
+
+template <class Node, class Edge>
+compressed_graph<Node, Edge> rmat_graph(uint64_t scale, uint64_t num_edges,
+                                        bool directed /* = false */,
+                                        double a /* = 0.57 */,
+                                        double b /* = 0.19 */,
+                                        double c /* = 0.19 */,
+                                        uint64_t seed /* = 1 */)
+{
+    if (scale >= 64)
+        throw graph_algorithm_exception{"R-MAT scale must be less than 64"};
+    if (a < 0 || b < 0 || c < 0 || a + b + c > 1)
+        throw graph_algorithm_exception{
+            "R-MAT quadrant probabilities must be a distribution"};
+
+    auto& pool = parallel::default_pool();
+    auto num_blocks = (num_edges + internal::parallel_block_size - 1)
+                      / internal::parallel_block_size;
+    std::vector<std::vector<internal::node_pair>> blocks(num_blocks);
+    internal::parallel_sum<uint64_t>(pool, num_edges,
+                                     [&](uint64_t begin, uint64_t end)
+                                     {
+        auto block = begin / internal::parallel_block_size;
+        std::mt19937_64 gen{internal::mix(seed + block)};
+        std::uniform_real_distribution<double> dist;
+        auto& edges = blocks[block];
+        edges.reserve(end - begin);
+        for (auto i = begin; i < end; ++i)
+        {
+            uint64_t src = 0;
+            uint64_t dest = 0;
+            for (uint64_t level = 0; level < scale; ++level)
+            {
+                auto r = dist(gen);
+                src <<= 1;
+                dest <<= 1;
+                if (r >= a + b + c)
+                {
+                    src |= 1;
+                    dest |= 1;
+                }
+                else if (r >= a + b)
+                    src |= 1;
+                else if (r >= a)
+                    dest |= 1;
+            }
+            edges.emplace_back(node_id{src}, node_id{dest});
+        }
+        return uint64_t{0};
+    });
+
+    return internal::from_pairs<Node, Edge>(pool, uint64_t{1} << scale, blocks,
+                                            directed);
+}
+
+template <class Node, class Edge>
+compressed_graph<Node, Edge> barabasi_albert_graph(uint64_t num_nodes,
+                                                   uint64_t node_edges,
+                                                   uint64_t seed /* = 1 */)
+{
+    if (node_edges == 0)
+        throw graph_algorithm_exception{
+            "each node must create at least one edge"};
+
+    // edge i leads from node i / node_edges; its endpoints are positions
+    // 2i and 2i + 1 of the list of endpoints. Its target copies the node
+    // at a random position before 2i + 1, which picks a node with
+    // probability proportional to its degree so far; an odd position is
+    // itself a target, so it is resolved the same way
+    auto salt = internal::mix(seed);
+    auto draw = [&](uint64_t i)
+    {
+        return internal::mix(salt + i) % (2 * i + 1);
+    };
+
+    auto& pool = parallel::default_pool();
+    auto num_blocks = (num_nodes + internal::parallel_block_size - 1)
+                      / internal::parallel_block_size;
+    std::vector<std::vector<internal::node_pair>> blocks(num_blocks);
+    internal::parallel_sum<uint64_t>(pool, num_nodes,
+                                     [&](uint64_t begin, uint64_t end)
+                                     {
+        auto& edges = blocks[begin / internal::parallel_block_size];
+        edges.reserve((end - begin) * node_edges);
+        for (auto u = begin; u < end; ++u)
+        {
+            for (uint64_t j = 0; j < node_edges; ++j)
+            {
+                auto pos = draw(u * node_edges + j);
+                while (pos % 2 == 1)
+                    pos = draw(pos / 2);
+                edges.emplace_back(node_id{u}, node_id{pos / 2 / node_edges});
+            }
+        }
+        return uint64_t{0};
+    });
+
+    return internal::from_pairs<Node, Edge>(pool, num_nodes, blocks, false);
+}
+
+namespace internal
+{
+inline uint64_t mix(uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+template <class Node, class Edge>
+compressed_graph<Node, Edge>
+    from_pairs(parallel::thread_pool& pool, uint64_t num_nodes,
+               const std::vector<std::vector<node_pair>>& blocks,
+               bool directed)
+{
+    // count the entries of each row, shifted by one so that the prefix sum
+    // leaves the start of each row in offsets
+    std::vector<uint64_t> offsets(num_nodes + 1, 0);
+    for (const auto& block : blocks)
+    {
+        for (const auto& p : block)
+        {
+            ++offsets[p.first + 1];
+            if (!directed)
+                ++offsets[p.second + 1];
+        }
+    }
+    std::partial_sum(offsets.begin(), offsets.end(), offsets.begin());
+
+    std::vector<node_id> ids(offsets.back());
+    std::vector<uint64_t> lengths(offsets.begin(), offsets.end() - 1);
+    for (const auto& block : blocks)
+    {
+        for (const auto& p : block)
+        {
+            ids[lengths[p.first]++] = p.second;
+            if (!directed)
+                ids[lengths[p.second]++] = p.first;
+        }
+    }
+
+    // sort each row and drop its repeats and self-loops, leaving the new
+    // length of the row in lengths
+    parallel_sum<uint64_t>(pool, num_nodes, [&](uint64_t begin, uint64_t end)
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            auto first = ids.begin() + offsets[i];
+            auto last = ids.begin() + offsets[i + 1];
+            std::sort(first, last);
+            last = std::unique(first, last);
+            last = std::remove(first, last, node_id{i});
+            lengths[i] = static_cast<uint64_t>(last - first);
+        }
+        return uint64_t{0};
+    });
+
+    std::vector<uint64_t> row_offsets(num_nodes + 1, 0);
+    std::partial_sum(lengths.begin(), lengths.end(), row_offsets.begin() + 1);
+
+    std::vector<node_id> neighbors(row_offsets.back());
+    std::vector<Edge> edges(row_offsets.back());
+    parallel_sum<uint64_t>(pool, num_nodes, [&](uint64_t begin, uint64_t end)
+    {
+        for (auto i = begin; i < end; ++i)
+        {
+            for (uint64_t k = 0; k < lengths[i]; ++k)
+            {
+                auto pos = row_offsets[i] + k;
+                auto v = ids[offsets[i] + k];
+                neighbors[pos] = v;
+                // both rows of an undirected edge hold the same edge
+                edges[pos].src = (directed || v > i) ? node_id{i} : v;
+                edges[pos].dest = (directed || v > i) ? v : node_id{i};
+            }
+        }
+        return uint64_t{0};
+    });
+
+    return {std::vector<Node>(num_nodes), std::move(row_offsets),
+            std::move(neighbors), std::move(edges), directed};
+}
+}
 }
 }
 }
@@ -10,8 +10,11 @@
 #ifndef META_GRAPH_ALGORITHMS_SEARCH_H_
 #define META_GRAPH_ALGORITHMS_SEARCH_H_
 
+#include <limits>
+#include <vector>
 #include "graph/undirected_graph.h"
 #include "graph/directed_graph.h"
+#include "graph/algorithms/internal.h"
 
 namespace meta
 {
@@ -36,6 +39,41 @@ std::vector<node_id> myopic_search(Graph& g, node_id src, node_id dest);
  */
 template <class Graph>
 std::vector<node_id> bfs(Graph& g, node_id src, node_id dest);
+
+/// The distance bfs_levels gives nodes that cannot be reached
+const uint64_t unreachable = std::numeric_limits<uint64_t>::max();
+
+/**
+ * Finds the number of edges on a shortest path from src to every node, by
+ * a parallel breadth-first search over bitmap frontiers. Each level is
+ * expanded either top-down, from the frontier along outgoing edges, or
+ * bottom-up, from the unvisited nodes along incoming edges, whichever
+ * will scan fewer edges (Beamer et al., 2012). Graphs other than a
+ * compressed_graph are compressed first.
+ * @see http://www.scottbeamer.net/pubs/beamer-sc2012.pdf
+ * @param g
+ * @param src
+ * @return the distance of each node_id from src, or unreachable
+ */
+template <class Graph>
+std::vector<uint64_t> bfs_levels(const Graph& g, node_id src);
+
+/**
+ * Finds the number of edges on a shortest path from each of many sources
+ * to every node. The sources are searched 64 at a time in one sweep over
+ * the graph, with a bit per source in each node's frontier word (Then et
+ * al., 2014), and the nodes of each level are divided between threads.
+ * Graphs other than a compressed_graph are compressed first.
+ * @see http://www.vldb.org/pvldb/vol8/p449-then.pdf
+ * @param g
+ * @param sources
+ * @return for each source, in order, the distance of each node_id from
+ * it, or unreachable; a node can be reached from a source if its distance
+ * is not unreachable
+ */
+template <class Graph>
+std::vector<std::vector<uint64_t>>
+    bfs_levels(const Graph& g, const std::vector<node_id>& sources);
 }
 }
 }
@@ -3,6 +3,8 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+#include <atomic>
 #include <unordered_set>
 #include <unordered_map>
 #include <queue>
@@ -25,7 +27,7 @@ std::vector<node_id> myopic_search(Graph& g, node_id src, node_id dest)
             throw graph_algorithm_exception{"no path found in myopic search"};
         node_id best_id;
         double best_distance = std::numeric_limits<double>::max();
-        for (auto& n : g.adjacent(cur))
+        for (const auto& n : g.adjacent(cur))
         {
             double distance = std::abs(static_cast<double>(n.first)
                                        - static_cast<double>(dest));
@@ -57,7 +59,7 @@ std::vector<node_id> bfs(Graph& g, node_id src, node_id dest)
         auto cur = q.front();
         q.pop();
         seen.insert(cur);
-        for (auto& n : g.adjacent(cur))
+        for (const auto& n : g.adjacent(cur))
         {
             if (seen.find(n.first) == seen.end())
             {
@@ -87,6 +89,234 @@ std::vector<node_id> bfs(Graph& g, node_id src, node_id dest)
 
     return path;
 }
+namespace internal
+{
+/**
+ * The number of nodes added to a breadth-first search's frontier and the
+ * number of edges leaving them.
+ */
+struct frontier_stats
+{
+    uint64_t nodes = 0;
+    uint64_t edges = 0;
+
+    frontier_stats& operator+=(const frontier_stats& other)
+    {
+        nodes += other.nodes;
+        edges += other.edges;
+        return *this;
+    }
+};
+}
+
+template <class Graph>
+std::vector<uint64_t> bfs_levels(const Graph& g, node_id src)
+{
+    const auto& cg = internal::compressed(g);
+    auto n = cg.size();
+    if (src >= n)
+        throw graph_algorithm_exception{"node_id out of range"};
+
+    using bitmap = std::vector<std::atomic<uint64_t>>;
+    auto num_words = (n + 63) / 64;
+    bitmap visited(num_words);
+    bitmap frontier(num_words);
+    bitmap next(num_words);
+    for (uint64_t w = 0; w < num_words; ++w)
+    {
+        visited[w] = 0;
+        frontier[w] = 0;
+        next[w] = 0;
+    }
+    auto bit = [](uint64_t id)
+    {
+        return uint64_t{1} << (id % 64);
+    };
+
+    std::vector<uint64_t> dist(n, unreachable);
+    dist[src] = 0;
+    visited[src / 64] |= bit(src);
+    frontier[src / 64] |= bit(src);
+
+    auto& pool = parallel::default_pool();
+    auto unexplored_edges = internal::parallel_sum<uint64_t>(
+        pool, n, [&](uint64_t begin, uint64_t end)
+        {
+            uint64_t total = 0;
+            for (auto i = begin; i < end; ++i)
+                total += cg.adjacent(node_id{i}).size();
+            return total;
+        });
+
+    // the thresholds for switching direction suggested by Beamer et al.
+    const uint64_t alpha = 14;
+    const uint64_t beta = 24;
+
+    internal::frontier_stats stats;
+    stats.nodes = 1;
+    stats.edges = cg.adjacent(src).size();
+    unexplored_edges -= stats.edges;
+    bool bottom_up = false;
+    for (uint64_t level = 1; stats.nodes > 0; ++level)
+    {
+        if (!bottom_up && stats.edges > unexplored_edges / alpha)
+            bottom_up = true;
+        else if (bottom_up && stats.nodes < n / beta)
+            bottom_up = false;
+
+        stats = internal::parallel_sum<internal::frontier_stats>(
+            pool, n, [&](uint64_t begin, uint64_t end)
+            {
+                internal::frontier_stats found;
+                if (bottom_up)
+                {
+                    // a block owns the words of its nodes, so only reads
+                    // of the frontier are shared
+                    for (auto i = begin; i < end; ++i)
+                    {
+                        if (visited[i / 64].load(std::memory_order_relaxed)
+                            & bit(i))
+                            continue;
+
+                        for (const auto& in : cg.incoming(node_id{i}))
+                        {
+                            auto parent = in.first;
+                            if (!(frontier[parent / 64].load(
+                                      std::memory_order_relaxed)
+                                  & bit(parent)))
+                                continue;
+
+                            dist[i] = level;
+                            visited[i / 64].fetch_or(
+                                bit(i), std::memory_order_relaxed);
+                            next[i / 64].fetch_or(bit(i),
+                                                  std::memory_order_relaxed);
+                            ++found.nodes;
+                            found.edges += cg.adjacent(node_id{i}).size();
+                            break;
+                        }
+                    }
+                }
+                else
+                {
+                    // the first thread to set a node's visited bit claims
+                    // it
+                    for (auto w = begin / 64; w < (end + 63) / 64; ++w)
+                    {
+                        auto bits = frontier[w].load(std::memory_order_relaxed);
+                        while (bits)
+                        {
+                            auto i = w * 64 + __builtin_ctzll(bits);
+                            bits &= bits - 1;
+                            for (const auto& out : cg.adjacent(node_id{i}))
+                            {
+                                auto child = out.first;
+                                auto& word = visited[child / 64];
+                                if (word.load(std::memory_order_relaxed)
+                                    & bit(child))
+                                    continue;
+                                if (word.fetch_or(bit(child),
+                                                  std::memory_order_relaxed)
+                                    & bit(child))
+                                    continue;
+
+                                dist[child] = level;
+                                next[child / 64].fetch_or(
+                                    bit(child), std::memory_order_relaxed);
+                                ++found.nodes;
+                                found.edges += cg.adjacent(child).size();
+                            }
+                        }
+                    }
+                }
+                return found;
+            });
+
+        frontier.swap(next);
+        for (auto& word : next)
+            word.store(0, std::memory_order_relaxed);
+        unexplored_edges -= stats.edges;
+    }
+
+    return dist;
+}
+
+template <class Graph>
+std::vector<std::vector<uint64_t>>
+    bfs_levels(const Graph& g, const std::vector<node_id>& sources)
+{
+    const auto& cg = internal::compressed(g);
+    auto n = cg.size();
+    for (const auto& src : sources)
+        if (src >= n)
+            throw graph_algorithm_exception{"node_id out of range"};
+
+    std::vector<std::vector<uint64_t>> dist(
+        sources.size(), std::vector<uint64_t>(n, unreachable));
+
+    // bit j of a node's words stands for the j-th source of the batch
+    std::vector<uint64_t> seen(n);
+    std::vector<uint64_t> visit(n);
+    std::vector<uint64_t> visit_next(n);
+
+    auto& pool = parallel::default_pool();
+    for (uint64_t batch = 0; batch < sources.size(); batch += 64)
+    {
+        auto batch_size = std::min<uint64_t>(64, sources.size() - batch);
+        auto all = batch_size == 64 ? ~uint64_t{0}
+                                    : (uint64_t{1} << batch_size) - 1;
+
+        std::fill(seen.begin(), seen.end(), 0);
+        std::fill(visit.begin(), visit.end(), 0);
+        for (uint64_t j = 0; j < batch_size; ++j)
+        {
+            auto src = sources[batch + j];
+            seen[src] |= uint64_t{1} << j;
+            visit[src] |= uint64_t{1} << j;
+            dist[batch + j][src] = 0;
+        }
+
+        // each node pulls the searches that reach it from the nodes with
+        // edges to it, so every thread writes only its own nodes
+        for (uint64_t level = 1;; ++level)
+        {
+            auto found = internal::parallel_sum<uint64_t>(
+                pool, n, [&](uint64_t begin, uint64_t end)
+                {
+                    uint64_t reached = 0;
+                    for (auto i = begin; i < end; ++i)
+                    {
+                        visit_next[i] = 0;
+                        if (seen[i] == all)
+                            continue;
+
+                        uint64_t bits = 0;
+                        for (const auto& in : cg.incoming(node_id{i}))
+                            bits |= visit[in.first];
+                        bits &= ~seen[i];
+                        if (!bits)
+                            continue;
+
+                        visit_next[i] = bits;
+                        seen[i] |= bits;
+                        ++reached;
+                        while (bits)
+                        {
+                            dist[batch + __builtin_ctzll(bits)][i] = level;
+                            bits &= bits - 1;
+                        }
+                    }
+                    return reached;
+                });
+
+            if (found == 0)
+                break;
+            visit.swap(visit_next);
+        }
+    }
+
+    return dist;
+}
 }
 }
 }
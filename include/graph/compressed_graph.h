@@ -0,0 +1,322 @@
+/**
+ * @file compressed_graph.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_COMPRESSED_GRAPH_H_
+#define META_COMPRESSED_GRAPH_H_
+
+#include <cstddef>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+#include "meta.h"
+#include "util/optional.h"
+#include "graph/default_node.h"
+#include "graph/default_edge.h"
+#include "graph/directed_graph.h"
+#include "graph/undirected_graph.h"
+
+namespace meta
+{
+namespace graph
+{
+/**
+ * An immutable graph in compressed sparse row form. The neighbors of every
+ * node are stored in one contiguous array, sorted by id within each node's
+ * row, and the edge objects in a second array parallel to it, so that
+ * traversals read memory in order instead of following a pointer per
+ * node. The graph can be built from a directed_graph, an
+ * undirected_graph, or a list of edges, and can be passed to any of the
+ * graph::algorithms that do not modify the graph.
+ *
+ * As in undirected_graph, each edge of an undirected graph appears in the
+ * rows of both of its nodes. A directed graph also keeps its transpose,
+ * so that the edges entering a node are as cheap to visit as those
+ * leaving it.
+ */
+template <class Node = default_node, class Edge = default_edge>
+class compressed_graph
+{
+  public:
+    /**
+     * The neighbors of one node, as (node_id, Edge) pairs. The range
+     * refers into the graph, which must outlive it.
+     */
+    class adjacency_range
+    {
+      public:
+        /// A neighbor and the edge connecting to it
+        using value_type = std::pair<node_id, const Edge&>;
+
+        class iterator
+            : public std::iterator<std::forward_iterator_tag, value_type>
+        {
+          public:
+            iterator(const node_id* id, const Edge* edge)
+                : id_{id}, edge_{edge}
+            {
+            }
+
+            iterator& operator++()
+            {
+                ++id_;
+                ++edge_;
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator saved{*this};
+                ++(*this);
+                return saved;
+            }
+
+            value_type operator*() const
+            {
+                return {*id_, *edge_};
+            }
+
+            friend bool operator==(const iterator& lhs, const iterator& rhs)
+            {
+                return lhs.id_ == rhs.id_;
+            }
+
+            friend bool operator!=(const iterator& lhs, const iterator& rhs)
+            {
+                return !(lhs == rhs);
+            }
+
+          private:
+            const node_id* id_;
+            const Edge* edge_;
+        };
+
+        adjacency_range(const node_id* ids, const Edge* edges, uint64_t size)
+            : ids_{ids}, edges_{edges}, size_{size}
+        {
+        }
+
+        iterator begin() const
+        {
+            return {ids_, edges_};
+        }
+
+        iterator end() const
+        {
+            return {ids_ + size_, edges_ + size_};
+        }
+
+        /**
+         * @param idx The position of a neighbor in the row
+         * @return the neighbor and the edge connecting to it
+         */
+        value_type operator[](uint64_t idx) const
+        {
+            return {ids_[idx], edges_[idx]};
+        }
+
+        /**
+         * @return the number of neighbors
+         */
+        uint64_t size() const
+        {
+            return size_;
+        }
+
+        /**
+         * @return whether the node has no neighbors
+         */
+        bool empty() const
+        {
+            return size_ == 0;
+        }
+
+      private:
+        const node_id* ids_;
+        const Edge* edges_;
+        uint64_t size_;
+    };
+
+    using const_iterator = typename std::vector<Node>::const_iterator;
+
+    /**
+     * Compresses a directed graph; each node's row holds its outgoing
+     * edges.
+     * @param g The graph to compress
+     */
+    explicit compressed_graph(const directed_graph<Node, Edge>& g);
+
+    /**
+     * Compresses an undirected graph.
+     * @param g The graph to compress
+     */
+    explicit compressed_graph(const undirected_graph<Node, Edge>& g);
+
+    /**
+     * Builds a graph from a list of edges. Each edge's src and dest fields
+     * must hold the ids (positions) of the nodes it connects.
+     * @param nodes The nodes; their ids are set to their positions
+     * @param edges The edges
+     * @param directed Whether each edge only leads from its src to its
+     * dest; if not, it is added to the rows of both nodes
+     */
+    compressed_graph(std::vector<Node> nodes, const std::vector<Edge>& edges,
+                     bool directed = true);
+
+    /**
+     * Adopts rows that are already in compressed sparse row form, as
+     * produced by the parallel graph generators.
+     * @param nodes The nodes; their ids are set to their positions
+     * @param offsets The start of each node's row in neighbors, plus the
+     * end of the last row
+     * @param neighbors The neighbors, row after row; each row must be
+     * sorted without repeats, and for an undirected graph each edge must
+     * be in the rows of both of its nodes
+     * @param edges The edge to each neighbor
+     * @param directed Whether the graph is directed
+     */
+    compressed_graph(std::vector<Node> nodes, std::vector<uint64_t> offsets,
+                     std::vector<node_id> neighbors, std::vector<Edge> edges,
+                     bool directed);
+
+    /**
+     * @param id
+     * @return the Node object that the id represents
+     */
+    const Node& node(node_id id) const;
+
+    /**
+     * @param source
+     * @param dest
+     * @return an optional edge connecting source and dest
+     */
+    util::optional<Edge> edge(node_id source, node_id dest) const;
+
+    /**
+     * @param id The node id to get adjacent nodes to
+     * @return the edges leaving the node and the node_ids they lead to,
+     * in increasing order of node_id
+     */
+    adjacency_range adjacent(node_id id) const;
+
+    /**
+     * @param id The node id to get incoming nodes to
+     * @return the edges entering the node and the node_ids they come
+     * from, in increasing order of node_id; for an undirected graph, the
+     * same as adjacent(id)
+     */
+    adjacency_range incoming(node_id id) const;
+
+    /**
+     * @return whether the graph is directed
+     */
+    bool directed() const
+    {
+        return directed_;
+    }
+
+    /**
+     * @return the size of this graph (number of nodes), which is the
+     * range for a valid node_id
+     */
+    uint64_t size() const
+    {
+        return nodes_.size();
+    }
+
+    /**
+     * @return the number of edges in the graph
+     */
+    uint64_t num_edges() const
+    {
+        return num_edges_;
+    }
+
+    /**
+     * @return an iterator to the beginning ("first" node) of this graph
+     */
+    const_iterator begin() const
+    {
+        return nodes_.cbegin();
+    }
+
+    /**
+     * @return an iterator that represents one past the last node of this
+     * graph
+     */
+    const_iterator end() const
+    {
+        return nodes_.cend();
+    }
+
+  private:
+    /**
+     * Copies the nodes and adjacency lists of another graph.
+     * @param g The graph to compress
+     */
+    template <class Graph>
+    void compress(const Graph& g);
+
+    /**
+     * Fills the neighbor and edge arrays from (node_id, Edge) pairs
+     * grouped by row, once offsets_ holds the start of every row. The
+     * rows are sorted by node_id.
+     * @param entries The neighbors of every node, row after row
+     */
+    void fill(std::vector<std::pair<node_id, Edge>>& entries);
+
+    /**
+     * Builds the rows of incoming edges of a directed graph from its rows
+     * of outgoing edges.
+     */
+    void transpose();
+
+    /// The nodes, indexed by id
+    std::vector<Node> nodes_;
+
+    /// The start of each node's row in neighbors_ and edges_, plus the end
+    /// of the last row
+    std::vector<uint64_t> offsets_;
+
+    /// The neighbors of every node, row after row
+    std::vector<node_id> neighbors_;
+
+    /// The edge leading to each entry of neighbors_
+    std::vector<Edge> edges_;
+
+    /// The start of each node's row in in_neighbors_ and in_edges_, for a
+    /// directed graph
+    std::vector<uint64_t> in_offsets_;
+
+    /// The nodes with an edge to each node, row after row, for a directed
+    /// graph
+    std::vector<node_id> in_neighbors_;
+
+    /// The edge coming from each entry of in_neighbors_
+    std::vector<Edge> in_edges_;
+
+    /// The number of edges in the graph
+    uint64_t num_edges_ = 0;
+
+    /// Whether the graph is directed
+    bool directed_;
+};
+
+/**
+ * Basic exception for compressed_graph interactions.
+ */
+class compressed_graph_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#include "graph/compressed_graph.tcc"
+#endif
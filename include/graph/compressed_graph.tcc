@@ -0,0 +1,224 @@
+/**
+ * @file compressed_graph.tcc
+ */
+
+#include <algorithm>
+#include <numeric>
+
+namespace meta
+{
+namespace graph
+{
+template <class Node, class Edge>
+compressed_graph<Node, Edge>::compressed_graph(
+    const directed_graph<Node, Edge>& g)
+    : directed_{true}
+{
+    compress(g);
+    transpose();
+}
+
+template <class Node, class Edge>
+compressed_graph<Node, Edge>::compressed_graph(
+    const undirected_graph<Node, Edge>& g)
+    : directed_{false}
+{
+    compress(g);
+}
+
+template <class Node, class Edge>
+compressed_graph<Node, Edge>::compressed_graph(std::vector<Node> nodes,
+                                               const std::vector<Edge>& edges,
+                                               bool directed /* = true */)
+    : nodes_(std::move(nodes)),
+      offsets_(nodes_.size() + 1, 0),
+      directed_{directed}
+{
+    for (uint64_t i = 0; i < nodes_.size(); ++i)
+        nodes_[i].id = node_id{i};
+
+    // count the entries of each row, shifted by one so that the prefix sum
+    // leaves the start of each row in offsets_
+    for (const auto& e : edges)
+    {
+        if (e.src >= size() || e.dest >= size())
+            throw compressed_graph_exception{"node_id out of range"};
+        if (!directed && e.src == e.dest)
+            throw compressed_graph_exception{"can not create self-loops"};
+
+        ++offsets_[e.src + 1];
+        if (!directed)
+            ++offsets_[e.dest + 1];
+    }
+    std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+
+    std::vector<std::pair<node_id, Edge>> entries(offsets_.back());
+    std::vector<uint64_t> next(offsets_.begin(), offsets_.end() - 1);
+    for (const auto& e : edges)
+    {
+        entries[next[e.src]++] = {e.dest, e};
+        if (!directed)
+            entries[next[e.dest]++] = {e.src, e};
+    }
+
+    num_edges_ = edges.size();
+    fill(entries);
+    if (directed)
+        transpose();
+}
+
+template <class Node, class Edge>
+compressed_graph<Node, Edge>::compressed_graph(std::vector<Node> nodes,
+                                               std::vector<uint64_t> offsets,
+                                               std::vector<node_id> neighbors,
+                                               std::vector<Edge> edges,
+                                               bool directed)
+    : nodes_(std::move(nodes)),
+      offsets_(std::move(offsets)),
+      neighbors_(std::move(neighbors)),
+      edges_(std::move(edges)),
+      directed_{directed}
+{
+    if (offsets_.size() != nodes_.size() + 1
+        || offsets_.back() != neighbors_.size()
+        || edges_.size() != neighbors_.size())
+        throw compressed_graph_exception{"malformed compressed rows"};
+
+    for (uint64_t i = 0; i < nodes_.size(); ++i)
+        nodes_[i].id = node_id{i};
+
+    num_edges_ = directed_ ? neighbors_.size() : neighbors_.size() / 2;
+    if (directed_)
+        transpose();
+}
+
+template <class Node, class Edge>
+template <class Graph>
+void compressed_graph<Node, Edge>::compress(const Graph& g)
+{
+    nodes_.reserve(g.size());
+    offsets_.reserve(g.size() + 1);
+    offsets_.push_back(0);
+
+    std::vector<std::pair<node_id, Edge>> entries;
+    for (uint64_t i = 0; i < g.size(); ++i)
+    {
+        nodes_.push_back(g.node(node_id{i}));
+        const auto& adj = g.adjacent(node_id{i});
+        entries.insert(entries.end(), adj.begin(), adj.end());
+        offsets_.push_back(entries.size());
+    }
+
+    num_edges_ = g.num_edges();
+    fill(entries);
+}
+
+template <class Node, class Edge>
+void compressed_graph<Node, Edge>::fill(
+    std::vector<std::pair<node_id, Edge>>& entries)
+{
+    using pair_t = std::pair<node_id, Edge>;
+    neighbors_.reserve(entries.size());
+    edges_.reserve(entries.size());
+    for (uint64_t i = 0; i < size(); ++i)
+    {
+        auto first = entries.begin() + offsets_[i];
+        auto last = entries.begin() + offsets_[i + 1];
+        std::sort(first, last, [](const pair_t& a, const pair_t& b)
+                  {
+            return a.first < b.first;
+        });
+
+        auto dup = std::adjacent_find(first, last,
+                                      [](const pair_t& a, const pair_t& b)
+                                      {
+            return a.first == b.first;
+        });
+        if (dup != last)
+            throw compressed_graph_exception{"attempted to add existing edge"};
+
+        for (auto it = first; it != last; ++it)
+        {
+            neighbors_.push_back(it->first);
+            edges_.push_back(std::move(it->second));
+        }
+    }
+}
+
+template <class Node, class Edge>
+void compressed_graph<Node, Edge>::transpose()
+{
+    in_offsets_.assign(size() + 1, 0);
+    for (const auto& dest : neighbors_)
+        ++in_offsets_[dest + 1];
+    std::partial_sum(in_offsets_.begin(), in_offsets_.end(),
+                     in_offsets_.begin());
+
+    // visiting the sources in order leaves each row sorted
+    in_neighbors_.resize(neighbors_.size());
+    in_edges_.resize(edges_.size());
+    std::vector<uint64_t> next(in_offsets_.begin(), in_offsets_.end() - 1);
+    for (uint64_t src = 0; src < size(); ++src)
+    {
+        for (auto i = offsets_[src]; i < offsets_[src + 1]; ++i)
+        {
+            auto pos = next[neighbors_[i]]++;
+            in_neighbors_[pos] = node_id{src};
+            in_edges_[pos] = edges_[i];
+        }
+    }
+}
+
+template <class Node, class Edge>
+const Node& compressed_graph<Node, Edge>::node(node_id id) const
+{
+    if (id >= size())
+        throw compressed_graph_exception{"node_id out of range"};
+
+    return nodes_[id];
+}
+
+template <class Node, class Edge>
+util::optional<Edge> compressed_graph<Node, Edge>::edge(node_id source,
+                                                        node_id dest) const
+{
+    if (source >= size() || dest >= size())
+        throw compressed_graph_exception{"node_id out of range"};
+
+    // rows are sorted, so the neighbor can be found by binary search
+    auto first = neighbors_.begin() + offsets_[source];
+    auto last = neighbors_.begin() + offsets_[source + 1];
+    auto it = std::lower_bound(first, last, dest);
+    if (it != last && *it == dest)
+        return util::optional<Edge>{edges_[it - neighbors_.begin()]};
+
+    return util::optional<Edge>{util::nullopt};
+}
+
+template <class Node, class Edge>
+auto compressed_graph<Node, Edge>::adjacent(node_id id) const
+    -> adjacency_range
+{
+    if (id >= size())
+        throw compressed_graph_exception{"node_id out of range"};
+
+    auto begin = offsets_[id];
+    return {neighbors_.data() + begin, edges_.data() + begin,
+            offsets_[id + 1] - begin};
+}
+template <class Node, class Edge>
+auto compressed_graph<Node, Edge>::incoming(node_id id) const
+    -> adjacency_range
+{
+    if (!directed_)
+        return adjacent(id);
+
+    if (id >= size())
+        throw compressed_graph_exception{"node_id out of range"};
+
+    auto begin = in_offsets_[id];
+    return {in_neighbors_.data() + begin, in_edges_.data() + begin,
+            in_offsets_[id + 1] - begin};
+}
+}
+}
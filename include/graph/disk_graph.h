@@ -0,0 +1,367 @@
+/**
+ * @file disk_graph.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_DISK_GRAPH_H_
+#define META_DISK_GRAPH_H_
+
+#include <iterator>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include "meta.h"
+#include "util/disk_vector.h"
+#include "util/optional.h"
+#include "graph/compressed_graph.h"
+#include "graph/default_node.h"
+#include "graph/default_edge.h"
+
+namespace meta
+{
+namespace graph
+{
+/**
+ * A read-only graph stored on disk in compressed sparse row form. Its
+ * files are memory-mapped when the graph is loaded, so that loading does
+ * no parsing and graphs larger than memory can be used; pages are read as
+ * the graph is traversed.
+ *
+ * The files hold each node's row of neighbor ids, sorted, the offsets of
+ * the rows and, optionally, a weight for every edge; a directed graph also
+ * holds its transpose. Node labels and any other edge data are not kept:
+ * nodes are default_nodes with empty labels and edges are default_edges.
+ * A graph is written once from a compressed_graph, with save().
+ *
+ * A disk_graph can be passed to any of the graph::algorithms that do not
+ * modify the graph.
+ */
+class disk_graph
+{
+  public:
+    /**
+     * The neighbors of one node, as (node_id, default_edge) pairs. The
+     * range refers into the graph, which must outlive it.
+     */
+    class adjacency_range
+    {
+      public:
+        /// A neighbor and the edge connecting to it
+        using value_type = std::pair<node_id, default_edge>;
+
+        class iterator
+            : public std::iterator<std::forward_iterator_tag, value_type>
+        {
+          public:
+            iterator(const adjacency_range* range, uint64_t idx)
+                : range_{range}, idx_{idx}
+            {
+            }
+
+            iterator& operator++()
+            {
+                ++idx_;
+                return *this;
+            }
+
+            iterator operator++(int)
+            {
+                iterator saved{*this};
+                ++(*this);
+                return saved;
+            }
+
+            value_type operator*() const
+            {
+                return (*range_)[idx_];
+            }
+
+            friend bool operator==(const iterator& lhs, const iterator& rhs)
+            {
+                return lhs.idx_ == rhs.idx_;
+            }
+
+            friend bool operator!=(const iterator& lhs, const iterator& rhs)
+            {
+                return !(lhs == rhs);
+            }
+
+          private:
+            const adjacency_range* range_;
+            uint64_t idx_;
+        };
+
+        /**
+         * @param id The node whose row this is
+         * @param ids The neighbors
+         * @param weights The weights of the edges, or nullptr
+         * @param size The number of neighbors
+         * @param incoming Whether the edges lead from the neighbors to the
+         * node rather than the other way
+         */
+        adjacency_range(node_id id, const node_id* ids, const double* weights,
+                        uint64_t size, bool incoming);
+
+        iterator begin() const
+        {
+            return {this, 0};
+        }
+
+        iterator end() const
+        {
+            return {this, size_};
+        }
+
+        /**
+         * @param idx The position of a neighbor in the row
+         * @return the neighbor and the edge connecting to it
+         */
+        value_type operator[](uint64_t idx) const;
+
+        /**
+         * @return the number of neighbors
+         */
+        uint64_t size() const
+        {
+            return size_;
+        }
+
+        /**
+         * @return whether the node has no neighbors
+         */
+        bool empty() const
+        {
+            return size_ == 0;
+        }
+
+      private:
+        node_id id_;
+        const node_id* ids_;
+        const double* weights_;
+        uint64_t size_;
+        bool incoming_;
+    };
+
+    /**
+     * Iterates over the nodes of the graph, which are made as they are
+     * visited.
+     */
+    class const_iterator
+        : public std::iterator<std::forward_iterator_tag, default_node>
+    {
+      public:
+        const_iterator(node_id id) : id_{id}
+        {
+        }
+
+        const_iterator& operator++()
+        {
+            id_ = node_id{id_ + 1};
+            return *this;
+        }
+
+        const_iterator operator++(int)
+        {
+            const_iterator saved{*this};
+            ++(*this);
+            return saved;
+        }
+
+        default_node operator*() const;
+
+        friend bool operator==(const const_iterator& lhs,
+                               const const_iterator& rhs)
+        {
+            return lhs.id_ == rhs.id_;
+        }
+
+        friend bool operator!=(const const_iterator& lhs,
+                               const const_iterator& rhs)
+        {
+            return !(lhs == rhs);
+        }
+
+      private:
+        node_id id_;
+    };
+
+    /**
+     * Memory-maps a graph written by save().
+     * @param prefix The directory the graph was saved in
+     */
+    disk_graph(const std::string& prefix);
+
+    /**
+     * @param prefix A directory
+     * @return whether a graph has been saved in it
+     */
+    static bool exists(const std::string& prefix);
+
+    /**
+     * Writes a graph to disk.
+     * @param g The graph to write
+     * @param prefix The directory to write it in, which is created if
+     * needed
+     * @param weighted Whether to keep the weight of each edge, which Edge
+     * must then have
+     */
+    template <class Node, class Edge>
+    static void save(const compressed_graph<Node, Edge>& g,
+                     const std::string& prefix, bool weighted = false);
+
+    /**
+     * @param id
+     * @return the node the id represents
+     */
+    default_node node(node_id id) const;
+
+    /**
+     * @param source
+     * @param dest
+     * @return an optional edge connecting source and dest
+     */
+    util::optional<default_edge> edge(node_id source, node_id dest) const;
+
+    /**
+     * @param id The node id to get adjacent nodes to
+     * @return the edges leaving the node and the node_ids they lead to,
+     * in increasing order of node_id
+     */
+    adjacency_range adjacent(node_id id) const;
+
+    /**
+     * @param id The node id to get incoming nodes to
+     * @return the edges entering the node and the node_ids they come
+     * from, in increasing order of node_id; for an undirected graph, the
+     * same as adjacent(id)
+     */
+    adjacency_range incoming(node_id id) const;
+
+    /**
+     * @return whether the graph is directed
+     */
+    bool directed() const
+    {
+        return directed_;
+    }
+
+    /**
+     * @return whether the edges have weights; if not, every edge has
+     * weight 0
+     */
+    bool weighted() const
+    {
+        return weighted_;
+    }
+
+    /**
+     * @return the size of this graph (number of nodes), which is the
+     * range for a valid node_id
+     */
+    uint64_t size() const
+    {
+        return out_.offsets->size() - 1;
+    }
+
+    /**
+     * @return the number of edges in the graph
+     */
+    uint64_t num_edges() const
+    {
+        return num_edges_;
+    }
+
+    /**
+     * @return an iterator to the beginning ("first" node) of this graph
+     */
+    const_iterator begin() const
+    {
+        return {node_id{0}};
+    }
+
+    /**
+     * @return an iterator that represents one past the last node of this
+     * graph
+     */
+    const_iterator end() const
+    {
+        return {node_id{size()}};
+    }
+
+    /**
+     * Reads every page of the graph into memory now, so that later
+     * traversals do not fault.
+     */
+    void prefault() const;
+
+  private:
+    /// The rows of neighbors of every node, one way along the edges
+    struct rows
+    {
+        /// The start of each row, plus the end of the last row
+        std::unique_ptr<util::disk_vector<uint64_t>> offsets;
+        /// The neighbors, row after row; null if there are none
+        std::unique_ptr<util::disk_vector<node_id>> neighbors;
+        /// The weight of the edge to each neighbor; null if unweighted
+        std::unique_ptr<util::disk_vector<double>> weights;
+    };
+
+    /**
+     * Maps the files of one set of rows.
+     * @param path The path of the files, without extension
+     * @return the rows
+     */
+    rows load_rows(const std::string& path) const;
+
+    /**
+     * @param r A set of rows
+     * @param id A node
+     * @param incoming Whether the rows hold incoming edges
+     * @return the node's row
+     */
+    adjacency_range row(const rows& r, node_id id, bool incoming) const;
+
+    /**
+     * Writes one set of rows.
+     * @param path The path of the files, without extension
+     * @param g The graph to write
+     * @param adj Gives the row of a node
+     * @param weighted Whether to write the weights
+     */
+    template <class Graph, class Adjacent>
+    static void save_rows(const std::string& path, const Graph& g,
+                          Adjacent&& adj, bool weighted);
+
+    /// The rows of outgoing edges
+    rows out_;
+
+    /// The rows of incoming edges, for a directed graph
+    rows in_;
+
+    /// The number of edges in the graph
+    uint64_t num_edges_;
+
+    /// Whether the graph is directed
+    bool directed_;
+
+    /// Whether the edges have weights
+    bool weighted_;
+};
+
+/**
+ * Basic exception for disk_graph interactions.
+ */
+class disk_graph_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#include "graph/disk_graph.tcc"
+#endif
@@ -0,0 +1,78 @@
+/**
+ * @file disk_graph.tcc
+ */
+
+#include <fstream>
+#include "io/binary.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace graph
+{
+template <class Node, class Edge>
+void disk_graph::save(const compressed_graph<Node, Edge>& g,
+                      const std::string& prefix, bool weighted /* = false */)
+{
+    filesystem::make_directory(prefix);
+    filesystem::delete_file(prefix + "/graph.meta");
+
+    save_rows(prefix + "/out", g, [&](node_id id)
+              {
+                  return g.adjacent(id);
+              },
+              weighted);
+    if (g.directed())
+    {
+        save_rows(prefix + "/in", g, [&](node_id id)
+                  {
+                      return g.incoming(id);
+                  },
+                  weighted);
+    }
+
+    // the header is written last, so that a graph whose writing was
+    // interrupted is not taken to exist
+    std::ofstream header{prefix + "/graph.meta", std::ios::binary};
+    io::write_binary(header, static_cast<uint8_t>(g.directed()));
+    io::write_binary(header, static_cast<uint8_t>(weighted));
+    io::write_binary(header, g.num_edges());
+}
+
+template <class Graph, class Adjacent>
+void disk_graph::save_rows(const std::string& path, const Graph& g,
+                           Adjacent&& adj, bool weighted)
+{
+    // disk_vector does not shrink existing files
+    for (const auto& ext : {".offsets", ".neighbors", ".weights"})
+        filesystem::delete_file(path + ext);
+
+    util::disk_vector<uint64_t> offsets{path + ".offsets", g.size() + 1};
+    offsets[0] = 0;
+    for (uint64_t i = 0; i < g.size(); ++i)
+        offsets[i + 1] = offsets[i] + adj(node_id{i}).size();
+
+    auto num_entries = offsets[g.size()];
+    if (num_entries == 0)
+        return;
+
+    util::disk_vector<node_id> neighbors{path + ".neighbors", num_entries};
+    std::unique_ptr<util::disk_vector<double>> weights;
+    if (weighted)
+        weights = make_unique<util::disk_vector<double>>(path + ".weights",
+                                                         num_entries);
+
+    uint64_t pos = 0;
+    for (uint64_t i = 0; i < g.size(); ++i)
+    {
+        for (const auto& p : adj(node_id{i}))
+        {
+            neighbors[pos] = p.first;
+            if (weights)
+                (*weights)[pos] = p.second.weight;
+            ++pos;
+        }
+    }
+}
+}
+}
@@ -11,6 +11,12 @@
 #define META_CACHED_INDEX_H_
 
 #include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "caching/cache_stats.h"
+#include "util/memory_usage.h"
 
 namespace cpptoml
 {
@@ -22,11 +28,48 @@ namespace meta
 namespace index
 {
 
+/**
+ * Keeps the postings in the cache of a cached_index as they are read, so
+ * that a hit returns the cached postings_data itself. This is the fastest
+ * way to cache postings, but the one that takes the most memory; see
+ * compact_cache_values for the other.
+ */
+template <class PostingsData>
+struct shared_cache_values
+{
+    /// What the cache holds
+    using value_type = std::shared_ptr<PostingsData>;
+
+    /**
+     * @param pdata The postings read from the index
+     * @return the value to keep in the cache
+     */
+    static value_type store(const std::shared_ptr<PostingsData>& pdata)
+    {
+        return pdata;
+    }
+
+    /**
+     * @param value A value from the cache
+     * @return its postings
+     */
+    static std::shared_ptr<PostingsData> load(const value_type& value)
+    {
+        return value;
+    }
+};
+
 /**
  * Decorator class for wrapping indexes with a cache. Like other indexes,
  * you shouldn't construct this directly, but rather use make_index().
+ *
+ * The Values policy decides the form the postings take in the cache: the
+ * default keeps the postings_data objects themselves, and
+ * compact_cache_values keeps a compressed copy that is decoded on each
+ * hit, to fit more postings in the same memory.
  */
-template <class Index, template <class, class> class Cache>
+template <class Index, template <class, class> class Cache,
+          template <class> class Values = shared_cache_values>
 class cached_index : public Index
 {
   public:
@@ -61,17 +104,98 @@ class cached_index : public Index
     virtual std::shared_ptr<postings_data_type>
         search_primary(primary_key_type p_id) const override;
 
+    /**
+     * @return true: the postings of the index are read through the cache
+     */
+    virtual bool caches_postings() const override;
+
     /**
      * Clears the cache for the index. Useful if you're using something
      * like no-evict cache and want to reclaim memory.
      */
     void clear_cache();
 
+    /**
+     * @return the activity of the cache so far, including the time spent
+     * reading postings that were not in it
+     */
+    caching::cache_stats cache_stats() const;
+
+    /**
+     * @return the memory used by each component of the index, including
+     * the postings held in the cache
+     */
+    virtual util::memory_report memory_usage() const override;
+
+    /**
+     * Loads the postings of some keys into the cache before they are
+     * searched for, so that the first queries after startup do not pay
+     * to decode them. The postings are read in parallel and then
+     * inserted from the last key to the first, so a cache that evicts
+     * the least recently used keys keeps the first ones longest.
+     *
+     * @param keys The keys to load, hottest first
+     * @param num_threads The number of threads to read postings with
+     */
+    void warm_cache(const std::vector<primary_key_type>& keys,
+                    uint64_t num_threads
+                    = std::thread::hardware_concurrency());
+
+    /**
+     * @return the keys currently in the cache, roughly the most recently
+     * used first
+     */
+    std::vector<primary_key_type> cached_keys() const;
+
+    /**
+     * Writes the keys currently in the cache to a file, one per line,
+     * so that a restarted process can warm its cache with the same keys
+     * using load_cache_keys().
+     *
+     * @param filename The file to write
+     */
+    void save_cache_keys(const std::string& filename) const;
+
+    /**
+     * Warms the cache with the keys saved by save_cache_keys(). The keys
+     * must have been saved from the same index.
+     *
+     * @param filename The file to read
+     * @param num_threads The number of threads to read postings with
+     * @return the number of keys loaded, or zero if the file does not
+     * exist
+     */
+    uint64_t load_cache_keys(const std::string& filename,
+                             uint64_t num_threads
+                             = std::thread::hardware_concurrency());
+
+    /**
+     * Warms the cache with the terms cached by another version of the
+     * index, such as the one a rebuilt index replaces (see index_handle).
+     * Term ids differ between versions, so the terms are matched by their
+     * text, and their postings are read from this index; terms it lacks
+     * are skipped. Only for inverted indexes.
+     *
+     * @param previous The other version of the index
+     * @param num_threads The number of threads to read postings with
+     * @return the number of terms loaded
+     */
+    template <class OtherIndex>
+    uint64_t warm_from(const OtherIndex& previous,
+                       uint64_t num_threads
+                       = std::thread::hardware_concurrency());
+
   private:
     /**
      * The internal cache object.
      */
-    mutable Cache<primary_key_type, std::shared_ptr<postings_data_type>> cache_;
+    mutable Cache<primary_key_type,
+                  typename Values<postings_data_type>::value_type> cache_;
+
+    /**
+     * The time spent reading postings that were not in the cache.
+     */
+    mutable caching::cache_counters decode_counters_;
 };
 }
 }
@@ -3,37 +3,165 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+
 #include "index/cached_index.h"
+#include "parallel/thread_pool.h"
+#include "util/filesystem.h"
 
 namespace meta
 {
 namespace index
 {
 
-template <class Index, template <class, class> class Cache>
+template <class Index, template <class, class> class Cache,
+          template <class> class Values>
 template <class... Args>
-cached_index<Index, Cache>::cached_index(cpptoml::table& config, Args&&... args)
+cached_index<Index, Cache, Values>::cached_index(cpptoml::table& config,
+                                                 Args&&... args)
     : Index{config}, cache_(std::forward<Args>(args)...)
 {
     /* nothing */
 }
 
-template <class Index, template <class, class> class Cache>
-auto cached_index<Index, Cache>::search_primary(
+template <class Index, template <class, class> class Cache,
+          template <class> class Values>
+auto cached_index<Index, Cache, Values>::search_primary(
     primary_key_type p_id) const -> std::shared_ptr<postings_data_type>
 {
     auto opt = cache_.find(p_id);
     if (opt)
-        return *opt;
+        return Values<postings_data_type>::load(*opt);
+    auto start = std::chrono::steady_clock::now();
     auto result = Index::search_primary(p_id);
-    cache_.insert(p_id, result);
+    decode_counters_.decode_time(std::chrono::steady_clock::now() - start);
+    cache_.insert(p_id, Values<postings_data_type>::store(result));
     return result;
 }
 
-template <class Index, template <class, class> class Cache>
-void cached_index<Index, Cache>::clear_cache()
+template <class Index, template <class, class> class Cache,
+          template <class> class Values>
+bool cached_index<Index, Cache, Values>::caches_postings() const
+{
+    return true;
+}
+
+template <class Index, template <class, class> class Cache,
+          template <class> class Values>
+void cached_index<Index, Cache, Values>::clear_cache()
 {
     cache_.clear();
 }
+
+template <class Index, template <class, class> class Cache,
+          template <class> class Values>
+caching::cache_stats cached_index<Index, Cache, Values>::cache_stats() const
+{
+    auto stats = cache_.stats();
+    stats.decode_time = decode_counters_.stats().decode_time;
+    return stats;
+}
+
+template <class Index, template <class, class> class Cache,
+          template <class> class Values>
+util::memory_report cached_index<Index, Cache, Values>::memory_usage() const
+{
+    auto report = Index::memory_usage();
+    util::memory_usage cached;
+    cached.heap_bytes = cache_.stats().bytes;
+    report.add("postings-cache", cached);
+    return report;
+}
+
+template <class Index, template <class, class> class Cache,
+          template <class> class Values>
+void cached_index<Index, Cache, Values>::warm_cache(
+    const std::vector<primary_key_type>& keys, uint64_t num_threads)
+{
+    if (keys.empty())
+        return;
+
+    std::vector<std::shared_ptr<postings_data_type>> postings(keys.size());
+    std::atomic<uint64_t> next{0};
+    auto worker = [&]()
+    {
+        for (auto i = next++; i < keys.size(); i = next++)
+            postings[i] = Index::search_primary(keys[i]);
+    };
+
+    num_threads = std::max<uint64_t>(
+        1, std::min<uint64_t>(num_threads, keys.size()));
+    parallel::thread_pool pool{num_threads};
+    std::vector<std::future<void>> futures;
+    for (uint64_t i = 0; i < num_threads; ++i)
+        futures.push_back(pool.submit_task(worker));
+    for (auto& fut : futures)
+        fut.get();
+
+    for (uint64_t i = keys.size(); i > 0; --i)
+        cache_.insert(keys[i - 1],
+                      Values<postings_data_type>::store(postings[i - 1]));
+}
+
+template <class Index, template <class, class> class Cache,
+          template <class> class Values>
+auto cached_index<Index, Cache, Values>::cached_keys() const
+    -> std::vector<primary_key_type>
+{
+    return cache_.keys();
+}
+
+template <class Index, template <class, class> class Cache,
+          template <class> class Values>
+void cached_index<Index, Cache, Values>::save_cache_keys(
+    const std::string& filename) const
+{
+    // write to a temporary file first, so that a crash never leaves a
+    // partially written key list behind
+    {
+        std::ofstream out{filename + ".tmp"};
+        for (const auto& key : cached_keys())
+            out << static_cast<uint64_t>(key) << "\n";
+    }
+    filesystem::rename_file(filename + ".tmp", filename);
+}
+
+template <class Index, template <class, class> class Cache,
+          template <class> class Values>
+uint64_t cached_index<Index, Cache, Values>::load_cache_keys(
+    const std::string& filename, uint64_t num_threads)
+{
+    std::ifstream in{filename};
+    std::vector<primary_key_type> keys;
+    uint64_t key;
+    while (in >> key)
+        keys.push_back(primary_key_type{key});
+    warm_cache(keys, num_threads);
+    return keys.size();
+}
+
+template <class Index, template <class, class> class Cache,
+          template <class> class Values>
+template <class OtherIndex>
+uint64_t
+    cached_index<Index, Cache, Values>::warm_from(const OtherIndex& previous,
+                                                  uint64_t num_threads)
+{
+    std::vector<std::string> terms;
+    for (const auto& key : previous.cached_keys())
+        terms.push_back(previous.term_text(key));
+
+    std::vector<primary_key_type> keys;
+    for (const auto& t_id : this->get_term_ids(terms))
+    {
+        if (t_id < this->unique_terms())
+            keys.push_back(t_id);
+    }
+    warm_cache(keys, num_threads);
+    return keys.size();
+}
 }
 }
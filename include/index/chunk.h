@@ -12,6 +12,8 @@
 
 #include <cstdint>
 #include <string>
+#include <utility>
+#include <vector>
 
 namespace meta
 {
@@ -20,25 +22,26 @@ namespace index
 
 /**
  * Represents a portion of a disk_index's postings file. It is an intermediate
- * file mapping primary keys to secondary keys. The chunks are sorted to enable
- * efficient merging, and define an operator< to allow them to be sorted or
- * stored in a priority queue.
+ * file mapping primary keys to secondary keys, sorted by primary key so that
+ * any number of chunks can be merged in a single pass.
+ *
+ * A chunk also remembers a sparse sample of the primary keys it holds,
+ * together with the bit offsets they were written at, so that a merge can
+ * start reading it from (close to) any given key.
  */
 template <class PrimaryKey, class SecondaryKey>
 class chunk
 {
   public:
-    /**
-     * @param path The path to this chunk file on disk
-     */
-    chunk(const std::string& path);
+    /// A primary key and the bit offset of its postings in the chunk file
+    using sample_type = std::pair<PrimaryKey, uint64_t>;
 
     /**
-     * @param other The other chunk to compare with this one
-     * @return whether this chunk is less than (has a smaller size than)
-     * the parameter
+     * @param path The path to this chunk file on disk
+     * @param samples Sampled primary keys and their bit offsets, in
+     * increasing order; the first must be the first key in the file
      */
-    bool operator<(const chunk& other) const;
+    chunk(const std::string& path, std::vector<sample_type> samples = {});
 
     /**
      * @return the size of this postings file chunk in bytes
@@ -51,33 +54,26 @@ class chunk
     std::string path() const;
 
     /**
-     * After this function ends, the current chunk file will contain
-     * information from both chunks, and the "other" chunk file will be
-     * deleted.
-     * @param other The other chunk to merge merge_with
+     * @return the sampled primary keys and their bit offsets
      */
-    void merge_with(const chunk& other);
+    const std::vector<sample_type>& samples() const;
 
     /**
-     * @param pdata A collection of postings data to combine with this chunk
-     * pdata must:
-     *  - support iteration in sorted order
-     *  - dereferenced type must be a
-     *      postings_data<PrimaryKey, SecondaryKey> object
-     *  - implement the clear() function
+     * @param key The primary key to look for
+     * @return a bit offset in the chunk file at which to start reading so
+     * that no postings for primary keys not less than key are skipped
      */
-    template <class Container>
-    void memory_merge_with(Container& pdata);
+    uint64_t seek_location(const PrimaryKey& key) const;
 
   private:
-    /// Calculates the size of the file this chunk represents in bytes.
-    void set_size();
-
     /// The path to this chunk file on disk
     std::string path_;
 
     /// The number of bytes this chunk takes up
     uint64_t size_;
+
+    /// The sampled primary keys, in increasing order
+    std::vector<sample_type> samples_;
 };
 }
 }
@@ -11,15 +11,17 @@
 #define META_INDEX_CHUNK_HANDLER_H_
 
 #include <atomic>
+#include <exception>
 #include <functional>
 #include <mutex>
-#include <queue>
 #include <stdexcept>
-#include <unordered_set>
+#include <thread>
 #include <utility>
 #include <vector>
 
 #include "index/chunk.h"
+#include "index/postings_buffer.h"
+#include "parallel/bounded_queue.h"
 #include "util/optional.h"
 
 namespace meta
@@ -30,6 +32,15 @@ namespace index
 /**
  * An interface for writing and merging inverted chunks of postings_data for a
  * disk_index.
+ *
+ * All of the producers of a handler share one memory budget. The handler
+ * counts the bytes every producer's buffer holds, along with those of the
+ * full chunks waiting to be written. Once they reach the budget, the
+ * producers whose buffers are at least the average size flush them, so
+ * the chunks are as large as the budget allows however many producers
+ * there are. While a chunk is being written, the others only flush if
+ * their buffers alone reach the budget, since that chunk's memory is
+ * about to be freed.
  */
 template <class Index>
 class chunk_handler
@@ -39,6 +50,7 @@ class chunk_handler
     using primary_key_type = typename index_pdata_type::primary_key_type;
     using secondary_key_type = typename index_pdata_type::secondary_key_type;
     using chunk_t = chunk<primary_key_type, secondary_key_type>;
+    using buffer_type = postings_buffer<primary_key_type, secondary_key_type>;
 
     /**
      * The object that is fed postings_data by the index.
@@ -52,6 +64,12 @@ class chunk_handler
          */
         producer(chunk_handler* parent);
 
+        /**
+         * Move constructs a producer; the moved-from producer is left
+         * empty, so it writes nothing when destroyed.
+         */
+        producer(producer&&);
+
         /**
          * Handler for when a given secondary_key has been processed and is
          * ready to be added to the in-memory chunk.
@@ -69,28 +87,38 @@ class chunk_handler
 
       private:
         /**
-         * Flushes the current in-memory chunk to disk.
+         * Hands the current in-memory chunk to the handler's flushing
+         * threads and starts a new one.
          */
         void flush_chunk();
 
         /// Current in-memory chunk
-        std::unordered_set<index_pdata_type> pdata_;
-
-        /// Current size of the in-memory chunk
-        uint64_t chunk_size_;
+        buffer_type buffer_;
 
-        /// Maximum allowed size of a chunk in bytes before it is written
-        const static uint64_t constexpr max_size = 1024 * 1024 * 128; // 128 MB
+        /// The bytes of buffer_ counted in the handler's total
+        uint64_t counted_ = 0;
 
         /// Back-pointer to the handler this producer is operating on
         chunk_handler* parent_;
     };
 
     /**
-     * Constructs a chunk_handler that writes to the given prefix.
+     * Constructs a chunk_handler that writes to the given prefix. Full
+     * chunks are sorted and written by background threads, so that the
+     * producers can keep filling new ones in the meantime.
      * @param prefix The prefix for all chunks to be written
+     * @param ram_budget The bytes all producers together may buffer
+     * postings in, or 0 for default_ram_budget
+     * @param num_flushers The number of threads writing chunks
      */
-    chunk_handler(const std::string& prefix);
+    chunk_handler(const std::string& prefix, uint64_t ram_budget = 0,
+                  uint64_t num_flushers = 2);
+
+    /**
+     * Waits for the chunks being written, if merge_chunks() has not
+     * already done so.
+     */
+    ~chunk_handler();
 
     /**
      * Creates a producer for this chunk_handler. Producers are designed to
@@ -106,16 +134,38 @@ class chunk_handler
     uint32_t size() const;
 
     /**
-     * @return the size, in bytes, of the last chunk written to disk after
-     * merging.
+     * @return the size, in bytes, of the postings file written by
+     * merge_chunks()
      */
     uint64_t final_size() const;
 
     /**
-     * Merge the remaining on-disk chunks.
+     * Merges all of the on-disk chunks into a single postings file,
+     * prefix + "/postings.index", and deletes the chunks.
      */
     void merge_chunks();
 
+    /**
+     * Merges all of the on-disk chunks in a single pass, handing the
+     * merged postings_data for each primary key to a consumer instead of
+     * writing them to a file. The chunks are deleted afterwards. Every
+     * producer must have been destroyed before the merge begins; the
+     * merge first waits for their chunks to be written, and rethrows any
+     * error that writing them raised.
+     *
+     * The primary keys are split into num_parts contiguous ranges of
+     * roughly equal size, which are merged concurrently when num_parts is
+     * larger than one. Every key in part i is smaller than every key in
+     * part i + 1, and the keys of each part are consumed in increasing
+     * order by a single thread; a part may also be empty.
+     *
+     * @param num_parts The number of key ranges to split the merge into
+     * @param consume A callable taking the index of a part and an
+     * index_pdata_type&& for the next primary key in that part
+     */
+    template <class Consumer>
+    void merge_chunks(uint64_t num_parts, Consumer&& consume);
+
     /**
      * @return the number of unique primary keys seen while merging chunks.
      */
@@ -129,27 +179,98 @@ class chunk_handler
         using std::runtime_error::runtime_error;
     };
 
+    /// The bytes all producers together may buffer postings in, unless
+    /// told otherwise
+    const static uint64_t constexpr default_ram_budget
+        = 1024 * 1024 * 1024; // 1 GB
+
   private:
+    /**
+     * @param bytes The bytes held by a producer's buffer
+     * @return whether the producer should flush its buffer
+     */
+    bool should_flush(uint64_t bytes) const;
+
+    /**
+     * Queues a full in-memory chunk to be written, waiting if the
+     * flushing threads are behind.
+     * @param buffer The chunk
+     * @param bytes The bytes of the chunk counted as resident
+     */
+    void flush(buffer_type buffer, uint64_t bytes);
+
+    /**
+     * The work of a flushing thread: writes queued chunks until the queue
+     * is closed.
+     */
+    void write_queued();
+
+    /**
+     * Closes the queue of full chunks and waits for the flushing threads
+     * to write what is left in it.
+     */
+    void finish_flushing();
+
     /**
      * @param pdata The collection of postings_data objects to combine into a
      * chunk
      */
     void write_chunk(std::vector<index_pdata_type>& pdata);
 
+    /**
+     * Merges the postings for the primary keys in [first, last) from every
+     * chunk.
+     * @param first The smallest primary key to merge, if any
+     * @param last The primary key to stop at, if any
+     * @param consume A callable taking an index_pdata_type&&
+     * @return the number of unique primary keys merged
+     */
+    template <class Consumer>
+    uint64_t merge_range(const util::optional<primary_key_type>& first,
+                         const util::optional<primary_key_type>& last,
+                         Consumer& consume);
+
+    /// Number of bits written to a chunk between primary key samples
+    const static uint64_t constexpr sample_bits = 8 * 1024 * 1024; // 1 MB
+
     /// The prefix for all chunks to be written
     std::string prefix_;
 
+    /// The bytes all producers together may buffer postings in
+    const uint64_t ram_budget_;
+
+    /// The bytes held by the buffers of the producers
+    std::atomic<uint64_t> resident_{0};
+
+    /// The bytes of the full chunks queued or being written
+    std::atomic<uint64_t> flushing_{0};
+
+    /// The number of producers that have not been destroyed
+    std::atomic<uint64_t> producers_{0};
+
     /// The current chunk number
     std::atomic<uint32_t> chunk_num_{0};
 
-    /// Queue of chunks on disk that need to be merged */
-    std::priority_queue<chunk_t> chunks_;
+    /// Chunks on disk that need to be merged
+    std::vector<chunk_t> chunks_;
 
-    /// Mutex used for protecting the chunk queue
+    /// Mutex used for protecting the chunk list and flush_error_
     mutable std::mutex mutables_;
 
+    /// Full chunks waiting to be written
+    parallel::bounded_queue<buffer_type> full_;
+
+    /// The threads writing full chunks
+    std::vector<std::thread> flushers_;
+
+    /// The first error raised while writing a chunk, if any
+    std::exception_ptr flush_error_;
+
     /// Number of unique primary keys encountered while merging
     util::optional<uint64_t> unique_primary_keys_;
+
+    /// Size of the postings file written by merge_chunks()
+    util::optional<uint64_t> final_size_;
 };
 }
 }
@@ -4,10 +4,18 @@
  */
 
 #include <algorithm>
+#include <memory>
+#include <queue>
 
 #include "index/chunk_handler.h"
 #include "index/disk_index.h"
+#include "io/compressed_file_reader.h"
+#include "io/compressed_file_writer.h"
 #include "parallel/thread_pool.h"
+#include "util/filesystem.h"
+#include "util/metrics.h"
+#include "util/shim.h"
+#include "util/trace.h"
 
 namespace meta
 {
@@ -16,9 +24,20 @@ namespace index
 
 template <class Index>
 chunk_handler<Index>::producer::producer(chunk_handler* parent)
-    : chunk_size_{0}, parent_{parent}
+    : parent_{parent}
 {
-    // nothing
+    ++parent_->producers_;
+}
+
+template <class Index>
+chunk_handler<Index>::producer::producer(producer&& other)
+    : buffer_{std::move(other.buffer_)},
+      counted_{other.counted_},
+      parent_{other.parent_}
+{
+    other.buffer_ = buffer_type{};
+    other.counted_ = 0;
+    other.parent_ = nullptr;
 }
 
 template <class Index>
@@ -27,57 +46,66 @@ void chunk_handler<Index>::producer::operator()(const secondary_key_type& key,
                                                 const Container& counts)
 {
     for (const auto& count : counts)
-    {
-        index_pdata_type pd{count.first};
-        pd.increase_count(key, count.second);
-        auto it = pdata_.find(pd);
-        if (it == pdata_.end())
-        {
-            chunk_size_ += pd.bytes_used();
-            pdata_.emplace(pd);
-        }
-        else
-        {
-            chunk_size_ -= it->bytes_used();
-
-            // note: we can modify elements in this set because we do not change
-            // how comparisons are made (the primary_key value)
-            const_cast<index_pdata_type&>(*it).increase_count(key,
-                                                              count.second);
-            chunk_size_ += it->bytes_used();
-        }
+        buffer_.increase_count(count.first, key, count.second);
 
-        if (chunk_size_ >= max_size)
-            flush_chunk();
-    }
+    // a buffer only grows until it is flushed
+    auto bytes = buffer_.bytes_used();
+    parent_->resident_ += bytes - counted_;
+    counted_ = bytes;
+    if (parent_->should_flush(bytes))
+        flush_chunk();
 }
 
 template <class Index>
 void chunk_handler<Index>::producer::flush_chunk()
 {
-    if (chunk_size_ == 0)
+    if (buffer_.empty())
+    {
+        parent_->resident_ -= counted_;
+        counted_ = 0;
         return;
+    }
 
-    std::vector<index_pdata_type> pdata;
-    for (auto it = pdata_.begin(); it != pdata_.end(); it = pdata_.erase(it))
-        pdata.emplace_back(std::move(*it));
-    pdata_.clear();
-    std::sort(pdata.begin(), pdata.end());
-    parent_->write_chunk(pdata);
-    chunk_size_ = 0;
+    parent_->flush(std::move(buffer_), counted_);
+    buffer_ = buffer_type{};
+    counted_ = 0;
 }
 
 template <class Index>
 chunk_handler<Index>::producer::~producer()
 {
+    if (!parent_)
+        return;
     flush_chunk();
+    --parent_->producers_;
 }
 
 template <class Index>
-chunk_handler<Index>::chunk_handler(const std::string& prefix)
-    : prefix_{prefix}
+chunk_handler<Index>::chunk_handler(const std::string& prefix,
+                                    uint64_t ram_budget /* = 0 */,
+                                    uint64_t num_flushers /* = 2 */)
+    : prefix_{prefix},
+      ram_budget_{ram_budget == 0 ? uint64_t{default_ram_budget}
+                                  : ram_budget},
+      full_{num_flushers}
 {
-    // nothing
+    if (num_flushers == 0)
+        throw chunk_handler_exception{"chunks need a thread to write them"};
+
+    for (uint64_t i = 0; i < num_flushers; ++i)
+        flushers_.emplace_back([this]()
+                               {
+            write_queued();
+        });
+}
+
+template <class Index>
+chunk_handler<Index>::~chunk_handler()
+{
+    full_.close();
+    for (auto& thread : flushers_)
+        if (thread.joinable())
+            thread.join();
 }
 
 template <class Index>
@@ -87,102 +115,282 @@ auto chunk_handler<Index>::make_producer() -> producer
 }
 
 template <class Index>
-void chunk_handler<Index>::write_chunk(std::vector<index_pdata_type>& pdata)
+bool chunk_handler<Index>::should_flush(uint64_t bytes) const
 {
-    auto chunk_num = chunk_num_.fetch_add(1);
+    auto resident = resident_.load();
+    auto flushing = flushing_.load();
+    if (resident + flushing < ram_budget_)
+        return false;
+
+    // the memory of a chunk being written is about to be freed
+    if (flushing > 0 && resident < ram_budget_)
+        return false;
+
+    // at least one buffer is as large as the average, so some producer
+    // always flushes
+    return bytes * producers_.load() >= resident;
+}
 
-    util::optional<chunk_t> top;
+template <class Index>
+void chunk_handler<Index>::flush(buffer_type buffer, uint64_t bytes)
+{
+    // counted as flushing before it stops counting as resident, so that
+    // the total never appears to drop before the chunk is written
+    flushing_ += bytes;
+    resident_ -= bytes;
+    if (!full_.push(std::move(buffer)))
+        throw chunk_handler_exception{
+            "cannot add chunks once they are being merged"};
+}
+
+template <class Index>
+void chunk_handler<Index>::write_queued()
+{
+    buffer_type buffer;
+    while (full_.pop(buffer))
     {
-        std::lock_guard<std::mutex> lock{mutables_};
-        if (!chunks_.empty())
+        // keep taking chunks after an error, so that no producer is left
+        // waiting for room in the queue
+        auto bytes = buffer.bytes_used();
+        try
+        {
+            // extract() hands the postings back sorted by primary key
+            auto pdata = buffer.extract();
+            write_chunk(pdata);
+        }
+        catch (...)
         {
-            top = chunks_.top();
-            chunks_.pop();
+            std::lock_guard<std::mutex> lock{mutables_};
+            if (!flush_error_)
+                flush_error_ = std::current_exception();
         }
+        flushing_ -= bytes;
     }
+}
+
+template <class Index>
+void chunk_handler<Index>::finish_flushing()
+{
+    full_.close();
+    for (auto& thread : flushers_)
+        if (thread.joinable())
+            thread.join();
+
+    if (flush_error_)
+        std::rethrow_exception(flush_error_);
+}
 
-    if (!top) // pqueue was empty
+template <class Index>
+void chunk_handler<Index>::write_chunk(std::vector<index_pdata_type>& pdata)
+{
+    metrics::scoped_timer timer{"chunk_flush_ns"};
+    trace::scoped_event event{"chunk_flush", "index"};
+    auto chunk_num = chunk_num_.fetch_add(1);
+    std::string chunk_name = prefix_ + "/chunk-" + std::to_string(chunk_num);
+
+    std::vector<typename chunk_t::sample_type> samples;
     {
-        std::string chunk_name = prefix_ + "/chunk-"
-                                 + std::to_string(chunk_num);
-        io::compressed_file_writer outfile{chunk_name,
-                                           io::default_compression_writer_func};
+        io::default_compressed_file_writer outfile{chunk_name};
+        uint64_t next_sample = 0;
         for (auto& p : pdata)
+        {
+            if (outfile.bit_location() >= next_sample)
+            {
+                samples.emplace_back(p.primary_key(), outfile.bit_location());
+                next_sample = outfile.bit_location() + sample_bits;
+            }
             outfile << p;
+        }
+        // close so we can read the file size in chunk ctr
+        outfile.close();
+    }
+    pdata.clear();
 
-        outfile.close(); // close so we can read the file size in chunk ctr
-        std::ofstream termfile{chunk_name + ".numterms"};
-        termfile << pdata.size();
-        pdata.clear();
+    chunk_t chnk{chunk_name, std::move(samples)};
+    std::lock_guard<std::mutex> lock{mutables_};
+    chunks_.push_back(std::move(chnk));
+}
 
-        std::lock_guard<std::mutex> lock{mutables_};
-        chunks_.emplace(chunk_name);
+template <class Index>
+void chunk_handler<Index>::merge_chunks()
+{
+    auto filename = prefix_ + "/postings.index";
+    {
+        io::default_compressed_file_writer outfile{filename};
+        merge_chunks(1, [&](uint64_t, index_pdata_type&& pdata)
+                     {
+            outfile << pdata;
+        });
     }
-    else // we can merge with an existing chunk
+    final_size_ = filesystem::file_size(filename);
+}
+
+template <class Index>
+template <class Consumer>
+void chunk_handler<Index>::merge_chunks(uint64_t num_parts, Consumer&& consume)
+{
+    finish_flushing();
+    metrics::scoped_timer timer{"chunk_merge_ns"};
+    trace::scoped_event event{"merge_chunks", "index"};
+    if (chunks_.empty())
+        throw chunk_handler_exception{"there were no chunks to merge"};
+    if (num_parts == 0)
+        throw chunk_handler_exception{"cannot merge chunks into zero parts"};
+
+    uint64_t total_size = 0;
+    for (const auto& chnk : chunks_)
+        total_size += chnk.size();
+    LOG(progress) << "> Merging " << chunks_.size() << " chunks ("
+                  << printing::bytes_to_units(total_size) << ")\n" << ENDLG;
+
+    // split the primary keys at evenly spaced samples; each sample stands
+    // for about the same number of bytes of postings
+    std::vector<primary_key_type> sampled;
+    for (const auto& chnk : chunks_)
+        for (const auto& sample : chnk.samples())
+            sampled.push_back(sample.first);
+    std::sort(sampled.begin(), sampled.end());
+
+    std::vector<util::optional<primary_key_type>> bounds(num_parts + 1);
+    for (uint64_t i = 1; i < num_parts; ++i)
+        bounds[i] = sampled[sampled.size() * i / num_parts];
+
+    uint64_t unique_keys = 0;
+    if (num_parts == 1)
     {
-        top->memory_merge_with(pdata);
+        auto part = [&](index_pdata_type&& pdata)
+        {
+            consume(uint64_t{0}, std::move(pdata));
+        };
+        unique_keys = merge_range(bounds[0], bounds[1], part);
+    }
+    else
+    {
+        parallel::thread_pool pool;
+        std::vector<std::future<uint64_t>> futures;
+        for (uint64_t i = 0; i < num_parts; ++i)
+        {
+            futures.emplace_back(pool.submit_task([&, i]()
+                                                  {
+                auto part = [&](index_pdata_type&& pdata)
+                {
+                    consume(i, std::move(pdata));
+                };
+                return merge_range(bounds[i], bounds[i + 1], part);
+            }));
+        }
 
-        std::lock_guard<std::mutex> lock{mutables_};
-        chunks_.emplace(*top);
+        for (auto& fut : futures)
+            unique_keys += fut.get();
     }
+
+    for (const auto& chnk : chunks_)
+        filesystem::delete_file(chnk.path());
+    chunks_.clear();
+
+    unique_primary_keys_ = unique_keys;
 }
 
 template <class Index>
-void chunk_handler<Index>::merge_chunks()
+template <class Consumer>
+uint64_t chunk_handler<Index>::merge_range(
+    const util::optional<primary_key_type>& first,
+    const util::optional<primary_key_type>& last, Consumer& consume)
 {
-    size_t remaining = chunks_.size() - 1;
-    std::mutex mutex;
-    auto task = [&]()
+    using count_t = typename index_pdata_type::count_t;
+    using pair_t = typename index_pdata_type::pair_t;
+
+    std::vector<std::unique_ptr<io::default_compressed_file_reader>> readers;
+    std::vector<index_pdata_type> current(chunks_.size());
+
+    // a min-heap of the chunks, ordered by their current primary key
+    auto greater = [&](uint64_t a, uint64_t b)
+    {
+        return current[b].primary_key() < current[a].primary_key();
+    };
+    std::priority_queue<uint64_t, std::vector<uint64_t>, decltype(greater)>
+        heap{greater};
+
+    auto advance = [&](uint64_t i)
     {
-        while (true)
+        auto& reader = *readers[i];
+        reader >> current[i];
+        if (reader && (!last || current[i].primary_key() < *last))
+            heap.push(i);
+    };
+
+    for (uint64_t i = 0; i < chunks_.size(); ++i)
+    {
+        readers.emplace_back(
+            make_unique<io::default_compressed_file_reader>(chunks_[i].path()));
+        auto& reader = *readers[i];
+        if (!first)
         {
-            util::optional<chunk_t> first;
-            util::optional<chunk_t> second;
-            {
-                std::lock_guard<std::mutex> lock{mutables_};
-                if (chunks_.size() < 2)
-                    return;
-                first = chunks_.top();
-                chunks_.pop();
-                second = chunks_.top();
-                chunks_.pop();
-                LOG(progress) << "> Merging " << first->path() << " ("
-                              << printing::bytes_to_units(first->size())
-                              << ") and " << second->path() << " ("
-                              << printing::bytes_to_units(second->size())
-                              << "), " << --remaining << " remaining        \r"
-                              << ENDLG;
-            }
-            first->merge_with(*second);
-            {
-                std::lock_guard<std::mutex> lock{mutex};
-                chunks_.push(*first);
-            }
+            advance(i);
+            continue;
         }
-    };
 
-    parallel::thread_pool pool;
-    auto thread_ids = pool.thread_ids();
-    std::vector<std::future<void>> futures;
-    for (size_t i = 0; i < thread_ids.size(); ++i)
-        futures.emplace_back(pool.submit_task(task));
+        reader.seek(chunks_[i].seek_location(*first));
+        do
+        {
+            reader >> current[i];
+        } while (reader && current[i].primary_key() < *first);
 
-    for (auto& fut : futures)
-        fut.get();
+        if (reader && (!last || current[i].primary_key() < *last))
+            heap.push(i);
+    }
 
-    LOG(progress) << '\n' << ENDLG;
+    uint64_t unique_keys = 0;
+    while (!heap.empty())
+    {
+        auto i = heap.top();
+        heap.pop();
+        ++unique_keys;
 
-    if (chunks_.empty())
-        throw chunk_handler_exception{"there were no chunks to merge"};
+        // the common case: no other chunk has postings for this key
+        if (heap.empty()
+            || current[i].primary_key() != current[heap.top()].primary_key())
+        {
+            consume(std::move(current[i]));
+            advance(i);
+            continue;
+        }
+
+        index_pdata_type merged{current[i].primary_key()};
+        count_t counts = current[i].counts();
+        advance(i);
+        while (!heap.empty()
+               && current[heap.top()].primary_key() == merged.primary_key())
+        {
+            auto j = heap.top();
+            heap.pop();
+            const auto& more = current[j].counts();
+            counts.insert(counts.end(), more.begin(), more.end());
+            advance(j);
+        }
+
+        // the chunks' postings for a key usually cover disjoint ranges of
+        // secondary keys, but they need not arrive in order
+        std::sort(counts.begin(), counts.end(),
+                  [](const pair_t& a, const pair_t& b)
+                  {
+            return a.first < b.first;
+        });
+        auto end = counts.begin();
+        for (auto it = counts.begin() + 1; it != counts.end(); ++it)
+        {
+            if (it->first == end->first)
+                end->second += it->second;
+            else
+                *++end = *it;
+        }
+        counts.erase(end + 1, counts.end());
 
-    uint64_t unique_keys;
-    std::ifstream termfile{chunks_.top().path() + ".numterms"};
-    termfile >> unique_keys;
-    termfile.close();
-    filesystem::delete_file(chunks_.top().path() + ".numterms");
-    filesystem::rename_file(chunks_.top().path(), prefix_ + "/postings.index");
+        merged.set_counts(std::move(counts));
+        consume(std::move(merged));
+    }
 
-    unique_primary_keys_ = unique_keys;
+    return unique_keys;
 }
 
 template <class Index>
@@ -197,10 +405,10 @@ uint64_t chunk_handler<Index>::unique_primary_keys() const
 template <class Index>
 uint64_t chunk_handler<Index>::final_size() const
 {
-    if (chunks_.size() != 1)
+    if (!final_size_)
         throw chunk_handler_exception{
             "merge not complete before final_size() called"};
-    return chunks_.top().size();
+    return *final_size_;
 }
 
 template <class Index>
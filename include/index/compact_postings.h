@@ -0,0 +1,150 @@
+/**
+ * @file compact_postings.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_COMPACT_POSTINGS_H_
+#define META_INDEX_COMPACT_POSTINGS_H_
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "index/postings_data.h"
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * An immutable, compact copy of a postings_data, for keeping many postings
+ * lists in memory at once. A postings_data spends 16 bytes on each of its
+ * (SecondaryKey, count) pairs; here the keys are gap coded with Stream VByte
+ * in blocks of 128, and the counts of a block follow its keys, packed as
+ * integers when they all are, as floats when that loses nothing, and as
+ * doubles otherwise. A typical list of term counts takes two or three bytes
+ * a posting, and the original postings are always recovered exactly.
+ *
+ * The postings are decoded as they are visited, one block at a time, with
+ * for_each(), or all at once into a postings_data with decode().
+ */
+template <class PrimaryKey, class SecondaryKey>
+class compact_postings
+{
+  public:
+    /**
+     * Encodes the postings of a postings_data.
+     * @param pdata The postings to encode
+     */
+    template <class Allocator>
+    explicit compact_postings(
+        const postings_data<PrimaryKey, SecondaryKey, Allocator>& pdata);
+
+    /**
+     * @return the primary key of the postings
+     */
+    const PrimaryKey& primary_key() const;
+
+    /**
+     * @return the number of postings
+     */
+    uint64_t size() const;
+
+    /**
+     * Visits the postings in increasing order of their SecondaryKeys.
+     * @param fn The function to call with each SecondaryKey and its count
+     */
+    template <class Function>
+    void for_each(Function&& fn) const;
+
+    /**
+     * @return a postings_data holding the same postings
+     */
+    template <class PostingsData>
+    std::shared_ptr<PostingsData> decode() const;
+
+    /**
+     * @return the number of bytes the postings take, not counting the
+     * object itself
+     */
+    uint64_t bytes_used() const;
+
+  private:
+    /// How the SecondaryKey gaps of each block are stored
+    enum class id_format : uint8_t
+    {
+        /// Stream VByte, when every gap fits in 32 bits
+        packed,
+        /// Raw 64-bit gaps
+        wide
+    };
+
+    /// How the counts of each block are stored
+    enum class count_format : uint8_t
+    {
+        /// Stream VByte, when every count is an integer that fits in 32 bits
+        integral,
+        /// Raw floats, when every count is exactly a float
+        single,
+        /// Raw doubles
+        full
+    };
+
+    /// The number of postings in each block
+    const static uint64_t block_size = 128;
+
+    /// The primary key of the postings
+    PrimaryKey p_id_;
+
+    /// The number of postings
+    uint64_t size_;
+
+    /// How the gaps are stored
+    id_format ids_;
+
+    /// How the counts are stored
+    count_format counts_;
+
+    /// The encoded blocks
+    std::vector<uint8_t> data_;
+};
+
+/**
+ * Keeps the postings in the cache of a cached_index as compact_postings,
+ * which are decoded again each time they are found (see compact_postings).
+ * The cache then holds several times as many postings lists in the same
+ * memory, at the price of decoding one on every hit, which is still far
+ * cheaper than reading it from disk.
+ */
+template <class PostingsData>
+struct compact_cache_values
+{
+    /// The compact form of the postings
+    using compact_type
+        = compact_postings<typename PostingsData::primary_key_type,
+                           typename PostingsData::secondary_key_type>;
+
+    /// What the cache holds
+    using value_type = std::shared_ptr<const compact_type>;
+
+    /**
+     * @param pdata The postings read from the index
+     * @return the value to keep in the cache
+     */
+    static value_type store(const std::shared_ptr<PostingsData>& pdata);
+
+    /**
+     * @param value A value from the cache
+     * @return its postings
+     */
+    static std::shared_ptr<PostingsData> load(const value_type& value);
+};
+}
+}
+
+#include "index/compact_postings.tcc"
+#endif
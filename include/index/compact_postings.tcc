@@ -0,0 +1,206 @@
+/**
+ * @file compact_postings.tcc
+ */
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "index/compact_postings.h"
+#include "io/stream_vbyte.h"
+
+namespace meta
+{
+namespace index
+{
+
+template <class PrimaryKey, class SecondaryKey>
+const uint64_t compact_postings<PrimaryKey, SecondaryKey>::block_size;
+
+template <class PrimaryKey, class SecondaryKey>
+template <class Allocator>
+compact_postings<PrimaryKey, SecondaryKey>::compact_postings(
+    const postings_data<PrimaryKey, SecondaryKey, Allocator>& pdata)
+    : p_id_{pdata.primary_key()},
+      size_{pdata.counts().size()},
+      ids_{id_format::packed},
+      counts_{count_format::integral}
+{
+    const auto& counts = pdata.counts();
+
+    // pick the narrowest formats that hold every posting exactly
+    uint64_t last_id = 0;
+    for (const auto& count : counts)
+    {
+        uint64_t id = count.first;
+        if (id - last_id > std::numeric_limits<uint32_t>::max())
+            ids_ = id_format::wide;
+        last_id = id;
+
+        auto value = count.second;
+        if (counts_ == count_format::integral
+            && !(value >= 0 && value <= std::numeric_limits<uint32_t>::max()
+                 && std::floor(value) == value))
+            counts_ = count_format::single;
+        if (counts_ == count_format::single
+            && static_cast<double>(static_cast<float>(value)) != value)
+            counts_ = count_format::full;
+    }
+
+    std::array<uint32_t, block_size> gaps;
+    std::array<uint64_t, block_size> wide_gaps;
+    std::array<uint32_t, block_size> freqs;
+    std::array<float, block_size> singles;
+    std::array<double, block_size> fulls;
+    std::vector<uint8_t> buffer(io::stream_vbyte::max_encoded_size(block_size));
+
+    auto append = [&](const void* bytes, uint64_t len)
+    {
+        auto begin = static_cast<const uint8_t*>(bytes);
+        data_.insert(data_.end(), begin, begin + len);
+    };
+
+    last_id = 0;
+    for (uint64_t start = 0; start < size_; start += block_size)
+    {
+        uint64_t n = std::min<uint64_t>(block_size, size_ - start);
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            uint64_t id = counts[start + i].first;
+            wide_gaps[i] = id - last_id;
+            gaps[i] = static_cast<uint32_t>(wide_gaps[i]);
+            last_id = id;
+
+            auto value = counts[start + i].second;
+            freqs[i] = static_cast<uint32_t>(value);
+            singles[i] = static_cast<float>(value);
+            fulls[i] = value;
+        }
+
+        if (ids_ == id_format::packed)
+            append(buffer.data(), io::stream_vbyte::encode(gaps.data(), n,
+                                                           buffer.data()));
+        else
+            append(wide_gaps.data(), n * sizeof(uint64_t));
+
+        switch (counts_)
+        {
+            case count_format::integral:
+                append(buffer.data(),
+                       io::stream_vbyte::encode(freqs.data(), n,
+                                                buffer.data()));
+                break;
+            case count_format::single:
+                append(singles.data(), n * sizeof(float));
+                break;
+            case count_format::full:
+                append(fulls.data(), n * sizeof(double));
+                break;
+        }
+    }
+    data_.shrink_to_fit();
+}
+
+template <class PrimaryKey, class SecondaryKey>
+const PrimaryKey&
+    compact_postings<PrimaryKey, SecondaryKey>::primary_key() const
+{
+    return p_id_;
+}
+
+template <class PrimaryKey, class SecondaryKey>
+uint64_t compact_postings<PrimaryKey, SecondaryKey>::size() const
+{
+    return size_;
+}
+
+template <class PrimaryKey, class SecondaryKey>
+template <class Function>
+void compact_postings<PrimaryKey, SecondaryKey>::for_each(Function&& fn) const
+{
+    std::array<uint32_t, block_size> gaps;
+    std::array<uint64_t, block_size> wide_gaps;
+    std::array<uint32_t, block_size> freqs;
+    std::array<float, block_size> singles;
+    std::array<double, block_size> fulls;
+
+    auto in = data_.data();
+    uint64_t last_id = 0;
+    for (uint64_t start = 0; start < size_; start += block_size)
+    {
+        uint64_t n = std::min<uint64_t>(block_size, size_ - start);
+        if (ids_ == id_format::packed)
+        {
+            in += io::stream_vbyte::decode(in, n, gaps.data());
+            std::copy(gaps.begin(), gaps.begin() + n, wide_gaps.begin());
+        }
+        else
+        {
+            std::memcpy(wide_gaps.data(), in, n * sizeof(uint64_t));
+            in += n * sizeof(uint64_t);
+        }
+
+        switch (counts_)
+        {
+            case count_format::integral:
+                in += io::stream_vbyte::decode(in, n, freqs.data());
+                std::copy(freqs.begin(), freqs.begin() + n, fulls.begin());
+                break;
+            case count_format::single:
+                std::memcpy(singles.data(), in, n * sizeof(float));
+                in += n * sizeof(float);
+                std::copy(singles.begin(), singles.begin() + n, fulls.begin());
+                break;
+            case count_format::full:
+                std::memcpy(fulls.data(), in, n * sizeof(double));
+                in += n * sizeof(double);
+                break;
+        }
+
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            last_id += wide_gaps[i];
+            fn(SecondaryKey{last_id}, fulls[i]);
+        }
+    }
+}
+
+template <class PrimaryKey, class SecondaryKey>
+template <class PostingsData>
+std::shared_ptr<PostingsData>
+    compact_postings<PrimaryKey, SecondaryKey>::decode() const
+{
+    auto pdata = std::make_shared<PostingsData>(p_id_);
+    typename PostingsData::count_t counts;
+    counts.reserve(size_);
+    for_each([&](SecondaryKey s_id, double count)
+             {
+                 counts.emplace_back(s_id, count);
+             });
+    pdata->set_counts(std::move(counts));
+    return pdata;
+}
+
+template <class PrimaryKey, class SecondaryKey>
+uint64_t compact_postings<PrimaryKey, SecondaryKey>::bytes_used() const
+{
+    return data_.capacity();
+}
+
+template <class PostingsData>
+auto compact_cache_values<PostingsData>::store(
+    const std::shared_ptr<PostingsData>& pdata) -> value_type
+{
+    return std::make_shared<compact_type>(*pdata);
+}
+
+template <class PostingsData>
+std::shared_ptr<PostingsData>
+    compact_cache_values<PostingsData>::load(const value_type& value)
+{
+    return value->template decode<PostingsData>();
+}
+}
+}
@@ -0,0 +1,198 @@
+/**
+ * @file completion_index.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_COMPLETION_INDEX_H_
+#define META_INDEX_COMPLETION_INDEX_H_
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "io/mmap_file.h"
+#include "meta.h"
+#include "util/memory_usage.h"
+
+namespace cpptoml
+{
+class table;
+}
+
+namespace meta
+{
+namespace index
+{
+
+class inverted_index;
+class vocabulary_map;
+
+/**
+ * What the completions of a prefix are ranked by.
+ */
+enum class completion_weight
+{
+    /// The number of occurrences of the term in the corpus
+    term_count,
+    /// The number of documents containing the term
+    doc_freq
+};
+
+/**
+ * Options for building a completion_index.
+ */
+struct completion_options
+{
+    /**
+     * What terms are ranked by.
+     */
+    completion_weight weight = completion_weight::term_count;
+
+    /**
+     * A query log to rank terms by, or empty for none: a line per query
+     * of its text, optionally followed by a tab and the number of times
+     * it was issued. A query that is a term of the index adds its count
+     * to the term; terms are ranked by these counts first and by weight
+     * second.
+     */
+    std::string query_log;
+};
+
+/**
+ * Suggests completions of a prefix among the terms of an inverted index,
+ * most frequent first, in time independent of the number of terms that
+ * have the prefix.
+ *
+ * The terms of an index are numbered in sorted order, so the terms with a
+ * prefix are a range of term ids, which the vocabulary finds with a
+ * binary search (see vocabulary_map::prefix_range()). The index stores a
+ * weight for each term and, over those, a tree of 64-way maxima: a node
+ * of level l covers 64^l consecutive terms and holds the id of the
+ * heaviest of them. The range of a prefix is covered by at most 126 nodes
+ * per level, and the best n terms are popped from a heap of nodes, each
+ * pop of an inner node pushing its 64 children. The file is memory
+ * mapped, about (1 + 1/63) * 8 bytes per term.
+ *
+ * Completions are the terms of the index as its analyzer produced them,
+ * so they read best with an analyzer that neither stems nor filters.
+ */
+class completion_index
+{
+  public:
+    /**
+     * Builds the completion index of an inverted index and saves it in
+     * the index's directory.
+     * @param idx The index
+     * @param options How terms are ranked
+     */
+    static void build(const inverted_index& idx,
+                      const completion_options& options
+                      = completion_options{});
+
+    /**
+     * @param idx An index
+     * @return whether the index has a completion index
+     */
+    static bool exists(const inverted_index& idx);
+
+    /**
+     * Loads the completion index of an inverted index, which must outlive
+     * it.
+     * @param idx The index
+     */
+    completion_index(const inverted_index& idx);
+
+    /**
+     * completion_index may be move constructed.
+     */
+    completion_index(completion_index&&) = default;
+
+    /**
+     * completion_index may be move assigned.
+     */
+    completion_index& operator=(completion_index&&) = default;
+
+    /**
+     * May be called from several threads at once.
+     * @param prefix A prefix of terms
+     * @param n The number of completions to return
+     * @return at most n terms that start with the prefix and their
+     * weights, heaviest first; terms of equal weight are in sorted order
+     */
+    std::vector<std::pair<std::string, uint64_t>>
+        complete(const std::string& prefix, uint64_t n = 10) const;
+
+    /**
+     * @param first The first term id of a range
+     * @param last One past the last term id of the range
+     * @param n The number of terms to return
+     * @return at most n terms of the range and their weights, heaviest
+     * first; terms of equal weight are in order of id
+     */
+    std::vector<std::pair<term_id, uint64_t>>
+        top_terms(term_id first, term_id last, uint64_t n) const;
+
+    /**
+     * @param t_id A term
+     * @return the weight the term is ranked by
+     */
+    uint64_t weight(term_id t_id) const;
+
+    /**
+     * @return the memory used by the mapped file
+     */
+    util::memory_usage memory_usage() const;
+
+  private:
+    /**
+     * @param level A level of the tree
+     * @param node A node of the level
+     * @return the heaviest term the node covers
+     */
+    uint64_t best(uint64_t level, uint64_t node) const;
+
+    /// The vocabulary of the index
+    const vocabulary_map* vocab_;
+
+    /// The mapped file
+    io::mmap_file file_;
+
+    /// The number of terms
+    uint64_t num_terms_;
+
+    /// The weight of each term
+    const uint64_t* weights_;
+
+    /// The nodes of each level of the tree above the terms, as the id of
+    /// the heaviest term each covers; level 0, the terms, is empty
+    std::vector<const uint64_t*> levels_;
+
+    /// The number of nodes of each level, from the terms up
+    std::vector<uint64_t> sizes_;
+};
+
+/**
+ * Reads the completion options of an index's configuration: the
+ * `autocomplete-weight` ("term-count" or "doc-freq") and
+ * `autocomplete-log` keys. Options that are not set keep their default.
+ * @param config The configuration
+ * @return the options
+ */
+completion_options make_completion_options(const cpptoml::table& config);
+
+/**
+ * Basic exception for completion_index interactions.
+ */
+class completion_index_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
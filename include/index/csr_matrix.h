@@ -0,0 +1,287 @@
+/**
+ * @file csr_matrix.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_CSR_MATRIX_H_
+#define META_INDEX_CSR_MATRIX_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "util/disk_vector.h"
+#include "util/optional.h"
+#include "meta.h"
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * The term counts of a set of documents in compressed sparse row form:
+ * the (term id, value) pairs of every row are contiguous, so that
+ * learners that pass over the same documents many times can read them
+ * without decoding postings or allocating. Created by
+ * forward_index::materialize(); the pairs of large sets may be kept in
+ * memory-mapped files instead of in memory.
+ */
+class csr_matrix
+{
+  public:
+    /**
+     * The (term id, value) pairs of one document, in increasing order of
+     * term id.
+     */
+    class row
+    {
+      public:
+        /**
+         * Iterates over the pairs of a row as (term id, value) pairs.
+         */
+        class const_iterator
+        {
+          public:
+            /**
+             * @param term The term id of the pair to start at
+             * @param value The value of the pair to start at
+             */
+            const_iterator(const uint32_t* term, const float* value)
+                : term_{term}, value_{value}
+            {
+                // nothing
+            }
+
+            /**
+             * @return the pair at the current position
+             */
+            std::pair<term_id, double> operator*() const
+            {
+                return {term_id{*term_}, *value_};
+            }
+
+            /**
+             * Moves to the next pair.
+             * @return the iterator
+             */
+            const_iterator& operator++()
+            {
+                ++term_;
+                ++value_;
+                return *this;
+            }
+
+            /**
+             * @param other Another iterator over the same row
+             * @return whether the iterators are at the same position
+             */
+            bool operator==(const const_iterator& other) const
+            {
+                return term_ == other.term_;
+            }
+
+            /**
+             * @param other Another iterator over the same row
+             * @return whether the iterators are at different positions
+             */
+            bool operator!=(const const_iterator& other) const
+            {
+                return term_ != other.term_;
+            }
+
+          private:
+            /// The term id of the current pair
+            const uint32_t* term_;
+            /// The value of the current pair
+            const float* value_;
+        };
+
+        /**
+         * @param terms The term ids of the row
+         * @param values The values of the row
+         * @param size The number of pairs in the row
+         */
+        row(const uint32_t* terms, const float* values, uint64_t size)
+            : terms_{terms}, values_{values}, size_{size}
+        {
+            // nothing
+        }
+
+        /**
+         * @return the number of pairs in the row
+         */
+        uint64_t size() const
+        {
+            return size_;
+        }
+
+        /**
+         * @param i A position in the row
+         * @return the term id of the pair at that position
+         */
+        term_id term(uint64_t i) const
+        {
+            return term_id{terms_[i]};
+        }
+
+        /**
+         * @param i A position in the row
+         * @return the value of the pair at that position
+         */
+        double value(uint64_t i) const
+        {
+            return values_[i];
+        }
+
+        /**
+         * @return an iterator to the first pair of the row
+         */
+        const_iterator begin() const
+        {
+            return {terms_, values_};
+        }
+
+        /**
+         * @return an iterator past the last pair of the row
+         */
+        const_iterator end() const
+        {
+            return {terms_ + size_, values_ + size_};
+        }
+
+      private:
+        /// The term ids of the row
+        const uint32_t* terms_;
+        /// The values of the row
+        const float* values_;
+        /// The number of pairs in the row
+        uint64_t size_;
+    };
+
+    /**
+     * Creates a matrix with no rows.
+     */
+    csr_matrix();
+
+    /**
+     * Creates a matrix held in memory.
+     * @param docs The document of each row
+     * @param offsets The position of the first pair of each row, followed
+     * by the number of pairs
+     * @param terms The term id of each pair
+     * @param values The value of each pair
+     */
+    csr_matrix(std::vector<doc_id> docs, std::vector<uint64_t> offsets,
+               std::vector<uint32_t> terms, std::vector<float> values);
+
+    /**
+     * Creates a matrix whose pairs are memory-mapped from the files
+     * prefix + ".terms" and prefix + ".values".
+     * @param docs The document of each row
+     * @param offsets The position of the first pair of each row, followed
+     * by the number of pairs
+     * @param prefix The prefix of the files holding the pairs
+     */
+    csr_matrix(std::vector<doc_id> docs, std::vector<uint64_t> offsets,
+               const std::string& prefix);
+
+    /**
+     * Move constructs a csr_matrix.
+     */
+    csr_matrix(csr_matrix&&) = default;
+
+    /**
+     * Move assigns a csr_matrix.
+     */
+    csr_matrix& operator=(csr_matrix&&) = default;
+
+    /**
+     * A csr_matrix points into its own storage, so it may not be copied.
+     */
+    csr_matrix(const csr_matrix&) = delete;
+
+    /**
+     * A csr_matrix points into its own storage, so it may not be copied.
+     */
+    csr_matrix& operator=(const csr_matrix&) = delete;
+
+    /**
+     * @param r A row of the matrix
+     * @return the pairs of the row
+     */
+    row operator[](uint64_t r) const
+    {
+        return row{terms_ + offsets_[r], values_ + offsets_[r],
+                   offsets_[r + 1] - offsets_[r]};
+    }
+
+    /**
+     * @param r A row of the matrix
+     * @return the document of the row
+     */
+    doc_id doc(uint64_t r) const;
+
+    /**
+     * @return the number of rows in the matrix
+     */
+    uint64_t rows() const;
+
+    /**
+     * @return the number of (term id, value) pairs in the matrix
+     */
+    uint64_t nonzeros() const;
+
+    /**
+     * @return whether the pairs are memory-mapped from files
+     */
+    bool mapped() const;
+
+    /**
+     * @return the memory used by the matrix
+     */
+    util::memory_usage memory_usage() const;
+
+    /**
+     * Basic exception for csr_matrix interactions.
+     */
+    class csr_matrix_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /// The document of each row
+    std::vector<doc_id> docs_;
+
+    /// The position of the first pair of each row, and the number of pairs
+    std::vector<uint64_t> offsets_;
+
+    /// The term ids of the pairs, when they are held in memory
+    std::vector<uint32_t> terms_mem_;
+
+    /// The values of the pairs, when they are held in memory
+    std::vector<float> values_mem_;
+
+    /// The term ids of the pairs, when they are memory-mapped
+    util::optional<util::disk_vector<uint32_t>> terms_file_;
+
+    /// The values of the pairs, when they are memory-mapped
+    util::optional<util::disk_vector<float>> values_file_;
+
+    /// The term ids of the pairs, wherever they are held
+    const uint32_t* terms_;
+
+    /// The values of the pairs, wherever they are held
+    const float* values_;
+};
+}
+}
+
+#endif
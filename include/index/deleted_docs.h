@@ -0,0 +1,131 @@
+/**
+ * @file deleted_docs.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_DELETED_DOCS_H_
+#define META_INDEX_DELETED_DOCS_H_
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "meta.h"
+#include "util/memory_usage.h"
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * A persistent bitmap of the documents deleted from an index. Deleting a
+ * document only sets its bit; its postings stay where they are and are
+ * skipped by anything that checks contains().
+ *
+ * contains() may be called while other threads delete documents.
+ */
+class deleted_docs
+{
+  public:
+    /**
+     * Loads the bitmap if the file exists, or starts an empty one.
+     * @param path The file the bitmap is saved in
+     * @param num_docs The number of documents in the index
+     */
+    deleted_docs(const std::string& path, uint64_t num_docs);
+
+    /**
+     * @param d_id The document to check
+     * @return whether the document is deleted
+     */
+    bool contains(doc_id d_id) const
+    {
+        return (words_[d_id / 64].load(std::memory_order_relaxed)
+                >> (d_id % 64)) & 1;
+    }
+
+    /**
+     * Deletes a document and saves the change.
+     * @param d_id The document to delete
+     * @return whether the document was not already deleted
+     */
+    bool insert(doc_id d_id);
+
+    /**
+     * Deletes several documents, saving the changes once.
+     * @param ids The documents to delete
+     * @return the number of documents that were not already deleted
+     */
+    uint64_t insert(const std::vector<doc_id>& ids);
+
+    /**
+     * @return the number of deleted documents
+     */
+    uint64_t size() const;
+
+    /**
+     * @return the memory used by the set of deleted documents
+     */
+    util::memory_usage memory_usage() const;
+
+    /**
+     * @return whether no documents are deleted
+     */
+    bool empty() const;
+
+    /**
+     * @return the number of documents in the index
+     */
+    uint64_t num_docs() const;
+
+  private:
+    /**
+     * Sets the bit of a document; the caller must hold mutex_.
+     * @param d_id The document to delete
+     * @return whether the document was not already deleted
+     */
+    bool set(doc_id d_id);
+
+    /**
+     * Writes the whole bitmap to its file.
+     */
+    void save() const;
+
+    /// The file the bitmap is saved in
+    std::string path_;
+
+    /// The number of documents in the index
+    uint64_t num_docs_;
+
+    /// The number of 64-bit words in the bitmap
+    uint64_t num_words_;
+
+    /// The bitmap, one bit per document
+    std::unique_ptr<std::atomic<uint64_t>[]> words_;
+
+    /// The number of deleted documents
+    std::atomic<uint64_t> size_;
+
+    /// Serializes deletions and their writes to the file
+    std::mutex mutex_;
+};
+
+/**
+ * Basic exception for deleted_docs interactions.
+ */
+class deleted_docs_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
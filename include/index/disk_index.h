@@ -13,6 +13,8 @@
 
 #include <memory>
 #include <vector>
+#include "index/doc_metadata.h"
+#include "util/memory_usage.h"
 #include "util/pimpl.h"
 #include "meta.h"
 
@@ -26,10 +28,17 @@ namespace meta
 
 namespace index
 {
+class deleted_docs;
+class field_store;
 class string_list;
 class vocabulary_map;
 }
 
+namespace io
+{
+enum class access_pattern;
+}
+
 namespace tokenizers
 {
 class tokenizer;
@@ -82,6 +91,42 @@ class disk_index
      */
     std::string doc_path(doc_id d_id) const;
 
+    /**
+     * Deletes a document from the index. Its doc_id stays in use, but
+     * rankers no longer return it; the deletion is saved right away.
+     * @param d_id The document to delete
+     */
+    void delete_doc(doc_id d_id);
+
+    /**
+     * Deletes several documents from the index, saving the deletions once.
+     * @param ids The documents to delete
+     */
+    void delete_docs(const std::vector<doc_id>& ids);
+
+    /**
+     * @param d_id The document to check
+     * @return whether the document has been deleted
+     */
+    bool is_deleted(doc_id d_id) const;
+
+    /**
+     * @return the number of deleted documents
+     */
+    uint64_t num_deleted() const;
+
+    /**
+     * @return the deleted documents of this index
+     */
+    const deleted_docs& deleted() const;
+
+    /**
+     * Hints how the postings of this index will be read, so that the
+     * kernel can tune its readahead.
+     * @param pattern How the postings will be read
+     */
+    void advise_postings(io::access_pattern pattern) const;
+
     /**
      * @return a vector of doc_ids that are contained in this index
      */
@@ -94,6 +139,24 @@ class disk_index
      */
     uint64_t doc_size(doc_id d_id) const;
 
+    /**
+     * @param d_id The document to search for
+     * @return the length and number of unique terms of the document, read
+     * together
+     */
+    doc_metadata::record doc_info(doc_id d_id) const;
+
+    /**
+     * @return whether the index stores typed document fields
+     */
+    bool has_fields() const;
+
+    /**
+     * @return the typed fields of the documents, declared with [[fields]]
+     * in the configuration; throws if the index has none
+     */
+    const field_store& fields() const;
+
     /**
      * @param d_id The doc id to find the class label for
      * @return the label of the class that the document belongs to, or an
@@ -147,12 +210,44 @@ class disk_index
      */
     term_id get_term_id(const std::string& term);
 
+    /**
+     * Looks up the ids of many terms at once, which is cheaper than
+     * calling get_term_id for each of them: the terms are resolved in a
+     * single sorted pass over the vocabulary.
+     *
+     * @param terms The terms to look up
+     * @return the term_id of each term, in the order given; a term that
+     * is not in the index gets the id unique_terms()
+     */
+    std::vector<term_id> get_term_ids(const std::vector<std::string>& terms);
+
     /**
      * @param t_id The term_id to get the original text for
      * @return the string representation of the term
      */
     std::string term_text(term_id t_id) const;
 
+    /**
+     * @return the term dictionary of the index, for prefix, range,
+     * wildcard, and fuzzy lookups of terms
+     */
+    const vocabulary_map& vocabulary() const;
+
+    /**
+     * Reports the memory held by the index: its postings, its lexicon,
+     * and its document metadata. Indexes that hold more, such as a cache
+     * of postings, add their own components.
+     * @return the memory used by each component of the index
+     */
+    virtual util::memory_report memory_usage() const;
+
+    /**
+     * @return whether search_primary() answers from a cache of postings
+     * (see cached_index), in which case an inverted_index reads the
+     * postings of its cursors through it as well
+     */
+    virtual bool caches_postings() const;
+
   protected:
     /// Forward declare the implementation
     class disk_index_impl;
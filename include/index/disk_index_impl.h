@@ -10,11 +10,17 @@
 #ifndef META_INDEX_DISK_INDEX_IMPL_H_
 #define META_INDEX_DISK_INDEX_IMPL_H_
 
+#include <memory>
 #include <mutex>
 
+#include "caching/dblru_cache.h"
+#include "index/deleted_docs.h"
 #include "index/disk_index.h"
+#include "index/doc_metadata.h"
+#include "index/field_store.h"
 #include "index/string_list.h"
 #include "index/vocabulary_map.h"
+#include "io/mmap_file.h"
 #include "util/disk_vector.h"
 #include "util/invertible_map.h"
 #include "util/optional.h"
@@ -58,7 +64,8 @@ class disk_index::disk_index_impl
 
     /**
      * Initializes the following metadata maps:
-     * doc_sizes_, labels_, unique_terms_
+     * doc_sizes_, labels_, unique_terms_, deleted_, and, when loading an
+     * existing index, doc_metadata_
      * @param num_docs The number of documents stored in the index
      */
     void initialize_metadata(uint64_t num_docs = 0);
@@ -82,7 +89,41 @@ class disk_index::disk_index_impl
     void load_unique_terms(uint64_t num_docs = 0);
 
     /**
-     * Loads the doc_id mapping.
+     * Loads the deleted documents, which must come after the doc sizes.
+     * @param num_docs The number of documents stored in the index; if
+     * nonzero, the index is new and no documents are deleted
+     */
+    void load_deleted_docs(uint64_t num_docs = 0);
+
+    /**
+     * Loads the packed per-document statistics, packing doc_sizes_ and
+     * unique_terms_ first if they have not been already.
+     * @param rebuild Whether to pack them again even if they have been
+     */
+    void load_doc_metadata(bool rebuild = false);
+
+    /**
+     * Loads the typed document fields, if the index has any.
+     */
+    void load_fields();
+
+    /**
+     * Creates a writer for the typed document fields declared in the
+     * configuration.
+     * @param num_docs The number of documents in the index
+     * @return the writer, or nullptr if no fields are declared
+     */
+    std::unique_ptr<field_store_writer>
+        make_field_writer(uint64_t num_docs) const;
+
+    /**
+     * @return the typed document fields declared in the configuration
+     */
+    const std::vector<field_spec>& field_specs() const;
+
+    /**
+     * Loads the doc_id mapping. The mapping is only opened when it is
+     * first used, so that opening an index does not wait on it.
      */
     void load_doc_id_mapping();
 
@@ -92,15 +133,39 @@ class disk_index::disk_index_impl
     void load_term_id_mapping();
 
     /**
-     * Loads the label_id mapping.
+     * Loads the label_id mapping. The mapping is only read when it is
+     * first used, so that opening an index does not wait on it.
      */
     void load_label_id_mapping();
 
     /**
-     * Loads the postings file.
+     * @return the doc_id -> document path mapping, opening it if this is
+     * its first use
+     */
+    const string_list& doc_id_mapping() const;
+
+    /**
+     * @return the class label <-> label_id mapping, reading it if this is
+     * its first use
+     */
+    const util::invertible_map<class_label, label_id>& label_ids() const;
+
+    /**
+     * Loads the postings file, bringing it into memory as configured.
      */
     void load_postings();
 
+    /**
+     * Reads the per-document metadata into memory now, unless the index
+     * is configured to read pages on demand.
+     */
+    void prefault_metadata() const;
+
+    /**
+     * @return how the files of the index are brought into memory
+     */
+    io::residency residency() const;
+
     /**
      * Saves the label_id mapping.
      */
@@ -156,6 +221,12 @@ class disk_index::disk_index_impl
      */
     std::vector<class_label> class_labels() const;
 
+    /**
+     * @return the bytes of postings that may be buffered while building
+     * the index, or 0 for the chunk_handler default
+     */
+    uint64_t ram_budget() const;
+
   private:
     /**
      * @param lbl the string class label to find the id for
@@ -167,11 +238,14 @@ class disk_index::disk_index_impl
     /// the location of this index
     std::string index_name_;
 
+    /// how the files of the index are brought into memory
+    io::residency residency_ = io::residency::on_demand;
+
     /**
      * doc_id -> document path mapping.
-     * Each index corresponds to a doc_id (uint64_t).
+     * Each index corresponds to a doc_id (uint64_t). Opened on first use.
      */
-    util::optional<string_list> doc_id_mapping_;
+    mutable util::optional<string_list> doc_id_mapping_;
 
     /**
      * doc_id -> document length mapping.
@@ -193,11 +267,37 @@ class disk_index::disk_index_impl
      */
     util::optional<util::disk_vector<uint64_t>> unique_terms_;
 
+    /**
+     * The lengths and unique term counts of the documents, packed
+     * together for the rankers; loaded once the index has been built.
+     */
+    util::optional<doc_metadata> doc_metadata_;
+
+    /// The typed document fields declared in the configuration
+    std::vector<field_spec> field_specs_;
+
+    /// The typed document fields, if the index has any
+    util::optional<field_store> fields_;
+
+    /// The documents that have been deleted from the index
+    std::unique_ptr<deleted_docs> deleted_;
+
     /// Maps string terms to term_ids.
     util::optional<vocabulary_map> term_id_mapping_;
 
+    /// The bytes of postings buffered while building the index, as given
+    /// in MB by "indexer-ram-budget", or 0 for the chunk_handler default
+    uint64_t ram_budget_ = 0;
+
+    /// The most recent term lookups, if enabled by "term-id-cache-size"
+    std::unique_ptr<caching::default_dblru_cache<std::string, term_id>>
+        term_id_cache_;
+
     /// Assigns an integer to each class label (used for liblinear mappings)
-    util::invertible_map<class_label, label_id> label_ids_;
+    mutable util::invertible_map<class_label, label_id> label_ids_;
+
+    /// Whether label_ids_ has yet to be read from disk
+    mutable bool label_ids_pending_ = false;
 
     /**
      * A pointer to a memory-mapped postings file. It is a pointer because
@@ -208,6 +308,9 @@ class disk_index::disk_index_impl
 
     /// mutex for thread-safe operations
     mutable std::mutex mutex_;
+
+    /// guards the metadata that is opened on first use
+    mutable std::mutex lazy_mutex_;
 };
 }
 }
@@ -0,0 +1,141 @@
+/**
+ * @file distributed_build.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_DISTRIBUTED_BUILD_H_
+#define META_INDEX_DISTRIBUTED_BUILD_H_
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "corpus/line_corpus.h"
+
+namespace meta
+{
+namespace index
+{
+
+class inverted_index;
+
+/**
+ * Builds one inverted index on several machines that share a filesystem,
+ * in three steps that any scheduler can run:
+ *
+ * 1. plan_build() splits the line corpus of the configuration into byte
+ *    ranges of about the same size (see corpus::line_corpus::partitions())
+ *    and saves them next to the index, as `<inverted-index>.plan`.
+ * 2. build_part(), run once for each part on any machine, tokenizes the
+ *    documents of the part with the usual indexing pipeline, into a
+ *    complete index of its own at `<inverted-index>.part-<n>`. The parts
+ *    are independent, so they may be built all at once.
+ * 3. merge_parts() merges the postings of the parts a term at a time
+ *    into the index the configuration names (see merge_indexes()), which
+ *    is then a standard inverted_index; or write_shard_configs() leaves
+ *    the parts as they are and writes a configuration that serves them
+ *    as the shards of a sharded_index.
+ *
+ * The documents of each part follow those of the parts before it, so
+ * either way every document has the doc_id it would have in an index of
+ * the whole corpus built on one machine. Documents' fields are not read
+ * from a partitioned corpus, so the corpus must not have any.
+ *
+ * The same steps also let a single machine build an index in checkpoints
+ * that survive a crash (see `build-checkpoints` in inverted_index).
+ */
+struct build_plan
+{
+    /// The number of documents in the corpus
+    uint64_t num_docs;
+    /// The partitions, in doc_id order
+    std::vector<corpus::line_corpus::partition> parts;
+};
+
+/**
+ * Splits the corpus of a configuration into parts and saves the plan.
+ * @param config_file The configuration of the index, whose corpus must be
+ * a line corpus
+ * @param num_parts The number of parts, usually a few per machine
+ * @return the plan
+ */
+build_plan plan_build(const std::string& config_file, uint64_t num_parts);
+
+/**
+ * @param config_file The configuration of the index
+ * @return the plan saved by plan_build()
+ */
+build_plan load_build_plan(const std::string& config_file);
+
+/**
+ * @param config_file The configuration of the index
+ * @param part The number of a part
+ * @return the directory of the part's index
+ */
+std::string part_name(const std::string& config_file, uint64_t part);
+
+/**
+ * Builds the index of one part of the plan, replacing any index already
+ * in its directory.
+ * @param config_file The configuration of the index
+ * @param part The number of the part
+ * @return the index of the part
+ */
+std::shared_ptr<inverted_index> build_part(const std::string& config_file,
+                                           uint64_t part);
+
+/**
+ * @param config_file The configuration of the index
+ * @param part The number of a part
+ * @return whether build_part() has finished the part's index
+ */
+bool part_built(const std::string& config_file, uint64_t part);
+
+/**
+ * Opens the index of every part of the plan.
+ * @param config_file The configuration of the index
+ * @return the indexes of the parts, in doc_id order
+ */
+std::vector<std::shared_ptr<inverted_index>>
+    load_parts(const std::string& config_file);
+
+/**
+ * Merges the indexes of every part of the plan into the index the
+ * configuration names. The parts are left in place.
+ * @param config_file The configuration of the index
+ * @return the merged index
+ */
+std::shared_ptr<inverted_index> merge_parts(const std::string& config_file);
+
+/**
+ * Writes a configuration for each part, naming its index, into the
+ * part's directory, and a configuration of a sharded_index with a shard
+ * per part (see sharded_index::load()).
+ * @param config_file The configuration of the index
+ * @param sharded_config The path to write the sharded configuration to
+ */
+void write_shard_configs(const std::string& config_file,
+                         const std::string& sharded_config);
+
+/**
+ * Deletes the plan and the indexes of its parts.
+ * @param config_file The configuration of the index
+ */
+void remove_build(const std::string& config_file);
+
+/**
+ * Basic exception for distributed builds.
+ */
+class distributed_build_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
@@ -0,0 +1,148 @@
+/**
+ * @file doc_metadata.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_DOC_METADATA_H_
+#define META_INDEX_DOC_METADATA_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "meta.h"
+#include "util/disk_vector.h"
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * The per-document statistics that rankers read for every posting (the
+ * length and the number of unique terms of each document), packed
+ * together into one read-only array.
+ *
+ * Each document's record holds its length and then its unique term
+ * count, each in just as many bits as the largest value of its column
+ * needs, and the records are stored back to back. Both statistics of a
+ * document are therefore read from one or two adjacent words, in place of
+ * the 16 bytes scattered over two files that the columns take on their
+ * own.
+ */
+class doc_metadata
+{
+  public:
+    /**
+     * The statistics of one document.
+     */
+    struct record
+    {
+        /// The length of the document
+        uint64_t length;
+        /// The number of unique terms in the document
+        uint64_t unique_terms;
+    };
+
+    /**
+     * Packs the columns of an index into a file.
+     * @param path The file to write
+     * @param lengths The length of each document
+     * @param unique_terms The number of unique terms in each document
+     */
+    static void write(const std::string& path,
+                      const util::disk_vector<double>& lengths,
+                      const util::disk_vector<uint64_t>& unique_terms);
+
+    /**
+     * Opens a file written by write().
+     * @param path The file to read
+     */
+    doc_metadata(const std::string& path);
+
+    /**
+     * doc_metadata may be move constructed.
+     */
+    doc_metadata(doc_metadata&&) = default;
+
+    /**
+     * doc_metadata may be move assigned.
+     */
+    doc_metadata& operator=(doc_metadata&&) = default;
+
+    /**
+     * @param d_id The document to look up; no bounds checking is
+     * performed
+     * @return the statistics of the document
+     */
+    record at(doc_id d_id) const;
+
+    /**
+     * @param d_id The document to look up
+     * @return the length of the document
+     */
+    uint64_t length(doc_id d_id) const;
+
+    /**
+     * @param d_id The document to look up
+     * @return the number of unique terms in the document
+     */
+    uint64_t unique_terms(doc_id d_id) const;
+
+    /**
+     * @return the number of documents
+     */
+    uint64_t size() const;
+
+    /**
+     * @return the memory used by the metadata
+     */
+    util::memory_usage memory_usage() const;
+
+    /**
+     * @return the number of bits each document's record takes
+     */
+    uint64_t record_bits() const;
+
+    /**
+     * Reads the whole array into memory now.
+     */
+    void prefault() const;
+
+    /**
+     * Basic exception for doc_metadata interactions.
+     */
+    class doc_metadata_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /**
+     * @param bit The position of the field's first bit
+     * @param width The number of bits in the field
+     * @return the value of the field
+     */
+    uint64_t field(uint64_t bit, uint64_t width) const;
+
+    /// The header (number of documents and the two field widths) followed
+    /// by the packed records
+    util::disk_vector<uint64_t> words_;
+
+    /// The number of documents
+    uint64_t num_docs_;
+
+    /// The number of bits in the length field
+    uint64_t length_bits_;
+
+    /// The number of bits in the unique terms field
+    uint64_t unique_bits_;
+};
+}
+}
+
+#endif
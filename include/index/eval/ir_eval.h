@@ -17,6 +17,7 @@
 #include <utility>
 #include <vector>
 #include "meta.h"
+#include "parallel/thread_pool.h"
 
 namespace meta
 {
@@ -32,6 +33,23 @@ class ir_eval
   public:
     using result_type = std::vector<std::pair<doc_id, double>>;
 
+    /**
+     * The scores of the results of one query.
+     */
+    struct query_stats
+    {
+        /// The precision of the results
+        double precision;
+        /// The recall of the results
+        double recall;
+        /// The F1 score of the results
+        double f1;
+        /// The NDCG of the results
+        double ndcg;
+        /// The average precision of the results
+        double avg_p;
+    };
+
     /**
      * @param config_file Path to cpptoml configuration file
      */
@@ -88,6 +106,23 @@ class ir_eval
     double avg_p(const result_type& results, query_id q_id,
                  uint64_t num_docs = std::numeric_limits<uint64_t>::max());
 
+    /**
+     * Scores the results of many queries on a pool of threads, each as
+     * precision(), recall(), f1(), ndcg() and avg_p() would. The average
+     * precisions are saved for map() and gmap() in the order of the
+     * queries, on the calling thread, so the aggregates are the same as
+     * those of a serial evaluation.
+     * @param results The ranked list of results of each query
+     * @param q_ids The query that produced each list of results
+     * @param num_docs The cutoff of every score
+     * @param pool The threads to score with
+     * @return the scores of each query, in the order of results
+     */
+    std::vector<query_stats>
+        evaluate(const std::vector<result_type>& results,
+                 const std::vector<query_id>& q_ids, uint64_t num_docs,
+                 parallel::thread_pool& pool);
+
     /**
      * @return the Mean Average Precision for a set of queries.
      * Note that avg_p() must be called in order for the individual query scores
@@ -132,6 +167,15 @@ class ir_eval
      */
     void init_index(const std::string& path);
 
+    /**
+     * @param results The ranked list of results
+     * @param q_id The query that was run to produce these results
+     * @param num_docs For avg_p@num_docs
+     * @return the average precision, without saving it
+     */
+    double average_precision(const result_type& results, query_id q_id,
+                             uint64_t num_docs) const;
+
     /**
      * @param results The ranked list of results
      * @param q_id The query that was run to produce these results
@@ -0,0 +1,134 @@
+/**
+ * @file feedback.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_FEEDBACK_H_
+#define META_INDEX_FEEDBACK_H_
+
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "corpus/document.h"
+#include "meta.h"
+
+namespace meta
+{
+namespace index
+{
+
+class forward_index;
+class inverted_index;
+class ranker;
+
+/**
+ * The ways of building an expanded query from feedback documents.
+ */
+enum class feedback_model
+{
+    /**
+     * Rocchio: the centroid of the feedback documents' term vectors,
+     * each term's relative frequency weighted by its idf.
+     */
+    rocchio,
+
+    /**
+     * RM3: the relevance model, in which each feedback document's
+     * relative term frequencies are weighted by how likely the document
+     * is given the query, estimated from its score.
+     */
+    rm3
+};
+
+/**
+ * Options for pseudo-relevance feedback.
+ */
+struct feedback_options
+{
+    /**
+     * How the expansion terms are chosen and weighted.
+     */
+    feedback_model model = feedback_model::rm3;
+
+    /**
+     * How many of the top documents are taken to be relevant.
+     */
+    uint64_t num_docs = 10;
+
+    /**
+     * How many expansion terms are added to the query.
+     */
+    uint64_t num_terms = 20;
+
+    /**
+     * The weight of the original query in the expanded one, between 0
+     * and 1; the expansion terms share the rest.
+     */
+    double original_weight = 0.5;
+
+    /**
+     * How many threads read the feedback documents' term vectors.
+     */
+    uint64_t num_threads = std::thread::hardware_concurrency();
+};
+
+/**
+ * Expands a query with the terms of documents taken to be relevant to it.
+ * The documents' term vectors are read from a forward index, in parallel,
+ * without parsing or tokenizing them again, and the expansion terms are
+ * weighted with the inverted index's lexicon statistics.
+ *
+ * The indexes must hold the same documents analyzed the same way, as
+ * when both are made from one configuration, so that they share term ids.
+ *
+ * @param idx The inverted index the query is run against
+ * @param fwd The forward index of the same documents
+ * @param query The query, which is tokenized first if it has not been
+ * @param results The documents taken to be relevant and their scores,
+ * best first; at most options.num_docs of them are used
+ * @param options How to choose the expansion terms
+ * @return the expanded query, whose weighted terms add up to the length
+ * of the original query
+ */
+corpus::document
+    expand_query(inverted_index& idx, const forward_index& fwd,
+                 corpus::document& query,
+                 const std::vector<std::pair<doc_id, double>>& results,
+                 const feedback_options& options = {});
+
+/**
+ * Scores a query with pseudo-relevance feedback in one call: the query is
+ * scored, expanded with its top results by expand_query(), and the
+ * expanded query is scored again.
+ *
+ * @param idx The inverted index to search
+ * @param fwd The forward index of the same documents
+ * @param r The ranker to score with
+ * @param query The query, which is tokenized first if it has not been
+ * @param num_results The number of results to return
+ * @param options How to choose the expansion terms
+ * @return the results of the expanded query
+ */
+std::vector<std::pair<doc_id, double>>
+    score_with_feedback(inverted_index& idx, const forward_index& fwd,
+                        ranker& r, corpus::document& query,
+                        uint64_t num_results = 10,
+                        const feedback_options& options = {});
+
+/**
+ * Basic exception for feedback interactions.
+ */
+class feedback_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
@@ -0,0 +1,259 @@
+/**
+ * @file field_store.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_FIELD_STORE_H_
+#define META_INDEX_FIELD_STORE_H_
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "meta.h"
+#include "index/string_list.h"
+#include "index/string_list_writer.h"
+#include "util/disk_vector.h"
+#include "util/optional.h"
+
+namespace cpptoml
+{
+class table;
+}
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * The types a document field may have.
+ */
+enum class field_type
+{
+    integer,
+    real,
+    string
+};
+
+/**
+ * The declaration of a document field.
+ */
+struct field_spec
+{
+    /// The name of the field
+    std::string name;
+    /// The type of the field's values
+    field_type type;
+};
+
+/**
+ * Reads the fields declared in a configuration, as an array of tables
+ * with a name and a type of "int", "double", or "string":
+ *
+ * ~~~toml
+ * [[fields]]
+ * name = "timestamp"
+ * type = "int"
+ * ~~~
+ *
+ * @param config The configuration
+ * @return the declared fields, in order
+ */
+std::vector<field_spec> parse_field_specs(const cpptoml::table& config);
+
+/**
+ * Writes the typed fields of an index's documents, one column per field,
+ * into a directory read by field_store. Values may be inserted from
+ * several threads at once and in any order of documents; the columns are
+ * complete once the writer is destroyed.
+ */
+class field_store_writer
+{
+  public:
+    /**
+     * @param dir The directory to write the columns to
+     * @param specs The fields to write
+     * @param num_docs The number of documents in the index
+     */
+    field_store_writer(const std::string& dir,
+                       const std::vector<field_spec>& specs,
+                       uint64_t num_docs);
+
+    /**
+     * Sets the field values of a document.
+     * @param d_id The document
+     * @param values The value of each field, as text, in the order of the
+     * field specs
+     */
+    void insert(doc_id d_id, const std::vector<std::string>& values);
+
+  private:
+    /// The fields being written
+    std::vector<field_spec> specs_;
+
+    /// The integer columns, by field
+    std::vector<util::optional<util::disk_vector<int64_t>>> integers_;
+
+    /// The real columns, by field
+    std::vector<util::optional<util::disk_vector<double>>> reals_;
+
+    /// The string columns, by field
+    std::vector<util::optional<string_list_writer>> strings_;
+};
+
+/**
+ * Read-only access to the typed fields of an index's documents. Each
+ * field is its own memory-mapped column, so a filter on one field reads
+ * nothing but that field's values.
+ */
+class field_store
+{
+  public:
+    /**
+     * A predicate on documents, as taken by the rankers' filters.
+     */
+    using filter_type = std::function<bool(doc_id)>;
+
+    /**
+     * @param dir The directory written by a field_store_writer
+     */
+    field_store(const std::string& dir);
+
+    /**
+     * field_store may be move constructed.
+     */
+    field_store(field_store&&) = default;
+
+    /**
+     * field_store may be move assigned.
+     */
+    field_store& operator=(field_store&&) = default;
+
+    /**
+     * @return the fields in the store, in the order they were declared
+     */
+    const std::vector<field_spec>& fields() const;
+
+    /**
+     * @param name The name of a field
+     * @return whether the store has the field
+     */
+    bool contains(const std::string& name) const;
+
+    /**
+     * @param name The name of an integer field
+     * @param d_id The document
+     * @return the value of the field for the document
+     */
+    int64_t int_value(const std::string& name, doc_id d_id) const;
+
+    /**
+     * @param name The name of a real field
+     * @param d_id The document
+     * @return the value of the field for the document
+     */
+    double real_value(const std::string& name, doc_id d_id) const;
+
+    /**
+     * @param name The name of a string field
+     * @param d_id The document
+     * @return the value of the field for the document
+     */
+    std::string string_value(const std::string& name, doc_id d_id) const;
+
+    /**
+     * @param d_id The document
+     * @return the value of every field for the document, as text, in the
+     * order of fields(); suitable for field_store_writer::insert()
+     */
+    std::vector<std::string> values(doc_id d_id) const;
+
+    /**
+     * Builds a filter for the documents whose integer field lies in a
+     * range. The field's column is scanned once, here, so calling the
+     * filter is a single bit test.
+     * @param name The name of an integer field
+     * @param lower The smallest value accepted
+     * @param upper The largest value accepted
+     * @return the filter
+     */
+    filter_type int_range(const std::string& name, int64_t lower,
+                          int64_t upper) const;
+
+    /**
+     * Builds a filter for the documents whose real field lies in a range,
+     * in the same way as int_range().
+     * @param name The name of a real field
+     * @param lower The smallest value accepted
+     * @param upper The largest value accepted
+     * @return the filter
+     */
+    filter_type real_range(const std::string& name, double lower,
+                           double upper) const;
+
+    /**
+     * Builds a filter for the documents whose string field has a value, in
+     * the same way as int_range().
+     * @param name The name of a string field
+     * @param value The value accepted
+     * @return the filter
+     */
+    filter_type string_equals(const std::string& name,
+                              const std::string& value) const;
+
+    /**
+     * @return the memory used by the fields
+     */
+    util::memory_usage memory_usage() const;
+
+    /**
+     * Basic exception for field store interactions.
+     */
+    class field_store_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /**
+     * @param name The name of a field
+     * @param type The type the field must have
+     * @return the position of the field in fields()
+     */
+    uint64_t find(const std::string& name, field_type type) const;
+
+    /**
+     * @param accept Whether to accept each document
+     * @return a filter accepting the documents accept accepts
+     */
+    filter_type make_filter(const std::function<bool(uint64_t)>& accept) const;
+
+    /// The fields in the store
+    std::vector<field_spec> specs_;
+
+    /// The position of each field in specs_
+    std::unordered_map<std::string, uint64_t> positions_;
+
+    /// The number of documents
+    uint64_t num_docs_;
+
+    /// The integer columns, by field
+    std::vector<util::optional<util::disk_vector<int64_t>>> integers_;
+
+    /// The real columns, by field
+    std::vector<util::optional<util::disk_vector<double>>> reals_;
+
+    /// The string columns, by field
+    std::vector<util::optional<string_list>> strings_;
+};
+}
+}
+
+#endif
@@ -11,9 +11,13 @@
 #define META_FORWARD_INDEX_H_
 
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
+#include "index/csr_matrix.h"
 #include "index/disk_index.h"
 #include "index/make_index.h"
+#include "index/postings_data_fwd.h"
 #include "util/disk_vector.h"
 #include "meta.h"
 
@@ -23,12 +27,6 @@ namespace corpus
 {
 class corpus;
 }
-
-namespace index
-{
-template <class, class>
-class postings_data;
-}
 }
 
 namespace meta
@@ -117,9 +115,35 @@ class forward_index : public disk_index
     virtual std::shared_ptr<postings_data_type>
         search_primary(doc_id d_id) const;
 
+    /**
+     * Decodes the postings for a document into a caller-provided
+     * container, so that repeated lookups (e.g. over several training
+     * epochs) can reuse its memory.
+     * @param d_id The doc_id to search for
+     * @param counts The container to store the (term_id, count) pairs in;
+     * its previous contents are replaced
+     */
+    void read_counts(doc_id d_id,
+                     std::vector<std::pair<term_id, double>>& counts) const;
+
+    /**
+     * Decodes the postings of a set of documents, once, into a matrix with
+     * a row for each of them, so that learners passing over the documents
+     * many times can read them directly. Term ids must fit in 32 bits, and
+     * values are stored as floats.
+     * @param docs The documents of the rows, in order
+     * @param prefix If not empty, the pairs are written to the files
+     * prefix + ".terms" and prefix + ".values" and memory-mapped from
+     * there, for sets too large to hold in memory
+     * @return the matrix
+     */
+    csr_matrix materialize(const std::vector<doc_id>& docs,
+                           const std::string& prefix = "") const;
+
     /**
      * @param d_id The document id of the doc to convert to liblinear format
-     * @return the string representation liblinear format
+     * @return the string representation liblinear format, with the
+     * document's label_id as its class
      */
     std::string liblinear_data(doc_id d_id) const;
 
@@ -128,6 +152,12 @@ class forward_index : public disk_index
      */
     virtual uint64_t unique_terms() const override;
 
+    /**
+     * @return the memory used by each component of the index, with the
+     * document offsets counted among the postings
+     */
+    virtual util::memory_report memory_usage() const override;
+
   private:
     /**
      * This function loads a disk index from its filesystem
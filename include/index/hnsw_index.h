@@ -0,0 +1,191 @@
+/**
+ * @file hnsw_index.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_HNSW_INDEX_H_
+#define META_INDEX_HNSW_INDEX_H_
+
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "index/csr_matrix.h"
+#include "meta.h"
+
+namespace meta
+{
+namespace index
+{
+
+class forward_index;
+
+/**
+ * Parameters for building and searching an hnsw_index.
+ */
+struct hnsw_options
+{
+    /**
+     * The number of links of a node on each layer above the bottom
+     * one, which has twice as many.
+     */
+    uint64_t links = 16;
+
+    /**
+     * The number of candidate neighbors kept while inserting a node;
+     * larger values build a better graph, more slowly.
+     */
+    uint64_t ef_construction = 100;
+
+    /**
+     * The number of candidate neighbors kept while searching, at least
+     * the number of neighbors asked for; larger values find the true
+     * nearest neighbors more often, more slowly.
+     */
+    uint64_t ef_search = 50;
+
+    /**
+     * The seed for the random number generator that picks the layer
+     * of each node.
+     */
+    uint64_t seed = 1;
+};
+
+/**
+ * An approximate nearest-neighbor index over the TF-IDF vectors of a set
+ * of documents, by cosine similarity: a hierarchical navigable small world
+ * graph (Malkov and Yashunin). Every document is a node linked to similar
+ * documents on the bottom layer of the graph, and to fewer, more distant
+ * ones on the exponentially sparser layers above. A query descends
+ * greedily from the top layer, then searches the bottom layer from where
+ * it lands, comparing itself to a number of documents that grows with the
+ * logarithm of their count rather than to all of them.
+ */
+class hnsw_index
+{
+  public:
+    /**
+     * Indexes a set of documents. The inverse document frequencies of the
+     * terms are computed over these documents.
+     * @param idx The index holding the documents
+     * @param docs The documents to index
+     * @param opts The parameters of the graph
+     */
+    hnsw_index(const forward_index& idx, const std::vector<doc_id>& docs,
+               const hnsw_options& opts = hnsw_options{});
+
+    /**
+     * Finds approximate nearest neighbors of a document, which need not be
+     * one of the indexed documents. May be called from several threads at
+     * once.
+     * @param counts The (term id, count) pairs of the query document
+     * @param k The number of neighbors to find
+     * @return at most k indexed documents and their cosine similarity to
+     * the query, most similar first
+     */
+    std::vector<std::pair<doc_id, double>>
+        neighbors(const std::vector<std::pair<term_id, double>>& counts,
+                  uint64_t k) const;
+
+    /**
+     * @return the number of indexed documents
+     */
+    uint64_t size() const;
+
+    /**
+     * Basic exception for hnsw_index interactions.
+     */
+    class hnsw_index_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /// A sparse vector, in increasing order of term id
+    using vector_type = std::vector<std::pair<term_id, double>>;
+
+    /// A node of the graph and its similarity to a query
+    using scored_node = std::pair<double, uint64_t>;
+
+    /**
+     * @param node A node of the graph
+     * @return the unit TF-IDF vector of the node's document
+     */
+    vector_type vector(uint64_t node) const;
+
+    /**
+     * @param query A unit TF-IDF vector
+     * @param node A node of the graph
+     * @return the cosine similarity of the query and the node's document
+     */
+    double similarity(const vector_type& query, uint64_t node) const;
+
+    /**
+     * @param a A node of the graph
+     * @param b Another node of the graph
+     * @return the cosine similarity of the nodes' documents
+     */
+    double similarity(uint64_t a, uint64_t b) const;
+
+    /**
+     * Finds the nodes of a layer most similar to a query, searching
+     * outwards from some entry points.
+     * @param query A unit TF-IDF vector
+     * @param entry The nodes to start from
+     * @param ef The number of nodes to find
+     * @param layer The layer to search
+     * @return at most ef nodes, most similar first
+     */
+    std::vector<scored_node> search_layer(const vector_type& query,
+                                          const std::vector<scored_node>& entry,
+                                          uint64_t ef, uint64_t layer) const;
+
+    /**
+     * Chooses the nodes a node links to, by the heuristic of Malkov and
+     * Yashunin.
+     * @param candidates Nodes and their similarity to the linking node,
+     * most similar first
+     * @param num_links The largest number of nodes to choose
+     * @return the chosen nodes
+     */
+    std::vector<uint64_t> select(const std::vector<scored_node>& candidates,
+                                 uint64_t num_links) const;
+
+    /**
+     * Links a node into the graph.
+     * @param node The node, whose layer is already chosen
+     */
+    void insert(uint64_t node);
+
+    /**
+     * @param layer A layer of the graph
+     * @return the largest number of links of a node on the layer
+     */
+    uint64_t max_links(uint64_t layer) const;
+
+    /// The unit TF-IDF vector of each node
+    csr_matrix vectors_;
+
+    /// The inverse document frequency of each term
+    std::vector<double> idf_;
+
+    /// The parameters of the graph
+    hnsw_options opts_;
+
+    /// The links of each node, on each of its layers
+    std::vector<std::vector<std::vector<uint64_t>>> links_;
+
+    /// The node searches start from, on the top layer
+    uint64_t entry_;
+
+    /// The top layer of the graph
+    uint64_t top_layer_;
+};
+}
+}
+
+#endif
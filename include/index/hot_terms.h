@@ -0,0 +1,70 @@
+/**
+ * @file hot_terms.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_HOT_TERMS_H_
+#define META_INDEX_HOT_TERMS_H_
+
+#include <istream>
+#include <vector>
+
+#include "meta.h"
+
+namespace meta
+{
+namespace index
+{
+
+class inverted_index;
+
+/**
+ * Finds the terms that a query log uses most often, for warming the cache
+ * of a cached_index with cached_index::warm_cache(). Each line of the log
+ * is one query, tokenized with the index's analyzer; a term counts once
+ * for every query it appears in.
+ *
+ * @param idx The index the queries will be run against
+ * @param queries The query log
+ * @param max_terms The number of terms to return
+ * @return the most frequent query terms that are in the index, most
+ * frequent first
+ */
+std::vector<term_id> hot_terms_from_queries(inverted_index& idx,
+                                            std::istream& queries,
+                                            uint64_t max_terms);
+
+/**
+ * Finds the most frequent terms in a list of term frequencies, for warming
+ * the cache of a cached_index with cached_index::warm_cache(). Each line
+ * of the list holds a term, as the index stores it, and its frequency,
+ * separated by whitespace.
+ *
+ * @param idx The index the terms belong to
+ * @param counts The list of terms and frequencies
+ * @param max_terms The number of terms to return
+ * @return the most frequent terms that are in the index, most frequent
+ * first
+ */
+std::vector<term_id> hot_terms_from_counts(inverted_index& idx,
+                                           std::istream& counts,
+                                           uint64_t max_terms);
+
+/**
+ * Finds the terms that occur in the most documents, whose postings lists
+ * are the longest, for placing in the hot tier of an index with
+ * inverted_index::tier_postings() when there is no query log to go by.
+ *
+ * @param idx The index the terms belong to
+ * @param max_terms The number of terms to return
+ * @return the terms with the highest document frequency, highest first
+ */
+std::vector<term_id> hot_terms_by_doc_freq(const inverted_index& idx,
+                                           uint64_t max_terms);
+}
+}
+
+#endif
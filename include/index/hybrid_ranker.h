@@ -0,0 +1,172 @@
+/**
+ * @file hybrid_ranker.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_HYBRID_RANKER_H_
+#define META_INDEX_HYBRID_RANKER_H_
+
+#include <functional>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "meta.h"
+
+namespace cpptoml
+{
+class table;
+}
+
+namespace meta
+{
+
+namespace corpus
+{
+class document;
+}
+
+namespace index
+{
+
+class inverted_index;
+class ivf_index;
+class ranker;
+class vector_store;
+
+/**
+ * How a hybrid_ranker combines the lexical and dense scores of a
+ * document.
+ */
+enum class fusion_method
+{
+    /**
+     * A weighted sum of the two scores, each scaled to [0, 1] from the
+     * worst to the best of it over the candidates. A document without a
+     * vector has a scaled dense score of zero.
+     */
+    linear,
+    /**
+     * Reciprocal rank fusion (Cormack et al.): the sum over the two
+     * candidate lists of 1 / (rank_constant + rank), which needs no
+     * calibration of the scores.
+     */
+    reciprocal_rank
+};
+
+/**
+ * Options for hybrid retrieval.
+ */
+struct hybrid_options
+{
+    /**
+     * How the two scores of a document are combined.
+     */
+    fusion_method fusion = fusion_method::linear;
+
+    /**
+     * The weight of the dense score in linear fusion; the lexical score
+     * has one minus this weight.
+     */
+    double dense_weight = 0.5;
+
+    /**
+     * The number of candidates taken from each of the lexical ranker and
+     * the dense vectors, at least the number of results.
+     */
+    uint64_t candidates = 100;
+
+    /**
+     * The constant added to ranks in reciprocal rank fusion.
+     */
+    double rank_constant = 60;
+};
+
+/**
+ * Ranks documents by both a lexical ranker (such as okapi_bm25) over an
+ * inverted index and dense vectors of the documents, such as embeddings
+ * computed offline, in one process.
+ *
+ * The best candidates of each are found separately: the lexical ones
+ * with ranker::score(), and the dense ones with an ivf_index or, without
+ * one, by scoring every vector of the store. In linear fusion, each
+ * candidate then gets the score it lacks: the dense scores of the lexical
+ * candidates are inner products with their stored vectors, and the
+ * lexical scores of the dense candidates come from a second ranker::score()
+ * restricted to them, so every fused score uses both exact scores.
+ * Reciprocal rank fusion uses only the ranks within each list.
+ *
+ * The store's doc_ids must be the index's. Documents without a vector
+ * are scored by the lexical ranker alone.
+ */
+class hybrid_ranker
+{
+  public:
+    /**
+     * @param lexical The ranker of the query terms
+     * @param vectors The dense vectors of the documents
+     * @param ann An index of the vectors to find dense candidates with,
+     * or nullptr to score every vector
+     * @param options How the scores are combined
+     */
+    hybrid_ranker(ranker& lexical, const vector_store& vectors,
+                  const ivf_index* ann = nullptr,
+                  const hybrid_options& options = hybrid_options{});
+
+    /**
+     * Scores a query given as both terms and a dense vector. May be
+     * called from several threads at once.
+     * @param idx The index the lexical ranker is operating on
+     * @param query The query terms
+     * @param embedding The query's dense vector, of the store's dims()
+     * @param num_results The number of results to return in the vector
+     * @param filter A filtering function to apply to each doc_id; returns
+     * true if the document should be included in results. Deleted
+     * documents are never included, and an empty filter includes every
+     * other one.
+     * @return the best documents by fused score, best first
+     */
+    std::vector<std::pair<doc_id, double>>
+        score(inverted_index& idx, corpus::document& query,
+              const std::vector<float>& embedding, uint64_t num_results = 10,
+              const std::function<bool(doc_id d_id)>& filter = nullptr);
+
+  private:
+    /// The ranker of the query terms
+    ranker* lexical_;
+
+    /// The dense vectors of the documents
+    const vector_store* vectors_;
+
+    /// The index of the vectors, if any
+    const ivf_index* ann_;
+
+    /// How the scores are combined
+    hybrid_options options_;
+};
+
+/**
+ * Reads hybrid retrieval options from the `[hybrid]` table of a
+ * configuration, which may set `fusion` ("linear" or "rrf"),
+ * `dense-weight`, `candidates`, and `rank-constant`. Options that are not
+ * set keep their default.
+ * @param config The configuration
+ * @return the options
+ */
+hybrid_options make_hybrid_options(const cpptoml::table& config);
+
+/**
+ * Basic exception for hybrid_ranker interactions.
+ */
+class hybrid_ranker_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
@@ -0,0 +1,162 @@
+/**
+ * @file impact_index.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_IMPACT_INDEX_H_
+#define META_INDEX_IMPACT_INDEX_H_
+
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "io/mmap_file.h"
+#include "meta.h"
+#include "util/disk_vector.h"
+#include "util/optional.h"
+
+namespace cpptoml
+{
+class table;
+}
+
+namespace meta
+{
+namespace corpus
+{
+class document;
+}
+
+namespace index
+{
+
+class inverted_index;
+class ranker;
+
+/**
+ * Precomputed, quantized scores of the postings of an inverted_index for
+ * one ranker, for fast approximate top-k retrieval.
+ *
+ * The score a ranker gives a posting for a query term of weight one (its
+ * impact) is computed once, when the impacts are built, and quantized to
+ * eight bits on a per-term scale. Each term's postings are stored in
+ * segments of equal impact, highest first, and a query is processed
+ * score-at-a-time: every query term's segments are visited in order of
+ * decreasing weighted impact, adding to the scores of their documents.
+ * Processing stops as soon as no remaining segment can change which
+ * documents are in the top k, or once a budget of postings is spent.
+ *
+ * Rankers whose scores have a per-document part (the language models'
+ * document constants) have it stored as a prior per document, scaled by
+ * the query's length. Everything else about the ranker is fixed when the
+ * impacts are built: query term weights only scale the impacts, so
+ * rankers that treat query term weights non-linearly (such as BM25's k3)
+ * are approximated by their score at weight one.
+ *
+ * The impacts live in the "impacts" directory of the index.
+ */
+class impact_index
+{
+  public:
+    /**
+     * Opens the impacts of an index for a ranker, building them first if
+     * they have not been built, or were built for different ranker
+     * parameters or a different version of the index.
+     * @param idx The index
+     * @param r The ranker whose scores to precompute
+     * @param num_threads The number of threads to build with
+     */
+    impact_index(inverted_index& idx, ranker& r,
+                 uint64_t num_threads = std::thread::hardware_concurrency());
+
+    /**
+     * impact_index may be move constructed.
+     */
+    impact_index(impact_index&&) = default;
+
+    /**
+     * Scores a query with the precomputed impacts.
+     * @param query The query, which is tokenized first if it has not been
+     * @param num_results The number of results to return
+     * @param max_postings The number of postings after which to stop even
+     * if the top k could still change
+     * @return the best documents and their approximate scores, best first
+     */
+    std::vector<std::pair<doc_id, double>>
+        score(corpus::document& query, uint64_t num_results = 10,
+              uint64_t max_postings = std::numeric_limits<uint64_t>::max());
+
+    /**
+     * @return the description of the ranker the impacts were built for
+     * (see ranker::parameters())
+     */
+    const std::string& parameters() const;
+
+    /**
+     * Basic exception for impact_index interactions.
+     */
+    class impact_index_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /**
+     * Writes the impacts of every posting of the index.
+     * @param r The ranker whose scores to precompute
+     * @param num_threads The number of threads to build with
+     */
+    void build(ranker& r, uint64_t num_threads);
+
+    /**
+     * @return a description of the index and ranker the impacts are for,
+     * written with them so that stale impacts are rebuilt
+     * @param r The ranker
+     */
+    std::string signature(ranker& r) const;
+
+    /// The index the impacts are for
+    inverted_index* idx_;
+
+    /// The directory the impacts are stored in
+    std::string dir_;
+
+    /// The description of the ranker the impacts were built for
+    std::string parameters_;
+
+    /// The segments of every term
+    util::optional<io::mmap_file> postings_;
+
+    /// The position of each term's segments in postings_
+    util::optional<util::disk_vector<uint64_t>> offsets_;
+
+    /// The per-document part of the score, for a query of length one
+    util::optional<util::disk_vector<double>> priors_;
+
+    /// The largest prior
+    double max_prior_;
+};
+
+/**
+ * Opens the impacts of an index for the ranker described by the
+ * `[impacts]` table of a configuration, which takes the same keys as the
+ * `[ranker]` table, building them if needed.
+ * @param idx The index
+ * @param config The configuration
+ * @return the impacts, or nullptr if the configuration has no `[impacts]`
+ * table
+ */
+std::unique_ptr<impact_index> make_impact_index(inverted_index& idx,
+                                                const cpptoml::table& config);
+}
+}
+
+#endif
@@ -0,0 +1,144 @@
+/**
+ * @file index_handle.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_INDEX_HANDLE_H_
+#define META_INDEX_INDEX_HANDLE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+
+namespace meta
+{
+
+namespace parallel
+{
+class thread_pool;
+}
+
+namespace index
+{
+
+/**
+ * A handle to the current version of an index, through which a server can
+ * replace the index with a rebuilt one without stopping.
+ *
+ * A query takes a snapshot() of the handle and runs on it. Replacing the
+ * index, with swap() or reload(), publishes a new version for the
+ * snapshots taken after it; the queries that hold the old version finish
+ * on it, and it is closed when the last of them drops its snapshot (a
+ * read-copy-update scheme, with shared_ptr counts as the grace period).
+ * reload() opens the new version on a thread pool, so the queries never
+ * wait on load_index(), and keeps serving the old one if opening fails.
+ *
+ * A new version must be built in its own directory: rebuilding an index
+ * in place would change the files the old version has mapped.
+ *
+ * ~~~cpp
+ * index::index_handle<index::dblru_inverted_index> handle{
+ *     index::make_index<index::dblru_inverted_index>(config, 10000)};
+ *
+ * // in each query
+ * auto idx = handle.snapshot();
+ * auto results = ranker->score(*idx, query);
+ *
+ * // once index-v2 is built
+ * handle.reload([&]()
+ * {
+ *     return index::make_index<index::dblru_inverted_index>(config_v2,
+ *                                                           10000);
+ * }, pool, index::index_handle<index::dblru_inverted_index>::carry_cache);
+ * ~~~
+ */
+template <class Index>
+class index_handle
+{
+  public:
+    /// A version of the index
+    using index_ptr = std::shared_ptr<Index>;
+
+    /// Opens a new version of the index
+    using open_function = std::function<index_ptr()>;
+
+    /// Prepares a new version of the index from the current one before it
+    /// is published, such as by warming its cache
+    using prepare_function = std::function<void(const Index&, Index&)>;
+
+    /**
+     * @param idx The first version of the index
+     */
+    explicit index_handle(index_ptr idx);
+
+    /**
+     * May be called from several threads at once.
+     * @return the current version of the index, which stays open for as
+     * long as the snapshot is held, even if a new version is published
+     */
+    index_ptr snapshot() const;
+
+    /**
+     * @return the number of versions published since the first, which
+     * is zero
+     */
+    uint64_t version() const;
+
+    /**
+     * Publishes a new version of the index.
+     * @param next The new version
+     * @return the replaced version, which closes when it and every
+     * snapshot of it are dropped
+     */
+    index_ptr swap(index_ptr next);
+
+    /**
+     * Opens a new version of the index on a thread pool, prepares it from
+     * the current version, and publishes it, while queries go on using
+     * the current version. If opening or preparing throws, nothing is
+     * published and the future holds the exception. Reloads that overlap
+     * publish in the order they finish. The handle must outlive the
+     * reload.
+     * @param open Opens the new version, as with make_index()
+     * @param pool The thread pool to open it on
+     * @param prepare Called with the current and the new version before
+     * the new one is published, or empty for nothing
+     * @return the replaced version, once the new one is published
+     */
+    std::future<index_ptr> reload(open_function open,
+                                  parallel::thread_pool& pool,
+                                  prepare_function prepare = nullptr);
+
+    /**
+     * Warms the cache of a new version of a cached inverted index with
+     * the terms cached by the current version (see
+     * cached_index::warm_from()), for use as the prepare function of
+     * reload().
+     * @param current The current version
+     * @param next The new version
+     */
+    static void carry_cache(const Index& current, Index& next);
+
+  private:
+    /// The current version of the index
+    index_ptr current_;
+
+    /// The number of versions published since the first
+    std::atomic<uint64_t> version_;
+
+#if !META_HAS_STD_SHARED_PTR_ATOMICS
+    /// Guards current_ where shared_ptrs have no atomic operations
+    mutable std::mutex mutex_;
+#endif
+};
+}
+}
+
+#include "index/index_handle.tcc"
+#endif
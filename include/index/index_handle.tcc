@@ -0,0 +1,75 @@
+/**
+ * @file index_handle.tcc
+ */
+
+#include "index/index_handle.h"
+#include "parallel/thread_pool.h"
+
+namespace meta
+{
+namespace index
+{
+
+template <class Index>
+index_handle<Index>::index_handle(index_ptr idx)
+    : current_{std::move(idx)}, version_{0}
+{
+    // nothing
+}
+
+template <class Index>
+auto index_handle<Index>::snapshot() const -> index_ptr
+{
+#if META_HAS_STD_SHARED_PTR_ATOMICS
+    return std::atomic_load(&current_);
+#else
+    std::lock_guard<std::mutex> lock{mutex_};
+    return current_;
+#endif
+}
+
+template <class Index>
+uint64_t index_handle<Index>::version() const
+{
+    return version_.load();
+}
+
+template <class Index>
+auto index_handle<Index>::swap(index_ptr next) -> index_ptr
+{
+#if META_HAS_STD_SHARED_PTR_ATOMICS
+    auto previous = std::atomic_exchange(&current_, std::move(next));
+#else
+    index_ptr previous;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        previous = std::move(current_);
+        current_ = std::move(next);
+    }
+#endif
+    ++version_;
+    return previous;
+}
+
+template <class Index>
+auto index_handle<Index>::reload(open_function open,
+                                 parallel::thread_pool& pool,
+                                 prepare_function prepare)
+    -> std::future<index_ptr>
+{
+    return pool.submit_task([this, open, prepare]()
+                            {
+        auto next = open();
+        if (prepare)
+            prepare(*snapshot(), *next);
+        return swap(std::move(next));
+    });
+}
+
+template <class Index>
+void index_handle<Index>::carry_cache(const Index& current, Index& next)
+{
+    next.warm_from(current);
+}
+}
+}
@@ -11,11 +11,16 @@
 #ifndef META_INVERTED_INDEX_H_
 #define META_INVERTED_INDEX_H_
 
+#include <functional>
+#include <memory>
 #include <queue>
 #include <stdexcept>
+#include <utility>
+#include <vector>
 
 #include "index/disk_index.h"
 #include "index/make_index.h"
+#include "index/postings_data_fwd.h"
 
 namespace meta
 {
@@ -31,9 +36,12 @@ namespace index
 
 template <class>
 class chunk_handler;
-
-template <class, class>
-class postings_data;
+class segmented_index;
+class live_segment;
+class postings_cursor;
+class positions_cursor;
+class ranker;
+struct pruning_options;
 }
 }
 
@@ -50,6 +58,12 @@ namespace index
  * postings file containing the (term_id -> each doc_id) information is saved on
  * disk. A lexicon (or "dictionary") contains pointers into the large postings
  * file. It is assumed that the lexicon will fit in memory.
+ *
+ * With `feature-hashing = true` in the configuration, documents are
+ * tokenized into the feature ids of a corpus::feature_vocabulary shared by
+ * all of the indexing threads, so that each term's text is stored only
+ * once instead of once per document containing it. The index created is
+ * the same either way.
  */
 class inverted_index : public disk_index
 {
@@ -84,6 +98,40 @@ class inverted_index : public disk_index
     friend std::shared_ptr<cached_index<Index, Cache>>
         make_index(const std::string& config_file, Args&&... args);
 
+    /**
+     * segmented_index creates, loads, and merges the inverted_index of each
+     * of its segments.
+     */
+    friend class segmented_index;
+
+    /**
+     * live_segment analyzes its documents with an unloaded inverted_index.
+     */
+    friend class live_segment;
+
+    /**
+     * prune_index creates an inverted_index from some of the postings of
+     * another.
+     */
+    friend std::shared_ptr<inverted_index>
+        prune_index(const std::shared_ptr<inverted_index>& source, ranker& r,
+                    const std::string& config_file,
+                    const pruning_options& options);
+
+    /**
+     * build_part creates an inverted_index from one part of a corpus.
+     */
+    friend std::shared_ptr<inverted_index>
+        build_part(const std::string& config_file, uint64_t part);
+
+    /**
+     * merge_indexes creates an inverted_index from the postings of others.
+     */
+    friend std::shared_ptr<inverted_index>
+        merge_indexes(const std::vector<std::shared_ptr<inverted_index>>&
+                          sources,
+                      const std::string& config_file);
+
   protected:
     /**
      * @param config The table that specifies how to create the
@@ -91,6 +139,13 @@ class inverted_index : public disk_index
      */
     inverted_index(const cpptoml::table& config);
 
+    /**
+     * @param config The table that specifies how to create the index
+     * @param name The directory of the index, used in place of the one in
+     * the configuration
+     */
+    inverted_index(const cpptoml::table& config, const std::string& name);
+
   public:
     /**
      * Move constructs a inverted_index.
@@ -129,6 +184,68 @@ class inverted_index : public disk_index
     virtual std::shared_ptr<postings_data_type>
         search_primary(term_id t_id) const;
 
+    /**
+     * @return the memory used by each component of the index, with the
+     * term positions counted among the postings and the per-term
+     * statistics among the lexicon
+     */
+    virtual util::memory_report memory_usage() const override;
+
+    /**
+     * @param t_id The term_id to search for
+     * @return a cursor over the postings for the given term_id, which
+     * decodes blocks directly from the postings file as it is advanced.
+     * Unlike search_primary(), this allocates nothing per posting, so
+     * rankers should prefer it. If the index caches its postings (see
+     * caches_postings()), the cursor walks the postings search_primary()
+     * returns instead.
+     */
+    postings_cursor cursor(term_id t_id) const;
+
+    /**
+     * @return whether this index stores the position of every term
+     * occurrence, which is enabled by `store-positions = true` in the
+     * configuration
+     */
+    bool has_positions() const;
+
+    /**
+     * @param t_id The term_id to search for
+     * @return a cursor over the postings for the given term_id that can
+     * also report the positions of the term in each document
+     */
+    positions_cursor positions(term_id t_id) const;
+
+    /**
+     * Copies the postings of some terms into a second, much smaller
+     * postings file, the hot tier, from which cursor() and
+     * search_primary() then read them. Queries mostly read the postings
+     * of a few terms (see hot_terms_by_doc_freq() and
+     * hot_terms_from_queries()), so the hot tier can be kept on fast
+     * storage or in memory while the postings file of the whole index
+     * stays on cheaper storage. The postings file is left as it is.
+     *
+     * The hot tier is written to `postings.hot` in the index, or to the
+     * path given by `hot-postings` in the configuration, which must then
+     * be given whenever the index is opened. It is brought into memory
+     * like the rest of the index, unless `hot-postings-residency` says
+     * otherwise (see io::parse_residency()). A lexicon beside the
+     * index's own, `lexicon.hot`, marks the terms in the tier.
+     *
+     * This must not be called while the index is being searched.
+     *
+     * @param terms The terms to put in the hot tier, replacing any that
+     * are there; if empty, the hot tier is removed
+     * @return the size of the hot tier's postings file, in bytes
+     */
+    uint64_t tier_postings(const std::vector<term_id>& terms);
+
+    /**
+     * @param t_id The term_id to search for
+     * @return whether the term's postings are read from the hot tier
+     */
+    bool in_hot_tier(term_id t_id) const;
+
     /**
      * @param t_id The term to search for
      * @return the document frequency of a term (number of documents it
@@ -142,6 +259,18 @@ class inverted_index : public disk_index
      */
     uint64_t term_freq(term_id t_id, doc_id d_id) const;
 
+    /**
+     * Looks up the counts of many (term, document) pairs at once. The
+     * pairs are visited in order by term and then by document, so each
+     * term's postings are read only once and its cursor only ever skips
+     * forward; pairs that are already sorted this way are not reordered.
+     * @param pairs The (term_id, doc_id) pairs, in any order
+     * @return the number of times each pair's term appears in its
+     * document, in the order of the pairs
+     */
+    std::vector<uint64_t>
+        term_freqs(const std::vector<std::pair<term_id, doc_id>>& pairs) const;
+
     /**
      * @return the total number of terms in this index
      */
@@ -153,6 +282,14 @@ class inverted_index : public disk_index
      */
     uint64_t total_num_occurences(term_id t_id) const;
 
+    /**
+     * @param t_id The specified term
+     * @return the probability of the term in the collection language
+     * model: the number of times it appears in the corpus over the total
+     * number of terms, as computed when the index was built
+     */
+    double collection_probability(term_id t_id);
+
     /**
      * @return the average document length in this index
      */
@@ -166,6 +303,68 @@ class inverted_index : public disk_index
      */
     void create_index(const std::string& config_file);
 
+    /**
+     * Creates the index from a line corpus in parts that are kept once
+     * they are built, as by build_part(), and then merges them. The plan
+     * of the parts is the build's manifest: a build that is interrupted,
+     * and so leaves the index invalid, resumes with the first part that
+     * was not finished, or with the merge if every part was. This is
+     * enabled by `build-checkpoints = N` in the configuration, which
+     * builds the index in N parts.
+     * @param config_file The configuration to be used
+     * @param num_docs The number of documents in the corpus
+     */
+    void create_index_in_parts(const std::string& config_file,
+                               uint64_t num_docs);
+
+    /**
+     * Creates the index from the given documents rather than the corpus
+     * named in the configuration.
+     * @param config_file The configuration to be used
+     * @param docs The documents to index
+     */
+    void create_index(const std::string& config_file, corpus::corpus& docs);
+
+    /**
+     * Creates the index by concatenating other indexes built with the same
+     * configuration, without tokenizing their documents again. The
+     * documents of each source follow those of the sources before it.
+     * @param config_file The configuration to be used
+     * @param sources The indexes to combine
+     */
+    void create_index(const std::string& config_file,
+                      const std::vector<std::shared_ptr<inverted_index>>&
+                          sources);
+
+    /**
+     * Creates the index from the postings of another index that a
+     * predicate keeps. The documents, their lengths, and the document
+     * frequency and total count of every term are those of the source, so
+     * that the kept postings score as they do in the source.
+     * @param config_file The configuration to be used
+     * @param source The index to prune
+     * @param keep Whether to keep a posting, given its term and document
+     * in the source and its count
+     */
+    void create_index(const std::string& config_file,
+                      const std::shared_ptr<inverted_index>& source,
+                      const std::function<bool(term_id, doc_id, uint64_t)>&
+                          keep);
+
+    /**
+     * Writes the documents and the postings of the sources, which are
+     * concatenated as in the merging create_index().
+     * @param config_file The configuration to be used
+     * @param sources The indexes to copy
+     * @param keep Whether to keep a posting, given its term and document
+     * in its source and its count; every posting is kept if it is empty
+     */
+    void copy_postings(const std::string& config_file,
+                       const std::vector<std::shared_ptr<inverted_index>>&
+                           sources,
+                       const std::function<bool(term_id, doc_id, uint64_t)>&
+                           keep);
+
     /**
      * This function loads a disk index from its filesystem
      * representation.
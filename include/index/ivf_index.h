@@ -0,0 +1,160 @@
+/**
+ * @file ivf_index.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_IVF_INDEX_H_
+#define META_INDEX_IVF_INDEX_H_
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "index/vector_store.h"
+#include "meta.h"
+#include "util/dense_matrix.h"
+
+namespace meta
+{
+
+namespace parallel
+{
+class thread_pool;
+}
+
+namespace index
+{
+
+/**
+ * Parameters for building and searching an ivf_index.
+ */
+struct ivf_options
+{
+    /**
+     * The number of lists the vectors are split into, or 0 for about the
+     * square root of the number of vectors.
+     */
+    uint64_t lists = 0;
+
+    /**
+     * The number of lists a query searches, at most lists; larger values
+     * find the true nearest neighbors more often, more slowly.
+     */
+    uint64_t probes = 8;
+
+    /**
+     * The number of k-means iterations that train the centroids of the
+     * lists.
+     */
+    uint64_t iterations = 10;
+
+    /**
+     * The number of vectors per list the centroids are trained on, a
+     * random sample of the store.
+     */
+    uint64_t sample_per_list = 64;
+
+    /**
+     * The seed of the random sample and the initial centroids.
+     */
+    uint64_t seed = 1;
+};
+
+/**
+ * An approximate nearest-neighbor index over the vectors of a
+ * vector_store, by inner product: an inverted file (IVF). The vectors are
+ * clustered by spherical k-means on a sample of them, and each document
+ * is put in the list of the centroid most similar to its vector. A query
+ * compares itself to every centroid, then scores only the documents of
+ * the lists of its most similar centroids, with the store's exact inner
+ * products; a store of n vectors with about sqrt(n) lists is searched in
+ * time of about probes * sqrt(n) rather than n.
+ *
+ * The lists hold doc_ids only, so the index is small next to the store
+ * and every score it returns is the one vector_store::search() gives.
+ */
+class ivf_index
+{
+  public:
+    /**
+     * Indexes the vectors of a store, which must outlive the index.
+     * @param store The vectors to index
+     * @param opts The parameters of the index
+     * @param pool The threads to train and assign on
+     */
+    ivf_index(const vector_store& store, const ivf_options& opts,
+              parallel::thread_pool& pool);
+
+    /**
+     * Loads an index saved by save().
+     * @param store The vectors the index was built over, which must
+     * outlive the index
+     * @param path The file the index was saved to
+     * @param probes The number of lists a query searches
+     */
+    ivf_index(const vector_store& store, const std::string& path,
+              uint64_t probes = ivf_options{}.probes);
+
+    /**
+     * Saves the centroids and lists.
+     * @param path The file to save to
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * Finds approximate nearest neighbors of a query vector. May be
+     * called from several threads at once.
+     * @param query The query vector
+     * @param k The number of documents to return
+     * @param filter A filtering function to apply to each doc_id; returns
+     * true if the document should be included in results. An empty
+     * filter includes every document.
+     * @return at most k documents and their scores, best first
+     */
+    std::vector<std::pair<doc_id, double>>
+        search(const std::vector<float>& query, uint64_t k,
+               const vector_store::filter_type& filter = nullptr) const;
+
+    /**
+     * @return the number of lists
+     */
+    uint64_t lists() const;
+
+    /**
+     * @param probes The number of lists a query searches
+     */
+    void probes(uint64_t probes);
+
+  private:
+    /// The vectors of the indexed documents
+    const vector_store* store_;
+
+    /// The number of lists a query searches
+    uint64_t probes_;
+
+    /// The unit centroid of each list, a row each
+    util::dense_matrix<float> centroids_;
+
+    /// Where each list begins in docs_, and one past the end of the last
+    std::vector<uint64_t> offsets_;
+
+    /// The documents of every list, in order of list
+    std::vector<doc_id> docs_;
+};
+
+/**
+ * Basic exception for ivf_index interactions.
+ */
+class ivf_index_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
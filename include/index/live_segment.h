@@ -0,0 +1,244 @@
+/**
+ * @file live_segment.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_LIVE_SEGMENT_H_
+#define META_INDEX_LIVE_SEGMENT_H_
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "corpus/document.h"
+#include "meta.h"
+
+namespace cpptoml
+{
+class table;
+}
+
+namespace meta
+{
+namespace index
+{
+
+class inverted_index;
+class ranker;
+struct collection_stats;
+
+/**
+ * An inverted segment kept in memory, to which documents are added one at
+ * a time and which is searchable as soon as each is added. Documents are
+ * analyzed by the analyzer of the configuration the segment is made with,
+ * so their terms are those of disk segments made with it.
+ *
+ * Adding documents and reading the segment may happen at the same time
+ * from any number of threads: a reader copies what it needs under a
+ * short lock (see make_view()) and scores the copy without holding it.
+ * The segment keeps a copy of each document as it was added, so that it
+ * can be written out as a disk segment later (see documents()).
+ */
+class live_segment
+{
+  public:
+    /**
+     * A consistent copy of the segment's statistics and of the postings of
+     * a query's terms, taken at one point in time.
+     */
+    struct view
+    {
+        /// a posting: document, count, and the document's length and
+        /// number of unique terms
+        struct posting
+        {
+            doc_id d_id;
+            uint64_t count;
+            uint64_t doc_size;
+            uint64_t doc_unique_terms;
+        };
+
+        /// the postings of one query term
+        struct term_postings
+        {
+            /// the number of documents containing the term
+            uint64_t doc_freq = 0;
+            /// the number of times the term occurs in the segment
+            uint64_t total_count = 0;
+            /// the term's postings, in doc_id order
+            std::vector<posting> postings;
+        };
+
+        /// the number of documents in the segment
+        uint64_t num_docs = 0;
+        /// the number of term occurrences in the segment
+        uint64_t total_terms = 0;
+        /// query term -> its postings
+        std::unordered_map<std::string, term_postings> terms;
+        /// whether each document has been deleted
+        std::vector<bool> deleted;
+    };
+
+    /**
+     * Creates an empty segment.
+     * @param config The configuration whose analyzer documents are
+     * analyzed with
+     * @param name A name for the segment's (never written) index
+     */
+    live_segment(const cpptoml::table& config, const std::string& name);
+
+    /**
+     * The default destructor.
+     */
+    ~live_segment();
+
+    /**
+     * Analyzes a document and adds it to the segment. Any term counts the
+     * document already holds are ignored.
+     * @param doc The document, holding its content or the path to it
+     * @return the doc_id of the document within the segment
+     */
+    doc_id add(const corpus::document& doc);
+
+    /**
+     * Tokenizes a query with the segment's analyzer.
+     * @param query The query
+     */
+    void tokenize(corpus::document& query);
+
+    /**
+     * @param query A tokenized query
+     * @return a copy of the segment's statistics and of the postings of
+     * the query's terms
+     */
+    view make_view(const corpus::document& query) const;
+
+    /**
+     * Scores a query against a view of the segment, term-at-a-time.
+     * @param r The ranker to score with
+     * @param query The tokenized query
+     * @param v A view of the segment for the query
+     * @param stats The statistics of the whole collection the segment is
+     * part of
+     * @param num_results The number of results to return
+     * @param filter A filtering function to apply to each doc_id (within
+     * the segment), or an empty one to include every document; deleted
+     * documents are never included
+     * @return the documents that contain a query term, best first; fewer
+     * than num_results if fewer do
+     */
+    std::vector<std::pair<doc_id, double>>
+        score(ranker& r, const corpus::document& query, const view& v,
+              const collection_stats& stats, uint64_t num_results,
+              const std::function<bool(doc_id)>& filter) const;
+
+    /**
+     * @return copies of the documents of the segment as they were added,
+     * numbered from zero in doc_id order
+     */
+    std::vector<corpus::document> documents() const;
+
+    /**
+     * @return the number of documents in the segment
+     */
+    uint64_t num_docs() const;
+
+    /**
+     * @param d_id A document of the segment
+     * @return the path of the document
+     */
+    std::string doc_path(doc_id d_id) const;
+
+    /**
+     * @param d_id A document of the segment
+     * @return the number of terms in the document
+     */
+    uint64_t doc_size(doc_id d_id) const;
+
+    /**
+     * @param d_id A document of the segment
+     * @return the label of the document
+     */
+    class_label label(doc_id d_id) const;
+
+    /**
+     * Deletes a document from the segment.
+     * @param d_id The document to delete
+     */
+    void delete_doc(doc_id d_id);
+
+    /**
+     * @param d_id A document of the segment
+     * @return whether the document has been deleted
+     */
+    bool is_deleted(doc_id d_id) const;
+
+    /**
+     * @return the number of deleted documents
+     */
+    uint64_t num_deleted() const;
+
+    /**
+     * Basic exception for live_segment interactions.
+     */
+    class live_segment_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /**
+     * @param d_id A doc_id
+     * @throw live_segment_exception if it is not a document of the
+     * segment; the caller must hold mutex_
+     */
+    void check(doc_id d_id) const;
+
+    /// An unloaded index, whose analyzer analyzes documents and which
+    /// score_data refers to when the segment is scored
+    std::unique_ptr<inverted_index> idx_;
+
+    /// Guards idx_'s analyzer
+    std::mutex analyzer_mutex_;
+
+    /// The documents as they were added
+    std::vector<corpus::document> docs_;
+
+    /// The number of terms in each document
+    std::vector<uint64_t> lengths_;
+
+    /// The number of unique terms in each document
+    std::vector<uint64_t> unique_terms_;
+
+    /// Whether each document has been deleted
+    std::vector<bool> deleted_;
+
+    /// The number of deleted documents
+    uint64_t num_deleted_;
+
+    /// The number of term occurrences in all of the documents
+    uint64_t total_terms_;
+
+    /// Term -> (doc_id, count) postings, in doc_id order
+    std::unordered_map<std::string, std::vector<std::pair<doc_id, uint64_t>>>
+        postings_;
+
+    /// Term -> number of occurrences
+    std::unordered_map<std::string, uint64_t> term_counts_;
+
+    /// Guards everything but the analyzer
+    mutable std::mutex mutex_;
+};
+}
+}
+
+#endif
@@ -14,7 +14,9 @@
 #include "cpptoml.h"
 #include "caching/all.h"
 #include "index/cached_index.h"
+#include "index/compact_postings.h"
 #include "util/filesystem.h"
+#include "util/trace.h"
 
 namespace meta
 {
@@ -42,6 +44,25 @@ using dblru_forward_index =
 /// Forward index using splay cache
 using splay_forward_index = cached_index<forward_index, caching::splay_cache>;
 
+/// Inverted index using default DBLRU cache of compact postings
+using compact_dblru_inverted_index
+    = cached_index<inverted_index, caching::default_dblru_cache,
+                   compact_cache_values>;
+
+/// Inverted index using a byte-budgeted GDSF cache of compact postings
+using compact_gdsf_inverted_index
+    = cached_index<inverted_index, caching::gdsf_cache, compact_cache_values>;
+
+/// In-memory forward index holding compact postings
+using compact_memory_forward_index
+    = cached_index<forward_index, caching::no_evict_cache,
+                   compact_cache_values>;
+
+/// Forward index using default DBLRU cache of compact postings
+using compact_dblru_forward_index
+    = cached_index<forward_index, caching::default_dblru_cache,
+                   compact_cache_values>;
+
 /**
  * Factory method for creating indexes.
  * Usage:
@@ -50,6 +71,9 @@ using splay_forward_index = cached_index<forward_index, caching::splay_cache>;
  * auto idx = index::make_index<derived_index_type>(config_path);
  * ~~~
  *
+ * A [trace] table in the configuration turns on tracing of the build;
+ * see trace::configure().
+ *
  * @param config_file The path to the configuration file to be
  *  used to build the index
  * @param args any additional arguments to forward to the
@@ -61,6 +85,7 @@ std::shared_ptr<Index> make_index(const std::string& config_file,
                                   Args&&... args)
 {
     auto config = cpptoml::parse_file(config_file);
+    trace::configure(config);
 
     // check if we have paths specified for either kind of index
     if (!(config.contains("forward-index")
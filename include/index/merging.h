@@ -0,0 +1,57 @@
+/**
+ * @file merging.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_MERGING_H_
+#define META_INDEX_MERGING_H_
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+namespace meta
+{
+namespace index
+{
+
+class inverted_index;
+
+/**
+ * Creates one index from the postings of several existing ones, without
+ * tokenizing any of their documents again. The documents of each source
+ * follow those of the sources before it, keeping their order; the terms
+ * of all of the sources are merged into one vocabulary, and their postings
+ * are merged a term at a time straight into the new postings file.
+ *
+ * Documents deleted from a source keep their doc_id in the merged index,
+ * where they are deleted too, but their postings are dropped. Positions
+ * are merged when every source has them and the configuration stores them.
+ *
+ * @param sources The indexes to merge, which should all have analyzed
+ * their documents as the configuration does
+ * @param config_file The configuration of the merged index, which must
+ * name an index directory other than those of the sources; any index
+ * already in that directory is replaced
+ * @return the merged index
+ */
+std::shared_ptr<inverted_index>
+    merge_indexes(const std::vector<std::shared_ptr<inverted_index>>& sources,
+                  const std::string& config_file);
+
+/**
+ * Basic exception for merging interactions.
+ */
+class merging_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
@@ -0,0 +1,181 @@
+/**
+ * @file near_duplicates.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_NEAR_DUPLICATES_H_
+#define META_INDEX_NEAR_DUPLICATES_H_
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "meta.h"
+
+namespace cpptoml
+{
+class table;
+}
+
+namespace meta
+{
+namespace index
+{
+
+class forward_index;
+
+/**
+ * The signatures near duplicates are found by.
+ */
+enum class signature_method
+{
+    /**
+     * MinHash (Broder): the minimum of each of num_hashes hash functions
+     * over the document's set of terms. Two signatures agree in each
+     * position with probability equal to the Jaccard similarity of the
+     * two term sets.
+     */
+    minhash,
+    /**
+     * SimHash (Charikar): one 64-bit fingerprint whose bits are the signs
+     * of the count-weighted sums of the bits of the term hashes. Similar
+     * term vectors give fingerprints a small Hamming distance apart.
+     */
+    simhash
+};
+
+/**
+ * Options for near-duplicate detection.
+ */
+struct dedup_options
+{
+    /**
+     * The signatures documents are compared by.
+     */
+    signature_method method = signature_method::minhash;
+
+    /**
+     * For MinHash, the number of hash functions in a signature.
+     */
+    uint64_t num_hashes = 128;
+
+    /**
+     * The number of bands the signatures are split into for
+     * locality-sensitive hashing. Documents that agree on every value of
+     * some band become a candidate pair: more bands find pairs of lower
+     * similarity, at the cost of more candidates. A SimHash fingerprint
+     * is cut into bands of consecutive bits, so two fingerprints fewer
+     * than `bands` bits apart always share a band; a few bands (4 to 8)
+     * suit it, since narrow bands make large buckets.
+     */
+    uint64_t bands = 32;
+
+    /**
+     * The similarity a candidate pair must have to be near duplicates: the
+     * fraction of agreeing MinHash values, or for SimHash one minus the
+     * fraction of differing fingerprint bits.
+     */
+    double threshold = 0.8;
+
+    /**
+     * How many threads compute signatures and candidate pairs.
+     */
+    uint64_t num_threads = std::thread::hardware_concurrency();
+};
+
+/**
+ * The near duplicates of an index: clusters of documents, each of which
+ * keeps its lowest doc_id and treats the others as its duplicates.
+ */
+class near_duplicates
+{
+  public:
+    /**
+     * @param num_docs The number of documents in the index
+     * @param clusters The clusters, each sorted, in order of their first
+     * documents
+     */
+    near_duplicates(uint64_t num_docs,
+                    std::vector<std::vector<doc_id>> clusters);
+
+    /**
+     * @return the clusters of two or more near duplicates, each sorted, in
+     * order of their first documents
+     */
+    const std::vector<std::vector<doc_id>>& clusters() const;
+
+    /**
+     * @return every document of a cluster but the first, in order
+     */
+    std::vector<doc_id> duplicates() const;
+
+    /**
+     * @param d_id A document
+     * @return whether the document is a duplicate of a document with a
+     * lower doc_id
+     */
+    bool is_duplicate(doc_id d_id) const;
+
+    /**
+     * @return a filter for ranker::score that rejects duplicates; it may
+     * outlive this object
+     */
+    std::function<bool(doc_id)> filter() const;
+
+  private:
+    /// The clusters of near duplicates
+    std::vector<std::vector<doc_id>> clusters_;
+
+    /// Whether each document is a duplicate, shared with the filters
+    std::shared_ptr<const std::vector<bool>> duplicate_;
+};
+
+/**
+ * Finds the near duplicates among the documents of a forward index.
+ *
+ * A signature is computed from each document's term vector, in parallel,
+ * and locality-sensitive hashing over bands of the signatures proposes
+ * candidate pairs: the documents of each band are sorted by the hash of
+ * their band, so that those that agree on it are adjacent, without ever
+ * comparing all pairs. Each candidate is checked against the threshold
+ * with the whole signature, and the pairs that pass are joined into
+ * clusters. A document is only compared with the first document of its
+ * bucket and, failing that, with its neighbor in it, which keeps the work
+ * near linear in the number of documents even for large buckets.
+ *
+ * Deleted and empty documents are never duplicates.
+ *
+ * @param idx The index of the documents
+ * @param options How signatures are computed and compared
+ * @return the near duplicates
+ */
+near_duplicates find_near_duplicates(const forward_index& idx,
+                                     const dedup_options& options);
+
+/**
+ * Reads near-duplicate detection options from the `[dedup]` table of a
+ * configuration, which may set `method` ("minhash" or "simhash"),
+ * `num-hashes`, `bands`, `threshold`, and `num-threads`. Options that are
+ * not set keep their default.
+ * @param config The configuration
+ * @return the options
+ */
+dedup_options make_dedup_options(const cpptoml::table& config);
+
+/**
+ * Basic exception for near-duplicate detection.
+ */
+class dedup_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
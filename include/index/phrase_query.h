@@ -0,0 +1,74 @@
+/**
+ * @file phrase_query.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_PHRASE_QUERY_H_
+#define META_INDEX_PHRASE_QUERY_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "meta.h"
+
+namespace meta
+{
+namespace index
+{
+
+class inverted_index;
+
+/**
+ * Finds the documents in which a sequence of terms occurs in order, using
+ * the term positions stored by an inverted_index built with
+ * `store-positions = true`.
+ *
+ * With a slop of zero the terms must be adjacent, so the query matches an
+ * exact phrase. A larger slop turns it into an ordered proximity query:
+ * up to that many other terms may occur between any two consecutive query
+ * terms.
+ */
+class phrase_query
+{
+  public:
+    /**
+     * @param terms The terms of the phrase, in order
+     * @param slop The number of other terms allowed between consecutive
+     * terms of the phrase
+     */
+    phrase_query(std::vector<term_id> terms, uint64_t slop = 0);
+
+    /**
+     * @param idx The positional index to search
+     * @return the documents containing the phrase, in increasing doc_id
+     * order, each paired with the number of positions at which a match
+     * starts
+     */
+    std::vector<std::pair<doc_id, uint64_t>>
+        search(const inverted_index& idx) const;
+
+    /**
+     * Basic exception for phrase_query interactions.
+     */
+    class phrase_query_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /// the terms of the phrase
+    std::vector<term_id> terms_;
+
+    /// the number of other terms allowed between consecutive terms
+    uint64_t slop_;
+};
+}
+}
+
+#endif
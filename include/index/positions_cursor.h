@@ -0,0 +1,96 @@
+/**
+ * @file positions_cursor.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_POSITIONS_CURSOR_H_
+#define META_INDEX_POSITIONS_CURSOR_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "index/postings_cursor.h"
+#include "meta.h"
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * A forward-only iterator over a single term's postings list that can also
+ * report the positions at which the term occurs in the current document.
+ *
+ * The positions are read from a separate stream laid out in the same
+ * order as the postings: for each document, one variable byte coded gap
+ * per occurrence. A document's positions are only decoded when they are
+ * asked for; the positions of documents that are stepped over are skipped
+ * without decoding them.
+ */
+class positions_cursor
+{
+  public:
+    /**
+     * Creates a cursor over an empty postings list.
+     */
+    positions_cursor();
+
+    /**
+     * @param postings A cursor over the term's postings
+     * @param positions Pointer to the first byte of the term's positions
+     */
+    positions_cursor(postings_cursor postings, const char* positions);
+
+    /**
+     * @return whether the cursor has moved past the last posting
+     */
+    bool at_end() const;
+
+    /**
+     * @return the doc_id at the current position
+     */
+    doc_id doc() const;
+
+    /**
+     * @return the count at the current position
+     */
+    uint64_t count() const;
+
+    /**
+     * Advances to the next posting.
+     */
+    void next();
+
+    /**
+     * Advances to the first posting whose doc_id is at least d_id. The
+     * cursor never moves backwards.
+     * @param d_id The doc_id to move to
+     */
+    void skip_to(doc_id d_id);
+
+    /**
+     * @return the positions of the term in the current document, in
+     * increasing order
+     */
+    const std::vector<uint64_t>& positions();
+
+  private:
+    /// the postings for the term
+    postings_cursor postings_;
+
+    /// the positions of the current document
+    const uint8_t* data_;
+
+    /// whether the positions of the current document have been decoded
+    bool decoded_;
+
+    /// the decoded positions of the current document
+    std::vector<uint64_t> positions_;
+};
+}
+}
+
+#endif
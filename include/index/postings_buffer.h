@@ -0,0 +1,150 @@
+/**
+ * @file postings_buffer.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_POSTINGS_BUFFER_H_
+#define META_INDEX_POSTINGS_BUFFER_H_
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "index/postings_data.h"
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * An in-memory inversion buffer that accumulates (PrimaryKey,
+ * SecondaryKey, count) triples until they are written out as a chunk.
+ *
+ * Each distinct PrimaryKey is stored (interned) once, in an entry found
+ * through a flat, open-addressing hash table. The entry's postings live in
+ * a linked list of fixed-size blocks carved out of large pages, so adding
+ * a posting never allocates unless a new page is needed. bytes_used()
+ * accounts for every byte the buffer holds on to.
+ */
+template <class PrimaryKey, class SecondaryKey>
+class postings_buffer
+{
+  public:
+    using postings_data_type = postings_data<PrimaryKey, SecondaryKey>;
+    using pair_t = typename postings_data_type::pair_t;
+
+    /**
+     * Creates an empty buffer.
+     */
+    postings_buffer();
+
+    /**
+     * @param p_key The PrimaryKey to add counts for
+     * @param s_key The SecondaryKey to add counts for
+     * @param amount The amount to increase the count by
+     */
+    void increase_count(const PrimaryKey& p_key, SecondaryKey s_key,
+                        double amount);
+
+    /**
+     * @return the number of bytes of memory held by the buffer
+     */
+    uint64_t bytes_used() const;
+
+    /**
+     * @return whether the buffer holds no postings
+     */
+    bool empty() const;
+
+    /**
+     * Empties the buffer and releases its memory.
+     * @return the buffered postings, one postings_data per PrimaryKey,
+     * sorted by PrimaryKey
+     */
+    std::vector<postings_data_type> extract();
+
+  private:
+    /// the number of postings stored in each block
+    const static uint32_t block_capacity = 8;
+
+    /// the number of blocks allocated at a time
+    const static uint32_t page_size = 4096;
+
+    /// the initial number of slots in the hash table
+    const static uint64_t initial_slots = 1024;
+
+    /**
+     * A fixed-size piece of a postings list.
+     */
+    struct block
+    {
+        /// the postings in this block
+        std::array<pair_t, block_capacity> postings;
+        /// the index of the next block in the list
+        uint32_t next;
+    };
+
+    /**
+     * The postings list for a single PrimaryKey.
+     */
+    struct entry
+    {
+        /// the PrimaryKey
+        PrimaryKey key;
+        /// the hash of the key, kept so that the table can be resized
+        uint64_t hash;
+        /// the index of the first block of the list
+        uint32_t head;
+        /// the index of the last block of the list
+        uint32_t tail;
+        /// the number of postings in the list
+        uint64_t size;
+    };
+
+    /**
+     * @param key The PrimaryKey to look for
+     * @return the index of the key's entry, creating it if necessary
+     */
+    uint32_t find_or_insert(const PrimaryKey& key);
+
+    /**
+     * Doubles the number of slots in the hash table.
+     */
+    void grow_table();
+
+    /**
+     * @return the index of a newly allocated block
+     */
+    uint32_t allocate_block();
+
+    /**
+     * @param idx The index of the block
+     * @return the block with the given index
+     */
+    block& get_block(uint32_t idx);
+
+    /// slot -> (entry index + 1), or 0 for an empty slot
+    std::vector<uint32_t> table_;
+
+    /// the postings lists, in order of insertion
+    std::vector<entry> entries_;
+
+    /// the pages that blocks are allocated from
+    std::vector<std::unique_ptr<block[]>> pages_;
+
+    /// the number of blocks handed out so far
+    uint32_t num_blocks_;
+
+    /// the heap memory used by the keys of the entries
+    uint64_t key_bytes_;
+};
+}
+}
+
+#include "index/postings_buffer.tcc"
+#endif
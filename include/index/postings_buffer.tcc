@@ -0,0 +1,360 @@
+/**
+ * @file postings_buffer.tcc
+ */
+
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <type_traits>
+
+#include "index/postings_buffer.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace internal
+{
+/**
+ * Sorts (key, index) pairs on their numeric keys with an LSD radix sort
+ * that handles one byte per pass, skipping passes in which every key has
+ * the same byte.
+ * @param items The pairs to sort
+ */
+inline void radix_sort(std::vector<std::pair<uint64_t, uint32_t>>& items)
+{
+    std::vector<std::pair<uint64_t, uint32_t>> buffer(items.size());
+    for (uint32_t shift = 0; shift < 64; shift += 8)
+    {
+        std::array<uint64_t, 257> starts{};
+        for (const auto& item : items)
+            ++starts[((item.first >> shift) & 0xFF) + 1];
+
+        if (std::any_of(starts.begin(), starts.end(), [&](uint64_t count)
+                        {
+                return count == items.size();
+            }))
+            continue;
+
+        for (uint64_t i = 1; i < starts.size(); ++i)
+            starts[i] += starts[i - 1];
+
+        for (const auto& item : items)
+            buffer[starts[(item.first >> shift) & 0xFF]++] = item;
+        items.swap(buffer);
+    }
+}
+
+/// A string key paired with the index of its entry
+using string_item = std::pair<const std::string*, uint32_t>;
+
+/**
+ * Sorts (key, index) pairs on their string keys with an MSD radix sort,
+ * switching to a comparison sort for small ranges.
+ * @param items The pairs to sort
+ * @param begin The start of the range to sort
+ * @param end The end of the range to sort
+ * @param depth The number of leading characters the range has in common
+ * @param buffer Scratch space the size of items
+ */
+inline void radix_sort(std::vector<string_item>& items, uint64_t begin,
+                       uint64_t end, uint64_t depth,
+                       std::vector<string_item>& buffer)
+{
+    if (end - begin < 32)
+    {
+        std::sort(items.begin() + begin, items.begin() + end,
+                  [](const string_item& a, const string_item& b)
+                  {
+            return *a.first < *b.first;
+        });
+        return;
+    }
+
+    // bucket 0 holds the keys that end at depth, so they sort first
+    auto bucket = [&](const string_item& item) -> uint64_t
+    {
+        const auto& key = *item.first;
+        if (depth >= key.size())
+            return 0;
+        return static_cast<uint8_t>(key[depth]) + uint64_t{1};
+    };
+
+    std::array<uint64_t, 258> starts{};
+    for (auto i = begin; i < end; ++i)
+        ++starts[bucket(items[i]) + 1];
+    for (uint64_t i = 1; i < starts.size(); ++i)
+        starts[i] += starts[i - 1];
+
+    auto next = starts;
+    for (auto i = begin; i < end; ++i)
+        buffer[begin + next[bucket(items[i])]++] = items[i];
+    std::copy(buffer.begin() + begin, buffer.begin() + end,
+              items.begin() + begin);
+
+    for (uint64_t b = 1; b < 257; ++b)
+    {
+        if (starts[b + 1] - starts[b] > 1)
+            radix_sort(items, begin + starts[b], begin + starts[b + 1],
+                       depth + 1, buffer);
+    }
+}
+
+/**
+ * @param entries The entries to order
+ * @return the indices of the entries, sorted by their string keys
+ */
+template <class Entry>
+std::vector<uint32_t> sorted_order(const std::vector<Entry>& entries,
+                                   std::true_type /* string keys */)
+{
+    std::vector<string_item> items;
+    items.reserve(entries.size());
+    for (uint32_t i = 0; i < entries.size(); ++i)
+        items.emplace_back(&entries[i].key, i);
+
+    std::vector<string_item> buffer(items.size());
+    radix_sort(items, 0, items.size(), 0, buffer);
+
+    std::vector<uint32_t> order;
+    order.reserve(items.size());
+    for (const auto& item : items)
+        order.push_back(item.second);
+    return order;
+}
+
+/**
+ * @param entries The entries to order
+ * @return the indices of the entries, sorted by their numeric keys
+ */
+template <class Entry>
+std::vector<uint32_t> sorted_order(const std::vector<Entry>& entries,
+                                   std::false_type /* numeric keys */)
+{
+    std::vector<std::pair<uint64_t, uint32_t>> items;
+    items.reserve(entries.size());
+    for (uint32_t i = 0; i < entries.size(); ++i)
+        items.emplace_back(static_cast<uint64_t>(entries[i].key), i);
+
+    radix_sort(items);
+
+    std::vector<uint32_t> order;
+    order.reserve(items.size());
+    for (const auto& item : items)
+        order.push_back(item.second);
+    return order;
+}
+
+/**
+ * @param key A string key
+ * @return the heap memory used by the key
+ */
+inline uint64_t key_bytes(const std::string& key)
+{
+    return key.capacity();
+}
+
+/**
+ * @param key A numeric key
+ * @return the heap memory used by the key (none)
+ */
+template <class Key>
+uint64_t key_bytes(const Key&)
+{
+    return 0;
+}
+
+/**
+ * @param hash A hash value
+ * @return the hash with its high bits mixed into its low bits, which are
+ * the ones used to pick a slot
+ */
+inline uint64_t mix(uint64_t hash)
+{
+    hash *= 0x9E3779B97F4A7C15ull;
+    return hash ^ (hash >> 32);
+}
+}
+
+template <class PrimaryKey, class SecondaryKey>
+const uint32_t postings_buffer<PrimaryKey, SecondaryKey>::block_capacity;
+
+template <class PrimaryKey, class SecondaryKey>
+const uint32_t postings_buffer<PrimaryKey, SecondaryKey>::page_size;
+
+template <class PrimaryKey, class SecondaryKey>
+const uint64_t postings_buffer<PrimaryKey, SecondaryKey>::initial_slots;
+
+template <class PrimaryKey, class SecondaryKey>
+postings_buffer<PrimaryKey, SecondaryKey>::postings_buffer()
+    : num_blocks_{0}, key_bytes_{0}
+{
+    // nothing
+}
+
+template <class PrimaryKey, class SecondaryKey>
+void postings_buffer<PrimaryKey, SecondaryKey>::increase_count(
+    const PrimaryKey& p_key, SecondaryKey s_key, double amount)
+{
+    auto& e = entries_[find_or_insert(p_key)];
+    auto pos = e.size % block_capacity;
+
+    if (e.size > 0)
+    {
+        // repeated counts for the same SecondaryKey usually arrive
+        // together, so they are combined here
+        auto& tail = get_block(e.tail);
+        auto& last = tail.postings[(e.size - 1) % block_capacity];
+        if (last.first == s_key)
+        {
+            last.second += amount;
+            return;
+        }
+
+        if (pos == 0)
+        {
+            auto b = allocate_block();
+            get_block(e.tail).next = b;
+            e.tail = b;
+        }
+    }
+
+    get_block(e.tail).postings[pos] = pair_t{s_key, amount};
+    ++e.size;
+}
+
+template <class PrimaryKey, class SecondaryKey>
+uint32_t postings_buffer<PrimaryKey, SecondaryKey>::find_or_insert(
+    const PrimaryKey& key)
+{
+    if ((entries_.size() + 1) * 2 > table_.size())
+        grow_table();
+
+    auto hash = std::hash<PrimaryKey>{}(key);
+    auto mask = table_.size() - 1;
+    for (auto slot = internal::mix(hash) & mask;; slot = (slot + 1) & mask)
+    {
+        auto idx = table_[slot];
+        if (idx == 0)
+        {
+            auto b = allocate_block();
+            entries_.push_back(entry{key, hash, b, b, 0});
+            key_bytes_ += internal::key_bytes(entries_.back().key);
+            table_[slot] = static_cast<uint32_t>(entries_.size());
+            return static_cast<uint32_t>(entries_.size() - 1);
+        }
+
+        const auto& e = entries_[idx - 1];
+        if (e.hash == hash && e.key == key)
+            return idx - 1;
+    }
+}
+
+template <class PrimaryKey, class SecondaryKey>
+void postings_buffer<PrimaryKey, SecondaryKey>::grow_table()
+{
+    std::vector<uint32_t> table(
+        std::max(initial_slots, uint64_t{table_.size()} * 2), 0);
+    auto mask = table.size() - 1;
+    for (uint32_t i = 0; i < entries_.size(); ++i)
+    {
+        auto slot = internal::mix(entries_[i].hash) & mask;
+        while (table[slot] != 0)
+            slot = (slot + 1) & mask;
+        table[slot] = i + 1;
+    }
+    table_.swap(table);
+}
+
+template <class PrimaryKey, class SecondaryKey>
+uint32_t postings_buffer<PrimaryKey, SecondaryKey>::allocate_block()
+{
+    if (num_blocks_ == pages_.size() * page_size)
+        pages_.emplace_back(new block[page_size]);
+    return num_blocks_++;
+}
+
+template <class PrimaryKey, class SecondaryKey>
+auto postings_buffer<PrimaryKey, SecondaryKey>::get_block(uint32_t idx)
+    -> block &
+{
+    return pages_[idx / page_size][idx % page_size];
+}
+
+template <class PrimaryKey, class SecondaryKey>
+uint64_t postings_buffer<PrimaryKey, SecondaryKey>::bytes_used() const
+{
+    return table_.capacity() * sizeof(uint32_t)
+           + entries_.capacity() * sizeof(entry)
+           + pages_.capacity() * sizeof(std::unique_ptr<block[]>)
+           + pages_.size() * page_size * sizeof(block) + key_bytes_;
+}
+
+template <class PrimaryKey, class SecondaryKey>
+bool postings_buffer<PrimaryKey, SecondaryKey>::empty() const
+{
+    return entries_.empty();
+}
+
+template <class PrimaryKey, class SecondaryKey>
+auto postings_buffer<PrimaryKey, SecondaryKey>::extract()
+    -> std::vector<postings_data_type>
+{
+    auto order = internal::sorted_order(
+        entries_, std::is_same<PrimaryKey, std::string>{});
+
+    std::vector<postings_data_type> pdata;
+    pdata.reserve(order.size());
+    for (const auto& idx : order)
+    {
+        auto& e = entries_[idx];
+
+        typename postings_data_type::count_t counts;
+        counts.reserve(e.size);
+        auto b = e.head;
+        for (uint64_t remaining = e.size; remaining > 0;)
+        {
+            auto& blk = get_block(b);
+            auto n = std::min<uint64_t>(remaining, block_capacity);
+            counts.insert(counts.end(), blk.postings.begin(),
+                          blk.postings.begin() + n);
+            remaining -= n;
+            b = blk.next;
+        }
+
+        // postings normally arrive in SecondaryKey order; if they did not,
+        // sort them and combine the counts of repeated keys
+        auto out_of_order = [](const pair_t& a, const pair_t& b)
+        {
+            return !(a.first < b.first);
+        };
+        if (std::adjacent_find(counts.begin(), counts.end(), out_of_order)
+            != counts.end())
+        {
+            std::stable_sort(counts.begin(), counts.end(),
+                             [](const pair_t& a, const pair_t& b)
+                             {
+                return a.first < b.first;
+            });
+
+            auto last = counts.begin();
+            for (auto it = counts.begin() + 1; it != counts.end(); ++it)
+            {
+                if (it->first == last->first)
+                    last->second += it->second;
+                else
+                    *++last = *it;
+            }
+            counts.erase(last + 1, counts.end());
+        }
+
+        pdata.emplace_back(std::move(e.key));
+        pdata.back().set_counts(std::move(counts));
+    }
+
+    *this = postings_buffer{};
+    return pdata;
+}
+}
+}
@@ -0,0 +1,208 @@
+/**
+ * @file postings_cursor.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_POSTINGS_CURSOR_H_
+#define META_INDEX_POSTINGS_CURSOR_H_
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "index/postings_data.h"
+#include "meta.h"
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * A forward-only iterator over a single term's postings list that decodes
+ * one block at a time. Using the skip table written by
+ * postings_data::write_packed(), it can jump directly to the block that
+ * may contain a given doc_id, and it exposes the largest count in each
+ * block so that rankers can bound the score of the documents in it without
+ * decoding them.
+ *
+ * Gamma coded postings are read in place as well: a first pass over the
+ * list builds the same skip table in memory, and each block is then
+ * decoded only when the cursor reaches it. A cursor can also be
+ * constructed over an already decoded list of postings.
+ */
+class postings_cursor
+{
+  public:
+    /// The number of postings in each block
+    const static uint64_t block_size
+        = postings_data<term_id, doc_id>::block_size;
+
+    /**
+     * Creates a cursor over an empty postings list.
+     */
+    postings_cursor();
+
+    /**
+     * Creates a cursor over packed postings.
+     * @param data Pointer to the first byte of the postings list, as
+     * written by postings_data::write_packed()
+     */
+    postings_cursor(const char* data);
+
+    /**
+     * Creates a cursor over gamma coded postings.
+     * @param data Pointer to the first byte of the postings file, as
+     * written by postings_data::write_compressed()
+     * @param size The size of the postings file in bytes
+     * @param bit_location The position of the postings list in the file,
+     * in bits
+     */
+    postings_cursor(const char* data, uint64_t size, uint64_t bit_location);
+
+    /**
+     * Creates a cursor over decoded postings.
+     * @param counts The (doc_id, count) pairs, sorted by doc_id
+     */
+    postings_cursor(std::vector<std::pair<doc_id, double>> counts);
+
+    /**
+     * Creates a cursor over decoded postings that are shared, such as
+     * those held by the cache of a cached_index, without copying them.
+     * @param pdata The postings, which the cursor keeps alive
+     */
+    postings_cursor(
+        std::shared_ptr<const postings_data<term_id, doc_id>> pdata);
+
+    /**
+     * @return whether the cursor has moved past the last posting
+     */
+    bool at_end() const;
+
+    /**
+     * Limits the cursor to the postings whose doc_ids are in [first,
+     * last): it skips to first, and is at its end once it reaches last.
+     * This lets a query be scored over a range of doc_ids.
+     * @param first The first doc_id to include
+     * @param last One past the last doc_id to include
+     */
+    void restrict_to(doc_id first, doc_id last);
+
+    /**
+     * @return the doc_id at the current position
+     */
+    doc_id doc() const;
+
+    /**
+     * @return the count at the current position
+     */
+    uint64_t count() const;
+
+    /**
+     * Advances to the next posting.
+     */
+    void next();
+
+    /**
+     * Advances to the first posting whose doc_id is at least d_id,
+     * skipping (without decoding) every block that cannot contain it and
+     * galloping through the block that does. The cursor never moves
+     * backwards.
+     * @param d_id The doc_id to move to
+     */
+    void skip_to(doc_id d_id);
+
+    /**
+     * Advances to the first posting of the next block without decoding
+     * the remainder of the current one.
+     */
+    void next_block();
+
+    /**
+     * @return the largest doc_id in the current block
+     */
+    doc_id block_last_doc() const;
+
+    /**
+     * @return the largest count in the current block
+     */
+    uint64_t block_max_count() const;
+
+    /**
+     * @return the largest count in the entire postings list
+     */
+    uint64_t max_count() const;
+
+    /**
+     * @return the total number of postings in the list
+     */
+    uint64_t size() const;
+
+  private:
+    /**
+     * Skip table entry for a single block.
+     */
+    struct block_info
+    {
+        /// the largest doc_id in the block
+        doc_id last_doc;
+        /// the byte offset of the block from the start of the block data,
+        /// or the bit offset of the block in the file for gamma coding
+        uint64_t offset;
+        /// the largest count in the block
+        uint64_t max_count;
+    };
+
+    /**
+     * Decodes a block into the current position buffers.
+     * @param block The index of the block to load
+     */
+    void load_block(uint64_t block);
+
+    /// the skip table
+    std::vector<block_info> blocks_;
+
+    /// the start of the packed blocks, or nullptr for decoded postings
+    const uint8_t* data_;
+
+    /// the start of the gamma coded postings file, or nullptr
+    const uint8_t* gamma_;
+
+    /// the size of the gamma coded postings file in bytes
+    uint64_t gamma_size_;
+
+    /// the postings, if they were provided already decoded
+    std::shared_ptr<const postings_data<term_id, doc_id>> decoded_;
+
+    /// the total number of postings
+    uint64_t size_;
+
+    /// the largest count in the postings list
+    uint64_t max_count_;
+
+    /// the index of the current block
+    uint64_t block_;
+
+    /// the position within the current block
+    uint64_t pos_;
+
+    /// the number of postings in the current block
+    uint64_t block_length_;
+
+    /// the doc_id at which the cursor ends, past every doc_id by default
+    doc_id end_doc_;
+
+    /// the doc_ids in the current block
+    std::array<uint64_t, block_size> docs_;
+
+    /// the counts in the current block
+    std::array<uint32_t, block_size> counts_;
+};
+}
+}
+
+#endif
@@ -16,8 +16,10 @@
 #include <vector>
 
 #include "meta.h"
+#include "index/postings_data_fwd.h"
 #include "io/compressed_file_reader.h"
 #include "io/compressed_file_writer.h"
+#include "io/stream_vbyte.h"
 #include "util/sparse_vector.h"
 
 namespace meta
@@ -25,14 +27,6 @@ namespace meta
 namespace index
 {
 
-template <class, class>
-class postings_data;
-
-template <class PrimaryKey, class SecondaryKey>
-io::compressed_file_reader& operator>>(io::compressed_file_reader&,
-                                       postings_data<PrimaryKey,
-                                                     SecondaryKey>&);
-
 /**
  * A class to represent the per-PrimaryKey data in an index's postings
  * file. For a given PrimaryKey, a mapping of SecondaryKey -> count information
@@ -40,15 +34,20 @@ io::compressed_file_reader& operator>>(io::compressed_file_reader&,
  *
  * For example, for an inverted index, PrimaryKey = term_id, SecondaryKey =
  * doc_id. For a forward_index, PrimaryKey = doc_id, SecondaryKey = term_id.
+ *
+ * The counts are allocated with Allocator (see postings_data_fwd.h for
+ * its default), which may be an arena_allocator for postings that are
+ * made and dropped for each document or query.
  */
-template <class PrimaryKey, class SecondaryKey>
+template <class PrimaryKey, class SecondaryKey, class Allocator>
 class postings_data
 {
   public:
     using primary_key_type = PrimaryKey;
     using secondary_key_type = SecondaryKey;
+    using allocator_type = Allocator;
     using pair_t = std::pair<SecondaryKey, double>;
-    using count_t = std::vector<pair_t>;
+    using count_t = std::vector<pair_t, Allocator>;
 
     /**
      * PrimaryKeys may only be integral types or strings; SecondaryKeys may
@@ -82,6 +81,14 @@ class postings_data
      */
     postings_data(PrimaryKey p_id);
 
+    /**
+     * Creates an empty postings_data for a given PrimaryKey whose counts
+     * are allocated with the given allocator.
+     * @param p_id The PrimaryKey to be associated with this postings_data
+     * @param alloc The allocator for the counts
+     */
+    postings_data(PrimaryKey p_id, const Allocator& alloc);
+
     /**
      * @param other The other postings_data object to consume
      * Adds the parameter's data to this object's data
@@ -109,9 +116,10 @@ class postings_data
     const count_t& counts() const;
 
     /**
-     * @param counts A map of counts to assign into this postings_data
+     * @param counts A map of counts to assign into this postings_data;
+     * pass an rvalue to avoid copying it
      */
-    void set_counts(const count_t& counts);
+    void set_counts(count_t counts);
 
     /**
      * @param other The postings_data to compare with
@@ -121,13 +129,17 @@ class postings_data
     bool operator<(const postings_data& other) const;
 
     /**
-     * Helper function used by istream operator.
+     * Reads semi-compressed postings data from a compressed file.
      * @param in The stream to read from
      * @param pd The postings data object to write the stream info to
+     * @return the input stream
      */
-    friend void stream_helper(io::compressed_file_reader& in,
-                              postings_data<PrimaryKey, SecondaryKey>& pd)
+    template <class Mapping>
+    friend io::basic_compressed_file_reader<Mapping>&
+        operator>>(io::basic_compressed_file_reader<Mapping>& in,
+                   postings_data& pd)
     {
+        read_primary_key(in, pd.p_id_);
         pd.counts_.clear();
         uint32_t num_pairs = in.next();
         for (uint32_t i = 0; i < num_pairs; ++i)
@@ -136,27 +148,19 @@ class postings_data
             uint64_t count = in.next();
             pd.counts_.emplace_back(s_id, static_cast<double>(count));
         }
+        return in;
     }
 
-    /**
-     * Reads semi-compressed postings data from a compressed file.
-     * @param in The stream to read from
-     * @param pd The postings data object to write the stream info to
-     * @return the input stream
-     */
-    friend io::compressed_file_reader& operator>>
-        <>(io::compressed_file_reader& in,
-           postings_data<PrimaryKey, SecondaryKey>& pd);
-
     /**
      * Writes semi-compressed postings data to a compressed file.
      * @param out The stream to write to
      * @param pd The postings data object to write to the stream
      * @return the output stream
      */
-    friend io::compressed_file_writer& operator<<(
-        io::compressed_file_writer& out,
-        const postings_data<PrimaryKey, SecondaryKey>& pd)
+    template <class Mapping>
+    friend io::basic_compressed_file_writer<Mapping>&
+        operator<<(io::basic_compressed_file_writer<Mapping>& out,
+                   const postings_data& pd)
     {
         if (pd.counts_.empty())
             return out;
@@ -180,7 +184,9 @@ class postings_data
      * file.
      * @param writer The compressed file to write to
      */
-    void write_compressed(io::compressed_file_writer& writer) const;
+    template <class Mapping>
+    void write_compressed(io::basic_compressed_file_writer<Mapping>& writer)
+        const;
 
     /**
      * Reads compressed postings_data into this object. The mapping for the
@@ -189,7 +195,31 @@ class postings_data
      * file.
      * @param reader The compressed file to read from
      */
-    void read_compressed(io::compressed_file_reader& reader);
+    template <class Mapping>
+    void read_compressed(io::basic_compressed_file_reader<Mapping>& reader);
+
+    /**
+     * Writes this postings_data in the word-aligned block format: the
+     * number of postings, then a skip table with one entry per block (the
+     * gap between the block's last SecondaryKey and that of the previous
+     * block, the block's size in bytes, and its largest count), and
+     * finally the blocks themselves. Each block holds up to block_size
+     * SecondaryKey gaps and counts, each encoded with Stream VByte.
+     * Counts are stored as integers, so this is meant for term_id ->
+     * doc_id postings.
+     *
+     * @see postings_cursor for reading single blocks via the skip table
+     * @param out The stream to write to
+     * @return the number of bytes written
+     */
+    uint64_t write_packed(std::ostream& out) const;
+
+    /**
+     * Reads postings_data written by write_packed() into this object.
+     * @param data Pointer to the first byte of the packed postings (e.g.
+     * into a memory-mapped postings file)
+     */
+    void read_packed(const char* data);
 
     /**
      * @param out The output stream to write to
@@ -223,46 +253,41 @@ class postings_data
     uint64_t bytes_used() const;
 
   private:
+    /**
+     * Reads a string PrimaryKey from a compressed file.
+     * @param in The stream to read from
+     * @param key The key to read into
+     */
+    template <class Reader>
+    static void read_primary_key(Reader& in, std::string& key)
+    {
+        key = in.next_string();
+    }
+
+    /**
+     * Reads a numeric PrimaryKey from a compressed file.
+     * @param in The stream to read from
+     * @param key The key to read into
+     */
+    template <class Reader, class Key>
+    static void read_primary_key(Reader& in, Key& key)
+    {
+        key = in.next();
+    }
+
     /// Primary id this postings_data represents
     PrimaryKey p_id_;
 
     /// The (secondary_key_type, count) pairs
-    util::sparse_vector<SecondaryKey, double> counts_;
+    util::sparse_vector<SecondaryKey, double, Allocator> counts_;
 
     /// delimiter used when writing to compressed files
     const static uint64_t delimiter_ = std::numeric_limits<uint64_t>::max();
-};
 
-/**
- * Reads semi-compressed postings data from a compressed file.
- * @param in The stream to read from
- * @param pd The postings data object to write the stream info to
- * @return the input stream
- */
-template <class PrimaryKey, class SecondaryKey>
-io::compressed_file_reader& operator>>(io::compressed_file_reader& in,
-                                       postings_data<PrimaryKey,
-                                                     SecondaryKey>& pd)
-{
-    pd.p_id_ = in.next();
-    stream_helper(in, pd);
-    return in;
-}
-
-/**
- * Reads semi-compressed postings data from a compressed file.
- * @param in The stream to read from
- * @param pd The postings data object to write the stream info to
- * @return the input stream
- */
-template <>
-inline io::compressed_file_reader& operator>>
-    <>(io::compressed_file_reader& in, postings_data<std::string, doc_id>& pd)
-{
-    pd.p_id_ = in.next_string();
-    stream_helper(in, pd);
-    return in;
-}
+  public:
+    /// The number of postings per block in the packed format
+    const static uint64_t block_size = 128;
+};
 
 /**
  * @param lhs The first postings_data
@@ -270,21 +295,22 @@ inline io::compressed_file_reader& operator>>
  * @return whether this postings_data has the same PrimaryKey as
  * the paramter
  */
-template <class PrimaryKey, class SecondaryKey>
-bool operator==(const postings_data<PrimaryKey, SecondaryKey>& lhs,
-                const postings_data<PrimaryKey, SecondaryKey>& rhs);
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+bool operator==(const postings_data<PrimaryKey, SecondaryKey, Allocator>& lhs,
+                const postings_data<PrimaryKey, SecondaryKey, Allocator>& rhs);
 }
 }
 
 namespace std
 {
-template <class PrimaryKey, class SecondaryKey>
+template <class PrimaryKey, class SecondaryKey, class Allocator>
 /**
  * Hash specialization for postings_data<PrimaryKey, SecondaryKey>
  */
-struct hash<meta::index::postings_data<PrimaryKey, SecondaryKey>>
+struct hash<meta::index::postings_data<PrimaryKey, SecondaryKey, Allocator>>
 {
-    using pdata_t = meta::index::postings_data<PrimaryKey, SecondaryKey>;
+    using pdata_t
+        = meta::index::postings_data<PrimaryKey, SecondaryKey, Allocator>;
     /**
      * @param pd The postings_data to hash
      * @return the hash of the given postings_data
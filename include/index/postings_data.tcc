@@ -4,6 +4,7 @@
  */
 
 #include <algorithm>
+#include <array>
 #include <cstring>
 #include "index/postings_data.h"
 
@@ -12,14 +13,27 @@ namespace meta
 namespace index
 {
 
-template <class PrimaryKey, class SecondaryKey>
-postings_data<PrimaryKey, SecondaryKey>::postings_data(PrimaryKey p_id)
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+const uint64_t postings_data<PrimaryKey, SecondaryKey, Allocator>::block_size;
+
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+postings_data<PrimaryKey, SecondaryKey, Allocator>::postings_data(
+    PrimaryKey p_id)
     : p_id_{p_id}
 {/* nothing */
 }
 
-template <class PrimaryKey, class SecondaryKey>
-void postings_data<PrimaryKey, SecondaryKey>::merge_with(postings_data& other)
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+postings_data<PrimaryKey, SecondaryKey, Allocator>::postings_data(
+    PrimaryKey p_id, const Allocator& alloc)
+    : p_id_{p_id}, counts_{alloc}
+{
+    // nothing
+}
+
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+void postings_data<PrimaryKey, SecondaryKey, Allocator>::merge_with(
+    postings_data& other)
 {
     auto searcher = [](const pair_t& p, const SecondaryKey& s) {
         return p.first < s;
@@ -50,64 +64,67 @@ void postings_data<PrimaryKey, SecondaryKey>::merge_with(postings_data& other)
     }
 }
 
-template <class PrimaryKey, class SecondaryKey>
-void postings_data
-    <PrimaryKey, SecondaryKey>::increase_count(SecondaryKey s_id, double amount)
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+void postings_data<PrimaryKey, SecondaryKey, Allocator>::increase_count(
+    SecondaryKey s_id, double amount)
 {
     counts_[s_id] += amount;
 }
 
-template <class PrimaryKey, class SecondaryKey>
-double postings_data<PrimaryKey, SecondaryKey>::count(SecondaryKey s_id) const
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+double postings_data<PrimaryKey, SecondaryKey, Allocator>::count(
+    SecondaryKey s_id) const
 {
     return counts_.at(s_id);
 }
 
-template <class PrimaryKey, class SecondaryKey>
-const std::vector<std::pair<SecondaryKey, double>>& postings_data
-    <PrimaryKey, SecondaryKey>::counts() const
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+auto postings_data<PrimaryKey, SecondaryKey, Allocator>::counts() const
+    -> const count_t &
 {
     return counts_.contents();
 }
 
-template <class PrimaryKey, class SecondaryKey>
-void postings_data<PrimaryKey, SecondaryKey>::set_counts(const count_t& counts)
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+void postings_data<PrimaryKey, SecondaryKey, Allocator>::set_counts(
+    count_t counts)
 {
     // no sort needed: sparse_vector::contents() sorts the parameter
-    counts_.contents(counts);
+    counts_.contents(std::move(counts));
 }
 
-template <class PrimaryKey, class SecondaryKey>
-void postings_data
-    <PrimaryKey, SecondaryKey>::set_primary_key(PrimaryKey new_key)
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+void postings_data<PrimaryKey, SecondaryKey, Allocator>::set_primary_key(
+    PrimaryKey new_key)
 {
     p_id_ = new_key;
 }
 
-template <class PrimaryKey, class SecondaryKey>
-bool postings_data<PrimaryKey, SecondaryKey>::operator<(const postings_data
-                                                        & other) const
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+bool postings_data<PrimaryKey, SecondaryKey, Allocator>::operator<(
+    const postings_data& other) const
 {
     return primary_key() < other.primary_key();
 }
 
-template <class PrimaryKey, class SecondaryKey>
-bool operator==(const postings_data<PrimaryKey, SecondaryKey>& lhs,
-                const postings_data<PrimaryKey, SecondaryKey>& rhs)
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+bool operator==(const postings_data<PrimaryKey, SecondaryKey, Allocator>& lhs,
+                const postings_data<PrimaryKey, SecondaryKey, Allocator>& rhs)
 {
     return lhs.primary_key() == rhs.primary_key();
 }
 
-template <class PrimaryKey, class SecondaryKey>
-PrimaryKey postings_data<PrimaryKey, SecondaryKey>::primary_key() const
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+auto postings_data<PrimaryKey, SecondaryKey, Allocator>::primary_key() const
+    -> PrimaryKey
 {
     return p_id_;
 }
 
-template <class PrimaryKey, class SecondaryKey>
-void postings_data
-    <PrimaryKey, SecondaryKey>::write_compressed(io::compressed_file_writer
-                                                 & writer) const
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+template <class Mapping>
+void postings_data<PrimaryKey, SecondaryKey, Allocator>::write_compressed(
+    io::basic_compressed_file_writer<Mapping>& writer) const
 {
     count_t mutable_counts{counts_.contents()};
     writer.write(mutable_counts[0].first);
@@ -151,9 +168,10 @@ void postings_data
     writer.write(delimiter_);
 }
 
-template <class PrimaryKey, class SecondaryKey>
-void postings_data<PrimaryKey, SecondaryKey>::read_compressed(
-        io::compressed_file_reader& reader)
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+template <class Mapping>
+void postings_data<PrimaryKey, SecondaryKey, Allocator>::read_compressed(
+    io::basic_compressed_file_reader<Mapping>& reader)
 {
     counts_.clear();
     uint64_t last_id = 0;
@@ -184,6 +202,98 @@ void postings_data<PrimaryKey, SecondaryKey>::read_compressed(
     counts_.shrink_to_fit();
 }
 
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+uint64_t postings_data<PrimaryKey, SecondaryKey, Allocator>::write_packed(
+    std::ostream& out) const
+{
+    const auto& counts = counts_.contents();
+    uint64_t bytes = io::stream_vbyte::write_varint(out, counts.size());
+
+    std::array<uint32_t, block_size> gaps;
+    std::array<uint32_t, block_size> freqs;
+    std::vector<uint8_t> blocks;
+    std::vector<uint8_t> buffer(io::stream_vbyte::max_encoded_size(block_size));
+
+    auto narrow = [](uint64_t value)
+    {
+        if (value > std::numeric_limits<uint32_t>::max())
+            throw io::stream_vbyte::stream_vbyte_exception{
+                "value too large for the packed postings format"};
+        return static_cast<uint32_t>(value);
+    };
+
+    auto encode_run = [&](const std::array<uint32_t, block_size>& run,
+                          uint64_t n)
+    {
+        auto len = io::stream_vbyte::encode(run.data(), n, buffer.data());
+        blocks.insert(blocks.end(), buffer.begin(), buffer.begin() + len);
+        return len;
+    };
+
+    // the skip table precedes the blocks, so encode them all first
+    uint64_t last_id = 0;
+    for (uint64_t start = 0; start < counts.size(); start += block_size)
+    {
+        uint64_t n = std::min<uint64_t>(block_size, counts.size() - start);
+        uint64_t block_start_id = last_id;
+        uint32_t max_count = 0;
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            // use gap encoding on the SecondaryKeys (we know they are
+            // integral types)
+            uint64_t id = counts[start + i].first;
+            gaps[i] = narrow(id - last_id);
+            freqs[i] = narrow(static_cast<uint64_t>(counts[start + i].second));
+            max_count = std::max(max_count, freqs[i]);
+            last_id = id;
+        }
+
+        auto len = encode_run(gaps, n);
+        len += encode_run(freqs, n);
+
+        bytes += io::stream_vbyte::write_varint(out, last_id - block_start_id);
+        bytes += io::stream_vbyte::write_varint(out, len);
+        bytes += io::stream_vbyte::write_varint(out, max_count);
+    }
+
+    out.write(reinterpret_cast<const char*>(blocks.data()), blocks.size());
+    return bytes + blocks.size();
+}
+
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+void postings_data<PrimaryKey, SecondaryKey, Allocator>::read_packed(
+    const char* data)
+{
+    counts_.clear();
+    auto in = reinterpret_cast<const uint8_t*>(data);
+    uint64_t size = io::stream_vbyte::read_varint(in);
+    counts_.reserve(size);
+
+    // we are decoding everything, so the skip table isn't needed
+    for (uint64_t start = 0; start < size; start += block_size)
+    {
+        for (uint8_t i = 0; i < 3; ++i)
+            io::stream_vbyte::read_varint(in);
+    }
+
+    std::array<uint32_t, block_size> gaps;
+    std::array<uint32_t, block_size> freqs;
+
+    uint64_t last_id = 0;
+    for (uint64_t start = 0; start < size; start += block_size)
+    {
+        uint64_t n = std::min<uint64_t>(block_size, size - start);
+        in += io::stream_vbyte::decode(in, n, gaps.data());
+        in += io::stream_vbyte::decode(in, n, freqs.data());
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            last_id += gaps[i];
+            counts_.emplace_back(SecondaryKey{last_id},
+                                 static_cast<double>(freqs[i]));
+        }
+    }
+}
+
 namespace
 {
 template <class T>
@@ -201,8 +311,8 @@ uint64_t length(const T& elem, typename std::enable_if<
 }
 }
 
-template <class PrimaryKey, class SecondaryKey>
-uint64_t postings_data<PrimaryKey, SecondaryKey>::bytes_used() const
+template <class PrimaryKey, class SecondaryKey, class Allocator>
+uint64_t postings_data<PrimaryKey, SecondaryKey, Allocator>::bytes_used() const
 {
     return sizeof(pair_t) * counts_.size() + length(p_id_);
 }
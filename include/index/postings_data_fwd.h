@@ -0,0 +1,30 @@
+/**
+ * @file postings_data_fwd.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_POSTINGS_DATA_FWD_H_
+#define META_INDEX_POSTINGS_DATA_FWD_H_
+
+#include <memory>
+#include <utility>
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * Declares postings_data, with its default allocator, for headers that
+ * only name it.
+ */
+template <class PrimaryKey, class SecondaryKey,
+          class Allocator = std::allocator<std::pair<SecondaryKey, double>>>
+class postings_data;
+}
+}
+
+#endif
@@ -0,0 +1,124 @@
+/**
+ * @file pruning.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_PRUNING_H_
+#define META_INDEX_PRUNING_H_
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "meta.h"
+
+namespace cpptoml
+{
+class table;
+}
+
+namespace meta
+{
+namespace index
+{
+
+class inverted_index;
+class ranker;
+
+/**
+ * The ways of choosing which postings a pruned index keeps.
+ */
+enum class pruning_method
+{
+    /**
+     * Term-centric pruning (Carmel et al.): each term keeps the postings
+     * whose impact is within a factor of its k-th best impact, so that the
+     * top k documents of every single-term query are unchanged. The
+     * factor is shared by all terms and chosen to meet the target size.
+     */
+    term_centric,
+
+    /**
+     * Document-centric pruning (Büttcher and Clarke): each document keeps
+     * the same fraction of its postings, those of its highest impact.
+     */
+    document_centric
+};
+
+/**
+ * Options for static index pruning.
+ */
+struct pruning_options
+{
+    /**
+     * How the postings to keep are chosen.
+     */
+    pruning_method method = pruning_method::term_centric;
+
+    /**
+     * The fraction of the postings to keep, in (0, 1].
+     */
+    double keep = 0.5;
+
+    /**
+     * For term-centric pruning, the number of top documents of each term
+     * that are always kept, even past the target size.
+     */
+    uint64_t top_k = 10;
+
+    /**
+     * How many threads compute the impacts of the postings.
+     */
+    uint64_t num_threads = std::thread::hardware_concurrency();
+};
+
+/**
+ * Creates a smaller index holding the postings of another that contribute
+ * most to its scores. The impact of a posting is the score a ranker gives
+ * it for a query term of weight one, as in impact_index.
+ *
+ * The pruned index has every document of the source under the same
+ * doc_id, with its length and unique term count, and keeps the document
+ * frequency and total count of every term it still has. Rankers therefore
+ * compute the same scores from it as from the source; documents that lost
+ * the postings of a query's terms just no longer get them. Positions are
+ * kept for the postings that are kept.
+ *
+ * @param source The index to prune
+ * @param r The ranker whose scores decide which postings matter
+ * @param config_file The configuration of the pruned index, which must
+ * analyze documents as the source's does but name another index directory;
+ * any index already in that directory is replaced
+ * @param options How many postings to keep and how to choose them
+ * @return the pruned index
+ */
+std::shared_ptr<inverted_index>
+    prune_index(const std::shared_ptr<inverted_index>& source, ranker& r,
+                const std::string& config_file,
+                const pruning_options& options);
+
+/**
+ * Reads pruning options from the `[pruning]` table of a configuration,
+ * which may set `method` ("term-centric" or "document-centric"), `keep`,
+ * `top-k`, and `num-threads`. Options that are not set keep their default.
+ * @param config The configuration
+ * @return the options
+ */
+pruning_options make_pruning_options(const cpptoml::table& config);
+
+/**
+ * Basic exception for pruning interactions.
+ */
+class pruning_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
@@ -46,6 +46,23 @@ class absolute_discount : public language_model_ranker
      */
     double doc_constant(const score_data& sd) const override;
 
+    /**
+     * Bounds score_one() using the largest count of the term.
+     * @param sd score_data for the current query
+     */
+    double score_upper_bound(const score_data& sd) const override;
+
+    /**
+     * Bounds initial_score() over all documents.
+     * @param sd score_data for the current query
+     */
+    double initial_score_upper_bound(const score_data& sd) const override;
+
+    /**
+     * @return the ranker's id and parameters
+     */
+    std::string parameters() const override;
+
   private:
     /// the absolute discounting parameter
     const double delta_;
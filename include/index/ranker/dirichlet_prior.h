@@ -46,6 +46,33 @@ class dirichlet_prior : public language_model_ranker
      */
     double doc_constant(const score_data& sd) const override;
 
+    /**
+     * Scores a block of postings, computing the smoothing terms that
+     * depend only on the term once for all of them.
+     * @param sd score_data for the current query and term
+     * @param block The postings to score
+     * @param scores Where to write their scores
+     */
+    void score_postings(score_data& sd, const posting_block& block,
+                        double* scores) override;
+
+    /**
+     * Bounds score_one() using the largest count of the term.
+     * @param sd score_data for the current query
+     */
+    double score_upper_bound(const score_data& sd) const override;
+
+    /**
+     * Bounds initial_score() over all documents.
+     * @param sd score_data for the current query
+     */
+    double initial_score_upper_bound(const score_data& sd) const override;
+
+    /**
+     * @return the ranker's id and parameters
+     */
+    std::string parameters() const override;
+
   private:
     /// the Dirichlet prior parameter
     const double mu_;
@@ -48,6 +48,27 @@ class okapi_bm25 : public ranker
      */
     double score_one(const score_data& sd) override;
 
+    /**
+     * Scores a block of postings, computing the IDF and QTF of the term
+     * once for all of them.
+     * @param sd score_data for the current query and term
+     * @param block The postings to score
+     * @param scores Where to write their scores
+     */
+    void score_postings(score_data& sd, const posting_block& block,
+                        double* scores) override;
+
+    /**
+     * Bounds score_one() by taking the document length to be zero.
+     * @param sd score_data for the current query
+     */
+    double score_upper_bound(const score_data& sd) const override;
+
+    /**
+     * @return the ranker's id and parameters
+     */
+    std::string parameters() const override;
+
   private:
     /// Doc term smoothing
     const double k1_;
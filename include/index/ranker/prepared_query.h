@@ -0,0 +1,125 @@
+/**
+ * @file prepared_query.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_PREPARED_QUERY_H_
+#define META_INDEX_PREPARED_QUERY_H_
+
+#include <vector>
+
+#include "corpus/document.h"
+#include "meta.h"
+
+namespace meta
+{
+namespace index
+{
+
+class inverted_index;
+
+/**
+ * A query term resolved against an index.
+ */
+struct prepared_term
+{
+    /// The id of the term in the index
+    term_id t_id;
+    /// The weight of the term in the query
+    double weight;
+    /// The number of documents that contain the term
+    uint64_t doc_count;
+    /// The number of times the term occurs in the index
+    uint64_t corpus_term_count;
+    /// The probability of the term in the index's language model
+    double corpus_term_prob;
+};
+
+/**
+ * A query analyzed and resolved against an index once, so that it can be
+ * scored many times, as when tuning a ranker over a fixed set of queries,
+ * without paying each time for tokenizing it, looking its terms up in the
+ * vocabulary, and reading their statistics.
+ *
+ * A prepared query holds the term ids of one index, along with the
+ * statistics of the terms and of the index at the time it was prepared,
+ * and may only be scored on that index (see ranker::score()). Scoring it
+ * gives the same results as scoring the query itself.
+ *
+ * ~~~cpp
+ * corpus::document doc;
+ * doc.content("stock prices");
+ * index::prepared_query query{*idx, std::move(doc)};
+ * for (auto& ranker : rankers)
+ *     auto results = ranker->score(*idx, query, 10);
+ * ~~~
+ */
+class prepared_query
+{
+  public:
+    /**
+     * Tokenizes a query, if it has not been, and resolves its terms. Like
+     * inverted_index::tokenize(), this is not safe to call on one index
+     * from several threads at once; scoring the prepared query is.
+     * @param idx The index the query will be scored on
+     * @param query The query
+     */
+    prepared_query(inverted_index& idx, corpus::document query);
+
+    /**
+     * @return the index the query was prepared for
+     */
+    const inverted_index& index() const;
+
+    /**
+     * @return the tokenized query
+     */
+    const corpus::document& query() const;
+
+    /**
+     * @return the resolved terms, in the iteration order of the query's
+     * counts()
+     */
+    const std::vector<prepared_term>& terms() const;
+
+    /**
+     * @return the average document length in the index
+     */
+    double avg_doc_length() const;
+
+    /**
+     * @return the number of documents in the index
+     */
+    uint64_t num_docs() const;
+
+    /**
+     * @return the total number of terms in the index
+     */
+    uint64_t total_terms() const;
+
+  private:
+    /// The index the query was prepared for
+    const inverted_index* idx_;
+
+    /// The tokenized query
+    corpus::document query_;
+
+    /// The resolved terms
+    std::vector<prepared_term> terms_;
+
+    /// The average document length in the index
+    double avg_dl_;
+
+    /// The number of documents in the index
+    uint64_t num_docs_;
+
+    /// The total number of terms in the index
+    uint64_t total_terms_;
+};
+}
+}
+
+#endif
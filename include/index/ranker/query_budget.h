@@ -0,0 +1,117 @@
+/**
+ * @file query_budget.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_QUERY_BUDGET_H_
+#define META_INDEX_QUERY_BUDGET_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "meta.h"
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * Limits on the work a single query may do: a deadline, a number of
+ * postings, or both. Rankers charge the postings they walk to the budget
+ * as they go and stop, returning the best documents found so far, once it
+ * is spent or once the query is cancelled.
+ *
+ * cancel() may be called from any thread while the query runs; the clock
+ * is only read every few thousand postings, so a deadline may be overrun
+ * by the time it takes to walk that many.
+ */
+class query_budget
+{
+  public:
+    /// The clock deadlines are measured on
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * Creates a budget without limits, which only cancel() ends.
+     */
+    query_budget();
+
+    /**
+     * Sets the time by which the query must stop.
+     * @param when The deadline
+     * @return this budget
+     */
+    query_budget& deadline(clock::time_point when);
+
+    /**
+     * Sets the deadline to some time from now.
+     * @param duration The time the query may take
+     * @return this budget
+     */
+    query_budget& timeout(clock::duration duration);
+
+    /**
+     * Sets the number of postings the query may walk.
+     * @param num_postings The number of postings
+     * @return this budget
+     */
+    query_budget& max_postings(uint64_t num_postings);
+
+    /**
+     * Asks the query to stop as soon as it next checks its budget.
+     */
+    void cancel();
+
+    /**
+     * Charges postings to the budget.
+     * @param num_postings The number of postings walked since the last
+     * charge
+     * @return whether the query may go on
+     */
+    bool charge(uint64_t num_postings);
+
+    /**
+     * @return whether the budget has run out or the query was cancelled
+     */
+    bool exhausted() const;
+
+    /**
+     * @return the number of postings charged so far
+     */
+    uint64_t postings() const;
+
+  private:
+    /// the time by which the query must stop
+    clock::time_point deadline_;
+    /// the number of postings the query may walk
+    uint64_t max_postings_;
+    /// the number of postings charged so far
+    std::atomic<uint64_t> postings_;
+    /// the number of postings charged when the clock was last read
+    std::atomic<uint64_t> last_clock_check_;
+    /// whether the query must stop
+    std::atomic<bool> exhausted_;
+};
+
+/**
+ * The results of a query scored within a query_budget.
+ */
+struct budgeted_results
+{
+    /// the best documents found, sorted by decreasing score
+    std::vector<std::pair<doc_id, double>> results;
+    /// whether the budget ran out (or the query was cancelled) before
+    /// every posting was walked, so that results may be incomplete
+    bool terminated_early;
+};
+}
+}
+
+#endif
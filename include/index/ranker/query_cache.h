@@ -0,0 +1,104 @@
+/**
+ * @file query_cache.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_QUERY_CACHE_H_
+#define META_INDEX_QUERY_CACHE_H_
+
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "caching/cache_stats.h"
+#include "caching/dblru_cache.h"
+#include "meta.h"
+
+namespace meta
+{
+namespace corpus
+{
+class document;
+}
+
+namespace index
+{
+
+class inverted_index;
+class ranker;
+
+/**
+ * Caches the results of queries in front of a ranker, so that a query
+ * that is asked again is answered without reading any postings.
+ *
+ * Queries are keyed on their analyzed terms and weights (so two queries
+ * differing only in ways the analyzer discards share an entry), on the
+ * ranker and its parameters (see ranker::parameters()), on the number of
+ * results, and on the index. Every entry is dropped as soon as the index
+ * is seen to change---its documents, its terms, or its deletions---and
+ * the Cache policy bounds how many results are kept.
+ *
+ * Filtered queries are never cached, since the filter cannot be part of
+ * the key; they are passed straight to the ranker.
+ */
+template <template <class, class> class Cache = caching::default_dblru_cache>
+class query_cache
+{
+  public:
+    /// The results of a query
+    using results_type = std::vector<std::pair<doc_id, double>>;
+
+    /**
+     * @param args The arguments to send to the Cache constructor
+     */
+    template <class... Args>
+    query_cache(Args&&... args);
+
+    /**
+     * Scores a query with a ranker, unless its results are cached.
+     * @param idx The index to search
+     * @param r The ranker to score with
+     * @param query The query; it is tokenized first if it has not been
+     * @param num_results The number of results to return
+     * @return the results, as ranker::score() would return them
+     */
+    results_type score(inverted_index& idx, ranker& r,
+                       corpus::document& query, uint64_t num_results = 10);
+
+    /**
+     * Drops every cached result.
+     */
+    void clear();
+
+    /**
+     * @return the activity of the cache so far
+     */
+    caching::cache_stats stats() const;
+
+  private:
+    /**
+     * Drops every cached result if idx is not the index seen last time or
+     * it has changed since.
+     * @param idx The index about to be searched
+     * @return the state of idx, to key the results on
+     */
+    std::string check_index(inverted_index& idx);
+
+    /// The cached results, by key
+    Cache<std::string, results_type> cache_;
+
+    /// Protects index_state_
+    std::mutex mutex_;
+
+    /// The state of the index seen last, empty if none has been
+    std::string index_state_;
+};
+}
+}
+
+#include "index/ranker/query_cache.tcc"
+#endif
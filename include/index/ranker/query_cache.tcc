@@ -0,0 +1,84 @@
+/**
+ * @file query_cache.tcc
+ */
+
+#include <algorithm>
+#include <limits>
+#include <sstream>
+
+#include "corpus/document.h"
+#include "index/inverted_index.h"
+#include "index/ranker/query_cache.h"
+#include "index/ranker/ranker.h"
+
+namespace meta
+{
+namespace index
+{
+
+template <template <class, class> class Cache>
+template <class... Args>
+query_cache<Cache>::query_cache(Args&&... args)
+    : cache_(std::forward<Args>(args)...)
+{
+    /* nothing */
+}
+
+template <template <class, class> class Cache>
+auto query_cache<Cache>::score(inverted_index& idx, ranker& r,
+                               corpus::document& query, uint64_t num_results)
+    -> results_type
+{
+    if (query.counts().empty())
+        idx.tokenize(query);
+
+    std::vector<std::pair<std::string, double>> terms{query.counts().begin(),
+                                                      query.counts().end()};
+    std::sort(terms.begin(), terms.end());
+
+    std::ostringstream key;
+    key.precision(std::numeric_limits<double>::max_digits10);
+    key << check_index(idx) << '\n' << r.parameters() << '\n' << num_results;
+    for (const auto& term : terms)
+        key << '\n' << term.first << '\t' << term.second;
+
+    if (auto results = cache_.find(key.str()))
+        return *results;
+
+    auto results = r.score(idx, query, num_results);
+    cache_.insert(key.str(), results);
+    return results;
+}
+
+template <template <class, class> class Cache>
+std::string query_cache<Cache>::check_index(inverted_index& idx)
+{
+    // deletions are never undone, so the number of them changes whenever
+    // the set of them does
+    std::ostringstream state;
+    state << idx.index_name() << '\t' << idx.num_docs() << '\t'
+          << idx.unique_terms() << '\t' << idx.total_corpus_terms() << '\t'
+          << idx.num_deleted();
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (state.str() != index_state_)
+    {
+        cache_.clear();
+        index_state_ = state.str();
+    }
+    return index_state_;
+}
+
+template <template <class, class> class Cache>
+void query_cache<Cache>::clear()
+{
+    cache_.clear();
+}
+
+template <template <class, class> class Cache>
+caching::cache_stats query_cache<Cache>::stats() const
+{
+    return cache_.stats();
+}
+}
+}
@@ -9,10 +9,19 @@
 #ifndef META_RANKER_H_
 #define META_RANKER_H_
 
+#include <functional>
+#include <future>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 
+#include "index/ranker/query_budget.h"
 #include "meta.h"
+#include "util/optional.h"
 
 namespace meta
 {
@@ -25,8 +34,15 @@ class document;
 namespace index
 {
 class inverted_index;
+class prepared_query;
+struct posting_block;
 struct score_data;
 }
+
+namespace parallel
+{
+class thread_pool;
+}
 }
 
 namespace meta
@@ -34,9 +50,69 @@ namespace meta
 namespace index
 {
 
+/**
+ * Statistics of a collection that an index holds only part of, such as
+ * the segments of a segmented_index. Scoring the part with them gives each
+ * of its documents the score it would have in the whole collection.
+ */
+struct collection_stats
+{
+    /// the number of documents in the collection
+    uint64_t num_docs;
+    /// the average document length in the collection
+    double avg_dl;
+    /// the total number of terms in the collection
+    uint64_t total_terms;
+    /// query term -> (number of documents containing it, its total count)
+    std::unordered_map<std::string, std::pair<uint64_t, uint64_t>> terms;
+};
+
+/**
+ * What is known of the results of a query before it is scored, as when a
+ * cheaper first-stage ranker has already ranked it, or when an earlier run
+ * of the query (or of one much like it) found its best documents. Seeding
+ * ranker::score() with it lets block-max WAND skip documents from the
+ * first posting on, instead of only once the top num_results have been
+ * filled by the documents met first.
+ */
+struct score_seed
+{
+    /// Only documents scoring above this are returned; it should be a
+    /// score that at least num_results documents are known to exceed
+    double threshold = std::numeric_limits<double>::lowest();
+
+    /// Documents likely to be among the results, such as those a
+    /// first-stage ranker returned; they are scored before the others,
+    /// and do not change the results, only how soon the threshold rises
+    std::vector<doc_id> candidates;
+
+    /**
+     * @param results The results of an earlier ranking of the query
+     * @return a seed whose candidates are the documents of the results
+     */
+    static score_seed
+        from_results(const std::vector<std::pair<doc_id, double>>& results);
+};
+
 /**
  * A ranker scores a query against all the documents in an inverted index,
  * returning a list of documents sorted by relevance.
+ *
+ * If a ranker can bound the contribution of each query term (see
+ * score_upper_bound()), queries are evaluated document-at-a-time with
+ * block-max WAND: documents whose bound cannot beat the current top
+ * num_results are skipped without being scored. Otherwise, every posting
+ * of every query term is scored term-at-a-time.
+ *
+ * Documents deleted from the index are skipped while the postings are
+ * walked, before they are scored or passed to the filter, and documents
+ * the filter rejects are skipped before they are scored. Filters are
+ * called once per posting, so the filters built by field_store, which
+ * are single bit tests, are the cheapest way to restrict a query to
+ * documents with some field values.
+ *
+ * score() keeps no per-query state in the ranker, so a single ranker may
+ * be used by several threads at once.
  */
 class ranker
 {
@@ -46,14 +122,197 @@ class ranker
      * @param query The current query
      * @param num_results The number of results to return in the vector
      * @param filter A filtering function to apply to each doc_id; returns true
-     * if the document should be included in results
+     * if the document should be included in results. Deleted documents
+     * are never included, and an empty filter includes every other one.
      */
     std::vector<std::pair<doc_id, double>>
     score(inverted_index& idx, corpus::document& query,
           uint64_t num_results = 10,
-          const std::function<bool(doc_id d_id)>& filter = [](doc_id) {
-              return true;
-          });
+          const std::function<bool(doc_id d_id)>& filter = nullptr);
+
+    /**
+     * Scores a prepared query, without tokenizing it or looking up its
+     * terms and their statistics again. The results are those score()
+     * gives for the query itself.
+     * @param idx The index the query was prepared for
+     * @param query The prepared query
+     * @param num_results The number of results to return in the vector
+     * @param filter A filtering function to apply to each doc_id; returns true
+     * if the document should be included in results. Deleted documents
+     * are never included, and an empty filter includes every other one.
+     */
+    std::vector<std::pair<doc_id, double>>
+    score(inverted_index& idx, const prepared_query& query,
+          uint64_t num_results = 10,
+          const std::function<bool(doc_id d_id)>& filter = nullptr);
+
+    /**
+     * Scores a query with a seed from an earlier or cheaper ranking of it
+     * (see score_seed). The candidates of the seed are scored first, so
+     * that document-at-a-time scoring starts with the threshold their
+     * scores give; the results are then those of score(), except that
+     * documents that do not score above the seed's threshold are left
+     * out, and the results are not padded with documents that match no
+     * query terms when the seed has a threshold. Rankers that cannot
+     * bound their scores score every posting, as score() does, and only
+     * apply the threshold to the results.
+     * @param idx The index this ranker is operating on
+     * @param query The current query
+     * @param seed What is known of the results
+     * @param num_results The number of results to return in the vector
+     * @param filter A filtering function to apply to each doc_id; returns true
+     * if the document should be included in results. Deleted documents
+     * are never included, and an empty filter includes every other one.
+     */
+    std::vector<std::pair<doc_id, double>>
+    score(inverted_index& idx, corpus::document& query, const score_seed& seed,
+          uint64_t num_results = 10,
+          const std::function<bool(doc_id d_id)>& filter = nullptr);
+
+    /**
+     * Scores a prepared query with a seed from an earlier or cheaper
+     * ranking of it, as the other seeded score() does.
+     * @param idx The index the query was prepared for
+     * @param query The prepared query
+     * @param seed What is known of the results
+     * @param num_results The number of results to return in the vector
+     * @param filter A filtering function to apply to each doc_id; returns true
+     * if the document should be included in results. Deleted documents
+     * are never included, and an empty filter includes every other one.
+     */
+    std::vector<std::pair<doc_id, double>>
+    score(inverted_index& idx, const prepared_query& query,
+          const score_seed& seed, uint64_t num_results = 10,
+          const std::function<bool(doc_id d_id)>& filter = nullptr);
+
+    /**
+     * Scores the documents of an index that is part of a larger
+     * collection, using the collection's statistics rather than the
+     * index's. Unlike the other overload, the results are not padded with
+     * documents that match no query terms, so that the results for each
+     * part can be merged.
+     * @param idx The index this ranker is operating on
+     * @param query The current query
+     * @param stats The statistics of the whole collection
+     * @param num_results The number of results to return in the vector
+     * @param filter A filtering function to apply to each doc_id; returns true
+     * if the document should be included in results. Deleted documents
+     * are never included, and an empty filter includes every other one.
+     */
+    std::vector<std::pair<doc_id, double>>
+    score(inverted_index& idx, corpus::document& query,
+          const collection_stats& stats, uint64_t num_results = 10,
+          const std::function<bool(doc_id d_id)>& filter = nullptr);
+
+    /**
+     * Scores a query within a budget of time or postings. The budget is
+     * checked as the postings are walked; once it runs out, or the
+     * caller cancels it, the best documents scored so far are returned.
+     * Those are not padded with documents that match no query terms,
+     * since the documents not yet reached may match some.
+     * @param idx The index this ranker is operating on
+     * @param query The current query
+     * @param budget The limits on the work of the query
+     * @param num_results The number of results to return in the vector
+     * @param filter A filtering function to apply to each doc_id; returns true
+     * if the document should be included in results. Deleted documents
+     * are never included, and an empty filter includes every other one.
+     * @return the results, and whether the query stopped early; if it did
+     * not, the results are those of score()
+     */
+    budgeted_results score(inverted_index& idx, corpus::document& query,
+                           query_budget& budget, uint64_t num_results = 10,
+                           const std::function<bool(doc_id d_id)>& filter
+                           = nullptr);
+
+    /**
+     * Scores a query within a budget on a thread pool, returning at once.
+     * The caller may cancel the budget to stop the query early. The
+     * index, the ranker, and the budget must outlive the query.
+     * @param idx The index this ranker is operating on
+     * @param query The query, which is tokenized on the pool if it has
+     * not been
+     * @param pool The thread pool to score on
+     * @param budget The limits on the work of the query
+     * @param num_results The number of results to return in the vector
+     * @param filter A filtering function to apply to each doc_id; returns true
+     * if the document should be included in results. Deleted documents
+     * are never included, and an empty filter includes every other one.
+     * @return the results, as the budgeted score() returns them, once the
+     * query is done
+     */
+    std::future<budgeted_results>
+        score_async(inverted_index& idx, corpus::document query,
+                    parallel::thread_pool& pool, query_budget& budget,
+                    uint64_t num_results = 10,
+                    std::function<bool(doc_id d_id)> filter = nullptr);
+
+    /**
+     * Scores only the documents that contain every query term (a boolean
+     * AND of the terms). The postings lists are intersected led by the
+     * rarest term: each of its documents is looked for in the other lists
+     * with skip_to(), so the blocks of the longer lists that fall between
+     * matches are never decoded, and only the documents in the
+     * intersection are scored with score_one(). Query terms that are not
+     * in the index match no documents.
+     * @param idx The index this ranker is operating on
+     * @param query The current query
+     * @param num_results The number of results to return in the vector
+     * @param filter A filtering function to apply to each doc_id; returns true
+     * if the document should be included in results. Deleted documents
+     * are never included, and an empty filter includes every other one.
+     * @return the best matching documents; fewer than num_results if
+     * fewer contain every term
+     */
+    std::vector<std::pair<doc_id, double>>
+        score_conjunctive(inverted_index& idx, corpus::document& query,
+                          uint64_t num_results = 10,
+                          const std::function<bool(doc_id d_id)>& filter
+                          = nullptr);
+
+    /**
+     * Scores a batch of queries on a pool of threads. Queries that have
+     * not been tokenized are tokenized first, on the calling thread. When
+     * several queries of the batch contain a term and are scored
+     * term-at-a-time, its postings are read and decoded only once.
+     * @param idx The index this ranker is operating on
+     * @param queries The queries
+     * @param num_results The number of results to return for each query
+     * @param num_threads The number of threads to score with
+     * @return the results of each query, in the order of queries, the same
+     * as if each query had been passed to score()
+     */
+    std::vector<std::vector<std::pair<doc_id, double>>>
+        score_batch(inverted_index& idx,
+                    std::vector<corpus::document>& queries,
+                    uint64_t num_results = 10,
+                    uint64_t num_threads
+                    = std::thread::hardware_concurrency());
+
+    /**
+     * Scores a single query on a pool of threads, for long queries (such
+     * as those expanded by feedback) whose latency matters more than the
+     * throughput of the pool. The doc_ids of the index are split into
+     * ranges that the threads claim in turn. Each range is scored as
+     * score() scores the whole index, with every query term's postings
+     * walked only within it. The best documents of each range are then
+     * merged. The postings of each term are opened only once.
+     * @param idx The index this ranker is operating on
+     * @param query The current query
+     * @param pool The thread pool to score with
+     * @param num_results The number of results to return in the vector
+     * @param filter A filtering function to apply to each doc_id; returns true
+     * if the document should be included in results. Deleted documents
+     * are never included, and an empty filter includes every other one.
+     * @return the same documents and scores as score(), up to the order
+     * of documents with equal scores
+     */
+    std::vector<std::pair<doc_id, double>>
+        score_parallel(inverted_index& idx, corpus::document& query,
+                       parallel::thread_pool& pool,
+                       uint64_t num_results = 10,
+                       const std::function<bool(doc_id d_id)>& filter
+                       = nullptr);
 
     /**
      * Computes the contribution to the score of a document for a matched
@@ -62,6 +321,21 @@ class ranker
      */
     virtual double score_one(const score_data& sd) = 0;
 
+    /**
+     * Computes score_one() for each of a block of postings of one query
+     * term. Term-at-a-time scoring calls this rather than score_one(), so
+     * that a ranker can compute what depends only on the term once and
+     * score the postings in a loop free of virtual calls. An override
+     * must give the same scores as score_one(); the default calls it for
+     * each posting.
+     * @param sd The score_data for the query, with the term-based fields
+     * set; the document-based fields may be overwritten
+     * @param block The postings to score
+     * @param scores Where to write the score of each posting of the block
+     */
+    virtual void score_postings(score_data& sd, const posting_block& block,
+                                double* scores);
+
     /**
      * Computes the constant contribution to the score of a particular
      * document.
@@ -69,14 +343,142 @@ class ranker
      */
     virtual double initial_score(const score_data& sd) const;
 
+    /**
+     * Computes an upper bound on score_one() for a query term over a set of
+     * documents. The term-based fields of sd are set, and doc_term_count
+     * holds the largest count of the term in any of the documents; the
+     * document-based fields are unset. The default returns infinity,
+     * which disables document-at-a-time scoring.
+     * @param sd The score_data for the query
+     */
+    virtual double score_upper_bound(const score_data& sd) const;
+
+    /**
+     * Computes an upper bound on initial_score() over all documents.
+     * @param sd The score_data for the query, with only the general info
+     * fields set
+     */
+    virtual double initial_score_upper_bound(const score_data& sd) const;
+
+    /**
+     * Describes the ranker and its parameters, so that results may be
+     * cached (see query_cache): two rankers with the same description
+     * must score every query the same. By default this is the name of the
+     * ranker's type, which suffices for rankers without parameters.
+     * @return the description
+     */
+    virtual std::string parameters() const;
+
     /**
      * Default destructor.
      */
     virtual ~ranker() = default;
 
   private:
-    /// results per doc_id
-    std::vector<double> results_;
+    /// The postings shared by the queries of a batch
+    class batch_postings;
+
+    /**
+     * Scores the query by accumulating the contributions of each query
+     * term's postings in turn.
+     * @param sd The score_data for the query
+     * @param num_results The number of results to return
+     * @param filter The filtering function for doc_ids
+     * @param stats The collection statistics to use, or nullptr to use
+     * the index's own
+     * @param shared The postings shared with other queries of a batch, or
+     * nullptr to read every postings list from the index
+     * @param first The first doc_id to score
+     * @param last One past the last doc_id to score
+     * @param budget The budget to charge the postings walked to, or
+     * nullptr for none
+     * @param seed What is known of the results, or nullptr for nothing;
+     * only its threshold is used
+     */
+    std::vector<std::pair<doc_id, double>> score_term_at_a_time(
+        score_data& sd, uint64_t num_results,
+        const std::function<bool(doc_id)>& filter,
+        const collection_stats* stats, batch_postings* shared,
+        doc_id first = doc_id{0},
+        doc_id last = doc_id{std::numeric_limits<uint64_t>::max()},
+        query_budget* budget = nullptr, const score_seed* seed = nullptr);
+
+    /**
+     * Scores the query by walking the query terms' postings in doc_id
+     * order with block-max WAND, skipping documents that cannot enter the
+     * top num_results.
+     * @param sd The score_data for the query
+     * @param num_results The number of results to return
+     * @param filter The filtering function for doc_ids
+     * @param stats The collection statistics to use, or nullptr to use
+     * the index's own
+     * @param shared The postings shared with other queries of a batch, or
+     * nullptr to read every postings list from the index
+     * @param first The first doc_id to score
+     * @param last One past the last doc_id to score
+     * @param budget The budget to charge the postings walked to, or
+     * nullptr for none
+     * @param seed What is known of the results, or nullptr for nothing
+     * @return the results, or nothing if the query terms cannot be
+     * bounded
+     */
+    util::optional<std::vector<std::pair<doc_id, double>>>
+        score_document_at_a_time(
+            score_data& sd, uint64_t num_results,
+            const std::function<bool(doc_id)>& filter,
+            const collection_stats* stats, batch_postings* shared,
+            doc_id first = doc_id{0},
+            doc_id last = doc_id{std::numeric_limits<uint64_t>::max()},
+            query_budget* budget = nullptr, const score_seed* seed = nullptr);
+};
+
+/**
+ * Scores a query with each of several rankers in a single pass over its
+ * postings, as when sweeping the parameters of a ranker. Every postings
+ * list is read and decoded once, and each block of its postings is scored
+ * by every ranker (see ranker::score_postings()) into a row of
+ * accumulators per document, one for each ranker. The query is scored
+ * term-at-a-time, so rankers that could skip documents document-at-a-time
+ * score all of them here; the scores are those score() gives.
+ * @param rankers The rankers to score with
+ * @param idx The index the rankers are operating on
+ * @param query The query, which is tokenized if it has not been
+ * @param num_results The number of results to return for each ranker
+ * @param filter A filtering function to apply to each doc_id; returns true
+ * if the document should be included in results. Deleted documents are
+ * never included, and an empty filter includes every other one.
+ * @return the results of each ranker, in the order of rankers
+ */
+std::vector<std::vector<std::pair<doc_id, double>>>
+    score_sweep(const std::vector<ranker*>& rankers, inverted_index& idx,
+                corpus::document& query, uint64_t num_results = 10,
+                const std::function<bool(doc_id d_id)>& filter = nullptr);
+
+/**
+ * Scores a prepared query with each of several rankers in a single pass
+ * over its postings, as score_sweep() scores a query, without tokenizing
+ * it or looking up its terms and their statistics again.
+ * @param rankers The rankers to score with
+ * @param idx The index the query was prepared for
+ * @param query The prepared query
+ * @param num_results The number of results to return for each ranker
+ * @param filter A filtering function to apply to each doc_id; returns true
+ * if the document should be included in results. Deleted documents are
+ * never included, and an empty filter includes every other one.
+ * @return the results of each ranker, in the order of rankers
+ */
+std::vector<std::vector<std::pair<doc_id, double>>>
+    score_sweep(const std::vector<ranker*>& rankers, inverted_index& idx,
+                const prepared_query& query, uint64_t num_results = 10,
+                const std::function<bool(doc_id d_id)>& filter = nullptr);
+
+/**
+ * Basic exception for ranker interactions.
+ */
+class ranker_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
 };
 }
 }
@@ -23,6 +23,7 @@ class document;
 namespace index
 {
 class inverted_index;
+class prepared_query;
 }
 }
 
@@ -50,6 +51,9 @@ struct score_data
     uint64_t total_terms;
     /// the current query
     const corpus::document& query;
+    /// the query's terms resolved against idx, or nullptr if they are
+    /// looked up in idx as they are scored
+    const prepared_query* prepared = nullptr;
 
     // term-based info
 
@@ -61,6 +65,9 @@ struct score_data
     uint64_t doc_count;
     /// number of times t_id appears in corpus
     uint64_t corpus_term_count;
+    /// probability of t_id in the collection language model, that is
+    /// corpus_term_count / total_terms
+    double corpus_term_prob;
 
     // document-based info
 
@@ -92,6 +99,27 @@ struct score_data
         /* nothing */
     }
 };
+
+/**
+ * The document-based info of a block of postings of one term, laid out
+ * so that a ranker can score all of them in one loop (see
+ * ranker::score_postings()).
+ */
+struct posting_block
+{
+    /// the largest number of postings in a block
+    const static constexpr uint64_t capacity = 128;
+    /// the number of postings in the block
+    uint64_t size = 0;
+    /// document ids
+    doc_id d_ids[capacity];
+    /// number of times the term appears in each doc
+    uint64_t doc_term_counts[capacity];
+    /// total number of terms in each doc
+    uint64_t doc_sizes[capacity];
+    /// number of unique terms in each doc
+    uint64_t doc_unique_terms[capacity];
+};
 }
 }
 
@@ -0,0 +1,113 @@
+/**
+ * @file search_client.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_SEARCH_CLIENT_H_
+#define META_INDEX_SEARCH_CLIENT_H_
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "index/search_protocol.h"
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * A connection to a search_server.
+ *
+ * Requests may be pipelined: send() any number of them, then receive()
+ * their responses, which come back in the order they are answered. A
+ * client is meant to be used by one thread at a time.
+ *
+ * ~~~cpp
+ * index::search_client client{"/tmp/meta.sock"};
+ * auto resp = client.search("news", {"stock prices", "election"});
+ * for (const auto& res : resp.results[0])
+ *     std::cout << res.d_id << " " << res.score << std::endl;
+ * ~~~
+ */
+class search_client
+{
+  public:
+    /**
+     * Connects to a server.
+     * @param socket_path The path of the server's socket
+     */
+    search_client(const std::string& socket_path);
+
+    /**
+     * search_client may not be copy constructed.
+     */
+    search_client(const search_client&) = delete;
+
+    /**
+     * search_client may not be copy assigned.
+     */
+    search_client& operator=(const search_client&) = delete;
+
+    /**
+     * Closes the connection.
+     */
+    ~search_client();
+
+    /**
+     * Sends a request without waiting for its response.
+     * @param req The request, whose id is replaced by a new one
+     * @return the id of the request
+     */
+    uint64_t send(protocol::request req);
+
+    /**
+     * Waits for the next response to any request sent.
+     * @return the response
+     */
+    protocol::response receive();
+
+    /**
+     * Waits for the response to a request; the responses to other
+     * requests that arrive first are kept for later calls.
+     * @param id The id of the request
+     * @return the response
+     */
+    protocol::response receive(uint64_t id);
+
+    /**
+     * Sends a batch of queries and waits for their results.
+     * @param index The name of the index to search
+     * @param queries The text of each query
+     * @param num_results The number of results to return for each query
+     * @param with_paths Whether the results should carry paths
+     * @return the response; its error is thrown as a protocol_exception
+     */
+    protocol::response search(const std::string& index,
+                              const std::vector<std::string>& queries,
+                              uint32_t num_results = 10,
+                              bool with_paths = false);
+
+  private:
+    /**
+     * Reads the next response from the socket.
+     */
+    protocol::response read_response();
+
+    /// The socket
+    int fd_;
+
+    /// The id of the next request
+    uint64_t next_id_;
+
+    /// The responses received before they were asked for, by id
+    std::unordered_map<uint64_t, protocol::response> received_;
+};
+}
+}
+
+#endif
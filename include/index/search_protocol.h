@@ -0,0 +1,145 @@
+/**
+ * @file search_protocol.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_SEARCH_PROTOCOL_H_
+#define META_INDEX_SEARCH_PROTOCOL_H_
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "meta.h"
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * The messages of the binary protocol between a search_server and its
+ * clients, over a stream socket.
+ *
+ * Every message is a frame: a 32-bit length, then that many bytes of
+ * payload. Integers are little-endian, strings are a 32-bit length and
+ * their bytes, and doubles are their IEEE 754 bits as a 64-bit integer.
+ *
+ * A request carries a batch of queries to one index, and a response the
+ * results of each of them. A client may send any number of requests
+ * before reading the responses (pipelining); the server answers each
+ * once its queries are done, so responses may arrive in a different
+ * order than the requests, and are matched to them by their ids.
+ */
+namespace protocol
+{
+
+/// The largest payload of a frame, beyond which a peer is misbehaving
+const uint32_t max_frame_bytes = 64 * 1024 * 1024;
+
+/**
+ * A batch of queries to one index.
+ */
+struct request
+{
+    /// Chosen by the client, and echoed in the response
+    uint64_t id = 0;
+    /// The name of the index to search
+    std::string index;
+    /// The number of results to return for each query
+    uint32_t num_results = 10;
+    /// Whether the results should carry the paths of their documents
+    bool with_paths = false;
+    /// The text of each query
+    std::vector<std::string> queries;
+};
+
+/**
+ * A result of a query.
+ */
+struct result
+{
+    /// The document
+    doc_id d_id;
+    /// Its score
+    double score;
+    /// Its path, if the request asked for paths
+    std::string path;
+};
+
+/**
+ * The answer to a request.
+ */
+struct response
+{
+    /// The id of the request
+    uint64_t id = 0;
+    /// Why the request failed, or empty if it succeeded
+    std::string error;
+    /// The results of each query, in the order of the request's queries
+    std::vector<std::vector<result>> results;
+};
+
+/**
+ * @param req A request
+ * @return its payload
+ */
+std::string encode(const request& req);
+
+/**
+ * @param resp A response
+ * @return its payload
+ */
+std::string encode(const response& resp);
+
+/**
+ * @param payload The payload of a request frame
+ * @return the request
+ */
+request decode_request(const std::string& payload);
+
+/**
+ * @param payload The payload of a response frame
+ * @return the response
+ */
+response decode_response(const std::string& payload);
+
+/**
+ * Writes a frame to a socket, all of it or nothing.
+ * @param fd The socket
+ * @param payload The payload of the frame
+ */
+void write_frame(int fd, const std::string& payload);
+
+/**
+ * Reads a frame from a socket.
+ * @param fd The socket
+ * @param payload Where to store the payload of the frame
+ * @return false if the peer closed the socket before the frame began
+ */
+bool read_frame(int fd, std::string& payload);
+
+/**
+ * Opens a stream socket to a Unix socket path.
+ * @param path The path of the socket
+ * @return the connected socket
+ */
+int connect_unix(const std::string& path);
+}
+
+/**
+ * Basic exception for errors of the search protocol and its sockets.
+ */
+class protocol_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
@@ -0,0 +1,205 @@
+/**
+ * @file search_server.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_SEARCH_SERVER_H_
+#define META_INDEX_SEARCH_SERVER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "index/index_handle.h"
+#include "index/inverted_index.h"
+#include "index/make_index.h"
+#include "index/search_protocol.h"
+#include "parallel/thread_pool.h"
+
+namespace cpptoml
+{
+class table;
+}
+
+namespace meta
+{
+namespace index
+{
+
+class ranker;
+
+/**
+ * A resident search server, which keeps its indexes open and answers the
+ * requests of the search protocol (see search_protocol.h) on a Unix
+ * socket, so that a query pays neither for loading an index nor for
+ * starting a process.
+ *
+ * Each connection has a thread that reads its requests and hands each to
+ * a shared pool of query threads; a response is written as soon as its
+ * request is answered, so a client that pipelines requests has them
+ * answered concurrently, and out of order. The queries of one request
+ * (a batch) are answered by one query thread, in turn, and go out in one
+ * response.
+ *
+ * Each index is held by an index_handle, so that it can be replaced by a
+ * rebuilt one while the server runs (see handle()).
+ *
+ * The server is configured by a `[server]` table, with the `socket` to
+ * listen on and the number of query `threads`, and by one
+ * `[[server-index]]` table per index, with the `name` clients use and
+ * the `config` file the index was built from, whose `[ranker]` table
+ * chooses how it is scored:
+ *
+ * ~~~toml
+ * [server]
+ * socket = "/tmp/meta.sock"
+ * threads = 8
+ *
+ * [[server-index]]
+ * name = "news"
+ * config = "news.toml"
+ * ~~~
+ */
+class search_server
+{
+  public:
+    /// The type of the indexes served
+    using index_type = dblru_inverted_index;
+
+    /// The handle each index is held by
+    using handle_type = index_handle<index_type>;
+
+    /**
+     * Opens the indexes of a configuration.
+     * @param config The configuration, as described above
+     */
+    search_server(const cpptoml::table& config);
+
+    /**
+     * Creates a server with no indexes, to which add() adds them.
+     * @param socket_path The path of the socket to listen on
+     * @param num_threads The number of query threads
+     */
+    search_server(std::string socket_path,
+                  uint64_t num_threads
+                  = std::thread::hardware_concurrency());
+
+    /**
+     * Stops the server, if it is running.
+     */
+    ~search_server();
+
+    /**
+     * Serves an index. Must be called before run().
+     * @param name The name clients search the index by
+     * @param idx The index
+     * @param rnk How the index is scored
+     */
+    void add(const std::string& name, std::shared_ptr<index_type> idx,
+             std::unique_ptr<ranker> rnk);
+
+    /**
+     * @param name The name of an index
+     * @return the handle of the index, through which it may be replaced
+     * while the server runs
+     */
+    handle_type& handle(const std::string& name);
+
+    /**
+     * Listens on the socket and answers requests until stop() is called.
+     * A file left at the socket's path by an earlier server is replaced.
+     */
+    void run();
+
+    /**
+     * Stops run() from accepting connections, closes the open ones, and
+     * waits for their requests to be answered. May be called from another
+     * thread, but not from a signal handler.
+     */
+    void stop();
+
+    /**
+     * Answers a request, as the server would over its socket.
+     * @param req The request
+     * @return the response
+     */
+    protocol::response answer(const protocol::request& req);
+
+  private:
+    /**
+     * An index being served.
+     */
+    struct served_index
+    {
+        served_index(std::shared_ptr<index_type> idx,
+                     std::unique_ptr<ranker> rnk);
+
+        /// The current version of the index
+        handle_type handle;
+        /// How the index is scored
+        std::unique_ptr<ranker> rnk;
+        /// Guards the analyzer, which is not meant to be shared between
+        /// threads, while queries are tokenized
+        std::mutex tokenize_mutex;
+    };
+
+    /**
+     * A client's connection.
+     */
+    struct connection;
+
+    /**
+     * Reads the requests of a connection until it closes.
+     * @param conn The connection
+     */
+    void serve(std::shared_ptr<connection> conn);
+
+    /// The path of the socket
+    std::string socket_path_;
+
+    /// The indexes, by name
+    std::unordered_map<std::string, std::unique_ptr<served_index>> indexes_;
+
+    /// The query threads
+    parallel::thread_pool pool_;
+
+    /// The listening socket, or -1 if the server is not running
+    std::atomic<int> listen_fd_;
+
+    /// Whether stop() has been called
+    std::atomic<bool> stopping_;
+
+    /// Guards connections_ and active_readers_
+    std::mutex connections_mutex_;
+
+    /// The open connections
+    std::vector<std::weak_ptr<connection>> connections_;
+
+    /// The number of connections whose reader is running
+    uint64_t active_readers_;
+
+    /// Signaled when the last reader is done
+    std::condition_variable readers_done_;
+};
+
+/**
+ * Basic exception for search_server interactions.
+ */
+class search_server_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
@@ -0,0 +1,382 @@
+/**
+ * @file segmented_index.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_SEGMENTED_INDEX_H_
+#define META_INDEX_SEGMENTED_INDEX_H_
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "cpptoml.h"
+#include "meta.h"
+#include "util/optional.h"
+
+namespace meta
+{
+namespace corpus
+{
+class corpus;
+class document;
+}
+
+namespace index
+{
+class inverted_index;
+class live_segment;
+class ranker;
+}
+}
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * An inverted index that grows by appending segments instead of being
+ * rebuilt. Each batch of documents added becomes a segment: a small,
+ * self-contained inverted_index with its own postings, lexicon, and
+ * metadata, stored in a subdirectory of the directory named by the
+ * "inverted-index" key of the configuration. The segments making up the
+ * index are listed, in order, in its "segments" file.
+ *
+ * The documents of each segment follow those of the segments before it,
+ * so a document's doc_id is its doc_id within its segment plus the number
+ * of documents in earlier segments. Queries are scored in every segment
+ * with the statistics of the whole index, so a document gets the same
+ * score it would get in a single index of all of the documents.
+ *
+ * Whenever "segment-merge-factor" (by default 10) consecutive segments of
+ * about the same size exist, a background thread merges them into one
+ * larger segment, so that the number of segments grows only
+ * logarithmically with the number of documents. Merging concatenates the
+ * segments' postings, leaving out those of deleted documents; it does not
+ * change any doc_ids.
+ *
+ * Documents may also be added one at a time with add_document(). They go
+ * to a live segment kept in memory, which queries see as soon as each is
+ * added, and which is written out as a disk segment (flushed) in the
+ * background once it holds "live-flush-docs" (by default 1000) documents
+ * or its oldest document is "live-flush-seconds" (by default 60; 0 for
+ * never) seconds old, as checked whenever a document is added, or when
+ * flush() is called. The live documents follow those of the disk
+ * segments. Until they are flushed, they are only in memory, and are lost
+ * if the process ends without flushing.
+ */
+class segmented_index
+{
+  public:
+    /**
+     * Opens the segmented index, creating an empty one if it does not
+     * exist.
+     * @param config_file The configuration for the index; every segment is
+     * built with its analyzers and options
+     */
+    segmented_index(const std::string& config_file);
+
+    /**
+     * Waits for any background flush or merge to finish. Documents still
+     * in the live segment are not flushed.
+     */
+    ~segmented_index();
+
+    /**
+     * segmented_index may not be copied.
+     */
+    segmented_index(const segmented_index&) = delete;
+
+    /**
+     * segmented_index may not be assigned.
+     */
+    segmented_index& operator=(const segmented_index&) = delete;
+
+    /**
+     * Indexes a batch of documents as a new segment, which is searchable
+     * as soon as this returns. Only the new documents are tokenized.
+     * @param docs The documents to add
+     */
+    void add_segment(corpus::corpus& docs);
+
+    /**
+     * Adds one document to the live segment, where it is searchable as
+     * soon as this returns, flushing the live segment in the background if
+     * it is due. The document is analyzed with the configuration's
+     * analyzer.
+     * @param doc The document, holding its content or the path to it
+     * @return the doc_id of the document
+     */
+    doc_id add_document(const corpus::document& doc);
+
+    /**
+     * Writes the live documents to a new disk segment, waiting for it (and
+     * for any background flush) to finish. Their doc_ids do not change.
+     */
+    void flush();
+
+    /**
+     * @return the number of documents that are only in memory
+     */
+    uint64_t num_live_docs() const;
+
+    /**
+     * Deletes a document from the segment that holds it. The document is
+     * no longer returned by score(), and its postings are dropped when its
+     * segment is next merged.
+     * @param d_id The document to delete
+     */
+    void delete_doc(doc_id d_id);
+
+    /**
+     * @param d_id The document to check
+     * @return whether the document has been deleted
+     */
+    bool is_deleted(doc_id d_id) const;
+
+    /**
+     * @return the number of deleted documents
+     */
+    uint64_t num_deleted() const;
+
+    /**
+     * Waits until no segments are being merged, rethrowing the exception
+     * of a merge that failed.
+     */
+    void wait_for_merges();
+
+    /**
+     * @return the number of segments on disk
+     */
+    uint64_t num_segments() const;
+
+    /**
+     * @param idx The position of the segment
+     * @return the inverted_index of the segment
+     */
+    std::shared_ptr<inverted_index> segment(uint64_t idx) const;
+
+    /**
+     * @return the number of documents in the index
+     */
+    uint64_t num_docs() const;
+
+    /**
+     * @param d_id The document to look up
+     * @return the path of the document
+     */
+    std::string doc_path(doc_id d_id) const;
+
+    /**
+     * @param d_id The document to look up
+     * @return the number of terms in the document
+     */
+    uint64_t doc_size(doc_id d_id) const;
+
+    /**
+     * @param d_id The document to look up
+     * @return the label of the document
+     */
+    class_label label(doc_id d_id) const;
+
+    /**
+     * Scores a query against every segment.
+     * @param r The ranker to score with
+     * @param query The query
+     * @param num_results The number of results to return
+     * @param filter A filtering function to apply to each doc_id; returns
+     * true if the document should be included in results. Deleted
+     * documents are never included, and an empty filter includes every
+     * other one.
+     * @return the results, sorted by decreasing score
+     */
+    std::vector<std::pair<doc_id, double>>
+        score(ranker& r, corpus::document& query, uint64_t num_results = 10,
+              const std::function<bool(doc_id d_id)>& filter = nullptr);
+
+    /**
+     * Basic exception for segmented_index interactions.
+     */
+    class segmented_index_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /**
+     * A segment of the index.
+     */
+    struct segment_info
+    {
+        /// the name of the segment's directory
+        std::string name;
+        /// the segment's index
+        std::shared_ptr<inverted_index> index;
+        /// the doc_id, in the whole index, of the segment's first document
+        uint64_t first_doc;
+    };
+
+    /// The segments of the index, in order
+    using segment_list = std::vector<segment_info>;
+
+    /**
+     * @return the current list of segments; it will not change, even if
+     * segments are added or merged while it is in use
+     */
+    std::shared_ptr<const segment_list> snapshot() const;
+
+    /**
+     * Makes a list of segments current and saves it. The caller must hold
+     * mutex_.
+     * @param segments The new list of segments
+     */
+    void install(segment_list segments);
+
+    /**
+     * @param name The name of a segment
+     * @return an (unloaded) inverted_index for the segment
+     */
+    std::shared_ptr<inverted_index> make_segment(const std::string& name) const;
+
+    /**
+     * @return a name for a new segment. The caller must hold mutex_.
+     */
+    std::string next_name();
+
+    /**
+     * @param segments A list of segments
+     * @return the range [first, last) of consecutive segments that should
+     * be merged, if any
+     */
+    util::optional<std::pair<uint64_t, uint64_t>>
+        find_merge(const segment_list& segments) const;
+
+    /**
+     * Starts merging in the background if the merge policy calls for it
+     * and no merge is running. The caller must hold mutex_.
+     */
+    void schedule_merges();
+
+    /**
+     * Merges segments until the merge policy is satisfied.
+     */
+    void run_merges();
+
+    /**
+     * A live segment and the doc_id, in the whole index, of its first
+     * document.
+     */
+    using live_info = std::pair<std::shared_ptr<live_segment>, uint64_t>;
+
+    /**
+     * @return the live segments, the one being flushed (if any) first.
+     * The caller must hold mutex_.
+     */
+    std::vector<live_info> live_segments() const;
+
+    /**
+     * @param d_id A doc_id in the whole index
+     * @return the live segment holding the document and the document's
+     * doc_id within it, or a null segment if the document is on disk. The
+     * caller must hold mutex_.
+     */
+    std::pair<std::shared_ptr<live_segment>, doc_id>
+        locate_live(doc_id d_id) const;
+
+    /**
+     * Moves the live documents to a new disk segment.
+     */
+    void flush_live();
+
+    /**
+     * Starts flushing in the background if the live segment is due and no
+     * flush is running. The caller must hold mutex_.
+     */
+    void schedule_flush();
+
+    /**
+     * @param d_id A doc_id in the whole index
+     * @return the segment holding the document and the document's doc_id
+     * within it
+     */
+    std::pair<std::shared_ptr<inverted_index>, doc_id>
+        locate(doc_id d_id) const;
+
+    /**
+     * @param segments A list of segments
+     * @param d_id A doc_id in the whole index
+     * @return the segment holding the document
+     */
+    static const segment_info& locate(const segment_list& segments,
+                                      doc_id d_id);
+
+    /// The configuration every segment is built with
+    cpptoml::table config_;
+
+    /// The directory of the index
+    std::string name_;
+
+    /// The copy of the configuration kept in the index directory
+    std::string config_file_;
+
+    /// The number of similarly sized segments that are merged together
+    uint64_t merge_factor_;
+
+    /// The number used to name the next segment
+    uint64_t next_segment_;
+
+    /// The current segments
+    std::shared_ptr<const segment_list> segments_;
+
+    /// Whether a background merge is running
+    bool merging_;
+
+    /// The result of the most recent background merge
+    std::future<void> merges_;
+
+    /// The live segment documents are added to
+    std::shared_ptr<live_segment> live_;
+
+    /// The live segment being flushed, if any
+    std::shared_ptr<live_segment> flushing_;
+
+    /// When the first document of live_ was added
+    std::chrono::steady_clock::time_point live_since_;
+
+    /// The number of live documents that starts a flush
+    uint64_t flush_docs_;
+
+    /// The age of the oldest live document that starts a flush
+    std::chrono::seconds flush_interval_;
+
+    /// Whether a background flush is running
+    bool flush_running_;
+
+    /// The result of the most recent background flush
+    std::future<void> flushes_;
+
+    /// Keeps documents from being added while live_ is replaced
+    std::mutex ingest_mutex_;
+
+    /// Lets one flush run at a time
+    std::mutex flush_mutex_;
+
+    /// Protects the segments, the live segments, and the merge and flush
+    /// state
+    mutable std::mutex mutex_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,238 @@
+/**
+ * @file sharded_index.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_SHARDED_INDEX_H_
+#define META_INDEX_SHARDED_INDEX_H_
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "meta.h"
+#include "parallel/thread_pool.h"
+
+namespace meta
+{
+namespace corpus
+{
+class document;
+}
+
+namespace index
+{
+class inverted_index;
+class ranker;
+struct collection_stats;
+}
+}
+
+namespace meta
+{
+namespace index
+{
+
+/**
+ * One document partition of a sharded_index. A shard answers the
+ * questions a sharded_index needs to score a query: its share of the
+ * collection statistics, and its best documents for a query scored with
+ * the statistics of the whole collection.
+ *
+ * local_shard serves an inverted_index in this process; a shard served by
+ * another process implements the same interface by forwarding each call.
+ * Every method may be called from several threads at once.
+ */
+class shard
+{
+  public:
+    /**
+     * Default destructor.
+     */
+    virtual ~shard() = default;
+
+    /**
+     * @return the number of documents in the shard
+     */
+    virtual uint64_t num_docs() const = 0;
+
+    /**
+     * @return the number of term occurrences in the shard
+     */
+    virtual uint64_t total_corpus_terms() const = 0;
+
+    /**
+     * @param terms Some terms
+     * @return the number of documents each term appears in and its total
+     * number of occurrences, in the order of terms
+     */
+    virtual std::vector<std::pair<uint64_t, uint64_t>>
+        term_stats(const std::vector<std::string>& terms) = 0;
+
+    /**
+     * @param r The ranker to score with
+     * @param query The query, already tokenized
+     * @param stats The statistics of the whole collection
+     * @param num_results The number of results to return
+     * @return the shard's best documents, with doc_ids local to the shard,
+     * sorted by decreasing score
+     */
+    virtual std::vector<std::pair<doc_id, double>>
+        search(ranker& r, const corpus::document& query,
+               const collection_stats& stats, uint64_t num_results) = 0;
+
+    /**
+     * @param d_id A doc_id local to the shard
+     * @return the path of the document
+     */
+    virtual std::string doc_path(doc_id d_id) const = 0;
+
+    /**
+     * @param d_id A doc_id local to the shard
+     * @return the label of the document
+     */
+    virtual class_label label(doc_id d_id) const = 0;
+};
+
+/**
+ * A shard backed by an inverted_index in this process.
+ */
+class local_shard : public shard
+{
+  public:
+    /**
+     * @param idx The index to serve
+     */
+    local_shard(std::shared_ptr<inverted_index> idx);
+
+    uint64_t num_docs() const override;
+    uint64_t total_corpus_terms() const override;
+    std::vector<std::pair<uint64_t, uint64_t>>
+        term_stats(const std::vector<std::string>& terms) override;
+    std::vector<std::pair<doc_id, double>>
+        search(ranker& r, const corpus::document& query,
+               const collection_stats& stats,
+               uint64_t num_results) override;
+    std::string doc_path(doc_id d_id) const override;
+    class_label label(doc_id d_id) const override;
+
+    /**
+     * @return the index served by this shard
+     */
+    inverted_index& index();
+
+  private:
+    /// The index served by this shard
+    std::shared_ptr<inverted_index> idx_;
+};
+
+/**
+ * A document-partitioned index: each shard holds a disjoint set of the
+ * documents. The documents of each shard follow those of the shards
+ * before it, so a document's doc_id is its doc_id within its shard plus
+ * the number of documents in earlier shards.
+ *
+ * A query is answered in two rounds sent to every shard at once: the
+ * first gathers each shard's statistics for the query terms, and the
+ * second asks each shard for its top documents scored with the sums of
+ * those statistics. The shards' lists are then merged, so the results
+ * match those of a single index of all of the documents.
+ */
+class sharded_index
+{
+  public:
+    /**
+     * @param shards The shards, in doc_id order
+     * @param num_threads The number of threads used to query the shards
+     */
+    sharded_index(std::vector<std::unique_ptr<shard>> shards,
+                  uint64_t num_threads
+                  = std::thread::hardware_concurrency());
+
+    /**
+     * Opens the shards listed in a configuration file. Each entry of its
+     * [[shards]] table array names the configuration of an inverted index
+     * with its "config" key.
+     * @param config_file The configuration file
+     * @return the sharded index
+     */
+    static std::unique_ptr<sharded_index> load(const std::string& config_file);
+
+    /**
+     * @return the number of shards
+     */
+    uint64_t num_shards() const;
+
+    /**
+     * @param idx The position of the shard
+     * @return the shard
+     */
+    shard& get_shard(uint64_t idx);
+
+    /**
+     * @return the number of documents in the index
+     */
+    uint64_t num_docs() const;
+
+    /**
+     * @param d_id The document to look up
+     * @return the path of the document
+     */
+    std::string doc_path(doc_id d_id) const;
+
+    /**
+     * @param d_id The document to look up
+     * @return the label of the document
+     */
+    class_label label(doc_id d_id) const;
+
+    /**
+     * Scores a query against every shard. The query is tokenized with the
+     * analyzer of the first local shard if it has not been already. Unlike
+     * ranker::score, the results are not padded with documents that match
+     * no query terms.
+     * @param r The ranker to score with
+     * @param query The query
+     * @param num_results The number of results to return
+     * @return the results, sorted by decreasing score
+     */
+    std::vector<std::pair<doc_id, double>>
+        score(ranker& r, corpus::document& query, uint64_t num_results = 10);
+
+    /**
+     * Basic exception for sharded_index interactions.
+     */
+    class sharded_index_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /**
+     * @param d_id A doc_id in the whole index
+     * @return the position of the shard holding the document
+     */
+    uint64_t locate(doc_id d_id) const;
+
+    /// The shards, in doc_id order
+    std::vector<std::unique_ptr<shard>> shards_;
+
+    /// The doc_id of the first document of each shard
+    std::vector<uint64_t> first_docs_;
+
+    /// The number of documents in the index
+    uint64_t num_docs_;
+
+    /// The threads that query the shards
+    parallel::thread_pool pool_;
+};
+}
+}
+
+#endif
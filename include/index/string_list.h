@@ -12,8 +12,11 @@
 
 #include <string>
 
+#include <stdexcept>
+
 #include "io/mmap_file.h"
 #include "util/disk_vector.h"
+#include "util/optional.h"
 
 namespace meta
 {
@@ -25,6 +28,10 @@ namespace index
  * persisted to disk. This class provides read-only
  * access---string_list_writer provides write-only access and is to be used
  * for building the string list and associated index this class reads.
+ *
+ * The strings are front coded in blocks, and only the position of each
+ * block is indexed, so a lookup decodes the strings of one block up to the
+ * one requested.
  */
 class string_list
 {
@@ -49,18 +56,33 @@ class string_list
      * @param idx
      * @return the string at a given index.
      */
-    const char* at(uint64_t idx) const;
+    std::string at(uint64_t idx) const;
 
     /**
      * @return the number of strings in the list.
      */
     uint64_t size() const;
 
+    /**
+     * @return the memory used by the list
+     */
+    util::memory_usage memory_usage() const;
+
+    /**
+     * Basic exception for string_list interactions.
+     */
+    class string_list_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
   private:
-    /// The file containing the strings.
-    io::mmap_file string_file_;
+    /// The file containing the strings; empty if there are none.
+    util::optional<io::mmap_file> string_file_;
 
-    /// An index that gives the starting byte for each index.
+    /// The number of strings, the number of strings per block, and the
+    /// starting byte of each block.
     util::disk_vector<uint64_t> index_;
 };
 }
@@ -13,14 +13,13 @@
 #include <fstream>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #if !META_HAS_STREAM_MOVE
 #include <memory>
 #include "util/shim.h"
 #endif
 
-#include "util/disk_vector.h"
-
 namespace meta
 {
 namespace index
@@ -30,6 +29,17 @@ namespace index
  * A class for writing large lists of strings to disk with an associated
  * index file for fast random access. This class is used for writing the
  * output format read by the string_list class.
+ *
+ * The strings are front coded (see io::front_coding) in blocks of
+ * block_size strings, in index order, since neighbouring strings such as
+ * the paths of documents from the same directory tend to share long
+ * prefixes. The index file is a disk-persisted vector: the number of
+ * strings, the block size, and the byte position of each block.
+ *
+ * Strings may be inserted in any order, so they are first staged
+ * uncompressed in a temporary file next to the string file; the
+ * compressed list is written when the writer is destroyed. A string that
+ * is never inserted is empty.
  */
 class string_list_writer
 {
@@ -40,8 +50,10 @@ class string_list_writer
      *
      * @param path The path to write the string file to.
      * @param size The number of strings in the list (must be known)
+     * @param block_size The number of strings in each front-coded block
      */
-    string_list_writer(const std::string& path, uint64_t size);
+    string_list_writer(const std::string& path, uint64_t size,
+                       uint64_t block_size = 16);
 
     /**
      * May be move constructed.
@@ -53,6 +65,11 @@ class string_list_writer
      */
     string_list_writer& operator=(string_list_writer&&);
 
+    /**
+     * Writes the compressed string list and its index.
+     */
+    ~string_list_writer();
+
     /**
      * Sets the string at idx to be elem.
      * @param idx
@@ -60,6 +77,13 @@ class string_list_writer
      */
     void insert(uint64_t idx, const std::string& elem);
 
+    /**
+     * Writes the compressed string list and its index now, rather than
+     * when the writer is destroyed, so that it may be done on another
+     * thread. No strings may be inserted afterwards.
+     */
+    void close();
+
   private:
 #if META_HAS_STREAM_MOVE
     using ofstream = std::ofstream;
@@ -91,17 +115,30 @@ class string_list_writer
     }
 #endif
 
+    /**
+     * Front codes the staged strings into the string file and writes the
+     * index file.
+     */
+    void compress();
+
     /// Writes are internally synchronized
     std::mutex mutex_;
 
-    /// The file containing the strings
+    /// The path to the string file; empty if moved from
+    std::string path_;
+
+    /// The file the strings are staged in
     ofstream string_file_;
 
-    /// Keeps track of the write position
+    /// Keeps track of the write position in the staging file
     uint64_t write_pos_;
 
-    /// Index vector---stores byte positions
-    util::disk_vector<uint64_t> index_;
+    /// The number of strings in each block
+    uint64_t block_size_;
+
+    /// The position of each string in the staging file, plus one; zero
+    /// for strings that have not been inserted
+    std::vector<uint64_t> positions_;
 };
 }
 }
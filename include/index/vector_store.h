@@ -0,0 +1,280 @@
+/**
+ * @file vector_store.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_INDEX_VECTOR_STORE_H_
+#define META_INDEX_VECTOR_STORE_H_
+
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "meta.h"
+#include "util/disk_vector.h"
+#include "util/memory_usage.h"
+#include "util/optional.h"
+
+namespace meta
+{
+
+namespace parallel
+{
+class thread_pool;
+}
+
+namespace index
+{
+
+/**
+ * How the elements of stored vectors are kept.
+ */
+enum class vector_encoding
+{
+    /// As 32-bit floats
+    float32,
+    /// As 8-bit integers, with a scale per vector: a quarter of the space
+    /// of float32, at the cost of a relative error of about 1/254 in each
+    /// element
+    int8
+};
+
+/**
+ * Writes dense vectors of an index's documents, such as embeddings
+ * computed offline, into a directory read by vector_store. Vectors may be
+ * inserted from several threads at once, for different documents, and in
+ * any order of documents; documents without one have none in the store.
+ */
+class vector_store_writer
+{
+  public:
+    /**
+     * @param dir The directory to write the vectors to
+     * @param num_docs The number of documents in the index
+     * @param dims The number of elements of every vector
+     * @param encoding How the elements are stored
+     */
+    vector_store_writer(const std::string& dir, uint64_t num_docs,
+                        uint64_t dims, vector_encoding encoding);
+
+    /**
+     * Sets the vector of a document. A vector of zeros is the same as no
+     * vector.
+     * @param d_id The document
+     * @param vec The vector, with as many elements as the store's
+     */
+    void insert(doc_id d_id, const std::vector<float>& vec);
+
+  private:
+    /// The number of elements of every vector
+    uint64_t dims_;
+
+    /// How the elements are stored
+    vector_encoding encoding_;
+
+    /// The float32 vectors, a row of dims_ elements per document
+    util::optional<util::disk_vector<float>> floats_;
+
+    /// The int8 vectors, a row of dims_ elements per document
+    util::optional<util::disk_vector<int8_t>> bytes_;
+
+    /// The scale of each int8 vector
+    util::optional<util::disk_vector<float>> scales_;
+
+    /// The Euclidean norm of each vector, zero for documents without one
+    util::disk_vector<float> norms_;
+};
+
+/**
+ * Read-only access to the dense vectors of an index's documents, memory
+ * mapped so that the store may be larger than memory. Documents are
+ * scored by the inner product of their vector with a query vector, which
+ * for unit vectors is their cosine similarity.
+ *
+ * The inner products are computed with AVX2 where the build targets it
+ * (float32 elements through the vectorized util::dense::dot, and int8
+ * elements widened to floats eight at a time) and with plain loops
+ * otherwise. Queries stay in floats against int8 vectors, so only the
+ * stored side is quantized.
+ */
+class vector_store
+{
+  public:
+    /**
+     * A predicate on documents, as taken by the rankers' filters.
+     */
+    using filter_type = std::function<bool(doc_id)>;
+
+    /**
+     * @param dir The directory written by a vector_store_writer
+     */
+    vector_store(const std::string& dir);
+
+    /**
+     * vector_store may be move constructed.
+     */
+    vector_store(vector_store&&) = default;
+
+    /**
+     * vector_store may be move assigned.
+     */
+    vector_store& operator=(vector_store&&) = default;
+
+    /**
+     * @return the number of elements of every vector
+     */
+    uint64_t dims() const;
+
+    /**
+     * @return the number of documents of the index, with or without a
+     * vector
+     */
+    uint64_t size() const;
+
+    /**
+     * @return how the elements are stored
+     */
+    vector_encoding encoding() const;
+
+    /**
+     * @param d_id A document
+     * @return whether the document has a vector
+     */
+    bool contains(doc_id d_id) const;
+
+    /**
+     * @param d_id A document
+     * @return the document's vector, decoded to floats; zeros if it has
+     * none
+     */
+    std::vector<float> vector(doc_id d_id) const;
+
+    /**
+     * Decodes a document's vector into a buffer.
+     * @param d_id A document
+     * @param out Where to write the dims() elements of the vector
+     */
+    void decode(doc_id d_id, float* out) const;
+
+    /**
+     * @param query A vector of dims() elements
+     * @param d_id A document
+     * @return the inner product of the query and the document's vector
+     */
+    float score(const float* query, doc_id d_id) const;
+
+    /**
+     * Scores every document with a vector against a query, keeping the
+     * best ones.
+     * @param query The query vector
+     * @param k The number of documents to return
+     * @param filter A filtering function to apply to each doc_id; returns
+     * true if the document should be included in results. An empty
+     * filter includes every document.
+     * @return at most k documents and their scores, best first
+     */
+    std::vector<std::pair<doc_id, double>>
+        search(const std::vector<float>& query, uint64_t k,
+               const filter_type& filter = nullptr) const;
+
+    /**
+     * Scores every document with a vector against a query on a pool of
+     * threads, each of which keeps the best documents of the ranges of
+     * doc_ids it claims.
+     * @param query The query vector
+     * @param k The number of documents to return
+     * @param pool The threads to score on
+     * @param filter A filtering function to apply to each doc_id; returns
+     * true if the document should be included in results. An empty
+     * filter includes every document.
+     * @return the same documents as the other overload, up to the order
+     * of documents with equal scores
+     */
+    std::vector<std::pair<doc_id, double>>
+        search(const std::vector<float>& query, uint64_t k,
+               parallel::thread_pool& pool,
+               const filter_type& filter = nullptr) const;
+
+    /**
+     * @return the memory used by the mapped vectors
+     */
+    util::memory_report memory_usage() const;
+
+    /**
+     * Throws unless a query has as many elements as the store's vectors.
+     * @param query The query vector
+     */
+    void check(const std::vector<float>& query) const;
+
+  private:
+    /**
+     * Scores a range of documents against a query.
+     * @param query The query vector
+     * @param first The first document to score
+     * @param last One past the last document to score
+     * @param filter The filter on documents
+     * @param best Called with each document and its score
+     */
+    template <class Function>
+    void scan(const float* query, uint64_t first, uint64_t last,
+              const filter_type& filter, Function&& best) const;
+
+    /// The number of elements of every vector
+    uint64_t dims_;
+
+    /// How the elements are stored
+    vector_encoding encoding_;
+
+    /// The float32 vectors, a row of dims_ elements per document
+    util::optional<util::disk_vector<float>> floats_;
+
+    /// The int8 vectors, a row of dims_ elements per document
+    util::optional<util::disk_vector<int8_t>> bytes_;
+
+    /// The scale of each int8 vector
+    util::optional<util::disk_vector<float>> scales_;
+
+    /// The Euclidean norm of each vector, zero for documents without one
+    util::disk_vector<float> norms_;
+};
+
+/**
+ * Basic exception for vector_store interactions.
+ */
+class vector_store_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+namespace internal
+{
+/**
+ * The dot product that scores the vectors of an int8 store: with AVX2
+ * when the library is compiled for it, and dot_int8_scalar() otherwise.
+ * @param query A vector of floats
+ * @param x A vector of 8-bit integers
+ * @param size The length of the vectors
+ * @return the dot product of the vectors
+ */
+float dot_int8(const float* query, const int8_t* x, uint64_t size);
+
+/**
+ * The dot product of dot_int8() without vector instructions, which is
+ * also built when AVX2 is, so the two can be compared.
+ * @param query A vector of floats
+ * @param x A vector of 8-bit integers
+ * @param size The length of the vectors
+ * @return the dot product of the vectors
+ */
+float dot_int8_scalar(const float* query, const int8_t* x, uint64_t size);
+}
+}
+}
+
+#endif
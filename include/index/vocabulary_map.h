@@ -10,17 +10,15 @@
 #ifndef META_VOCABULARY_MAP_H_
 #define META_VOCABULARY_MAP_H_
 
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
 #include "io/mmap_file.h"
 #include "util/disk_vector.h"
-
-namespace meta
-{
-namespace util
-{
-template <class>
-class optional;
-}
-}
+#include "util/optional.h"
 
 namespace meta
 {
@@ -28,61 +26,62 @@ namespace index
 {
 
 /**
- * A read-only view of a B+-tree-like structure that stores the vocabulary
- * for an index. It reads the file format that is written by the
- * vocabulary_map_writer class (see the documentation for the writer for
- * information about the file format).
+ * A read-only view of the front-coded sorted array that stores the
+ * vocabulary for an index. It reads the file format that is written by
+ * the vocabulary_map_writer class (see the documentation for the writer
+ * for information about the file format).
+ *
+ * Since term ids are assigned in sorted order, the terms sharing a prefix
+ * or falling in a range of strings have consecutive ids, which makes
+ * prefix and range lookups (for autocompletion and wildcard queries) as
+ * cheap as exact ones.
  */
 class vocabulary_map
 {
   private:
     /**
-     * The file containing the tree. mmapped for performance.
+     * The file containing the terms. mmapped for performance; empty if the
+     * map has no terms.
      */
-    io::mmap_file file_;
+    util::optional<io::mmap_file> file_;
 
     /**
-     * Byte positions for each term in the leaves to allow for reverse
-     * lookup of a the string associated with a given id.
+     * The number of terms, the number of terms per block, and the
+     * positions of each block and of its first term in file_.
      */
-    util::disk_vector<uint64_t> inverse_;
+    util::disk_vector<uint64_t> index_;
 
     /**
-     * The size of the nodes in the tree.
+     * The number of terms in the map.
      */
-    uint64_t block_size_;
+    uint64_t num_terms_;
 
     /**
-     * The ending position of the leaf nodes. Used to determine when to
-     * stop a search.
+     * The number of terms in each block.
      */
-    uint64_t leaf_end_pos_;
+    uint64_t block_terms_;
 
     /**
-     * The position of the first internal node that is not the root. Used
-     * to seek to the first level during search.
+     * @param block A block of the map
+     * @return the first term of the block
      */
-    uint64_t initial_seek_pos_;
+    const char* head(uint64_t block) const;
 
     /**
-     * Convenience wrapper for comparing the term with strings in the tree.
-     * @param term  the term we are looking for
-     * @param other the string in the tree we are considering
+     * @param term A term
+     * @param first The first block to consider
+     * @return the last block whose first term is not larger than the
+     * term, or the first block considered if there is none
      */
-    int compare(const std::string& term, const char* other) const;
+    uint64_t find_block(const std::string& term, uint64_t first = 0) const;
 
   public:
     /**
-     * Creates a vocabulary map reading the file in the given path with
-     * the given block size. Changing the block size is not
-     * recommended---the block size used should always be the same as the
-     * block size used in the vocabulary_map_writer used to create the
-     * tree.
+     * Creates a vocabulary map reading the files at the given path.
      *
-     * @param path the location of the tree file
-     * @param block_size the size of the nodes in the tree
+     * @param path the location of the terms file
      */
-    vocabulary_map(const std::string& path, uint16_t block_size = 4096);
+    vocabulary_map(const std::string& path);
 
     /**
      * Move constructs a vocabulary_map.
@@ -95,11 +94,22 @@ class vocabulary_map
     vocabulary_map& operator=(vocabulary_map&&) = default;
 
     /**
-     * Finds the given term in the tree, if it exists.
+     * Finds the given term in the map, if it exists. This binary searches
+     * the first terms of the blocks and then decodes one block.
      * @param term the term to find an id for
      */
     util::optional<term_id> find(const std::string& term) const;
 
+    /**
+     * Finds many terms in the map at once. The terms are sorted and then
+     * resolved in one ordered pass, so each block is searched for and
+     * decoded at most once no matter how many of the terms it holds.
+     * @param terms the terms to find ids for
+     * @return the id of each term, in the order of the terms given
+     */
+    std::vector<util::optional<term_id>>
+        find_all(const std::vector<std::string>& terms) const;
+
     /**
      * Finds the term associated with the given id. No bounds checking is
      * performed---accessing beyond the maximum assigned term_id is
@@ -113,6 +123,75 @@ class vocabulary_map
      * The number of terms in the map.
      */
     uint64_t size() const;
+
+    /**
+     * @return the memory used by the map
+     */
+    util::memory_usage memory_usage() const;
+
+    /**
+     * @param term A string
+     * @return the id of the first term that is not less than the string,
+     * or size() if there is none
+     */
+    term_id lower_bound(const std::string& term) const;
+
+    /**
+     * @param lower The smallest string in the range
+     * @param upper The string just past the range
+     * @return the ids [first, last) of the terms in [lower, upper)
+     */
+    std::pair<term_id, term_id> range(const std::string& lower,
+                                      const std::string& upper) const;
+
+    /**
+     * @param prefix A prefix
+     * @return the ids [first, last) of the terms that start with the
+     * prefix
+     */
+    std::pair<term_id, term_id> prefix_range(const std::string& prefix) const;
+
+    /**
+     * Calls a function with each term in a range of ids, in order, decoding
+     * each block once.
+     * @param first The first id of the range
+     * @param last The id just past the range
+     * @param fn The function to call with each id and its term
+     */
+    void for_each(term_id first, term_id last,
+                  const std::function<void(term_id, const std::string&)>& fn)
+        const;
+
+    /**
+     * Finds the terms matching a wildcard pattern, in which '*' matches any
+     * sequence of characters and '?' matches any one character. Only the
+     * terms sharing the pattern's leading literal characters are examined.
+     * @param pattern The pattern to match
+     * @return the ids of the matching terms, in order
+     */
+    std::vector<term_id> wildcard(const std::string& pattern) const;
+
+    /**
+     * Finds the terms within an edit distance of a string. Every term is
+     * examined, but the edit distance computation is shared between terms
+     * with a common prefix and abandoned for prefixes that are already too
+     * far from the string.
+     * @param term The string to match
+     * @param max_edits The largest number of insertions, deletions, and
+     * substitutions of single characters allowed
+     * @return the ids of the matching terms, in order
+     */
+    std::vector<term_id> fuzzy(const std::string& term,
+                               uint64_t max_edits) const;
+
+    /**
+     * Basic exception for vocabulary_map interactions.
+     */
+    class vocabulary_map_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
 };
 }
 }
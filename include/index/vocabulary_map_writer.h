@@ -12,8 +12,12 @@
 
 #include <cstdint>
 #include <fstream>
+#include <future>
 #include <stdexcept>
 #include <string>
+#include <vector>
+
+#include "parallel/bounded_queue.h"
 
 namespace meta
 {
@@ -21,31 +25,26 @@ namespace index
 {
 
 /**
- * A class that writes the B+-tree-like data structure used for storing
- * the term id mapping in an index. This class provides a write-only view
- * of the mapping.
- *
- * The file format consists of two files: one for the "forward" mapping and
- * one for the "backward" mapping.
+ * A class that writes the front-coded sorted array used for storing the
+ * term id mapping in an index. This class provides a write-only view of
+ * the mapping. Terms must be inserted in increasing (byte-wise) order, and
+ * each term's id is its position in that order.
  *
- * The "forward" mapping is a structure like a B+-tree, with the exception
- * that each node has a fixed size instead of there always being a fixed
- * number of elements. This is necessary due to the size of the keys being
- * unknown ahead of time; this also allows for some gains in space
- * utilization as we do not pad the keys to be a fixed maximum length.
- * However, the nodes are always block_size bytes large and will be padded
- * with null bytes when needed.
+ * The file format consists of two files: the terms themselves, and an
+ * index into them.
  *
- * Each internal node is a sorted list of strings and byte
- * positions---depending on the string comparison, the search will pick the
- * appropriate byte position and seek there, recursively. The leaf nodes
- * are a sorted list of strings and id assignments. The search linearly
- * scans the leaf node it arrives at for the term in question.
+ * The terms file holds the terms in blocks of block_terms terms. Within a
+ * block, each term is stored as the length of the prefix it shares with
+ * the term before it, the length of the rest of the term, and the rest of
+ * the term, with both lengths as variable byte codes; the first term of a
+ * block shares no prefix, so that any block can be decoded on its own.
+ * After the last block, the first term of every block is stored again,
+ * null terminated, so that the block holding a term can be found by a
+ * binary search over a small, contiguous region of the file.
  *
- * The "backward" mapping is simply a disk-persisted vector of byte
- * positions, indexed by the term id. Reading a string from the forward
- * mapping's file starting at the given byte position will yield the string
- * for that id.
+ * The index file is a disk-persisted vector: the number of terms, the
+ * number of terms per block, and then, for each block, the byte position
+ * of the block and of its first term in the terms file.
  *
  * The mappings created are non-portable and depend on the endianness of
  * the system building them. This may be changed in the future.
@@ -58,80 +57,125 @@ class vocabulary_map_writer
 {
   public:
     /**
-     * Creates a writer for a tree at the given path and block_size.
-     * Changing the block size is not recommended---if doing so, ensure
-     * that any and all vocabulary_maps created for the written file are
-     * also created with the same modified block size.
+     * Creates a writer for a mapping at the given path.
      *
-     * @param path the path to the tree file tow rite
-     * @param block_size the size of the nodes in the tree
+     * @param path the path to the terms file to write
+     * @param block_terms the number of terms in each front-coded block;
+     * larger blocks make the file smaller and lookups slower
      */
-    vocabulary_map_writer(const std::string& path, uint16_t block_size = 4096);
+    vocabulary_map_writer(const std::string& path, uint64_t block_terms = 16);
 
     /**
-     * The destructor for a vocabulary_map_writer flushes the last leaf
-     * node and builds the internal structure---as such, it may block for
-     * a period of time while finalizing the tree structure. This may be
-     * changed in the future.
+     * The destructor for a vocabulary_map_writer writes the first terms of
+     * the blocks and the index file.
      */
     ~vocabulary_map_writer();
 
     /**
-     * Inserts this term into the map. No checking is done for duplicate
-     * terms or that the ordering is indeed lexicographically sorted, but
-     * these invariants are important to maintain for the tree to work
-     * properly.
-     *
-     * @param term the term to insert
+     * Inserts this term into the map.
+     * @param term the term to insert; it must be larger than every term
+     * inserted before it
      */
     void insert(const std::string& term);
 
     /**
-     * An exception that can be thrown during the building of the tree.
+     * An exception that can be thrown during the building of the map.
      */
     class vocabulary_map_writer_exception : public std::runtime_error
     {
+      public:
         using std::runtime_error::runtime_error;
     };
 
   private:
+    /// The file containing the terms.
+    std::ofstream file_;
+
+    /// The path to the terms file
+    std::string path_;
+
+    /// The number of terms in each block
+    uint64_t block_terms_;
+
+    /// The total number of terms inserted so far
+    uint64_t num_terms_;
+
+    /// The number of bytes written to the terms file so far (can't use
+    /// fstream tell functions because the file may be larger than 2GB)
+    uint64_t file_write_pos_;
+
+    /// The term inserted last
+    std::string previous_;
+
+    /// The byte position of each block in the terms file
+    std::vector<uint64_t> block_positions_;
+
+    /// The first term of each block, each null terminated
+    std::string heads_;
+};
+
+/**
+ * Writes a vocabulary map on a thread of its own, so that front coding
+ * the terms and writing their blocks overlaps with whatever produces the
+ * sorted terms, such as merging and compressing their postings. Terms are
+ * handed to the thread in batches through a bounded queue, so a producer
+ * that outpaces the writer waits rather than buffering the whole
+ * vocabulary.
+ *
+ * Like vocabulary_map_writer, this must only be used from one thread.
+ */
+class async_vocabulary_writer
+{
+  public:
     /**
-     * Writes null bytes to fill up the current block.
+     * Starts the writing thread.
+     * @param path the path to the terms file to write
+     * @param block_terms the number of terms in each front-coded block
      */
-    void write_padding();
+    async_vocabulary_writer(const std::string& path,
+                            uint64_t block_terms = 16);
 
     /**
-     * Flushes a node to disk after writing the padding bytes.
+     * Waits for the writing thread, if finish() has not been called.
+     * Errors are then ignored, so callers should call finish().
      */
-    void flush();
+    ~async_vocabulary_writer();
 
-    /// The file containing the forward mapping tree.
-    std::ofstream file_;
+    /**
+     * Queues a term to be inserted into the map.
+     * @param term the term to insert; it must be larger than every term
+     * inserted before it
+     */
+    void insert(std::string term);
 
     /**
-     * The current write position in the forward mapping tree file. This is
-     * kept to avoid potential 32-bit system issues with the
-     * `tellp()/tellg()` functions on the standard streams.
+     * Writes the remaining terms and waits until the map is complete.
+     * @return the number of terms in the map
+     * @throw vocabulary_map_writer::vocabulary_map_writer_exception if the
+     * map could not be written
      */
-    uint64_t file_write_pos_;
+    uint64_t finish();
 
-    /// The file containing the reverse mapping
-    std::ofstream inverse_file_;
+  private:
+    /**
+     * Hands the current batch to the writing thread.
+     */
+    void flush();
 
-    /// The path to the tree file
-    std::string path_;
+    /// The number of terms handed to the thread at once
+    const static uint64_t batch_size = 4096;
 
-    /// The block size of every node in the tree, in bytes
-    uint16_t block_size_;
+    /// The batches waiting to be written
+    parallel::bounded_queue<std::vector<std::string>> queue_;
 
-    /// The total number of terms inserted so far
-    uint64_t num_terms_;
+    /// The terms not yet handed to the thread
+    std::vector<std::string> batch_;
 
-    /// The remaining space in the block currently being written
-    uint16_t remaining_block_space_;
+    /// The number of terms inserted so far
+    uint64_t num_terms_;
 
-    /// Number of written nodes to be "merged" when writing the next level
-    uint64_t written_nodes_;
+    /// The writing thread, which completes once the map is written
+    std::future<void> done_;
 };
 }
 }
@@ -0,0 +1,262 @@
+/**
+ * @file bgzf.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_IO_BGZF_H_
+#define META_IO_BGZF_H_
+
+#include <deque>
+#include <fstream>
+#include <future>
+#include <ostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <streambuf>
+#include <thread>
+#include <vector>
+
+#include "io/mmap_file.h"
+#include "parallel/thread_pool.h"
+
+namespace meta
+{
+namespace io
+{
+
+/**
+ * Basic exception for reading and writing BGZF files.
+ */
+class bgzf_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * Writes a file in the blocked gzip format (BGZF) of samtools' bgzip: a
+ * sequence of gzip members of at most 64KB each, whose headers carry the
+ * compressed size of the member in a "BC" extra field. The file is still
+ * valid gzip, and can be read by gzifstream or zcat, but its members can
+ * also be found without decompressing them and then be inflated
+ * independently by bgzf_reader.
+ *
+ * Because the blocks are independent, they are also deflated
+ * independently: full blocks are compressed on a pool of threads, as
+ * pigz does, and written in order as they finish.
+ */
+class bgzf_writer
+{
+  public:
+    /// The most uncompressed bytes a block may hold, so that even bytes
+    /// that do not compress fit in a member of at most 64KB
+    const static uint64_t max_block_size = 65280;
+
+    /**
+     * Opens a file for writing.
+     * @param filename The file to write
+     * @param block_size The number of uncompressed bytes in each block,
+     * which is at most max_block_size
+     * @param level The zlib compression level
+     * @param num_threads The number of threads to deflate blocks with; with
+     * one, blocks are deflated on the calling thread
+     */
+    bgzf_writer(const std::string& filename,
+                uint64_t block_size = max_block_size, int level = 6,
+                uint64_t num_threads = std::thread::hardware_concurrency());
+
+    /**
+     * Closes the file if close() has not been called.
+     */
+    ~bgzf_writer();
+
+    /**
+     * Appends bytes to the file.
+     * @param data The bytes to write
+     * @param size The number of bytes to write
+     */
+    void write(const char* data, uint64_t size);
+
+    /**
+     * Appends a string to the file.
+     * @param str The string to write
+     */
+    void write(const std::string& str);
+
+    /**
+     * Compresses the last block and writes the empty block that marks the
+     * end of a BGZF file.
+     */
+    void close();
+
+  private:
+    /**
+     * Starts compressing the block being filled, and writes the oldest
+     * compressed blocks if too many are in flight.
+     */
+    void flush_block();
+
+    /**
+     * Writes the oldest block being compressed, once it is done.
+     */
+    void write_front();
+
+    /// The compressed file
+    std::ofstream out_;
+
+    /// The bytes of the block being filled
+    std::string buffer_;
+
+    /// The number of uncompressed bytes in each block
+    uint64_t block_size_;
+
+    /// The zlib compression level
+    int level_;
+
+    /// The threads that deflate blocks, if there is more than one
+    std::unique_ptr<parallel::thread_pool> pool_;
+
+    /// The most blocks deflating at once
+    uint64_t max_pending_;
+
+    /// The blocks being deflated, in the order of the file
+    std::deque<std::future<std::string>> pending_;
+
+    /// Whether close() has been called
+    bool closed_;
+};
+
+/**
+ * A stream buffer that writes a BGZF file through a bgzf_writer.
+ */
+class bgzf_streambuf : public std::streambuf
+{
+  public:
+    /**
+     * Opens a file for writing.
+     * @param filename The file to write
+     * @param num_threads The number of threads to deflate blocks with
+     */
+    bgzf_streambuf(const std::string& filename, uint64_t num_threads);
+
+    /**
+     * Writes what is buffered and closes the file.
+     */
+    ~bgzf_streambuf();
+
+    /**
+     * Writes what is buffered and closes the file.
+     */
+    void close();
+
+  protected:
+    int_type overflow(int_type ch) override;
+
+    int sync() override;
+
+  private:
+    /// The compressed file
+    bgzf_writer writer_;
+
+    /// The bytes not yet handed to writer_
+    std::vector<char> buffer_;
+};
+
+/**
+ * An output stream that writes a BGZF file, deflating its blocks on a
+ * pool of threads. What it writes can be read back by gzifstream, and so
+ * by gz_corpus.
+ */
+class bgzf_ofstream : public std::ostream
+{
+  public:
+    /**
+     * Opens a file for writing.
+     * @param filename The file to write
+     * @param num_threads The number of threads to deflate blocks with
+     */
+    explicit bgzf_ofstream(const std::string& filename,
+                           uint64_t num_threads
+                           = std::thread::hardware_concurrency());
+
+    /**
+     * Writes what is buffered and closes the file.
+     */
+    void close();
+
+  private:
+    /// The buffer that writes the file
+    bgzf_streambuf buffer_;
+};
+
+/**
+ * Reads the lines of a BGZF file, inflating the blocks ahead of the reader
+ * on a pool of threads. Blocks are handed out in the order of the file,
+ * and lines may span blocks.
+ */
+class bgzf_reader
+{
+  public:
+    /**
+     * @param filename A file
+     * @return whether the file starts with a BGZF block, and so can be
+     * read by a bgzf_reader
+     */
+    static bool is_bgzf(const std::string& filename);
+
+    /**
+     * Opens a BGZF file for reading.
+     * @param filename The file to read
+     * @param num_threads The number of threads to inflate blocks with
+     */
+    bgzf_reader(const std::string& filename,
+                uint64_t num_threads = std::thread::hardware_concurrency());
+
+    /**
+     * Reads the next line.
+     * @param line Where to store the line, without its newline
+     * @return whether there was a line to read
+     */
+    bool getline(std::string& line);
+
+  private:
+    /**
+     * Starts inflating blocks until enough are in flight or none are left.
+     */
+    void fill();
+
+    /**
+     * Moves to the next inflated block.
+     * @return whether there was another block
+     */
+    bool next_block();
+
+    /// The compressed file, if it is not empty
+    std::unique_ptr<mmap_file> file_;
+
+    /// The offset of the next block to start inflating
+    uint64_t offset_;
+
+    /// The threads that inflate blocks
+    parallel::thread_pool pool_;
+
+    /// The most blocks inflating at once
+    uint64_t max_pending_;
+
+    /// The blocks being inflated, in the order of the file
+    std::deque<std::future<std::string>> pending_;
+
+    /// The current inflated block
+    std::string block_;
+
+    /// The position of the next line in block_
+    uint64_t pos_;
+};
+}
+}
+
+#endif
@@ -11,6 +11,7 @@
 #define META_COMPRESSED_FILE_READER_H_
 
 #include <functional>
+#include <limits>
 #include <memory>
 #include <stdexcept>
 #include <string>
@@ -34,8 +35,14 @@ enum ReaderStatus
 
 /**
  * Represents a file of unsigned integers compressed using gamma compression.
+ *
+ * The Mapping is invoked on every value read, so the hot decoding loops
+ * (chunk merging, postings compression, searching) use a stateless mapping
+ * type like default_compression_reader_mapping that can be inlined; the
+ * compressed_file_reader alias accepts any std::function for the rest.
  */
-class compressed_file_reader
+template <class Mapping>
+class basic_compressed_file_reader
 {
   public:
     /**
@@ -46,8 +53,8 @@ class compressed_file_reader
      * compressed id, usually to take advantage of a skewed distribution of
      * towards many small numbers
      */
-    compressed_file_reader(const mmap_file& file,
-                           std::function<uint64_t(uint64_t)> mapping);
+    basic_compressed_file_reader(const mmap_file& file,
+                                 Mapping mapping = Mapping{});
 
     /**
      * Constructor to create a new mmap file for reading.
@@ -56,13 +63,13 @@ class compressed_file_reader
      * compressed id, usually to take advantage of a skewed distribution of
      * towards many small numbers
      */
-    compressed_file_reader(const std::string& filename,
-                           std::function<uint64_t(uint64_t)> mapping);
+    basic_compressed_file_reader(const std::string& filename,
+                                 Mapping mapping = Mapping{});
 
     /**
      * Destructor.
      */
-    ~compressed_file_reader();
+    ~basic_compressed_file_reader();
 
     /**
      * Sets the cursor back to the beginning of the file.
@@ -149,7 +156,7 @@ class compressed_file_reader
     uint8_t current_bit_;
 
     /// hold the (actual -> compressed id) mapping
-    std::function<uint64_t(uint64_t)> mapping_;
+    Mapping mapping_;
 
   public:
     /**
@@ -162,6 +169,41 @@ class compressed_file_reader
     };
 };
 
+/**
+ * Converts a compressed number back into its normal representation: the
+ * inverse of default_compression_writer_mapping.
+ */
+struct default_compression_reader_mapping
+{
+    /**
+     * @param value The value to transform
+     * @return the original form
+     */
+    uint64_t operator()(uint64_t value) const
+    {
+        if (value == 1)
+            return std::numeric_limits<uint64_t>::max(); // delimiter
+        return value - 2;
+    }
+};
+
+/**
+ * A compressed_file_reader with a runtime-specified mapping.
+ */
+using compressed_file_reader
+    = basic_compressed_file_reader<std::function<uint64_t(uint64_t)>>;
+
+/**
+ * A compressed_file_reader using the default mapping, which is resolved at
+ * compile time.
+ */
+using default_compressed_file_reader
+    = basic_compressed_file_reader<default_compression_reader_mapping>;
+
+// the runtime-mapped reader is compiled once, in compressed_file_reader.cpp
+extern template class basic_compressed_file_reader<
+    std::function<uint64_t(uint64_t)>>;
+
 /**
  * Function that converts a compressed number back into its normal
  * representation.
@@ -172,4 +214,6 @@ uint64_t default_compression_reader_func(uint64_t value);
 }
 }
 
+#include "io/compressed_file_reader.tcc"
+
 #endif
@@ -0,0 +1,161 @@
+/**
+ * @file compressed_file_reader.tcc
+ * @author Sean Massung
+ */
+
+#include "io/compressed_file_reader.h"
+#include "io/mmap_file.h"
+#include "util/shim.h"
+
+namespace meta
+{
+namespace io
+{
+
+template <class Mapping>
+basic_compressed_file_reader<Mapping>::basic_compressed_file_reader(
+    const std::string& filename, Mapping mapping)
+    : file_{make_unique<mmap_file>(filename)},
+      start_{file_->begin()},
+      size_{file_->size()},
+      status_{notDone},
+      current_value_{0},
+      current_char_{0},
+      current_bit_{0},
+      mapping_{std::move(mapping)}
+{
+    // a reader that owns its file decodes it front to back
+    file_->advise(access_pattern::sequential);
+
+    // initialize the stream
+    get_next();
+}
+
+template <class Mapping>
+basic_compressed_file_reader<Mapping>::basic_compressed_file_reader(
+    const mmap_file& file, Mapping mapping)
+    : file_{nullptr},
+      start_{file.begin()},
+      size_{file.size()},
+      status_{notDone},
+      current_value_{0},
+      current_char_{0},
+      current_bit_{0},
+      mapping_{std::move(mapping)}
+{
+    // initialize the stream
+    get_next();
+}
+
+template <class Mapping>
+basic_compressed_file_reader<Mapping>::~basic_compressed_file_reader()
+    = default;
+
+template <class Mapping>
+void basic_compressed_file_reader<Mapping>::close()
+{
+    file_.reset(nullptr); // closes the mmap_file
+}
+
+template <class Mapping>
+uint64_t basic_compressed_file_reader<Mapping>::bit_location() const
+{
+    return (current_char_ * 8) + current_bit_;
+}
+
+template <class Mapping>
+void basic_compressed_file_reader<Mapping>::reset()
+{
+    current_char_ = 0;
+    current_bit_ = 0;
+    status_ = notDone;
+    get_next();
+}
+
+template <class Mapping>
+std::string basic_compressed_file_reader<Mapping>::next_string()
+{
+    uint64_t length = next();
+    std::string str;
+    for (uint64_t i = 0; i < length; ++i)
+        str += static_cast<char>(next());
+    return str;
+}
+
+template <class Mapping>
+void basic_compressed_file_reader<Mapping>::seek(uint64_t bit_offset)
+{
+    uint64_t byte = bit_offset / 8;
+    uint8_t bit = bit_offset % 8;
+
+    if (byte < size_)
+    {
+        current_char_ = byte;
+        current_bit_ = bit;
+        status_ = notDone;
+        get_next();
+    }
+    else
+        throw compressed_file_reader_exception(
+            "error seeking: parameter out of bounds");
+}
+
+template <class Mapping>
+bool basic_compressed_file_reader<Mapping>::has_next() const
+{
+    return status_ != readerDone;
+}
+
+template <class Mapping>
+uint64_t basic_compressed_file_reader<Mapping>::next()
+{
+    if (status_ == userDone)
+        return 0;
+
+    if (status_ == readerDone)
+    {
+        status_ = userDone;
+        return current_value_;
+    }
+
+    uint64_t next = mapping_(current_value_);
+    get_next();
+    return next;
+}
+
+template <class Mapping>
+void basic_compressed_file_reader<Mapping>::get_next()
+{
+    uint64_t numberBits = 0;
+    while (status_ == 0 && !read_bit())
+        ++numberBits;
+
+    current_value_ = 0;
+    for (int64_t bit = numberBits - 1; status_ == 0 && bit >= 0; --bit)
+    {
+        if (read_bit())
+            current_value_ |= (uint64_t{1} << bit);
+    }
+
+    current_value_ |= (uint64_t{1} << numberBits);
+}
+
+template <class Mapping>
+bool basic_compressed_file_reader<Mapping>::read_bit()
+{
+    // (7 - current_Bit) to read from left to right
+    bool bit = start_[current_char_] & (1 << (7 - current_bit_));
+    if (current_bit_ == 7)
+    {
+        current_bit_ = 0;
+        if (++current_char_ == size_)
+            status_ = readerDone;
+    }
+    else
+    {
+        ++current_bit_;
+    }
+    return bit;
+}
+}
+}
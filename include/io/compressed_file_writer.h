@@ -10,9 +10,14 @@
 #ifndef META_COMPRESSED_FILE_WRITER_H_
 #define META_COMPRESSED_FILE_WRITER_H_
 
+#include <cstdint>
+#include <cstdio>
 #include <functional>
+#include <future>
+#include <limits>
 #include <stdexcept>
 #include <string>
+#include <vector>
 
 namespace meta
 {
@@ -21,10 +26,23 @@ namespace io
 
 /**
  * Writes to a file of unsigned integers using gamma compression.
+ *
+ * Codes are gathered in a 64-bit accumulator and stored into the buffer a
+ * word at a time. A full buffer is written to disk by a background task
+ * while the writer fills a second one, so the writer only waits for the
+ * disk when it gets a buffer ahead of it.
+ *
+ * As with basic_compressed_file_reader, the Mapping is applied to every
+ * value written, so hot loops should use a stateless mapping type such as
+ * default_compression_writer_mapping.
  */
-class compressed_file_writer
+template <class Mapping>
+class basic_compressed_file_writer
 {
   public:
+    /// The default size in bytes of each buffer of a writer
+    const static uint64_t default_buffer_size = 1024 * 1024; // 1 MB
+
     /**
      * Constructor; Opens a compressed file for writing or creates a new
      * file if it doesn't exist.
@@ -32,14 +50,17 @@ class compressed_file_writer
      * @param mapping A function to map the original numbers to their
      * compressed id, usually to take advantage of a skewed distribution of
      * towards many small numbers
+     * @param buffer_size The size in bytes of each of the writer's two
+     * buffers, rounded up to a multiple of eight
      */
-    compressed_file_writer(const std::string& filename,
-                           std::function<uint64_t(uint64_t)> mapping);
+    basic_compressed_file_writer(const std::string& filename,
+                                 Mapping mapping = Mapping{},
+                                 uint64_t buffer_size = default_buffer_size);
 
     /**
      * Destructor; closes the compressed file.
      */
-    ~compressed_file_writer();
+    ~basic_compressed_file_writer();
 
     /**
      * @return the character index and bit index of the current location in
@@ -60,40 +81,56 @@ class compressed_file_writer
     void write(const std::string& str);
 
     /**
-     * Closes this compressed file.
+     * Closes this compressed file, waiting for its last buffers to be
+     * written; throws an exception if they could not be.
      */
     void close();
 
   private:
     /**
-     * Writes a bit to the file and advances the current location in the
-     * file.
-     * @param bit
+     * Appends the low bits of a value to the file, most significant
+     * first.
+     * @param value The bits to write; any bits above the lowest count
+     * must be zero
+     * @param count The number of bits to write, at most 64
      */
-    void write_bit(bool bit);
+    void write_bits(uint64_t value, uint64_t count);
 
     /**
-     * Writes the buffer to the file.
+     * Stores a full accumulator into the buffer.
      */
-    void write_buffer() const;
+    void store_word();
+
+    /**
+     * Hands the buffer to a background write and switches to the other
+     * one, once the previous write is done.
+     * @param size The number of bytes of the buffer to write
+     */
+    void write_buffer(uint64_t size);
 
     /// Where to write the compressed data
     FILE* outfile_;
 
-    /// The current byte this reader is on
-    uint64_t char_cursor_;
-
-    /// The current bit of the current byte this reader is on
-    uint64_t bit_cursor_;
+    /// Bits not yet stored in the buffer, starting at the high bit
+    uint64_t bits_;
 
-    /// How large to make the internal writer buffer
-    uint64_t buffer_size_;
+    /// The number of bits in bits_
+    uint64_t num_bits_;
 
     /// Saved data that is not yet written to disk
-    unsigned char* buffer_;
+    std::vector<unsigned char> buffer_;
+
+    /// The number of bytes of buffer_ that are filled
+    uint64_t buffer_pos_;
+
+    /// The buffer being written to disk in the background
+    std::vector<unsigned char> flushing_;
+
+    /// The background write of flushing_, if any
+    std::future<void> pending_write_;
 
     /// The mapping to use (actual -> compressed id)
-    std::function<uint64_t(uint64_t)> mapping_;
+    Mapping mapping_;
 
     /// The number of total bits that have been written (for seeking)
     uint64_t bit_location_;
@@ -112,6 +149,42 @@ class compressed_file_writer
     };
 };
 
+/**
+ * Shows how to convert a number into its compressed form: reserves 1 for
+ * the delimiter and shifts everything else up by two, since gamma codes
+ * cannot represent zero.
+ */
+struct default_compression_writer_mapping
+{
+    /**
+     * @param key The value to transform
+     * @return the compressed form
+     */
+    uint64_t operator()(uint64_t key) const
+    {
+        if (key == std::numeric_limits<uint64_t>::max()) // delimiter
+            return uint64_t{1};
+        return key + 2;
+    }
+};
+
+/**
+ * A compressed_file_writer with a runtime-specified mapping.
+ */
+using compressed_file_writer
+    = basic_compressed_file_writer<std::function<uint64_t(uint64_t)>>;
+
+/**
+ * A compressed_file_writer using the default mapping, which is resolved at
+ * compile time.
+ */
+using default_compressed_file_writer
+    = basic_compressed_file_writer<default_compression_writer_mapping>;
+
+// the runtime-mapped writer is compiled once, in compressed_file_writer.cpp
+extern template class basic_compressed_file_writer<
+    std::function<uint64_t(uint64_t)>>;
+
 /**
  * Shows how to convert a number into its compressed form.
  * @param key The value to transform
@@ -121,4 +194,6 @@ uint64_t default_compression_writer_func(uint64_t key);
 }
 }
 
+#include "io/compressed_file_writer.tcc"
+
 #endif
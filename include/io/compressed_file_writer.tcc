@@ -0,0 +1,167 @@
+/**
+ * @file compressed_file_writer.tcc
+ * @author Sean Massung
+ */
+
+#include <algorithm>
+#include <exception>
+
+#include "io/compressed_file_writer.h"
+
+namespace meta
+{
+namespace io
+{
+
+template <class Mapping>
+const uint64_t basic_compressed_file_writer<Mapping>::default_buffer_size;
+
+template <class Mapping>
+basic_compressed_file_writer<Mapping>::basic_compressed_file_writer(
+    const std::string& filename, Mapping mapping,
+    uint64_t buffer_size /* = default_buffer_size */)
+    : outfile_{fopen(filename.c_str(), "w")},
+      bits_{0},
+      num_bits_{0},
+      buffer_((std::max<uint64_t>(buffer_size, 8) + 7) / 8 * 8),
+      buffer_pos_{0},
+      flushing_(buffer_.size()),
+      mapping_{std::move(mapping)},
+      bit_location_{0},
+      closed_{false}
+{
+    if (!outfile_)
+        throw compressed_file_writer_exception{"could not open " + filename};
+
+    // disable buffering
+    if (setvbuf(outfile_, nullptr, _IONBF, 0) != 0)
+        throw compressed_file_writer_exception(
+            "error disabling buffering (setvbuf)");
+}
+
+template <class Mapping>
+void basic_compressed_file_writer<Mapping>::write(const std::string& str)
+{
+    uint64_t length = str.size();
+    write(length);
+    for (auto& ch : str)
+    {
+        auto uch = static_cast<uint8_t>(ch);
+        write(static_cast<uint64_t>(uch));
+    }
+}
+
+template <class Mapping>
+uint64_t basic_compressed_file_writer<Mapping>::bit_location() const
+{
+    return bit_location_;
+}
+
+template <class Mapping>
+basic_compressed_file_writer<Mapping>::~basic_compressed_file_writer()
+{
+    // a destructor can not report a failed write; call close() to see it
+    try
+    {
+        close();
+    }
+    catch (const compressed_file_writer_exception&)
+    {
+        // nothing
+    }
+}
+
+template <class Mapping>
+void basic_compressed_file_writer<Mapping>::close()
+{
+    if (!closed_)
+    {
+        closed_ = true;
+
+        // write the remaining bits, up to the nearest byte; as the
+        // bit-at-a-time writer did, this includes the byte the next bit
+        // would go in even when no bit has gone in it yet
+        for (uint64_t i = 0; i <= num_bits_ / 8; ++i)
+            buffer_[buffer_pos_++] = static_cast<unsigned char>(
+                bits_ >> (56 - 8 * i));
+        std::exception_ptr error;
+        try
+        {
+            write_buffer(buffer_pos_);
+            pending_write_.get();
+        }
+        catch (...)
+        {
+            error = std::current_exception();
+        }
+        fclose(outfile_);
+        if (error)
+            std::rethrow_exception(error);
+    }
+}
+
+template <class Mapping>
+void basic_compressed_file_writer<Mapping>::write(uint64_t value)
+{
+    // the gamma code of cvalue is as many zeros as there are bits in
+    // cvalue after its leading one, then cvalue itself
+    uint64_t cvalue = mapping_(value);
+    uint64_t length = 63 - static_cast<uint64_t>(__builtin_clzll(cvalue));
+
+    write_bits(0, length);
+    write_bits(cvalue, length + 1);
+}
+
+template <class Mapping>
+void basic_compressed_file_writer<Mapping>::write_bits(uint64_t value,
+                                                       uint64_t count)
+{
+    if (count == 0)
+        return;
+
+    bit_location_ += count;
+    auto room = 64 - num_bits_;
+    if (count < room)
+    {
+        bits_ |= value << (room - count);
+        num_bits_ += count;
+        return;
+    }
+
+    // the accumulator fills up: store it, and keep the bits left over
+    bits_ |= value >> (count - room);
+    store_word();
+    num_bits_ = count - room;
+    bits_ = num_bits_ > 0 ? value << (64 - num_bits_) : 0;
+}
+
+template <class Mapping>
+void basic_compressed_file_writer<Mapping>::store_word()
+{
+    // most significant byte first, as the bits are read back
+    for (uint64_t i = 0; i < 8; ++i)
+        buffer_[buffer_pos_ + i]
+            = static_cast<unsigned char>(bits_ >> (56 - 8 * i));
+    buffer_pos_ += 8;
+    if (buffer_pos_ == buffer_.size())
+        write_buffer(buffer_pos_);
+}
+
+template <class Mapping>
+void basic_compressed_file_writer<Mapping>::write_buffer(uint64_t size)
+{
+    if (pending_write_.valid())
+        pending_write_.get();
+
+    std::swap(buffer_, flushing_);
+    buffer_pos_ = 0;
+    auto out = outfile_;
+    auto data = flushing_.data();
+    pending_write_ = std::async(std::launch::async, [=]()
+                                {
+        if (fwrite(data, 1, size, out) != size)
+            throw compressed_file_writer_exception("error writing to file");
+    });
+}
+}
+}
@@ -0,0 +1,90 @@
+/**
+ * @file delimiter_scanner.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_IO_DELIMITER_SCANNER_H_
+#define META_IO_DELIMITER_SCANNER_H_
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace meta
+{
+namespace io
+{
+
+/**
+ * Finds the next of a set of delimiter characters in a range of memory,
+ * many bytes at a time.
+ *
+ * A single delimiter is found with memchr, which the C library vectorizes.
+ * A set of delimiters is matched sixteen bytes at a time when SSSE3 is
+ * available, by looking up the low and the high nibble of each byte in two
+ * shuffle tables: each distinct high nibble of the delimiters gets a bit,
+ * the high table maps a nibble to its bit, and the low table maps a low
+ * nibble to the bits of the high nibbles it forms a delimiter with, so a
+ * byte is a delimiter exactly when its two lookups share a bit. Sets
+ * whose delimiters have more than eight distinct high nibbles, and
+ * machines without SSSE3, fall back to a table of one flag per byte.
+ */
+class delimiter_scanner
+{
+  public:
+    /**
+     * @param delims The delimiter characters
+     */
+    explicit delimiter_scanner(const std::string& delims);
+
+    /**
+     * @param first The start of the range
+     * @param last The end of the range
+     * @return the first delimiter in [first, last), or last if there is
+     * none
+     */
+    const char* find(const char* first, const char* last) const;
+
+    /**
+     * @param ch A character
+     * @return whether the character is a delimiter
+     */
+    bool is_delimiter(char ch) const
+    {
+        return delimiter_[static_cast<uint8_t>(ch)];
+    }
+
+  private:
+    /**
+     * How the delimiters are found.
+     */
+    enum class method
+    {
+        none,
+        single,
+        nibbles,
+        table
+    };
+
+    /// How the delimiters are found
+    method method_;
+
+    /// The delimiter, if there is only one
+    char single_;
+
+    /// The bits of the high nibbles each low nibble forms a delimiter with
+    std::array<uint8_t, 16> low_;
+
+    /// The bit of each high nibble of a delimiter
+    std::array<uint8_t, 16> high_;
+
+    /// Whether each character is a delimiter
+    std::array<bool, 256> delimiter_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,71 @@
+/**
+ * @file front_coding.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_IO_FRONT_CODING_H_
+#define META_IO_FRONT_CODING_H_
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+namespace meta
+{
+namespace io
+{
+
+/**
+ * Front coding of lists of strings. Each string is stored as the length
+ * of the prefix it shares with the string before it, the length of the
+ * rest of the string, and the rest of the string, with both lengths as
+ * variable byte codes. Lists are broken into blocks whose first string
+ * shares no prefix, so that any block can be decoded on its own.
+ */
+namespace front_coding
+{
+
+/**
+ * Writes one string of a front-coded block.
+ * @param out The stream to write to
+ * @param previous The string written before this one
+ * @param str The string to write
+ * @param block_start Whether this string starts a new block, in which
+ * case it is written in full
+ * @return the number of bytes written
+ */
+uint64_t write(std::ostream& out, const std::string& previous,
+               const std::string& str, bool block_start);
+
+/**
+ * Decodes the strings of a front-coded block one after another.
+ */
+class block_reader
+{
+  public:
+    /**
+     * @param pos The start of the block
+     */
+    block_reader(const char* pos);
+
+    /**
+     * Decodes the next string of the block.
+     * @return the string, which remains valid until the next call
+     */
+    const std::string& next();
+
+  private:
+    /// The next string to decode
+    const uint8_t* pos_;
+
+    /// The string decoded last
+    std::string current_;
+};
+}
+}
+}
+
+#endif
@@ -10,6 +10,7 @@
 #ifndef META_LIBSVM_PARSER_H_
 #define META_LIBSVM_PARSER_H_
 
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include <vector>
@@ -33,6 +34,14 @@ using counts_t = const std::vector<std::pair<term_id, double>>;
  */
 class_label label(const std::string& text);
 
+/**
+ * Extracts a class_label from a line in libsvm format.
+ * @param first The start of the line
+ * @param last The end of the line
+ * @return the class_label
+ */
+class_label label(const char* first, const char* last);
+
 /**
  * @param text A libsvm-formatted string; throws an exception if it can't
  * be parsed correctly
@@ -42,6 +51,21 @@ class_label label(const std::string& text);
  */
 counts_t counts(const std::string& text, bool contains_label = true);
 
+/**
+ * Parses the (feature, count) pairs of a line in libsvm format directly
+ * from its characters, without allocating anything but room in the
+ * output. Calls that reuse the output vector allocate nothing once it has
+ * grown to the longest line. Throws an exception if the line can't be
+ * parsed correctly.
+ * @param first The start of the line
+ * @param last The end of the line
+ * @param out Where to store the pairs; its previous contents are replaced
+ * @param contains_label Whether the line's first token is the class_label
+ */
+void counts(const char* first, const char* last,
+            std::vector<std::pair<term_id, double>>& out,
+            bool contains_label = true);
+
 /**
  * Exception class for this parser.
  */
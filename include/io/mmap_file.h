@@ -10,14 +10,65 @@
 #ifndef META_MMAP_FILE_H_
 #define META_MMAP_FILE_H_
 
+#include <cstdint>
 #include <stdexcept>
 #include <string>
 
+#include "util/memory_usage.h"
+
 namespace meta
 {
 namespace io
 {
 
+/**
+ * How a memory-mapped file is brought into memory.
+ */
+enum class residency
+{
+    /// pages are read from the file the first time they are touched
+    on_demand,
+    /// every page is read from the file when it is mapped
+    prefault,
+    /// the file is copied into anonymous memory, which is backed by
+    /// transparent huge pages where the system supports them
+    in_memory
+};
+
+/**
+ * How a mapped region is about to be accessed, passed to madvise so that
+ * the kernel can tune its readahead.
+ */
+enum class access_pattern
+{
+    /// no particular pattern; the default readahead
+    normal,
+    /// read from front to back, so read far ahead and drop pages behind
+    sequential,
+    /// read at scattered offsets, so do not read ahead
+    random,
+    /// going to be read soon, so start reading it in now
+    will_need,
+    /// not going to be read again soon, so its pages may be dropped
+    dont_need
+};
+
+/**
+ * Gives the kernel a hint about how a mapped region will be accessed.
+ * Hints are advisory, so failures are ignored. dont_need discards the
+ * contents of anonymous memory, so it must only be used on file mappings.
+ * @param start The start of the region
+ * @param bytes The length of the region
+ * @param pattern How the region will be accessed
+ */
+void advise(const void* start, uint64_t bytes, access_pattern pattern);
+
+/**
+ * @param name "on-demand", "prefault", or "memory"
+ * @return the residency with the given name
+ */
+residency parse_residency(const std::string& name);
+
 /**
  * Memory maps a text file readonly.
  */
@@ -27,8 +78,9 @@ class mmap_file
     /**
      * Constructor.
      * @param path Path to the text file to open
+     * @param res How the file is brought into memory
      */
-    mmap_file(const std::string& path);
+    mmap_file(const std::string& path, residency res = residency::on_demand);
 
     /**
      * Move constructor.
@@ -69,6 +121,25 @@ class mmap_file
      */
     char* begin() const;
 
+    /**
+     * @return the memory used by the mapping
+     */
+    util::memory_usage memory_usage() const;
+
+    /**
+     * Hints how the whole file will be accessed.
+     * @param pattern How the file will be accessed
+     */
+    void advise(access_pattern pattern) const;
+
+    /**
+     * Hints how part of the file will be accessed.
+     * @param pattern How the bytes will be accessed
+     * @param offset The first byte
+     * @param bytes The number of bytes
+     */
+    void advise(access_pattern pattern, uint64_t offset, uint64_t bytes) const;
+
   private:
     /// Filename of the text file
     std::string path_;
@@ -79,7 +150,8 @@ class mmap_file
     /// Size of the current text file
     uint64_t size_;
 
-    /// File descriptor for the open text file
+    /// File descriptor for the open text file, or -1 if the file has been
+    /// copied into memory
     int file_descriptor_;
 
     /// No copying */
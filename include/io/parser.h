@@ -10,10 +10,11 @@
 #ifndef META_PARSER_H_
 #define META_PARSER_H_
 
-#include <array>
+#include <cstdint>
 #include <memory>
+#include <stdexcept>
 #include <string>
-#include "util/optional.h"
+#include "io/delimiter_scanner.h"
 
 namespace meta
 {
@@ -24,7 +25,9 @@ class mmap_file;
 
 /**
  * Parses a text file by reading it completely into memory, delimiting tokens
- * by user request.
+ * by user request. Delimiters are found by a delimiter_scanner, many bytes
+ * at a time, so reading is bound by memory bandwidth when tokens are taken
+ * with next_token(), which does not copy them.
  */
 class parser
 {
@@ -40,7 +43,28 @@ class parser
     };
 
     /**
-     * @param path The path to the file to parse
+     * A token of the input. It points into the file or string being
+     * parsed, so it is only valid while the parser is.
+     */
+    struct token
+    {
+        /// The first character of the token
+        const char* data;
+        /// The number of characters in the token
+        uint64_t size;
+
+        /**
+         * @return the token as a string
+         */
+        std::string str() const
+        {
+            return std::string{data, size};
+        }
+    };
+
+    /**
+     * @param input The path to the file to parse, or the string to parse,
+     * which must then outlive the parser
      * @param delims Delimiters to be used for separating tokens
      * @param in_type Determines whether the input is a file or a string
      */
@@ -79,6 +103,12 @@ class parser
      */
     std::string next();
 
+    /**
+     * @return the next token in the parser, without copying it, advancing
+     * to the next one if it exists
+     */
+    token next_token();
+
     /**
      * @return whether the parser contains another token
      */
@@ -93,8 +123,8 @@ class parser
     /// The current position of the "cursor" into the file or string
     size_t idx_;
 
-    /// Array of booleans indicating whether or not a character is a delimiter
-    std::array<bool, 256> invalid_;
+    /// Finds the delimiters of the input
+    delimiter_scanner delims_;
 
     /// Saves the name of the file if the parser is parsing a file
     std::string filename_;
@@ -108,8 +138,20 @@ class parser
     /// Pointer into a string or memory-mapped file
     const char* data_;
 
-    /// The next token to be returned; "" if none
-    util::optional<std::string> next_;
+    /// The next token to be returned, if has_next_
+    token next_;
+
+    /// Whether there is another token
+    bool has_next_;
+};
+
+/**
+ * Exception thrown when a parser is asked for a token it does not have.
+ */
+class parser_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
 };
 }
 }
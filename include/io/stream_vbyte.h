@@ -0,0 +1,101 @@
+/**
+ * @file stream_vbyte.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_IO_STREAM_VBYTE_H_
+#define META_IO_STREAM_VBYTE_H_
+
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+
+namespace meta
+{
+namespace io
+{
+
+/**
+ * Word-aligned integer compression using the Stream VByte format (Lemire,
+ * Kurz, and Rupp, 2017). A run of n 32-bit integers is stored as
+ * ceil(n / 4) control bytes followed by the data bytes: each control byte
+ * holds four 2-bit fields giving the byte length (minus one) of the
+ * corresponding little-endian integer in the data section.
+ *
+ * Separating the lengths from the data means a decoder never branches on
+ * individual bytes, and four integers can be decoded with a single byte
+ * shuffle when SSSE3 is available.
+ */
+namespace stream_vbyte
+{
+
+/**
+ * @param n The number of integers to be encoded
+ * @return an upper bound on the number of bytes needed to encode n
+ * integers
+ */
+inline uint64_t max_encoded_size(uint64_t n)
+{
+    return (n + 3) / 4 + 4 * n;
+}
+
+/**
+ * Encodes a run of integers.
+ * @param in The integers to encode
+ * @param n The number of integers to encode
+ * @param out The buffer to write to; must have at least
+ * max_encoded_size(n) bytes available
+ * @return the number of bytes written to out
+ */
+uint64_t encode(const uint32_t* in, uint64_t n, uint8_t* out);
+
+/**
+ * Decodes a run of integers.
+ * @param in The encoded bytes
+ * @param n The number of integers that were encoded
+ * @param out The buffer to write the decoded integers to; must have room
+ * for n integers
+ * @return the number of bytes read from in
+ */
+uint64_t decode(const uint8_t* in, uint64_t n, uint32_t* out);
+
+/**
+ * @param in The encoded bytes
+ * @param n The number of integers that were encoded
+ * @return the number of bytes occupied by the encoded run, without
+ * decoding it
+ */
+uint64_t encoded_size(const uint8_t* in, uint64_t n);
+
+/**
+ * Writes a single integer as a (LEB128-style) variable byte code, used for
+ * the small headers that precede runs of Stream VByte data.
+ * @param out The stream to write to
+ * @param value The value to write
+ * @return the number of bytes written
+ */
+uint64_t write_varint(std::ostream& out, uint64_t value);
+
+/**
+ * Reads a single variable byte code.
+ * @param in The encoded bytes; advanced past the value read
+ * @return the decoded value
+ */
+uint64_t read_varint(const uint8_t*& in);
+
+/**
+ * Basic exception for stream_vbyte interactions.
+ */
+class stream_vbyte_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+}
+
+#endif
@@ -11,9 +11,11 @@
 #define META_LANGUAGE_MODEL_H_
 
 #include <deque>
-#include <memory>
 #include <string>
-#include <unordered_map>
+#include <vector>
+
+#include "lm/ngram_trie.h"
+#include "parallel/thread_pool.h"
 
 namespace meta
 {
@@ -35,6 +37,34 @@ class language_model
      */
     language_model(const std::string& config_file, size_t n);
 
+    /**
+     * Loads a language model saved by save(), memory-mapping it so that it
+     * is usable without being read in and shares its pages with every
+     * other process using it.
+     * @param filename The model file
+     * @return the language model
+     */
+    static language_model load(const std::string& filename);
+
+    /**
+     * Loads a language model from a file in the ARPA text format.
+     * @param filename The ARPA file
+     * @return the language model
+     */
+    static language_model load_arpa(const std::string& filename);
+
+    /**
+     * Saves the language model in its binary format.
+     * @param filename The file to write
+     */
+    void save(const std::string& filename) const;
+
+    /**
+     * Saves the language model in the ARPA text format.
+     * @param filename The file to write
+     */
+    void save_arpa(const std::string& filename) const;
+
     /**
      * Randomly generates one token sequence based on <s> and </s> symbols.
      * @return a random sequence of tokens based on this language model
@@ -44,7 +74,8 @@ class language_model
     /**
      * @param tokens The previous N - 1 tokens
      * @param random A random number on [0, 1] used for choosing the next token
-     * @return the next token based on the previous tokens
+     * @return the next token based on the previous tokens, or on as many of
+     * the last of them as were seen together
      */
     std::string next_token(const std::deque<std::string>& tokens,
                            double random) const;
@@ -64,6 +95,45 @@ class language_model
      */
     double perplexity_per_word(const std::string& tokens) const;
 
+    /**
+     * Scores many token sequences concurrently. Each thread of the pool
+     * takes sequences a batch at a time until none are left, scoring them
+     * with buffers it reuses, so that scoring allocates nothing.
+     * @param sequences The token sequences
+     * @param pool The threads to score with
+     * @return the perplexity of each sequence
+     */
+    std::vector<double> perplexity(const std::vector<std::string>& sequences,
+                                   parallel::thread_pool& pool) const;
+
+    /**
+     * Scores many token sequences concurrently, with a thread for each
+     * core.
+     * @param sequences The token sequences
+     * @return the perplexity of each sequence
+     */
+    std::vector<double>
+        perplexity(const std::vector<std::string>& sequences) const;
+
+    /**
+     * Scores many token sequences concurrently.
+     * @param sequences The token sequences
+     * @param pool The threads to score with
+     * @return the perplexity of each sequence normalized by its length
+     */
+    std::vector<double>
+        perplexity_per_word(const std::vector<std::string>& sequences,
+                            parallel::thread_pool& pool) const;
+
+    /**
+     * Scores many token sequences concurrently, with a thread for each
+     * core.
+     * @param sequences The token sequences
+     * @return the perplexity of each sequence normalized by its length
+     */
+    std::vector<double> perplexity_per_word(
+        const std::vector<std::string>& sequences) const;
+
     /**
      * @param tokens A sequence of n tokens
      * @return the probability of seeing the nth token based on the previous n
@@ -71,38 +141,100 @@ class language_model
      */
     double prob(std::deque<std::string> tokens) const;
 
+    /**
+     * Tokenizes the corpus specified in the config file as a language
+     * model would, writing the token sequences of its documents to a
+     * tokenized corpus that language models can then be learned from
+     * without tokenizing the corpus again.
+     * @param config_file The config file that specifies the location of the
+     * corpus
+     * @param filename The file to write the tokenized corpus to
+     */
+    static void write_tokenized_corpus(const std::string& config_file,
+                                       const std::string& filename);
+
   private:
+    /**
+     * Creates an empty N-gram language model.
+     * @param n The value of n
+     */
+    explicit language_model(size_t n);
 
     /**
-     * Builds the probabilities associated with this language model.
+     * Creates a language model of the n-grams in a trie.
+     * @param trie The trie
+     */
+    explicit language_model(ngram_trie trie);
+
+    /**
+     * Builds the probabilities of the n-grams of every order this language
+     * model interpolates, counting them in a single pass over the corpus.
      * @param config_file The config file that specifies the location of the
      * corpus
      */
     void learn_model(const std::string& config_file);
 
     /**
-     * @param tokens A deque of tokens to convert to a string
-     * @return the string version of the deque (space delimited)
+     * The buffers a thread scores token sequences with, reused from one
+     * sequence to the next.
      */
-    std::string make_string(const std::deque<std::string>& tokens) const;
+    struct score_buffers
+    {
+        /// The ids of the last N tokens
+        std::vector<uint32_t> window;
+        /// The node of the context of each order
+        std::vector<uint64_t> nodes;
+    };
+
+    /**
+     * @param tokens A sequence of space-delimited tokens
+     * @param buffers The buffers to score with
+     * @return the perplexity of the sequence
+     */
+    double perplexity(const std::string& tokens, score_buffers& buffers) const;
+
+    /**
+     * @param ngram The ids of a sequence of N tokens
+     * @param nodes Space for the node of the context of each order
+     * @param depth The length of the longest context that could exist,
+     * which is replaced by that of the longest one that does
+     * @return the probability of seeing the Nth token based on the
+     * previous N - 1 tokens, backing off to shorter contexts
+     */
+    double ngram_prob(const uint32_t* ngram, uint64_t* nodes,
+                      uint64_t& depth) const;
+
+    /**
+     * @param token A token
+     * @return the id of the token, or that of <unk> if it is unknown
+     */
+    uint32_t token_id(const std::string& token) const;
 
     /**
-     * @param tokens A string of space-delimited tokens to convert to a deque
-     * @return a deque of the tokens
+     * @param token The characters of a token
+     * @param length The number of characters
+     * @return the id of the token, or that of <unk> if it is unknown
      */
-    std::deque<std::string> make_deque(const std::string& tokens) const;
+    uint32_t token_id(const char* token, uint64_t length) const;
+
+    /**
+     * @param tokens A deque of tokens to convert to a string
+     * @return the string version of the deque (space delimited)
+     */
+    std::string make_string(const std::deque<std::string>& tokens) const;
 
-    /// The language_model used to interpolate with this one for smoothing
-    std::unique_ptr<language_model> interp_;
+    /// The n-grams of this order and every order below it, which it backs
+    /// off to for smoothing
+    ngram_trie trie_;
 
-    /// Contains the N-gram distribution probabilities (N-1 words -> (w, prob))
-    std::unordered_map
-        <std::string, std::unordered_map<std::string, double>> dist_;
+    /// The id of <unk>, which unknown tokens are scored as
+    uint32_t unk_;
 
     /// The value of N in this n-gram
     size_t N_;
 
-    /// The interpolation coefficient for smoothing LM probabilities
+    /// The interpolation coefficient for smoothing the probabilities of a
+    /// learned model
     constexpr static double lambda_ = 0.7;
 };
 }
@@ -0,0 +1,289 @@
+/**
+ * @file ngram_trie.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_NGRAM_TRIE_H_
+#define META_NGRAM_TRIE_H_
+
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "io/mmap_file.h"
+
+namespace meta
+{
+namespace lm
+{
+/**
+ * The n-grams of every order of a back-off language model, stored over
+ * integer word ids.
+ *
+ * Each context (the n - 1 tokens an n-gram's last token follows) is a
+ * node of a trie read backwards from the last token of the context, so
+ * that walking from the root along the tokens before a position visits
+ * the context of every order in turn. The nodes are laid out one level
+ * after another in sorted arrays, with the children of a node and the
+ * tokens following its context each a contiguous, sorted range, so a
+ * lookup is a binary search per level and allocates nothing. The
+ * probability of each n-gram and the back-off weight of each context
+ * are stored as 16-bit quantized logarithms.
+ *
+ * The arrays have the same layout in memory as in a saved model file, so
+ * a saved model is loaded by memory-mapping it, and its pages are shared
+ * by every process that maps it.
+ */
+class ngram_trie
+{
+  public:
+    /// The probability of each token following each context of
+    /// space-separated tokens
+    using distribution
+        = std::unordered_map<std::string,
+                             std::unordered_map<std::string, double>>;
+
+    /// The back-off weight of each context of space-separated tokens
+    using backoff_weights = std::unordered_map<std::string, double>;
+
+    /**
+     * Creates an empty trie.
+     */
+    ngram_trie();
+
+    /**
+     * Creates the trie of the given distributions.
+     * @param dists The distribution of each order, the unigrams (whose
+     * context is the empty string) first
+     * @param backoffs The back-off weights of the contexts of each
+     * length, the empty context first
+     * @param default_backoff The back-off weight of the contexts that
+     * are not given one
+     */
+    ngram_trie(const std::vector<distribution>& dists,
+               const std::vector<backoff_weights>& backoffs,
+               double default_backoff);
+
+    /**
+     * Loads a trie saved by save() by memory-mapping it.
+     * @param filename The model file
+     * @param res How the file is brought into memory
+     */
+    ngram_trie(const std::string& filename,
+               io::residency res = io::residency::on_demand);
+
+    /**
+     * Move constructor.
+     */
+    ngram_trie(ngram_trie&&) = default;
+
+    /**
+     * Move assignment operator.
+     */
+    ngram_trie& operator=(ngram_trie&&) = default;
+
+    /**
+     * Saves the trie in its binary format.
+     * @param filename The file to write
+     */
+    void save(const std::string& filename) const;
+
+    /**
+     * Reads a model in the ARPA text format.
+     * @param filename The ARPA file
+     * @return the trie of the model
+     */
+    static ngram_trie read_arpa(const std::string& filename);
+
+    /**
+     * Writes the model in the ARPA text format.
+     * @param filename The ARPA file to write
+     */
+    void write_arpa(const std::string& filename) const;
+
+    /**
+     * @return the highest order of the n-grams
+     */
+    uint64_t order() const;
+
+    /**
+     * @param word A token
+     * @return the id of the token, or vocab_size() if it is unknown
+     */
+    uint32_t id(const std::string& word) const;
+
+    /**
+     * @param word The characters of a token, which need not be followed
+     * by a null
+     * @param length The number of characters
+     * @return the id of the token, or vocab_size() if it is unknown
+     */
+    uint32_t id(const char* word, uint64_t length) const;
+
+    /**
+     * @param id The id of a token
+     * @return the token
+     */
+    std::string word(uint32_t id) const;
+
+    /**
+     * @return the number of known tokens
+     */
+    uint32_t vocab_size() const;
+
+    /**
+     * @return the node of the empty context, that of the unigrams
+     */
+    uint64_t root() const
+    {
+        return 0;
+    }
+
+    /**
+     * Moves from a context to the context one token longer.
+     * @param node The node of the context, which is replaced by the node
+     * of the longer one if it exists
+     * @param word The id of the token before the context
+     * @return whether the longer context exists
+     */
+    bool extend(uint64_t& node, uint32_t word) const;
+
+    /**
+     * @param node The node of a context
+     * @param word The id of a token
+     * @return the probability of the token following the context, or a
+     * negative number if it never does
+     */
+    double prob(uint64_t node, uint32_t word) const;
+
+    /**
+     * @param node The node of a context
+     * @return the weight of backing off from the context to a shorter one
+     */
+    double backoff(uint64_t node) const
+    {
+        return decode(node_backoffs_[node], backoff_lo_, backoff_step_);
+    }
+
+    /**
+     * Chooses one of the tokens that follow a context, each in proportion
+     * to its probability, by binary search over a cumulative distribution
+     * stored with them. <unk> is never chosen.
+     * @param node The node of the context
+     * @param random A random number on [0, 1)
+     * @return the id of the token, or vocab_size() if no token can be
+     * chosen
+     */
+    uint32_t sample(uint64_t node, double random) const;
+
+    /**
+     * Calls a function with the id and probability of each token that
+     * follows a context, in order of id.
+     * @param node The node of the context
+     * @param fn The function to call
+     */
+    template <class Function>
+    void each_ending(uint64_t node, Function&& fn) const
+    {
+        for (auto i = ending_begin_[node]; i < ending_begin_[node + 1]; ++i)
+            fn(ending_words_[i],
+               decode(ending_probs_[i], prob_lo_, prob_step_));
+    }
+
+  private:
+    /**
+     * @param q A quantized logarithm
+     * @param lo The smallest logarithm
+     * @param step The size of one quantization step
+     * @return the value
+     */
+    static double decode(uint16_t q, double lo, double step)
+    {
+        return std::exp(lo + q * step);
+    }
+
+    /**
+     * Points the arrays into a model laid out in memory.
+     * @param data The start of the model
+     * @param size The number of bytes of the model
+     */
+    void map(const char* data, uint64_t size);
+
+    /**
+     * Calls a function with every node below a node and the ids of its
+     * context, from the last token back.
+     * @param node The node to start at
+     * @param context The context of the node
+     * @param fn The function to call
+     */
+    void each_context(
+        uint64_t node, std::vector<uint32_t>& context,
+        const std::function<void(uint64_t, const std::vector<uint32_t>&)>& fn)
+        const;
+
+    /// The model, if it was built rather than loaded
+    std::vector<uint64_t> memory_;
+    /// The model file, if it was loaded
+    std::unique_ptr<io::mmap_file> file_;
+
+    /// The highest order of the n-grams
+    uint64_t order_;
+    /// The number of known tokens
+    uint64_t vocab_size_;
+    /// The number of nodes
+    uint64_t num_nodes_;
+    /// The number of n-grams
+    uint64_t num_endings_;
+
+    /// The smallest log probability
+    double prob_lo_;
+    /// The size of one log probability quantization step
+    double prob_step_;
+    /// The smallest log back-off weight
+    double backoff_lo_;
+    /// The size of one log back-off weight quantization step
+    double backoff_step_;
+
+    /// Where each token's characters start, and the total at the end; the
+    /// tokens are sorted, so that a token's id is its position
+    const uint64_t* word_offsets_;
+    /// The characters of the tokens, each followed by a null
+    const char* word_data_;
+    /// The id of the token that begins each node's context
+    const uint32_t* node_words_;
+    /// Where the children of each node start, and the total at the end
+    const uint64_t* child_begin_;
+    /// Where the tokens following each node start, and the total at the
+    /// end
+    const uint64_t* ending_begin_;
+    /// The quantized back-off weight of each node
+    const uint16_t* node_backoffs_;
+    /// The id of each token following each context
+    const uint32_t* ending_words_;
+    /// The quantized probability of each token following each context
+    const uint16_t* ending_probs_;
+    /// The fixed-point cumulative probability of each token following each
+    /// context, up to and including it, for sampling
+    const uint32_t* ending_cumulative_;
+};
+
+/**
+ * Basic exception for ngram_trie interactions.
+ */
+class ngram_trie_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
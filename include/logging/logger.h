@@ -11,13 +11,21 @@
 #ifndef META_LOGGER_H_
 #define META_LOGGER_H_
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <functional>
 #include <iostream>
 #include <iomanip>
+#include <memory>
+#include <mutex>
 #include <sstream>
+#include <thread>
 #include <vector>
 
+#include "parallel/bounded_queue.h"
+
 namespace meta
 {
 
@@ -30,6 +38,13 @@ namespace logging
 /**
  * logger: Main logging class. Keeps track of a list of sinks to write
  * lines to---these can be of any std::ostream-derived type.
+ *
+ * Lines are written to the sinks by the thread that logs them, one line
+ * at a time, unless start_async() has been called. Then they are handed
+ * to a background thread that formats and writes them, in the order
+ * they were logged. The LOG macro asks the logger whether any sink wants
+ * a line of its severity before it formats anything. A line that no sink
+ * wants costs one atomic load.
  */
 class logger
 {
@@ -50,6 +65,24 @@ class logger
         fatal
     };
 
+    /**
+     * @param sev A severity level
+     * @return the bit for that level in a mask of levels
+     */
+    static uint32_t level_bit(severity_level sev)
+    {
+        return uint32_t{1} << static_cast<uint32_t>(sev);
+    }
+
+    /**
+     * @param sev A severity level
+     * @return the mask of that level and every level more severe
+     */
+    static uint32_t levels_from(severity_level sev)
+    {
+        return ~(level_bit(sev) - 1);
+    }
+
     /**
      * Determines the string form of a given severity_level.
      *
@@ -95,11 +128,17 @@ class logger
          */
         log_line(logger& log, severity_level sev, size_t line,
                  const std::string& file)
-            : log_(log), sev_(sev), line_(line), file_(file)
+            : log_(&log), sev_(sev), line_(line), file_(file)
         {
             /* nothing */
         }
 
+        /**
+         * log_line may be move constructed, so that it can be handed to
+         * the background writer.
+         */
+        log_line(log_line&&) = default;
+
         /**
          * Simulates a std::endl, but for log entries. Flushes
          * all internal streams and then writes the log_line to
@@ -143,11 +182,13 @@ class logger
 
         /**
          * Writes the current log line to all sinks of the
-         * logger it was created with.
+         * logger it was created with. When the logger writes
+         * asynchronously, the line is moved to its background writer
+         * and is left empty.
          */
         void write_to_sinks()
         {
-            log_.write_to_sinks(*this);
+            log_->submit(std::move(*this));
         }
 
         /**
@@ -192,7 +233,7 @@ class logger
         /**
          * The logger this log_line is to be written on.
          */
-        logger& log_;
+        logger* log_;
 
         /**
          * The severity of this message.
@@ -210,6 +251,22 @@ class logger
         std::string file_;
     };
 
+    /**
+     * Ends the expression the LOG macro expands to, so that the line is
+     * only built when its severity is enabled: LOG(sev) << ... << ENDLG
+     * becomes a conditional expression whose operands are both void.
+     */
+    struct discard_line
+    {
+        /**
+         * Does nothing with a finished line.
+         */
+        void operator&(log_line&)
+        {
+            // nothing
+        }
+    };
+
     /**
      * sink: A wrapper for a stream that a logger should write to.
      */
@@ -238,11 +295,18 @@ class logger
          * the log_lines written to the stream
          * @param filter The filtering function used to determine if a
          * given log_line should be written to the stream or not
+         * @param levels The mask of the severity levels the filter may
+         * accept (see level_bit()); lines of other levels are not even
+         * formatted
          */
         sink(std::ostream& stream, const filter_func& filter =
             [](const log_line&) { return true; },
-            const formatter_func& formatter = &default_formatter)
-            : stream_(stream), formatter_(formatter), filter_(filter)
+            const formatter_func& formatter = &default_formatter,
+            uint32_t levels = ~uint32_t{0})
+            : stream_(stream),
+              formatter_(formatter),
+              filter_(filter),
+              levels_(levels)
         {
             /* nothing */
         }
@@ -263,11 +327,20 @@ class logger
             : stream_(stream),
               formatter_(formatter),
               filter_([sev](const log_line& ll)
-                  { return ll.severity() >= sev; })
+                  { return ll.severity() >= sev; }),
+              levels_(levels_from(sev))
         {
             // nothing
         }
 
+        /**
+         * @return the mask of the severity levels this sink may write
+         */
+        uint32_t levels() const
+        {
+            return levels_;
+        }
+
         /**
          * Writes the given log_line to the stream, formatting and
          * filtering it as necessary.
@@ -333,8 +406,99 @@ class logger
          * The filtering functor.
          */
         filter_func filter_;
+
+        /**
+         * The mask of the severity levels the filter may accept.
+         */
+        uint32_t levels_;
     };
 
+    /**
+     * Creates a logger without sinks, which writes synchronously.
+     */
+    logger() : levels_{0}, submitted_{0}, written_{0}
+    {
+        // nothing
+    }
+
+    /**
+     * Writes the lines still waiting for the background writer, if any.
+     */
+    ~logger()
+    {
+        stop_async();
+    }
+
+    /**
+     * @param sev A severity level
+     * @return whether any sink may write lines of that level
+     */
+    bool enabled(severity_level sev) const
+    {
+        return (levels_.load(std::memory_order_relaxed) & level_bit(sev))
+               != 0;
+    }
+
+    /**
+     * Starts writing lines on a background thread, so that logging a
+     * line only hands it over. Sinks must not be added while the
+     * background writer runs.
+     *
+     * @param capacity The number of lines that may wait to be written;
+     * threads logging more lines than that wait for the writer
+     */
+    void start_async(std::size_t capacity = 4096)
+    {
+        std::lock_guard<std::mutex> lock{async_mutex_};
+        if (writer_.joinable())
+            return;
+        auto queue = std::make_shared<line_queue>(capacity);
+        store_queue(queue);
+        writer_ = std::thread{[this, queue]()
+                              {
+            std::shared_ptr<log_line> line;
+            while (queue->pop(line))
+            {
+                write_to_sinks(*line);
+                line = nullptr;
+                std::lock_guard<std::mutex> lock{flush_mutex_};
+                ++written_;
+                flushed_.notify_all();
+            }
+        }};
+        async_.store(true);
+    }
+
+    /**
+     * Waits until every line logged so far has been written.
+     */
+    void flush()
+    {
+        auto target = submitted_.load();
+        std::unique_lock<std::mutex> lock{flush_mutex_};
+        flushed_.wait(lock, [&]()
+                      {
+            return !async_.load() || written_ >= target;
+        });
+    }
+
+    /**
+     * Writes the lines waiting for the background writer and stops it;
+     * lines are written synchronously again afterwards.
+     */
+    void stop_async()
+    {
+        std::lock_guard<std::mutex> lock{async_mutex_};
+        if (!writer_.joinable())
+            return;
+        async_.store(false);
+        load_queue()->close();
+        writer_.join();
+        store_queue(nullptr);
+        std::lock_guard<std::mutex> flush_lock{flush_mutex_};
+        flushed_.notify_all();
+    }
+
     /**
      * Adds a sink to the given logger.
      *
@@ -343,6 +507,7 @@ class logger
     void add_sink(const sink& s)
     {
         sinks_.push_back(s);
+        levels_.fetch_or(s.levels());
     }
 
     /**
@@ -352,6 +517,7 @@ class logger
      */
     void add_sink(sink&& s)
     {
+        levels_.fetch_or(s.levels());
         sinks_.emplace_back(std::move(s));
     }
 
@@ -362,15 +528,132 @@ class logger
      */
     void write_to_sinks(const log_line& line)
     {
+        std::lock_guard<std::mutex> lock{write_mutex_};
         for (sink& s : sinks_)
             s.write(line);
     }
 
+    /**
+     * Writes a finished log_line: hands it to the background writer if
+     * there is one, or writes it to all sinks otherwise.
+     *
+     * @param line The log_line to write
+     */
+    void submit(log_line&& line)
+    {
+        // the queue is held for the whole hand-over, so a writer started
+        // or stopped meanwhile can only close it, never free it
+        auto queue = async_.load(std::memory_order_acquire) ? load_queue()
+                                                            : nullptr;
+        if (queue)
+        {
+            auto queued = std::make_shared<log_line>(std::move(line));
+            ++submitted_;
+            if (queue->push(queued))
+                return;
+
+            // the writer was stopped meanwhile
+            --submitted_;
+            write_to_sinks(*queued);
+            return;
+        }
+        write_to_sinks(line);
+    }
+
   private:
+    /// the queue of lines waiting for the background writer
+    using line_queue = parallel::bounded_queue<std::shared_ptr<log_line>>;
+
+    /**
+     * @return the queue of the background writer, if there is one
+     */
+    std::shared_ptr<line_queue> load_queue()
+    {
+#if META_HAS_STD_SHARED_PTR_ATOMICS
+        return std::atomic_load(&queue_);
+#else
+        std::lock_guard<std::mutex> lock{queue_mutex_};
+        return queue_;
+#endif
+    }
+
+    /**
+     * Replaces the queue of the background writer.
+     * @param queue The new queue, or nullptr if there is no writer
+     */
+    void store_queue(std::shared_ptr<line_queue> queue)
+    {
+#if META_HAS_STD_SHARED_PTR_ATOMICS
+        std::atomic_store(&queue_, std::move(queue));
+#else
+        std::lock_guard<std::mutex> lock{queue_mutex_};
+        queue_ = std::move(queue);
+#endif
+    }
+
     /**
      * The list of sinks to write to.
      */
     std::vector<sink> sinks_;
+
+    /**
+     * The mask of the severity levels any sink may write.
+     */
+    std::atomic<uint32_t> levels_;
+
+    /**
+     * Serializes writes to the sinks.
+     */
+    std::mutex write_mutex_;
+
+    /**
+     * Whether lines go to the background writer.
+     */
+    std::atomic<bool> async_{false};
+
+    /**
+     * Serializes starting and stopping the background writer.
+     */
+    std::mutex async_mutex_;
+
+    /**
+     * The lines waiting for the background writer. Threads that log take
+     * their own reference to it (see load_queue()), so it outlives any
+     * hand-over in progress when the writer is replaced.
+     */
+    std::shared_ptr<line_queue> queue_;
+
+#if !META_HAS_STD_SHARED_PTR_ATOMICS
+    /**
+     * Protects queue_ where shared_ptr has no atomic operations.
+     */
+    std::mutex queue_mutex_;
+#endif
+
+    /**
+     * The background writer.
+     */
+    std::thread writer_;
+
+    /**
+     * The number of lines handed to the background writer.
+     */
+    std::atomic<uint64_t> submitted_;
+
+    /**
+     * The number of lines the background writer has written.
+     */
+    uint64_t written_;
+
+    /**
+     * Protects written_.
+     */
+    std::mutex flush_mutex_;
+
+    /**
+     * Signaled when the background writer writes a line or stops.
+     */
+    std::condition_variable flushed_;
 };
 
 /**
@@ -415,7 +698,7 @@ inline void set_cerr_logging(logging::logger::severity_level sev
         return ll.severity() == logger::severity_level::progress;
     }, [](const logger::log_line& ll) {
         return " " + ll.str();
-    }});
+    }, logger::level_bit(logger::severity_level::progress)});
 
     add_sink({std::cerr, sev});
 }
@@ -423,9 +706,12 @@ inline void set_cerr_logging(logging::logger::severity_level sev
 }
 
 #define LOG(sev)                                                               \
-    logging::logger::log_line(logging::get_logger(),                           \
-                              logging::logger::severity_level::sev, __LINE__,  \
-                              __FILE__)
+    !logging::get_logger().enabled(logging::logger::severity_level::sev)       \
+        ? (void)0                                                              \
+        : logging::logger::discard_line{}                                      \
+              & logging::logger::log_line(                                     \
+                    logging::get_logger(),                                     \
+                    logging::logger::severity_level::sev, __LINE__, __FILE__)
 #define ENDLG logging::logger::log_line::endlg
 #define LOG_FUNCTION_START()                                                   \
     LOG(trace) << "entering " << __func__ << "()" << ENDLG
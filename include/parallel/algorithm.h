@@ -0,0 +1,286 @@
+/**
+ * @file algorithm.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_PARALLEL_ALGORITHM_H_
+#define META_PARALLEL_ALGORITHM_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include <vector>
+
+#include "parallel/default_pool.h"
+#include "parallel/parallel_for.h"
+#include "parallel/thread_pool.h"
+
+namespace meta
+{
+namespace parallel
+{
+namespace internal
+{
+/// Ranges shorter than this are handled serially, since the threads
+/// would cost more than they save
+const uint64_t serial_cutoff = 1 << 14;
+
+/**
+ * Orders values with operator<.
+ */
+struct less
+{
+    template <class T, class U>
+    bool operator()(const T& a, const U& b) const
+    {
+        return a < b;
+    }
+};
+
+/**
+ * Finds where the first k elements of the stable merge of two sorted
+ * ranges come from.
+ * @param first1 The first range
+ * @param size1 Its length
+ * @param first2 The second range
+ * @param size2 Its length
+ * @param k The number of elements of the merge
+ * @param comp The ordering of the ranges
+ * @return how many of the k elements are from the first range
+ */
+template <class It1, class It2, class Compare>
+uint64_t co_rank(It1 first1, uint64_t size1, It2 first2, uint64_t size2,
+                 uint64_t k, Compare& comp)
+{
+    auto lo = k > size2 ? k - size2 : 0;
+    auto hi = std::min(k, size1);
+    while (lo < hi)
+    {
+        auto i = lo + (hi - lo) / 2;
+        auto j = k - i;
+        // ties go to the first range, so its element i belongs in the
+        // prefix when it is no greater than element j - 1 of the second
+        if (j > 0 && i < size1 && !comp(first2[j - 1], first1[i]))
+            lo = i + 1;
+        else
+            hi = i;
+    }
+    return lo;
+}
+}
+
+/**
+ * Merges two sorted ranges into an output range in parallel. The output is
+ * cut into one piece per thread at positions found by binary search in
+ * the inputs, and the pieces are merged at the same time. As with
+ * std::merge, equal elements of the first range come before those of the
+ * second.
+ * @param first1 The start of the first range
+ * @param last1 The end of the first range
+ * @param first2 The start of the second range
+ * @param last2 The end of the second range
+ * @param out The start of the output, which may not overlap the inputs
+ * @param pool The thread pool to use
+ * @param comp The ordering of the ranges
+ * @return the end of the output
+ */
+template <class It1, class It2, class OutputIt, class Compare>
+OutputIt merge(It1 first1, It1 last1, It2 first2, It2 last2, OutputIt out,
+               thread_pool& pool, Compare comp)
+{
+    auto size1 = static_cast<uint64_t>(last1 - first1);
+    auto size2 = static_cast<uint64_t>(last2 - first2);
+    auto total = size1 + size2;
+    auto num_pieces = pool.thread_ids().size();
+    if (total < internal::serial_cutoff || num_pieces == 1)
+        return std::merge(first1, last1, first2, last2, out, comp);
+
+    parallel_chunks(pool, num_pieces, 1,
+                    [&](uint64_t, uint64_t piece, uint64_t)
+                    {
+        auto k_first = total * piece / num_pieces;
+        auto k_last = total * (piece + 1) / num_pieces;
+        auto i_first
+            = internal::co_rank(first1, size1, first2, size2, k_first, comp);
+        auto i_last
+            = internal::co_rank(first1, size1, first2, size2, k_last, comp);
+        std::merge(first1 + i_first, first1 + i_last,
+                   first2 + (k_first - i_first), first2 + (k_last - i_last),
+                   out + k_first, comp);
+    });
+    return out + total;
+}
+
+/**
+ * Merges two sorted ranges into an output range in parallel, on the
+ * default_pool().
+ */
+template <class It1, class It2, class OutputIt, class Compare>
+OutputIt merge(It1 first1, It1 last1, It2 first2, It2 last2, OutputIt out,
+               Compare comp)
+{
+    return merge(first1, last1, first2, last2, out, default_pool(), comp);
+}
+
+/**
+ * Merges two ranges sorted by operator< into an output range in parallel,
+ * on the default_pool().
+ */
+template <class It1, class It2, class OutputIt>
+OutputIt merge(It1 first1, It1 last1, It2 first2, It2 last2, OutputIt out)
+{
+    return merge(first1, last1, first2, last2, out, default_pool(),
+                 internal::less{});
+}
+
+/**
+ * Sorts a random access range in parallel. Each thread sorts one run of
+ * the range with std::sort, and the runs are then merged in pairs with
+ * merge(), back and forth between the range and a buffer. Like std::sort,
+ * it is not stable.
+ * @param begin The start of the range
+ * @param end The end of the range
+ * @param pool The thread pool to use
+ * @param comp The ordering to sort by
+ */
+template <class RandomIt, class Compare>
+void sort(RandomIt begin, RandomIt end, thread_pool& pool, Compare comp)
+{
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+
+    auto size = static_cast<uint64_t>(end - begin);
+    auto num_threads = pool.thread_ids().size();
+    if (size < internal::serial_cutoff || num_threads == 1)
+    {
+        std::sort(begin, end, comp);
+        return;
+    }
+
+    auto run = (size + num_threads - 1) / num_threads;
+    parallel_chunks(pool, size, run,
+                    [&](uint64_t, uint64_t first, uint64_t last)
+                    {
+        std::sort(begin + first, begin + last, comp);
+    });
+
+    std::vector<value_type> buffer(std::make_move_iterator(begin),
+                                   std::make_move_iterator(end));
+    auto in_buffer = true;
+    for (; run < size; run *= 2)
+    {
+        for (uint64_t first = 0; first < size; first += 2 * run)
+        {
+            auto mid = std::min(first + run, size);
+            auto last = std::min(first + 2 * run, size);
+            if (in_buffer)
+            {
+                auto src = std::make_move_iterator(buffer.begin());
+                merge(src + first, src + mid, src + mid, src + last,
+                      begin + first, pool, comp);
+            }
+            else
+            {
+                auto src = std::make_move_iterator(begin);
+                merge(src + first, src + mid, src + mid, src + last,
+                      buffer.begin() + first, pool, comp);
+            }
+        }
+        in_buffer = !in_buffer;
+    }
+
+    if (in_buffer)
+        std::move(buffer.begin(), buffer.end(), begin);
+}
+
+/**
+ * Sorts a random access range in parallel, on the default_pool().
+ */
+template <class RandomIt, class Compare>
+void sort(RandomIt begin, RandomIt end, Compare comp)
+{
+    sort(begin, end, default_pool(), comp);
+}
+
+/**
+ * Sorts a random access range by operator< in parallel, on the
+ * default_pool().
+ */
+template <class RandomIt>
+void sort(RandomIt begin, RandomIt end)
+{
+    sort(begin, end, default_pool(), internal::less{});
+}
+
+/**
+ * Moves the elements of a random access range that satisfy a predicate
+ * before those that do not, in parallel, keeping the order of each group.
+ * The predicate is called once for each element, on blocks of the range
+ * at the same time; the elements are then moved to a buffer and back to
+ * their places.
+ * @param begin The start of the range
+ * @param end The end of the range
+ * @param pool The thread pool to use
+ * @param pred The predicate
+ * @return the end of the elements that satisfy the predicate
+ */
+template <class RandomIt, class Predicate>
+RandomIt stable_partition(RandomIt begin, RandomIt end, thread_pool& pool,
+                          Predicate pred)
+{
+    using value_type = typename std::iterator_traits<RandomIt>::value_type;
+
+    auto size = static_cast<uint64_t>(end - begin);
+    auto num_threads = pool.thread_ids().size();
+    if (size < internal::serial_cutoff || num_threads == 1)
+        return std::stable_partition(begin, end, pred);
+
+    auto block = (size + 4 * num_threads - 1) / (4 * num_threads);
+    auto num_blocks = (size + block - 1) / block;
+    std::vector<uint8_t> chosen(size);
+    std::vector<uint64_t> counts(num_blocks + 1, 0);
+    parallel_chunks(pool, size, block,
+                    [&](uint64_t, uint64_t first, uint64_t last)
+                    {
+        uint64_t count = 0;
+        for (auto i = first; i < last; ++i)
+        {
+            chosen[i] = pred(begin[i]) ? 1 : 0;
+            count += chosen[i];
+        }
+        counts[first / block + 1] = count;
+    });
+
+    // counts[b] becomes the number of chosen elements before block b
+    for (uint64_t b = 0; b < num_blocks; ++b)
+        counts[b + 1] += counts[b];
+    auto num_chosen = counts[num_blocks];
+
+    std::vector<value_type> buffer(std::make_move_iterator(begin),
+                                   std::make_move_iterator(end));
+    parallel_chunks(pool, size, block,
+                    [&](uint64_t, uint64_t first, uint64_t last)
+                    {
+        auto yes = counts[first / block];
+        auto no = num_chosen + (first - yes);
+        for (auto i = first; i < last; ++i)
+            begin[chosen[i] ? yes++ : no++] = std::move(buffer[i]);
+    });
+    return begin + num_chosen;
+}
+
+/**
+ * Partitions a random access range in parallel, keeping the order of each
+ * group, on the default_pool().
+ */
+template <class RandomIt, class Predicate>
+RandomIt stable_partition(RandomIt begin, RandomIt end, Predicate pred)
+{
+    return stable_partition(begin, end, default_pool(), pred);
+}
+}
+}
+
+#endif
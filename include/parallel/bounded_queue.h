@@ -0,0 +1,123 @@
+/**
+ * @file bounded_queue.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_PARALLEL_BOUNDED_QUEUE_H_
+#define META_PARALLEL_BOUNDED_QUEUE_H_
+
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <queue>
+
+namespace meta
+{
+namespace parallel
+{
+
+/**
+ * A first-in first-out queue that can be shared by any number of
+ * producing and consuming threads. Producers block while the queue is
+ * full, which bounds the memory used when they outpace the consumers, and
+ * consumers block while it is empty. Closing the queue wakes everyone up:
+ * consumers then drain the remaining items and producers give up.
+ */
+template <class T>
+class bounded_queue
+{
+  public:
+    /**
+     * @param capacity The largest number of items the queue may hold
+     */
+    bounded_queue(std::size_t capacity) : capacity_{capacity}, closed_{false}
+    {
+        // nothing
+    }
+
+    /**
+     * Adds an item to the back of the queue, waiting for room if the
+     * queue is full.
+     * @param item The item to add
+     * @return false if the queue was closed, in which case the item was
+     * not added
+     */
+    bool push(T item)
+    {
+        {
+            std::unique_lock<std::mutex> lock{mutex_};
+            not_full_.wait(lock, [&]()
+                           {
+                return closed_ || items_.size() < capacity_;
+            });
+            if (closed_)
+                return false;
+            items_.push(std::move(item));
+        }
+        not_empty_.notify_one();
+        return true;
+    }
+
+    /**
+     * Removes the item at the front of the queue, waiting for one if the
+     * queue is empty.
+     * @param item Where to store the removed item
+     * @return false if the queue was closed and is empty
+     */
+    bool pop(T& item)
+    {
+        {
+            std::unique_lock<std::mutex> lock{mutex_};
+            not_empty_.wait(lock, [&]()
+                            {
+                return closed_ || !items_.empty();
+            });
+            if (items_.empty())
+                return false;
+            item = std::move(items_.front());
+            items_.pop();
+        }
+        not_full_.notify_one();
+        return true;
+    }
+
+    /**
+     * Closes the queue: no more items may be pushed, and pop() returns
+     * false once the items already in the queue have been removed.
+     */
+    void close()
+    {
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            closed_ = true;
+        }
+        not_full_.notify_all();
+        not_empty_.notify_all();
+    }
+
+  private:
+    /// the items in the queue
+    std::queue<T> items_;
+
+    /// the largest number of items the queue may hold
+    const std::size_t capacity_;
+
+    /// whether the queue has been closed
+    bool closed_;
+
+    /// protects the queue
+    std::mutex mutex_;
+
+    /// signaled when an item is removed or the queue is closed
+    std::condition_variable not_full_;
+
+    /// signaled when an item is added or the queue is closed
+    std::condition_variable not_empty_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,144 @@
+/**
+ * @file default_pool.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_PARALLEL_DEFAULT_POOL_H_
+#define META_PARALLEL_DEFAULT_POOL_H_
+
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "cpptoml.h"
+#include "parallel/thread_pool.h"
+#include "util/shim.h"
+
+namespace meta
+{
+namespace parallel
+{
+
+/**
+ * Exception thrown when the default thread pool is misconfigured.
+ */
+class default_pool_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+namespace internal
+{
+/**
+ * The state behind default_pool().
+ */
+struct default_pool_state
+{
+    /// guards the other members
+    std::mutex mutex;
+    /// the number of threads the pool is made with
+    size_t num_threads = std::thread::hardware_concurrency();
+    /// where the threads of the pool may run
+    placement where = placement::none;
+    /// the pool, once it has been made
+    std::unique_ptr<thread_pool> pool;
+};
+
+/**
+ * @return the process-wide state of the default pool
+ */
+inline default_pool_state& default_state()
+{
+    static default_pool_state state;
+    return state;
+}
+}
+
+/**
+ * Sets the number of threads of the default pool. The pool is made the
+ * first time it is used, so this must be called before then.
+ * @param num_threads The number of threads
+ */
+inline void set_default_threads(size_t num_threads)
+{
+    if (num_threads == 0)
+        throw default_pool_exception{"thread pool must have a thread"};
+
+    auto& state = internal::default_state();
+    std::lock_guard<std::mutex> lock{state.mutex};
+    if (state.pool && state.pool->thread_ids().size() != num_threads)
+        throw default_pool_exception{
+            "default thread pool is already running"};
+    state.num_threads = num_threads;
+}
+
+/**
+ * Sets where the threads of the default pool may run. The pool is made
+ * the first time it is used, so this must be called before then.
+ * @param where The placement of the threads
+ */
+inline void set_default_placement(placement where)
+{
+    auto& state = internal::default_state();
+    std::lock_guard<std::mutex> lock{state.mutex};
+    if (state.pool && state.where != where)
+        throw default_pool_exception{
+            "default thread pool is already running"};
+    state.where = where;
+}
+
+/**
+ * Sets the number of threads of the default pool from the "num-threads"
+ * key of a configuration, and where they run from its "thread-placement"
+ * key ("none", "nodes", or "cpus"; see placement), for the keys it has.
+ * @param config The configuration
+ */
+inline void configure_default_pool(const cpptoml::table& config)
+{
+    if (auto where = config.get_as<std::string>("thread-placement"))
+    {
+        if (*where == "none")
+            set_default_placement(placement::none);
+        else if (*where == "nodes")
+            set_default_placement(placement::nodes);
+        else if (*where == "cpus")
+            set_default_placement(placement::cpus);
+        else
+            throw default_pool_exception{"unknown thread-placement: "
+                                         + *where};
+    }
+
+    auto num_threads = config.get_as<int64_t>("num-threads");
+    if (!num_threads)
+        return;
+    if (*num_threads <= 0)
+        throw default_pool_exception{"num-threads must be positive"};
+    set_default_threads(static_cast<size_t>(*num_threads));
+}
+
+/**
+ * The thread pool that parallel algorithms use when none is passed to
+ * them, shared by the whole process so that its threads are only started
+ * once. It has one unplaced thread per core unless set_default_threads(),
+ * set_default_placement() or configure_default_pool() said otherwise
+ * before its first use.
+ * @return the default thread pool
+ */
+inline thread_pool& default_pool()
+{
+    auto& state = internal::default_state();
+    std::lock_guard<std::mutex> lock{state.mutex};
+    if (!state.pool)
+        state.pool = make_unique<thread_pool>(state.num_threads, state.where);
+    return *state.pool;
+}
+}
+}
+
+#endif
@@ -11,10 +11,13 @@
 #define META_PARALLEL_FOR_H_
 
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
 #include <iterator>
 #include <thread>
 #include <vector>
 
+#include "parallel/default_pool.h"
 #include "parallel/thread_pool.h"
 
 namespace meta
@@ -23,37 +26,120 @@ namespace parallel
 {
 
 /**
- * Runs the given function on the range denoted by begin and end in parallel.
- * @param begin The first element to operate on
- * @param end One past the last element to operate on
- * @param func The function to perform on each element
+ * Splits the indices [0, size) into chunks, which one task on each thread
+ * of the pool claims in turn until none are left. Threads that draw cheap
+ * chunks simply claim more of them, so skewed costs per index (long
+ * documents, high-degree nodes) do not leave threads idle.
+ *
+ * The callback is told which task runs each chunk; no two chunks run on
+ * the same task at once, so per-task state (such as an accumulator) can
+ * be kept in an array indexed by it without locking. Task t is given to
+ * worker t of the pool, so per-task state made by for_each_worker() is
+ * usually on the node of the thread that uses it.
+ *
+ * @param pool The thread pool to use
+ * @param size The number of indices
+ * @param grain The number of indices in a chunk; 0 picks a size that
+ * gives each thread several chunks
+ * @param fn Called as fn(task, first, last) for each chunk [first, last),
+ * where task is less than the number of threads of the pool
  */
-template <class Iterator, class Function>
-void parallel_for(Iterator begin, Iterator end, Function func)
+template <class Function>
+void parallel_chunks(thread_pool& pool, uint64_t size, uint64_t grain,
+                     Function&& fn)
 {
-    thread_pool pool;
-    parallel_for(begin, end, pool, func);
+    if (size == 0)
+        return;
+
+    auto num_threads = pool.thread_ids().size();
+    if (grain == 0)
+        grain = std::max<uint64_t>(1, size / (16 * num_threads));
+    auto num_chunks = (size + grain - 1) / grain;
+    auto num_tasks = std::min<uint64_t>(num_threads, num_chunks);
+
+    std::atomic<uint64_t> next{0};
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_tasks);
+    for (uint64_t t = 0; t < num_tasks; ++t)
+    {
+        futures.emplace_back(pool.submit_to(t, [&, t]()
+        {
+            for (auto c = next++; c < num_chunks; c = next++)
+            {
+                auto first = c * grain;
+                fn(t, first, std::min(first + grain, size));
+            }
+        }));
+    }
+
+    for (auto& fut : futures)
+        pool.wait(fut);
+    for (auto& fut : futures)
+        fut.get();
 }
 
 /**
- * Runs the given function on the range denoted by begin and end in parallel.
- * @param begin The first element to operate on
- * @param end One past the last element to operate on
+ * Runs a function once for each worker of a pool, on that worker unless
+ * another one steals it. Large per-thread buffers allocated this way are
+ * first touched, and so placed in memory, on the node of the thread that
+ * will use them.
  * @param pool The thread pool to use
- * @param func The function to perform on each element
+ * @param fn Called as fn(worker) for each worker position
+ */
+template <class Function>
+void for_each_worker(thread_pool& pool, Function&& fn)
+{
+    auto num_threads = pool.thread_ids().size();
+    std::vector<std::future<void>> futures;
+    futures.reserve(num_threads);
+    for (uint64_t w = 0; w < num_threads; ++w)
+    {
+        futures.emplace_back(pool.submit_to(w, [&, w]()
+                                            {
+            fn(w);
+        }));
+    }
+
+    for (auto& fut : futures)
+        pool.wait(fut);
+    for (auto& fut : futures)
+        fut.get();
+}
+
+namespace internal
+{
+/**
+ * Runs func on each element of a random access range, in dynamically
+ * claimed chunks.
+ */
+template <class Iterator, class Function>
+void parallel_for(Iterator begin, Iterator end, thread_pool& pool,
+                  Function& func, uint64_t grain,
+                  std::random_access_iterator_tag)
+{
+    parallel_chunks(pool, static_cast<uint64_t>(std::distance(begin, end)),
+                    grain, [&](uint64_t, uint64_t first, uint64_t last)
+                    {
+        std::for_each(begin + first, begin + last, func);
+    });
+}
+
+/**
+ * Runs func on each element of a range that can only be walked forward,
+ * in one contiguous block per thread, since finding the start of a chunk
+ * takes time proportional to its position.
  */
 template <class Iterator, class Function>
 void parallel_for(Iterator begin, Iterator end, thread_pool& pool,
-                  Function func)
+                  Function& func, uint64_t, std::forward_iterator_tag)
 {
-    auto block_size = std::distance(begin, end)
-                      / std::thread::hardware_concurrency();
+    auto num_threads = pool.thread_ids().size();
+    auto block_size = std::distance(begin, end) / num_threads;
 
     Iterator last = begin;
     if (block_size > 0)
     {
-        std::advance(last,
-                     (std::thread::hardware_concurrency() - 1) * block_size);
+        std::advance(last, (num_threads - 1) * block_size);
     }
     else
     {
@@ -76,7 +162,124 @@ void parallel_for(Iterator begin, Iterator end, thread_pool& pool,
     futures.emplace_back(pool.submit_task([=]()
     { std::for_each(begin, end, func); }));
     for (auto& fut : futures)
+    {
+        pool.wait(fut);
         fut.get();
+    }
+}
+}
+
+/**
+ * Runs the given function on the range denoted by begin and end in parallel.
+ * A random access range is split into chunks that the threads claim as
+ * they finish their previous ones (see parallel_chunks); any other range is
+ * split into one equal block per thread.
+ * @param begin The first element to operate on
+ * @param end One past the last element to operate on
+ * @param pool The thread pool to use
+ * @param func The function to perform on each element
+ * @param grain The number of elements in a chunk; 0 picks one
+ */
+template <class Iterator, class Function>
+void parallel_for(Iterator begin, Iterator end, thread_pool& pool,
+                  Function func, uint64_t grain = 0)
+{
+    internal::parallel_for(
+        begin, end, pool, func, grain,
+        typename std::iterator_traits<Iterator>::iterator_category{});
+}
+
+/**
+ * Runs the given function on the range denoted by begin and end in
+ * parallel, on the default_pool().
+ * @param begin The first element to operate on
+ * @param end One past the last element to operate on
+ * @param func The function to perform on each element
+ */
+template <class Iterator, class Function>
+void parallel_for(Iterator begin, Iterator end, Function func)
+{
+    parallel_for(begin, end, default_pool(), func);
+}
+
+/**
+ * Reduces a random access range in parallel. Each task of the pool folds
+ * the chunks it claims into an accumulator of its own, starting from a
+ * copy of identity, and the accumulators are then combined in task order.
+ * Which elements go to which accumulator depends on the scheduling of the
+ * threads, so combine should be associative and commutative.
+ * @param begin The first element to operate on
+ * @param end One past the last element to operate on
+ * @param pool The thread pool to use
+ * @param identity The initial value of each accumulator
+ * @param fn Called as fn(accumulator, element) to fold in each element
+ * @param combine Called as combine(total, accumulator) to fold each
+ * task's accumulator into the result
+ * @param grain The number of elements in a chunk; 0 picks one
+ * @return the combined accumulators
+ */
+template <class Iterator, class T, class Function, class Combine>
+T parallel_reduce(Iterator begin, Iterator end, thread_pool& pool,
+                  T identity, Function fn, Combine combine,
+                  uint64_t grain = 0)
+{
+    std::vector<T> partial(pool.thread_ids().size(), identity);
+    parallel_chunks(pool, static_cast<uint64_t>(std::distance(begin, end)),
+                    grain, [&](uint64_t task, uint64_t first, uint64_t last)
+                    {
+        auto& acc = partial[task];
+        for (auto it = begin + first; it != begin + last; ++it)
+            fn(acc, *it);
+    });
+
+    for (auto& part : partial)
+        combine(identity, part);
+    return identity;
+}
+
+/**
+ * Reduces a random access range in parallel on the default_pool(); see
+ * the overload that takes a pool.
+ */
+template <class Iterator, class T, class Function, class Combine>
+T parallel_reduce(Iterator begin, Iterator end, T identity, Function fn,
+                  Combine combine)
+{
+    return parallel_reduce(begin, end, default_pool(), std::move(identity),
+                           fn, combine);
+}
+
+/**
+ * Writes fn(element) for each element of a random access range to the
+ * same position of an output range, in parallel.
+ * @param begin The first element to operate on
+ * @param end One past the last element to operate on
+ * @param out The start of the output range, which must be random access
+ * and as long as the input
+ * @param pool The thread pool to use
+ * @param fn The function to apply
+ * @param grain The number of elements in a chunk; 0 picks one
+ */
+template <class Iterator, class OutputIterator, class Function>
+void parallel_transform(Iterator begin, Iterator end, OutputIterator out,
+                        thread_pool& pool, Function fn, uint64_t grain = 0)
+{
+    parallel_chunks(pool, static_cast<uint64_t>(std::distance(begin, end)),
+                    grain, [&](uint64_t, uint64_t first, uint64_t last)
+                    {
+        std::transform(begin + first, begin + last, out + first, fn);
+    });
+}
+
+/**
+ * Transforms a random access range in parallel on the default_pool(); see
+ * the overload that takes a pool.
+ */
+template <class Iterator, class OutputIterator, class Function>
+void parallel_transform(Iterator begin, Iterator end, OutputIterator out,
+                        Function fn)
+{
+    parallel_transform(begin, end, out, default_pool(), fn);
 }
 }
 }
@@ -0,0 +1,130 @@
+/**
+ * @file stage_counter.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_PARALLEL_STAGE_COUNTER_H_
+#define META_PARALLEL_STAGE_COUNTER_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+
+namespace meta
+{
+namespace parallel
+{
+
+/**
+ * Thread-safe throughput counters for one stage of a pipeline. They record
+ * how many items the stage processed, how long it spent working on them,
+ * and how long it spent waiting on its neighbors. Times are summed over
+ * every thread running the stage. A stage that waits a lot is being held
+ * up by another one; the stage that rarely waits is the bottleneck.
+ */
+class stage_counter
+{
+  public:
+    /// The clock used to time the stage
+    using clock = std::chrono::steady_clock;
+
+    /**
+     * Creates a counter with nothing recorded.
+     */
+    stage_counter() : items_{0}, busy_{0}, waiting_{0}
+    {
+        // nothing
+    }
+
+    /**
+     * @param items The number of items processed
+     * @param busy The time spent processing them
+     */
+    void add_work(uint64_t items, clock::duration busy)
+    {
+        items_ += items;
+        busy_ += nanoseconds(busy);
+    }
+
+    /**
+     * @param waited The time spent waiting on another stage
+     */
+    void add_wait(clock::duration waited)
+    {
+        waiting_ += nanoseconds(waited);
+    }
+
+    /**
+     * @return the number of items processed
+     */
+    uint64_t items() const
+    {
+        return items_.load();
+    }
+
+    /**
+     * @return the number of seconds spent processing items
+     */
+    double busy_seconds() const
+    {
+        return busy_.load() / 1e9;
+    }
+
+    /**
+     * @return the number of seconds spent waiting on other stages
+     */
+    double wait_seconds() const
+    {
+        return waiting_.load() / 1e9;
+    }
+
+    /**
+     * @return the number of items processed per second of work
+     */
+    double throughput() const
+    {
+        auto busy = busy_seconds();
+        return busy > 0 ? items() / busy : 0;
+    }
+
+  private:
+    /**
+     * @param duration A duration
+     * @return the duration in nanoseconds
+     */
+    static uint64_t nanoseconds(clock::duration duration)
+    {
+        return static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(duration)
+                .count());
+    }
+
+    /// the number of items processed
+    std::atomic<uint64_t> items_;
+
+    /// the nanoseconds spent processing items
+    std::atomic<uint64_t> busy_;
+
+    /// the nanoseconds spent waiting on other stages
+    std::atomic<uint64_t> waiting_;
+};
+
+/**
+ * @param os The stream to write to
+ * @param counter The counter to summarize
+ * @return the stream
+ */
+inline std::ostream& operator<<(std::ostream& os, const stage_counter& counter)
+{
+    return os << counter.items() << " items in " << counter.busy_seconds()
+              << "s of work (" << counter.throughput() << "/s), "
+              << counter.wait_seconds() << "s waiting";
+}
+}
+}
+
+#endif
@@ -13,22 +13,62 @@
 #ifndef META_THREAD_POOL_H_
 #define META_THREAD_POOL_H_
 
+#include <atomic>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
+#include <new>
 #include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
-#include <functional>
-#include <queue>
-#include <future>
+
+#include "parallel/topology.h"
+#include "util/shim.h"
+#include "util/trace.h"
 
 namespace meta
 {
 namespace parallel
 {
 
+/**
+ * Where the threads of a thread_pool may run.
+ */
+enum class placement
+{
+    /// wherever the operating system puts them
+    none,
+    /// each thread stays on the cpus of one NUMA node, with the threads
+    /// split evenly over the nodes
+    nodes,
+    /// each thread stays on one cpu, with the threads split evenly over
+    /// the NUMA nodes
+    cpus
+};
+
 /**
  * Represents a collection of a fixed number of threads, which tasks can be
  * added to.
+ *
+ * Every worker thread has its own queue of tasks. A task submitted from a
+ * worker goes on that worker's queue, which it works through newest first;
+ * a task submitted from any other thread is dealt to the workers' queues
+ * in turn. A worker whose queue is empty steals the oldest task from
+ * another worker's queue, so threads contend for a lock only when they
+ * touch the same queue. Tasks that wait for tasks of their own should do
+ * so with wait(), which runs queued tasks in the meantime instead of
+ * blocking a worker.
+ *
+ * A pool whose threads are placed on NUMA nodes groups its workers by
+ * node, and an idle worker steals from the workers of its own node before
+ * those of other nodes, so that tasks tend to stay near the memory they
+ * first touched.
  */
 class thread_pool
 {
@@ -36,17 +76,45 @@ class thread_pool
     /**
      * @param num_threads The number of threads to initialize this thread_pool
      * with; by default, the hardware concurrency.
+     * @param where Where the threads may run
      */
-    thread_pool(size_t num_threads = std::thread::hardware_concurrency())
-        : running_(true)
+    thread_pool(size_t num_threads = std::thread::hardware_concurrency(),
+                placement where = placement::none)
+        : num_nodes_(1), running_(true), pending_(0), sleepers_(0),
+          next_queue_(0)
     {
+        if (num_threads == 0)
+            num_threads = 1;
+
+        topology topo;
+        if (where != placement::none)
+        {
+            topo = detect_topology();
+            num_nodes_ = topo.nodes.size();
+        }
+
+        // the workers of a node are numbered together, and each node gets
+        // an equal share of them
+        std::vector<size_t> placed(num_nodes_, 0);
+        for (size_t i = 0; i < num_threads; ++i)
+        {
+            queues_.emplace_back(make_unique<task_queue>());
+            auto& q = *queues_.back();
+            q.node = i * num_nodes_ / num_threads;
+            auto rank = placed[q.node]++;
+            if (where == placement::nodes)
+                q.cpus = topo.nodes[q.node];
+            else if (where == placement::cpus)
+                q.cpus.push_back(
+                    topo.nodes[q.node][rank % topo.nodes[q.node].size()]);
+        }
         for (size_t i = 0; i < num_threads; ++i)
             threads_.push_back(
-                std::thread{std::bind(&thread_pool::worker, this)});
+                std::thread{std::bind(&thread_pool::worker, this, i)});
     }
 
     /**
-     * Destructor; joins all threads.
+     * Destructor; runs the remaining tasks and joins all threads.
      */
     ~thread_pool()
     {
@@ -68,21 +136,84 @@ class thread_pool
     template <class Function>
     std::future<typename std::result_of<Function()>::type>
     submit_task(Function func)
+    {
+        // a worker keeps its own tasks; other threads deal them out
+        auto self = current();
+        auto idx = self.pool == this
+                       ? self.index
+                       : next_queue_.fetch_add(1, std::memory_order_relaxed)
+                             % queues_.size();
+        return submit_to(idx, std::move(func));
+    }
+
+    /**
+     * Adds a task to the queue of a given worker. The task may still be
+     * stolen by an idle worker, but usually runs on the one it was given
+     * to, so memory it touches first is usually on that worker's node.
+     * @param worker The position of the worker in the pool
+     * @param func The function (task) to add
+     * @return a std::future that wraps the return value of the task for
+     * retrieval later
+     */
+    template <class Function>
+    std::future<typename std::result_of<Function()>::type>
+    submit_to(size_t worker, Function func)
     {
         using result_type = typename std::result_of<Function()>::type;
 
-        std::unique_ptr<concrete_task<result_type>> task(
-            new concrete_task<result_type>(func));
+        std::packaged_task<result_type()> ptask(std::move(func));
+        auto future = ptask.get_future();
+
+        auto idx = worker % queues_.size();
+        {
+            std::unique_lock<std::mutex> lock(queues_[idx]->mutex);
+            queues_[idx]->tasks.emplace_back(std::move(ptask));
+        }
 
-        auto future = task->get_future();
+        // a worker going to sleep announces itself before it checks for
+        // tasks, so either it sees this task or it is woken here
+        ++pending_;
+        if (sleepers_ > 0)
         {
             std::unique_lock<std::mutex> lock(mutex_);
-            tasks_.push(std::move(task));
+            cond_.notify_one();
         }
-        cond_.notify_one();
         return future;
     }
 
+    /**
+     * Waits for a future to become ready. Called from one of the pool's
+     * own workers, it runs queued tasks in the meantime: a task that
+     * submits tasks of its own should wait for them with this rather than
+     * future::wait(), which would hold a worker idle and could deadlock
+     * the pool. Any other thread simply blocks, so tasks only ever run on
+     * the threads listed by thread_ids().
+     * @param fut The future to wait for
+     */
+    template <class T>
+    void wait(const std::future<T>& fut)
+    {
+        auto self = current();
+        if (self.pool != this)
+        {
+            fut.wait();
+            return;
+        }
+
+        while (fut.wait_for(std::chrono::seconds(0))
+               != std::future_status::ready)
+        {
+            task t;
+            if (take(self.index, t))
+            {
+                trace::scoped_event event{"task", "thread_pool"};
+                t();
+            }
+            else
+                std::this_thread::yield();
+        }
+    }
+
     /**
      * @return a vector of the thread_ids from the current pool
      */
@@ -95,105 +226,356 @@ class thread_pool
     }
 
     /**
-     * @return the number of currently queued tasks
+     * @return the number of NUMA nodes the workers are spread over; one
+     * if they were not placed
      */
-    size_t tasks() const
+    size_t num_nodes() const
     {
-        std::unique_lock<std::mutex> lock(mutex_);
-        return tasks_.size();
+        return num_nodes_;
     }
 
-  private:
     /**
-     * A generic task object.
+     * @param worker The position of a worker in the pool
+     * @return the NUMA node the worker runs on, numbered from zero
      */
-    struct task
+    size_t node(size_t worker) const
     {
-        /**
-         * Runs the given task.
-         */
-        virtual void run() = 0;
+        return queues_[worker % queues_.size()]->node;
+    }
 
-        /**
-         * Virtual destructor to support deletion from base pointers.
-         */
-        virtual ~task() = default;
-    };
+    /**
+     * @return the NUMA node of the calling thread if it is one of the
+     * pool's workers, and zero otherwise
+     */
+    size_t current_node() const
+    {
+        auto self = current();
+        return self.pool == this ? node(self.index) : 0;
+    }
 
     /**
-     * A concrete task is templated with a result type.
+     * @return the number of currently queued tasks
      */
-    template <class R>
-    struct concrete_task : task
+    size_t tasks() const
     {
-        /**
-         * Constructs a new concrete task.
-         *
-         * @param f The function to run.
-         */
+        auto pending = pending_.load();
+        return pending > 0 ? static_cast<size_t>(pending) : 0;
+    }
+
+  private:
+    /**
+     * A type-erased, move-only function taking and returning nothing.
+     * Functions small enough (such as the std::packaged_task made by
+     * submit_task) are stored in place, so that queueing one does not
+     * allocate.
+     */
+    class task
+    {
+      public:
+        task() : ops_{nullptr}
+        {
+        }
+
         template <class Function>
-        concrete_task(const Function& f)
-            : task_(f)
+        task(Function&& func)
+            : ops_{&operations<typename std::decay<Function>::type>::table}
         {
+            using fn_type = typename std::decay<Function>::type;
+            operations<fn_type>::create(&storage_,
+                                        std::forward<Function>(func));
         }
 
-        /**
-         * Virtual destructor to support deletion from base pointers.
-         */
-        virtual ~concrete_task() = default;
+        task(task&& other) : ops_{other.ops_}
+        {
+            if (ops_)
+                ops_->move(&storage_, &other.storage_);
+            other.ops_ = nullptr;
+        }
+
+        task& operator=(task&& other)
+        {
+            if (this != &other)
+            {
+                reset();
+                ops_ = other.ops_;
+                if (ops_)
+                    ops_->move(&storage_, &other.storage_);
+                other.ops_ = nullptr;
+            }
+            return *this;
+        }
+
+        task(const task&) = delete;
+        task& operator=(const task&) = delete;
 
-        virtual void run() override
+        ~task()
         {
-            task_();
+            reset();
         }
 
         /**
-         * @return the future associated with this task
+         * Runs the function.
          */
-        std::future<R> get_future()
+        void operator()()
         {
-            return task_.get_future();
+            ops_->run(&storage_);
         }
 
-        /// the internal task representation
-        std::packaged_task<R()> task_;
+      private:
+        /// The room for a function stored in place
+        using storage_type =
+            typename std::aligned_storage<6 * sizeof(void*)>::type;
+
+        /// How to run, move, and destroy the stored function
+        struct ops_table
+        {
+            void (*run)(storage_type*);
+            /// Moves from the second argument, which is then destroyed
+            void (*move)(storage_type*, storage_type*);
+            void (*destroy)(storage_type*);
+        };
+
+        template <class Function, bool Inline>
+        struct storage_ops;
+
+        /// Operations for a function stored in place
+        template <class Function>
+        struct storage_ops<Function, true>
+        {
+            static Function* get(storage_type* s)
+            {
+                return reinterpret_cast<Function*>(s);
+            }
+
+            template <class F>
+            static void create(storage_type* s, F&& f)
+            {
+                new (s) Function(std::forward<F>(f));
+            }
+
+            static void run(storage_type* s)
+            {
+                (*get(s))();
+            }
+
+            static void move(storage_type* dst, storage_type* src)
+            {
+                new (dst) Function(std::move(*get(src)));
+                get(src)->~Function();
+            }
+
+            static void destroy(storage_type* s)
+            {
+                get(s)->~Function();
+            }
+        };
+
+        /// Operations for a function stored on the heap, owned by a
+        /// std::unique_ptr stored in place
+        template <class Function>
+        struct storage_ops<Function, false>
+        {
+            using pointer = std::unique_ptr<Function>;
+
+            static pointer& get(storage_type* s)
+            {
+                return *reinterpret_cast<pointer*>(s);
+            }
+
+            template <class F>
+            static void create(storage_type* s, F&& f)
+            {
+                new (s) pointer(make_unique<Function>(std::forward<F>(f)));
+            }
+
+            static void run(storage_type* s)
+            {
+                (*get(s))();
+            }
+
+            static void move(storage_type* dst, storage_type* src)
+            {
+                new (dst) pointer(std::move(get(src)));
+                get(src).~pointer();
+            }
+
+            static void destroy(storage_type* s)
+            {
+                get(s).~pointer();
+            }
+        };
+
+        template <class Function>
+        struct operations
+            : storage_ops<Function,
+                          sizeof(Function) <= sizeof(storage_type)
+                              && alignof(Function) <= alignof(storage_type)
+                              && std::is_nothrow_move_constructible<
+                                     Function>::value>
+        {
+            static const ops_table table;
+        };
+
+        void reset()
+        {
+            if (ops_)
+                ops_->destroy(&storage_);
+            ops_ = nullptr;
+        }
+
+        /// The operations on the stored function, or null if empty
+        const ops_table* ops_;
+        /// The function, or a pointer to it
+        storage_type storage_;
+    };
+
+    /**
+     * The queue of tasks of one worker, and where the worker runs.
+     */
+    struct task_queue
+    {
+        /// guards tasks
+        std::mutex mutex;
+        /// the tasks, oldest first
+        std::deque<task> tasks;
+        /// the NUMA node of the worker
+        size_t node = 0;
+        /// the cpus the worker may run on, or none if it was not placed
+        std::vector<unsigned> cpus;
+    };
+
+    /**
+     * The worker a thread is, if any.
+     */
+    struct worker_id
+    {
+        /// the pool the thread works for, or null
+        const thread_pool* pool;
+        /// the position of the thread in the pool
+        size_t index;
     };
 
+    /**
+     * @return the worker the calling thread is
+     */
+    static worker_id& current()
+    {
+        static thread_local worker_id id{nullptr, 0};
+        return id;
+    }
+
+    /**
+     * Takes a task: the newest one from the given queue if there is one,
+     * else the oldest one from another queue, looking first at the queues
+     * of the same node.
+     * @param index The queue to look in first
+     * @param t Where to put the task
+     * @return whether a task was found
+     */
+    bool take(size_t index, task& t)
+    {
+        {
+            auto& q = *queues_[index];
+            std::unique_lock<std::mutex> lock(q.mutex);
+            if (!q.tasks.empty())
+            {
+                t = std::move(q.tasks.back());
+                q.tasks.pop_back();
+                return claimed();
+            }
+        }
+
+        auto home = queues_[index]->node;
+        for (auto local : {true, false})
+        {
+            for (size_t i = 1; i < queues_.size(); ++i)
+            {
+                auto& q = *queues_[(index + i) % queues_.size()];
+                if ((q.node == home) != local)
+                    continue;
+
+                std::unique_lock<std::mutex> lock(q.mutex);
+                if (!q.tasks.empty())
+                {
+                    t = std::move(q.tasks.front());
+                    q.tasks.pop_front();
+                    return claimed();
+                }
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Records that a queued task was taken.
+     * @return true
+     */
+    bool claimed()
+    {
+        --pending_;
+        return true;
+    }
+
     /**
      * Function invoked by the worker threads to process tasks off the
-     * internal queue.
+     * queues.
+     * @param index The position of the worker in the pool
      */
-    void worker()
+    void worker(size_t index)
     {
+        current() = worker_id{this, index};
+        if (!queues_[index]->cpus.empty())
+            pin_current_thread(queues_[index]->cpus);
+        if (trace::enabled())
+            trace::name_thread("pool worker " + std::to_string(index));
         while (true)
         {
-            std::unique_ptr<task> task;
+            task t;
+            if (take(index, t))
             {
-                std::unique_lock<std::mutex> lock(mutex_);
-                while (running_ && tasks_.empty())
-                    cond_.wait(lock);
-                if (!running_ && tasks_.empty())
-                    return;
-                task = std::move(tasks_.front());
-                tasks_.pop();
+                trace::scoped_event event{"task", "thread_pool"};
+                t();
+                continue;
             }
-            task->run();
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            ++sleepers_;
+            while (running_ && pending_ <= 0)
+                cond_.wait(lock);
+            --sleepers_;
+            if (!running_ && pending_ <= 0)
+                return;
         }
     }
 
     /// the threads in the pool
     std::vector<std::thread> threads_;
-    /// the queue containing the tasks to be run
-    std::queue<std::unique_ptr<task>> tasks_;
+    /// the queue of each thread
+    std::vector<std::unique_ptr<task_queue>> queues_;
+    /// the number of NUMA nodes the threads are spread over
+    size_t num_nodes_;
 
     /// whether or not the pool is currently running
     bool running_;
+    /// the number of queued tasks; briefly negative when a task is taken
+    /// before its submitter has counted it
+    std::atomic<std::ptrdiff_t> pending_;
+    /// the number of workers asleep or about to sleep
+    std::atomic<size_t> sleepers_;
+    /// the queue the next task from outside the pool goes on
+    std::atomic<size_t> next_queue_;
 
-    /// the mutex to wrap queue operations
+    /// the mutex that guards running_ and the sleeping of workers
     mutable std::mutex mutex_;
     /// the condition variable that workers sleep on when waiting for work
     std::condition_variable cond_;
 };
+
+template <class Function>
+const thread_pool::task::ops_table
+    thread_pool::task::operations<Function>::table
+    = {&operations<Function>::run, &operations<Function>::move,
+       &operations<Function>::destroy};
 }
 }
 
@@ -0,0 +1,140 @@
+/**
+ * @file topology.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_PARALLEL_TOPOLOGY_H_
+#define META_PARALLEL_TOPOLOGY_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+namespace meta
+{
+namespace parallel
+{
+
+/**
+ * The NUMA nodes of the machine, as the logical cpus that belong to each,
+ * limited to the cpus this process may run on. Machines (or platforms)
+ * that do not report their nodes appear as a single node holding every
+ * cpu.
+ */
+struct topology
+{
+    /// the cpus of each node that has any
+    std::vector<std::vector<unsigned>> nodes;
+};
+
+namespace internal
+{
+/**
+ * Parses a list of cpus in the kernel's format, such as "0-3,8,10-11".
+ * @param list The list
+ * @return the cpus in the list
+ */
+inline std::vector<unsigned> parse_cpu_list(const std::string& list)
+{
+    std::vector<unsigned> cpus;
+    std::stringstream ranges{list};
+    std::string range;
+    while (std::getline(ranges, range, ','))
+    {
+        if (range.empty() || range == "\n")
+            continue;
+        auto dash = range.find('-');
+        auto first = std::stoul(range.substr(0, dash));
+        auto last = dash == std::string::npos
+                        ? first
+                        : std::stoul(range.substr(dash + 1));
+        for (auto cpu = first; cpu <= last; ++cpu)
+            cpus.push_back(static_cast<unsigned>(cpu));
+    }
+    return cpus;
+}
+
+/**
+ * @param path A file holding a list of cpus or nodes
+ * @return its contents, or nothing if it could not be read
+ */
+inline std::vector<unsigned> read_cpu_list(const std::string& path)
+{
+    std::ifstream file{path};
+    std::string list;
+    if (!file || !std::getline(file, list))
+        return {};
+    return parse_cpu_list(list);
+}
+}
+
+/**
+ * Finds the NUMA nodes of the machine from /sys on Linux.
+ * @return the machine's topology
+ */
+inline topology detect_topology()
+{
+    topology topo;
+#ifdef __linux__
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    auto have_mask = sched_getaffinity(0, sizeof(allowed), &allowed) == 0;
+
+    const std::string sys = "/sys/devices/system/node/";
+    for (auto node : internal::read_cpu_list(sys + "online"))
+    {
+        std::vector<unsigned> cpus;
+        auto path = sys + "node" + std::to_string(node) + "/cpulist";
+        for (auto cpu : internal::read_cpu_list(path))
+            if (!have_mask || (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)))
+                cpus.push_back(cpu);
+        if (!cpus.empty())
+            topo.nodes.push_back(std::move(cpus));
+    }
+#endif
+    if (topo.nodes.empty())
+    {
+        auto num_cpus = std::thread::hardware_concurrency();
+        topo.nodes.emplace_back();
+        for (unsigned cpu = 0; cpu < std::max(num_cpus, 1u); ++cpu)
+            topo.nodes.back().push_back(cpu);
+    }
+    return topo;
+}
+
+/**
+ * Restricts the calling thread to a set of cpus. Does nothing on
+ * platforms without thread affinity.
+ * @param cpus The cpus the thread may run on
+ * @return whether the thread was restricted
+ */
+inline bool pin_current_thread(const std::vector<unsigned>& cpus)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (auto cpu : cpus)
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    (void)cpus;
+    return false;
+#endif
+}
+}
+}
+
+#endif
@@ -0,0 +1,138 @@
+/**
+ * @file parse_cache.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_PARSE_CACHE_H_
+#define META_PARSE_CACHE_H_
+
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "meta.h"
+#include "parser/trees/parse_tree.h"
+
+namespace meta
+{
+namespace analyzers
+{
+
+/**
+ * Keeps the parse trees of documents so that each document is tagged and
+ * parsed once, however many tree_analyzers featurize it.
+ *
+ * Documents are keyed by their doc_id and a hash of the sentences given
+ * to the tagger, so a document whose content (or whose analyzer's
+ * filters) changed is parsed anew. The trees of the last document each
+ * thread parsed are always kept, which lets several tree analyzer groups
+ * of one config share the parse of the document they all tokenize in
+ * turn. Given a file, the cache also keeps every parse in a binary store
+ * that outlives the process, so that an index rebuilt with different
+ * featurizers parses nothing it has parsed before.
+ *
+ * The store is a log of records (doc_id, hash, size, trees), each tree
+ * written in preorder; only the offset of each document's latest record
+ * is kept in memory.
+ */
+class parse_cache
+{
+  public:
+    /// The parse trees of the sentences of a document
+    using tree_list = std::vector<parser::parse_tree>;
+
+    /**
+     * Finds the cache shared by every analyzer that tags and parses with
+     * the same models into the same store, making it on first use.
+     * @param tagger_prefix The directory of the tagger model
+     * @param parser_prefix The directory of the parser model
+     * @param path The file of the store, or empty to keep no store
+     * @return the cache
+     */
+    static std::shared_ptr<parse_cache>
+        shared(const std::string& tagger_prefix,
+               const std::string& parser_prefix, const std::string& path);
+
+    /**
+     * Opens a cache, reading the documents of its store if it has one.
+     * @param path The file of the store, or empty to keep no store
+     */
+    explicit parse_cache(const std::string& path = "");
+
+    /**
+     * @param id The id of a document
+     * @param hash The hash of the document's sentences
+     * @return the trees of the document, or null if they are not cached
+     */
+    std::shared_ptr<const tree_list> find(doc_id id, uint64_t hash);
+
+    /**
+     * Caches the trees of a document.
+     * @param id The id of the document
+     * @param hash The hash of the document's sentences
+     * @param trees The trees of the document's sentences
+     */
+    void insert(doc_id id, uint64_t hash,
+                std::shared_ptr<const tree_list> trees);
+
+    /**
+     * @return the number of documents in the store
+     */
+    uint64_t size() const;
+
+  private:
+    /**
+     * Where a document's trees are in the store.
+     */
+    struct entry
+    {
+        /// The hash of the document's sentences
+        uint64_t hash;
+        /// The offset of the trees in the store
+        uint64_t offset;
+        /// The number of bytes of the trees
+        uint64_t size;
+    };
+
+    /**
+     * Reads the records of the store, dropping a last record that was
+     * only partly written.
+     */
+    void load();
+
+    /// The number that tells this cache's parses apart from another's in
+    /// the trees each thread keeps
+    const uint64_t id_;
+
+    /// The file of the store, or empty
+    const std::string path_;
+
+    /// Guards entries_ and file_
+    mutable std::mutex mutex_;
+
+    /// Where each document's latest trees are in the store
+    std::unordered_map<doc_id, entry> entries_;
+
+    /// The store, read and appended to
+    std::fstream file_;
+};
+
+/**
+ * Exception thrown when a parse cache's store cannot be used.
+ */
+class parse_cache_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+#endif
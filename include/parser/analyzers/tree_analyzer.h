@@ -14,6 +14,7 @@
 #include "analyzers/analyzer.h"
 #include "analyzers/analyzer_factory.h"
 #include "parser/analyzers/featurizers/tree_featurizer.h"
+#include "parser/analyzers/parse_cache.h"
 #include "parser/sr_parser.h"
 #include "sequence/perceptron.h"
 #include "util/clonable.h"
@@ -25,16 +26,28 @@ namespace analyzers
 
 /**
  * Base class tokenizing using parse tree features.
+ *
+ * Each document is tagged and parsed once: the trees are kept in a
+ * parse_cache shared by every tree_analyzer with the same models, so
+ * several tree analyzer groups in one config parse each document only
+ * once, and a group given a `parse-cache` file reuses the trees stored
+ * there by earlier runs.
  */
 class tree_analyzer : public util::clonable<analyzer, tree_analyzer>
 {
   public:
     /**
      * Creates a tree analyzer
+     * @param stream The token stream that splits documents into sentences
+     * @param tagger_prefix The directory of the tagger model
+     * @param parser_prefix The directory of the parser model
+     * @param cache_path The file that parse trees are stored in between
+     * runs, or empty to keep them only in memory
      */
     tree_analyzer(std::unique_ptr<token_stream> stream,
                   const std::string& tagger_prefix,
-                  const std::string& parser_prefix);
+                  const std::string& parser_prefix,
+                  const std::string& cache_path = "");
 
     /**
      * Copy constructor.
@@ -84,6 +97,12 @@ class tree_analyzer : public util::clonable<analyzer, tree_analyzer>
      * parser's model across all of the threads used during tokenization).
      */
     std::shared_ptr<const parser::sr_parser> parser_;
+
+    /**
+     * The parse trees of documents, shared with every analyzer that uses
+     * the same models.
+     */
+    std::shared_ptr<parse_cache> cache_;
 };
 
 /**
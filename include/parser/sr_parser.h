@@ -10,12 +10,16 @@
 #define META_PARSER_SR_PARSER_H_
 
 #include <map>
+#include <memory>
 #include <random>
 #include <unordered_map>
 
+#include "classify/models/frozen_linear_model.h"
 #include "classify/models/linear_model.h"
+#include "io/mmap_file.h"
 #include "meta.h"
 #include "parallel/thread_pool.h"
+#include "parser/trees/evalb.h"
 #include "parser/trees/parse_tree.h"
 #include "parser/transition_map.h"
 #include "sequence/sequence.h"
@@ -90,6 +94,22 @@ class sr_parser
          */
         training_algorithm algorithm = training_algorithm::EARLY_TERMINATION;
 
+        /**
+         * If nonzero, the features are hashed rather than kept as strings:
+         * each feature's string is hashed (without being built) to one of
+         * \f$2^{hash\_bits}\f$ rows of a flat table holding a weight for
+         * every transition. Zero keeps the string-keyed model.
+         */
+        uint64_t hash_bits = 0;
+
+        /**
+         * If not empty, a directory caching the preprocessed training
+         * data: the sentence and gold transitions of each tree. If it
+         * holds data, the trees are not preprocessed (and may be empty);
+         * otherwise the data is saved there after preprocessing.
+         */
+        std::string cache;
+
         /**
          * Default constructor.
          */
@@ -121,6 +141,47 @@ class sr_parser
      */
     parse_tree parse(const sequence::sequence& sentence) const;
 
+    /**
+     * Parses many POS-tagged sentences concurrently. The threads share
+     * the model, which parsing only reads, and each keeps its own
+     * features and beam from one sentence to the next.
+     *
+     * @param sentences The sentences to parse
+     * @param pool The threads to parse with
+     * @return the parse tree of each sentence, in order
+     */
+    std::vector<parse_tree>
+        parse(const std::vector<sequence::sequence>& sentences,
+              parallel::thread_pool& pool) const;
+
+    /**
+     * Parses many POS-tagged sentences concurrently, with a thread for
+     * each core.
+     *
+     * @param sentences The sentences to parse
+     * @return the parse tree of each sentence, in order
+     */
+    std::vector<parse_tree>
+        parse(const std::vector<sequence::sequence>& sentences) const;
+
+    /**
+     * Parses many POS-tagged sentences concurrently and scores each parse
+     * against its gold tree as soon as it is found, so that scoring
+     * overlaps with parsing. Each thread keeps its own counts, which are
+     * merged at the end.
+     *
+     * @param sentences The sentences to parse
+     * @param gold The gold standard parse of each sentence
+     * @param pool The threads to parse and score with
+     * @param proposed If not null, receives the parse tree of each
+     * sentence, in order
+     * @return the evaluation of the parses
+     */
+    evalb evaluate(const std::vector<sequence::sequence>& sentences,
+                   const std::vector<parse_tree>& gold,
+                   parallel::thread_pool& pool,
+                   std::vector<parse_tree>* proposed = nullptr) const;
+
     /**
      * Trains a model on the given parse trees using the supplied training
      * options.
@@ -131,6 +192,28 @@ class sr_parser
     void train(std::vector<parse_tree>& trees, training_options options);
 
     /**
+     * @param cache A directory
+     * @return whether the directory caches preprocessed training data,
+     * which train() uses in place of its trees
+     */
+    static bool cached(const std::string& cache);
+
+    /**
+     * Copies the string-keyed weights into a dense table holding, for each
+     * feature, a contiguous row of a weight for every transition, which
+     * scores a state with a few vectorized row additions rather than
+     * lookups into sparse vectors, at the cost of storing every
+     * feature's zero weights. A beam then scores its whole agenda at once.
+     * Parsers with hashed features are already dense.
+     */
+    void densify();
+
+    /**
+     * Saves the parser, writing its model both in the ordinary format and
+     * as a frozen model that later loads without being read. A parser with
+     * hashed features writes only its table of weights, which likewise
+     * loads by being memory-mapped.
+     *
      * @param prefix The prefix to store the model in
      */
     void save(const std::string& prefix) const;
@@ -159,6 +242,17 @@ class sr_parser
      */
     using weight_vectors = std::unordered_map<std::string, weight_vector>;
 
+    /**
+     * A state's features as the hashes of their strings, or, once reduced,
+     * as the rows of the hashed weight table they fall in.
+     */
+    using hashed_feature_vector = std::vector<uint64_t>;
+
+    /**
+     * A collection of weight vectors by row of the hashed weight table.
+     */
+    using hashed_weight_vectors = std::unordered_map<uint64_t, weight_vector>;
+
   private:
     /**
      * The training data for the parser.
@@ -182,6 +276,16 @@ class sr_parser
     class state_analyzer;
 
     /**
+     * The features and beam a thread reuses from one sentence it parses
+     * to the next.
+     */
+    template <class FeatureVector>
+    struct workspace;
+
+    /**
+     * Loads the parser's model, mapping its frozen model into memory if it
+     * has one.
+     *
      * @param prefix The prefix to load the model from
      */
     void load(const std::string& prefix);
@@ -194,50 +298,129 @@ class sr_parser
      * @param options The training options
      * @return a 3-tuple (update, correct actions, incorrect actions)
      */
-    std::tuple<weight_vectors, uint64_t, uint64_t>
+    template <class WeightVectors>
+    std::tuple<WeightVectors, uint64_t, uint64_t>
         train_batch(training_batch batch, parallel::thread_pool& pool,
                     const training_options& options);
 
+    /**
+     * Runs every iteration of training.
+     *
+     * @param data The training data
+     * @param pool The thread pool to use for parsing the batches in
+     * parallel
+     * @param options The training options
+     * @param apply A function that adds a batch's update to the weights,
+     * and to the weights summed for averaging scaled by the number of
+     * updates before it
+     * @param end_iteration A function called after each iteration
+     * @return the number of updates made
+     */
+    template <class WeightVectors, class Apply, class EndIteration>
+    uint64_t train_iterations(training_data& data, parallel::thread_pool& pool,
+                              const training_options& options, Apply&& apply,
+                              EndIteration&& end_iteration);
+
     /**
      * Calculates a weight update on a single tree.
      *
-     * @param tree The training tree
+     * @param sentence The sentence of the training tree
      * @param transitions The correct transitions for parsing this tree
      * @param options The training options
      * @param update The weight vector to place the update in
      * @return (correct actions, incorrect actions)
      */
+    template <class WeightVectors>
     std::pair<uint64_t, uint64_t> train_instance(
-        const parse_tree& tree, const std::vector<trans_id>& transitions,
-        const training_options& options, weight_vectors& update) const;
+        const sequence::sequence& sentence,
+        const std::vector<trans_id>& transitions,
+        const training_options& options, WeightVectors& update) const;
 
     /**
      * Calculates a weight update on a single tree, using the greedy early
      * termination training strategy.
      *
-     * @param tree The training tree
+     * @param sentence The sentence of the training tree
      * @param transitions The correct transitions for parsing this tree
      * @param options The training options
      * @param update The weight vector to place the update in
      * @return (correct actions, incorrect actions)
      */
+    template <class WeightVectors>
     std::pair<uint64_t, uint64_t>
-        train_early_termination(const parse_tree& tree,
+        train_early_termination(const sequence::sequence& sentence,
                                 const std::vector<trans_id>& transitions,
-                                weight_vectors& update) const;
+                                WeightVectors& update) const;
 
     /**
      * Calculates a weight update on a single tree, using beam search.
      *
-     * @param tree The training tree
+     * @param sentence The sentence of the training tree
      * @param transitions The correct transitions for parsing this tree
      * @param options The training options
      * @param update The weight vector to place the update in
      * @return (correct actions, incorrect actions)
      */
+    template <class WeightVectors>
     std::pair<uint64_t, uint64_t> train_beam_search(
-        const parse_tree& tree, const std::vector<trans_id>& transitions,
-        const training_options& options, weight_vectors& update) const;
+        const sequence::sequence& sentence,
+        const std::vector<trans_id>& transitions,
+        const training_options& options, WeightVectors& update) const;
+
+    /**
+     * Parses many POS-tagged sentences concurrently with features of the
+     * given kind.
+     *
+     * @param sentences The sentences to parse
+     * @param pool The threads to parse with
+     * @return the parse tree of each sentence, in order
+     */
+    template <class FeatureVector>
+    std::vector<parse_tree>
+        parse_all(const std::vector<sequence::sequence>& sentences,
+                  parallel::thread_pool& pool) const;
+
+    /**
+     * Parses many POS-tagged sentences concurrently with features of the
+     * given kind, handing each tree to a function on the thread that
+     * parsed it.
+     *
+     * @param sentences The sentences to parse
+     * @param pool The threads to parse with
+     * @param fn Called with the index of the task, the index of the
+     * sentence and its parse tree; calls from different tasks run
+     * concurrently
+     */
+    template <class FeatureVector, class Function>
+    void parse_each(const std::vector<sequence::sequence>& sentences,
+                    parallel::thread_pool& pool, Function&& fn) const;
+
+    /**
+     * Parses a POS-tagged sentence with features of the given kind.
+     *
+     * @param sentence The sentence to parse
+     * @param ws The workspace of the parsing thread
+     * @return a parse tree for the sentence
+     */
+    template <class FeatureVector>
+    parse_tree parse_with(const sequence::sequence& sentence,
+                          workspace<FeatureVector>& ws) const;
+
+    /**
+     * Computes the features of a state.
+     *
+     * @param state The state
+     * @param feats The feature vector to fill
+     */
+    void featurize(const state& state, feature_vector& feats) const;
+
+    /**
+     * Computes the features of a state as rows of the hashed weight table.
+     *
+     * @param state The state
+     * @param feats The rows, each at most once
+     */
+    void featurize(const state& state, hashed_feature_vector& feats) const;
 
     /**
      * Computes the most likely transition according to the current model
@@ -252,6 +435,20 @@ class sr_parser
     trans_id best_transition(const feature_vector& features, const state& state,
                              bool check_legality = false) const;
 
+    /**
+     * Computes the most likely transition according to the hashed model
+     *
+     * @param features The rows of the hashed weight table of the features
+     * of the current state
+     * @param state The current state
+     * @param check_legality Whether or not to limit the transitions to
+     * only those that are "legal" according to the constraints given for
+     * each transition
+     */
+    trans_id best_transition(const hashed_feature_vector& features,
+                             const state& state,
+                             bool check_legality = false) const;
+
     using scored_trans = std::pair<trans_id, float>;
 
     /**
@@ -268,6 +465,96 @@ class sr_parser
         best_transitions(const feature_vector& features, const state& state,
                          size_t num, bool check_legality = false) const;
 
+    /**
+     * Computes the \f$k\f$ most likely transitions according to the
+     * hashed model.
+     * @param features The rows of the hashed weight table of the features
+     * of the current state
+     * @param state The current state
+     * @param check_legality Whether or not to limit the transitions to
+     * only those that are "legal" according to the constraints given for
+     * each transition
+     */
+    std::vector<scored_trans>
+        best_transitions(const hashed_feature_vector& features,
+                         const state& state, size_t num,
+                         bool check_legality = false) const;
+
+    /**
+     * Computes the \f$k\f$ most likely transitions from each state of a
+     * workspace's agenda, scoring them all at once when the weights are
+     * dense.
+     * @param ws The workspace, whose states are those to score
+     * @param num The number of transitions to keep for each state
+     * @param check_legality Whether or not to limit the transitions to
+     * only those that are "legal" according to the constraints given for
+     * each transition
+     * @return the transitions from each state
+     */
+    template <class FeatureVector>
+    std::vector<std::vector<scored_trans>>
+        best_transitions(workspace<FeatureVector>& ws, size_t num,
+                         bool check_legality) const;
+
+    /**
+     * @return whether the weights are in dense_weights_
+     */
+    bool dense() const;
+
+    /**
+     * @return the dense weights, wherever they are stored
+     */
+    const float* dense_data() const;
+
+    /**
+     * @return the number of weights in a row of dense_weights_: the number
+     * of transitions, padded to a multiple of eight
+     */
+    uint64_t row_stride() const;
+
+    /**
+     * Adds the dense weights of a state's features to its scores.
+     * @param features The features of the state
+     * @param scores The score of each transition, row_stride() of them
+     */
+    void add_scores(const feature_vector& features, float* scores) const;
+
+    /**
+     * Adds the hashed weights of a state's features to its scores.
+     * @param features The rows of the hashed weight table of the features
+     * @param scores The score of each transition, row_stride() of them
+     */
+    void add_scores(const hashed_feature_vector& features,
+                    float* scores) const;
+
+    /**
+     * @param scores The score of each transition from a state
+     * @param state The state
+     * @param check_legality Whether to consider only legal transitions
+     * @return the best transition
+     */
+    trans_id best_scored(const float* scores, const state& state,
+                         bool check_legality) const;
+
+    /**
+     * @param scores The score of each transition from a state
+     * @param state The state
+     * @param num The number of transitions to return
+     * @param check_legality Whether to consider only legal transitions
+     * @return the num best transitions, best first
+     */
+    std::vector<scored_trans> best_scored(const float* scores,
+                                          const state& state, size_t num,
+                                          bool check_legality) const;
+
+    /**
+     * Copies the string-keyed weights out of the frozen model or the dense
+     * table, whichever holds them.
+     * @param model The model to add the weights to
+     */
+    void thaw(classify::linear_model<std::string, float, trans_id>& model)
+        const;
+
     /**
      * Storage for the ids for each transition
      */
@@ -278,10 +565,48 @@ class sr_parser
      */
     classify::linear_model<std::string, float, trans_id> model_;
 
+    /**
+     * The frozen model the parser was loaded from, if any, which is used
+     * in place of model_.
+     */
+    std::unique_ptr<classify::frozen_linear_model<std::string, trans_id>>
+        frozen_;
+
     /**
      * Beam size used during training.
      */
     uint64_t beam_size_ = 1;
+
+    /**
+     * The number of bits of the hashes of the features that pick their
+     * row of dense_weights_, or zero if the features are strings.
+     */
+    uint64_t hash_bits_ = 0;
+
+    /**
+     * The row of dense_weights_ of each string feature, if the parser has
+     * been densified.
+     */
+    std::unordered_map<std::string, uint64_t> dense_rows_;
+
+    /**
+     * The dense weights: a row of row_stride() weights, one for every
+     * transition, for each of the \f$2^{hash\_bits\_}\f$ feature
+     * hashes or for each feature of dense_rows_.
+     */
+    std::vector<float> dense_weights_;
+
+    /**
+     * The hashed model file the dense weights are mapped from, if the
+     * parser was loaded with hashed features.
+     */
+    std::unique_ptr<meta::io::mmap_file> hashed_file_;
+
+    /**
+     * The dense weights in hashed_file_, which are used in place of
+     * dense_weights_, or nullptr.
+     */
+    const float* mapped_weights_ = nullptr;
 };
 }
 }
@@ -9,14 +9,10 @@
 #ifndef META_PARSER_STATE_H_
 #define META_PARSER_STATE_H_
 
-#include <memory>
-#include <vector>
-
+#include "parser/state_arena.h"
 #include "parser/transition.h"
-#include "parser/trees/node.h"
 #include "parser/trees/parse_tree.h"
 #include "sequence/sequence.h"
-#include "util/persistent_stack.h"
 
 namespace meta
 {
@@ -31,32 +27,26 @@ namespace parser
  * The stack is represented using a persistent stack structure to ensure
  * that updates to the parser state occur in O(1) time. The queue is
  * static, so it can be represented as a vector + an index and updated in
- * O(1) time.
+ * O(1) time. The stack's cells, the partial parse trees, and the queue
+ * all live in a state_arena shared by every state of a sentence, so a
+ * state is a few integers and copies for free.
  */
 class state
 {
   public:
-    /**
-     * A persistent stack of partial parse trees.
-     */
-    using stack_type = util::persistent_stack<std::unique_ptr<node>>;
-
-    /**
-     * The underlying queue type.
-     */
-    using queue_type = std::vector<std::unique_ptr<leaf_node>>;
-
     /**
      * Constructs a state from a parse tree. This is used to generate the
-     * starting state for parsing during training.
+     * starting state for parsing during training. The arena is cleared
+     * for the tree's sentence.
      */
-    state(const parse_tree& tree);
+    state(const parse_tree& tree, state_arena& arena);
 
     /**
      * Constructs a state from a POS-tagged sequence. This generates teh
-     * starting state for parsing during test time.
+     * starting state for parsing during test time. The arena is cleared
+     * for the sentence.
      */
-    state(const sequence::sequence& sentence);
+    state(const sequence::sequence& sentence, state_arena& arena);
 
     /**
      * Advances the current state by taking the given transition.
@@ -84,13 +74,13 @@ class state
      * @param depth The depth to seek to in the stack
      * @return the node on the stack at the given depth
      */
-    const node* stack_item(size_t depth) const;
+    const state_node* stack_item(size_t depth) const;
 
     /**
      * @param depth The depth to seek to in the queue
      * @return the node on teh queue at the given depth
      */
-    const leaf_node* queue_item(ssize_t depth) const;
+    const state_node* queue_item(ssize_t depth) const;
 
     /**
      * @return the number of partial parse trees on the stack.
@@ -108,18 +98,17 @@ class state
     bool finalized() const;
 
   private:
-    state(stack_type stack, std::shared_ptr<queue_type> queue, size_t q_idx,
-          bool done);
+    state(state_arena* arena, uint64_t stack, size_t q_idx, bool done);
 
     /**
-     * The stack of partial parse trees.
+     * The arena the stack and queue live in.
      */
-    stack_type stack_;
+    state_arena* arena_;
 
     /**
-     * The queue of preterminals.
+     * The stack of partial parse trees.
      */
-    std::shared_ptr<queue_type> queue_;
+    uint64_t stack_;
 
     /**
      * The index of the front of the queue.
@@ -29,41 +29,63 @@ class sr_parser::state_analyzer
      */
     feature_vector featurize(const state& state) const;
 
+    /**
+     * Computes the same features as featurize(), but as the hashes of
+     * their strings, which are never built.
+     * @param state The current parser state
+     * @param feats The vector to put the distinct hashes in, in sorted
+     * order
+     */
+    void featurize(const state& state, hashed_feature_vector& feats) const;
+
   private:
+    /**
+     * Adds every feature of a state.
+     * @param state The current parser state
+     * @param feats The feature vector to put features in
+     */
+    template <class FeatureVector>
+    void all_features(const state& state, FeatureVector& feats) const;
+
     /**
      * Adds unigram features.
      * @param state The current parser state
      * @param feats The feature vector to put features in
      */
-    void unigram_featurize(const state& state, feature_vector& feats) const;
+    template <class FeatureVector>
+    void unigram_featurize(const state& state, FeatureVector& feats) const;
 
     /**
      * Adds bigram features.
      * @param state The current parser state
      * @param feats The feature vector to put features in
      */
-    void bigram_featurize(const state& state, feature_vector& feats) const;
+    template <class FeatureVector>
+    void bigram_featurize(const state& state, FeatureVector& feats) const;
 
     /**
      * Adds trigram features.
      * @param state The current parser state
      * @param feats The feature vector to put features in
      */
-    void trigram_featurize(const state& state, feature_vector& feats) const;
+    template <class FeatureVector>
+    void trigram_featurize(const state& state, FeatureVector& feats) const;
 
     /**
      * Adds children features.
      * @param state The current parser state
      * @param feats The feature vector to put features in
      */
-    void children_featurize(const state& state, feature_vector& feats) const;
+    template <class FeatureVector>
+    void children_featurize(const state& state, FeatureVector& feats) const;
 
     /**
      * Adds dependent features.
      * @param state The current parser state
      * @param feats The feature vector to put features in
      */
-    void dependents_featurize(const state& state, feature_vector& feats) const;
+    template <class FeatureVector>
+    void dependents_featurize(const state& state, FeatureVector& feats) const;
 
     /**
      * Adds unigram features from the parser stack.
@@ -71,8 +93,9 @@ class sr_parser::state_analyzer
      * @param prefix The feature name prefix
      * @param feats The feature vector to put features in
      */
-    void unigram_stack_feats(const node* n, std::string prefix,
-                             feature_vector& feats) const;
+    template <class FeatureVector>
+    void unigram_stack_feats(const state_node* n, const std::string& prefix,
+                             FeatureVector& feats) const;
 
     /**
      * Adds bigram features to the feature vector.
@@ -82,8 +105,10 @@ class sr_parser::state_analyzer
      * @param name2 The feature name prefix of the second node
      * @param feats The feature vector put features in
      */
-    void bigram_features(const node* n1, std::string name1, const node* n2,
-                         std::string name2, feature_vector& feats) const;
+    template <class FeatureVector>
+    void bigram_features(const state_node* n1, const std::string& name1,
+                         const state_node* n2, const std::string& name2,
+                         FeatureVector& feats) const;
 
     /**
      * Adds child features to the feature vector.
@@ -93,8 +118,9 @@ class sr_parser::state_analyzer
      * @param doubs Whether or not to add features for children two steps
      * down
      */
-    void child_feats(const node* n, std::string prefix, feature_vector& feats,
-                     bool doubs) const;
+    template <class FeatureVector>
+    void child_feats(const state_node* n, const std::string& prefix,
+                     FeatureVector& feats, bool doubs) const;
 };
 }
 }
@@ -0,0 +1,267 @@
+/**
+ * @file state_arena.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_PARSER_STATE_ARENA_H_
+#define META_PARSER_STATE_ARENA_H_
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "meta.h"
+#include "parser/trees/node.h"
+
+namespace meta
+{
+namespace parser
+{
+
+/**
+ * A node of a partial parse tree built by the parser's states. The nodes
+ * of a sentence all live in one state_arena and refer to their children
+ * without owning them, so the states on a beam share their subtrees
+ * rather than copying them.
+ */
+class state_node
+{
+  public:
+    /**
+     * Creates an empty node, to be assigned over.
+     */
+    state_node() = default;
+
+    /**
+     * Creates a preterminal.
+     * @param tag The part of speech
+     * @param word The word, which must outlive the node
+     */
+    state_node(class_label tag, const std::string* word);
+
+    /**
+     * Creates a node over one or two children.
+     * @param cat The category
+     * @param left The left (or only) child
+     * @param right The right child, or nullptr for a unary node
+     * @param head The child the node is headed by
+     */
+    state_node(class_label cat, const state_node* left,
+               const state_node* right, const state_node* head);
+
+    /**
+     * @return the category (the part of speech of a preterminal)
+     */
+    const class_label& category() const
+    {
+        return category_;
+    }
+
+    /**
+     * @return whether the node is a preterminal
+     */
+    bool is_leaf() const
+    {
+        return num_children_ == 0;
+    }
+
+    /**
+     * @return whether the node is a temporary node of a binarized tree
+     */
+    bool is_temporary() const;
+
+    /**
+     * @return the number of children
+     */
+    uint64_t num_children() const
+    {
+        return num_children_;
+    }
+
+    /**
+     * @param idx The position of the child
+     * @return the child
+     */
+    const state_node* child(uint64_t idx) const
+    {
+        return children_[idx];
+    }
+
+    /**
+     * @return the child the node is headed by, or nullptr for a
+     * preterminal
+     */
+    const state_node* head_constituent() const
+    {
+        return head_;
+    }
+
+    /**
+     * @return the preterminal the node is headed by (itself for a
+     * preterminal)
+     */
+    const state_node* head_lexicon() const
+    {
+        return lexicon_ ? lexicon_ : this;
+    }
+
+    /**
+     * @return the word of the preterminal the node is headed by
+     */
+    const std::string& word() const
+    {
+        return *head_lexicon()->word_;
+    }
+
+    /**
+     * @return a parse tree node that owns a copy of this subtree
+     */
+    std::unique_ptr<node> tree() const;
+
+  private:
+    /// The category
+    class_label category_;
+    /// The children, if any
+    const state_node* children_[2] = {nullptr, nullptr};
+    /// The number of children
+    uint64_t num_children_ = 0;
+    /// The child the node is headed by
+    const state_node* head_ = nullptr;
+    /// The preterminal the node is headed by, or nullptr if it is one
+    const state_node* lexicon_ = nullptr;
+    /// The word, if the node is a preterminal
+    const std::string* word_ = nullptr;
+};
+
+/**
+ * Owns every node and stack cell of the states of one sentence's parse,
+ * so that advancing a state allocates nothing but the arena's blocks,
+ * and all of it is freed at once when the next sentence starts. The
+ * stacks are persistent, linked by index from each cell to the one
+ * below it. The blocks are kept from one sentence to the next.
+ *
+ * An arena is used by one thread at a time.
+ */
+class state_arena
+{
+  public:
+    /// The index of the empty stack
+    const static uint64_t empty_stack = 0;
+
+    /**
+     * Creates an empty arena.
+     */
+    state_arena();
+
+    /**
+     * Frees every node and stack cell and starts a new sentence.
+     */
+    void clear();
+
+    /**
+     * Adds a preterminal to the end of the sentence's queue.
+     * @param tag The part of speech
+     * @param word The word
+     */
+    void add_word(class_label tag, std::string word);
+
+    /**
+     * @param idx A position in the sentence
+     * @return the preterminal at the position
+     */
+    const state_node* word(uint64_t idx) const
+    {
+        return queue_[idx];
+    }
+
+    /**
+     * @return the number of words of the sentence
+     */
+    uint64_t num_words() const
+    {
+        return queue_.size();
+    }
+
+    /**
+     * Creates a node over one or two children.
+     * @param cat The category
+     * @param left The left (or only) child
+     * @param right The right child, or nullptr for a unary node
+     * @param head The child the node is headed by
+     * @return the node
+     */
+    const state_node* make_node(class_label cat, const state_node* left,
+                                const state_node* right,
+                                const state_node* head);
+
+    /**
+     * @param stack A stack
+     * @param item The node to push
+     * @return the stack with the node pushed onto it
+     */
+    uint64_t push(uint64_t stack, const state_node* item);
+
+    /**
+     * @param stack A non-empty stack
+     * @return the stack with its top node popped
+     */
+    uint64_t pop(uint64_t stack) const
+    {
+        return cells_[stack].prev;
+    }
+
+    /**
+     * @param stack A non-empty stack
+     * @return its top node
+     */
+    const state_node* top(uint64_t stack) const
+    {
+        return cells_[stack].item;
+    }
+
+    /**
+     * @param stack A stack
+     * @return the number of nodes on it
+     */
+    uint64_t size(uint64_t stack) const
+    {
+        return cells_[stack].size;
+    }
+
+  private:
+    /**
+     * @return storage for a new node
+     */
+    state_node& allocate();
+
+    /// A cell of a persistent stack
+    struct stack_cell
+    {
+        const state_node* item;
+        uint64_t prev;
+        uint64_t size;
+    };
+
+    /// The number of nodes in a block
+    const static uint64_t block_size = 1024;
+
+    /// The blocks the nodes are stored in
+    std::vector<std::unique_ptr<state_node[]>> blocks_;
+    /// The number of nodes allocated
+    uint64_t num_nodes_;
+    /// The cells of every stack, the empty stack first
+    std::vector<stack_cell> cells_;
+    /// The words of the sentence, which do not move as words are added
+    std::deque<std::string> words_;
+    /// The preterminals of the sentence, in order
+    std::vector<const state_node*> queue_;
+};
+}
+}
+
+#endif
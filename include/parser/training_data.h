@@ -30,6 +30,23 @@ class sr_parser::training_data
     training_data(std::vector<parse_tree>& trees,
                   std::default_random_engine::result_type seed);
 
+    /**
+     * Loads training data that was preprocessed and saved by save(),
+     * which needs no trees.
+     *
+     * @param prefix The directory the data was saved in
+     * @param seed The seed to used for seeding the rng for shuffling
+     * examples
+     */
+    training_data(const std::string& prefix,
+                  std::default_random_engine::result_type seed);
+
+    /**
+     * @param prefix A directory
+     * @return whether the directory holds saved training data
+     */
+    static bool exists(const std::string& prefix);
+
     /**
      * Preprocesses all of the training trees. This currently runs the
      * following transformations across all of the training data:
@@ -40,10 +57,24 @@ class sr_parser::training_data
      * - head_finder
      * - binarizer
      *
+     * and then finds the transitions that build each tree. The trees are
+     * processed concurrently; the transitions are given ids in the order
+     * of the trees, so the ids do not depend on the number of threads.
+     *
+     * @param pool The threads to preprocess with
      * @return a transition_map to associate all transition names with ids
      * in the binarized training data
      */
-    transition_map preprocess();
+    transition_map preprocess(parallel::thread_pool& pool);
+
+    /**
+     * Saves the preprocessed data, the sentence and gold transitions of
+     * each tree, so that later training runs can skip preprocessing.
+     *
+     * @param prefix The directory to save the data in
+     * @param trans The transition_map of the data
+     */
+    void save(const std::string& prefix, const transition_map& trans) const;
 
     /**
      * Shuffles the training data.
@@ -57,9 +88,10 @@ class sr_parser::training_data
 
     /**
      * @param idx The index to seek into the training data
-     * @return the parse tree at that position in the training data
+     * @return the POS-tagged sentence of the tree at that position in the
+     * training data
      */
-    const parse_tree& tree(size_t idx) const;
+    const sequence::sequence& sentence(size_t idx) const;
 
     /**
      * @param idx The index to seek into the training data
@@ -69,9 +101,14 @@ class sr_parser::training_data
 
   private:
     /**
-     * A reference to the collection of training trees.
+     * The collection of training trees, if the data was not loaded.
+     */
+    std::vector<parse_tree>* trees_;
+
+    /**
+     * The POS-tagged sentence of each tree.
      */
-    std::vector<parse_tree>& trees_;
+    std::vector<sequence::sequence> sentences_;
 
     /**
      * The gold standard transitions for each tree.
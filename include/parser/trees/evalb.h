@@ -9,6 +9,9 @@
 #ifndef META_PARSER_EVALB_H_
 #define META_PARSER_EVALB_H_
 
+#include <vector>
+
+#include "parallel/thread_pool.h"
 #include "parser/trees/parse_tree.h"
 
 namespace meta
@@ -105,6 +108,27 @@ class evalb
      */
     void add_tree(parse_tree proposed, parse_tree gold);
 
+    /**
+     * Scores many trees concurrently. Each thread takes chunks of the
+     * trees and counts them in an evalb of its own; the counts are
+     * merged into this one at the end.
+     *
+     * @param proposed The proposed parses
+     * @param gold The gold standard parses, in the same order
+     * @param pool The threads to score with
+     */
+    void add_trees(const std::vector<parse_tree>& proposed,
+                   const std::vector<parse_tree>& gold,
+                   parallel::thread_pool& pool);
+
+    /**
+     * Adds the counts of another evaluation to this one, as if its trees
+     * had been added here.
+     *
+     * @param other The evaluation to merge
+     */
+    void merge(const evalb& other);
+
   private:
     /**
      * The number of correct constituents in proposed parse trees.
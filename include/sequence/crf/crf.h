@@ -10,6 +10,7 @@
 #ifndef META_SEQUENCE_CRF_H_
 #define META_SEQUENCE_CRF_H_
 
+#include "parallel/thread_pool.h"
 #include "sequence/observation.h"
 #include "sequence/sequence.h"
 #include "sequence/sequence_analyzer.h"
@@ -40,6 +41,29 @@ MAKE_NUMERIC_IDENTIFIER(crf_feature_id, uint64_t)
 class crf
 {
   public:
+    /**
+     * How the threads of parallel training apply their updates to the
+     * weights.
+     */
+    enum class update_strategy
+    {
+        /**
+         * The sequences of a minibatch are all scored against the same
+         * weights, and their updates are then combined and applied
+         * together, each scaled by the learning rate of its own step.
+         * The result does not depend on how the threads are scheduled.
+         */
+        minibatch,
+
+        /**
+         * Each thread applies the update of a sequence as soon as it has
+         * scored it, without locking, so threads may read weights that
+         * others are writing to. This is the fastest, and sparse updates
+         * rarely collide.
+         */
+        lock_free
+    };
+
     /**
      * Wrapper to represent the parameters used during learning. The
      * defaults are sane, and so most users should simply initialize the
@@ -107,6 +131,50 @@ class crf
          * calibration.
          */
         uint64_t calibration_trials = 10;
+
+        /**
+         * The number of threads to train (and calibrate) with. With one,
+         * the sequences are learned from one at a time.
+         */
+        uint64_t num_threads = 1;
+
+        /**
+         * How the threads apply their updates when training in parallel.
+         */
+        update_strategy strategy = update_strategy::minibatch;
+
+        /**
+         * The number of sequences in each minibatch when the strategy is
+         * update_strategy::minibatch.
+         */
+        uint64_t batch_size = 256;
+    };
+
+    /**
+     * Options for tagging with a trained model, trading exactness or
+     * memory for speed when there are many labels.
+     */
+    struct decoding_options
+    {
+        /**
+         * If nonzero, only this many of the best labels at each time step
+         * are extended to the next one (beam search). With zero, every
+         * label is, and the best path is found exactly.
+         */
+        uint64_t beam_size = 0;
+
+        /**
+         * Whether to copy the observation weights into memory as floats
+         * grouped by feature, rather than read them from the model's
+         * memory-mapped files.
+         */
+        bool compact = false;
+
+        /**
+         * Whether to allow only the transitions between labels that were
+         * seen in training, visiting only those.
+         */
+        bool mask_transitions = false;
     };
 
     /**
@@ -144,11 +212,30 @@ class crf
      */
     tagger make_tagger() const;
 
+    /**
+     * Constructs a new tagging interface that references the current
+     * model and decodes with the given options.
+     *
+     * @param options The decoding options
+     * @return a new tagging interface for this model
+     */
+    tagger make_tagger(const decoding_options& options) const;
+
     /**
      * @return the number of labels possible under this model.
      */
     uint64_t num_labels() const;
 
+    /**
+     * Scores the labels already on a sequence: the sum of the log-domain
+     * state and transition scores along them, which is what tagging
+     * maximizes.
+     *
+     * @param seq The sequence, with its features and labels set
+     * @return the score of the sequence's labels under this model
+     */
+    double score(const sequence& seq) const;
+
   private:
 
     /**
@@ -196,11 +283,14 @@ class crf
      * @param indices The vector of shuffled indices for the random
      * sampling
      * @param examples The (unshuffled) training examples
+     * @param pool The threads to calibrate with, or nullptr to calibrate
+     * serially
      * @return The optimal `t0` found by calibration, which determines the
      * initial learning rate \f$\eta\f$.
      */
     double calibrate(parameters params, const std::vector<uint64_t>& indices,
-                     const std::vector<sequence>& examples);
+                     const std::vector<sequence>& examples,
+                     parallel::thread_pool* pool);
 
     /**
      * @param idx The internal crf model feature id
@@ -268,6 +358,58 @@ class crf
                  uint64_t iter, const std::vector<uint64_t>& indices,
                  const std::vector<sequence>& examples, scorer& scorer);
 
+    /**
+     * Performs a single epoch of training in parallel, with the update
+     * strategy of the parameters. Each thread scores with its own
+     * scorer.
+     *
+     * @param params The learning parameters
+     * @param progress The progress logger to use
+     * @param iter The current epoch
+     * @param indices The shuffled indices for the random sampling
+     * @param examples The (not shuffled) training examples
+     * @param pool The threads to train with
+     * @return the loss for this training epoch
+     */
+    double epoch(parameters params, printing::progress& progress,
+                 uint64_t iter, const std::vector<uint64_t>& indices,
+                 const std::vector<sequence>& examples,
+                 parallel::thread_pool& pool);
+
+    /**
+     * Performs a parallel epoch of training that applies the updates of
+     * each minibatch together.
+     *
+     * @param params The learning parameters
+     * @param progress The progress logger to use
+     * @param iter The current epoch
+     * @param indices The shuffled indices for the random sampling
+     * @param examples The (not shuffled) training examples
+     * @param pool The threads to train with
+     * @return the loss for this training epoch
+     */
+    double minibatch_epoch(parameters params, printing::progress& progress,
+                           uint64_t iter, const std::vector<uint64_t>& indices,
+                           const std::vector<sequence>& examples,
+                           parallel::thread_pool& pool);
+
+    /**
+     * Performs a parallel epoch of training in which every thread
+     * applies its updates as it goes, without locking.
+     *
+     * @param params The learning parameters
+     * @param progress The progress logger to use
+     * @param iter The current epoch
+     * @param indices The shuffled indices for the random sampling
+     * @param examples The (not shuffled) training examples
+     * @param pool The threads to train with
+     * @return the loss for this training epoch
+     */
+    double lock_free_epoch(parameters params, printing::progress& progress,
+                           uint64_t iter, const std::vector<uint64_t>& indices,
+                           const std::vector<sequence>& examples,
+                           parallel::thread_pool& pool);
+
     /**
      * Performs a single iteration within a training epoch.
      *
@@ -282,25 +424,38 @@ class crf
                      scorer& scorer);
 
     /**
-     * Updates the model parameters based on the observation expectation
-     * part of the gradient.
+     * Finds the updates to the model parameters from the observation
+     * expectation part of the gradient.
      *
      * @param seq The sequence to use
      * @param gain The amount to scale the weight updates by
+     * @param obs_update Called with each observation feature and the
+     * amount to add to its weight
+     * @param trans_update Called with each transition feature and the
+     * amount to add to its weight
      */
-    void gradient_observation_expectation(const sequence& seq, double gain);
+    template <class ObsUpdate, class TransUpdate>
+    void gradient_observation_expectation(const sequence& seq, double gain,
+                                          ObsUpdate&& obs_update,
+                                          TransUpdate&& trans_update) const;
 
     /**
-     * Updates the model parameters based on the model expectation part of
-     * the gradient.
+     * Finds the updates to the model parameters from the model
+     * expectation part of the gradient.
      *
      * @param seq The sequence to use
      * @param gain The amount to scale the weight updates by
      * @param scr The scorer to re-use for computing the marginal
      * probabilities
+     * @param obs_update Called with each observation feature and the
+     * amount to add to its weight
+     * @param trans_update Called with each transition feature and the
+     * amount to add to its weight
      */
+    template <class ObsUpdate, class TransUpdate>
     void gradient_model_expectation(const sequence& seq, double gain,
-                                    const scorer& scr);
+                                    const scorer& scr, ObsUpdate&& obs_update,
+                                    TransUpdate&& trans_update) const;
 
     /**
      * @return the current l2 norm of the weights (\f$w^T w\f$)
@@ -72,6 +72,13 @@ class crf::scorer
      */
     double state(uint64_t time, label_id lbl) const;
 
+    /**
+     * @param time The time step
+     * @return the log-domain scores of every state at the given time,
+     * stored contiguously in order of label
+     */
+    const double* state_row(uint64_t time) const;
+
     /**
      * @param time The time step
      * @param lbl The state
@@ -86,6 +93,13 @@ class crf::scorer
      */
     double trans(label_id from, label_id to) const;
 
+    /**
+     * @param from The origin state
+     * @return the log-domain scores of every transition from the given
+     * state, stored contiguously in order of destination
+     */
+    const double* trans_row(label_id from) const;
+
     /**
      * @param from The origin state
      * @param to The destination state
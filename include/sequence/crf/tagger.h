@@ -10,6 +10,9 @@
 #ifndef META_SEQUENCE_CRF_TAGGER_H_
 #define META_SEQUENCE_CRF_TAGGER_H_
 
+#include <vector>
+
+#include "parallel/thread_pool.h"
 #include "sequence/crf/viterbi_scorer.h"
 
 namespace meta
@@ -26,6 +29,14 @@ class crf::tagger
      */
     tagger(const crf& model);
 
+    /**
+     * Constructs a tagger against the given model that decodes with the
+     * given options.
+     * @param model The model to use for the tagging
+     * @param options The decoding options
+     */
+    tagger(const crf& model, const decoding_options& options);
+
     /**
      * Tags a sequence. The tags will be filled in on the `label` field
      * of each observation within the sequence. (You will need to ask
@@ -35,8 +46,32 @@ class crf::tagger
      */
     void tag(sequence& seq);
 
+    /**
+     * Tags many sequences concurrently. Each thread of the pool takes
+     * sequences a batch at a time until none are left, tagging them with
+     * its own copy of the scorer, whose workspace it reuses from one
+     * sequence to the next; the model itself is shared.
+     * @param seqs The sequences to be tagged
+     * @param pool The threads to tag with
+     */
+    void tag(std::vector<sequence>& seqs, parallel::thread_pool& pool) const;
+
+    /**
+     * Tags many sequences concurrently, with a thread for each core.
+     * @param seqs The sequences to be tagged
+     */
+    void tag(std::vector<sequence>& seqs) const;
+
   private:
     class impl;
+
+    /**
+     * Tags a sequence with the given scorer.
+     * @param seq The sequence to be tagged
+     * @param scorer The scorer to run viterbi with
+     */
+    void tag(sequence& seq, crf::viterbi_scorer& scorer) const;
+
     /// the scorer used internally to run viterbi
     crf::viterbi_scorer scorer_;
     /// the number of labels
@@ -10,6 +10,9 @@
 #ifndef META_SEQUENCE_CRF_VITERBI_SCORER_H_
 #define META_SEQUENCE_CRF_VITERBI_SCORER_H_
 
+#include <memory>
+#include <vector>
+
 #include "sequence/crf/scorer.h"
 
 namespace meta
@@ -29,19 +32,69 @@ class crf::viterbi_scorer
      */
     viterbi_scorer(const crf& model);
 
+    /**
+     * Constructs a new scorer against the given model that decodes with
+     * the given options.
+     * @param model The model to score with
+     * @param options The decoding options
+     */
+    viterbi_scorer(const crf& model, const decoding_options& options);
+
     /**
      * Runs the viterbi algorithm to produce a trellis with
-     * back-pointers.
+     * back-pointers. The trellis is storage the scorer reuses for every
+     * sequence, so that scoring a sequence no longer than those before
+     * it allocates nothing.
      *
      * @param seq The sequence to score
      * @return a trellis with back-pointers indicating the path with
-     * the highest score
+     * the highest score, valid until the next call
      */
-    viterbi_trellis viterbi(const sequence& seq);
+    const viterbi_trellis& viterbi(const sequence& seq);
 
   private:
+    /**
+     * The observation weights of a model, scaled, as floats grouped by
+     * feature.
+     */
+    struct compact_weights
+    {
+        /// where the labels of each feature start, and the total at the
+        /// end
+        std::vector<uint64_t> offsets;
+        /// the label of each weight
+        std::vector<label_id> labels;
+        /// the weights
+        std::vector<float> weights;
+    };
+
+    /**
+     * Computes the log-domain state scores of a sequence from the compact
+     * weights.
+     * @param seq The sequence to score
+     */
+    void compact_state_scores(const sequence& seq);
+
+    /// the options decoding is done with
+    decoding_options options_;
     /// the internal scorer used
     crf::scorer scorer_;
+    /// the compact weights, if they are used, shared by copies of the
+    /// scorer
+    std::shared_ptr<const compact_weights> compact_;
+    /// the state scores computed from the compact weights
+    util::dense_matrix<double> state_;
+    /// where the transitions allowed from each label start, and the total
+    /// at the end, if transitions are masked
+    std::vector<uint64_t> successor_offsets_;
+    /// the destination of each allowed transition
+    std::vector<label_id> successors_;
+    /// the labels extended from the previous time step
+    std::vector<label_id> beam_;
+    /// the trellis filled in for the last sequence scored
+    viterbi_trellis table_;
+    /// the best previous label of each label at the current time step
+    std::vector<label_id> best_;
     /// a back-pointer to the model this scorer uses to tag
     const crf* model_;
 };
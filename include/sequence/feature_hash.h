@@ -0,0 +1,120 @@
+/**
+ * @file feature_hash.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_SEQUENCE_FEATURE_HASH_H_
+#define META_SEQUENCE_FEATURE_HASH_H_
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace meta
+{
+namespace sequence
+{
+
+/**
+ * A 64-bit FNV-1a hash of a feature's string representation, built up a
+ * piece at a time. Appending the pieces of a string gives the same hash
+ * as hashing the whole string, so an observation function can describe a
+ * feature such as "w[t]_suffix_2=" followed by the end of a word without
+ * ever building the string:
+ *
+ * ~~~{.cpp}
+ * coll.add(feature_hash{"w[t]_suffix_2="}.append(word.data() + size - 2, 2),
+ *          1);
+ * ~~~
+ */
+class feature_hash
+{
+  public:
+    /**
+     * The hash of the empty string.
+     */
+    feature_hash() : hash_{14695981039346656037ULL}
+    {
+        // nothing
+    }
+
+    /**
+     * @param str The start of the feature's string representation
+     */
+    explicit feature_hash(const char* str) : feature_hash{}
+    {
+        append(str, std::strlen(str));
+    }
+
+    /**
+     * @param str The start of the feature's string representation
+     */
+    explicit feature_hash(const std::string& str) : feature_hash{}
+    {
+        append(str);
+    }
+
+    /**
+     * Appends characters to the feature.
+     * @param data The characters
+     * @param length The number of characters
+     * @return this hash
+     */
+    feature_hash& append(const char* data, uint64_t length)
+    {
+        for (uint64_t i = 0; i < length; ++i)
+            append(data[i]);
+        return *this;
+    }
+
+    /**
+     * Appends a null-terminated string to the feature.
+     * @param str The string
+     * @return this hash
+     */
+    feature_hash& append(const char* str)
+    {
+        return append(str, std::strlen(str));
+    }
+
+    /**
+     * Appends a string to the feature.
+     * @param str The string
+     * @return this hash
+     */
+    feature_hash& append(const std::string& str)
+    {
+        return append(str.data(), str.size());
+    }
+
+    /**
+     * Appends a character to the feature.
+     * @param c The character
+     * @return this hash
+     */
+    feature_hash& append(char c)
+    {
+        hash_ ^= static_cast<unsigned char>(c);
+        hash_ *= 1099511628211ULL;
+        return *this;
+    }
+
+    /**
+     * @return the hash of the feature's string representation
+     */
+    uint64_t value() const
+    {
+        return hash_;
+    }
+
+  private:
+    /// The hash of the characters appended so far
+    uint64_t hash_;
+};
+}
+}
+
+#endif
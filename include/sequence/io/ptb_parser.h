@@ -9,6 +9,7 @@
 #ifndef META_PTB_PARSER_H_
 #define META_PTB_PARSER_H_
 
+#include "parallel/thread_pool.h"
 #include "sequence/sequence.h"
 
 namespace meta
@@ -25,6 +26,31 @@ namespace sequence
  */
 std::vector<sequence> extract_sequences(const std::string& filename);
 
+/**
+ * Reads several Penn Treebank formatted part of speech tagged files at
+ * once, each file being parsed by one of the threads of a pool.
+ *
+ * @param filenames The names of the files to be parsed
+ * @param pool The thread pool to parse the files on
+ * @return all of the sequences that were parsed from the given files, in
+ * the order of the files, as if each had been given to
+ * extract_sequences() in turn
+ */
+std::vector<sequence>
+    extract_sequences(const std::vector<std::string>& filenames,
+                      parallel::thread_pool& pool);
+
+/**
+ * Reads several Penn Treebank formatted part of speech tagged files at
+ * once on the default thread pool (see parallel::default_pool()).
+ *
+ * @param filenames The names of the files to be parsed
+ * @return all of the sequences that were parsed from the given files, in
+ * the order of the files
+ */
+std::vector<sequence>
+    extract_sequences(const std::vector<std::string>& filenames);
+
 }
 }
 #endif
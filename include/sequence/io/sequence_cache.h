@@ -0,0 +1,54 @@
+/**
+ * @file sequence_cache.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_SEQUENCE_CACHE_H_
+#define META_SEQUENCE_CACHE_H_
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "sequence/sequence.h"
+
+namespace meta
+{
+namespace sequence
+{
+
+/**
+ * Exception thrown when a cache of sequences cannot be read.
+ */
+class sequence_cache_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * Saves analyzed sequences, with the symbol, tag, label, and features of
+ * every observation, in a binary file, so that later training runs can
+ * load them with load_sequences() instead of parsing and analyzing their
+ * corpus again. The feature and label ids only have meaning with the
+ * sequence_analyzer that gave them, which must be saved alongside.
+ *
+ * @param sequences The analyzed sequences
+ * @param filename The file to save them to
+ */
+void save_sequences(const std::vector<sequence>& sequences,
+                    const std::string& filename);
+
+/**
+ * Loads sequences saved with save_sequences().
+ *
+ * @param filename The file the sequences were saved to
+ * @return the sequences, analyzed as they were when they were saved
+ */
+std::vector<sequence> load_sequences(const std::string& filename);
+}
+}
+#endif
@@ -98,6 +98,13 @@ class observation
      */
     void features(feature_vector feats);
 
+    /**
+     * Takes the features away from this observation, leaving it with
+     * none, so that their storage can be reused.
+     * @return the features this observation had
+     */
+    feature_vector release_features();
+
     /**
      * Basic exception class for observation interactions.
      */
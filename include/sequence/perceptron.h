@@ -9,9 +9,13 @@
 #ifndef META_SEQUENCE_PERCEPTRON_H_
 #define META_SEQUENCE_PERCEPTRON_H_
 
+#include <memory>
 #include <random>
+#include <vector>
 
+#include "classify/models/frozen_linear_model.h"
 #include "classify/models/linear_model.h"
+#include "parallel/thread_pool.h"
 #include "sequence/sequence_analyzer.h"
 
 namespace meta
@@ -40,6 +44,15 @@ class perceptron
          * examples during training.
          */
         std::random_device::result_type seed = std::random_device{}();
+
+        /**
+         * The number of threads to train with. With one, the sequences
+         * are learned from one at a time; with more, each epoch the
+         * shuffled sequences are split into a shard per thread, each
+         * shard is learned from independently, and the shards' weights
+         * are averaged (iterative parameter mixing).
+         */
+        uint64_t num_threads = 1;
     };
 
     /**
@@ -48,7 +61,8 @@ class perceptron
     perceptron();
 
     /**
-     * Loads a perceptron tagger from a given prefix.
+     * Loads a perceptron tagger from a given prefix, mapping its frozen
+     * model into memory if it has one.
      * @param prefix The folder that contains the tagger model
      */
     perceptron(const std::string& prefix);
@@ -60,6 +74,21 @@ class perceptron
      */
     void tag(sequence& seq) const;
 
+    /**
+     * Tags many sequences concurrently. Each thread of the pool takes
+     * sequences a batch at a time until none are left; the model and
+     * analyzer are only read, so they are shared by every thread.
+     * @param seqs The sequences to be tagged
+     * @param pool The threads to tag with
+     */
+    void tag(std::vector<sequence>& seqs, parallel::thread_pool& pool) const;
+
+    /**
+     * Tags many sequences concurrently, with a thread for each core.
+     * @param seqs The sequences to be tagged
+     */
+    void tag(std::vector<sequence>& seqs) const;
+
     /**
      * Trains the tagger on a set of sequences using the given options. The
      * sequences given for training will be analyzed by the tagger
@@ -73,13 +102,24 @@ class perceptron
 
     /**
      * Saves the model to the folder specified by prefix. Both the tagger
-     * and its analyzer are serialized.
+     * and its analyzer are serialized, and the tagger is also written as
+     * a frozen model that later loads without being read.
      *
      * @param prefix The folder to save the model to
      */
     void save(const std::string& prefix) const;
 
   private:
+    /**
+     * Trains the tagger by iterative parameter mixing over
+     * options.num_threads shards.
+     *
+     * @param sequences The training data
+     * @param options The training options
+     */
+    void train_parallel(std::vector<sequence>& sequences,
+                        const training_options& options);
+
     /**
      * The analyzer used for feature generation.
      */
@@ -89,6 +129,13 @@ class perceptron
      * The model storage.
      */
     classify::linear_model<feature_id, double, label_id> model_;
+
+    /**
+     * The frozen model the tagger was loaded from, if any, which is used
+     * in place of model_.
+     */
+    std::unique_ptr<classify::frozen_linear_model<feature_id, label_id>>
+        frozen_;
 };
 }
 }
@@ -16,6 +16,8 @@
 #include <unordered_map>
 
 #include "meta.h"
+#include "parallel/thread_pool.h"
+#include "sequence/feature_hash.h"
 #include "sequence/sequence.h"
 #include "util/invertible_map.h"
 
@@ -45,6 +47,14 @@ namespace sequence
  *     coll.add("w[t]=" + word, 1);
  * };
  * ~~~
+ *
+ * Features are identified by the hash of their string representation,
+ * so a function may instead give the hash of the pieces of the string,
+ * which builds no string at all:
+ *
+ * ~~~{.cpp}
+ * coll.add(feature_hash{"w[t]="}.append(word), 1);
+ * ~~~
  */
 class sequence_analyzer
 {
@@ -112,6 +122,28 @@ class sequence_analyzer
      */
     void analyze(sequence& sequence, uint64_t idx);
 
+    /**
+     * Analyzes many sequences at once on a pool of threads, generating new
+     * label_ids and feature_ids for unseen elements. Each thread hashes the
+     * features of its share of the sequences, noting the features and tags
+     * it meets for the first time; these are then given ids in order, and
+     * the threads look up the ids of all of their features. The ids are
+     * those that analyzing the sequences one after the other would give.
+     *
+     * @param sequences The sequences to be analyzed
+     * @param pool The thread pool to analyze them on
+     */
+    void analyze(std::vector<sequence>& sequences,
+                 parallel::thread_pool& pool);
+
+    /**
+     * Analyzes many sequences at once on the default thread pool (see
+     * parallel::default_pool()).
+     *
+     * @param sequences The sequences to be analyzed
+     */
+    void analyze(std::vector<sequence>& sequences);
+
     /**
      * Analyzes a sequence, but ignores any new label_ids or feature_ids.
      * Used for analyzing test items, for example, so that existing models
@@ -149,6 +181,25 @@ class sequence_analyzer
      */
     feature_id feature(const std::string& feature) const;
 
+    /**
+     * Looks up the feature id for the feature with the given hash. If one
+     * doesn't exist, it will assign the next feature_id to this feature.
+     *
+     * @param feature The hash of the feature's string representation
+     * @return the feature id associated (or just assigned to) this feature
+     */
+    feature_id feature(const feature_hash& feature);
+
+    /**
+     * Looks up the feature id for the feature with the given hash,
+     * without assigning one if it doesn't exist.
+     *
+     * @param feature The hash of the feature's string representation
+     * @return the feature id associated with this feature, or the
+     * "one-past-the-end" feature id
+     */
+    feature_id feature(const feature_hash& feature) const;
+
     /**
      * @return the number of feature_ids used so far to describe observations
      */
@@ -204,9 +255,12 @@ class sequence_analyzer
          * Constructs the collector over a given observation.
          * @param obs A pointer to the observation to be analyzed
          */
-        collector(observation* obs) : obs_{obs}
+        collector(observation* obs)
+            : obs_{obs}, feats_(obs->release_features())
         {
-            // nothing
+            // reuse the storage of the features the observation had, if
+            // it was analyzed before
+            feats_.clear();
         }
 
         /**
@@ -229,7 +283,17 @@ class sequence_analyzer
          * @param feat The string representation of the feature to add
          * @param amount The value associated with this feature (typically 1)
          */
-        virtual void add(const std::string& feat, double amount)
+        void add(const std::string& feat, double amount)
+        {
+            add(feature_hash{feat}, amount);
+        }
+
+        /**
+         * Adds a new feature to this observation.
+         * @param feat The hash of the feature's string representation
+         * @param amount The value associated with this feature (typically 1)
+         */
+        virtual void add(const feature_hash& feat, double amount)
         {
             feats_.emplace_back(feature(feat), amount);
         }
@@ -239,7 +303,7 @@ class sequence_analyzer
          * @param feat The feature to obtain an id for
          * @return the feature_id for this feature
          */
-        virtual feature_id feature(const std::string& feat) = 0;
+        virtual feature_id feature(const feature_hash& feat) = 0;
 
         /// the observation we are collecting data for
         observation* obs_;
@@ -276,7 +340,7 @@ class sequence_analyzer
         /// back-pointer to the analyzer for this collector
         Analyzer* analyzer_;
 
-        virtual feature_id feature(const std::string& feat)
+        virtual feature_id feature(const feature_hash& feat)
         {
             return analyzer_->feature(feat);
         }
@@ -300,10 +364,11 @@ class sequence_analyzer
     {
       public:
         using basic_collector<const sequence_analyzer>::basic_collector;
+        using basic_collector<const sequence_analyzer>::add;
 
         // special case add to not actually add if a brand new feature id
         // is found
-        virtual void add(const std::string& feat, double amount)
+        virtual void add(const feature_hash& feat, double amount)
         {
             auto fid = feature(feat);
             if (fid != analyzer_->num_features())
@@ -318,6 +383,13 @@ class sequence_analyzer
      */
     void load_feature_id_mapping(const std::string& prefix);
 
+    /**
+     * Loads the feature_id mapping from disk in the format of old models,
+     * which stored the features' strings rather than their hashes.
+     * @param prefix The folder to load the mapping from
+     */
+    void load_legacy_feature_id_mapping(const std::string& prefix);
+
     /**
      * Loads the label_id mapping from disk.
      * @param prefix The folder to load the mapping from
@@ -337,8 +409,8 @@ class sequence_analyzer
     std::vector<std::function<void(const sequence&, uint64_t, collector&)>>
         obs_fns_;
 
-    /// The feature_id mapping (string to id)
-    std::unordered_map<std::string, feature_id> feature_id_mapping_;
+    /// The feature_id mapping (hash of the string to id)
+    std::unordered_map<uint64_t, feature_id> feature_id_mapping_;
 
     /// The label_id mapping (tag_t to label_id)
     util::invertible_map<tag_t, label_id> label_id_mapping_;
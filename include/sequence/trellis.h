@@ -41,6 +41,16 @@ class trellis
      */
     trellis(uint64_t size, uint64_t labels);
 
+    /**
+     * Resizes the trellis to the given number of time steps and labels,
+     * resetting every value. The storage is reused when it is already
+     * large enough.
+     *
+     * @param size The number of time steps
+     * @param labels The number of labels associated with each time step
+     */
+    void resize(uint64_t size, uint64_t labels);
+
     /**
      * @return The number of time steps in the trellis.
      */
@@ -63,6 +73,20 @@ class trellis
      * @return the value in the trellis at that location
      */
     double probability(uint64_t idx, const label_id& tag) const;
+
+    /**
+     * @param idx The time step
+     * @return the values of every label at the given time step, stored
+     * contiguously in order of label
+     */
+    double* row(uint64_t idx);
+
+    /**
+     * @param idx The time step
+     * @return the values of every label at the given time step, stored
+     * contiguously in order of label
+     */
+    const double* row(uint64_t idx) const;
 };
 
 /**
@@ -121,6 +145,16 @@ class viterbi_trellis : public trellis
      */
     viterbi_trellis(uint64_t size, uint64_t labels);
 
+    /**
+     * Resizes the trellis and its back pointers to the given number of
+     * time steps and labels, reusing their storage when it is already
+     * large enough.
+     *
+     * @param size The number of time steps
+     * @param labels The number of labels
+     */
+    void resize(uint64_t size, uint64_t labels);
+
     /**
      * Sets the back pointer for the given time step and label to the
      * given label.
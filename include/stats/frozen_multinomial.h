@@ -0,0 +1,137 @@
+/**
+ * @file frozen_multinomial.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_STATS_FROZEN_MULTINOMIAL_H_
+#define META_STATS_FROZEN_MULTINOMIAL_H_
+
+#include <cstdint>
+#include <vector>
+
+#include "stats/multinomial.h"
+
+namespace meta
+{
+namespace stats
+{
+
+/**
+ * A categorical distribution that no longer changes, prepared for
+ * drawing many samples from. Building one takes O(n) time for n events.
+ * After that, a random sample takes O(1) time with Vose's alias method,
+ * and the event at a given quantile takes O(log n) time with a
+ * cumulative table.
+ *
+ * A multinomial walks all of its events for every sample. A caller that
+ * draws more than a few samples between changes to the distribution
+ * should freeze it first.
+ */
+template <class T>
+class frozen_multinomial
+{
+  public:
+    /**
+     * The event type for this distribution.
+     */
+    using event_type = T;
+
+    /**
+     * Freezes the observed events of a multinomial. Each event is
+     * weighted by its probability, prior included. Events that have never
+     * been observed cannot be sampled.
+     *
+     * @param dist The distribution to freeze
+     */
+    explicit frozen_multinomial(const multinomial<T>& dist);
+
+    /**
+     * Creates a distribution over events from their weights, which need
+     * not sum to one.
+     *
+     * @param events The events
+     * @param weights The weight of each event, in the same order
+     */
+    frozen_multinomial(std::vector<T> events,
+                       const std::vector<double>& weights);
+
+    /**
+     * Creates a distribution over the events T{0} to T{n - 1} from their
+     * weights, which need not sum to one.
+     *
+     * @param weights The weight of each event
+     */
+    explicit frozen_multinomial(const std::vector<double>& weights);
+
+    /**
+     * Samples from the distribution in constant time.
+     * @param gen The random number generator to be used
+     * @return the event drawn
+     */
+    template <class Generator>
+    const T& operator()(Generator&& gen) const;
+
+    /**
+     * Draws several samples from the distribution.
+     * @param gen The random number generator to be used
+     * @param num_samples The number of samples to draw
+     * @param out The output iterator to write the samples to
+     * @return the output iterator past the last sample
+     */
+    template <class Generator, class OutputIterator>
+    OutputIterator sample(Generator&& gen, uint64_t num_samples,
+                          OutputIterator out) const;
+
+    /**
+     * Finds the event at a quantile of the distribution, in the order
+     * the events were given, in logarithmic time. A uniform value in
+     * [0, 1) therefore gives a sample. Callers that bring their own random
+     * value use this.
+     *
+     * @param quantile The quantile, in [0, 1]
+     * @return the first event whose cumulative probability exceeds
+     * quantile
+     */
+    const T& quantile(double quantile) const;
+
+    /**
+     * @param idx The position of an event
+     * @return the probability of that event
+     */
+    double probability(uint64_t idx) const;
+
+    /**
+     * @return the events of the distribution
+     */
+    const std::vector<T>& events() const;
+
+    /**
+     * @return the number of events
+     */
+    uint64_t size() const;
+
+  private:
+    /**
+     * Fills the alias and cumulative tables from the weights.
+     * @param weights The weight of each event
+     */
+    void build(const std::vector<double>& weights);
+
+    /// the events, in the order they were given
+    std::vector<T> events_;
+    /// the probability of keeping each column's own event in the alias
+    /// method
+    std::vector<double> keep_;
+    /// the event each column gives instead of its own
+    std::vector<uint64_t> alias_;
+    /// the running total of the normalized probabilities
+    std::vector<double> cumulative_;
+};
+}
+}
+
+#include "stats/frozen_multinomial.tcc"
+#endif
@@ -0,0 +1,159 @@
+/**
+ * @file frozen_multinomial.tcc
+ */
+
+#include <algorithm>
+#include <random>
+#include <stdexcept>
+
+#include "stats/frozen_multinomial.h"
+
+namespace meta
+{
+namespace stats
+{
+
+template <class T>
+frozen_multinomial<T>::frozen_multinomial(const multinomial<T>& dist)
+{
+    std::vector<double> weights;
+    dist.each_seen_event([&](const T& event)
+                         {
+        events_.push_back(event);
+        weights.push_back(dist.probability(event));
+    });
+    build(weights);
+}
+
+template <class T>
+frozen_multinomial<T>::frozen_multinomial(std::vector<T> events,
+                                          const std::vector<double>& weights)
+    : events_{std::move(events)}
+{
+    if (events_.size() != weights.size())
+        throw std::runtime_error{"every event needs one weight"};
+    build(weights);
+}
+
+template <class T>
+frozen_multinomial<T>::frozen_multinomial(const std::vector<double>& weights)
+{
+    events_.reserve(weights.size());
+    for (uint64_t i = 0; i < weights.size(); ++i)
+        events_.push_back(T{i});
+    build(weights);
+}
+
+template <class T>
+void frozen_multinomial<T>::build(const std::vector<double>& weights)
+{
+    double total = 0;
+    for (const auto& weight : weights)
+    {
+        if (!(weight >= 0))
+            throw std::runtime_error{"event weights must not be negative"};
+        total += weight;
+    }
+    if (!(total > 0))
+        throw std::runtime_error{"no event has a positive weight"};
+
+    auto size = weights.size();
+    cumulative_.resize(size);
+    double sum = 0;
+    for (uint64_t i = 0; i < size; ++i)
+    {
+        sum += weights[i];
+        cumulative_[i] = sum / total;
+    }
+
+    // Vose's alias method: every column holds 1/size of the probability,
+    // made up of its own event's and, when that is short, of one other
+    // event's that has more than 1/size
+    keep_.assign(size, 1.0);
+    alias_.resize(size);
+    std::vector<double> scaled(size);
+    std::vector<uint64_t> small;
+    std::vector<uint64_t> large;
+    for (uint64_t i = 0; i < size; ++i)
+    {
+        alias_[i] = i;
+        scaled[i] = weights[i] * size / total;
+        if (scaled[i] < 1)
+            small.push_back(i);
+        else
+            large.push_back(i);
+    }
+
+    while (!small.empty() && !large.empty())
+    {
+        auto less = small.back();
+        small.pop_back();
+        auto more = large.back();
+
+        keep_[less] = scaled[less];
+        alias_[less] = more;
+        scaled[more] = (scaled[more] + scaled[less]) - 1;
+        if (scaled[more] < 1)
+        {
+            large.pop_back();
+            small.push_back(more);
+        }
+    }
+    // whatever is left over is 1 up to rounding error, and so keeps its
+    // whole column
+}
+
+template <class T>
+template <class Generator>
+const T& frozen_multinomial<T>::operator()(Generator&& gen) const
+{
+    // the whole part of a single uniform value picks the column, and its
+    // fractional part picks between the column's two events
+    auto size = events_.size();
+    std::uniform_real_distribution<double> dist{0, static_cast<double>(size)};
+    auto value = dist(gen);
+    auto column = std::min(static_cast<uint64_t>(value), size - 1);
+    if (value - column < keep_[column])
+        return events_[column];
+    return events_[alias_[column]];
+}
+
+template <class T>
+template <class Generator, class OutputIterator>
+OutputIterator frozen_multinomial<T>::sample(Generator&& gen,
+                                             uint64_t num_samples,
+                                             OutputIterator out) const
+{
+    for (uint64_t i = 0; i < num_samples; ++i)
+        *out++ = (*this)(gen);
+    return out;
+}
+
+template <class T>
+const T& frozen_multinomial<T>::quantile(double quantile) const
+{
+    auto it = std::upper_bound(cumulative_.begin(), cumulative_.end(),
+                               quantile);
+    auto idx = std::min<uint64_t>(it - cumulative_.begin(), size() - 1);
+    return events_[idx];
+}
+
+template <class T>
+double frozen_multinomial<T>::probability(uint64_t idx) const
+{
+    return cumulative_[idx] - (idx > 0 ? cumulative_[idx - 1] : 0);
+}
+
+template <class T>
+const std::vector<T>& frozen_multinomial<T>::events() const
+{
+    return events_;
+}
+
+template <class T>
+uint64_t frozen_multinomial<T>::size() const
+{
+    return events_.size();
+}
+}
+}
@@ -4,6 +4,7 @@
  */
 
 #include <random>
+#include <stdexcept>
 #include <unordered_map>
 #include "stats/multinomial.h"
 #include "util/identifiers.h"
@@ -40,6 +40,27 @@ int content_tokenize();
  */
 int file_tokenize();
 
+/**
+ * Test that documents tokenized into the feature ids of a shared
+ * vocabulary count the same terms as documents tokenized by text.
+ * @return the number of tests failed
+ */
+int feature_tokenize();
+
+/**
+ * Test that the ICU tokenizer splits content into sentences and words,
+ * and that it can be reused for several documents.
+ * @return the number of tests failed
+ */
+int icu_tokenize();
+
+/**
+ * Test that the ICU tokenizer gives the same tokens for ASCII content on
+ * its fast path as through ICU.
+ * @return the number of tests failed
+ */
+int ascii_tokenize();
+
 /**
  * Runs the analyzer tests.
  * @return the number of tests failed
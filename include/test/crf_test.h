@@ -0,0 +1,27 @@
+/**
+ * @file crf_test.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_CRF_TEST_H_
+#define META_CRF_TEST_H_
+
+#include "test/unit_test.h"
+
+namespace meta
+{
+namespace testing
+{
+
+/**
+ * Runs the CRF training and tagging tests.
+ * @return the number of tests failed
+ */
+int crf_tests();
+}
+}
+
+#endif
@@ -14,6 +14,9 @@
 #include <iostream>
 #include "test/unit_test.h"
 #include "index/forward_index.h"
+#include "index/hnsw_index.h"
+#include "index/near_duplicates.h"
+#include "io/libsvm_parser.h"
 #include "test/inverted_index_test.h" // for config file creation
 #include "caching/all.h"
 #include "cpptoml.h"
@@ -27,6 +30,12 @@ namespace testing
  */
 void create_libsvm_config();
 
+/**
+ * Checks that MinHash and SimHash near-duplicate detection finds the
+ * clusters that comparing every pair of documents does.
+ */
+void check_near_duplicates();
+
 /**
  * Asserts that the bcancer corpus was created correctly.
  * @param idx The index to use
@@ -10,11 +10,42 @@
 #ifndef META_INVERTED_INDEX_TEST_H_
 #define META_INVERTED_INDEX_TEST_H_
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
 #include "test/unit_test.h"
+#include "analyzers/analyzer.h"
+#include "corpus/corpus.h"
+#include "corpus/file_corpus.h"
+#include "corpus/line_corpus.h"
+#include "corpus/tokenized_corpus.h"
+#if META_HAS_ZLIB
+#include "corpus/gz_corpus.h"
+#include "io/bgzf.h"
+#endif
+#include "index/chunk_handler.h"
+#include "index/completion_index.h"
+#include "index/distributed_build.h"
+#include "index/field_store.h"
+#include "index/forward_index.h"
+#include "index/hot_terms.h"
+#include "index/index_handle.h"
 #include "index/inverted_index.h"
+#include "index/merging.h"
+#include "index/phrase_query.h"
+#include "index/positions_cursor.h"
+#include "index/postings_buffer.h"
 #include "index/postings_data.h"
+#include "index/ranker/okapi_bm25.h"
+#include "index/sharded_index.h"
+#include "index/vocabulary_map.h"
+#include "parallel/thread_pool.h"
 #include "caching/all.h"
 #include "cpptoml.h"
 
@@ -42,6 +73,126 @@ void check_ceeaus_expected(Index& idx);
 template <class Index>
 void check_term_id(Index& idx);
 
+/**
+ * Checks that looking up many terms at once agrees with looking them up
+ * one at a time, including for repeated and unknown terms.
+ * @param idx The index to check
+ */
+template <class Index>
+void check_term_ids(Index& idx);
+
+/**
+ * Checks that a cached index can be warmed with the hot terms of a query
+ * log or a term frequency list, and that its cached keys survive being
+ * saved and loaded again.
+ * @param idx The index to check
+ */
+template <class Index>
+void check_cache_warm_up(Index& idx);
+
+/**
+ * Checks that ranking against a cached index gives the results of an
+ * uncached one, while reading postings through the cache.
+ */
+void check_cursor_cache();
+
+/**
+ * Checks that an index_handle publishes swapped and reloaded versions,
+ * that snapshots keep their version open, and that a reload carries the
+ * cache of the current version over to the new one.
+ */
+void check_index_handle();
+
+/**
+ * Checks that the postings of terms moved into the hot tier read the
+ * same as from the postings file, that the tier survives reloading the
+ * index, and that it can be removed.
+ */
+void check_hot_tier();
+
+/**
+ * Checks that a completion index returns the heaviest terms with a
+ * prefix, and of ranges of term ids, that a scan of every term finds,
+ * with weights from term counts, document frequencies, and a query log.
+ */
+void check_completions();
+
+/**
+ * Checks that an index built in checkpoints, whether uninterrupted or
+ * resumed after being interrupted while building its parts or merging
+ * them, equals an index built at once.
+ */
+void check_checkpoints();
+
+/**
+ * Checks that the parts of a distributed build hold the postings of their
+ * documents, and that merging them gives the postings and vocabulary of
+ * an index built at once, with any number of parts.
+ */
+void check_distributed_build();
+
+/**
+ * Checks that doc_metadata packs columns of widely varying widths without
+ * losing any values, and that an index's packed metadata agrees with its
+ * columns.
+ * @param idx The index to check
+ */
+void check_doc_metadata(index::inverted_index& idx);
+
+/**
+ * Checks that the typed fields declared in a configuration are read from
+ * the corpus into inverted and forward indexes, survive reloading, and
+ * filter ranked results.
+ */
+void check_fields();
+
+/**
+ * Checks that a gdsf_cache stays within its byte budget, prefers small,
+ * frequently used values, and turns away large values it has rarely seen.
+ */
+void check_gdsf_cache();
+
+/**
+ * Checks that a concurrent_map keeps every entry written to it by several
+ * threads at once, while other threads read it.
+ */
+void check_concurrent_map();
+
+/**
+ * Checks that the stored term positions agree with a fresh tokenization of
+ * some of the documents, and that phrases taken from those documents are
+ * found by a phrase_query.
+ * @param idx The positional index to check
+ */
+void check_positions(index::inverted_index& idx);
+
+/**
+ * Checks that a postings_buffer returns the postings it was given, sorted
+ * by primary key and with repeated secondary keys combined.
+ */
+void check_postings_buffer();
+
+/**
+ * Checks that a chunk_handler merges the postings of several chunks into
+ * one postings_data per primary key, in order across all parts.
+ * @param num_parts The number of parts to split the merge into
+ */
+void check_chunk_merge(uint64_t num_parts);
+
+/**
+ * Checks that looking up many (term, document) counts at once agrees with
+ * looking each of them up alone, whatever order they are given in.
+ * @param idx The index to check
+ */
+void check_term_freqs(index::inverted_index& idx);
+
+/**
+ * Checks that merging an index with itself concatenates its documents
+ * and the postings and positions of each of its terms.
+ * @param idx The positional index to merge
+ */
+void check_merge(const std::shared_ptr<index::inverted_index>& idx);
+
 /**
  * Runs the inverted index tests.
  * @return the number of tests failed
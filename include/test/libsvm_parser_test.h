@@ -11,7 +11,9 @@
 #define META_LIBSVM_PARSER_TEST_H_
 
 #include "test/unit_test.h"
+#include "io/delimiter_scanner.h"
 #include "io/libsvm_parser.h"
+#include "io/parser.h"
 
 namespace meta
 {
@@ -37,6 +39,31 @@ void bad_label();
  */
 void bad_counts();
 
+/**
+ * Tests that values are parsed exactly as strtod parses them.
+ */
+void exact_values();
+
+/**
+ * Tests lines that are malformed or have extra whitespace.
+ */
+void malformed_lines();
+
+/**
+ * Tests parsing part of a buffer into a reused vector.
+ */
+void in_place();
+
+/**
+ * Tests delimiter_scanner against a byte-by-byte scan.
+ */
+void delimiter_scanning();
+
+/**
+ * Tests that io::parser splits strings and files as before.
+ */
+void tokenizing();
+
 /**
  * Runs all the libsvm parser tests.
  * @return the number of tests failed
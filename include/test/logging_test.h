@@ -0,0 +1,26 @@
+/**
+ * @file logging_test.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_LOGGING_TEST_H_
+#define META_LOGGING_TEST_H_
+
+#include "test/unit_test.h"
+
+namespace meta
+{
+namespace testing
+{
+
+/**
+ * Runs all the logging tests.
+ * @return the number of tests failed
+ */
+int logging_tests();
+}
+}
+#endif
@@ -12,10 +12,18 @@
 
 #include <cmath>
 #include <algorithm>
+#include <fstream>
+#include <list>
 #include <numeric>
+#include <random>
+#include <set>
 
 #include "test/unit_test.h"
+#include "util/filesystem.h"
 #include "util/time.h"
+#include "parallel/algorithm.h"
+#include "parallel/bounded_queue.h"
+#include "parallel/default_pool.h"
 #include "parallel/parallel_for.h"
 #include "parallel/thread_pool.h"
 
@@ -51,6 +59,70 @@ int test_correctness(std::vector<double>& v);
  */
 int test_threadpool();
 
+/**
+ * Tests that tasks waiting with thread_pool::wait() for tasks they
+ * submitted finish, even when every worker is waiting.
+ * @return the number of tests failed
+ */
+int test_nested_wait();
+
+/**
+ * Tests that tasks all queued on one worker are stolen by the others.
+ * @return the number of tests failed
+ */
+int test_stealing();
+
+/**
+ * Tests that destroying a thread_pool runs the tasks still queued.
+ * @return the number of tests failed
+ */
+int test_shutdown();
+
+/**
+ * Tests that the default pool is shared, runs the algorithms not given a
+ * pool with the same results as serial code, and cannot be resized once
+ * it is running.
+ * @return the number of tests failed
+ */
+int test_default_pool();
+
+/**
+ * Tests that parallel_chunks covers every index exactly once, in chunks
+ * no longer than the grain, and never runs two chunks on one task at
+ * once.
+ * @return the number of tests failed
+ */
+int test_chunks();
+
+/**
+ * Tests that parallel_reduce, parallel_transform, and parallel_for over a
+ * forward range give the same results as serial code.
+ * @return the number of tests failed
+ */
+int test_reduce_transform();
+
+/**
+ * Tests that the parallel sort, merge and stable_partition give the same
+ * results as their serial counterparts in the standard library.
+ * @return the number of tests failed
+ */
+int test_algorithms();
+
+/**
+ * Tests cpu list parsing, and that pools placed on NUMA nodes number
+ * their workers by node and run tasks given to a worker with submit_to()
+ * with the same results as serial code.
+ * @return the number of tests failed
+ */
+int test_placement();
+
+/**
+ * Tests that every item pushed onto a bounded_queue by several producers
+ * is popped exactly once by several consumers.
+ * @return the number of tests failed
+ */
+int test_bounded_queue();
+
 /**
  * Tests all the parallel functions.
  * @return the number of tests failed
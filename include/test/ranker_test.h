@@ -12,7 +12,15 @@
 
 #include "test/unit_test.h"
 #include "test/inverted_index_test.h"
+#include "index/feedback.h"
+#include "index/forward_index.h"
+#include "index/impact_index.h"
+#include "index/pruning.h"
 #include "index/ranker/all.h"
+#include "index/ranker/prepared_query.h"
+#include "index/ranker/query_cache.h"
+#include "index/segmented_index.h"
+#include "index/sharded_index.h"
 
 namespace meta
 {
@@ -27,6 +35,219 @@ namespace testing
 template <class Ranker, class Index>
 void test_rank(Ranker& r, Index& idx);
 
+/**
+ * Checks that a ranker scores blocks of postings as it scores each of
+ * their postings alone.
+ * @param r The ranker to test
+ * @param idx The index to use
+ */
+template <class Ranker>
+void test_score_postings(Ranker& r, index::inverted_index& idx);
+
+/**
+ * Checks that a ranker's document-at-a-time scoring returns the same
+ * results as exhaustive term-at-a-time scoring.
+ * @param r The ranker to test
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+template <class Ranker, class Index>
+void test_document_at_a_time(Ranker& r, Index& idx,
+                             const std::string& encoding);
+
+/**
+ * Checks that a ranker's conjunctive scoring returns exactly the
+ * documents containing every query term, with the scores term-at-a-time
+ * scoring gives them.
+ * @param r The ranker to test
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+template <class Ranker>
+void test_conjunctive(Ranker& r, index::inverted_index& idx,
+                      const std::string& encoding);
+
+/**
+ * Checks that a single ranker gives the same results when queries are
+ * scored concurrently as when they are scored one at a time.
+ * @param r The ranker to test
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+template <class Ranker, class Index>
+void test_concurrent_queries(Ranker& r, Index& idx,
+                             const std::string& encoding);
+
+/**
+ * Checks that scoring a batch of queries with score_batch() gives the
+ * same results as scoring them one at a time.
+ * @param r The ranker to test
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+template <class Ranker, class Index>
+void test_score_batch(Ranker& r, Index& idx, const std::string& encoding);
+
+/**
+ * Checks that scoring within a budget that never runs out, at once or
+ * on a thread pool, gives the results of score(), and that a budget
+ * that runs out or is cancelled stops the query early.
+ * @param r The ranker to test
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+template <class Ranker, class Index>
+void test_budgeted(Ranker& r, Index& idx, const std::string& encoding);
+
+/**
+ * Checks that scoring a query over ranges of doc_ids on a thread pool
+ * with score_parallel() gives the documents and scores of score().
+ * @param r The ranker to test
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+template <class Ranker, class Index>
+void test_score_parallel(Ranker& r, Index& idx, const std::string& encoding);
+
+/**
+ * Checks that seeding a query with candidates gives the results of
+ * score(), and that a seed's threshold leaves out exactly the documents
+ * that do not score above it.
+ * @param r The ranker to test
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+template <class Ranker, class Index>
+void test_seeded(Ranker& r, Index& idx, const std::string& encoding);
+
+/**
+ * Checks that scoring a prepared query gives the results of scoring the
+ * query itself, with and without a filter or a seed.
+ * @param r The ranker to test
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+template <class Ranker>
+void test_prepared(Ranker& r, index::inverted_index& idx,
+                   const std::string& encoding);
+
+/**
+ * Checks that scoring a query prepared for another index throws.
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+void test_prepared_other_index(index::inverted_index& idx,
+                               const std::string& encoding);
+
+/**
+ * Checks that scoring queries with several rankers in one pass with
+ * score_sweep() gives each ranker's results from score().
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+void test_score_sweep(index::inverted_index& idx, const std::string& encoding);
+
+/**
+ * Checks that a segmented_index scores queries the same as an
+ * inverted_index of the same documents.
+ * @param r The ranker to test
+ * @param seg The segmented index to use
+ * @param idx The inverted index to compare against
+ * @param encoding The encoding of the documents in the index
+ */
+template <class Ranker>
+void test_segmented_index(Ranker& r, index::segmented_index& seg,
+                          index::inverted_index& idx,
+                          const std::string& encoding);
+
+/**
+ * Builds a segmented_index of the documents of an index, in several
+ * segments, and checks it against the index.
+ * @param idx The inverted index to split into segments
+ * @param encoding The encoding of the documents in the index
+ */
+void test_segments(index::inverted_index& idx, const std::string& encoding);
+
+/**
+ * Checks that a sharded_index scores queries the same as an
+ * inverted_index of the same documents.
+ * @param r The ranker to test
+ * @param sharded The sharded index to use
+ * @param idx The inverted index to compare against
+ * @param encoding The encoding of the documents in the index
+ */
+template <class Ranker>
+void test_sharded_index(Ranker& r, index::sharded_index& sharded,
+                        index::inverted_index& idx,
+                        const std::string& encoding);
+
+/**
+ * Splits the documents of an index into shards and checks a
+ * sharded_index of them against the index.
+ * @param idx The inverted index to split into shards
+ * @param encoding The encoding of the documents in the index
+ */
+void test_shards(index::inverted_index& idx, const std::string& encoding);
+
+/**
+ * Checks that a ranker never returns deleted documents, and returns all
+ * of the others when asked for every document.
+ * @param r The ranker to test
+ * @param idx The index to use, with some documents deleted
+ * @param encoding The encoding of the documents in the index
+ */
+template <class Ranker>
+void test_deleted_docs(Ranker& r, index::inverted_index& idx,
+                       const std::string& encoding);
+
+/**
+ * Checks that a query_cache returns the same results as its rankers,
+ * answers repeated queries from the cache, keeps rankers with different
+ * parameters apart, and drops its results when documents are deleted.
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+void test_query_cache(index::inverted_index& idx, const std::string& encoding);
+
+/**
+ * Checks that queries expanded by pseudo-relevance feedback keep their
+ * length and original terms, and that an expansion giving the original
+ * query all of the weight scores the same as the query.
+ * @param idx The index to use
+ * @param fwd A forward index of the same documents
+ * @param encoding The encoding of the documents in the index
+ */
+void test_feedback(index::inverted_index& idx, index::forward_index& fwd,
+                   const std::string& encoding);
+
+/**
+ * Checks that documents added one at a time to a segmented_index's live
+ * segment are searchable right away, score as in a single index, and keep
+ * their doc_ids and deletions when they are flushed to disk.
+ * @param idx An index of all of the documents
+ * @param encoding The encoding of the documents in the index
+ */
+void test_live_segments(index::inverted_index& idx,
+                        const std::string& encoding);
+
+/**
+ * Checks that an impact_index ranks documents close to the ranker it was
+ * built for, that stopping early keeps the same top documents as
+ * processing every posting, and that the impacts are rebuilt when the
+ * ranker's parameters change.
+ * @param idx The index to use
+ * @param encoding The encoding of the documents in the index
+ */
+void test_impacts(index::inverted_index& idx, const std::string& encoding);
+
+/**
+ * Checks that pruning an index keeps about the target fraction of its
+ * postings and the statistics of the source, and that term-centric
+ * pruning leaves the top documents of single-term queries unchanged.
+ * @param idx The index to prune
+ */
+void test_pruning(const std::shared_ptr<index::inverted_index>& idx);
+
 /**
  * Runs all the ranking tests.
  * @return the number of tests failed
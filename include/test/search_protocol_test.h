@@ -0,0 +1,26 @@
+/**
+ * @file search_protocol_test.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_SEARCH_PROTOCOL_TEST_H_
+#define META_SEARCH_PROTOCOL_TEST_H_
+
+#include "test/unit_test.h"
+
+namespace meta
+{
+namespace testing
+{
+
+/**
+ * Runs all the search protocol tests.
+ * @return the number of tests failed
+ */
+int search_protocol_tests();
+}
+}
+#endif
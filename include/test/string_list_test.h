@@ -15,6 +15,8 @@
 
 #include "test/unit_test.h"
 #include "io/binary.h"
+#include "io/front_coding.h"
+#include "io/mmap_file.h"
 #include "index/string_list.h"
 #include "index/string_list_writer.h"
 #include "util/filesystem.h"
@@ -26,10 +28,11 @@ namespace meta
 namespace testing
 {
 /**
- * @param file The file to read from
+ * @param reader The front-coded block to read from
  * @param expect What we expect to read
  */
-void assert_read(std::ifstream& file, const std::string& expect);
+void assert_read(io::front_coding::block_reader& reader,
+                 const std::string& expect);
 
 /**
  * Always makes sure a new file is created.
@@ -53,7 +56,7 @@ struct file_guard
         filesystem::delete_file(path_);
     }
     /// The path to this file
-    const std::string& path_;
+    const std::string path_;
 };
 
 /**
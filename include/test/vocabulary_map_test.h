@@ -1,5 +1,5 @@
 /**
- * @file vocabulary_map_writer.h
+ * @file vocabulary_map_test.h
  * @author Chase Geigle
  *
  * All files in META are dual-licensed under the MIT and NCSA licenses. For more
@@ -11,10 +11,8 @@
 #define META_VOCABULARY_MAP_WRITER_TEST_H_
 
 #include <iostream>
-#include "io/binary.h"
 #include "index/vocabulary_map_writer.h"
 #include "index/vocabulary_map.h"
-#include "util/disk_vector.h"
 #include "util/filesystem.h"
 #include "test/unit_test.h"
 
@@ -24,21 +22,32 @@ namespace testing
 {
 /**
  * Writes a file to decode
- * @param size The number of bytes in the file
+ * @param block_terms The number of terms in each block of the file
  */
-void write_file(uint16_t size = 20);
+void write_file(uint64_t block_terms = 16);
 
 /**
- * Makes sure the content in the vocab map is correct.
- * @param size The number of bytes in the file
+ * Reads data from the vocab map file.
  */
-void assert_correctness(uint16_t size = 20);
+void read_file();
 
 /**
- * Reads data from the vocab map file.
- * @param size The number of bytes in the file
+ * Checks the prefix, range, wildcard, and fuzzy lookups of the vocab map.
+ * @param block_terms The number of terms in each block of the file
+ */
+void check_lookups(uint64_t block_terms);
+
+/**
+ * Checks that an async_vocabulary_writer writes the same files as a
+ * vocabulary_map_writer given the same terms.
+ * @param block_terms The number of terms in each block of the files
+ */
+void check_async_writer(uint64_t block_terms);
+
+/**
+ * Removes the vocab map files.
  */
-void read_file(uint16_t size = 20);
+void delete_files();
 
 /**
  * Runs the vocab map tests.
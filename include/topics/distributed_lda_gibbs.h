@@ -0,0 +1,265 @@
+/**
+ * @file topics/distributed_lda_gibbs.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_TOPICS_DISTRIBUTED_LDA_GIBBS_H_
+#define META_TOPICS_DISTRIBUTED_LDA_GIBBS_H_
+
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "topics/lda_model.h"
+#include "topics/log_gamma_table.h"
+#include "topics/topic_assignments.h"
+#include "topics/topic_counts.h"
+
+namespace meta
+{
+namespace topics
+{
+
+/**
+ * One worker of an LDA topic model sampled by several processes, possibly
+ * on different machines, with the Approximate Distributed LDA algorithm.
+ *
+ * The documents are split into num_shards contiguous shards, and each
+ * worker process models only its own: it decodes and samples its shard
+ * against a full copy of the topic-term counts. After every iteration a
+ * worker publishes the changes it made to the topic-term counts as a file
+ * in a directory shared by all the workers (over a network file system
+ * when they run on several machines), and adds in the changes the other
+ * workers published. The files of a run are kept in a subdirectory named
+ * by its run id, so that files left behind by an earlier run that
+ * crashed are never read as this run's. With a staleness of s, a worker starts iteration
+ * t + 1 once it has the changes of everyone else through iteration
+ * t - s, so that a slow worker holds the others back by at most s
+ * iterations; with a staleness of 0 every worker samples against the same
+ * counts, as in parallel_lda_gibbs.
+ *
+ * save() writes the same files as any other lda_model: every worker
+ * writes the topic proportions of its documents to the shared directory,
+ * and the worker of shard 0 joins them and writes the topic
+ * distributions, all of them having the same counts after the last
+ * iteration.
+ *
+ * @see http://www.jmlr.org/papers/volume10/newman09a/newman09a.pdf
+ */
+class distributed_lda_gibbs : public lda_model
+{
+  public:
+    /**
+     * Constructs the worker of one shard.
+     *
+     * @param idx The index that contains the documents to model; only
+     * the documents of the shard are read
+     * @param num_topics The number of topics to infer
+     * @param alpha The hyperparameter for the Dirichlet prior over
+     * \f$\theta\f$
+     * @param beta The hyperparameter for the Dirichlet prior over
+     * \f$\phi\f$
+     * @param shard The shard of this worker, in [0, num_shards)
+     * @param num_shards The number of workers
+     * @param sync_dir The directory shared by all the workers; it need
+     * not exist
+     * @param run_id The id of this run, which every worker of the run must
+     * be given and no other run may reuse; the workers' files are kept in
+     * sync_dir/run_id
+     * @param staleness The number of iterations a worker may run ahead of
+     * the changes of the others
+     */
+    distributed_lda_gibbs(std::shared_ptr<index::forward_index> idx,
+                          uint64_t num_topics, double alpha, double beta,
+                          uint64_t shard, uint64_t num_shards,
+                          const std::string& sync_dir,
+                          const std::string& run_id, uint64_t staleness = 0);
+
+    /**
+     * Destructor: virtual for potential subclassing.
+     */
+    virtual ~distributed_lda_gibbs() = default;
+
+    /**
+     * Runs the sampler for a maximum number of iterations, or until
+     * the given convergence criterion is met, which like lda_gibbs is the
+     * relative difference in log corpus likelihood between two
+     * iterations. Since the workers must agree on when to stop, the
+     * criterion is only used with a staleness of 0, when they all see
+     * the same counts; otherwise every worker runs num_iters iterations.
+     *
+     * @param num_iters The maximum number of iterations to run the
+     * sampler for
+     * @param convergence The lowest relative difference in \f$\log
+     * P(\mathbf{w} \mid \mathbf{z})\f$ to be allowed before considering
+     * the sampler to have converged
+     */
+    virtual void run(uint64_t num_iters, double convergence = 1e-6) override;
+
+    /**
+     * Saves the model once every worker has called it; the worker of
+     * shard 0 writes prefix.theta and prefix.phi, and blocks until all
+     * the others have written their documents.
+     *
+     * @param prefix The prefix for the files of the model
+     */
+    virtual void save(const std::string& prefix) const override;
+
+    /**
+     * @return the memory used by each component of the model
+     */
+    virtual util::memory_report memory_usage() const override;
+
+    /**
+     * Basic exception for distributed_lda_gibbs interactions.
+     */
+    class distributed_lda_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  protected:
+    /**
+     * @return the probability that the given term appears in the given
+     * topic
+     *
+     * @param term The term we are concerned with.
+     * @param topic The topic we are concerned with.
+     */
+    virtual double
+        compute_term_topic_probability(term_id term,
+                                       topic_id topic) const override;
+
+    /**
+     * @return the probability that the given topic is picked for the given
+     * document
+     *
+     * @param doc The document we are concerned with, which must be in the
+     * shard
+     * @param topic The topic we are concerned with.
+     */
+    virtual double compute_doc_topic_probability(doc_id doc,
+                                                 topic_id topic) const override;
+
+  private:
+    /**
+     * Samples every word of the shard once.
+     *
+     * @param iter The iteration number
+     * @param init Whether this is the initialization, where each word's
+     * topic is sampled given only the words before it
+     */
+    void perform_iteration(uint64_t iter, bool init);
+
+    /**
+     * Samples a topic for a word from the full conditional.
+     *
+     * @param term The word's term
+     * @param row The row of the word's document in doc_terms_
+     * @return the sampled topic
+     */
+    topic_id sample_topic(term_id term, uint64_t row);
+
+    /**
+     * Publishes the changes this worker made to the topic-term counts in
+     * an iteration, and clears them.
+     *
+     * @param iter The iteration
+     */
+    void publish(uint64_t iter);
+
+    /**
+     * Adds in the changes of every other worker through an iteration,
+     * waiting for those not yet published.
+     *
+     * @param iter The last iteration to add the changes of
+     */
+    void synchronize(uint64_t iter);
+
+    /**
+     * @param shard A shard
+     * @param iter An iteration
+     * @return the file holding the changes of the shard in the iteration
+     */
+    std::string delta_file(uint64_t shard, uint64_t iter) const;
+
+    /**
+     * @param shard A shard
+     * @return the file holding the topic proportions of the shard
+     */
+    std::string theta_file(uint64_t shard) const;
+
+    /**
+     * Blocks until a file exists.
+     *
+     * @param filename The file
+     */
+    void wait_for(const std::string& filename) const;
+
+    /**
+     * @return \f$\log P(\mathbf{w} \mid \mathbf{z})\f$ under the counts
+     * this worker sees
+     */
+    double corpus_log_likelihood() const;
+
+    /// \f$\alpha\f$, the document-topic smoothing parameter
+    const double alpha_;
+
+    /// \f$\beta\f$, the topic-term smoothing parameter
+    const double beta_;
+
+    /// \f$\log\Gamma(n + \beta) - \log\Gamma(\beta)\f$ for the counts
+    /// \f$n\f$ of the terms in the topics
+    log_gamma_table count_log_gammas_;
+
+    /// The shard of this worker
+    const uint64_t shard_;
+
+    /// The number of workers
+    const uint64_t num_shards_;
+
+    /// The directory shared by all the workers
+    const std::string sync_dir_;
+
+    /// The number of iterations a worker may run ahead of the others
+    const uint64_t staleness_;
+
+    /// The topic assignment for every word in every document of the
+    /// shard, indexed as (row, position).
+    topic_assignments doc_word_topic_;
+
+    /// The number of words of each term assigned to each topic, by every
+    /// worker as far as this one has seen.
+    topic_counts<uint32_t> term_topics_;
+
+    /// The number of words of each document of the shard assigned to
+    /// each topic, by row.
+    topic_counts<uint32_t> doc_topics_;
+
+    /// The number of words assigned to each topic, as in term_topics_.
+    std::vector<uint64_t> topic_totals_;
+
+    /// The changes this worker made to term_topics_ since it last
+    /// published, indexed as [term * num_topics + topic].
+    std::vector<int32_t> deltas_;
+
+    /// The first iteration of every worker whose changes have not been
+    /// added in yet.
+    std::vector<uint64_t> next_iters_;
+
+    /// The cumulative sampling weights of the topics of the word being
+    /// sampled.
+    std::vector<double> weights_;
+
+    /// The random number generator for the sampler.
+    std::mt19937_64 rng_;
+};
+}
+}
+
+#endif
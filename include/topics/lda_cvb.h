@@ -10,8 +10,10 @@
 #ifndef META_TOPICS_LDA_CVB_H_
 #define META_TOPICS_LDA_CVB_H_
 
-#include "stats/multinomial.h"
+#include <vector>
+
 #include "topics/lda_model.h"
+#include "topics/topic_counts.h"
 
 namespace meta
 {
@@ -64,11 +66,16 @@ class lda_cvb : public lda_model
      */
     void run(uint64_t num_iters, double convergence = 1e-3) override;
 
+    /**
+     * @return the memory used by each component of the model
+     */
+    virtual util::memory_report memory_usage() const override;
+
   protected:
     /**
      * Initializes the parameters randomly.
      */
-    void initialize();
+    virtual void initialize();
 
     /**
      * Performs one iteration of the inference algorithm.
@@ -76,7 +83,7 @@ class lda_cvb : public lda_model
      * @param iter The current iteration number
      * @return the maximum change in any of the \f$\gamma_{dij}\f$s
      */
-    double perform_iteration(uint64_t iter);
+    virtual double perform_iteration(uint64_t iter);
 
     virtual double
         compute_term_topic_probability(term_id term,
@@ -88,21 +95,46 @@ class lda_cvb : public lda_model
     /**
      * Variational distributions \f$\gamma_{ij}\f$, which represent the soft
      * topic assignments for each word occurrence \f$i\f$ in document
-     * \f$j\f$.
+     * \f$j\f$. Every occurrence of a term in a document has the same
+     * distribution, so each is stored once for the term and updated with
+     * the weight of its count.
      *
-     * Indexed as gamma_[d][i]
+     * Indexed as gamma_[d][i * num_topics + topic], where i is the
+     * position of the term in the document's row of doc_terms_.
+     */
+    std::vector<std::vector<double>> gamma_;
+
+    /**
+     * \f$\alpha\f$, the document-topic smoothing parameter.
+     */
+    const double alpha_;
+
+    /**
+     * \f$\beta\f$, the topic-term smoothing parameter.
+     */
+    const double beta_;
+
+    /**
+     * The expected number of words of each term assigned to each topic,
+     * stored word-major.
+     */
+    topic_counts<double> term_topics_;
+
+    /**
+     * The expected number of words of each document assigned to each
+     * topic.
      */
-    std::vector<std::vector<stats::multinomial<topic_id>>> gamma_;
+    topic_counts<double> doc_topics_;
 
     /**
-     * The word distributions for each topic, \f$\phi_t\f$.
+     * The expected number of words assigned to each topic.
      */
-    std::vector<stats::multinomial<term_id>> phi_;
+    std::vector<double> topic_totals_;
 
     /**
-     * The topic distributions for each document, \f$\theta_d\f$.
+     * The unnormalized \f$\gamma_{ij}\f$ of the word being updated.
      */
-    std::vector<stats::multinomial<topic_id>> theta_;
+    std::vector<double> weights_;
 };
 }
 }
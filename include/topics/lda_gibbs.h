@@ -11,10 +11,12 @@
 #define META_LDA_GIBBS_H_
 
 #include <random>
+#include <vector>
 
-#include "stats/multinomial.h"
 #include "topics/lda_model.h"
-#include "util/dense_matrix.h"
+#include "topics/log_gamma_table.h"
+#include "topics/topic_assignments.h"
+#include "topics/topic_counts.h"
 
 namespace meta
 {
@@ -41,9 +43,13 @@ class lda_gibbs : public lda_model
      * \f$\phi\f$
      * @param beta The hyperparameter for the Dirichlet prior over
      * \f$\theta\f$
+     * @param assignments_path If not empty, the file to memory-map the
+     * topic assignments of the words from, rather than holding them in
+     * memory
      */
     lda_gibbs(std::shared_ptr<index::forward_index> idx, uint64_t num_topics,
-              double alpha, double beta);
+              double alpha, double beta,
+              const std::string& assignments_path = "");
 
     /**
      * Destructor: virtual for potential subclassing.
@@ -64,6 +70,11 @@ class lda_gibbs : public lda_model
      */
     virtual void run(uint64_t num_iters, double convergence = 1e-6) override;
 
+    /**
+     * @return the memory used by each component of the model
+     */
+    virtual util::memory_report memory_usage() const override;
+
   protected:
     /**
      * Samples a topic from the full conditional distribution
@@ -151,7 +162,21 @@ class lda_gibbs : public lda_model
     /**
      * @return \f$\log P(\mathbf{w} \mid \mathbf{z})\f$
      */
-    double corpus_log_likelihood() const;
+    virtual double corpus_log_likelihood() const;
+
+    /**
+     * @param first The first term of the range
+     * @param last Just past the last term of the range
+     * @return the part of \f$\log P(\mathbf{w} \mid \mathbf{z})\f$
+     * contributed by the counts of a range of terms
+     */
+    double term_log_likelihood(term_id first, term_id last) const;
+
+    /**
+     * @return the part of \f$\log P(\mathbf{w} \mid \mathbf{z})\f$
+     * contributed by the topic totals
+     */
+    double topic_log_likelihood() const;
 
     /**
      * lda_gibbs cannot be copy assigned.
@@ -169,19 +194,49 @@ class lda_gibbs : public lda_model
      * potentially have many different topics assigned to it, so we are
      * not using term_ids here, but our own contrived intra document term id.
      *
-     * Indexed as [doc_id][position].
+     * Indexed as (doc_id, position).
+     */
+    topic_assignments doc_word_topic_;
+
+    /**
+     * \f$\alpha\f$, the document-topic smoothing parameter.
+     */
+    const double alpha_;
+
+    /**
+     * \f$\beta\f$, the topic-term smoothing parameter.
+     */
+    const double beta_;
+
+    /**
+     * \f$\log\Gamma(n + \beta) - \log\Gamma(\beta)\f$ for the counts
+     * \f$n\f$ of the terms in the topics.
+     */
+    log_gamma_table count_log_gammas_;
+
+    /**
+     * The number of words of each term assigned to each topic,
+     * \f$n_{w,j}\f$, stored word-major with sparse rows for the rare
+     * terms.
+     */
+    topic_counts<uint32_t> term_topics_;
+
+    /**
+     * The number of words of each document assigned to each topic,
+     * \f$n_{d,j}\f$, with sparse rows for the short documents.
      */
-    std::vector<std::vector<topic_id>> doc_word_topic_;
+    topic_counts<uint32_t> doc_topics_;
 
     /**
-     * The word distributions for each topic, \f$\phi_t\f$.
+     * The number of words assigned to each topic, \f$n_j\f$.
      */
-    std::vector<stats::multinomial<term_id>> phi_;
+    std::vector<uint64_t> topic_totals_;
 
     /**
-     * The topic distributions for each document, \f$\theta_d\f$.
+     * The cumulative sampling weights of the topics of the word being
+     * sampled.
      */
-    std::vector<stats::multinomial<topic_id>> theta_;
+    std::vector<double> weights_;
 
     /**
      * The random number generator for the sampler.
@@ -50,6 +50,17 @@ class lda_model
      */
     virtual void run(uint64_t num_iters, double convergence) = 0;
 
+    /**
+     * Sets how many iterations run between evaluations of the
+     * convergence criterion, for the models whose criterion is a costly
+     * pass over the model (the Gibbs samplers' log likelihood); the
+     * criterion then compares consecutive evaluations. The last
+     * iteration is always evaluated.
+     *
+     * @param interval The number of iterations between evaluations
+     */
+    void evaluation_interval(uint64_t interval);
+
     /**
      * Saves the topic proportions \f$\theta_d\f$ for each document to
      * the given file. Saves the distributions in a simple "human
@@ -68,15 +79,82 @@ class lda_model
      */
     void save_topic_term_distributions(const std::string& filename) const;
 
+    /**
+     * Saves the probability of each term in each topic to the given file,
+     * in the binary format read by topic_inferencer: the number of topics
+     * and the number of terms, as uint64_ts, followed by the num_topics
+     * probabilities of each term, as floats.
+     *
+     * @param filename The file to save the probabilities to
+     */
+    void save_topic_term_probabilities(const std::string& filename) const;
+
+    /**
+     * Saves the topic proportions \f$\theta_d\f$ for each document to
+     * the given file, in the binary format of
+     * save_topic_term_probabilities, with a row for each document in
+     * place of each term. The file is read with topic_matrix.
+     *
+     * @param filename The file to save \f$\theta\f$ to
+     */
+    void save_doc_topic_probabilities(const std::string& filename) const;
+
+    /**
+     * Saves the highest-scoring terms of each topic to the given file, in
+     * a binary format read with topic_top_terms. The terms are scored as
+     * in save_topic_term_distributions, but only the best of each topic
+     * are kept, so the file stays small however large the vocabulary is.
+     *
+     * @param filename The file to save the terms to
+     * @param num_terms The number of terms to keep for each topic
+     */
+    void save_topic_top_terms(const std::string& filename,
+                              uint64_t num_terms) const;
+
+    /**
+     * Makes save() write \f$\theta\f$ and \f$\phi\f$ in binary,
+     * to prefix.theta.bin (see save_doc_topic_probabilities) and
+     * prefix.phi.bin (see save_topic_top_terms), instead of as text.
+     * Both are memory-mapped when they are read, so large models are
+     * neither formatted nor parsed.
+     *
+     * @param top_terms The number of terms to keep for each topic in
+     * prefix.phi.bin
+     */
+    void binary_output(uint64_t top_terms);
+
     /**
      * Saves the current model to a set of files beginning with prefix:
-     * prefix.phi, prefix.theta, and prefix.terms.
+     * prefix.phi, prefix.theta, and prefix.topics, or prefix.phi.bin and
+     * prefix.theta.bin in place of the first two after binary_output().
      *
      * @param prefix The prefix for all generated files over this model
      */
-    void save(const std::string& prefix) const;
+    virtual void save(const std::string& prefix) const;
+
+    /**
+     * Reports the memory held by the model. The base model holds the
+     * document-term matrix it samples from; subclasses add their topic
+     * assignments, their counts, and their scratch space.
+     *
+     * @return the memory used by each component of the model
+     */
+    virtual util::memory_report memory_usage() const;
 
   protected:
+    /**
+     * Constructs an lda_model over a contiguous range of the documents of
+     * an index, such as one shard of a distributed model. The rows of
+     * doc_terms_ are then the documents of the range, in order.
+     *
+     * @param idx The index containing the documents to use for the model
+     * @param num_topics The number of topics to find
+     * @param first The first document of the range
+     * @param last Just past the last document of the range
+     */
+    lda_model(std::shared_ptr<index::forward_index> idx, uint64_t num_topics,
+              doc_id first, doc_id last);
+
     /**
      * lda_models cannot be copy assigned.
      */
@@ -112,6 +190,22 @@ class lda_model
      */
     std::shared_ptr<index::forward_index> idx_;
 
+    /**
+     * The first document of the model.
+     */
+    doc_id first_doc_;
+
+    /**
+     * Just past the last document of the model.
+     */
+    doc_id last_doc_;
+
+    /**
+     * The counts of every document of the model, decoded once for all
+     * the iterations of the model.
+     */
+    index::csr_matrix doc_terms_;
+
     /**
      * The number of topics.
      */
@@ -121,6 +215,25 @@ class lda_model
      * The number of total unique words.
      */
     size_t num_words_;
+
+    /**
+     * The number of iterations between evaluations of the convergence
+     * criterion.
+     */
+    uint64_t eval_interval_;
+
+    /**
+     * The number of terms of each topic that save() writes to
+     * prefix.phi.bin, or zero if it writes text instead.
+     */
+    uint64_t binary_top_terms_;
+
+  private:
+    /**
+     * @return the geometric mean of each term's probabilities over the
+     * topics, which its scores in the topics are normalized by
+     */
+    std::vector<double> term_score_denominators() const;
 };
 }
 }
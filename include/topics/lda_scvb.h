@@ -10,7 +10,13 @@
 #ifndef META_TOPICS_LDA_SCVB_H_
 #define META_TOPICS_LDA_SCVB_H_
 
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "parallel/thread_pool.h"
 #include "topics/lda_model.h"
+#include "topics/topic_counts.h"
 
 namespace meta
 {
@@ -22,6 +28,12 @@ namespace topics
  * variational Bayes for inference. Specifically, it uses the SCVB0
  * algorithm detailed in Foulds et. al.
  *
+ * The documents of a minibatch are processed in parallel, each against the
+ * topic-term statistics from before the minibatch, so the result is the
+ * same as processing them serially. The per-document statistics are only
+ * kept for the documents being processed; those of the saved model are
+ * inferred again, the same way, against the final topic-term statistics.
+ *
  * @see http://dl.acm.org/citation.cfm?id=2487575.2487697
  */
 class lda_scvb : public lda_model
@@ -63,21 +75,60 @@ class lda_scvb : public lda_model
      */
     virtual void run(uint64_t num_iters, double convergence = 0) override;
 
+    /**
+     * @return the memory used by each component of the model
+     */
+    virtual util::memory_report memory_usage() const override;
+
   protected:
     virtual double compute_term_topic_probability(term_id term,
                                                   topic_id topic) const
         override;
 
+    /**
+     * Infers the topic proportions of the document against the current
+     * topic-term statistics, so it is costly; the proportions of the last
+     * document asked for are cached, which makes walking every topic of a
+     * document (as save_doc_topic_distributions does) a single inference.
+     */
     virtual double compute_doc_topic_probability(doc_id doc,
                                                  topic_id topic) const override;
 
   private:
     /**
-     * Initialize the model with random parameters.
+     * The state a thread processes part of a minibatch with.
+     */
+    struct worker
+    {
+        /// The expected topic counts of the document being processed.
+        std::vector<double> theta;
+
+        /// The \f$\gamma_{ij}\f$ of the word being processed.
+        std::vector<double> gamma;
+
+        /// The position of each term of the minibatch the thread has seen
+        /// in batch_terms, in units of num_topics.
+        std::unordered_map<term_id, uint64_t> slots;
+
+        /// The terms the thread has seen, sorted before merging.
+        std::vector<term_id> terms;
+
+        /// The thread's estimates of the topic-term statistics of the
+        /// terms it has seen.
+        std::vector<double> batch_terms;
+
+        /// The thread's estimates of the topic statistics.
+        std::vector<double> batch_topics;
+    };
+
+    /**
+     * Initialize the model with random parameters, estimated from a
+     * single minibatch rather than the whole dataset.
      *
      * @param gen The random number generator to use.
+     * @param docs Contains the minibatch in indexes [0, minibatch_size_]
      */
-    void initialize(std::mt19937& gen);
+    void initialize(std::mt19937& gen, const std::vector<doc_id>& docs);
 
     /**
      * Performs one iteration (e.g., one minibatch) of the inference algorithm.
@@ -86,19 +137,61 @@ class lda_scvb : public lda_model
      */
     void perform_iteration(uint64_t iter, const std::vector<doc_id>& docs);
 
+    /**
+     * Processes a block of a minibatch, accumulating the worker's
+     * estimates of the topic-term and topic statistics.
+     *
+     * @param w The state of the processing thread
+     * @param first The first document of the block
+     * @param last Just past the last document of the block
+     */
+    void process_block(worker& w, const doc_id* first, const doc_id* last);
+
+    /**
+     * Computes the expected topic counts of a document: they start out
+     * uniform and are updated by a burn-in pass over the document, and
+     * then by a second pass, during which fn(term, count, gamma) is
+     * called for each term of the document.
+     *
+     * @param doc The document
+     * @param theta Where to store the expected topic counts
+     * @param gamma Space for the \f$\gamma_{ij}\f$ of a word
+     * @param fn The function to call during the second pass
+     */
+    template <class Function>
+    void infer_doc(doc_id doc, double* theta, double* gamma,
+                   Function&& fn) const;
+
+    /**
+     * Adds the estimates of the topic-term statistics of a range of terms
+     * made by all the threads into the model.
+     *
+     * @param first The first term of the range
+     * @param last Just past the last term of the range
+     * @param rate The weight of the estimates, over the scale of the
+     * stored statistics
+     */
+    void merge(term_id first, term_id last, double rate);
+
+    /**
+     * Multiplies the stored topic-term statistics by scale_, and resets
+     * it to one.
+     */
+    void rescale();
+
     /**
      * Contains the expected counts for each word being assigned a given
-     * topic.  Indexed as `topic_term_count_[k][w]` where `k` is a
-     * `topic_id` and `w` is a `term_id`.
+     * topic, stored word-major and divided by scale_. Indexed as
+     * `term_topic_count_(w, k)` where `w` is a `term_id` and `k` is a
+     * `topic_id`.
      */
-    std::vector<std::vector<double>> topic_term_count_;
+    topic_counts<float> term_topic_count_;
 
     /**
-     * Contains the expected counts for each topic being assigned in a
-     * given document. Indexed as `doc_topic_count_[d][k]` where `d` is a
-     * `doc_id` and `k` is a `topic_id`.
+     * The factor term_topic_count_ is stored divided by, so that decaying
+     * every statistic after a minibatch only touches this.
      */
-    std::vector<std::vector<double>> doc_topic_count_;
+    double scale_;
 
     /**
      * Contains the expected number of times the given topic has been
@@ -107,6 +200,29 @@ class lda_scvb : public lda_model
      */
     std::vector<double> topic_count_;
 
+    /**
+     * \f$1 / (n_k + V\beta)\f$ for each topic \f$k\f$, which is fixed
+     * during a minibatch.
+     */
+    std::vector<double> topic_norms_;
+
+    /**
+     * The thread pool used for parallelization.
+     */
+    parallel::thread_pool pool_;
+
+    /**
+     * The state of each thread, which only it touches while processing.
+     */
+    std::vector<worker> workers_;
+
+    /// The document whose topic proportions are in cached_theta_
+    mutable doc_id cached_doc_;
+    /// The expected topic counts of cached_doc_
+    mutable std::vector<double> cached_theta_;
+    /// Space for the \f$\gamma_{ij}\f$ used while inferring cached_theta_
+    mutable std::vector<double> cached_gamma_;
+
     /// The hyperparameter on \f$\theta\f$, the topic proportions
     const double alpha_;
     /// The hyperparameter on \f$\phi\f$, the topic distributions
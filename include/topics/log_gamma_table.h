@@ -0,0 +1,69 @@
+/**
+ * @file topics/log_gamma_table.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_TOPICS_LOG_GAMMA_TABLE_H_
+#define META_TOPICS_LOG_GAMMA_TABLE_H_
+
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace meta
+{
+namespace topics
+{
+
+/**
+ * A table of \f$\log\Gamma(n + c) - \log\Gamma(c)\f$ for the small
+ * integers \f$n\f$ and a fixed smoothing constant \f$c\f$, the term each
+ * count contributes to a Gibbs sampler's log likelihood, so that
+ * computing it is a lookup per count rather than two calls to lgamma.
+ * Larger counts fall back to lgamma.
+ */
+class log_gamma_table
+{
+  public:
+    /**
+     * @param offset The smoothing constant \f$c\f$
+     * @param size The number of counts to tabulate
+     */
+    log_gamma_table(double offset, uint64_t size = 1 << 16)
+        : offset_{offset}, base_{std::lgamma(offset)}, table_(size)
+    {
+        // lgamma(n + 1 + c) = lgamma(n + c) + log(n + c)
+        double value = 0;
+        for (uint64_t n = 0; n < size; ++n)
+        {
+            table_[n] = value;
+            value += std::log(n + offset);
+        }
+    }
+
+    /**
+     * @param n The count
+     * @return \f$\log\Gamma(n + c) - \log\Gamma(c)\f$
+     */
+    double operator()(uint64_t n) const
+    {
+        if (n < table_.size())
+            return table_[n];
+        return std::lgamma(n + offset_) - base_;
+    }
+
+  private:
+    /// The smoothing constant
+    double offset_;
+    /// \f$\log\Gamma(c)\f$
+    double base_;
+    /// The tabulated values
+    std::vector<double> table_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,115 @@
+/**
+ * @file topics/parallel_lda_cvb.h
+ * @author Chase Geigle
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_TOPICS_PARALLEL_LDA_CVB_H_
+#define META_TOPICS_PARALLEL_LDA_CVB_H_
+
+#include <vector>
+
+#include "parallel/thread_pool.h"
+#include "topics/lda_cvb.h"
+
+namespace meta
+{
+namespace topics
+{
+
+/**
+ * A parallel implementation of the CVB0 inference of lda_cvb, in the style
+ * of Approximate Distributed LDA: each thread updates a block of the
+ * documents against the expected counts of the previous iteration plus its
+ * own changes to them, and the changes are merged once every thread has
+ * finished.
+ *
+ * @see http://www.ics.uci.edu/~asuncion/pubs/UAI_09.pdf
+ * @see http://www.jmlr.org/papers/volume10/newman09a/newman09a.pdf
+ */
+class parallel_lda_cvb : public lda_cvb
+{
+  public:
+    /** use same constructor from base class */
+    using lda_cvb::lda_cvb;
+
+    /**
+     * Destructor: virtual for potential subclassing.
+     */
+    virtual ~parallel_lda_cvb() = default;
+
+    /**
+     * @return the memory used by each component of the model, with the
+     * changes of each thread counted as scratch space
+     */
+    virtual util::memory_report memory_usage() const override;
+
+  protected:
+    virtual void initialize() override;
+
+    /**
+     * Performs one iteration of the inference algorithm, with one block
+     * of the documents per thread. The changes the threads made to the
+     * expected counts are reduced into them in parallel across terms
+     * before the iteration is completed.
+     *
+     * @param iter The current iteration number
+     * @return the maximum change in any of the \f$\gamma_{dij}\f$s
+     */
+    virtual double perform_iteration(uint64_t iter) override;
+
+    /**
+     * The state a thread updates a block of documents with.
+     */
+    struct worker
+    {
+        /// The thread's changes to the expected topic-term counts,
+        /// indexed as [term * num_topics + topic].
+        std::vector<double> term_deltas;
+
+        /// The thread's changes to the expected number of words in each
+        /// topic.
+        std::vector<double> topic_deltas;
+
+        /// The unnormalized \f$\gamma_{ij}\f$ of the word being updated.
+        std::vector<double> weights;
+
+        /// The maximum change in any \f$\gamma_{ij}\f$ of the block.
+        double max_change;
+    };
+
+    /**
+     * Updates the \f$\gamma_{ij}\f$ of a block of documents.
+     *
+     * @param w The state of the updating thread
+     * @param first The first document of the block
+     * @param last Just past the last document of the block
+     */
+    void update_block(worker& w, doc_id first, doc_id last);
+
+    /**
+     * Adds the changes to the expected counts of a block of terms made by
+     * all the threads to them, and clears them.
+     *
+     * @param first The first term of the block
+     * @param last Just past the last term of the block
+     */
+    void reduce(term_id first, term_id last);
+
+    /**
+     * The thread pool used for parallelization.
+     */
+    parallel::thread_pool pool_;
+
+    /**
+     * The state of each thread, which only it touches while updating.
+     */
+    std::vector<worker> workers_;
+};
+}
+}
+
+#endif
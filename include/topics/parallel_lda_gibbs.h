@@ -10,7 +10,8 @@
 #ifndef META_PARALLEL_LDA_GIBBS_H_
 #define META_PARALLEL_LDA_GIBBS_H_
 
-#include <thread>
+#include <random>
+#include <vector>
 
 #include "parallel/thread_pool.h"
 #include "topics/lda_gibbs.h"
@@ -37,16 +38,22 @@ class parallel_lda_gibbs : public lda_gibbs
      */
     virtual ~parallel_lda_gibbs() = default;
 
+    /**
+     * @return the memory used by each component of the model, with the
+     * changes of each thread counted as scratch space
+     */
+    virtual util::memory_report memory_usage() const override;
+
   protected:
     virtual void initialize() override;
 
     /**
      * Performs a sampling iteration of the AD-LDA algorithm. This
-     * consists of splitting up the sampling of (document, word) topic
-     * assignments across threads, keeping for each thread a difference
-     * in counts for the potentially shared topic counts. Once the
-     * sampling has finished, the counts are reduced down (serially)
-     * before the iteration is completed.
+     * consists of splitting up the documents into one block per thread,
+     * each of which samples its block against the topic counts of the
+     * previous iteration plus its own changes to them. Once the sampling
+     * has finished, the changes are reduced into the topic counts in
+     * parallel across terms before the iteration is completed.
      *
      * @param iter The current iteration number
      * @param init Whether or not this iteration should use the online
@@ -54,28 +61,73 @@ class parallel_lda_gibbs : public lda_gibbs
      */
     virtual void perform_iteration(uint64_t iter, bool init = false) override;
 
-    virtual void decrease_counts(topic_id topic, term_id term,
-                                 doc_id doc) override;
+    /**
+     * Computes the log likelihood with the terms split into one block per
+     * thread.
+     *
+     * @return \f$\log P(\mathbf{w} \mid \mathbf{z})\f$
+     */
+    virtual double corpus_log_likelihood() const override;
+
+    /**
+     * The state a thread samples a block of documents with.
+     */
+    struct worker
+    {
+        /// The thread's changes to the topic-term counts, indexed as
+        /// [term * num_topics + topic]; dense, since a thread touches
+        /// many of them, so each thread keeps num_words * num_topics.
+        std::vector<int32_t> phi_deltas;
+
+        /// The thread's changes to the number of words in each topic.
+        std::vector<int64_t> topic_deltas;
 
-    virtual void increase_counts(topic_id topic, term_id term,
-                                 doc_id doc) override;
+        /// The sampling weight of each topic for the current word.
+        std::vector<double> weights;
 
-    virtual double compute_sampling_weight(term_id term, doc_id doc,
-                                           topic_id topic) const override;
+        /// The thread's random number generator.
+        std::mt19937_64 rng;
+    };
 
     /**
-     * The thread pool used for parallelization.
+     * Samples a block of documents.
+     *
+     * @param w The state of the sampling thread
+     * @param first The first document of the block
+     * @param last Just past the last document of the block
+     * @param init Whether or not to employ the online method
      */
-    parallel::thread_pool pool_;
+    void sample_block(worker& w, doc_id first, doc_id last, bool init);
 
     /**
-     * Stores the difference in topic_term counts on a per-thread basis
-     * for use in the reduction step.
+     * Samples a topic for a word, from the full conditional given the
+     * counts the thread sees.
      *
-     * Indexed as [thread_id][topic]
+     * @param w The state of the sampling thread
+     * @param term The word's term
+     * @param doc The document the word is in
+     * @return the sampled topic
+     */
+    topic_id sample_topic(worker& w, term_id term, doc_id doc);
+
+    /**
+     * Adds the changes to the topic counts of a block of terms made by
+     * all the threads to them, and clears them.
+     *
+     * @param first The first term of the block
+     * @param last Just past the last term of the block
+     */
+    void reduce(term_id first, term_id last);
+
+    /**
+     * The thread pool used for parallelization.
+     */
+    mutable parallel::thread_pool pool_;
+
+    /**
+     * The state of each thread, which only it touches while sampling.
      */
-    std::unordered_map<std::thread::id,
-                       std::vector<stats::multinomial<term_id>>> phi_diffs_;
+    std::vector<worker> workers_;
 };
 }
 }
@@ -0,0 +1,233 @@
+/**
+ * @file topics/sparse_lda_gibbs.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_SPARSE_LDA_GIBBS_H_
+#define META_SPARSE_LDA_GIBBS_H_
+
+#include <random>
+#include <vector>
+
+#include "topics/lda_model.h"
+#include "topics/log_gamma_table.h"
+#include "topics/topic_assignments.h"
+
+namespace meta
+{
+namespace topics
+{
+
+/**
+ * A LDA topic model implemented using the SparseLDA collapsed gibbs
+ * sampler, which samples from the same full conditional as lda_gibbs in
+ * time proportional to the number of topics of the current document and
+ * term rather than to the number of topics in the model.
+ *
+ * The full conditional
+ * \f$P(z_i = j) \propto (\alpha + n_{d,j})(\beta + n_{w,j}) /
+ * (V\beta + n_j)\f$ is split into a smoothing bucket
+ * \f$\alpha\beta / (V\beta + n_j)\f$, which changes only slightly during
+ * an iteration, a document bucket \f$n_{d,j}\beta / (V\beta + n_j)\f$,
+ * which is nonzero only for the topics of the document, and a term bucket
+ * \f$(\alpha + n_{d,j}) n_{w,j} / (V\beta + n_j)\f$, which is nonzero only
+ * for the topics of the term. The masses of the first two are maintained
+ * as counts change, and the topics of each term are kept sorted by count
+ * so that samples from the term bucket, where most of the mass lies,
+ * usually stop after a few topics.
+ *
+ * @see http://people.cs.umass.edu/~mimno/papers/fast-topic-model.pdf
+ */
+class sparse_lda_gibbs : public lda_model
+{
+  public:
+    /**
+     * Constructs the lda model over the given documents, with the
+     * given number of topics, and hyperparameters \f$\alpha\f$ and
+     * \f$\beta\f$ for the priors on \f$\theta\f$ (topic proportions)
+     * and \f$\phi\f$ (topic distributions), respectively.
+     *
+     * @param idx The index that contains the documents to model
+     * @param num_topics The number of topics to infer
+     * @param alpha The hyperparameter for the Dirichlet prior over
+     * \f$\theta\f$
+     * @param beta The hyperparameter for the Dirichlet prior over
+     * \f$\phi\f$
+     */
+    sparse_lda_gibbs(std::shared_ptr<index::forward_index> idx,
+                     uint64_t num_topics, double alpha, double beta);
+
+    /**
+     * Destructor: virtual for potential subclassing.
+     */
+    virtual ~sparse_lda_gibbs() = default;
+
+    /**
+     * Runs the sampler for a maximum number of iterations, or until
+     * the given convergence criterion is met. The convergence
+     * criterion is determined as the relative difference in log
+     * corpus likelihood between two iterations.
+     *
+     * @param num_iters The maximum number of iterations to run the
+     * sampler for
+     * @param convergence The lowest relative difference in \f$\log
+     * P(\mathbf{w} \mid \mathbf{z})\f$ to be allowed before considering
+     * the sampler to have converged
+     */
+    virtual void run(uint64_t num_iters, double convergence = 1e-6) override;
+
+    /**
+     * @return the memory used by each component of the model
+     */
+    virtual util::memory_report memory_usage() const override;
+
+  protected:
+    /**
+     * @return the probability that the given term appears in the given
+     * topic
+     *
+     * @param term The term we are concerned with.
+     * @param topic The topic we are concerned with.
+     */
+    virtual double
+        compute_term_topic_probability(term_id term,
+                                       topic_id topic) const override;
+
+    /**
+     * @return the probability that the given topic is picked for the given
+     * document
+     *
+     * @param doc The document we are concerned with.
+     * @param topic The topic we are concerned with.
+     */
+    virtual double compute_doc_topic_probability(doc_id doc,
+                                                 topic_id topic) const override;
+
+    /**
+     * The number of words of a document or term assigned to a topic.
+     */
+    struct topic_count
+    {
+        topic_id topic;
+        uint64_t count;
+    };
+
+    /**
+     * Performs a sampling iteration.
+     *
+     * @param iter The iteration number
+     * @param init Whether this is the initialization, where each word's
+     * topic is sampled given only the words before it
+     */
+    void perform_iteration(uint64_t iter, bool init);
+
+    /**
+     * Loads the topic counts of a document into the state of the
+     * document being sampled.
+     *
+     * @param doc The document
+     * @param init Whether the document has no topic assignments yet
+     */
+    void load_doc(doc_id doc, bool init);
+
+    /**
+     * Stores the topic counts of the document being sampled.
+     *
+     * @param doc The document
+     */
+    void store_doc(doc_id doc);
+
+    /**
+     * Samples a topic for a word of the document being sampled, whose
+     * own assignment has been removed from the counts.
+     *
+     * @param term The word's term
+     * @return the sampled topic
+     */
+    topic_id sample_topic(term_id term);
+
+    /**
+     * Removes a word of the document being sampled from a topic.
+     *
+     * @param topic The topic
+     * @param term The word's term
+     */
+    void decrease_counts(topic_id topic, term_id term);
+
+    /**
+     * Assigns a word of the document being sampled to a topic.
+     *
+     * @param topic The topic
+     * @param term The word's term
+     */
+    void increase_counts(topic_id topic, term_id term);
+
+    /**
+     * Updates the bucket masses and coefficient of a topic for a change
+     * to its counts.
+     *
+     * @param topic The topic
+     * @param sign +1 to add the topic's current contributions, -1 to
+     * remove them
+     */
+    void update_masses(topic_id topic, double sign);
+
+    /**
+     * @return \f$\log P(\mathbf{w} \mid \mathbf{z})\f$
+     */
+    double corpus_log_likelihood() const;
+
+    /// \f$\alpha\f$, the document-topic smoothing parameter
+    const double alpha_;
+
+    /// \f$\beta\f$, the topic-term smoothing parameter
+    const double beta_;
+
+    /// \f$\log\Gamma(n + \beta) - \log\Gamma(\beta)\f$ for the counts
+    /// \f$n\f$ of the terms in the topics
+    log_gamma_table count_log_gammas_;
+
+    /// The topic assignment for every word in every document, indexed as
+    /// (doc_id, position).
+    topic_assignments doc_word_topic_;
+
+    /// The topics of each term, by decreasing count.
+    std::vector<std::vector<topic_count>> term_topics_;
+
+    /// The topics of each document, by topic id.
+    std::vector<std::vector<topic_count>> doc_topics_;
+
+    /// The number of words assigned to each topic.
+    std::vector<uint64_t> topic_totals_;
+
+    /// The topic counts of the document being sampled.
+    std::vector<uint64_t> doc_counts_;
+
+    /// The topics with nonzero counts in the document being sampled.
+    std::vector<topic_id> doc_nonzero_;
+
+    /// The position of each topic in doc_nonzero_.
+    std::vector<uint64_t> doc_positions_;
+
+    /// \f$(\alpha + n_{d,j}) / (V\beta + n_j)\f$ for each topic.
+    std::vector<double> coefficients_;
+
+    /// The term bucket weights of the topics of the term being sampled.
+    std::vector<double> term_weights_;
+
+    /// The mass of the smoothing bucket.
+    double smoothing_mass_;
+
+    /// The mass of the document bucket.
+    double doc_mass_;
+
+    /// The random number generator for the sampler.
+    std::mt19937_64 rng_;
+};
+}
+}
+
+#endif
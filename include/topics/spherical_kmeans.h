@@ -0,0 +1,242 @@
+/**
+ * @file topics/spherical_kmeans.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_TOPICS_SPHERICAL_KMEANS_H_
+#define META_TOPICS_SPHERICAL_KMEANS_H_
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "index/csr_matrix.h"
+#include "index/forward_index.h"
+#include "parallel/thread_pool.h"
+#include "topics/lda_model.h"
+#include "util/dense_matrix.h"
+
+namespace meta
+{
+namespace topics
+{
+
+/**
+ * Options for spherical k-means.
+ */
+struct kmeans_options
+{
+    /**
+     * The number of clusters.
+     */
+    uint64_t num_clusters = 10;
+
+    /**
+     * The maximum number of iterations: passes over the documents, or
+     * mini-batches in mini-batch mode.
+     */
+    uint64_t max_iters = 100;
+
+    /**
+     * The fraction of documents that must change cluster for another pass
+     * to run; ignored in mini-batch mode.
+     */
+    double convergence = 0.001;
+
+    /**
+     * The number of documents in each mini-batch, or 0 to update the
+     * centroids from every document in each iteration.
+     */
+    uint64_t batch_size = 0;
+
+    /**
+     * The seed of the random choices of seeding and mini-batches.
+     */
+    uint64_t seed = 47;
+};
+
+/**
+ * Clusters the documents of a forward index by the cosine similarity of
+ * their term vectors, as a cheap alternative to a topic model: each
+ * cluster is a topic, and each document has one.
+ *
+ * Centroids are seeded by k-means++, each picked with probability
+ * proportional to the distance (one minus the cosine similarity) of a
+ * document to its nearest centroid so far. Each iteration then assigns
+ * every document to its most similar centroid, in parallel over the rows
+ * of the documents' csr_matrix, and recomputes the centroids from their
+ * documents. In mini-batch mode (Sculley, 2010), an iteration assigns a
+ * random sample of documents and moves each one's centroid toward it by a
+ * step of one over the number of documents the centroid has seen.
+ *
+ * The centroids are stored as one dense row of cluster weights per term,
+ * so that a document's similarity to every centroid is a sum of one
+ * vectorized row per term of the document. Each centroid is kept
+ * unnormalized along with its norm; the similarity is the dot product
+ * over that norm, so updates never rescale a whole centroid.
+ */
+class spherical_kmeans
+{
+  public:
+    /**
+     * @param idx The index of the documents to cluster
+     * @param options The number of clusters and how to find them
+     */
+    spherical_kmeans(std::shared_ptr<index::forward_index> idx,
+                     const kmeans_options& options);
+
+    /**
+     * Seeds the centroids and iterates until the assignments converge or
+     * the maximum number of iterations is reached.
+     * @param pool The threads to run on
+     */
+    void run(parallel::thread_pool& pool);
+
+    /**
+     * Runs on the default thread pool.
+     */
+    void run();
+
+    /**
+     * @param d_id A document
+     * @return the cluster of the document
+     */
+    topic_id cluster(doc_id d_id) const;
+
+    /**
+     * @param d_id A document
+     * @return the cosine similarity of the document to its centroid
+     */
+    double similarity(doc_id d_id) const;
+
+    /**
+     * @param cluster A cluster
+     * @param t_id A term
+     * @return the weight of the term in the cluster's centroid, which
+     * over all terms sums to one
+     */
+    double term_weight(topic_id cluster, term_id t_id) const;
+
+    /**
+     * @return the mean cosine similarity of the documents to their
+     * centroids
+     */
+    double objective() const;
+
+    /**
+     * Saves the clustering to a set of files beginning with prefix:
+     * prefix.assignments, with the cluster and similarity of each
+     * document on a line; prefix.clusters, with each cluster's size and
+     * its terms in decreasing order of weight; and prefix.topics, with
+     * the centroids' term weights in the binary format read by
+     * topic_inferencer.
+     * @param prefix The prefix of the files
+     */
+    void save(const std::string& prefix) const;
+
+    /**
+     * @return the memory used by the documents and the centroids
+     */
+    util::memory_report memory_usage() const;
+
+  private:
+    /**
+     * Picks the initial centroids with k-means++.
+     * @param pool The threads to run on
+     */
+    void seed(parallel::thread_pool& pool);
+
+    /**
+     * Makes a document the whole of a centroid.
+     * @param cluster The centroid
+     * @param row The document's row of doc_terms_
+     */
+    void set_centroid(uint64_t cluster, uint64_t row);
+
+    /**
+     * @param row A row of doc_terms_
+     * @param sims Where to write the dot product of the row with every
+     * centroid
+     */
+    void dot_products(uint64_t row, std::vector<float>& sims) const;
+
+    /**
+     * Assigns some documents to their most similar centroids.
+     * @param rows The rows of doc_terms_ to assign
+     * @param pool The threads to run on
+     * @return the number of documents whose cluster changed
+     */
+    uint64_t assign(const std::vector<uint64_t>& rows,
+                    parallel::thread_pool& pool);
+
+    /**
+     * Recomputes every centroid as the sum of its documents.
+     * @param pool The threads to run on
+     */
+    void update(parallel::thread_pool& pool);
+
+    /**
+     * Multiplies a centroid's stored weights by its scale, making the
+     * scale one, and recomputes its norm and sum.
+     * @param cluster The centroid
+     */
+    void fold_scale(uint64_t cluster);
+
+    /**
+     * Moves the centroid of a document toward it, by a step of one over
+     * the number of documents the centroid has been moved by.
+     * @param row The document's row of doc_terms_
+     */
+    void step(uint64_t row);
+
+    /// The index of the documents
+    std::shared_ptr<index::forward_index> idx_;
+
+    /// The options of the clustering
+    kmeans_options options_;
+
+    /// The documents, decoded once for every iteration
+    index::csr_matrix doc_terms_;
+
+    /// The norm of each document
+    std::vector<double> doc_norms_;
+
+    /// The centroids, a row of cluster weights per term
+    util::dense_matrix<float> centroids_;
+
+    /// The norm of each centroid
+    std::vector<double> centroid_norms_;
+
+    /// The factor each centroid's stored weights are scaled by in
+    /// mini-batch mode, so that shrinking a centroid is one multiplication
+    std::vector<double> centroid_scales_;
+
+    /// The number of documents each centroid has been moved by
+    std::vector<uint64_t> centroid_counts_;
+
+    /// The sum of the weights of each centroid, once run() has finished
+    std::vector<double> centroid_sums_;
+
+    /// The cluster of each document
+    std::vector<uint64_t> assignments_;
+
+    /// The cosine similarity of each document to its centroid
+    std::vector<float> similarities_;
+};
+
+/**
+ * Basic exception for k-means interactions.
+ */
+class kmeans_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
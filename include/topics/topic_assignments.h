@@ -0,0 +1,110 @@
+/**
+ * @file topics/topic_assignments.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_TOPICS_TOPIC_ASSIGNMENTS_H_
+#define META_TOPICS_TOPIC_ASSIGNMENTS_H_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "topics/lda_model.h"
+#include "util/disk_vector.h"
+
+namespace meta
+{
+namespace topics
+{
+
+/**
+ * The topic assigned to every word of a set of documents by a Gibbs
+ * sampler, stored as one flat array with the offset of each document's
+ * words in it. The topics are stored in 16 bits when there are no more
+ * than 65,536 of them, and in 32 bits otherwise.
+ *
+ * The array is held in memory, or, given a path, in a memory-mapped file
+ * for corpora whose assignments do not fit in memory.
+ */
+class topic_assignments
+{
+  public:
+    /**
+     * Constructs the assignments of documents of the given lengths, every
+     * word assigned topic 0 (unless the array is an existing file).
+     *
+     * @param lengths The number of words of each document
+     * @param num_topics The number of topics
+     * @param path If not empty, the file to memory-map the array from
+     */
+    topic_assignments(const std::vector<uint64_t>& lengths,
+                      uint64_t num_topics, const std::string& path = "");
+
+    /**
+     * @param doc The row of the document
+     * @param i The position of the word within the document
+     * @return the topic assigned to the word
+     */
+    topic_id operator()(uint64_t doc, uint64_t i) const
+    {
+        auto pos = offsets_[doc] + i;
+        return topic_id{narrow_ ? narrow_[pos] : wide_[pos]};
+    }
+
+    /**
+     * Assigns a topic to a word.
+     *
+     * @param doc The row of the document
+     * @param i The position of the word within the document
+     * @param topic The topic to assign
+     */
+    void assign(uint64_t doc, uint64_t i, topic_id topic)
+    {
+        auto pos = offsets_[doc] + i;
+        if (narrow_)
+            narrow_[pos] = static_cast<uint16_t>(topic);
+        else
+            wide_[pos] = static_cast<uint32_t>(topic);
+    }
+
+    /**
+     * @param doc The row of the document
+     * @return the number of words of the document
+     */
+    uint64_t size(uint64_t doc) const
+    {
+        return offsets_[doc + 1] - offsets_[doc];
+    }
+
+    /**
+     * @return the memory used by the assignments
+     */
+    util::memory_usage memory_usage() const;
+
+  private:
+    /// Where the words of each document start, and the total at the end
+    std::vector<uint64_t> offsets_;
+
+    /// The in-memory 16-bit topics, if they are used
+    std::vector<uint16_t> narrow_memory_;
+    /// The in-memory 32-bit topics, if they are used
+    std::vector<uint32_t> wide_memory_;
+    /// The memory-mapped 16-bit topics, if they are used
+    std::unique_ptr<util::disk_vector<uint16_t>> narrow_file_;
+    /// The memory-mapped 32-bit topics, if they are used
+    std::unique_ptr<util::disk_vector<uint32_t>> wide_file_;
+
+    /// The 16-bit topics, wherever they are stored, or nullptr
+    uint16_t* narrow_;
+    /// The 32-bit topics, wherever they are stored, or nullptr
+    uint32_t* wide_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,193 @@
+/**
+ * @file topics/topic_counts.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_TOPICS_TOPIC_COUNTS_H_
+#define META_TOPICS_TOPIC_COUNTS_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#include "topics/lda_model.h"
+#include "util/memory_usage.h"
+
+namespace meta
+{
+namespace topics
+{
+
+/**
+ * A matrix of the counts of each topic in each of a set of rows (the terms
+ * of a word-major topic-term matrix, or the documents of a document-topic
+ * matrix), laid out contiguously so that a sampler touching every topic of
+ * a row walks one block of memory.
+ *
+ * Rows are dense arrays of num_topics counts, except that a row may be
+ * given a length that bounds the number of its topics with nonzero counts
+ * (the frequency of a term, or the size of a document, when every word is
+ * assigned a single topic). A row whose length makes an array of
+ * (topic, count) pairs smaller than the dense array is stored as such a
+ * pair array, sorted by topic, with room for length pairs; these are the
+ * long-tail terms and the short documents.
+ *
+ * Column totals are not kept, since samplers update rows from several
+ * threads and keep their own.
+ */
+template <class Count>
+class topic_counts
+{
+  public:
+    /**
+     * Constructs a matrix of dense rows, all counts zero.
+     *
+     * @param num_rows The number of rows
+     * @param num_topics The number of topics
+     */
+    topic_counts(uint64_t num_rows, uint64_t num_topics);
+
+    /**
+     * Constructs a matrix whose rows are sparse when their lengths allow,
+     * all counts zero.
+     *
+     * @param lengths The maximum number of topics of each row with a
+     * nonzero count
+     * @param num_topics The number of topics
+     */
+    topic_counts(const std::vector<uint64_t>& lengths, uint64_t num_topics);
+
+    /**
+     * @param row The row
+     * @param topic The topic
+     * @return the count of the topic in the row
+     */
+    Count operator()(uint64_t row, topic_id topic) const;
+
+    /**
+     * Adds to the count of a topic in a row.
+     *
+     * @param row The row
+     * @param topic The topic
+     * @param amount The amount to add
+     */
+    void increment(uint64_t row, topic_id topic, Count amount = 1);
+
+    /**
+     * Subtracts from the count of a topic in a row.
+     *
+     * @param row The row
+     * @param topic The topic
+     * @param amount The amount to subtract; at most the current count
+     */
+    void decrement(uint64_t row, topic_id topic, Count amount = 1);
+
+    /**
+     * Calls a function with each topic of a row with a nonzero count, in
+     * order of topic. Dense rows call it with every topic.
+     *
+     * @param row The row
+     * @param fn The function, called as fn(topic, count)
+     */
+    template <class Function>
+    void each_topic(uint64_t row, Function&& fn) const;
+
+    /**
+     * @param row The row
+     * @return whether the row is stored as a dense array
+     */
+    bool dense(uint64_t row) const;
+
+    /**
+     * Modifying a dense row through this pointer is equivalent to calls
+     * to increment() and decrement().
+     *
+     * @param row The row, which must be dense
+     * @return the num_topics() counts of the row
+     */
+    Count* dense_row(uint64_t row);
+
+    /**
+     * @param row The row, which must be dense
+     * @return the num_topics() counts of the row
+     */
+    const Count* dense_row(uint64_t row) const;
+
+    /**
+     * @return the number of rows
+     */
+    uint64_t rows() const;
+
+    /**
+     * @return the number of topics
+     */
+    uint64_t num_topics() const;
+
+    /**
+     * @return the memory used by the counts
+     */
+    util::memory_usage memory_usage() const;
+
+    /**
+     * Basic exception for topic_counts interactions.
+     */
+    class topic_counts_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /**
+     * A topic of a sparse row with a nonzero count.
+     */
+    struct entry
+    {
+        uint32_t topic;
+        Count count;
+    };
+
+    /**
+     * Where a row's counts are stored.
+     */
+    struct row_info
+    {
+        /// The position of the row in dense_ or sparse_
+        uint64_t offset;
+        /// The number of entries of a sparse row
+        uint32_t size;
+        /// The room for entries of a sparse row, or dense_capacity
+        uint32_t capacity;
+    };
+
+    /// The capacity marking a dense row
+    const static constexpr uint32_t dense_capacity = ~uint32_t{0};
+
+    /**
+     * @param row The row, which must be sparse
+     * @param topic The topic
+     * @return the first entry of the row whose topic is not less than topic
+     */
+    entry* find(uint64_t row, topic_id topic);
+
+    /// The number of topics
+    uint64_t num_topics_;
+
+    /// The placement of each row
+    std::vector<row_info> rows_;
+
+    /// The dense rows, one after another
+    std::vector<Count> dense_;
+
+    /// The sparse rows, one after another
+    std::vector<entry> sparse_;
+};
+}
+}
+
+#include "topics/topic_counts.tcc"
+
+#endif
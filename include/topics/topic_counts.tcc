@@ -0,0 +1,188 @@
+/**
+ * @file topic_counts.tcc
+ */
+
+#include <algorithm>
+#include <string>
+
+#include "topics/topic_counts.h"
+
+namespace meta
+{
+namespace topics
+{
+
+template <class Count>
+topic_counts<Count>::topic_counts(uint64_t num_rows, uint64_t num_topics)
+    : num_topics_{num_topics},
+      rows_(num_rows),
+      dense_(num_rows * num_topics)
+{
+    for (uint64_t row = 0; row < num_rows; ++row)
+        rows_[row] = {row * num_topics_, 0, dense_capacity};
+}
+
+template <class Count>
+topic_counts<Count>::topic_counts(const std::vector<uint64_t>& lengths,
+                                  uint64_t num_topics)
+    : num_topics_{num_topics}, rows_(lengths.size())
+{
+    uint64_t dense_size = 0;
+    uint64_t sparse_size = 0;
+    for (uint64_t row = 0; row < lengths.size(); ++row)
+    {
+        if (lengths[row] * sizeof(entry) < num_topics_ * sizeof(Count))
+        {
+            auto capacity = static_cast<uint32_t>(lengths[row]);
+            rows_[row] = {sparse_size, 0, capacity};
+            sparse_size += lengths[row];
+        }
+        else
+        {
+            rows_[row] = {dense_size, 0, dense_capacity};
+            dense_size += num_topics_;
+        }
+    }
+    dense_.resize(dense_size);
+    sparse_.resize(sparse_size);
+}
+
+template <class Count>
+Count topic_counts<Count>::operator()(uint64_t row, topic_id topic) const
+{
+    const auto& info = rows_[row];
+    if (info.capacity == dense_capacity)
+        return dense_[info.offset + topic];
+
+    auto first = sparse_.begin() + info.offset;
+    auto last = first + info.size;
+    auto it = std::lower_bound(first, last, topic,
+                               [](const entry& e, topic_id t)
+                               {
+        return e.topic < t;
+    });
+    return it != last && it->topic == topic ? it->count : Count{0};
+}
+
+template <class Count>
+auto topic_counts<Count>::find(uint64_t row, topic_id topic) -> entry*
+{
+    const auto& info = rows_[row];
+    auto first = sparse_.data() + info.offset;
+    return std::lower_bound(first, first + info.size, topic,
+                            [](const entry& e, topic_id t)
+                            {
+        return e.topic < t;
+    });
+}
+
+template <class Count>
+void topic_counts<Count>::increment(uint64_t row, topic_id topic,
+                                    Count amount)
+{
+    auto& info = rows_[row];
+    if (info.capacity == dense_capacity)
+    {
+        dense_[info.offset + topic] += amount;
+        return;
+    }
+
+    auto it = find(row, topic);
+    auto last = sparse_.data() + info.offset + info.size;
+    if (it != last && it->topic == topic)
+    {
+        it->count += amount;
+        return;
+    }
+
+    if (info.size == info.capacity)
+        throw topic_counts_exception{"row " + std::to_string(row)
+                                     + " has more topics than its length"};
+    std::copy_backward(it, last, last + 1);
+    *it = {static_cast<uint32_t>(topic), amount};
+    ++info.size;
+}
+
+template <class Count>
+void topic_counts<Count>::decrement(uint64_t row, topic_id topic,
+                                    Count amount)
+{
+    auto& info = rows_[row];
+    if (info.capacity == dense_capacity)
+    {
+        dense_[info.offset + topic] -= amount;
+        return;
+    }
+
+    auto it = find(row, topic);
+    auto last = sparse_.data() + info.offset + info.size;
+    if (it == last || it->topic != topic)
+        throw topic_counts_exception{"topic " + std::to_string(topic)
+                                     + " has no count in row "
+                                     + std::to_string(row)};
+    it->count -= amount;
+    if (it->count == Count{0})
+    {
+        std::copy(it + 1, last, it);
+        --info.size;
+    }
+}
+
+template <class Count>
+template <class Function>
+void topic_counts<Count>::each_topic(uint64_t row, Function&& fn) const
+{
+    const auto& info = rows_[row];
+    if (info.capacity == dense_capacity)
+    {
+        auto counts = dense_.data() + info.offset;
+        for (topic_id topic{0}; topic < num_topics_; ++topic)
+            fn(topic, counts[topic]);
+        return;
+    }
+
+    auto first = sparse_.data() + info.offset;
+    for (auto it = first; it != first + info.size; ++it)
+        fn(topic_id{it->topic}, it->count);
+}
+
+template <class Count>
+bool topic_counts<Count>::dense(uint64_t row) const
+{
+    return rows_[row].capacity == dense_capacity;
+}
+
+template <class Count>
+Count* topic_counts<Count>::dense_row(uint64_t row)
+{
+    return dense_.data() + rows_[row].offset;
+}
+
+template <class Count>
+const Count* topic_counts<Count>::dense_row(uint64_t row) const
+{
+    return dense_.data() + rows_[row].offset;
+}
+
+template <class Count>
+uint64_t topic_counts<Count>::rows() const
+{
+    return rows_.size();
+}
+
+template <class Count>
+uint64_t topic_counts<Count>::num_topics() const
+{
+    return num_topics_;
+}
+
+template <class Count>
+util::memory_usage topic_counts<Count>::memory_usage() const
+{
+    auto usage = util::heap_memory(rows_);
+    usage += util::heap_memory(dense_);
+    usage += util::heap_memory(sparse_);
+    return usage;
+}
+}
+}
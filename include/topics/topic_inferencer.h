@@ -0,0 +1,129 @@
+/**
+ * @file topics/topic_inferencer.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_TOPICS_TOPIC_INFERENCER_H_
+#define META_TOPICS_TOPIC_INFERENCER_H_
+
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "corpus/document.h"
+#include "index/disk_index.h"
+#include "topics/lda_model.h"
+#include "topics/topic_model_file.h"
+
+namespace meta
+{
+namespace topics
+{
+
+/**
+ * Infers the topic proportions of documents that were not part of a
+ * trained lda_model (folding them in), against the topic distributions
+ * the model saved with save_topic_term_probabilities.
+ *
+ * The distributions are held fixed and stored term-major, so that the
+ * probabilities of a term in every topic are one contiguous block of
+ * floats. They are memory-mapped (see topic_matrix) rather than read, so
+ * that a large model is ready at once and its pages are shared by every
+ * process inferring with it.
+ *
+ * A document is inferred with a few iterations of collapsed variational
+ * inference (CVB0) over its distinct terms: each term's distribution
+ * over topics is \f$\gamma_{wk} \propto \phi_{kw} (n_k + \alpha)\f$,
+ * and the expected topic counts \f$n_k\f$ of the document are
+ * then the count-weighted sums of the \f$\gamma_{wk}\f$. The cost of a
+ * document is proportional to its number of distinct terms times the
+ * number of topics, per iteration.
+ *
+ * Inference does not modify the inferencer, so many threads may infer
+ * with one at once.
+ */
+class topic_inferencer
+{
+  public:
+    /**
+     * Exception thrown when a model cannot be loaded.
+     */
+    class topic_inferencer_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+    /**
+     * Loads the topic distributions of a model.
+     *
+     * @param filename The file written by
+     *  lda_model::save_topic_term_probabilities (prefix.topics)
+     * @param alpha The hyperparameter for the Dirichlet prior over the
+     *  topic proportions
+     * @param max_iters The maximum number of iterations to run for a
+     *  document
+     * @param convergence The mean change per word in the expected topic
+     *  counts of a document below which it is considered converged
+     */
+    topic_inferencer(const std::string& filename, double alpha,
+                     uint64_t max_iters = 20, double convergence = 1e-3);
+
+    /**
+     * Infers the topic proportions of a document.
+     *
+     * @param counts The (term id, count) pairs of the document, each term
+     *  appearing once; terms unknown to the model are ignored
+     * @return the probability of each topic in the document
+     */
+    std::vector<double>
+        infer(const std::vector<std::pair<term_id, double>>& counts) const;
+
+    /**
+     * Infers the topic proportions of a tokenized document, whose terms
+     * are mapped to ids through the index the model was trained on.
+     *
+     * @param doc The document, whose counts() have been filled in
+     * @param idx The index to map the document's terms with
+     * @return the probability of each topic in the document
+     */
+    std::vector<double> infer(const corpus::document& doc,
+                              index::disk_index& idx) const;
+
+    /**
+     * @return the number of topics of the model
+     */
+    uint64_t num_topics() const;
+
+    /**
+     * @return the number of terms of the model
+     */
+    uint64_t num_words() const;
+
+  private:
+    /// The probability of each term in each topic, a row for each term
+    topic_matrix probs_;
+
+    /// The number of topics
+    uint64_t num_topics_;
+
+    /// The number of terms
+    uint64_t num_words_;
+
+    /// \f$\alpha\f$, the document-topic smoothing parameter
+    const double alpha_;
+
+    /// The maximum number of iterations for a document
+    const uint64_t max_iters_;
+
+    /// The mean change per word at which a document has converged
+    const double convergence_;
+};
+}
+}
+
+#endif
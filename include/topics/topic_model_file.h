@@ -0,0 +1,152 @@
+/**
+ * @file topics/topic_model_file.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_TOPICS_TOPIC_MODEL_FILE_H_
+#define META_TOPICS_TOPIC_MODEL_FILE_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+#include "io/mmap_file.h"
+#include "meta.h"
+#include "topics/lda_model.h"
+
+namespace meta
+{
+namespace topics
+{
+
+/**
+ * Exception thrown when a binary model file cannot be read.
+ */
+class topic_model_file_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * A dense matrix of topic probabilities, memory-mapped from a file
+ * written by lda_model::save_topic_term_probabilities (prefix.topics, one
+ * row for each term) or lda_model::save_doc_topic_probabilities
+ * (prefix.theta.bin, one row for each document). The file holds the
+ * number of topics and the number of rows, as uint64_ts, followed by the
+ * num_topics probabilities of each row, as floats, so that nothing is
+ * parsed or copied when it is opened and a row is one contiguous block.
+ */
+class topic_matrix
+{
+  public:
+    /**
+     * @param filename The file to map
+     * @param res How the file is brought into memory
+     */
+    topic_matrix(const std::string& filename,
+                 io::residency res = io::residency::on_demand);
+
+    /**
+     * @return the number of topics
+     */
+    uint64_t num_topics() const;
+
+    /**
+     * @return the number of rows (terms or documents)
+     */
+    uint64_t num_rows() const;
+
+    /**
+     * @param r The row
+     * @return the num_topics() probabilities of the row
+     */
+    const float* row(uint64_t r) const;
+
+    /**
+     * @param r The row
+     * @param k The topic
+     * @return the probability of the topic in the row
+     */
+    float probability(uint64_t r, topic_id k) const;
+
+  private:
+    /// The mapped file
+    io::mmap_file file_;
+
+    /// The number of topics
+    uint64_t num_topics_;
+
+    /// The number of rows
+    uint64_t num_rows_;
+
+    /// The first probability of the first row
+    const float* probs_;
+};
+
+/**
+ * The highest-scoring terms of each topic, memory-mapped from a file
+ * written by lda_model::save_topic_top_terms (prefix.phi.bin), in place
+ * of the scores of every term that prefix.phi holds. The file holds the
+ * number of topics and the number of terms kept for each, as uint64_ts;
+ * then the ids of the terms of every topic, as uint64_ts; and then their
+ * scores, as floats. The terms of a topic are in decreasing order of
+ * score.
+ */
+class topic_top_terms
+{
+  public:
+    /**
+     * @param filename The file to map
+     * @param res How the file is brought into memory
+     */
+    topic_top_terms(const std::string& filename,
+                    io::residency res = io::residency::on_demand);
+
+    /**
+     * @return the number of topics
+     */
+    uint64_t num_topics() const;
+
+    /**
+     * @return the number of terms kept for each topic
+     */
+    uint64_t terms_per_topic() const;
+
+    /**
+     * @param k The topic
+     * @param i The rank of the term in the topic
+     * @return the id of the term
+     */
+    term_id term(topic_id k, uint64_t i) const;
+
+    /**
+     * @param k The topic
+     * @param i The rank of the term in the topic
+     * @return the score of the term in the topic
+     */
+    float score(topic_id k, uint64_t i) const;
+
+  private:
+    /// The mapped file
+    io::mmap_file file_;
+
+    /// The number of topics
+    uint64_t num_topics_;
+
+    /// The number of terms kept for each topic
+    uint64_t num_terms_;
+
+    /// The ids of the terms, topic by topic
+    const uint64_t* terms_;
+
+    /// The scores of the terms, topic by topic
+    const float* scores_;
+};
+}
+}
+
+#endif
@@ -0,0 +1,78 @@
+/**
+ * @file ascii_segmenter.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_UTF_ASCII_SEGMENTER_H_
+#define META_UTF_ASCII_SEGMENTER_H_
+
+#include <string>
+#include <vector>
+
+#include "utf/segmenter.h"
+
+namespace meta
+{
+namespace utf
+{
+
+/**
+ * Segments ASCII strings into sentences and words without ICU. The
+ * boundaries are those the default segmenter finds: the sentence and word
+ * boundary rules of Unicode Standard Annex #29, as ICU implements them,
+ * restricted to the ASCII characters. Segments are byte offsets into the
+ * string, as they are for segmenter.
+ */
+class ascii_segmenter
+{
+  public:
+    /// A segment of the content
+    using segment = segmenter::segment;
+
+    /**
+     * Resets the content of the segmenter to the given string.
+     * @param str An ASCII string that should be segmented
+     */
+    void set_content(std::string str);
+
+    /**
+     * @return a vector of segments that represent sentences
+     */
+    std::vector<segment> sentences() const;
+
+    /**
+     * @param seg the segment to sub-segment into words
+     * @return a vector of segments that represent words
+     */
+    std::vector<segment> words(const segment& seg) const;
+
+    /**
+     * @param seg the segment to sub-segment into words
+     * @param words the vector to replace the contents of with the words
+     */
+    void words(const segment& seg, std::vector<segment>& words) const;
+
+    /**
+     * @return the content associated with a given segment
+     * @param seg the segment to get content for
+     */
+    std::string content(const segment& seg) const;
+
+    /**
+     * Copies the content associated with a given segment into a buffer.
+     * @param seg the segment to get content for
+     * @param buffer the string to assign the content to
+     */
+    void content(const segment& seg, std::string& buffer) const;
+
+  private:
+    /// The content being segmented
+    std::string content_;
+};
+}
+}
+
+#endif
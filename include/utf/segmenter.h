@@ -20,6 +20,8 @@ namespace meta
 namespace utf
 {
 
+class ascii_segmenter;
+
 /**
  * Class that encapsulates segmenting unicode strings. Supports segmenting
  * sentences as well as words.
@@ -28,8 +30,9 @@ class segmenter
 {
   public:
     /**
-     * Represents a segment within a unicode string. Created by the
-     * segmenter class.
+     * Represents a segment within a unicode string, as the byte offsets
+     * of its first and one past its last byte in the utf-8 content.
+     * Created by the segmenter class.
      */
     class segment
     {
@@ -37,18 +40,19 @@ class segmenter
         /**
          * Creates a segment.
          *
-         * @param begin The starting index of the segment
-         * @param end The ending index of the segment
+         * @param begin The starting byte offset of the segment
+         * @param end The ending byte offset of the segment
          */
         segment(int32_t begin, int32_t end);
 
       private:
         friend segmenter;
+        friend ascii_segmenter;
         // using int32_t here because of ICU, which accepts only int32_t as
         // its indexes
-        /// The beginning index of this segment.
+        /// The beginning byte offset of this segment.
         int32_t begin_;
-        /// The ending index of this segment.
+        /// The ending byte offset of this segment.
         int32_t end_;
     };
 
@@ -88,11 +92,13 @@ class segmenter
     ~segmenter();
 
     /**
-     * Resets the content of the segmenter to the given string.
+     * Resets the content of the segmenter to the given string. The
+     * string is segmented as utf-8 in place, without being converted to
+     * utf-16.
      *
      * @param str A utf-8 string that should be segmented
      */
-    void set_content(const std::string& str);
+    void set_content(std::string str);
 
     /**
      * Segments the current content into sentences by following the
@@ -120,6 +126,15 @@ class segmenter
      */
     std::vector<segment> words(const segment& seg) const;
 
+    /**
+     * Segments a given segment into words, into a vector whose memory is
+     * reused from one call to the next.
+     *
+     * @param seg the segment to sub-segment into words
+     * @param words the vector to replace the contents of with the words
+     */
+    void words(const segment& seg, std::vector<segment>& words) const;
+
     /**
      * @return the content associated with a given segment as a utf-8
      * encoded string
@@ -127,6 +142,14 @@ class segmenter
      */
     std::string content(const segment& seg) const;
 
+    /**
+     * Copies the content associated with a given segment into a buffer.
+     *
+     * @param seg the segment to get content for
+     * @param buffer the string to assign the content to
+     */
+    void content(const segment& seg, std::string& buffer) const;
+
   private:
     class impl;
     /// A pointer to the implementation class for the segmenter.
@@ -10,6 +10,7 @@
 #ifndef META_UTF8_H_
 #define META_UTF8_H_
 
+#include <cstddef>
 #include <functional>
 #include <string>
 
@@ -97,6 +98,28 @@ std::string transform(const std::string& str, const std::string& id);
 std::string remove_if(const std::string& str,
                       std::function<bool(uint32_t)> pred);
 
+/**
+ * @return whether a string holds only ASCII characters, and so is the
+ * same in ASCII, utf8, and (character for character) utf16
+ * @param str The string to check
+ */
+bool is_ascii(const std::string& str);
+
+/**
+ * @return whether a string is well-formed utf8: every sequence is the
+ * shortest encoding of a code point that is not a surrogate and is at
+ * most U+10FFFF
+ * @param str The string to check
+ */
+bool is_valid_utf8(const std::string& str);
+
+/**
+ * @return whether a buffer is well-formed utf8
+ * @param data The start of the buffer
+ * @param size The number of bytes in the buffer
+ */
+bool is_valid_utf8(const char* data, std::size_t size);
+
 /**
  * @return the number of code points in a utf8 string.
  * @param str The string to find the length of
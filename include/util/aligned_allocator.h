@@ -0,0 +1,110 @@
+/**
+ * @file aligned_allocator.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_UTIL_ALIGNED_ALLOCATOR_H_
+#define META_UTIL_ALIGNED_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace meta
+{
+namespace util
+{
+
+/// The size of a cache line, which aligned storage is aligned to
+const std::size_t cache_line_size = 64;
+
+/**
+ * An allocator for standard containers whose memory starts on an
+ * Alignment-byte boundary, so that it starts a cache line and loads of
+ * vector registers from its start are aligned.
+ */
+template <class T, std::size_t Alignment = cache_line_size>
+class aligned_allocator
+{
+    static_assert((Alignment & (Alignment - 1)) == 0,
+                  "alignment must be a power of two");
+    static_assert(Alignment >= sizeof(void*),
+                  "alignment must leave room for the original pointer");
+
+  public:
+    using value_type = T;
+
+    /**
+     * The same allocator for objects of another type.
+     */
+    template <class U>
+    struct rebind
+    {
+        /// the allocator for U
+        using other = aligned_allocator<U, Alignment>;
+    };
+
+    aligned_allocator() = default;
+
+    /**
+     * Copies an allocator of another type; all of them are the same.
+     */
+    template <class U>
+    aligned_allocator(const aligned_allocator<U, Alignment>&)
+    {
+        // nothing
+    }
+
+    /**
+     * @param n The number of objects
+     * @return memory for n objects, aligned to Alignment
+     */
+    T* allocate(std::size_t n)
+    {
+        // the memory is over-allocated, and the pointer to free is kept
+        // in the word just before the aligned memory
+        auto raw = static_cast<char*>(
+            ::operator new(n * sizeof(T) + Alignment + sizeof(void*)));
+        auto start = reinterpret_cast<uintptr_t>(raw + sizeof(void*));
+        auto aligned = reinterpret_cast<char*>((start + Alignment - 1)
+                                               & ~(Alignment - 1));
+        reinterpret_cast<void**>(aligned)[-1] = raw;
+        return reinterpret_cast<T*>(aligned);
+    }
+
+    /**
+     * Frees memory from allocate().
+     * @param p The memory
+     */
+    void deallocate(T* p, std::size_t)
+    {
+        ::operator delete(reinterpret_cast<void**>(p)[-1]);
+    }
+};
+
+/**
+ * @return true: memory from any aligned_allocator may be freed by another
+ */
+template <class T, class U, std::size_t Alignment>
+bool operator==(const aligned_allocator<T, Alignment>&,
+                const aligned_allocator<U, Alignment>&)
+{
+    return true;
+}
+
+/**
+ * @return false: memory from any aligned_allocator may be freed by another
+ */
+template <class T, class U, std::size_t Alignment>
+bool operator!=(const aligned_allocator<T, Alignment>&,
+                const aligned_allocator<U, Alignment>&)
+{
+    return false;
+}
+}
+}
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * @file arena.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_UTIL_ARENA_H_
+#define META_UTIL_ARENA_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace meta
+{
+namespace util
+{
+
+/**
+ * A monotonic buffer: memory is handed out from large blocks by bumping a
+ * pointer, individual frees do nothing, and reset() frees everything at
+ * once. A thread that makes many short-lived objects for each unit of
+ * work (a document, a query) can keep an arena, allocate the objects'
+ * memory from it with arena_allocator, and reset it between units
+ * instead of freeing the objects one at a time. The blocks are kept from
+ * one reset to the next, so a warmed up arena allocates nothing.
+ *
+ * An arena is used by one thread at a time.
+ */
+class arena
+{
+  public:
+    /// The size of the blocks memory is handed out from, by default
+    const static uint64_t default_block_size = 64 * 1024;
+
+    /**
+     * Creates an empty arena.
+     * @param block_size The size of the blocks to allocate; larger
+     * requests get a block of their own
+     */
+    explicit arena(uint64_t block_size = default_block_size);
+
+    /**
+     * Allocates memory that lives until the next reset().
+     * @param size The number of bytes
+     * @param alignment The alignment of the memory, a power of two
+     * @return the memory
+     */
+    void* allocate(uint64_t size,
+                   uint64_t alignment = alignof(std::max_align_t));
+
+    /**
+     * Frees all the memory allocated since the last reset, keeping the
+     * blocks for reuse. Objects still using the memory must have been
+     * destroyed.
+     */
+    void reset();
+
+    /**
+     * @return the number of bytes allocated since the last reset
+     */
+    uint64_t bytes_used() const;
+
+    /**
+     * @return the total size of the arena's blocks
+     */
+    uint64_t capacity() const;
+
+    /**
+     * arena cannot be copied.
+     */
+    arena(const arena&) = delete;
+
+    /**
+     * arena cannot be copied.
+     */
+    arena& operator=(const arena&) = delete;
+
+  private:
+    /**
+     * A block that memory is handed out from.
+     */
+    struct block
+    {
+        /// the memory of the block
+        std::unique_ptr<char[]> data;
+        /// the size of the block in bytes
+        uint64_t size;
+    };
+
+    /// the blocks, in the order they are used in
+    std::vector<block> blocks_;
+    /// the block memory is being handed out from
+    uint64_t current_;
+    /// the offset of the free memory in the current block
+    uint64_t offset_;
+    /// the size of new blocks
+    uint64_t block_size_;
+    /// the number of bytes allocated since the last reset
+    uint64_t used_;
+};
+
+/**
+ * An allocator for standard containers that takes its memory from an
+ * arena, or from the heap when it has none. Containers with an arena free
+ * nothing until the arena is reset, so they must be destroyed before it
+ * is. Copies of a container are made on the heap, so that they may
+ * outlive the arena; moves keep the arena.
+ */
+template <class T>
+class arena_allocator
+{
+  public:
+    using value_type = T;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    /**
+     * Creates an allocator that uses the heap.
+     */
+    arena_allocator() : arena_{nullptr}
+    {
+        // nothing
+    }
+
+    /**
+     * Creates an allocator that uses an arena.
+     * @param a The arena, or nullptr to use the heap
+     */
+    arena_allocator(util::arena* a) : arena_{a}
+    {
+        // nothing
+    }
+
+    /**
+     * Creates an allocator that uses the same memory as another.
+     * @param other The allocator to copy
+     */
+    template <class U>
+    arena_allocator(const arena_allocator<U>& other)
+        : arena_{other.arena()}
+    {
+        // nothing
+    }
+
+    /**
+     * @param n The number of objects
+     * @return memory for n objects
+     */
+    T* allocate(std::size_t n)
+    {
+        if (arena_)
+            return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    /**
+     * Frees memory for objects, which does nothing for an arena.
+     * @param p The memory
+     */
+    void deallocate(T* p, std::size_t)
+    {
+        if (!arena_)
+            ::operator delete(p);
+    }
+
+    /**
+     * @return the allocator of a copy of a container: the heap
+     */
+    arena_allocator select_on_container_copy_construction() const
+    {
+        return arena_allocator{};
+    }
+
+    /**
+     * @return the arena memory comes from, or nullptr for the heap
+     */
+    util::arena* arena() const
+    {
+        return arena_;
+    }
+
+  private:
+    /// the arena memory comes from, or nullptr for the heap
+    util::arena* arena_;
+};
+
+/**
+ * @return whether memory allocated by one allocator may be freed by the
+ * other
+ */
+template <class T, class U>
+bool operator==(const arena_allocator<T>& a, const arena_allocator<U>& b)
+{
+    return a.arena() == b.arena();
+}
+
+/**
+ * @return whether memory allocated by one allocator may not be freed by
+ * the other
+ */
+template <class T, class U>
+bool operator!=(const arena_allocator<T>& a, const arena_allocator<U>& b)
+{
+    return !(a == b);
+}
+}
+}
+
+#endif
@@ -13,6 +13,8 @@
 #include <cstdint>
 #include <vector>
 
+#include "util/aligned_allocator.h"
+
 namespace meta
 {
 namespace util
@@ -22,6 +24,12 @@ namespace util
  * Simple wrapper class for representing a dense matrix laid out in
  * row-major order (that is, its internal representation is a linear array
  * of the rows).
+ *
+ * The storage is aligned to a cache line, and each row is padded to a
+ * whole number of cache lines when the element size allows it, so that
+ * every row starts on a cache line as well. The elements of a row are
+ * contiguous, so row() may be given to the kernels in util/dense_ops.h;
+ * the padding between rows is value-initialized and otherwise unused.
  */
 template <class T>
 class dense_matrix
@@ -91,8 +99,22 @@ class dense_matrix
      */
     const T& operator()(uint64_t row, uint64_t column) const;
 
-    using row_iterator = typename std::vector<T>::iterator;
-    using const_row_iterator = typename std::vector<T>::const_iterator;
+    /// The container the elements are stored in
+    using storage_type = std::vector<T, aligned_allocator<T>>;
+    using row_iterator = typename storage_type::iterator;
+    using const_row_iterator = typename storage_type::const_iterator;
+
+    /**
+     * @param row The row index
+     * @return a pointer to the first element of the row-th row
+     */
+    T* row(uint64_t row);
+
+    /**
+     * @param row The row index
+     * @return a const pointer to the first element of the row-th row
+     */
+    const T* row(uint64_t row) const;
 
     /**
      * @param row The row index
@@ -129,10 +151,24 @@ class dense_matrix
     uint64_t columns() const;
 
   private:
+    /**
+     * @param columns A number of columns
+     * @return the distance between the starts of rows of that many
+     * columns
+     */
+    static uint64_t stride_for(uint64_t columns);
+
     /// the underlying storage for the matrix
-    std::vector<T> storage_;
+    storage_type storage_;
+
+    /// the number of rows in the matrix
+    uint64_t rows_ = 0;
+
     /// the number of columns in the matrix
-    uint64_t columns_;
+    uint64_t columns_ = 0;
+
+    /// the distance between the starts of consecutive rows
+    uint64_t stride_ = 0;
 };
 
 }
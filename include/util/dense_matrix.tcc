@@ -3,6 +3,8 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+
 #include "util/dense_matrix.h"
 
 namespace meta
@@ -12,60 +14,87 @@ namespace util
 
 template <class T>
 dense_matrix<T>::dense_matrix(uint64_t rows, uint64_t columns)
-    : storage_(rows * columns), columns_{columns}
+    : storage_(rows * stride_for(columns)),
+      rows_{rows},
+      columns_{columns},
+      stride_{stride_for(columns)}
 {
     // nothing: use the fact that std::vector<T> value initializes all
     // elements on construction
 }
 
+template <class T>
+uint64_t dense_matrix<T>::stride_for(uint64_t columns)
+{
+    // a row of elements that do not pack into cache lines is not padded
+    if (sizeof(T) > cache_line_size || cache_line_size % sizeof(T) != 0)
+        return columns;
+    const uint64_t per_line = cache_line_size / sizeof(T);
+    return (columns + per_line - 1) / per_line * per_line;
+}
+
 template <class T>
 T& dense_matrix<T>::operator()(uint64_t row, uint64_t column)
 {
-    return storage_[row * columns_ + column];
+    return storage_[row * stride_ + column];
 }
 
 template <class T>
 const T& dense_matrix<T>::operator()(uint64_t row, uint64_t column) const
 {
-    return storage_[row * columns_ + column];
+    return storage_[row * stride_ + column];
 }
 
 template <class T>
 void dense_matrix<T>::resize(uint64_t rows, uint64_t columns)
 {
-    storage_.resize(rows * columns);
+    stride_ = stride_for(columns);
+    storage_.resize(rows * stride_);
     std::fill(storage_.begin(), storage_.end(), T{});
+    rows_ = rows;
     columns_ = columns;
 }
 
+template <class T>
+T* dense_matrix<T>::row(uint64_t row)
+{
+    return storage_.data() + row * stride_;
+}
+
+template <class T>
+const T* dense_matrix<T>::row(uint64_t row) const
+{
+    return storage_.data() + row * stride_;
+}
+
 template <class T>
 auto dense_matrix<T>::begin(uint64_t row) -> row_iterator
 {
-    return storage_.begin() + row * columns_;
+    return storage_.begin() + row * stride_;
 }
 
 template <class T>
 auto dense_matrix<T>::begin(uint64_t row) const -> const_row_iterator
 {
-    return storage_.begin() + row * columns_;
+    return storage_.begin() + row * stride_;
 }
 
 template <class T>
 auto dense_matrix<T>::end(uint64_t row) -> row_iterator
 {
-    return storage_.begin() + (row + 1) * columns_;
+    return begin(row) + columns_;
 }
 
 template <class T>
 auto dense_matrix<T>::end(uint64_t row) const -> const_row_iterator
 {
-    return storage_.begin() + (row + 1) * columns_;
+    return begin(row) + columns_;
 }
 
 template <class T>
 uint64_t dense_matrix<T>::rows() const
 {
-    return storage_.size() / columns_;
+    return rows_;
 }
 
 template <class T>
@@ -0,0 +1,133 @@
+/**
+ * @file dense_ops.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_UTIL_DENSE_OPS_H_
+#define META_UTIL_DENSE_OPS_H_
+
+#include <cstdint>
+
+#include "util/dense_matrix.h"
+
+namespace meta
+{
+namespace util
+{
+
+/**
+ * Arithmetic on dense vectors (contiguous arrays, such as the rows of a
+ * dense_matrix) and on dense matrices, shared by the models that would
+ * otherwise each write their own loops. The loops are plain loops over
+ * contiguous memory, written so that the compiler may vectorize them;
+ * the reductions keep several partial sums to the same end.
+ */
+namespace dense
+{
+
+/**
+ * Exponentiates a vector: out[i] = exp(in[i]). in and out may be the
+ * same vector.
+ * @param in The vector to exponentiate
+ * @param out The vector to store the result in
+ * @param size The length of the vectors
+ */
+template <class T>
+void exp(const T* in, T* out, uint64_t size);
+
+/**
+ * Multiplies a vector by a constant: x *= alpha.
+ * @param alpha The constant
+ * @param x The vector
+ * @param size The length of the vector
+ */
+template <class T>
+void scale(T alpha, T* x, uint64_t size);
+
+/**
+ * Multiplies two vectors elementwise: out[i] = a[i] * b[i]. out may be
+ * the same vector as a or b.
+ * @param a A vector
+ * @param b A vector
+ * @param out The vector to store the result in
+ * @param size The length of the vectors
+ */
+template <class T>
+void multiply(const T* a, const T* b, T* out, uint64_t size);
+
+/**
+ * Adds a multiple of one vector to another: y += alpha * x.
+ * @param alpha The multiple
+ * @param x The vector to add
+ * @param y The vector to add to
+ * @param size The length of the vectors
+ */
+template <class T>
+void axpy(T alpha, const T* x, T* y, uint64_t size);
+
+/**
+ * @param a A vector
+ * @param b A vector
+ * @param size The length of the vectors
+ * @return the dot product of a and b
+ */
+template <class T>
+T dot(const T* a, const T* b, uint64_t size);
+
+/**
+ * @param x A vector
+ * @param size The length of the vector
+ * @return the sum of x's elements
+ */
+template <class T>
+T sum(const T* x, uint64_t size);
+
+/**
+ * Scales a vector so that its elements sum to one, leaving it as it is
+ * if they sum to zero.
+ * @param x The vector
+ * @param size The length of the vector
+ * @return the factor the vector was scaled by
+ */
+template <class T>
+T normalize(T* x, uint64_t size);
+
+/**
+ * Multiplies a matrix by a column vector: y = m * x.
+ * @param m The matrix
+ * @param x A vector of m.columns() elements
+ * @param y A vector of m.rows() elements to store the result in
+ */
+template <class T>
+void matrix_vector(const dense_matrix<T>& m, const T* x, T* y);
+
+/**
+ * Multiplies a row vector by a matrix: y = x * m, a row of m at a time,
+ * so that every inner loop runs over contiguous memory.
+ * @param x A vector of m.rows() elements
+ * @param m The matrix
+ * @param y A vector of m.columns() elements to store the result in
+ */
+template <class T>
+void vector_matrix(const T* x, const dense_matrix<T>& m, T* y);
+
+/**
+ * Multiplies two matrices: c = a * b. The product is computed in blocks
+ * of rows and columns that fit in cache together.
+ * @param a A matrix
+ * @param b A matrix with as many rows as a has columns
+ * @param c The matrix to store the result in, which is resized to
+ * a.rows() by b.columns()
+ */
+template <class T>
+void matrix_matrix(const dense_matrix<T>& a, const dense_matrix<T>& b,
+                   dense_matrix<T>& c);
+}
+}
+}
+
+#include "util/dense_ops.tcc"
+#endif
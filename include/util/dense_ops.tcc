@@ -0,0 +1,137 @@
+/**
+ * @file dense_ops.tcc
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "util/dense_ops.h"
+
+namespace meta
+{
+namespace util
+{
+namespace dense
+{
+
+namespace internal
+{
+/// the number of rows or columns in a block of matrix_matrix
+const uint64_t block_size = 64;
+}
+
+template <class T>
+void exp(const T* in, T* out, uint64_t size)
+{
+    for (uint64_t i = 0; i < size; ++i)
+        out[i] = std::exp(in[i]);
+}
+
+template <class T>
+void scale(T alpha, T* x, uint64_t size)
+{
+    for (uint64_t i = 0; i < size; ++i)
+        x[i] *= alpha;
+}
+
+template <class T>
+void multiply(const T* a, const T* b, T* out, uint64_t size)
+{
+    for (uint64_t i = 0; i < size; ++i)
+        out[i] = a[i] * b[i];
+}
+
+template <class T>
+void axpy(T alpha, const T* x, T* y, uint64_t size)
+{
+    for (uint64_t i = 0; i < size; ++i)
+        y[i] += alpha * x[i];
+}
+
+template <class T>
+T dot(const T* a, const T* b, uint64_t size)
+{
+    T sums[4] = {0, 0, 0, 0};
+    uint64_t i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        sums[0] += a[i] * b[i];
+        sums[1] += a[i + 1] * b[i + 1];
+        sums[2] += a[i + 2] * b[i + 2];
+        sums[3] += a[i + 3] * b[i + 3];
+    }
+    for (; i < size; ++i)
+        sums[0] += a[i] * b[i];
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+template <class T>
+T sum(const T* x, uint64_t size)
+{
+    T sums[4] = {0, 0, 0, 0};
+    uint64_t i = 0;
+    for (; i + 4 <= size; i += 4)
+    {
+        sums[0] += x[i];
+        sums[1] += x[i + 1];
+        sums[2] += x[i + 2];
+        sums[3] += x[i + 3];
+    }
+    for (; i < size; ++i)
+        sums[0] += x[i];
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+template <class T>
+T normalize(T* x, uint64_t size)
+{
+    auto total = sum(x, size);
+    T factor = total != 0 ? 1 / total : 1;
+    scale(factor, x, size);
+    return factor;
+}
+
+template <class T>
+void matrix_vector(const dense_matrix<T>& m, const T* x, T* y)
+{
+    for (uint64_t r = 0; r < m.rows(); ++r)
+        y[r] = dot(m.row(r), x, m.columns());
+}
+
+template <class T>
+void vector_matrix(const T* x, const dense_matrix<T>& m, T* y)
+{
+    std::fill_n(y, m.columns(), T{0});
+    for (uint64_t r = 0; r < m.rows(); ++r)
+        axpy(x[r], m.row(r), y, m.columns());
+}
+
+template <class T>
+void matrix_matrix(const dense_matrix<T>& a, const dense_matrix<T>& b,
+                   dense_matrix<T>& c)
+{
+    using internal::block_size;
+    c.resize(a.rows(), b.columns());
+
+    // each block of b's rows and columns is reused for every row of a
+    // while it is in cache, and every inner loop is an axpy over a
+    // contiguous piece of a row of b and of c
+    for (uint64_t kk = 0; kk < a.columns(); kk += block_size)
+    {
+        auto k_end = std::min(kk + block_size, a.columns());
+        for (uint64_t jj = 0; jj < b.columns(); jj += block_size)
+        {
+            auto width = std::min(jj + block_size, b.columns()) - jj;
+            for (uint64_t i = 0; i < a.rows(); ++i)
+            {
+                auto a_row = a.row(i);
+                auto c_row = c.row(i) + jj;
+                for (uint64_t k = kk; k < k_end; ++k)
+                    axpy(a_row[k], b.row(k) + jj, c_row, width);
+            }
+        }
+    }
+}
+}
+}
+}
@@ -16,7 +16,9 @@
 #include <stdio.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#include "io/mmap_file.h"
 #include "meta.h"
+#include "util/memory_usage.h"
 
 namespace meta
 {
@@ -100,6 +102,23 @@ class disk_vector
      */
     uint64_t size() const;
 
+    /**
+     * @return the memory used by the mapping
+     */
+    util::memory_usage memory_usage() const;
+
+    /**
+     * Reads every page of the vector into memory now, so that later
+     * accesses do not fault.
+     */
+    void prefault() const;
+
+    /**
+     * Hints how the vector will be accessed.
+     * @param pattern How the vector will be accessed
+     */
+    void advise(io::access_pattern pattern) const;
+
     /**
      * Provides iterator functionality for the disk_vector class.
      */
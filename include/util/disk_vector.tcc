@@ -117,6 +117,34 @@ uint64_t disk_vector<T>::size() const
     return size_;
 }
 
+template <class T>
+util::memory_usage disk_vector<T>::memory_usage() const
+{
+    return mapped_memory(start_, size_ * sizeof(T));
+}
+
+template <class T>
+void disk_vector<T>::prefault() const
+{
+    if (!start_ || size_ == 0)
+        return;
+
+    auto bytes = sizeof(T) * size_;
+    advise(io::access_pattern::will_need);
+
+    // the advice is only a hint, so every page is touched as well
+    auto page = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    auto data = reinterpret_cast<const volatile char*>(start_);
+    for (uint64_t i = 0; i < bytes; i += page)
+        (void)data[i];
+}
+
+template <class T>
+void disk_vector<T>::advise(io::access_pattern pattern) const
+{
+    io::advise(start_, sizeof(T) * size_, pattern);
+}
+
 template <class T>
 typename disk_vector<T>::iterator disk_vector<T>::begin() const
 {
@@ -0,0 +1,147 @@
+/**
+ * @file elias_fano.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_UTIL_ELIAS_FANO_H_
+#define META_UTIL_ELIAS_FANO_H_
+
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "util/memory_usage.h"
+
+namespace meta
+{
+namespace util
+{
+
+/**
+ * An immutable non-decreasing sequence of integers in Elias-Fano form,
+ * with random access to its elements.
+ *
+ * Each value is split into its low l bits, stored packed, and its high
+ * bits, stored in unary as gaps in a bit vector where element i sets bit
+ * (value >> l) + i. Choosing l as log2(max / size) keeps the whole
+ * sequence under 2 + log2(max / size) bits per element. Access finds the
+ * i-th set bit of the high bits from a sampled position of every 256th
+ * one, so it reads a bounded number of words.
+ */
+class elias_fano_vector
+{
+  public:
+    /**
+     * Encodes a sequence.
+     * @param first The start of the sequence
+     * @param last The end of the sequence
+     * @throw elias_fano_exception if the sequence decreases
+     */
+    template <class ForwardIterator>
+    elias_fano_vector(ForwardIterator first, ForwardIterator last)
+    {
+        uint64_t size = 0;
+        uint64_t max = 0;
+        for (auto it = first; it != last; ++it, ++size)
+        {
+            if (*it < max)
+                throw elias_fano_exception{"sequence is not monotone"};
+            max = *it;
+        }
+
+        reserve(size, max);
+        uint64_t i = 0;
+        for (auto it = first; it != last; ++it)
+            set(i++, *it);
+        sample();
+    }
+
+    /**
+     * Reads a sequence written by save().
+     * @param path The file to read
+     */
+    explicit elias_fano_vector(const std::string& path);
+
+    /**
+     * Writes the sequence to a file.
+     * @param path The file to write
+     */
+    void save(const std::string& path) const;
+
+    /**
+     * @param idx The index of an element
+     * @return the element, which must exist
+     */
+    uint64_t operator[](uint64_t idx) const;
+
+    /**
+     * @param idx The index of an element
+     * @return the element
+     * @throw elias_fano_exception if there is no such element
+     */
+    uint64_t at(uint64_t idx) const;
+
+    /**
+     * @return the number of elements
+     */
+    uint64_t size() const
+    {
+        return size_;
+    }
+
+    /**
+     * @return the memory used by the sequence
+     */
+    util::memory_usage memory_usage() const;
+
+    /**
+     * Basic exception for elias_fano_vector.
+     */
+    class elias_fano_exception : public std::runtime_error
+    {
+      public:
+        using std::runtime_error::runtime_error;
+    };
+
+  private:
+    /**
+     * Sizes the bit vectors for a sequence.
+     * @param size The number of elements
+     * @param max The largest element
+     */
+    void reserve(uint64_t size, uint64_t max);
+
+    /**
+     * Stores an element; elements must be set in order.
+     * @param idx The index of the element
+     * @param value The element
+     */
+    void set(uint64_t idx, uint64_t value);
+
+    /**
+     * Records the position of every 256th set bit of the high bits.
+     */
+    void sample();
+
+    /// The number of elements
+    uint64_t size_ = 0;
+
+    /// The number of low bits of each element stored packed
+    uint64_t low_bits_ = 0;
+
+    /// The packed low bits of the elements
+    std::vector<uint64_t> low_;
+
+    /// The high bits of the elements, in unary
+    std::vector<uint64_t> high_;
+
+    /// The position in high_ of every 256th element
+    std::vector<uint64_t> samples_;
+};
+}
+}
+#endif
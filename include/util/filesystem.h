@@ -10,9 +10,14 @@
 #ifndef META_FILESYSTEM_H_
 #define META_FILESYSTEM_H_
 
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <string>
 #include <fstream>
+#include <thread>
 #include <vector>
+#include <dirent.h>
 #include <sys/stat.h>
 #include "io/mmap_file.h"
 #include "util/printing.h"
@@ -33,6 +38,25 @@ inline void delete_file(const std::string& filename)
     remove(filename.c_str());
 }
 
+/**
+ * Deletes the given file, or the given directory and everything in it.
+ * @param path The file or directory to delete
+ */
+inline void remove_all(const std::string& path)
+{
+    if (DIR* dir = opendir(path.c_str()))
+    {
+        while (dirent* entry = readdir(dir))
+        {
+            std::string name{entry->d_name};
+            if (name != "." && name != "..")
+                remove_all(path + "/" + name);
+        }
+        closedir(dir);
+    }
+    delete_file(path);
+}
+
 /**
  * Renames the given file.
  * @param old_name The old filename
@@ -146,24 +170,86 @@ inline std::string file_text(const std::string& in_name)
 }
 
 /**
+ * Counts the delimiters in a range of memory.
+ * @param first The start of the range
+ * @param last The end of the range
+ * @param delimiter The character to count
+ * @return the number of times delimiter occurs in [first, last)
+ */
+inline uint64_t count_delimiters(const char* first, const char* last,
+                                 char delimiter)
+{
+    // memchr is vectorized by the C library, so it skips most bytes a
+    // word at a time or more
+    uint64_t num = 0;
+    while (first < last)
+    {
+        auto found = static_cast<const char*>(
+            std::memchr(first, delimiter, static_cast<size_t>(last - first)));
+        if (!found)
+            break;
+        ++num;
+        first = found + 1;
+    }
+    return num;
+}
+
+/**
+ * Counts the lines of a file. The file is mapped into memory and split
+ * into chunks that are scanned in parallel.
  * @param filename The file to count lines in
  * @param delimiter How to denote lines
+ * @param num_threads The number of threads to scan with
  * @return the number of delimiter (default newline) characters in the
  * paramter
  */
-inline uint64_t num_lines(const std::string& filename, char delimiter = '\n')
+inline uint64_t num_lines(const std::string& filename, char delimiter = '\n',
+                          uint64_t num_threads
+                          = std::thread::hardware_concurrency())
 {
+    // empty files cannot be mapped
+    if (file_size(filename) == 0)
+        return 0;
+
     io::mmap_file file{filename};
-    uint64_t num = 0;
+    file.advise(io::access_pattern::sequential);
 
-    printing::progress progress{" > Counting lines in file: ", file.size(), 500,
-                                32 * 1024 * 1024};
-    for (uint64_t idx = 0; idx < file.size(); ++idx)
+    // the file is scanned in blocks, so that progress can be reported
+    // and so that small files are not split across threads for nothing
+    const uint64_t block_size = 32 * 1024 * 1024;
+    auto num_blocks = (file.size() + block_size - 1) / block_size;
+    auto num_parts = std::max<uint64_t>(
+        1, std::min<uint64_t>(num_threads, num_blocks));
+
+    std::atomic<uint64_t> next_block{0};
+    std::atomic<uint64_t> blocks_done{0};
+    std::vector<uint64_t> counts(num_parts, 0);
+    printing::progress progress{" > Counting lines in file: ", num_blocks};
+    auto worker = [&](uint64_t part)
     {
-        progress(idx);
-        if (file[idx] == delimiter)
-            ++num;
-    }
+        for (auto block = next_block++; block < num_blocks;
+             block = next_block++)
+        {
+            auto first = block * block_size;
+            auto last = std::min(file.size(), first + block_size);
+            counts[part] += count_delimiters(file.begin() + first,
+                                             file.begin() + last, delimiter);
+            auto done = ++blocks_done;
+            if (part == 0)
+                progress(done);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint64_t part = 1; part < num_parts; ++part)
+        threads.emplace_back(worker, part);
+    worker(0);
+    for (auto& thread : threads)
+        thread.join();
+
+    uint64_t num = 0;
+    for (const auto& count : counts)
+        num += count;
 
     // this fixes a potential off-by-one if the last line in the file
     // doesn't end with the delimiter
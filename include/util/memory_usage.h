@@ -0,0 +1,140 @@
+/**
+ * @file memory_usage.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_UTIL_MEMORY_USAGE_H_
+#define META_UTIL_MEMORY_USAGE_H_
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace meta
+{
+namespace util
+{
+
+/**
+ * The memory used by an object.
+ */
+struct memory_usage
+{
+    /// the bytes it has allocated on the heap
+    uint64_t heap_bytes = 0;
+    /// the bytes of the files (or anonymous memory) it has mapped
+    uint64_t mapped_bytes = 0;
+    /// the bytes of its mappings that are in memory right now
+    uint64_t resident_bytes = 0;
+
+    /**
+     * @return the memory the object is using right now: its heap memory
+     * and its resident mapped memory
+     */
+    uint64_t in_memory() const
+    {
+        return heap_bytes + resident_bytes;
+    }
+
+    /**
+     * Adds the memory used by another object.
+     * @param other The memory to add
+     * @return this memory_usage
+     */
+    memory_usage& operator+=(const memory_usage& other)
+    {
+        heap_bytes += other.heap_bytes;
+        mapped_bytes += other.mapped_bytes;
+        resident_bytes += other.resident_bytes;
+        return *this;
+    }
+};
+
+/**
+ * @param start The start of a mapped region
+ * @param bytes The length of the region
+ * @return the memory used by the region, with the pages in memory counted
+ * by mincore
+ */
+memory_usage mapped_memory(const void* start, uint64_t bytes);
+
+/**
+ * @param vec A vector
+ * @return the memory the vector has allocated
+ */
+template <class T, class Alloc>
+memory_usage heap_memory(const std::vector<T, Alloc>& vec)
+{
+    memory_usage usage;
+    usage.heap_bytes = vec.capacity() * sizeof(T);
+    return usage;
+}
+
+/**
+ * @param vecs A vector of vectors
+ * @return the memory the vector and each of its vectors have allocated
+ */
+template <class T, class Alloc, class InnerAlloc>
+memory_usage
+    heap_memory(const std::vector<std::vector<T, InnerAlloc>, Alloc>& vecs)
+{
+    memory_usage usage;
+    usage.heap_bytes = vecs.capacity() * sizeof(std::vector<T, InnerAlloc>);
+    for (const auto& vec : vecs)
+        usage.heap_bytes += vec.capacity() * sizeof(T);
+    return usage;
+}
+
+/**
+ * The memory used by an object, broken down by its components, such as
+ * the postings, lexicon and document metadata of an index.
+ */
+class memory_report
+{
+  public:
+    /**
+     * Adds the memory used by a component. Memory added under the same
+     * name more than once is summed.
+     * @param component The name of the component
+     * @param usage The memory it uses
+     */
+    void add(const std::string& component, const memory_usage& usage);
+
+    /**
+     * Adds the components of another report, such as that of an object
+     * this one holds.
+     * @param other The report to add
+     */
+    void add(const memory_report& other);
+
+    /**
+     * @return the memory used by each component, by name
+     */
+    const std::map<std::string, memory_usage>& components() const;
+
+    /**
+     * @return the memory used by every component together
+     */
+    memory_usage total() const;
+
+  private:
+    /// The memory used by each component
+    std::map<std::string, memory_usage> components_;
+};
+
+/**
+ * Prints a memory report, one component per line and then the total.
+ * @param out The stream to write to
+ * @param report The report to print
+ * @return out
+ */
+std::ostream& operator<<(std::ostream& out, const memory_report& report);
+}
+}
+
+#endif
@@ -0,0 +1,433 @@
+/**
+ * @file metrics.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_UTIL_METRICS_H_
+#define META_UTIL_METRICS_H_
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+namespace meta
+{
+
+/**
+ * Counters, gauges and latency histograms kept by the hot paths of the
+ * library (postings decoding, cache lookups, indexing, and the training
+ * loops of the topic models and the CRF), and their export as JSON or in
+ * the Prometheus text format.
+ *
+ * Collection is off by default. While it is off, an instrumented point
+ * costs one relaxed load and a branch: the point checks enabled() before
+ * looking up its metric or reading the clock. Rates, such as tokens
+ * analyzed per second, are left to whoever reads the metrics, from a
+ * counter and the time spent.
+ */
+namespace metrics
+{
+
+namespace internal
+{
+/// whether metrics are being collected
+extern std::atomic<bool> enabled_flag;
+}
+
+/**
+ * @return whether metrics are being collected
+ */
+inline bool enabled()
+{
+    return internal::enabled_flag.load(std::memory_order_relaxed);
+}
+
+/**
+ * Starts or stops collecting metrics. Metrics collected so far are kept.
+ * @param on Whether to collect metrics
+ */
+void enable(bool on = true);
+
+/**
+ * A count that only goes up, such as the number of postings decoded. The
+ * count is spread over several cache-line sized slots, and each thread
+ * adds to the slot it is assigned, so that threads counting the same
+ * thing do not contend; reading it sums every slot.
+ */
+class counter
+{
+  public:
+    /**
+     * Starts the count at zero.
+     */
+    counter();
+
+    /**
+     * @param amount The amount to add to the count
+     */
+    void add(uint64_t amount = 1)
+    {
+        slots_[thread_slot()].count.fetch_add(amount,
+                                              std::memory_order_relaxed);
+    }
+
+    /**
+     * @return the count so far
+     */
+    uint64_t value() const;
+
+    /**
+     * Sets the count back to zero.
+     */
+    void reset();
+
+  private:
+    /// The number of slots the count is spread over
+    const static uint64_t num_slots = 16;
+
+    /**
+     * One part of the count, padded to a cache line.
+     */
+    struct slot
+    {
+        /// the part of the count added by the threads of this slot
+        std::atomic<uint64_t> count;
+        /// fills out the rest of the cache line
+        uint64_t padding[7];
+    };
+
+    /**
+     * @return the slot the calling thread adds to
+     */
+    static uint64_t thread_slot()
+    {
+        static std::atomic<uint64_t> next_slot{0};
+        thread_local uint64_t slot_idx = next_slot++ % num_slots;
+        return slot_idx;
+    }
+
+    /// The slots holding the count
+    std::unique_ptr<slot[]> slots_;
+};
+
+/**
+ * A value that goes up and down, such as the size of a queue. Only the
+ * latest value set is kept.
+ */
+class gauge
+{
+  public:
+    /**
+     * Starts the value at zero.
+     */
+    gauge();
+
+    /**
+     * @param value The new value
+     */
+    void set(double value)
+    {
+        value_.store(value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @return the latest value set
+     */
+    double value() const
+    {
+        return value_.load(std::memory_order_relaxed);
+    }
+
+  private:
+    /// The latest value set
+    std::atomic<double> value_;
+};
+
+/**
+ * The distribution of a quantity, such as the time taken by an iteration
+ * in nanoseconds. Values are counted in power-of-two buckets: bucket 0
+ * holds zero, and bucket i holds the values in [2^(i - 1), 2^i).
+ */
+class histogram
+{
+  public:
+    /// The number of buckets
+    const static uint64_t num_buckets = 65;
+
+    /**
+     * Starts every bucket at zero.
+     */
+    histogram();
+
+    /**
+     * @param value The value to record
+     */
+    void record(uint64_t value);
+
+    /**
+     * @param time The time to record, in nanoseconds
+     */
+    void record(std::chrono::nanoseconds time)
+    {
+        record(static_cast<uint64_t>(time.count()));
+    }
+
+    /**
+     * @return the number of values recorded
+     */
+    uint64_t count() const;
+
+    /**
+     * @return the sum of the values recorded
+     */
+    uint64_t sum() const;
+
+    /**
+     * @param idx A bucket
+     * @return the number of values recorded in that bucket
+     */
+    uint64_t bucket(uint64_t idx) const;
+
+    /**
+     * @param idx A bucket
+     * @return the smallest value past that bucket
+     */
+    static double upper_bound(uint64_t idx);
+
+    /**
+     * Estimates a quantile of the values recorded, to within a factor of
+     * two.
+     * @param quantile The quantile, in [0, 1]
+     * @return the upper bound of the bucket holding the quantile, or zero
+     * if no values have been recorded
+     */
+    double quantile(double quantile) const;
+
+    /**
+     * Forgets every value recorded.
+     */
+    void reset();
+
+  private:
+    /// The number of values in each bucket
+    std::unique_ptr<std::atomic<uint64_t>[]> buckets_;
+    /// The sum of the values recorded
+    std::atomic<uint64_t> sum_;
+};
+
+/**
+ * Exception thrown when a metric is misused.
+ */
+class metrics_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+
+/**
+ * The metrics of the program, by name. A metric is created the first time
+ * its name is asked for and lives as long as the program, so callers may
+ * keep references to it. Names must be valid Prometheus metric names:
+ * letters, digits and underscores, not starting with a digit.
+ */
+class registry
+{
+  public:
+    /**
+     * @return the registry that the library's metrics are kept in
+     */
+    static registry& global();
+
+    /**
+     * @param name The name of the counter
+     * @return the counter with that name
+     */
+    metrics::counter& counter(const std::string& name);
+
+    /**
+     * @param name The name of the gauge
+     * @return the gauge with that name
+     */
+    metrics::gauge& gauge(const std::string& name);
+
+    /**
+     * @param name The name of the histogram
+     * @return the histogram with that name
+     */
+    metrics::histogram& histogram(const std::string& name);
+
+    /**
+     * Writes every metric as a JSON object with "counters", "gauges" and
+     * "histograms" members, each of which maps names to values.
+     * @param out The stream to write to
+     */
+    void write_json(std::ostream& out) const;
+
+    /**
+     * Writes every metric in the Prometheus text exposition format.
+     * @param out The stream to write to
+     */
+    void write_prometheus(std::ostream& out) const;
+
+    /**
+     * Sets every counter and histogram back to zero, and every gauge to
+     * zero.
+     */
+    void reset();
+
+  private:
+    /**
+     * Throws if a name is not a valid metric name, or is already used by
+     * a metric of another kind.
+     * @param name The name to check
+     */
+    void check_name(const std::string& name) const;
+
+    /// Guards the maps, but not the metrics in them
+    mutable std::mutex mutex_;
+    /// The counters, by name
+    std::map<std::string, std::unique_ptr<metrics::counter>> counters_;
+    /// The gauges, by name
+    std::map<std::string, std::unique_ptr<metrics::gauge>> gauges_;
+    /// The histograms, by name
+    std::map<std::string, std::unique_ptr<metrics::histogram>> histograms_;
+};
+
+/**
+ * @param name The name of a counter
+ * @return the counter with that name in the global registry
+ */
+inline counter& get_counter(const std::string& name)
+{
+    return registry::global().counter(name);
+}
+
+/**
+ * @param name The name of a gauge
+ * @return the gauge with that name in the global registry
+ */
+inline gauge& get_gauge(const std::string& name)
+{
+    return registry::global().gauge(name);
+}
+
+/**
+ * @param name The name of a histogram
+ * @return the histogram with that name in the global registry
+ */
+inline histogram& get_histogram(const std::string& name)
+{
+    return registry::global().histogram(name);
+}
+
+/**
+ * Records the time between its construction and destruction in a
+ * histogram of the global registry, in nanoseconds, if metrics were being
+ * collected when it was constructed. The histogram is looked up by name
+ * when the time is recorded, so a timer is meant for spans such as an
+ * iteration or a chunk flush rather than for a single posting.
+ */
+class scoped_timer
+{
+  public:
+    /**
+     * Starts the timer.
+     * @param name The name of the histogram to record the time in
+     */
+    explicit scoped_timer(const char* name)
+        : name_{enabled() ? name : nullptr}
+    {
+        if (name_)
+            start_ = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * Records the time since construction.
+     */
+    ~scoped_timer()
+    {
+        if (name_)
+            get_histogram(name_).record(std::chrono::steady_clock::now()
+                                        - start_);
+    }
+
+    scoped_timer(const scoped_timer&) = delete;
+    scoped_timer& operator=(const scoped_timer&) = delete;
+
+  private:
+    /// The name of the histogram, or null if the time is not recorded
+    const char* name_;
+    /// When the timer started
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * Writes the global registry to a file every so often from a background
+ * thread, replacing the file's contents each time, and once more when it
+ * is destroyed.
+ */
+class periodic_dump
+{
+  public:
+    /**
+     * The formats a dump may be written in.
+     */
+    enum class format
+    {
+        json,
+        prometheus
+    };
+
+    /**
+     * Starts the thread.
+     * @param path The file to write to
+     * @param interval The time between dumps
+     * @param fmt The format to write in
+     */
+    periodic_dump(const std::string& path, std::chrono::milliseconds interval,
+                  format fmt = format::json);
+
+    /**
+     * Stops the thread, and writes the metrics once more.
+     */
+    ~periodic_dump();
+
+    periodic_dump(const periodic_dump&) = delete;
+    periodic_dump& operator=(const periodic_dump&) = delete;
+
+  private:
+    /**
+     * Writes the metrics to the file.
+     */
+    void dump() const;
+
+    /// The file to write to
+    const std::string path_;
+    /// The time between dumps
+    const std::chrono::milliseconds interval_;
+    /// The format to write in
+    const format format_;
+    /// Guards stopped_
+    std::mutex mutex_;
+    /// Wakes the thread when it is stopped
+    std::condition_variable cond_;
+    /// Whether the thread should stop
+    bool stopped_;
+    /// The thread writing the dumps
+    std::thread thread_;
+};
+}
+}
+
+#endif
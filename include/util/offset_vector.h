@@ -0,0 +1,99 @@
+/**
+ * @file offset_vector.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_UTIL_OFFSET_VECTOR_H_
+#define META_UTIL_OFFSET_VECTOR_H_
+
+#include <cstdint>
+#include <string>
+
+#include "util/disk_vector.h"
+#include "util/elias_fano.h"
+#include "util/optional.h"
+
+namespace meta
+{
+namespace util
+{
+
+/**
+ * A read-only table of file offsets, such as the location of each term's
+ * postings, held in Elias-Fano form when it is monotone.
+ *
+ * Tables are built as a disk_vector<uint64_t>, since their entries are
+ * often filled out of order, and compact() then replaces the file with
+ * an Elias-Fano file beside it (its path plus ".ef") if the offsets never
+ * decrease. An offset_vector reads whichever of the two it finds, so
+ * tables that are not monotone, and those of indexes written before the
+ * Elias-Fano form existed, are still mapped as they are.
+ */
+class offset_vector
+{
+  public:
+    /**
+     * Replaces a table written as a disk_vector<uint64_t> with its
+     * Elias-Fano form, if its offsets never decrease.
+     * @param path The path of the table
+     * @return whether the table was replaced
+     */
+    static bool compact(const std::string& path);
+
+    /**
+     * @param path The path of a table
+     * @return whether the table exists, in either form
+     */
+    static bool exists(const std::string& path);
+
+    /**
+     * Opens a table, in Elias-Fano form if it has been compacted.
+     * @param path The path of the table
+     */
+    explicit offset_vector(const std::string& path);
+
+    /**
+     * @param idx The index of an offset
+     * @return the offset, which must exist
+     */
+    uint64_t operator[](uint64_t idx) const
+    {
+        return packed_ ? (*packed_)[idx] : (*flat_)[idx];
+    }
+
+    /**
+     * @param idx The index of an offset
+     * @return the offset
+     * @throw an exception if there is no such offset
+     */
+    uint64_t at(uint64_t idx) const;
+
+    /**
+     * @return the number of offsets
+     */
+    uint64_t size() const;
+
+    /**
+     * @return the memory used by the table
+     */
+    util::memory_usage memory_usage() const;
+
+    /**
+     * Reads a table that is still a disk_vector into memory now; one in
+     * Elias-Fano form is always in memory.
+     */
+    void prefault() const;
+
+  private:
+    /// The offsets, if the table is in Elias-Fano form
+    util::optional<elias_fano_vector> packed_;
+
+    /// The offsets, if the table is a disk_vector
+    util::optional<disk_vector<uint64_t>> flat_;
+};
+}
+}
+#endif
@@ -10,8 +10,12 @@
 #ifndef META_UTIL_PROGRESS_H_
 #define META_UTIL_PROGRESS_H_
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <mutex>
 #include <string>
+#include <thread>
 
 namespace meta
 {
@@ -96,6 +100,75 @@ class progress
     /// Whether or not we should print an endline when done.
     bool endline_;
 };
+
+/**
+ * A progress reporter for loops whose iterations run on several threads
+ * at once. The threads only add the work they finish to an atomic
+ * counter, and a timer thread of the reporter's own draws the progress
+ * bar from it every interval; no thread waits on another to report.
+ */
+class concurrent_progress
+{
+  public:
+    /**
+     * Constructs a progress reporter with the given prefix and iteration
+     * length, and starts its timer thread.
+     *
+     * @param prefix The string to be printed right before the progress
+     * output
+     * @param length The number of iterations
+     * @param interval The length of time, in milliseconds, to wait
+     * between updates. Default = 500ms.
+     */
+    concurrent_progress(const std::string& prefix, uint64_t length,
+                        int interval = 500);
+
+    /**
+     * Sets whether or not an endline should be printed at completion.
+     * @param endline Whether or not an endline should be printed at
+     * completion
+     */
+    void print_endline(bool endline);
+
+    /**
+     * Destroys this progress reporter. It will call end() if it has not
+     * already been called.
+     */
+    ~concurrent_progress();
+
+    /**
+     * Records finished iterations; safe to call from any thread.
+     * @param count The number of iterations finished
+     */
+    void increment(uint64_t count = 1);
+
+    /**
+     * Stops the timer thread and marks the progress indicator as having
+     * finished.
+     */
+    void end();
+
+  private:
+    /// Draws the progress bar until end() is called.
+    void run();
+
+    /// The progress bar, drawn only by the timer thread until end().
+    progress progress_;
+    /// The number of iterations finished so far.
+    std::atomic<uint64_t> done_;
+    /// The length of time, in milliseconds, to wait between updates.
+    std::chrono::milliseconds interval_;
+    /// Protects stop_.
+    std::mutex mutex_;
+    /// Wakes the timer thread when the job ends.
+    std::condition_variable stopped_;
+    /// Whether the timer thread should stop.
+    bool stop_;
+    /// Whether end() has been called.
+    bool finished_;
+    /// The thread that draws the progress bar.
+    std::thread timer_;
+};
 }
 }
 #endif
@@ -0,0 +1,96 @@
+/**
+ * @file sparse_ops.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_UTIL_SPARSE_OPS_H_
+#define META_UTIL_SPARSE_OPS_H_
+
+namespace meta
+{
+namespace util
+{
+
+/**
+ * Arithmetic on sparse vectors, shared by the classifiers and kernels
+ * instead of each writing its own loops.
+ *
+ * A sparse vector here is any range of (index, value) pairs sorted by
+ * index with one pair per index: a sparse_vector, the counts of a
+ * postings_data, or a row of a csr_matrix. A dense vector is anything
+ * indexed by the sparse vectors' indices with operator[].
+ *
+ * When both ranges have random access iterators, the sparse-sparse
+ * operations gallop through the longer vector instead of stepping
+ * through it, so that a short vector (a query, a support vector) is
+ * cheap to compare against a long one.
+ */
+namespace sparse
+{
+
+/**
+ * @param x A sparse vector
+ * @param y A dense vector
+ * @return the dot product of x and y
+ */
+template <class Sparse, class Dense>
+double dot_dense(const Sparse& x, const Dense& y);
+
+/**
+ * @param a A sparse vector
+ * @param b A sparse vector
+ * @return the dot product of a and b
+ */
+template <class Sparse1, class Sparse2>
+double dot(const Sparse1& a, const Sparse2& b);
+
+/**
+ * @param x A sparse vector
+ * @return the sum of the squares of x's values
+ */
+template <class Sparse>
+double squared_norm(const Sparse& x);
+
+/**
+ * @param x A sparse vector
+ * @return the Euclidean length of x
+ */
+template <class Sparse>
+double norm(const Sparse& x);
+
+/**
+ * @param a A sparse vector
+ * @param b A sparse vector
+ * @return the squared Euclidean distance between a and b
+ */
+template <class Sparse1, class Sparse2>
+double squared_distance(const Sparse1& a, const Sparse2& b);
+
+/**
+ * Adds a multiple of a sparse vector to a dense vector: y += alpha * x.
+ * @param alpha The multiple
+ * @param x A sparse vector
+ * @param y A dense vector, large enough for every index of x
+ */
+template <class Sparse, class Dense>
+void axpy(double alpha, const Sparse& x, Dense& y);
+
+/**
+ * Appends the sum of two sparse vectors to another, in index order and
+ * with one pair per index: out += a + b.
+ * @param a A sparse vector
+ * @param b A sparse vector
+ * @param out The sparse vector to append to, with emplace_back; its
+ * indices must all be lower than those of a and b
+ */
+template <class Sparse1, class Sparse2, class Out>
+void merge(const Sparse1& a, const Sparse2& b, Out& out);
+}
+}
+}
+
+#include "util/sparse_ops.tcc"
+#endif
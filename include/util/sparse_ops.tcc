@@ -0,0 +1,271 @@
+/**
+ * @file sparse_ops.tcc
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+
+#include "util/sparse_ops.h"
+
+namespace meta
+{
+namespace util
+{
+namespace sparse
+{
+namespace internal
+{
+
+/**
+ * Whether an iterator is a random access iterator; iterators without
+ * iterator traits are not.
+ */
+template <class Iterator>
+class is_random_access
+{
+    template <class It>
+    static auto check(int) -> typename std::is_base_of<
+        std::random_access_iterator_tag,
+        typename std::iterator_traits<It>::iterator_category>::type;
+
+    template <class>
+    static std::false_type check(...);
+
+  public:
+    /// whether Iterator is a random access iterator
+    const static bool value = decltype(check<Iterator>(0))::value;
+};
+
+/**
+ * How many times longer than the other a vector must be for the
+ * sparse-sparse operations to gallop through it.
+ */
+const std::ptrdiff_t gallop_ratio = 8;
+
+/**
+ * Finds the first pair of a sorted range whose index is not less than a
+ * given one, looking at exponentially further pairs and then searching
+ * between the last two, so that it is cheap when the pair is near.
+ * @param first The start of the range
+ * @param last The end of the range
+ * @param index The index to find
+ * @return the first pair whose index is not less than index
+ */
+template <class Iterator, class Index>
+Iterator gallop(Iterator first, Iterator last, const Index& index)
+{
+    auto size = last - first;
+    std::ptrdiff_t bound = 1;
+    while (bound < size && first[bound].first < index)
+        bound *= 2;
+
+    using pair_type = typename std::iterator_traits<Iterator>::value_type;
+    return std::lower_bound(first + bound / 2,
+                            first + std::min(bound, size), index,
+                            [](const pair_type& p, const Index& idx)
+                            {
+        return p.first < idx;
+    });
+}
+
+/**
+ * The dot product of two sparse vectors, stepping through both.
+ */
+template <class It1, class It2>
+double dot(It1 a, It1 a_end, It2 b, It2 b_end, std::false_type)
+{
+    double sum = 0;
+    while (a != a_end && b != b_end)
+    {
+        auto a_index = (*a).first;
+        auto b_index = (*b).first;
+        if (a_index < b_index)
+            ++a;
+        else if (b_index < a_index)
+            ++b;
+        else
+        {
+            sum += (*a).second * (*b).second;
+            ++a;
+            ++b;
+        }
+    }
+    return sum;
+}
+
+/**
+ * The dot product of two sparse vectors with random access, galloping
+ * through the longer one when it is much longer than the other.
+ */
+template <class It1, class It2>
+double dot(It1 a, It1 a_end, It2 b, It2 b_end, std::true_type)
+{
+    auto a_size = a_end - a;
+    auto b_size = b_end - b;
+    if (a_size > gallop_ratio * b_size)
+        return dot(b, b_end, a, a_end, std::true_type{});
+    if (b_size <= gallop_ratio * a_size)
+        return dot(a, a_end, b, b_end, std::false_type{});
+
+    double sum = 0;
+    for (; a != a_end; ++a)
+    {
+        b = gallop(b, b_end, a->first);
+        if (b == b_end)
+            break;
+        if (b->first == a->first)
+        {
+            sum += a->second * b->second;
+            ++b;
+        }
+    }
+    return sum;
+}
+
+/**
+ * The dot product of a sparse and a dense vector, stepping through the
+ * sparse one.
+ */
+template <class Iterator, class Dense>
+double dot_dense(Iterator it, Iterator end, const Dense& y, std::false_type)
+{
+    double sum = 0;
+    for (; it != end; ++it)
+    {
+        auto p = *it;
+        sum += p.second * y[p.first];
+    }
+    return sum;
+}
+
+/**
+ * The dot product of a sparse vector with random access and a dense
+ * vector. Four sums are kept, so that the loads of the dense values are
+ * not each held up waiting for the previous addition.
+ */
+template <class Iterator, class Dense>
+double dot_dense(Iterator it, Iterator end, const Dense& y, std::true_type)
+{
+    double sums[4] = {0, 0, 0, 0};
+    for (; end - it >= 4; it += 4)
+    {
+        sums[0] += it[0].second * y[it[0].first];
+        sums[1] += it[1].second * y[it[1].first];
+        sums[2] += it[2].second * y[it[2].first];
+        sums[3] += it[3].second * y[it[3].first];
+    }
+    for (; it != end; ++it)
+        sums[0] += it->second * y[it->first];
+    return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+}
+
+template <class Sparse, class Dense>
+double dot_dense(const Sparse& x, const Dense& y)
+{
+    using iterator = decltype(x.begin());
+    return internal::dot_dense(
+        x.begin(), x.end(), y,
+        std::integral_constant<bool, internal::is_random_access<
+                                         iterator>::value>{});
+}
+
+template <class Sparse1, class Sparse2>
+double dot(const Sparse1& a, const Sparse2& b)
+{
+    using iterator1 = decltype(a.begin());
+    using iterator2 = decltype(b.begin());
+    return internal::dot(
+        a.begin(), a.end(), b.begin(), b.end(),
+        std::integral_constant<
+            bool, internal::is_random_access<iterator1>::value
+                      && internal::is_random_access<iterator2>::value>{});
+}
+
+template <class Sparse>
+double squared_norm(const Sparse& x)
+{
+    double sum = 0;
+    for (const auto& p : x)
+        sum += p.second * p.second;
+    return sum;
+}
+
+template <class Sparse>
+double norm(const Sparse& x)
+{
+    return std::sqrt(squared_norm(x));
+}
+
+template <class Sparse1, class Sparse2>
+double squared_distance(const Sparse1& a, const Sparse2& b)
+{
+    double sum = 0;
+    auto a_it = a.begin();
+    auto b_it = b.begin();
+    while (a_it != a.end() || b_it != b.end())
+    {
+        if (b_it == b.end()
+            || (a_it != a.end() && (*a_it).first < (*b_it).first))
+        {
+            auto value = (*a_it).second;
+            sum += value * value;
+            ++a_it;
+        }
+        else if (a_it == a.end() || (*b_it).first < (*a_it).first)
+        {
+            auto value = (*b_it).second;
+            sum += value * value;
+            ++b_it;
+        }
+        else
+        {
+            auto delta = (*a_it).second - (*b_it).second;
+            sum += delta * delta;
+            ++a_it;
+            ++b_it;
+        }
+    }
+    return sum;
+}
+
+template <class Sparse, class Dense>
+void axpy(double alpha, const Sparse& x, Dense& y)
+{
+    for (const auto& p : x)
+        y[p.first] += alpha * p.second;
+}
+
+template <class Sparse1, class Sparse2, class Out>
+void merge(const Sparse1& a, const Sparse2& b, Out& out)
+{
+    auto a_it = a.begin();
+    auto b_it = b.begin();
+    while (a_it != a.end() || b_it != b.end())
+    {
+        if (b_it == b.end()
+            || (a_it != a.end() && (*a_it).first < (*b_it).first))
+        {
+            out.emplace_back((*a_it).first, (*a_it).second);
+            ++a_it;
+        }
+        else if (a_it == a.end() || (*b_it).first < (*a_it).first)
+        {
+            out.emplace_back((*b_it).first, (*b_it).second);
+            ++b_it;
+        }
+        else
+        {
+            out.emplace_back((*a_it).first, (*a_it).second + (*b_it).second);
+            ++a_it;
+            ++b_it;
+        }
+    }
+}
+}
+}
+}
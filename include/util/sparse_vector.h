@@ -11,6 +11,7 @@
 #define META_UTIL_SPARSE_VECTOR_H_
 
 #include <cstdint>
+#include <memory>
 #include <utility>
 #include <vector>
 
@@ -22,14 +23,17 @@ namespace util
 /**
  * Represents a sparse vector, indexed by type Index and storing values of
  * type Value. This stores the elements in the vector in sorted order by
- * the Index type.
+ * the Index type. The elements are allocated with Allocator, which may be
+ * an arena_allocator for vectors that are made and dropped often.
  */
-template <class Index, class Value>
+template <class Index, class Value,
+          class Allocator = std::allocator<std::pair<Index, Value>>>
 class sparse_vector
 {
   public:
     using pair_type = std::pair<Index, Value>;
-    using container_type = std::vector<pair_type>;
+    using allocator_type = Allocator;
+    using container_type = std::vector<pair_type, Allocator>;
     using iterator = typename container_type::iterator;
     using const_iterator = typename container_type::const_iterator;
 
@@ -44,6 +48,13 @@ class sparse_vector
      */
     sparse_vector(uint64_t size);
 
+    /**
+     * Creates an empty sparse_vector that allocates its elements with the
+     * given allocator.
+     * @param alloc The allocator
+     */
+    explicit sparse_vector(const Allocator& alloc);
+
     /**
      * Creates a sparse vector from a pair of iterators of pairs.
      * @param begin The iterator to the beginning of the sequence
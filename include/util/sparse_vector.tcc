@@ -11,23 +11,30 @@ namespace meta
 namespace util
 {
 
-template <class Index, class Value>
-sparse_vector<Index, Value>::sparse_vector(uint64_t size)
+template <class Index, class Value, class Allocator>
+sparse_vector<Index, Value, Allocator>::sparse_vector(uint64_t size)
     : storage_(size)
 {
     // nothing
 }
 
-template <class Index, class Value>
+template <class Index, class Value, class Allocator>
+sparse_vector<Index, Value, Allocator>::sparse_vector(const Allocator& alloc)
+    : storage_(alloc)
+{
+    // nothing
+}
+
+template <class Index, class Value, class Allocator>
 template <class Iter>
-sparse_vector<Index, Value>::sparse_vector(Iter begin, Iter end)
+sparse_vector<Index, Value, Allocator>::sparse_vector(Iter begin, Iter end)
     : storage_{begin, end}
 {
     // nothing
 }
 
-template <class Index, class Value>
-Value& sparse_vector<Index, Value>::operator[](const Index& index)
+template <class Index, class Value, class Allocator>
+Value& sparse_vector<Index, Value, Allocator>::operator[](const Index& index)
 {
     auto it = std::lower_bound(std::begin(storage_), std::end(storage_), index,
                                [](const pair_type& p, const Index& idx)
@@ -51,8 +58,8 @@ Value& sparse_vector<Index, Value>::operator[](const Index& index)
     }
 }
 
-template <class Index, class Value>
-Value sparse_vector<Index, Value>::at(const Index& index) const
+template <class Index, class Value, class Allocator>
+Value sparse_vector<Index, Value, Allocator>::at(const Index& index) const
 {
     auto it = std::lower_bound(std::begin(storage_), std::end(storage_), index,
                                [](const pair_type& p, const Index& idx)
@@ -65,8 +72,8 @@ Value sparse_vector<Index, Value>::at(const Index& index) const
     return it->second;
 }
 
-template <class Index, class Value>
-auto sparse_vector<Index, Value>::find(
+template <class Index, class Value, class Allocator>
+auto sparse_vector<Index, Value, Allocator>::find(
     const Index& index) const -> const_iterator
 {
     auto it = std::lower_bound(std::begin(storage_), std::end(storage_), index,
@@ -81,33 +88,33 @@ auto sparse_vector<Index, Value>::find(
     return it;
 }
 
-template <class Index, class Value>
+template <class Index, class Value, class Allocator>
 template <class... Ts>
-void sparse_vector<Index, Value>::emplace_back(Ts&&... ts)
+void sparse_vector<Index, Value, Allocator>::emplace_back(Ts&&... ts)
 {
     storage_.emplace_back(std::forward<Ts>(ts)...);
 }
 
-template <class Index, class Value>
-void sparse_vector<Index, Value>::reserve(uint64_t size)
+template <class Index, class Value, class Allocator>
+void sparse_vector<Index, Value, Allocator>::reserve(uint64_t size)
 {
     storage_.reserve(size);
 }
 
-template <class Index, class Value>
-void sparse_vector<Index, Value>::clear()
+template <class Index, class Value, class Allocator>
+void sparse_vector<Index, Value, Allocator>::clear()
 {
     storage_.clear();
 }
 
-template <class Index, class Value>
-void sparse_vector<Index, Value>::shrink_to_fit()
+template <class Index, class Value, class Allocator>
+void sparse_vector<Index, Value, Allocator>::shrink_to_fit()
 {
     storage_.shrink_to_fit();
 }
 
-template <class Index, class Value>
-void sparse_vector<Index, Value>::condense()
+template <class Index, class Value, class Allocator>
+void sparse_vector<Index, Value, Allocator>::condense()
 {
     Value default_value{};
 
@@ -121,26 +128,26 @@ void sparse_vector<Index, Value>::condense()
     shrink_to_fit();
 }
 
-template <class Index, class Value>
-uint64_t sparse_vector<Index, Value>::size() const
+template <class Index, class Value, class Allocator>
+uint64_t sparse_vector<Index, Value, Allocator>::size() const
 {
     return storage_.size();
 }
 
-template <class Index, class Value>
-bool sparse_vector<Index, Value>::empty() const
+template <class Index, class Value, class Allocator>
+bool sparse_vector<Index, Value, Allocator>::empty() const
 {
     return storage_.empty();
 }
 
-template <class Index, class Value>
-auto sparse_vector<Index, Value>::contents() const -> const container_type &
+template <class Index, class Value, class Allocator>
+auto sparse_vector<Index, Value, Allocator>::contents() const -> const container_type &
 {
     return storage_;
 }
 
-template <class Index, class Value>
-void sparse_vector<Index, Value>::contents(container_type cont)
+template <class Index, class Value, class Allocator>
+void sparse_vector<Index, Value, Allocator>::contents(container_type cont)
 {
     storage_ = std::move(cont);
     std::sort(std::begin(storage_), std::end(storage_),
@@ -150,38 +157,38 @@ void sparse_vector<Index, Value>::contents(container_type cont)
     });
 }
 
-template <class Index, class Value>
-auto sparse_vector<Index, Value>::begin() -> iterator
+template <class Index, class Value, class Allocator>
+auto sparse_vector<Index, Value, Allocator>::begin() -> iterator
 {
     return std::begin(storage_);
 }
 
-template <class Index, class Value>
-auto sparse_vector<Index, Value>::begin() const -> const_iterator
+template <class Index, class Value, class Allocator>
+auto sparse_vector<Index, Value, Allocator>::begin() const -> const_iterator
 {
     return std::begin(storage_);
 }
 
-template <class Index, class Value>
-auto sparse_vector<Index, Value>::cbegin() const -> const_iterator
+template <class Index, class Value, class Allocator>
+auto sparse_vector<Index, Value, Allocator>::cbegin() const -> const_iterator
 {
     return storage_.cbegin();
 }
 
-template <class Index, class Value>
-auto sparse_vector<Index, Value>::end() -> iterator
+template <class Index, class Value, class Allocator>
+auto sparse_vector<Index, Value, Allocator>::end() -> iterator
 {
     return std::end(storage_);
 }
 
-template <class Index, class Value>
-auto sparse_vector<Index, Value>::end() const -> const_iterator
+template <class Index, class Value, class Allocator>
+auto sparse_vector<Index, Value, Allocator>::end() const -> const_iterator
 {
     return std::end(storage_);
 }
 
-template <class Index, class Value>
-auto sparse_vector<Index, Value>::cend() const -> const_iterator
+template <class Index, class Value, class Allocator>
+auto sparse_vector<Index, Value, Allocator>::cend() const -> const_iterator
 {
     return storage_.cend();
 }
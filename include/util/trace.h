@@ -0,0 +1,181 @@
+/**
+ * @file trace.h
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#ifndef META_UTIL_TRACE_H_
+#define META_UTIL_TRACE_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+
+namespace cpptoml
+{
+class table;
+}
+
+namespace meta
+{
+
+/**
+ * A timeline of the stages of the library's pipelines (tokenizing,
+ * flushing and merging chunks, compressing postings, uninverting) and of
+ * the tasks run by thread pools, for finding the stage that takes the
+ * longest and seeing how the threads overlap.
+ *
+ * Each thread records its events into a ring buffer of its own, so that
+ * recording never waits on another thread; a thread that records more
+ * events than its buffer holds overwrites its oldest ones. The timeline
+ * is written in the Chrome trace event format, which chrome://tracing
+ * and the Perfetto UI both open.
+ *
+ * Tracing is off by default. While it is off, a traced scope costs one
+ * relaxed load and a branch. It is turned on by enable(), by a [trace]
+ * table given to configure(), or by setting the META_TRACE environment
+ * variable to the file the trace should be written to when the program
+ * exits.
+ */
+namespace trace
+{
+
+namespace internal
+{
+/// whether events are being recorded
+extern std::atomic<bool> enabled_flag;
+}
+
+/**
+ * @return whether events are being recorded
+ */
+inline bool enabled()
+{
+    return internal::enabled_flag.load(std::memory_order_relaxed);
+}
+
+/// The number of events each thread keeps unless told otherwise
+const uint64_t default_events_per_thread = 1 << 16;
+
+/**
+ * Starts or stops recording events. Events recorded so far are kept.
+ * @param on Whether to record events
+ * @param events_per_thread The number of events each thread keeps; only
+ * threads that record their first event afterwards use it
+ */
+void enable(bool on = true,
+            uint64_t events_per_thread = default_events_per_thread);
+
+/**
+ * Records an event that has already ended.
+ * @param name The name of the event, which must outlive the trace (a
+ * string literal)
+ * @param category The category of the event, which must outlive the
+ * trace (a string literal)
+ * @param start When the event started
+ * @param end When the event ended
+ */
+void record(const char* name, const char* category,
+            std::chrono::steady_clock::time_point start,
+            std::chrono::steady_clock::time_point end);
+
+/**
+ * Names the calling thread in the timeline, such as "pool worker 3".
+ * @param name The name of the thread
+ */
+void name_thread(const std::string& name);
+
+/**
+ * Writes every event recorded so far in the Chrome trace event format.
+ * Threads may go on recording while the trace is written.
+ * @param out The stream to write to
+ */
+void write_chrome_json(std::ostream& out);
+
+/**
+ * Writes every event recorded so far in the Chrome trace event format.
+ * @param path The file to write to
+ */
+void write_chrome_json(const std::string& path);
+
+/**
+ * Discards every event recorded so far.
+ */
+void clear();
+
+/**
+ * Turns tracing on from the [trace] table of a configuration, if it has
+ * one, as in
+ *
+ * ~~~toml
+ * [trace]
+ * output = "trace.json"        # written when the program exits
+ * events-per-thread = 65536    # optional
+ * ~~~
+ *
+ * The META_TRACE environment variable, if set, takes the place of the
+ * output key.
+ * @param config The configuration
+ */
+void configure(const cpptoml::table& config);
+
+/**
+ * Records the time between its construction and destruction as an event
+ * of the calling thread, if events were being recorded when it was
+ * constructed.
+ */
+class scoped_event
+{
+  public:
+    /**
+     * Starts the event.
+     * @param name The name of the event, which must outlive the trace (a
+     * string literal)
+     * @param category The category of the event, which must outlive the
+     * trace (a string literal)
+     */
+    explicit scoped_event(const char* name, const char* category = "meta")
+        : name_{enabled() ? name : nullptr}, category_{category}
+    {
+        if (name_)
+            start_ = std::chrono::steady_clock::now();
+    }
+
+    /**
+     * Ends the event.
+     */
+    ~scoped_event()
+    {
+        if (name_)
+            record(name_, category_, start_, std::chrono::steady_clock::now());
+    }
+
+    scoped_event(const scoped_event&) = delete;
+    scoped_event& operator=(const scoped_event&) = delete;
+
+  private:
+    /// The name of the event, or null if it is not recorded
+    const char* name_;
+    /// The category of the event
+    const char* category_;
+    /// When the event started
+    std::chrono::steady_clock::time_point start_;
+};
+
+/**
+ * Exception thrown when a trace cannot be written.
+ */
+class trace_exception : public std::runtime_error
+{
+  public:
+    using std::runtime_error::runtime_error;
+};
+}
+}
+
+#endif
@@ -2,16 +2,14 @@
  * @file analyzer.cpp
  */
 
+#include <cctype>
+#include <cstring>
+
 #include "analyzers/analyzer_factory.h"
 #include "analyzers/filter_factory.h"
 #include "analyzers/multi_analyzer.h"
 #include "analyzers/token_stream.h"
-#include "analyzers/filters/alpha_filter.h"
-#include "analyzers/filters/empty_sentence_filter.h"
-#include "analyzers/filters/length_filter.h"
-#include "analyzers/filters/list_filter.h"
-#include "analyzers/filters/lowercase_filter.h"
-#include "analyzers/filters/porter2_stemmer.h"
+#include "analyzers/filters/fused_chain.h"
 #include "analyzers/tokenizers/icu_tokenizer.h"
 #include "corpus/document.h"
 #include "cpptoml.h"
@@ -24,15 +22,75 @@ namespace meta
 namespace analyzers
 {
 
+void analyzer::tokenize_positions(corpus::document&, position_map&)
+{
+    throw analyzer_exception{"this analyzer does not record term positions"};
+}
+
+namespace
+{
+/**
+ * @param encoding The name of an encoding
+ * @return whether the encoding is utf-8
+ */
+bool is_utf8(const std::string& encoding)
+{
+    std::string name;
+    for (auto c : encoding)
+    {
+        if (c != '-' && c != '_')
+            name += std::tolower(static_cast<unsigned char>(c));
+    }
+    return name == "utf8";
+}
+
+/**
+ * @param data The start of the content of a document
+ * @param size The number of bytes of content
+ * @param encoding The encoding of the content
+ * @return whether converting the content to utf-8 would leave it as it
+ * is. ICU reads the content up to its first null, so content holding one
+ * is converted as before.
+ */
+bool is_utf8_already(const char* data, std::size_t size,
+                     const std::string& encoding)
+{
+    return is_utf8(encoding) && std::memchr(data, '\0', size) == nullptr
+           && utf::is_valid_utf8(data, size);
+}
+}
+
 std::string analyzer::get_content(const corpus::document& doc)
 {
     if (doc.contains_content())
-        return utf::to_utf8(doc.content(), doc.encoding());
+    {
+        const auto& content = doc.content();
+        if (is_utf8_already(content.data(), content.size(), doc.encoding()))
+            return content;
+        return utf::to_utf8(content, doc.encoding());
+    }
 
     io::mmap_file file{doc.path()};
+    if (is_utf8_already(file.begin(), file.size(), doc.encoding()))
+        return {file.begin(), file.size()};
     return utf::to_utf8({file.begin(), file.size()}, doc.encoding());
 }
 
+void analyzer::set_content(token_stream& stream, const corpus::document& doc)
+{
+    if (doc.contains_content())
+    {
+        // valid utf-8 content is given to the stream without a copy
+        const auto& content = doc.content();
+        if (is_utf8_already(content.data(), content.size(), doc.encoding()))
+        {
+            stream.set_content(content);
+            return;
+        }
+    }
+    stream.set_content(get_content(doc));
+}
+
 io::parser analyzer::create_parser(const corpus::document& doc,
                                    const std::string& extension,
                                    const std::string& delims)
@@ -49,18 +107,23 @@ namespace
 {
 std::unique_ptr<token_stream>
     add_default_filters(std::unique_ptr<token_stream> tokenizer,
-                        const cpptoml::table& config)
+                        const cpptoml::table& config,
+                        bool drop_empty_sentences)
 {
     auto stopwords = config.get_as<std::string>("stop-words");
 
-    std::unique_ptr<token_stream> result;
-
-    result = make_unique<filters::lowercase_filter>(std::move(tokenizer));
-    result = make_unique<filters::alpha_filter>(std::move(result));
-    result = make_unique<filters::length_filter>(std::move(result), 2, 35);
-    result = make_unique<filters::list_filter>(std::move(result), *stopwords);
-    result = make_unique<filters::porter2_stemmer>(std::move(result));
-    return result;
+    // lowercase-alpha, length 2-35, stopwords, porter2, in one loop
+    filters::fused_chain::stages stages;
+    stages.lowercase_alpha = true;
+    stages.length = true;
+    stages.min_length = 2;
+    stages.max_length = 35;
+    stages.list = std::make_shared<const std::unordered_set<std::string>>(
+        filters::list_filter::read_list(*stopwords));
+    stages.stem = true;
+    stages.drop_empty_sentences = drop_empty_sentences;
+    return make_unique<filters::fused_chain>(std::move(tokenizer),
+                                             std::move(stages));
 }
 }
 
@@ -68,9 +131,7 @@ std::unique_ptr<token_stream>
     analyzer::default_filter_chain(const cpptoml::table& config)
 {
     auto tokenizer = make_unique<tokenizers::icu_tokenizer>();
-    auto result = add_default_filters(std::move(tokenizer), config);
-    result = make_unique<filters::empty_sentence_filter>(std::move(result));
-    return result;
+    return add_default_filters(std::move(tokenizer), config, true);
 }
 
 std::unique_ptr<token_stream>
@@ -78,7 +139,7 @@ std::unique_ptr<token_stream>
 {
     // suppress "<s>", "</s>"
     auto tokenizer = make_unique<tokenizers::icu_tokenizer>(true);
-    return add_default_filters(std::move(tokenizer), config);
+    return add_default_filters(std::move(tokenizer), config, false);
 }
 
 std::unique_ptr<token_stream>
@@ -110,9 +171,26 @@ std::unique_ptr<token_stream>
     auto filters = config.get_table_array("filter");
     if (!filters)
         throw analyzer_exception{"analyzer group missing filter configuration"};
+    // runs of filters that a fused_chain can stand for are compiled into
+    // one, which gives the same tokens
+    const auto& tables = filters->get();
     std::unique_ptr<token_stream> result;
-    for (const auto filter : filters->get())
-        result = load_filter(std::move(result), *filter);
+    for (uint64_t i = 0; i < tables.size();)
+    {
+        filters::fused_chain::stages stages;
+        uint64_t num_fused = 0;
+        if (result)
+            num_fused = filters::fused_chain::compile(tables, i, stages);
+        if (num_fused == 0)
+        {
+            result = load_filter(std::move(result), *tables[i]);
+            ++i;
+            continue;
+        }
+        result = make_unique<filters::fused_chain>(std::move(result),
+                                                   std::move(stages));
+        i += num_fused;
+    }
     return result;
 }
 
@@ -36,29 +36,46 @@ void alpha_filter::set_content(const std::string& content)
 
 std::string alpha_filter::next()
 {
-    auto tok = *token_;
+    auto tok = std::move(*token_);
     next_token();
     return tok;
 }
 
+void alpha_filter::next_into(std::string& token)
+{
+    token.swap(*token_);
+    next_token();
+}
+
 void alpha_filter::next_token()
 {
+    if (!token_)
+        token_ = std::string{};
+    auto& tok = *token_;
     while (*source_)
     {
-        auto tok = source_->next();
+        source_->next_into(tok);
         if (tok == "<s>" || tok == "</s>")
-        {
-            token_ = tok;
             return;
-        }
 
-        auto filt = utf::remove_if(tok, [](uint32_t codepoint)
-        { return !utf::isalpha(codepoint) && codepoint != '\''; });
-        if (!filt.empty())
+        // ASCII tokens are filtered in place
+        auto ascii = std::all_of(tok.begin(), tok.end(), [](char c)
+        { return static_cast<unsigned char>(c) < 0x80; });
+        if (ascii)
         {
-            token_ = filt;
-            return;
+            tok.erase(std::remove_if(tok.begin(), tok.end(), [](char c)
+            {
+                return !(c >= 'a' && c <= 'z') && !(c >= 'A' && c <= 'Z')
+                       && c != '\'';
+            }), tok.end());
         }
+        else
+        {
+            tok = utf::remove_if(tok, [](uint32_t codepoint)
+            { return !utf::isalpha(codepoint) && codepoint != '\''; });
+        }
+        if (!tok.empty())
+            return;
     }
     token_ = util::nullopt;
 }
@@ -40,30 +40,41 @@ void empty_sentence_filter::next_token()
 {
     if (second_ || !*source_)
     {
-        first_ = second_;
+        first_.swap(second_);
         second_ = util::nullopt;
         return;
     }
 
+    if (!first_)
+        first_ = std::string{};
     while (*source_)
     {
-        first_ = source_->next();
+        source_->next_into(*first_);
         if (!*source_ || *first_ != "<s>")
             return;
-        second_ = source_->next();
+        if (!second_)
+            second_ = std::string{};
+        source_->next_into(*second_);
         if (*second_ != "</s>")
             return;
-        first_ = second_ = util::nullopt;
+        second_ = util::nullopt;
     }
+    first_ = util::nullopt;
 }
 
 std::string empty_sentence_filter::next()
 {
-    auto tok = *first_;
+    auto tok = std::move(*first_);
     next_token();
     return tok;
 }
 
+void empty_sentence_filter::next_into(std::string& token)
+{
+    token.swap(*first_);
+    next_token();
+}
+
 empty_sentence_filter::operator bool() const
 {
     return static_cast<bool>(first_);
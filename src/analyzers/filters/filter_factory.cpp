@@ -15,6 +15,7 @@
 #include "analyzers/filters/icu_filter.h"
 #include "analyzers/filters/length_filter.h"
 #include "analyzers/filters/list_filter.h"
+#include "analyzers/filters/lowercase_alpha_filter.h"
 #include "analyzers/filters/lowercase_filter.h"
 #include "analyzers/filters/porter2_stemmer.h"
 #include "analyzers/filters/ptb_normalizer.h"
@@ -58,6 +59,7 @@ filter_factory::filter_factory()
     register_filter<filters::icu_filter>();
     register_filter<filters::length_filter>();
     register_filter<filters::list_filter>();
+    register_filter<filters::lowercase_alpha_filter>();
     register_filter<filters::lowercase_filter>();
     register_filter<filters::porter2_stemmer>();
     register_filter<filters::ptb_normalizer>();
@@ -0,0 +1,218 @@
+/**
+ * @file fused_chain.cpp
+ */
+
+#include "analyzers/filters/fused_chain.h"
+#include "analyzers/filters/lowercase_alpha_filter.h"
+#include "cpptoml.h"
+#include "porter2_stemmer.h"
+#include "utf/utf.h"
+
+namespace meta
+{
+namespace analyzers
+{
+namespace filters
+{
+
+fused_chain::fused_chain(std::unique_ptr<token_stream> source, stages stgs)
+    : source_{std::move(source)}, stages_(std::move(stgs))
+{
+    next_token();
+}
+
+fused_chain::fused_chain(const fused_chain& other)
+    : source_{other.source_->clone()},
+      stages_(other.stages_),
+      first_{other.first_},
+      second_{other.second_}
+{
+    // nothing
+}
+
+void fused_chain::set_content(const std::string& content)
+{
+    source_->set_content(content);
+    first_ = second_ = util::nullopt;
+    next_token();
+}
+
+std::string fused_chain::next()
+{
+    auto tok = std::move(*first_);
+    next_token();
+    return tok;
+}
+
+void fused_chain::next_into(std::string& token)
+{
+    token.swap(*first_);
+    next_token();
+}
+
+fused_chain::operator bool() const
+{
+    return static_cast<bool>(first_);
+}
+
+bool fused_chain::advance(std::string& token)
+{
+    while (*source_)
+    {
+        source_->next_into(token);
+        auto tag = token == "<s>" || token == "</s>";
+
+        if (stages_.lowercase_alpha && !tag)
+        {
+            lowercase_alpha_filter::fold(token);
+            if (token.empty())
+                continue;
+        }
+
+        if (stages_.length && !tag)
+        {
+            auto len = utf::length(token);
+            if (len < stages_.min_length || len > stages_.max_length)
+                continue;
+        }
+
+        if (stages_.list)
+        {
+            auto found = stages_.list->find(token) != stages_.list->end();
+            if (found == (stages_.list_method == list_filter::type::REJECT))
+                continue;
+        }
+
+        if (stages_.stem)
+        {
+            Porter2Stemmer::stem(token);
+            if (token.empty())
+                continue;
+        }
+        return true;
+    }
+    return false;
+}
+
+void fused_chain::next_token()
+{
+    if (!stages_.drop_empty_sentences)
+    {
+        if (!first_)
+            first_ = std::string{};
+        if (!advance(*first_))
+            first_ = util::nullopt;
+        return;
+    }
+
+    // as the empty_sentence_filter, holding on to the token after an
+    // opening "<s>" until it is known not to close the sentence
+    if (second_)
+    {
+        first_.swap(second_);
+        second_ = util::nullopt;
+        return;
+    }
+
+    if (!first_)
+        first_ = std::string{};
+    while (advance(*first_))
+    {
+        if (*first_ != "<s>")
+            return;
+        if (!second_)
+            second_ = std::string{};
+        if (!advance(*second_))
+        {
+            second_ = util::nullopt;
+            return;
+        }
+        if (*second_ != "</s>")
+            return;
+        second_ = util::nullopt;
+    }
+    first_ = util::nullopt;
+}
+
+namespace
+{
+/**
+ * @param filters The configuration of each filter of a chain
+ * @param pos The position of a filter
+ * @return the type of the filter at pos, or the empty string if there is
+ * none
+ */
+std::string
+    type_at(const std::vector<std::shared_ptr<cpptoml::table>>& filters,
+            uint64_t pos)
+{
+    if (pos >= filters.size())
+        return {};
+    auto type = filters[pos]->get_as<std::string>("type");
+    return type ? *type : std::string{};
+}
+}
+
+uint64_t fused_chain::compile(
+    const std::vector<std::shared_ptr<cpptoml::table>>& filters,
+    uint64_t first, stages& stgs)
+{
+    // any configuration the filters themselves would reject ends the
+    // fused part of the chain, so that the filter reports the error
+    auto pos = first;
+    if (type_at(filters, pos) == "lowercase"
+        && type_at(filters, pos + 1) == "alpha")
+    {
+        stgs.lowercase_alpha = true;
+        pos += 2;
+    }
+    else if (type_at(filters, pos) == "lowercase-alpha")
+    {
+        stgs.lowercase_alpha = true;
+        ++pos;
+    }
+
+    if (type_at(filters, pos) == "length")
+    {
+        auto min = filters[pos]->get_as<int64_t>("min");
+        auto max = filters[pos]->get_as<int64_t>("max");
+        if (!min || !max)
+            return pos - first;
+        stgs.length = true;
+        stgs.min_length = static_cast<uint64_t>(*min);
+        stgs.max_length = static_cast<uint64_t>(*max);
+        ++pos;
+    }
+
+    if (type_at(filters, pos) == "list")
+    {
+        auto method = filters[pos]->get_as<std::string>("method");
+        auto file = filters[pos]->get_as<std::string>("file");
+        if (!file || (method && *method != "accept" && *method != "reject"))
+            return pos - first;
+        if (method && *method == "accept")
+            stgs.list_method = list_filter::type::ACCEPT;
+        stgs.list = std::make_shared<const std::unordered_set<std::string>>(
+            list_filter::read_list(*file));
+        ++pos;
+    }
+
+    if (type_at(filters, pos) == "porter2-stemmer")
+    {
+        auto cache_size = filters[pos]->get_as<int64_t>("cache-size");
+        if (cache_size && *cache_size != 0)
+            return pos - first;
+        stgs.stem = true;
+        ++pos;
+    }
+
+    if (type_at(filters, pos) == "empty-sentence")
+    {
+        stgs.drop_empty_sentences = true;
+        ++pos;
+    }
+    return pos - first;
+}
+}
+}
+}
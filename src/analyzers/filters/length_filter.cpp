@@ -41,11 +41,17 @@ void length_filter::set_content(const std::string& content)
 
 std::string length_filter::next()
 {
-    auto tok = *token_;
+    auto tok = std::move(*token_);
     next_token();
     return tok;
 }
 
+void length_filter::next_into(std::string& token)
+{
+    token.swap(*token_);
+    next_token();
+}
+
 length_filter::operator bool() const
 {
     return token_ || *source_;
@@ -59,20 +65,17 @@ void length_filter::next_token()
         return;
     }
 
+    if (!token_)
+        token_ = std::string{};
+    auto& tok = *token_;
     while (*source_)
     {
-        auto tok = source_->next();
+        source_->next_into(tok);
         if (tok == "<s>" || tok == "</s>")
-        {
-            token_ = tok;
             return;
-        }
         auto len = utf::length(tok);
         if (len >= min_length_ && len <= max_length_)
-        {
-            token_ = tok;
             return;
-        }
     }
     token_ = util::nullopt;
 }
@@ -18,17 +18,23 @@ const std::string list_filter::id = "list";
 
 list_filter::list_filter(std::unique_ptr<token_stream> source,
                          const std::string& filename, type method)
-    : source_{std::move(source)}, method_{method}
+    : source_{std::move(source)}, list_{read_list(filename)}, method_{method}
+{
+    next_token();
+}
+
+std::unordered_set<std::string>
+    list_filter::read_list(const std::string& filename)
 {
     std::ifstream file{filename};
     if (!file)
         throw token_stream_exception{"invalid file for list filter"};
 
+    std::unordered_set<std::string> list;
     std::string line;
     while (std::getline(file, line))
-        list_.emplace(std::move(line));
-
-    next_token();
+        list.emplace(std::move(line));
+    return list;
 }
 
 list_filter::list_filter(const list_filter& other)
@@ -49,11 +55,17 @@ void list_filter::set_content(const std::string& content)
 
 std::string list_filter::next()
 {
-    auto tok = *token_;
+    auto tok = std::move(*token_);
     next_token();
     return tok;
 }
 
+void list_filter::next_into(std::string& token)
+{
+    token.swap(*token_);
+    next_token();
+}
+
 list_filter::operator bool() const
 {
     return token_ || *source_;
@@ -67,25 +79,22 @@ void list_filter::next_token()
         return;
     }
 
+    if (!token_)
+        token_ = std::string{};
+    auto& tok = *token_;
     while (*source_)
     {
-        auto tok = source_->next();
+        source_->next_into(tok);
         auto found = list_.find(tok) != list_.end();
         switch (method_)
         {
             case type::ACCEPT:
                 if (found)
-                {
-                    token_ = tok;
                     return;
-                }
                 break;
             case type::REJECT:
                 if (!found)
-                {
-                    token_ = tok;
                     return;
-                }
                 break;
             default:
                 throw token_stream_exception{"invalid method"};
@@ -0,0 +1,118 @@
+/**
+ * @file lowercase_alpha_filter.cpp
+ */
+
+#include <array>
+
+#include "analyzers/filters/lowercase_alpha_filter.h"
+#include "utf/utf.h"
+
+namespace meta
+{
+namespace analyzers
+{
+namespace filters
+{
+
+namespace
+{
+/**
+ * @return the table mapping each ASCII character to itself lowercased if
+ * the alpha_filter keeps it, or to '\0' if it removes it
+ */
+const std::array<char, 128>& ascii_table()
+{
+    static const std::array<char, 128> table = []()
+    {
+        std::array<char, 128> result{};
+        for (char c = 'a'; c <= 'z'; ++c)
+            result[c] = c;
+        for (char c = 'A'; c <= 'Z'; ++c)
+            result[c] = c + ('a' - 'A');
+        result['\''] = '\'';
+        return result;
+    }();
+    return table;
+}
+}
+
+const std::string lowercase_alpha_filter::id = "lowercase-alpha";
+
+lowercase_alpha_filter::lowercase_alpha_filter(
+    std::unique_ptr<token_stream> source)
+    : source_{std::move(source)}
+{
+    next_token();
+}
+
+lowercase_alpha_filter::lowercase_alpha_filter(
+    const lowercase_alpha_filter& other)
+    : source_{other.source_->clone()}, token_{other.token_}
+{
+    // nothing
+}
+
+void lowercase_alpha_filter::set_content(const std::string& content)
+{
+    source_->set_content(content);
+    next_token();
+}
+
+std::string lowercase_alpha_filter::next()
+{
+    auto tok = std::move(*token_);
+    next_token();
+    return tok;
+}
+
+void lowercase_alpha_filter::next_into(std::string& token)
+{
+    token.swap(*token_);
+    next_token();
+}
+
+void lowercase_alpha_filter::next_token()
+{
+    if (!token_)
+        token_ = std::string{};
+    auto& tok = *token_;
+    while (*source_)
+    {
+        source_->next_into(tok);
+        if (tok == "<s>" || tok == "</s>")
+            return;
+
+        fold(tok);
+        if (!tok.empty())
+            return;
+    }
+    token_ = util::nullopt;
+}
+
+void lowercase_alpha_filter::fold(std::string& token)
+{
+    if (utf::is_ascii(token))
+    {
+        const auto& table = ascii_table();
+        auto out = token.begin();
+        for (auto c : token)
+        {
+            if (auto folded = table[static_cast<unsigned char>(c)])
+                *out++ = folded;
+        }
+        token.erase(out, token.end());
+    }
+    else
+    {
+        token = utf::remove_if(utf::foldcase(token), [](uint32_t codepoint)
+        { return !utf::isalpha(codepoint) && codepoint != '\''; });
+    }
+}
+
+lowercase_alpha_filter::operator bool() const
+{
+    return static_cast<bool>(token_);
+}
+}
+}
+}
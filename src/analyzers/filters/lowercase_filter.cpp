@@ -36,8 +36,28 @@ void lowercase_filter::set_content(const std::string& content)
 
 std::string lowercase_filter::next()
 {
-    auto tok = source_->next();
-    return utf::foldcase(tok);
+    std::string tok;
+    next_into(tok);
+    return tok;
+}
+
+void lowercase_filter::next_into(std::string& token)
+{
+    source_->next_into(token);
+
+    // ASCII tokens fold to lowercase in place
+    auto ascii = std::all_of(token.begin(), token.end(), [](char c)
+    { return static_cast<unsigned char>(c) < 0x80; });
+    if (!ascii)
+    {
+        token = utf::foldcase(token);
+        return;
+    }
+    for (auto& c : token)
+    {
+        if (c >= 'A' && c <= 'Z')
+            c += 'a' - 'A';
+    }
 }
 
 lowercase_filter::operator bool() const
@@ -3,8 +3,10 @@
  * @author Chase Geigle
  */
 
+#include "cpptoml.h"
 #include "analyzers/filters/porter2_stemmer.h"
 #include "porter2_stemmer.h"
+#include "util/shim.h"
 
 namespace meta
 {
@@ -15,14 +17,17 @@ namespace filters
 
 const std::string porter2_stemmer::id = "porter2-stemmer";
 
-porter2_stemmer::porter2_stemmer(std::unique_ptr<token_stream> source)
-    : source_{std::move(source)}
+porter2_stemmer::porter2_stemmer(std::unique_ptr<token_stream> source,
+                                 uint64_t cache_size)
+    : source_{std::move(source)}, cache_size_{cache_size}
 {
     next_token();
 }
 
 porter2_stemmer::porter2_stemmer(const porter2_stemmer& other)
-    : source_{other.source_->clone()}, token_{other.token_}
+    : source_{other.source_->clone()},
+      token_{other.token_},
+      cache_size_{other.cache_size_}
 {
     // nothing
 }
@@ -35,30 +40,91 @@ void porter2_stemmer::set_content(const std::string& content)
 
 std::string porter2_stemmer::next()
 {
-    auto tok = *token_;
+    auto tok = std::move(*token_);
     next_token();
     return tok;
 }
 
+void porter2_stemmer::next_into(std::string& token)
+{
+    token.swap(*token_);
+    next_token();
+}
+
 void porter2_stemmer::next_token()
 {
+    if (!token_)
+        token_ = std::string{};
+    auto& tok = *token_;
     while (*source_)
     {
-        auto tok = source_->next();
-        Porter2Stemmer::stem(tok);
+        source_->next_into(tok);
+        stem(tok);
         if (!tok.empty())
-        {
-            token_ = tok;
             return;
-        }
     }
     token_ = util::nullopt;
 }
 
+void porter2_stemmer::stem(std::string& token)
+{
+    if (cache_size_ == 0)
+    {
+        Porter2Stemmer::stem(token);
+        return;
+    }
+
+    auto it = cache_.find(token);
+    if (it != cache_.end())
+    {
+        ++stats_.hits;
+        token.assign(it->second);
+        return;
+    }
+
+    ++stats_.misses;
+    if (cache_.size() >= cache_size_)
+    {
+        stats_.evictions += cache_.size();
+        cache_.clear();
+    }
+    auto& stemmed = cache_.emplace(token, std::string{}).first->second;
+    Porter2Stemmer::stem(token);
+    stemmed = token;
+    ++stats_.insertions;
+}
+
+uint64_t porter2_stemmer::cache_size() const
+{
+    return cache_size_;
+}
+
+caching::cache_stats porter2_stemmer::cache_stats() const
+{
+    auto stats = stats_;
+    stats.entries = cache_.size();
+    for (const auto& entry : cache_)
+        stats.bytes += entry.first.size() + entry.second.size();
+    return stats;
+}
+
 porter2_stemmer::operator bool() const
 {
     return static_cast<bool>(token_);
 }
+
+template <>
+std::unique_ptr<token_stream>
+    make_filter<porter2_stemmer>(std::unique_ptr<token_stream> src,
+                                 const cpptoml::table& config)
+{
+    auto cache_size = config.get_as<int64_t>("cache-size");
+    if (cache_size && *cache_size < 0)
+        throw token_stream::token_stream_exception{
+            "cache-size must not be negative for porter2-stemmer"};
+    return make_unique<porter2_stemmer>(
+        std::move(src), cache_size ? static_cast<uint64_t>(*cache_size) : 0);
+}
 }
 }
 }
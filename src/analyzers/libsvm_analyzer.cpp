@@ -3,8 +3,6 @@
  * @author Sean Massung
  */
 
-#include <sstream>
-
 #include "corpus/document.h"
 #include "io/libsvm_parser.h"
 #include "analyzers/libsvm_analyzer.h"
@@ -18,12 +16,16 @@ const std::string libsvm_analyzer::id = "libsvm";
 
 void libsvm_analyzer::tokenize(corpus::document& doc)
 {
-    for (auto& count_pair : io::libsvm_parser::counts(doc.content(), false))
+    const auto& content = doc.content();
+    auto first = content.data();
+    auto last = content.data() + content.size();
+    io::libsvm_parser::counts(first, last, counts_, false);
+    for (auto& count_pair : counts_)
         doc.increment(std::to_string(count_pair.first), count_pair.second);
 
     // label info is inside the document content for libsvm format; the line
     // corpus will not set it since it's not in a separate file
-    doc.label(io::libsvm_parser::label(doc.content()));
+    doc.label(io::libsvm_parser::label(first, last));
 }
 }
 }
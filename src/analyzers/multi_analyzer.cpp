@@ -26,5 +26,14 @@ void multi_analyzer::tokenize(corpus::document& doc)
     for (auto& tok : analyzers_)
         tok->tokenize(doc);
 }
+
+void multi_analyzer::tokenize_positions(corpus::document& doc,
+                                        position_map& positions)
+{
+    if (analyzers_.size() != 1)
+        throw analyzer_exception{
+            "term positions require exactly one analyzer"};
+    analyzers_.front()->tokenize_positions(doc, positions);
+}
 }
 }
@@ -3,6 +3,7 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
 #include <string>
 #include <vector>
 
@@ -16,37 +17,94 @@ namespace meta
 namespace analyzers
 {
 
+namespace
+{
+/**
+ * @param orders Some ngram orders
+ * @return the orders in increasing order, without duplicates
+ */
+std::vector<uint16_t> sorted_orders(std::vector<uint16_t> orders)
+{
+    if (orders.empty())
+        throw analyzer::analyzer_exception{
+            "ngram word analyzer needs at least one ngram size"};
+    std::sort(orders.begin(), orders.end());
+    orders.erase(std::unique(orders.begin(), orders.end()), orders.end());
+    return orders;
+}
+}
+
 const std::string ngram_word_analyzer::id = "ngram-word";
 
 ngram_word_analyzer::ngram_word_analyzer(uint16_t n,
                                          std::unique_ptr<token_stream> stream)
-    : base{n}, stream_{std::move(stream)}
+    : base{n}, orders_{n}, stream_{std::move(stream)}
+{
+    // nothing
+}
+
+ngram_word_analyzer::ngram_word_analyzer(std::vector<uint16_t> orders,
+                                         std::unique_ptr<token_stream> stream)
+    : base{orders.empty()
+               ? uint16_t{0}
+               : *std::max_element(orders.begin(), orders.end())},
+      orders_{sorted_orders(std::move(orders))},
+      stream_{std::move(stream)}
 {
     // nothing
 }
 
 ngram_word_analyzer::ngram_word_analyzer(const ngram_word_analyzer& other)
-    : base{other.n_value()}, stream_{other.stream_->clone()}
+    : base{other.n_value()},
+      orders_{other.orders_},
+      stream_{other.stream_->clone()}
 {
     // nothing
 }
 
 void ngram_word_analyzer::tokenize(corpus::document& doc)
 {
-    // first, get tokens
-    stream_->set_content(get_content(doc));
-    std::vector<std::string> tokens;
+    ngramify(doc, nullptr);
+}
+
+void ngram_word_analyzer::tokenize_positions(corpus::document& doc,
+                                             position_map& positions)
+{
+    ngramify(doc, &positions);
+}
+
+void ngram_word_analyzer::ngramify(corpus::document& doc,
+                                   position_map* positions)
+{
+    // first, join the tokens into one buffer, which the next document
+    // reuses
+    set_content(*stream_, doc);
+    text_.clear();
+    starts_.clear();
     while (*stream_)
-        tokens.push_back(stream_->next());
+    {
+        stream_->next_into(token_);
+        if (!starts_.empty())
+            text_ += '_';
+        starts_.push_back(text_.size());
+        text_ += token_;
+    }
 
-    // second, create ngrams from them
-    for (size_t i = n_value() - 1; i < tokens.size(); ++i)
+    // second, copy out each ngram of each order from the buffer in one
+    // piece; a term is only stored when it is first counted
+    auto num_tokens = starts_.size();
+    for (auto n : orders_)
     {
-        std::string combined = tokens[i];
-        for (size_t j = 1; j < n_value(); ++j)
-            combined = tokens[i - j] + "_" + combined;
+        for (size_t i = n - 1; i < num_tokens; ++i)
+        {
+            auto first = starts_[i - (n - 1)];
+            auto last = i + 1 < num_tokens ? starts_[i + 1] - 1 : text_.size();
+            ngram_.assign(text_, first, last - first);
 
-        doc.increment(combined, 1);
+            doc.increment(ngram_, 1);
+            if (positions)
+                (*positions)[ngram_].push_back(i - (n - 1));
+        }
     }
 }
 
@@ -55,13 +113,19 @@ std::unique_ptr<analyzer>
     make_analyzer<ngram_word_analyzer>(const cpptoml::table& global,
                                        const cpptoml::table& config)
 {
-    auto n_val = config.get_as<int64_t>("ngram");
-    if (!n_val)
+    auto filts = analyzer::load_filters(global, config);
+    if (auto n_val = config.get_as<int64_t>("ngram"))
+        return make_unique<ngram_word_analyzer>(*n_val, std::move(filts));
+
+    auto n_vals = config.get_array("ngram");
+    if (!n_vals)
         throw analyzer::analyzer_exception{
             "ngram size needed for ngram word analyzer in config file"};
-
-    auto filts = analyzer::load_filters(global, config);
-    return make_unique<ngram_word_analyzer>(*n_val, std::move(filts));
+    std::vector<uint16_t> orders;
+    for (const auto& n_val : n_vals->array_of<int64_t>())
+        orders.push_back(static_cast<uint16_t>(n_val->get()));
+    return make_unique<ngram_word_analyzer>(std::move(orders),
+                                            std::move(filts));
 }
 }
 }
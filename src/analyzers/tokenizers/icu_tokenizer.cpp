@@ -4,7 +4,7 @@
  */
 
 #include <algorithm>
-#include <deque>
+#include <vector>
 
 #include <unicode/utf.h>
 #include <unicode/uchar.h>
@@ -12,7 +12,9 @@
 #include "analyzers/tokenizers/icu_tokenizer.h"
 #include "cpptoml.h"
 #include "util/pimpl.tcc"
+#include "utf/ascii_segmenter.h"
 #include "utf/segmenter.h"
+#include "utf/utf.h"
 
 namespace meta
 {
@@ -29,23 +31,27 @@ const std::string icu_tokenizer::id = "icu-tokenizer";
 class icu_tokenizer::impl
 {
   public:
-    impl(bool suppress_tags) : suppress_tags_{suppress_tags}
+    impl(bool suppress_tags, bool ascii_fast_path)
+        : suppress_tags_{suppress_tags}, ascii_fast_path_{ascii_fast_path}
     {
         // nothing
     }
 
     explicit impl(utf::segmenter segmenter, bool suppress_tags)
-        : suppress_tags_{suppress_tags}, segmenter_{std::move(segmenter)}
+        : suppress_tags_{suppress_tags},
+          ascii_fast_path_{false},
+          segmenter_{std::move(segmenter)}
     {
         // nothing
     }
 
     /**
+     * Segments the content into sentences. Each sentence is only split
+     * into words once the tokens before it have been read, and each word
+     * is only copied out when it is the next token.
      * @param content The string content to set
-     * TODO: can we make this be a streaming API instead of buffering all
-     * of the tokens?
      */
-    void set_content(std::string content)
+    void set_content(const std::string& content)
     {
         auto pred = [](char c)
         {
@@ -54,30 +60,35 @@ class icu_tokenizer::impl
         // doing this because the sentence segmenter gets confused by
         // newlines appearing within a pargraph. Plus, we don't really care
         // about the kind of whitespace that was used for IR tasks.
-        std::replace_if(content.begin(), content.end(), pred, ' ');
-
-        segmenter_.set_content(content);
-        for (const auto& sentence : segmenter_.sentences())
+        ascii_ = ascii_fast_path_ && utf::is_ascii(content);
+        if (ascii_)
         {
-            if (!suppress_tags_)
-                tokens_.emplace_back("<s>");
-            for (const auto& word : segmenter_.words(sentence))
+            // ASCII content is segmented by the same rules without ICU
+            auto replaced = content;
+            std::replace_if(replaced.begin(), replaced.end(), pred, ' ');
+            ascii_segmenter_.set_content(std::move(replaced));
+            sentences_ = ascii_segmenter_.sentences();
+        }
+        else
+        {
+            if (std::any_of(content.begin(), content.end(), pred))
             {
-                auto wrd = segmenter_.content(word);
-                if (wrd.empty())
-                    continue;
-
-                // check first character, if it's whitespace skip it
-                UChar32 codepoint;
-                U8_GET_UNSAFE(wrd.c_str(), 0, codepoint);
-                if (u_isUWhiteSpace(codepoint))
-                    continue;
-
-                tokens_.emplace_back(std::move(wrd));
+                auto replaced = content;
+                std::replace_if(replaced.begin(), replaced.end(), pred, ' ');
+                segmenter_.set_content(std::move(replaced));
             }
-            if (!suppress_tags_)
-                tokens_.emplace_back("</s>");
+            else
+            {
+                segmenter_.set_content(content);
+            }
+            sentences_ = segmenter_.sentences();
         }
+
+        sentence_ = 0;
+        words_.clear();
+        word_ = 0;
+        in_sentence_ = false;
+        has_token_ = advance();
     }
 
     /**
@@ -87,31 +98,122 @@ class icu_tokenizer::impl
     {
         if (!*this)
             throw token_stream_exception{"next() called with no tokens left"};
-        auto result = tokens_.front();
-        tokens_.pop_front();
+        auto result = std::move(token_);
+        has_token_ = advance();
         return result;
     }
 
     /**
-     * True if tokens is not empty.
+     * @param token The buffer to move the next token into
+     */
+    void next_into(std::string& token)
+    {
+        if (!*this)
+            throw token_stream_exception{"next() called with no tokens left"};
+        token.swap(token_);
+        has_token_ = advance();
+    }
+
+    /**
+     * True if there is another token.
      */
     explicit operator bool() const
     {
-        return !tokens_.empty();
+        return has_token_;
     }
 
   private:
+    /**
+     * Finds the token after the current one and stores it in token_.
+     * @return whether there was one
+     */
+    bool advance()
+    {
+        while (true)
+        {
+            if (in_sentence_)
+            {
+                while (word_ < words_.size())
+                {
+                    if (ascii_)
+                        ascii_segmenter_.content(words_[word_++], token_);
+                    else
+                        segmenter_.content(words_[word_++], token_);
+                    if (token_.empty())
+                        continue;
+
+                    // check first character, if it's whitespace skip it
+                    UChar32 codepoint;
+                    U8_GET_UNSAFE(token_.c_str(), 0, codepoint);
+                    if (u_isUWhiteSpace(codepoint))
+                        continue;
+                    return true;
+                }
+                in_sentence_ = false;
+                if (!suppress_tags_)
+                {
+                    token_ = "</s>";
+                    return true;
+                }
+            }
+
+            if (sentence_ == sentences_.size())
+                return false;
+            const auto& sentence = sentences_[sentence_++];
+            if (ascii_)
+                ascii_segmenter_.words(sentence, words_);
+            else
+                segmenter_.words(sentence, words_);
+            word_ = 0;
+            in_sentence_ = true;
+            if (!suppress_tags_)
+            {
+                token_ = "<s>";
+                return true;
+            }
+        }
+    }
+
     /// Whether or not to suppress "<s>" or "</s>" generation
     const bool suppress_tags_;
 
+    /// Whether ASCII content is segmented without ICU
+    const bool ascii_fast_path_;
+
     /// UTF segmenter to use for this tokenizer
     utf::segmenter segmenter_;
 
-    /// Buffered tokens
-    std::deque<std::string> tokens_;
+    /// The segmenter for ASCII content
+    utf::ascii_segmenter ascii_segmenter_;
+
+    /// Whether the current content is segmented by ascii_segmenter_
+    bool ascii_ = false;
+
+    /// The sentences of the content
+    std::vector<utf::segmenter::segment> sentences_;
+
+    /// The sentence that is split into words next
+    uint64_t sentence_ = 0;
+
+    /// The words of the current sentence
+    std::vector<utf::segmenter::segment> words_;
+
+    /// The word of the current sentence that is read next
+    uint64_t word_ = 0;
+
+    /// Whether the current sentence's words (and closing tag) are still
+    /// being read
+    bool in_sentence_ = false;
+
+    /// The next token, if has_token_
+    std::string token_;
+
+    /// Whether there is another token
+    bool has_token_ = false;
 };
 
-icu_tokenizer::icu_tokenizer(bool suppress_tags) : impl_{suppress_tags}
+icu_tokenizer::icu_tokenizer(bool suppress_tags, bool ascii_fast_path)
+    : impl_{suppress_tags, ascii_fast_path}
 {
     // nothing
 }
@@ -141,6 +243,11 @@ std::string icu_tokenizer::next()
     return impl_->next();
 }
 
+void icu_tokenizer::next_into(std::string& token)
+{
+    impl_->next_into(token);
+}
+
 icu_tokenizer::operator bool() const
 {
     return static_cast<bool>(*impl_);
@@ -153,9 +260,12 @@ std::unique_ptr<token_stream>
     auto language = config.get_as<std::string>("language");
     auto country = config.get_as<std::string>("country");
     bool suppress_tags = false;
+    bool ascii_fast_path = true;
 
     if (auto stags = config.get_as<bool>("suppress-tags"))
         suppress_tags = *stags;
+    if (auto fast = config.get_as<bool>("ascii-fast-path"))
+        ascii_fast_path = *fast;
 
     using exception = token_stream::token_stream_exception;
 
@@ -172,7 +282,7 @@ std::unique_ptr<token_stream>
                                               suppress_tags);
     }
 
-    return make_unique<icu_tokenizer>(suppress_tags);
+    return make_unique<icu_tokenizer>(suppress_tags, ascii_fast_path);
 }
 }
 }
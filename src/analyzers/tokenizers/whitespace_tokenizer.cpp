@@ -30,25 +30,28 @@ void whitespace_tokenizer::set_content(const std::string& content)
 }
 
 std::string whitespace_tokenizer::next()
+{
+    std::string ret;
+    next_into(ret);
+    return ret;
+}
+
+void whitespace_tokenizer::next_into(std::string& token)
 {
     if (!*this)
         throw token_stream_exception{"next() called with no tokens left"};
 
-    std::string ret;
     // all whitespace chars are their own token
-    if (std::isspace(content_[idx_]))
-    {
-        ret.push_back(content_[idx_++]);
-    }
-    // otherwise, concatenate all non-whitespace chars together until we
-    // find a whitespace char
-    else
+    auto begin = idx_++;
+    // otherwise, the token is all non-whitespace chars until we find a
+    // whitespace char
+    if (!std::isspace(content_[begin]))
     {
         while (*this && !std::isspace(content_[idx_]))
-            ret.push_back(content_[idx_++]);
+            ++idx_;
     }
-    assert(!ret.empty());
-    return ret;
+    token.assign(content_, begin, idx_ - begin);
+    assert(!token.empty());
 }
 
 whitespace_tokenizer::operator bool() const
@@ -0,0 +1,54 @@
+/**
+ * @file benchmark.cpp
+ */
+
+#include <algorithm>
+#include <numeric>
+
+#include "bench/benchmark.h"
+
+namespace meta
+{
+namespace bench
+{
+
+runner::runner(std::ostream& out, const std::string& label,
+               uint64_t repetitions, const std::string& filter)
+    : out_(out),
+      label_{label},
+      repetitions_{std::max<uint64_t>(repetitions, 1)},
+      filter_{filter},
+      num_run_{0}
+{
+    // nothing
+}
+
+bool runner::selected(const std::string& name) const
+{
+    return name.find(filter_) != std::string::npos;
+}
+
+uint64_t runner::num_run() const
+{
+    return num_run_;
+}
+
+void runner::report(result& res)
+{
+    ++num_run_;
+    std::sort(res.times.begin(), res.times.end());
+    auto median = res.times[res.times.size() / 2];
+    auto mean = std::accumulate(res.times.begin(), res.times.end(), 0.0)
+                / res.times.size();
+    auto per_second = median == 0 ? 0.0 : res.items * 1e9 / median;
+
+    out_ << "{\"benchmark\":\"" << res.name << "\",\"label\":\"" << label_
+         << "\",\"repetitions\":" << res.times.size()
+         << ",\"items\":" << res.items << ",\"min_ns\":" << res.times.front()
+         << ",\"median_ns\":" << median << ",\"mean_ns\":"
+         << static_cast<uint64_t>(mean) << ",\"max_ns\":" << res.times.back()
+         << ",\"items_per_second\":" << static_cast<uint64_t>(per_second)
+         << "}" << std::endl;
+}
+}
+}
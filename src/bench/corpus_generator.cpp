@@ -0,0 +1,129 @@
+/**
+ * @file corpus_generator.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "bench/corpus_generator.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace bench
+{
+
+namespace
+{
+/// the share of a document's words drawn from its label's vocabulary
+const double label_share = 0.3;
+
+/**
+ * The splitmix64 generator. It is used instead of the standard
+ * distributions, whose results differ between standard libraries, so that
+ * the corpus is the same wherever it is generated.
+ * @param state The state of the generator
+ * @return the next random number
+ */
+uint64_t next_random(uint64_t& state)
+{
+    auto z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+/**
+ * @param state The state of the generator
+ * @return a random number in [0, 1)
+ */
+double next_uniform(uint64_t& state)
+{
+    return (next_random(state) >> 11) * (1.0 / (1ULL << 53));
+}
+}
+
+std::string word(uint64_t idx)
+{
+    // bijective base 26, so that every index has its own spelling
+    std::string spelling;
+    do
+    {
+        spelling.push_back(static_cast<char>('a' + idx % 26));
+        idx /= 26;
+    } while (idx-- > 0);
+    return spelling;
+}
+
+word_generator::word_generator(const corpus_options& opts)
+    : opts_(opts), state_{opts.seed}, cumulative_(opts.vocab_size)
+{
+    double sum = 0;
+    for (uint64_t rank = 0; rank < opts_.vocab_size; ++rank)
+    {
+        sum += 1.0 / (rank + 1);
+        cumulative_[rank] = sum;
+    }
+    for (auto& total : cumulative_)
+        total /= sum;
+}
+
+std::string word_generator::text(uint64_t label, uint64_t num_words)
+{
+    std::string text;
+    for (uint64_t i = 0; i < num_words; ++i)
+    {
+        auto it = std::upper_bound(cumulative_.begin(), cumulative_.end(),
+                                   next_uniform(state_));
+        auto rank = std::min<uint64_t>(it - cumulative_.begin(),
+                                       opts_.vocab_size - 1);
+        // the label's words are every num_labels-th word, offset by the
+        // label
+        if (next_uniform(state_) < label_share)
+            rank = (rank * opts_.num_labels + label) % opts_.vocab_size;
+        if (i > 0)
+            text.push_back(' ');
+        text += word(rank);
+    }
+    return text;
+}
+
+std::string generate_corpus(const std::string& prefix,
+                            const std::string& dataset,
+                            const corpus_options& opts)
+{
+    auto dir = prefix + "/" + dataset;
+    filesystem::make_directory(prefix);
+    filesystem::make_directory(dir);
+
+    word_generator gen{opts};
+    {
+        std::ofstream content{dir + "/" + dataset + ".dat"};
+        std::ofstream labels{dir + "/" + dataset + ".labels"};
+        for (uint64_t d = 0; d < opts.num_docs; ++d)
+        {
+            auto label = d % opts.num_labels;
+            content << gen.text(label, opts.doc_length) << '\n';
+            labels << "label" << label << '\n';
+        }
+    }
+
+    auto config = prefix + "/config.toml";
+    std::ofstream out{config};
+    out << "prefix = \"" << prefix << "\"\n"
+        << "dataset = \"" << dataset << "\"\n"
+        << "corpus-type = \"line-corpus\"\n"
+        << "forward-index = \"" << prefix << "/fwd\"\n"
+        << "inverted-index = \"" << prefix << "/inv\"\n"
+        << "\n[[analyzers]]\n"
+        << "method = \"ngram-word\"\n"
+        << "ngram = 1\n"
+        << "[[analyzers.filter]]\n"
+        << "type = \"icu-tokenizer\"\n"
+        << "[[analyzers.filter]]\n"
+        << "type = \"lowercase\"\n";
+    return config;
+}
+}
+}
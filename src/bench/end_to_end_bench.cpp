@@ -0,0 +1,165 @@
+/**
+ * @file end_to_end_bench.cpp
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <vector>
+
+#include "bench/end_to_end_bench.h"
+#include "classify/classifier/naive_bayes.h"
+#include "corpus/document.h"
+#include "cpptoml.h"
+#include "index/forward_index.h"
+#include "index/inverted_index.h"
+#include "index/make_index.h"
+#include "index/ranker/okapi_bm25.h"
+#include "parallel/parallel_for.h"
+#include "parallel/thread_pool.h"
+#include "topics/lda_cvb.h"
+#include "util/filesystem.h"
+#include "util/shim.h"
+
+namespace meta
+{
+namespace bench
+{
+
+namespace
+{
+/// the number of queries scored
+const uint64_t num_queries = 1000;
+/// the number of words in a query
+const uint64_t query_length = 3;
+/// the number of results asked for
+const uint64_t num_results = 10;
+/// the number of topics of the LDA model
+const uint64_t num_topics = 8;
+/// the number of iterations of the LDA model
+const uint64_t lda_iters = 5;
+
+void ranker_benchmarks(runner& run, std::shared_ptr<index::inverted_index> idx,
+                       const corpus_options& opts)
+{
+    if (!run.selected("ranker/"))
+        return;
+
+    // the queries come from the same distribution as the documents, from
+    // a generator seeded differently
+    auto query_opts = opts;
+    ++query_opts.seed;
+    word_generator gen{query_opts};
+    std::vector<std::string> queries;
+    for (uint64_t i = 0; i < num_queries; ++i)
+        queries.push_back(gen.text(i % opts.num_labels, query_length));
+
+    index::okapi_bm25 ranker;
+    // the documents are made anew on every run, so that every run also
+    // tokenizes its queries
+    run.run("ranker/score", num_queries, [&]()
+            {
+                uint64_t found = 0;
+                for (const auto& text : queries)
+                {
+                    corpus::document query;
+                    query.content(text);
+                    found += ranker.score(*idx, query, num_results).size();
+                }
+                keep(found);
+            });
+
+    parallel::thread_pool pool;
+    run.run("ranker/score_parallel", num_queries, [&]()
+            {
+                std::atomic<uint64_t> found{0};
+                parallel::parallel_for(
+                    queries.begin(), queries.end(), pool,
+                    [&](const std::string& text)
+                    {
+                        corpus::document query;
+                        query.content(text);
+                        found += ranker.score(*idx, query, num_results).size();
+                    });
+                keep(found.load());
+            });
+}
+
+void classify_benchmarks(runner& run,
+                         std::shared_ptr<index::forward_index> fwd)
+{
+    if (!run.selected("classify/"))
+        return;
+
+    auto docs = fwd->docs();
+    std::shuffle(docs.begin(), docs.end(), std::mt19937_64{47});
+    auto split = docs.size() / 5;
+    std::vector<doc_id> test_docs{docs.begin(), docs.begin() + split};
+    std::vector<doc_id> train_docs{docs.begin() + split, docs.end()};
+
+    run.run("classify/naive_bayes", docs.size(), [&]()
+            {
+                classify::naive_bayes nb{fwd};
+                nb.train(train_docs);
+                keep(nb.test(test_docs).accuracy());
+            });
+}
+
+void lda_benchmarks(runner& run, std::shared_ptr<index::forward_index> fwd,
+                    const corpus_options& opts)
+{
+    if (!run.selected("lda/"))
+        return;
+
+    std::unique_ptr<topics::lda_cvb> model;
+    run.run("lda/cvb", opts.num_docs * opts.doc_length * lda_iters, [&]()
+            {
+                model = make_unique<topics::lda_cvb>(fwd, num_topics, 0.1,
+                                                     0.1);
+            },
+            [&]()
+            {
+                model->run(lda_iters, 0);
+            });
+}
+}
+
+void end_to_end_benchmarks(runner& run, const std::string& config_file,
+                           const corpus_options& opts)
+{
+    auto config = cpptoml::parse_file(config_file);
+    auto inv_path = *config.get_as<std::string>("inverted-index");
+    auto fwd_path = *config.get_as<std::string>("forward-index");
+
+    // each run builds the index anew; the index of the last run is kept
+    // for the benchmarks that follow
+    run.run("index/build", opts.num_docs, [&]()
+            {
+                filesystem::remove_all(inv_path);
+            },
+            [&]()
+            {
+                index::make_index<index::inverted_index>(config_file);
+            });
+    run.run("index/build_forward", opts.num_docs, [&]()
+            {
+                filesystem::remove_all(fwd_path);
+            },
+            [&]()
+            {
+                index::make_index<index::forward_index>(config_file);
+            });
+
+    if (run.selected("ranker/"))
+        ranker_benchmarks(
+            run, index::make_index<index::inverted_index>(config_file), opts);
+
+    if (run.selected("classify/") || run.selected("lda/"))
+    {
+        auto fwd = index::make_index<index::forward_index>(config_file);
+        classify_benchmarks(run, fwd);
+        lda_benchmarks(run, fwd, opts);
+    }
+}
+}
+}
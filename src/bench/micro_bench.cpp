@@ -0,0 +1,249 @@
+/**
+ * @file micro_bench.cpp
+ */
+
+#include <algorithm>
+#include <future>
+#include <random>
+#include <vector>
+
+#include "analyzers/filters/lowercase_filter.h"
+#include "analyzers/filters/porter2_stemmer.h"
+#include "analyzers/tokenizers/icu_tokenizer.h"
+#include "bench/micro_bench.h"
+#include "index/vocabulary_map.h"
+#include "index/vocabulary_map_writer.h"
+#include "io/compressed_file_reader.h"
+#include "io/compressed_file_writer.h"
+#include "parallel/thread_pool.h"
+#include "util/filesystem.h"
+#include "util/shim.h"
+#include "util/sparse_ops.h"
+#include "util/sparse_vector.h"
+
+namespace meta
+{
+namespace bench
+{
+
+namespace
+{
+/// the number of values in the compressed file
+const uint64_t num_values = 1 << 22;
+/// the number of terms in the vocabulary_map
+const uint64_t num_terms = 1 << 18;
+/// the number of documents tokenized
+const uint64_t num_token_docs = 1000;
+/// the number of times each sparse vector operation is repeated
+const uint64_t sparse_rounds = 1000;
+/// the number of tasks given to the thread_pool
+const uint64_t num_tasks = 1 << 16;
+
+// the values are drawn straight from std::mt19937_64, whose output the
+// standard fixes, rather than through a distribution, whose output it
+// does not
+
+void compressed_benchmarks(runner& run, const std::string& prefix)
+{
+    if (!run.selected("compressed_file_reader/decode"))
+        return;
+
+    // mostly small numbers, as the gaps and counts of postings are
+    auto path = prefix + "/values.bin";
+    {
+        std::mt19937_64 gen{47};
+        io::default_compressed_file_writer out{path};
+        for (uint64_t i = 0; i < num_values; ++i)
+            out.write(gen() >> (44 + gen() % 20));
+    }
+
+    run.run("compressed_file_reader/decode", num_values, [&]()
+            {
+                io::default_compressed_file_reader in{path};
+                uint64_t sum = 0;
+                for (uint64_t i = 0; i < num_values; ++i)
+                    sum += in.next();
+                keep(sum);
+            });
+    filesystem::delete_file(path);
+}
+
+void vocabulary_map_benchmarks(runner& run, const std::string& prefix)
+{
+    if (!run.selected("vocabulary_map/find"))
+        return;
+
+    std::vector<std::string> terms;
+    terms.reserve(num_terms);
+    for (uint64_t i = 0; i < num_terms; ++i)
+        terms.push_back(word(i));
+    std::sort(terms.begin(), terms.end());
+
+    auto path = prefix + "/vocab.map";
+    {
+        index::vocabulary_map_writer writer{path};
+        for (const auto& term : terms)
+            writer.insert(term);
+    }
+    index::vocabulary_map vocab{path};
+
+    // one lookup in eight is of a word that is not in the map
+    std::vector<std::string> queries;
+    for (uint64_t i = 0; i < num_terms; ++i)
+        queries.push_back(i % 8 == 0 ? word(num_terms + i) : terms[i]);
+    std::shuffle(queries.begin(), queries.end(), std::mt19937_64{47});
+
+    run.run("vocabulary_map/find", queries.size(), [&]()
+            {
+                uint64_t found = 0;
+                for (const auto& query : queries)
+                    found += vocab.find(query) ? 1 : 0;
+                keep(found);
+            });
+    filesystem::delete_file(path);
+    filesystem::delete_file(path + ".inverse");
+}
+
+void tokenizer_benchmarks(runner& run, const corpus_options& opts)
+{
+    using namespace analyzers;
+    if (!run.selected("tokenize/"))
+        return;
+
+    word_generator gen{opts};
+    std::vector<std::string> docs;
+    for (uint64_t i = 0; i < num_token_docs; ++i)
+        docs.push_back(gen.text(i % opts.num_labels, opts.doc_length));
+    auto num_words = num_token_docs * opts.doc_length;
+
+    auto time_chain = [&](const std::string& name, token_stream& stream)
+    {
+        std::string token;
+        run.run(name, num_words, [&]()
+                {
+                    uint64_t num_tokens = 0;
+                    for (const auto& doc : docs)
+                    {
+                        stream.set_content(doc);
+                        while (stream)
+                        {
+                            stream.next_into(token);
+                            ++num_tokens;
+                        }
+                    }
+                    keep(num_tokens);
+                });
+    };
+
+    tokenizers::icu_tokenizer tok{true};
+    time_chain("tokenize/icu", tok);
+
+    filters::lowercase_filter lower{
+        make_unique<tokenizers::icu_tokenizer>(true)};
+    time_chain("tokenize/icu_lowercase", lower);
+
+    filters::porter2_stemmer stem{make_unique<filters::lowercase_filter>(
+        make_unique<tokenizers::icu_tokenizer>(true))};
+    time_chain("tokenize/icu_lowercase_porter2", stem);
+}
+
+void sparse_benchmarks(runner& run)
+{
+    using vector_type = util::sparse_vector<uint64_t, double>;
+    if (!run.selected("sparse/"))
+        return;
+
+    const uint64_t dimensions = 1 << 20;
+    std::mt19937_64 gen{47};
+    auto make_vector = [&](uint64_t nnz)
+    {
+        std::vector<uint64_t> indices;
+        for (uint64_t i = 0; i < nnz; ++i)
+            indices.push_back(gen() % dimensions);
+        std::sort(indices.begin(), indices.end());
+        indices.erase(std::unique(indices.begin(), indices.end()),
+                      indices.end());
+        vector_type vec;
+        for (const auto& idx : indices)
+            vec.emplace_back(idx, static_cast<double>(gen() % 16 + 1));
+        return vec;
+    };
+
+    auto similar_a = make_vector(5000);
+    auto similar_b = make_vector(5000);
+    run.run("sparse/dot", sparse_rounds * (similar_a.size() + similar_b.size()),
+            [&]()
+            {
+                double sum = 0;
+                for (uint64_t i = 0; i < sparse_rounds; ++i)
+                    sum += util::sparse::dot(similar_a, similar_b);
+                keep(sum);
+            });
+
+    auto short_vec = make_vector(100);
+    auto long_vec = make_vector(50000);
+    run.run("sparse/dot_skewed", sparse_rounds * short_vec.size(), [&]()
+            {
+                double sum = 0;
+                for (uint64_t i = 0; i < sparse_rounds; ++i)
+                    sum += util::sparse::dot(short_vec, long_vec);
+                keep(sum);
+            });
+
+    std::vector<double> dense(dimensions);
+    run.run("sparse/axpy", sparse_rounds * similar_a.size(), [&]()
+            {
+                for (uint64_t i = 0; i < sparse_rounds; ++i)
+                    util::sparse::axpy(0.5, similar_a, dense);
+                keep(dense[similar_a.begin()->first]);
+            });
+
+    run.run("sparse/merge", sparse_rounds * (similar_a.size() + similar_b.size()),
+            [&]()
+            {
+                vector_type out;
+                for (uint64_t i = 0; i < sparse_rounds; ++i)
+                {
+                    out.clear();
+                    util::sparse::merge(similar_a, similar_b, out);
+                }
+                keep(out.size());
+            });
+}
+
+void thread_pool_benchmarks(runner& run)
+{
+    if (!run.selected("thread_pool/submit"))
+        return;
+
+    parallel::thread_pool pool;
+    std::vector<std::future<uint64_t>> futures;
+    futures.reserve(num_tasks);
+    run.run("thread_pool/submit", num_tasks, [&]()
+            {
+                futures.clear();
+                for (uint64_t i = 0; i < num_tasks; ++i)
+                    futures.emplace_back(pool.submit_task([i]()
+                                                          {
+                                                              return i;
+                                                          }));
+                uint64_t sum = 0;
+                for (auto& fut : futures)
+                    sum += fut.get();
+                keep(sum);
+            });
+}
+}
+
+void micro_benchmarks(runner& run, const std::string& prefix,
+                      const corpus_options& opts)
+{
+    filesystem::make_directory(prefix);
+    compressed_benchmarks(run, prefix);
+    vocabulary_map_benchmarks(run, prefix);
+    tokenizer_benchmarks(run, opts);
+    sparse_benchmarks(run);
+    thread_pool_benchmarks(run);
+}
+}
+}
@@ -0,0 +1,108 @@
+/**
+ * @file meta-bench.cpp
+ */
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "bench/benchmark.h"
+#include "bench/corpus_generator.h"
+#include "bench/end_to_end_bench.h"
+#include "bench/micro_bench.h"
+#include "logging/logger.h"
+#include "util/filesystem.h"
+
+using namespace meta;
+
+/**
+ * Prints help for this executable.
+ * @param prog The name of the current executable
+ * @return the exit code for this program
+ */
+int print_usage(const std::string& prog)
+{
+    std::cerr << std::endl;
+    std::cerr << "Usage: " << prog << " [OPTION]..." << std::endl;
+    std::cerr << "Runs the benchmarks and writes one JSON object per "
+                 "benchmark, one per line" << std::endl;
+    std::cerr << "where [OPTION] is one or more of:" << std::endl;
+    std::cerr << "\t--filter TEXT\tonly run benchmarks whose names contain "
+                 "TEXT" << std::endl;
+    std::cerr << "\t--repetitions N\ttimed runs of each benchmark (default 5)"
+              << std::endl;
+    std::cerr << "\t--label TEXT\ta label for the results, such as the commit"
+              << std::endl;
+    std::cerr << "\t--output FILE\twrite the results to FILE instead of "
+                 "standard output" << std::endl;
+    std::cerr << "\t--docs N\tdocuments in the generated corpus (default "
+                 "10000)" << std::endl;
+    std::cerr << "\t--prefix DIR\tdirectory for generated files (default "
+                 "meta-bench-data)" << std::endl;
+    std::cerr << "\t--keep\tkeep the generated files" << std::endl;
+    std::cerr << std::endl;
+    return 1;
+}
+
+int main(int argc, char* argv[])
+{
+    std::string filter;
+    std::string label;
+    std::string output;
+    std::string prefix = "meta-bench-data";
+    uint64_t repetitions = 5;
+    bool keep_files = false;
+    bench::corpus_options opts;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--keep")
+        {
+            keep_files = true;
+            continue;
+        }
+        if (i + 1 == argc)
+            return print_usage(argv[0]);
+
+        std::string value = argv[++i];
+        if (arg == "--filter")
+            filter = value;
+        else if (arg == "--repetitions")
+            repetitions = std::stoull(value);
+        else if (arg == "--label")
+            label = value;
+        else if (arg == "--output")
+            output = value;
+        else if (arg == "--docs")
+            opts.num_docs = std::stoull(value);
+        else if (arg == "--prefix")
+            prefix = value;
+        else
+            return print_usage(argv[0]);
+    }
+
+    // progress and information go to standard error, so that they do not
+    // mix with results written to standard output
+    logging::set_cerr_logging(logging::logger::severity_level::warning);
+
+    std::ofstream file;
+    if (!output.empty())
+        file.open(output);
+    std::ostream& out = output.empty() ? std::cout : file;
+
+    bench::runner run{out, label, repetitions, filter};
+    bench::micro_benchmarks(run, prefix, opts);
+    auto config = bench::generate_corpus(prefix, "bench", opts);
+    bench::end_to_end_benchmarks(run, config, opts);
+
+    if (!keep_files)
+        filesystem::remove_all(prefix);
+
+    if (run.num_run() == 0)
+    {
+        std::cerr << "No benchmark matches \"" << filter << "\"" << std::endl;
+        return 1;
+    }
+    return 0;
+}
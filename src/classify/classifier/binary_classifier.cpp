@@ -14,7 +14,9 @@ binary_classifier::binary_classifier(std::shared_ptr<index::forward_index> idx,
                                      class_label positive, class_label negative)
     : classifier{std::move(idx)},
       positive_{std::move(positive)},
-      negative_{std::move(negative)}
+      negative_{std::move(negative)},
+      positive_id_{idx_->id(positive_)},
+      negative_id_{idx_->id(negative_)}
 {
     // nothing
 }
@@ -35,5 +37,20 @@ const class_label& binary_classifier::negative_label() const
     return negative_;
 }
 
+label_id binary_classifier::positive_id() const
+{
+    return positive_id_;
+}
+
+label_id binary_classifier::negative_id() const
+{
+    return negative_id_;
+}
+
+label_id binary_classifier::classify_id(doc_id d_id) const
+{
+    return predict(d_id) >= 0 ? positive_id_ : negative_id_;
+}
+
 }
 }
@@ -3,10 +3,12 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
 #include <random>
 #include <numeric>
 #include "logging/logger.h"
 #include "classify/classifier/classifier.h"
+#include "parallel/thread_pool.h"
 
 namespace meta
 {
@@ -19,18 +21,64 @@ classifier::classifier(std::shared_ptr<index::forward_index> idx)
     /* nothing */
 }
 
+std::vector<class_label>
+    classifier::classify_batch(const std::vector<doc_id>& docs,
+                               uint64_t num_threads)
+{
+    std::vector<class_label> labels(docs.size());
+    num_threads = std::max<uint64_t>(num_threads, 1);
+    auto block_size = (docs.size() + num_threads - 1) / num_threads;
+    if (block_size == 0)
+        return labels;
+
+    parallel::thread_pool pool{num_threads};
+    std::vector<std::future<void>> futures;
+    for (uint64_t first = 0; first < docs.size(); first += block_size)
+    {
+        auto last = std::min<uint64_t>(first + block_size, docs.size());
+        futures.emplace_back(pool.submit_task([&, first, last]()
+        {
+            for (auto i = first; i < last; ++i)
+                labels[i] = classify(docs[i]);
+        }));
+    }
+    for (auto& fut : futures)
+        fut.get();
+    return labels;
+}
+
 confusion_matrix classifier::test(const std::vector<doc_id>& docs)
 {
+    uint64_t num_threads = std::max(std::thread::hardware_concurrency(), 1u);
+    auto block_size = (docs.size() + num_threads - 1) / num_threads;
+
     confusion_matrix matrix;
-    for (auto& d_id : docs)
-        matrix.add(classify(d_id), idx_->label(d_id));
+    if (block_size == 0)
+        return matrix;
+
+    // each thread fills its own matrix, and they are summed at the end
+    parallel::thread_pool pool{num_threads};
+    std::vector<std::future<confusion_matrix>> futures;
+    for (uint64_t first = 0; first < docs.size(); first += block_size)
+    {
+        auto last = std::min<uint64_t>(first + block_size, docs.size());
+        futures.emplace_back(pool.submit_task([&, first, last]()
+        {
+            confusion_matrix local;
+            for (auto i = first; i < last; ++i)
+                local.add(classify(docs[i]), idx_->label(docs[i]));
+            return local;
+        }));
+    }
+    for (auto& fut : futures)
+        matrix += fut.get();
 
     return matrix;
 }
 
-confusion_matrix
-    classifier::cross_validate(const std::vector<doc_id>& input_docs, size_t k,
-                               bool even_split /* = false */, int seed)
+std::vector<doc_id>
+    classifier::fold_order(const std::vector<doc_id>& input_docs,
+                           bool even_split, int seed) const
 {
     // docs might be ordered by class, so make sure things are shuffled
     std::vector<doc_id> docs{input_docs};
@@ -38,6 +86,14 @@ confusion_matrix
         create_even_split(docs, seed);
     std::mt19937 gen(seed);
     std::shuffle(docs.begin(), docs.end(), gen);
+    return docs;
+}
+
+confusion_matrix
+    classifier::cross_validate(const std::vector<doc_id>& input_docs, size_t k,
+                               bool even_split /* = false */, int seed)
+{
+    auto docs = fold_order(input_docs, even_split, seed);
 
     confusion_matrix matrix;
     size_t step_size = docs.size() / k;
@@ -56,6 +112,48 @@ confusion_matrix
     return matrix;
 }
 
+confusion_matrix classifier::cross_validate(
+    const fold_factory& make_fold, const std::vector<doc_id>& input_docs,
+    size_t k, bool even_split /* = false */, int seed, uint64_t num_threads)
+{
+    confusion_matrix matrix;
+    if (k == 0)
+        return matrix;
+
+    // the first fold's classifier also chooses the documents
+    std::vector<std::unique_ptr<classifier>> classifiers(k);
+    classifiers[0] = make_fold(0);
+    auto docs = classifiers[0]->fold_order(input_docs, even_split, seed);
+    size_t step_size = docs.size() / k;
+
+    parallel::thread_pool pool{
+        std::max<uint64_t>(std::min<uint64_t>(num_threads, k), 1)};
+    std::vector<std::future<confusion_matrix>> futures;
+    for (size_t i = 0; i < k; ++i)
+    {
+        futures.emplace_back(pool.submit_task([&, i]()
+        {
+            auto& c = classifiers[i];
+            if (!c)
+                c = make_fold(i);
+
+            // the same documents as the sequential version's rotation
+            auto first = docs.begin() + i * step_size;
+            std::vector<doc_id> train_docs{first + step_size, docs.end()};
+            train_docs.insert(train_docs.end(), docs.begin(), first);
+            c->train(train_docs);
+            auto m = c->test(std::vector<doc_id>{first, first + step_size});
+            LOG(info) << "Finished fold " << (i + 1) << "/" << k << ENDLG;
+            c = nullptr;
+            return m;
+        }));
+    }
+    for (auto& fut : futures)
+        matrix += fut.get();
+
+    return matrix;
+}
+
 void classifier::create_even_split(std::vector<doc_id>& docs, int seed) const
 {
     LOG(info) << "Creating an even split of class labels" << ENDLG;
@@ -9,7 +9,6 @@
 #include "classify/kernel/all.h"
 #include "classify/classifier/dual_perceptron.h"
 #include "index/postings_data.h"
-#include "util/functional.h"
 #include "util/printing.h"
 #include "util/progress.h"
 #include "utf/utf.h"
@@ -23,9 +22,21 @@ const std::string dual_perceptron::id = "dual-perceptron";
 
 void dual_perceptron::train(const std::vector<doc_id>& docs)
 {
-    weights_ = {};
-    for (const auto& d_id : docs)
-        weights_[idx_->label(d_id)] = {};
+    reset();
+
+    // every training document is read once, into its own slot
+    auto matrix = idx_->materialize(docs);
+    std::vector<class_label> labels(matrix.rows());
+    offsets_.reserve(matrix.rows() + 1);
+    offsets_.push_back(0);
+    for (uint64_t r = 0; r < matrix.rows(); ++r)
+    {
+        for (const auto& count : matrix[r])
+            arena_.push_back(count);
+        offsets_.push_back(arena_.size());
+        labels[r] = idx_->label(matrix.doc(r));
+        weights_[labels[r]];
+    }
 
     std::vector<uint64_t> indices(docs.size());
     std::iota(begin(indices), end(indices), 0);
@@ -38,28 +49,30 @@ void dual_perceptron::train(const std::vector<doc_id>& docs)
         std::stringstream ss;
         ss << " > iteration " << iter << ": ";
         printing::progress progress{ss.str(), docs.size()};
-        uint64_t doc = 0;
+        uint64_t num_seen = 0;
         for (const auto& i : indices)
         {
-            progress(doc++);
-            auto guess = classify(docs[i]);
-            auto actual = idx_->label(docs[i]);
+            progress(num_seen++);
+            auto guess = classify(doc(i), i);
+            const auto& actual = labels[i];
             if (guess != actual)
             {
                 ++error_count;
-                decrease_weight(guess, docs[i]);
-                weights_[actual][docs[i]]++;
+                decrease_weight(guess, i);
+                weights_[actual][i]++;
             }
         }
         if (static_cast<double>(error_count) / docs.size() < gamma_)
             break;
     }
+
+    compact();
+    cache_.clear();
 }
 
-void dual_perceptron::decrease_weight(const class_label& label,
-                                      const doc_id& d_id)
+void dual_perceptron::decrease_weight(const class_label& label, uint64_t slot)
 {
-    auto it = weights_[label].find(d_id);
+    auto it = weights_[label].find(slot);
     if (it == weights_[label].end())
         return;
     --it->second;
@@ -67,9 +80,47 @@ void dual_perceptron::decrease_weight(const class_label& label,
         weights_[label].erase(it);
 }
 
+void dual_perceptron::compact()
+{
+    std::vector<uint64_t> new_slots(offsets_.size() - 1, no_slot);
+    std::vector<count_t> arena;
+    std::vector<uint64_t> offsets{0};
+    for (auto& w : weights_)
+    {
+        std::unordered_map<uint64_t, uint64_t> mistakes;
+        for (const auto& slot : w.second)
+        {
+            auto& new_slot = new_slots[slot.first];
+            if (new_slot == no_slot)
+            {
+                new_slot = offsets.size() - 1;
+                arena.insert(arena.end(), arena_.begin() + offsets_[slot.first],
+                             arena_.begin() + offsets_[slot.first + 1]);
+                offsets.push_back(arena.size());
+            }
+            mistakes[new_slot] = slot.second;
+        }
+        w.second = std::move(mistakes);
+    }
+    arena_ = std::move(arena);
+    offsets_ = std::move(offsets);
+}
+
+auto dual_perceptron::doc(uint64_t slot) const -> sparse_doc
+{
+    auto first = arena_.data();
+    return {first + offsets_[slot], first + offsets_[slot + 1]};
+}
+
 class_label dual_perceptron::classify(doc_id d_id)
 {
-    auto doc = idx_->search_primary(d_id);
+    auto pdata = idx_->search_primary(d_id);
+    const auto& counts = pdata->counts();
+    return classify({counts.data(), counts.data() + counts.size()}, no_slot);
+}
+
+class_label dual_perceptron::classify(const sparse_doc& doc, uint64_t slot)
+{
     class_label best_label = weights_.begin()->first;
     double best_dot = 0;
     for (const auto& w : weights_)
@@ -77,9 +128,28 @@ class_label dual_perceptron::classify(doc_id d_id)
         double dot = 0;
         for (const auto& mistakes : w.second)
         {
-            dot += mistakes.second
-                   * (kernel_(doc, idx_->search_primary(mistakes.first))
-                      + bias_);
+            double value;
+            if (slot == no_slot)
+            {
+                value = kernel_(doc, this->doc(mistakes.first));
+            }
+            else
+            {
+                // kernels are symmetric, so each pair has a single key
+                auto lo = std::min(slot, mistakes.first);
+                auto hi = std::max(slot, mistakes.first);
+                auto key = (lo << 32) | hi;
+                if (auto cached = cache_.find(key))
+                {
+                    value = *cached;
+                }
+                else
+                {
+                    value = kernel_(doc, this->doc(mistakes.first));
+                    cache_.insert(key, value);
+                }
+            }
+            dot += mistakes.second * (value + bias_);
         }
         dot *= alpha_;
         if (dot > best_dot)
@@ -94,6 +164,9 @@ class_label dual_perceptron::classify(doc_id d_id)
 void dual_perceptron::reset()
 {
     weights_ = {};
+    arena_.clear();
+    offsets_.clear();
+    cache_.clear();
 }
 
 template <>
@@ -117,15 +190,26 @@ std::unique_ptr<classifier>
     if (auto c_max_iter = config.get_as<int64_t>("max-iter"))
         max_iter = *c_max_iter;
 
+    auto cache_size = dual_perceptron::default_cache_size;
+    if (auto c_cache_size = config.get_as<int64_t>("kernel-cache-size"))
+    {
+        if (*c_cache_size <= 0)
+            throw classifier_factory::exception{
+                "kernel-cache-size must be positive for dual perceptron"};
+        cache_size = static_cast<uint64_t>(*c_cache_size);
+    }
+
     auto kernel = config.get_as<std::string>("kernel");
     if (!kernel)
         return make_unique<dual_perceptron>(
-            std::move(idx), kernel::polynomial{}, alpha, gamma, bias, max_iter);
+            std::move(idx), kernel::polynomial{}, alpha, gamma, bias, max_iter,
+            cache_size);
 
     auto kern = utf::tolower(*kernel);
     if (kern == "polynomial")
         return make_unique<dual_perceptron>(
-            std::move(idx), kernel::polynomial{}, alpha, gamma, bias, max_iter);
+            std::move(idx), kernel::polynomial{}, alpha, gamma, bias, max_iter,
+            cache_size);
 
     if (kern == "rbf")
     {
@@ -135,7 +219,8 @@ std::unique_ptr<classifier>
                 "rbf kernel requires rbf-gamma in configuration"};
         return make_unique<dual_perceptron>(std::move(idx),
                                             kernel::radial_basis{*rbf_gamma},
-                                            alpha, gamma, bias, max_iter);
+                                            alpha, gamma, bias, max_iter,
+                                            cache_size);
     }
 
     if (kern == "sigmoid")
@@ -152,7 +237,7 @@ std::unique_ptr<classifier>
 
         return make_unique<dual_perceptron>(
             std::move(idx), kernel::sigmoid{*sigmoid_alpha, *sigmoid_c}, alpha,
-            gamma, bias, max_iter);
+            gamma, bias, max_iter, cache_size);
     }
 
     throw classifier_factory::exception{
@@ -3,6 +3,7 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
 #include <vector>
 #include <unordered_map>
 
@@ -21,18 +22,26 @@ const std::string knn::id = "knn";
 
 knn::knn(std::shared_ptr<index::inverted_index> idx,
          std::shared_ptr<index::forward_index> f_idx, uint16_t k,
-         std::unique_ptr<index::ranker> ranker, bool weighted /* = false */)
+         std::unique_ptr<index::ranker> ranker, bool weighted /* = false */,
+         util::optional<index::hnsw_options> ann)
     : classifier{std::move(f_idx)},
       inv_idx_{std::move(idx)},
       k_{k},
       ranker_{std::move(ranker)},
-      weighted_{weighted}
+      weighted_{weighted},
+      ann_{std::move(ann)}
 { /* nothing */
 }
 
 void knn::train(const std::vector<doc_id>& docs)
 {
     legal_docs_.insert(docs.begin(), docs.end());
+    if (ann_)
+    {
+        std::vector<doc_id> training{legal_docs_.begin(), legal_docs_.end()};
+        std::sort(training.begin(), training.end());
+        hnsw_ = make_unique<index::hnsw_index>(*idx_, training, *ann_);
+    }
 }
 
 class_label knn::classify(doc_id d_id)
@@ -42,27 +51,38 @@ class_label knn::classify(doc_id d_id)
             "k must be smaller than the "
             "number of documents in the index (training documents)"};
 
-    corpus::document query{"[no path]", d_id};
-    for (const auto& count : idx_->search_primary(d_id)->counts())
-        query.increment(idx_->term_text(count.first), count.second);
-
-    auto scored = ranker_->score(*inv_idx_, query, inv_idx_->num_docs(),
-                                 [&](doc_id d_id)
-                                 {
-        return legal_docs_.find(d_id) != legal_docs_.end();
-    });
+    std::vector<std::pair<doc_id, double>> scored;
+    if (hnsw_)
+    {
+        // one more than k, as the votes below are counted
+        scored = hnsw_->neighbors(idx_->search_primary(d_id)->counts(),
+                                  k_ + 1u);
+    }
+    else
+    {
+        corpus::document query{"[no path]", d_id};
+        auto pdata = idx_->search_primary(d_id);
+        for (const auto& count : pdata->counts())
+            query.increment(idx_->term_text(count.first), count.second);
+
+        scored = ranker_->score(*inv_idx_, query, inv_idx_->num_docs(),
+                                [&](doc_id d_id)
+                                {
+            return legal_docs_.find(d_id) != legal_docs_.end();
+        });
+    }
 
-    std::unordered_map<class_label, double> counts;
+    std::unordered_map<label_id, double> counts;
     uint16_t i = 0;
     for (auto& s : scored)
     {
         // normally, weighted k-nn weights neighbors by 1/distance, but since
         // our scores are similarity scores, we weight by the similarity
         if (weighted_)
-            counts[idx_->label(s.first)] += s.second;
+            counts[idx_->lbl_id(s.first)] += s.second;
         // if not weighted, each neighbor gets an equal vote
         else
-            ++counts[idx_->label(s.first)];
+            ++counts[idx_->lbl_id(s.first)];
 
         if (++i > k_)
             break;
@@ -71,23 +91,23 @@ class_label knn::classify(doc_id d_id)
     if (counts.empty())
         throw knn_exception{"label counts were empty"};
 
-    using pair_t = std::pair<class_label, uint16_t>;
+    using pair_t = std::pair<label_id, uint16_t>;
     std::vector<pair_t> sorted{counts.begin(), counts.end()};
     std::sort(sorted.begin(), sorted.end(), [](const pair_t& a, const pair_t& b)
               {
         return a.second > b.second;
     });
 
-    return select_best_label(scored, sorted);
+    return idx_->class_label_from_id(select_best_label(scored, sorted));
 }
 
-class_label knn::select_best_label(
+label_id knn::select_best_label(
     const std::vector<std::pair<doc_id, double>>& scored,
-    const std::vector<std::pair<class_label, uint16_t>>& sorted) const
+    const std::vector<std::pair<label_id, uint16_t>>& sorted) const
 {
     uint16_t highest = sorted.begin()->second;
     auto it = sorted.begin();
-    std::unordered_set<class_label> best;
+    std::unordered_set<label_id> best;
     while (it != sorted.end() && it->second == highest)
     {
         best.insert(it->first);
@@ -103,7 +123,7 @@ class_label knn::select_best_label(
     // weighted
     for (auto& p : scored)
     {
-        class_label lbl{inv_idx_->label(p.first)};
+        auto lbl = idx_->lbl_id(p.first);
         auto f = best.find(lbl);
         if (f != best.end())
             return *f;
@@ -116,6 +136,7 @@ class_label knn::select_best_label(
 void knn::reset()
 {
     legal_docs_.clear();
+    hnsw_ = nullptr;
 }
 
 template <>
@@ -138,8 +159,26 @@ std::unique_ptr<classifier> make_multi_index_classifier<knn>(
     if (weighted)
         use_weighted = *weighted;
 
+    util::optional<index::hnsw_options> ann;
+    auto neighbors = config.get_as<std::string>("neighbors");
+    if (neighbors && *neighbors == "hnsw")
+    {
+        index::hnsw_options opts;
+        if (auto links = config.get_as<int64_t>("hnsw-links"))
+            opts.links = static_cast<uint64_t>(*links);
+        if (auto ef = config.get_as<int64_t>("hnsw-ef-construction"))
+            opts.ef_construction = static_cast<uint64_t>(*ef);
+        if (auto ef = config.get_as<int64_t>("hnsw-ef-search"))
+            opts.ef_search = static_cast<uint64_t>(*ef);
+        ann = opts;
+    }
+    else if (neighbors && *neighbors != "ranker")
+        throw classifier_factory::exception{
+            "knn neighbors must be \"ranker\" or \"hnsw\""};
+
     return make_unique<knn>(std::move(inv_idx), std::move(idx), *k,
-                            index::make_ranker(*ranker), use_weighted);
+                            index::make_ranker(*ranker), use_weighted,
+                            std::move(ann));
 }
 }
 }
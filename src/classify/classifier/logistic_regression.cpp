@@ -37,11 +37,13 @@ logistic_regression::logistic_regression(
 std::unordered_map<class_label, double>
     logistic_regression::predict(doc_id d_id)
 {
+    // the document is read once for all of the regressions
+    auto pdata = idx_->search_primary(d_id);
     std::unordered_map<class_label, double> probs;
     double denom = 0;
     for (auto& pair : classifiers_)
     {
-        auto prediction = std::exp(pair.second.predict(d_id));
+        auto prediction = std::exp(pair.second.predict(pdata->counts()));
         probs[pair.first] = prediction;
         denom += prediction;
     }
@@ -66,18 +68,31 @@ class_label logistic_regression::classify(doc_id d_id)
 
 void logistic_regression::train(const std::vector<doc_id>& docs)
 {
-    std::unordered_map<class_label, std::vector<doc_id>> docs_by_class;
-    for (const auto& d_id : docs)
-        docs_by_class[idx_->label(d_id)].emplace_back(d_id);
+    // every regression trains on the rows of its class and the pivot's
+    // in one copy of the training documents, decoded once
+    auto matrix = idx_->materialize(docs);
+    std::unordered_map<class_label, std::vector<uint64_t>> rows_by_class;
+    rows_by_class[pivot_];
+    for (const auto& pair : classifiers_)
+        rows_by_class[pair.first];
+    for (uint64_t r = 0; r < docs.size(); ++r)
+    {
+        auto it = rows_by_class.find(idx_->label(docs[r]));
+        if (it != rows_by_class.end())
+            it->second.push_back(r);
+    }
+
+    const auto& pivot_rows = rows_by_class.at(pivot_);
     using T = decltype(*classifiers_.begin());
     parallel::parallel_for(classifiers_.begin(), classifiers_.end(),
                            [&](T& pair)
                            {
-        auto train_docs = docs_by_class[pair.first];
-        auto pivot_docs = docs_by_class[pivot_];
-        train_docs.insert(train_docs.end(), pivot_docs.begin(),
-                          pivot_docs.end());
-        pair.second.train(train_docs);
+        auto rows = rows_by_class.at(pair.first);
+        std::vector<int> labels(docs.size(), -1);
+        for (const auto& r : rows)
+            labels[r] = 1;
+        rows.insert(rows.end(), pivot_rows.begin(), pivot_rows.end());
+        pair.second.train(matrix, rows, labels);
     });
 }
 
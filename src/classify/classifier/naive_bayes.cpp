@@ -4,6 +4,7 @@
  */
 
 #include <cassert>
+#include <cmath>
 #include <unordered_set>
 #include "cpptoml.h"
 #include "classify/classifier/naive_bayes.h"
@@ -19,14 +20,17 @@ const std::string naive_bayes::id = "naive-bayes";
 naive_bayes::naive_bayes(std::shared_ptr<index::forward_index> idx,
                          double alpha, double beta)
     : classifier{std::move(idx)},
-      class_probs_{stats::dirichlet<class_label>{beta, idx_->num_labels()}}
+      class_probs_{stats::dirichlet<label_id>{beta, idx_->num_labels()}}
 {
     stats::dirichlet<term_id> term_prior{alpha, idx_->unique_terms()};
-    auto lbls = idx_->class_labels();
+    std::vector<label_id> lbls;
+    for (const auto& lbl : idx_->class_labels())
+        lbls.push_back(idx_->id(lbl));
     std::sort(std::begin(lbls), std::end(lbls));
     term_probs_.reserve(lbls.size());
     for (const auto& lbl : lbls)
         term_probs_.emplace_back(lbl, term_prior);
+    finalize();
 }
 
 void naive_bayes::reset()
@@ -34,52 +38,78 @@ void naive_bayes::reset()
     for (auto& term_dist : term_probs_)
         term_dist.second.clear();
     class_probs_.clear();
+    finalize();
 }
 
 void naive_bayes::train(const std::vector<doc_id>& docs)
 {
-    for (auto& d_id : docs)
+    auto matrix = idx_->materialize(docs);
+    for (uint64_t r = 0; r < matrix.rows(); ++r)
     {
-        auto pdata = idx_->search_primary(d_id);
-        auto lbl = idx_->label(d_id);
-        for (auto& p : pdata->counts())
+        auto lbl = idx_->lbl_id(matrix.doc(r));
+        for (const auto& p : matrix[r])
         {
             term_probs_[lbl].increment(p.first, p.second);
             assert(term_probs_[lbl].probability(p.first) > 0);
         }
         class_probs_.increment(lbl, 1);
     }
+    finalize();
 }
 
-class_label naive_bayes::classify(doc_id d_id)
+void naive_bayes::finalize()
 {
-    class_label label;
-    double best = std::numeric_limits<double>::lowest();
+    auto num_classes = term_probs_.size();
+    auto num_terms = idx_->unique_terms();
+    log_term_probs_.resize(num_terms * num_classes);
+    log_class_probs_.resize(num_classes);
 
-    // calculate prob of test doc for each class
-    for (auto& cls : term_probs_)
+    uint64_t k = 0;
+    for (const auto& cls : term_probs_)
     {
-        const auto& lbl = cls.first;
-        const auto& term_dist = cls.second;
-
-        double sum = 0.0;
-        assert(class_probs_.probability(lbl) > 0);
-        sum += log(class_probs_.probability(lbl));
-        auto pdata = idx_->search_primary(d_id);
-        for (auto& t : pdata->counts())
+        assert(class_probs_.probability(cls.first) > 0);
+        log_class_probs_[k] = std::log(class_probs_.probability(cls.first));
+        for (uint64_t t = 0; t < num_terms; ++t)
         {
-            assert(term_dist.probability(t.first) > 0);
-            sum += t.second * log(term_dist.probability(t.first));
+            auto prob = cls.second.probability(term_id{t});
+            assert(prob > 0);
+            log_term_probs_[t * num_classes + k]
+                = static_cast<float>(std::log(prob));
         }
+        ++k;
+    }
+}
 
-        if (sum > best)
-        {
-            best = sum;
-            label = cls.first;
-        }
+template <class Row>
+label_id naive_bayes::best_label(const Row& doc) const
+{
+    auto num_classes = term_probs_.size();
+    std::vector<double> scores{log_class_probs_};
+    for (const auto& t : doc)
+    {
+        auto row = &log_term_probs_[t.first * num_classes];
+        for (uint64_t k = 0; k < num_classes; ++k)
+            scores[k] += t.second * row[k];
     }
 
-    return label;
+    auto best = std::max_element(scores.begin(), scores.end());
+    return term_probs_.begin()[best - scores.begin()].first;
+}
+
+class_label naive_bayes::classify(doc_id d_id)
+{
+    auto pdata = idx_->search_primary(d_id);
+    return idx_->class_label_from_id(best_label(pdata->counts()));
+}
+
+confusion_matrix naive_bayes::test(const std::vector<doc_id>& docs)
+{
+    confusion_matrix matrix;
+    auto rows = idx_->materialize(docs);
+    for (uint64_t r = 0; r < rows.rows(); ++r)
+        matrix.add(idx_->class_label_from_id(best_label(rows[r])),
+                   idx_->label(rows.doc(r)));
+    return matrix;
 }
 
 template <>
@@ -3,6 +3,8 @@
  * @author Sean Massung
  */
 
+#include <cmath>
+#include <limits>
 #include <vector>
 #include <unordered_map>
 
@@ -26,81 +28,101 @@ nearest_centroid::nearest_centroid(std::shared_ptr<index::inverted_index> idx,
 
 void nearest_centroid::train(const std::vector<doc_id>& docs)
 {
-    double num_docs = idx_->num_docs();
-    std::unordered_map<class_label, uint32_t> docs_per_class;
+    // the weights of the terms depend only on the index, so they are
+    // computed once, rather than for every term of every document
+    if (idf_.empty())
+    {
+        double num_docs = idx_->num_docs();
+        idf_.resize(idx_->unique_terms());
+        for (term_id t{0}; t < idf_.size(); ++t)
+        {
+            auto df = inv_idx_->doc_freq(t);
+            idf_[t] = df > 0 ? std::log(num_docs / df) : 0;
+        }
+    }
+
+    reset();
+    auto matrix = idx_->materialize(docs);
+    std::unordered_map<class_label, uint64_t> class_ids;
+    std::vector<uint64_t> labels(matrix.rows());
+    for (uint64_t r = 0; r < matrix.rows(); ++r)
+    {
+        auto label = idx_->label(matrix.doc(r));
+        auto it = class_ids.find(label);
+        if (it == class_ids.end())
+        {
+            it = class_ids.emplace(label, classes_.size()).first;
+            classes_.push_back(label);
+        }
+        labels[r] = it->second;
+    }
 
     // create document centroids based on averages of TF-IDF values
+    auto num_classes = classes_.size();
+    centroids_.assign(idf_.size() * num_classes, 0.0);
+    std::vector<uint64_t> docs_per_class(num_classes, 0);
+    for (uint64_t r = 0; r < matrix.rows(); ++r)
+    {
+        ++docs_per_class[labels[r]];
+        for (const auto& pair : matrix[r])
+            centroids_[pair.first * num_classes + labels[r]]
+                += pair.second * idf_[pair.first];
+    }
 
-    for (auto& id : docs)
+    norms_.assign(num_classes, 0.0);
+    for (uint64_t t = 0; t < idf_.size(); ++t)
     {
-        auto label = idx_->label(id);
-        ++docs_per_class[label];
-        for (auto& pair : idx_->search_primary(id)->counts())
+        for (uint64_t k = 0; k < num_classes; ++k)
         {
-            term_id tid = pair.first;
-            double count = pair.second;
-            double tfidf = count * std::log(num_docs / inv_idx_->doc_freq(tid));
-            centroids_[label][tid] += tfidf;
+            auto& weight = centroids_[t * num_classes + k];
+            weight /= docs_per_class[k];
+            norms_[k] += weight * weight;
         }
     }
-
-    for (auto& centroid : centroids_)
-        for (auto& term_pair : centroid.second)
-            term_pair.second /= docs_per_class[centroid.first];
+    for (auto& norm : norms_)
+        norm = std::sqrt(norm);
 }
 
 class_label nearest_centroid::classify(doc_id d_id)
 {
-    double best_score = std::numeric_limits<double>::lowest();
-    class_label best_label;
-
+    // one pass over the terms of the document accumulates its dot product
+    // with every centroid
+    auto num_classes = classes_.size();
+    std::vector<double> dots(num_classes, 0.0);
+    double doc_mag = 0.0;
     auto pdata = idx_->search_primary(d_id);
+    for (const auto& count : pdata->counts())
+    {
+        if (count.first >= idf_.size())
+            continue;
+        auto weight = count.second * idf_[count.first];
+        doc_mag += weight * weight;
+        auto row = &centroids_[count.first * num_classes];
+        for (uint64_t k = 0; k < num_classes; ++k)
+            dots[k] += weight * row[k];
+    }
+    doc_mag = std::sqrt(doc_mag);
 
-    // convert to TF-IDF representation
-    auto counts(pdata->counts());
-    double num_docs = idx_->num_docs();
-    for (auto& count : counts)
-        count.second *= std::log(num_docs / inv_idx_->doc_freq(count.first));
-
-    for (auto& centroid : centroids_)
+    double best_score = std::numeric_limits<double>::lowest();
+    class_label best_label;
+    for (uint64_t k = 0; k < num_classes; ++k)
     {
-        double score = cosine_sim(counts, centroid.second);
+        double score = dots[k] / (doc_mag * norms_[k]);
         if (score > best_score)
         {
             best_score = score;
-            best_label = centroid.first;
+            best_label = classes_[k];
         }
     }
 
     return best_label;
 }
 
-double nearest_centroid::cosine_sim(
-    const std::vector<std::pair<term_id, double>>& doc,
-    const std::unordered_map<term_id, double>& centroid)
-{
-    double centroid_mag = 0.0;
-    for (auto& pair : centroid)
-        centroid_mag += pair.second * pair.second;
-
-    double dot = 0.0;
-    double doc_mag = 0.0;
-    for (auto& count : doc)
-    {
-        doc_mag += count.second * count.second;
-        auto it = centroid.find(count.first);
-        if (it != centroid.end())
-            dot += it->second * count.second;
-    }
-
-    centroid_mag = std::sqrt(centroid_mag);
-    doc_mag = std::sqrt(doc_mag);
-    return dot / (doc_mag * centroid_mag);
-}
-
 void nearest_centroid::reset()
 {
+    classes_.clear();
     centroids_.clear();
+    norms_.clear();
 }
 
 template <>
@@ -18,15 +18,25 @@ const std::string one_vs_one::id = "one-vs-one";
 
 void one_vs_one::train(const std::vector<doc_id>& docs)
 {
-    std::unordered_map<class_label, std::vector<doc_id>> partitions;
+    // the documents are grouped by label id, so that no label strings
+    // are made, hashed or compared per document
+    std::unordered_map<label_id, std::vector<doc_id>> partitions;
     for (const auto& id : docs)
-        partitions[idx_->label(id)].emplace_back(id);
+        partitions[idx_->lbl_id(id)].emplace_back(id);
+
+    // partitions is shared by the threads below, so it is only searched
+    const std::vector<doc_id> none;
+    auto partition = [&](label_id lbl) -> const std::vector<doc_id> &
+    {
+        auto it = partitions.find(lbl);
+        return it == partitions.end() ? none : it->second;
+    };
 
     parallel::parallel_for(classifiers_.begin(), classifiers_.end(),
                            [&](const std::unique_ptr<binary_classifier>& p)
                            {
-        const auto& pos = partitions[p->positive_label()];
-        const auto& neg = partitions[p->negative_label()];
+        const auto& pos = partition(p->positive_id());
+        const auto& neg = partition(p->negative_id());
 
         std::vector<doc_id> examples;
         examples.reserve(pos.size() + neg.size());
@@ -40,25 +50,20 @@ void one_vs_one::train(const std::vector<doc_id>& docs)
 
 class_label one_vs_one::classify(doc_id d_id)
 {
-    std::unordered_map<class_label, int> votes;
-    std::mutex mut;
-
-    parallel::parallel_for(classifiers_.begin(), classifiers_.end(),
-                           [&](const std::unique_ptr<binary_classifier>& p)
-                           {
-        auto lbl = p->classify(d_id);
-        std::lock_guard<std::mutex> lock{mut};
-        votes[lbl]++;
-    });
+    // the documents of a batch are classified in parallel, so the votes
+    // for a single document are counted on the calling thread
+    std::unordered_map<label_id, int> votes;
+    for (const auto& p : classifiers_)
+        votes[p->classify_id(d_id)]++;
 
-    using count_type = std::pair<const class_label, int>;
+    using count_type = std::pair<const label_id, int>;
     auto iter
         = std::max_element(votes.begin(), votes.end(),
                            [](const count_type& lhs, const count_type& rhs)
                            {
             return lhs.second < rhs.second;
         });
-    return iter->first;
+    return idx_->class_label_from_id(iter->first);
 }
 
 void one_vs_one::reset()
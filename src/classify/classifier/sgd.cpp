@@ -3,12 +3,19 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <future>
+#include <limits>
 #include <numeric>
 #include <random>
 
 #include "classify/classifier/sgd.h"
 #include "classify/loss/loss_function_factory.h"
 #include "index/postings_data.h"
+#include "parallel/thread_pool.h"
+#include "util/sparse_ops.h"
 
 namespace meta
 {
@@ -17,47 +24,166 @@ namespace classify
 
 const std::string sgd::id = "sgd";
 
+namespace
+{
+/**
+ * @param z The FTRL-Proximal sum of a weight's adjusted gradients
+ * @param n The sum of the squares of the weight's gradients
+ * @param alpha The learning rate
+ * @param l1 The L1 regularization constant
+ * @param l2 The L2 regularization constant
+ * @return the weight
+ */
+double ftrl_weight(double z, double n, double alpha, double l1, double l2)
+{
+    if (std::abs(z) <= l1)
+        return 0;
+    // beta, the learning rate's offset for weights with few updates, is 1
+    auto shrunk = z > 0 ? z - l1 : z + l1;
+    return -shrunk / ((1 + std::sqrt(n)) / alpha + l2);
+}
+
+/**
+ * Applies proximal regularization steps to an AdaGrad weight.
+ * @param weight The weight
+ * @param rate The weight's learning rate
+ * @param l1 The L1 regularization constant
+ * @param l2 The L2 regularization constant
+ * @param steps The number of steps to apply
+ * @return the regularized weight
+ */
+double regularize(double weight, double rate, double l1, double l2,
+                  uint64_t steps)
+{
+    if (steps == 0)
+        return weight;
+    weight /= std::pow(1 + rate * l2, static_cast<double>(steps));
+    auto shrink = rate * l1 * steps;
+    if (std::abs(weight) <= shrink)
+        return 0;
+    return weight > 0 ? weight - shrink : weight + shrink;
+}
+}
+
+auto sgd::parse_update_rule(const std::string& name) -> update_rule
+{
+    if (name == "sgd")
+        return update_rule::standard;
+    if (name == "adagrad")
+        return update_rule::adagrad;
+    if (name == "ftrl")
+        return update_rule::ftrl;
+    throw binary_classifier_factory::exception{"unknown sgd update rule: "
+                                               + name};
+}
+
 sgd::sgd(const std::string& prefix, std::shared_ptr<index::forward_index> idx,
          class_label positive, class_label negative,
          std::unique_ptr<loss::loss_function> loss, double alpha, double gamma,
-         double bias, double lambda, size_t max_iter)
+         double bias, double lambda, size_t max_iter, size_t num_threads,
+         uint64_t num_features, selection_method selection, update_rule rule,
+         uint64_t batch_size, double l1)
     : binary_classifier{std::move(idx), positive, negative},
       weights_{prefix + "_" + std::to_string(idx_->id(positive)) + ".model",
-               idx_->unique_terms()},
+               num_features > 0
+                   ? std::min<uint64_t>(num_features, idx_->unique_terms())
+                   : idx_->unique_terms()},
       alpha_{alpha},
       gamma_{gamma},
       bias_{0},
       bias_weight_{bias},
       lambda_{lambda},
       max_iter_{max_iter},
-      loss_{std::move(loss)}
+      loss_{std::move(loss)},
+      num_threads_{num_threads == 0 ? 1 : num_threads},
+      num_features_{num_features},
+      selection_{selection},
+      rule_{rule},
+      batch_size_{batch_size == 0 ? 1 : batch_size},
+      l1_{l1}
 {
     reset();
 }
 
 double sgd::predict(doc_id d_id) const
 {
-    auto pdata = idx_->search_primary(d_id);
-    return predict(pdata->counts());
+    return predict(idx_->search_primary(d_id)->counts());
 }
 
 double sgd::predict(const counts_t& doc) const
 {
-    double dot = coeff_ * bias_ * bias_weight_;
-    for (const auto& count : doc)
-        dot += coeff_ * count.second * weights_[count.first];
-    return dot;
+    double dot = 0;
+    if (projection_)
+        dot = util::sparse::dot_dense(projection_->project(doc), weights_);
+    else if (num_features_ == 0) // otherwise no terms have been selected yet
+        dot = util::sparse::dot_dense(doc, weights_);
+    return coeff_ * (bias_ * bias_weight_ + dot);
+}
+
+double sgd::predict(const index::csr_matrix::row& doc) const
+{
+    return coeff_
+           * (bias_ * bias_weight_ + util::sparse::dot_dense(doc, weights_));
 }
 
 void sgd::train(const std::vector<doc_id>& docs)
 {
-    std::vector<size_t> indices(docs.size());
+    // every epoch reads the same documents, so they are decoded once
+    auto matrix = idx_->materialize(docs);
+    if (num_features_ > 0)
+    {
+        feature_selector selector{*idx_, docs};
+        projection_ = feature_projection{
+            selector.select(selection_, weights_.size()),
+            idx_->unique_terms()};
+        matrix = projection_->project(matrix);
+    }
+
+    std::vector<uint64_t> rows(docs.size());
     std::vector<int> labels(docs.size());
     for (size_t i = 0; i < docs.size(); ++i)
     {
-        indices[i] = i;
-        labels[i] = idx_->label(docs[i]) == positive_label() ? 1 : -1;
+        rows[i] = i;
+        labels[i] = idx_->lbl_id(docs[i]) == positive_id() ? 1 : -1;
+    }
+    train_rows(matrix, rows, labels);
+}
+
+void sgd::train(const index::csr_matrix& matrix,
+                const std::vector<uint64_t>& rows,
+                const std::vector<int>& labels)
+{
+    if (num_features_ > 0)
+    {
+        // the terms are selected by statistics read from the index
+        std::vector<doc_id> docs;
+        docs.reserve(rows.size());
+        for (const auto& r : rows)
+            docs.push_back(matrix.doc(r));
+        train(docs);
+        return;
+    }
+    train_rows(matrix, rows, labels);
+}
+
+void sgd::train_rows(const index::csr_matrix& matrix,
+                     const std::vector<uint64_t>& rows,
+                     const std::vector<int>& labels)
+{
+    if (rule_ != update_rule::standard || batch_size_ > 1)
+    {
+        train_batches(matrix, rows, labels);
+        return;
+    }
+    if (num_threads_ > 1)
+    {
+        train_parallel(matrix, rows, labels);
+        return;
     }
+
+    auto num_docs = rows.size();
+    auto indices = rows;
+
     std::random_device d;
     std::mt19937 g{d()};
     size_t t = 0;
@@ -71,17 +197,16 @@ void sgd::train(const std::vector<doc_id>& docs)
             t += 1;
 
             // check for convergence every 10th of the dataset
-            if (t % (docs.size() / 10) == 0)
+            if (t % (num_docs / 10) == 0)
             {
-                sum_loss /= docs.size() / 10;
+                sum_loss /= num_docs / 10;
                 if (std::abs(prev_sum_loss - sum_loss) < gamma_)
                     return;
                 prev_sum_loss = sum_loss;
                 sum_loss = 0;
             }
 
-            auto pdata = idx_->search_primary(docs[indices[i]]);
-            const counts_t& doc = pdata->counts();
+            auto doc = matrix[indices[i]];
 
             // get output prediction
             // this is the binary case where p is either +1 or -1
@@ -105,16 +230,296 @@ void sgd::train(const std::vector<doc_id>& docs)
             double update = -alpha_ * error_derivative / coeff_;
             if (update != 0)
             {
-                for (const auto& count : doc)
+                util::sparse::axpy(update, doc, weights_);
+                bias_ += update * bias_weight_;
+            }
+        }
+    }
+}
+
+void sgd::train_parallel(const index::csr_matrix& matrix,
+                         const std::vector<uint64_t>& rows,
+                         const std::vector<int>& labels)
+{
+    auto num_docs = rows.size();
+    if (num_docs == 0)
+        return;
+
+    auto indices = rows;
+    std::random_device d;
+    std::mt19937 g{d()};
+
+    parallel::thread_pool pool{num_threads_};
+    auto block_size = std::max<size_t>(num_docs / 10, 1);
+    double prev_sum_loss = std::numeric_limits<double>::max();
+    for (size_t iter = 0; iter < max_iter_; ++iter)
+    {
+        std::shuffle(indices.begin(), indices.end(), g);
+        for (size_t start = 0; start < num_docs; start += block_size)
+        {
+            auto end = std::min(start + block_size, num_docs);
+
+            // coeff_ and bias_ stay fixed while the threads run, and each
+            // thread returns its loss and the change to the bias
+            auto task = [&](size_t first, size_t last)
+            {
+                double sum_loss = 0;
+                double bias_update = 0;
+                for (size_t i = first; i < last; ++i)
                 {
-                    weights_[count.first] += update * count.second;
+                    auto doc = matrix[indices[i]];
+                    double prediction = predict(doc);
+                    int actual = labels[indices[i]];
+                    sum_loss += loss_->loss(prediction, actual);
+
+                    double update = -alpha_
+                                    * loss_->derivative(prediction, actual)
+                                    / coeff_;
+                    if (update != 0)
+                    {
+                        util::sparse::axpy(update, doc, weights_);
+                        bias_update += update * bias_weight_;
+                    }
                 }
-                bias_ += update * bias_weight_;
+                return std::make_pair(sum_loss, bias_update);
+            };
+
+            std::vector<std::future<std::pair<double, double>>> futures;
+            auto per_thread = (end - start + num_threads_ - 1) / num_threads_;
+            for (auto first = start; first < end; first += per_thread)
+                futures.emplace_back(pool.submit_task(
+                    std::bind(task, first, std::min(first + per_thread, end))));
+
+            double sum_loss = 0;
+            for (auto& fut : futures)
+            {
+                auto result = fut.get();
+                sum_loss += result.first;
+                bias_ += result.second;
+            }
+
+            // the regularization of every update of the block at once
+            coeff_ *= std::pow(1 - alpha_ * lambda_,
+                               static_cast<double>(end - start));
+            if (coeff_ < 1e-9)
+            {
+                bias_ *= coeff_;
+                for (auto& w : weights_)
+                    w *= coeff_;
+                coeff_ = 1;
+            }
+
+            // check for convergence after every full block
+            if (end - start == block_size)
+            {
+                sum_loss /= block_size;
+                if (std::abs(prev_sum_loss - sum_loss) < gamma_)
+                    return;
+                prev_sum_loss = sum_loss;
             }
         }
     }
 }
 
+void sgd::train_batches(const index::csr_matrix& matrix,
+                        const std::vector<uint64_t>& rows,
+                        const std::vector<int>& labels)
+{
+    auto num_docs = rows.size();
+    if (num_docs == 0)
+        return;
+
+    // the sums of the squares of the gradients, and the FTRL-Proximal
+    // sums of the adjusted gradients, of each weight and then the bias;
+    // and the last batch each AdaGrad weight was regularized in
+    auto num_weights = weights_.size();
+    std::vector<double> sq_grads;
+    std::vector<double> z;
+    std::vector<uint64_t> last;
+    if (rule_ != update_rule::standard)
+        sq_grads.assign(num_weights + 1, 0.0);
+    if (rule_ == update_rule::ftrl)
+        z.assign(num_weights + 1, 0.0);
+    if (rule_ == update_rule::adagrad)
+        last.assign(num_weights, 0);
+
+    // the gradient of a batch, and the weights it touches
+    std::vector<double> grad(num_weights, 0.0);
+    std::vector<bool> in_batch(num_weights, false);
+    std::vector<uint64_t> touched;
+
+    using partial = std::pair<double, std::vector<std::pair<uint64_t, double>>>;
+    auto indices = rows;
+
+    // each thread returns the loss of its part of a batch and the terms of
+    // its gradient, scaled by the derivative of the loss
+    auto task = [&](size_t first, size_t last_doc)
+    {
+        partial result{0.0, {}};
+        for (size_t i = first; i < last_doc; ++i)
+        {
+            auto doc = matrix[indices[i]];
+            double prediction = predict(doc);
+            int actual = labels[indices[i]];
+            result.first += loss_->loss(prediction, actual);
+
+            double derivative = loss_->derivative(prediction, actual);
+            if (derivative == 0)
+                continue;
+            for (const auto& count : doc)
+                result.second.emplace_back(count.first,
+                                           derivative * count.second);
+            result.second.emplace_back(num_weights,
+                                       derivative * bias_weight_);
+        }
+        return result;
+    };
+
+    std::random_device d;
+    std::mt19937 g{d()};
+    std::unique_ptr<parallel::thread_pool> pool;
+    if (num_threads_ > 1)
+        pool = make_unique<parallel::thread_pool>(num_threads_);
+
+    auto check_size = std::max<size_t>(num_docs / 10, 1);
+    size_t since_check = 0;
+    double sum_loss = 0;
+    double prev_sum_loss = std::numeric_limits<double>::max();
+    uint64_t step = 0;
+    bool converged = false;
+    for (size_t iter = 0; iter < max_iter_ && !converged; ++iter)
+    {
+        std::shuffle(indices.begin(), indices.end(), g);
+        for (size_t start = 0; start < num_docs && !converged;
+             start += batch_size_)
+        {
+            auto end = std::min<size_t>(start + batch_size_, num_docs);
+            std::vector<partial> partials;
+            if (!pool)
+            {
+                partials.push_back(task(start, end));
+            }
+            else
+            {
+                std::vector<std::future<partial>> futures;
+                auto per_thread
+                    = (end - start + num_threads_ - 1) / num_threads_;
+                for (auto first = start; first < end; first += per_thread)
+                    futures.emplace_back(pool->submit_task(std::bind(
+                        task, first, std::min(first + per_thread, end))));
+                for (auto& fut : futures)
+                    partials.push_back(fut.get());
+            }
+
+            double bias_grad = 0;
+            for (const auto& part : partials)
+            {
+                sum_loss += part.first;
+                for (const auto& term : part.second)
+                {
+                    if (term.first == num_weights)
+                    {
+                        bias_grad += term.second;
+                        continue;
+                    }
+                    if (!in_batch[term.first])
+                    {
+                        in_batch[term.first] = true;
+                        touched.push_back(term.first);
+                    }
+                    grad[term.first] += term.second;
+                }
+            }
+            ++step;
+
+            // the mean gradient of the batch
+            double scale = 1.0 / (end - start);
+            bias_grad *= scale;
+            if (rule_ == update_rule::standard)
+            {
+                coeff_ *= 1 - alpha_ * lambda_;
+                if (coeff_ < 1e-9)
+                {
+                    bias_ *= coeff_;
+                    for (auto& w : weights_)
+                        w *= coeff_;
+                    coeff_ = 1;
+                }
+                for (const auto& t : touched)
+                    weights_[t] -= alpha_ * grad[t] * scale / coeff_;
+                bias_ -= alpha_ * bias_grad / coeff_;
+            }
+            else if (rule_ == update_rule::adagrad)
+            {
+                for (const auto& t : touched)
+                {
+                    auto gt = grad[t] * scale;
+                    sq_grads[t] += gt * gt;
+                    auto rate = alpha_ / std::sqrt(sq_grads[t]);
+                    weights_[t] = regularize(weights_[t] - rate * gt, rate,
+                                             l1_, lambda_, step - last[t]);
+                    last[t] = step;
+                }
+                if (bias_grad != 0)
+                {
+                    sq_grads[num_weights] += bias_grad * bias_grad;
+                    bias_ -= alpha_ * bias_grad
+                             / std::sqrt(sq_grads[num_weights]);
+                }
+            }
+            else
+            {
+                auto update = [&](uint64_t t, double gt, double w, double l1,
+                                  double l2)
+                {
+                    auto n = sq_grads[t];
+                    auto sigma = (std::sqrt(n + gt * gt) - std::sqrt(n))
+                                 / alpha_;
+                    z[t] += gt - sigma * w;
+                    sq_grads[t] += gt * gt;
+                    return ftrl_weight(z[t], sq_grads[t], alpha_, l1, l2);
+                };
+                for (const auto& t : touched)
+                    weights_[t]
+                        = update(t, grad[t] * scale, weights_[t], l1_, lambda_);
+                if (bias_grad != 0)
+                    bias_ = update(num_weights, bias_grad, bias_, 0, 0);
+            }
+
+            for (const auto& t : touched)
+            {
+                grad[t] = 0;
+                in_batch[t] = false;
+            }
+            touched.clear();
+
+            // check for convergence every 10th of the dataset
+            since_check += end - start;
+            if (since_check >= check_size)
+            {
+                sum_loss /= since_check;
+                converged = std::abs(prev_sum_loss - sum_loss) < gamma_;
+                prev_sum_loss = sum_loss;
+                sum_loss = 0;
+                since_check = 0;
+            }
+        }
+    }
+
+    // the regularization of the batches each AdaGrad weight missed since
+    // its last update
+    if (rule_ == update_rule::adagrad)
+    {
+        for (uint64_t t = 0; t < num_weights; ++t)
+        {
+            if (sq_grads[t] > 0)
+                weights_[t] = regularize(weights_[t],
+                                         alpha_ / std::sqrt(sq_grads[t]),
+                                         l1_, lambda_, step - last[t]);
+        }
+    }
+}
+
 void sgd::reset()
 {
     for (auto& w : weights_)
@@ -159,9 +564,50 @@ std::unique_ptr<binary_classifier>
     if (auto c_max_iter = config.get_as<int64_t>("max-iter"))
         max_iter = *c_max_iter;
 
-    return make_unique<sgd>(
-        *prefix, std::move(idx), std::move(positive), std::move(negative),
-        loss::make_loss_function(*loss), alpha, gamma, bias, lambda, max_iter);
+    auto num_threads = sgd::default_num_threads;
+    if (auto c_threads = config.get_as<int64_t>("threads"))
+    {
+        if (*c_threads <= 0)
+            throw binary_classifier_factory::exception{
+                "threads must be positive for sgd"};
+        num_threads = static_cast<size_t>(*c_threads);
+    }
+
+    uint64_t num_features = 0;
+    if (auto c_features = config.get_as<int64_t>("features"))
+    {
+        if (*c_features <= 0)
+            throw binary_classifier_factory::exception{
+                "features must be positive for sgd"};
+        num_features = static_cast<uint64_t>(*c_features);
+    }
+
+    auto selection = selection_method::chi_square;
+    if (auto c_selection = config.get_as<std::string>("feature-selection"))
+        selection = parse_selection_method(*c_selection);
+
+    auto rule = sgd::update_rule::standard;
+    if (auto c_rule = config.get_as<std::string>("update"))
+        rule = sgd::parse_update_rule(*c_rule);
+
+    auto batch_size = sgd::default_batch_size;
+    if (auto c_batch_size = config.get_as<int64_t>("batch-size"))
+    {
+        if (*c_batch_size <= 0)
+            throw binary_classifier_factory::exception{
+                "batch-size must be positive for sgd"};
+        batch_size = static_cast<uint64_t>(*c_batch_size);
+    }
+
+    double l1 = 0;
+    if (auto c_l1 = config.get_as<double>("l1"))
+        l1 = *c_l1;
+
+    return make_unique<sgd>(*prefix, std::move(idx), std::move(positive),
+                            std::move(negative),
+                            loss::make_loss_function(*loss), alpha, gamma,
+                            bias, lambda, max_iter, num_threads, num_features,
+                            selection, rule, batch_size, l1);
 }
 }
 }
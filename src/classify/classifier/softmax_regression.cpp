@@ -0,0 +1,209 @@
+/**
+ * @file softmax_regression.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+
+#include "classify/classifier/softmax_regression.h"
+#include "index/postings_data.h"
+#include "util/functional.h"
+
+namespace meta
+{
+namespace classify
+{
+
+const std::string softmax_regression::id = "softmax-regression";
+
+softmax_regression::softmax_regression(
+    const std::string& prefix, std::shared_ptr<index::forward_index> idx,
+    double alpha, double gamma, double bias, double lambda, uint64_t max_iter)
+    : classifier{std::move(idx)},
+      classes_{idx_->class_labels()},
+      weights_{prefix + "_softmax.model",
+               (idx_->unique_terms() + 1) * std::max<uint64_t>(
+                                                idx_->class_labels().size(),
+                                                1)},
+      alpha_{alpha},
+      gamma_{gamma},
+      bias_weight_{bias},
+      lambda_{lambda},
+      max_iter_{max_iter}
+{
+    for (uint64_t k = 0; k < classes_.size(); ++k)
+        class_ids_[classes_[k]] = k;
+    reset();
+}
+
+template <class Row>
+void softmax_regression::probabilities(const Row& doc,
+                                       std::vector<double>& probs) const
+{
+    auto num_classes = classes_.size();
+    auto bias = idx_->unique_terms() * num_classes;
+    for (uint64_t k = 0; k < num_classes; ++k)
+        probs[k] = weights_[bias + k] * bias_weight_;
+
+    // each term adds its contiguous block of per-class weights
+    for (const auto& count : doc)
+    {
+        auto block = count.first * num_classes;
+        for (uint64_t k = 0; k < num_classes; ++k)
+            probs[k] += count.second * weights_[block + k];
+    }
+
+    auto max = *std::max_element(probs.begin(), probs.end()) * coeff_;
+    double denom = 0;
+    for (auto& p : probs)
+    {
+        p = std::exp(p * coeff_ - max);
+        denom += p;
+    }
+    for (auto& p : probs)
+        p /= denom;
+}
+
+std::unordered_map<class_label, double>
+    softmax_regression::predict(doc_id d_id) const
+{
+    std::vector<double> probs(classes_.size());
+    auto pdata = idx_->search_primary(d_id);
+    probabilities(pdata->counts(), probs);
+
+    std::unordered_map<class_label, double> result;
+    for (uint64_t k = 0; k < classes_.size(); ++k)
+        result[classes_[k]] = probs[k];
+    return result;
+}
+
+class_label softmax_regression::classify(doc_id d_id)
+{
+    using namespace functional;
+    auto probs = predict(d_id);
+    auto it = argmax(probs.begin(), probs.end(),
+                     [](const std::pair<class_label, double>& pair)
+                     {
+        return pair.second;
+    });
+    return it->first;
+}
+
+void softmax_regression::train(const std::vector<doc_id>& docs)
+{
+    if (docs.empty() || classes_.empty())
+        return;
+
+    // every epoch reads the same documents, so they are decoded once
+    auto matrix = idx_->materialize(docs);
+
+    std::vector<uint64_t> indices(docs.size());
+    std::vector<uint64_t> labels(docs.size());
+    std::iota(indices.begin(), indices.end(), 0);
+    for (uint64_t i = 0; i < docs.size(); ++i)
+        labels[i] = class_ids_.at(idx_->label(docs[i]));
+
+    auto num_classes = classes_.size();
+    auto bias = idx_->unique_terms() * num_classes;
+    std::vector<double> probs(num_classes);
+
+    std::random_device d;
+    std::mt19937 g{d()};
+    auto check = std::max<uint64_t>(docs.size() / 10, 1);
+    uint64_t t = 0;
+    double sum_loss = 0;
+    double prev_sum_loss = std::numeric_limits<double>::max();
+    for (uint64_t iter = 0; iter < max_iter_; ++iter)
+    {
+        std::shuffle(indices.begin(), indices.end(), g);
+        for (const auto& i : indices)
+        {
+            t += 1;
+
+            // check for convergence every 10th of the dataset
+            if (t % check == 0)
+            {
+                sum_loss /= check;
+                if (std::abs(prev_sum_loss - sum_loss) < gamma_)
+                    return;
+                prev_sum_loss = sum_loss;
+                sum_loss = 0;
+            }
+
+            auto doc = matrix[i];
+            probabilities(doc, probs);
+            sum_loss -= std::log(
+                std::max(probs[labels[i]],
+                         std::numeric_limits<double>::min()));
+
+            // the gradient of the cross-entropy for class k is
+            // p_k - 1[k == y], so every class is updated at once
+            probs[labels[i]] -= 1;
+
+            coeff_ *= (1 - alpha_ * lambda_);
+
+            // renormalize if the coefficient is too small
+            if (coeff_ < 1e-9)
+            {
+                for (auto& w : weights_)
+                    w *= coeff_;
+                coeff_ = 1;
+            }
+
+            auto scale = -alpha_ / coeff_;
+            for (const auto& count : doc)
+            {
+                auto block = count.first * num_classes;
+                for (uint64_t k = 0; k < num_classes; ++k)
+                    weights_[block + k] += scale * count.second * probs[k];
+            }
+            for (uint64_t k = 0; k < num_classes; ++k)
+                weights_[bias + k] += scale * bias_weight_ * probs[k];
+        }
+    }
+}
+
+void softmax_regression::reset()
+{
+    for (auto& w : weights_)
+        w = 0;
+    coeff_ = 1;
+}
+
+template <>
+std::unique_ptr<classifier> make_classifier<softmax_regression>(
+    const cpptoml::table& config, std::shared_ptr<index::forward_index> idx)
+{
+    auto prefix = config.get_as<std::string>("prefix");
+    if (!prefix)
+        throw classifier_factory::exception{
+            "prefix must be specified for softmax-regression in config"};
+
+    auto alpha = softmax_regression::default_alpha;
+    if (auto c_alpha = config.get_as<double>("alpha"))
+        alpha = *c_alpha;
+
+    auto gamma = softmax_regression::default_gamma;
+    if (auto c_gamma = config.get_as<double>("gamma"))
+        gamma = *c_gamma;
+
+    auto bias = softmax_regression::default_bias;
+    if (auto c_bias = config.get_as<double>("bias"))
+        bias = *c_bias;
+
+    auto lambda = softmax_regression::default_lambda;
+    if (auto c_lambda = config.get_as<double>("lambda"))
+        lambda = *c_lambda;
+
+    auto max_iter = softmax_regression::default_max_iter;
+    if (auto c_max_iter = config.get_as<int64_t>("max-iter"))
+        max_iter = *c_max_iter;
+
+    return make_unique<softmax_regression>(*prefix, std::move(idx), alpha,
+                                           gamma, bias, lambda, max_iter);
+}
+}
+}
@@ -3,8 +3,14 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
 #include <fstream>
+#include <iterator>
+#include <sstream>
 #include "classify/classifier/svm_wrapper.h"
+#include "index/postings_data.h"
 #include "utf/utf.h"
 
 namespace meta
@@ -24,87 +30,252 @@ decltype(svm_wrapper::options_) svm_wrapper::options_
 
 svm_wrapper::svm_wrapper(std::shared_ptr<index::forward_index> idx,
                          const std::string& svm_path,
-                         kernel kernel_opt /* = None */)
-    : classifier{std::move(idx)}, svm_path_{svm_path}, kernel_{kernel_opt}
+                         kernel kernel_opt /* = None */,
+                         const std::string& prefix /* = "svm" */)
+    : classifier{std::move(idx)},
+      svm_path_{svm_path},
+      prefix_{prefix},
+      kernel_{kernel_opt}
 {
     if (kernel_opt == kernel::None)
         executable_ = "liblinear/";
     else
         executable_ = "libsvm/svm-";
+    reset();
 }
 
 class_label svm_wrapper::classify(doc_id d_id)
 {
-    // create input for liblinear
-    std::ofstream out("svm-input");
-    out << idx_->liblinear_data(d_id);
-    out.close();
+    if (labels_.empty())
+        throw svm_wrapper_exception{"svm_wrapper has not been trained"};
 
-    // run liblinear/libsvm
-    std::string command = svm_path_ + executable_
-                          + "predict svm-input svm-train.model svm-predicted";
-    command += " > /dev/null 2>&1";
-    system(command.c_str());
+    auto pdata = idx_->search_primary(d_id);
+    auto k = kernel_ == kernel::None ? linear_class(pdata->counts())
+                                     : kernel_class(pdata->counts());
+    return idx_->class_label_from_id(label_id{labels_[k]});
+}
 
-    // extract answer
-    std::ifstream in("svm-predicted");
-    std::string str_val;
-    std::getline(in, str_val);
-    in.close();
+uint64_t svm_wrapper::linear_class(const counts_t& counts) const
+{
+    // liblinear's feature ids are one more than the term ids
+    std::vector<double> scores(num_weights_, 0.0);
+    auto num_features = weights_.size() / num_weights_ - (bias_ >= 0 ? 1 : 0);
+    for (const auto& count : counts)
+    {
+        if (count.first >= num_features)
+            continue;
+        auto row = &weights_[count.first * num_weights_];
+        for (uint64_t k = 0; k < num_weights_; ++k)
+            scores[k] += row[k] * count.second;
+    }
+    if (bias_ >= 0)
+    {
+        auto row = &weights_[num_features * num_weights_];
+        for (uint64_t k = 0; k < num_weights_; ++k)
+            scores[k] += row[k] * bias_;
+    }
 
-    label_id label{static_cast<uint32_t>(std::stoul(str_val))};
-    return idx_->class_label_from_id(label);
+    if (labels_.size() == 2)
+        return scores[0] > 0 ? 0 : 1;
+    return std::max_element(scores.begin(), scores.end()) - scores.begin();
 }
 
-confusion_matrix svm_wrapper::test(const std::vector<doc_id>& docs)
+uint64_t svm_wrapper::kernel_class(const counts_t& counts) const
 {
-    // create input for liblinear/libsvm
-    std::ofstream out("svm-input");
-    for (auto& d_id : docs)
-        out << idx_->liblinear_data(d_id) << "\n";
-    out.close();
+    std::vector<double> values;
+    values.reserve(support_vectors_.size());
+    for (const auto& sv : support_vectors_)
+        values.push_back(kernel_value(counts, sv));
 
-    // run liblinear/libsvm
-    std::string command = svm_path_ + executable_
-                          + "predict svm-input svm-train.model svm-predicted";
-    command += " > /dev/null 2>&1";
-    system(command.c_str());
+    std::vector<uint64_t> start(labels_.size(), 0);
+    for (uint64_t i = 1; i < labels_.size(); ++i)
+        start[i] = start[i - 1] + num_svs_[i - 1];
 
-    // extract answer
-    confusion_matrix matrix;
-    std::ifstream in("svm-predicted");
-    std::string str_val;
-    for (auto& d_id : docs)
+    // each pair of classes votes for one of them, as libsvm does
+    std::vector<uint64_t> votes(labels_.size(), 0);
+    uint64_t pair = 0;
+    for (uint64_t i = 0; i < labels_.size(); ++i)
     {
-        // we can assume that the number of lines in the file is equal to the
-        // number of testing documents
-        std::getline(in, str_val);
-        uint32_t value = std::stoul(str_val);
-        class_label predicted = idx_->class_label_from_id(label_id{value});
-        class_label actual = idx_->label(d_id);
-        matrix.add(predicted, actual);
+        for (uint64_t j = i + 1; j < labels_.size(); ++j)
+        {
+            double sum = -rho_[pair++];
+            for (uint64_t s = start[i]; s < start[i] + num_svs_[i]; ++s)
+                sum += coefficients_[j - 1][s] * values[s];
+            for (uint64_t s = start[j]; s < start[j] + num_svs_[j]; ++s)
+                sum += coefficients_[i][s] * values[s];
+            ++votes[sum > 0 ? i : j];
+        }
     }
-    in.close();
+    return std::max_element(votes.begin(), votes.end()) - votes.begin();
+}
 
-    return matrix;
+double svm_wrapper::kernel_value(const counts_t& counts,
+                                 const counts_t& sv) const
+{
+    double dot = 0;
+    double dist = 0;
+    uint64_t i = 0;
+    uint64_t j = 0;
+    while (i < counts.size() || j < sv.size())
+    {
+        if (j == sv.size()
+            || (i < counts.size() && counts[i].first < sv[j].first))
+        {
+            dist += counts[i].second * counts[i].second;
+            ++i;
+        }
+        else if (i == counts.size() || sv[j].first < counts[i].first)
+        {
+            dist += sv[j].second * sv[j].second;
+            ++j;
+        }
+        else
+        {
+            dot += counts[i].second * sv[j].second;
+            auto diff = counts[i++].second - sv[j++].second;
+            dist += diff * diff;
+        }
+    }
+
+    switch (kernel_)
+    {
+        case kernel::RBF:
+            return std::exp(-gamma_ * dist);
+        case kernel::Sigmoid:
+            return std::tanh(gamma_ * dot + coef0_);
+        default:
+            return std::pow(gamma_ * dot + coef0_, degree_);
+    }
 }
 
 void svm_wrapper::train(const std::vector<doc_id>& docs)
 {
-    std::ofstream out("svm-train");
+    auto train_file = prefix_ + "-train";
+    auto model_file = train_file + ".model";
+    std::ofstream out{train_file};
     for (auto& d_id : docs)
         out << idx_->liblinear_data(d_id) << "\n";
     out.close();
 
+    // a model left from an earlier run must not be mistaken for this one's
+    std::remove(model_file.c_str());
     std::string command = svm_path_ + executable_ + "train "
-                          + options_.at(kernel_) + " svm-train";
+                          + options_.at(kernel_) + " " + train_file + " "
+                          + model_file;
     command += " > /dev/null 2>&1";
     system(command.c_str());
+
+    load_model(model_file);
+}
+
+void svm_wrapper::load_model(const std::string& filename)
+{
+    reset();
+    std::ifstream in{filename};
+    if (!in)
+        throw svm_wrapper_exception{"could not read model file " + filename};
+
+    // the header lines of both models are a key followed by its values
+    std::string solver;
+    uint64_t num_classes = 0;
+    uint64_t num_features = 0;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields{line};
+        std::string key;
+        fields >> key;
+        if (key == "w" || key == "SV")
+            break;
+
+        if (key == "solver_type")
+            fields >> solver;
+        else if (key == "nr_class")
+            fields >> num_classes;
+        else if (key == "nr_feature")
+            fields >> num_features;
+        else if (key == "bias")
+            fields >> bias_;
+        else if (key == "gamma")
+            fields >> gamma_;
+        else if (key == "coef0")
+            fields >> coef0_;
+        else if (key == "degree")
+            fields >> degree_;
+        else if (key == "label")
+            labels_.assign(std::istream_iterator<uint32_t>{fields}, {});
+        else if (key == "rho")
+            rho_.assign(std::istream_iterator<double>{fields}, {});
+        else if (key == "nr_sv")
+            num_svs_.assign(std::istream_iterator<uint64_t>{fields}, {});
+    }
+
+    if (num_classes == 0 || labels_.size() != num_classes)
+        throw svm_wrapper_exception{"malformed model file " + filename};
+
+    if (kernel_ == kernel::None)
+    {
+        num_weights_
+            = num_classes == 2 && solver != "MCSVM_CS" ? 1 : num_classes;
+        weights_.resize((num_features + (bias_ >= 0 ? 1 : 0)) * num_weights_);
+        for (auto& weight : weights_)
+        {
+            if (!(in >> weight))
+                throw svm_wrapper_exception{"malformed model file "
+                                            + filename};
+        }
+        return;
+    }
+
+    // each support vector is its coefficients followed by its features
+    coefficients_.resize(num_classes - 1);
+    while (std::getline(in, line))
+    {
+        std::istringstream fields{line};
+        double coefficient;
+        for (auto& row : coefficients_)
+        {
+            if (!(fields >> coefficient))
+                break;
+            row.push_back(coefficient);
+        }
+        if (!fields)
+            continue;
+
+        counts_t sv;
+        std::string feature;
+        while (fields >> feature)
+        {
+            auto colon = feature.find(':');
+            sv.emplace_back(term_id{std::stoul(feature.substr(0, colon)) - 1},
+                            std::stod(feature.substr(colon + 1)));
+        }
+        std::sort(sv.begin(), sv.end());
+        support_vectors_.push_back(std::move(sv));
+    }
+
+    uint64_t total = 0;
+    for (const auto& num : num_svs_)
+        total += num;
+    if (rho_.size() != num_classes * (num_classes - 1) / 2
+        || num_svs_.size() != num_classes || total != support_vectors_.size()
+        || coefficients_.front().size() != total)
+        throw svm_wrapper_exception{"malformed model file " + filename};
 }
 
 void svm_wrapper::reset()
 {
-    // nothing
+    labels_.clear();
+    weights_.clear();
+    num_weights_ = 1;
+    bias_ = -1;
+    support_vectors_.clear();
+    coefficients_.clear();
+    rho_.clear();
+    num_svs_.clear();
+    gamma_ = 0;
+    coef0_ = 0;
+    degree_ = 3;
 }
 
 template <>
@@ -117,34 +288,25 @@ std::unique_ptr<classifier>
         throw classifier_factory::exception{
             "path to libsvm modules must be present in config for svm wrapper"};
 
+    auto k_type = svm_wrapper::kernel::None;
     if (auto kernel = config.get_as<std::string>("kernel"))
     {
-        auto k_type = utf::tolower(*kernel);
-        if (k_type == "none")
-            return make_unique<svm_wrapper>(std::move(idx), *path);
-
-        if (k_type == "quadratic")
-            return make_unique<svm_wrapper>(std::move(idx), *path,
-                                            svm_wrapper::kernel::Quadratic);
-
-        if (k_type == "cubic")
-            return make_unique<svm_wrapper>(std::move(idx), *path,
-                                            svm_wrapper::kernel::Cubic);
-
-        if (k_type == "quartic")
-            return make_unique<svm_wrapper>(std::move(idx), *path,
-                                            svm_wrapper::kernel::Quartic);
-
-        if (k_type == "rbf")
-            return make_unique<svm_wrapper>(std::move(idx), *path,
-                                            svm_wrapper::kernel::RBF);
-
-        if (k_type == "sigmoid")
-            return make_unique<svm_wrapper>(std::move(idx), *path,
-                                            svm_wrapper::kernel::Sigmoid);
+        auto name = utf::tolower(*kernel);
+        if (name == "quadratic")
+            k_type = svm_wrapper::kernel::Quadratic;
+        else if (name == "cubic")
+            k_type = svm_wrapper::kernel::Cubic;
+        else if (name == "quartic")
+            k_type = svm_wrapper::kernel::Quartic;
+        else if (name == "rbf")
+            k_type = svm_wrapper::kernel::RBF;
+        else if (name == "sigmoid")
+            k_type = svm_wrapper::kernel::Sigmoid;
     }
 
-    return make_unique<svm_wrapper>(std::move(idx), *path);
+    auto prefix = config.get_as<std::string>("prefix");
+    return make_unique<svm_wrapper>(std::move(idx), *path, k_type,
+                                    prefix ? *prefix : "svm");
 }
 }
 }
@@ -4,6 +4,7 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
 #include <numeric>
 #include <random>
 #include "cpptoml.h"
@@ -24,26 +25,60 @@ winnow::winnow(std::shared_ptr<index::forward_index> idx, double m,
     /* nothing */
 }
 
-double winnow::get_weight(const class_label& label, const term_id& term) const
+template <class Row>
+uint64_t winnow::best_class(const Row& doc) const
 {
-    auto weight_it = weights_.find(label);
-    if (weight_it == weights_.end())
-        return 1;
-    auto term_it = weight_it->second.find(term);
-    if (term_it == weight_it->second.end())
-        return 1;
-    return term_it->second;
+    auto num_classes = classes_.size();
+    std::vector<double> dots(num_classes,
+                             static_cast<double>(num_classes / 2)); // bias
+
+    // each term adds its contiguous block of per-class weights
+    for (const auto& count : doc)
+    {
+        auto block = count.first * num_classes;
+        for (uint64_t k = 0; k < num_classes; ++k)
+            dots[k] += count.second * weights_[block + k];
+    }
+
+    uint64_t best = 0;
+    double best_dot = 0;
+    for (uint64_t k = 0; k < num_classes; ++k)
+    {
+        if (dots[k] > best_dot)
+        {
+            best_dot = dots[k];
+            best = k;
+        }
+    }
+    return best;
 }
 
 void winnow::zero_weights(const std::vector<doc_id>& docs)
 {
+    classes_.clear();
+    class_ids_.clear();
     for (const auto& d_id : docs)
-        weights_[idx_->label(d_id)] = {};
+    {
+        auto label = idx_->label(d_id);
+        if (class_ids_.emplace(label, classes_.size()).second)
+            classes_.push_back(label);
+    }
+    weights_.assign(idx_->unique_terms() * classes_.size(), 1.0);
 }
 
 void winnow::train(const std::vector<doc_id>& docs)
 {
     zero_weights(docs);
+    if (docs.empty())
+        return;
+
+    // every iteration reads the same documents, so they are decoded once
+    auto matrix = idx_->materialize(docs);
+    auto num_classes = classes_.size();
+    std::vector<uint64_t> labels(docs.size());
+    for (uint64_t i = 0; i < docs.size(); ++i)
+        labels[i] = class_ids_.at(idx_->label(docs[i]));
+
     std::vector<uint64_t> indices(docs.size());
     std::iota(indices.begin(), indices.end(), 0);
     std::random_device d;
@@ -53,21 +88,19 @@ void winnow::train(const std::vector<doc_id>& docs)
     {
         std::shuffle(indices.begin(), indices.end(), g);
         double error_count = 0;
-        for (size_t i = 0; i < indices.size(); ++i)
+        for (const auto& i : indices)
         {
-            const doc_id doc{docs[indices[i]]};
-            class_label guess = classify(doc);
-            class_label actual = idx_->label(doc);
+            auto doc = matrix[i];
+            auto guess = best_class(doc);
+            auto actual = labels[i];
             if (guess != actual)
             {
                 error_count += 1;
-                auto pdata = idx_->search_primary(doc);
-                for (const auto& count : pdata->counts())
+                for (const auto& count : doc)
                 {
-                    double guess_weight = get_weight(guess, count.first);
-                    weights_[guess][count.first] = guess_weight / m_;
-                    double actual_weight = get_weight(actual, count.first);
-                    weights_[actual][count.first] = actual_weight * m_;
+                    auto block = count.first * num_classes;
+                    weights_[block + guess] /= m_;
+                    weights_[block + actual] *= m_;
                 }
             }
         }
@@ -78,27 +111,15 @@ void winnow::train(const std::vector<doc_id>& docs)
 
 class_label winnow::classify(doc_id d_id)
 {
-    class_label best_label = weights_.begin()->first;
-    double best_dot = 0;
-    for (const auto& w : weights_)
-    {
-        double dot = weights_.size() / 2; // bias term
-        auto pdata = idx_->search_primary(d_id);
-        for (const auto& count : pdata->counts())
-            dot += count.second * get_weight(w.first, count.first);
-
-        if (dot > best_dot)
-        {
-            best_dot = dot;
-            best_label = w.first;
-        }
-    }
-    return best_label;
+    auto pdata = idx_->search_primary(d_id);
+    return classes_[best_class(pdata->counts())];
 }
 
 void winnow::reset()
 {
-    weights_ = {};
+    classes_.clear();
+    class_ids_.clear();
+    weights_.clear();
 }
 
 template <>
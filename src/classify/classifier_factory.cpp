@@ -39,6 +39,7 @@ classifier_factory::classifier_factory()
     reg<winnow>();
     reg<dual_perceptron>();
     reg<logistic_regression>();
+    reg<softmax_regression>();
 
     // built-in multi-index classifiers
     reg_mi<knn>();
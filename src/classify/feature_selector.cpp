@@ -0,0 +1,239 @@
+/** @file feature_selector.cpp */
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+#include "classify/feature_selector.h"
+#include "index/forward_index.h"
+#include "index/postings_data.h"
+#include "parallel/thread_pool.h"
+
+namespace meta
+{
+namespace classify
+{
+
+namespace
+{
+/**
+ * @param p A probability
+ * @return \f$p \log p\f$, which is 0 when p is
+ */
+double plogp(double p)
+{
+    return p > 0 ? p * std::log(p) : 0;
+}
+}
+
+selection_method parse_selection_method(const std::string& name)
+{
+    if (name == "chi-square")
+        return selection_method::chi_square;
+    if (name == "info-gain")
+        return selection_method::information_gain;
+    if (name == "doc-freq")
+        return selection_method::doc_freq;
+    throw feature_selector::feature_selector_exception{
+        "unknown feature selection method: " + name};
+}
+
+feature_selector::feature_selector(const index::forward_index& idx,
+                                   const std::vector<doc_id>& docs,
+                                   uint64_t num_threads)
+    : num_docs_{docs.size()}, term_docs_(idx.unique_terms(), 0)
+{
+    std::unordered_map<label_id, uint64_t> class_ids;
+    std::vector<uint64_t> classes(docs.size());
+    for (uint64_t i = 0; i < docs.size(); ++i)
+    {
+        auto it = class_ids.emplace(idx.lbl_id(docs[i]), class_ids.size());
+        classes[i] = it.first->second;
+    }
+    auto num_classes = class_ids.size();
+    class_docs_.assign(num_classes, 0);
+    for (const auto& k : classes)
+        ++class_docs_[k];
+
+    // each thread counts a block of the documents into its own table
+    num_threads = std::max<uint64_t>(num_threads, 1);
+    auto block_size = (docs.size() + num_threads - 1) / num_threads;
+    counts_.assign(term_docs_.size() * num_classes, 0);
+    if (block_size == 0)
+        return;
+
+    parallel::thread_pool pool{num_threads};
+    std::vector<std::future<std::vector<uint32_t>>> futures;
+    for (uint64_t first = 0; first < docs.size(); first += block_size)
+    {
+        auto last = std::min<uint64_t>(first + block_size, docs.size());
+        futures.emplace_back(pool.submit_task([&, first, last]()
+        {
+            std::vector<uint32_t> counts(counts_.size(), 0);
+            for (auto i = first; i < last; ++i)
+            {
+                auto pdata = idx.search_primary(docs[i]);
+                for (const auto& count : pdata->counts())
+                    ++counts[count.first * num_classes + classes[i]];
+            }
+            return counts;
+        }));
+    }
+    for (auto& fut : futures)
+    {
+        auto counts = fut.get();
+        for (uint64_t i = 0; i < counts.size(); ++i)
+            counts_[i] += counts[i];
+    }
+
+    for (uint64_t t = 0; t < term_docs_.size(); ++t)
+    {
+        for (uint64_t k = 0; k < num_classes; ++k)
+            term_docs_[t] += counts_[t * num_classes + k];
+    }
+}
+
+double feature_selector::score(term_id term, selection_method method) const
+{
+    if (term >= term_docs_.size())
+        throw feature_selector_exception{"term id out of range"};
+
+    switch (method)
+    {
+        case selection_method::chi_square:
+            return chi_square(term);
+        case selection_method::information_gain:
+            return information_gain(term);
+        case selection_method::doc_freq:
+            return term_docs_[term];
+    }
+    return 0;
+}
+
+double feature_selector::chi_square(term_id term) const
+{
+    double best = 0;
+    double n = num_docs_;
+    double df = term_docs_[term];
+    for (uint64_t k = 0; k < class_docs_.size(); ++k)
+    {
+        // the documents with and without the term, in and out of class k
+        double a = counts_[term * class_docs_.size() + k];
+        double b = df - a;
+        double c = class_docs_[k] - a;
+        double d = n - class_docs_[k] - b;
+        double denom = (a + c) * (b + d) * (a + b) * (c + d);
+        if (denom > 0)
+            best = std::max(best, n * (a * d - c * b) * (a * d - c * b)
+                                      / denom);
+    }
+    return best;
+}
+
+double feature_selector::information_gain(term_id term) const
+{
+    if (num_docs_ == 0)
+        return 0;
+
+    double n = num_docs_;
+    double df = term_docs_[term];
+    double gain = 0;
+    for (uint64_t k = 0; k < class_docs_.size(); ++k)
+    {
+        double with = counts_[term * class_docs_.size() + k];
+        double without = class_docs_[k] - with;
+        gain -= plogp(class_docs_[k] / n);
+        if (df > 0)
+            gain += df / n * plogp(with / df);
+        if (n > df)
+            gain += (n - df) / n * plogp(without / (n - df));
+    }
+    return gain;
+}
+
+std::vector<term_id> feature_selector::select(selection_method method,
+                                              uint64_t num) const
+{
+    std::vector<std::pair<double, term_id>> scores;
+    scores.reserve(term_docs_.size());
+    for (term_id t{0}; t < term_docs_.size(); ++t)
+        scores.emplace_back(score(t, method), t);
+
+    // higher scores first, and lower term ids among equal scores
+    num = std::min<uint64_t>(num, scores.size());
+    std::partial_sort(scores.begin(), scores.begin() + num, scores.end(),
+                      [](const std::pair<double, term_id>& a,
+                         const std::pair<double, term_id>& b)
+                      {
+        return a.first > b.first || (a.first == b.first && a.second < b.second);
+    });
+
+    std::vector<term_id> features;
+    features.reserve(num);
+    for (uint64_t i = 0; i < num; ++i)
+        features.push_back(scores[i].second);
+    std::sort(features.begin(), features.end());
+    return features;
+}
+
+feature_projection::feature_projection(const std::vector<term_id>& features,
+                                       uint64_t num_terms)
+    : size_{features.size()}, ids_(num_terms, static_cast<uint32_t>(size_))
+{
+    for (uint64_t i = 0; i < features.size(); ++i)
+        ids_.at(features[i]) = static_cast<uint32_t>(i);
+}
+
+uint64_t feature_projection::size() const
+{
+    return size_;
+}
+
+uint64_t feature_projection::operator()(term_id term) const
+{
+    return term < ids_.size() ? ids_[term] : size_;
+}
+
+std::vector<std::pair<term_id, double>> feature_projection::project(
+    const std::vector<std::pair<term_id, double>>& counts) const
+{
+    std::vector<std::pair<term_id, double>> projected;
+    projected.reserve(counts.size());
+    for (const auto& count : counts)
+    {
+        auto id = (*this)(count.first);
+        if (id < size_)
+            projected.emplace_back(term_id{id}, count.second);
+    }
+    return projected;
+}
+
+index::csr_matrix
+    feature_projection::project(const index::csr_matrix& matrix) const
+{
+    std::vector<doc_id> docs;
+    std::vector<uint64_t> offsets{0};
+    std::vector<uint32_t> terms;
+    std::vector<float> values;
+    docs.reserve(matrix.rows());
+    offsets.reserve(matrix.rows() + 1);
+    for (uint64_t r = 0; r < matrix.rows(); ++r)
+    {
+        auto row = matrix[r];
+        for (uint64_t i = 0; i < row.size(); ++i)
+        {
+            auto id = (*this)(row.term(i));
+            if (id < size_)
+            {
+                terms.push_back(static_cast<uint32_t>(id));
+                values.push_back(static_cast<float>(row.value(i)));
+            }
+        }
+        docs.push_back(matrix.doc(r));
+        offsets.push_back(terms.size());
+    }
+    return {std::move(docs), std::move(offsets), std::move(terms),
+            std::move(values)};
+}
+}
+}
@@ -0,0 +1,179 @@
+/** @file online_classifier.cpp */
+
+#if META_HAS_STD_SHARED_PTR_ATOMICS
+#include <atomic>
+#endif
+#include <limits>
+
+#include "cpptoml.h"
+#include "classify/loss/hinge.h"
+#include "classify/loss/loss_function_factory.h"
+#include "classify/online_classifier.h"
+#include "util/shim.h"
+
+namespace meta
+{
+namespace classify
+{
+
+online_classifier::online_classifier(
+    std::unique_ptr<loss::loss_function> loss, double alpha, double lambda,
+    uint64_t snapshot_interval)
+    : loss_{std::move(loss)},
+      alpha_{alpha},
+      lambda_{lambda},
+      snapshot_interval_{snapshot_interval}
+{
+    if (!loss_)
+        throw online_classifier_exception{"a loss function is required"};
+}
+
+std::vector<double>
+    online_classifier::model::scores(const feature_vector& features) const
+{
+    auto result = bias;
+    for (const auto& feat : features)
+    {
+        auto it = weights.find(feat.first);
+        if (it == weights.end())
+            continue;
+        for (uint64_t k = 0; k < it->second.size(); ++k)
+            result[k] += feat.second * it->second[k];
+    }
+    for (auto& score : result)
+        score *= coeff;
+    return result;
+}
+
+void online_classifier::train(const feature_vector& features,
+                              const class_label& label)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    auto it = model_.class_ids.find(label);
+    if (it == model_.class_ids.end())
+    {
+        it = model_.class_ids.emplace(label, model_.classes.size()).first;
+        model_.classes.push_back(label);
+        model_.bias.push_back(0);
+    }
+
+    // every binary model is updated with the same prediction-time weights,
+    // then all of them are regularized at once through the coefficient
+    auto scores = model_.scores(features);
+    std::vector<double> updates(scores.size());
+    for (uint64_t k = 0; k < scores.size(); ++k)
+    {
+        int actual = k == it->second ? 1 : -1;
+        updates[k] = -alpha_ * loss_->derivative(scores[k], actual);
+    }
+
+    model_.coeff *= 1 - alpha_ * lambda_;
+    if (model_.coeff < 1e-9)
+    {
+        for (auto& b : model_.bias)
+            b *= model_.coeff;
+        for (auto& feat : model_.weights)
+            for (auto& w : feat.second)
+                w *= model_.coeff;
+        model_.coeff = 1;
+    }
+
+    for (uint64_t k = 0; k < updates.size(); ++k)
+        updates[k] /= model_.coeff;
+    for (const auto& feat : features)
+    {
+        auto& weights = model_.weights[feat.first];
+        if (weights.size() < updates.size())
+            weights.resize(updates.size(), 0.0);
+        for (uint64_t k = 0; k < updates.size(); ++k)
+            weights[k] += updates[k] * feat.second;
+    }
+    for (uint64_t k = 0; k < updates.size(); ++k)
+        model_.bias[k] += updates[k];
+
+    ++num_updates_;
+    if (snapshot_interval_ > 0 && num_updates_ % snapshot_interval_ == 0)
+        publish_locked();
+}
+
+class_label online_classifier::classify(const feature_vector& features) const
+{
+#if META_HAS_STD_SHARED_PTR_ATOMICS
+    auto snapshot = std::atomic_load(&snapshot_);
+#else
+    std::shared_ptr<const model> snapshot;
+    {
+        std::lock_guard<std::mutex> lock{snapshot_mutex_};
+        snapshot = snapshot_;
+    }
+#endif
+    if (!snapshot)
+        return class_label{};
+
+    auto scores = snapshot->scores(features);
+    double best_score = std::numeric_limits<double>::lowest();
+    class_label best_label;
+    for (uint64_t k = 0; k < scores.size(); ++k)
+    {
+        if (scores[k] > best_score)
+        {
+            best_score = scores[k];
+            best_label = snapshot->classes[k];
+        }
+    }
+    return best_label;
+}
+
+void online_classifier::publish()
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    publish_locked();
+}
+
+void online_classifier::publish_locked()
+{
+    std::shared_ptr<const model> snapshot = std::make_shared<model>(model_);
+#if META_HAS_STD_SHARED_PTR_ATOMICS
+    std::atomic_store(&snapshot_, snapshot);
+#else
+    std::lock_guard<std::mutex> lock{snapshot_mutex_};
+    snapshot_ = std::move(snapshot);
+#endif
+}
+
+uint64_t online_classifier::num_updates() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return num_updates_;
+}
+
+std::unique_ptr<online_classifier>
+    make_online_classifier(const cpptoml::table& config)
+{
+    auto loss = loss::hinge::id;
+    if (auto c_loss = config.get_as<std::string>("loss"))
+        loss = *c_loss;
+
+    auto alpha = online_classifier::default_alpha;
+    if (auto c_alpha = config.get_as<double>("alpha"))
+        alpha = *c_alpha;
+
+    auto lambda = online_classifier::default_lambda;
+    if (auto c_lambda = config.get_as<double>("lambda"))
+        lambda = *c_lambda;
+
+    auto interval = online_classifier::default_snapshot_interval;
+    if (auto c_interval = config.get_as<int64_t>("snapshot-interval"))
+    {
+        if (*c_interval < 0)
+            throw online_classifier::online_classifier_exception{
+                "snapshot-interval must not be negative"};
+        interval = static_cast<uint64_t>(*c_interval);
+    }
+
+    return make_unique<online_classifier>(loss::make_loss_function(loss),
+                                          alpha, lambda, interval);
+}
+}
+}
@@ -11,6 +11,7 @@
 #include "classify/loss/all.h"
 #include "index/forward_index.h"
 #include "index/ranker/all.h"
+#include "parallel/default_pool.h"
 #include "parser/analyzers/tree_analyzer.h"
 #include "sequence/analyzers/ngram_pos_analyzer.h"
 #include "util/printing.h"
@@ -38,6 +39,27 @@ classify::confusion_matrix cv(Index& idx, Classifier& c, bool even)
     return matrix;
 }
 
+/**
+ * @param config A classifier configuration
+ * @param suffix A suffix for every model prefix in the configuration
+ * @return a copy of the configuration in which the classifier, and any
+ * classifiers nested in it, store their models with the given suffix
+ */
+cpptoml::table fold_config(const cpptoml::table& config,
+                           const std::string& suffix)
+{
+    cpptoml::table result = config;
+    for (const auto& entry : config)
+    {
+        if (auto nested = config.get_table(entry.first))
+            result.insert(entry.first, std::make_shared<cpptoml::table>(
+                                           fold_config(*nested, suffix)));
+    }
+    if (auto prefix = config.get_as<std::string>("prefix"))
+        result.insert("prefix", *prefix + suffix);
+    return result;
+}
+
 template <class Index>
 void compare_cv(classify::confusion_matrix&, Index&)
 {
@@ -77,6 +99,7 @@ int main(int argc, char* argv[])
     sequence::register_analyzers();
 
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
     auto class_config = config.get_table("classifier");
     if (!class_config)
     {
@@ -96,21 +119,40 @@ int main(int argc, char* argv[])
     }
     progress.end();
 
-    std::unique_ptr<classify::classifier> classifier;
+    std::shared_ptr<index::dblru_inverted_index> i_idx;
     auto classifier_method = *class_config->get_as<std::string>("method");
     if (classifier_method == "knn" || classifier_method == "nearest-centroid")
-    {
-        auto i_idx
-            = index::make_index<index::dblru_inverted_index>(argv[1], 10000);
-        classifier = classify::make_classifier(*class_config, f_idx, i_idx);
-    }
-    else
-        classifier = classify::make_classifier(*class_config, f_idx);
+        i_idx = index::make_index<index::dblru_inverted_index>(argv[1], 10000);
 
     bool even = false;
     auto even_split = class_config->get_as<std::string>("even-split");
     if (even_split && *even_split == "true")
         even = true;
+
+    // folds run concurrently on classifiers of their own, each of which
+    // stores its models under a prefix of its own
+    auto cv_threads = class_config->get_as<int64_t>("cv-threads");
+    if (cv_threads && *cv_threads > 1)
+    {
+        classify::confusion_matrix matrix;
+        auto seconds = common::time<std::chrono::seconds>([&]()
+        {
+            matrix = classify::classifier::cross_validate(
+                [&](uint64_t fold)
+                {
+                    auto config = fold_config(*class_config,
+                                              "-fold" + std::to_string(fold));
+                    return classify::make_classifier(config, f_idx, i_idx);
+                },
+                docs, 5, even, 1, static_cast<uint64_t>(*cv_threads));
+        });
+        std::cerr << "time elapsed: " << seconds.count() << "s" << std::endl;
+        matrix.print();
+        matrix.print_stats();
+        return 0;
+    }
+
+    auto classifier = classify::make_classifier(*class_config, f_idx, i_idx);
     cv(*f_idx, *classifier, even);
 
     return 0;
@@ -3,9 +3,13 @@
  */
 
 #include <iostream>
-#include "classify/batch_training.h"
-#include "classify/classifier_factory.h"
+#include "classify/confusion_matrix.h"
+#include "classify/online_classifier.h"
+#include "index/forward_index.h"
+#include "index/make_index.h"
+#include "index/postings_data.h"
 #include "logging/logger.h"
+#include "parallel/default_pool.h"
 #include "parser/analyzers/tree_analyzer.h"
 #include "sequence/analyzers/ngram_pos_analyzer.h"
 #include "util/time.h"
@@ -27,6 +31,7 @@ int main(int argc, char* argv[])
     sequence::register_analyzers();
 
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
     auto class_config = config.get_table("classifier");
     if (!class_config)
     {
@@ -36,9 +41,10 @@ int main(int argc, char* argv[])
     }
 
     auto batch_size = config.get_as<int64_t>("batch-size");
-    if (!batch_size)
+    if (!batch_size || *batch_size <= 0)
     {
-        std::cerr << "Missing batch-size in " << argv[1] << std::endl;
+        std::cerr << "Missing or non-positive batch-size in " << argv[1]
+                  << std::endl;
         return 1;
     }
 
@@ -58,19 +64,36 @@ int main(int argc, char* argv[])
         return 1;
     }
 
-    auto classifier = classify::make_classifier(*class_config, f_idx);
+    auto classifier = classify::make_online_classifier(*class_config);
 
     auto docs = f_idx->docs();
     auto test_begin = docs.begin() + *test_start;
 
-    std::vector<doc_id> training_set{docs.begin(), test_begin};
-    std::vector<doc_id> test_set{test_begin, docs.end()};
-
+    // the training documents are streamed to the classifier one at a time,
+    // and its weights are published to classify() after every batch
     auto dur = common::time([&]()
     {
-        classify::batch_train(*f_idx, *classifier, training_set, *batch_size);
-
-        auto mtrx = classifier->test(test_set);
+        auto num_train = static_cast<uint64_t>(*test_start);
+        auto batch = static_cast<uint64_t>(*batch_size);
+        for (uint64_t i = 0; i < num_train; ++i)
+        {
+            auto pdata = f_idx->search_primary(docs[i]);
+            classifier->train(pdata->counts(), f_idx->label(docs[i]));
+            if ((i + 1) % batch == 0 || i + 1 == num_train)
+            {
+                classifier->publish();
+                LOG(progress) << "\rTrained " << i + 1 << "/" << num_train
+                              << ENDLG;
+            }
+        }
+        LOG(progress) << '\n' << ENDLG;
+
+        classify::confusion_matrix mtrx;
+        for (auto it = test_begin; it != docs.end(); ++it)
+        {
+            auto pdata = f_idx->search_primary(*it);
+            mtrx.add(classifier->classify(pdata->counts()), f_idx->label(*it));
+        }
         mtrx.print();
         mtrx.print_stats();
     });
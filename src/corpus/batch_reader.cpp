@@ -0,0 +1,80 @@
+/**
+ * @file batch_reader.cpp
+ */
+
+#include "corpus/batch_reader.h"
+
+namespace meta
+{
+namespace corpus
+{
+
+batch_reader::batch_reader(corpus& docs, const std::string& progress_prefix,
+                           uint64_t batch_size, uint64_t max_batches)
+    : docs_(docs),
+      batch_size_{batch_size},
+      queue_{max_batches},
+      progress_{progress_prefix, docs.size()}
+{
+    if (batch_size_ == 0 || max_batches == 0)
+        throw batch_reader_exception{"batch sizes must be positive"};
+    reader_ = std::thread{&batch_reader::read, this};
+}
+
+batch_reader::~batch_reader()
+{
+    // if the consumers stopped early, the reader may be waiting for room
+    queue_.close();
+    reader_.join();
+}
+
+void batch_reader::read()
+{
+    using clock = parallel::stage_counter::clock;
+    try
+    {
+        while (true)
+        {
+            std::vector<document> batch;
+            batch.reserve(batch_size_);
+
+            auto start = clock::now();
+            while (batch.size() < batch_size_ && docs_.has_next())
+            {
+                batch.push_back(docs_.next());
+                progress_(batch.back().id());
+            }
+            auto read = clock::now();
+            counter_.add_work(batch.size(), read - start);
+
+            if (batch.empty() || !queue_.push(std::move(batch)))
+                break;
+            counter_.add_wait(clock::now() - read);
+        }
+    }
+    catch (...)
+    {
+        error_ = std::current_exception();
+    }
+
+    progress_.end();
+    queue_.close();
+}
+
+bool batch_reader::next(std::vector<document>& batch)
+{
+    if (queue_.pop(batch))
+        return true;
+
+    // the queue is closed after error_ is set, so this sees it
+    if (error_)
+        std::rethrow_exception(error_);
+    return false;
+}
+
+const parallel::stage_counter& batch_reader::counter() const
+{
+    return counter_;
+}
+}
+}
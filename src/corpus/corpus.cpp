@@ -23,10 +23,59 @@ const std::string& corpus::encoding() const
     return encoding_;
 }
 
+void corpus::fields_file(const std::string& path, uint64_t num_fields)
+{
+    fields_ = make_unique<std::ifstream>(path);
+    if (!*fields_)
+        throw corpus_exception{"failed to open fields file: " + path};
+    num_fields_ = num_fields;
+}
+
+void corpus::read_fields(document& doc)
+{
+    if (!fields_)
+        return;
+
+    std::string line;
+    if (!std::getline(*fields_, line))
+        throw corpus_exception{"fields file is missing a line for document "
+                               + std::to_string(doc.id())};
+
+    std::vector<std::string> values;
+    values.reserve(num_fields_);
+    std::string::size_type start = 0;
+    while (true)
+    {
+        auto tab = line.find('\t', start);
+        values.push_back(line.substr(start, tab - start));
+        if (tab == std::string::npos)
+            break;
+        start = tab + 1;
+    }
+    if (values.size() != num_fields_)
+        throw corpus_exception{"wrong number of fields for document "
+                               + std::to_string(doc.id())};
+    doc.fields(std::move(values));
+}
+
 std::unique_ptr<corpus> corpus::load(const std::string& config_file)
 {
     auto config = cpptoml::parse_file(config_file);
+    auto corp = make_corpus(config);
+
+    // the typed fields, if any are declared, are read alongside the corpus
+    if (auto fields = config.get_table_array("fields"))
+    {
+        auto prefix = *config.get_as<std::string>("prefix");
+        auto dataset = *config.get_as<std::string>("dataset");
+        corp->fields_file(prefix + "/" + dataset + "/" + dataset + ".fields",
+                          fields->get().size());
+    }
+    return corp;
+}
 
+std::unique_ptr<corpus> corpus::make_corpus(const cpptoml::table& config)
+{
     auto type = config.get_as<std::string>("corpus-type");
     if (!type)
         throw corpus_exception{"corpus-type missing from configuration file"};
@@ -54,8 +103,15 @@ std::unique_ptr<corpus> corpus::load(const std::string& config_file)
 
         std::string file = *prefix + "/" + *dataset + "/" + *file_list
                            + "-full-corpus.txt";
-        return make_unique<file_corpus>(*prefix + "/" + *dataset + "/", file,
-                                        encoding);
+        auto prefetch = config.get_as<int64_t>("prefetch");
+        auto io_threads = config.get_as<int64_t>("io-threads");
+        if ((prefetch && *prefetch < 0) || (io_threads && *io_threads <= 0))
+            throw corpus_exception{
+                "prefetch must not be negative and io-threads positive"};
+        return make_unique<file_corpus>(
+            *prefix + "/" + *dataset + "/", file, encoding,
+            prefetch ? static_cast<uint64_t>(*prefetch) : 0,
+            io_threads ? static_cast<uint64_t>(*io_threads) : 8);
     }
     else if (*type == "line-corpus")
     {
@@ -67,6 +123,14 @@ std::unique_ptr<corpus> corpus::load(const std::string& config_file)
         return make_unique<line_corpus>(filename, encoding,
                                         static_cast<uint64_t>(*lines));
     }
+    else if (*type == "tokenized-corpus")
+    {
+        auto file = config.get_as<std::string>("tokenized-file");
+        if (file)
+            return make_unique<tokenized_corpus>(*file);
+        return make_unique<tokenized_corpus>(*prefix + "/" + *dataset + "/"
+                                             + *dataset + ".tok");
+    }
 #if META_HAS_ZLIB
     else if (*type == "gz-corpus")
     {
@@ -3,6 +3,8 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+
 #include "corpus/corpus.h"
 #include "corpus/document.h"
 #include "util/mapping.h"
@@ -14,7 +16,14 @@ namespace corpus
 
 document::document(const std::string& path, doc_id d_id,
                    const class_label& label)
-    : path_{path}, d_id_{d_id}, label_{label}, length_{0}, encoding_{"utf-8"}
+    : path_{path},
+      d_id_{d_id},
+      label_{label},
+      length_{0},
+      vocab_{nullptr},
+      condensed_{true},
+      encoding_{"utf-8"},
+      pretokenized_{false}
 {
     size_t idx = path.find_last_of("/") + 1;
     name_ = path.substr(idx);
@@ -22,10 +31,32 @@ document::document(const std::string& path, doc_id d_id,
 
 void document::increment(const std::string& term, double amount)
 {
+    if (vocab_)
+    {
+        increment(vocab_->intern(term), amount);
+        return;
+    }
     counts_[term] += amount;
     length_ += amount;
 }
 
+void document::increment(feature_vocabulary::feature_id id, double amount)
+{
+    features_.emplace_back(id, amount);
+    condensed_ = false;
+    length_ += amount;
+}
+
+void document::vocabulary(feature_vocabulary* vocab)
+{
+    vocab_ = vocab;
+}
+
+feature_vocabulary* document::vocabulary() const
+{
+    return vocab_;
+}
+
 std::string document::path() const
 {
     return path_;
@@ -56,11 +87,50 @@ double document::count(const std::string& term) const
     return map::safe_at(counts_, term);
 }
 
-const std::unordered_map<std::string, double>& document::counts() const
+auto document::counts() const -> const count_map &
 {
     return counts_;
 }
 
+void document::arena(util::arena* a)
+{
+    count_map counts{counts_.begin(), counts_.end(), counts_.bucket_count(),
+                     counts_.hash_function(), counts_.key_eq(),
+                     count_map::allocator_type{a}};
+    counts_ = std::move(counts);
+}
+
+auto document::features() const -> const feature_vector &
+{
+    if (condensed_)
+        return features_;
+
+    // appending and combining once is cheaper than keeping the features
+    // sorted while the document is tokenized
+    std::sort(features_.begin(), features_.end(),
+              [](const feature_vector::pair_type& a,
+                 const feature_vector::pair_type& b)
+              {
+        return a.first < b.first;
+    });
+    auto out = features_.begin();
+    for (auto it = features_.begin(); it != features_.end(); ++it)
+    {
+        if (out != features_.begin() && (out - 1)->first == it->first)
+            (out - 1)->second += it->second;
+        else
+            *out++ = *it;
+    }
+    features_.contents({features_.begin(), out});
+    condensed_ = true;
+    return features_;
+}
+
+uint64_t document::unique_terms() const
+{
+    return counts_.size() + features().size();
+}
+
 void document::content(const std::string& content,
                        const std::string& encoding /* = "utf-8" */)
 {
@@ -100,5 +170,25 @@ void document::label(class_label label)
 {
     label_ = label;
 }
+
+const std::vector<std::string>& document::fields() const
+{
+    return fields_;
+}
+
+void document::fields(std::vector<std::string> values)
+{
+    fields_ = std::move(values);
+}
+
+bool document::pretokenized() const
+{
+    return pretokenized_;
+}
+
+void document::pretokenized(bool pretok)
+{
+    pretokenized_ = pretok;
+}
 }
 }
@@ -0,0 +1,90 @@
+/**
+ * @file feature_vocabulary.cpp
+ */
+
+#include <algorithm>
+#include <functional>
+
+#include "corpus/feature_vocabulary.h"
+
+namespace meta
+{
+namespace corpus
+{
+
+feature_vocabulary::feature_vocabulary(uint64_t num_shards)
+    : shards_(num_shards == 0 ? 1 : num_shards), size_{0}
+{
+    // nothing
+}
+
+auto feature_vocabulary::intern(const std::string& term) -> feature_id
+{
+    auto index = std::hash<std::string>{}(term) % shards_.size();
+    auto& shrd = shards_[index];
+    std::lock_guard<std::mutex> lock{shrd.mutex};
+    auto it = shrd.ids.find(term);
+    if (it != shrd.ids.end())
+        return it->second;
+
+    feature_id id = shrd.terms.size() * shards_.size() + index;
+    it = shrd.ids.emplace(term, id).first;
+    shrd.terms.push_back(&it->first);
+    ++size_;
+    return id;
+}
+
+const std::string& feature_vocabulary::term(feature_id id) const
+{
+    const auto& shrd = shards_[id % shards_.size()];
+    std::lock_guard<std::mutex> lock{shrd.mutex};
+    auto pos = id / shards_.size();
+    if (pos >= shrd.terms.size())
+        throw feature_vocabulary_exception{"unknown feature id: "
+                                           + std::to_string(id)};
+    return *shrd.terms[pos];
+}
+
+uint64_t feature_vocabulary::size() const
+{
+    return size_.load();
+}
+
+uint64_t feature_vocabulary::id_bound() const
+{
+    uint64_t bound = 0;
+    for (uint64_t i = 0; i < shards_.size(); ++i)
+    {
+        std::lock_guard<std::mutex> lock{shards_[i].mutex};
+        if (!shards_[i].terms.empty())
+            bound = std::max(bound, (shards_[i].terms.size() - 1)
+                                            * shards_.size()
+                                        + i + 1);
+    }
+    return bound;
+}
+
+auto feature_vocabulary::ids_by_term() const -> std::vector<feature_id>
+{
+    std::vector<std::pair<const std::string*, feature_id>> terms;
+    for (const auto& shrd : shards_)
+    {
+        std::lock_guard<std::mutex> lock{shrd.mutex};
+        for (const auto& entry : shrd.ids)
+            terms.emplace_back(&entry.first, entry.second);
+    }
+    std::sort(terms.begin(), terms.end(),
+              [](const std::pair<const std::string*, feature_id>& a,
+                 const std::pair<const std::string*, feature_id>& b)
+              {
+        return *a.first < *b.first;
+    });
+
+    std::vector<feature_id> ids;
+    ids.reserve(terms.size());
+    for (const auto& term : terms)
+        ids.push_back(term.second);
+    return ids;
+}
+}
+}
@@ -3,8 +3,12 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+
 #include "corpus/file_corpus.h"
+#include "io/mmap_file.h"
 #include "io/parser.h"
+#include "util/shim.h"
 
 namespace meta
 {
@@ -12,19 +16,25 @@ namespace corpus
 {
 
 file_corpus::file_corpus(const std::string& prefix, const std::string& doc_list,
-                         std::string encoding)
-    : corpus{std::move(encoding)}, cur_{0}, prefix_{prefix}
+                         std::string encoding, uint64_t prefetch,
+                         uint64_t io_threads)
+    : corpus{std::move(encoding)},
+      cur_{0},
+      prefix_{prefix},
+      prefetch_{prefetch},
+      next_read_{0}
 {
     io::parser psr{doc_list, "\n"};
     uint64_t idx = 0;
     while (psr.has_next())
     {
-        std::string line = psr.next();
-        size_t space = line.find_first_of(" ");
-        if (space != std::string::npos)
+        auto line = psr.next_token();
+        auto end = line.data + line.size;
+        auto space = std::find(line.data, end, ' ');
+        if (space != end)
         {
-            std::string file{line.substr(space + 1)};
-            class_label label{line.substr(0, space)};
+            std::string file{space + 1, end};
+            class_label label{std::string{line.data, space}};
             docs_.emplace_back(std::make_pair(file, label));
         }
         else
@@ -34,6 +44,27 @@ file_corpus::file_corpus(const std::string& prefix, const std::string& doc_list,
         }
         ++idx;
     }
+
+    if (prefetch_ > 0)
+    {
+        pool_ = make_unique<parallel::thread_pool>(
+            io_threads == 0 ? 1 : io_threads);
+        fill();
+    }
+}
+
+void file_corpus::fill()
+{
+    while (next_read_ < docs_.size() && next_read_ - cur_ < prefetch_)
+    {
+        auto path = prefix_ + docs_[next_read_].first;
+        pending_.emplace_back(pool_->submit_task([path]()
+        {
+            io::mmap_file file{path};
+            return std::string{file.begin(), file.size()};
+        }));
+        ++next_read_;
+    }
 }
 
 bool file_corpus::has_next() const
@@ -45,7 +76,23 @@ document file_corpus::next()
 {
     document doc{prefix_ + docs_[cur_].first, doc_id{cur_}, docs_[cur_].second};
     doc.encoding(encoding());
+    if (pool_)
+    {
+        auto content = std::move(pending_.front());
+        pending_.pop_front();
+        try
+        {
+            doc.content(content.get(), encoding());
+        }
+        catch (const io::mmap_file::mmap_file_exception&)
+        {
+            // the analyzer opens the file itself, and reports the error
+        }
+    }
     ++cur_;
+    if (pool_)
+        fill();
+    read_fields(doc);
     return doc;
 }
 
@@ -5,19 +5,26 @@
 
 #include "corpus/gz_corpus.h"
 #include "util/filesystem.h"
+#include "util/shim.h"
 
 namespace meta
 {
 namespace corpus
 {
 
-gz_corpus::gz_corpus(const std::string& file, std::string encoding)
+gz_corpus::gz_corpus(const std::string& file, std::string encoding,
+                     uint64_t num_threads)
     : corpus{std::move(encoding)},
       cur_id_{0},
-      corpus_stream_{file + ".gz"},
       class_stream_{file + ".labels.gz"},
       name_stream_{file + ".names.gz"}
 {
+    if (io::bgzf_reader::is_bgzf(file + ".gz"))
+        corpus_reader_
+            = make_unique<io::bgzf_reader>(file + ".gz", num_threads);
+    else
+        corpus_stream_ = make_unique<io::gzifstream>(file + ".gz");
+
     if (!filesystem::file_exists(file + ".numdocs"))
         throw corpus::corpus_exception{
             file + ".numdocs file does not exist (required for gz_corpus)"};
@@ -50,11 +57,15 @@ document gz_corpus::next()
         std::getline(name_stream_, name);
 
     std::string line;
-    std::getline(corpus_stream_, line);
+    if (corpus_reader_)
+        corpus_reader_->getline(line);
+    else
+        std::getline(*corpus_stream_, line);
 
     document doc{name, cur_id_++, label};
     doc.content(line, encoding());
 
+    read_fields(doc);
     return doc;
 }
 
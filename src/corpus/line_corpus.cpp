@@ -4,6 +4,8 @@
  */
 
 #include <algorithm>
+#include <cstring>
+#include <limits>
 
 #include "corpus/line_corpus.h"
 #include "io/parser.h"
@@ -18,6 +20,7 @@ namespace corpus
 line_corpus::line_corpus(const std::string& file, std::string encoding,
                          uint64_t num_lines /* = 0 */)
     : corpus{std::move(encoding)},
+      file_{file},
       cur_id_{0},
       num_lines_{num_lines},
       parser_{file, "\n"}
@@ -63,6 +66,7 @@ document line_corpus::next()
     document doc{name, cur_id_++, label};
     doc.content(parser_.next(), encoding());
 
+    read_fields(doc);
     return doc;
 }
 
@@ -70,5 +74,188 @@ uint64_t line_corpus::size() const
 {
     return num_lines_;
 }
+
+namespace
+{
+/**
+ * @param path A file
+ * @return the file mapped into memory, or nullptr if it is empty and so
+ * cannot be mapped
+ */
+std::unique_ptr<io::mmap_file> map_file(const std::string& path)
+{
+    if (filesystem::file_size(path) == 0)
+        return nullptr;
+    return make_unique<io::mmap_file>(path);
+}
+
+/**
+ * @param path A file of lines
+ * @param lines Line numbers, in increasing order
+ * @return the offset at which each of the lines starts, or the size of
+ * the file for lines past its end
+ */
+std::vector<uint64_t> line_offsets(const std::string& path,
+                                   const std::vector<uint64_t>& lines)
+{
+    auto file = map_file(path);
+    uint64_t size = file ? file->size() : 0;
+    std::vector<uint64_t> offsets;
+    offsets.reserve(lines.size());
+
+    uint64_t pos = 0;
+    uint64_t line = 0;
+    for (const auto& target : lines)
+    {
+        while (line < target && pos < size)
+        {
+            auto found = static_cast<const char*>(
+                std::memchr(file->begin() + pos, '\n', size - pos));
+            pos = found ? static_cast<uint64_t>(found - file->begin()) + 1
+                        : size;
+            ++line;
+        }
+        offsets.push_back(pos);
+    }
+    return offsets;
+}
+}
+
+auto line_corpus::partitions(uint64_t num_partitions) const
+    -> std::vector<partition>
+{
+    if (num_partitions == 0)
+        num_partitions = 1;
+
+    auto file = map_file(file_);
+    uint64_t size = file ? file->size() : 0;
+    const char* data = file ? file->begin() : nullptr;
+
+    // each partition ends just past the first newline after its share of
+    // the bytes, so that no line is split
+    std::vector<partition> parts;
+    std::vector<uint64_t> first_lines;
+    uint64_t begin = 0;
+    uint64_t num_docs = 0;
+    for (uint64_t i = 0; i < num_partitions; ++i)
+    {
+        uint64_t end = size;
+        auto target = std::max(begin, size / num_partitions * (i + 1));
+        if (i + 1 < num_partitions && target < size)
+        {
+            auto found = static_cast<const char*>(
+                std::memchr(data + target, '\n', size - target));
+            if (found)
+                end = static_cast<uint64_t>(found - data) + 1;
+        }
+
+        uint64_t count = 0;
+        if (end > begin)
+        {
+            count = filesystem::count_delimiters(data + begin, data + end,
+                                                 '\n');
+            if (data[end - 1] != '\n')
+                ++count;
+        }
+
+        parts.push_back(partition{doc_id{num_docs}, count, begin, end, 0, 0});
+        first_lines.push_back(num_docs);
+        num_docs += count;
+        begin = end;
+    }
+
+    if (class_parser_)
+    {
+        auto offsets = line_offsets(file_ + ".labels", first_lines);
+        for (uint64_t i = 0; i < parts.size(); ++i)
+            parts[i].labels_begin = offsets[i];
+    }
+
+    if (name_parser_)
+    {
+        auto offsets = line_offsets(file_ + ".names", first_lines);
+        for (uint64_t i = 0; i < parts.size(); ++i)
+            parts[i].names_begin = offsets[i];
+    }
+    return parts;
+}
+
+std::unique_ptr<corpus> line_corpus::open(const partition& part) const
+{
+    return make_unique<line_corpus_partition>(file_, encoding(), part,
+                                              class_parser_ != nullptr,
+                                              name_parser_ != nullptr);
+}
+
+line_corpus_partition::line_corpus_partition(
+    const std::string& file, std::string encoding,
+    const line_corpus::partition& part, bool labels, bool names)
+    : corpus{std::move(encoding)},
+      part_(part),
+      cur_id_{part.first_id},
+      content_(make_reader(file, part.begin, part.end))
+{
+    auto end = std::numeric_limits<uint64_t>::max();
+    if (labels)
+        labels_ = make_unique<line_reader>(
+            make_reader(file + ".labels", part.labels_begin, end));
+    if (names)
+        names_ = make_unique<line_reader>(
+            make_reader(file + ".names", part.names_begin, end));
+}
+
+auto line_corpus_partition::make_reader(const std::string& path,
+                                        uint64_t begin, uint64_t end)
+    -> line_reader
+{
+    line_reader reader;
+    reader.file = map_file(path);
+    uint64_t size = reader.file ? reader.file->size() : 0;
+    reader.end = std::min(end, size);
+    reader.pos = std::min(begin, reader.end);
+    return reader;
+}
+
+std::string line_corpus_partition::line_reader::next()
+{
+    if (pos >= end)
+        throw corpus_exception{"ran out of lines reading a line corpus "
+                               "partition"};
+
+    auto data = file->begin();
+    auto found = static_cast<const char*>(
+        std::memchr(data + pos, '\n', end - pos));
+    auto last = found ? static_cast<uint64_t>(found - data) : end;
+    std::string line{data + pos, last - pos};
+    pos = found ? last + 1 : end;
+    return line;
+}
+
+bool line_corpus_partition::has_next() const
+{
+    return static_cast<uint64_t>(cur_id_)
+           < static_cast<uint64_t>(part_.first_id) + part_.num_docs;
+}
+
+document line_corpus_partition::next()
+{
+    class_label label{"[none]"};
+    std::string name{"[none]"};
+
+    if (labels_)
+        label = class_label{labels_->next()};
+
+    if (names_)
+        name = names_->next();
+
+    document doc{name, cur_id_++, label};
+    doc.content(content_.next(), encoding());
+    return doc;
+}
+
+uint64_t line_corpus_partition::size() const
+{
+    return part_.num_docs;
+}
 }
 }
@@ -0,0 +1,222 @@
+/**
+ * @file tokenized_corpus.cpp
+ */
+
+#include "corpus/tokenized_corpus.h"
+#include "io/binary.h"
+
+namespace meta
+{
+namespace corpus
+{
+
+namespace
+{
+/// The first bytes of a tokenized corpus, "META-TOK" in little-endian
+const uint64_t magic = 0x4b4f542d4154454dULL;
+
+/// The version of the format
+const uint64_t version = 1;
+
+/// The offset of the number of documents in the header
+const std::streamoff num_docs_offset = 3 * sizeof(uint64_t);
+
+/// The bytes of the header, which the documents follow
+const std::streamoff header_size = 5 * sizeof(uint64_t);
+}
+
+tokenized_corpus::tokenized_corpus(const std::string& file)
+    : corpus{"utf-8"},
+      input_{file, std::ios::binary},
+      cur_id_{0},
+      num_docs_{0},
+      sequences_{false}
+{
+    if (!input_)
+        throw tokenized_corpus_exception{"failed to open " + file};
+
+    uint64_t file_magic = 0;
+    uint64_t file_version = 0;
+    uint64_t flags = 0;
+    uint64_t vocab_offset = 0;
+    io::read_binary(input_, file_magic);
+    io::read_binary(input_, file_version);
+    io::read_binary(input_, flags);
+    io::read_binary(input_, num_docs_);
+    io::read_binary(input_, vocab_offset);
+    if (!input_ || file_magic != magic)
+        throw tokenized_corpus_exception{file + " is not a tokenized corpus"};
+    if (file_version != version)
+        throw tokenized_corpus_exception{
+            file + " has an unsupported tokenized corpus version"};
+    if (vocab_offset < static_cast<uint64_t>(header_size))
+        throw tokenized_corpus_exception{file + " was not completed"};
+    sequences_ = (flags & 1) != 0;
+
+    input_.seekg(static_cast<std::streamoff>(vocab_offset));
+    uint64_t num_terms = 0;
+    io::read_binary(input_, num_terms);
+    terms_.resize(num_terms);
+    for (auto& term : terms_)
+        io::read_binary(input_, term);
+    if (!input_)
+        throw tokenized_corpus_exception{"failed to read the vocabulary of "
+                                         + file};
+    input_.seekg(header_size);
+}
+
+bool tokenized_corpus::has_next() const
+{
+    return cur_id_ < num_docs_;
+}
+
+document tokenized_corpus::next()
+{
+    std::string path;
+    std::string name;
+    std::string label;
+    io::read_binary(input_, path);
+    io::read_binary(input_, name);
+    io::read_binary(input_, label);
+
+    document doc{path, doc_id{cur_id_}, class_label{label}};
+    doc.name(name);
+
+    uint64_t count = 0;
+    io::read_binary(input_, count);
+    sequence_.clear();
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        uint64_t id = 0;
+        double amount = 1;
+        io::read_binary(input_, id);
+        if (sequences_)
+            sequence_.push_back(id);
+        else
+            io::read_binary(input_, amount);
+        if (!input_)
+            break;
+        if (id >= terms_.size())
+            throw tokenized_corpus_exception{"unknown term id in document "
+                                             + std::to_string(cur_id_)};
+        doc.increment(terms_[id], amount);
+    }
+    if (!input_)
+        throw tokenized_corpus_exception{"failed to read document "
+                                         + std::to_string(cur_id_)};
+
+    doc.pretokenized(true);
+    ++cur_id_;
+    read_fields(doc);
+    return doc;
+}
+
+uint64_t tokenized_corpus::size() const
+{
+    return num_docs_;
+}
+
+bool tokenized_corpus::sequences() const
+{
+    return sequences_;
+}
+
+const std::vector<uint64_t>& tokenized_corpus::sequence() const
+{
+    return sequence_;
+}
+
+const std::string& tokenized_corpus::term(uint64_t id) const
+{
+    if (id >= terms_.size())
+        throw tokenized_corpus_exception{"term id out of range"};
+    return terms_[id];
+}
+
+tokenized_corpus_writer::tokenized_corpus_writer(const std::string& file,
+                                                 bool sequences)
+    : output_{file, std::ios::binary},
+      sequences_{sequences},
+      num_docs_{0},
+      closed_{false}
+{
+    if (!output_)
+        throw tokenized_corpus::tokenized_corpus_exception{"failed to open "
+                                                           + file};
+
+    // the number of documents and the offset of the vocabulary are
+    // filled in by close()
+    io::write_binary(output_, magic);
+    io::write_binary(output_, version);
+    io::write_binary(output_, uint64_t{sequences_ ? 1u : 0u});
+    io::write_binary(output_, uint64_t{0});
+    io::write_binary(output_, uint64_t{0});
+}
+
+tokenized_corpus_writer::~tokenized_corpus_writer()
+{
+    if (!closed_)
+        close();
+}
+
+void tokenized_corpus_writer::write(const document& doc)
+{
+    if (sequences_)
+        throw tokenized_corpus::tokenized_corpus_exception{
+            "a file of sequences needs the tokens of each document"};
+
+    write_header(doc);
+    io::write_binary(output_, static_cast<uint64_t>(doc.counts().size()));
+    for (const auto& count : doc.counts())
+    {
+        io::write_binary(output_, intern(count.first));
+        io::write_binary(output_, count.second);
+    }
+}
+
+void tokenized_corpus_writer::write(const document& doc,
+                                    const std::vector<std::string>& tokens)
+{
+    if (!sequences_)
+        throw tokenized_corpus::tokenized_corpus_exception{
+            "a file of bags is written from the counts of each document"};
+
+    write_header(doc);
+    io::write_binary(output_, static_cast<uint64_t>(tokens.size()));
+    for (const auto& token : tokens)
+        io::write_binary(output_, intern(token));
+}
+
+void tokenized_corpus_writer::close()
+{
+    auto vocab_offset = static_cast<uint64_t>(output_.tellp());
+    io::write_binary(output_, static_cast<uint64_t>(terms_.size()));
+    for (const auto& term : terms_)
+        io::write_binary(output_, term);
+
+    output_.seekp(num_docs_offset);
+    io::write_binary(output_, num_docs_);
+    io::write_binary(output_, vocab_offset);
+    output_.close();
+    closed_ = true;
+}
+
+void tokenized_corpus_writer::write_header(const document& doc)
+{
+    io::write_binary(output_, doc.path());
+    io::write_binary(output_, doc.name());
+    io::write_binary(output_, static_cast<const std::string&>(doc.label()));
+    ++num_docs_;
+}
+
+uint64_t tokenized_corpus_writer::intern(const std::string& term)
+{
+    auto it = ids_.find(term);
+    if (it != ids_.end())
+        return it->second;
+    ids_.emplace(term, terms_.size());
+    terms_.push_back(term);
+    return terms_.size() - 1;
+}
+}
+}
@@ -11,6 +11,9 @@
 #include "util/printing.h"
 #include "util/filesystem.h"
 #include "meta.h"
+#if META_HAS_ZLIB
+#include "io/bgzf.h"
+#endif
 
 using namespace meta;
 
@@ -25,16 +28,32 @@ std::string get_content(const std::string& file, const std::string& prefix)
     return content;
 }
 
-void create_line_corpus(const std::string& filename,
-                        const std::string& new_filename,
-                        const std::string& prefix)
+/**
+ * Writes a line to an uncompressed file.
+ */
+void write_line(std::ofstream& out, const std::string& line)
+{
+    out << line << "\n";
+}
+
+#if META_HAS_ZLIB
+/**
+ * Writes a line to a BGZF file.
+ */
+void write_line(io::bgzf_writer& out, const std::string& line)
+{
+    out.write(line);
+    out.write("\n", 1);
+}
+#endif
+
+template <class Writer>
+uint64_t write_corpus(const std::string& filename, const std::string& prefix,
+                      Writer& content, Writer& labels, Writer& names)
 {
     std::ifstream input_paths{filename};
     if (!input_paths.good())
         std::cout << "Failed to open " << filename << std::endl;
-    std::ofstream content{new_filename};
-    std::ofstream labels{new_filename + ".labels"};
-    std::ofstream names{new_filename + ".names"};
 
     uint64_t num_lines = filesystem::num_lines(filename);
     uint64_t cur_line = 0;
@@ -44,20 +63,56 @@ void create_line_corpus(const std::string& filename,
     std::string label;
     while (input_paths >> label >> path)
     {
-        content << get_content(path, prefix) << "\n";
-        labels << label << "\n";
-        names << path << "\n";
+        write_line(content, get_content(path, prefix));
+        write_line(labels, label);
+        write_line(names, path);
         std::cout << ++cur_line << "/" << num_lines << " " << path
                   << "\t\t\t\t\r";
     }
     std::cout << std::endl;
+    return cur_line;
 }
 
+void create_line_corpus(const std::string& filename,
+                        const std::string& new_filename,
+                        const std::string& prefix)
+{
+    std::ofstream content{new_filename};
+    std::ofstream labels{new_filename + ".labels"};
+    std::ofstream names{new_filename + ".names"};
+    write_corpus(filename, prefix, content, labels, names);
+}
+
+#if META_HAS_ZLIB
+/**
+ * Writes the corpus as a gz_corpus whose files are in BGZF, so that they
+ * can be compressed and decompressed on several threads. The labels and
+ * names are small, so only the content gets a pool of threads.
+ */
+void create_bgzf_corpus(const std::string& filename,
+                        const std::string& new_filename,
+                        const std::string& prefix)
+{
+    io::bgzf_writer content{new_filename + ".gz"};
+    io::bgzf_writer labels{new_filename + ".labels.gz",
+                           io::bgzf_writer::max_block_size, 6, 1};
+    io::bgzf_writer names{new_filename + ".names.gz",
+                          io::bgzf_writer::max_block_size, 6, 1};
+    auto num_docs = write_corpus(filename, prefix, content, labels, names);
+    std::ofstream numdocs{new_filename + ".numdocs"};
+    numdocs << num_docs << "\n";
+}
+#endif
+
 int main(int argc, char* argv[])
 {
-    if (argc != 2)
+    bool bgzf = argc == 3 && std::string{argv[2]} == "--bgzf";
+    if (argc != 2 && !bgzf)
     {
-        std::cerr << "Usage:\t" << argv[0] << " configFile" << std::endl;
+        std::cerr << "Usage:\t" << argv[0] << " configFile [--bgzf]"
+                  << std::endl;
+        std::cerr << "\t--bgzf writes a gz-corpus in blocked gzip, which "
+                     "is decompressed in parallel" << std::endl;
         return 1;
     }
 
@@ -78,7 +133,20 @@ int main(int argc, char* argv[])
         *prefix + "/" + *dataset + "/" + *file_list + "-full-corpus.txt";
     std::string new_file = *prefix + "/" + *dataset + "/" + *dataset + ".dat";
 
-    create_line_corpus(file, new_file, *prefix + "/" + *dataset + "/");
+    if (bgzf)
+    {
+#if META_HAS_ZLIB
+        create_bgzf_corpus(file, new_file, *prefix + "/" + *dataset + "/");
+#else
+        std::cerr << "--bgzf requires MeTA to be built with zlib"
+                  << std::endl;
+        return 1;
+#endif
+    }
+    else
+    {
+        create_line_corpus(file, new_file, *prefix + "/" + *dataset + "/");
+    }
 
     return 0;
 }
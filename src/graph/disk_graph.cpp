@@ -0,0 +1,165 @@
+/**
+ * @file disk_graph.cpp
+ */
+
+#include <algorithm>
+#include <fstream>
+#include "graph/disk_graph.h"
+#include "io/binary.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace graph
+{
+
+disk_graph::adjacency_range::adjacency_range(node_id id, const node_id* ids,
+                                             const double* weights,
+                                             uint64_t size, bool incoming)
+    : id_{id}, ids_{ids}, weights_{weights}, size_{size}, incoming_{incoming}
+{
+    // nothing
+}
+
+auto disk_graph::adjacency_range::operator[](uint64_t idx) const
+    -> value_type
+{
+    default_edge edge{weights_ ? weights_[idx] : 0.0};
+    edge.src = incoming_ ? ids_[idx] : id_;
+    edge.dest = incoming_ ? id_ : ids_[idx];
+    return {ids_[idx], edge};
+}
+
+default_node disk_graph::const_iterator::operator*() const
+{
+    default_node node;
+    node.id = id_;
+    return node;
+}
+
+disk_graph::disk_graph(const std::string& prefix)
+{
+    if (!exists(prefix))
+        throw disk_graph_exception{"no graph found in " + prefix};
+
+    std::ifstream header{prefix + "/graph.meta", std::ios::binary};
+    uint8_t directed;
+    uint8_t weighted;
+    io::read_binary(header, directed);
+    io::read_binary(header, weighted);
+    io::read_binary(header, num_edges_);
+    if (!header)
+        throw disk_graph_exception{"graph header is truncated in " + prefix};
+    directed_ = directed;
+    weighted_ = weighted;
+
+    out_ = load_rows(prefix + "/out");
+    if (directed_)
+        in_ = load_rows(prefix + "/in");
+}
+
+bool disk_graph::exists(const std::string& prefix)
+{
+    return filesystem::file_exists(prefix + "/graph.meta");
+}
+
+auto disk_graph::load_rows(const std::string& path) const -> rows
+{
+    rows r;
+    r.offsets = make_unique<util::disk_vector<uint64_t>>(path + ".offsets");
+    if (r.offsets->size() == 0)
+        throw disk_graph_exception{"graph offsets are missing in " + path};
+
+    auto num_entries = (*r.offsets)[r.offsets->size() - 1];
+    if (num_entries == 0)
+        return r;
+
+    r.neighbors
+        = make_unique<util::disk_vector<node_id>>(path + ".neighbors");
+    if (r.neighbors->size() != num_entries)
+        throw disk_graph_exception{"graph neighbors are truncated in "
+                                   + path};
+
+    if (weighted_)
+    {
+        r.weights = make_unique<util::disk_vector<double>>(path + ".weights");
+        if (r.weights->size() != num_entries)
+            throw disk_graph_exception{"graph weights are truncated in "
+                                       + path};
+    }
+    return r;
+}
+
+default_node disk_graph::node(node_id id) const
+{
+    if (id >= size())
+        throw disk_graph_exception{"node_id out of range"};
+
+    return *const_iterator{id};
+}
+
+util::optional<default_edge> disk_graph::edge(node_id source,
+                                              node_id dest) const
+{
+    auto adj = adjacent(source);
+    if (dest >= size())
+        throw disk_graph_exception{"node_id out of range"};
+
+    // rows are sorted, so the neighbor can be found by binary search
+    uint64_t first = 0;
+    uint64_t last = adj.size();
+    while (first < last)
+    {
+        auto mid = first + (last - first) / 2;
+        if (adj[mid].first < dest)
+            first = mid + 1;
+        else
+            last = mid;
+    }
+    if (first < adj.size() && adj[first].first == dest)
+        return util::optional<default_edge>{adj[first].second};
+
+    return util::optional<default_edge>{util::nullopt};
+}
+
+auto disk_graph::adjacent(node_id id) const -> adjacency_range
+{
+    return row(out_, id, false);
+}
+
+auto disk_graph::incoming(node_id id) const -> adjacency_range
+{
+    if (!directed_)
+        return adjacent(id);
+    return row(in_, id, true);
+}
+
+auto disk_graph::row(const rows& r, node_id id, bool incoming) const
+    -> adjacency_range
+{
+    if (id >= size())
+        throw disk_graph_exception{"node_id out of range"};
+
+    auto begin = (*r.offsets)[id];
+    auto length = (*r.offsets)[id + 1] - begin;
+    if (length == 0)
+        return {id, nullptr, nullptr, 0, incoming};
+
+    return {id, &(*r.neighbors)[begin],
+            r.weights ? &(*r.weights)[begin] : nullptr, length, incoming};
+}
+
+void disk_graph::prefault() const
+{
+    for (const auto* r : {&out_, &in_})
+    {
+        if (r->offsets)
+            r->offsets->prefault();
+        if (r->neighbors)
+            r->neighbors->prefault();
+        if (r->weights)
+            r->weights->prefault();
+    }
+}
+}
+}
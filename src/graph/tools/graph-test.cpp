@@ -14,6 +14,8 @@
 #include "util/progress.h"
 #include "graph/undirected_graph.h"
 #include "graph/directed_graph.h"
+#include "graph/compressed_graph.h"
+#include "graph/disk_graph.h"
 #include "graph/algorithms/algorithms.h"
 #include "logging/logger.h"
 
@@ -170,9 +172,18 @@ void simulations()
 void hybrid(const std::string& graph_file)
 {
     using namespace graph;
-    auto g = undirected_graph<>::load(graph_file);
+
+    // the text is only parsed the first time; the graph is then saved
+    // next to it and memory-mapped on later runs
+    auto prefix = graph_file + ".graph";
+    if (!disk_graph::exists(prefix))
+    {
+        compressed_graph<> cg{undirected_graph<>::load(graph_file)};
+        disk_graph::save(cg, prefix);
+    }
+    disk_graph g{prefix};
     std::vector<uint64_t> counts(g.size(), 0);
-    for (auto& n : g)
+    for (const auto& n : g)
         ++counts[g.adjacent(n.id).size()];
 
     std::ofstream out{"degrees.txt"};
@@ -0,0 +1,306 @@
+/**
+ * @file completion_index.cpp
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+#include "cpptoml.h"
+#include "index/completion_index.h"
+#include "index/inverted_index.h"
+#include "index/vocabulary_map.h"
+#include "io/binary.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/// The first word of a completion index file
+const uint64_t magic = 0x434f4d504c455445; // "COMPLETE"
+
+/// The number of children of each node of the tree
+const uint64_t fanout = 64;
+
+/**
+ * @param idx An index
+ * @return the path of its completion index
+ */
+std::string completions_path(const inverted_index& idx)
+{
+    return idx.index_name() + "/completions";
+}
+
+/**
+ * Reads the counts of a query log.
+ * @param path The log, a line per query with an optional tab and count
+ * @return the count of each distinct query
+ */
+std::unordered_map<std::string, uint64_t>
+    read_query_log(const std::string& path)
+{
+    std::ifstream in{path};
+    if (!in)
+        throw completion_index_exception{"cannot read query log " + path};
+
+    std::unordered_map<std::string, uint64_t> counts;
+    std::string line;
+    while (std::getline(in, line))
+    {
+        uint64_t count = 1;
+        auto tab = line.rfind('\t');
+        if (tab != std::string::npos)
+        {
+            try
+            {
+                count = std::stoull(line.substr(tab + 1));
+                line.resize(tab);
+            }
+            catch (const std::exception&)
+            {
+                // the tab is part of the query
+            }
+        }
+        if (!line.empty())
+            counts[line] += count;
+    }
+    return counts;
+}
+
+/**
+ * A node of the tree, ranked by its heaviest term.
+ */
+struct ranked_node
+{
+    /// The weight of the heaviest term the node covers
+    uint64_t weight;
+    /// The heaviest term the node covers
+    uint64_t term;
+    /// The level of the node
+    uint64_t level;
+    /// The position of the node in its level
+    uint64_t node;
+
+    /// Whether this node ranks below another
+    bool operator<(const ranked_node& other) const
+    {
+        if (weight != other.weight)
+            return weight < other.weight;
+        return term > other.term;
+    }
+};
+}
+
+void completion_index::build(const inverted_index& idx,
+                             const completion_options& options)
+{
+    auto num_terms = idx.unique_terms();
+    std::vector<uint64_t> weights(num_terms);
+    for (term_id t_id{0}; t_id < num_terms; ++t_id)
+    {
+        weights[t_id] = options.weight == completion_weight::doc_freq
+                            ? idx.doc_freq(t_id)
+                            : idx.total_num_occurences(t_id);
+    }
+
+    // the query counts take the high half of each weight, so that they
+    // rank first and the index's weights break their ties
+    if (!options.query_log.empty())
+    {
+        auto counts = read_query_log(options.query_log);
+        std::vector<std::string> queries;
+        std::vector<uint64_t> query_counts;
+        for (const auto& entry : counts)
+        {
+            queries.push_back(entry.first);
+            query_counts.push_back(entry.second);
+        }
+        std::vector<uint64_t> logged(num_terms, 0);
+        auto ids = idx.vocabulary().find_all(queries);
+        for (uint64_t i = 0; i < ids.size(); ++i)
+        {
+            if (ids[i])
+                logged[*ids[i]] += query_counts[i];
+        }
+
+        const uint64_t low_max = std::numeric_limits<uint32_t>::max();
+        for (uint64_t t = 0; t < num_terms; ++t)
+            weights[t] = (std::min(logged[t], low_max) << 32)
+                         | std::min(weights[t], low_max);
+    }
+
+    // each level holds the heaviest term of every fanout nodes below it,
+    // the lowest id among equals, until a level has at most fanout nodes
+    std::vector<std::vector<uint64_t>> levels;
+    std::vector<uint64_t> below(num_terms);
+    for (uint64_t t = 0; t < num_terms; ++t)
+        below[t] = t;
+    while (below.size() > fanout)
+    {
+        std::vector<uint64_t> level((below.size() + fanout - 1) / fanout);
+        for (uint64_t i = 0; i < level.size(); ++i)
+        {
+            auto first = i * fanout;
+            auto last = std::min(first + fanout, below.size());
+            auto best = below[first];
+            for (auto j = first + 1; j < last; ++j)
+            {
+                if (weights[below[j]] > weights[best])
+                    best = below[j];
+            }
+            level[i] = best;
+        }
+        levels.push_back(level);
+        below = std::move(level);
+    }
+
+    auto path = completions_path(idx);
+    std::ofstream out{path, std::ios::binary};
+    io::write_binary(out, magic);
+    io::write_binary(out, num_terms);
+    io::write_binary(out, static_cast<uint64_t>(levels.size()));
+    for (const auto& level : levels)
+        io::write_binary(out, static_cast<uint64_t>(level.size()));
+    out.write(reinterpret_cast<const char*>(weights.data()),
+              static_cast<std::streamsize>(sizeof(uint64_t) * num_terms));
+    for (const auto& level : levels)
+        out.write(reinterpret_cast<const char*>(level.data()),
+                  static_cast<std::streamsize>(sizeof(uint64_t)
+                                               * level.size()));
+    if (!out)
+        throw completion_index_exception{"failed to write " + path};
+}
+
+bool completion_index::exists(const inverted_index& idx)
+{
+    return filesystem::file_exists(completions_path(idx));
+}
+
+completion_index::completion_index(const inverted_index& idx)
+    : vocab_{&idx.vocabulary()}, file_{completions_path(idx)}
+{
+    auto words = reinterpret_cast<const uint64_t*>(file_.begin());
+    auto size = file_.size() / sizeof(uint64_t);
+    if (size < 3 || words[0] != magic || size < 3 + words[2])
+        throw completion_index_exception{"invalid completion index in "
+                                         + idx.index_name()};
+
+    num_terms_ = words[1];
+    auto num_levels = words[2];
+    sizes_.push_back(num_terms_);
+    for (uint64_t l = 0; l < num_levels; ++l)
+        sizes_.push_back(words[3 + l]);
+
+    uint64_t pos = 3 + num_levels;
+    weights_ = words + pos;
+    pos += num_terms_;
+    levels_.push_back(nullptr);
+    for (uint64_t l = 1; l < sizes_.size(); ++l)
+    {
+        levels_.push_back(words + pos);
+        pos += sizes_[l];
+    }
+    if (pos != size || num_terms_ != idx.unique_terms())
+        throw completion_index_exception{"stale completion index in "
+                                         + idx.index_name()};
+}
+
+uint64_t completion_index::best(uint64_t level, uint64_t node) const
+{
+    return level == 0 ? node : levels_[level][node];
+}
+
+std::vector<std::pair<term_id, uint64_t>>
+    completion_index::top_terms(term_id first, term_id last, uint64_t n) const
+{
+    std::priority_queue<ranked_node> heap;
+    auto push = [&](uint64_t level, uint64_t lo, uint64_t hi)
+    {
+        for (auto i = lo; i < hi; ++i)
+        {
+            auto term = best(level, i);
+            heap.push({weights_[term], term, level, i});
+        }
+    };
+
+    // cover [first, last) with the largest nodes that fit in it: the
+    // ragged ends of each level, then the whole nodes of the level above
+    uint64_t lo = std::min<uint64_t>(first, num_terms_);
+    uint64_t hi = std::min<uint64_t>(last, num_terms_);
+    for (uint64_t level = 0; lo < hi; ++level)
+    {
+        auto up_lo = (lo + fanout - 1) / fanout;
+        auto up_hi = hi / fanout;
+        if (level + 1 == sizes_.size() || up_lo >= up_hi)
+        {
+            push(level, lo, hi);
+            break;
+        }
+        push(level, lo, up_lo * fanout);
+        push(level, up_hi * fanout, hi);
+        lo = up_lo;
+        hi = up_hi;
+    }
+
+    std::vector<std::pair<term_id, uint64_t>> results;
+    while (results.size() < n && !heap.empty())
+    {
+        auto top = heap.top();
+        heap.pop();
+        if (top.level == 0)
+        {
+            results.emplace_back(term_id{top.term}, top.weight);
+            continue;
+        }
+        auto child_lo = top.node * fanout;
+        push(top.level - 1, child_lo,
+             std::min(child_lo + fanout, sizes_[top.level - 1]));
+    }
+    return results;
+}
+
+std::vector<std::pair<std::string, uint64_t>>
+    completion_index::complete(const std::string& prefix, uint64_t n) const
+{
+    auto range = vocab_->prefix_range(prefix);
+    std::vector<std::pair<std::string, uint64_t>> results;
+    for (const auto& term : top_terms(range.first, range.second, n))
+        results.emplace_back(vocab_->find_term(term.first), term.second);
+    return results;
+}
+
+uint64_t completion_index::weight(term_id t_id) const
+{
+    return weights_[t_id];
+}
+
+util::memory_usage completion_index::memory_usage() const
+{
+    return file_.memory_usage();
+}
+
+completion_options make_completion_options(const cpptoml::table& config)
+{
+    completion_options options;
+    if (auto weight = config.get_as<std::string>("autocomplete-weight"))
+    {
+        if (*weight == "term-count")
+            options.weight = completion_weight::term_count;
+        else if (*weight == "doc-freq")
+            options.weight = completion_weight::doc_freq;
+        else
+            throw completion_index_exception{"unknown completion weight: "
+                                             + *weight};
+    }
+    if (auto log = config.get_as<std::string>("autocomplete-log"))
+        options.query_log = *log;
+    return options;
+}
+}
+}
@@ -0,0 +1,87 @@
+/**
+ * @file csr_matrix.cpp
+ */
+
+#include "index/csr_matrix.h"
+
+namespace meta
+{
+namespace index
+{
+
+csr_matrix::csr_matrix() : offsets_{0}, terms_{nullptr}, values_{nullptr}
+{
+    // nothing
+}
+
+csr_matrix::csr_matrix(std::vector<doc_id> docs, std::vector<uint64_t> offsets,
+                       std::vector<uint32_t> terms, std::vector<float> values)
+    : docs_{std::move(docs)},
+      offsets_{std::move(offsets)},
+      terms_mem_{std::move(terms)},
+      values_mem_{std::move(values)},
+      terms_{terms_mem_.data()},
+      values_{values_mem_.data()}
+{
+    if (offsets_.size() != docs_.size() + 1 || offsets_.back() != terms_mem_.size()
+        || values_mem_.size() != terms_mem_.size())
+        throw csr_matrix_exception{"inconsistent csr_matrix sizes"};
+}
+
+csr_matrix::csr_matrix(std::vector<doc_id> docs, std::vector<uint64_t> offsets,
+                       const std::string& prefix)
+    : docs_{std::move(docs)},
+      offsets_{std::move(offsets)},
+      terms_{nullptr},
+      values_{nullptr}
+{
+    if (offsets_.size() != docs_.size() + 1)
+        throw csr_matrix_exception{"inconsistent csr_matrix sizes"};
+
+    // files without any pairs cannot be mapped
+    if (offsets_.back() == 0)
+        return;
+    terms_file_ = util::disk_vector<uint32_t>{prefix + ".terms"};
+    values_file_ = util::disk_vector<float>{prefix + ".values"};
+    if (terms_file_->size() != offsets_.back()
+        || values_file_->size() != offsets_.back())
+        throw csr_matrix_exception{"csr_matrix files at " + prefix
+                                   + " do not match their rows"};
+    terms_ = &(*terms_file_)[0];
+    values_ = &(*values_file_)[0];
+}
+
+doc_id csr_matrix::doc(uint64_t r) const
+{
+    return docs_[r];
+}
+
+uint64_t csr_matrix::rows() const
+{
+    return docs_.size();
+}
+
+uint64_t csr_matrix::nonzeros() const
+{
+    return offsets_.back();
+}
+
+bool csr_matrix::mapped() const
+{
+    return static_cast<bool>(terms_file_);
+}
+
+util::memory_usage csr_matrix::memory_usage() const
+{
+    auto usage = util::heap_memory(docs_);
+    usage += util::heap_memory(offsets_);
+    usage += util::heap_memory(terms_mem_);
+    usage += util::heap_memory(values_mem_);
+    if (terms_file_)
+        usage += terms_file_->memory_usage();
+    if (values_file_)
+        usage += values_file_->memory_usage();
+    return usage;
+}
+}
+}
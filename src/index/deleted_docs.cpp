@@ -0,0 +1,129 @@
+/**
+ * @file deleted_docs.cpp
+ */
+
+#include <bitset>
+#include <fstream>
+
+#include "index/deleted_docs.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace index
+{
+
+deleted_docs::deleted_docs(const std::string& path, uint64_t num_docs)
+    : path_{path},
+      num_docs_{num_docs},
+      num_words_{(num_docs + 63) / 64},
+      words_{new std::atomic<uint64_t>[num_words_]},
+      size_{0}
+{
+    for (uint64_t i = 0; i < num_words_; ++i)
+        words_[i].store(0, std::memory_order_relaxed);
+
+    if (!filesystem::file_exists(path_))
+        return;
+
+    if (filesystem::file_size(path_) != num_words_ * sizeof(uint64_t))
+        throw deleted_docs_exception{"deleted documents file " + path_
+                                     + " does not match the index"};
+
+    std::vector<uint64_t> words(num_words_);
+    std::ifstream in{path_, std::ios::binary};
+    in.read(reinterpret_cast<char*>(words.data()),
+            static_cast<std::streamsize>(words.size() * sizeof(uint64_t)));
+    if (!in)
+        throw deleted_docs_exception{"failed to read " + path_};
+
+    uint64_t size = 0;
+    for (uint64_t i = 0; i < num_words_; ++i)
+    {
+        words_[i].store(words[i], std::memory_order_relaxed);
+        size += std::bitset<64>{words[i]}.count();
+    }
+    size_.store(size);
+}
+
+bool deleted_docs::insert(doc_id d_id)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    if (!set(d_id))
+        return false;
+    save();
+    return true;
+}
+
+uint64_t deleted_docs::insert(const std::vector<doc_id>& ids)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    uint64_t num_set = 0;
+    for (const auto& d_id : ids)
+    {
+        if (set(d_id))
+            ++num_set;
+    }
+    if (num_set > 0)
+        save();
+    return num_set;
+}
+
+bool deleted_docs::set(doc_id d_id)
+{
+    if (d_id >= num_docs_)
+        throw deleted_docs_exception{"doc_id out of range: "
+                                     + std::to_string(d_id)};
+
+    auto bit = uint64_t{1} << (d_id % 64);
+    auto& word = words_[d_id / 64];
+    if (word.load(std::memory_order_relaxed) & bit)
+        return false;
+
+    word.fetch_or(bit, std::memory_order_relaxed);
+    ++size_;
+    return true;
+}
+
+void deleted_docs::save() const
+{
+    // the bitmap is small next to the index, so it is rewritten whole and
+    // swapped in, which never leaves a torn file behind
+    std::vector<uint64_t> words(num_words_);
+    for (uint64_t i = 0; i < num_words_; ++i)
+        words[i] = words_[i].load(std::memory_order_relaxed);
+
+    {
+        std::ofstream out{path_ + ".tmp", std::ios::binary};
+        out.write(reinterpret_cast<const char*>(words.data()),
+                  static_cast<std::streamsize>(words.size()
+                                               * sizeof(uint64_t)));
+        if (!out)
+            throw deleted_docs_exception{"failed to write " + path_};
+    }
+    filesystem::rename_file(path_ + ".tmp", path_);
+}
+
+util::memory_usage deleted_docs::memory_usage() const
+{
+    util::memory_usage usage;
+    usage.heap_bytes = num_words_ * sizeof(std::atomic<uint64_t>);
+    return usage;
+}
+
+uint64_t deleted_docs::size() const
+{
+    return size_.load();
+}
+
+bool deleted_docs::empty() const
+{
+    return size() == 0;
+}
+
+uint64_t deleted_docs::num_docs() const
+{
+    return num_docs_;
+}
+}
+}
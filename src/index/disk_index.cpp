@@ -5,6 +5,7 @@
 
 #include <numeric>
 
+#include "cpptoml.h"
 #include "index/disk_index.h"
 #include "index/disk_index_impl.h"
 #include "index/string_list.h"
@@ -12,18 +13,35 @@
 #include "index/vocabulary_map.h"
 #include "analyzers/analyzer.h"
 #include "util/disk_vector.h"
+#include "util/filesystem.h"
 #include "util/mapping.h"
 #include "util/optional.h"
 #include "util/pimpl.tcc"
+#include "util/shim.h"
 
 namespace meta
 {
 namespace index
 {
 
-disk_index::disk_index(const cpptoml::table&, const std::string& name)
+disk_index::disk_index(const cpptoml::table& config, const std::string& name)
 {
     impl_->index_name_ = name;
+    if (auto res = config.get_as<std::string>("index-residency"))
+        impl_->residency_ = io::parse_residency(*res);
+    impl_->field_specs_ = parse_field_specs(config);
+    if (auto budget = config.get_as<int64_t>("indexer-ram-budget"))
+    {
+        if (*budget > 0)
+            impl_->ram_budget_ = static_cast<uint64_t>(*budget) * 1024 * 1024;
+    }
+    if (auto size = config.get_as<int64_t>("term-id-cache-size"))
+    {
+        if (*size > 0)
+            impl_->term_id_cache_ = make_unique<
+                caching::default_dblru_cache<std::string, term_id>>(
+                static_cast<uint64_t>(*size));
+    }
 }
 
 std::string disk_index::index_name() const
@@ -33,14 +51,54 @@ std::string disk_index::index_name() const
 
 term_id disk_index::get_term_id(const std::string& term)
 {
-    std::lock_guard<std::mutex> lock{impl_->mutex_};
+    auto& cache = impl_->term_id_cache_;
+    if (cache)
+    {
+        if (auto t_id = cache->find(term))
+            return *t_id;
+    }
+
+    term_id t_id{impl_->term_id_mapping_->size()};
+    if (auto found = impl_->term_id_mapping_->find(term))
+        t_id = *found;
+    if (cache)
+        cache->insert(term, t_id);
+    return t_id;
+}
+
+std::vector<term_id>
+    disk_index::get_term_ids(const std::vector<std::string>& terms)
+{
+    const auto& vocab = *impl_->term_id_mapping_;
+    auto& cache = impl_->term_id_cache_;
+    std::vector<term_id> ids(terms.size(), term_id{vocab.size()});
 
-    auto termID = impl_->term_id_mapping_->find(term);
-    if (termID)
-        return term_id{*termID};
+    // only the terms missing from the cache go to the vocabulary
+    std::vector<uint64_t> missing;
+    std::vector<std::string> missing_terms;
+    for (uint64_t i = 0; i < terms.size(); ++i)
+    {
+        if (cache)
+        {
+            if (auto t_id = cache->find(terms[i]))
+            {
+                ids[i] = *t_id;
+                continue;
+            }
+        }
+        missing.push_back(i);
+        missing_terms.push_back(terms[i]);
+    }
 
-    uint64_t size = impl_->term_id_mapping_->size();
-    return term_id{size};
+    auto found = vocab.find_all(missing_terms);
+    for (uint64_t i = 0; i < missing.size(); ++i)
+    {
+        if (found[i])
+            ids[missing[i]] = *found[i];
+        if (cache)
+            cache->insert(missing_terms[i], ids[missing[i]]);
+    }
+    return ids;
 }
 
 class_label disk_index::label(doc_id d_id) const
@@ -55,17 +113,17 @@ label_id disk_index::lbl_id(doc_id d_id) const
 
 label_id disk_index::id(class_label label) const
 {
-    return impl_->label_ids_.get_value(label);
+    return impl_->label_ids().get_value(label);
 }
 
 class_label disk_index::class_label_from_id(label_id l_id) const
 {
-    return impl_->label_ids_.get_key(l_id);
+    return impl_->label_ids().get_key(l_id);
 }
 
 uint64_t disk_index::num_labels() const
 {
-    return impl_->label_ids_.size();
+    return impl_->label_ids().size();
 }
 
 std::vector<class_label> disk_index::class_labels() const
@@ -75,6 +133,8 @@ std::vector<class_label> disk_index::class_labels() const
 
 uint64_t disk_index::unique_terms(doc_id d_id) const
 {
+    if (impl_->doc_metadata_)
+        return impl_->doc_metadata_->unique_terms(d_id);
     return impl_->unique_terms_->at(d_id);
 }
 
@@ -85,9 +145,32 @@ uint64_t disk_index::unique_terms() const
 
 uint64_t disk_index::doc_size(doc_id d_id) const
 {
+    if (impl_->doc_metadata_)
+        return impl_->doc_metadata_->length(d_id);
     return impl_->doc_sizes_->at(d_id);
 }
 
+bool disk_index::has_fields() const
+{
+    return static_cast<bool>(impl_->fields_);
+}
+
+const field_store& disk_index::fields() const
+{
+    if (!impl_->fields_)
+        throw field_store::field_store_exception{"index has no fields: "
+                                                 + impl_->index_name_};
+    return *impl_->fields_;
+}
+
+doc_metadata::record disk_index::doc_info(doc_id d_id) const
+{
+    if (impl_->doc_metadata_)
+        return impl_->doc_metadata_->at(d_id);
+    return {static_cast<uint64_t>(impl_->doc_sizes_->at(d_id)),
+            impl_->unique_terms_->at(d_id)};
+}
+
 uint64_t disk_index::num_docs() const
 {
     return impl_->doc_sizes_->size();
@@ -101,12 +184,42 @@ std::string disk_index::doc_name(doc_id d_id) const
 
 std::string disk_index::doc_path(doc_id d_id) const
 {
-    return impl_->doc_id_mapping_->at(d_id);
+    return impl_->doc_id_mapping().at(d_id);
+}
+
+void disk_index::delete_doc(doc_id d_id)
+{
+    impl_->deleted_->insert(d_id);
+}
+
+void disk_index::delete_docs(const std::vector<doc_id>& ids)
+{
+    impl_->deleted_->insert(ids);
+}
+
+bool disk_index::is_deleted(doc_id d_id) const
+{
+    return impl_->deleted_->contains(d_id);
+}
+
+uint64_t disk_index::num_deleted() const
+{
+    return impl_->deleted_->size();
+}
+
+const deleted_docs& disk_index::deleted() const
+{
+    return *impl_->deleted_;
+}
+
+void disk_index::advise_postings(io::access_pattern pattern) const
+{
+    impl_->postings().advise(pattern);
 }
 
 std::vector<doc_id> disk_index::docs() const
 {
-    std::vector<doc_id> ret(impl_->doc_id_mapping_->size());
+    std::vector<doc_id> ret(impl_->doc_id_mapping().size());
     std::iota(ret.begin(), ret.end(), 0);
     return ret;
 }
@@ -120,6 +233,7 @@ const std::vector<const char*> disk_index::disk_index_impl::files
 
 label_id disk_index::disk_index_impl::get_label_id(const class_label& lbl)
 {
+    label_ids();
     std::lock_guard<std::mutex> lock{mutex_};
     if (!label_ids_.contains_key(lbl))
     {
@@ -137,6 +251,12 @@ void disk_index::disk_index_impl::initialize_metadata(uint64_t num_docs)
     load_doc_sizes(num_docs);
     load_labels(num_docs);
     load_unique_terms(num_docs);
+    load_deleted_docs(num_docs);
+    if (num_docs == 0)
+    {
+        load_doc_metadata();
+        load_fields();
+    }
 }
 
 void disk_index::disk_index_impl::load_doc_sizes(uint64_t num_docs)
@@ -157,9 +277,67 @@ void disk_index::disk_index_impl::load_unique_terms(uint64_t num_docs)
         index_name_ + files[DOC_UNIQUETERMS], num_docs};
 }
 
+void disk_index::disk_index_impl::load_deleted_docs(uint64_t num_docs)
+{
+    auto path = index_name_ + "/docs.deleted";
+    if (num_docs != 0)
+        filesystem::delete_file(path);
+    deleted_ = make_unique<deleted_docs>(path, doc_sizes_->size());
+}
+
+void disk_index::disk_index_impl::load_doc_metadata(bool rebuild)
+{
+    auto path = index_name_ + "/docs.metadata";
+    doc_metadata_ = util::nullopt;
+    if (!rebuild && filesystem::file_exists(path))
+    {
+        try
+        {
+            doc_metadata meta{path};
+            if (meta.size() == doc_sizes_->size())
+            {
+                doc_metadata_ = std::move(meta);
+                return;
+            }
+        }
+        catch (doc_metadata::doc_metadata_exception&)
+        {
+            // the file is rewritten below
+        }
+    }
+    doc_metadata::write(path, *doc_sizes_, *unique_terms_);
+    doc_metadata_ = doc_metadata{path};
+}
+
+void disk_index::disk_index_impl::load_fields()
+{
+    auto dir = index_name_ + "/fields";
+    if (filesystem::file_exists(dir + "/schema"))
+        fields_ = field_store{dir};
+    else
+        fields_ = util::nullopt;
+}
+
+std::unique_ptr<field_store_writer>
+    disk_index::disk_index_impl::make_field_writer(uint64_t num_docs) const
+{
+    auto dir = index_name_ + "/fields";
+    filesystem::remove_all(dir);
+    if (field_specs_.empty())
+        return nullptr;
+    return make_unique<field_store_writer>(dir, field_specs_, num_docs);
+}
+
+const std::vector<field_spec>&
+    disk_index::disk_index_impl::field_specs() const
+{
+    return field_specs_;
+}
+
 void disk_index::disk_index_impl::load_doc_id_mapping()
 {
-    doc_id_mapping_ = string_list{index_name_ + files[DOC_IDS_MAPPING]};
+    std::lock_guard<std::mutex> lock{lazy_mutex_};
+    doc_id_mapping_ = util::nullopt;
 }
 
 void disk_index::disk_index_impl::load_term_id_mapping()
@@ -169,17 +347,60 @@ void disk_index::disk_index_impl::load_term_id_mapping()
 
 void disk_index::disk_index_impl::load_label_id_mapping()
 {
-    map::load_mapping(label_ids_, index_name_ + files[LABEL_IDS_MAPPING]);
+    std::lock_guard<std::mutex> lock{lazy_mutex_};
+    label_ids_pending_ = true;
+}
+
+const string_list& disk_index::disk_index_impl::doc_id_mapping() const
+{
+    std::lock_guard<std::mutex> lock{lazy_mutex_};
+    if (!doc_id_mapping_)
+        doc_id_mapping_ = string_list{index_name_ + files[DOC_IDS_MAPPING]};
+    return *doc_id_mapping_;
+}
+
+const util::invertible_map<class_label, label_id>&
+    disk_index::disk_index_impl::label_ids() const
+{
+    std::lock_guard<std::mutex> lock{lazy_mutex_};
+    if (label_ids_pending_)
+    {
+        map::load_mapping(label_ids_, index_name_ + files[LABEL_IDS_MAPPING]);
+        label_ids_pending_ = false;
+    }
+    return label_ids_;
 }
 
 void disk_index::disk_index_impl::load_postings()
 {
-    postings_ = io::mmap_file{index_name_ + files[POSTINGS]};
+    postings_ = io::mmap_file{index_name_ + files[POSTINGS], residency_};
+}
+
+void disk_index::disk_index_impl::prefault_metadata() const
+{
+    if (residency_ == io::residency::on_demand)
+        return;
+    labels_->prefault();
+    // the rankers read the packed copy of the sizes and unique terms
+    if (doc_metadata_)
+    {
+        doc_metadata_->prefault();
+    }
+    else
+    {
+        doc_sizes_->prefault();
+        unique_terms_->prefault();
+    }
+}
+
+io::residency disk_index::disk_index_impl::residency() const
+{
+    return residency_;
 }
 
 void disk_index::disk_index_impl::save_label_id_mapping()
 {
-    map::save_mapping(label_ids_, index_name_ + files[LABEL_IDS_MAPPING]);
+    map::save_mapping(label_ids(), index_name_ + files[LABEL_IDS_MAPPING]);
 }
 
 string_list_writer
@@ -221,17 +442,70 @@ label_id disk_index::disk_index_impl::doc_label_id(doc_id id) const
 std::vector<class_label> disk_index::disk_index_impl::class_labels() const
 {
     std::vector<class_label> labels;
-    labels.reserve(label_ids_.size());
-    for (const auto& pair : label_ids_)
+    const auto& ids = label_ids();
+    labels.reserve(ids.size());
+    for (const auto& pair : ids)
         labels.emplace_back(pair.first);
     return labels;
 }
 
+uint64_t disk_index::disk_index_impl::ram_budget() const
+{
+    return ram_budget_;
+}
+
 std::string disk_index::term_text(term_id t_id) const
 {
     if (t_id >= impl_->term_id_mapping_->size())
         return "";
     return impl_->term_id_mapping_->find_term(t_id);
 }
+
+const vocabulary_map& disk_index::vocabulary() const
+{
+    return *impl_->term_id_mapping_;
+}
+
+util::memory_report disk_index::memory_usage() const
+{
+    util::memory_report report;
+    if (impl_->postings_)
+        report.add("postings", impl_->postings_->memory_usage());
+    if (impl_->term_id_mapping_)
+        report.add("lexicon", impl_->term_id_mapping_->memory_usage());
+    if (impl_->term_id_cache_)
+    {
+        util::memory_usage usage;
+        usage.heap_bytes = impl_->term_id_cache_->stats().bytes;
+        report.add("term-id-cache", usage);
+    }
+
+    util::memory_usage metadata;
+    {
+        std::lock_guard<std::mutex> lock{impl_->lazy_mutex_};
+        if (impl_->doc_id_mapping_)
+            metadata += impl_->doc_id_mapping_->memory_usage();
+    }
+    if (impl_->doc_sizes_)
+        metadata += impl_->doc_sizes_->memory_usage();
+    if (impl_->labels_)
+        metadata += impl_->labels_->memory_usage();
+    if (impl_->unique_terms_)
+        metadata += impl_->unique_terms_->memory_usage();
+    if (impl_->doc_metadata_)
+        metadata += impl_->doc_metadata_->memory_usage();
+    if (impl_->deleted_)
+        metadata += impl_->deleted_->memory_usage();
+    report.add("doc-metadata", metadata);
+
+    if (impl_->fields_)
+        report.add("fields", impl_->fields_->memory_usage());
+    return report;
+}
+
+bool disk_index::caches_postings() const
+{
+    return false;
+}
 }
 }
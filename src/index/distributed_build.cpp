@@ -0,0 +1,242 @@
+/**
+ * @file distributed_build.cpp
+ */
+
+#include <fstream>
+
+#include "cpptoml.h"
+#include "index/distributed_build.h"
+#include "index/inverted_index.h"
+#include "index/merging.h"
+#include "io/binary.h"
+#include "logging/logger.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/// The first word of a plan file
+const uint64_t magic = 0x4255494c44504c4e; // "BUILDPLN"
+
+/**
+ * @param config The configuration of the index
+ * @return the name of the index
+ */
+std::string index_name(const cpptoml::table& config)
+{
+    auto name = config.get_as<std::string>("inverted-index");
+    if (!name)
+        throw distributed_build_exception{"inverted-index missing from "
+                                          "configuration file"};
+    return *name;
+}
+
+/**
+ * @param config_file The configuration of the index
+ * @return the path of its plan
+ */
+std::string plan_path(const std::string& config_file)
+{
+    return index_name(cpptoml::parse_file(config_file)) + ".plan";
+}
+
+/**
+ * @param part The directory of a part
+ * @return the configuration that names the part's index, which is
+ * written once the part is built
+ */
+std::string part_config(const std::string& part)
+{
+    return part + "/part.toml";
+}
+
+/**
+ * @param config_file The configuration of the index
+ * @return the corpus of the configuration, which must be a line corpus
+ */
+std::unique_ptr<corpus::line_corpus> load_line_corpus(
+    const std::string& config_file)
+{
+    auto docs = corpus::corpus::load(config_file);
+    if (!dynamic_cast<corpus::line_corpus*>(docs.get()))
+        throw distributed_build_exception{"only a line corpus can be "
+                                          "partitioned"};
+    return std::unique_ptr<corpus::line_corpus>{
+        static_cast<corpus::line_corpus*>(docs.release())};
+}
+}
+
+build_plan plan_build(const std::string& config_file, uint64_t num_parts)
+{
+    if (num_parts == 0)
+        throw distributed_build_exception{"a plan needs at least one part"};
+
+    auto docs = load_line_corpus(config_file);
+    build_plan plan;
+    plan.num_docs = docs->size();
+    plan.parts = docs->partitions(num_parts);
+
+    auto path = plan_path(config_file);
+    std::ofstream out{path, std::ios::binary};
+    io::write_binary(out, magic);
+    io::write_binary(out, plan.num_docs);
+    io::write_binary(out, static_cast<uint64_t>(plan.parts.size()));
+    for (const auto& part : plan.parts)
+    {
+        io::write_binary(out, static_cast<uint64_t>(part.first_id));
+        io::write_binary(out, part.num_docs);
+        io::write_binary(out, part.begin);
+        io::write_binary(out, part.end);
+        io::write_binary(out, part.labels_begin);
+        io::write_binary(out, part.names_begin);
+    }
+    if (!out)
+        throw distributed_build_exception{"failed to write " + path};
+
+    LOG(info) << "Split " << plan.num_docs << " documents into "
+              << plan.parts.size() << " parts: " << path << ENDLG;
+    return plan;
+}
+
+build_plan load_build_plan(const std::string& config_file)
+{
+    auto path = plan_path(config_file);
+    std::ifstream in{path, std::ios::binary};
+    uint64_t word = 0;
+    io::read_binary(in, word);
+    if (!in || word != magic)
+        throw distributed_build_exception{"no build plan at " + path};
+
+    build_plan plan;
+    uint64_t num_parts;
+    io::read_binary(in, plan.num_docs);
+    io::read_binary(in, num_parts);
+    for (uint64_t i = 0; i < num_parts && in; ++i)
+    {
+        corpus::line_corpus::partition part;
+        uint64_t first_id;
+        io::read_binary(in, first_id);
+        part.first_id = doc_id{first_id};
+        io::read_binary(in, part.num_docs);
+        io::read_binary(in, part.begin);
+        io::read_binary(in, part.end);
+        io::read_binary(in, part.labels_begin);
+        io::read_binary(in, part.names_begin);
+        plan.parts.push_back(part);
+    }
+    if (!in)
+        throw distributed_build_exception{"truncated build plan at " + path};
+    return plan;
+}
+
+std::string part_name(const std::string& config_file, uint64_t part)
+{
+    return index_name(cpptoml::parse_file(config_file)) + ".part-"
+           + std::to_string(part);
+}
+
+std::shared_ptr<inverted_index> build_part(const std::string& config_file,
+                                           uint64_t part)
+{
+    auto plan = load_build_plan(config_file);
+    if (part >= plan.parts.size())
+        throw distributed_build_exception{"the plan has no part "
+                                          + std::to_string(part)};
+
+    auto docs = load_line_corpus(config_file);
+    if (docs->size() != plan.num_docs)
+        throw distributed_build_exception{"the corpus has changed since "
+                                          "the plan was made"};
+
+    // the part is indexed on its own, so its documents are numbered from
+    // zero; merging puts them back after those of the parts before it
+    auto range = plan.parts[part];
+    range.first_id = doc_id{0};
+    auto part_docs = docs->open(range);
+
+    auto config = cpptoml::parse_file(config_file);
+    auto name = part_name(config_file, part);
+
+    // can't use std::make_shared here since the constructor is protected
+    std::shared_ptr<inverted_index> idx{new inverted_index(config, name)};
+    filesystem::remove_all(name);
+    filesystem::make_directory(name);
+    idx->create_index(config_file, *part_docs);
+
+    // the part's own configuration is written last, so that it marks the
+    // part as built
+    config.insert("inverted-index", name);
+    // the part is complete in itself, so it is never built in checkpoints
+    config.insert("build-checkpoints", int64_t{0});
+    std::ofstream out{part_config(name)};
+    out << config;
+    if (!out)
+        throw distributed_build_exception{"failed to write "
+                                          + part_config(name)};
+    return idx;
+}
+
+bool part_built(const std::string& config_file, uint64_t part)
+{
+    return filesystem::file_exists(
+        part_config(part_name(config_file, part)));
+}
+
+std::vector<std::shared_ptr<inverted_index>>
+    load_parts(const std::string& config_file)
+{
+    auto plan = load_build_plan(config_file);
+    std::vector<std::shared_ptr<inverted_index>> parts;
+    uint64_t num_docs = 0;
+    for (uint64_t i = 0; i < plan.parts.size(); ++i)
+    {
+        if (!part_built(config_file, i))
+            throw distributed_build_exception{"part " + std::to_string(i)
+                                              + " has not been built"};
+        auto config = part_config(part_name(config_file, i));
+        parts.push_back(make_index<inverted_index>(config));
+        num_docs += parts.back()->num_docs();
+    }
+    if (num_docs != plan.num_docs)
+        throw distributed_build_exception{"the parts do not hold the "
+                                          "documents of the plan"};
+    return parts;
+}
+
+std::shared_ptr<inverted_index> merge_parts(const std::string& config_file)
+{
+    return merge_indexes(load_parts(config_file), config_file);
+}
+
+void write_shard_configs(const std::string& config_file,
+                         const std::string& sharded_config)
+{
+    // the parts are opened to check that every one of them is built
+    auto num_parts = load_parts(config_file).size();
+
+    std::ofstream out{sharded_config};
+    for (uint64_t i = 0; i < num_parts; ++i)
+    {
+        out << "[[shards]]\n";
+        out << "config = \"" << part_config(part_name(config_file, i))
+            << "\"\n\n";
+    }
+    if (!out)
+        throw distributed_build_exception{"failed to write "
+                                          + sharded_config};
+}
+
+void remove_build(const std::string& config_file)
+{
+    // the plan goes first: once it is gone, the parts are just leftovers
+    filesystem::delete_file(plan_path(config_file));
+    for (uint64_t i = 0; filesystem::file_exists(part_name(config_file, i));
+         ++i)
+        filesystem::remove_all(part_name(config_file, i));
+}
+}
+}
@@ -0,0 +1,153 @@
+/**
+ * @file doc_metadata.cpp
+ */
+
+#include <algorithm>
+#include <fstream>
+
+#include "index/doc_metadata.h"
+#include "io/binary.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/// The number of words before the first record
+const uint64_t header_words = 3;
+
+/**
+ * @param value A value
+ * @return the number of bits needed to store the value
+ */
+uint64_t bit_width(uint64_t value)
+{
+    uint64_t bits = 0;
+    while (value > 0)
+    {
+        ++bits;
+        value >>= 1;
+    }
+    return bits;
+}
+}
+
+void doc_metadata::write(const std::string& path,
+                         const util::disk_vector<double>& lengths,
+                         const util::disk_vector<uint64_t>& unique_terms)
+{
+    if (lengths.size() != unique_terms.size())
+        throw doc_metadata_exception{
+            "document metadata columns differ in size"};
+
+    uint64_t max_length = 0;
+    uint64_t max_unique = 0;
+    for (uint64_t i = 0; i < lengths.size(); ++i)
+    {
+        max_length
+            = std::max(max_length, static_cast<uint64_t>(lengths[i]));
+        max_unique = std::max(max_unique, unique_terms[i]);
+    }
+    auto length_bits = bit_width(max_length);
+    auto unique_bits = bit_width(max_unique);
+
+    std::ofstream out{path, std::ios::binary};
+    io::write_binary(out, static_cast<uint64_t>(lengths.size()));
+    io::write_binary(out, length_bits);
+    io::write_binary(out, unique_bits);
+
+    // a field's bits start in the current word and may spill into the
+    // next one
+    uint64_t word = 0;
+    uint64_t used = 0;
+    auto append = [&](uint64_t value, uint64_t width)
+    {
+        if (width == 0)
+            return;
+        word |= value << used;
+        if (used + width >= 64)
+        {
+            io::write_binary(out, word);
+            word = used == 0 ? 0 : value >> (64 - used);
+            used = used + width - 64;
+        }
+        else
+        {
+            used += width;
+        }
+    };
+    for (uint64_t i = 0; i < lengths.size(); ++i)
+    {
+        append(static_cast<uint64_t>(lengths[i]), length_bits);
+        append(unique_terms[i], unique_bits);
+    }
+    // one extra word, so a field can always be read from two
+    io::write_binary(out, word);
+    io::write_binary(out, uint64_t{0});
+}
+
+doc_metadata::doc_metadata(const std::string& path) : words_{path}
+{
+    if (words_.size() < header_words)
+        throw doc_metadata_exception{"invalid document metadata: " + path};
+    num_docs_ = words_[0];
+    length_bits_ = words_[1];
+    unique_bits_ = words_[2];
+    if (length_bits_ > 64 || unique_bits_ > 64
+        || words_.size()
+               < header_words + (num_docs_ * record_bits() + 63) / 64 + 1)
+        throw doc_metadata_exception{"invalid document metadata: " + path};
+}
+
+uint64_t doc_metadata::field(uint64_t bit, uint64_t width) const
+{
+    if (width == 0)
+        return 0;
+    auto word = header_words + bit / 64;
+    auto offset = bit % 64;
+    auto value = words_[word] >> offset;
+    if (offset + width > 64)
+        value |= words_[word + 1] << (64 - offset);
+    return width == 64 ? value : value & ((uint64_t{1} << width) - 1);
+}
+
+auto doc_metadata::at(doc_id d_id) const -> record
+{
+    auto bit = static_cast<uint64_t>(d_id) * record_bits();
+    return {field(bit, length_bits_), field(bit + length_bits_, unique_bits_)};
+}
+
+uint64_t doc_metadata::length(doc_id d_id) const
+{
+    return field(static_cast<uint64_t>(d_id) * record_bits(), length_bits_);
+}
+
+uint64_t doc_metadata::unique_terms(doc_id d_id) const
+{
+    return field(static_cast<uint64_t>(d_id) * record_bits() + length_bits_,
+                 unique_bits_);
+}
+
+util::memory_usage doc_metadata::memory_usage() const
+{
+    return words_.memory_usage();
+}
+
+uint64_t doc_metadata::size() const
+{
+    return num_docs_;
+}
+
+uint64_t doc_metadata::record_bits() const
+{
+    return length_bits_ + unique_bits_;
+}
+
+void doc_metadata::prefault() const
+{
+    words_.prefault();
+}
+}
+}
@@ -4,12 +4,14 @@
  */
 
 #include <algorithm>
+#include <cmath>
 #include <numeric>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
 #include "cpptoml.h"
 #include "index/eval/ir_eval.h"
+#include "parallel/parallel_for.h"
 #include "util/mapping.h"
 #include "util/printing.h"
 #include "util/shim.h"
@@ -159,13 +161,18 @@ double ir_eval::ndcg(const std::vector<std::pair<doc_id, double>>& results,
 
 double ir_eval::avg_p(const std::vector<std::pair<doc_id, double>>& results,
                       query_id q_id, uint64_t num_docs)
+{
+    auto avgp = average_precision(results, q_id, num_docs);
+    scores_.push_back(avgp);
+    return avgp;
+}
+
+double ir_eval::average_precision(const result_type& results, query_id q_id,
+                                  uint64_t num_docs) const
 {
     const auto& ht = qrels_.find(q_id);
     if (ht == qrels_.end() || results.empty())
-    {
-        scores_.push_back(0.0);
         return 0.0;
-    }
 
     // the total number of *possible* relevant documents given the num_docs
     // cutoff point
@@ -185,10 +192,39 @@ double ir_eval::avg_p(const std::vector<std::pair<doc_id, double>>& results,
         ++i;
     }
 
-    scores_.push_back(avgp / total_relevant);
     return avgp / total_relevant;
 }
 
+std::vector<ir_eval::query_stats>
+    ir_eval::evaluate(const std::vector<result_type>& results,
+                      const std::vector<query_id>& q_ids, uint64_t num_docs,
+                      parallel::thread_pool& pool)
+{
+    if (results.size() != q_ids.size())
+        throw ir_eval_exception{"every list of results needs a query id"};
+
+    // the scores only read the judgements, so the queries can be scored
+    // independently
+    std::vector<query_stats> stats(results.size());
+    parallel::parallel_chunks(pool, results.size(), 0,
+                              [&](uint64_t, uint64_t first, uint64_t last)
+                              {
+        for (auto i = first; i < last; ++i)
+        {
+            auto& st = stats[i];
+            st.precision = precision(results[i], q_ids[i], num_docs);
+            st.recall = recall(results[i], q_ids[i], num_docs);
+            st.f1 = f1(results[i], q_ids[i], num_docs);
+            st.ndcg = ndcg(results[i], q_ids[i], num_docs);
+            st.avg_p = average_precision(results[i], q_ids[i], num_docs);
+        }
+    });
+
+    for (const auto& st : stats)
+        scores_.push_back(st.avg_p);
+    return stats;
+}
+
 double ir_eval::map() const
 {
     if (scores_.empty())
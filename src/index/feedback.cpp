@@ -0,0 +1,178 @@
+/**
+ * @file feedback.cpp
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <future>
+#include <unordered_map>
+
+#include "index/feedback.h"
+#include "index/forward_index.h"
+#include "index/inverted_index.h"
+#include "index/ranker/ranker.h"
+#include "parallel/thread_pool.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/**
+ * Reads the term vectors of documents from a forward index.
+ * @param fwd The forward index
+ * @param docs The documents
+ * @param num_threads The number of threads to read with
+ * @return the (term_id, count) pairs of each document, in order
+ */
+std::vector<std::vector<std::pair<term_id, double>>>
+    read_vectors(const forward_index& fwd, const std::vector<doc_id>& docs,
+                 uint64_t num_threads)
+{
+    std::vector<std::vector<std::pair<term_id, double>>> vectors(docs.size());
+    std::atomic<uint64_t> next{0};
+    auto worker = [&]()
+    {
+        for (auto i = next++; i < docs.size(); i = next++)
+            fwd.read_counts(docs[i], vectors[i]);
+    };
+
+    num_threads = std::max<uint64_t>(
+        1, std::min<uint64_t>(num_threads, docs.size()));
+    if (num_threads == 1)
+    {
+        worker();
+        return vectors;
+    }
+
+    parallel::thread_pool pool{num_threads};
+    std::vector<std::future<void>> futures;
+    for (uint64_t i = 0; i < num_threads; ++i)
+        futures.push_back(pool.submit_task(worker));
+    for (auto& fut : futures)
+        fut.get();
+    return vectors;
+}
+}
+
+corpus::document
+    expand_query(inverted_index& idx, const forward_index& fwd,
+                 corpus::document& query,
+                 const std::vector<std::pair<doc_id, double>>& results,
+                 const feedback_options& options /* = {} */)
+{
+    if (fwd.num_docs() != idx.num_docs()
+        || fwd.unique_terms() != idx.unique_terms())
+        throw feedback_exception{"feedback needs a forward index of the "
+                                 "inverted index's documents"};
+    if (options.original_weight < 0 || options.original_weight > 1)
+        throw feedback_exception{
+            "the original query's weight must be in [0, 1]"};
+
+    if (query.counts().empty())
+        idx.tokenize(query);
+
+    double query_length = 0;
+    for (const auto& count : query.counts())
+        query_length += count.second;
+
+    auto num_docs = std::min<uint64_t>(options.num_docs, results.size());
+    if (query_length == 0 || num_docs == 0)
+        return query;
+
+    std::vector<doc_id> docs;
+    docs.reserve(num_docs);
+    for (uint64_t i = 0; i < num_docs; ++i)
+        docs.push_back(results[i].first);
+    auto vectors = read_vectors(fwd, docs, options.num_threads);
+
+    // how much each feedback document contributes: the same for Rocchio;
+    // for RM3, the scores are taken as log likelihoods and normalized
+    std::vector<double> doc_weights(num_docs, 1.0 / num_docs);
+    if (options.model == feedback_model::rm3)
+    {
+        double total = 0;
+        for (uint64_t i = 0; i < num_docs; ++i)
+        {
+            doc_weights[i] = std::exp(results[i].second - results[0].second);
+            total += doc_weights[i];
+        }
+        for (auto& weight : doc_weights)
+            weight /= total;
+    }
+
+    std::unordered_map<term_id, double> weights;
+    for (uint64_t i = 0; i < num_docs; ++i)
+    {
+        double length = 0;
+        for (const auto& count : vectors[i])
+            length += count.second;
+        if (length == 0)
+            continue;
+        for (const auto& count : vectors[i])
+            weights[count.first] += doc_weights[i] * count.second / length;
+    }
+
+    std::vector<std::pair<term_id, double>> terms{weights.begin(),
+                                                  weights.end()};
+    if (options.model == feedback_model::rocchio)
+    {
+        auto total_docs = static_cast<double>(idx.num_docs());
+        for (auto& term : terms)
+        {
+            auto df = static_cast<double>(idx.doc_freq(term.first));
+            term.second *= std::log(1.0 + (total_docs - df + 0.5) / (df + 0.5));
+        }
+    }
+
+    auto num_terms = std::min<uint64_t>(options.num_terms, terms.size());
+    auto by_weight = [](const std::pair<term_id, double>& a,
+                        const std::pair<term_id, double>& b)
+    {
+        return a.second > b.second
+               || (a.second == b.second && a.first < b.first);
+    };
+    std::partial_sort(terms.begin(), terms.begin() + num_terms, terms.end(),
+                      by_weight);
+    terms.resize(num_terms);
+
+    double expansion_total = 0;
+    for (const auto& term : terms)
+        expansion_total += term.second;
+
+    // both parts are distributions over terms, scaled back up to the
+    // length of the original query
+    corpus::document expanded{query.path(), query.id(), query.label()};
+    expanded.encoding(query.encoding());
+    if (options.original_weight > 0)
+    {
+        for (const auto& count : query.counts())
+            expanded.increment(count.first,
+                               options.original_weight * count.second);
+    }
+    if (expansion_total > 0)
+    {
+        auto scale = (1 - options.original_weight) * query_length
+                     / expansion_total;
+        for (const auto& term : terms)
+            expanded.increment(idx.term_text(term.first), scale * term.second);
+    }
+    return expanded;
+}
+
+std::vector<std::pair<doc_id, double>>
+    score_with_feedback(inverted_index& idx, const forward_index& fwd,
+                        ranker& r, corpus::document& query,
+                        uint64_t num_results /* = 10 */,
+                        const feedback_options& options /* = {} */)
+{
+    auto results = r.score(idx, query,
+                           std::max<uint64_t>(num_results, options.num_docs));
+    auto expanded = expand_query(idx, fwd, query, results, options);
+    return r.score(idx, expanded, num_results);
+}
+}
+}
@@ -0,0 +1,348 @@
+/**
+ * @file field_store.cpp
+ */
+
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <sstream>
+
+#include "cpptoml.h"
+#include "index/field_store.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/**
+ * @param type A field type
+ * @return the name of the type in configuration files
+ */
+std::string type_name(field_type type)
+{
+    switch (type)
+    {
+        case field_type::integer:
+            return "int";
+        case field_type::real:
+            return "double";
+        case field_type::string:
+            return "string";
+    }
+    return "";
+}
+
+/**
+ * @param name The name of a type in configuration files
+ * @return the type
+ */
+field_type parse_type(const std::string& name)
+{
+    if (name == "int")
+        return field_type::integer;
+    if (name == "double")
+        return field_type::real;
+    if (name == "string")
+        return field_type::string;
+    throw field_store::field_store_exception{"unknown field type: " + name};
+}
+
+/**
+ * @param dir The directory of a field store
+ * @param spec A field
+ * @return the path of the field's column
+ */
+std::string column_path(const std::string& dir, const field_spec& spec)
+{
+    return dir + "/" + spec.name + "." + type_name(spec.type);
+}
+
+/**
+ * @param spec A field
+ * @param value A value of the field, as text
+ * @return the value converted with conv, which must consume all of it
+ */
+template <class T, class Conversion>
+T parse_value(const field_spec& spec, const std::string& value,
+              Conversion&& conv)
+{
+    try
+    {
+        std::size_t used = 0;
+        auto result = conv(value, &used);
+        if (used == value.size())
+            return result;
+    }
+    catch (std::logic_error&)
+    {
+        // reported below
+    }
+    throw field_store::field_store_exception{"invalid value for field "
+                                             + spec.name + ": " + value};
+}
+}
+
+std::vector<field_spec> parse_field_specs(const cpptoml::table& config)
+{
+    std::vector<field_spec> specs;
+    auto fields = config.get_table_array("fields");
+    if (!fields)
+        return specs;
+
+    for (const auto& field : fields->get())
+    {
+        auto name = field->get_as<std::string>("name");
+        auto type = field->get_as<std::string>("type");
+        if (!name || !type)
+            throw field_store::field_store_exception{
+                "fields must have a name and a type"};
+        if (name->empty()
+            || name->find_first_of(" \t\n/") != std::string::npos)
+            throw field_store::field_store_exception{"invalid field name: "
+                                                     + *name};
+        for (const auto& spec : specs)
+        {
+            if (spec.name == *name)
+                throw field_store::field_store_exception{
+                    "duplicate field name: " + *name};
+        }
+        specs.push_back({*name, parse_type(*type)});
+    }
+    return specs;
+}
+
+field_store_writer::field_store_writer(const std::string& dir,
+                                       const std::vector<field_spec>& specs,
+                                       uint64_t num_docs)
+    : specs_(specs),
+      integers_(specs.size()),
+      reals_(specs.size()),
+      strings_(specs.size())
+{
+    filesystem::make_directory(dir);
+    std::ofstream schema{dir + "/schema"};
+    schema << num_docs << "\n";
+    for (uint64_t i = 0; i < specs_.size(); ++i)
+    {
+        const auto& spec = specs_[i];
+        schema << spec.name << " " << type_name(spec.type) << "\n";
+        auto path = column_path(dir, spec);
+        switch (spec.type)
+        {
+            case field_type::integer:
+                integers_[i] = util::disk_vector<int64_t>{path, num_docs};
+                break;
+            case field_type::real:
+                reals_[i] = util::disk_vector<double>{path, num_docs};
+                break;
+            case field_type::string:
+                strings_[i] = string_list_writer{path, num_docs};
+                break;
+        }
+    }
+}
+
+void field_store_writer::insert(doc_id d_id,
+                                const std::vector<std::string>& values)
+{
+    if (values.size() != specs_.size())
+        throw field_store::field_store_exception{
+            "wrong number of fields for document " + std::to_string(d_id)};
+
+    for (uint64_t i = 0; i < specs_.size(); ++i)
+    {
+        const auto& spec = specs_[i];
+        switch (spec.type)
+        {
+            case field_type::integer:
+                (*integers_[i])[d_id] = parse_value<int64_t>(
+                    spec, values[i], [](const std::string& str,
+                                        std::size_t* used)
+                    {
+                        return std::stoll(str, used);
+                    });
+                break;
+            case field_type::real:
+                (*reals_[i])[d_id] = parse_value<double>(
+                    spec, values[i], [](const std::string& str,
+                                        std::size_t* used)
+                    {
+                        return std::stod(str, used);
+                    });
+                break;
+            case field_type::string:
+                strings_[i]->insert(d_id, values[i]);
+                break;
+        }
+    }
+}
+
+field_store::field_store(const std::string& dir)
+{
+    std::ifstream schema{dir + "/schema"};
+    if (!(schema >> num_docs_))
+        throw field_store_exception{"invalid field schema in " + dir};
+
+    std::string name;
+    std::string type;
+    while (schema >> name >> type)
+    {
+        positions_[name] = specs_.size();
+        specs_.push_back({name, parse_type(type)});
+    }
+
+    // the columns cannot be copied, so the vectors are never grown
+    using int_column = util::optional<util::disk_vector<int64_t>>;
+    using real_column = util::optional<util::disk_vector<double>>;
+    integers_ = std::vector<int_column>(specs_.size());
+    reals_ = std::vector<real_column>(specs_.size());
+    strings_ = std::vector<util::optional<string_list>>(specs_.size());
+    for (uint64_t i = 0; i < specs_.size(); ++i)
+    {
+        auto path = column_path(dir, specs_[i]);
+        switch (specs_[i].type)
+        {
+            case field_type::integer:
+                integers_[i] = util::disk_vector<int64_t>{path};
+                break;
+            case field_type::real:
+                reals_[i] = util::disk_vector<double>{path};
+                break;
+            case field_type::string:
+                strings_[i] = string_list{path};
+                break;
+        }
+    }
+}
+
+const std::vector<field_spec>& field_store::fields() const
+{
+    return specs_;
+}
+
+bool field_store::contains(const std::string& name) const
+{
+    return positions_.find(name) != positions_.end();
+}
+
+uint64_t field_store::find(const std::string& name, field_type type) const
+{
+    auto it = positions_.find(name);
+    if (it == positions_.end())
+        throw field_store_exception{"no such field: " + name};
+    if (specs_[it->second].type != type)
+        throw field_store_exception{"field " + name + " is not of type "
+                                    + type_name(type)};
+    return it->second;
+}
+
+int64_t field_store::int_value(const std::string& name, doc_id d_id) const
+{
+    return integers_[find(name, field_type::integer)]->at(d_id);
+}
+
+double field_store::real_value(const std::string& name, doc_id d_id) const
+{
+    return reals_[find(name, field_type::real)]->at(d_id);
+}
+
+std::string field_store::string_value(const std::string& name,
+                                      doc_id d_id) const
+{
+    if (d_id >= num_docs_)
+        throw field_store_exception{"document out of range: "
+                                    + std::to_string(d_id)};
+    return strings_[find(name, field_type::string)]->at(d_id);
+}
+
+std::vector<std::string> field_store::values(doc_id d_id) const
+{
+    std::vector<std::string> result;
+    result.reserve(specs_.size());
+    for (uint64_t i = 0; i < specs_.size(); ++i)
+    {
+        switch (specs_[i].type)
+        {
+            case field_type::integer:
+                result.push_back(std::to_string(integers_[i]->at(d_id)));
+                break;
+            case field_type::real:
+            {
+                // enough digits that the value reads back exactly
+                std::ostringstream out;
+                out.precision(std::numeric_limits<double>::max_digits10);
+                out << reals_[i]->at(d_id);
+                result.push_back(out.str());
+                break;
+            }
+            case field_type::string:
+                result.push_back(string_value(specs_[i].name, d_id));
+                break;
+        }
+    }
+    return result;
+}
+
+auto field_store::make_filter(
+    const std::function<bool(uint64_t)>& accept) const -> filter_type
+{
+    auto accepted = std::make_shared<std::vector<bool>>(num_docs_);
+    for (uint64_t i = 0; i < num_docs_; ++i)
+        (*accepted)[i] = accept(i);
+    return [accepted](doc_id d_id)
+    {
+        return d_id < accepted->size() && (*accepted)[d_id];
+    };
+}
+
+auto field_store::int_range(const std::string& name, int64_t lower,
+                            int64_t upper) const -> filter_type
+{
+    const auto& column = *integers_[find(name, field_type::integer)];
+    return make_filter([&](uint64_t i)
+                       {
+                           return column[i] >= lower && column[i] <= upper;
+                       });
+}
+
+auto field_store::real_range(const std::string& name, double lower,
+                             double upper) const -> filter_type
+{
+    const auto& column = *reals_[find(name, field_type::real)];
+    return make_filter([&](uint64_t i)
+                       {
+                           return column[i] >= lower && column[i] <= upper;
+                       });
+}
+
+auto field_store::string_equals(const std::string& name,
+                                const std::string& value) const
+    -> filter_type
+{
+    const auto& column = *strings_[find(name, field_type::string)];
+    return make_filter([&](uint64_t i)
+                       {
+                           return column.at(i) == value;
+                       });
+}
+
+util::memory_usage field_store::memory_usage() const
+{
+    util::memory_usage usage;
+    for (const auto& column : integers_)
+        if (column)
+            usage += column->memory_usage();
+    for (const auto& column : reals_)
+        if (column)
+            usage += column->memory_usage();
+    for (const auto& column : strings_)
+        if (column)
+            usage += column->memory_usage();
+    return usage;
+}
+}
+}
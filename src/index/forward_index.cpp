@@ -3,6 +3,19 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <map>
+#include <mutex>
+#include <numeric>
+#include <sstream>
+#include <unordered_map>
+
+#include "analyzers/analyzer.h"
+#include "corpus/batch_reader.h"
+#include "corpus/corpus.h"
 #include "cpptoml.h"
 #include "index/chunk_handler.h"
 #include "index/disk_index_impl.h"
@@ -12,18 +25,115 @@
 #include "index/string_list.h"
 #include "index/string_list_writer.h"
 #include "index/vocabulary_map.h"
+#include "index/vocabulary_map_writer.h"
+#include "io/binary.h"
+#include "io/mmap_file.h"
 #include "io/libsvm_parser.h"
+#include "io/stream_vbyte.h"
+#include "parallel/stage_counter.h"
 #include "parallel/thread_pool.h"
 #include "util/disk_vector.h"
 #include "util/mapping.h"
+#include "util/offset_vector.h"
 #include "util/pimpl.tcc"
 #include "util/shim.h"
+#include "util/trace.h"
 
 namespace meta
 {
 namespace index
 {
 
+namespace
+{
+/**
+ * Writes a single document's postings to the binary postings file. Each
+ * document is a variable byte header holding the number of postings
+ * (shifted left by one) and a flag that is set if any count is not an
+ * integer, followed by the gap coded term_ids and then the counts: as
+ * variable byte codes if they are all integers, or as raw doubles
+ * otherwise.
+ * @param out The stream to write to
+ * @param counts The (term_id, count) pairs, sorted by term_id
+ * @return the number of bytes written
+ */
+uint64_t write_doc(std::ostream& out,
+                   const forward_index::postings_data_type::count_t& counts)
+{
+    bool integral = std::all_of(counts.begin(), counts.end(),
+                                [](const std::pair<term_id, double>& count)
+                                {
+        return count.second >= 0 && count.second == std::floor(count.second);
+    });
+
+    uint64_t bytes = io::stream_vbyte::write_varint(
+        out, (counts.size() << 1) | (integral ? 0 : 1));
+
+    term_id last_id{0};
+    for (const auto& count : counts)
+    {
+        bytes += io::stream_vbyte::write_varint(out, count.first - last_id);
+        last_id = count.first;
+    }
+
+    for (const auto& count : counts)
+    {
+        if (integral)
+        {
+            bytes += io::stream_vbyte::write_varint(
+                out, static_cast<uint64_t>(count.second));
+        }
+        else
+        {
+            out.write(reinterpret_cast<const char*>(&count.second),
+                      sizeof(double));
+            bytes += sizeof(double);
+        }
+    }
+
+    return bytes;
+}
+
+/**
+ * Reads a single document's postings written by write_doc().
+ * @param data Pointer to the first byte of the document's postings
+ * @param counts The container to store the (term_id, count) pairs in; its
+ * previous contents are replaced
+ * @return the number of bytes read
+ */
+uint64_t read_doc(const char* data,
+                  std::vector<std::pair<term_id, double>>& counts)
+{
+    auto in = reinterpret_cast<const uint8_t*>(data);
+    auto header = io::stream_vbyte::read_varint(in);
+    uint64_t size = header >> 1;
+    bool integral = !(header & 1);
+
+    counts.resize(size);
+    uint64_t last_id = 0;
+    for (auto& count : counts)
+    {
+        last_id += io::stream_vbyte::read_varint(in);
+        count.first = term_id{last_id};
+    }
+
+    for (auto& count : counts)
+    {
+        if (integral)
+        {
+            count.second = io::stream_vbyte::read_varint(in);
+        }
+        else
+        {
+            std::memcpy(&count.second, in, sizeof(double));
+            in += sizeof(double);
+        }
+    }
+
+    return static_cast<uint64_t>(reinterpret_cast<const char*>(in) - data);
+}
+}
+
 /**
  * Implementation of a forward_index.
  */
@@ -48,19 +158,30 @@ class forward_index::impl
     void create_index(const std::string& config_file);
 
     /**
-     * Initializes this index's metadata structures.
+     * Converts the libsvm-formatted corpus file into the binary postings
+     * file, filling in the document metadata along the way.
+     * @param config the configuration settings for this index
      */
-    void init_metadata();
+    void create_libsvm_postings(const cpptoml::table& config);
 
     /**
-     * @param config the configuration settings for this index
+     * Tokenizes every document once, writing its postings in doc_id
+     * order, without building an inverted index first.
+     * @param config_file The configuration file used to create the index
      */
-    void create_libsvm_postings(const cpptoml::table& config);
+    void tokenize_docs(const std::string& config_file);
 
     /**
-     * Initializes structures based on a libsvm-formatted file.
+     * Rewrites the postings file written by tokenize_docs(), replacing
+     * the provisional term_ids (assigned in order of first occurrence)
+     * with the final ones (assigned in lexicographic order), and writes
+     * the term_id mapping.
+     * @param terms The provisional term_id -> term mapping
+     * @param locations The doc_id -> postings file byte location table,
+     * rewritten along with the postings
      */
-    void create_libsvm_metadata();
+    void assign_term_ids(const std::vector<std::string>& terms,
+                         util::disk_vector<uint64_t>& locations);
 
     /**
      * @param inv_idx The inverted index to uninvert
@@ -80,21 +201,17 @@ class forward_index::impl
     bool is_libsvm_format(const cpptoml::table& config) const;
 
     /**
-     * Calculates which documents start at which bytes in the postings file.
-     */
-    void set_doc_byte_locations();
-
-    /**
-     * Converts postings.index into a libsvm formatted file
+     * Converts the merged (doc_id-sorted) postings chunk in postings.index
+     * into the binary postings file.
      * @param num_docs The total number of documents
      */
-    void compressed_postings_to_libsvm(uint64_t num_docs);
+    void compressed_postings_to_binary(uint64_t num_docs);
 
     /// the total number of unique terms if term_id_mapping_ is unused
     uint64_t total_unique_terms_;
 
     /// doc_id -> postings file byte location
-    util::optional<util::disk_vector<uint64_t>> doc_byte_locations_;
+    util::optional<util::offset_vector> doc_byte_locations_;
 
   private:
     /// Pointer to the forward_index this is an implementation of
@@ -119,7 +236,8 @@ forward_index& forward_index::operator=(forward_index&&) = default;
 
 bool forward_index::valid() const
 {
-    if (!filesystem::file_exists(index_name() + "/corpus.uniqueterms"))
+    if (!filesystem::file_exists(index_name() + "/corpus.uniqueterms")
+        || !util::offset_vector::exists(index_name() + "/lexicon.offsets"))
     {
         LOG(info)
             << "Existing forward index detected as invalid; recreating"
@@ -140,27 +258,87 @@ bool forward_index::valid() const
 }
 
 std::string forward_index::liblinear_data(doc_id d_id) const
+{
+    postings_data_type::count_t counts;
+    read_counts(d_id, counts);
+
+    std::ostringstream out;
+    out << impl_->doc_label_id(d_id);
+    for (const auto& count : counts)
+        out << ' ' << (count.first + 1) << ':' << count.second;
+    return out.str();
+}
+
+void forward_index::read_counts(
+    doc_id d_id, std::vector<std::pair<term_id, double>>& counts) const
 {
     if (d_id >= num_docs())
         throw forward_index_exception{"invalid doc_id in search_primary"};
 
-    uint64_t begin = (*fwd_impl_->doc_byte_locations_)[d_id];
-    uint64_t length = 0;
-    while (impl_->postings()[begin + length] != '\n')
+    auto location = fwd_impl_->doc_byte_locations_->at(d_id);
+    read_doc(impl_->postings().begin() + location, counts);
+}
+
+csr_matrix forward_index::materialize(const std::vector<doc_id>& docs,
+                                      const std::string& prefix) const
+{
+    std::vector<uint64_t> offsets;
+    offsets.reserve(docs.size() + 1);
+    offsets.push_back(0);
+
+    std::vector<uint32_t> terms;
+    std::vector<float> values;
+    std::ofstream terms_out;
+    std::ofstream values_out;
+    if (!prefix.empty())
     {
-        ++length;
-        if (begin + length >= impl_->postings().size())
-            throw forward_index_exception{"out of bounds!"};
+        terms_out.open(prefix + ".terms", std::ios::binary);
+        values_out.open(prefix + ".values", std::ios::binary);
+        if (!terms_out || !values_out)
+            throw forward_index_exception{"failed to create matrix files at "
+                                          + prefix};
     }
 
-    return std::string{impl_->postings().begin() + begin, length};
+    postings_data_type::count_t counts;
+    for (const auto& d_id : docs)
+    {
+        read_counts(d_id, counts);
+        for (const auto& count : counts)
+        {
+            if (count.first > std::numeric_limits<uint32_t>::max())
+                throw forward_index_exception{
+                    "term id too large for a csr_matrix"};
+            auto t_id = static_cast<uint32_t>(count.first);
+            auto value = static_cast<float>(count.second);
+            if (prefix.empty())
+            {
+                terms.push_back(t_id);
+                values.push_back(value);
+            }
+            else
+            {
+                io::write_binary(terms_out, t_id);
+                io::write_binary(values_out, value);
+            }
+        }
+        offsets.push_back(offsets.back() + counts.size());
+    }
+
+    if (prefix.empty())
+        return {docs, std::move(offsets), std::move(terms), std::move(values)};
+
+    terms_out.close();
+    values_out.close();
+    return {docs, std::move(offsets), prefix};
 }
 
 void forward_index::load_index()
 {
     LOG(info) << "Loading index from disk: " << index_name() << ENDLG;
 
-    fwd_impl_->init_metadata();
+    impl_->initialize_metadata();
+    fwd_impl_->doc_byte_locations_
+        = util::offset_vector{index_name() + "/lexicon.offsets"};
 
     impl_->load_doc_id_mapping();
     impl_->load_postings();
@@ -173,23 +351,40 @@ void forward_index::load_index()
 
     std::ifstream unique_terms_file{index_name() + "/corpus.uniqueterms"};
     unique_terms_file >> fwd_impl_->total_unique_terms_;
+
+    impl_->prefault_metadata();
+    if (impl_->residency() != io::residency::on_demand)
+        fwd_impl_->doc_byte_locations_->prefault();
 }
 
 void forward_index::create_index(const std::string& config_file)
 {
+    trace::scoped_event event{"create_forward_index", "index"};
     filesystem::copy_file(config_file, index_name() + "/config.toml");
     auto config = cpptoml::parse_file(index_name() + "/config.toml");
 
     // if the corpus is a single libsvm formatted file, then we are done;
-    // otherwise, we will create an inverted index and the uninvert it
+    // otherwise, we tokenize the corpus directly, or, if requested with
+    // `uninvert = true`, create an inverted index and then uninvert it
     if (fwd_impl_->is_libsvm_format(config))
     {
         LOG(info) << "Creating index from libsvm data: " << index_name()
                   << ENDLG;
 
         fwd_impl_->create_libsvm_postings(config);
-        fwd_impl_->create_libsvm_metadata();
         impl_->save_label_id_mapping();
+        impl_->load_postings();
+    }
+    else if (!config.get_as<bool>("uninvert")
+             || !*config.get_as<bool>("uninvert"))
+    {
+        LOG(info) << "Creating index: " << index_name() << ENDLG;
+
+        fwd_impl_->tokenize_docs(config_file);
+        impl_->save_label_id_mapping();
+        impl_->load_postings();
+        impl_->load_term_id_mapping();
+        fwd_impl_->total_unique_terms_ = impl_->total_unique_terms();
     }
     else
     {
@@ -201,17 +396,30 @@ void forward_index::create_index(const std::string& config_file)
         auto inv_idx = make_index<inverted_index>(config_file);
 
         fwd_impl_->create_uninverted_metadata(inv_idx->index_name());
+        if (inv_idx->has_fields())
+        {
+            auto field_writer = impl_->make_field_writer(inv_idx->num_docs());
+            for (const auto& d_id : inv_idx->docs())
+                field_writer->insert(d_id, inv_idx->fields().values(d_id));
+        }
         impl_->load_label_id_mapping();
+        impl_->initialize_metadata();
         fwd_impl_->uninvert(*inv_idx);
-        fwd_impl_->init_metadata();
         impl_->load_postings();
-        fwd_impl_->set_doc_byte_locations();
         impl_->load_term_id_mapping();
         fwd_impl_->total_unique_terms_ = impl_->total_unique_terms();
     }
 
+    // documents are written in doc_id order, so their locations never
+    // decrease and the table is always packed
+    util::offset_vector::compact(index_name() + "/lexicon.offsets");
+    fwd_impl_->doc_byte_locations_
+        = util::offset_vector{index_name() + "/lexicon.offsets"};
+
     // now that the files are tokenized, we can create the string_list
     impl_->load_doc_id_mapping();
+    impl_->load_doc_metadata(true);
+    impl_->load_fields();
 
     std::ofstream unique_terms_file{index_name() + "/corpus.uniqueterms"};
     unique_terms_file << fwd_impl_->total_unique_terms_;
@@ -233,78 +441,60 @@ void forward_index::impl::create_libsvm_postings(const cpptoml::table& config)
     std::string existing_file = *prefix + "/" + *dataset + "/" + *dataset
                                 + ".dat";
 
-    filesystem::copy_file(existing_file,
-                          idx_->index_name() + idx_->impl_->files[POSTINGS]);
-
-    init_metadata();
-
-    // now, assign byte locations for libsvm doc starting points
-    idx_->impl_->load_postings();
-    set_doc_byte_locations();
-}
-
-void forward_index::impl::set_doc_byte_locations()
-{
-    doc_id d_id{0};
-    uint8_t last_byte = '\n';
-    printing::progress progress{" > Setting document locations: ",
-                                idx_->impl_->postings().size()};
-    for (uint64_t idx = 0; idx < idx_->impl_->postings().size(); ++idx)
-    {
-        progress(idx);
-        if (last_byte == '\n')
-        {
-            (*doc_byte_locations_)[d_id] = idx;
-            ++d_id;
-        }
-        last_byte = idx_->impl_->postings()[idx];
-    }
-}
-
-void forward_index::impl::init_metadata()
-{
-    uint64_t num_docs = filesystem::num_lines(idx_->index_name()
-                                              + idx_->impl_->files[POSTINGS]);
+    uint64_t num_docs = filesystem::num_lines(existing_file);
     idx_->impl_->initialize_metadata(num_docs);
-    doc_byte_locations_ = util::disk_vector<uint64_t>(
-        idx_->index_name() + "/lexicon.index", num_docs);
-}
+    util::disk_vector<uint64_t> locations{
+        idx_->index_name() + "/lexicon.offsets", num_docs};
 
-void forward_index::impl::create_libsvm_metadata()
-{
     total_unique_terms_ = 0;
 
-    printing::progress progress{" > Creating metadata: ",
-                                doc_byte_locations_->size()};
+    printing::progress progress{" > Creating postings: ", num_docs};
+
+    // the lines are found in the mapped file with memchr rather than read
+    // through a stream a character at a time
+    io::mmap_file in{existing_file};
+    in.advise(io::access_pattern::sequential);
+    std::ofstream out{idx_->index_name() + idx_->impl_->files[POSTINGS],
+                      std::ios::binary};
+    auto docid_writer = idx_->impl_->make_doc_id_writer(num_docs);
 
+    uint64_t bytes = 0;
     doc_id d_id{0};
-    std::ifstream in{idx_->index_name() + idx_->impl_->files[POSTINGS]};
-    std::string line;
-    auto docid_writer = idx_->impl_->make_doc_id_writer(idx_->num_docs());
-    while (in.good())
+    // each line is parsed where it lies in the mapped file, into one
+    // buffer reused for every document
+    postings_data_type::count_t counts;
+    const char* next = in.begin();
+    const char* end = in.begin() + in.size();
+    while (d_id < num_docs && next < end)
     {
-        std::getline(in, line);
-        if (line.empty())
+        auto newline = static_cast<const char*>(
+            std::memchr(next, '\n', static_cast<size_t>(end - next)));
+        auto line = next;
+        auto line_end = newline ? newline : end;
+        next = newline ? newline + 1 : end;
+        if (line == line_end)
             break;
 
         progress(d_id);
 
-        class_label lbl = io::libsvm_parser::label(line);
+        class_label lbl = io::libsvm_parser::label(line, line_end);
         idx_->impl_->set_label(d_id, lbl);
 
-        uint64_t num_unique = 0;
+        io::libsvm_parser::counts(line, line_end, counts);
         uint64_t length = 0;
-        for (const auto& count_pair : io::libsvm_parser::counts(line))
+        for (const auto& count_pair : counts)
         {
-            ++num_unique;
             if (count_pair.first > total_unique_terms_)
                 total_unique_terms_ = count_pair.first;
             length += static_cast<uint64_t>(count_pair.second);
         }
 
+        locations[d_id] = bytes;
+        bytes += write_doc(out, counts);
+
         docid_writer.insert(d_id, "[no path]");
         idx_->impl_->set_length(d_id, length);
-        idx_->impl_->set_unique_terms(d_id, num_unique);
+        idx_->impl_->set_unique_terms(d_id, counts.size());
 
         ++d_id;
     }
@@ -312,6 +502,187 @@ void forward_index::impl::create_libsvm_metadata()
     ++total_unique_terms_; // since we subtracted one from the ids earlier
 }
 
+void forward_index::impl::tokenize_docs(const std::string& config_file)
+{
+    auto config = cpptoml::parse_file(config_file);
+    auto analyzer = analyzers::analyzer::load(config);
+    auto docs = corpus::corpus::load(config_file);
+
+    uint64_t num_docs = docs->size();
+    idx_->impl_->initialize_metadata(num_docs);
+    util::disk_vector<uint64_t> locations{
+        idx_->index_name() + "/lexicon.offsets", num_docs};
+    auto docid_writer = idx_->impl_->make_doc_id_writer(num_docs);
+    auto field_writer = idx_->impl_->make_field_writer(num_docs);
+
+    auto filename = idx_->index_name() + idx_->impl_->files[POSTINGS];
+    std::ofstream output{filename + ".tmp", std::ios::binary};
+
+    // provisional term_ids, assigned in order of first occurrence
+    std::unordered_map<std::string, term_id> vocab;
+    std::vector<std::string> terms;
+    std::mutex vocab_mutex;
+
+    // documents finish tokenizing out of order, so each one waits in
+    // pending until every document before it has been written
+    std::map<doc_id, std::vector<std::pair<term_id, double>>> pending;
+    doc_id next_id{0};
+    uint64_t bytes = 0;
+    std::mutex output_mutex;
+
+    std::mutex mutex;
+    corpus::batch_reader reader{*docs, " > Tokenizing Docs: "};
+    parallel::stage_counter analysis;
+    using clock = parallel::stage_counter::clock;
+
+    auto task = [&]()
+    {
+        auto ana = analyzer->clone();
+        std::vector<corpus::document> batch;
+        std::vector<std::vector<std::pair<term_id, double>>> batch_counts;
+        while (true)
+        {
+            auto start = clock::now();
+            if (!reader.next(batch))
+                return;
+            auto taken = clock::now();
+            analysis.add_wait(taken - start);
+
+            for (auto& doc : batch)
+            {
+                if (!doc.pretokenized())
+                    ana->tokenize(doc);
+
+                // warn if there is an empty document
+                if (doc.counts().empty())
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    LOG(progress) << '\n' << ENDLG;
+                    LOG(warning) << "Empty document (id = " << doc.id()
+                                 << ") generated!" << ENDLG;
+                }
+
+                // save metadata
+                docid_writer.insert(doc.id(), doc.path());
+                idx_->impl_->set_length(doc.id(), doc.length());
+                idx_->impl_->set_unique_terms(doc.id(), doc.counts().size());
+                idx_->impl_->set_label(doc.id(), doc.label());
+                if (field_writer)
+                    field_writer->insert(doc.id(), doc.fields());
+            }
+
+            // the shared vocabulary and output are locked once per batch
+            batch_counts.resize(batch.size());
+            {
+                std::lock_guard<std::mutex> lock{vocab_mutex};
+                for (uint64_t i = 0; i < batch.size(); ++i)
+                {
+                    auto& counts = batch_counts[i];
+                    counts.clear();
+                    for (const auto& count : batch[i].counts())
+                    {
+                        auto it = vocab.find(count.first);
+                        if (it == vocab.end())
+                        {
+                            it = vocab.emplace(count.first,
+                                               term_id{terms.size()}).first;
+                            terms.push_back(count.first);
+                        }
+                        counts.emplace_back(it->second, count.second);
+                    }
+                }
+            }
+            for (auto& counts : batch_counts)
+                std::sort(counts.begin(), counts.end());
+
+            {
+                std::lock_guard<std::mutex> lock{output_mutex};
+                for (uint64_t i = 0; i < batch.size(); ++i)
+                    pending.emplace(batch[i].id(), std::move(batch_counts[i]));
+                for (auto it = pending.begin();
+                     it != pending.end() && it->first == next_id;
+                     it = pending.erase(it), ++next_id)
+                {
+                    locations[next_id] = bytes;
+                    bytes += write_doc(output, it->second);
+                }
+            }
+            auto done = clock::now();
+            analysis.add_work(batch.size(), done - taken);
+            if (trace::enabled())
+                trace::record("tokenize_batch", "index", taken, done);
+        }
+    };
+
+    {
+        parallel::thread_pool pool;
+        std::vector<std::future<void>> futures;
+        for (size_t i = 0; i < pool.thread_ids().size(); ++i)
+            futures.emplace_back(pool.submit_task(task));
+
+        for (auto& fut : futures)
+            fut.get();
+    }
+
+    LOG(info) << "Reading: " << reader.counter() << ENDLG;
+    LOG(info) << "Analysis: " << analysis << ENDLG;
+
+    if (next_id != num_docs)
+        throw forward_index_exception{"not all documents were written"};
+
+    output.close();
+    assign_term_ids(terms, locations);
+}
+
+void forward_index::impl::assign_term_ids(
+    const std::vector<std::string>& terms,
+    util::disk_vector<uint64_t>& locations)
+{
+    std::vector<uint64_t> order(terms.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b)
+    {
+        return terms[a] < terms[b];
+    });
+
+    std::vector<term_id> final_ids(terms.size());
+    {
+        vocabulary_map_writer vocab{idx_->index_name()
+                                    + idx_->impl_->files[TERM_IDS_MAPPING]};
+        for (uint64_t i = 0; i < order.size(); ++i)
+        {
+            vocab.insert(terms[order[i]]);
+            final_ids[order[i]] = term_id{i};
+        }
+    }
+
+    auto filename = idx_->index_name() + idx_->impl_->files[POSTINGS];
+    {
+        io::mmap_file input{filename + ".tmp"};
+        input.advise(io::access_pattern::sequential);
+        std::ofstream output{filename, std::ios::binary};
+
+        printing::progress progress{" > Assigning term ids: ",
+                                    locations.size()};
+        uint64_t in_bytes = 0;
+        uint64_t out_bytes = 0;
+        std::vector<std::pair<term_id, double>> counts;
+        for (uint64_t d_id = 0; d_id < locations.size(); ++d_id)
+        {
+            progress(d_id);
+            in_bytes += read_doc(input.begin() + in_bytes, counts);
+            for (auto& count : counts)
+                count.first = final_ids[count.first];
+            std::sort(counts.begin(), counts.end());
+
+            locations[d_id] = out_bytes;
+            out_bytes += write_doc(output, counts);
+        }
+    }
+
+    filesystem::delete_file(filename + ".tmp");
+}
+
 void forward_index::impl::create_uninverted_metadata(const std::string& name)
 {
     auto files = {DOC_IDS_MAPPING,  DOC_IDS_MAPPING_INDEX,   DOC_SIZES,
@@ -341,82 +712,122 @@ uint64_t forward_index::unique_terms() const
     return fwd_impl_->total_unique_terms_;
 }
 
+util::memory_report forward_index::memory_usage() const
+{
+    auto report = disk_index::memory_usage();
+    if (fwd_impl_->doc_byte_locations_)
+        report.add("postings", fwd_impl_->doc_byte_locations_->memory_usage());
+    return report;
+}
+
 auto forward_index::search_primary(
     doc_id d_id) const -> std::shared_ptr<postings_data_type>
 {
     auto pdata = std::make_shared<postings_data_type>(d_id);
-    auto line = liblinear_data(d_id);
-    pdata->set_counts(io::libsvm_parser::counts(line));
+    postings_data_type::count_t counts;
+    read_counts(d_id, counts);
+    pdata->set_counts(std::move(counts));
     return pdata;
 }
 
 void forward_index::impl::uninvert(const inverted_index& inv_idx)
 {
-    io::compressed_file_reader inv_reader{inv_idx.index_name()
-                                          + idx_->impl_->files[POSTINGS],
-                                          io::default_compression_reader_func};
+    trace::scoped_event event{"uninvert", "index"};
+    // each thread reads its range of the postings front to back
+    inv_idx.advise_postings(io::access_pattern::sequential);
 
-    term_id t_id{0};
-    chunk_handler<forward_index> handler{idx_->index_name()};
+    chunk_handler<forward_index> handler{idx_->index_name(),
+                                         idx_->impl_->ram_budget()};
     {
-        auto producer = handler.make_producer();
-        while (inv_reader.has_next())
+        parallel::thread_pool pool;
+        uint64_t num_threads = pool.thread_ids().size();
+        uint64_t num_terms = inv_idx.unique_terms();
+
+        // split the terms into one contiguous range per thread, balanced
+        // by the number of postings each range holds rather than by the
+        // number of terms
+        uint64_t total_postings = 0;
+        for (term_id t_id{0}; t_id < num_terms; ++t_id)
+            total_postings += inv_idx.doc_freq(t_id);
+
+        std::vector<term_id> bounds{term_id{0}};
+        uint64_t seen = 0;
+        for (term_id t_id{0}; t_id < num_terms; ++t_id)
         {
-            inverted_pdata_type pdata{t_id};
-            pdata.read_compressed(inv_reader);
-            producer(pdata.primary_key(), pdata.counts());
-            ++t_id;
+            seen += inv_idx.doc_freq(t_id);
+            if (bounds.size() < num_threads
+                && seen * num_threads >= total_postings * bounds.size())
+                bounds.push_back(term_id{t_id + 1});
         }
+        bounds.push_back(term_id{num_terms});
+
+        // read the postings through the inverted index so that we decode
+        // them with whichever codec the inverted index was built with;
+        // each thread gets its own producer, and documents split across
+        // their chunks are combined by the usual chunk merging
+        std::vector<std::future<void>> futures;
+        for (uint64_t i = 0; i + 1 < bounds.size(); ++i)
+        {
+            auto begin = bounds[i];
+            auto end = bounds[i + 1];
+            futures.emplace_back(pool.submit_task([&, begin, end]()
+                                                  {
+                auto producer = handler.make_producer();
+                for (term_id t_id = begin; t_id < end; ++t_id)
+                {
+                    auto pdata = inv_idx.search_primary(t_id);
+                    producer(pdata->primary_key(), pdata->counts());
+                }
+            }));
+        }
+
+        for (auto& fut : futures)
+            fut.get();
     }
 
     handler.merge_chunks();
-    compressed_postings_to_libsvm(inv_idx.num_docs());
+    compressed_postings_to_binary(inv_idx.num_docs());
 }
 
-void forward_index::impl::compressed_postings_to_libsvm(uint64_t num_docs)
+void forward_index::impl::compressed_postings_to_binary(uint64_t num_docs)
 {
-    idx_->impl_->load_labels();
-
+    trace::scoped_event event{"compress_postings", "index"};
     auto filename = idx_->index_name() + idx_->impl_->files[POSTINGS];
     filesystem::rename_file(filename, filename + ".tmp");
-    std::ofstream output{filename};
-    io::compressed_file_reader input{filename + ".tmp",
-                                     io::default_compression_reader_func};
 
-    // handler for writing gaps of blank documents
-    doc_id last_id{0};
-    auto write_gap = [&](doc_id next_id)
     {
-        while (next_id > last_id + 1)
-        {
-            ++last_id;
-            index_pdata_type empty;
-            empty.set_primary_key(
-                static_cast<doc_id>(idx_->impl_->doc_label_id(last_id)));
-            empty.write_libsvm(output);
-        }
-    };
+        std::ofstream output{filename, std::ios::binary};
+        io::default_compressed_file_reader input{filename + ".tmp"};
 
-    // read from input, write to output, changing doc_id to class_label for the
-    // correct libsvm format
-    index_pdata_type pdata;
-    while (input >> pdata)
-    {
-        doc_id d_id = pdata.primary_key();
+        util::disk_vector<uint64_t> locations{
+            idx_->index_name() + "/lexicon.offsets", num_docs};
 
-        // write empty document lines for any documents in a gap
-        write_gap(d_id);
+        // documents that had no terms are missing from the merged chunk,
+        // so they are written as empty postings lists
+        uint64_t bytes = 0;
+        doc_id next_id{0};
+        auto write_empty = [&](doc_id end_id)
+        {
+            for (; next_id < end_id; ++next_id)
+            {
+                locations[next_id] = bytes;
+                bytes += write_doc(output, {});
+            }
+        };
+
+        index_pdata_type pdata;
+        while (input >> pdata)
+        {
+            doc_id d_id = pdata.primary_key();
+            write_empty(d_id);
 
-        // write current document
-        pdata.set_primary_key(
-            static_cast<doc_id>(idx_->impl_->doc_label_id(d_id)));
-        pdata.write_libsvm(output);
-        last_id = d_id;
+            locations[d_id] = bytes;
+            bytes += write_doc(output, pdata.counts());
+            next_id = doc_id{d_id + 1};
+        }
+        write_empty(doc_id{num_docs});
     }
 
-    // write any trailing empty documents
-    write_gap(doc_id{num_docs});
-
     filesystem::delete_file(filename + ".tmp");
 }
 }
@@ -0,0 +1,301 @@
+/**
+ * @file hnsw_index.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <random>
+#include <unordered_set>
+
+#include "index/forward_index.h"
+#include "index/hnsw_index.h"
+
+namespace meta
+{
+namespace index
+{
+
+hnsw_index::hnsw_index(const forward_index& idx,
+                       const std::vector<doc_id>& docs,
+                       const hnsw_options& opts)
+    : idf_(idx.unique_terms(), 0.0), opts_(opts), entry_{0}, top_layer_{0}
+{
+    if (opts_.links < 2)
+        throw hnsw_index_exception{"an hnsw_index needs at least two links"};
+    if (opts_.ef_construction == 0)
+        throw hnsw_index_exception{"ef_construction must be positive"};
+
+    auto counts = idx.materialize(docs);
+    for (uint64_t r = 0; r < counts.rows(); ++r)
+        for (const auto& count : counts[r])
+            idf_[count.first] += 1;
+    double num_docs = counts.rows();
+    for (auto& df : idf_)
+        df = std::log(1 + num_docs / std::max(df, 1.0));
+
+    // the unit TF-IDF vectors, so that a dot product is a cosine
+    std::vector<uint64_t> offsets{0};
+    std::vector<uint32_t> terms;
+    std::vector<float> values;
+    offsets.reserve(counts.rows() + 1);
+    terms.reserve(counts.nonzeros());
+    values.reserve(counts.nonzeros());
+    for (uint64_t r = 0; r < counts.rows(); ++r)
+    {
+        double norm = 0;
+        for (const auto& count : counts[r])
+            norm += std::pow(count.second * idf_[count.first], 2);
+        norm = std::sqrt(norm);
+        for (const auto& count : counts[r])
+        {
+            terms.push_back(static_cast<uint32_t>(count.first));
+            values.push_back(static_cast<float>(
+                norm > 0 ? count.second * idf_[count.first] / norm : 0));
+        }
+        offsets.push_back(terms.size());
+    }
+    vectors_ = csr_matrix{docs, std::move(offsets), std::move(terms),
+                          std::move(values)};
+
+    // each layer holds about 1/links of the nodes of the one below it
+    std::mt19937_64 rng{opts_.seed};
+    std::uniform_real_distribution<double> dist{0, 1};
+    auto scale = 1 / std::log(static_cast<double>(opts_.links));
+    links_.resize(docs.size());
+    for (uint64_t node = 0; node < docs.size(); ++node)
+    {
+        auto layer = static_cast<uint64_t>(
+            -std::log(std::max(dist(rng), 1e-12)) * scale);
+        links_[node].resize(layer + 1);
+        insert(node);
+    }
+}
+
+auto hnsw_index::vector(uint64_t node) const -> vector_type
+{
+    vector_type vec;
+    auto row = vectors_[node];
+    vec.reserve(row.size());
+    for (const auto& weight : row)
+        vec.push_back(weight);
+    return vec;
+}
+
+double hnsw_index::similarity(const vector_type& query, uint64_t node) const
+{
+    auto row = vectors_[node];
+    double dot = 0;
+    uint64_t i = 0;
+    uint64_t j = 0;
+    while (i < query.size() && j < row.size())
+    {
+        if (query[i].first < row.term(j))
+            ++i;
+        else if (row.term(j) < query[i].first)
+            ++j;
+        else
+            dot += query[i++].second * row.value(j++);
+    }
+    return dot;
+}
+
+double hnsw_index::similarity(uint64_t a, uint64_t b) const
+{
+    auto first = vectors_[a];
+    auto second = vectors_[b];
+    double dot = 0;
+    uint64_t i = 0;
+    uint64_t j = 0;
+    while (i < first.size() && j < second.size())
+    {
+        if (first.term(i) < second.term(j))
+            ++i;
+        else if (second.term(j) < first.term(i))
+            ++j;
+        else
+            dot += first.value(i++) * second.value(j++);
+    }
+    return dot;
+}
+
+auto hnsw_index::search_layer(const vector_type& query,
+                              const std::vector<scored_node>& entry,
+                              uint64_t ef, uint64_t layer) const
+    -> std::vector<scored_node>
+{
+    std::unordered_set<uint64_t> visited;
+    std::priority_queue<scored_node> candidates;
+    std::priority_queue<scored_node, std::vector<scored_node>,
+                        std::greater<scored_node>> found;
+    for (const auto& e : entry)
+    {
+        visited.insert(e.second);
+        candidates.push(e);
+        found.push(e);
+        if (found.size() > ef)
+            found.pop();
+    }
+
+    while (!candidates.empty())
+    {
+        auto closest = candidates.top();
+        if (found.size() >= ef && closest.first < found.top().first)
+            break;
+        candidates.pop();
+
+        for (const auto& next : links_[closest.second][layer])
+        {
+            if (!visited.insert(next).second)
+                continue;
+            auto sim = similarity(query, next);
+            if (found.size() < ef || sim > found.top().first)
+            {
+                candidates.emplace(sim, next);
+                found.emplace(sim, next);
+                if (found.size() > ef)
+                    found.pop();
+            }
+        }
+    }
+
+    std::vector<scored_node> result(found.size());
+    for (auto it = result.rbegin(); it != result.rend(); ++it)
+    {
+        *it = found.top();
+        found.pop();
+    }
+    return result;
+}
+
+uint64_t hnsw_index::max_links(uint64_t layer) const
+{
+    return layer == 0 ? 2 * opts_.links : opts_.links;
+}
+
+std::vector<uint64_t>
+    hnsw_index::select(const std::vector<scored_node>& candidates,
+                       uint64_t num_links) const
+{
+    // a candidate is kept only if it is closer to the center than to every
+    // candidate already kept, so that the links point in many directions
+    // rather than into one cluster; the rest fill any links left over
+    std::vector<uint64_t> selected;
+    std::vector<uint64_t> skipped;
+    for (const auto& candidate : candidates)
+    {
+        if (selected.size() == num_links)
+            break;
+        bool diverse = true;
+        for (const auto& kept : selected)
+        {
+            if (similarity(candidate.second, kept) > candidate.first)
+            {
+                diverse = false;
+                break;
+            }
+        }
+        if (diverse)
+            selected.push_back(candidate.second);
+        else
+            skipped.push_back(candidate.second);
+    }
+    for (uint64_t i = 0; i < skipped.size() && selected.size() < num_links;
+         ++i)
+        selected.push_back(skipped[i]);
+    return selected;
+}
+
+void hnsw_index::insert(uint64_t node)
+{
+    auto level = links_[node].size() - 1;
+    if (node == 0)
+    {
+        entry_ = node;
+        top_layer_ = level;
+        return;
+    }
+
+    auto query = vector(node);
+    std::vector<scored_node> entry{{similarity(query, entry_), entry_}};
+    for (auto layer = top_layer_; layer > level; --layer)
+        entry.assign(1, search_layer(query, entry, 1, layer).front());
+
+    for (auto layer = std::min(level, top_layer_) + 1; layer-- > 0;)
+    {
+        auto found = search_layer(query, entry, opts_.ef_construction, layer);
+        links_[node][layer] = select(found, opts_.links);
+        for (const auto& other : links_[node][layer])
+        {
+            auto& back = links_[other][layer];
+            back.push_back(node);
+            if (back.size() > max_links(layer))
+            {
+                std::vector<scored_node> scored;
+                scored.reserve(back.size());
+                for (const auto& n : back)
+                    scored.emplace_back(similarity(other, n), n);
+                std::sort(scored.begin(), scored.end(),
+                          std::greater<scored_node>{});
+                back = select(scored, max_links(layer));
+            }
+        }
+        entry = std::move(found);
+    }
+
+    if (level > top_layer_)
+    {
+        entry_ = node;
+        top_layer_ = level;
+    }
+}
+
+std::vector<std::pair<doc_id, double>> hnsw_index::neighbors(
+    const std::vector<std::pair<term_id, double>>& counts, uint64_t k) const
+{
+    std::vector<std::pair<doc_id, double>> results;
+    if (links_.empty() || k == 0)
+        return results;
+
+    vector_type query;
+    query.reserve(counts.size());
+    double norm = 0;
+    for (const auto& count : counts)
+    {
+        // terms that no indexed document contains cannot match any of them,
+        // but still count towards the length of the query
+        auto idf = count.first < idf_.size()
+                       ? idf_[count.first]
+                       : std::log(1 + static_cast<double>(links_.size()));
+        query.emplace_back(count.first, count.second * idf);
+        norm += query.back().second * query.back().second;
+    }
+    std::sort(query.begin(), query.end());
+    norm = std::sqrt(norm);
+    if (norm > 0)
+    {
+        for (auto& weight : query)
+            weight.second /= norm;
+    }
+
+    std::vector<scored_node> entry{{similarity(query, entry_), entry_}};
+    for (auto layer = top_layer_; layer > 0; --layer)
+        entry.assign(1, search_layer(query, entry, 1, layer).front());
+    auto found
+        = search_layer(query, entry, std::max(opts_.ef_search, k), 0);
+
+    if (found.size() > k)
+        found.resize(k);
+    results.reserve(found.size());
+    for (const auto& node : found)
+        results.emplace_back(vectors_.doc(node.second), node.first);
+    return results;
+}
+
+uint64_t hnsw_index::size() const
+{
+    return vectors_.rows();
+}
+}
+}
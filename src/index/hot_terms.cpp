@@ -0,0 +1,104 @@
+/**
+ * @file hot_terms.cpp
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+
+#include "corpus/document.h"
+#include "index/hot_terms.h"
+#include "index/inverted_index.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/**
+ * @param terms Each term and its frequency
+ * @param max_terms The number of terms to return
+ * @return the most frequent terms, most frequent first, with ties broken
+ * by term_id so that the order is always the same
+ */
+std::vector<term_id>
+    most_frequent(std::vector<std::pair<term_id, uint64_t>> terms,
+                  uint64_t max_terms)
+{
+    auto last = terms.begin() + std::min<uint64_t>(max_terms, terms.size());
+    std::partial_sort(terms.begin(), last, terms.end(),
+                      [](const std::pair<term_id, uint64_t>& a,
+                         const std::pair<term_id, uint64_t>& b)
+                      {
+        if (a.second != b.second)
+            return a.second > b.second;
+        return a.first < b.first;
+    });
+
+    std::vector<term_id> ids;
+    ids.reserve(last - terms.begin());
+    for (auto it = terms.begin(); it != last; ++it)
+        ids.push_back(it->first);
+    return ids;
+}
+}
+
+std::vector<term_id> hot_terms_from_queries(inverted_index& idx,
+                                            std::istream& queries,
+                                            uint64_t max_terms)
+{
+    std::unordered_map<term_id, uint64_t> freqs;
+    std::string line;
+    while (std::getline(queries, line))
+    {
+        if (line.empty())
+            continue;
+
+        corpus::document query;
+        query.content(line);
+        idx.tokenize(query);
+        for (const auto& count : query.counts())
+        {
+            auto t_id = idx.get_term_id(count.first);
+            if (t_id < idx.unique_terms())
+                ++freqs[t_id];
+        }
+    }
+    return most_frequent({freqs.begin(), freqs.end()}, max_terms);
+}
+
+std::vector<term_id> hot_terms_from_counts(inverted_index& idx,
+                                           std::istream& counts,
+                                           uint64_t max_terms)
+{
+    std::unordered_map<term_id, uint64_t> freqs;
+    std::string line;
+    while (std::getline(counts, line))
+    {
+        std::istringstream fields{line};
+        std::string term;
+        uint64_t freq;
+        if (!(fields >> term >> freq))
+            continue;
+
+        auto t_id = idx.get_term_id(term);
+        if (t_id < idx.unique_terms())
+            freqs[t_id] += freq;
+    }
+    return most_frequent({freqs.begin(), freqs.end()}, max_terms);
+}
+
+std::vector<term_id> hot_terms_by_doc_freq(const inverted_index& idx,
+                                           uint64_t max_terms)
+{
+    std::vector<std::pair<term_id, uint64_t>> freqs;
+    freqs.reserve(idx.unique_terms());
+    for (term_id t_id{0}; t_id < idx.unique_terms(); ++t_id)
+        freqs.emplace_back(t_id, idx.doc_freq(t_id));
+    return most_frequent(std::move(freqs), max_terms);
+}
+}
+}
@@ -0,0 +1,226 @@
+/**
+ * @file hybrid_ranker.cpp
+ */
+
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+
+#include "cpptoml.h"
+#include "index/hybrid_ranker.h"
+#include "index/inverted_index.h"
+#include "index/ivf_index.h"
+#include "index/ranker/ranker.h"
+#include "index/vector_store.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/**
+ * The scores of a candidate document.
+ */
+struct candidate
+{
+    /// The lexical score, if known
+    double lexical = 0;
+    /// Whether the lexical score is known
+    bool has_lexical = false;
+    /// The dense score, if the document has a vector
+    double dense = 0;
+    /// Whether the document has a vector
+    bool has_dense = false;
+    /// The fused score
+    double fused = 0;
+};
+
+/**
+ * Scales a score to [0, 1] from the lowest to the highest of a set.
+ * @param score The score
+ * @param low The lowest score of the set
+ * @param high The highest score of the set
+ * @return the scaled score, one if every score of the set is the same
+ */
+double scaled(double score, double low, double high)
+{
+    return high > low ? (score - low) / (high - low) : 1.0;
+}
+
+/**
+ * Removes the documents a ranker returned only to fill its results: they
+ * match no query term and have the lowest score there is.
+ * @param results The results of ranker::score()
+ */
+void drop_unmatched(std::vector<std::pair<doc_id, double>>& results)
+{
+    results.erase(std::remove_if(results.begin(), results.end(),
+                                 [](const std::pair<doc_id, double>& result)
+                                 {
+                      return result.second
+                             == std::numeric_limits<double>::lowest();
+                  }),
+                  results.end());
+}
+}
+
+hybrid_ranker::hybrid_ranker(ranker& lexical, const vector_store& vectors,
+                             const ivf_index* ann,
+                             const hybrid_options& options)
+    : lexical_{&lexical}, vectors_{&vectors}, ann_{ann}, options_(options)
+{
+    if (options_.dense_weight < 0 || options_.dense_weight > 1)
+        throw hybrid_ranker_exception{"dense weight must be in [0, 1]"};
+    if (options_.rank_constant < 0)
+        throw hybrid_ranker_exception{"rank constant must not be negative"};
+}
+
+std::vector<std::pair<doc_id, double>> hybrid_ranker::score(
+    inverted_index& idx, corpus::document& query,
+    const std::vector<float>& embedding, uint64_t num_results,
+    const std::function<bool(doc_id d_id)>& filter)
+{
+    vectors_->check(embedding);
+    auto depth = std::max(options_.candidates, num_results);
+
+    auto lexical = lexical_->score(idx, query, depth, filter);
+    drop_unmatched(lexical);
+    auto keep = [&](doc_id d_id)
+    {
+        return !idx.is_deleted(d_id) && (!filter || filter(d_id));
+    };
+    auto dense = ann_ ? ann_->search(embedding, depth, keep)
+                      : vectors_->search(embedding, depth, keep);
+
+    std::unordered_map<doc_id, candidate> candidates;
+    if (options_.fusion == fusion_method::reciprocal_rank)
+    {
+        for (uint64_t i = 0; i < lexical.size(); ++i)
+            candidates[lexical[i].first].fused
+                += 1 / (options_.rank_constant + i + 1);
+        for (uint64_t i = 0; i < dense.size(); ++i)
+            candidates[dense[i].first].fused
+                += 1 / (options_.rank_constant + i + 1);
+    }
+    else
+    {
+        for (const auto& result : lexical)
+        {
+            auto& cand = candidates[result.first];
+            cand.lexical = result.second;
+            cand.has_lexical = true;
+        }
+        for (const auto& result : dense)
+        {
+            auto& cand = candidates[result.first];
+            cand.dense = result.second;
+            cand.has_dense = true;
+        }
+
+        // the lexical candidates' dense scores are a dot product each; the
+        // dense candidates' lexical scores take one more pass over the
+        // query terms' postings, restricted to them
+        std::vector<doc_id> missing;
+        for (auto& entry : candidates)
+        {
+            auto& cand = entry.second;
+            if (!cand.has_dense && vectors_->contains(entry.first))
+            {
+                cand.dense = vectors_->score(embedding.data(), entry.first);
+                cand.has_dense = true;
+            }
+            if (!cand.has_lexical)
+                missing.push_back(entry.first);
+        }
+        if (!missing.empty())
+        {
+            std::sort(missing.begin(), missing.end());
+            auto rescored = lexical_->score(
+                idx, query, missing.size(), [&](doc_id d_id)
+                {
+                    return std::binary_search(missing.begin(), missing.end(),
+                                              d_id);
+                });
+            drop_unmatched(rescored);
+            for (const auto& result : rescored)
+            {
+                auto it = candidates.find(result.first);
+                if (it == candidates.end())
+                    continue;
+                it->second.lexical = result.second;
+                it->second.has_lexical = true;
+            }
+        }
+
+        auto lex_low = std::numeric_limits<double>::infinity();
+        auto lex_high = -lex_low;
+        auto dense_low = lex_low;
+        auto dense_high = -lex_low;
+        for (const auto& entry : candidates)
+        {
+            // a candidate no lexical pass returned matches no query term
+            const auto& cand = entry.second;
+            lex_low = std::min(lex_low, cand.lexical);
+            lex_high = std::max(lex_high, cand.lexical);
+            if (cand.has_dense)
+            {
+                dense_low = std::min(dense_low, cand.dense);
+                dense_high = std::max(dense_high, cand.dense);
+            }
+        }
+
+        auto weight = options_.dense_weight;
+        for (auto& entry : candidates)
+        {
+            auto& cand = entry.second;
+            cand.fused = (1 - weight) * scaled(cand.lexical, lex_low, lex_high);
+            if (cand.has_dense)
+                cand.fused += weight * scaled(cand.dense, dense_low, dense_high);
+        }
+    }
+
+    std::vector<std::pair<doc_id, double>> results;
+    results.reserve(candidates.size());
+    for (const auto& entry : candidates)
+        results.emplace_back(entry.first, entry.second.fused);
+    std::sort(results.begin(), results.end(),
+              [](const std::pair<doc_id, double>& a,
+                 const std::pair<doc_id, double>& b)
+              {
+        if (a.second != b.second)
+            return a.second > b.second;
+        return a.first < b.first;
+    });
+    if (results.size() > num_results)
+        results.resize(num_results);
+    return results;
+}
+
+hybrid_options make_hybrid_options(const cpptoml::table& config)
+{
+    hybrid_options options;
+    auto table = config.get_table("hybrid");
+    if (!table)
+        return options;
+
+    if (auto fusion = table->get_as<std::string>("fusion"))
+    {
+        if (*fusion == "linear")
+            options.fusion = fusion_method::linear;
+        else if (*fusion == "rrf")
+            options.fusion = fusion_method::reciprocal_rank;
+        else
+            throw hybrid_ranker_exception{"unknown fusion method: " + *fusion};
+    }
+    if (auto weight = table->get_as<double>("dense-weight"))
+        options.dense_weight = *weight;
+    if (auto candidates = table->get_as<int64_t>("candidates"))
+        options.candidates = static_cast<uint64_t>(*candidates);
+    if (auto constant = table->get_as<double>("rank-constant"))
+        options.rank_constant = *constant;
+    return options;
+}
+}
+}
@@ -0,0 +1,415 @@
+/**
+ * @file impact_index.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <future>
+#include <queue>
+#include <sstream>
+
+#include "corpus/document.h"
+#include "cpptoml.h"
+#include "index/deleted_docs.h"
+#include "index/impact_index.h"
+#include "index/inverted_index.h"
+#include "index/postings_cursor.h"
+#include "index/ranker/ranker.h"
+#include "index/ranker/ranker_factory.h"
+#include "index/score_data.h"
+#include "io/stream_vbyte.h"
+#include "parallel/thread_pool.h"
+#include "util/filesystem.h"
+#include "util/shim.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/// The largest quantized impact
+const uint64_t max_level = 255;
+
+/**
+ * A query term's segments during score-at-a-time processing.
+ */
+struct term_segments
+{
+    /// The next segment, or the end of the term's segments
+    const uint8_t* next;
+    /// The number of segments not yet processed
+    uint64_t remaining;
+    /// The impact of one quantization level
+    double scale;
+    /// The weight of the term in the query
+    double weight;
+    /// The score each document of the next segment gets from it
+    double contribution;
+};
+
+/**
+ * Reads the header of a term's next segment.
+ * @param term The term
+ */
+void peek(term_segments& term)
+{
+    term.contribution = term.remaining == 0
+                            ? 0.0
+                            : term.weight * term.scale * *term.next;
+}
+}
+
+impact_index::impact_index(inverted_index& idx, ranker& r,
+                           uint64_t num_threads /* = hardware_concurrency */)
+    : idx_{&idx}, dir_{idx.index_name() + "/impacts"}
+{
+    auto sig = signature(r);
+    if (!filesystem::file_exists(dir_ + "/signature")
+        || filesystem::file_text(dir_ + "/signature") != sig)
+        build(r, std::max<uint64_t>(1, num_threads));
+
+    parameters_ = r.parameters();
+    if (filesystem::file_size(dir_ + "/postings") > 0)
+        postings_ = io::mmap_file{dir_ + "/postings"};
+    offsets_ = util::disk_vector<uint64_t>{dir_ + "/postings.offsets"};
+    priors_ = util::disk_vector<double>{dir_ + "/docs.priors"};
+    max_prior_ = 0;
+    if (priors_->size() > 0)
+        max_prior_ = *std::max_element(priors_->begin(), priors_->end());
+}
+
+std::string impact_index::signature(ranker& r) const
+{
+    std::ostringstream sig;
+    sig << r.parameters() << '\n'
+        << idx_->num_docs() << ' ' << idx_->unique_terms() << ' '
+        << idx_->total_corpus_terms() << '\n';
+    return sig.str();
+}
+
+void impact_index::build(ranker& r, uint64_t num_threads)
+{
+    auto& idx = *idx_;
+    filesystem::remove_all(dir_);
+    filesystem::make_directory(dir_);
+
+    // impacts are the scores for a query term of weight one, in a query of
+    // length one
+    corpus::document unit;
+    unit.increment("[impact]", 1);
+    auto avg_dl = idx.avg_doc_length();
+    auto total_terms = idx.total_corpus_terms();
+    auto num_docs = idx.num_docs();
+    auto num_terms = idx.unique_terms();
+
+    {
+        util::disk_vector<double> priors{dir_ + "/docs.priors", num_docs};
+        score_data sd{idx, avg_dl, num_docs, total_terms, unit};
+        for (uint64_t d = 0; d < num_docs; ++d)
+        {
+            sd.d_id = doc_id{d};
+            auto info = idx.doc_info(sd.d_id);
+            sd.doc_size = info.length;
+            sd.doc_unique_terms = info.unique_terms;
+            priors[d] = r.initial_score(sd);
+        }
+    }
+
+    // each thread writes the segments of a contiguous range of terms to
+    // its own part, and the parts are concatenated in order
+    auto num_parts = std::max<uint64_t>(
+        1, std::min<uint64_t>(num_threads, num_terms));
+    std::vector<std::vector<uint64_t>> part_offsets(num_parts);
+    auto worker = [&](uint64_t part)
+    {
+        auto first = num_terms * part / num_parts;
+        auto last = num_terms * (part + 1) / num_parts;
+        std::ofstream out{dir_ + "/postings.part-" + std::to_string(part),
+                          std::ios::binary};
+        auto& offsets = part_offsets[part];
+        offsets.reserve(last - first);
+        uint64_t bytes = 0;
+
+        score_data sd{idx, avg_dl, num_docs, total_terms, unit};
+        std::vector<std::pair<double, doc_id>> impacts;
+        std::vector<std::pair<uint64_t, doc_id>> levels;
+        for (auto t = first; t < last; ++t)
+        {
+            offsets.push_back(bytes);
+            auto cursor = idx.cursor(term_id{t});
+            sd.t_id = term_id{t};
+            sd.query_term_weight = 1;
+            sd.doc_count = idx.doc_freq(sd.t_id);
+            sd.corpus_term_count = idx.total_num_occurences(sd.t_id);
+            sd.corpus_term_prob = idx.collection_probability(sd.t_id);
+
+            impacts.clear();
+            double max_impact = 0;
+            for (; !cursor.at_end(); cursor.next())
+            {
+                sd.d_id = cursor.doc();
+                sd.doc_term_count = cursor.count();
+                auto info = idx.doc_info(sd.d_id);
+                sd.doc_size = info.length;
+                sd.doc_unique_terms = info.unique_terms;
+                auto impact = r.score_one(sd);
+                if (impact > 0)
+                {
+                    impacts.emplace_back(impact, sd.d_id);
+                    max_impact = std::max(max_impact, impact);
+                }
+            }
+
+            double scale = max_impact / max_level;
+            levels.clear();
+            for (const auto& impact : impacts)
+            {
+                auto level = std::lround(impact.first / scale);
+                levels.emplace_back(
+                    std::min<uint64_t>(
+                        max_level, std::max<uint64_t>(
+                                       1, static_cast<uint64_t>(level))),
+                    impact.second);
+            }
+            std::sort(levels.begin(), levels.end(),
+                      [](const std::pair<uint64_t, doc_id>& a,
+                         const std::pair<uint64_t, doc_id>& b)
+                      {
+                          return a.first > b.first
+                                 || (a.first == b.first
+                                     && a.second < b.second);
+                      });
+
+            uint64_t num_segments = 0;
+            for (uint64_t i = 0; i < levels.size(); ++i)
+            {
+                if (i == 0 || levels[i].first != levels[i - 1].first)
+                    ++num_segments;
+            }
+
+            // the scale, the number of segments, and then each segment's
+            // level, length, and doc_id gaps
+            out.write(reinterpret_cast<const char*>(&scale), sizeof(scale));
+            bytes += sizeof(scale);
+            bytes += io::stream_vbyte::write_varint(out, num_segments);
+            for (uint64_t i = 0; i < levels.size();)
+            {
+                auto level = levels[i].first;
+                auto end = i;
+                while (end < levels.size() && levels[end].first == level)
+                    ++end;
+                out.put(static_cast<char>(level));
+                bytes += 1;
+                bytes += io::stream_vbyte::write_varint(out, end - i);
+                uint64_t last_doc = 0;
+                for (; i < end; ++i)
+                {
+                    uint64_t d_id{levels[i].second};
+                    bytes += io::stream_vbyte::write_varint(out,
+                                                            d_id - last_doc);
+                    last_doc = d_id;
+                }
+            }
+        }
+    };
+
+    {
+        parallel::thread_pool pool{num_parts};
+        std::vector<std::future<void>> futures;
+        for (uint64_t part = 0; part < num_parts; ++part)
+            futures.push_back(pool.submit_task([&, part]()
+                                               {
+                                                   worker(part);
+                                               }));
+        for (auto& fut : futures)
+            fut.get();
+    }
+
+    {
+        std::ofstream out{dir_ + "/postings", std::ios::binary};
+        util::disk_vector<uint64_t> offsets{dir_ + "/postings.offsets",
+                                            num_terms + 1};
+        uint64_t base = 0;
+        uint64_t t = 0;
+        for (uint64_t part = 0; part < num_parts; ++part)
+        {
+            for (const auto& offset : part_offsets[part])
+                offsets[t++] = base + offset;
+
+            auto path = dir_ + "/postings.part-" + std::to_string(part);
+            base += filesystem::file_size(path);
+            {
+                std::ifstream in{path, std::ios::binary};
+                out << in.rdbuf();
+            }
+            filesystem::delete_file(path);
+        }
+        offsets[num_terms] = base;
+    }
+
+    // written last, so that an interrupted build is redone
+    std::ofstream sig{dir_ + "/signature"};
+    sig << signature(r);
+}
+
+std::vector<std::pair<doc_id, double>>
+    impact_index::score(corpus::document& query, uint64_t num_results,
+                        uint64_t max_postings)
+{
+    auto& idx = *idx_;
+    if (query.counts().empty())
+        idx.tokenize(query);
+    if (num_results == 0)
+        return {};
+
+    std::vector<std::string> words;
+    std::vector<double> weights;
+    for (const auto& count : query.counts())
+    {
+        words.push_back(count.first);
+        weights.push_back(count.second);
+    }
+    auto t_ids = idx.get_term_ids(words);
+
+    std::vector<term_segments> terms;
+    for (uint64_t i = 0; i < t_ids.size(); ++i)
+    {
+        uint64_t t{t_ids[i]};
+        if (t >= idx.unique_terms() || weights[i] <= 0)
+            continue;
+        auto in = reinterpret_cast<const uint8_t*>(postings_->begin()
+                                                   + (*offsets_)[t]);
+        term_segments term;
+        std::memcpy(&term.scale, in, sizeof(term.scale));
+        in += sizeof(term.scale);
+        term.remaining = io::stream_vbyte::read_varint(in);
+        term.next = in;
+        term.weight = weights[i];
+        peek(term);
+        terms.push_back(term);
+    }
+
+    // every term's next segment, by decreasing contribution; the sum of
+    // their contributions bounds what any document can still gain
+    auto by_contribution = [&](uint64_t a, uint64_t b)
+    {
+        return terms[a].contribution < terms[b].contribution;
+    };
+    std::priority_queue<uint64_t, std::vector<uint64_t>,
+                        decltype(by_contribution)> order{by_contribution};
+    double remaining = 0;
+    for (uint64_t i = 0; i < terms.size(); ++i)
+    {
+        if (terms[i].remaining > 0)
+            order.push(i);
+        remaining += terms[i].contribution;
+    }
+
+    // the accumulators are kept between queries; only the entries a
+    // query touches are reset after it
+    static thread_local std::vector<double> scores;
+    static thread_local std::vector<bool> seen;
+    if (seen.size() != idx.num_docs())
+    {
+        scores.assign(idx.num_docs(), 0.0);
+        seen.assign(idx.num_docs(), false);
+    }
+    std::vector<doc_id> touched;
+
+    const auto& deleted = idx.deleted();
+    auto query_length = static_cast<double>(query.length());
+    auto max_score = std::numeric_limits<double>::lowest();
+    uint64_t num_postings = 0;
+    std::vector<double> candidates;
+    while (!order.empty() && num_postings < max_postings)
+    {
+        auto& term = terms[order.top()];
+        order.pop();
+
+        auto in = term.next + 1;
+        auto length = io::stream_vbyte::read_varint(in);
+        uint64_t d_id = 0;
+        for (uint64_t i = 0; i < length; ++i)
+        {
+            d_id += io::stream_vbyte::read_varint(in);
+            if (deleted.contains(doc_id{d_id}))
+                continue;
+            if (!seen[d_id])
+            {
+                seen[d_id] = true;
+                touched.emplace_back(d_id);
+                scores[d_id] = (*priors_)[d_id] * query_length;
+            }
+            scores[d_id] += term.contribution;
+            max_score = std::max(max_score, scores[d_id]);
+        }
+        num_postings += length;
+
+        remaining -= term.contribution;
+        term.next = in;
+        --term.remaining;
+        peek(term);
+        remaining += term.contribution;
+        if (term.remaining > 0)
+            order.push(static_cast<uint64_t>(&term - terms.data()));
+
+        // the top k can no longer change once the k-th best document is
+        // out of reach of the one after it and of every unseen document
+        if (touched.size() < num_results || remaining > max_score)
+            continue;
+        candidates.clear();
+        for (const auto& d : touched)
+            candidates.push_back(scores[d]);
+        std::nth_element(candidates.begin(),
+                         candidates.begin() + (num_results - 1),
+                         candidates.end(), std::greater<double>());
+        auto kth = candidates[num_results - 1];
+        auto next = std::numeric_limits<double>::lowest();
+        if (candidates.size() > num_results)
+            next = *std::max_element(candidates.begin() + num_results,
+                                     candidates.end());
+        if (kth >= next + remaining
+            && kth >= max_prior_ * query_length + remaining)
+            break;
+    }
+
+    std::vector<std::pair<doc_id, double>> results;
+    results.reserve(touched.size());
+    for (const auto& d : touched)
+    {
+        results.emplace_back(d, scores[d]);
+        seen[d] = false;
+    }
+    auto best = std::min<uint64_t>(num_results, results.size());
+    std::partial_sort(results.begin(), results.begin() + best, results.end(),
+                      [](const std::pair<doc_id, double>& a,
+                         const std::pair<doc_id, double>& b)
+                      {
+                          return a.second > b.second
+                                 || (a.second == b.second
+                                     && a.first < b.first);
+                      });
+    results.resize(best);
+    return results;
+}
+
+const std::string& impact_index::parameters() const
+{
+    return parameters_;
+}
+
+std::unique_ptr<impact_index> make_impact_index(inverted_index& idx,
+                                                const cpptoml::table& config)
+{
+    auto table = config.get_table("impacts");
+    if (!table)
+        return nullptr;
+    auto r = make_ranker(*table);
+    return make_unique<impact_index>(idx, *r);
+}
+}
+}
@@ -4,26 +4,158 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <numeric>
+#include <queue>
+
+#include "corpus/batch_reader.h"
 #include "corpus/corpus.h"
+#include "corpus/feature_vocabulary.h"
 #include "index/chunk_handler.h"
+#include "index/completion_index.h"
+#include "index/distributed_build.h"
 #include "index/disk_index_impl.h"
 #include "index/inverted_index.h"
+#include "index/positions_cursor.h"
+#include "index/postings_cursor.h"
 #include "index/string_list.h"
 #include "index/string_list_writer.h"
 #include "index/vocabulary_map.h"
 #include "index/vocabulary_map_writer.h"
+#include "io/mmap_file.h"
+#include "io/stream_vbyte.h"
+#include "parallel/stage_counter.h"
 #include "parallel/thread_pool.h"
 #include "analyzers/analyzer.h"
+#include "util/arena.h"
 #include "util/mapping.h"
+#include "util/metrics.h"
+#include "util/offset_vector.h"
 #include "util/pimpl.tcc"
 #include "util/progress.h"
 #include "util/shim.h"
+#include "util/trace.h"
 
 namespace meta
 {
 namespace index
 {
 
+namespace
+{
+/**
+ * The encodings supported for the postings file.
+ */
+enum class postings_codec
+{
+    /// Elias-gamma codes, read and written one bit at a time
+    gamma,
+    /// blocks of Stream VByte encoded gaps and counts
+    block
+};
+
+/**
+ * @param config The configuration for the index
+ * @return the postings codec requested by the configuration
+ */
+postings_codec load_postings_codec(const cpptoml::table& config)
+{
+    auto codec = config.get_as<std::string>("postings-codec");
+    if (!codec || *codec == "gamma")
+        return postings_codec::gamma;
+    if (*codec == "block")
+        return postings_codec::block;
+    throw inverted_index::inverted_index_exception{"unknown postings codec: "
+                                                   + *codec};
+}
+
+/**
+ * Describes the chunks used to collect postings while indexing. Their
+ * primary keys are the feature ids the tokenizing threads give the terms
+ * in a shared corpus::feature_vocabulary, which only become term_ids once
+ * every term has been seen, so the chunks compare and store integers
+ * rather than strings.
+ */
+struct term_chunks
+{
+    using index_pdata_type = postings_data<term_id, doc_id>;
+};
+
+/**
+ * Describes the chunks used to collect term positions while indexing.
+ * Each posting is keyed on the pair (doc_id, position), with the doc_id in
+ * the high 32 bits, so the chunks are merged and gap coded exactly like
+ * the ordinary postings. Terms are keyed by feature id, as in term_chunks.
+ */
+struct positional_chunks
+{
+    using index_pdata_type = postings_data<term_id, uint64_t>;
+};
+
+/// The largest position that can be stored in a positional chunk key
+const uint64_t max_position = (uint64_t{1} << 32) - 1;
+
+/**
+ * A contiguous range of terms whose postings are compressed into a file of
+ * their own while the chunks are merged, to be appended to the postings
+ * file afterwards.
+ */
+struct postings_segment
+{
+    /// the path to the segment's postings
+    std::string path;
+    /// the output for the gamma codec
+    std::unique_ptr<io::default_compressed_file_writer> out;
+    /// the output for the block codec
+    std::ofstream packed_out;
+    /// the number of bytes written to packed_out
+    uint64_t packed_bytes = 0;
+    /// the term_id of each term in the segment, when they are merged from
+    /// chunks and are not in term_id order
+    std::vector<term_id> ids;
+    /// the offset of each term's postings from the start of the segment
+    std::vector<uint64_t> locations;
+    /// the number of documents containing each term
+    std::vector<uint64_t> doc_freqs;
+    /// the number of occurrences of each term
+    std::vector<uint64_t> counts;
+};
+
+/**
+ * @param src An index being merged
+ * @param specs The fields of the merged index
+ * @param d_id A document of src
+ * @return the document's values of the fields, as text
+ */
+std::vector<std::string> source_fields(const inverted_index& src,
+                                       const std::vector<field_spec>& specs,
+                                       doc_id d_id)
+{
+    const auto& fields = src.fields();
+    auto values = fields.values(d_id);
+    std::vector<std::string> result;
+    result.reserve(specs.size());
+    for (const auto& spec : specs)
+    {
+        auto it = std::find_if(fields.fields().begin(), fields.fields().end(),
+                               [&](const field_spec& field)
+                               {
+                                   return field.name == spec.name
+                                          && field.type == spec.type;
+                               });
+        if (it == fields.fields().end())
+            throw field_store::field_store_exception{
+                "merged index lacks field " + spec.name + ": "
+                + src.index_name()};
+        result.push_back(values[it - fields.fields().begin()]);
+    }
+    return result;
+}
+}
+
 /**
  * Implementation of an inverted_index.
  */
@@ -44,10 +176,16 @@ class inverted_index::impl
     /**
      * @param docs The documents to be tokenized
      * @param handler The chunk handler for this index
-     * @return the number of chunks created
+     * @param positions The chunk handler for term positions, or nullptr
+     * if positions are not being stored
+     * @param vocab The vocabulary whose feature ids key the chunks
+     * @return a future that completes once the doc_id mapping, which is
+     * compressed while the chunks are merged, has been written
      */
-    void tokenize_docs(corpus::corpus* docs,
-                       chunk_handler<inverted_index>& handler);
+    std::future<void> tokenize_docs(corpus::corpus* docs,
+                                    chunk_handler<term_chunks>& handler,
+                                    chunk_handler<positional_chunks>* positions,
+                                    corpus::feature_vocabulary& vocab);
 
     /**
      * Creates the lexicon file (or "dictionary") which has pointers into
@@ -59,9 +197,155 @@ class inverted_index::impl
                         const std::string& lexicon_file);
 
     /**
-     * Compresses the large postings file.
+     * Merges the chunks written while creating the index into its
+     * postings and positions files, and loads the rest of its metadata.
+     * @param handler The chunk handler for this index
+     * @param positions The chunk handler for term positions, or nullptr
+     * if positions are not being stored
+     * @param vocab The vocabulary whose feature ids key the chunks
+     * @param doc_ids The future returned by tokenize_docs()
      */
-    void compress(const std::string& filename, uint64_t num_unique_terms);
+    void finish_create(chunk_handler<term_chunks>& handler,
+                       chunk_handler<positional_chunks>* positions,
+                       const corpus::feature_vocabulary& vocab,
+                       std::future<void>& doc_ids);
+
+    /**
+     * Merges the postings chunks straight into the compressed postings
+     * file and the lexicon, without writing an uncompressed postings file
+     * first. Ranges of terms are merged and compressed in parallel into
+     * segments, which are concatenated afterwards, while the vocabulary
+     * is written on another thread.
+     * @param handler The chunk handler holding the postings chunks
+     * @param vocab The vocabulary whose feature ids key the chunks
+     * @param term_ids The term_id of each feature id
+     * @return the number of unique terms in the index
+     */
+    uint64_t merge_postings(chunk_handler<term_chunks>& handler,
+                            const corpus::feature_vocabulary& vocab,
+                            const std::vector<term_id>& term_ids);
+
+    /**
+     * Merges the positional chunks straight into the positions file, which
+     * stores each term's positions in the same order as its postings.
+     * @param handler The chunk handler holding the positional chunks
+     * @param term_ids The term_id of each feature id
+     * @param num_unique_terms The number of terms in the index
+     */
+    void merge_positions(chunk_handler<positional_chunks>& handler,
+                         const std::vector<term_id>& term_ids,
+                         uint64_t num_unique_terms);
+
+    /**
+     * Merges the postings (and positions) of existing indexes straight
+     * into the postings and positions files, and loads the rest of the
+     * metadata. The vocabularies of the sources are merged a term at a
+     * time, so nothing is tokenized or written to chunks.
+     * @param sources The indexes whose postings are merged; the documents
+     * of each follow those of the sources before it
+     * @param keep Whether to keep a posting, given its term and document
+     * in its source and its count; every posting is kept if it is empty
+     * @param with_positions Whether to merge the positions as well
+     */
+    void finish_merge(
+        const std::vector<std::shared_ptr<inverted_index>>& sources,
+        const std::function<bool(term_id, doc_id, uint64_t)>& keep,
+        bool with_positions);
+
+    /**
+     * Opens the segments that the postings are compressed into.
+     * @param segments The segments, one for each range of terms
+     */
+    void open_segments(std::vector<postings_segment>& segments) const;
+
+    /**
+     * Compresses a term's postings onto the end of a segment; the caller
+     * records which term they belong to.
+     * @param seg The segment
+     * @param pdata The postings of the term
+     */
+    template <class PrimaryKey>
+    void write_postings(postings_segment& seg,
+                        const postings_data<PrimaryKey, doc_id>& pdata) const;
+
+    /**
+     * Closes the segments and concatenates them into the postings file,
+     * writing the lexicon of their terms at the same time. The vocabulary
+     * is written by the caller.
+     * @param segments The segments, in order by their terms unless they
+     * record the term_id of each of their terms
+     * @return the number of unique terms in the index
+     */
+    uint64_t finish_postings(std::vector<postings_segment>& segments);
+
+    /**
+     * Writes the positions of a term, gap coded within each document.
+     * @param out The stream to write them to
+     * @param pdata The positions of the term, keyed on (doc_id, position)
+     * as in the positional chunks
+     * @return the number of bytes written
+     */
+    static uint64_t
+        write_positions(std::ostream& out,
+                        const positional_chunks::index_pdata_type& pdata);
+
+    /**
+     * Loads the metadata of an index whose postings were just written.
+     */
+    void load_created();
+
+    /**
+     * Builds the index's completion_index, if the configuration asks for
+     * one. Called once the term statistics of a new index are final.
+     */
+    void save_completions();
+
+    /**
+     * Maps the positions file into memory, if there is one.
+     */
+    void load_positions();
+
+    /**
+     * @return the path of the hot tier's postings file, which is given by
+     * "hot-postings" in the configuration or else kept in the index
+     */
+    std::string hot_postings_path() const;
+
+    /**
+     * Maps the hot tier into memory, if the index has one.
+     */
+    void load_hot_tier();
+
+    /**
+     * Deletes the hot tier, if the index has one.
+     */
+    void drop_hot_tier();
+
+    /**
+     * @param idx The term_id of a term in the index
+     * @return the file holding the term's postings, from the hot tier if
+     * it is there, and the location of the postings in the file
+     */
+    std::pair<const io::mmap_file*, uint64_t> locate(uint64_t idx) const;
+
+    /**
+     * Writes the statistics of the whole corpus beside the index, so that
+     * opening it later need not compute them from every document.
+     */
+    void save_corpus_stats();
+
+    /**
+     * Reads the statistics written by save_corpus_stats(), if they are
+     * there and describe this index; otherwise they are computed when
+     * they are first needed.
+     */
+    void load_corpus_stats();
+
+    /**
+     * Writes the probability of each term in the collection language
+     * model from the term counts and the total number of terms.
+     */
+    void save_term_probs();
 
     /// The analyzer used to tokenize documents.
     std::unique_ptr<analyzers::analyzer> analyzer_;
@@ -70,7 +354,73 @@ class inverted_index::impl
      * PrimaryKey -> postings location.
      * Each index corresponds to a PrimaryKey (uint64_t).
      */
-    util::optional<util::disk_vector<uint64_t>> term_bit_locations_;
+    util::optional<util::offset_vector> term_bit_locations_;
+
+    /**
+     * PrimaryKey -> number of documents containing the term. Written
+     * alongside the lexicon so that doc_freq() needs no decoding; may be
+     * missing for indexes created before it was added.
+     */
+    util::optional<util::disk_vector<uint64_t>> doc_freqs_;
+
+    /**
+     * PrimaryKey -> number of occurrences of the term in the corpus.
+     */
+    util::optional<util::disk_vector<uint64_t>> term_counts_;
+
+    /**
+     * PrimaryKey -> probability of the term in the collection language
+     * model, its count over the total number of term occurrences.
+     */
+    util::optional<util::disk_vector<double>> term_probs_;
+
+    /**
+     * PrimaryKey -> byte offset of the term's positions in positions_.
+     */
+    util::optional<util::offset_vector> position_locations_;
+
+    /**
+     * The positions of every term occurrence, kept apart from the postings
+     * so that queries that only need counts never read them.
+     */
+    util::optional<io::mmap_file> positions_;
+
+    /**
+     * PrimaryKey -> location of the term's postings in hot_postings_, with
+     * one more entry for the end of the file. A term is in the hot tier
+     * if its location differs from the next one.
+     */
+    util::optional<util::offset_vector> hot_locations_;
+
+    /// The postings of the terms in the hot tier (see tier_postings())
+    util::optional<io::mmap_file> hot_postings_;
+
+    /// The path of the hot tier's postings file, if it is not in the index
+    std::string hot_path_;
+
+    /// How the hot tier is brought into memory, if not like the index
+    util::optional<io::residency> hot_residency_;
+
+    /// whether new indexes should store term positions
+    bool store_positions_;
+
+    /// the number of parts to build new indexes in, if they are built in
+    /// checkpoints
+    uint64_t checkpoints_ = 0;
+
+    /// whether documents are tokenized into the feature ids of a shared
+    /// vocabulary instead of into maps of their own terms
+    bool feature_hashing_;
+
+    /// how to rank the completions of new indexes, if they should have a
+    /// completion_index
+    util::optional<completion_options> completions_;
+
+    /**
+     * The codec used for the postings file. For the block codec,
+     * term_bit_locations_ holds byte offsets rather than bit offsets.
+     */
+    postings_codec codec_;
 
     /// the total number of term occurrences in the entire corpus
     uint64_t total_corpus_terms_;
@@ -79,14 +429,34 @@ class inverted_index::impl
 inverted_index::impl::impl(inverted_index* idx, const cpptoml::table& config)
     : idx_{idx},
       analyzer_{analyzers::analyzer::load(config)},
+      codec_{load_postings_codec(config)},
       total_corpus_terms_{0}
 {
-    // nothing
+    auto store_positions = config.get_as<bool>("store-positions");
+    store_positions_ = store_positions && *store_positions;
+    auto feature_hashing = config.get_as<bool>("feature-hashing");
+    feature_hashing_ = feature_hashing && *feature_hashing;
+    auto autocomplete = config.get_as<bool>("autocomplete");
+    if (autocomplete && *autocomplete)
+        completions_ = make_completion_options(config);
+    if (auto checkpoints = config.get_as<int64_t>("build-checkpoints"))
+        checkpoints_
+            = static_cast<uint64_t>(std::max<int64_t>(0, *checkpoints));
+    if (auto hot_path = config.get_as<std::string>("hot-postings"))
+        hot_path_ = *hot_path;
+    if (auto hot_res = config.get_as<std::string>("hot-postings-residency"))
+        hot_residency_ = io::parse_residency(*hot_res);
 }
 
 inverted_index::inverted_index(const cpptoml::table& config)
-    : disk_index{config, *config.get_as<std::string>("inverted-index")},
-      inv_impl_{this, config}
+    : inverted_index{config, *config.get_as<std::string>("inverted-index")}
+{
+    // nothing
+}
+
+inverted_index::inverted_index(const cpptoml::table& config,
+                               const std::string& name)
+    : disk_index{config, name}, inv_impl_{this, config}
 {
     // nothing
 }
@@ -107,43 +477,210 @@ bool inverted_index::valid() const
             return false;
         }
     }
+
+    // an index built in checkpoints is only complete once the plan of its
+    // parts has been removed (see plan_build())
+    if (inv_impl_->checkpoints_ > 1
+        && filesystem::file_exists(index_name() + ".plan"))
+    {
+        LOG(info) << "Interrupted checkpointed build detected; resuming"
+                  << ENDLG;
+        return false;
+    }
     return true;
 }
 
 void inverted_index::create_index(const std::string& config_file)
+{
+    // load the documents from the corpus
+    auto docs = corpus::corpus::load(config_file);
+    if (inv_impl_->checkpoints_ > 1)
+    {
+        if (dynamic_cast<corpus::line_corpus*>(docs.get()))
+        {
+            auto num_docs = docs->size();
+            docs.reset();
+            create_index_in_parts(config_file, num_docs);
+            return;
+        }
+        LOG(warning) << "Only a line corpus can be built in checkpoints; "
+                        "building the index at once" << ENDLG;
+    }
+    create_index(config_file, *docs);
+}
+
+void inverted_index::create_index_in_parts(const std::string& config_file,
+                                           uint64_t num_docs)
+{
+    auto num_parts = inv_impl_->checkpoints_;
+
+    // the plan of an interrupted build is resumed, as long as it still
+    // describes the corpus
+    bool resume = false;
+    try
+    {
+        auto plan = load_build_plan(config_file);
+        resume = plan.num_docs == num_docs && plan.parts.size() == num_parts;
+    }
+    catch (distributed_build_exception&)
+    {
+        // there is no plan to resume
+    }
+    if (!resume)
+    {
+        // the parts of any other plan hold other documents
+        remove_build(config_file);
+        plan_build(config_file, num_parts);
+    }
+
+    uint64_t built = 0;
+    for (uint64_t i = 0; i < num_parts; ++i)
+        built += part_built(config_file, i);
+    if (built > 0)
+        LOG(info) << "Resuming the build of " << index_name() << ": " << built
+                  << " of " << num_parts << " parts are built" << ENDLG;
+
+    for (uint64_t i = 0; i < num_parts; ++i)
+    {
+        if (!part_built(config_file, i))
+            build_part(config_file, i);
+    }
+
+    // the plan is only removed once the parts are merged, so that a build
+    // interrupted while merging merges them again
+    create_index(config_file, load_parts(config_file));
+    remove_build(config_file);
+}
+
+void inverted_index::create_index(const std::string& config_file,
+                                  corpus::corpus& docs)
 {
     // save the config file so we can recreate the analyzer
+    trace::scoped_event event{"create_index", "index"};
     filesystem::copy_file(config_file, index_name() + "/config.toml");
 
     LOG(info) << "Creating index: " << index_name() << ENDLG;
 
-    // load the documents from the corpus
-    auto docs = corpus::corpus::load(config_file);
-
-    uint64_t num_docs = docs->size();
+    uint64_t num_docs = docs.size();
     impl_->initialize_metadata(num_docs);
 
-    chunk_handler<inverted_index> handler{index_name()};
-    inv_impl_->tokenize_docs(docs.get(), handler);
+    // the term positions, when they are kept, get half of the budget
+    uint64_t budget = impl_->ram_budget();
+    if (budget == 0)
+        budget = chunk_handler<term_chunks>::default_ram_budget;
+    if (inv_impl_->store_positions_)
+        budget /= 2;
 
-    impl_->load_doc_id_mapping();
+    chunk_handler<term_chunks> handler{index_name(), budget};
+    std::unique_ptr<chunk_handler<positional_chunks>> positions;
+    if (inv_impl_->store_positions_)
+    {
+        filesystem::make_directory(index_name() + "/positions");
+        positions = make_unique<chunk_handler<positional_chunks>>(
+            index_name() + "/positions", budget);
+    }
+    corpus::feature_vocabulary vocab;
+    auto doc_ids
+        = inv_impl_->tokenize_docs(&docs, handler, positions.get(), vocab);
 
-    handler.merge_chunks();
+    inv_impl_->finish_create(handler, positions.get(), vocab, doc_ids);
+    inv_impl_->save_completions();
+}
 
-    LOG(info) << "Created uncompressed postings file " << index_name()
-              << impl_->files[POSTINGS] << " ("
-              << printing::bytes_to_units(handler.final_size()) << ")" << ENDLG;
+void inverted_index::create_index(
+    const std::string& config_file,
+    const std::vector<std::shared_ptr<inverted_index>>& sources)
+{
+    LOG(info) << "Merging " << sources.size()
+              << " indexes into: " << index_name() << ENDLG;
+    copy_postings(config_file, sources, nullptr);
+    inv_impl_->save_completions();
+}
 
-    uint64_t num_unique_terms = handler.unique_primary_keys();
-    inv_impl_->compress(index_name() + impl_->files[POSTINGS],
-                        num_unique_terms);
+void inverted_index::create_index(
+    const std::string& config_file,
+    const std::shared_ptr<inverted_index>& source,
+    const std::function<bool(term_id, doc_id, uint64_t)>& keep)
+{
+    LOG(info) << "Pruning " << source->index_name()
+              << " into: " << index_name() << ENDLG;
+    copy_postings(config_file, {source}, keep);
 
-    impl_->load_term_id_mapping();
+    // the kept postings are scored with the statistics of all of them, so
+    // that a pruned index ranks its documents as the source would; terms
+    // that lost every posting are not in the pruned index at all
+    std::vector<std::string> terms;
+    terms.reserve(unique_terms());
+    for (term_id t_id{0}; t_id < unique_terms(); ++t_id)
+        terms.push_back(term_text(t_id));
+    auto src_ids = source->get_term_ids(terms);
+    for (term_id t_id{0}; t_id < unique_terms(); ++t_id)
+    {
+        (*inv_impl_->doc_freqs_)[t_id] = source->doc_freq(src_ids[t_id]);
+        (*inv_impl_->term_counts_)[t_id]
+            = source->total_num_occurences(src_ids[t_id]);
+    }
+    inv_impl_->save_term_probs();
+    inv_impl_->save_completions();
+}
 
-    impl_->save_label_id_mapping();
-    impl_->load_postings();
+void inverted_index::copy_postings(
+    const std::string& config_file,
+    const std::vector<std::shared_ptr<inverted_index>>& sources,
+    const std::function<bool(term_id, doc_id, uint64_t)>& keep)
+{
+    filesystem::copy_file(config_file, index_name() + "/config.toml");
+
+    uint64_t num_docs = 0;
+    bool has_positions = inv_impl_->store_positions_;
+    for (const auto& src : sources)
+    {
+        num_docs += src->num_docs();
+        has_positions = has_positions && src->has_positions();
+
+        // the sources are read term by term, front to back
+        src->advise_postings(io::access_pattern::sequential);
+    }
+    impl_->initialize_metadata(num_docs);
+
+    {
+        auto docid_writer = impl_->make_doc_id_writer(num_docs);
+        auto field_writer = impl_->make_field_writer(num_docs);
+        uint64_t offset = 0;
+        for (const auto& src : sources)
+        {
+            for (const auto& d_id : src->docs())
+            {
+                doc_id new_id{offset + d_id};
+                docid_writer.insert(new_id, src->doc_path(d_id));
+                impl_->set_length(new_id, src->doc_size(d_id));
+                impl_->set_unique_terms(new_id, src->unique_terms(d_id));
+                impl_->set_label(new_id, src->label(d_id));
+                if (field_writer)
+                    field_writer->insert(
+                        new_id, source_fields(*src, impl_->field_specs(), d_id));
+            }
+            offset += src->num_docs();
+        }
+    }
+
+    inv_impl_->finish_merge(sources, keep, has_positions);
 
-    LOG(info) << "Done creating index: " << index_name() << ENDLG;
+    for (const auto& src : sources)
+        src->advise_postings(io::access_pattern::random);
+
+    std::vector<doc_id> deleted;
+    uint64_t offset = 0;
+    for (const auto& src : sources)
+    {
+        for (const auto& d_id : src->docs())
+        {
+            if (src->is_deleted(d_id))
+                deleted.emplace_back(offset + d_id);
+        }
+        offset += src->num_docs();
+    }
+    delete_docs(deleted);
 }
 
 void inverted_index::load_index()
@@ -152,124 +689,773 @@ void inverted_index::load_index()
 
     auto config = cpptoml::parse_file(index_name() + "/config.toml");
 
+    // the postings file is read with the codec it was written with, which
+    // may differ from the one in the configuration used to open it
+    inv_impl_->codec_ = load_postings_codec(config);
+
     impl_->initialize_metadata();
     impl_->load_doc_id_mapping();
     impl_->load_term_id_mapping();
 
     inv_impl_->term_bit_locations_
-        = util::disk_vector<uint64_t>(index_name() + "/lexicon.index");
+        = util::offset_vector{index_name() + "/lexicon.index"};
+
+    if (filesystem::file_exists(index_name() + "/lexicon.docfreqs")
+        && filesystem::file_exists(index_name() + "/lexicon.counts"))
+    {
+        inv_impl_->doc_freqs_
+            = util::disk_vector<uint64_t>(index_name() + "/lexicon.docfreqs");
+        inv_impl_->term_counts_
+            = util::disk_vector<uint64_t>(index_name() + "/lexicon.counts");
+    }
+
+    inv_impl_->load_positions();
+    inv_impl_->load_corpus_stats();
 
     impl_->load_label_id_mapping();
     impl_->load_postings();
+    inv_impl_->load_hot_tier();
+
+    // queries jump between the postings lists of their terms, so reading
+    // ahead of a list mostly reads postings that are never used
+    advise_postings(io::access_pattern::random);
+
+    impl_->prefault_metadata();
+    if (impl_->residency() != io::residency::on_demand)
+    {
+        inv_impl_->term_bit_locations_->prefault();
+        if (inv_impl_->doc_freqs_)
+        {
+            inv_impl_->doc_freqs_->prefault();
+            inv_impl_->term_counts_->prefault();
+        }
+        if (inv_impl_->term_probs_)
+            inv_impl_->term_probs_->prefault();
+        if (inv_impl_->position_locations_)
+            inv_impl_->position_locations_->prefault();
+    }
 }
 
-void inverted_index::impl::tokenize_docs(corpus::corpus* docs,
-                                         chunk_handler<inverted_index>& handler)
+std::future<void> inverted_index::impl::tokenize_docs(
+    corpus::corpus* docs, chunk_handler<term_chunks>& handler,
+    chunk_handler<positional_chunks>* positions,
+    corpus::feature_vocabulary& vocab)
 {
     std::mutex mutex;
-    auto docid_writer = idx_->impl_->make_doc_id_writer(docs->size());
+    auto docid_writer = std::make_shared<string_list_writer>(
+        idx_->impl_->make_doc_id_writer(docs->size()));
+    auto field_writer = idx_->impl_->make_field_writer(docs->size());
+
+    // one thread reads the corpus, and the workers take whole batches of
+    // documents from it instead of locking for every document
+    corpus::batch_reader reader{*docs, " > Tokenizing Docs: "};
+    parallel::stage_counter analysis;
+    using clock = parallel::stage_counter::clock;
 
-    printing::progress progress{" > Tokenizing Docs: ", docs->size()};
+    // each term's text is kept once for the whole corpus, and the chunks
+    // only see its feature id; with feature hashing, the documents intern
+    // their terms themselves
+    using term_count = std::pair<term_id, double>;
 
     auto task = [&]()
     {
         auto producer = handler.make_producer();
+        using positional_producer = chunk_handler<positional_chunks>::producer;
+        std::unique_ptr<positional_producer> pos_producer;
+        if (positions)
+            pos_producer = make_unique<positional_producer>(
+                positions->make_producer());
+        analyzers::analyzer::position_map term_positions;
+        std::vector<term_count> terms;
         auto analyzer = analyzer_->clone();
+        // the counts of a batch's documents are allocated from the arena
+        // and freed all at once; batch is declared after it so that the
+        // documents are destroyed first
+        util::arena arena;
+        std::vector<corpus::document> batch;
         while (true)
         {
-            util::optional<corpus::document> doc;
+            auto start = clock::now();
+            if (!reader.next(batch))
+                return; // destructor for producer will write
+                        // any intermediate chunks
+            auto taken = clock::now();
+            analysis.add_wait(taken - start);
+
+            for (auto& doc : batch)
             {
-                std::lock_guard<std::mutex> lock{mutex};
+                if (doc.pretokenized())
+                {
+                    // its counts were read by text, without positions
+                    if (pos_producer)
+                        throw inverted_index_exception{
+                            "a tokenized corpus has no term positions"};
+                }
+                else
+                {
+                    doc.arena(&arena);
+                    if (feature_hashing_)
+                        doc.vocabulary(&vocab);
+                    if (pos_producer)
+                    {
+                        term_positions.clear();
+                        analyzer->tokenize_positions(doc, term_positions);
+                    }
+                    else
+                    {
+                        analyzer->tokenize(doc);
+                    }
+                }
+
+                // warn if there is an empty document
+                if (doc.unique_terms() == 0)
+                {
+                    std::lock_guard<std::mutex> lock{mutex};
+                    LOG(progress) << '\n' << ENDLG;
+                    LOG(warning) << "Empty document (id = " << doc.id()
+                                 << ") generated!" << ENDLG;
+                }
 
-                if (!docs->has_next())
-                    return; // destructor for producer will write
-                            // any intermediate chunks
-                doc = docs->next();
-                progress(doc->id());
+                // save metadata
+                docid_writer->insert(doc.id(), doc.path());
+                idx_->impl_->set_length(doc.id(), doc.length());
+                idx_->impl_->set_unique_terms(doc.id(), doc.unique_terms());
+                idx_->impl_->set_label(doc.id(), doc.label());
+                if (field_writer)
+                    field_writer->insert(doc.id(), doc.fields());
+                // update chunk
+                terms.clear();
+                if (doc.vocabulary())
+                {
+                    for (const auto& feature : doc.features())
+                        terms.emplace_back(term_id{feature.first},
+                                           feature.second);
+                }
+                else
+                {
+                    for (const auto& count : doc.counts())
+                        terms.emplace_back(term_id{vocab.intern(count.first)},
+                                           count.second);
+                }
+                producer(doc.id(), terms);
+                if (pos_producer)
+                {
+                    uint64_t high = static_cast<uint64_t>(doc.id()) << 32;
+                    for (const auto& term : term_positions)
+                    {
+                        std::array<term_count, 1> count{
+                            {{term_id{vocab.intern(term.first)}, 1}}};
+                        for (const auto& position : term.second)
+                        {
+                            if (position > max_position)
+                                throw inverted_index_exception{
+                                    "document too long to store positions"};
+                            (*pos_producer)(high | position, count);
+                        }
+                    }
+                }
+            }
+            auto done = clock::now();
+            analysis.add_work(batch.size(), done - taken);
+            if (trace::enabled())
+                trace::record("tokenize_batch", "index", taken, done);
+            if (metrics::enabled())
+            {
+                // tokens per second is tokens_analyzed over analysis_ns,
+                // which adds up the time of every thread
+                static auto& tokens = metrics::get_counter("tokens_analyzed");
+                static auto& time = metrics::get_counter("analysis_ns");
+                uint64_t length = 0;
+                for (const auto& doc : batch)
+                    length += doc.length();
+                tokens.add(length);
+                time.add(static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        done - taken).count()));
             }
+            batch.clear();
+            arena.reset();
+        }
+    };
 
-            analyzer->tokenize(*doc);
+    {
+        parallel::thread_pool pool;
+        std::vector<std::future<void>> futures;
+        for (size_t i = 0; i < pool.thread_ids().size(); ++i)
+            futures.emplace_back(pool.submit_task(task));
+
+        for (auto& fut : futures)
+            fut.get();
+    }
+
+    LOG(info) << "Reading: " << reader.counter() << ENDLG;
+    LOG(info) << "Analysis: " << analysis << ENDLG;
+
+    // the paths are front coded while the chunks are merged
+    return std::async(std::launch::async, [docid_writer]()
+                      {
+        docid_writer->close();
+    });
+}
+
+void inverted_index::impl::finish_create(
+    chunk_handler<term_chunks>& handler,
+    chunk_handler<positional_chunks>* positions,
+    const corpus::feature_vocabulary& vocab, std::future<void>& doc_ids)
+{
+    auto& impl = idx_->impl_;
+    impl->load_doc_id_mapping();
+
+    // the term_ids of an index are assigned in sorted order of the terms
+    std::vector<term_id> term_ids(vocab.id_bound());
+    {
+        auto ids = vocab.ids_by_term();
+        for (uint64_t i = 0; i < ids.size(); ++i)
+            term_ids[ids[i]] = term_id{i};
+    }
+
+    uint64_t num_unique_terms = merge_postings(handler, vocab, term_ids);
+    if (positions)
+    {
+        merge_positions(*positions, term_ids, num_unique_terms);
+        filesystem::delete_file(idx_->index_name() + "/positions");
+        load_positions();
+    }
+
+    doc_ids.get();
+    load_created();
+}
+
+void inverted_index::impl::finish_merge(
+    const std::vector<std::shared_ptr<inverted_index>>& sources,
+    const std::function<bool(term_id, doc_id, uint64_t)>& keep,
+    bool with_positions)
+{
+    idx_->impl_->load_doc_id_mapping();
+
+    std::vector<postings_segment> segments(1);
+    open_segments(segments);
+
+    // the terms come out of the merge in sorted order, so the vocabulary
+    // is written as they do
+    async_vocabulary_writer vocab{idx_->index_name()
+                                  + idx_->impl_->files[TERM_IDS_MAPPING]};
+    uint64_t num_terms = 0;
+
+    std::string pfilename{idx_->index_name() + "/postings.positions"};
+    std::ofstream positions_out;
+    if (with_positions)
+        positions_out.open(pfilename, std::ios::binary);
+    std::vector<uint64_t> position_offsets;
+    uint64_t position_bytes = 0;
+
+    // the term_ids of an index are assigned in sorted order of the terms,
+    // so the vocabularies are merged by walking each in term_id order
+    using entry = std::pair<std::string, uint64_t>;
+    std::priority_queue<entry, std::vector<entry>, std::greater<entry>> heap;
+    std::vector<uint64_t> next(sources.size(), 0);
+    std::vector<uint64_t> offsets(sources.size(), 0);
+    auto advance = [&](uint64_t i)
+    {
+        const auto& src = *sources[i];
+        if (next[i] >= src.unique_terms())
+            return;
+        auto term = src.term_text(term_id{next[i]});
+        if (next[i] > 0 && !(src.term_text(term_id{next[i] - 1}) < term))
+            throw inverted_index_exception{"terms are out of order in "
+                                           + src.index_name()};
+        heap.emplace(std::move(term), i);
+    };
+    for (uint64_t i = 0; i < sources.size(); ++i)
+    {
+        if (i > 0)
+            offsets[i] = offsets[i - 1] + sources[i - 1]->num_docs();
+        advance(i);
+    }
+
+    postings_data<std::string, doc_id>::count_t counts;
+    positional_chunks::index_pdata_type::count_t positions;
+    std::vector<doc_id> kept;
+    while (!heap.empty())
+    {
+        // equal terms come off the heap in source order, so their postings
+        // are concatenated in doc_id order
+        auto term = heap.top().first;
+        counts.clear();
+        positions.clear();
+        while (!heap.empty() && heap.top().first == term)
+        {
+            auto i = heap.top().second;
+            heap.pop();
+            const auto& src = *sources[i];
+            const auto& deleted = src.deleted();
+            term_id t_id{next[i]++};
 
-            // warn if there is an empty document
-            if (doc->counts().empty())
+            // the postings of deleted documents are dropped, but their
+            // doc_ids are kept so that no other doc_id changes
+            kept.clear();
+            auto pdata = src.search_primary(t_id);
+            for (const auto& posting : pdata->counts())
             {
-                std::lock_guard<std::mutex> lock{mutex};
-                LOG(progress) << '\n' << ENDLG;
-                LOG(warning) << "Empty document (id = " << doc->id()
-                             << ") generated!" << ENDLG;
+                if (deleted.contains(posting.first))
+                    continue;
+                if (keep
+                    && !keep(t_id, posting.first,
+                             static_cast<uint64_t>(posting.second)))
+                    continue;
+                counts.emplace_back(doc_id{offsets[i] + posting.first},
+                                    posting.second);
+                kept.push_back(posting.first);
             }
 
-            // save metadata
-            docid_writer.insert(doc->id(), doc->path());
-            idx_->impl_->set_length(doc->id(), doc->length());
-            idx_->impl_->set_unique_terms(doc->id(), doc->counts().size());
-            idx_->impl_->set_label(doc->id(), doc->label());
-            // update chunk
-            producer(doc->id(), doc->counts());
+            if (with_positions)
+            {
+                for (auto cur = src.positions(t_id); !cur.at_end();
+                     cur.next())
+                {
+                    if (!std::binary_search(kept.begin(), kept.end(),
+                                            cur.doc()))
+                        continue;
+                    uint64_t high = (offsets[i] + cur.doc()) << 32;
+                    for (const auto& position : cur.positions())
+                        positions.emplace_back(high | position, 1);
+                }
+            }
+            advance(i);
         }
-    };
 
-    parallel::thread_pool pool;
-    std::vector<std::future<void>> futures;
-    for (size_t i = 0; i < pool.thread_ids().size(); ++i)
-        futures.emplace_back(pool.submit_task(task));
+        // a term that lost every posting is left out of the index
+        if (counts.empty())
+            continue;
+
+        term_id t_id{num_terms++};
+        postings_data<term_id, doc_id> pdata{t_id};
+        pdata.set_counts(std::move(counts));
+        counts.clear();
+        vocab.insert(std::move(term));
+        write_postings(segments[0], pdata);
+
+        if (with_positions)
+        {
+            positional_chunks::index_pdata_type ppdata{t_id};
+            ppdata.set_counts(std::move(positions));
+            positions.clear();
+            position_offsets.push_back(position_bytes);
+            position_bytes += write_positions(positions_out, ppdata);
+        }
+    }
+
+    auto num_unique_terms = finish_postings(segments);
+    if (vocab.finish() != num_unique_terms)
+        throw inverted_index_exception{
+            "the postings do not match the vocabulary"};
+    if (with_positions)
+    {
+        positions_out.close();
+        auto path = idx_->index_name() + "/lexicon.positions";
+        {
+            util::disk_vector<uint64_t> locations{path, num_unique_terms};
+            for (uint64_t t = 0; t < num_unique_terms; ++t)
+                locations[t] = position_offsets[t];
+        }
+        util::offset_vector::compact(path);
+        load_positions();
+    }
+
+    load_created();
+}
+
+void inverted_index::impl::save_completions()
+{
+    // a completion_index left by an earlier index of the same name would
+    // no longer match the terms
+    if (!completions_)
+    {
+        filesystem::delete_file(idx_->index_name() + "/completions");
+        return;
+    }
+    trace::scoped_event event{"save_completions", "index"};
+    completion_index::build(*idx_, *completions_);
+}
+
+void inverted_index::impl::load_created()
+{
+    auto& impl = idx_->impl_;
+    impl->load_term_id_mapping();
+
+    impl->save_label_id_mapping();
+    impl->load_postings();
+    impl->load_doc_metadata(true);
+    impl->load_fields();
+    idx_->advise_postings(io::access_pattern::random);
+    save_corpus_stats();
 
-    for (auto& fut : futures)
-        fut.get();
+    LOG(info) << "Done creating index: " << idx_->index_name() << ENDLG;
 }
 
-void inverted_index::impl::compress(const std::string& filename,
-                                    uint64_t num_unique_terms)
+uint64_t inverted_index::impl::merge_postings(
+    chunk_handler<term_chunks>& handler,
+    const corpus::feature_vocabulary& vocab,
+    const std::vector<term_id>& term_ids)
 {
-    std::string cfilename{filename + ".compressed"};
+    trace::scoped_event event{"merge_postings", "index"};
+    uint64_t num_parts = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<postings_segment> segments(num_parts);
+    open_segments(segments);
+
+    // the terms are all known, so the vocabulary is written while their
+    // postings are merged and compressed
+    auto ids_by_term = vocab.ids_by_term();
+    auto vocab_path = idx_->index_name() + idx_->impl_->files[TERM_IDS_MAPPING];
+    auto vocab_done = std::async(std::launch::async, [&]()
+                                 {
+        trace::scoped_event event{"write_vocabulary", "index"};
+        vocabulary_map_writer writer{vocab_path};
+        for (const auto& id : ids_by_term)
+            writer.insert(vocab.term(id));
+    });
+
+    handler.merge_chunks(num_parts, [&](uint64_t part,
+                                        term_chunks::index_pdata_type&& pdata)
+                         {
+        uint64_t id{pdata.primary_key()};
+        if (id >= term_ids.size())
+            throw inverted_index_exception{
+                "the postings do not match the vocabulary"};
+        segments[part].ids.push_back(term_ids[id]);
+        write_postings(segments[part], pdata);
+    });
 
-    // create scope so the writer closes and we can calculate the size of the
-    // file as well as rename it
+    auto num_unique_terms = finish_postings(segments);
+    vocab_done.get();
+    if (ids_by_term.size() != num_unique_terms)
+        throw inverted_index_exception{
+            "the postings do not match the vocabulary"};
+    return num_unique_terms;
+}
+
+void inverted_index::impl::open_segments(
+    std::vector<postings_segment>& segments) const
+{
+    auto filename = idx_->index_name() + idx_->impl_->files[POSTINGS];
+    for (uint64_t i = 0; i < segments.size(); ++i)
     {
-        io::compressed_file_writer out{cfilename,
-                                       io::default_compression_writer_func};
+        auto& seg = segments[i];
+        seg.path = filename + ".segment-" + std::to_string(i);
+        if (codec_ == postings_codec::block)
+            seg.packed_out.open(seg.path, std::ios::binary);
+        else
+            seg.out = make_unique<io::default_compressed_file_writer>(seg.path);
+    }
+}
+
+template <class PrimaryKey>
+void inverted_index::impl::write_postings(
+    postings_segment& seg, const postings_data<PrimaryKey, doc_id>& pdata) const
+{
+    uint64_t total = 0;
+    for (const auto& count : pdata.counts())
+        total += static_cast<uint64_t>(count.second);
+    seg.doc_freqs.push_back(pdata.counts().size());
+    seg.counts.push_back(total);
 
-        vocabulary_map_writer vocab{idx_->index_name()
-                                    + idx_->impl_->files[TERM_IDS_MAPPING]};
+    if (codec_ == postings_codec::block)
+    {
+        seg.locations.push_back(seg.packed_bytes);
+        seg.packed_bytes += pdata.write_packed(seg.packed_out);
+    }
+    else
+    {
+        seg.locations.push_back(seg.out->bit_location());
+        pdata.write_compressed(*seg.out);
+    }
+}
+
+uint64_t inverted_index::impl::finish_postings(
+    std::vector<postings_segment>& segments)
+{
+    trace::scoped_event event{"finish_postings", "index"};
+    auto filename = idx_->index_name() + idx_->impl_->files[POSTINGS];
+
+    // a hot tier left by an earlier index in the same place would hold
+    // the postings of different terms
+    drop_hot_tier();
+    uint64_t num_unique_terms = 0;
+    std::vector<uint64_t> sizes;
+    for (auto& seg : segments)
+    {
+        if (seg.out)
+            seg.out->close();
+        else
+            seg.packed_out.close();
+        num_unique_terms += seg.locations.size();
+        sizes.push_back(filesystem::file_size(seg.path));
+    }
+
+    // the segments are concatenated while the lexicon is written
+    auto concatenated = std::async(std::launch::async, [&]()
+                                   {
+        if (segments.size() == 1)
+        {
+            filesystem::rename_file(segments[0].path, filename);
+            return;
+        }
+        std::ofstream out{filename, std::ios::binary};
+        for (uint64_t i = 0; i < segments.size(); ++i)
+        {
+            // streaming an empty buffer would put out into a failed state
+            if (sizes[i] > 0)
+            {
+                std::ifstream in{segments[i].path, std::ios::binary};
+                out << in.rdbuf();
+            }
+            filesystem::delete_file(segments[i].path);
+        }
+    });
 
-        postings_data<std::string, doc_id> pdata;
-        auto length = filesystem::file_size(filename) * 8; // number of bits
-        io::compressed_file_reader in{filename,
-                                      io::default_compression_reader_func};
+    // allocate memory for the term_id -> term location mapping now that we
+    // know how many terms there are
+    auto locations_path = idx_->index_name() + "/lexicon.index";
+    doc_freqs_ = util::disk_vector<uint64_t>(
+        idx_->index_name() + "/lexicon.docfreqs", num_unique_terms);
+    term_counts_ = util::disk_vector<uint64_t>(
+        idx_->index_name() + "/lexicon.counts", num_unique_terms);
 
-        // allocate memory for the term_id -> term location mapping now
-        // that we know how many terms there are
-        term_bit_locations_ = util::disk_vector<uint64_t>(
-            idx_->index_name() + "/lexicon.index", num_unique_terms);
+    {
+        util::disk_vector<uint64_t> locations{locations_path,
+                                              num_unique_terms};
 
-        printing::progress progress{
-            " > Compressing postings: ", length, 500, 8 * 1024 /* 1KB */
-        };
-        // note: we will be accessing pdata in sorted order
-        term_id t_id{0};
-        while (in.has_next())
+        // every segment starts on a byte boundary, so a term's location in
+        // the concatenated file is its location in its segment plus the
+        // size of the segments before it
+        term_id next{0};
+        uint64_t base = 0;
+        for (uint64_t s = 0; s < segments.size(); ++s)
         {
-            in >> pdata;
-            progress(in.bit_location());
-            vocab.insert(pdata.primary_key());
-            (*term_bit_locations_)[t_id] = out.bit_location();
-            pdata.write_compressed(out);
-            ++t_id;
+            const auto& seg = segments[s];
+            for (uint64_t i = 0; i < seg.locations.size(); ++i)
+            {
+                auto t_id = seg.ids.empty() ? next++ : seg.ids[i];
+                locations[t_id] = base + seg.locations[i];
+                (*doc_freqs_)[t_id] = seg.doc_freqs[i];
+                (*term_counts_)[t_id] = seg.counts[i];
+            }
+            base += codec_ == postings_codec::block ? sizes[s] : sizes[s] * 8;
         }
     }
 
+    // terms are found at increasing locations unless the segments were
+    // written out of term_id order, so the table can usually be packed
+    util::offset_vector::compact(locations_path);
+    term_bit_locations_ = util::offset_vector{locations_path};
+    concatenated.get();
+
     LOG(info) << "Created compressed postings file ("
-              << printing::bytes_to_units(filesystem::file_size(cfilename))
+              << printing::bytes_to_units(filesystem::file_size(filename))
               << ")" << ENDLG;
 
-    filesystem::delete_file(filename);
-    filesystem::rename_file(cfilename, filename);
+    return num_unique_terms;
+}
+
+void inverted_index::impl::merge_positions(
+    chunk_handler<positional_chunks>& handler,
+    const std::vector<term_id>& term_ids, uint64_t num_unique_terms)
+{
+    trace::scoped_event event{"merge_positions", "index"};
+    std::string pfilename{idx_->index_name() + "/postings.positions"};
+    {
+        std::ofstream out{pfilename, std::ios::binary};
+        util::disk_vector<uint64_t> locations{
+            idx_->index_name() + "/lexicon.positions", num_unique_terms};
+
+        // the positional chunks hold exactly the terms of the postings
+        // file, keyed by feature id as its chunks are
+        uint64_t bytes = 0;
+        uint64_t num_terms = 0;
+        handler.merge_chunks(1, [&](uint64_t,
+                                    positional_chunks::index_pdata_type&& pdata)
+                             {
+            uint64_t id{pdata.primary_key()};
+            if (id >= term_ids.size() || num_terms >= num_unique_terms)
+                throw inverted_index_exception{
+                    "positions do not match the postings file"};
+
+            locations[term_ids[id]] = bytes;
+            bytes += write_positions(out, pdata);
+            ++num_terms;
+        });
+
+        if (num_terms != num_unique_terms)
+            throw inverted_index_exception{
+                "positions do not match the postings file"};
+    }
+    util::offset_vector::compact(idx_->index_name() + "/lexicon.positions");
+
+    LOG(info) << "Created positions file ("
+              << printing::bytes_to_units(filesystem::file_size(pfilename))
+              << ")" << ENDLG;
+}
+
+uint64_t inverted_index::impl::write_positions(
+    std::ostream& out, const positional_chunks::index_pdata_type& pdata)
+{
+    uint64_t bytes = 0;
+    uint64_t last_doc = 0;
+    uint64_t last_position = 0;
+    for (const auto& count : pdata.counts())
+    {
+        uint64_t doc = count.first >> 32;
+        uint64_t position = count.first & max_position;
+        if (doc != last_doc)
+        {
+            last_doc = doc;
+            last_position = 0;
+        }
+        bytes += io::stream_vbyte::write_varint(out, position - last_position);
+        last_position = position;
+    }
+    return bytes;
+}
+
+void inverted_index::impl::load_positions()
+{
+    auto prefix = idx_->index_name();
+    if (!filesystem::file_exists(prefix + "/postings.positions")
+        || !util::offset_vector::exists(prefix + "/lexicon.positions"))
+        return;
+
+    position_locations_ = util::offset_vector{prefix + "/lexicon.positions"};
+    positions_ = io::mmap_file{prefix + "/postings.positions",
+                               idx_->impl_->residency()};
+    positions_->advise(io::access_pattern::random);
+}
+
+std::string inverted_index::impl::hot_postings_path() const
+{
+    if (!hot_path_.empty())
+        return hot_path_;
+    return idx_->index_name() + "/postings.hot";
+}
+
+void inverted_index::impl::load_hot_tier()
+{
+    auto locations_path = idx_->index_name() + "/lexicon.hot";
+    if (!util::offset_vector::exists(locations_path))
+        return;
+
+    auto path = hot_postings_path();
+    if (!filesystem::file_exists(path))
+        throw inverted_index_exception{"the hot postings tier is missing: "
+                                       + path};
+
+    auto residency = hot_residency_ ? *hot_residency_
+                                    : idx_->impl_->residency();
+    hot_locations_ = util::offset_vector{locations_path};
+    hot_postings_ = io::mmap_file{path, residency};
+    hot_postings_->advise(io::access_pattern::random);
+    if (residency != io::residency::on_demand)
+        hot_locations_->prefault();
+}
+
+void inverted_index::impl::drop_hot_tier()
+{
+    hot_locations_ = util::nullopt;
+    hot_postings_ = util::nullopt;
+
+    auto locations_path = idx_->index_name() + "/lexicon.hot";
+    filesystem::delete_file(locations_path);
+    filesystem::delete_file(locations_path + ".ef");
+    filesystem::delete_file(hot_postings_path());
+}
+
+std::pair<const io::mmap_file*, uint64_t>
+    inverted_index::impl::locate(uint64_t idx) const
+{
+    if (hot_locations_)
+    {
+        auto location = (*hot_locations_)[idx];
+        if ((*hot_locations_)[idx + 1] != location)
+            return {&*hot_postings_, location};
+    }
+    return {&idx_->impl_->postings(), term_bit_locations_->at(idx)};
+}
+
+void inverted_index::impl::save_corpus_stats()
+{
+    total_corpus_terms_ = 0;
+    for (doc_id d_id{0}; d_id < idx_->num_docs(); ++d_id)
+        total_corpus_terms_ += idx_->doc_size(d_id);
+
+    std::ofstream stats_file{idx_->index_name() + "/corpus.stats"};
+    stats_file << idx_->num_docs() << " " << total_corpus_terms_ << " "
+               << idx_->unique_terms() << "\n";
+    save_term_probs();
+}
+
+void inverted_index::impl::save_term_probs()
+{
+    auto num_terms = idx_->unique_terms();
+    term_probs_ = util::disk_vector<double>(
+        idx_->index_name() + "/lexicon.probs", num_terms);
+    for (uint64_t t = 0; t < num_terms; ++t)
+        (*term_probs_)[t] = static_cast<double>(term_counts_->at(t))
+                            / total_corpus_terms_;
+}
+
+void inverted_index::impl::load_corpus_stats()
+{
+    std::ifstream stats_file{idx_->index_name() + "/corpus.stats"};
+    uint64_t num_docs;
+    uint64_t total_terms;
+    uint64_t unique_terms;
+    if (stats_file >> num_docs >> total_terms >> unique_terms
+        && num_docs == idx_->num_docs()
+        && unique_terms == idx_->unique_terms())
+        total_corpus_terms_ = total_terms;
+
+    if (total_corpus_terms_ > 0
+        && filesystem::file_exists(idx_->index_name() + "/lexicon.probs"))
+    {
+        term_probs_
+            = util::disk_vector<double>(idx_->index_name() + "/lexicon.probs");
+        if (term_probs_->size() != idx_->unique_terms())
+            term_probs_ = util::nullopt;
+    }
 }
 
 uint64_t inverted_index::term_freq(term_id t_id, doc_id d_id) const
 {
-    auto pdata = search_primary(t_id);
-    return pdata->count(d_id);
+    // only the block that may contain d_id needs to be decoded
+    auto postings = cursor(t_id);
+    postings.skip_to(d_id);
+    if (postings.at_end() || postings.doc() != d_id)
+        return 0;
+    return postings.count();
+}
+
+std::vector<uint64_t> inverted_index::term_freqs(
+    const std::vector<std::pair<term_id, doc_id>>& pairs) const
+{
+    std::vector<uint64_t> order(pairs.size());
+    std::iota(order.begin(), order.end(), 0);
+    if (!std::is_sorted(pairs.begin(), pairs.end()))
+        std::sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b)
+                  {
+                      return pairs[a] < pairs[b];
+                  });
+
+    std::vector<uint64_t> freqs(pairs.size(), 0);
+    postings_cursor postings;
+    for (uint64_t i = 0; i < order.size(); ++i)
+    {
+        const auto& pair = pairs[order[i]];
+        if (i == 0 || pair.first != pairs[order[i - 1]].first)
+            postings = cursor(pair.first);
+        postings.skip_to(pair.second);
+        if (!postings.at_end() && postings.doc() == pair.second)
+            freqs[order[i]] = postings.count();
+    }
+    return freqs;
 }
 
 uint64_t inverted_index::total_corpus_terms()
@@ -285,15 +1471,30 @@ uint64_t inverted_index::total_corpus_terms()
 
 uint64_t inverted_index::total_num_occurences(term_id t_id) const
 {
-    auto pdata = search_primary(t_id);
+    if (inv_impl_->term_counts_)
+    {
+        uint64_t idx{t_id};
+        if (idx >= inv_impl_->term_counts_->size())
+            return 0;
+        return inv_impl_->term_counts_->at(idx);
+    }
 
-    double sum = 0;
-    for (auto& c : pdata->counts())
-        sum += c.second;
+    uint64_t sum = 0;
+    for (auto postings = cursor(t_id); !postings.at_end(); postings.next())
+        sum += postings.count();
 
     return sum;
 }
 
+double inverted_index::collection_probability(term_id t_id)
+{
+    uint64_t idx{t_id};
+    if (inv_impl_->term_probs_ && idx < inv_impl_->term_probs_->size())
+        return inv_impl_->term_probs_->at(idx);
+    return static_cast<double>(total_num_occurences(t_id))
+           / total_corpus_terms();
+}
+
 double inverted_index::avg_doc_length()
 {
     return static_cast<double>(total_corpus_terms()) / num_docs();
@@ -306,7 +1507,151 @@ void inverted_index::tokenize(corpus::document& doc)
 
 uint64_t inverted_index::doc_freq(term_id t_id) const
 {
-    return search_primary(t_id)->counts().size();
+    if (inv_impl_->doc_freqs_)
+    {
+        uint64_t idx{t_id};
+        if (idx >= inv_impl_->doc_freqs_->size())
+            return 0;
+        return inv_impl_->doc_freqs_->at(idx);
+    }
+
+    return cursor(t_id).size();
+}
+
+postings_cursor inverted_index::cursor(term_id t_id) const
+{
+    uint64_t idx{t_id};
+    if (idx >= inv_impl_->term_bit_locations_->size())
+        return {};
+
+    // a cached index keeps decoded postings, which are cheaper to walk
+    // than the postings file and must be counted as hits of its cache
+    if (caches_postings())
+        return {std::shared_ptr<const postings_data_type>{
+            search_primary(t_id)}};
+
+    auto location = inv_impl_->locate(idx);
+    if (inv_impl_->codec_ == postings_codec::block)
+        return {location.first->begin() + location.second};
+
+    const auto& postings = *location.first;
+    return {postings.begin(), postings.size(), location.second};
+}
+
+uint64_t inverted_index::tier_postings(const std::vector<term_id>& terms)
+{
+    // the tier is copied from the postings file of the whole index, so
+    // any tier already written is dropped before reading from it
+    inv_impl_->drop_hot_tier();
+
+    std::vector<bool> hot(unique_terms(), false);
+    uint64_t num_hot = 0;
+    for (const auto& t_id : terms)
+    {
+        if (t_id < hot.size() && !hot[t_id])
+        {
+            hot[t_id] = true;
+            ++num_hot;
+        }
+    }
+    if (num_hot == 0)
+        return 0;
+
+    auto path = inv_impl_->hot_postings_path();
+    auto locations_path = index_name() + "/lexicon.hot";
+    LOG(info) << "Writing the postings of " << num_hot
+              << " terms to the hot tier: " << path << ENDLG;
+    {
+        util::disk_vector<uint64_t> locations{locations_path,
+                                              hot.size() + 1};
+        if (inv_impl_->codec_ == postings_codec::block)
+        {
+            std::ofstream out{path, std::ios::binary};
+            uint64_t bytes = 0;
+            for (term_id t_id{0}; t_id < hot.size(); ++t_id)
+            {
+                locations[t_id] = bytes;
+                if (hot[t_id])
+                    bytes += inverted_index::search_primary(t_id)
+                                 ->write_packed(out);
+            }
+            locations[hot.size()] = bytes;
+            if (!out)
+                throw inverted_index_exception{"failed to write " + path};
+        }
+        else
+        {
+            io::default_compressed_file_writer out{path};
+            for (term_id t_id{0}; t_id < hot.size(); ++t_id)
+            {
+                locations[t_id] = out.bit_location();
+                if (hot[t_id])
+                    inverted_index::search_primary(t_id)->write_compressed(
+                        out);
+            }
+            locations[hot.size()] = out.bit_location();
+            out.close();
+        }
+    }
+    util::offset_vector::compact(locations_path);
+    inv_impl_->load_hot_tier();
+    return filesystem::file_size(path);
+}
+
+bool inverted_index::in_hot_tier(term_id t_id) const
+{
+    uint64_t idx{t_id};
+    return inv_impl_->hot_locations_ && idx < unique_terms()
+           && inv_impl_->locate(idx).first == &*inv_impl_->hot_postings_;
+}
+
+bool inverted_index::has_positions() const
+{
+    return static_cast<bool>(inv_impl_->positions_);
+}
+
+positions_cursor inverted_index::positions(term_id t_id) const
+{
+    if (!has_positions())
+        throw inverted_index_exception{"index does not store term positions"};
+
+    uint64_t idx{t_id};
+    if (idx >= inv_impl_->position_locations_->size())
+        return {};
+
+    auto location = inv_impl_->position_locations_->at(idx);
+    return {cursor(t_id), inv_impl_->positions_->begin() + location};
+}
+
+util::memory_report inverted_index::memory_usage() const
+{
+    auto report = disk_index::memory_usage();
+
+    util::memory_usage postings;
+    if (inv_impl_->term_bit_locations_)
+        postings += inv_impl_->term_bit_locations_->memory_usage();
+    if (inv_impl_->position_locations_)
+        postings += inv_impl_->position_locations_->memory_usage();
+    if (inv_impl_->positions_)
+        postings += inv_impl_->positions_->memory_usage();
+    report.add("postings", postings);
+
+    if (inv_impl_->hot_postings_)
+    {
+        auto hot = inv_impl_->hot_postings_->memory_usage();
+        hot += inv_impl_->hot_locations_->memory_usage();
+        report.add("hot-postings", hot);
+    }
+
+    util::memory_usage lexicon;
+    if (inv_impl_->doc_freqs_)
+        lexicon += inv_impl_->doc_freqs_->memory_usage();
+    if (inv_impl_->term_counts_)
+        lexicon += inv_impl_->term_counts_->memory_usage();
+    if (inv_impl_->term_probs_)
+        lexicon += inv_impl_->term_probs_->memory_usage();
+    report.add("lexicon", lexicon);
+    return report;
 }
 
 auto inverted_index::search_primary(
@@ -318,11 +1663,16 @@ auto inverted_index::search_primary(
     if (idx >= inv_impl_->term_bit_locations_->size())
         return std::make_shared<postings_data_type>(t_id);
 
-    io::compressed_file_reader reader{impl_->postings(),
-                                      io::default_compression_reader_func};
-    reader.seek(inv_impl_->term_bit_locations_->at(idx));
-
     auto pdata = std::make_shared<postings_data_type>(t_id);
+    auto location = inv_impl_->locate(idx);
+    if (inv_impl_->codec_ == postings_codec::block)
+    {
+        pdata->read_packed(location.first->begin() + location.second);
+        return pdata;
+    }
+
+    io::default_compressed_file_reader reader{*location.first};
+    reader.seek(location.second);
     pdata->read_compressed(reader);
 
     return pdata;
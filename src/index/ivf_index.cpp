@@ -0,0 +1,283 @@
+/**
+ * @file ivf_index.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+#include <numeric>
+#include <random>
+
+#include "index/ivf_index.h"
+#include "io/binary.h"
+#include "parallel/parallel_for.h"
+#include "parallel/thread_pool.h"
+#include "util/dense_ops.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/// The first word of a saved index
+const uint64_t magic = 0x495646494e444558; // "IVFINDEX"
+
+/**
+ * Scales a vector to unit length, leaving a vector of zeros as it is.
+ * @param x The vector
+ * @param size The length of the vector
+ */
+void unit(float* x, uint64_t size)
+{
+    auto norm = std::sqrt(util::dense::dot(x, x, size));
+    if (norm > 0)
+        util::dense::scale(1 / norm, x, size);
+}
+
+/**
+ * @param centroids The unit centroids, a row each
+ * @param x A vector
+ * @return the centroid most similar to the vector by inner product
+ */
+uint64_t nearest(const util::dense_matrix<float>& centroids, const float* x)
+{
+    uint64_t best = 0;
+    auto best_sim = -std::numeric_limits<float>::infinity();
+    for (uint64_t c = 0; c < centroids.rows(); ++c)
+    {
+        auto sim = util::dense::dot(centroids.row(c), x, centroids.columns());
+        if (sim > best_sim)
+        {
+            best = c;
+            best_sim = sim;
+        }
+    }
+    return best;
+}
+}
+
+ivf_index::ivf_index(const vector_store& store, const ivf_options& opts,
+                     parallel::thread_pool& pool)
+    : store_{&store}, probes_{opts.probes}
+{
+    auto dims = store.dims();
+    std::vector<doc_id> present;
+    for (doc_id d_id{0}; d_id < store.size(); ++d_id)
+    {
+        if (store.contains(d_id))
+            present.push_back(d_id);
+    }
+    if (present.empty())
+        throw ivf_index_exception{"the store has no vectors to index"};
+
+    auto num_lists = opts.lists;
+    if (num_lists == 0)
+        num_lists = static_cast<uint64_t>(std::sqrt(present.size()));
+    num_lists = std::max<uint64_t>(1, std::min(num_lists, present.size()));
+
+    // a random sample of distinct vectors, the first num_lists of which
+    // are the initial centroids
+    std::mt19937_64 rng{opts.seed};
+    auto sample_size = std::min<uint64_t>(
+        present.size(), std::max(num_lists, num_lists * opts.sample_per_list));
+    std::vector<doc_id> order = present;
+    for (uint64_t i = 0; i < sample_size; ++i)
+    {
+        std::uniform_int_distribution<uint64_t> dist{i, order.size() - 1};
+        std::swap(order[i], order[dist(rng)]);
+    }
+
+    util::dense_matrix<float> sample{sample_size, dims};
+    parallel::parallel_chunks(pool, sample_size, 0,
+                              [&](uint64_t, uint64_t first, uint64_t last)
+                              {
+        for (auto i = first; i < last; ++i)
+        {
+            store.decode(order[i], sample.row(i));
+            unit(sample.row(i), dims);
+        }
+    });
+
+    centroids_.resize(num_lists, dims);
+    for (uint64_t c = 0; c < num_lists; ++c)
+        std::copy(sample.row(c), sample.row(c) + dims, centroids_.row(c));
+
+    // spherical k-means on the sample
+    std::vector<uint64_t> assignments(sample_size);
+    std::vector<std::vector<uint64_t>> members(num_lists);
+    for (uint64_t iter = 0; iter < opts.iterations; ++iter)
+    {
+        parallel::parallel_chunks(pool, sample_size, 0,
+                                  [&](uint64_t, uint64_t first, uint64_t last)
+                                  {
+            for (auto i = first; i < last; ++i)
+                assignments[i] = nearest(centroids_, sample.row(i));
+        });
+
+        for (auto& list : members)
+            list.clear();
+        for (uint64_t i = 0; i < sample_size; ++i)
+            members[assignments[i]].push_back(i);
+
+        parallel::parallel_chunks(pool, num_lists, 1,
+                                  [&](uint64_t, uint64_t first, uint64_t last)
+                                  {
+            for (auto c = first; c < last; ++c)
+            {
+                auto centroid = centroids_.row(c);
+                // an empty list takes over a sample vector, the same one
+                // for every run with the same seed
+                if (members[c].empty())
+                {
+                    auto i = (iter * num_lists + c) % sample_size;
+                    std::copy(sample.row(i), sample.row(i) + dims, centroid);
+                    continue;
+                }
+                std::fill(centroid, centroid + dims, 0.0f);
+                for (const auto& i : members[c])
+                    util::dense::axpy(1.0f, sample.row(i), centroid, dims);
+                unit(centroid, dims);
+            }
+        });
+    }
+
+    // every vector goes into the list of its nearest centroid
+    std::vector<uint64_t> lists(present.size());
+    std::vector<std::vector<float>> buffers(pool.thread_ids().size(),
+                                            std::vector<float>(dims));
+    parallel::parallel_chunks(pool, present.size(), 0,
+                              [&](uint64_t task, uint64_t first, uint64_t last)
+                              {
+        auto& buffer = buffers[task];
+        for (auto i = first; i < last; ++i)
+        {
+            store.decode(present[i], buffer.data());
+            lists[i] = nearest(centroids_, buffer.data());
+        }
+    });
+
+    offsets_.assign(num_lists + 1, 0);
+    for (const auto& list : lists)
+        ++offsets_[list + 1];
+    std::partial_sum(offsets_.begin(), offsets_.end(), offsets_.begin());
+    docs_.resize(present.size());
+    auto next = offsets_;
+    for (uint64_t i = 0; i < present.size(); ++i)
+        docs_[next[lists[i]]++] = present[i];
+}
+
+ivf_index::ivf_index(const vector_store& store, const std::string& path,
+                     uint64_t probes)
+    : store_{&store}, probes_{probes}
+{
+    std::ifstream in{path, std::ios::binary};
+    uint64_t header = 0;
+    uint64_t dims = 0;
+    uint64_t num_lists = 0;
+    uint64_t num_docs = 0;
+    io::read_binary(in, header);
+    io::read_binary(in, dims);
+    io::read_binary(in, num_lists);
+    io::read_binary(in, num_docs);
+    if (!in || header != magic)
+        throw ivf_index_exception{"invalid ivf index: " + path};
+    if (dims != store.dims())
+        throw ivf_index_exception{"ivf index " + path
+                                  + " was built over other vectors"};
+
+    centroids_.resize(num_lists, dims);
+    for (uint64_t c = 0; c < num_lists; ++c)
+        in.read(reinterpret_cast<char*>(centroids_.row(c)),
+                static_cast<std::streamsize>(sizeof(float) * dims));
+    offsets_.resize(num_lists + 1);
+    in.read(reinterpret_cast<char*>(offsets_.data()),
+            static_cast<std::streamsize>(sizeof(uint64_t) * offsets_.size()));
+    docs_.resize(num_docs);
+    in.read(reinterpret_cast<char*>(docs_.data()),
+            static_cast<std::streamsize>(sizeof(doc_id) * docs_.size()));
+    if (!in || offsets_.back() != num_docs)
+        throw ivf_index_exception{"truncated ivf index: " + path};
+}
+
+void ivf_index::save(const std::string& path) const
+{
+    std::ofstream out{path, std::ios::binary};
+    io::write_binary(out, magic);
+    io::write_binary(out, static_cast<uint64_t>(centroids_.columns()));
+    io::write_binary(out, static_cast<uint64_t>(centroids_.rows()));
+    io::write_binary(out, static_cast<uint64_t>(docs_.size()));
+    for (uint64_t c = 0; c < centroids_.rows(); ++c)
+        out.write(reinterpret_cast<const char*>(centroids_.row(c)),
+                  static_cast<std::streamsize>(sizeof(float)
+                                               * centroids_.columns()));
+    out.write(reinterpret_cast<const char*>(offsets_.data()),
+              static_cast<std::streamsize>(sizeof(uint64_t) * offsets_.size()));
+    out.write(reinterpret_cast<const char*>(docs_.data()),
+              static_cast<std::streamsize>(sizeof(doc_id) * docs_.size()));
+    if (!out)
+        throw ivf_index_exception{"failed to write " + path};
+}
+
+std::vector<std::pair<doc_id, double>>
+    ivf_index::search(const std::vector<float>& query, uint64_t k,
+                      const vector_store::filter_type& filter) const
+{
+    store_->check(query);
+
+    std::vector<float> sims(centroids_.rows());
+    util::dense::matrix_vector(centroids_, query.data(), sims.data());
+    std::vector<uint64_t> probed(centroids_.rows());
+    std::iota(probed.begin(), probed.end(), 0);
+    auto num_probes = std::min<uint64_t>(std::max<uint64_t>(probes_, 1),
+                                         probed.size());
+    std::partial_sort(probed.begin(), probed.begin() + num_probes,
+                      probed.end(), [&](uint64_t a, uint64_t b)
+                      {
+        return sims[a] > sims[b];
+    });
+
+    std::vector<std::pair<doc_id, double>> results;
+    for (uint64_t p = 0; p < num_probes; ++p)
+    {
+        auto list = probed[p];
+        for (auto i = offsets_[list]; i < offsets_[list + 1]; ++i)
+        {
+            auto d_id = docs_[i];
+            if (filter && !filter(d_id))
+                continue;
+            results.emplace_back(d_id, store_->score(query.data(), d_id));
+        }
+    }
+
+    auto better = [](const std::pair<doc_id, double>& a,
+                     const std::pair<doc_id, double>& b)
+    {
+        if (a.second != b.second)
+            return a.second > b.second;
+        return a.first < b.first;
+    };
+    if (results.size() > k)
+    {
+        std::partial_sort(results.begin(), results.begin() + k, results.end(),
+                          better);
+        results.resize(k);
+    }
+    else
+        std::sort(results.begin(), results.end(), better);
+    return results;
+}
+
+uint64_t ivf_index::lists() const
+{
+    return centroids_.rows();
+}
+
+void ivf_index::probes(uint64_t probes)
+{
+    probes_ = probes;
+}
+}
+}
@@ -0,0 +1,236 @@
+/**
+ * @file live_segment.cpp
+ */
+
+#include <algorithm>
+
+#include "cpptoml.h"
+#include "index/inverted_index.h"
+#include "index/live_segment.h"
+#include "index/ranker/ranker.h"
+#include "index/score_data.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/**
+ * @param doc A document
+ * @param d_id The doc_id to give the copy
+ * @return a copy of the document's path, label, content, and fields,
+ * without any term counts
+ */
+corpus::document copy_document(const corpus::document& doc, doc_id d_id)
+{
+    corpus::document copy{doc.path(), d_id, doc.label()};
+    copy.encoding(doc.encoding());
+    if (doc.contains_content())
+        copy.content(doc.content(), doc.encoding());
+    copy.fields(doc.fields());
+    return copy;
+}
+}
+
+live_segment::live_segment(const cpptoml::table& config,
+                           const std::string& name)
+    : idx_{new inverted_index(config, name)}, num_deleted_{0}, total_terms_{0}
+{
+    // nothing
+}
+
+live_segment::~live_segment() = default;
+
+doc_id live_segment::add(const corpus::document& doc)
+{
+    auto copy = copy_document(doc, doc_id{0});
+    auto analyzed = copy;
+    {
+        std::lock_guard<std::mutex> lock{analyzer_mutex_};
+        idx_->tokenize(analyzed);
+    }
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    doc_id d_id{docs_.size()};
+    for (const auto& count : analyzed.counts())
+    {
+        auto amount = static_cast<uint64_t>(count.second);
+        postings_[count.first].emplace_back(d_id, amount);
+        term_counts_[count.first] += amount;
+    }
+    copy.label(analyzed.label());
+    docs_.push_back(std::move(copy));
+    lengths_.push_back(analyzed.length());
+    unique_terms_.push_back(analyzed.counts().size());
+    deleted_.push_back(false);
+    total_terms_ += analyzed.length();
+    return d_id;
+}
+
+void live_segment::tokenize(corpus::document& query)
+{
+    std::lock_guard<std::mutex> lock{analyzer_mutex_};
+    idx_->tokenize(query);
+}
+
+auto live_segment::make_view(const corpus::document& query) const -> view
+{
+    view v;
+    std::lock_guard<std::mutex> lock{mutex_};
+    v.num_docs = docs_.size();
+    v.total_terms = total_terms_;
+    v.deleted = deleted_;
+    for (const auto& count : query.counts())
+    {
+        auto& term = v.terms[count.first];
+        auto it = postings_.find(count.first);
+        if (it == postings_.end())
+            continue;
+        term.doc_freq = it->second.size();
+        term.total_count = term_counts_.at(count.first);
+        term.postings.reserve(it->second.size());
+        for (const auto& posting : it->second)
+            term.postings.push_back({posting.first, posting.second,
+                                     lengths_[posting.first],
+                                     unique_terms_[posting.first]});
+    }
+    return v;
+}
+
+std::vector<std::pair<doc_id, double>>
+    live_segment::score(ranker& r, const corpus::document& query,
+                        const view& v, const collection_stats& stats,
+                        uint64_t num_results,
+                        const std::function<bool(doc_id)>& filter) const
+{
+    score_data sd{*idx_, stats.avg_dl, stats.num_docs, stats.total_terms,
+                  query};
+    sd.t_id = term_id{0};
+
+    // the terms are scored in query order, as ranker::score does
+    std::unordered_map<doc_id, double> scores;
+    for (const auto& count : query.counts())
+    {
+        auto it = v.terms.find(count.first);
+        if (it == v.terms.end() || it->second.postings.empty())
+            continue;
+
+        sd.query_term_weight = count.second;
+        auto collection = stats.terms.find(count.first);
+        if (collection != stats.terms.end())
+        {
+            sd.doc_count = collection->second.first;
+            sd.corpus_term_count = collection->second.second;
+        }
+        else
+        {
+            sd.doc_count = it->second.doc_freq;
+            sd.corpus_term_count = it->second.total_count;
+        }
+        sd.corpus_term_prob = static_cast<double>(sd.corpus_term_count)
+                              / sd.total_terms;
+
+        for (const auto& posting : it->second.postings)
+        {
+            if (v.deleted[posting.d_id] || (filter && !filter(posting.d_id)))
+                continue;
+
+            sd.d_id = posting.d_id;
+            sd.doc_term_count = posting.count;
+            sd.doc_size = posting.doc_size;
+            sd.doc_unique_terms = posting.doc_unique_terms;
+
+            auto found = scores.find(posting.d_id);
+            if (found == scores.end())
+                found = scores.emplace(posting.d_id, r.initial_score(sd))
+                            .first;
+            found->second += r.score_one(sd);
+        }
+    }
+
+    std::vector<std::pair<doc_id, double>> results{scores.begin(),
+                                                   scores.end()};
+    auto better = [](const std::pair<doc_id, double>& a,
+                     const std::pair<doc_id, double>& b)
+    {
+        return a.second > b.second
+               || (a.second == b.second && a.first < b.first);
+    };
+    auto num = std::min<uint64_t>(num_results, results.size());
+    std::partial_sort(results.begin(), results.begin() + num, results.end(),
+                      better);
+    results.resize(num);
+    return results;
+}
+
+std::vector<corpus::document> live_segment::documents() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    std::vector<corpus::document> docs;
+    docs.reserve(docs_.size());
+    for (uint64_t i = 0; i < docs_.size(); ++i)
+        docs.push_back(copy_document(docs_[i], doc_id{i}));
+    return docs;
+}
+
+uint64_t live_segment::num_docs() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return docs_.size();
+}
+
+void live_segment::check(doc_id d_id) const
+{
+    if (d_id >= docs_.size())
+        throw live_segment_exception{"doc_id out of range: "
+                                     + std::to_string(d_id)};
+}
+
+std::string live_segment::doc_path(doc_id d_id) const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    check(d_id);
+    return docs_[d_id].path();
+}
+
+uint64_t live_segment::doc_size(doc_id d_id) const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    check(d_id);
+    return lengths_[d_id];
+}
+
+class_label live_segment::label(doc_id d_id) const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    check(d_id);
+    return docs_[d_id].label();
+}
+
+void live_segment::delete_doc(doc_id d_id)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    check(d_id);
+    if (!deleted_[d_id])
+    {
+        deleted_[d_id] = true;
+        ++num_deleted_;
+    }
+}
+
+bool live_segment::is_deleted(doc_id d_id) const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    check(d_id);
+    return deleted_[d_id];
+}
+
+uint64_t live_segment::num_deleted() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return num_deleted_;
+}
+}
+}
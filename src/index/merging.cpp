@@ -0,0 +1,43 @@
+/**
+ * @file merging.cpp
+ */
+
+#include "cpptoml.h"
+#include "index/inverted_index.h"
+#include "index/merging.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace index
+{
+
+std::shared_ptr<inverted_index>
+    merge_indexes(const std::vector<std::shared_ptr<inverted_index>>& sources,
+                  const std::string& config_file)
+{
+    if (sources.empty())
+        throw merging_exception{"there are no indexes to merge"};
+
+    auto config = cpptoml::parse_file(config_file);
+    auto name = config.get_as<std::string>("inverted-index");
+    if (!name)
+        throw merging_exception{"inverted-index missing from configuration "
+                                "file"};
+
+    // can't use std::make_shared here since the constructor is protected
+    std::shared_ptr<inverted_index> idx{new inverted_index(config)};
+    for (const auto& src : sources)
+    {
+        if (idx->index_name() == src->index_name())
+            throw merging_exception{"the merged index must not replace one "
+                                    "of its sources"};
+    }
+
+    filesystem::remove_all(idx->index_name());
+    filesystem::make_directory(idx->index_name());
+    idx->create_index(config_file, sources);
+    return idx;
+}
+}
+}
@@ -0,0 +1,410 @@
+/**
+ * @file near_duplicates.cpp
+ */
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+#include <utility>
+
+#include "cpptoml.h"
+#include "index/forward_index.h"
+#include "index/near_duplicates.h"
+#include "parallel/parallel_for.h"
+#include "parallel/thread_pool.h"
+#include "util/trace.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/**
+ * Scrambles the bits of a value (the finalizer of splitmix64).
+ * @param x The value
+ * @return the scrambled value
+ */
+uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111eb;
+    x ^= x >> 31;
+    return x;
+}
+
+/**
+ * The signatures of every document, kept in one array.
+ */
+class signatures
+{
+  public:
+    /**
+     * Computes the signatures of the documents of an index.
+     * @param idx The index
+     * @param options How the signatures are computed
+     * @param pool The threads to compute them on
+     */
+    signatures(const forward_index& idx, const dedup_options& options,
+               parallel::thread_pool& pool)
+        : method_{options.method},
+          width_{options.method == signature_method::minhash
+                     ? options.num_hashes
+                     : 1},
+          values_(idx.num_docs() * width_),
+          empty_(idx.num_docs(), false)
+    {
+        std::vector<std::vector<std::pair<term_id, double>>> counts(
+            pool.thread_ids().size());
+        std::vector<std::vector<double>> weights(counts.size());
+        parallel::parallel_chunks(
+            pool, idx.num_docs(), 0,
+            [&](uint64_t task, uint64_t first, uint64_t last)
+            {
+                for (doc_id d_id{first}; d_id < last; ++d_id)
+                {
+                    if (idx.is_deleted(d_id))
+                    {
+                        empty_[d_id] = true;
+                        continue;
+                    }
+                    idx.read_counts(d_id, counts[task]);
+                    if (counts[task].empty())
+                    {
+                        empty_[d_id] = true;
+                        continue;
+                    }
+                    if (method_ == signature_method::minhash)
+                        minhash(counts[task], &values_[d_id * width_]);
+                    else
+                        values_[d_id] = simhash(counts[task], weights[task]);
+                }
+            });
+    }
+
+    /**
+     * @param d_id A document
+     * @return whether the document has no signature, being deleted or
+     * without terms
+     */
+    bool empty(doc_id d_id) const
+    {
+        return empty_[d_id];
+    }
+
+    /**
+     * @param d_id A document
+     * @param band A band of the signatures
+     * @param num_bands The number of bands
+     * @return the hash of the document's signature in the band
+     */
+    uint64_t band_key(doc_id d_id, uint64_t band, uint64_t num_bands) const
+    {
+        if (method_ == signature_method::simhash)
+        {
+            auto first = band * 64 / num_bands;
+            auto last = (band + 1) * 64 / num_bands;
+            auto bits = values_[d_id] >> first;
+            return last - first == 64 ? bits
+                                      : bits & ((uint64_t{1} << (last - first))
+                                                - 1);
+        }
+
+        auto rows = width_ / num_bands;
+        uint64_t key = 0;
+        for (uint64_t i = band * rows; i < (band + 1) * rows; ++i)
+            key = mix(key ^ values_[d_id * width_ + i]);
+        return key;
+    }
+
+    /**
+     * @param a A document
+     * @param b Another document
+     * @return the similarity of the two documents' signatures
+     */
+    double similarity(doc_id a, doc_id b) const
+    {
+        if (method_ == signature_method::simhash)
+        {
+            auto diff = __builtin_popcountll(values_[a] ^ values_[b]);
+            return 1.0 - diff / 64.0;
+        }
+
+        uint64_t same = 0;
+        for (uint64_t i = 0; i < width_; ++i)
+            same += values_[a * width_ + i] == values_[b * width_ + i];
+        return static_cast<double>(same) / width_;
+    }
+
+  private:
+    /**
+     * Computes the MinHash signature of a document.
+     * @param counts The terms of the document
+     * @param out Where to write the num_hashes values
+     */
+    void minhash(const std::vector<std::pair<term_id, double>>& counts,
+                 uint64_t* out) const
+    {
+        std::fill(out, out + width_, std::numeric_limits<uint64_t>::max());
+        for (const auto& count : counts)
+        {
+            // the hash functions are the mixes of the term's hash with
+            // each function's number
+            auto h = mix(count.first + 1);
+            for (uint64_t i = 0; i < width_; ++i)
+                out[i] = std::min(out[i], mix(h + i));
+        }
+    }
+
+    /**
+     * Computes the SimHash fingerprint of a document.
+     * @param counts The terms of the document
+     * @param weights A buffer for the weight of each bit
+     * @return the fingerprint
+     */
+    uint64_t simhash(const std::vector<std::pair<term_id, double>>& counts,
+                     std::vector<double>& weights) const
+    {
+        weights.assign(64, 0.0);
+        for (const auto& count : counts)
+        {
+            auto h = mix(count.first + 1);
+            for (uint64_t bit = 0; bit < 64; ++bit)
+                weights[bit] += (h >> bit) & 1 ? count.second : -count.second;
+        }
+
+        uint64_t fingerprint = 0;
+        for (uint64_t bit = 0; bit < 64; ++bit)
+            if (weights[bit] > 0)
+                fingerprint |= uint64_t{1} << bit;
+        return fingerprint;
+    }
+
+    /// How the signatures are computed
+    signature_method method_;
+
+    /// The number of values in each signature
+    uint64_t width_;
+
+    /// The signatures, width_ values per document
+    std::vector<uint64_t> values_;
+
+    /// Whether each document has no signature; a vector<bool> would not
+    /// let threads write neighboring documents at once
+    std::vector<char> empty_;
+};
+
+/**
+ * A union-find forest over documents.
+ */
+class disjoint_sets
+{
+  public:
+    /**
+     * @param size The number of documents
+     */
+    explicit disjoint_sets(uint64_t size) : parent_(size)
+    {
+        std::iota(parent_.begin(), parent_.end(), 0);
+    }
+
+    /**
+     * @param x A document
+     * @return the root of its set
+     */
+    uint64_t find(uint64_t x)
+    {
+        while (parent_[x] != x)
+        {
+            parent_[x] = parent_[parent_[x]];
+            x = parent_[x];
+        }
+        return x;
+    }
+
+    /**
+     * Joins the sets of two documents under the lower root.
+     * @param a A document
+     * @param b Another document
+     */
+    void join(uint64_t a, uint64_t b)
+    {
+        a = find(a);
+        b = find(b);
+        if (a == b)
+            return;
+        if (b < a)
+            std::swap(a, b);
+        parent_[b] = a;
+    }
+
+  private:
+    /// The parent of each document
+    std::vector<uint64_t> parent_;
+};
+
+/**
+ * Checks the options of a detection.
+ * @param options The options
+ */
+void check_options(const dedup_options& options)
+{
+    if (options.bands == 0)
+        throw dedup_exception{"near-duplicate detection needs a band"};
+    if (options.method == signature_method::minhash
+        && options.num_hashes < options.bands)
+        throw dedup_exception{"each band needs at least one MinHash value"};
+    if (options.method == signature_method::simhash && options.bands > 64)
+        throw dedup_exception{"a SimHash fingerprint has 64 bits, too few "
+                              "for more than 64 bands"};
+    if (options.threshold < 0 || options.threshold > 1)
+        throw dedup_exception{"the similarity threshold must be in [0, 1]"};
+}
+}
+
+near_duplicates::near_duplicates(uint64_t num_docs,
+                                 std::vector<std::vector<doc_id>> clusters)
+    : clusters_{std::move(clusters)}
+{
+    auto duplicate = std::make_shared<std::vector<bool>>(num_docs, false);
+    for (const auto& cluster : clusters_)
+        for (uint64_t i = 1; i < cluster.size(); ++i)
+            (*duplicate)[cluster[i]] = true;
+    duplicate_ = std::move(duplicate);
+}
+
+const std::vector<std::vector<doc_id>>& near_duplicates::clusters() const
+{
+    return clusters_;
+}
+
+std::vector<doc_id> near_duplicates::duplicates() const
+{
+    std::vector<doc_id> ids;
+    for (const auto& cluster : clusters_)
+        ids.insert(ids.end(), cluster.begin() + 1, cluster.end());
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+bool near_duplicates::is_duplicate(doc_id d_id) const
+{
+    return d_id < duplicate_->size() && (*duplicate_)[d_id];
+}
+
+std::function<bool(doc_id)> near_duplicates::filter() const
+{
+    auto duplicate = duplicate_;
+    return [duplicate](doc_id d_id)
+    {
+        return d_id >= duplicate->size() || !(*duplicate)[d_id];
+    };
+}
+
+near_duplicates find_near_duplicates(const forward_index& idx,
+                                     const dedup_options& options)
+{
+    trace::scoped_event event{"find_near_duplicates", "index"};
+    check_options(options);
+
+    parallel::thread_pool pool{options.num_threads == 0 ? 1
+                                                        : options.num_threads};
+    signatures sigs{idx, options, pool};
+
+    // each band sorts the documents by their key in it, so that candidate
+    // pairs are neighbors; the pairs that pass are kept per task
+    using candidate = std::pair<uint64_t, doc_id>;
+    std::vector<std::vector<std::pair<doc_id, doc_id>>> pairs(
+        pool.thread_ids().size());
+    parallel::parallel_chunks(
+        pool, options.bands, 1,
+        [&](uint64_t task, uint64_t first, uint64_t last)
+        {
+            std::vector<candidate> keys;
+            for (auto band = first; band < last; ++band)
+            {
+                keys.clear();
+                for (doc_id d_id{0}; d_id < idx.num_docs(); ++d_id)
+                    if (!sigs.empty(d_id))
+                        keys.emplace_back(
+                            sigs.band_key(d_id, band, options.bands), d_id);
+                std::sort(keys.begin(), keys.end());
+
+                auto similar = [&](doc_id a, doc_id b)
+                {
+                    return sigs.similarity(a, b) >= options.threshold;
+                };
+                for (uint64_t i = 1, start = 0; i < keys.size(); ++i)
+                {
+                    if (keys[i].first != keys[start].first)
+                    {
+                        start = i;
+                        continue;
+                    }
+                    auto d_id = keys[i].second;
+                    if (similar(keys[start].second, d_id))
+                        pairs[task].emplace_back(keys[start].second, d_id);
+                    else if (i - 1 != start
+                             && similar(keys[i - 1].second, d_id))
+                        pairs[task].emplace_back(keys[i - 1].second, d_id);
+                }
+            }
+        });
+
+    disjoint_sets sets{idx.num_docs()};
+    for (const auto& task_pairs : pairs)
+        for (const auto& pair : task_pairs)
+            sets.join(pair.first, pair.second);
+
+    // every root is the lowest document of its set, so visiting documents
+    // in order makes each cluster sorted and orders the clusters
+    std::vector<uint64_t> cluster_of(idx.num_docs(),
+                                     std::numeric_limits<uint64_t>::max());
+    std::vector<std::vector<doc_id>> clusters;
+    for (uint64_t d_id = 0; d_id < idx.num_docs(); ++d_id)
+    {
+        auto root = sets.find(d_id);
+        if (root == d_id)
+            continue;
+        if (cluster_of[root] == std::numeric_limits<uint64_t>::max())
+        {
+            cluster_of[root] = clusters.size();
+            clusters.push_back({doc_id{root}});
+        }
+        clusters[cluster_of[root]].push_back(doc_id{d_id});
+    }
+
+    return {idx.num_docs(), std::move(clusters)};
+}
+
+dedup_options make_dedup_options(const cpptoml::table& config)
+{
+    dedup_options options;
+    auto table = config.get_table("dedup");
+    if (!table)
+        return options;
+
+    if (auto method = table->get_as<std::string>("method"))
+    {
+        if (*method == "minhash")
+            options.method = signature_method::minhash;
+        else if (*method == "simhash")
+            options.method = signature_method::simhash;
+        else
+            throw dedup_exception{"unknown signature method: " + *method};
+    }
+    if (auto num_hashes = table->get_as<int64_t>("num-hashes"))
+        options.num_hashes = static_cast<uint64_t>(*num_hashes);
+    if (auto bands = table->get_as<int64_t>("bands"))
+        options.bands = static_cast<uint64_t>(*bands);
+    if (auto threshold = table->get_as<double>("threshold"))
+        options.threshold = *threshold;
+    if (auto threads = table->get_as<int64_t>("num-threads"))
+        options.num_threads = static_cast<uint64_t>(*threads);
+    return options;
+}
+}
+}
@@ -0,0 +1,107 @@
+/**
+ * @file phrase_query.cpp
+ */
+
+#include "index/inverted_index.h"
+#include "index/phrase_query.h"
+#include "index/positions_cursor.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/**
+ * Counts the positions in the current document at which the phrase
+ * starts. All cursors must be on the same document.
+ * @param cursors The cursors for the terms of the phrase, in order
+ * @param slop The number of other terms allowed between consecutive terms
+ * @return the number of matching start positions
+ */
+uint64_t count_matches(std::vector<positions_cursor>& cursors, uint64_t slop)
+{
+    std::vector<const std::vector<uint64_t>*> lists;
+    lists.reserve(cursors.size());
+    for (auto& c : cursors)
+        lists.push_back(&c.positions());
+
+    // next[i] is the first position in lists[i] that may still follow the
+    // previous term; since the start positions are visited in increasing
+    // order, the greedy (earliest) choice for each term never decreases
+    std::vector<uint64_t> next(lists.size(), 0);
+    uint64_t matches = 0;
+    for (auto start : *lists[0])
+    {
+        auto prev = start;
+        bool matched = true;
+        for (uint64_t i = 1; i < lists.size() && matched; ++i)
+        {
+            const auto& list = *lists[i];
+            while (next[i] < list.size() && list[next[i]] <= prev)
+                ++next[i];
+            if (next[i] == list.size())
+                return matches;
+            if (list[next[i]] > prev + 1 + slop)
+                matched = false;
+            else
+                prev = list[next[i]];
+        }
+        if (matched)
+            ++matches;
+    }
+    return matches;
+}
+}
+
+phrase_query::phrase_query(std::vector<term_id> terms, uint64_t slop)
+    : terms_{std::move(terms)}, slop_{slop}
+{
+    // nothing
+}
+
+std::vector<std::pair<doc_id, uint64_t>>
+    phrase_query::search(const inverted_index& idx) const
+{
+    if (!idx.has_positions())
+        throw phrase_query_exception{"index does not store term positions"};
+
+    std::vector<std::pair<doc_id, uint64_t>> results;
+    if (terms_.empty())
+        return results;
+
+    std::vector<positions_cursor> cursors;
+    cursors.reserve(terms_.size());
+    for (const auto& t_id : terms_)
+        cursors.push_back(idx.positions(t_id));
+
+    // intersect the postings lists, then the position lists of the
+    // documents that contain every term
+    doc_id target{0};
+    while (true)
+    {
+        bool aligned = true;
+        for (auto& c : cursors)
+        {
+            c.skip_to(target);
+            if (c.at_end())
+                return results;
+            if (c.doc() != target)
+            {
+                target = c.doc();
+                aligned = false;
+            }
+        }
+
+        if (!aligned)
+            continue;
+
+        auto matches = count_matches(cursors, slop_);
+        if (matches > 0)
+            results.emplace_back(target, matches);
+        target = doc_id{target + 1};
+    }
+}
+}
+}
@@ -0,0 +1,79 @@
+/**
+ * @file positions_cursor.cpp
+ */
+
+#include "index/positions_cursor.h"
+#include "io/stream_vbyte.h"
+
+namespace meta
+{
+namespace index
+{
+
+positions_cursor::positions_cursor() : data_{nullptr}, decoded_{false}
+{
+    // nothing
+}
+
+positions_cursor::positions_cursor(postings_cursor postings,
+                                   const char* positions)
+    : postings_{std::move(postings)},
+      data_{reinterpret_cast<const uint8_t*>(positions)},
+      decoded_{false}
+{
+    // nothing
+}
+
+bool positions_cursor::at_end() const
+{
+    return postings_.at_end();
+}
+
+doc_id positions_cursor::doc() const
+{
+    return postings_.doc();
+}
+
+uint64_t positions_cursor::count() const
+{
+    return postings_.count();
+}
+
+void positions_cursor::next()
+{
+    if (!decoded_)
+    {
+        // step over the encoded positions by finding their final bytes
+        for (uint64_t i = 0; i < postings_.count(); ++data_)
+        {
+            if (!(*data_ & 0x80))
+                ++i;
+        }
+    }
+    decoded_ = false;
+    postings_.next();
+}
+
+void positions_cursor::skip_to(doc_id d_id)
+{
+    while (!at_end() && doc() < d_id)
+        next();
+}
+
+const std::vector<uint64_t>& positions_cursor::positions()
+{
+    if (!decoded_)
+    {
+        positions_.clear();
+        uint64_t position = 0;
+        for (uint64_t i = 0; i < postings_.count(); ++i)
+        {
+            position += io::stream_vbyte::read_varint(data_);
+            positions_.push_back(position);
+        }
+        decoded_ = true;
+    }
+    return positions_;
+}
+}
+}
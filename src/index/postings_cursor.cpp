@@ -0,0 +1,469 @@
+/**
+ * @file postings_cursor.cpp
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "index/postings_cursor.h"
+#include "io/compressed_file_reader.h"
+#include "io/stream_vbyte.h"
+#include "util/metrics.h"
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+#include <immintrin.h>
+#endif
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/**
+ * @param docs A sorted array of doc_ids
+ * @param length The length of the array
+ * @param target A doc_id
+ * @return the number of doc_ids in the array that are less than target
+ */
+inline uint64_t count_less(const uint64_t* docs, uint64_t length,
+                           uint64_t target)
+{
+    // doc_ids are far below 2^63, so signed comparisons order them
+    uint64_t count = 0;
+    uint64_t i = 0;
+#if defined(__AVX2__)
+    auto targets = _mm256_set1_epi64x(static_cast<int64_t>(target));
+    for (; i + 4 <= length; i += 4)
+    {
+        auto values = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(docs + i));
+        auto less = _mm256_cmpgt_epi64(targets, values);
+        count += static_cast<uint64_t>(
+            __builtin_popcount(_mm256_movemask_pd(_mm256_castsi256_pd(less))));
+    }
+#elif defined(__SSE4_2__)
+    auto targets = _mm_set1_epi64x(static_cast<int64_t>(target));
+    for (; i + 2 <= length; i += 2)
+    {
+        auto values
+            = _mm_loadu_si128(reinterpret_cast<const __m128i*>(docs + i));
+        auto less = _mm_cmpgt_epi64(targets, values);
+        count += static_cast<uint64_t>(
+            __builtin_popcount(_mm_movemask_pd(_mm_castsi128_pd(less))));
+    }
+#endif
+    for (; i < length; ++i)
+        count += docs[i] < target;
+    return count;
+}
+
+/**
+ * Finds the first doc_id not less than target in a sorted array, by
+ * galloping forward from a position whose doc_id is less than it and then
+ * counting, branch-free, within the window the gallop stopped in. Targets
+ * close to the start are found in a few steps, as they are when
+ * intersecting postings lists.
+ * @param docs A sorted array of doc_ids
+ * @param pos A position in the array whose doc_id is less than target
+ * @param length The length of the array
+ * @param target A doc_id
+ * @return the position of the first doc_id not less than target, or
+ * length if there is none
+ */
+inline uint64_t gallop_to(const uint64_t* docs, uint64_t pos, uint64_t length,
+                          uint64_t target)
+{
+    uint64_t step = 1;
+    while (pos + step < length && docs[pos + step] < target)
+    {
+        pos += step;
+        step *= 2;
+    }
+    auto end = std::min(pos + step, length);
+    return pos + 1 + count_less(docs + pos + 1, end - pos - 1, target);
+}
+
+/**
+ * Reads gamma codes, as written by compressed_file_writer, directly from
+ * memory. Codes are read a 64-bit window at a time, with the length of
+ * each found by counting the leading zeros of the window.
+ */
+class gamma_reader
+{
+  public:
+    /**
+     * @param data The start of the coded data
+     * @param size The size of the coded data in bytes
+     * @param bit The position of the first code to read, in bits
+     */
+    gamma_reader(const uint8_t* data, uint64_t size, uint64_t bit)
+        : data_{data}, size_{size}, bit_{bit}
+    {
+        // nothing
+    }
+
+    /**
+     * @return the position of the next code, in bits
+     */
+    uint64_t position() const
+    {
+        return bit_;
+    }
+
+    /**
+     * @return the next value, mapped back as the default reader does; a
+     * read past the end of the data returns the delimiter
+     */
+    uint64_t next()
+    {
+        uint64_t zeros = 0;
+        while (true)
+        {
+            // a window holds at least 57 bits of the data
+            auto window = peek();
+            if (window != 0)
+            {
+                auto leading = static_cast<uint64_t>(__builtin_clzll(window));
+                if (leading < 57)
+                {
+                    zeros += leading;
+                    bit_ += leading;
+                    break;
+                }
+            }
+            if (bit_ >= size_ * 8)
+                return std::numeric_limits<uint64_t>::max();
+            zeros += 56;
+            bit_ += 56;
+        }
+        return io::default_compression_reader_mapping{}(read(zeros + 1));
+    }
+
+  private:
+    /**
+     * @return the 64 bits starting at the current position, with any
+     * past the end of the data as zeros
+     */
+    uint64_t peek() const
+    {
+        auto byte = bit_ / 8;
+        uint64_t window = 0;
+        if (byte + 8 <= size_)
+        {
+            // codes are stored most significant byte first
+            std::memcpy(&window, data_ + byte, sizeof(window));
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            window = __builtin_bswap64(window);
+#endif
+        }
+        else
+        {
+            for (uint64_t i = 0; i < 8; ++i)
+                window = (window << 8)
+                         | (byte + i < size_ ? data_[byte + i] : 0);
+        }
+        return window << (bit_ % 8);
+    }
+
+    /**
+     * @param count The number of bits to read, at most 64
+     * @return the next count bits
+     */
+    uint64_t read(uint64_t count)
+    {
+        if (count > 57)
+        {
+            auto high = read(count - 32);
+            return (high << 32) | read(32);
+        }
+        auto value = peek() >> (64 - count);
+        bit_ += count;
+        return value;
+    }
+
+    /// the start of the coded data
+    const uint8_t* data_;
+    /// the size of the coded data in bytes
+    uint64_t size_;
+    /// the position of the next code, in bits
+    uint64_t bit_;
+};
+
+/**
+ * Counts a decoded block in the metrics, if they are being collected.
+ * @param postings The number of postings in the block
+ * @param bytes The size of the block's coded data
+ */
+void count_decoded(uint64_t postings, uint64_t bytes)
+{
+    if (!metrics::enabled())
+        return;
+    static auto& decoded = metrics::get_counter("postings_decoded");
+    static auto& read = metrics::get_counter("postings_bytes_read");
+    decoded.add(postings);
+    read.add(bytes);
+}
+}
+
+const uint64_t postings_cursor::block_size;
+
+postings_cursor::postings_cursor()
+    : data_{nullptr},
+      gamma_{nullptr},
+      gamma_size_{0},
+      size_{0},
+      max_count_{0},
+      block_{0},
+      pos_{0},
+      block_length_{0},
+      end_doc_{std::numeric_limits<uint64_t>::max()}
+{
+    // nothing
+}
+
+postings_cursor::postings_cursor(const char* data) : postings_cursor{}
+{
+    auto in = reinterpret_cast<const uint8_t*>(data);
+    size_ = io::stream_vbyte::read_varint(in);
+
+    uint64_t num_blocks = (size_ + block_size - 1) / block_size;
+    blocks_.reserve(num_blocks);
+
+    uint64_t last_doc = 0;
+    uint64_t offset = 0;
+    for (uint64_t i = 0; i < num_blocks; ++i)
+    {
+        last_doc += io::stream_vbyte::read_varint(in);
+        auto length = io::stream_vbyte::read_varint(in);
+        auto max_count = io::stream_vbyte::read_varint(in);
+        blocks_.push_back({doc_id{last_doc}, offset, max_count});
+        max_count_ = std::max(max_count_, max_count);
+        offset += length;
+    }
+
+    data_ = in;
+    load_block(0);
+}
+
+postings_cursor::postings_cursor(const char* data, uint64_t size,
+                                 uint64_t bit_location)
+    : postings_cursor{}
+{
+    gamma_ = reinterpret_cast<const uint8_t*>(data);
+    gamma_size_ = size;
+
+    // the first pass only notes where each block starts and the largest
+    // doc_id and count in it; the postings are decoded in load_block()
+    gamma_reader in{gamma_, gamma_size_, bit_location};
+    uint64_t last_doc = 0;
+    uint64_t offset = bit_location;
+    uint64_t length = 0;
+    uint64_t max_count = 0;
+    while (true)
+    {
+        auto start = in.position();
+        auto gap = in.next();
+        if (gap == std::numeric_limits<uint64_t>::max())
+            break;
+
+        if (length == 0)
+            offset = start;
+        last_doc += gap;
+        max_count = std::max(max_count, in.next());
+        ++size_;
+        if (++length == block_size)
+        {
+            blocks_.push_back({doc_id{last_doc}, offset, max_count});
+            max_count_ = std::max(max_count_, max_count);
+            length = 0;
+            max_count = 0;
+        }
+    }
+    if (length > 0)
+    {
+        blocks_.push_back({doc_id{last_doc}, offset, max_count});
+        max_count_ = std::max(max_count_, max_count);
+    }
+    load_block(0);
+}
+
+namespace
+{
+/**
+ * @param counts Decoded postings
+ * @return postings_data holding them
+ */
+std::shared_ptr<const postings_data<term_id, doc_id>>
+    make_pdata(std::vector<std::pair<doc_id, double>> counts)
+{
+    auto pdata = std::make_shared<postings_data<term_id, doc_id>>(term_id{0});
+    pdata->set_counts(std::move(counts));
+    return pdata;
+}
+}
+
+postings_cursor::postings_cursor(std::vector<std::pair<doc_id, double>> counts)
+    : postings_cursor{make_pdata(std::move(counts))}
+{
+    // nothing
+}
+
+postings_cursor::postings_cursor(
+    std::shared_ptr<const postings_data<term_id, doc_id>> pdata)
+    : postings_cursor{}
+{
+    decoded_ = std::move(pdata);
+    const auto& counts = decoded_->counts();
+    size_ = counts.size();
+    for (uint64_t start = 0; start < size_; start += block_size)
+    {
+        auto end = std::min(start + block_size, size_);
+        uint64_t max_count = 0;
+        for (auto i = start; i < end; ++i)
+            max_count = std::max(max_count,
+                                 static_cast<uint64_t>(counts[i].second));
+        blocks_.push_back({counts[end - 1].first, start, max_count});
+        max_count_ = std::max(max_count_, max_count);
+    }
+    load_block(0);
+}
+
+void postings_cursor::load_block(uint64_t block)
+{
+    block_ = block;
+    pos_ = 0;
+    if (block_ >= blocks_.size())
+    {
+        block_length_ = 0;
+        return;
+    }
+
+    block_length_ = std::min(block_size, size_ - block_ * block_size);
+    const auto& info = blocks_[block_];
+
+    if (gamma_)
+    {
+        // the first doc_id of the list is coded as a gap from zero
+        gamma_reader in{gamma_, gamma_size_, info.offset};
+        uint64_t last_doc = 0;
+        if (block_ > 0)
+            last_doc = blocks_[block_ - 1].last_doc;
+        for (uint64_t i = 0; i < block_length_; ++i)
+        {
+            last_doc += in.next();
+            docs_[i] = last_doc;
+            counts_[i] = static_cast<uint32_t>(in.next());
+        }
+        count_decoded(block_length_, (in.position() - info.offset + 7) / 8);
+        return;
+    }
+
+    if (!data_)
+    {
+        for (uint64_t i = 0; i < block_length_; ++i)
+        {
+            const auto& p = decoded_->counts()[info.offset + i];
+            docs_[i] = p.first;
+            counts_[i] = static_cast<uint32_t>(p.second);
+        }
+        return;
+    }
+
+    // doc_ids are gaps from the last doc_id of the previous block
+    std::array<uint32_t, block_size> gaps;
+    auto in = data_ + info.offset;
+    in += io::stream_vbyte::decode(in, block_length_, gaps.data());
+    in += io::stream_vbyte::decode(in, block_length_, counts_.data());
+    count_decoded(block_length_,
+                  static_cast<uint64_t>(in - (data_ + info.offset)));
+
+    // (a conditional expression here would narrow the doc_id through int)
+    uint64_t last_doc = 0;
+    if (block_ > 0)
+        last_doc = blocks_[block_ - 1].last_doc;
+    for (uint64_t i = 0; i < block_length_; ++i)
+    {
+        last_doc += gaps[i];
+        docs_[i] = last_doc;
+    }
+}
+
+bool postings_cursor::at_end() const
+{
+    return block_ >= blocks_.size() || docs_[pos_] >= end_doc_;
+}
+
+void postings_cursor::restrict_to(doc_id first, doc_id last)
+{
+    end_doc_ = last;
+    skip_to(first);
+}
+
+doc_id postings_cursor::doc() const
+{
+    return doc_id{docs_[pos_]};
+}
+
+uint64_t postings_cursor::count() const
+{
+    return counts_[pos_];
+}
+
+void postings_cursor::next()
+{
+    if (++pos_ == block_length_)
+        load_block(block_ + 1);
+}
+
+void postings_cursor::next_block()
+{
+    if (!at_end())
+        load_block(block_ + 1);
+}
+
+void postings_cursor::skip_to(doc_id d_id)
+{
+    if (at_end() || doc() >= d_id)
+        return;
+
+    if (blocks_[block_].last_doc < d_id)
+    {
+        auto it = std::lower_bound(blocks_.begin() + block_ + 1, blocks_.end(),
+                                   d_id, [](const block_info& b, doc_id id)
+                                   {
+                                       return b.last_doc < id;
+                                   });
+        load_block(static_cast<uint64_t>(it - blocks_.begin()));
+        if (at_end())
+            return;
+    }
+
+    // the current block is now known to contain a doc_id >= d_id
+    if (docs_[pos_] < d_id)
+        pos_ = gallop_to(docs_.data(), pos_, block_length_, d_id);
+}
+
+doc_id postings_cursor::block_last_doc() const
+{
+    return blocks_[block_].last_doc;
+}
+
+uint64_t postings_cursor::block_max_count() const
+{
+    return blocks_[block_].max_count;
+}
+
+uint64_t postings_cursor::max_count() const
+{
+    return max_count_;
+}
+
+uint64_t postings_cursor::size() const
+{
+    return size_;
+}
+}
+}
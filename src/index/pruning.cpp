@@ -0,0 +1,338 @@
+/**
+ * @file pruning.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+#include <limits>
+
+#include "cpptoml.h"
+#include "corpus/document.h"
+#include "index/deleted_docs.h"
+#include "index/inverted_index.h"
+#include "index/postings_cursor.h"
+#include "index/pruning.h"
+#include "index/ranker/ranker.h"
+#include "index/score_data.h"
+#include "parallel/thread_pool.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/// The impacts of one term's postings, in doc_id order
+using term_impacts = std::vector<std::pair<doc_id, double>>;
+
+/**
+ * Scores the postings of an index for a query term of weight one.
+ */
+class impact_scorer
+{
+  public:
+    /**
+     * @param idx The index whose postings to score
+     * @param r The ranker to score them with
+     */
+    impact_scorer(inverted_index& idx, ranker& r)
+        : idx_(idx),
+          r_(r),
+          sd_{idx, idx.avg_doc_length(), idx.num_docs(),
+              idx.total_corpus_terms(), unit()}
+    {
+        sd_.query_term_weight = 1;
+    }
+
+    /**
+     * Sets the term whose postings are scored next.
+     * @param t_id The term
+     */
+    void term(term_id t_id)
+    {
+        sd_.t_id = t_id;
+        sd_.doc_count = idx_.doc_freq(t_id);
+        sd_.corpus_term_count = idx_.total_num_occurences(t_id);
+        sd_.corpus_term_prob = idx_.collection_probability(t_id);
+    }
+
+    /**
+     * @param d_id The document of a posting of the current term
+     * @param count The count of the term in the document
+     * @return the impact of the posting
+     */
+    double operator()(doc_id d_id, uint64_t count)
+    {
+        sd_.d_id = d_id;
+        sd_.doc_term_count = count;
+        auto info = idx_.doc_info(d_id);
+        sd_.doc_size = info.length;
+        sd_.doc_unique_terms = info.unique_terms;
+        return r_.score_one(sd_);
+    }
+
+  private:
+    /**
+     * @return the query impacts are scored for, of length one
+     */
+    static const corpus::document& unit()
+    {
+        static const corpus::document doc = []()
+        {
+            corpus::document d;
+            d.increment("[impact]", 1);
+            return d;
+        }();
+        return doc;
+    }
+
+    /// The index whose postings are scored
+    inverted_index& idx_;
+    /// The ranker they are scored with
+    ranker& r_;
+    /// The score_data handed to the ranker
+    score_data sd_;
+};
+
+/**
+ * Computes the impact of every posting of an index's documents that are
+ * not deleted.
+ * @param idx The index
+ * @param r The ranker
+ * @param num_threads The number of threads to score with
+ * @return the impacts of each term's postings
+ */
+std::vector<term_impacts> compute_impacts(inverted_index& idx, ranker& r,
+                                          uint64_t num_threads)
+{
+    auto num_terms = idx.unique_terms();
+    std::vector<term_impacts> impacts(num_terms);
+
+    // each thread scores a contiguous range of terms
+    auto num_parts = std::max<uint64_t>(
+        1, std::min<uint64_t>(num_threads, num_terms));
+    auto worker = [&](uint64_t part)
+    {
+        impact_scorer impact{idx, r};
+        const auto& deleted = idx.deleted();
+        auto last = num_terms * (part + 1) / num_parts;
+        for (auto t = num_terms * part / num_parts; t < last; ++t)
+        {
+            impact.term(term_id{t});
+            auto cursor = idx.cursor(term_id{t});
+            impacts[t].reserve(cursor.size());
+            for (; !cursor.at_end(); cursor.next())
+            {
+                if (!deleted.contains(cursor.doc()))
+                    impacts[t].emplace_back(
+                        cursor.doc(), impact(cursor.doc(), cursor.count()));
+            }
+        }
+    };
+
+    if (num_parts == 1)
+    {
+        worker(0);
+        return impacts;
+    }
+
+    parallel::thread_pool pool{num_parts};
+    std::vector<std::future<void>> futures;
+    for (uint64_t part = 0; part < num_parts; ++part)
+        futures.push_back(pool.submit_task([&, part]()
+                                           {
+                                               worker(part);
+                                           }));
+    for (auto& fut : futures)
+        fut.get();
+    return impacts;
+}
+
+/**
+ * @param values Some values, which are reordered
+ * @param num The number of the largest values wanted, at least one and
+ * at most values.size()
+ * @return the num-th largest value
+ */
+double nth_largest(std::vector<double>& values, uint64_t num)
+{
+    auto nth = values.begin() + static_cast<std::ptrdiff_t>(num - 1);
+    std::nth_element(values.begin(), nth, values.end(),
+                     std::greater<double>{});
+    return *nth;
+}
+
+/**
+ * @param total The number of postings
+ * @param keep The fraction of them to keep
+ * @return the number of postings to keep, at least one of any
+ */
+uint64_t num_kept(uint64_t total, double keep)
+{
+    auto num = static_cast<uint64_t>(std::ceil(keep * total));
+    return std::max<uint64_t>(1, std::min(num, total));
+}
+
+/**
+ * Chooses each term's impact threshold for term-centric pruning: a term's
+ * threshold is its k-th best impact scaled by a factor shared by all
+ * terms, the largest factor no greater than one that keeps the target
+ * fraction of the postings.
+ * @param impacts The impacts of each term's postings
+ * @param options The pruning options
+ * @return the smallest impact each term keeps
+ */
+std::vector<double> term_thresholds(const std::vector<term_impacts>& impacts,
+                                    const pruning_options& options)
+{
+    auto top_k = std::max<uint64_t>(1, options.top_k);
+    std::vector<double> kth(impacts.size(),
+                            std::numeric_limits<double>::infinity());
+    std::vector<double> ratios;
+    std::vector<double> values;
+    for (uint64_t t = 0; t < impacts.size(); ++t)
+    {
+        if (impacts[t].empty())
+            continue;
+        values.clear();
+        for (const auto& impact : impacts[t])
+            values.push_back(impact.second);
+        auto k = std::min<uint64_t>(top_k, values.size());
+        kth[t] = nth_largest(values, k);
+
+        // impacts are scores, which may be negative for some rankers;
+        // relative to the k-th best, they are how far below it they are
+        for (const auto& impact : impacts[t])
+            ratios.push_back(kth[t] > 0 ? impact.second / kth[t]
+                                        : impact.second - kth[t] + 1);
+    }
+
+    std::vector<double> thresholds(impacts.size(),
+                                   std::numeric_limits<double>::infinity());
+    if (ratios.empty())
+        return thresholds;
+
+    auto epsilon = std::min(
+        1.0, nth_largest(ratios, num_kept(ratios.size(), options.keep)));
+    for (uint64_t t = 0; t < impacts.size(); ++t)
+    {
+        if (impacts[t].empty())
+            continue;
+        thresholds[t] = kth[t] > 0 ? epsilon * kth[t] : kth[t] + epsilon - 1;
+    }
+    return thresholds;
+}
+
+/**
+ * Chooses each document's impact threshold for document-centric pruning:
+ * the impact of the document's posting at the target fraction of them.
+ * @param impacts The impacts of each term's postings
+ * @param num_docs The number of documents
+ * @param options The pruning options
+ * @return the smallest impact each document keeps
+ */
+std::vector<double> doc_thresholds(const std::vector<term_impacts>& impacts,
+                                   uint64_t num_docs,
+                                   const pruning_options& options)
+{
+    std::vector<std::vector<double>> by_doc(num_docs);
+    for (const auto& term : impacts)
+    {
+        for (const auto& impact : term)
+            by_doc[impact.first].push_back(impact.second);
+    }
+
+    std::vector<double> thresholds(num_docs,
+                                   std::numeric_limits<double>::infinity());
+    for (uint64_t d = 0; d < num_docs; ++d)
+    {
+        auto& values = by_doc[d];
+        if (values.empty())
+            continue;
+        thresholds[d] = nth_largest(values, num_kept(values.size(),
+                                                     options.keep));
+        std::vector<double>{}.swap(values);
+    }
+    return thresholds;
+}
+}
+
+std::shared_ptr<inverted_index>
+    prune_index(const std::shared_ptr<inverted_index>& source, ranker& r,
+                const std::string& config_file,
+                const pruning_options& options)
+{
+    if (!(options.keep > 0 && options.keep <= 1))
+        throw pruning_exception{"the fraction of postings to keep must be "
+                                "in (0, 1]"};
+
+    auto config = cpptoml::parse_file(config_file);
+    auto name = config.get_as<std::string>("inverted-index");
+    if (!name)
+        throw pruning_exception{"inverted-index missing from configuration "
+                                "file"};
+
+    // can't use std::make_shared here since the constructor is protected
+    std::shared_ptr<inverted_index> idx{new inverted_index(config)};
+    if (idx->index_name() == source->index_name())
+        throw pruning_exception{"the pruned index must not replace its "
+                                "source"};
+
+    auto impacts = compute_impacts(*source, r, options.num_threads);
+    auto by_doc = options.method == pruning_method::document_centric;
+    auto thresholds = by_doc
+                          ? doc_thresholds(impacts, source->num_docs(),
+                                           options)
+                          : term_thresholds(impacts, options);
+    std::vector<term_impacts>{}.swap(impacts);
+
+    // postings are copied in order by term, so the scorer is only told of
+    // each new term once
+    impact_scorer impact{*source, r};
+    term_id current{std::numeric_limits<uint64_t>::max()};
+    auto keep = [&](term_id t_id, doc_id d_id, uint64_t count)
+    {
+        if (t_id != current)
+        {
+            impact.term(t_id);
+            current = t_id;
+        }
+        auto threshold = by_doc ? thresholds[d_id] : thresholds[t_id];
+        return impact(d_id, count) >= threshold;
+    };
+
+    filesystem::remove_all(idx->index_name());
+    filesystem::make_directory(idx->index_name());
+    idx->create_index(config_file, source, keep);
+    return idx;
+}
+
+pruning_options make_pruning_options(const cpptoml::table& config)
+{
+    pruning_options options;
+    auto table = config.get_table("pruning");
+    if (!table)
+        return options;
+
+    if (auto method = table->get_as<std::string>("method"))
+    {
+        if (*method == "term-centric")
+            options.method = pruning_method::term_centric;
+        else if (*method == "document-centric")
+            options.method = pruning_method::document_centric;
+        else
+            throw pruning_exception{"unknown pruning method: " + *method};
+    }
+    if (auto keep = table->get_as<double>("keep"))
+        options.keep = *keep;
+    if (auto top_k = table->get_as<int64_t>("top-k"))
+        options.top_k = static_cast<uint64_t>(*top_k);
+    if (auto threads = table->get_as<int64_t>("num-threads"))
+        options.num_threads = static_cast<uint64_t>(*threads);
+    return options;
+}
+}
+}
@@ -4,7 +4,11 @@
  */
 
 #include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
 #include "cpptoml.h"
+#include "corpus/document.h"
 #include "index/ranker/absolute_discount.h"
 #include "index/score_data.h"
 
@@ -22,7 +26,7 @@ absolute_discount::absolute_discount(double delta) : delta_{delta}
 
 double absolute_discount::smoothed_prob(const score_data& sd) const
 {
-    double pc = static_cast<double>(sd.corpus_term_count) / sd.total_terms;
+    double pc = sd.corpus_term_prob;
     double numerator = std::max<double>(sd.doc_term_count - delta_, 0);
     double denominator = sd.doc_size;
     return numerator / denominator + doc_constant(sd) * pc;
@@ -34,6 +38,29 @@ double absolute_discount::doc_constant(const score_data& sd) const
     return delta_ * unique / sd.doc_size;
 }
 
+double absolute_discount::score_upper_bound(const score_data& sd) const
+{
+    // score_one() is w * log(1 + max(c - delta, 0) / (delta * u * p_c)),
+    // where u is the number of unique terms in the document
+    double pc = sd.corpus_term_prob;
+    double numerator = std::max<double>(sd.doc_term_count - delta_, 0);
+    return sd.query_term_weight * std::log(1.0 + numerator / (delta_ * pc));
+}
+
+double absolute_discount::initial_score_upper_bound(const score_data& sd) const
+{
+    // a document never has more unique terms than it has terms
+    return sd.query.length() * std::log(delta_);
+}
+
+std::string absolute_discount::parameters() const
+{
+    std::ostringstream out;
+    out.precision(std::numeric_limits<double>::max_digits10);
+    out << id << " delta=" << delta_;
+    return out.str();
+}
+
 template <>
 std::unique_ptr<ranker>
     make_ranker<absolute_discount>(const cpptoml::table& config)
@@ -3,6 +3,9 @@
  * @author Sean Massung
  */
 
+#include <cmath>
+#include <limits>
+#include <sstream>
 #include "cpptoml.h"
 #include "index/ranker/dirichlet_prior.h"
 #include "index/score_data.h"
@@ -21,7 +24,7 @@ dirichlet_prior::dirichlet_prior(double mu) : mu_{mu}
 
 double dirichlet_prior::smoothed_prob(const score_data& sd) const
 {
-    double pc = static_cast<double>(sd.corpus_term_count) / sd.total_terms;
+    double pc = sd.corpus_term_prob;
     double numerator = sd.doc_term_count + mu_ * pc;
     double denominator = sd.doc_size + mu_;
     return numerator / denominator;
@@ -32,6 +35,46 @@ double dirichlet_prior::doc_constant(const score_data& sd) const
     return mu_ / (sd.doc_size + mu_);
 }
 
+void dirichlet_prior::score_postings(score_data& sd,
+                                     const posting_block& block,
+                                     double* scores)
+{
+    // the same as score_one(), with smoothed_prob() and doc_constant()
+    // written out
+    double pc = sd.corpus_term_prob;
+    double mu_pc = mu_ * pc;
+    for (uint64_t i = 0; i < block.size; ++i)
+    {
+        double denominator = block.doc_sizes[i] + mu_;
+        double ps = (block.doc_term_counts[i] + mu_pc) / denominator;
+        scores[i] = sd.query_term_weight
+                    * std::log(ps / ((mu_ / denominator) * pc));
+    }
+}
+
+double dirichlet_prior::score_upper_bound(const score_data& sd) const
+{
+    // score_one() is w * log(1 + c / (mu * p_c)), independent of the
+    // document's length
+    double pc = sd.corpus_term_prob;
+    return sd.query_term_weight
+           * std::log(1.0 + sd.doc_term_count / (mu_ * pc));
+}
+
+double dirichlet_prior::initial_score_upper_bound(const score_data&) const
+{
+    // doc_constant() is always less than one
+    return 0.0;
+}
+
+std::string dirichlet_prior::parameters() const
+{
+    std::ostringstream out;
+    out.precision(std::numeric_limits<double>::max_digits10);
+    out << id << " mu=" << mu_;
+    return out.str();
+}
+
 template <>
 std::unique_ptr<ranker>
     make_ranker<dirichlet_prior>(const cpptoml::table& config)
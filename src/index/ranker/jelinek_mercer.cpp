@@ -3,7 +3,11 @@
  * @author Sean Massung
  */
 
+#include <cmath>
+#include <limits>
+#include <sstream>
 #include "cpptoml.h"
+#include "corpus/document.h"
 #include "index/ranker/jelinek_mercer.h"
 #include "index/score_data.h"
 
@@ -23,7 +27,7 @@ double jelinek_mercer::smoothed_prob(const score_data& sd) const
 {
     double max_likelihood = static_cast<double>(sd.doc_term_count)
                             / sd.doc_size;
-    double pc = static_cast<double>(sd.corpus_term_count) / sd.total_terms;
+    double pc = sd.corpus_term_prob;
     return (1.0 - lambda_) * max_likelihood + lambda_ * pc;
 }
 
@@ -32,6 +36,43 @@ double jelinek_mercer::doc_constant(const score_data&) const
     return lambda_;
 }
 
+void jelinek_mercer::score_postings(score_data& sd, const posting_block& block,
+                                    double* scores)
+{
+    // the same as score_one(), with smoothed_prob() and doc_constant()
+    // written out
+    double pc = sd.corpus_term_prob;
+    double smoothed_pc = lambda_ * pc;
+    for (uint64_t i = 0; i < block.size; ++i)
+    {
+        double max_likelihood = static_cast<double>(block.doc_term_counts[i])
+                                / block.doc_sizes[i];
+        double ps = (1.0 - lambda_) * max_likelihood + smoothed_pc;
+        scores[i] = sd.query_term_weight * std::log(ps / smoothed_pc);
+    }
+}
+
+double jelinek_mercer::score_upper_bound(const score_data& sd) const
+{
+    // the maximum likelihood estimate is at most one
+    double pc = sd.corpus_term_prob;
+    return sd.query_term_weight
+           * std::log(1.0 + (1.0 - lambda_) / (lambda_ * pc));
+}
+
+double jelinek_mercer::initial_score_upper_bound(const score_data& sd) const
+{
+    return sd.query.length() * std::log(lambda_);
+}
+
+std::string jelinek_mercer::parameters() const
+{
+    std::ostringstream out;
+    out.precision(std::numeric_limits<double>::max_digits10);
+    out << id << " lambda=" << lambda_;
+    return out.str();
+}
+
 template <>
 std::unique_ptr<ranker>
     make_ranker<jelinek_mercer>(const cpptoml::table& config)
@@ -18,7 +18,7 @@ const std::string language_model_ranker::id = "language-model";
 double language_model_ranker::score_one(const score_data& sd)
 {
     double ps = smoothed_prob(sd);
-    double pc = static_cast<double>(sd.corpus_term_count) / sd.total_terms;
+    double pc = sd.corpus_term_prob;
 
     return sd.query_term_weight * std::log(ps / (doc_constant(sd) * pc));
 }
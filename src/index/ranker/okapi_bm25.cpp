@@ -4,6 +4,8 @@
  */
 
 #include <cmath>
+#include <limits>
+#include <sstream>
 #include "index/inverted_index.h"
 #include "index/ranker/okapi_bm25.h"
 #include "index/score_data.h"
@@ -22,7 +24,7 @@ okapi_bm25::okapi_bm25(double k1, double b, double k3) : k1_{k1}, b_{b}, k3_{k3}
 
 double okapi_bm25::score_one(const score_data& sd)
 {
-    double doc_len = sd.idx.doc_size(sd.d_id);
+    double doc_len = sd.doc_size;
 
     // add 1.0 to the IDF to ensure that the result is positive
     double IDF = std::log(
@@ -38,6 +40,48 @@ double okapi_bm25::score_one(const score_data& sd)
     return TF * IDF * QTF;
 }
 
+void okapi_bm25::score_postings(score_data& sd, const posting_block& block,
+                                double* scores)
+{
+    double IDF = std::log(
+        1.0 + (sd.num_docs - sd.doc_count + 0.5) / (sd.doc_count + 0.5));
+    double QTF = ((k3_ + 1.0) * sd.query_term_weight)
+                 / (k3_ + sd.query_term_weight);
+
+    for (uint64_t i = 0; i < block.size; ++i)
+    {
+        double doc_len = block.doc_sizes[i];
+        double count = block.doc_term_counts[i];
+        double TF = ((k1_ + 1.0) * count)
+                    / ((k1_ * ((1.0 - b_) + b_ * doc_len / sd.avg_dl))
+                       + count);
+        scores[i] = TF * IDF * QTF;
+    }
+}
+
+double okapi_bm25::score_upper_bound(const score_data& sd) const
+{
+    double IDF = std::log(
+        1.0 + (sd.num_docs - sd.doc_count + 0.5) / (sd.doc_count + 0.5));
+
+    // TF increases with doc_term_count and decreases with doc length
+    double TF = ((k1_ + 1.0) * sd.doc_term_count)
+                / (k1_ * (1.0 - b_) + sd.doc_term_count);
+
+    double QTF = ((k3_ + 1.0) * sd.query_term_weight)
+                 / (k3_ + sd.query_term_weight);
+
+    return TF * IDF * QTF;
+}
+
+std::string okapi_bm25::parameters() const
+{
+    std::ostringstream out;
+    out.precision(std::numeric_limits<double>::max_digits10);
+    out << id << " k1=" << k1_ << " b=" << b_ << " k3=" << k3_;
+    return out.str();
+}
+
 template <>
 std::unique_ptr<ranker> make_ranker<okapi_bm25>(const cpptoml::table& config)
 {
@@ -3,6 +3,8 @@
  * @author Sean Massung
  */
 
+#include <limits>
+#include <sstream>
 #include "index/inverted_index.h"
 #include "index/ranker/pivoted_length.h"
 #include "index/score_data.h"
@@ -21,7 +23,7 @@ pivoted_length::pivoted_length(double s) : s_{s}
 
 double pivoted_length::score_one(const score_data& sd)
 {
-    double doc_len = sd.idx.doc_size(sd.d_id);
+    double doc_len = sd.doc_size;
     double TF = 1 + log(1 + log(sd.doc_term_count));
     double norm = (1 - s_) + s_ * (doc_len / sd.avg_dl);
     double IDF = log((sd.num_docs + 1) / (0.5 + sd.doc_count));
@@ -29,6 +31,36 @@ double pivoted_length::score_one(const score_data& sd)
     return TF / norm * sd.query_term_weight * IDF;
 }
 
+void pivoted_length::score_postings(score_data& sd, const posting_block& block,
+                                    double* scores)
+{
+    double IDF = log((sd.num_docs + 1) / (0.5 + sd.doc_count));
+    for (uint64_t i = 0; i < block.size; ++i)
+    {
+        double doc_len = block.doc_sizes[i];
+        double TF = 1 + log(1 + log(block.doc_term_counts[i]));
+        double norm = (1 - s_) + s_ * (doc_len / sd.avg_dl);
+        scores[i] = TF / norm * sd.query_term_weight * IDF;
+    }
+}
+
+double pivoted_length::score_upper_bound(const score_data& sd) const
+{
+    double TF = 1 + log(1 + log(sd.doc_term_count));
+    double norm = 1 - s_;
+    double IDF = log((sd.num_docs + 1) / (0.5 + sd.doc_count));
+
+    return TF / norm * sd.query_term_weight * IDF;
+}
+
+std::string pivoted_length::parameters() const
+{
+    std::ostringstream out;
+    out.precision(std::numeric_limits<double>::max_digits10);
+    out << id << " s=" << s_;
+    return out.str();
+}
+
 template <>
 std::unique_ptr<ranker>
     make_ranker<pivoted_length>(const cpptoml::table& config)
@@ -0,0 +1,71 @@
+/**
+ * @file prepared_query.cpp
+ */
+
+#include "index/inverted_index.h"
+#include "index/ranker/prepared_query.h"
+
+namespace meta
+{
+namespace index
+{
+
+prepared_query::prepared_query(inverted_index& idx, corpus::document query)
+    : idx_{&idx},
+      query_{std::move(query)},
+      avg_dl_{idx.avg_doc_length()},
+      num_docs_{idx.num_docs()},
+      total_terms_{idx.total_corpus_terms()}
+{
+    if (query_.counts().empty())
+        idx.tokenize(query_);
+
+    // the terms are looked up in one pass over the vocabulary
+    std::vector<std::string> texts;
+    texts.reserve(query_.counts().size());
+    for (const auto& count : query_.counts())
+        texts.push_back(count.first);
+    auto t_ids = idx.get_term_ids(texts);
+
+    terms_.reserve(t_ids.size());
+    auto next_id = t_ids.begin();
+    for (const auto& count : query_.counts())
+    {
+        auto t_id = *next_id++;
+        terms_.push_back({t_id, count.second, idx.doc_freq(t_id),
+                          idx.total_num_occurences(t_id),
+                          idx.collection_probability(t_id)});
+    }
+}
+
+const inverted_index& prepared_query::index() const
+{
+    return *idx_;
+}
+
+const corpus::document& prepared_query::query() const
+{
+    return query_;
+}
+
+const std::vector<prepared_term>& prepared_query::terms() const
+{
+    return terms_;
+}
+
+double prepared_query::avg_doc_length() const
+{
+    return avg_dl_;
+}
+
+uint64_t prepared_query::num_docs() const
+{
+    return num_docs_;
+}
+
+uint64_t prepared_query::total_terms() const
+{
+    return total_terms_;
+}
+}
+}
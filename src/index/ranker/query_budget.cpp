@@ -0,0 +1,89 @@
+/**
+ * @file query_budget.cpp
+ */
+
+#include <limits>
+
+#include "index/ranker/query_budget.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/// the number of postings charged between readings of the clock
+const uint64_t clock_interval = 4096;
+}
+
+query_budget::query_budget()
+    : deadline_{clock::time_point::max()},
+      max_postings_{std::numeric_limits<uint64_t>::max()},
+      postings_{0},
+      last_clock_check_{0},
+      exhausted_{false}
+{
+    // nothing
+}
+
+query_budget& query_budget::deadline(clock::time_point when)
+{
+    deadline_ = when;
+    return *this;
+}
+
+query_budget& query_budget::timeout(clock::duration duration)
+{
+    return deadline(clock::now() + duration);
+}
+
+query_budget& query_budget::max_postings(uint64_t num_postings)
+{
+    max_postings_ = num_postings;
+    return *this;
+}
+
+void query_budget::cancel()
+{
+    exhausted_.store(true);
+}
+
+bool query_budget::charge(uint64_t num_postings)
+{
+    if (exhausted_.load(std::memory_order_relaxed))
+        return false;
+
+    auto total = postings_.fetch_add(num_postings, std::memory_order_relaxed)
+                 + num_postings;
+    if (total > max_postings_)
+    {
+        exhausted_.store(true);
+        return false;
+    }
+
+    if (deadline_ != clock::time_point::max()
+        && total - last_clock_check_.load(std::memory_order_relaxed)
+               >= clock_interval)
+    {
+        last_clock_check_.store(total, std::memory_order_relaxed);
+        if (clock::now() >= deadline_)
+        {
+            exhausted_.store(true);
+            return false;
+        }
+    }
+    return true;
+}
+
+bool query_budget::exhausted() const
+{
+    return exhausted_.load();
+}
+
+uint64_t query_budget::postings() const
+{
+    return postings_.load();
+}
+}
+}
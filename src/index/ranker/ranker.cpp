@@ -3,17 +3,351 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <typeinfo>
+#include <unordered_map>
+
 #include "corpus/document.h"
+#include "index/deleted_docs.h"
 #include "index/inverted_index.h"
+#include "index/postings_cursor.h"
 #include "index/postings_data.h"
+#include "index/ranker/prepared_query.h"
 #include "index/ranker/ranker.h"
 #include "index/score_data.h"
+#include "parallel/parallel_for.h"
+#include "parallel/thread_pool.h"
+#include "util/metrics.h"
 
 namespace meta
 {
 namespace index
 {
 
+namespace
+{
+using doc_pair = std::pair<doc_id, double>;
+
+/**
+ * Orders doc_pairs by decreasing score.
+ */
+struct doc_pair_comp
+{
+    bool operator()(const doc_pair& a, const doc_pair& b) const
+    {
+        return a.second > b.second;
+    }
+};
+
+/**
+ * A min-heap of the best num_results documents seen so far.
+ */
+class top_k_heap
+{
+  public:
+    top_k_heap(uint64_t num_results) : num_results_{num_results}
+    {
+        // nothing
+    }
+
+    void push(doc_id d_id, double score)
+    {
+        pq_.emplace(d_id, score);
+        if (pq_.size() > num_results_)
+            pq_.pop();
+    }
+
+    /**
+     * @return the score a new document must exceed to enter the heap
+     */
+    double threshold() const
+    {
+        if (pq_.size() < num_results_)
+            return std::numeric_limits<double>::lowest();
+        return pq_.top().second;
+    }
+
+    uint64_t size() const
+    {
+        return pq_.size();
+    }
+
+    /**
+     * @return the contents of the heap, sorted by decreasing score
+     */
+    std::vector<doc_pair> extract()
+    {
+        std::vector<doc_pair> sorted;
+        sorted.reserve(pq_.size());
+        while (!pq_.empty())
+        {
+            sorted.emplace_back(pq_.top());
+            pq_.pop();
+        }
+        std::reverse(sorted.begin(), sorted.end());
+        return sorted;
+    }
+
+  private:
+    uint64_t num_results_;
+    std::priority_queue<doc_pair, std::vector<doc_pair>, doc_pair_comp> pq_;
+};
+
+/**
+ * Score accumulators for term-at-a-time scoring. Each thread keeps its own
+ * set, reused across queries, so a single ranker can be shared by several
+ * query threads.
+ *
+ * Scores are kept in a dense array indexed by doc_id when the query's
+ * postings cover a sizeable fraction of the collection, or in a hash table
+ * otherwise. Either way, the documents touched by a query are recorded, so
+ * the cost of a query is proportional to its number of postings rather than
+ * the number of documents.
+ */
+class score_accumulators
+{
+  public:
+    /**
+     * Prepares the accumulators for a new query.
+     * @param num_docs The number of documents in the index
+     * @param num_postings The total number of postings of the query terms
+     */
+    void reset(uint64_t num_docs, uint64_t num_postings)
+    {
+        for (const auto& d_id : touched_)
+            dense_[d_id] = std::numeric_limits<double>::lowest();
+        touched_.clear();
+        sparse_.clear();
+
+        dense_mode_ = num_postings >= num_docs / sparse_ratio;
+        if (dense_mode_ && dense_.size() < num_docs)
+            dense_.resize(num_docs, std::numeric_limits<double>::lowest());
+        if (!dense_mode_)
+            sparse_.reserve(num_postings);
+    }
+
+    /**
+     * @param d_id The document to look up
+     * @param init Computes the initial score of the document, if this is
+     * the first time it has been seen
+     * @return the accumulator for the document
+     */
+    template <class Init>
+    double& at(doc_id d_id, Init&& init)
+    {
+        if (!dense_mode_)
+        {
+            auto it = sparse_.find(d_id);
+            if (it == sparse_.end())
+                it = sparse_.emplace(d_id, init()).first;
+            return it->second;
+        }
+
+        auto& score = dense_[d_id];
+        if (score == std::numeric_limits<double>::lowest())
+        {
+            touched_.push_back(d_id);
+            score = init();
+        }
+        return score;
+    }
+
+    /**
+     * @param d_id The document to check
+     * @return whether the current query matched the document
+     */
+    bool contains(doc_id d_id) const
+    {
+        if (!dense_mode_)
+            return sparse_.find(d_id) != sparse_.end();
+        return d_id < dense_.size()
+               && dense_[d_id] != std::numeric_limits<double>::lowest();
+    }
+
+    /**
+     * @return the number of documents matched by the current query
+     */
+    uint64_t size() const
+    {
+        return dense_mode_ ? touched_.size() : sparse_.size();
+    }
+
+    /**
+     * Calls fn(d_id, score) for each matched document.
+     */
+    template <class Function>
+    void for_each(Function&& fn) const
+    {
+        if (!dense_mode_)
+        {
+            for (const auto& acc : sparse_)
+                fn(acc.first, acc.second);
+            return;
+        }
+        for (const auto& d_id : touched_)
+            fn(d_id, dense_[d_id]);
+    }
+
+  private:
+    /**
+     * Hash table accumulators are used when the query has fewer than one
+     * posting per this many documents.
+     */
+    const static uint64_t sparse_ratio = 64;
+
+    /// whether the dense accumulators are in use for the current query
+    bool dense_mode_ = true;
+
+    /// scores by doc_id, or lowest() for unmatched documents
+    std::vector<double> dense_;
+
+    /// the documents with a dense accumulator set in the current query
+    std::vector<doc_id> touched_;
+
+    /// the sparse accumulators
+    std::unordered_map<doc_id, double> sparse_;
+};
+
+/**
+ * @param deleted The deleted documents of the index
+ * @param filter The filtering function for doc_ids, which may be empty
+ * @param d_id The document to check
+ * @return whether the document may be returned
+ */
+inline bool included(const deleted_docs& deleted,
+                     const std::function<bool(doc_id)>& filter, doc_id d_id)
+{
+    return !deleted.contains(d_id) && (!filter || filter(d_id));
+}
+
+/**
+ * Fills the rest of a result list with documents that matched no query
+ * terms, in doc_id order, as if they had been scored lowest().
+ * @param results The results to fill
+ * @param num_results The number of results wanted
+ * @param deleted The deleted documents of the index
+ * @param filter The filtering function for doc_ids
+ * @param matched Whether a document matched any query term
+ * @param first The first doc_id to fill with
+ * @param last One past the last doc_id to fill with
+ */
+template <class Matched>
+void pad_results(std::vector<doc_pair>& results, uint64_t num_results,
+                 const deleted_docs& deleted,
+                 const std::function<bool(doc_id)>& filter, Matched&& matched,
+                 uint64_t first = 0,
+                 uint64_t last = std::numeric_limits<uint64_t>::max())
+{
+    last = std::min(last, deleted.num_docs());
+    for (auto id = first; id < last && results.size() < num_results; ++id)
+    {
+        if (matched(doc_id{id}) || !included(deleted, filter, doc_id{id}))
+            continue;
+        results.emplace_back(doc_id{id}, std::numeric_limits<double>::lowest());
+    }
+}
+
+/**
+ * Replaces the index's statistics for a query term with the collection's.
+ * @param stats The collection statistics, or nullptr to keep the index's
+ * @param term The query term
+ * @param sd The score_data whose doc_count, corpus_term_count, and
+ * corpus_term_prob are set
+ */
+void apply_stats(const collection_stats* stats, const std::string& term,
+                 score_data& sd)
+{
+    if (!stats)
+        return;
+    auto it = stats->terms.find(term);
+    if (it != stats->terms.end())
+    {
+        sd.doc_count = it->second.first;
+        sd.corpus_term_count = it->second.second;
+    }
+    sd.corpus_term_prob = static_cast<double>(sd.corpus_term_count)
+                          / sd.total_terms;
+}
+
+/**
+ * Looks up the ids of all of a query's terms in one pass over the
+ * vocabulary.
+ * @param idx The index to look the terms up in
+ * @param query The query
+ * @return the id of each term, in the iteration order of query.counts()
+ */
+std::vector<term_id> query_term_ids(inverted_index& idx,
+                                    const corpus::document& query)
+{
+    std::vector<std::string> terms;
+    terms.reserve(query.counts().size());
+    for (const auto& count : query.counts())
+        terms.push_back(count.first);
+    return idx.get_term_ids(terms);
+}
+
+/**
+ * @param sd The score_data of a query
+ * @return the id of each of the query's terms, as prepared or as looked
+ * up in the index, in the iteration order of its counts()
+ */
+std::vector<term_id> query_term_ids(const score_data& sd)
+{
+    if (!sd.prepared)
+        return query_term_ids(sd.idx, sd.query);
+
+    std::vector<term_id> t_ids;
+    t_ids.reserve(sd.prepared->terms().size());
+    for (const auto& term : sd.prepared->terms())
+        t_ids.push_back(term.t_id);
+    return t_ids;
+}
+
+/**
+ * Sets the term-based fields of a score_data for a query term, from the
+ * prepared query if there is one and from the index otherwise.
+ * @param sd The score_data of the query
+ * @param i The position of the term in the query's counts()
+ * @param t_id The id of the term
+ * @param weight The weight of the term in the query
+ */
+void set_term_stats(score_data& sd, uint64_t i, term_id t_id, double weight)
+{
+    sd.t_id = t_id;
+    sd.query_term_weight = weight;
+    if (sd.prepared)
+    {
+        const auto& term = sd.prepared->terms()[i];
+        sd.doc_count = term.doc_count;
+        sd.corpus_term_count = term.corpus_term_count;
+        sd.corpus_term_prob = term.corpus_term_prob;
+        return;
+    }
+    sd.doc_count = sd.idx.doc_freq(t_id);
+    sd.corpus_term_count = sd.idx.total_num_occurences(t_id);
+    sd.corpus_term_prob = sd.idx.collection_probability(t_id);
+}
+
+/**
+ * The state of a single query term during document-at-a-time scoring.
+ */
+struct query_term
+{
+    postings_cursor cursor;
+    term_id t_id;
+    double weight;
+    uint64_t doc_count;
+    uint64_t corpus_term_count;
+    double corpus_term_prob;
+    double upper_bound;
+};
+}
+
 std::vector<std::pair<doc_id, double>>
 ranker::score(inverted_index& idx, corpus::document& query,
               uint64_t num_results /* = 10 */,
@@ -26,60 +360,986 @@ ranker::score(inverted_index& idx, corpus::document& query,
                   idx.num_docs(), idx.total_corpus_terms(),
                   query};
 
-    // zeros out elements and (if necessary) resizes the vector; this eliminates
-    // constructing a new vector each query for the same index
-    results_.assign(sd.num_docs, std::numeric_limits<double>::lowest());
+    if (num_results == 0)
+        return {};
+
+    if (auto results = score_document_at_a_time(sd, num_results, filter,
+                                                nullptr, nullptr))
+        return std::move(*results);
+    return score_term_at_a_time(sd, num_results, filter, nullptr, nullptr);
+}
+
+std::vector<std::pair<doc_id, double>>
+ranker::score(inverted_index& idx, const prepared_query& query,
+              uint64_t num_results /* = 10 */,
+              const std::function<bool(doc_id d_id)>& filter /* return true */)
+{
+    if (&query.index() != &idx)
+        throw ranker_exception{"query was prepared for another index"};
+
+    score_data sd{idx,             query.avg_doc_length(),
+                  query.num_docs(), query.total_terms(),
+                  query.query()};
+    sd.prepared = &query;
+
+    if (num_results == 0)
+        return {};
+
+    if (auto results = score_document_at_a_time(sd, num_results, filter,
+                                                nullptr, nullptr))
+        return std::move(*results);
+    return score_term_at_a_time(sd, num_results, filter, nullptr, nullptr);
+}
+
+score_seed score_seed::from_results(
+    const std::vector<std::pair<doc_id, double>>& results)
+{
+    score_seed seed;
+    seed.candidates.reserve(results.size());
+    for (const auto& result : results)
+        seed.candidates.push_back(result.first);
+    return seed;
+}
+
+std::vector<std::pair<doc_id, double>>
+ranker::score(inverted_index& idx, corpus::document& query,
+              const score_seed& seed, uint64_t num_results /* = 10 */,
+              const std::function<bool(doc_id d_id)>& filter /* return true */)
+{
+    if (query.counts().empty())
+        idx.tokenize(query);
+
+    score_data sd{idx,            idx.avg_doc_length(),
+                  idx.num_docs(), idx.total_corpus_terms(),
+                  query};
+
+    if (num_results == 0)
+        return {};
+
+    const doc_id first{0};
+    const doc_id last{std::numeric_limits<uint64_t>::max()};
+    if (auto results = score_document_at_a_time(
+            sd, num_results, filter, nullptr, nullptr, first, last, nullptr,
+            &seed))
+        return std::move(*results);
+    return score_term_at_a_time(sd, num_results, filter, nullptr, nullptr,
+                                first, last, nullptr, &seed);
+}
+
+std::vector<std::pair<doc_id, double>>
+ranker::score(inverted_index& idx, const prepared_query& query,
+              const score_seed& seed, uint64_t num_results /* = 10 */,
+              const std::function<bool(doc_id d_id)>& filter /* return true */)
+{
+    if (&query.index() != &idx)
+        throw ranker_exception{"query was prepared for another index"};
+
+    score_data sd{idx,             query.avg_doc_length(),
+                  query.num_docs(), query.total_terms(),
+                  query.query()};
+    sd.prepared = &query;
+
+    if (num_results == 0)
+        return {};
+
+    const doc_id first{0};
+    const doc_id last{std::numeric_limits<uint64_t>::max()};
+    if (auto results = score_document_at_a_time(
+            sd, num_results, filter, nullptr, nullptr, first, last, nullptr,
+            &seed))
+        return std::move(*results);
+    return score_term_at_a_time(sd, num_results, filter, nullptr, nullptr,
+                                first, last, nullptr, &seed);
+}
+
+std::vector<std::pair<doc_id, double>>
+ranker::score(inverted_index& idx, corpus::document& query,
+              const collection_stats& stats, uint64_t num_results /* = 10 */,
+              const std::function<bool(doc_id d_id)>& filter /* return true */)
+{
+    if (query.counts().empty())
+        idx.tokenize(query);
+
+    score_data sd{idx, stats.avg_dl, stats.num_docs, stats.total_terms, query};
+
+    if (num_results == 0)
+        return {};
+
+    if (auto results = score_document_at_a_time(sd, num_results, filter,
+                                                &stats, nullptr))
+        return std::move(*results);
+    return score_term_at_a_time(sd, num_results, filter, &stats, nullptr);
+}
+
+budgeted_results ranker::score(inverted_index& idx, corpus::document& query,
+                               query_budget& budget,
+                               uint64_t num_results /* = 10 */,
+                               const std::function<bool(doc_id d_id)>& filter
+                               /* return true */)
+{
+    if (query.counts().empty())
+        idx.tokenize(query);
+
+    score_data sd{idx,            idx.avg_doc_length(),
+                  idx.num_docs(), idx.total_corpus_terms(),
+                  query};
+
+    budgeted_results results{{}, false};
+    if (num_results == 0)
+        return results;
+
+    const doc_id first{0};
+    const doc_id last{std::numeric_limits<uint64_t>::max()};
+    if (auto ranking = score_document_at_a_time(
+            sd, num_results, filter, nullptr, nullptr, first, last, &budget))
+        results.results = std::move(*ranking);
+    else
+        results.results = score_term_at_a_time(
+            sd, num_results, filter, nullptr, nullptr, first, last, &budget);
+    results.terminated_early = budget.exhausted();
+    return results;
+}
+
+std::future<budgeted_results>
+    ranker::score_async(inverted_index& idx, corpus::document query,
+                        parallel::thread_pool& pool, query_budget& budget,
+                        uint64_t num_results /* = 10 */,
+                        std::function<bool(doc_id d_id)> filter
+                        /* return true */)
+{
+    auto shared_query = std::make_shared<corpus::document>(std::move(query));
+    return pool.submit_task([=, &idx, &budget]()
+                            {
+        return score(idx, *shared_query, budget, num_results, filter);
+    });
+}
+
+std::vector<std::pair<doc_id, double>>
+    ranker::score_conjunctive(inverted_index& idx, corpus::document& query,
+                              uint64_t num_results /* = 10 */,
+                              const std::function<bool(doc_id d_id)>& filter
+                              /* return true */)
+{
+    if (query.counts().empty())
+        idx.tokenize(query);
+
+    score_data sd{idx,            idx.avg_doc_length(),
+                  idx.num_docs(), idx.total_corpus_terms(),
+                  query};
+
+    if (num_results == 0 || query.counts().empty())
+        return {};
 
+    // query terms are kept in query order so that scores are accumulated
+    // in the same order as the other strategies
+    std::vector<query_term> terms;
+    terms.reserve(query.counts().size());
+    auto t_ids = query_term_ids(sd);
+    auto next_id = t_ids.begin();
     for (auto& tpair : query.counts())
     {
-        term_id t_id{idx.get_term_id(tpair.first)};
-        auto pdata = idx.search_primary(t_id);
-        sd.doc_count = pdata->counts().size();
-        sd.t_id = t_id;
-        sd.query_term_weight = tpair.second;
-        sd.corpus_term_count = idx.total_num_occurences(sd.t_id);
-        for (auto& dpair : pdata->counts())
+        auto t_id = *next_id++;
+        auto cursor = idx.cursor(t_id);
+        if (cursor.at_end())
+            return {};
+        set_term_stats(sd, terms.size(), t_id, tpair.second);
+        terms.push_back({std::move(cursor), t_id, tpair.second, sd.doc_count,
+                         sd.corpus_term_count, sd.corpus_term_prob, 0.0});
+    }
+
+    // the intersection is led by the rarest term
+    std::vector<query_term*> order;
+    order.reserve(terms.size());
+    for (auto& term : terms)
+        order.push_back(&term);
+    std::sort(order.begin(), order.end(),
+              [](const query_term* a, const query_term* b)
+              {
+                  return a->doc_count < b->doc_count;
+              });
+
+    const auto& deleted = idx.deleted();
+    top_k_heap heap{num_results};
+    auto& lead = order[0]->cursor;
+    while (!lead.at_end())
+    {
+        auto candidate = lead.doc();
+        auto matched = true;
+        for (uint64_t i = 1; i < order.size(); ++i)
         {
-            sd.d_id = dpair.first;
-            sd.doc_term_count = dpair.second;
-            sd.doc_size = idx.doc_size(dpair.first);
-            sd.doc_unique_terms = idx.unique_terms(dpair.first);
+            auto& cursor = order[i]->cursor;
+            cursor.skip_to(candidate);
+            if (cursor.at_end())
+                return heap.extract();
+            if (cursor.doc() != candidate)
+            {
+                // no document before this one can be in every list
+                lead.skip_to(cursor.doc());
+                matched = false;
+                break;
+            }
+        }
+        if (!matched)
+            continue;
 
+        if (included(deleted, filter, candidate))
+        {
+            sd.d_id = candidate;
+            auto info = idx.doc_info(candidate);
+            sd.doc_size = info.length;
+            sd.doc_unique_terms = info.unique_terms;
+            auto score = initial_score(sd);
+            for (const auto& term : terms)
+            {
+                sd.t_id = term.t_id;
+                sd.query_term_weight = term.weight;
+                sd.doc_count = term.doc_count;
+                sd.corpus_term_count = term.corpus_term_count;
+                sd.corpus_term_prob = term.corpus_term_prob;
+                sd.doc_term_count = term.cursor.count();
+                score += score_one(sd);
+            }
+            heap.push(candidate, score);
+        }
+        lead.next();
+    }
+    return heap.extract();
+}
+
+/**
+ * The postings cursors of the terms that more than one query of a batch
+ * contains. Each cursor is opened on the index (which scans the list for
+ * its skip table, if it is gamma coded) by the first query that needs
+ * it; the others wait for it and then copy it.
+ */
+class ranker::batch_postings
+{
+  public:
+    /**
+     * @param idx The index the batch is scored on
+     * @param queries The (tokenized) queries of the batch
+     */
+    batch_postings(inverted_index& idx,
+                   const std::vector<corpus::document>& queries)
+        : idx_(idx)
+    {
+        std::unordered_map<std::string, uint64_t> num_queries;
+        for (const auto& query : queries)
+        {
+            for (const auto& count : query.counts())
+                ++num_queries[count.first];
+        }
+
+        std::vector<std::string> shared;
+        for (const auto& term : num_queries)
+        {
+            if (term.second > 1)
+                shared.push_back(term.first);
+        }
+        for (const auto& t_id : idx_.get_term_ids(shared))
+            postings_[t_id];
+    }
+
+    /**
+     * Shares every term of a single query, whose parts are scored
+     * separately.
+     * @param idx The index the query is scored on
+     * @param query The (tokenized) query
+     */
+    batch_postings(inverted_index& idx, const corpus::document& query)
+        : idx_(idx)
+    {
+        for (const auto& t_id : query_term_ids(idx_, query))
+            postings_[t_id];
+    }
+
+    /**
+     * @param t_id The term to read the postings of
+     * @return a cursor at the start of the term's postings
+     */
+    postings_cursor get(term_id t_id)
+    {
+        auto it = postings_.find(t_id);
+        if (it == postings_.end())
+            return idx_.cursor(t_id);
+
+        // only the map's values change, so finding the entry needs no lock
+        auto& e = it->second;
+        std::call_once(e.once, [&]()
+                       {
+                           e.postings = idx_.cursor(t_id);
+                       });
+        return e.postings;
+    }
+
+  private:
+    /**
+     * A shared postings list.
+     */
+    struct entry
+    {
+        /// makes sure the cursor is opened only once
+        std::once_flag once;
+        /// the cursor, once it has been opened
+        postings_cursor postings;
+    };
+
+    /// The index the batch is scored on
+    inverted_index& idx_;
+
+    /// The shared lists, by term
+    std::unordered_map<term_id, entry> postings_;
+};
+
+std::vector<std::vector<std::pair<doc_id, double>>>
+    ranker::score_batch(inverted_index& idx,
+                        std::vector<corpus::document>& queries,
+                        uint64_t num_results /* = 10 */,
+                        uint64_t num_threads /* = hardware_concurrency */)
+{
+    // analyzers are not meant to be shared between threads
+    for (auto& query : queries)
+    {
+        if (query.counts().empty())
+            idx.tokenize(query);
+    }
+
+    std::vector<std::vector<std::pair<doc_id, double>>> results(
+        queries.size());
+    if (num_results == 0 || queries.empty())
+        return results;
+
+    batch_postings shared{idx, queries};
+
+    // queries vary a lot in cost, so each thread takes the next query
+    // as soon as it is done with its last one
+    std::atomic<uint64_t> next{0};
+    auto worker = [&]()
+    {
+        for (auto i = next++; i < queries.size(); i = next++)
+        {
+            score_data sd{idx,            idx.avg_doc_length(),
+                          idx.num_docs(), idx.total_corpus_terms(),
+                          queries[i]};
+            if (auto ranking = score_document_at_a_time(
+                    sd, num_results, nullptr, nullptr, &shared))
+                results[i] = std::move(*ranking);
+            else
+                results[i] = score_term_at_a_time(sd, num_results, nullptr,
+                                                  nullptr, &shared);
+        }
+    };
+
+    num_threads = std::max<uint64_t>(
+        1, std::min<uint64_t>(num_threads, queries.size()));
+    parallel::thread_pool pool{num_threads};
+    std::vector<std::future<void>> futures;
+    for (uint64_t i = 0; i < num_threads; ++i)
+        futures.push_back(pool.submit_task(worker));
+    for (auto& fut : futures)
+        fut.get();
+
+    return results;
+}
+
+std::vector<std::pair<doc_id, double>>
+    ranker::score_parallel(inverted_index& idx, corpus::document& query,
+                           parallel::thread_pool& pool,
+                           uint64_t num_results /* = 10 */,
+                           const std::function<bool(doc_id d_id)>& filter
+                           /* return true */)
+{
+    if (query.counts().empty())
+        idx.tokenize(query);
+
+    auto num_docs = idx.num_docs();
+    if (num_results == 0 || num_docs == 0)
+        return {};
+
+    // the statistics are computed lazily, so before the threads start
+    auto avg_dl = idx.avg_doc_length();
+    auto total_terms = idx.total_corpus_terms();
+
+    // each range copies the query terms' cursors rather than opening them
+    batch_postings shared{idx, query};
+
+    // a few ranges per thread, so that threads that draw ranges with
+    // sparse postings take more of them
+    auto num_threads = pool.thread_ids().size();
+    auto grain = std::max<uint64_t>(1, num_docs / (4 * num_threads));
+    std::vector<std::vector<doc_pair>> ranges((num_docs + grain - 1) / grain);
+    parallel::parallel_chunks(
+        pool, num_docs, grain, [&](uint64_t, uint64_t first, uint64_t last)
+        {
+            score_data sd{idx, avg_dl, num_docs, total_terms, query};
+            auto& results = ranges[first / grain];
+            if (auto ranking = score_document_at_a_time(
+                    sd, num_results, filter, nullptr, &shared,
+                    doc_id{first}, doc_id{last}))
+                results = std::move(*ranking);
+            else
+                results = score_term_at_a_time(sd, num_results, filter,
+                                               nullptr, &shared,
+                                               doc_id{first}, doc_id{last});
+        });
+
+    // each range holds its own best documents, padded with its first
+    // unmatched ones; ordering those by doc_id pads as score() does
+    std::vector<doc_pair> merged;
+    for (auto& results : ranges)
+        merged.insert(merged.end(), results.begin(), results.end());
+    auto num_merged = std::min<uint64_t>(num_results, merged.size());
+    std::partial_sort(merged.begin(), merged.begin() + num_merged,
+                      merged.end(), [](const doc_pair& a, const doc_pair& b)
+                      {
+                          if (a.second != b.second)
+                              return a.second > b.second;
+                          return a.first < b.first;
+                      });
+    merged.resize(num_merged);
+    return merged;
+}
+
+std::vector<std::pair<doc_id, double>>
+ranker::score_term_at_a_time(score_data& sd, uint64_t num_results,
+                             const std::function<bool(doc_id)>& filter,
+                             const collection_stats* stats,
+                             batch_postings* shared, doc_id first,
+                             doc_id last, query_budget* budget,
+                             const score_seed* seed)
+{
+    auto& idx = sd.idx;
+
+    // the postings are all read up front to choose the accumulators
+    struct query_postings
+    {
+        const std::string* term;
+        term_id t_id;
+        double weight;
+        postings_cursor postings;
+    };
+    std::vector<query_postings> postings;
+    postings.reserve(sd.query.counts().size());
+    uint64_t num_postings = 0;
+    auto t_ids = query_term_ids(sd);
+    auto next_id = t_ids.begin();
+    for (auto& tpair : sd.query.counts())
+    {
+        auto t_id = *next_id++;
+        postings.push_back({&tpair.first, t_id, tpair.second,
+                            shared ? shared->get(t_id) : idx.cursor(t_id)});
+        num_postings += postings.back().postings.size();
+        postings.back().postings.restrict_to(first, last);
+    }
+
+    // a range of doc_ids is assumed to hold its share of the postings
+    auto num_docs = idx.num_docs();
+    if (last < num_docs && num_docs > 0)
+        num_postings = static_cast<uint64_t>(
+            static_cast<double>(num_postings) * (last - first) / num_docs);
+
+    const auto& deleted = idx.deleted();
+    static thread_local score_accumulators results;
+    results.reset(idx.num_docs(), num_postings);
+
+    // the postings of each term are gathered into blocks, which are scored
+    // with one call each
+    posting_block block;
+    double scores[posting_block::capacity];
+    auto score_block = [&]()
+    {
+        score_postings(sd, block, scores);
+        for (uint64_t i = 0; i < block.size; ++i)
+        {
             // if this is the first time we've seen this document, compute
             // its initial score
-            if (results_[dpair.first] == std::numeric_limits<double>::lowest())
-                results_[dpair.first] = initial_score(sd);
+            results.at(block.d_ids[i], [&]()
+                       {
+                           sd.d_id = block.d_ids[i];
+                           sd.doc_term_count = block.doc_term_counts[i];
+                           sd.doc_size = block.doc_sizes[i];
+                           sd.doc_unique_terms = block.doc_unique_terms[i];
+                           return initial_score(sd);
+                       }) += scores[i];
+        }
+        block.size = 0;
+    };
 
-            results_[dpair.first] += score_one(sd);
+    // the postings walked are charged to the budget a block at a time
+    uint64_t walked = 0;
+    bool stopped = false;
+    auto charge = [&]()
+    {
+        if (budget && !budget->charge(walked))
+            stopped = true;
+        walked = 0;
+    };
+
+    for (uint64_t i = 0; i < postings.size(); ++i)
+    {
+        if (stopped)
+            break;
+
+        auto& term = postings[i];
+        auto& cursor = term.postings;
+        set_term_stats(sd, i, term.t_id, term.weight);
+        apply_stats(stats, *term.term, sd);
+        for (; !cursor.at_end() && !stopped; cursor.next())
+        {
+            if (++walked == posting_block::capacity)
+                charge();
+
+            // filtered documents are never scored
+            auto d_id = cursor.doc();
+            if (!included(deleted, filter, d_id))
+                continue;
+
+            auto info = idx.doc_info(d_id);
+            auto i = block.size++;
+            block.d_ids[i] = d_id;
+            block.doc_term_counts[i] = cursor.count();
+            block.doc_sizes[i] = info.length;
+            block.doc_unique_terms[i] = info.unique_terms;
+            if (block.size == posting_block::capacity)
+                score_block();
         }
+        score_block();
+        charge();
+    }
+
+    if (metrics::enabled())
+    {
+        static auto& sizes = metrics::get_histogram("ranker_accumulators");
+        sizes.record(results.size());
     }
 
-    using doc_pair = std::pair<doc_id, double>;
-    auto doc_pair_comp = [](const doc_pair& a, const doc_pair& b)
-    { return a.second > b.second; };
+    // every posting has been scored, so only the seed's threshold is of
+    // any use
+    auto floor = seed ? seed->threshold : std::numeric_limits<double>::lowest();
+    top_k_heap heap{num_results};
+    results.for_each([&](doc_id d_id, double score)
+                     {
+                         if (score > floor)
+                             heap.push(d_id, score);
+                     });
+
+    auto sorted = heap.extract();
+    if (!stats && !stopped && sorted.size() < num_results
+        && floor == std::numeric_limits<double>::lowest())
+        pad_results(sorted, num_results, deleted, filter, [&](doc_id d_id)
+                    {
+                        return results.contains(d_id);
+                    },
+                    first, last);
+    return sorted;
+}
+
+util::optional<std::vector<std::pair<doc_id, double>>>
+ranker::score_document_at_a_time(score_data& sd, uint64_t num_results,
+                                 const std::function<bool(doc_id)>& filter,
+                                 const collection_stats* stats,
+                                 batch_postings* shared, doc_id first,
+                                 doc_id last, query_budget* budget,
+                                 const score_seed* seed)
+{
+    auto& idx = sd.idx;
+
+    const auto& deleted = idx.deleted();
 
-    std::priority_queue<doc_pair,
-                        std::vector<doc_pair>,
-                        decltype(doc_pair_comp)> pq{doc_pair_comp};
-    for (uint64_t id = 0; id < results_.size(); ++id)
+    // query terms are kept in query order so that scores are accumulated
+    // in the same order as term-at-a-time scoring
+    std::vector<query_term> terms;
+    terms.reserve(sd.query.counts().size());
+    auto t_ids = query_term_ids(sd);
+    auto next_id = t_ids.begin();
+    uint64_t position = 0;
+    for (auto& tpair : sd.query.counts())
     {
-        if (!filter(doc_id{id}))
+        auto i = position++;
+        auto t_id = *next_id++;
+        auto cursor = shared ? shared->get(t_id) : idx.cursor(t_id);
+        cursor.restrict_to(first, last);
+        if (cursor.at_end())
             continue;
 
-        pq.emplace(doc_id{id}, results_[id]);
-        if (pq.size() > num_results)
-            pq.pop();
+        set_term_stats(sd, i, t_id, tpair.second);
+        apply_stats(stats, tpair.first, sd);
+        sd.doc_term_count = cursor.max_count();
+        auto bound = score_upper_bound(sd);
+        if (!std::isfinite(bound))
+            return util::nullopt;
+
+        // a term can never lower the bound on a document's score
+        bound = std::max(bound, 0.0);
+        terms.push_back({std::move(cursor), t_id, tpair.second, sd.doc_count,
+                         sd.corpus_term_count, sd.corpus_term_prob, bound});
     }
 
-    std::vector<doc_pair> sorted;
-    while (!pq.empty())
+    auto initial_bound = initial_score_upper_bound(sd);
+    if (!std::isfinite(initial_bound))
+        return util::nullopt;
+
+    auto set_term = [&](const query_term& term)
+    {
+        sd.t_id = term.t_id;
+        sd.query_term_weight = term.weight;
+        sd.doc_count = term.doc_count;
+        sd.corpus_term_count = term.corpus_term_count;
+        sd.corpus_term_prob = term.corpus_term_prob;
+    };
+
+    auto block_bound = [&](const query_term& term)
+    {
+        set_term(term);
+        sd.doc_term_count = term.cursor.block_max_count();
+        return std::max(score_upper_bound(sd), 0.0);
+    };
+
+    // the query terms, ordered by the doc_id of their cursors
+    std::vector<query_term*> order;
+    order.reserve(terms.size());
+    for (auto& term : terms)
+        order.push_back(&term);
+
+    auto by_doc = [](const query_term* a, const query_term* b)
+    {
+        if (a->cursor.at_end())
+            return false;
+        if (b->cursor.at_end())
+            return true;
+        return a->cursor.doc() < b->cursor.doc();
+    };
+
+    // restores the ordering after the first num_moved cursors have been
+    // advanced; the rest are still sorted, so each moved cursor only has
+    // to be shifted past the ones it has overtaken
+    auto reorder = [&](uint64_t num_moved)
+    {
+        for (auto i = num_moved; i-- > 0;)
+        {
+            for (auto j = i; j + 1 < order.size()
+                             && by_doc(order[j + 1], order[j]);
+                 ++j)
+                std::swap(order[j], order[j + 1]);
+        }
+    };
+
+    std::sort(order.begin(), order.end(), by_doc);
+
+    top_k_heap heap{num_results};
+    std::vector<doc_id> matched;
+
+    // the seed's candidates are scored before any postings are walked,
+    // looking up their counts of every term at once, so that the
+    // threshold starts out at their scores rather than at nothing
+    auto floor = seed ? seed->threshold : std::numeric_limits<double>::lowest();
+    std::vector<doc_id> seeded;
+    if (seed)
     {
-        sorted.emplace_back(pq.top());
-        pq.pop();
+        for (const auto& d_id : seed->candidates)
+        {
+            if (d_id >= first && d_id < last
+                && included(deleted, filter, d_id))
+                seeded.push_back(d_id);
+        }
+        std::sort(seeded.begin(), seeded.end());
+        seeded.erase(std::unique(seeded.begin(), seeded.end()), seeded.end());
+
+        std::vector<std::pair<term_id, doc_id>> pairs;
+        pairs.reserve(seeded.size() * terms.size());
+        for (const auto& d_id : seeded)
+        {
+            for (const auto& term : terms)
+                pairs.emplace_back(term.t_id, d_id);
+        }
+        auto counts = idx.term_freqs(pairs);
+
+        auto count = counts.begin();
+        for (const auto& d_id : seeded)
+        {
+            sd.d_id = d_id;
+            auto info = idx.doc_info(d_id);
+            sd.doc_size = info.length;
+            sd.doc_unique_terms = info.unique_terms;
+            auto score = initial_score(sd);
+
+            // the terms in query order, as when the document is reached
+            bool matches = false;
+            for (const auto& term : terms)
+            {
+                auto term_count = *count++;
+                if (term_count == 0)
+                    continue;
+                set_term(term);
+                sd.doc_term_count = term_count;
+                score += score_one(sd);
+                matches = true;
+            }
+            if (matches && score > std::max(heap.threshold(), floor))
+                heap.push(d_id, score);
+        }
     }
-    std::reverse(sorted.begin(), sorted.end());
 
-    return sorted;
+    // the cursors moved are charged to the budget a block at a time
+    uint64_t walked = 0;
+    bool stopped = false;
+    while (true)
+    {
+        // find the first term at which the sum of the upper bounds could
+        // beat the threshold; no document before its doc_id can
+        auto threshold = std::max(heap.threshold(), floor);
+        auto bound = initial_bound;
+        uint64_t pivot = 0;
+        for (; pivot < order.size() && !order[pivot]->cursor.at_end();
+             ++pivot)
+        {
+            bound += order[pivot]->upper_bound;
+            if (bound > threshold)
+                break;
+        }
+        if (pivot == order.size() || order[pivot]->cursor.at_end())
+            break;
+
+        auto pivot_doc = order[pivot]->cursor.doc();
+        while (pivot + 1 < order.size()
+               && !order[pivot + 1]->cursor.at_end()
+               && order[pivot + 1]->cursor.doc() == pivot_doc)
+            ++pivot;
+
+        walked += pivot + 1;
+        if (walked >= posting_block::capacity)
+        {
+            stopped = budget && !budget->charge(walked);
+            walked = 0;
+            if (stopped)
+                break;
+        }
+
+        if (order[0]->cursor.doc() != pivot_doc)
+        {
+            for (uint64_t i = 0; i <= pivot; ++i)
+                order[i]->cursor.skip_to(pivot_doc);
+            reorder(pivot + 1);
+            continue;
+        }
+
+        // every term up to the pivot is positioned on pivot_doc; check the
+        // tighter bound given by the blocks they are in before scoring it
+        auto block_max = initial_bound;
+        for (uint64_t i = 0; i <= pivot; ++i)
+            block_max += block_bound(*order[i]);
+
+        if (block_max <= threshold)
+        {
+            // no document can qualify until one of these blocks ends or
+            // the next term's postings begin
+            auto next_doc = order[0]->cursor.block_last_doc();
+            for (uint64_t i = 1; i <= pivot; ++i)
+                next_doc
+                    = std::min(next_doc, order[i]->cursor.block_last_doc());
+            next_doc = doc_id{next_doc + 1};
+            if (pivot + 1 < order.size() && !order[pivot + 1]->cursor.at_end())
+                next_doc = std::min(next_doc, order[pivot + 1]->cursor.doc());
+
+            for (uint64_t i = 0; i <= pivot; ++i)
+                order[i]->cursor.skip_to(next_doc);
+            reorder(pivot + 1);
+            continue;
+        }
+
+        if (std::binary_search(seeded.begin(), seeded.end(), pivot_doc))
+        {
+            // it was scored with the seed
+            matched.push_back(pivot_doc);
+        }
+        else if (included(deleted, filter, pivot_doc))
+        {
+            sd.d_id = pivot_doc;
+            auto info = idx.doc_info(pivot_doc);
+            sd.doc_size = info.length;
+            sd.doc_unique_terms = info.unique_terms;
+            auto score = initial_score(sd);
+
+            // the terms on pivot_doc, in query order
+            std::sort(order.begin(), order.begin() + pivot + 1);
+            for (uint64_t i = 0; i <= pivot; ++i)
+            {
+                set_term(*order[i]);
+                sd.doc_term_count = order[i]->cursor.count();
+                score += score_one(sd);
+            }
+
+            if (score > threshold)
+                heap.push(pivot_doc, score);
+            matched.push_back(pivot_doc);
+        }
+
+        for (uint64_t i = 0; i <= pivot; ++i)
+            order[i]->cursor.next();
+        reorder(pivot + 1);
+    }
+
+    auto results = heap.extract();
+
+    // the threshold never rose above its initial value, so every matching
+    // document was scored
+    if (!stats && !stopped && results.size() < num_results
+        && floor == std::numeric_limits<double>::lowest())
+        pad_results(results, num_results, deleted, filter,
+                    [&](doc_id d_id)
+                    {
+                        return std::binary_search(matched.begin(),
+                                                  matched.end(), d_id);
+                    },
+                    first, last);
+
+    return results;
+}
+
+namespace
+{
+/**
+ * Scores a query with each of several rankers (see score_sweep()).
+ * @param rankers The rankers to score with
+ * @param sd The score_data of the query
+ * @param num_results The number of results to return for each ranker
+ * @param filter The filtering function for doc_ids
+ * @return the results of each ranker, in the order of rankers
+ */
+std::vector<std::vector<doc_pair>>
+    sweep(const std::vector<ranker*>& rankers, score_data& sd,
+          uint64_t num_results, const std::function<bool(doc_id)>& filter)
+{
+    auto& idx = sd.idx;
+    auto num_rankers = rankers.size();
+    std::vector<std::vector<doc_pair>> results(num_rankers);
+    if (num_results == 0 || rankers.empty())
+        return results;
+
+    const auto& deleted = idx.deleted();
+
+    // each matched document has a row of accumulators, one per ranker
+    const auto no_row = std::numeric_limits<uint64_t>::max();
+    std::vector<uint64_t> row_of(idx.num_docs(), no_row);
+    std::vector<doc_id> row_docs;
+    std::vector<double> accumulators;
+
+    // the scores of a block are laid out ranker by ranker
+    const auto capacity = posting_block::capacity;
+    posting_block block;
+    std::vector<double> scores(num_rankers * capacity);
+    auto score_block = [&]()
+    {
+        for (uint64_t r = 0; r < num_rankers; ++r)
+            rankers[r]->score_postings(sd, block, &scores[r * capacity]);
+
+        for (uint64_t i = 0; i < block.size; ++i)
+        {
+            auto& row = row_of[block.d_ids[i]];
+            if (row == no_row)
+            {
+                row = row_docs.size();
+                row_docs.push_back(block.d_ids[i]);
+                sd.d_id = block.d_ids[i];
+                sd.doc_term_count = block.doc_term_counts[i];
+                sd.doc_size = block.doc_sizes[i];
+                sd.doc_unique_terms = block.doc_unique_terms[i];
+                for (const auto& r : rankers)
+                    accumulators.push_back(r->initial_score(sd));
+            }
+
+            auto acc = &accumulators[row * num_rankers];
+            for (uint64_t r = 0; r < num_rankers; ++r)
+                acc[r] += scores[r * capacity + i];
+        }
+        block.size = 0;
+    };
+
+    auto t_ids = query_term_ids(sd);
+    auto next_id = t_ids.begin();
+    uint64_t position = 0;
+    for (auto& tpair : sd.query.counts())
+    {
+        auto t_id = *next_id++;
+        auto cursor = idx.cursor(t_id);
+        set_term_stats(sd, position++, t_id, tpair.second);
+        for (; !cursor.at_end(); cursor.next())
+        {
+            auto d_id = cursor.doc();
+            if (!included(deleted, filter, d_id))
+                continue;
+
+            auto info = idx.doc_info(d_id);
+            auto i = block.size++;
+            block.d_ids[i] = d_id;
+            block.doc_term_counts[i] = cursor.count();
+            block.doc_sizes[i] = info.length;
+            block.doc_unique_terms[i] = info.unique_terms;
+            if (block.size == capacity)
+                score_block();
+        }
+        score_block();
+    }
+
+    for (uint64_t r = 0; r < num_rankers; ++r)
+    {
+        top_k_heap heap{num_results};
+        for (uint64_t row = 0; row < row_docs.size(); ++row)
+            heap.push(row_docs[row], accumulators[row * num_rankers + r]);
+        results[r] = heap.extract();
+        if (results[r].size() < num_results)
+            pad_results(results[r], num_results, deleted, filter,
+                        [&](doc_id d_id)
+                        {
+                            return row_of[d_id] != no_row;
+                        });
+    }
+    return results;
+}
+}
+
+std::vector<std::vector<std::pair<doc_id, double>>>
+    score_sweep(const std::vector<ranker*>& rankers, inverted_index& idx,
+                corpus::document& query, uint64_t num_results /* = 10 */,
+                const std::function<bool(doc_id d_id)>& filter
+                /* return true */)
+{
+    if (query.counts().empty())
+        idx.tokenize(query);
+
+    score_data sd{idx,            idx.avg_doc_length(),
+                  idx.num_docs(), idx.total_corpus_terms(),
+                  query};
+    return sweep(rankers, sd, num_results, filter);
+}
+
+std::vector<std::vector<std::pair<doc_id, double>>>
+    score_sweep(const std::vector<ranker*>& rankers, inverted_index& idx,
+                const prepared_query& query, uint64_t num_results /* = 10 */,
+                const std::function<bool(doc_id d_id)>& filter
+                /* return true */)
+{
+    if (&query.index() != &idx)
+        throw ranker_exception{"query was prepared for another index"};
+
+    score_data sd{idx,             query.avg_doc_length(),
+                  query.num_docs(), query.total_terms(),
+                  query.query()};
+    sd.prepared = &query;
+    return sweep(rankers, sd, num_results, filter);
+}
+
+void ranker::score_postings(score_data& sd, const posting_block& block,
+                            double* scores)
+{
+    for (uint64_t i = 0; i < block.size; ++i)
+    {
+        sd.d_id = block.d_ids[i];
+        sd.doc_term_count = block.doc_term_counts[i];
+        sd.doc_size = block.doc_sizes[i];
+        sd.doc_unique_terms = block.doc_unique_terms[i];
+        scores[i] = score_one(sd);
+    }
 }
 
 double ranker::initial_score(const score_data&) const
@@ -87,5 +1347,20 @@ double ranker::initial_score(const score_data&) const
     return 0.0;
 }
 
+double ranker::score_upper_bound(const score_data&) const
+{
+    return std::numeric_limits<double>::infinity();
+}
+
+double ranker::initial_score_upper_bound(const score_data&) const
+{
+    return 0.0;
+}
+
+std::string ranker::parameters() const
+{
+    return typeid(*this).name();
+}
+
 }
 }
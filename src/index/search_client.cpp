@@ -0,0 +1,93 @@
+/**
+ * @file search_client.cpp
+ */
+
+#include <unistd.h>
+
+#include "index/search_client.h"
+
+namespace meta
+{
+namespace index
+{
+
+search_client::search_client(const std::string& socket_path)
+    : fd_{protocol::connect_unix(socket_path)}, next_id_{1}
+{
+    // nothing
+}
+
+search_client::~search_client()
+{
+    ::close(fd_);
+}
+
+uint64_t search_client::send(protocol::request req)
+{
+    req.id = next_id_++;
+    protocol::write_frame(fd_, protocol::encode(req));
+    return req.id;
+}
+
+protocol::response search_client::read_response()
+{
+    std::string payload;
+    if (!protocol::read_frame(fd_, payload))
+        throw protocol_exception{"server closed the connection"};
+    auto resp = protocol::decode_response(payload);
+
+    // the server answers a request it cannot read with id 0, and then
+    // closes the connection
+    if (resp.id == 0)
+        throw protocol_exception{"server rejected a request: " + resp.error};
+    return resp;
+}
+
+protocol::response search_client::receive()
+{
+    if (!received_.empty())
+    {
+        auto it = received_.begin();
+        auto resp = std::move(it->second);
+        received_.erase(it);
+        return resp;
+    }
+    return read_response();
+}
+
+protocol::response search_client::receive(uint64_t id)
+{
+    auto it = received_.find(id);
+    if (it != received_.end())
+    {
+        auto resp = std::move(it->second);
+        received_.erase(it);
+        return resp;
+    }
+
+    while (true)
+    {
+        auto resp = read_response();
+        if (resp.id == id)
+            return resp;
+        received_[resp.id] = std::move(resp);
+    }
+}
+
+protocol::response search_client::search(
+    const std::string& index, const std::vector<std::string>& queries,
+    uint32_t num_results, bool with_paths)
+{
+    protocol::request req;
+    req.index = index;
+    req.num_results = num_results;
+    req.with_paths = with_paths;
+    req.queries = queries;
+
+    auto resp = receive(send(std::move(req)));
+    if (!resp.error.empty())
+        throw protocol_exception{resp.error};
+    return resp;
+}
+}
+}
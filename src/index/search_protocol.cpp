@@ -0,0 +1,341 @@
+/**
+ * @file search_protocol.cpp
+ */
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "index/search_protocol.h"
+
+namespace meta
+{
+namespace index
+{
+namespace protocol
+{
+
+namespace
+{
+/**
+ * Appends the fields of a message to its payload.
+ */
+class encoder
+{
+  public:
+    void put(uint64_t value, uint64_t bytes)
+    {
+        for (uint64_t i = 0; i < bytes; ++i)
+            out_.push_back(static_cast<char>((value >> (8 * i)) & 0xff));
+    }
+
+    void put_u8(uint8_t value)
+    {
+        put(value, 1);
+    }
+
+    void put_u32(uint64_t value)
+    {
+        if (value > 0xffffffffu)
+            throw protocol_exception{"field too large for the protocol"};
+        put(value, 4);
+    }
+
+    void put_u64(uint64_t value)
+    {
+        put(value, 8);
+    }
+
+    void put_double(double value)
+    {
+        uint64_t bits;
+        std::memcpy(&bits, &value, sizeof(bits));
+        put_u64(bits);
+    }
+
+    void put_string(const std::string& value)
+    {
+        put_u32(value.size());
+        out_.append(value);
+    }
+
+    std::string payload()
+    {
+        return std::move(out_);
+    }
+
+  private:
+    std::string out_;
+};
+
+/**
+ * Reads the fields of a message from its payload.
+ */
+class decoder
+{
+  public:
+    decoder(const std::string& in) : in_{in}, pos_{0}
+    {
+        // nothing
+    }
+
+    uint64_t get(uint64_t bytes)
+    {
+        need(bytes);
+        uint64_t value = 0;
+        for (uint64_t i = 0; i < bytes; ++i)
+            value |= static_cast<uint64_t>(static_cast<uint8_t>(in_[pos_ + i]))
+                     << (8 * i);
+        pos_ += bytes;
+        return value;
+    }
+
+    uint8_t get_u8()
+    {
+        return static_cast<uint8_t>(get(1));
+    }
+
+    uint32_t get_u32()
+    {
+        return static_cast<uint32_t>(get(4));
+    }
+
+    uint64_t get_u64()
+    {
+        return get(8);
+    }
+
+    double get_double()
+    {
+        auto bits = get_u64();
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+
+    std::string get_string()
+    {
+        auto size = get_u32();
+        need(size);
+        auto value = in_.substr(pos_, size);
+        pos_ += size;
+        return value;
+    }
+
+    /**
+     * @param count A count read from the payload
+     * @param min_bytes The fewest bytes each counted item takes
+     * @return the count, if the rest of the payload can hold its items
+     */
+    uint64_t get_count(uint64_t min_bytes)
+    {
+        auto count = get_u32();
+        if (count * min_bytes > in_.size() - pos_)
+            throw protocol_exception{"truncated message"};
+        return count;
+    }
+
+    void finish() const
+    {
+        if (pos_ != in_.size())
+            throw protocol_exception{"trailing bytes in message"};
+    }
+
+  private:
+    void need(uint64_t bytes) const
+    {
+        if (bytes > in_.size() - pos_)
+            throw protocol_exception{"truncated message"};
+    }
+
+    const std::string& in_;
+    uint64_t pos_;
+};
+
+/// Tags the kind of each message, against a peer speaking something else
+const uint8_t request_tag = 'Q';
+const uint8_t response_tag = 'R';
+
+/**
+ * Reads exactly size bytes from a socket.
+ * @return the number of bytes read before the peer closed the socket
+ */
+uint64_t read_fully(int fd, char* data, uint64_t size)
+{
+    uint64_t done = 0;
+    while (done < size)
+    {
+        auto got = ::recv(fd, data + done, size - done, 0);
+        if (got == 0)
+            break;
+        if (got < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw protocol_exception{std::string{"read failed: "}
+                                     + std::strerror(errno)};
+        }
+        done += static_cast<uint64_t>(got);
+    }
+    return done;
+}
+}
+
+std::string encode(const request& req)
+{
+    encoder out;
+    out.put_u8(request_tag);
+    out.put_u64(req.id);
+    out.put_string(req.index);
+    out.put_u32(req.num_results);
+    out.put_u8(req.with_paths ? 1 : 0);
+    out.put_u32(req.queries.size());
+    for (const auto& query : req.queries)
+        out.put_string(query);
+    return out.payload();
+}
+
+std::string encode(const response& resp)
+{
+    encoder out;
+    out.put_u8(response_tag);
+    out.put_u64(resp.id);
+    out.put_string(resp.error);
+    out.put_u32(resp.results.size());
+    for (const auto& results : resp.results)
+    {
+        out.put_u32(results.size());
+        for (const auto& res : results)
+        {
+            out.put_u64(res.d_id);
+            out.put_double(res.score);
+            out.put_string(res.path);
+        }
+    }
+    return out.payload();
+}
+
+request decode_request(const std::string& payload)
+{
+    decoder in{payload};
+    if (in.get_u8() != request_tag)
+        throw protocol_exception{"not a request"};
+
+    request req;
+    req.id = in.get_u64();
+    req.index = in.get_string();
+    req.num_results = in.get_u32();
+    req.with_paths = in.get_u8() != 0;
+    auto num_queries = in.get_count(4);
+    req.queries.reserve(num_queries);
+    for (uint64_t i = 0; i < num_queries; ++i)
+        req.queries.push_back(in.get_string());
+    in.finish();
+    return req;
+}
+
+response decode_response(const std::string& payload)
+{
+    decoder in{payload};
+    if (in.get_u8() != response_tag)
+        throw protocol_exception{"not a response"};
+
+    response resp;
+    resp.id = in.get_u64();
+    resp.error = in.get_string();
+    auto num_queries = in.get_count(4);
+    resp.results.resize(num_queries);
+    for (auto& results : resp.results)
+    {
+        auto num_results = in.get_count(20);
+        results.reserve(num_results);
+        for (uint64_t i = 0; i < num_results; ++i)
+        {
+            result res;
+            res.d_id = doc_id{in.get_u64()};
+            res.score = in.get_double();
+            res.path = in.get_string();
+            results.push_back(std::move(res));
+        }
+    }
+    in.finish();
+    return resp;
+}
+
+void write_frame(int fd, const std::string& payload)
+{
+    if (payload.size() > max_frame_bytes)
+        throw protocol_exception{"frame too large"};
+
+    // the header and payload go out in one buffer, so that frames written
+    // by different threads under a lock are never interleaved by a
+    // partial send
+    encoder header;
+    header.put_u32(payload.size());
+    auto frame = header.payload();
+    frame.append(payload);
+
+    uint64_t done = 0;
+    while (done < frame.size())
+    {
+        auto sent = ::send(fd, frame.data() + done, frame.size() - done,
+                           MSG_NOSIGNAL);
+        if (sent < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw protocol_exception{std::string{"write failed: "}
+                                     + std::strerror(errno)};
+        }
+        done += static_cast<uint64_t>(sent);
+    }
+}
+
+bool read_frame(int fd, std::string& payload)
+{
+    char header[4];
+    auto got = read_fully(fd, header, sizeof(header));
+    if (got == 0)
+        return false;
+    if (got != sizeof(header))
+        throw protocol_exception{"connection closed inside a frame"};
+
+    std::string header_bytes{header, sizeof(header)};
+    auto size = decoder{header_bytes}.get_u32();
+    if (size > max_frame_bytes)
+        throw protocol_exception{"frame too large"};
+
+    payload.resize(size);
+    if (read_fully(fd, &payload[0], size) != size)
+        throw protocol_exception{"connection closed inside a frame"};
+    return true;
+}
+
+int connect_unix(const std::string& path)
+{
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.size() >= sizeof(addr.sun_path))
+        throw protocol_exception{"socket path too long: " + path};
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw protocol_exception{std::string{"cannot create socket: "}
+                                 + std::strerror(errno)};
+    if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0)
+    {
+        auto error = errno;
+        ::close(fd);
+        throw protocol_exception{"cannot connect to " + path + ": "
+                                 + std::strerror(error)};
+    }
+    return fd;
+}
+}
+}
+}
@@ -0,0 +1,310 @@
+/**
+ * @file search_server.cpp
+ */
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "corpus/document.h"
+#include "cpptoml.h"
+#include "index/ranker/okapi_bm25.h"
+#include "index/ranker/ranker_factory.h"
+#include "index/search_server.h"
+#include "util/shim.h"
+
+namespace meta
+{
+namespace index
+{
+
+struct search_server::connection
+{
+    connection(int fd) : fd{fd}
+    {
+        // nothing
+    }
+
+    ~connection()
+    {
+        ::close(fd);
+    }
+
+    /// The client's socket, closed once the reader and every request in
+    /// flight are done with it
+    const int fd;
+
+    /// Keeps the responses of concurrent requests from interleaving
+    std::mutex write_mutex;
+};
+
+search_server::served_index::served_index(std::shared_ptr<index_type> idx,
+                                          std::unique_ptr<ranker> rnk)
+    : handle{std::move(idx)}, rnk{std::move(rnk)}
+{
+    // nothing
+}
+
+search_server::search_server(const cpptoml::table& config)
+    : search_server(
+          [&]()
+          {
+              auto server = config.get_table("server");
+              if (!server)
+                  throw search_server_exception{
+                      "[server] table needed in config file"};
+              auto socket = server->get_as<std::string>("socket");
+              if (!socket)
+                  throw search_server_exception{
+                      "[server] table needs a \"socket\" path"};
+              return *socket;
+          }(),
+          [&]()
+          {
+              auto server = config.get_table("server");
+              auto threads = server->get_as<int64_t>("threads");
+              return threads && *threads > 0
+                         ? static_cast<uint64_t>(*threads)
+                         : std::thread::hardware_concurrency();
+          }())
+{
+    auto indexes = config.get_table_array("server-index");
+    if (!indexes)
+        throw search_server_exception{
+            "config file needs a [[server-index]] table"};
+
+    for (const auto& table : indexes->get())
+    {
+        auto name = table->get_as<std::string>("name");
+        auto index_config = table->get_as<std::string>("config");
+        if (!name || !index_config)
+            throw search_server_exception{
+                "[[server-index]] needs a \"name\" and a \"config\""};
+
+        auto idx = make_index<index_type>(*index_config, 10000);
+        auto ranker_table
+            = cpptoml::parse_file(*index_config).get_table("ranker");
+        add(*name, std::move(idx), ranker_table
+                                       ? make_ranker(*ranker_table)
+                                       : make_unique<okapi_bm25>());
+    }
+}
+
+search_server::search_server(std::string socket_path, uint64_t num_threads)
+    : socket_path_{std::move(socket_path)},
+      pool_{num_threads},
+      listen_fd_{-1},
+      stopping_{false},
+      active_readers_{0}
+{
+    // nothing
+}
+
+search_server::~search_server()
+{
+    stop();
+}
+
+void search_server::add(const std::string& name,
+                        std::shared_ptr<index_type> idx,
+                        std::unique_ptr<ranker> rnk)
+{
+    if (indexes_.count(name))
+        throw search_server_exception{"index served twice: " + name};
+    indexes_[name] = make_unique<served_index>(std::move(idx), std::move(rnk));
+}
+
+auto search_server::handle(const std::string& name) -> handle_type &
+{
+    auto it = indexes_.find(name);
+    if (it == indexes_.end())
+        throw search_server_exception{"unknown index: " + name};
+    return it->second->handle;
+}
+
+void search_server::run()
+{
+    sockaddr_un addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socket_path_.size() >= sizeof(addr.sun_path))
+        throw search_server_exception{"socket path too long: "
+                                      + socket_path_};
+    std::memcpy(addr.sun_path, socket_path_.c_str(), socket_path_.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw search_server_exception{std::string{"cannot create socket: "}
+                                      + std::strerror(errno)};
+    ::unlink(socket_path_.c_str());
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0
+        || ::listen(fd, SOMAXCONN) < 0)
+    {
+        auto error = errno;
+        ::close(fd);
+        throw search_server_exception{"cannot listen on " + socket_path_
+                                      + ": " + std::strerror(error)};
+    }
+
+    // stop() shuts the listening socket down once it is published, and
+    // run() returns at once if stop() came before it
+    listen_fd_ = fd;
+    while (!stopping_)
+    {
+        int client = ::accept(fd, nullptr, nullptr);
+        if (client < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            if (stopping_)
+                break;
+            auto error = errno;
+            stop();
+            ::close(fd);
+            throw search_server_exception{
+                std::string{"cannot accept connections: "}
+                + std::strerror(error)};
+        }
+
+        auto conn = std::make_shared<connection>(client);
+        std::lock_guard<std::mutex> lock{connections_mutex_};
+        if (stopping_)
+            break;
+        connections_.erase(
+            std::remove_if(connections_.begin(), connections_.end(),
+                           [](const std::weak_ptr<connection>& c)
+                           {
+                               return c.expired();
+                           }),
+            connections_.end());
+        connections_.push_back(conn);
+        ++active_readers_;
+        std::thread{&search_server::serve, this, std::move(conn)}.detach();
+    }
+
+    stop();
+    ::close(fd);
+    ::unlink(socket_path_.c_str());
+}
+
+void search_server::stop()
+{
+    std::unique_lock<std::mutex> lock{connections_mutex_};
+    stopping_ = true;
+    auto fd = listen_fd_.exchange(-1);
+    if (fd >= 0)
+        ::shutdown(fd, SHUT_RDWR);
+
+    // the readers see the end of their connections and leave; requests in
+    // flight are still answered, and their connections closed after
+    for (const auto& weak : connections_)
+    {
+        if (auto conn = weak.lock())
+            ::shutdown(conn->fd, SHUT_RD);
+    }
+    readers_done_.wait(lock, [&]()
+                       {
+                           return active_readers_ == 0;
+                       });
+}
+
+void search_server::serve(std::shared_ptr<connection> conn)
+{
+    auto respond = [conn](const protocol::response& resp)
+    {
+        try
+        {
+            auto payload = protocol::encode(resp);
+            std::lock_guard<std::mutex> lock{conn->write_mutex};
+            protocol::write_frame(conn->fd, payload);
+        }
+        catch (const protocol_exception&)
+        {
+            // the client is gone, or the response cannot be framed; the
+            // reader sees the end of the socket either way
+            ::shutdown(conn->fd, SHUT_RDWR);
+        }
+    };
+
+    try
+    {
+        std::string payload;
+        while (protocol::read_frame(conn->fd, payload))
+        {
+            auto req = std::make_shared<protocol::request>(
+                protocol::decode_request(payload));
+            pool_.submit_task([this, req, respond]()
+                              {
+                                  respond(answer(*req));
+                              });
+        }
+    }
+    catch (const protocol_exception& ex)
+    {
+        // a malformed frame leaves the rest of the stream unreadable, so
+        // the client is told why and the connection is closed
+        protocol::response resp;
+        resp.error = ex.what();
+        respond(resp);
+        ::shutdown(conn->fd, SHUT_RDWR);
+    }
+
+    conn.reset();
+    std::lock_guard<std::mutex> lock{connections_mutex_};
+    if (--active_readers_ == 0)
+        readers_done_.notify_all();
+}
+
+protocol::response search_server::answer(const protocol::request& req)
+{
+    protocol::response resp;
+    resp.id = req.id;
+
+    auto it = indexes_.find(req.index);
+    if (it == indexes_.end())
+    {
+        resp.error = "unknown index: " + req.index;
+        return resp;
+    }
+    auto& served = *it->second;
+
+    try
+    {
+        auto idx = served.handle.snapshot();
+        std::vector<corpus::document> queries(req.queries.size());
+        {
+            std::lock_guard<std::mutex> lock{served.tokenize_mutex};
+            for (uint64_t i = 0; i < queries.size(); ++i)
+            {
+                queries[i].content(req.queries[i]);
+                idx->tokenize(queries[i]);
+            }
+        }
+
+        auto num_results
+            = std::min<uint64_t>(req.num_results, idx->num_docs());
+        resp.results.resize(queries.size());
+        for (uint64_t i = 0; i < queries.size(); ++i)
+        {
+            for (const auto& res :
+                 served.rnk->score(*idx, queries[i], num_results))
+            {
+                resp.results[i].push_back(
+                    {res.first, res.second,
+                     req.with_paths ? idx->doc_path(res.first) : ""});
+            }
+        }
+    }
+    catch (const std::exception& ex)
+    {
+        resp.results.clear();
+        resp.error = ex.what();
+    }
+    return resp;
+}
+}
+}
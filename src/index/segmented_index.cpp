@@ -0,0 +1,788 @@
+/**
+ * @file segmented_index.cpp
+ */
+
+#include <algorithm>
+#include <fstream>
+#include <limits>
+#include <unordered_set>
+
+#include "corpus/corpus.h"
+#include "index/inverted_index.h"
+#include "index/live_segment.h"
+#include "index/ranker/ranker.h"
+#include "index/segmented_index.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/**
+ * A corpus of documents held in memory.
+ */
+class document_list_corpus : public corpus::corpus
+{
+  public:
+    /**
+     * @param docs The documents, numbered from zero in order
+     */
+    document_list_corpus(std::vector<meta::corpus::document> docs)
+        : corpus::corpus{docs.empty() ? "utf-8" : docs.front().encoding()},
+          docs_(std::move(docs)),
+          cur_{0}
+    {
+        // nothing
+    }
+
+    bool has_next() const override
+    {
+        return cur_ < docs_.size();
+    }
+
+    meta::corpus::document next() override
+    {
+        return std::move(docs_[cur_++]);
+    }
+
+    uint64_t size() const override
+    {
+        return docs_.size();
+    }
+
+  private:
+    std::vector<meta::corpus::document> docs_;
+    uint64_t cur_;
+};
+}
+
+segmented_index::segmented_index(const std::string& config_file)
+    : config_(cpptoml::parse_file(config_file)),
+      next_segment_{0},
+      segments_{std::make_shared<const segment_list>()},
+      merging_{false},
+      flush_running_{false}
+{
+    auto name = config_.get_as<std::string>("inverted-index");
+    if (!name)
+        throw segmented_index_exception{
+            "inverted-index missing from configuration file"};
+    name_ = *name;
+
+    auto factor = config_.get_as<int64_t>("segment-merge-factor");
+    if (factor && *factor < 2)
+        throw segmented_index_exception{
+            "segment-merge-factor must be at least 2"};
+    merge_factor_ = factor ? static_cast<uint64_t>(*factor) : 10;
+
+    auto flush_docs = config_.get_as<int64_t>("live-flush-docs");
+    if (flush_docs && *flush_docs < 1)
+        throw segmented_index_exception{
+            "live-flush-docs must be at least 1"};
+    flush_docs_ = flush_docs ? static_cast<uint64_t>(*flush_docs) : 1000;
+
+    auto flush_seconds = config_.get_as<int64_t>("live-flush-seconds");
+    if (flush_seconds && *flush_seconds < 0)
+        throw segmented_index_exception{
+            "live-flush-seconds must not be negative"};
+    flush_interval_ = std::chrono::seconds{flush_seconds ? *flush_seconds
+                                                         : 60};
+
+    filesystem::make_directory(name_);
+    config_file_ = name_ + "/config.toml";
+    if (config_file != config_file_)
+        filesystem::copy_file(config_file, config_file_);
+
+    segment_list segments;
+    std::ifstream manifest{name_ + "/segments"};
+    std::string seg_name;
+    while (std::getline(manifest, seg_name))
+    {
+        if (seg_name.empty())
+            continue;
+
+        auto idx = make_segment(seg_name);
+        if (!idx->valid())
+            throw segmented_index_exception{"segment " + seg_name
+                                            + " is missing files"};
+        idx->load_index();
+        segments.push_back({seg_name, idx, 0});
+
+        auto num = std::stoull(seg_name.substr(seg_name.find('-') + 1));
+        next_segment_ = std::max<uint64_t>(next_segment_, num + 1);
+    }
+
+    live_ = std::make_shared<live_segment>(config_, name_ + "/live");
+    live_since_ = std::chrono::steady_clock::now();
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    install(std::move(segments));
+}
+
+segmented_index::~segmented_index()
+{
+    try
+    {
+        std::future<void> flushes;
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            flushes = std::move(flushes_);
+        }
+        if (flushes.valid())
+            flushes.get();
+    }
+    catch (const std::exception& ex)
+    {
+        LOG(error) << "Live segment flush failed: " << ex.what() << ENDLG;
+    }
+
+    try
+    {
+        wait_for_merges();
+    }
+    catch (const std::exception& ex)
+    {
+        LOG(error) << "Segment merge failed: " << ex.what() << ENDLG;
+    }
+}
+
+std::shared_ptr<inverted_index>
+    segmented_index::make_segment(const std::string& name) const
+{
+    // can't use std::make_shared here since the constructor is protected
+    return std::shared_ptr<inverted_index>{
+        new inverted_index(config_, name_ + "/" + name)};
+}
+
+std::string segmented_index::next_name()
+{
+    return "segment-" + std::to_string(next_segment_++);
+}
+
+void segmented_index::add_segment(corpus::corpus& docs)
+{
+    std::string name;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        name = next_name();
+    }
+
+    auto idx = make_segment(name);
+    filesystem::remove_all(idx->index_name());
+    filesystem::make_directory(idx->index_name());
+    idx->create_index(config_file_, docs);
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto segments = *segments_;
+    segments.push_back({name, idx, 0});
+    install(std::move(segments));
+    schedule_merges();
+}
+
+doc_id segmented_index::add_document(const corpus::document& doc)
+{
+    doc_id d_id;
+    {
+        std::lock_guard<std::mutex> ingest{ingest_mutex_};
+        std::shared_ptr<live_segment> live;
+        uint64_t first_doc;
+        {
+            std::lock_guard<std::mutex> lock{mutex_};
+            live = live_;
+            first_doc = live_segments().back().second;
+            if (live->num_docs() == 0)
+                live_since_ = std::chrono::steady_clock::now();
+        }
+        d_id = doc_id{first_doc + live->add(doc)};
+    }
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    schedule_flush();
+    return d_id;
+}
+
+void segmented_index::schedule_flush()
+{
+    if (flush_running_)
+        return;
+
+    auto num_live = live_->num_docs();
+    auto age = std::chrono::steady_clock::now() - live_since_;
+    auto aged = flush_interval_.count() > 0 && age >= flush_interval_;
+    if (num_live == 0 || (num_live < flush_docs_ && !aged))
+        return;
+
+    // the previous flush has finished; report its failure, if any
+    if (flushes_.valid())
+        flushes_.get();
+
+    flush_running_ = true;
+    flushes_ = std::async(std::launch::async, [this]()
+                          {
+                              try
+                              {
+                                  flush_live();
+                              }
+                              catch (...)
+                              {
+                                  std::lock_guard<std::mutex> lock{mutex_};
+                                  flush_running_ = false;
+                                  throw;
+                              }
+                              std::lock_guard<std::mutex> lock{mutex_};
+                              flush_running_ = false;
+                          });
+}
+
+void segmented_index::flush()
+{
+    std::future<void> flushes;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        flushes = std::move(flushes_);
+    }
+    if (flushes.valid())
+        flushes.get();
+    flush_live();
+}
+
+void segmented_index::flush_live()
+{
+    std::lock_guard<std::mutex> flush_lock{flush_mutex_};
+
+    // the live segment is replaced by an empty one, but stays searchable
+    // until its documents are in a disk segment
+    std::shared_ptr<live_segment> frozen;
+    std::string name;
+    {
+        std::lock_guard<std::mutex> ingest{ingest_mutex_};
+        std::lock_guard<std::mutex> lock{mutex_};
+        if (live_->num_docs() == 0)
+            return;
+        frozen = live_;
+        flushing_ = frozen;
+        live_ = std::make_shared<live_segment>(config_, name_ + "/live");
+        live_since_ = std::chrono::steady_clock::now();
+        name = next_name();
+    }
+
+    auto idx = make_segment(name);
+    try
+    {
+        document_list_corpus docs{frozen->documents()};
+        filesystem::remove_all(idx->index_name());
+        filesystem::make_directory(idx->index_name());
+        idx->create_index(config_file_, docs);
+    }
+    catch (...)
+    {
+        // the documents are put back in front of those added since
+        std::lock_guard<std::mutex> ingest{ingest_mutex_};
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto live = std::make_shared<live_segment>(config_,
+                                                   name_ + "/live");
+        for (const auto& seg : {frozen, live_})
+        {
+            for (auto& doc : seg->documents())
+            {
+                auto d_id = live->add(doc);
+                if (seg->is_deleted(doc.id()))
+                    live->delete_doc(d_id);
+            }
+        }
+        live_ = live;
+        flushing_ = nullptr;
+        throw;
+    }
+
+    std::lock_guard<std::mutex> lock{mutex_};
+
+    // deletions are made while holding mutex_, so none can be missed
+    std::vector<doc_id> deleted;
+    for (uint64_t i = 0; i < frozen->num_docs(); ++i)
+    {
+        if (frozen->is_deleted(doc_id{i}))
+            deleted.emplace_back(i);
+    }
+    idx->delete_docs(deleted);
+
+    auto segments = *segments_;
+    segments.push_back({name, idx, 0});
+    install(std::move(segments));
+    flushing_ = nullptr;
+    schedule_merges();
+}
+
+uint64_t segmented_index::num_live_docs() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    uint64_t num_live = 0;
+    for (const auto& live : live_segments())
+        num_live += live.first->num_docs();
+    return num_live;
+}
+
+auto segmented_index::live_segments() const -> std::vector<live_info>
+{
+    uint64_t first_doc = 0;
+    if (!segments_->empty())
+        first_doc = segments_->back().first_doc
+                    + segments_->back().index->num_docs();
+
+    std::vector<live_info> live;
+    if (flushing_)
+    {
+        live.emplace_back(flushing_, first_doc);
+        first_doc += flushing_->num_docs();
+    }
+    live.emplace_back(live_, first_doc);
+    return live;
+}
+
+auto segmented_index::locate_live(doc_id d_id) const
+    -> std::pair<std::shared_ptr<live_segment>, doc_id>
+{
+    for (const auto& live : live_segments())
+    {
+        if (d_id >= live.second && d_id < live.second + live.first->num_docs())
+            return {live.first, doc_id{d_id - live.second}};
+    }
+    return {nullptr, doc_id{0}};
+}
+
+void segmented_index::install(segment_list segments)
+{
+    uint64_t first_doc = 0;
+    for (auto& seg : segments)
+    {
+        seg.first_doc = first_doc;
+        first_doc += seg.index->num_docs();
+    }
+
+    // replace the list of segments in one step, so that a crash never
+    // leaves a partially written one behind
+    auto manifest = name_ + "/segments";
+    {
+        std::ofstream out{manifest + ".tmp"};
+        for (const auto& seg : segments)
+            out << seg.name << "\n";
+    }
+    filesystem::rename_file(manifest + ".tmp", manifest);
+
+    segments_ = std::make_shared<const segment_list>(std::move(segments));
+}
+
+auto segmented_index::snapshot() const -> std::shared_ptr<const segment_list>
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return segments_;
+}
+
+auto segmented_index::find_merge(const segment_list& segments) const
+    -> util::optional<std::pair<uint64_t, uint64_t>>
+{
+    // segments are grouped into levels by size, each level holding
+    // segments merge_factor_ times larger than the one below it
+    auto level = [&](const segment_info& seg)
+    {
+        uint64_t lvl = 0;
+        for (auto n = seg.index->num_docs(); n >= merge_factor_;
+             n /= merge_factor_)
+            ++lvl;
+        return lvl;
+    };
+
+    for (uint64_t first = 0; first < segments.size();)
+    {
+        auto lvl = level(segments[first]);
+        auto last = first + 1;
+        while (last < segments.size() && level(segments[last]) == lvl)
+            ++last;
+
+        if (last - first >= merge_factor_)
+            return std::make_pair(first, first + merge_factor_);
+        first = last;
+    }
+    return util::nullopt;
+}
+
+void segmented_index::schedule_merges()
+{
+    if (merging_ || !find_merge(*segments_))
+        return;
+
+    // the previous merge has finished; report its failure, if any
+    if (merges_.valid())
+        merges_.get();
+
+    merging_ = true;
+    merges_ = std::async(std::launch::async, [this]()
+                         {
+                             run_merges();
+                         });
+}
+
+void segmented_index::run_merges()
+{
+    try
+    {
+        while (true)
+        {
+            std::vector<std::shared_ptr<inverted_index>> sources;
+            std::vector<std::string> names;
+            std::string name;
+            {
+                std::lock_guard<std::mutex> lock{mutex_};
+                auto range = find_merge(*segments_);
+                if (!range)
+                {
+                    merging_ = false;
+                    return;
+                }
+
+                for (auto i = range->first; i < range->second; ++i)
+                {
+                    sources.push_back((*segments_)[i].index);
+                    names.push_back((*segments_)[i].name);
+                }
+                name = next_name();
+            }
+
+            auto idx = make_segment(name);
+            filesystem::remove_all(idx->index_name());
+            filesystem::make_directory(idx->index_name());
+            idx->create_index(config_file_, sources);
+
+            {
+                // segments may have been added while merging, but only
+                // after the ones that were merged
+                std::lock_guard<std::mutex> lock{mutex_};
+
+                // documents deleted during the merge still have their
+                // postings in the new segment, but must stay deleted
+                std::vector<doc_id> deleted;
+                uint64_t offset = 0;
+                for (const auto& src : sources)
+                {
+                    for (const auto& d_id : src->docs())
+                    {
+                        if (src->is_deleted(d_id))
+                            deleted.emplace_back(offset + d_id);
+                    }
+                    offset += src->num_docs();
+                }
+                idx->delete_docs(deleted);
+
+                segment_list segments;
+                for (uint64_t i = 0; i < segments_->size(); ++i)
+                {
+                    const auto& seg = (*segments_)[i];
+                    if (seg.name == names.front())
+                    {
+                        segments.push_back({name, idx, 0});
+                        i += names.size() - 1;
+                    }
+                    else
+                    {
+                        segments.push_back(seg);
+                    }
+                }
+                install(std::move(segments));
+            }
+
+            // queries still using the old segments keep their files
+            // mapped, so the files can be removed right away
+            for (const auto& old : names)
+                filesystem::remove_all(name_ + "/" + old);
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        merging_ = false;
+        throw;
+    }
+}
+
+void segmented_index::wait_for_merges()
+{
+    std::future<void> merges;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        merges = std::move(merges_);
+    }
+    if (merges.valid())
+        merges.get();
+}
+
+uint64_t segmented_index::num_segments() const
+{
+    return snapshot()->size();
+}
+
+std::shared_ptr<inverted_index> segmented_index::segment(uint64_t idx) const
+{
+    return snapshot()->at(idx).index;
+}
+
+uint64_t segmented_index::num_docs() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto live = live_segments();
+    return live.back().second + live.back().first->num_docs();
+}
+
+auto segmented_index::locate(const segment_list& segments, doc_id d_id)
+    -> const segment_info &
+{
+    auto it = std::upper_bound(segments.begin(), segments.end(),
+                               uint64_t{d_id},
+                               [](uint64_t id, const segment_info& seg)
+                               {
+        return id < seg.first_doc;
+    });
+    if (it == segments.begin()
+        || d_id >= (it - 1)->first_doc + (it - 1)->index->num_docs())
+        throw segmented_index_exception{"doc_id out of range: "
+                                        + std::to_string(d_id)};
+    return *(it - 1);
+}
+
+auto segmented_index::locate(doc_id d_id) const
+    -> std::pair<std::shared_ptr<inverted_index>, doc_id>
+{
+    auto segments = snapshot();
+    const auto& seg = locate(*segments, d_id);
+    return {seg.index, doc_id{d_id - seg.first_doc}};
+}
+
+void segmented_index::delete_doc(doc_id d_id)
+{
+    // the lock keeps a merge or flush from replacing the segment until
+    // the deletion is recorded, so that it can be carried over
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto live = locate_live(d_id);
+    if (live.first)
+    {
+        live.first->delete_doc(live.second);
+        return;
+    }
+    const auto& seg = locate(*segments_, d_id);
+    seg.index->delete_doc(doc_id{d_id - seg.first_doc});
+}
+
+bool segmented_index::is_deleted(doc_id d_id) const
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto live = locate_live(d_id);
+        if (live.first)
+            return live.first->is_deleted(live.second);
+    }
+    auto loc = locate(d_id);
+    return loc.first->is_deleted(loc.second);
+}
+
+uint64_t segmented_index::num_deleted() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    uint64_t num_deleted = 0;
+    for (const auto& seg : *segments_)
+        num_deleted += seg.index->num_deleted();
+    for (const auto& live : live_segments())
+        num_deleted += live.first->num_deleted();
+    return num_deleted;
+}
+
+std::string segmented_index::doc_path(doc_id d_id) const
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto live = locate_live(d_id);
+        if (live.first)
+            return live.first->doc_path(live.second);
+    }
+    auto loc = locate(d_id);
+    return loc.first->doc_path(loc.second);
+}
+
+uint64_t segmented_index::doc_size(doc_id d_id) const
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto live = locate_live(d_id);
+        if (live.first)
+            return live.first->doc_size(live.second);
+    }
+    auto loc = locate(d_id);
+    return loc.first->doc_size(loc.second);
+}
+
+class_label segmented_index::label(doc_id d_id) const
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto live = locate_live(d_id);
+        if (live.first)
+            return live.first->label(live.second);
+    }
+    auto loc = locate(d_id);
+    return loc.first->label(loc.second);
+}
+
+std::vector<std::pair<doc_id, double>>
+    segmented_index::score(ranker& r, corpus::document& query,
+                           uint64_t num_results,
+                           const std::function<bool(doc_id d_id)>& filter)
+{
+    std::shared_ptr<const segment_list> segments;
+    std::vector<live_info> live;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        segments = segments_;
+        live = live_segments();
+    }
+    if (num_results == 0)
+        return {};
+
+    // every segment uses the same analyzer
+    if (query.counts().empty())
+    {
+        if (segments->empty())
+            live.back().first->tokenize(query);
+        else
+            segments->front().index->tokenize(query);
+    }
+
+    // each live segment is read once, so the documents added while the
+    // query runs are left out of both its statistics and its results
+    std::vector<live_segment::view> views;
+    for (const auto& seg : live)
+        views.push_back(seg.first->make_view(query));
+
+    collection_stats stats;
+    stats.num_docs = 0;
+    stats.total_terms = 0;
+    for (const auto& seg : *segments)
+    {
+        stats.num_docs += seg.index->num_docs();
+        stats.total_terms += seg.index->total_corpus_terms();
+    }
+    for (const auto& v : views)
+    {
+        stats.num_docs += v.num_docs;
+        stats.total_terms += v.total_terms;
+    }
+    if (stats.num_docs == 0)
+        return {};
+    stats.avg_dl = stats.num_docs == 0 ? 0.0 : static_cast<double>(
+                                                   stats.total_terms)
+                                                   / stats.num_docs;
+
+    for (const auto& count : query.counts())
+    {
+        auto& term = stats.terms[count.first];
+        for (const auto& seg : *segments)
+        {
+            auto t_id = seg.index->get_term_id(count.first);
+            term.first += seg.index->doc_freq(t_id);
+            term.second += seg.index->total_num_occurences(t_id);
+        }
+        for (const auto& v : views)
+        {
+            const auto& postings = v.terms.at(count.first);
+            term.first += postings.doc_freq;
+            term.second += postings.total_count;
+        }
+    }
+
+    std::vector<std::pair<doc_id, double>> results;
+    for (const auto& seg : *segments)
+    {
+        auto first_doc = seg.first_doc;
+        std::function<bool(doc_id)> seg_filter;
+        if (filter)
+        {
+            seg_filter = [&](doc_id d_id)
+            {
+                return filter(doc_id{first_doc + d_id});
+            };
+        }
+        auto part
+            = r.score(*seg.index, query, stats, num_results, seg_filter);
+        for (const auto& result : part)
+            results.emplace_back(doc_id{first_doc + result.first},
+                                 result.second);
+    }
+    for (uint64_t i = 0; i < live.size(); ++i)
+    {
+        auto first_doc = live[i].second;
+        std::function<bool(doc_id)> seg_filter;
+        if (filter)
+        {
+            seg_filter = [&](doc_id d_id)
+            {
+                return filter(doc_id{first_doc + d_id});
+            };
+        }
+        auto part = live[i].first->score(r, query, views[i], stats,
+                                         num_results, seg_filter);
+        for (const auto& result : part)
+            results.emplace_back(doc_id{first_doc + result.first},
+                                 result.second);
+    }
+
+    std::stable_sort(results.begin(), results.end(),
+                     [](const std::pair<doc_id, double>& a,
+                        const std::pair<doc_id, double>& b)
+                     {
+        return a.second > b.second;
+    });
+    if (results.size() > num_results)
+        results.resize(num_results);
+
+    // if too few documents matched, fill the results with unmatched
+    // documents in doc_id order, as ranker::score does
+    if (results.size() < num_results)
+    {
+        std::unordered_set<doc_id> matched;
+        for (const auto& result : results)
+            matched.insert(result.first);
+        for (const auto& seg : *segments)
+        {
+            for (uint64_t i = 0; i < seg.index->num_docs()
+                                 && results.size() < num_results;
+                 ++i)
+            {
+                doc_id id{seg.first_doc + i};
+                if (matched.find(id) != matched.end()
+                    || seg.index->is_deleted(doc_id{i})
+                    || (filter && !filter(id)))
+                    continue;
+                results.emplace_back(id,
+                                     std::numeric_limits<double>::lowest());
+            }
+        }
+        for (uint64_t i = 0; i < live.size(); ++i)
+        {
+            for (uint64_t j = 0; j < views[i].num_docs
+                                 && results.size() < num_results;
+                 ++j)
+            {
+                doc_id id{live[i].second + j};
+                if (matched.find(id) != matched.end() || views[i].deleted[j]
+                    || (filter && !filter(id)))
+                    continue;
+                results.emplace_back(id,
+                                     std::numeric_limits<double>::lowest());
+            }
+        }
+    }
+
+    return results;
+}
+}
+}
@@ -0,0 +1,234 @@
+/**
+ * @file sharded_index.cpp
+ */
+
+#include <algorithm>
+#include <future>
+
+#include "cpptoml.h"
+#include "corpus/document.h"
+#include "index/inverted_index.h"
+#include "index/make_index.h"
+#include "index/ranker/ranker.h"
+#include "index/sharded_index.h"
+#include "util/shim.h"
+
+namespace meta
+{
+namespace index
+{
+
+local_shard::local_shard(std::shared_ptr<inverted_index> idx)
+    : idx_{std::move(idx)}
+{
+    // nothing
+}
+
+uint64_t local_shard::num_docs() const
+{
+    return idx_->num_docs();
+}
+
+uint64_t local_shard::total_corpus_terms() const
+{
+    return idx_->total_corpus_terms();
+}
+
+std::vector<std::pair<uint64_t, uint64_t>>
+    local_shard::term_stats(const std::vector<std::string>& terms)
+{
+    std::vector<std::pair<uint64_t, uint64_t>> stats;
+    stats.reserve(terms.size());
+    for (const auto& term : terms)
+    {
+        auto t_id = idx_->get_term_id(term);
+        stats.emplace_back(idx_->doc_freq(t_id),
+                           idx_->total_num_occurences(t_id));
+    }
+    return stats;
+}
+
+std::vector<std::pair<doc_id, double>>
+    local_shard::search(ranker& r, const corpus::document& query,
+                        const collection_stats& stats, uint64_t num_results)
+{
+    // the query is already tokenized, so the ranker only reads the copy
+    auto q = query;
+    return r.score(*idx_, q, stats, num_results);
+}
+
+std::string local_shard::doc_path(doc_id d_id) const
+{
+    return idx_->doc_path(d_id);
+}
+
+class_label local_shard::label(doc_id d_id) const
+{
+    return idx_->label(d_id);
+}
+
+inverted_index& local_shard::index()
+{
+    return *idx_;
+}
+
+sharded_index::sharded_index(std::vector<std::unique_ptr<shard>> shards,
+                             uint64_t num_threads)
+    : shards_{std::move(shards)},
+      num_docs_{0},
+      pool_{std::max<uint64_t>(num_threads, 1)}
+{
+    for (const auto& s : shards_)
+    {
+        first_docs_.push_back(num_docs_);
+        num_docs_ += s->num_docs();
+    }
+}
+
+std::unique_ptr<sharded_index>
+    sharded_index::load(const std::string& config_file)
+{
+    auto config = cpptoml::parse_file(config_file);
+    auto shard_configs = config.get_table_array("shards");
+    if (!shard_configs)
+        throw sharded_index_exception{
+            "shards missing from configuration file"};
+
+    std::vector<std::unique_ptr<shard>> shards;
+    for (auto shard_config : shard_configs->get())
+    {
+        auto path = shard_config->get_as<std::string>("config");
+        if (!path)
+            throw sharded_index_exception{
+                "shard configuration is missing its config file"};
+        shards.push_back(
+            make_unique<local_shard>(make_index<inverted_index>(*path)));
+    }
+    return make_unique<sharded_index>(std::move(shards));
+}
+
+uint64_t sharded_index::num_shards() const
+{
+    return shards_.size();
+}
+
+shard& sharded_index::get_shard(uint64_t idx)
+{
+    return *shards_.at(idx);
+}
+
+uint64_t sharded_index::num_docs() const
+{
+    return num_docs_;
+}
+
+uint64_t sharded_index::locate(doc_id d_id) const
+{
+    if (d_id >= num_docs_)
+        throw sharded_index_exception{"doc_id out of range: "
+                                      + std::to_string(d_id)};
+    auto it = std::upper_bound(first_docs_.begin(), first_docs_.end(),
+                               uint64_t{d_id});
+    return static_cast<uint64_t>(it - first_docs_.begin()) - 1;
+}
+
+std::string sharded_index::doc_path(doc_id d_id) const
+{
+    auto s = locate(d_id);
+    return shards_[s]->doc_path(doc_id{d_id - first_docs_[s]});
+}
+
+class_label sharded_index::label(doc_id d_id) const
+{
+    auto s = locate(d_id);
+    return shards_[s]->label(doc_id{d_id - first_docs_[s]});
+}
+
+std::vector<std::pair<doc_id, double>>
+    sharded_index::score(ranker& r, corpus::document& query,
+                         uint64_t num_results)
+{
+    if (shards_.empty() || num_results == 0)
+        return {};
+
+    if (query.counts().empty())
+    {
+        auto it = std::find_if(shards_.begin(), shards_.end(),
+                               [](const std::unique_ptr<shard>& s)
+                               {
+            return dynamic_cast<local_shard*>(s.get()) != nullptr;
+        });
+        if (it == shards_.end())
+            throw sharded_index_exception{
+                "queries must be tokenized when no shard is local"};
+        static_cast<local_shard&>(**it).index().tokenize(query);
+    }
+
+    std::vector<std::string> terms;
+    terms.reserve(query.counts().size());
+    for (const auto& count : query.counts())
+        terms.push_back(count.first);
+
+    // gather: each shard's share of the collection statistics
+    std::vector<std::future<std::vector<std::pair<uint64_t, uint64_t>>>>
+        term_stats;
+    for (auto& s : shards_)
+    {
+        auto sh = s.get();
+        term_stats.push_back(pool_.submit_task([sh, &terms]()
+                                               {
+            return sh->term_stats(terms);
+        }));
+    }
+
+    collection_stats stats;
+    stats.num_docs = num_docs_;
+    stats.total_terms = 0;
+    for (const auto& s : shards_)
+        stats.total_terms += s->total_corpus_terms();
+    stats.avg_dl = num_docs_ == 0 ? 0.0 : static_cast<double>(
+                                              stats.total_terms)
+                                              / num_docs_;
+    for (auto& fut : term_stats)
+    {
+        auto shard_stats = fut.get();
+        for (uint64_t i = 0; i < terms.size(); ++i)
+        {
+            auto& term = stats.terms[terms[i]];
+            term.first += shard_stats[i].first;
+            term.second += shard_stats[i].second;
+        }
+    }
+
+    // scatter: each shard's top documents under the global statistics
+    std::vector<std::future<std::vector<std::pair<doc_id, double>>>> parts;
+    for (auto& s : shards_)
+    {
+        auto sh = s.get();
+        parts.push_back(pool_.submit_task([&, sh]()
+                                          {
+            return sh->search(r, query, stats, num_results);
+        }));
+    }
+
+    std::vector<std::pair<doc_id, double>> results;
+    for (uint64_t i = 0; i < parts.size(); ++i)
+    {
+        for (const auto& result : parts[i].get())
+            results.emplace_back(doc_id{first_docs_[i] + result.first},
+                                 result.second);
+    }
+
+    // ties keep doc_id order, as they do in a single index
+    std::stable_sort(results.begin(), results.end(),
+                     [](const std::pair<doc_id, double>& a,
+                        const std::pair<doc_id, double>& b)
+                     {
+        return a.second > b.second;
+    });
+    if (results.size() > num_results)
+        results.resize(num_results);
+    return results;
+}
+}
+}
@@ -4,26 +4,45 @@
  */
 
 #include "index/string_list.h"
+#include "io/front_coding.h"
 
 namespace meta
 {
 namespace index
 {
 
-string_list::string_list(const std::string& path)
-    : string_file_{path}, index_{path + "_index"}
+string_list::string_list(const std::string& path) : index_{path + "_index"}
 {
-    // nothing
+    if (index_.size() < 2 || index_[1] == 0
+        || index_.size() != 2 + (index_[0] + index_[1] - 1) / index_[1])
+        throw string_list_exception{"invalid string list index: " + path
+                                    + "_index"};
+    if (index_[0] > 0)
+        string_file_ = io::mmap_file{path};
 }
 
-const char* string_list::at(uint64_t idx) const
+std::string string_list::at(uint64_t idx) const
 {
-    return string_file_.begin() + index_[idx];
+    auto block_size = index_[1];
+    auto block = idx / block_size;
+    io::front_coding::block_reader reader{string_file_->begin()
+                                          + index_[2 + block]};
+    for (auto i = block * block_size; i < idx; ++i)
+        reader.next();
+    return reader.next();
+}
+
+util::memory_usage string_list::memory_usage() const
+{
+    auto usage = index_.memory_usage();
+    if (string_file_)
+        usage += string_file_->memory_usage();
+    return usage;
 }
 
 uint64_t string_list::size() const
 {
-    return index_.size();
+    return index_[0];
 }
 }
 }
@@ -4,7 +4,12 @@
  */
 
 #include "io/binary.h"
+#include "io/front_coding.h"
+#include "io/mmap_file.h"
 #include "index/string_list_writer.h"
+#include "util/filesystem.h"
+#include "util/optional.h"
+#include "util/trace.h"
 #if !META_HAS_STREAM_MOVE
 #include "util/shim.h"
 #endif
@@ -14,39 +19,98 @@ namespace meta
 namespace index
 {
 
-string_list_writer::string_list_writer(const std::string& path, uint64_t size)
-    : string_file_{make_file(path)},
+string_list_writer::string_list_writer(const std::string& path, uint64_t size,
+                                       uint64_t block_size)
+    : path_{path},
+      string_file_{make_file(path + ".tmp")},
       write_pos_{0},
-      index_{path + "_index", size}
+      block_size_{block_size == 0 ? 1 : block_size},
+      positions_(size, 0)
 {
     // nothing
 }
 
 string_list_writer::string_list_writer(string_list_writer&& other)
-    : string_file_{std::move(other.string_file_)},
+    : path_{std::move(other.path_)},
+      string_file_{std::move(other.string_file_)},
       write_pos_{std::move(other.write_pos_)},
-      index_{std::move(other.index_)}
+      block_size_{std::move(other.block_size_)},
+      positions_{std::move(other.positions_)}
 {
-    // nothing
+    other.path_.clear();
 }
 
 string_list_writer& string_list_writer::operator=(string_list_writer&& other)
 {
     if (this != &other)
     {
+        if (!path_.empty())
+            compress();
+        path_ = std::move(other.path_);
         string_file_ = std::move(other.string_file_);
         write_pos_ = std::move(other.write_pos_);
-        index_ = std::move(other.index_);
+        block_size_ = std::move(other.block_size_);
+        positions_ = std::move(other.positions_);
+        other.path_.clear();
     }
     return *this;
 }
 
+string_list_writer::~string_list_writer()
+{
+    close();
+}
+
+void string_list_writer::close()
+{
+    if (!path_.empty())
+        compress();
+    path_.clear();
+}
+
 void string_list_writer::insert(uint64_t idx, const std::string& elem)
 {
     std::lock_guard<std::mutex> lock{mutex_};
-    index_[idx] = write_pos_;
+    if (idx >= positions_.size())
+        positions_.resize(idx + 1, 0);
+    positions_[idx] = write_pos_ + 1;
     io::write_binary(file(), elem);
     write_pos_ += elem.length() + 1;
 }
+
+void string_list_writer::compress()
+{
+    trace::scoped_event event{"compress_string_list", "index"};
+    file().close();
+    auto staged_path = path_ + ".tmp";
+    {
+        util::optional<io::mmap_file> staged;
+        if (write_pos_ > 0)
+            staged = io::mmap_file{staged_path};
+
+        std::ofstream output{path_, std::ios::binary};
+        std::ofstream index{path_ + "_index", std::ios::binary};
+        io::write_binary(index, static_cast<uint64_t>(positions_.size()));
+        io::write_binary(index, block_size_);
+
+        std::string previous;
+        std::string current;
+        uint64_t output_pos = 0;
+        for (uint64_t i = 0; i < positions_.size(); ++i)
+        {
+            auto block_start = i % block_size_ == 0;
+            if (block_start)
+                io::write_binary(index, output_pos);
+            if (positions_[i] == 0)
+                current.clear();
+            else
+                current = staged->begin() + positions_[i] - 1;
+            output_pos += io::front_coding::write(output, previous, current,
+                                                  block_start);
+            std::swap(previous, current);
+        }
+    }
+    filesystem::delete_file(staged_path);
+}
 }
 }
@@ -0,0 +1,64 @@
+/**
+ * @file autocomplete.cpp
+ */
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+#include "cpptoml.h"
+#include "index/completion_index.h"
+#include "index/inverted_index.h"
+#include "logging/logger.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+
+using namespace meta;
+
+/**
+ * Suggests completions of prefixes typed by the user, from the
+ * completion_index of the inverted index of the config file, which is
+ * built first if the index lacks one.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage:\t" << argv[0] << " configFile" << std::endl;
+        return 1;
+    }
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    auto config = cpptoml::parse_file(argv[1]);
+    auto idx = index::make_index<index::inverted_index>(argv[1]);
+    if (!index::completion_index::exists(*idx))
+        index::completion_index::build(*idx,
+                                       index::make_completion_options(config));
+    index::completion_index completions{*idx};
+
+    std::cout << "Enter a prefix, or blank to quit." << std::endl << std::endl;
+
+    std::string prefix;
+    while (true)
+    {
+        std::cout << "> ";
+        std::getline(std::cin, prefix);
+        if (prefix.empty())
+            break;
+
+        auto start = std::chrono::steady_clock::now();
+        auto results = completions.complete(prefix, 10);
+        auto micros = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - start);
+
+        for (const auto& result : results)
+            std::cout << "  " << result.first << " (" << result.second << ")"
+                      << std::endl;
+        std::cout << results.size() << " completions (" << micros.count()
+                  << "us)" << std::endl << std::endl;
+    }
+}
@@ -0,0 +1,96 @@
+/**
+ * @file distributed-index.cpp
+ */
+
+#include <iostream>
+#include <string>
+
+#include "index/distributed_build.h"
+#include "index/inverted_index.h"
+#include "logging/logger.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+#include "util/time.h"
+
+using namespace meta;
+
+namespace
+{
+/**
+ * Prints the usage of this program.
+ * @param prog The name of the program
+ * @return the exit code for this program
+ */
+int print_usage(const std::string& prog)
+{
+    std::cerr << "Usage:\t" << prog << " configFile plan NUM_PARTS"
+              << std::endl;
+    std::cerr << "\t" << prog << " configFile build PART" << std::endl;
+    std::cerr << "\t" << prog << " configFile merge" << std::endl;
+    std::cerr << "\t" << prog << " configFile shard shardedConfigFile"
+              << std::endl;
+    std::cerr << "Builds an index on several machines sharing a filesystem: "
+                 "plan splits the" << std::endl;
+    std::cerr << "corpus, build indexes one part (on any machine, in any "
+                 "order), and merge" << std::endl;
+    std::cerr << "combines the parts into the configured index, or shard "
+                 "serves them as the" << std::endl;
+    std::cerr << "shards of a sharded index." << std::endl;
+    return 1;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+        return print_usage(argv[0]);
+
+    std::string config = argv[1];
+    std::string command = argv[2];
+    if ((command == "merge") != (argc == 3) || argc > 4)
+        return print_usage(argv[0]);
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    auto time = common::time([&]()
+    {
+        if (command == "plan")
+        {
+            auto plan = index::plan_build(config, std::stoul(argv[3]));
+            for (uint64_t i = 0; i < plan.parts.size(); ++i)
+                std::cout << "Part " << i << ": " << plan.parts[i].num_docs
+                          << " documents" << std::endl;
+        }
+        else if (command == "build")
+        {
+            auto idx = index::build_part(config, std::stoul(argv[3]));
+            std::cout << "Documents: " << idx->num_docs() << std::endl;
+            std::cout << "Unique Terms: " << idx->unique_terms()
+                      << std::endl;
+        }
+        else if (command == "merge")
+        {
+            auto idx = index::merge_parts(config);
+            std::cout << "Documents: " << idx->num_docs() << std::endl;
+            std::cout << "Unique Terms: " << idx->unique_terms()
+                      << std::endl;
+        }
+        else if (command == "shard")
+        {
+            index::write_shard_configs(config, argv[3]);
+            std::cout << "Wrote " << argv[3] << std::endl;
+        }
+        else
+        {
+            throw index::distributed_build_exception{"unknown command: "
+                                                     + command};
+        }
+    });
+
+    std::cout << "Took: " << time.count() / 1000.0 << " seconds"
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file export-libsvm.cpp
+ */
+
+#include <fstream>
+#include <iostream>
+#include "index/forward_index.h"
+#include "logging/logger.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+
+using namespace meta;
+
+/**
+ * Writes the documents of a forward index in libsvm format, one line per
+ * document, with each document's label_id as its class.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage:\t" << argv[0] << " configFile outputFile"
+                  << std::endl;
+        return 1;
+    }
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    auto idx = index::make_index<index::forward_index>(argv[1]);
+
+    std::ofstream out{argv[2]};
+    for (const auto& d_id : idx->docs())
+        out << idx->liblinear_data(d_id) << '\n';
+
+    return 0;
+}
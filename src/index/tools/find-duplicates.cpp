@@ -0,0 +1,77 @@
+/**
+ * @file find-duplicates.cpp
+ */
+
+#include <iostream>
+#include <string>
+
+#include "cpptoml.h"
+#include "index/forward_index.h"
+#include "index/inverted_index.h"
+#include "index/near_duplicates.h"
+#include "logging/logger.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+#include "util/shim.h"
+#include "util/time.h"
+
+using namespace meta;
+
+/**
+ * Finds the near duplicates among the documents of a corpus, as set by the
+ * `[dedup]` table of the config file, and prints each cluster of them on a
+ * line of doc_ids, the document kept first. With --delete, every document
+ * but the first of each cluster is deleted from the inverted index of the
+ * config file, so that rankers never return it.
+ */
+int main(int argc, char* argv[])
+{
+    bool remove = argc == 3 && std::string{argv[2]} == "--delete";
+    if (argc != 2 && !remove)
+    {
+        std::cerr << "Usage:\t" << argv[0] << " configFile [--delete]"
+                  << std::endl;
+        return 1;
+    }
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    auto config = cpptoml::parse_file(argv[1]);
+    auto options = index::make_dedup_options(config);
+    auto fwd = index::make_index<index::forward_index>(argv[1]);
+
+    std::unique_ptr<index::near_duplicates> dups;
+    auto time = common::time([&]()
+    {
+        dups = make_unique<index::near_duplicates>(
+            index::find_near_duplicates(*fwd, options));
+    });
+
+    for (const auto& cluster : dups->clusters())
+    {
+        for (uint64_t i = 0; i < cluster.size(); ++i)
+            std::cout << (i ? " " : "") << cluster[i];
+        std::cout << std::endl;
+    }
+
+    auto duplicates = dups->duplicates();
+    std::cerr << "Clusters: " << dups->clusters().size() << std::endl;
+    std::cerr << "Duplicates: " << duplicates.size() << " of "
+              << fwd->num_docs() << std::endl;
+    std::cerr << "Detection took: " << time.count() / 1000.0 << " seconds"
+              << std::endl;
+
+    if (remove)
+    {
+        // the doc_ids of a forward and an inverted index of one corpus
+        // agree, so the duplicates are deleted under the same ids
+        auto inv = index::make_index<index::inverted_index>(argv[1]);
+        inv->delete_docs(duplicates);
+        std::cerr << "Deleted: " << duplicates.size() << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,133 @@
+/**
+ * @file index-vectors.cpp
+ */
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "cpptoml.h"
+#include "index/inverted_index.h"
+#include "index/ivf_index.h"
+#include "index/vector_store.h"
+#include "logging/logger.h"
+#include "parallel/default_pool.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+#include "util/time.h"
+
+using namespace meta;
+
+/**
+ * Stores dense vectors of the documents of an index, as set by the
+ * `[vectors]` table of the config file: `embeddings` is a text file with
+ * a line per document of its doc_id and the elements of its vector, and
+ * `path` the directory of the vector_store. `encoding` ("float32" or
+ * "int8") is optional, as are `ivf = true`, which also saves an ivf_index
+ * as path/ivf, and its `lists` and `iterations`.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage:\t" << argv[0] << " configFile" << std::endl;
+        return 1;
+    }
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
+
+    auto group = config.get_table("vectors");
+    if (!group)
+    {
+        std::cerr << "Missing vectors configuration group in " << argv[1]
+                  << std::endl;
+        return 1;
+    }
+
+    auto embeddings = group->get_as<std::string>("embeddings");
+    auto path = group->get_as<std::string>("path");
+    if (!embeddings || !path)
+    {
+        std::cerr << "vectors configuration group needs embeddings and path"
+                  << std::endl;
+        return 1;
+    }
+
+    auto encoding = index::vector_encoding::float32;
+    if (auto name = group->get_as<std::string>("encoding"))
+    {
+        if (*name == "int8")
+            encoding = index::vector_encoding::int8;
+        else if (*name != "float32")
+        {
+            std::cerr << "Unknown vector encoding: " << *name << std::endl;
+            return 1;
+        }
+    }
+
+    auto idx = index::make_index<index::inverted_index>(argv[1]);
+
+    std::ifstream in{*embeddings};
+    std::string line;
+    std::unique_ptr<index::vector_store_writer> writer;
+    uint64_t num_vectors = 0;
+    auto time = common::time([&]()
+    {
+        std::vector<float> vec;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields{line};
+            uint64_t d_id;
+            if (!(fields >> d_id))
+                continue;
+            vec.clear();
+            float x;
+            while (fields >> x)
+                vec.push_back(x);
+
+            if (!writer)
+                writer = make_unique<index::vector_store_writer>(
+                    *path, idx->num_docs(), vec.size(), encoding);
+            writer->insert(doc_id{d_id}, vec);
+            ++num_vectors;
+        }
+    });
+    if (!writer)
+    {
+        std::cerr << "No vectors in " << *embeddings << std::endl;
+        return 1;
+    }
+    writer.reset();
+    std::cerr << "Stored " << num_vectors << " vectors in "
+              << time.count() / 1000.0 << " seconds" << std::endl;
+
+    auto build_ivf = group->get_as<bool>("ivf");
+    if (!build_ivf || !*build_ivf)
+        return 0;
+
+    index::ivf_options options;
+    if (auto lists = group->get_as<int64_t>("lists"))
+        options.lists = static_cast<uint64_t>(*lists);
+    if (auto iterations = group->get_as<int64_t>("iterations"))
+        options.iterations = static_cast<uint64_t>(*iterations);
+
+    index::vector_store store{*path};
+    std::unique_ptr<index::ivf_index> ivf;
+    time = common::time([&]()
+    {
+        ivf = make_unique<index::ivf_index>(store, options,
+                                            parallel::default_pool());
+    });
+    ivf->save(*path + "/ivf");
+    std::cerr << "Built " << ivf->lists() << " lists in "
+              << time.count() / 1000.0 << " seconds" << std::endl;
+    return 0;
+}
@@ -11,6 +11,7 @@
 #include "corpus/document.h"
 #include "index/inverted_index.h"
 #include "index/ranker/ranker_factory.h"
+#include "parallel/default_pool.h"
 #include "parser/analyzers/tree_analyzer.h"
 #include "sequence/analyzers/ngram_pos_analyzer.h"
 #include "util/printing.h"
@@ -57,6 +58,7 @@ int main(int argc, char* argv[])
 
     // Create a ranking class based on the config file.
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
     auto group = config.get_table("ranker");
     if (!group)
         throw std::runtime_error{"\"ranker\" group needed in config file!"};
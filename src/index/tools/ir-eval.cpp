@@ -0,0 +1,186 @@
+/**
+ * @file ir-eval.cpp
+ */
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "corpus/document.h"
+#include "cpptoml.h"
+#include "index/eval/ir_eval.h"
+#include "index/inverted_index.h"
+#include "index/ranker/ranker_factory.h"
+#include "logging/logger.h"
+#include "parallel/default_pool.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+#include "util/time.h"
+
+using namespace meta;
+
+namespace
+{
+/// the number of queries scored and evaluated at once, which bounds the
+/// number of result lists held in memory
+const uint64_t batch_size = 1024;
+
+/**
+ * Prints the usage of this program.
+ * @param prog The name of the program
+ * @return the exit code for this program
+ */
+int print_usage(const std::string& prog)
+{
+    std::cerr << "Usage:\t" << prog
+              << " configFile [--results N] [--per-query]" << std::endl;
+    std::cerr << "\t--results N\tresults retrieved and evaluated per query "
+                 "(default 1000)" << std::endl;
+    std::cerr << "\t--per-query\tprint the scores of every query"
+              << std::endl;
+    return 1;
+}
+
+/**
+ * The sums of the scores of the queries evaluated so far.
+ */
+struct totals
+{
+    /// the number of queries
+    uint64_t queries = 0;
+    /// the sum of their scores
+    index::ir_eval::query_stats sum{0, 0, 0, 0, 0};
+
+    /**
+     * Adds the scores of a query.
+     * @param st The scores
+     */
+    void add(const index::ir_eval::query_stats& st)
+    {
+        ++queries;
+        sum.precision += st.precision;
+        sum.recall += st.recall;
+        sum.f1 += st.f1;
+        sum.ndcg += st.ndcg;
+        sum.avg_p += st.avg_p;
+    }
+
+    /**
+     * @param score The sum of a score
+     * @return the mean of the score
+     */
+    double mean(double score) const
+    {
+        return queries == 0 ? 0.0 : score / queries;
+    }
+};
+}
+
+/**
+ * Runs every query of the query file against an inverted index with the
+ * [ranker] of the config file and evaluates the results against the
+ * relevance judgements the config file names. The queries are scored in
+ * batches on a pool of threads (see index::ranker::score_batch), and each
+ * batch is evaluated in parallel (see index::ir_eval::evaluate).
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+        return print_usage(argv[0]);
+
+    uint64_t num_results = 1000;
+    bool per_query = false;
+    for (int i = 2; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg == "--per-query")
+            per_query = true;
+        else if (arg == "--results" && i + 1 < argc)
+            num_results = std::stoull(argv[++i]);
+        else
+            return print_usage(argv[0]);
+    }
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
+    auto group = config.get_table("ranker");
+    if (!group)
+        throw std::runtime_error{"\"ranker\" group needed in config file!"};
+    auto ranker = index::make_ranker(*group);
+
+    auto query_path = config.get_as<std::string>("querypath");
+    if (!query_path)
+        throw std::runtime_error{"config file needs a \"querypath\" parameter"};
+    std::ifstream query_file{*query_path
+                             + *config.get_as<std::string>("dataset")
+                             + "-queries.txt"};
+
+    auto start = config.get_as<int64_t>("query-id-start");
+    query_id q_id{start ? static_cast<uint64_t>(*start) : 1};
+
+    auto idx = index::make_index<index::inverted_index>(argv[1]);
+    index::ir_eval eval{argv[1]};
+    auto& pool = parallel::default_pool();
+    auto num_threads = pool.thread_ids().size();
+
+    totals total;
+    auto elapsed = common::time([&]()
+    {
+        std::string content;
+        bool more = true;
+        while (more)
+        {
+            std::vector<corpus::document> queries;
+            std::vector<query_id> q_ids;
+            while (queries.size() < batch_size
+                   && (more = static_cast<bool>(
+                           std::getline(query_file, content))))
+            {
+                queries.emplace_back("[user input]", doc_id{0});
+                queries.back().content(content);
+                q_ids.push_back(q_id++);
+            }
+            if (queries.empty())
+                break;
+
+            auto rankings = ranker->score_batch(*idx, queries, num_results,
+                                                num_threads);
+            auto stats = eval.evaluate(rankings, q_ids, num_results, pool);
+            for (uint64_t i = 0; i < stats.size(); ++i)
+            {
+                total.add(stats[i]);
+                if (!per_query)
+                    continue;
+                std::cout << q_ids[i] << std::fixed << std::setprecision(4)
+                          << "\tP: " << stats[i].precision
+                          << "\tR: " << stats[i].recall
+                          << "\tF1: " << stats[i].f1
+                          << "\tNDCG: " << stats[i].ndcg
+                          << "\tAP: " << stats[i].avg_p << std::endl;
+            }
+        }
+    });
+
+    std::cout << std::fixed << std::setprecision(4)
+              << "Queries: " << total.queries << std::endl
+              << "MAP: " << eval.map() << std::endl
+              << "gMAP: " << eval.gmap() << std::endl
+              << "NDCG@" << num_results << ": " << total.mean(total.sum.ndcg)
+              << std::endl
+              << "P@" << num_results << ": "
+              << total.mean(total.sum.precision) << std::endl
+              << "R@" << num_results << ": " << total.mean(total.sum.recall)
+              << std::endl
+              << "F1@" << num_results << ": " << total.mean(total.sum.f1)
+              << std::endl;
+    std::cout << "Elapsed time: " << elapsed.count() << "ms" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,52 @@
+/**
+ * @file merge-index.cpp
+ */
+
+#include <iostream>
+
+#include "index/inverted_index.h"
+#include "index/merging.h"
+#include "logging/logger.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+#include "util/time.h"
+
+using namespace meta;
+
+/**
+ * Merges existing inverted indexes into one, without tokenizing their
+ * documents again: the index named by the first configuration holds the
+ * documents of the indexes named by the others, in order.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+    {
+        std::cerr << "Usage:\t" << argv[0]
+                  << " mergedConfigFile configFile [configFile...]"
+                  << std::endl;
+        return 1;
+    }
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    std::vector<std::shared_ptr<index::inverted_index>> sources;
+    for (int i = 2; i < argc; ++i)
+        sources.push_back(index::make_index<index::inverted_index>(argv[i]));
+
+    std::shared_ptr<index::inverted_index> merged;
+    auto time = common::time([&]()
+    {
+        merged = index::merge_indexes(sources, argv[1]);
+    });
+
+    std::cout << "Documents: " << merged->num_docs() << std::endl;
+    std::cout << "Unique Terms: " << merged->unique_terms() << std::endl;
+    std::cout << "Merging took: " << time.count() / 1000.0 << " seconds"
+              << std::endl;
+
+    return 0;
+}
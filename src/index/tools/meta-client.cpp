@@ -0,0 +1,114 @@
+/**
+ * @file meta-client.cpp
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <iostream>
+#include <string>
+
+#include "index/search_client.h"
+
+using namespace meta;
+
+namespace
+{
+/**
+ * Prints the usage of this program.
+ * @param prog The name of the program
+ * @return the exit code for this program
+ */
+int print_usage(const std::string& prog)
+{
+    std::cerr << "Usage:\t" << prog << " socket index [OPTION]..."
+              << std::endl;
+    std::cerr << "Sends the queries on standard input, one per line, to a "
+                 "meta-server and prints" << std::endl;
+    std::cerr << "their results. [OPTION] is one or more of:" << std::endl;
+    std::cerr << "\t--batch N\tqueries per request (default 1)" << std::endl;
+    std::cerr << "\t--depth N\trequests in flight at once (default 16)"
+              << std::endl;
+    std::cerr << "\t--results N\tresults per query (default 10)"
+              << std::endl;
+    return 1;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+        return print_usage(argv[0]);
+
+    uint64_t batch = 1;
+    uint64_t depth = 16;
+    uint32_t num_results = 10;
+    for (int i = 3; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (i + 1 == argc)
+            return print_usage(argv[0]);
+        auto value = std::stoul(argv[++i]);
+        if (arg == "--batch")
+            batch = std::max<uint64_t>(1, value);
+        else if (arg == "--depth")
+            depth = std::max<uint64_t>(1, value);
+        else if (arg == "--results")
+            num_results = static_cast<uint32_t>(value);
+        else
+            return print_usage(argv[0]);
+    }
+
+    index::search_client client{argv[1]};
+
+    // requests are pipelined up to the depth, and their results printed
+    // in the order of the queries
+    std::deque<std::pair<uint64_t, std::vector<std::string>>> in_flight;
+    uint64_t num_queries = 0;
+    auto print_oldest = [&]()
+    {
+        auto resp = client.receive(in_flight.front().first);
+        const auto& queries = in_flight.front().second;
+        if (!resp.error.empty())
+            std::cerr << "Error: " << resp.error << std::endl;
+        for (uint64_t q = 0; q < resp.results.size(); ++q)
+        {
+            std::cout << "Query: " << queries[q] << std::endl;
+            uint64_t rank = 1;
+            for (const auto& res : resp.results[q])
+                std::cout << rank++ << ". " << res.path << " (" << res.d_id
+                          << ") " << res.score << std::endl;
+            std::cout << std::endl;
+        }
+        in_flight.pop_front();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    index::protocol::request req;
+    req.index = argv[2];
+    req.num_results = num_results;
+    req.with_paths = true;
+    std::string line;
+    bool more = true;
+    while (more)
+    {
+        more = static_cast<bool>(std::getline(std::cin, line));
+        if (more)
+            req.queries.push_back(line);
+        if (req.queries.size() == batch || (!more && !req.queries.empty()))
+        {
+            num_queries += req.queries.size();
+            if (in_flight.size() == depth)
+                print_oldest();
+            in_flight.emplace_back(client.send(req), req.queries);
+            req.queries.clear();
+        }
+    }
+    while (!in_flight.empty())
+        print_oldest();
+
+    auto millis = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    std::cerr << num_queries << " queries in " << millis.count() << "ms"
+              << std::endl;
+}
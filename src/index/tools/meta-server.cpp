@@ -0,0 +1,57 @@
+/**
+ * @file meta-server.cpp
+ */
+
+#include <csignal>
+#include <iostream>
+#include <thread>
+
+#include "cpptoml.h"
+#include "index/search_server.h"
+#include "logging/logger.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+
+using namespace meta;
+
+/**
+ * Serves the indexes of a config file (see search_server) until it is
+ * interrupted.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage:\t" << argv[0] << " configFile" << std::endl;
+        return 1;
+    }
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    // the signals are blocked before the server starts its threads, so
+    // that they all inherit the mask and only the waiting thread sees them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    auto config = cpptoml::parse_file(argv[1]);
+    index::search_server server{config};
+
+    std::thread{[&]()
+                {
+        int signal;
+        sigwait(&signals, &signal);
+        LOG(info) << "Stopping on signal " << signal << ENDLG;
+        server.stop();
+    }}.detach();
+
+    LOG(info) << "Serving on "
+              << *config.get_table("server")->get_as<std::string>("socket")
+              << ENDLG;
+    server.run();
+}
@@ -0,0 +1,78 @@
+/**
+ * @file prune-index.cpp
+ */
+
+#include <iostream>
+
+#include "cpptoml.h"
+#include "index/inverted_index.h"
+#include "index/postings_cursor.h"
+#include "index/pruning.h"
+#include "index/ranker/ranker_factory.h"
+#include "logging/logger.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+#include "util/time.h"
+
+using namespace meta;
+
+namespace
+{
+/**
+ * @param idx An index
+ * @return the number of postings in the index
+ */
+uint64_t num_postings(index::inverted_index& idx)
+{
+    uint64_t total = 0;
+    for (term_id t_id{0}; t_id < idx.unique_terms(); ++t_id)
+        total += idx.cursor(t_id).size();
+    return total;
+}
+}
+
+/**
+ * Creates a pruned copy of an index for serving: the postings that score
+ * highest under the source configuration's ranker are written to the
+ * index named by the second configuration, as chosen by the `[pruning]`
+ * table of the source configuration.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage:\t" << argv[0] << " configFile prunedConfigFile"
+                  << std::endl;
+        return 1;
+    }
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    auto config = cpptoml::parse_file(argv[1]);
+    auto group = config.get_table("ranker");
+    if (!group)
+        throw std::runtime_error{"\"ranker\" group needed in config file!"};
+    auto ranker = index::make_ranker(*group);
+    auto options = index::make_pruning_options(config);
+
+    auto source = index::make_index<index::inverted_index>(argv[1]);
+    std::shared_ptr<index::inverted_index> pruned;
+    auto time = common::time([&]()
+    {
+        pruned = index::prune_index(source, *ranker, argv[2], options);
+    });
+
+    auto before = num_postings(*source);
+    auto after = num_postings(*pruned);
+    std::cout << "Postings: " << after << " of " << before << " ("
+              << (before ? 100.0 * after / before : 0) << "%)" << std::endl;
+    std::cout << "Unique Terms: " << pruned->unique_terms() << " of "
+              << source->unique_terms() << std::endl;
+    std::cout << "Pruning took: " << time.count() / 1000.0 << " seconds"
+              << std::endl;
+
+    return 0;
+}
@@ -3,9 +3,14 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
 #include <vector>
 #include <string>
 #include <iostream>
+#include <thread>
 
 #include "util/time.h"
 #include "corpus/document.h"
@@ -13,20 +18,200 @@
 #include "index/ranker/ranker_factory.h"
 #include "parser/analyzers/tree_analyzer.h"
 #include "sequence/analyzers/ngram_pos_analyzer.h"
+#include "parallel/default_pool.h"
 
 using namespace meta;
 
+namespace
+{
+/**
+ * The settings of a load test.
+ */
+struct load_options
+{
+    /// the number of client threads sending queries
+    uint64_t clients = 1;
+    /// the rate at which queries are sent, or 0 for each client to send
+    /// its next query as soon as the last one is answered
+    double qps = 0;
+    /// the number of queries measured
+    uint64_t requests = 10000;
+    /// the number of queries sent, and not measured, before them
+    uint64_t warmup = 1000;
+};
+
+/**
+ * Prints the usage of this program.
+ * @param prog The name of the program
+ * @return the exit code for this program
+ */
+int print_usage(const std::string& prog)
+{
+    std::cerr << "Usage:\t" << prog << " configFile [--load [OPTION]...]"
+              << std::endl;
+    std::cerr << "With --load, the queries are sent repeatedly by "
+                 "concurrent clients, and their" << std::endl;
+    std::cerr << "latencies are reported instead of their results. "
+                 "[OPTION] is one or more of:" << std::endl;
+    std::cerr << "\t--clients N\tclient threads (default 1)" << std::endl;
+    std::cerr << "\t--qps RATE\tsend queries at a fixed total rate (open "
+                 "loop); by default" << std::endl;
+    std::cerr << "\t\t\teach client waits for its last answer (closed "
+                 "loop)" << std::endl;
+    std::cerr << "\t--requests N\tqueries measured (default 10000)"
+              << std::endl;
+    std::cerr << "\t--warmup N\tqueries sent before measuring (default "
+                 "1000)" << std::endl;
+    std::cerr << "Every [[sweep]] ranker group in the config file is "
+                 "tested in turn, or the" << std::endl;
+    std::cerr << "[ranker] group if there are none." << std::endl;
+    return 1;
+}
+
+/**
+ * Sends queries from several client threads and records how long each
+ * took to be answered.
+ * @param idx The index to search
+ * @param r The ranker to score with
+ * @param queries The queries, already tokenized, which are sent in turn
+ * @param opts The settings of the test
+ * @param first The number of the first query sent
+ * @param count The number of queries to send
+ * @param latencies Where to store each query's latency, or null if they
+ * are not recorded
+ * @return the time taken to send and answer all of the queries
+ */
+std::chrono::nanoseconds
+    send_queries(index::dblru_inverted_index& idx, index::ranker& r,
+                 std::vector<corpus::document>& queries,
+                 const load_options& opts, uint64_t first, uint64_t count,
+                 std::vector<std::chrono::nanoseconds>* latencies)
+{
+    using clock = std::chrono::steady_clock;
+    std::atomic<uint64_t> next{0};
+    auto start = clock::now();
+    auto interval = opts.qps > 0
+                        ? std::chrono::duration<double>{1.0 / opts.qps}
+                        : std::chrono::duration<double>{0};
+
+    auto client = [&]()
+    {
+        for (auto i = next++; i < count; i = next++)
+        {
+            // with a fixed rate, every query has a time it should be sent
+            // at, and its latency counts from then, so that queries held
+            // up behind a slow one are not left out of the tail
+            auto sent = clock::now();
+            if (opts.qps > 0)
+            {
+                sent = start + std::chrono::duration_cast<clock::duration>(
+                                   interval * static_cast<double>(i));
+                std::this_thread::sleep_until(sent);
+            }
+            // the ranker only reads a query that is already tokenized, so
+            // the clients may share them
+            auto& query = queries[(first + i) % queries.size()];
+            auto results = r.score(idx, query, 10);
+            if (latencies)
+                (*latencies)[i] = clock::now() - sent;
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < opts.clients; ++t)
+        threads.emplace_back(client);
+    for (auto& thread : threads)
+        thread.join();
+    return clock::now() - start;
+}
+
+/**
+ * Runs a load test of one ranker and prints its throughput, latency
+ * percentiles and postings cache hit rate.
+ * @param idx The index to search
+ * @param r The ranker to score with
+ * @param queries The queries, already tokenized
+ * @param opts The settings of the test
+ */
+void load_test(index::dblru_inverted_index& idx, index::ranker& r,
+               std::vector<corpus::document>& queries,
+               const load_options& opts)
+{
+    // every ranker starts from an empty cache, warmed by the same queries
+    idx.clear_cache();
+    send_queries(idx, r, queries, opts, 0, opts.warmup, nullptr);
+    auto before = idx.cache_stats();
+
+    std::vector<std::chrono::nanoseconds> latencies(opts.requests);
+    auto elapsed = send_queries(idx, r, queries, opts, opts.warmup,
+                                opts.requests, &latencies);
+    auto after = idx.cache_stats();
+    std::sort(latencies.begin(), latencies.end());
+
+    auto percentile = [&](double p)
+    {
+        auto rank = static_cast<uint64_t>(p * latencies.size());
+        rank = std::min<uint64_t>(rank, latencies.size() - 1);
+        auto latency = latencies[rank];
+        return std::chrono::duration<double, std::milli>{latency}.count();
+    };
+    auto seconds = std::chrono::duration<double>{elapsed}.count();
+    auto hits = after.hits - before.hits;
+    auto lookups = hits + after.misses - before.misses;
+
+    std::cout << r.parameters() << std::endl;
+    std::cout << std::fixed << std::setprecision(3)
+              << "  requests: " << opts.requests << " in " << seconds
+              << "s (" << opts.requests / seconds << " QPS)" << std::endl;
+    std::cout << "  latency (ms): p50 " << percentile(0.5) << ", p90 "
+              << percentile(0.9) << ", p99 " << percentile(0.99) << ", p999 "
+              << percentile(0.999) << ", max " << percentile(1.0)
+              << std::endl;
+    std::cout << "  postings cache hit rate: "
+              << (lookups == 0 ? 0.0 : 100.0 * hits / lookups) << "%"
+              << std::endl;
+}
+}
+
 /**
  * Demo app to read a file with one query per line and run each query on an
- * inverted index.
+ * inverted index. With --load, it is instead a load generator that sends
+ * the queries from concurrent clients and reports throughput and latency.
  */
 int main(int argc, char* argv[])
 {
-    if (argc != 2)
+    if (argc < 2)
+        return print_usage(argv[0]);
+
+    bool load = false;
+    load_options opts;
+    for (int i = 2; i < argc; ++i)
     {
-        std::cerr << "Usage:\t" << argv[0] << " configFile" << std::endl;
-        return 1;
+        std::string arg = argv[i];
+        if (arg == "--load")
+        {
+            load = true;
+            continue;
+        }
+        if (i + 1 == argc)
+            return print_usage(argv[0]);
+
+        std::string value = argv[++i];
+        if (arg == "--clients")
+            opts.clients = std::stoull(value);
+        else if (arg == "--qps")
+            opts.qps = std::stod(value);
+        else if (arg == "--requests")
+            opts.requests = std::stoull(value);
+        else if (arg == "--warmup")
+            opts.warmup = std::stoull(value);
+        else
+            return print_usage(argv[0]);
     }
+    if (argc > 2 && !load)
+        return print_usage(argv[0]);
+    if (opts.clients == 0 || opts.requests == 0)
+        return print_usage(argv[0]);
 
     // Log to standard error
     logging::set_cerr_logging();
@@ -43,6 +228,7 @@ int main(int argc, char* argv[])
 
     // Create a ranking class based on the config file.
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
     auto group = config.get_table("ranker");
     if (!group)
         throw std::runtime_error{"\"ranker\" group needed in config file!"};
@@ -53,24 +239,50 @@ int main(int argc, char* argv[])
     if (!query_path)
         throw std::runtime_error{"config file needs a \"querypath\" parameter"};
 
-    std::ifstream queries{*query_path + *config.get_as<std::string>("dataset")
-                          + "-queries.txt"};
+    std::ifstream query_file{*query_path
+                             + *config.get_as<std::string>("dataset")
+                             + "-queries.txt"};
+    std::vector<corpus::document> queries;
     std::string content;
-    auto elapsed_seconds = common::time([&]()
+    // only look at first 500 queries, unless load testing
+    while ((load || queries.size() < 500) && std::getline(query_file, content))
     {
-        size_t i = 1;
-        while (queries.good() && i <= 500) // only look at first 500 queries
+        queries.emplace_back("[user input]", doc_id{0});
+        queries.back().content(content);
+    }
+
+    if (load)
+    {
+        if (queries.empty())
+            throw std::runtime_error{"no queries to send"};
+
+        // the queries are tokenized once, so that the clients only share
+        // them for reading and the latencies are those of scoring
+        for (auto& query : queries)
+            idx->tokenize(query);
+
+        auto sweep = config.get_table_array("sweep");
+        if (!sweep)
         {
-            std::getline(queries, content);
-            corpus::document query{"[user input]", doc_id{0}};
-            query.content(content);
-            std::cout << "Ranking query " << i++ << ": " << query.path()
-                      << std::endl;
+            load_test(*idx, *ranker, queries, opts);
+            return 0;
+        }
+        for (const auto& group : sweep->get())
+            load_test(*idx, *index::make_ranker(*group), queries, opts);
+        return 0;
+    }
 
-            // Use the ranker to score the query over the index. By default, the
-            //  ranker returns 10 documents, so we will display the "top 10 of
-            //  10" docs.
-            auto ranking = ranker->score(*idx, query);
+    auto elapsed_seconds = common::time([&]()
+    {
+        // Use the ranker to score all of the queries over the index at once,
+        //  spread over all available threads. By default, the ranker returns
+        //  10 documents per query, so we will display the "top 10 of 10" docs.
+        auto rankings = ranker->score_batch(*idx, queries);
+        for (size_t q = 0; q < rankings.size(); ++q)
+        {
+            const auto& ranking = rankings[q];
+            std::cout << "Ranking query " << q + 1 << ": "
+                      << queries[q].path() << std::endl;
             std::cout << "Showing top 10 of " << ranking.size() << " results."
                       << std::endl;
 
@@ -85,6 +297,7 @@ int main(int argc, char* argv[])
 
     std::cout << "Elapsed time: " << elapsed_seconds.count() << "ms"
               << std::endl;
+    std::cout << "Postings cache: " << idx->cache_stats() << std::endl;
 
     return 0;
 }
@@ -0,0 +1,105 @@
+/**
+ * @file ranker-sweep.cpp
+ */
+
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "corpus/document.h"
+#include "cpptoml.h"
+#include "index/eval/ir_eval.h"
+#include "index/inverted_index.h"
+#include "index/ranker/ranker_factory.h"
+#include "logging/logger.h"
+#include "parallel/default_pool.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+#include "util/time.h"
+
+using namespace meta;
+
+/**
+ * Evaluates several ranker configurations on a query set at once, reading
+ * and decoding the postings of each query only once (see
+ * index::score_sweep). The configurations are the `[[sweep]]` tables of
+ * the config file, each of which is a ranker group; their MAP and mean
+ * NDCG is printed against the relevance judgements the config file names.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc != 2 && argc != 3)
+    {
+        std::cerr << "Usage:\t" << argv[0] << " configFile [numResults]"
+                  << std::endl;
+        return 1;
+    }
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
+    auto groups = config.get_table_array("sweep");
+    if (!groups)
+        throw std::runtime_error{"\"sweep\" groups needed in config file!"};
+
+    std::vector<std::unique_ptr<index::ranker>> rankers;
+    std::vector<index::ranker*> sweep;
+    for (const auto& group : groups->get())
+    {
+        rankers.push_back(index::make_ranker(*group));
+        sweep.push_back(rankers.back().get());
+    }
+
+    auto query_path = config.get_as<std::string>("querypath");
+    if (!query_path)
+        throw std::runtime_error{"config file needs a \"querypath\" parameter"};
+    std::ifstream query_file{*query_path
+                             + *config.get_as<std::string>("dataset")
+                             + "-queries.txt"};
+
+    uint64_t num_results = argc == 3 ? std::stoul(argv[2]) : 10;
+    auto start = config.get_as<int64_t>("query-id-start");
+    query_id q_id{start ? static_cast<uint64_t>(*start) : 1};
+
+    auto idx = index::make_index<index::inverted_index>(argv[1]);
+    index::ir_eval eval{argv[1]};
+    std::vector<std::vector<double>> ndcgs(sweep.size());
+    std::vector<index::ir_eval> evals(sweep.size(), eval);
+
+    auto elapsed = common::time([&]()
+    {
+        std::string content;
+        for (; std::getline(query_file, content); ++q_id)
+        {
+            corpus::document query{"[user input]", doc_id{0}};
+            query.content(content);
+            auto rankings = index::score_sweep(sweep, *idx, query,
+                                               num_results);
+            for (uint64_t i = 0; i < sweep.size(); ++i)
+            {
+                evals[i].avg_p(rankings[i], q_id, num_results);
+                ndcgs[i].push_back(
+                    evals[i].ndcg(rankings[i], q_id, num_results));
+            }
+        }
+    });
+
+    for (uint64_t i = 0; i < sweep.size(); ++i)
+    {
+        double ndcg = 0;
+        for (const auto& score : ndcgs[i])
+            ndcg += score;
+        if (!ndcgs[i].empty())
+            ndcg /= ndcgs[i].size();
+        std::cout << sweep[i]->parameters() << "\tMAP: " << evals[i].map()
+                  << "\tNDCG: " << ndcg << std::endl;
+    }
+    std::cout << "Elapsed time: " << elapsed.count() << "ms" << std::endl;
+
+    return 0;
+}
@@ -11,6 +11,7 @@
 #include "corpus/document.h"
 #include "index/inverted_index.h"
 #include "index/ranker/ranker_factory.h"
+#include "parallel/default_pool.h"
 #include "parser/analyzers/tree_analyzer.h"
 #include "sequence/analyzers/ngram_pos_analyzer.h"
 #include "util/time.h"
@@ -45,6 +46,7 @@ int main(int argc, char* argv[])
     auto idx = index::make_index<index::dblru_inverted_index>(argv[1], 10000);
 
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
 
     // Create a ranking class based on the config file.
     auto group = config.get_table("ranker");
@@ -0,0 +1,85 @@
+/**
+ * @file tier-postings.cpp
+ */
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "index/hot_terms.h"
+#include "index/inverted_index.h"
+#include "logging/logger.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+
+using namespace meta;
+
+namespace
+{
+/**
+ * Prints the usage of this program.
+ * @param prog The name of the program
+ * @return the exit code for this program
+ */
+int print_usage(const std::string& prog)
+{
+    std::cerr << "Usage:\t" << prog << " configFile doc-freq NUM_TERMS"
+              << std::endl;
+    std::cerr << "\t" << prog << " configFile queries queryLog NUM_TERMS"
+              << std::endl;
+    std::cerr << "\t" << prog << " configFile clear" << std::endl;
+    std::cerr << "Copies the postings of the terms in the most documents, or "
+                 "of those the query" << std::endl;
+    std::cerr << "log uses most, into the hot tier of the index (see "
+                 "hot-postings in the" << std::endl;
+    std::cerr << "configuration), or removes the hot tier." << std::endl;
+    return 1;
+}
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 3)
+        return print_usage(argv[0]);
+
+    std::string command = argv[2];
+    if ((command == "doc-freq" && argc != 4)
+        || (command == "queries" && argc != 5)
+        || (command == "clear" && argc != 3))
+        return print_usage(argv[0]);
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    auto idx = index::make_index<index::inverted_index>(argv[1]);
+
+    std::vector<term_id> terms;
+    if (command == "doc-freq")
+    {
+        terms = index::hot_terms_by_doc_freq(*idx, std::stoul(argv[3]));
+    }
+    else if (command == "queries")
+    {
+        std::ifstream queries{argv[3]};
+        if (!queries)
+        {
+            std::cerr << "Could not open " << argv[3] << std::endl;
+            return 1;
+        }
+        terms = index::hot_terms_from_queries(*idx, queries,
+                                              std::stoul(argv[4]));
+    }
+    else if (command != "clear")
+    {
+        return print_usage(argv[0]);
+    }
+
+    auto bytes = idx->tier_postings(terms);
+    std::cout << "Hot terms: " << terms.size() << " of "
+              << idx->unique_terms() << std::endl;
+    std::cout << "Hot tier: " << bytes / 1024.0 / 1024.0 << " MB"
+              << std::endl;
+    return 0;
+}
@@ -0,0 +1,60 @@
+/**
+ * @file tokenize-corpus.cpp
+ */
+
+#include <iostream>
+#include <vector>
+#include "analyzers/analyzer.h"
+#include "corpus/corpus.h"
+#include "corpus/tokenized_corpus.h"
+#include "cpptoml.h"
+#include "logging/logger.h"
+#include "parallel/thread_pool.h"
+#include "parser/analyzers/tree_analyzer.h"
+#include "sequence/analyzers/ngram_pos_analyzer.h"
+#include "util/progress.h"
+
+using namespace meta;
+
+/**
+ * Tokenizes the corpus of a configuration with its analyzers, once, and
+ * writes the counts of every document to a tokenized corpus that indexes
+ * can then be built from with corpus-type = "tokenized-corpus".
+ */
+int main(int argc, char* argv[])
+{
+    if (argc != 3)
+    {
+        std::cerr << "Usage:\t" << argv[0] << " configFile outputFile"
+                  << std::endl;
+        return 1;
+    }
+
+    logging::set_cerr_logging();
+
+    parser::register_analyzers();
+    sequence::register_analyzers();
+
+    auto config = cpptoml::parse_file(argv[1]);
+    auto analyzer = analyzers::analyzer::load(config);
+    auto docs = corpus::corpus::load(argv[1]);
+
+    corpus::tokenized_corpus_writer writer{argv[2]};
+    parallel::thread_pool pool;
+    printing::progress progress{" > Tokenizing Docs: ", docs->size()};
+    std::vector<corpus::document> batch;
+    while (docs->has_next())
+    {
+        batch.clear();
+        while (batch.size() < 1024 && docs->has_next())
+            batch.push_back(docs->next());
+        analyzer->tokenize_all(batch.begin(), batch.end(), pool);
+        for (const auto& doc : batch)
+            writer.write(doc);
+        progress(batch.back().id());
+    }
+    progress.end();
+    writer.close();
+
+    return 0;
+}
@@ -0,0 +1,412 @@
+/**
+ * @file vector_store.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <queue>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+#include "index/vector_store.h"
+#include "parallel/parallel_for.h"
+#include "parallel/thread_pool.h"
+#include "util/dense_ops.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace index
+{
+
+namespace
+{
+/**
+ * @param encoding A vector encoding
+ * @return its name in the schema of a store
+ */
+std::string encoding_name(vector_encoding encoding)
+{
+    return encoding == vector_encoding::int8 ? "int8" : "float32";
+}
+
+/**
+ * @param dir The directory of a store
+ * @param name The name of one of its files
+ * @return the path of the file
+ */
+std::string store_path(const std::string& dir, const std::string& name)
+{
+    return dir + "/" + name;
+}
+
+/**
+ * Makes the directory of a store and removes one of its files, so that a
+ * disk_vector made at the returned path starts afresh.
+ * @param dir The directory of the store
+ * @param name The name of the file
+ * @return the path of the file
+ */
+std::string fresh_path(const std::string& dir, const std::string& name)
+{
+    filesystem::make_directory(dir);
+    auto path = store_path(dir, name);
+    filesystem::delete_file(path);
+    return path;
+}
+
+/// A document and its score
+using scored_doc = std::pair<doc_id, double>;
+
+/**
+ * Orders documents by decreasing score, and those with equal scores by
+ * increasing doc_id.
+ */
+struct better_doc
+{
+    bool operator()(const scored_doc& a, const scored_doc& b) const
+    {
+        if (a.second != b.second)
+            return a.second > b.second;
+        return a.first < b.first;
+    }
+};
+
+/**
+ * A min-heap of the best k documents seen so far.
+ */
+class best_docs
+{
+  public:
+    best_docs(uint64_t k) : k_{k}
+    {
+        // nothing
+    }
+
+    void push(doc_id d_id, double score)
+    {
+        if (k_ == 0)
+            return;
+        if (heap_.size() < k_)
+            heap_.emplace(d_id, score);
+        else if (better_doc{}(scored_doc{d_id, score}, heap_.top()))
+        {
+            heap_.pop();
+            heap_.emplace(d_id, score);
+        }
+    }
+
+    void drain(std::vector<scored_doc>& out)
+    {
+        while (!heap_.empty())
+        {
+            out.push_back(heap_.top());
+            heap_.pop();
+        }
+    }
+
+  private:
+    uint64_t k_;
+    std::priority_queue<scored_doc, std::vector<scored_doc>, better_doc>
+        heap_;
+};
+
+/**
+ * Sorts documents best first and keeps the best k of them.
+ * @param docs The documents
+ * @param k The number to keep
+ */
+void keep_best(std::vector<scored_doc>& docs, uint64_t k)
+{
+    std::sort(docs.begin(), docs.end(), better_doc{});
+    if (docs.size() > k)
+        docs.resize(k);
+}
+}
+
+namespace internal
+{
+float dot_int8_scalar(const float* query, const int8_t* x, uint64_t size)
+{
+    uint64_t i = 0;
+    float sums[4] = {0, 0, 0, 0};
+    for (; i + 4 <= size; i += 4)
+    {
+        sums[0] += query[i] * x[i];
+        sums[1] += query[i + 1] * x[i + 1];
+        sums[2] += query[i + 2] * x[i + 2];
+        sums[3] += query[i + 3] * x[i + 3];
+    }
+    auto result = (sums[0] + sums[1]) + (sums[2] + sums[3]);
+    for (; i < size; ++i)
+        result += query[i] * x[i];
+    return result;
+}
+
+float dot_int8(const float* query, const int8_t* x, uint64_t size)
+{
+#if defined(__AVX2__)
+    uint64_t i = 0;
+    auto acc0 = _mm256_setzero_ps();
+    auto acc1 = _mm256_setzero_ps();
+    for (; i + 16 <= size; i += 16)
+    {
+        auto lo = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(x + i))));
+        auto hi = _mm256_cvtepi32_ps(_mm256_cvtepi8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(x + i + 8))));
+#if defined(__FMA__)
+        acc0 = _mm256_fmadd_ps(lo, _mm256_loadu_ps(query + i), acc0);
+        acc1 = _mm256_fmadd_ps(hi, _mm256_loadu_ps(query + i + 8), acc1);
+#else
+        acc0 = _mm256_add_ps(acc0,
+                             _mm256_mul_ps(lo, _mm256_loadu_ps(query + i)));
+        acc1 = _mm256_add_ps(
+            acc1, _mm256_mul_ps(hi, _mm256_loadu_ps(query + i + 8)));
+#endif
+    }
+    auto acc = _mm256_add_ps(acc0, acc1);
+    auto half = _mm_add_ps(_mm256_castps256_ps128(acc),
+                           _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    auto result = _mm_cvtss_f32(half);
+    for (; i < size; ++i)
+        result += query[i] * x[i];
+    return result;
+#else
+    return dot_int8_scalar(query, x, size);
+#endif
+}
+}
+
+vector_store_writer::vector_store_writer(const std::string& dir,
+                                         uint64_t num_docs, uint64_t dims,
+                                         vector_encoding encoding)
+    : dims_{dims},
+      encoding_{encoding},
+      norms_{fresh_path(dir, "norms"), num_docs}
+{
+    if (dims_ == 0)
+        throw vector_store_exception{"vectors must have some elements"};
+
+    // a new disk_vector's file is not all zeros, and a zero norm is how a
+    // document without a vector is told apart
+    for (uint64_t d = 0; d < num_docs; ++d)
+        norms_[d] = 0;
+
+    std::ofstream schema{store_path(dir, "schema")};
+    schema << num_docs << " " << dims_ << " " << encoding_name(encoding_)
+           << "\n";
+
+    if (encoding_ == vector_encoding::int8)
+    {
+        bytes_ = util::disk_vector<int8_t>{fresh_path(dir, "vectors"),
+                                           num_docs * dims_};
+        scales_ = util::disk_vector<float>{fresh_path(dir, "scales"),
+                                           num_docs};
+    }
+    else
+    {
+        floats_ = util::disk_vector<float>{fresh_path(dir, "vectors"),
+                                           num_docs * dims_};
+    }
+}
+
+void vector_store_writer::insert(doc_id d_id, const std::vector<float>& vec)
+{
+    if (vec.size() != dims_)
+        throw vector_store_exception{
+            "vector of document " + std::to_string(d_id) + " has "
+            + std::to_string(vec.size()) + " elements rather than "
+            + std::to_string(dims_)};
+    if (d_id >= norms_.size())
+        throw vector_store_exception{"document " + std::to_string(d_id)
+                                     + " is not in the store"};
+
+    double norm = 0;
+    float max_abs = 0;
+    for (const auto& x : vec)
+    {
+        norm += static_cast<double>(x) * x;
+        max_abs = std::max(max_abs, std::abs(x));
+    }
+    norms_[d_id] = static_cast<float>(std::sqrt(norm));
+
+    auto first = d_id * dims_;
+    if (encoding_ == vector_encoding::float32)
+    {
+        std::copy(vec.begin(), vec.end(), &(*floats_)[first]);
+        return;
+    }
+
+    auto scale = max_abs / 127;
+    (*scales_)[d_id] = scale;
+    for (uint64_t i = 0; i < dims_; ++i)
+    {
+        (*bytes_)[first + i] = static_cast<int8_t>(
+            scale > 0 ? std::lround(vec[i] / scale) : 0);
+    }
+}
+
+vector_store::vector_store(const std::string& dir)
+    : norms_{store_path(dir, "norms")}
+{
+    std::ifstream schema{store_path(dir, "schema")};
+    uint64_t num_docs;
+    std::string encoding;
+    if (!(schema >> num_docs >> dims_ >> encoding) || dims_ == 0)
+        throw vector_store_exception{"invalid vector schema in " + dir};
+
+    if (encoding == "int8")
+    {
+        encoding_ = vector_encoding::int8;
+        bytes_ = util::disk_vector<int8_t>{store_path(dir, "vectors")};
+        scales_ = util::disk_vector<float>{store_path(dir, "scales")};
+        if (bytes_->size() != num_docs * dims_ || scales_->size() != num_docs)
+            throw vector_store_exception{"truncated vectors in " + dir};
+    }
+    else if (encoding == "float32")
+    {
+        encoding_ = vector_encoding::float32;
+        floats_ = util::disk_vector<float>{store_path(dir, "vectors")};
+        if (floats_->size() != num_docs * dims_)
+            throw vector_store_exception{"truncated vectors in " + dir};
+    }
+    else
+        throw vector_store_exception{"unknown vector encoding: " + encoding};
+
+    if (norms_.size() != num_docs)
+        throw vector_store_exception{"truncated vectors in " + dir};
+}
+
+uint64_t vector_store::dims() const
+{
+    return dims_;
+}
+
+uint64_t vector_store::size() const
+{
+    return norms_.size();
+}
+
+vector_encoding vector_store::encoding() const
+{
+    return encoding_;
+}
+
+bool vector_store::contains(doc_id d_id) const
+{
+    return d_id < norms_.size() && norms_[d_id] > 0;
+}
+
+std::vector<float> vector_store::vector(doc_id d_id) const
+{
+    std::vector<float> vec(dims_, 0.0f);
+    if (contains(d_id))
+        decode(d_id, vec.data());
+    return vec;
+}
+
+void vector_store::decode(doc_id d_id, float* out) const
+{
+    auto first = d_id * dims_;
+    if (encoding_ == vector_encoding::float32)
+    {
+        std::copy(&(*floats_)[first], &(*floats_)[first] + dims_, out);
+        return;
+    }
+
+    auto scale = (*scales_)[d_id];
+    const auto* row = &(*bytes_)[first];
+    for (uint64_t i = 0; i < dims_; ++i)
+        out[i] = scale * row[i];
+}
+
+float vector_store::score(const float* query, doc_id d_id) const
+{
+    auto first = d_id * dims_;
+    if (encoding_ == vector_encoding::float32)
+        return util::dense::dot(query, &(*floats_)[first], dims_);
+    return (*scales_)[d_id] * internal::dot_int8(query, &(*bytes_)[first], dims_);
+}
+
+void vector_store::check(const std::vector<float>& query) const
+{
+    if (query.size() != dims_)
+        throw vector_store_exception{
+            "query has " + std::to_string(query.size())
+            + " elements rather than " + std::to_string(dims_)};
+}
+
+template <class Function>
+void vector_store::scan(const float* query, uint64_t first, uint64_t last,
+                        const filter_type& filter, Function&& best) const
+{
+    for (auto d = first; d < last; ++d)
+    {
+        doc_id d_id{d};
+        if (norms_[d] == 0 || (filter && !filter(d_id)))
+            continue;
+        best(d_id, score(query, d_id));
+    }
+}
+
+std::vector<std::pair<doc_id, double>>
+    vector_store::search(const std::vector<float>& query, uint64_t k,
+                         const filter_type& filter) const
+{
+    check(query);
+    best_docs heap{k};
+    scan(query.data(), 0, size(), filter, [&](doc_id d_id, double score)
+         {
+        heap.push(d_id, score);
+    });
+
+    std::vector<scored_doc> results;
+    heap.drain(results);
+    keep_best(results, k);
+    return results;
+}
+
+std::vector<std::pair<doc_id, double>>
+    vector_store::search(const std::vector<float>& query, uint64_t k,
+                         parallel::thread_pool& pool,
+                         const filter_type& filter) const
+{
+    check(query);
+    std::vector<best_docs> heaps(pool.thread_ids().size(), best_docs{k});
+    parallel::parallel_chunks(pool, size(), 0,
+                              [&](uint64_t task, uint64_t first, uint64_t last)
+                              {
+        auto& heap = heaps[task];
+        scan(query.data(), first, last, filter, [&](doc_id d_id, double score)
+             {
+            heap.push(d_id, score);
+        });
+    });
+
+    std::vector<scored_doc> results;
+    for (auto& heap : heaps)
+        heap.drain(results);
+    keep_best(results, k);
+    return results;
+}
+
+util::memory_report vector_store::memory_usage() const
+{
+    util::memory_report report;
+    if (floats_)
+        report.add("vectors", floats_->memory_usage());
+    if (bytes_)
+        report.add("vectors", bytes_->memory_usage());
+    if (scales_)
+        report.add("scales", scales_->memory_usage());
+    report.add("norms", norms_.memory_usage());
+    return report;
+}
+}
+}
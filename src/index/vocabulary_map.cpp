@@ -1,93 +1,327 @@
 /**
- * @file vocabulary_map.h
+ * @file vocabulary_map.cpp
  * @author Chase Geigle
  */
 
+#include <algorithm>
 #include <cstring>
+#include <limits>
+#include <numeric>
+
 #include "index/vocabulary_map.h"
-#include "util/optional.h"
+#include "io/front_coding.h"
 
 namespace meta
 {
 namespace index
 {
 
-vocabulary_map::vocabulary_map(const std::string& path, uint16_t block_size)
-    : file_{path}, inverse_{path + ".inverse"}, block_size_{block_size}
+namespace
+{
+using io::front_coding::block_reader;
+
+/**
+ * @param pattern A wildcard pattern
+ * @param text A string
+ * @return whether the pattern matches the whole string
+ */
+bool wildcard_match(const std::string& pattern, const std::string& text)
+{
+    // on a mismatch, retry from the most recent '*', letting it match one
+    // more character
+    uint64_t p = 0;
+    uint64_t t = 0;
+    auto star = std::string::npos;
+    uint64_t star_text = 0;
+    while (t < text.size())
+    {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t]))
+        {
+            ++p;
+            ++t;
+        }
+        else if (p < pattern.size() && pattern[p] == '*')
+        {
+            star = p++;
+            star_text = t;
+        }
+        else if (star != std::string::npos)
+        {
+            p = star + 1;
+            t = ++star_text;
+        }
+        else
+        {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*')
+        ++p;
+    return p == pattern.size();
+}
+}
+
+vocabulary_map::vocabulary_map(const std::string& path)
+    : index_{path + ".inverse"}
+{
+    if (index_.size() < 2 || index_.size() % 2 != 0)
+        throw vocabulary_map_exception{"invalid vocabulary map index: "
+                                       + path + ".inverse"};
+    num_terms_ = index_[0];
+    block_terms_ = index_[1];
+    if (num_terms_ > 0)
+        file_ = io::mmap_file{path};
+}
+
+const char* vocabulary_map::head(uint64_t block) const
+{
+    return file_->begin() + index_[2 + 2 * block + 1];
+}
+
+uint64_t vocabulary_map::find_block(const std::string& term,
+                                   uint64_t first) const
+{
+    // binary search for the first block whose head is larger than term
+    auto start = first;
+    uint64_t last = (index_.size() - 2) / 2;
+    while (first < last)
+    {
+        auto mid = first + (last - first) / 2;
+        if (term.compare(head(mid)) < 0)
+            last = mid;
+        else
+            first = mid + 1;
+    }
+    return first == start ? start : first - 1;
+}
+
+term_id vocabulary_map::lower_bound(const std::string& term) const
 {
-    // determine the position that denotes the end of the leaf node
-    // level---we can use this to determine when to stop our finds later on
-    auto pos = inverse_[inverse_.size() - 1];
-    leaf_end_pos_ = pos + sizeof(term_id) + std::strlen(file_.begin() + pos);
+    if (num_terms_ == 0)
+        return term_id{0};
 
-    // determine the position of the first internal node that is not the
-    // root---this is useful in find() and we don't want to compute it
-    // every time
-    auto root_start = file_.size() - block_size_;
-    auto first_pos = root_start + std::strlen(file_.begin() + root_start) + 1;
-    initial_seek_pos_ = *reinterpret_cast<uint64_t*>(file_.begin() + first_pos);
+    auto block = find_block(term);
+    auto id = block * block_terms_;
+    auto end = std::min(num_terms_, id + block_terms_);
+    block_reader reader{file_->begin() + index_[2 + 2 * block]};
+    for (; id < end; ++id)
+    {
+        if (!(reader.next() < term))
+            break;
+    }
+    return term_id{id};
 }
 
 util::optional<term_id> vocabulary_map::find(const std::string& term) const
 {
-    uint64_t pos = file_.size() - block_size_;
-    uint64_t seek_pos = initial_seek_pos_;
-    while (pos > leaf_end_pos_)
+    if (num_terms_ == 0)
+        return util::nullopt;
+
+    auto block = find_block(term);
+    auto id = block * block_terms_;
+    auto end = std::min(num_terms_, id + block_terms_);
+    block_reader reader{file_->begin() + index_[2 + 2 * block]};
+    for (; id < end; ++id)
     {
-        uint64_t end_pos = pos + block_size_;
-        while (pos < end_pos && *(file_.begin() + pos))
-        {
-            if (compare(term, file_.begin() + pos) < 0)
-            {
-                // stale seek pos: this means that the very first term in a
-                // block was larger than the target term, meaning we can't find
-                // this term in our tree
-                if (seek_pos >= pos)
-                    return util::nullopt;
-                // stop executing this loop: seek_pos determines where we
-                // go next
-                break;
-            }
-            else
-            {
-                // skip over the string
-                pos += std::strlen(file_.begin() + pos) + 1;
-                // read the position
-                seek_pos = *reinterpret_cast<uint64_t*>(file_.begin() + pos);
-                pos += sizeof(uint64_t);
-            }
-        }
-        pos = seek_pos; // remember: this decreases pos as we go towards the
-                        // leaves
+        auto cmp = reader.next().compare(term);
+        if (cmp == 0)
+            return term_id{id};
+        if (cmp > 0)
+            break;
     }
+    return util::nullopt;
+}
+
+std::vector<util::optional<term_id>>
+    vocabulary_map::find_all(const std::vector<std::string>& terms) const
+{
+    std::vector<util::optional<term_id>> ids(terms.size());
+    if (num_terms_ == 0)
+        return ids;
 
-    // we are now at a leaf node---find our term if it exists
-    uint64_t endpos = pos + block_size_;
-    while (pos < endpos)
+    std::vector<uint64_t> order(terms.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](uint64_t a, uint64_t b)
+              {
+                  return terms[a] < terms[b];
+              });
+
+    // the terms are visited in increasing order, so the block holding
+    // each one is never before the block holding the last, and within a
+    // block decoding resumes from where the last term stopped
+    auto num_blocks = (index_.size() - 2) / 2;
+    auto block = num_blocks;
+    block_reader reader{file_->begin()};
+    const std::string* current = nullptr;
+    uint64_t next_id = 0;
+    for (const auto& i : order)
     {
-        if (compare(term, file_.begin() + pos) == 0)
+        const auto& term = terms[i];
+        auto found = find_block(term, block == num_blocks ? 0 : block);
+        if (found != block)
+        {
+            block = found;
+            reader = block_reader{file_->begin() + index_[2 + 2 * block]};
+            current = nullptr;
+            next_id = block * block_terms_;
+        }
+
+        auto end = std::min(num_terms_, (block + 1) * block_terms_);
+        while ((!current || *current < term) && next_id < end)
         {
-            pos += term.length() + 1;
-            return term_id{*reinterpret_cast<uint64_t*>(file_.begin() + pos)};
+            current = &reader.next();
+            ++next_id;
         }
-        pos += std::strlen(file_.begin() + pos) + 1 + sizeof(uint64_t);
+        if (current && *current == term)
+            ids[i] = term_id{next_id - 1};
     }
-    return util::nullopt;
+    return ids;
 }
 
-int vocabulary_map::compare(const std::string& term, const char* other) const
+std::string vocabulary_map::find_term(term_id t_id) const
 {
-    return std::memcmp(term.c_str(), other, term.length() + 1);
+    uint64_t id{t_id};
+    auto block = id / block_terms_;
+    block_reader reader{file_->begin() + index_[2 + 2 * block]};
+    for (uint64_t i = block * block_terms_; i < id; ++i)
+        reader.next();
+    return reader.next();
 }
 
-std::string vocabulary_map::find_term(term_id t_id) const
+util::memory_usage vocabulary_map::memory_usage() const
 {
-    return file_.begin() + inverse_[t_id];
+    auto usage = index_.memory_usage();
+    if (file_)
+        usage += file_->memory_usage();
+    return usage;
 }
 
 uint64_t vocabulary_map::size() const
 {
-    return inverse_.size();
+    return num_terms_;
+}
+
+std::pair<term_id, term_id>
+    vocabulary_map::range(const std::string& lower,
+                          const std::string& upper) const
+{
+    auto first = lower_bound(lower);
+    auto last = lower_bound(upper);
+    return {first, std::max(first, last)};
+}
+
+std::pair<term_id, term_id>
+    vocabulary_map::prefix_range(const std::string& prefix) const
+{
+    // the strings with the prefix are those below the smallest string that
+    // is larger than all of them: the prefix with its last byte incremented,
+    // after dropping any trailing bytes that cannot be
+    auto upper = prefix;
+    while (!upper.empty()
+           && static_cast<unsigned char>(upper.back())
+                  == std::numeric_limits<unsigned char>::max())
+        upper.pop_back();
+    if (upper.empty())
+        return {lower_bound(prefix), term_id{num_terms_}};
+    auto last = static_cast<unsigned char>(upper.back());
+    upper.back() = static_cast<char>(last + 1);
+    return range(prefix, upper);
+}
+
+void vocabulary_map::for_each(
+    term_id first, term_id last,
+    const std::function<void(term_id, const std::string&)>& fn) const
+{
+    uint64_t id{first};
+    uint64_t end = std::min<uint64_t>(last, num_terms_);
+    while (id < end)
+    {
+        auto block = id / block_terms_;
+        auto block_end = std::min(end, (block + 1) * block_terms_);
+        block_reader reader{file_->begin() + index_[2 + 2 * block]};
+        for (auto i = block * block_terms_; i < id; ++i)
+            reader.next();
+        for (; id < block_end; ++id)
+            fn(term_id{id}, reader.next());
+    }
+}
+
+std::vector<term_id> vocabulary_map::wildcard(const std::string& pattern) const
+{
+    std::vector<term_id> matches;
+    auto literal = pattern.substr(0, pattern.find_first_of("*?"));
+    if (literal.size() == pattern.size())
+    {
+        if (auto id = find(pattern))
+            matches.push_back(*id);
+        return matches;
+    }
+
+    auto bounds = prefix_range(literal);
+    for_each(bounds.first, bounds.second,
+             [&](term_id id, const std::string& term)
+             {
+        if (wildcard_match(pattern, term))
+            matches.push_back(id);
+    });
+    return matches;
+}
+
+std::vector<term_id> vocabulary_map::fuzzy(const std::string& term,
+                                           uint64_t max_edits) const
+{
+    // rows[i][j] is the edit distance between the first i characters of
+    // the current candidate and the first j characters of term; rows for
+    // the candidate's prefix shared with the previous candidate are kept
+    std::vector<std::vector<uint64_t>> rows(1);
+    rows[0].resize(term.size() + 1);
+    for (uint64_t j = 0; j <= term.size(); ++j)
+        rows[0][j] = j;
+
+    std::vector<term_id> matches;
+    std::string previous;
+    // candidates whose first dead_depth characters match the previous
+    // candidate's are already too far from term
+    auto dead_depth = std::numeric_limits<uint64_t>::max();
+    for_each(term_id{0}, term_id{num_terms_},
+             [&](term_id id, const std::string& candidate)
+             {
+        uint64_t shared = 0;
+        auto limit = std::min(previous.size(), candidate.size());
+        while (shared < limit && previous[shared] == candidate[shared])
+            ++shared;
+        previous = candidate;
+
+        if (shared >= dead_depth)
+            return;
+        dead_depth = std::numeric_limits<uint64_t>::max();
+
+        if (rows.size() <= candidate.size())
+            rows.resize(candidate.size() + 1,
+                        std::vector<uint64_t>(term.size() + 1));
+        for (auto i = shared + 1; i <= candidate.size(); ++i)
+        {
+            const auto& prev = rows[i - 1];
+            auto& row = rows[i];
+            row[0] = i;
+            auto best = row[0];
+            for (uint64_t j = 1; j <= term.size(); ++j)
+            {
+                auto cost = candidate[i - 1] == term[j - 1] ? 0 : 1;
+                row[j] = std::min({prev[j] + 1, row[j - 1] + 1,
+                                   prev[j - 1] + cost});
+                best = std::min(best, row[j]);
+            }
+            if (best > max_edits)
+            {
+                dead_depth = i;
+                return;
+            }
+        }
+        if (rows[candidate.size()][term.size()] <= max_edits)
+            matches.push_back(id);
+    });
+    return matches;
 }
 }
 }
@@ -3,11 +3,11 @@
  * @author Chase Geigle
  */
 
-#include <iostream>
-#include <algorithm>
+#include <cstring>
 #include "meta.h"
 #include "index/vocabulary_map_writer.h"
 #include "io/binary.h"
+#include "io/front_coding.h"
 
 namespace meta
 {
@@ -15,17 +15,17 @@ namespace index
 {
 
 vocabulary_map_writer::vocabulary_map_writer(const std::string& path,
-                                             uint16_t block_size)
-    : file_write_pos_{0},
-      inverse_file_{path + ".inverse", std::ios::binary},
-      path_{path},
-      block_size_{block_size},
+                                             uint64_t block_terms)
+    : path_{path},
+      block_terms_{block_terms},
       num_terms_{0},
-      remaining_block_space_{block_size},
-      written_nodes_{0}
+      file_write_pos_{0}
 {
+    if (block_terms_ == 0)
+        throw vocabulary_map_writer_exception{
+            "vocabulary map blocks must hold at least one term"};
     file_.open(path, file_.binary | file_.trunc);
-    if (!file_ || !inverse_file_)
+    if (!file_)
         throw vocabulary_map_writer_exception{
             "failed to open vocabulary map file"};
 }
@@ -35,114 +35,107 @@ void vocabulary_map_writer::insert(const std::string& term)
     if (term.empty())
         throw vocabulary_map_writer_exception{
             "empty string cannot be inserted into the vocabulary_map"};
-    // + 1 for null terminator
-    auto length = sizeof(term_id) + term.length() + 1;
+    if (term.find('\0') != std::string::npos)
+        throw vocabulary_map_writer_exception{
+            "terms in the vocabulary_map cannot contain null bytes"};
+    if (num_terms_ > 0 && !(previous_ < term))
+        throw vocabulary_map_writer_exception{
+            "terms must be inserted into the vocabulary_map in sorted order"};
 
-    if (length > remaining_block_space_)
+    auto block_start = num_terms_ % block_terms_ == 0;
+    if (block_start)
     {
-        write_padding();
-        ++written_nodes_;
+        block_positions_.push_back(file_write_pos_);
+        heads_ += term;
+        heads_ += '\0';
     }
-    // record term position in inverse file
-    io::write_binary(inverse_file_, file_write_pos_);
-
-    // write term and id to tree file
-    io::write_binary(file_, term);
-    io::write_binary(file_, num_terms_);
-
-    // update write cursor (can't use fstream tell functions because these
-    // files may be larger than 2GB)
-    file_write_pos_ += length;
+    file_write_pos_
+        += io::front_coding::write(file_, previous_, term, block_start);
 
-    remaining_block_space_ -= length;
+    previous_ = term;
     ++num_terms_;
 }
 
-void vocabulary_map_writer::write_padding()
+vocabulary_map_writer::~vocabulary_map_writer()
 {
-    if (remaining_block_space_ > 0)
+    auto heads_pos = file_write_pos_;
+    file_.write(heads_.data(), static_cast<std::streamsize>(heads_.size()));
+    file_.flush();
+
+    std::ofstream index{path_ + ".inverse", std::ios::binary};
+    io::write_binary(index, num_terms_);
+    io::write_binary(index, block_terms_);
+    uint64_t head_pos = heads_pos;
+    for (const auto& pos : block_positions_)
     {
-        // -1 for null terminator
-        std::string padding(remaining_block_space_ - 1, '\0');
-        io::write_binary(file_, padding);
+        io::write_binary(index, pos);
+        io::write_binary(index, head_pos);
+        head_pos += std::strlen(heads_.c_str() + (head_pos - heads_pos)) + 1;
     }
-    file_write_pos_ += remaining_block_space_;
-    remaining_block_space_ = block_size_;
 }
 
-void vocabulary_map_writer::flush()
-{
-    write_padding();
-    file_.flush();
-    ++written_nodes_;
-}
+const uint64_t async_vocabulary_writer::batch_size;
 
-vocabulary_map_writer::~vocabulary_map_writer()
+async_vocabulary_writer::async_vocabulary_writer(const std::string& path,
+                                                 uint64_t block_terms)
+    : queue_{4}, num_terms_{0}
 {
-    // flush any remaining partial block
-    if (remaining_block_space_ != block_size_)
-        flush();
-    file_.flush();
-
-    uint64_t remaining_nodes{0};
-    std::swap(remaining_nodes, written_nodes_);
-
-    // begin writing the internal nodes
-    std::ifstream reader{path_, std::ios::binary};
-    uint64_t read_pos = 0;
-
-    // this first loop is over each of the levels: when we have written
-    // only one node inside the inner loop, we've just finished writing the
-    // root and we can stop
-    while (remaining_nodes != 1)
-    {
-        // this loop is over the last level that was written---once we have
-        // processed all nodes in the previous level, we can move to the
-        // next level's iteration
-        while (remaining_nodes > 0)
+    batch_.reserve(batch_size);
+    done_ = std::async(std::launch::async, [this, path, block_terms]()
+                       {
+        try
         {
-            uint64_t t_id;
-            std::string term;
-            io::read_binary(reader, term);
-            io::read_binary(reader, t_id);
-
-            // signed int for safe negation below (auto causes a big on
-            // 32-bit systems)
-            int64_t length = sizeof(uint64_t) + term.length() + 1;
-
-            // if we are out of room in the current block, flush it and start a
-            // new one
-            if (length > remaining_block_space_)
+            vocabulary_map_writer writer{path, block_terms};
+            std::vector<std::string> batch;
+            while (queue_.pop(batch))
             {
-                flush();
-                // we need to re-read the block head we just read
-                reader.seekg(-length, file_.cur);
+                for (const auto& term : batch)
+                    writer.insert(term);
             }
-            // otherwise, write the head term of the block we are reading to
-            // the current block along with its position
-            else
-            {
-                // write the position of the block and the term at its head
-                io::write_binary(file_, term);
-                io::write_binary(file_, read_pos);
+        }
+        catch (...)
+        {
+            // wake a producer waiting for room, so that it finds out
+            queue_.close();
+            throw;
+        }
+    });
+}
 
-                // skip to the next block
-                reader.seekg(block_size_ - length, file_.cur);
-                read_pos += block_size_;
+async_vocabulary_writer::~async_vocabulary_writer()
+{
+    if (done_.valid())
+    {
+        queue_.close();
+        done_.wait();
+    }
+}
 
-                // update the remaining space in the current block
-                remaining_block_space_ -= length;
-                --remaining_nodes;
-            }
-        }
+void async_vocabulary_writer::insert(std::string term)
+{
+    batch_.push_back(std::move(term));
+    ++num_terms_;
+    if (batch_.size() == batch_size)
+        flush();
+}
 
-        // if there is still a partial block remaining to be written for
-        // this level, write it
-        if (remaining_block_space_ != block_size_)
-            flush();
+void async_vocabulary_writer::flush()
+{
+    if (batch_.empty())
+        return;
+    // the queue is only closed early when the thread has failed
+    if (!queue_.push(std::move(batch_)))
+        done_.get();
+    batch_.clear();
+    batch_.reserve(batch_size);
+}
 
-        std::swap(remaining_nodes, written_nodes_);
-    }
+uint64_t async_vocabulary_writer::finish()
+{
+    flush();
+    queue_.close();
+    done_.get();
+    return num_terms_;
 }
 }
 }
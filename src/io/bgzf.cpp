@@ -0,0 +1,379 @@
+/**
+ * @file bgzf.cpp
+ */
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <zlib.h>
+
+#include "io/bgzf.h"
+#include "util/filesystem.h"
+#include "util/shim.h"
+
+namespace meta
+{
+namespace io
+{
+
+namespace
+{
+/// The bytes of a block header before its compressed data
+const uint64_t header_size = 18;
+
+/// The bytes of a block trailer: the CRC32 and size of the data
+const uint64_t trailer_size = 8;
+
+/// The empty block that ends a BGZF file
+const std::array<unsigned char, 28> eof_block
+    = {{0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0xff,
+        0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x1b, 0x00, 0x03, 0x00,
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00}};
+
+/**
+ * @param data The start of a little-endian integer
+ * @param bytes The number of bytes in the integer
+ * @return the integer
+ */
+uint64_t read_le(const unsigned char* data, uint64_t bytes)
+{
+    uint64_t value = 0;
+    for (uint64_t i = 0; i < bytes; ++i)
+        value |= static_cast<uint64_t>(data[i]) << (8 * i);
+    return value;
+}
+
+/**
+ * @param out Where to write a little-endian integer
+ * @param value The integer
+ * @param bytes The number of bytes to write
+ */
+void write_le(unsigned char* out, uint64_t value, uint64_t bytes)
+{
+    for (uint64_t i = 0; i < bytes; ++i)
+        out[i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+/**
+ * @param data The start of a gzip member
+ * @param size The number of bytes from data to the end of the file
+ * @return the total size of the member according to its "BC" extra
+ * field, or zero if it is not a BGZF block
+ */
+uint64_t block_size(const unsigned char* data, uint64_t size)
+{
+    if (size < header_size || data[0] != 0x1f || data[1] != 0x8b
+        || data[2] != 8 || !(data[3] & 4))
+        return 0;
+
+    auto xlen = read_le(data + 10, 2);
+    if (size < 12 + xlen)
+        return 0;
+    for (uint64_t i = 12; i + 4 <= 12 + xlen;)
+    {
+        auto slen = read_le(data + i + 2, 2);
+        if (data[i] == 'B' && data[i + 1] == 'C' && slen == 2)
+            return read_le(data + i + 4, 2) + 1;
+        i += 4 + slen;
+    }
+    return 0;
+}
+
+/**
+ * @param data The start of a BGZF block
+ * @param size The total size of the block
+ * @return the inflated contents of the block
+ */
+std::string inflate_block(const unsigned char* data, uint64_t size)
+{
+    auto xlen = read_le(data + 10, 2);
+    auto first = 12 + xlen;
+    if (size < first + trailer_size)
+        throw bgzf_exception{"truncated BGZF block"};
+
+    auto trailer = data + size - trailer_size;
+    std::string result(read_le(trailer + 4, 4), '\0');
+
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (inflateInit2(&stream, -15) != Z_OK)
+        throw bgzf_exception{"failed to initialize zlib"};
+    stream.next_in = const_cast<unsigned char*>(data + first);
+    stream.avail_in = static_cast<uInt>(size - first - trailer_size);
+    stream.next_out = reinterpret_cast<unsigned char*>(&result[0]);
+    stream.avail_out = static_cast<uInt>(result.size());
+    auto status = inflate(&stream, Z_FINISH);
+    inflateEnd(&stream);
+    if (status != Z_STREAM_END || stream.avail_out != 0)
+        throw bgzf_exception{"corrupt BGZF block"};
+
+    auto crc = crc32(0, reinterpret_cast<const unsigned char*>(result.data()),
+                     static_cast<uInt>(result.size()));
+    if (crc != read_le(trailer, 4))
+        throw bgzf_exception{"BGZF block fails its CRC check"};
+    return result;
+}
+
+/**
+ * @param data The bytes of a block
+ * @param size The number of bytes in the block
+ * @param level The zlib compression level
+ * @return the block, deflated into a BGZF member
+ */
+std::string deflate_block(const char* data, uint64_t size, int level)
+{
+    z_stream stream;
+    std::memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY)
+        != Z_OK)
+        throw bgzf_exception{"failed to initialize zlib"};
+
+    std::string block(header_size
+                          + deflateBound(&stream, static_cast<uLong>(size))
+                          + trailer_size,
+                      '\0');
+    auto out = reinterpret_cast<unsigned char*>(&block[0]);
+    stream.next_in
+        = reinterpret_cast<unsigned char*>(const_cast<char*>(data));
+    stream.avail_in = static_cast<uInt>(size);
+    stream.next_out = out + header_size;
+    stream.avail_out = static_cast<uInt>(block.size() - header_size
+                                         - trailer_size);
+    auto status = deflate(&stream, Z_FINISH);
+    auto compressed = stream.total_out;
+    deflateEnd(&stream);
+    if (status != Z_STREAM_END)
+        throw bgzf_exception{"failed to compress BGZF block"};
+
+    auto total = header_size + compressed + trailer_size;
+    const unsigned char header[header_size]
+        = {0x1f, 0x8b, 0x08, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00,
+           0xff, 0x06, 0x00, 0x42, 0x43, 0x02, 0x00, 0x00, 0x00};
+    std::memcpy(out, header, header_size);
+    write_le(out + 16, total - 1, 2);
+
+    auto trailer = out + header_size + compressed;
+    write_le(trailer,
+             crc32(0, reinterpret_cast<const unsigned char*>(data),
+                   static_cast<uInt>(size)),
+             4);
+    write_le(trailer + 4, size, 4);
+    block.resize(total);
+    return block;
+}
+}
+
+bgzf_writer::bgzf_writer(const std::string& filename, uint64_t block_size,
+                         int level, uint64_t num_threads)
+    : out_{filename, std::ios::binary},
+      block_size_{block_size},
+      level_{level},
+      max_pending_{4 * (num_threads == 0 ? 1 : num_threads)},
+      closed_{false}
+{
+    if (!out_)
+        throw bgzf_exception{"failed to open " + filename};
+    if (block_size_ == 0 || block_size_ > max_block_size)
+        throw bgzf_exception{"invalid BGZF block size"};
+    if (num_threads > 1)
+        pool_ = make_unique<parallel::thread_pool>(num_threads);
+    buffer_.reserve(block_size_);
+}
+
+bgzf_writer::~bgzf_writer()
+{
+    if (!closed_)
+        close();
+}
+
+void bgzf_writer::write(const char* data, uint64_t size)
+{
+    while (size > 0)
+    {
+        auto count = std::min(size, block_size_ - buffer_.size());
+        buffer_.append(data, count);
+        data += count;
+        size -= count;
+        if (buffer_.size() == block_size_)
+            flush_block();
+    }
+}
+
+void bgzf_writer::write(const std::string& str)
+{
+    write(str.data(), str.size());
+}
+
+void bgzf_writer::close()
+{
+    if (!buffer_.empty())
+        flush_block();
+    while (!pending_.empty())
+        write_front();
+    out_.write(reinterpret_cast<const char*>(eof_block.data()),
+               eof_block.size());
+    out_.close();
+    closed_ = true;
+}
+
+void bgzf_writer::flush_block()
+{
+    if (!pool_)
+    {
+        auto block = deflate_block(buffer_.data(), buffer_.size(), level_);
+        out_.write(block.data(), static_cast<std::streamsize>(block.size()));
+        buffer_.clear();
+        return;
+    }
+
+    // the block is handed to the pool, and a new one is started
+    auto data = std::make_shared<std::string>();
+    data->swap(buffer_);
+    buffer_.reserve(block_size_);
+    auto level = level_;
+    pending_.emplace_back(pool_->submit_task([data, level]()
+    {
+        return deflate_block(data->data(), data->size(), level);
+    }));
+    while (pending_.size() > max_pending_)
+        write_front();
+}
+
+void bgzf_writer::write_front()
+{
+    auto block = pending_.front().get();
+    pending_.pop_front();
+    out_.write(block.data(), static_cast<std::streamsize>(block.size()));
+}
+
+bgzf_streambuf::bgzf_streambuf(const std::string& filename,
+                               uint64_t num_threads)
+    : writer_{filename, bgzf_writer::max_block_size, 6, num_threads},
+      buffer_(bgzf_writer::max_block_size)
+{
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+}
+
+bgzf_streambuf::~bgzf_streambuf()
+{
+    sync();
+}
+
+void bgzf_streambuf::close()
+{
+    sync();
+    writer_.close();
+}
+
+auto bgzf_streambuf::overflow(int_type ch) -> int_type
+{
+    sync();
+    if (!traits_type::eq_int_type(ch, traits_type::eof()))
+    {
+        *pptr() = traits_type::to_char_type(ch);
+        pbump(1);
+    }
+    return traits_type::not_eof(ch);
+}
+
+int bgzf_streambuf::sync()
+{
+    auto size = static_cast<uint64_t>(pptr() - pbase());
+    if (size > 0)
+        writer_.write(pbase(), size);
+    setp(buffer_.data(), buffer_.data() + buffer_.size());
+    return 0;
+}
+
+bgzf_ofstream::bgzf_ofstream(const std::string& filename,
+                             uint64_t num_threads)
+    : std::ostream{&buffer_}, buffer_{filename, num_threads}
+{
+    clear();
+}
+
+void bgzf_ofstream::close()
+{
+    buffer_.close();
+}
+
+bool bgzf_reader::is_bgzf(const std::string& filename)
+{
+    std::ifstream in{filename, std::ios::binary};
+    std::array<char, 64> head;
+    in.read(head.data(), head.size());
+    return block_size(reinterpret_cast<const unsigned char*>(head.data()),
+                      static_cast<uint64_t>(in.gcount()))
+           != 0;
+}
+
+bgzf_reader::bgzf_reader(const std::string& filename, uint64_t num_threads)
+    : offset_{0},
+      pool_(num_threads == 0 ? 1 : num_threads),
+      max_pending_{4 * (num_threads == 0 ? 1 : num_threads)},
+      pos_{0}
+{
+    if (filesystem::file_size(filename) > 0)
+        file_ = make_unique<mmap_file>(filename);
+    fill();
+}
+
+void bgzf_reader::fill()
+{
+    if (!file_)
+        return;
+
+    auto data = reinterpret_cast<const unsigned char*>(file_->begin());
+    while (pending_.size() < max_pending_ && offset_ < file_->size())
+    {
+        auto first = data + offset_;
+        auto size = block_size(first, file_->size() - offset_);
+        if (size == 0 || size > file_->size() - offset_)
+            throw bgzf_exception{"invalid BGZF block at offset "
+                                 + std::to_string(offset_)};
+        pending_.emplace_back(pool_.submit_task([=]()
+        {
+            return inflate_block(first, size);
+        }));
+        offset_ += size;
+    }
+}
+
+bool bgzf_reader::next_block()
+{
+    if (pending_.empty())
+        return false;
+    block_ = pending_.front().get();
+    pending_.pop_front();
+    pos_ = 0;
+    fill();
+    return true;
+}
+
+bool bgzf_reader::getline(std::string& line)
+{
+    line.clear();
+    bool found = false;
+    while (true)
+    {
+        if (pos_ >= block_.size())
+        {
+            if (!next_block())
+                return found;
+            continue;
+        }
+
+        found = true;
+        auto nl = block_.find('\n', pos_);
+        if (nl != std::string::npos)
+        {
+            line.append(block_, pos_, nl - pos_);
+            pos_ = nl + 1;
+            return true;
+        }
+        line.append(block_, pos_, std::string::npos);
+        pos_ = block_.size();
+    }
+}
+}
+}
@@ -0,0 +1,107 @@
+/**
+ * @file delimiter_scanner.cpp
+ */
+
+#include <cstring>
+
+#include "io/delimiter_scanner.h"
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+namespace meta
+{
+namespace io
+{
+
+delimiter_scanner::delimiter_scanner(const std::string& delims)
+    : method_{method::none}, single_{0}
+{
+    low_.fill(0);
+    high_.fill(0);
+    delimiter_.fill(false);
+    for (const auto& ch : delims)
+        delimiter_[static_cast<uint8_t>(ch)] = true;
+
+    uint64_t num_delims = 0;
+    for (uint64_t ch = 0; ch < delimiter_.size(); ++ch)
+    {
+        if (delimiter_[ch])
+        {
+            ++num_delims;
+            single_ = static_cast<char>(ch);
+        }
+    }
+    if (num_delims == 0)
+        return;
+    if (num_delims == 1)
+    {
+        method_ = method::single;
+        return;
+    }
+
+    method_ = method::table;
+#ifdef __SSSE3__
+    uint8_t num_bits = 0;
+    for (uint64_t ch = 0; ch < delimiter_.size(); ++ch)
+    {
+        if (!delimiter_[ch])
+            continue;
+        auto high = ch >> 4;
+        if (high_[high] == 0)
+        {
+            // one bit per high nibble, and a byte has eight of them
+            if (num_bits == 8)
+                return;
+            high_[high] = static_cast<uint8_t>(1 << num_bits++);
+        }
+        low_[ch & 0x0f] |= high_[high];
+    }
+    method_ = method::nibbles;
+#endif
+}
+
+const char* delimiter_scanner::find(const char* first, const char* last) const
+{
+    if (method_ == method::none || first >= last)
+        return last;
+
+    if (method_ == method::single)
+    {
+        auto found = static_cast<const char*>(
+            std::memchr(first, single_, static_cast<size_t>(last - first)));
+        return found ? found : last;
+    }
+
+#ifdef __SSSE3__
+    if (method_ == method::nibbles)
+    {
+        auto low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&low_[0]));
+        auto high
+            = _mm_loadu_si128(reinterpret_cast<const __m128i*>(&high_[0]));
+        auto nibble = _mm_set1_epi8(0x0f);
+        auto zero = _mm_setzero_si128();
+        for (; last - first >= 16; first += 16)
+        {
+            auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+            auto low_bits = _mm_shuffle_epi8(low, _mm_and_si128(bytes, nibble));
+            auto high_bits = _mm_shuffle_epi8(
+                high, _mm_and_si128(_mm_srli_epi16(bytes, 4), nibble));
+            auto misses
+                = _mm_cmpeq_epi8(_mm_and_si128(low_bits, high_bits), zero);
+            auto hits = ~_mm_movemask_epi8(misses) & 0xffff;
+            if (hits)
+                return first + __builtin_ctz(static_cast<unsigned>(hits));
+        }
+    }
+#endif
+
+    // the table finishes what the vectors leave, fewer than sixteen bytes
+    for (; first < last; ++first)
+        if (is_delimiter(*first))
+            return first;
+    return last;
+}
+}
+}
@@ -0,0 +1,52 @@
+/**
+ * @file front_coding.cpp
+ */
+
+#include <algorithm>
+
+#include "io/front_coding.h"
+#include "io/stream_vbyte.h"
+
+namespace meta
+{
+namespace io
+{
+namespace front_coding
+{
+
+uint64_t write(std::ostream& out, const std::string& previous,
+               const std::string& str, bool block_start)
+{
+    uint64_t shared = 0;
+    if (!block_start)
+    {
+        auto limit = std::min(previous.size(), str.size());
+        while (shared < limit && previous[shared] == str[shared])
+            ++shared;
+    }
+
+    auto bytes = stream_vbyte::write_varint(out, shared);
+    bytes += stream_vbyte::write_varint(out, str.size() - shared);
+    out.write(str.data() + shared,
+              static_cast<std::streamsize>(str.size() - shared));
+    return bytes + str.size() - shared;
+}
+
+block_reader::block_reader(const char* pos)
+    : pos_{reinterpret_cast<const uint8_t*>(pos)}
+{
+    // nothing
+}
+
+const std::string& block_reader::next()
+{
+    auto shared = stream_vbyte::read_varint(pos_);
+    auto length = stream_vbyte::read_varint(pos_);
+    current_.resize(shared);
+    current_.append(reinterpret_cast<const char*>(pos_), length);
+    pos_ += length;
+    return current_;
+}
+}
+}
+}
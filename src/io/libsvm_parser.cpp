@@ -3,7 +3,9 @@
  * @author Sean Massung
  */
 
-#include <sstream>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
 
 #include "io/libsvm_parser.h"
 
@@ -15,58 +17,252 @@ namespace io
 namespace libsvm_parser
 {
 
+namespace
+{
+/**
+ * @param c A character
+ * @return whether c separates tokens, as for operator>> on a stream
+ */
+bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v'
+           || c == '\f';
+}
+
+/**
+ * @param c A character
+ * @return whether c is a decimal digit
+ */
+bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+/**
+ * @param first The start of a token
+ * @param last The end of the token
+ * @return whether the token is a nonempty string of decimal digits that
+ * fits in a uint64_t, and its value
+ */
+bool parse_integer(const char* first, const char* last, uint64_t& value)
+{
+    if (first == last)
+        return false;
+
+    value = 0;
+    for (; first != last; ++first)
+    {
+        if (!is_digit(*first))
+            return false;
+        auto digit = static_cast<unsigned>(*first - '0');
+        if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10)
+            return false;
+        value = value * 10 + digit;
+    }
+    return true;
+}
+
+/**
+ * Powers of ten that doubles represent exactly.
+ */
+const double exact_powers[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,
+                               1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17,
+                               1e18, 1e19, 1e20, 1e21, 1e22};
+
+/**
+ * Parses a token as a double with strtod, for the rare values the fast
+ * path can not round correctly.
+ * @param first The start of the token
+ * @param last The end of the token
+ * @param value Where to store the value
+ * @return whether the whole token was a number
+ */
+bool parse_double_slow(const char* first, const char* last, double& value)
+{
+    // strtod needs a null-terminated string, so the token is copied,
+    // onto the stack unless it is absurdly long
+    auto size = static_cast<size_t>(last - first);
+    char buffer[128];
+    std::string long_copy;
+    const char* copy = buffer;
+    if (size < sizeof(buffer))
+    {
+        std::memcpy(buffer, first, size);
+        buffer[size] = '\0';
+    }
+    else
+    {
+        long_copy.assign(first, last);
+        copy = long_copy.c_str();
+    }
+
+    char* end;
+    value = std::strtod(copy, &end);
+    return end != copy && end == copy + size;
+}
+
+/**
+ * Parses a token as a double without allocating. A decimal number with
+ * at most 19 significant digits and a small exponent is converted exactly
+ * with a single multiplication or division, which rounds correctly since
+ * both operands are exact; anything else goes to strtod.
+ * @param first The start of the token
+ * @param last The end of the token
+ * @param value Where to store the value
+ * @return whether the whole token was a number
+ */
+bool parse_double(const char* first, const char* last, double& value)
+{
+    auto it = first;
+    bool negative = false;
+    if (it != last && (*it == '-' || *it == '+'))
+        negative = *it++ == '-';
+
+    uint64_t mantissa = 0;
+    int64_t exponent = 0;
+    int digits = 0;
+    bool any_digits = false;
+    for (; it != last && is_digit(*it); ++it)
+    {
+        any_digits = true;
+        if (mantissa == 0 && *it == '0')
+            continue;
+        if (digits++ < 19)
+            mantissa = mantissa * 10 + static_cast<unsigned>(*it - '0');
+        else
+            ++exponent;
+    }
+    if (it != last && *it == '.')
+    {
+        for (++it; it != last && is_digit(*it); ++it)
+        {
+            any_digits = true;
+            if (mantissa == 0 && *it == '0')
+            {
+                --exponent;
+                continue;
+            }
+            if (digits++ < 19)
+            {
+                mantissa = mantissa * 10 + static_cast<unsigned>(*it - '0');
+                --exponent;
+            }
+        }
+    }
+    if (!any_digits)
+        return false;
+
+    if (it != last && (*it == 'e' || *it == 'E'))
+    {
+        ++it;
+        bool negative_exp = false;
+        if (it != last && (*it == '-' || *it == '+'))
+            negative_exp = *it++ == '-';
+        if (it == last)
+            return false;
+
+        int64_t exp = 0;
+        for (; it != last && is_digit(*it); ++it)
+            if (exp < 100000)
+                exp = exp * 10 + (*it - '0');
+        exponent += negative_exp ? -exp : exp;
+    }
+    if (it != last)
+        return false;
+
+    if (digits > 19 || mantissa >= (uint64_t{1} << 53) || exponent < -22
+        || exponent > 22)
+        return parse_double_slow(first, last, value);
+
+    value = static_cast<double>(mantissa);
+    if (exponent < 0)
+        value /= exact_powers[-exponent];
+    else
+        value *= exact_powers[exponent];
+    if (negative)
+        value = -value;
+    return true;
+}
+
+/**
+ * @param first The start of the line
+ * @param last The end of the line
+ * @return the line, for error messages
+ */
+std::string bad_line(const char* first, const char* last)
+{
+    return "incorrectly formatted libsvm data: " + std::string{first, last};
+}
+}
+
 class_label label(const std::string& text)
 {
-    size_t space = text.find_first_of(' ');
-    if (space == std::string::npos || space == 0 || space == text.size() - 1)
-        throw libsvm_parser_exception{"incorrectly formatted libsvm data: "
-                                      + text};
+    return label(text.data(), text.data() + text.size());
+}
 
-    return class_label{text.substr(0, space)};
+class_label label(const char* first, const char* last)
+{
+    auto space = static_cast<const char*>(
+        std::memchr(first, ' ', static_cast<size_t>(last - first)));
+    if (!space || space == first || space == last - 1)
+        throw libsvm_parser_exception{bad_line(first, last)};
+
+    return class_label{std::string{first, space}};
 }
 
 counts_t counts(const std::string& text, bool contains_label /* = true */)
 {
-    std::stringstream stream{text};
-    std::string token;
+    std::vector<std::pair<term_id, double>> result;
+    counts(text.data(), text.data() + text.size(), result, contains_label);
+    return result;
+}
 
+void counts(const char* first, const char* last,
+            std::vector<std::pair<term_id, double>>& out,
+            bool contains_label /* = true */)
+{
+    out.clear();
+    auto it = first;
+    auto next_token = [&](const char*& token_end)
+    {
+        while (it != last && is_space(*it))
+            ++it;
+        token_end = it;
+        while (token_end != last && !is_space(*token_end))
+            ++token_end;
+        return it != last;
+    };
+
+    const char* token_end;
     if (contains_label)
     {
-        if (!(stream >> token)) // ignore class label, but check that it's there
-            throw libsvm_parser_exception{
-                "incorrectly formatted libsvm data: " + text};
+        // ignore class label, but check that it's there
+        if (!next_token(token_end))
+            throw libsvm_parser_exception{bad_line(first, last)};
+        it = token_end;
     }
 
-    std::vector<std::pair<term_id, double>> counts;
-    term_id term;
-    double count;
-    while (stream >> token)
+    while (next_token(token_end))
     {
-        size_t colon = token.find_first_of(':');
-        if (colon == std::string::npos || colon == 0 || colon == token.size()
-                                                                 - 1)
-            throw libsvm_parser_exception{"incorrectly formatted libsvm data: "
-                                          + text};
-
-        std::istringstream term_stream{token.substr(0, colon)};
-        term_stream >> term;
-        std::istringstream double_stream{token.substr(colon + 1)};
-        double_stream >> count;
-
-        // make sure double conversion worked and used the entire string
-        if (double_stream.fail() || !double_stream.eof())
-            throw libsvm_parser_exception{"incorrectly formatted libsvm data: "
-                                          + text};
+        auto colon = static_cast<const char*>(
+            std::memchr(it, ':', static_cast<size_t>(token_end - it)));
+        if (!colon || colon == it || colon == token_end - 1)
+            throw libsvm_parser_exception{bad_line(first, last)};
+
+        uint64_t term;
+        double count;
+        if (!parse_integer(it, colon, term)
+            || !parse_double(colon + 1, token_end, count))
+            throw libsvm_parser_exception{bad_line(first, last)};
 
         if (term == 0)
             throw libsvm_parser_exception{"term id was 0 from libsvm format"};
 
         // liblinear has term_ids start at 1 instead of 0 like MeTA and libsvm
-        term_id minus_term{static_cast<uint64_t>(term) - 1};
-        counts.emplace_back(minus_term, count);
+        out.emplace_back(term_id{term - 1}, count);
+        it = token_end;
     }
-
-    return counts;
 }
 }
 }
@@ -3,6 +3,8 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+
 #include <sys/mman.h>
 #include <sys/stat.h>
 #include <fcntl.h>
@@ -16,7 +18,52 @@ namespace meta
 namespace io
 {
 
-mmap_file::mmap_file(const std::string& path)
+void advise(const void* start, uint64_t bytes, access_pattern pattern)
+{
+    if (!start || bytes == 0)
+        return;
+
+    int advice = MADV_NORMAL;
+    switch (pattern)
+    {
+        case access_pattern::normal:
+            advice = MADV_NORMAL;
+            break;
+        case access_pattern::sequential:
+            advice = MADV_SEQUENTIAL;
+            break;
+        case access_pattern::random:
+            advice = MADV_RANDOM;
+            break;
+        case access_pattern::will_need:
+            advice = MADV_WILLNEED;
+            break;
+        case access_pattern::dont_need:
+            advice = MADV_DONTNEED;
+            break;
+    }
+
+    // madvise needs a page-aligned start, so the region is widened to the
+    // page it starts in
+    static const auto page = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+    auto addr = reinterpret_cast<uintptr_t>(start);
+    auto aligned = addr & ~(page - 1);
+    madvise(reinterpret_cast<void*>(aligned), bytes + (addr - aligned),
+            advice);
+}
+
+residency parse_residency(const std::string& name)
+{
+    if (name == "on-demand")
+        return residency::on_demand;
+    if (name == "prefault")
+        return residency::prefault;
+    if (name == "memory")
+        return residency::in_memory;
+    throw mmap_file::mmap_file_exception{"unknown residency: " + name};
+}
+
+mmap_file::mmap_file(const std::string& path, residency res)
     : path_{path}, start_{nullptr}, size_{filesystem::file_size(path)}
 {
     file_descriptor_ = open(path_.c_str(), O_RDONLY);
@@ -24,13 +71,53 @@ mmap_file::mmap_file(const std::string& path)
         throw mmap_file_exception{"error obtaining file descriptor for "
                                   + path_};
 
-    start_ = (char*)mmap(nullptr, size_, PROT_READ, MAP_SHARED,
-                         file_descriptor_, 0);
+    if (res == residency::in_memory)
+    {
+        start_ = (char*)mmap(nullptr, size_, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (start_ == MAP_FAILED)
+        {
+            start_ = nullptr;
+            close(file_descriptor_);
+            throw mmap_file_exception("error allocating memory for " + path_);
+        }
+#ifdef MADV_HUGEPAGE
+        // the advice must be given before the pages are touched
+        madvise(start_, size_, MADV_HUGEPAGE);
+#endif
+        for (uint64_t done = 0; done < size_;)
+        {
+            auto bytes = read(file_descriptor_, start_ + done, size_ - done);
+            if (bytes <= 0)
+            {
+                munmap(start_, size_);
+                start_ = nullptr;
+                close(file_descriptor_);
+                throw mmap_file_exception("error reading " + path_);
+            }
+            done += static_cast<uint64_t>(bytes);
+        }
+        mprotect(start_, size_, PROT_READ);
+        close(file_descriptor_);
+        file_descriptor_ = -1;
+        return;
+    }
+
+    int flags = MAP_SHARED;
+#ifdef MAP_POPULATE
+    if (res == residency::prefault)
+        flags |= MAP_POPULATE;
+#endif
+    start_ = (char*)mmap(nullptr, size_, PROT_READ, flags, file_descriptor_,
+                         0);
     if (start_ == nullptr)
     {
         close(file_descriptor_);
         throw mmap_file_exception("error memory-mapping " + path_);
     }
+
+    if (res == residency::prefault)
+        advise(access_pattern::will_need);
 }
 
 mmap_file::mmap_file(mmap_file&& other)
@@ -55,6 +142,21 @@ char* mmap_file::begin() const
     return start_;
 }
 
+void mmap_file::advise(access_pattern pattern) const
+{
+    advise(pattern, 0, size_);
+}
+
+void mmap_file::advise(access_pattern pattern, uint64_t offset,
+                       uint64_t bytes) const
+{
+    // dropping the pages of a copy in anonymous memory would zero them
+    if (offset >= size_
+        || (file_descriptor_ < 0 && pattern == access_pattern::dont_need))
+        return;
+    io::advise(start_ + offset, std::min(bytes, size_ - offset), pattern);
+}
+
 mmap_file& mmap_file::operator=(mmap_file&& other)
 {
     if (this != &other)
@@ -62,7 +164,8 @@ mmap_file& mmap_file::operator=(mmap_file&& other)
         if (start_)
         {
             munmap(start_, size_);
-            close(file_descriptor_);
+            if (file_descriptor_ >= 0)
+                close(file_descriptor_);
         }
         path_ = std::move(other.path_);
         start_ = std::move(other.start_);
@@ -78,6 +181,11 @@ uint64_t mmap_file::size() const
     return size_;
 }
 
+util::memory_usage mmap_file::memory_usage() const
+{
+    return util::mapped_memory(start_, size_);
+}
+
 std::string mmap_file::path() const
 {
     return path_;
@@ -88,7 +196,8 @@ mmap_file::~mmap_file()
     if (start_ != nullptr)
     {
         munmap(start_, size_);
-        close(file_descriptor_);
+        if (file_descriptor_ >= 0)
+            close(file_descriptor_);
     }
 }
 }
@@ -13,13 +13,8 @@ namespace io
 
 parser::parser(const std::string& input, const std::string& delims,
                input_type in_type /* = File */)
-    : idx_{0}
+    : idx_{0}, delims_{delims}, has_next_{false}
 {
-    // initialize delimiter array
-    invalid_.fill(false);
-    for (const auto& ch : delims)
-        invalid_[static_cast<uint8_t>(ch)] = true;
-
     // determine whether we're parsing an mmap_file or a std::string
     if (in_type == input_type::File)
     {
@@ -44,23 +39,16 @@ parser& parser::operator=(parser&&) = default;
 
 void parser::get_next()
 {
-    next_ = util::nullopt;
-    for (size_t i = idx_; i < size_; ++i)
-    {
-        if (invalid_[static_cast<uint8_t>(data_[i])])
-        {
-            next_ = std::string{data_ + idx_, i - idx_};
-            idx_ = i + 1;
-            return;
-        }
-    }
+    has_next_ = idx_ != size_;
+    if (!has_next_)
+        return;
 
-    // get last token if there is no delimiter at the EOF
-    if (idx_ != size_)
-    {
-        next_ = std::string{data_ + idx_, size_ - idx_};
-        idx_ = size_;
-    }
+    // the last token need not end with a delimiter
+    auto first = data_ + idx_;
+    auto last = data_ + size_;
+    auto found = delims_.find(first, last);
+    next_ = token{first, static_cast<uint64_t>(found - first)};
+    idx_ = found == last ? size_ : static_cast<size_t>(found - data_) + 1;
 }
 
 std::string parser::filename() const
@@ -70,19 +58,28 @@ std::string parser::filename() const
 
 std::string parser::peek() const
 {
-    return *next_;
+    if (!has_next_)
+        throw parser_exception{"no tokens left to parse"};
+    return next_.str();
 }
 
 std::string parser::next()
 {
-    std::string ret{*next_};
+    return next_token().str();
+}
+
+auto parser::next_token() -> token
+{
+    if (!has_next_)
+        throw parser_exception{"no tokens left to parse"};
+    auto ret = next_;
     get_next();
     return ret;
 }
 
 bool parser::has_next() const
 {
-    return static_cast<bool>(next_);
+    return has_next_;
 }
 }
 }
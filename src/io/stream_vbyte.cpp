@@ -0,0 +1,175 @@
+/**
+ * @file stream_vbyte.cpp
+ */
+
+#include <array>
+#include <cstring>
+
+#include "io/stream_vbyte.h"
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
+
+namespace meta
+{
+namespace io
+{
+namespace stream_vbyte
+{
+
+namespace
+{
+/**
+ * @param value The value to be encoded
+ * @return the number of bytes needed to store value, minus one
+ */
+inline uint8_t code(uint32_t value)
+{
+    if (value < (1u << 8))
+        return 0;
+    if (value < (1u << 16))
+        return 1;
+    if (value < (1u << 24))
+        return 2;
+    return 3;
+}
+
+/**
+ * Lookup tables keyed on a control byte.
+ */
+struct tables
+{
+    /// the number of data bytes described by each control byte
+    std::array<uint8_t, 256> length;
+
+    /// pshufb masks that expand the data bytes into four 32-bit integers
+    std::array<std::array<uint8_t, 16>, 256> shuffle;
+
+    tables()
+    {
+        for (uint32_t ctrl = 0; ctrl < 256; ++ctrl)
+        {
+            uint8_t pos = 0;
+            for (uint32_t i = 0; i < 4; ++i)
+            {
+                uint8_t len = ((ctrl >> (2 * i)) & 3) + 1;
+                for (uint8_t b = 0; b < 4; ++b)
+                    shuffle[ctrl][4 * i + b] = b < len ? pos + b : 0xFF;
+                pos += len;
+            }
+            length[ctrl] = pos;
+        }
+    }
+};
+
+const tables& lookup()
+{
+    static tables t;
+    return t;
+}
+
+/**
+ * Decodes the integers described by the given control bytes one at a
+ * time.
+ */
+inline const uint8_t* decode_scalar(const uint8_t* ctrl, const uint8_t* data,
+                                    uint64_t n, uint32_t* out)
+{
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        uint8_t len = ((ctrl[i / 4] >> (2 * (i % 4))) & 3) + 1;
+        uint32_t value = 0;
+        std::memcpy(&value, data, len);
+        out[i] = value;
+        data += len;
+    }
+    return data;
+}
+}
+
+uint64_t encode(const uint32_t* in, uint64_t n, uint8_t* out)
+{
+    uint8_t* ctrl = out;
+    uint8_t* data = out + (n + 3) / 4;
+    std::memset(ctrl, 0, (n + 3) / 4);
+
+    for (uint64_t i = 0; i < n; ++i)
+    {
+        uint8_t c = code(in[i]);
+        ctrl[i / 4] |= c << (2 * (i % 4));
+        // little endian: the low-order bytes come first
+        for (uint8_t b = 0; b <= c; ++b)
+            *data++ = static_cast<uint8_t>(in[i] >> (8 * b));
+    }
+
+    return static_cast<uint64_t>(data - out);
+}
+
+uint64_t encoded_size(const uint8_t* in, uint64_t n)
+{
+    const auto& t = lookup();
+    uint64_t num_ctrl = (n + 3) / 4;
+    uint64_t size = num_ctrl;
+    for (uint64_t i = 0; i < n / 4; ++i)
+        size += t.length[in[i]];
+    for (uint64_t i = n - n % 4; i < n; ++i)
+        size += ((in[i / 4] >> (2 * (i % 4))) & 3) + 1;
+    return size;
+}
+
+uint64_t decode(const uint8_t* in, uint64_t n, uint32_t* out)
+{
+    const uint8_t* ctrl = in;
+    const uint8_t* data = in + (n + 3) / 4;
+    uint64_t i = 0;
+
+#ifdef __SSSE3__
+    // each 16-byte load may read past the data for the current group, so
+    // only take the vectorized path while that stays within the run
+    const auto& t = lookup();
+    const uint8_t* end = in + encoded_size(in, n);
+    for (; i + 4 <= n && end - data >= 16; i += 4)
+    {
+        uint8_t c = ctrl[i / 4];
+        auto mask = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(t.shuffle[c].data()));
+        auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(out + i),
+                         _mm_shuffle_epi8(bytes, mask));
+        data += t.length[c];
+    }
+#endif
+
+    data = decode_scalar(ctrl + i / 4, data, n - i, out + i);
+    return static_cast<uint64_t>(data - in);
+}
+
+uint64_t write_varint(std::ostream& out, uint64_t value)
+{
+    uint64_t bytes = 1;
+    while (value >= 0x80)
+    {
+        out.put(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+        ++bytes;
+    }
+    out.put(static_cast<char>(value));
+    return bytes;
+}
+
+uint64_t read_varint(const uint8_t*& in)
+{
+    uint64_t value = 0;
+    uint64_t shift = 0;
+    while (*in & 0x80)
+    {
+        value |= static_cast<uint64_t>(*in++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= static_cast<uint64_t>(*in++) << shift;
+    return value;
+}
+}
+}
+}
@@ -7,8 +7,10 @@
  * project.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <iostream>
-#include <sstream>
 #include <random>
 #include "cpptoml.h"
 #include "analyzers/analyzer.h"
@@ -16,7 +18,11 @@
 #include "analyzers/filters/lowercase_filter.h"
 #include "analyzers/filters/alpha_filter.h"
 #include "analyzers/filters/empty_sentence_filter.h"
+#include "corpus/batch_reader.h"
 #include "corpus/corpus.h"
+#include "corpus/tokenized_corpus.h"
+#include "parallel/default_pool.h"
+#include "parallel/thread_pool.h"
 #include "util/shim.h"
 #include "lm/language_model.h"
 
@@ -25,97 +31,266 @@ namespace meta
 namespace lm
 {
 
-language_model::language_model(const std::string& config_file)
+namespace
+{
+/**
+ * @param config_file The config file with a language-model group
+ * @return the value of n it specifies
+ */
+size_t n_value(const std::string& config_file)
 {
     auto config = cpptoml::parse_file(config_file);
     auto group = config.get_table("language-model");
     auto nval = group->get_as<int64_t>("n-value");
     if(!nval)
         throw std::runtime_error{"no n-value specified in language-model group"};
+    return *nval;
+}
+
+/**
+ * @return the token stream a language model is learned from
+ */
+std::unique_ptr<analyzers::token_stream> make_stream()
+{
+    using namespace analyzers;
+    std::unique_ptr<token_stream> stream;
+    stream = make_unique<tokenizers::icu_tokenizer>();
+    stream = make_unique<filters::lowercase_filter>(std::move(stream));
+    stream = make_unique<filters::alpha_filter>(std::move(stream));
+    stream = make_unique<filters::empty_sentence_filter>(std::move(stream));
+    return stream;
+}
+
+/// The counts of each token following each context of n - 1 tokens
+using ngram_counts = ngram_trie::distribution;
 
-    N_ = *nval;
+/**
+ * Counts the n-grams of every order that end in a token.
+ * @param counts The counts of each order, the unigrams first
+ * @param history The previous N - 1 tokens, which the token is added to
+ * @param token The token
+ */
+void count_token(std::vector<ngram_counts>& counts,
+                 std::deque<std::string>& history, const std::string& token)
+{
+    ++counts[0][""][token]; // unigram has no previous tokens
 
-    if (N_ > 1)
-        interp_ = make_unique<language_model>(config_file, N_ - 1);
+    // the context of each order is that of the order below it with one
+    // more previous token in front
+    std::string context;
+    for (size_t n = 1; n < counts.size(); ++n)
+    {
+        const auto& prev = history[history.size() - n];
+        context = n == 1 ? prev : prev + " " + context;
+        ++counts[n][context][token];
+    }
 
-    learn_model(config_file);
+    if (!history.empty())
+    {
+        history.pop_front();
+        history.push_back(token);
+    }
+}
 }
 
-language_model::language_model(const std::string& config_file, size_t n):
-    N_{n}
+language_model::language_model(const std::string& config_file)
+    : language_model{config_file, n_value(config_file)}
 {
-    if (N_ > 1)
-        interp_ = make_unique<language_model>(config_file, N_ - 1);
+    // nothing
+}
 
+language_model::language_model(const std::string& config_file, size_t n)
+    : language_model{n}
+{
     learn_model(config_file);
 }
 
-void language_model::learn_model(const std::string& config_file)
+language_model::language_model(size_t n) : unk_{0}, N_{n}
 {
-    std::cout << "Creating " << N_ << "-gram language model" << std::endl;
+    // nothing
+}
 
-    auto corpus = corpus::corpus::load(config_file);
+language_model::language_model(ngram_trie trie)
+    : trie_{std::move(trie)}, unk_{trie_.id("<unk>")}, N_{trie_.order()}
+{
+    // nothing
+}
 
-    using namespace analyzers;
-    std::unique_ptr<token_stream> stream;
-    stream = make_unique<tokenizers::icu_tokenizer>();
-    stream = make_unique<filters::lowercase_filter>(std::move(stream));
-    stream = make_unique<filters::alpha_filter>(std::move(stream));
-    stream = make_unique<filters::empty_sentence_filter>(std::move(stream));
+language_model language_model::load(const std::string& filename)
+{
+    return language_model{ngram_trie{filename}};
+}
 
-    while (corpus->has_next())
+language_model language_model::load_arpa(const std::string& filename)
+{
+    return language_model{ngram_trie::read_arpa(filename)};
+}
+
+void language_model::save(const std::string& filename) const
+{
+    trie_.save(filename);
+}
+
+void language_model::save_arpa(const std::string& filename) const
+{
+    trie_.write_arpa(filename);
+}
+
+void language_model::write_tokenized_corpus(const std::string& config_file,
+                                            const std::string& filename)
+{
+    auto docs = corpus::corpus::load(config_file);
+    auto stream = make_stream();
+    corpus::tokenized_corpus_writer writer{filename, true};
+    std::vector<std::string> tokens;
+    while (docs->has_next())
     {
-        auto doc = corpus->next();
+        auto doc = docs->next();
         stream->set_content(doc.content());
+        tokens.clear();
+        while (*stream)
+            tokens.push_back(stream->next());
+        writer.write(doc, tokens);
+    }
+    writer.close();
+}
+
+void language_model::learn_model(const std::string& config_file)
+{
+    if (N_ == 0)
+        throw std::runtime_error{"n-value must be positive"};
+    std::cout << "Creating " << N_ << "-gram language model" << std::endl;
 
-        // get ngram stream started
-        std::deque<std::string> ngram;
-        for (size_t i = 1; i < N_; ++i)
-            ngram.push_back("<s>");
+    auto corpus = corpus::corpus::load(config_file);
 
-        // count each ngram occurrence
-        while (*stream)
+    // a tokenized corpus of sequences already holds the tokens the stream
+    // would give, but its bags of terms have lost their order
+    auto tokenized = dynamic_cast<corpus::tokenized_corpus*>(corpus.get());
+    if (tokenized && !tokenized->sequences())
+        throw std::runtime_error{
+            "a language model needs a tokenized corpus of sequences"};
+
+    // every order is counted in the same pass; each thread keeps its own
+    // counts, which are added together once the corpus has been read
+    std::vector<std::vector<ngram_counts>> thread_counts;
+    if (tokenized)
+    {
+        // the sequences are read from the corpus itself, and there is no
+        // tokenizing left to spread across threads
+        thread_counts.emplace_back(N_);
+        std::deque<std::string> history;
+        while (corpus->has_next())
+        {
+            corpus->next();
+            history.assign(N_ - 1, "<s>");
+            for (const auto& id : tokenized->sequence())
+                count_token(thread_counts[0], history, tokenized->term(id));
+        }
+    }
+    else
+    {
+        // one thread reads the corpus, and the workers tokenize whole
+        // batches of documents from it
+        corpus::batch_reader reader{*corpus, " > Counting n-grams: "};
+        parallel::thread_pool pool;
+        thread_counts.resize(pool.thread_ids().size(),
+                             std::vector<ngram_counts>(N_));
+        std::vector<std::future<void>> futures;
+        for (auto& counts : thread_counts)
         {
-            auto token = stream->next();
-            if (N_ > 1)
+            futures.emplace_back(pool.submit_task([&]()
             {
-                ++dist_[make_string(ngram)][token];
-                ngram.pop_front();
-                ngram.push_back(token);
+                auto stream = make_stream();
+                std::deque<std::string> history;
+                std::vector<corpus::document> batch;
+                while (reader.next(batch))
+                {
+                    for (const auto& doc : batch)
+                    {
+                        history.assign(N_ - 1, "<s>");
+                        stream->set_content(doc.content());
+                        while (*stream)
+                            count_token(counts, history, stream->next());
+                    }
+                }
+            }));
+        }
+        for (auto& fut : futures)
+            fut.get();
+    }
+
+    // the counts of each order are added together and turned into
+    // probabilities, then packed into the trie
+    auto& dists = thread_counts[0];
+    for (size_t t = 1; t < thread_counts.size(); ++t)
+    {
+        for (size_t n = 0; n < N_; ++n)
+        {
+            for (auto& map : thread_counts[t][n])
+            {
+                auto& endings = dists[n][map.first];
+                for (auto& end : map.second)
+                    endings[end.first] += end.second;
             }
-            else
-                ++dist_[""][token]; // unigram has no previous tokens
+            thread_counts[t][n].clear();
         }
     }
 
-    // turn counts into probabilities
-    for (auto& map : dist_)
+    // each order's probabilities are interpolated with those of the
+    // order below it, whose n-gram ending in the same token was always
+    // counted too; an n-gram that was never seen is left to back off,
+    // which scales the lower order's probability by 1 - lambda
+    for (size_t n = 0; n < N_; ++n)
     {
-        double sum = 0.0;
-        for (auto& end : map.second)
-            sum += end.second;
-        for (auto& end : map.second)
-            end.second /= sum;
+        for (auto& map : dists[n])
+        {
+            double sum = 0.0;
+            for (auto& end : map.second)
+                sum += end.second;
+
+            const std::unordered_map<std::string, double>* lower = nullptr;
+            if (n > 0)
+            {
+                auto space = map.first.find(' ');
+                auto shorter = space == std::string::npos
+                                   ? std::string{}
+                                   : map.first.substr(space + 1);
+                lower = &dists[n - 1].at(shorter);
+            }
+            for (auto& end : map.second)
+            {
+                auto lower_prob = lower ? lower->at(end.first) : 1.0;
+                end.second = lambda_ * end.second / sum
+                             + (1.0 - lambda_) * lower_prob;
+            }
+        }
     }
+
+    // unknown tokens are scored as a unigram that was never seen
+    dists[0][""].emplace("<unk>", 1.0 - lambda_);
+
+    trie_ = ngram_trie{dists, {}, 1.0 - lambda_};
+    unk_ = trie_.id("<unk>");
 }
 
 std::string language_model::next_token(const std::deque<std::string>& tokens,
                                        double random) const
 {
-    auto str = make_string(tokens);
-    auto it = dist_.find(str);
-    if (it == dist_.end())
-        throw std::runtime_error{"couldn't find previous n - 1 tokens: " + str};
-
-    double cur = 0.0;
-    for (auto& end : it->second)
+    // the context is found from its last token back, backing off to the
+    // longest one that exists (an ARPA model has no context of several
+    // <s>, for instance)
+    auto node = trie_.root();
+    for (auto it = tokens.rbegin(); it != tokens.rend(); ++it)
     {
-        cur += end.second;
-        if (cur > random)
-            return end.first;
+        if (!trie_.extend(node, token_id(*it)))
+            break;
     }
 
-    throw std::runtime_error{"could not generate next token: " + str};
+    auto next = trie_.sample(node, random);
+    if (next == trie_.vocab_size())
+        throw std::runtime_error{"could not generate next token: "
+                                 + make_string(tokens)};
+    return trie_.word(next);
 }
 
 std::string language_model::generate(unsigned int seed) const
@@ -128,19 +303,21 @@ std::string language_model::generate(unsigned int seed) const
     for (size_t n = 1; n < N_; ++n)
         ngram.push_back("<s>");
 
-    // keep generating until we see </s>
+    // keep generating until we see </s>; each token is written out as it
+    // is generated, except for sentence-start markers
     std::string output;
     std::string next = next_token(ngram, rdist(gen));
     while (next != "</s>")
     {
-        if (ngram.front() != "<s>")
-            output += " " + ngram.front();
-        ngram.pop_front();
-        ngram.push_back(next);
+        if (next != "<s>")
+            output += (output.empty() ? "" : " ") + next;
+        if (!ngram.empty())
+        {
+            ngram.pop_front();
+            ngram.push_back(next);
+        }
         next = next_token(ngram, rdist(gen));
     }
-
-    output += make_string(ngram);
     return output;
 }
 
@@ -149,58 +326,157 @@ double language_model::prob(std::deque<std::string> tokens) const
     if (tokens.size() != N_)
         throw std::runtime_error{"prob() needs one N-gram"};
 
-    std::deque<std::string> interp_tokens{tokens};
-    interp_tokens.pop_front(); // look at prev N - 1
-    auto interp_prob = interp_ ? interp_->prob(interp_tokens) : 1.0;
-
-    auto last = tokens.back();
-    tokens.pop_back();
+    std::vector<uint32_t> ngram;
+    ngram.reserve(N_);
+    for (const auto& token : tokens)
+        ngram.push_back(token_id(token));
+    std::vector<uint64_t> nodes(N_);
+    uint64_t depth = N_ - 1;
+    return ngram_prob(ngram.data(), nodes.data(), depth);
+}
 
-    auto ngram = make_string(tokens);
+uint32_t language_model::token_id(const std::string& token) const
+{
+    return token_id(token.data(), token.size());
+}
 
-    auto endings = dist_.find(ngram);
-    if (endings == dist_.end())
-        return (1.0 - lambda_) * interp_prob;
+uint32_t language_model::token_id(const char* token, uint64_t length) const
+{
+    auto id = trie_.id(token, length);
+    return id == trie_.vocab_size() ? unk_ : id;
+}
 
-    auto prob = endings->second.find(last);
-    if (prob == endings->second.end())
-        return (1.0 - lambda_) * interp_prob;
+double language_model::ngram_prob(const uint32_t* ngram, uint64_t* nodes,
+                                  uint64_t& depth) const
+{
+    // the context of each order is that of the order below it with one
+    // more previous token, so every order is found in one walk down the
+    // trie, which stops at the first that is missing or at the longest
+    // that could exist
+    auto token = ngram[N_ - 1];
+    auto max_depth = depth;
+    nodes[0] = trie_.root();
+    depth = 0;
+    while (depth < max_depth)
+    {
+        auto node = nodes[depth];
+        if (!trie_.extend(node, ngram[N_ - 2 - depth]))
+            break;
+        nodes[++depth] = node;
+    }
 
-    return lambda_ * prob->second + (1.0 - lambda_) * interp_prob;
+    // the probability is that of the longest context the token was seen
+    // after, times the back-off weight of each longer context; a token
+    // never seen at all is given ARPA's log probability of -99
+    double backoff = 1.0;
+    for (auto d = depth + 1; d-- > 0;)
+    {
+        auto prob = trie_.prob(nodes[d], token);
+        if (prob >= 0)
+            return backoff * prob;
+        backoff *= trie_.backoff(nodes[d]);
+    }
+    return backoff * 1e-99;
 }
 
 double language_model::perplexity(const std::string& tokens) const
 {
-    std::deque<std::string> ngram;
-    for (size_t i = 1; i < N_; ++i)
-        ngram.push_back("<s>");
+    score_buffers buffers;
+    return perplexity(tokens, buffers);
+}
 
+double language_model::perplexity(const std::string& tokens,
+                                  score_buffers& buffers) const
+{
+    auto& window = buffers.window;
+    window.assign(N_, token_id("<s>", 3));
+    buffers.nodes.resize(N_);
+
+    // the context of a position can be at most one token longer than the
+    // longest context of the position before it, since a context's own
+    // context was always seen too, so each walk down the trie is bounded
+    // by the last
+    uint64_t depth = N_ - 1;
     double perp = 0.0;
-    for (auto& token : make_deque(tokens))
+    auto pos = tokens.data();
+    auto end = pos + tokens.size();
+    while (true)
     {
-        ngram.push_back(token);
-        perp += std::log(1.0 + 1.0 / prob(ngram));
-        ngram.pop_front();
+        while (pos != end && std::isspace(static_cast<unsigned char>(*pos)))
+            ++pos;
+        if (pos == end)
+            break;
+        auto token = pos;
+        while (pos != end && !std::isspace(static_cast<unsigned char>(*pos)))
+            ++pos;
+
+        std::copy(window.begin() + 1, window.end(), window.begin());
+        window.back() = token_id(token, static_cast<uint64_t>(pos - token));
+        depth = std::min<uint64_t>(depth + 1, N_ - 1);
+        perp += std::log(
+            1.0 + 1.0 / ngram_prob(window.data(), buffers.nodes.data(), depth));
     }
 
     return std::pow(perp, 1.0 / N_);
 }
 
-double language_model::perplexity_per_word(const std::string& tokens) const
+std::vector<double>
+    language_model::perplexity(const std::vector<std::string>& sequences,
+                               parallel::thread_pool& pool) const
 {
-    return perplexity(tokens) / tokens.size();
+    // the threads take batches of sequences from a shared counter, each
+    // scoring with its own buffers
+    const uint64_t batch_size = 64;
+    std::vector<double> perps(sequences.size());
+    std::atomic<uint64_t> next{0};
+    std::vector<std::future<void>> futures;
+    for (uint64_t t = 0; t < pool.thread_ids().size(); ++t)
+    {
+        futures.emplace_back(pool.submit_task([&]()
+        {
+            score_buffers buffers;
+            while (true)
+            {
+                auto begin = next.fetch_add(batch_size);
+                if (begin >= sequences.size())
+                    break;
+                auto last = std::min<uint64_t>(begin + batch_size,
+                                               sequences.size());
+                for (auto i = begin; i < last; ++i)
+                    perps[i] = perplexity(sequences[i], buffers);
+            }
+        }));
+    }
+    for (auto& fut : futures)
+        fut.get();
+    return perps;
+}
+
+std::vector<double> language_model::perplexity(
+    const std::vector<std::string>& sequences) const
+{
+    return perplexity(sequences, parallel::default_pool());
 }
 
-std::deque<std::string> language_model::make_deque(const std::string
-                                                   & tokens) const
+std::vector<double> language_model::perplexity_per_word(
+    const std::vector<std::string>& sequences,
+    parallel::thread_pool& pool) const
 {
-    std::deque<std::string> d;
-    std::stringstream sstream{tokens};
-    std::string token;
-    while (sstream >> token)
-        d.push_back(token);
+    auto perps = perplexity(sequences, pool);
+    for (uint64_t i = 0; i < perps.size(); ++i)
+        perps[i] /= sequences[i].size();
+    return perps;
+}
+
+std::vector<double> language_model::perplexity_per_word(
+    const std::vector<std::string>& sequences) const
+{
+    return perplexity_per_word(sequences, parallel::default_pool());
+}
 
-    return d;
+double language_model::perplexity_per_word(const std::string& tokens) const
+{
+    return perplexity(tokens) / tokens.size();
 }
 
 std::string language_model::make_string(const std::deque
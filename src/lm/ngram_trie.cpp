@@ -0,0 +1,736 @@
+/**
+ * @file ngram_trie.cpp
+ *
+ * All files in META are dual-licensed under the MIT and NCSA licenses. For more
+ * details, consult the file LICENSE.mit and LICENSE.ncsa in the root of the
+ * project.
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <limits>
+#include <set>
+#include <sstream>
+
+#include "lm/ngram_trie.h"
+
+namespace meta
+{
+namespace lm
+{
+
+namespace
+{
+/// Identifies a model file ("METALM02")
+const uint64_t magic = 0x32304d4c4154454dULL;
+
+/// The fixed-point value of a cumulative probability of one
+const uint32_t cumulative_one = std::numeric_limits<uint32_t>::max();
+
+/// The smallest logarithm that is stored; ARPA files give unlikely
+/// tokens such as <s> a log probability of -99, which would otherwise
+/// take up most of the quantization range
+const double min_log = -69.0;
+
+/**
+ * The fixed-size start of a model file.
+ */
+struct file_header
+{
+    uint64_t magic;
+    uint64_t order;
+    uint64_t vocab_size;
+    uint64_t word_bytes;
+    uint64_t num_nodes;
+    uint64_t num_endings;
+    double prob_lo;
+    double prob_step;
+    double backoff_lo;
+    double backoff_step;
+};
+
+/**
+ * A context, as the ids of its tokens from last to first, with the
+ * distribution of the tokens following it (or nullptr if none do) and its
+ * back-off weight.
+ */
+struct context_entry
+{
+    std::vector<uint32_t> ids;
+    const std::unordered_map<std::string, double>* endings;
+    double backoff;
+};
+
+/**
+ * Orders contexts by their tokens.
+ */
+bool by_context(const context_entry& a, const context_entry& b)
+{
+    return a.ids < b.ids;
+}
+
+/**
+ * Quantizes logarithms evenly between the smallest and largest.
+ */
+struct quantizer
+{
+    double lo = 0;
+    double hi = 0;
+    double step = 1;
+
+    void add(double value)
+    {
+        auto log = std::max(min_log, std::log(value));
+        if (empty)
+            lo = hi = log;
+        lo = std::min(lo, log);
+        hi = std::max(hi, log);
+        empty = false;
+        if (hi > lo)
+            step = (hi - lo) / std::numeric_limits<uint16_t>::max();
+    }
+
+    uint16_t encode(double value) const
+    {
+        auto log = std::max(min_log, std::log(value));
+        auto q = std::round((log - lo) / step);
+        q = std::min<double>(q, std::numeric_limits<uint16_t>::max());
+        return static_cast<uint16_t>(std::max(0.0, q));
+    }
+
+    bool empty = true;
+};
+
+/**
+ * Appends an array to a model, padded to a multiple of eight bytes.
+ * @param out The model
+ * @param data The array
+ * @param bytes The size of the array
+ */
+void append(std::vector<char>& out, const void* data, uint64_t bytes)
+{
+    auto begin = static_cast<const char*>(data);
+    out.insert(out.end(), begin, begin + bytes);
+    out.resize((out.size() + 7) / 8 * 8, '\0');
+}
+
+/**
+ * @param bytes A number of bytes
+ * @return the number rounded up to a multiple of eight
+ */
+uint64_t padded(uint64_t bytes)
+{
+    return (bytes + 7) / 8 * 8;
+}
+
+/**
+ * @param tokens A string of space-separated tokens
+ * @return the tokens
+ */
+std::vector<std::string> split(const std::string& tokens)
+{
+    std::vector<std::string> result;
+    std::istringstream stream{tokens};
+    std::string token;
+    while (stream >> token)
+        result.push_back(token);
+    return result;
+}
+}
+
+ngram_trie::ngram_trie() : ngram_trie{{}, {}, 1.0}
+{
+    // nothing
+}
+
+ngram_trie::ngram_trie(const std::vector<distribution>& dists,
+                       const std::vector<backoff_weights>& backoffs,
+                       double default_backoff)
+{
+    // the vocabulary is every token in a context or following one
+    std::set<std::string> vocab;
+    quantizer probs;
+    quantizer weights;
+    weights.add(default_backoff);
+    for (const auto& dist : dists)
+    {
+        for (const auto& map : dist)
+        {
+            for (auto& token : split(map.first))
+                vocab.insert(std::move(token));
+            for (const auto& end : map.second)
+            {
+                vocab.insert(end.first);
+                probs.add(end.second);
+            }
+        }
+    }
+    for (const auto& weight_map : backoffs)
+    {
+        for (const auto& weight : weight_map)
+        {
+            for (auto& token : split(weight.first))
+                vocab.insert(std::move(token));
+            weights.add(weight.second);
+        }
+    }
+    std::vector<std::string> words{vocab.begin(), vocab.end()};
+    vocab.clear();
+    auto word_id = [&](const std::string& word)
+    {
+        return static_cast<uint32_t>(
+            std::lower_bound(words.begin(), words.end(), word)
+            - words.begin());
+    };
+    auto unk = std::binary_search(words.begin(), words.end(), "<unk>")
+                   ? word_id("<unk>")
+                   : static_cast<uint32_t>(words.size());
+    auto context_ids = [&](const std::string& context)
+    {
+        std::vector<uint32_t> ids;
+        for (const auto& token : split(context))
+            ids.push_back(word_id(token));
+        std::reverse(ids.begin(), ids.end());
+        return ids;
+    };
+
+    // the contexts of order n + 1 are the nodes at depth n, read from the
+    // last token back; the highest order's n-grams are never contexts, so
+    // back-off weights are only kept below it
+    std::vector<std::vector<context_entry>> levels(
+        std::max<uint64_t>(dists.size(), 1));
+    for (uint64_t n = 0; n < dists.size(); ++n)
+    {
+        levels[n].reserve(dists[n].size());
+        for (const auto& map : dists[n])
+        {
+            auto weight = default_backoff;
+            if (n < backoffs.size())
+            {
+                auto it = backoffs[n].find(map.first);
+                if (it != backoffs[n].end())
+                    weight = it->second;
+            }
+            levels[n].push_back({context_ids(map.first), &map.second, weight});
+        }
+    }
+    for (uint64_t n = 0; n < backoffs.size() && n < levels.size(); ++n)
+    {
+        for (const auto& weight : backoffs[n])
+        {
+            if (n >= dists.size() || !dists[n].count(weight.first))
+                levels[n].push_back(
+                    {context_ids(weight.first), nullptr, weight.second});
+        }
+    }
+    if (levels[0].empty())
+        levels[0].push_back({{}, nullptr, default_backoff});
+
+    // a context is normally present along with the shorter ones it ends
+    // in, but a node whose parent is missing is given one rather than
+    // being unreachable
+    for (uint64_t d = levels.size() - 1; d > 0; --d)
+    {
+        std::sort(levels[d].begin(), levels[d].end(), by_context);
+        std::sort(levels[d - 1].begin(), levels[d - 1].end(), by_context);
+        std::vector<context_entry> missing;
+        for (const auto& entry : levels[d])
+        {
+            context_entry parent{
+                {entry.ids.begin(), entry.ids.end() - 1}, nullptr,
+                default_backoff};
+            auto it = std::lower_bound(levels[d - 1].begin(),
+                                       levels[d - 1].end(), parent,
+                                       by_context);
+            if ((it == levels[d - 1].end() || it->ids != parent.ids)
+                && (missing.empty() || missing.back().ids != parent.ids))
+                missing.push_back(std::move(parent));
+        }
+        levels[d - 1].insert(levels[d - 1].end(), missing.begin(),
+                             missing.end());
+        std::sort(levels[d - 1].begin(), levels[d - 1].end(), by_context);
+    }
+
+    uint64_t num_nodes = 0;
+    for (const auto& level : levels)
+        num_nodes += level.size();
+    std::vector<uint32_t> node_words;
+    std::vector<uint64_t> child_begin;
+    std::vector<uint64_t> ending_begin;
+    std::vector<uint16_t> node_backoffs;
+    std::vector<uint32_t> ending_words;
+    std::vector<uint16_t> ending_probs;
+    std::vector<uint32_t> ending_cumulative;
+    node_words.reserve(num_nodes);
+    child_begin.reserve(num_nodes + 1);
+    ending_begin.reserve(num_nodes + 1);
+    node_backoffs.reserve(num_nodes);
+
+    // the children of each level's nodes, in order, make up the next
+    // level, so the next level is swept once alongside this one
+    uint64_t level_begin = 0;
+    for (uint64_t d = 0; d < levels.size(); ++d)
+    {
+        auto next_begin = level_begin + levels[d].size();
+        uint64_t child = 0;
+        for (const auto& entry : levels[d])
+        {
+            node_words.push_back(entry.ids.empty() ? 0 : entry.ids.back());
+            node_backoffs.push_back(weights.encode(entry.backoff));
+            child_begin.push_back(next_begin + child);
+            if (d + 1 < levels.size())
+            {
+                const auto& next = levels[d + 1];
+                while (child < next.size()
+                       && std::equal(entry.ids.begin(), entry.ids.end(),
+                                     next[child].ids.begin()))
+                    ++child;
+            }
+
+            ending_begin.push_back(ending_words.size());
+            if (!entry.endings)
+                continue;
+            std::vector<std::pair<uint32_t, double>> endings;
+            endings.reserve(entry.endings->size());
+            for (const auto& end : *entry.endings)
+                endings.emplace_back(word_id(end.first), end.second);
+            std::sort(endings.begin(), endings.end());
+
+            // the tokens are sampled from a cumulative distribution in
+            // fixed point, which <unk> takes no share of
+            double total = 0;
+            for (const auto& end : endings)
+            {
+                if (end.first != unk)
+                    total += end.second;
+            }
+            double cumulative = 0;
+            for (const auto& end : endings)
+            {
+                ending_words.push_back(end.first);
+                ending_probs.push_back(probs.encode(end.second));
+                if (end.first != unk)
+                    cumulative += end.second;
+                ending_cumulative.push_back(
+                    total > 0 ? static_cast<uint32_t>(std::round(
+                                    cumulative / total * cumulative_one))
+                              : 0);
+            }
+            if (total > 0)
+                ending_cumulative.back() = cumulative_one;
+        }
+        level_begin = next_begin;
+    }
+    child_begin.push_back(num_nodes);
+    ending_begin.push_back(ending_words.size());
+    levels.clear();
+
+    std::vector<uint64_t> word_offsets{0};
+    std::vector<char> word_data;
+    for (const auto& word : words)
+    {
+        word_data.insert(word_data.end(), word.begin(), word.end());
+        word_data.push_back('\0');
+        word_offsets.push_back(word_data.size());
+    }
+
+    file_header header{magic,
+                       std::max<uint64_t>(dists.size(), 1),
+                       words.size(),
+                       word_data.size(),
+                       num_nodes,
+                       ending_words.size(),
+                       probs.lo,
+                       probs.step,
+                       weights.lo,
+                       weights.step};
+    std::vector<char> model;
+    append(model, &header, sizeof(header));
+    append(model, word_offsets.data(), word_offsets.size() * sizeof(uint64_t));
+    append(model, child_begin.data(), child_begin.size() * sizeof(uint64_t));
+    append(model, ending_begin.data(), ending_begin.size() * sizeof(uint64_t));
+    append(model, node_words.data(), node_words.size() * sizeof(uint32_t));
+    append(model, ending_words.data(), ending_words.size() * sizeof(uint32_t));
+    append(model, ending_cumulative.data(),
+           ending_cumulative.size() * sizeof(uint32_t));
+    append(model, node_backoffs.data(),
+           node_backoffs.size() * sizeof(uint16_t));
+    append(model, ending_probs.data(), ending_probs.size() * sizeof(uint16_t));
+    append(model, word_data.data(), word_data.size());
+
+    memory_.resize(model.size() / sizeof(uint64_t));
+    std::memcpy(memory_.data(), model.data(), model.size());
+    map(reinterpret_cast<const char*>(memory_.data()), model.size());
+}
+
+ngram_trie::ngram_trie(const std::string& filename,
+                       io::residency res /* = io::residency::on_demand */)
+{
+    try
+    {
+        file_.reset(new io::mmap_file{filename, res});
+    }
+    catch (const io::mmap_file::mmap_file_exception& ex)
+    {
+        throw ngram_trie_exception{"cannot load model: "
+                                   + std::string{ex.what()}};
+    }
+    file_->advise(io::access_pattern::random);
+    map(file_->begin(), file_->size());
+}
+
+void ngram_trie::map(const char* data, uint64_t size)
+{
+    file_header header;
+    if (size < sizeof(header))
+        throw ngram_trie_exception{"model file is too short"};
+    std::memcpy(&header, data, sizeof(header));
+    if (header.magic != magic)
+        throw ngram_trie_exception{"not a language model file"};
+
+    auto expected = padded(sizeof(header))
+                    + padded((header.vocab_size + 1) * sizeof(uint64_t))
+                    + 2 * padded((header.num_nodes + 1) * sizeof(uint64_t))
+                    + padded(header.num_nodes * sizeof(uint32_t))
+                    + 2 * padded(header.num_endings * sizeof(uint32_t))
+                    + padded(header.num_nodes * sizeof(uint16_t))
+                    + padded(header.num_endings * sizeof(uint16_t))
+                    + padded(header.word_bytes);
+    if (size != expected)
+        throw ngram_trie_exception{"model file has the wrong size"};
+
+    order_ = header.order;
+    vocab_size_ = header.vocab_size;
+    num_nodes_ = header.num_nodes;
+    num_endings_ = header.num_endings;
+    prob_lo_ = header.prob_lo;
+    prob_step_ = header.prob_step;
+    backoff_lo_ = header.backoff_lo;
+    backoff_step_ = header.backoff_step;
+
+    auto pos = data + padded(sizeof(header));
+    auto next = [&](uint64_t bytes)
+    {
+        auto start = pos;
+        pos += padded(bytes);
+        return start;
+    };
+    word_offsets_ = reinterpret_cast<const uint64_t*>(
+        next((vocab_size_ + 1) * sizeof(uint64_t)));
+    child_begin_ = reinterpret_cast<const uint64_t*>(
+        next((num_nodes_ + 1) * sizeof(uint64_t)));
+    ending_begin_ = reinterpret_cast<const uint64_t*>(
+        next((num_nodes_ + 1) * sizeof(uint64_t)));
+    node_words_ = reinterpret_cast<const uint32_t*>(
+        next(num_nodes_ * sizeof(uint32_t)));
+    ending_words_ = reinterpret_cast<const uint32_t*>(
+        next(num_endings_ * sizeof(uint32_t)));
+    ending_cumulative_ = reinterpret_cast<const uint32_t*>(
+        next(num_endings_ * sizeof(uint32_t)));
+    node_backoffs_ = reinterpret_cast<const uint16_t*>(
+        next(num_nodes_ * sizeof(uint16_t)));
+    ending_probs_ = reinterpret_cast<const uint16_t*>(
+        next(num_endings_ * sizeof(uint16_t)));
+    word_data_ = next(header.word_bytes);
+}
+
+void ngram_trie::save(const std::string& filename) const
+{
+    std::ofstream out{filename, std::ios::binary};
+    if (!out)
+        throw ngram_trie_exception{"cannot write model: " + filename};
+
+    // a loaded model is written back from its file; the two share a layout
+    const char* data;
+    uint64_t size;
+    if (file_)
+    {
+        data = file_->begin();
+        size = file_->size();
+    }
+    else
+    {
+        data = reinterpret_cast<const char*>(memory_.data());
+        size = memory_.size() * sizeof(uint64_t);
+    }
+    out.write(data, static_cast<std::streamsize>(size));
+    if (!out)
+        throw ngram_trie_exception{"cannot write model: " + filename};
+}
+
+ngram_trie ngram_trie::read_arpa(const std::string& filename)
+{
+    std::ifstream in{filename};
+    if (!in)
+        throw ngram_trie_exception{"cannot read ARPA file: " + filename};
+
+    std::vector<distribution> dists;
+    std::vector<backoff_weights> backoffs;
+    std::string line;
+    uint64_t line_num = 0;
+    uint64_t order = 0; // the order of the current section, or 0
+    bool in_data = false;
+    auto fail = [&](const std::string& msg)
+    {
+        throw ngram_trie_exception{filename + ":" + std::to_string(line_num)
+                                   + ": " + msg};
+    };
+
+    while (std::getline(in, line))
+    {
+        ++line_num;
+        auto fields = split(line);
+        if (fields.empty())
+            continue;
+
+        if (fields[0] == "\\data\\")
+        {
+            in_data = true;
+            continue;
+        }
+        if (fields[0] == "\\end\\")
+            break;
+        if (fields[0].front() == '\\')
+        {
+            // a section header such as \3-grams:
+            in_data = false;
+            order = std::strtoull(fields[0].c_str() + 1, nullptr, 10);
+            if (order == 0 || order > dists.size())
+                fail("unexpected section " + fields[0]);
+            continue;
+        }
+        if (in_data)
+        {
+            // ngram n=count
+            auto eq = line.find('=');
+            if (fields[0] != "ngram" || eq == std::string::npos)
+                fail("malformed \\data\\ line");
+            auto n = std::strtoull(line.c_str() + line.find("ngram") + 5,
+                                   nullptr, 10);
+            if (n == 0)
+                fail("malformed \\data\\ line");
+            if (n > dists.size())
+            {
+                dists.resize(n);
+                backoffs.resize(n);
+            }
+            continue;
+        }
+        if (order == 0)
+            continue; // text before \data\ is ignored
+
+        if (fields.size() != order + 1 && fields.size() != order + 2)
+            fail("expected a " + std::to_string(order) + "-gram");
+
+        auto prob = std::pow(10.0, std::stod(fields[0]));
+        std::string context;
+        for (uint64_t i = 1; i < order; ++i)
+            context += (i == 1 ? "" : " ") + fields[i];
+        dists[order - 1][context][fields[order]] = prob;
+
+        if (fields.size() == order + 2 && order < dists.size())
+        {
+            auto ngram = context.empty() ? fields[order]
+                                         : context + " " + fields[order];
+            backoffs[order][ngram] = std::pow(10.0, std::stod(fields.back()));
+        }
+    }
+
+    if (dists.empty())
+        throw ngram_trie_exception{"no \\data\\ section in " + filename};
+    return ngram_trie{dists, backoffs, 1.0};
+}
+
+void ngram_trie::write_arpa(const std::string& filename) const
+{
+    std::ofstream out{filename};
+    if (!out)
+        throw ngram_trie_exception{"cannot write ARPA file: " + filename};
+    out << std::setprecision(7);
+
+    // the n-gram a node stands for is its context read forward; it is
+    // listed even when it never follows its own context, so that its
+    // back-off weight is
+    auto ngram_node = [&](uint32_t last, const std::vector<uint32_t>& context,
+                          uint64_t& node)
+    {
+        node = root();
+        if (!extend(node, last))
+            return false;
+        for (auto id : context)
+        {
+            if (!extend(node, id))
+                return false;
+        }
+        return true;
+    };
+    auto listed = [&](const std::vector<uint32_t>& context)
+    {
+        auto node = root();
+        for (uint64_t i = 1; i < context.size(); ++i)
+        {
+            if (!extend(node, context[i]))
+                return false;
+        }
+        return prob(node, context[0]) >= 0;
+    };
+
+    std::vector<uint64_t> counts(order_, 0);
+    std::vector<uint32_t> context;
+    each_context(root(), context,
+                 [&](uint64_t node, const std::vector<uint32_t>& ctx)
+    {
+        counts[ctx.size()] += ending_begin_[node + 1] - ending_begin_[node];
+        if (!ctx.empty() && !listed(ctx))
+            ++counts[ctx.size() - 1];
+    });
+
+    out << "\n\\data\\\n";
+    for (uint64_t n = 1; n <= order_; ++n)
+        out << "ngram " << n << "=" << counts[n - 1] << "\n";
+
+    for (uint64_t n = 1; n <= order_; ++n)
+    {
+        out << "\n\\" << n << "-grams:\n";
+        auto write_ngram = [&](double prob, uint32_t last,
+                               const std::vector<uint32_t>& ctx)
+        {
+            out << std::log10(prob) << "\t";
+            for (auto it = ctx.rbegin(); it != ctx.rend(); ++it)
+                out << word(*it) << " ";
+            out << word(last);
+            uint64_t node;
+            if (n < order_ && ngram_node(last, ctx, node))
+                out << "\t" << std::log10(backoff(node));
+            out << "\n";
+        };
+
+        each_context(root(), context,
+                     [&](uint64_t node, const std::vector<uint32_t>& ctx)
+        {
+            if (ctx.size() == n - 1)
+            {
+                each_ending(node, [&](uint32_t last, double prob)
+                {
+                    write_ngram(prob, last, ctx);
+                });
+            }
+            else if (ctx.size() == n && !listed(ctx))
+            {
+                std::vector<uint32_t> shorter{ctx.begin() + 1, ctx.end()};
+                out << "-99\t";
+                for (auto it = shorter.rbegin(); it != shorter.rend(); ++it)
+                    out << word(*it) << " ";
+                out << word(ctx[0]) << "\t" << std::log10(backoff(node))
+                    << "\n";
+            }
+        });
+    }
+    out << "\n\\end\\\n";
+}
+
+void ngram_trie::each_context(
+    uint64_t node, std::vector<uint32_t>& context,
+    const std::function<void(uint64_t, const std::vector<uint32_t>&)>& fn)
+    const
+{
+    fn(node, context);
+    for (auto child = child_begin_[node]; child < child_begin_[node + 1];
+         ++child)
+    {
+        context.push_back(node_words_[child]);
+        each_context(child, context, fn);
+        context.pop_back();
+    }
+}
+
+uint64_t ngram_trie::order() const
+{
+    return order_;
+}
+
+uint32_t ngram_trie::id(const std::string& word) const
+{
+    return id(word.data(), word.size());
+}
+
+uint32_t ngram_trie::id(const char* word, uint64_t length) const
+{
+    // the tokens are sorted, so a token is found by binary search over
+    // their offsets; a stored token that matches the first length
+    // characters is only equal if it ends there too
+    auto compare = [&](uint64_t i)
+    {
+        auto stored = word_data_ + word_offsets_[i];
+        auto stored_length = word_offsets_[i + 1] - word_offsets_[i] - 1;
+        auto cmp = std::memcmp(stored, word, std::min(stored_length, length));
+        if (cmp != 0)
+            return cmp;
+        return stored_length < length ? -1 : stored_length > length ? 1 : 0;
+    };
+
+    uint64_t lo = 0;
+    uint64_t hi = vocab_size_;
+    while (lo < hi)
+    {
+        auto mid = lo + (hi - lo) / 2;
+        if (compare(mid) < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == vocab_size_ || compare(lo) != 0)
+        return vocab_size();
+    return static_cast<uint32_t>(lo);
+}
+
+std::string ngram_trie::word(uint32_t id) const
+{
+    return word_data_ + word_offsets_[id];
+}
+
+uint32_t ngram_trie::vocab_size() const
+{
+    return static_cast<uint32_t>(vocab_size_);
+}
+
+bool ngram_trie::extend(uint64_t& node, uint32_t word) const
+{
+    auto begin = node_words_ + child_begin_[node];
+    auto end = node_words_ + child_begin_[node + 1];
+    auto it = std::lower_bound(begin, end, word);
+    if (it == end || *it != word)
+        return false;
+    node = static_cast<uint64_t>(it - node_words_);
+    return true;
+}
+
+uint32_t ngram_trie::sample(uint64_t node, double random) const
+{
+    auto begin = ending_cumulative_ + ending_begin_[node];
+    auto end = ending_cumulative_ + ending_begin_[node + 1];
+    if (begin == end || *(end - 1) == 0)
+        return vocab_size();
+
+    // the first token whose cumulative probability passes the target;
+    // tokens with no share have the same value as the one before them,
+    // so they are never the first to pass it
+    auto target = static_cast<uint32_t>(
+        std::min(random, 1.0) * (cumulative_one - 1));
+    auto it = std::upper_bound(begin, end, target);
+    return ending_words_[it - ending_cumulative_];
+}
+
+double ngram_trie::prob(uint64_t node, uint32_t word) const
+{
+    auto begin = ending_words_ + ending_begin_[node];
+    auto end = ending_words_ + ending_begin_[node + 1];
+    auto it = std::lower_bound(begin, end, word);
+    if (it == end || *it != word)
+        return -1.0;
+    return decode(ending_probs_[it - ending_words_], prob_lo_, prob_step_);
+}
+}
+}
@@ -0,0 +1,49 @@
+/**
+ * @file build-lm.cpp
+ */
+
+#include <cstring>
+#include <iostream>
+#include "lm/language_model.h"
+
+using namespace meta;
+
+/**
+ * Builds a language model once and saves it in the binary format that
+ * language_model::load memory-maps, either by learning it from the corpus
+ * of a configuration or by converting an ARPA file. It can also write the
+ * model back out as an ARPA file.
+ */
+int main(int argc, char* argv[])
+{
+    if (argc < 3 || argc > 4)
+    {
+        std::cerr << "Usage:\t" << argv[0]
+                  << " (configFile | --arpa arpaFile) modelFile [arpaOutput]"
+                  << std::endl;
+        return 1;
+    }
+
+    bool arpa = std::strcmp(argv[1], "--arpa") == 0;
+    if (arpa && argc != 4)
+    {
+        std::cerr << "Usage:\t" << argv[0] << " --arpa arpaFile modelFile"
+                  << std::endl;
+        return 1;
+    }
+
+    if (arpa)
+    {
+        auto model = lm::language_model::load_arpa(argv[2]);
+        model.save(argv[3]);
+    }
+    else
+    {
+        lm::language_model model{argv[1]};
+        model.save(argv[2]);
+        if (argc == 4)
+            model.save_arpa(argv[3]);
+    }
+
+    return 0;
+}
@@ -0,0 +1,290 @@
+/**
+ * @file parse_cache.cpp
+ */
+
+#include <atomic>
+#include <sstream>
+
+#include <unistd.h>
+
+#include "io/binary.h"
+#include "parser/analyzers/parse_cache.h"
+#include "parser/trees/internal_node.h"
+#include "parser/trees/leaf_node.h"
+#include "parser/trees/visitors/visitor.h"
+#include "util/filesystem.h"
+#include "util/shim.h"
+
+namespace meta
+{
+namespace analyzers
+{
+
+namespace
+{
+/// How a node is written: an internal node, then a leaf with and a leaf
+/// without a word
+enum node_kind : uint8_t
+{
+    internal = 0,
+    word_leaf = 1,
+    bare_leaf = 2
+};
+
+/**
+ * Writes a tree in preorder: each node is its kind and category, then
+ * its word if it is a leaf with one, or its number of children and the
+ * children if it is an internal node.
+ */
+class tree_writer : public parser::const_visitor<void>
+{
+  public:
+    /**
+     * @param out The stream to write to
+     */
+    explicit tree_writer(std::ostream& out) : out_(out)
+    {
+        // nothing
+    }
+
+    void operator()(const parser::leaf_node& leaf) override
+    {
+        const auto& word = leaf.word();
+        io::write_binary(out_, static_cast<uint8_t>(word ? word_leaf
+                                                         : bare_leaf));
+        io::write_binary(out_, static_cast<const std::string&>(
+                                   leaf.category()));
+        if (word)
+            io::write_binary(out_, *word);
+    }
+
+    void operator()(const parser::internal_node& in) override
+    {
+        io::write_binary(out_, static_cast<uint8_t>(internal));
+        io::write_binary(out_,
+                         static_cast<const std::string&>(in.category()));
+        io::write_binary(out_, in.num_children());
+        in.each_child([&](const parser::node* child)
+                      {
+            child->accept(*this);
+        });
+    }
+
+  private:
+    /// The stream to write to
+    std::ostream& out_;
+};
+
+/**
+ * Reads a tree written by tree_writer.
+ * @param in The stream to read from
+ * @return the root of the tree
+ */
+std::unique_ptr<parser::node> read_node(std::istream& in)
+{
+    uint8_t kind = 0;
+    std::string category;
+    io::read_binary(in, kind);
+    io::read_binary(in, category);
+    if (!in)
+        throw parse_cache_exception{"truncated parse tree"};
+
+    if (kind == word_leaf)
+    {
+        std::string word;
+        io::read_binary(in, word);
+        return make_unique<parser::leaf_node>(class_label{category},
+                                              std::move(word));
+    }
+    if (kind == bare_leaf)
+        return make_unique<parser::leaf_node>(class_label{category});
+    if (kind != internal)
+        throw parse_cache_exception{"corrupt parse tree"};
+
+    uint64_t num_children = 0;
+    io::read_binary(in, num_children);
+    std::vector<std::unique_ptr<parser::node>> children;
+    for (uint64_t i = 0; i < num_children && in; ++i)
+        children.push_back(read_node(in));
+    return make_unique<parser::internal_node>(class_label{category},
+                                              std::move(children));
+}
+
+/**
+ * The trees of the last document a thread parsed or found.
+ */
+struct recent_parse
+{
+    /// The cache they belong to, or 0 if there are none
+    uint64_t cache = 0;
+    /// The id of the document
+    doc_id id{0};
+    /// The hash of the document's sentences
+    uint64_t hash = 0;
+    /// The trees
+    std::shared_ptr<const parse_cache::tree_list> trees;
+};
+
+/**
+ * @return the trees of the last document the calling thread parsed
+ */
+recent_parse& recent()
+{
+    static thread_local recent_parse parse;
+    return parse;
+}
+
+/**
+ * @return a number for a new cache, never 0
+ */
+uint64_t next_cache_id()
+{
+    static std::atomic<uint64_t> next{1};
+    return next++;
+}
+}
+
+std::shared_ptr<parse_cache>
+    parse_cache::shared(const std::string& tagger_prefix,
+                        const std::string& parser_prefix,
+                        const std::string& path)
+{
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::weak_ptr<parse_cache>>
+        caches;
+
+    auto key = tagger_prefix + '\0' + parser_prefix + '\0' + path;
+    std::lock_guard<std::mutex> lock{mutex};
+    auto& cache = caches[key];
+    if (auto existing = cache.lock())
+        return existing;
+    auto made = std::make_shared<parse_cache>(path);
+    cache = made;
+    return made;
+}
+
+parse_cache::parse_cache(const std::string& path)
+    : id_{next_cache_id()}, path_{path}
+{
+    if (path_.empty())
+        return;
+    if (!filesystem::file_exists(path_))
+        std::ofstream{path_, std::ios::binary};
+    load();
+}
+
+void parse_cache::load()
+{
+    std::ifstream in{path_, std::ios::binary};
+    if (!in)
+        throw parse_cache_exception{"failed to open parse store " + path_};
+
+    auto file_size = filesystem::file_size(path_);
+    uint64_t offset = 0;
+    while (true)
+    {
+        uint64_t id = 0;
+        entry ent;
+        io::read_binary(in, id);
+        io::read_binary(in, ent.hash);
+        io::read_binary(in, ent.size);
+        ent.offset = offset + 3 * sizeof(uint64_t);
+        if (!in || ent.offset + ent.size > file_size)
+            break;
+        entries_[doc_id{id}] = ent;
+        offset = ent.offset + ent.size;
+        in.seekg(static_cast<std::streamoff>(offset));
+    }
+    in.close();
+
+    // a record cut short by a crash would hide every record after it
+    if (offset < file_size && ::truncate(path_.c_str(),
+                                         static_cast<off_t>(offset)) != 0)
+        throw parse_cache_exception{"failed to repair parse store "
+                                    + path_};
+
+    file_.open(path_, std::ios::in | std::ios::out | std::ios::binary);
+    if (!file_)
+        throw parse_cache_exception{"failed to open parse store " + path_};
+}
+
+auto parse_cache::find(doc_id id, uint64_t hash)
+    -> std::shared_ptr<const tree_list>
+{
+    auto& last = recent();
+    if (last.cache == id_ && last.id == id && last.hash == hash)
+        return last.trees;
+    if (path_.empty())
+        return nullptr;
+
+    std::string bytes;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        auto it = entries_.find(id);
+        if (it == entries_.end() || it->second.hash != hash)
+            return nullptr;
+        bytes.resize(it->second.size);
+        file_.seekg(static_cast<std::streamoff>(it->second.offset));
+        file_.read(&bytes[0], static_cast<std::streamsize>(bytes.size()));
+        if (!file_)
+            throw parse_cache_exception{"failed to read parse store "
+                                        + path_};
+    }
+
+    std::istringstream in{bytes};
+    uint64_t num_trees = 0;
+    io::read_binary(in, num_trees);
+    auto trees = std::make_shared<tree_list>();
+    trees->reserve(num_trees);
+    for (uint64_t i = 0; i < num_trees; ++i)
+        trees->emplace_back(read_node(in));
+
+    last.cache = id_;
+    last.id = id;
+    last.hash = hash;
+    last.trees = trees;
+    return trees;
+}
+
+void parse_cache::insert(doc_id id, uint64_t hash,
+                         std::shared_ptr<const tree_list> trees)
+{
+    auto& last = recent();
+    last.cache = id_;
+    last.id = id;
+    last.hash = hash;
+    last.trees = trees;
+    if (path_.empty())
+        return;
+
+    std::ostringstream out;
+    io::write_binary(out, static_cast<uint64_t>(trees->size()));
+    tree_writer writer{out};
+    for (const auto& tree : *trees)
+        tree.visit(writer);
+    auto bytes = out.str();
+
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto it = entries_.find(id);
+    if (it != entries_.end() && it->second.hash == hash)
+        return;
+
+    file_.seekp(0, std::ios::end);
+    io::write_binary(file_, static_cast<uint64_t>(id));
+    io::write_binary(file_, hash);
+    io::write_binary(file_, static_cast<uint64_t>(bytes.size()));
+    auto offset = static_cast<uint64_t>(file_.tellp());
+    file_.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+    file_.flush();
+    if (!file_)
+        throw parse_cache_exception{"failed to write parse store " + path_};
+    entries_[id] = entry{hash, offset, bytes.size()};
+}
+
+uint64_t parse_cache::size() const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    return entries_.size();
+}
+}
+}
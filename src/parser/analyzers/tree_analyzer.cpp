@@ -16,9 +16,32 @@ namespace analyzers
 
 const std::string tree_analyzer::id = "tree";
 
+namespace
+{
+/**
+ * Mixes bytes into an FNV-1a hash.
+ * @param hash The hash so far
+ * @param str The bytes to mix in
+ * @return the new hash
+ */
+uint64_t mix(uint64_t hash, const std::string& str)
+{
+    for (const auto& ch : str)
+    {
+        hash ^= static_cast<unsigned char>(ch);
+        hash *= 0x100000001b3;
+    }
+    // a separator, so that ("ab", "c") and ("a", "bc") differ
+    hash ^= 0xff;
+    hash *= 0x100000001b3;
+    return hash;
+}
+}
+
 tree_analyzer::tree_analyzer(std::unique_ptr<token_stream> stream,
                              const std::string& tagger_prefix,
-                             const std::string& parser_prefix)
+                             const std::string& parser_prefix,
+                             const std::string& cache_path)
     : featurizers_{
           std::
               make_shared<std::
@@ -26,7 +49,8 @@ tree_analyzer::tree_analyzer(std::unique_ptr<token_stream> stream,
                                          unique_ptr<const tree_featurizer>>>()},
       stream_{std::move(stream)},
       tagger_{std::make_shared<sequence::perceptron>(tagger_prefix)},
-      parser_{std::make_shared<parser::sr_parser>(parser_prefix)}
+      parser_{std::make_shared<parser::sr_parser>(parser_prefix)},
+      cache_{parse_cache::shared(tagger_prefix, parser_prefix, cache_path)}
 {
     // nothing
 }
@@ -35,7 +59,8 @@ tree_analyzer::tree_analyzer(const tree_analyzer& other)
     : featurizers_{other.featurizers_},
       stream_{other.stream_->clone()},
       tagger_{other.tagger_},
-      parser_{other.parser_}
+      parser_{other.parser_},
+      cache_{other.cache_}
 {
     // nothing
 }
@@ -47,9 +72,13 @@ void tree_analyzer::add(std::unique_ptr<const tree_featurizer> featurizer)
 
 void tree_analyzer::tokenize(corpus::document& doc)
 {
-    stream_->set_content(get_content(doc));
+    set_content(*stream_, doc);
 
+    // the sentences are what the tagger sees, so their hash changes with
+    // the content and with the filters of the stream
+    std::vector<sequence::sequence> sentences;
     sequence::sequence seq;
+    uint64_t hash = 0xcbf29ce484222325;
     while (*stream_)
     {
         auto next = stream_->next();
@@ -60,16 +89,34 @@ void tree_analyzer::tokenize(corpus::document& doc)
         }
         else if (next == "</s>")
         {
-            tagger_->tag(seq);
-            auto tree = parser_->parse(seq);
-            for (const auto& featurizer : *featurizers_)
-                featurizer->tree_tokenize(doc, tree);
+            sentences.push_back(std::move(seq));
+            seq = {};
+            hash = mix(hash, next);
         }
         else
         {
+            hash = mix(hash, next);
             seq.add_symbol(sequence::symbol_t{next});
         }
     }
+
+    auto trees = cache_->find(doc.id(), hash);
+    if (!trees)
+    {
+        auto parsed = std::make_shared<parse_cache::tree_list>();
+        parsed->reserve(sentences.size());
+        for (auto& sentence : sentences)
+        {
+            tagger_->tag(sentence);
+            parsed->push_back(parser_->parse(sentence));
+        }
+        cache_->insert(doc.id(), hash, parsed);
+        trees = std::move(parsed);
+    }
+
+    for (const auto& tree : *trees)
+        for (const auto& featurizer : *featurizers_)
+            featurizer->tree_tokenize(doc, tree);
 }
 
 template <>
@@ -92,9 +139,12 @@ std::unique_ptr<analyzer>
         throw analyzer::analyzer_exception{
             "tree analyzer needs an array of features to generate"};
 
+    auto cache_path = config.get_as<std::string>("parse-cache");
+
     auto filts = analyzer::load_filters(global, config);
     auto ana = make_unique<tree_analyzer>(std::move(filts), *tagger_prefix,
-                                          *parser_prefix);
+                                          *parser_prefix,
+                                          cache_path ? *cache_path : "");
 
     for (const auto& feat : feat_arr->array_of<std::string>())
         ana->add(featurizer_factory::get().create(feat->get()));
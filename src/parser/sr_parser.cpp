@@ -3,11 +3,14 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
 #include <cassert>
 #include <fstream>
+#include <limits>
 
 #include "io/binary.h"
 #include "logging/logger.h"
+#include "parallel/default_pool.h"
 #include "parallel/parallel_for.h"
 #include "parser/sr_parser.h"
 #include "parser/state.h"
@@ -16,8 +19,8 @@
 #include "parser/trees/internal_node.h"
 #include "parser/trees/leaf_node.h"
 #include "parser/trees/visitors/debinarizer.h"
+#include "util/filesystem.h"
 #include "util/progress.h"
-#include "util/range.h"
 #include "util/time.h"
 
 #ifdef META_HAS_ZLIB
@@ -29,24 +32,202 @@ namespace meta
 namespace parser
 {
 
+namespace
+{
+/**
+ * The kind of feature vector a kind of weight vectors is updated from.
+ */
+template <class WeightVectors>
+struct features_of;
+
+template <>
+struct features_of<sr_parser::weight_vectors>
+{
+    using type = sr_parser::feature_vector;
+};
+
+template <>
+struct features_of<sr_parser::hashed_weight_vectors>
+{
+    using type = sr_parser::hashed_feature_vector;
+};
+
+const std::string& feature_key(const sr_parser::feature_vector::value_type& feat)
+{
+    return feat.first;
+}
+
+float feature_value(const sr_parser::feature_vector::value_type& feat)
+{
+    return feat.second;
+}
+
+uint64_t feature_key(uint64_t row)
+{
+    return row;
+}
+
+float feature_value(uint64_t)
+{
+    return 1;
+}
+
+/**
+ * Adds a scaled row of weights to a row of scores. The rows are
+ * contiguous and a multiple of eight long, so the loop vectorizes.
+ */
+void add_row(float scale, const float* weights, float* scores, uint64_t size)
+{
+    for (uint64_t i = 0; i < size; ++i)
+        scores[i] += scale * weights[i];
+}
+}
+
+/**
+ * What a thread reuses from one sentence it parses to the next.
+ */
+template <class FeatureVector>
+struct sr_parser::workspace
+{
+    using scored_state = std::pair<state, float>;
+
+    /// The features of the state being scored
+    FeatureVector feats;
+    /// The states on the beam
+    std::vector<scored_state> agenda;
+    /// The states the beam advances to
+    std::vector<scored_state> new_agenda;
+    /// The states of the agenda, to be scored together
+    std::vector<const state*> states;
+    /// The scores of the transitions from each state of the agenda
+    std::vector<float> scores;
+    /// The nodes and stacks of the states of the sentence being parsed
+    state_arena arena;
+};
+
 sr_parser::sr_parser(const std::string& prefix) : trans_{prefix}
 {
     load(prefix);
 }
 
 parse_tree sr_parser::parse(const sequence::sequence& sentence) const
+{
+    if (hash_bits_ > 0)
+    {
+        workspace<hashed_feature_vector> ws;
+        return parse_with(sentence, ws);
+    }
+    workspace<feature_vector> ws;
+    return parse_with(sentence, ws);
+}
+
+std::vector<parse_tree>
+    sr_parser::parse(const std::vector<sequence::sequence>& sentences,
+                     parallel::thread_pool& pool) const
+{
+    if (hash_bits_ > 0)
+        return parse_all<hashed_feature_vector>(sentences, pool);
+    return parse_all<feature_vector>(sentences, pool);
+}
+
+std::vector<parse_tree>
+    sr_parser::parse(const std::vector<sequence::sequence>& sentences) const
+{
+    return parse(sentences, parallel::default_pool());
+}
+
+evalb sr_parser::evaluate(const std::vector<sequence::sequence>& sentences,
+                         const std::vector<parse_tree>& gold,
+                         parallel::thread_pool& pool,
+                         std::vector<parse_tree>* proposed) const
+{
+    if (sentences.size() != gold.size())
+        throw exception{"cannot evaluate " + std::to_string(sentences.size())
+                        + " sentences against " + std::to_string(gold.size())
+                        + " gold trees"};
+
+    std::vector<util::optional<parse_tree>> trees;
+    if (proposed)
+        trees.resize(sentences.size());
+
+    // each tree is scored by the thread that parsed it, right after
+    // parsing, so scoring overlaps with the parsing of other sentences
+    std::vector<evalb> evals(pool.thread_ids().size());
+    auto score = [&](uint64_t task, uint64_t i, parse_tree tree)
+    {
+        if (proposed)
+            trees[i] = tree;
+        evals[task].add_tree(std::move(tree), gold[i]);
+    };
+    if (hash_bits_ > 0)
+        parse_each<hashed_feature_vector>(sentences, pool, score);
+    else
+        parse_each<feature_vector>(sentences, pool, score);
+
+    evalb eval;
+    for (const auto& ev : evals)
+        eval.merge(ev);
+
+    if (proposed)
+    {
+        proposed->clear();
+        proposed->reserve(trees.size());
+        for (auto& tree : trees)
+            proposed->push_back(std::move(*tree));
+    }
+    return eval;
+}
+
+template <class FeatureVector>
+std::vector<parse_tree>
+    sr_parser::parse_all(const std::vector<sequence::sequence>& sentences,
+                         parallel::thread_pool& pool) const
+{
+    std::vector<util::optional<parse_tree>> trees(sentences.size());
+    parse_each<FeatureVector>(sentences, pool,
+                              [&](uint64_t, uint64_t i, parse_tree tree)
+                              {
+        trees[i] = std::move(tree);
+    });
+
+    std::vector<parse_tree> result;
+    result.reserve(trees.size());
+    for (auto& tree : trees)
+        result.push_back(std::move(*tree));
+    return result;
+}
+
+template <class FeatureVector, class Function>
+void sr_parser::parse_each(const std::vector<sequence::sequence>& sentences,
+                           parallel::thread_pool& pool, Function&& fn) const
+{
+    // the threads take small batches of sentences as they go, since
+    // sentences vary a lot in length; each task has its own workspace
+    const uint64_t batch_size = 16;
+    std::vector<workspace<FeatureVector>> spaces(pool.thread_ids().size());
+    parallel::parallel_chunks(pool, sentences.size(), batch_size,
+                              [&](uint64_t task, uint64_t first, uint64_t last)
+                              {
+        for (auto i = first; i < last; ++i)
+            fn(task, i, parse_with(sentences[i], spaces[task]));
+    });
+}
+
+template <class FeatureVector>
+parse_tree sr_parser::parse_with(const sequence::sequence& sentence,
+                                 workspace<FeatureVector>& ws) const
 {
     if (sentence.size() == 0)
         return {make_unique<internal_node>("ROOT"_cl)};
 
-    state_analyzer analyzer;
-    state st{sentence};
+    state st{sentence, ws.arena};
+    auto& feats = ws.feats;
 
     if (beam_size_ == 1)
     {
         while (!st.finalized())
         {
-            auto feats = analyzer.featurize(st);
+            featurize(st, feats);
             auto tid = best_transition(feats, st, true);
             auto trans = trans_.at(tid);
 
@@ -58,7 +239,7 @@ parse_tree sr_parser::parse(const sequence::sequence& sentence) const
 
         assert(st.stack_size() == 1 && st.queue_size() == 0);
 
-        parse_tree tree{st.stack_item(0)->clone()};
+        parse_tree tree{st.stack_item(0)->tree()};
         debinarizer debin;
         tree.transform(debin);
 
@@ -66,7 +247,7 @@ parse_tree sr_parser::parse(const sequence::sequence& sentence) const
     }
     else
     {
-        using scored_state = std::pair<state, float>;
+        using scored_state = typename workspace<FeatureVector>::scored_state;
         auto comp = [&](const scored_state& lhs, const scored_state& rhs)
         {
             return std::get<1>(lhs) > std::get<1>(rhs);
@@ -77,24 +258,26 @@ parse_tree sr_parser::parse(const sequence::sequence& sentence) const
             return std::get<0>(ss).finalized();
         };
 
-        std::vector<scored_state> agenda;
+        auto& agenda = ws.agenda;
+        auto& new_agenda = ws.new_agenda;
+        agenda.clear();
         agenda.emplace_back(st, 0);
 
         while (!std::all_of(agenda.begin(), agenda.end(), fin))
         {
-            std::vector<scored_state> new_agenda;
+            new_agenda.clear();
 
+            ws.states.clear();
             for (const auto& ss : agenda)
-            {
-                const auto& c_state = std::get<0>(ss);
-                auto score = std::get<1>(ss);
-
-                auto feats = analyzer.featurize(c_state);
+                ws.states.push_back(&std::get<0>(ss));
+            auto candidates = best_transitions(ws, beam_size_, true);
 
-                auto transitions
-                    = best_transitions(feats, c_state, beam_size_, true);
+            for (uint64_t i = 0; i < agenda.size(); ++i)
+            {
+                const auto& c_state = std::get<0>(agenda[i]);
+                auto score = std::get<1>(agenda[i]);
 
-                for (const auto& scored_trans : transitions)
+                for (const auto& scored_trans : candidates[i])
                 {
                     auto trans = std::get<0>(scored_trans);
                     auto t_score = std::get<1>(scored_trans);
@@ -127,13 +310,13 @@ parse_tree sr_parser::parse(const sequence::sequence& sentence) const
             if (new_agenda.size() == 0)
                 throw exception{"unparsable"};
 
-            agenda = std::move(new_agenda);
+            std::swap(agenda, new_agenda);
         }
 
         // min because comp is backwards
         auto best = std::min_element(agenda.begin(), agenda.end(), comp);
 
-        parse_tree tree{std::get<0>(*best).stack_item(0)->clone()};
+        parse_tree tree{std::get<0>(*best).stack_item(0)->tree()};
         debinarizer debin;
         tree.transform(debin);
 
@@ -146,14 +329,114 @@ void sr_parser::train(std::vector<parse_tree>& trees, training_options options)
     if (options.algorithm == training_algorithm::BEAM_SEARCH)
         beam_size_ = options.beam_size;
 
-    training_data data{trees, options.seed};
-    trans_ = data.preprocess();
+    if (mapped_weights_)
+    {
+        dense_weights_.assign(mapped_weights_,
+                              mapped_weights_
+                                  + (uint64_t{1} << hash_bits_) * row_stride());
+        mapped_weights_ = nullptr;
+        hashed_file_ = nullptr;
+    }
 
-    LOG(info) << "Found " << trans_.size() << " transitions" << ENDLG;
+    if (frozen_ || !dense_rows_.empty())
+    {
+        thaw(model_);
+        frozen_ = nullptr;
+        dense_rows_.clear();
+        dense_weights_.clear();
+    }
 
     parallel::thread_pool pool{options.num_threads};
 
+    std::unique_ptr<training_data> cached;
+    if (!options.cache.empty() && training_data::exists(options.cache))
+    {
+        LOG(info) << "Loading preprocessed trees from " << options.cache
+                  << ENDLG;
+        cached = make_unique<training_data>(options.cache, options.seed);
+        trans_ = transition_map{options.cache};
+    }
+    else
+    {
+        cached = make_unique<training_data>(trees, options.seed);
+        trans_ = cached->preprocess(pool);
+        if (!options.cache.empty())
+        {
+            filesystem::make_directory(options.cache);
+            cached->save(options.cache, trans_);
+        }
+    }
+    auto& data = *cached;
+
+    LOG(info) << "Found " << trans_.size() << " transitions" << ENDLG;
+
+    if (options.hash_bits > 0)
+    {
+        // keep the weights of a hashed model being trained further, if its
+        // table still has the same shape
+        auto stride = row_stride();
+        auto size = (uint64_t{1} << options.hash_bits) * stride;
+        if (options.hash_bits != hash_bits_ || dense_weights_.size() != size)
+            dense_weights_.assign(size, 0.0f);
+        hash_bits_ = options.hash_bits;
+
+        std::vector<float> for_avg(size, 0.0f);
+        auto total_updates = train_iterations<hashed_weight_vectors>(
+            data, pool, options,
+            [&](const hashed_weight_vectors& update, uint64_t before)
+            {
+                for (const auto& row : update)
+                {
+                    for (const auto& weight : row.second)
+                    {
+                        auto i = row.first * stride + weight.first;
+                        dense_weights_[i] += weight.second;
+                        for_avg[i] += before * weight.second;
+                    }
+                }
+            },
+            []()
+            {
+            });
+
+        // update weights to be average over all parameters
+        for (uint64_t i = 0; i < size; ++i)
+            dense_weights_[i] -= for_avg[i] / total_updates;
+        return;
+    }
+
+    hash_bits_ = 0;
+    dense_weights_.clear();
+
     classify::linear_model<std::string, float, trans_id> for_avg;
+    auto total_updates = train_iterations<weight_vectors>(
+        data, pool, options,
+        [&](const weight_vectors& update, uint64_t before)
+        {
+            model_.update(update);
+            for_avg.update(update, before);
+        },
+        [&]()
+        {
+            model_.condense(true);
+            for_avg.condense(false);
+        });
+
+    // update weights to be average over all parameters
+    model_.update(for_avg.weights(), -1.0f / total_updates);
+}
+
+bool sr_parser::cached(const std::string& cache)
+{
+    return training_data::exists(cache);
+}
+
+template <class WeightVectors, class Apply, class EndIteration>
+uint64_t sr_parser::train_iterations(training_data& data,
+                                     parallel::thread_pool& pool,
+                                     const training_options& options,
+                                     Apply&& apply, EndIteration&& end_iteration)
+{
     uint64_t total_updates = 0;
     for (uint64_t iter = 1; iter <= options.max_iterations; ++iter)
     {
@@ -165,7 +448,7 @@ void sr_parser::train(std::vector<parse_tree>& trees, training_options options)
             {
                 printing::progress progress{" > Iteration "
                                             + std::to_string(iter) + ": ",
-                                            trees.size()};
+                                            data.size()};
                 data.shuffle();
 
                 for (size_t start = 0; start < data.size();
@@ -175,12 +458,11 @@ void sr_parser::train(std::vector<parse_tree>& trees, training_options options)
                     auto end = std::min<uint64_t>(start + options.batch_size,
                                                   data.size());
 
-                    auto result
-                        = train_batch({data, start, end}, pool, options);
+                    auto result = train_batch<WeightVectors>({data, start, end},
+                                                             pool, options);
 
                     ++total_updates;
-                    model_.update(std::get<0>(result));
-                    for_avg.update(std::get<0>(result), total_updates - 1);
+                    apply(std::get<0>(result), total_updates - 1);
 
                     num_correct += std::get<1>(result);
                     num_incorrect += std::get<2>(result);
@@ -192,46 +474,44 @@ void sr_parser::train(std::vector<parse_tree>& trees, training_options options)
         LOG(info) << "Correct transitions: " << num_correct
                   << ", incorrect transitions: " << num_incorrect << ENDLG;
 
-        model_.condense(true);
-        for_avg.condense(false);
+        end_iteration();
     }
-
-    // update weights to be average over all parameters
-    model_.update(for_avg.weights(), -1.0f / total_updates);
+    return total_updates;
 }
 
-auto sr_parser::train_batch(training_batch batch, parallel::thread_pool& pool,
-                            const training_options& options)
-    -> std::tuple<weight_vectors, uint64_t, uint64_t>
+template <class WeightVectors>
+std::tuple<WeightVectors, uint64_t, uint64_t>
+    sr_parser::train_batch(training_batch batch, parallel::thread_pool& pool,
+                           const training_options& options)
 {
     // TODO: real beam search
-    std::tuple<weight_vectors, uint64_t, uint64_t> result;
+    std::tuple<WeightVectors, uint64_t, uint64_t> result;
 
-    auto range = util::range(batch.start, batch.end - 1); // inclusive range
-
-    // Perform a reduction across threads: each thread stores its update in
+    // Perform a reduction across tasks: each task stores its update in
     // a separate location, and we then add them all up after we join
-    util::sparse_vector<std::thread::id, weight_vectors> updates;
-    for (const auto& tid : pool.thread_ids())
-        updates[tid] = {};
+    std::vector<WeightVectors> updates(pool.thread_ids().size());
 
     std::atomic<uint64_t> num_correct{0};
     std::atomic<uint64_t> num_incorrect{0};
-    parallel::parallel_for(range.begin(), range.end(), pool, [&](size_t i)
-                           {
-        auto& tree = batch.data.tree(i);
-        auto& transitions = batch.data.transitions(i);
-        auto& update = updates[std::this_thread::get_id()];
-
-        auto res = train_instance(tree, transitions, options, update);
-        num_correct += res.first;
-        num_incorrect += res.second;
+    parallel::parallel_chunks(pool, batch.end - batch.start, 0,
+                              [&](uint64_t task, uint64_t first, uint64_t last)
+                              {
+        for (auto i = batch.start + first; i < batch.start + last; ++i)
+        {
+            auto& sentence = batch.data.sentence(i);
+            auto& transitions = batch.data.transitions(i);
+
+            auto res = train_instance(sentence, transitions, options,
+                                      updates[task]);
+            num_correct += res.first;
+            num_incorrect += res.second;
+        }
     });
 
     // Reduce partial results down to final update vector
-    for (const auto& thread_update : updates)
+    for (const auto& update : updates)
     {
-        for (const auto& feat : thread_update.second)
+        for (const auto& feat : update)
         {
             auto& wv = std::get<0>(result)[feat.first];
             for (const auto& weight : feat.second)
@@ -243,35 +523,39 @@ auto sr_parser::train_batch(training_batch batch, parallel::thread_pool& pool,
     return result;
 }
 
+template <class WeightVectors>
 std::pair<uint64_t, uint64_t> sr_parser::train_instance(
-    const parse_tree& tree, const std::vector<trans_id>& transitions,
-    const training_options& options, weight_vectors& update) const
+    const sequence::sequence& sentence,
+    const std::vector<trans_id>& transitions,
+    const training_options& options, WeightVectors& update) const
 {
     switch (options.algorithm)
     {
         case training_algorithm::EARLY_TERMINATION:
-            return train_early_termination(tree, transitions, update);
+            return train_early_termination(sentence, transitions, update);
 
         case training_algorithm::BEAM_SEARCH:
-            return train_beam_search(tree, transitions, options, update);
+            return train_beam_search(sentence, transitions, options, update);
 
         default:
             throw exception{"Not yet implemented"};
     }
 }
 
+template <class WeightVectors>
 std::pair<uint64_t, uint64_t>
-    sr_parser::train_early_termination(const parse_tree& tree,
+    sr_parser::train_early_termination(const sequence::sequence& sentence,
                                        const std::vector<trans_id>& transitions,
-                                       weight_vectors& update) const
+                                       WeightVectors& update) const
 {
     std::pair<uint64_t, uint64_t> result{0, 0};
-    state state{tree};
-    state_analyzer analyzer;
+    state_arena arena;
+    state state{sentence, arena};
+    typename features_of<WeightVectors>::type feats;
 
     for (const auto& gold_trans : transitions)
     {
-        auto feats = analyzer.featurize(state);
+        featurize(state, feats);
         auto trans = best_transition(feats, state);
 
         if (trans == gold_trans)
@@ -283,9 +567,9 @@ std::pair<uint64_t, uint64_t>
         {
             for (const auto& feat : feats)
             {
-                auto& wv = update[feat.first];
-                wv[gold_trans] += feat.second;
-                wv[trans] -= feat.second;
+                auto& wv = update[feature_key(feat)];
+                wv[gold_trans] += feature_value(feat);
+                wv[trans] -= feature_value(feat);
             }
             ++result.second;
             break;
@@ -294,13 +578,16 @@ std::pair<uint64_t, uint64_t>
     return result;
 }
 
+template <class WeightVectors>
 std::pair<uint64_t, uint64_t> sr_parser::train_beam_search(
-    const parse_tree& tree, const std::vector<trans_id>& transitions,
-    const training_options& options, weight_vectors& update) const
+    const sequence::sequence& sentence,
+    const std::vector<trans_id>& transitions,
+    const training_options& options, WeightVectors& update) const
 {
     std::pair<uint64_t, uint64_t> result{0, 0};
-    state gold_state{tree};
-    state_analyzer analyzer;
+    state_arena arena;
+    state gold_state{sentence, arena};
+    typename features_of<WeightVectors>::type feats;
 
     using scored_state = std::tuple<state, double, bool>;
     // get<0>() is the state
@@ -313,7 +600,7 @@ std::pair<uint64_t, uint64_t> sr_parser::train_beam_search(
     };
 
     std::vector<scored_state> agenda;
-    agenda.emplace_back(state{tree}, 0, true);
+    agenda.emplace_back(gold_state, 0, true);
 
     for (const auto& gold_trans : transitions)
     {
@@ -338,7 +625,7 @@ std::pair<uint64_t, uint64_t> sr_parser::train_beam_search(
             const auto& score = std::get<1>(ss);
             bool is_gold = std::get<2>(ss);
 
-            auto feats = analyzer.featurize(std::get<0>(ss));
+            featurize(st, feats);
 
             auto transitions
                 = best_transitions(feats, st, options.beam_size, true);
@@ -386,16 +673,17 @@ std::pair<uint64_t, uint64_t> sr_parser::train_beam_search(
 
             if (best_state)
             {
-                auto best_feats = analyzer.featurize(std::get<0>(*best_state));
-
-                for (const auto& feat : best_feats)
-                    update[feat.first][best_trans] -= feat.second;
+                featurize(std::get<0>(*best_state), feats);
+                for (const auto& feat : feats)
+                    update[feature_key(feat)][best_trans]
+                        -= feature_value(feat);
             }
 
             {
-                auto gold_feats = analyzer.featurize(gold_state);
-                for (const auto& feat : gold_feats)
-                    update[feat.first][gold_trans] += feat.second;
+                featurize(gold_state, feats);
+                for (const auto& feat : feats)
+                    update[feature_key(feat)][gold_trans]
+                        += feature_value(feat);
             }
         }
         else
@@ -413,24 +701,238 @@ std::pair<uint64_t, uint64_t> sr_parser::train_beam_search(
     return result;
 }
 
+void sr_parser::featurize(const state& state, feature_vector& feats) const
+{
+    feats = state_analyzer{}.featurize(state);
+}
+
+void sr_parser::featurize(const state& state,
+                          hashed_feature_vector& feats) const
+{
+    state_analyzer{}.featurize(state, feats);
+
+    // features whose hashes fall in the same row share its weights
+    auto mask = (uint64_t{1} << hash_bits_) - 1;
+    for (auto& feat : feats)
+        feat &= mask;
+    std::sort(feats.begin(), feats.end());
+    feats.erase(std::unique(feats.begin(), feats.end()), feats.end());
+}
+
 auto sr_parser::best_transition(
     const feature_vector& features, const state& state,
     bool check_legality /* = false */) const -> trans_id
 {
-    return model_.best_class(features, [&](trans_id tid)
+    auto legal = [&](trans_id tid)
     {
         return !check_legality || state.legal(trans_.at(tid));
-    });
+    };
+    if (dense())
+    {
+        std::vector<float> scores(row_stride(), 0.0f);
+        add_scores(features, scores.data());
+        return best_scored(scores.data(), state, check_legality);
+    }
+    if (frozen_)
+        return frozen_->best_class(features, legal);
+    return model_.best_class(features, legal);
 }
 
 auto sr_parser::best_transitions(
     const feature_vector& features, const state& state, size_t num,
     bool check_legality) const -> std::vector<scored_trans>
 {
-    return model_.best_classes(features, num, [&](trans_id tid)
+    auto legal = [&](trans_id tid)
     {
         return !check_legality || state.legal(trans_.at(tid));
-    });
+    };
+    if (dense())
+    {
+        std::vector<float> scores(row_stride(), 0.0f);
+        add_scores(features, scores.data());
+        return best_scored(scores.data(), state, num, check_legality);
+    }
+    if (frozen_)
+        return frozen_->best_classes(features, num, legal);
+    return model_.best_classes(features, num, legal);
+}
+
+auto sr_parser::best_transition(
+    const hashed_feature_vector& features, const state& state,
+    bool check_legality /* = false */) const -> trans_id
+{
+    std::vector<float> scores(row_stride(), 0.0f);
+    add_scores(features, scores.data());
+    return best_scored(scores.data(), state, check_legality);
+}
+
+auto sr_parser::best_transitions(
+    const hashed_feature_vector& features, const state& state, size_t num,
+    bool check_legality) const -> std::vector<scored_trans>
+{
+    std::vector<float> scores(row_stride(), 0.0f);
+    add_scores(features, scores.data());
+    return best_scored(scores.data(), state, num, check_legality);
+}
+
+template <class FeatureVector>
+auto sr_parser::best_transitions(workspace<FeatureVector>& ws, size_t num,
+                                 bool check_legality) const
+    -> std::vector<std::vector<scored_trans>>
+{
+    const auto& states = ws.states;
+    auto& feats = ws.feats;
+    std::vector<std::vector<scored_trans>> result;
+    result.reserve(states.size());
+
+    if (!dense())
+    {
+        for (const auto& st : states)
+        {
+            featurize(*st, feats);
+            result.push_back(best_transitions(feats, *st, num, check_legality));
+        }
+        return result;
+    }
+
+    // score the whole agenda into one matrix, a row of scores per state
+    auto stride = row_stride();
+    auto& scores = ws.scores;
+    scores.assign(states.size() * stride, 0.0f);
+    for (uint64_t i = 0; i < states.size(); ++i)
+    {
+        featurize(*states[i], feats);
+        add_scores(feats, &scores[i * stride]);
+    }
+
+    for (uint64_t i = 0; i < states.size(); ++i)
+        result.push_back(
+            best_scored(&scores[i * stride], *states[i], num, check_legality));
+    return result;
+}
+
+bool sr_parser::dense() const
+{
+    return hash_bits_ > 0 || !dense_rows_.empty();
+}
+
+const float* sr_parser::dense_data() const
+{
+    return mapped_weights_ ? mapped_weights_ : dense_weights_.data();
+}
+
+uint64_t sr_parser::row_stride() const
+{
+    return (trans_.size() + 7) / 8 * 8;
+}
+
+void sr_parser::add_scores(const feature_vector& features, float* scores) const
+{
+    auto stride = row_stride();
+    for (const auto& feat : features)
+    {
+        auto it = dense_rows_.find(feat.first);
+        if (it != dense_rows_.end())
+            add_row(feat.second, dense_data() + it->second * stride, scores,
+                    stride);
+    }
+}
+
+void sr_parser::add_scores(const hashed_feature_vector& features,
+                           float* scores) const
+{
+    auto stride = row_stride();
+    for (const auto& row : features)
+        add_row(1.0f, dense_data() + row * stride, scores, stride);
+}
+
+auto sr_parser::best_scored(const float* scores, const state& state,
+                            bool check_legality) const -> trans_id
+{
+    trans_id best{0};
+    auto best_score = std::numeric_limits<float>::lowest();
+    for (uint64_t t = 0; t < trans_.size(); ++t)
+    {
+        trans_id tid{static_cast<uint16_t>(t)};
+        if (scores[t] > best_score
+            && (!check_legality || state.legal(trans_.at(tid))))
+        {
+            best = tid;
+            best_score = scores[t];
+        }
+    }
+    return best;
+}
+
+auto sr_parser::best_scored(const float* scores, const state& state,
+                            size_t num, bool check_legality) const
+    -> std::vector<scored_trans>
+{
+    std::vector<scored_trans> result;
+    for (uint64_t t = 0; t < trans_.size(); ++t)
+    {
+        trans_id tid{static_cast<uint16_t>(t)};
+        if (!check_legality || state.legal(trans_.at(tid)))
+            result.emplace_back(tid, scores[t]);
+    }
+
+    auto comp = [](const scored_trans& a, const scored_trans& b)
+    {
+        return a.second > b.second;
+    };
+    num = std::min(num, result.size());
+    std::partial_sort(result.begin(), result.begin() + num, result.end(),
+                      comp);
+    result.resize(num);
+    return result;
+}
+
+void sr_parser::densify()
+{
+    if (dense())
+        return;
+
+    classify::linear_model<std::string, float, trans_id> thawed;
+    if (frozen_)
+        frozen_->thaw(thawed);
+    const auto& weights = frozen_ ? thawed : model_;
+
+    auto stride = row_stride();
+    dense_weights_.assign(weights.weights().size() * stride, 0.0f);
+    for (const auto& feat : weights.weights())
+    {
+        auto row = dense_rows_.size();
+        dense_rows_[feat.first] = row;
+        for (const auto& weight : feat.second)
+            dense_weights_[row * stride + weight.first] = weight.second;
+    }
+
+    frozen_ = nullptr;
+    model_ = {};
+}
+
+void sr_parser::thaw(
+    classify::linear_model<std::string, float, trans_id>& model) const
+{
+    if (frozen_)
+    {
+        frozen_->thaw(model);
+        return;
+    }
+
+    auto stride = row_stride();
+    weight_vectors weights;
+    for (const auto& feat : dense_rows_)
+    {
+        auto& wv = weights[feat.first];
+        for (uint64_t t = 0; t < trans_.size(); ++t)
+        {
+            auto weight = dense_weights_[feat.second * stride + t];
+            if (weight != 0)
+                wv[trans_id{static_cast<uint16_t>(t)}] = weight;
+        }
+    }
+    model.update(weights);
 }
 
 void sr_parser::save(const std::string& prefix) const
@@ -445,7 +947,38 @@ void sr_parser::save(const std::string& prefix) const
 
     io::write_binary(model, beam_size_);
 
-    model_.save(model);
+    // a hashed model's weights are all in its table, which is written
+    // beside an empty string-keyed model
+    auto hashed_file = prefix + "/parser.hashed";
+    if (hash_bits_ > 0)
+    {
+        classify::linear_model<std::string, float, trans_id>{}.save(model);
+        filesystem::delete_file(prefix + "/parser.model.frozen");
+
+        // the table is written beside the file it may be mapped from
+        auto size = (uint64_t{1} << hash_bits_) * row_stride();
+        {
+            std::ofstream hashed{hashed_file + ".tmp", std::ios::binary};
+            io::write_binary(hashed, hash_bits_);
+            io::write_binary(hashed, size);
+            hashed.write(reinterpret_cast<const char*>(dense_data()),
+                         static_cast<std::streamsize>(size * sizeof(float)));
+        }
+        filesystem::rename_file(hashed_file + ".tmp", hashed_file);
+        return;
+    }
+    filesystem::delete_file(hashed_file);
+
+    // the weights of a parser loaded from a frozen model or densified are
+    // all in the frozen model or the dense table
+    classify::linear_model<std::string, float, trans_id> thawed;
+    if (frozen_ || dense())
+        thaw(thawed);
+    const auto& weights = frozen_ || dense() ? thawed : model_;
+
+    weights.save(model);
+    classify::frozen_linear_model<std::string, trans_id>::save(
+        weights, prefix + "/parser.model.frozen");
 }
 
 void sr_parser::load(const std::string& prefix)
@@ -460,7 +993,34 @@ void sr_parser::load(const std::string& prefix)
         throw exception{"model file not found"};
 
     io::read_binary(model, beam_size_);
-    model_.load(model);
+
+    auto hashed_file = prefix + "/parser.hashed";
+    if (filesystem::file_exists(hashed_file))
+    {
+        // the table is used where it is mapped, so loading reads nothing
+        // but its header
+        hashed_file_ = make_unique<meta::io::mmap_file>(hashed_file);
+        if (hashed_file_->size() < 2 * sizeof(uint64_t))
+            throw exception{"hashed model file is truncated"};
+
+        auto header = reinterpret_cast<const uint64_t*>(hashed_file_->begin());
+        hash_bits_ = header[0];
+        auto size = header[1];
+        if (size != (uint64_t{1} << hash_bits_) * row_stride())
+            throw exception{"hashed model does not match its transitions"};
+        if (hashed_file_->size() != 2 * sizeof(uint64_t) + size * sizeof(float))
+            throw exception{"hashed model file is truncated"};
+
+        mapped_weights_ = reinterpret_cast<const float*>(header + 2);
+        return;
+    }
+
+    if (filesystem::file_exists(prefix + "/parser.model.frozen"))
+        frozen_ = make_unique<
+            classify::frozen_linear_model<std::string, trans_id>>(
+            prefix + "/parser.model.frozen");
+    else
+        model_.load(model);
 }
 }
 }
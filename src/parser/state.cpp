@@ -3,8 +3,6 @@
  * @author Chase Geigle
  */
 
-#include <memory>
-
 #include "parser/trees/visitors/leaf_node_finder.h"
 #include "parser/trees/internal_node.h"
 #include "parser/trees/leaf_node.h"
@@ -17,37 +15,32 @@ namespace meta
 namespace parser
 {
 
-state::state(const parse_tree& tree)
+state::state(const parse_tree& tree, state_arena& arena)
+    : arena_{&arena}, stack_{state_arena::empty_stack}, q_idx_{0}, done_{false}
 {
     leaf_node_finder lnf;
     tree.visit(lnf);
-    queue_ = std::make_shared<queue_type>(lnf.leaves());
-    q_idx_ = 0;
-    done_ = false;
+
+    arena.clear();
+    for (const auto& leaf : lnf.leaves())
+        arena.add_word(leaf->category(), *leaf->word());
 }
 
-state::state(const sequence::sequence& sentence)
-    : queue_{std::make_shared<queue_type>()}, q_idx_{0}, done_{false}
+state::state(const sequence::sequence& sentence, state_arena& arena)
+    : arena_{&arena}, stack_{state_arena::empty_stack}, q_idx_{0}, done_{false}
 {
-    queue_->reserve(sentence.size());
+    arena.clear();
     for (const auto& obs : sentence)
     {
         if (!obs.tagged())
             throw sr_parser::exception{"sentence must be POS tagged"};
 
-        std::string word = obs.symbol();
-        class_label tag{obs.tag()};
-        queue_->emplace_back(
-            make_unique<leaf_node>(std::move(tag), std::move(word)));
+        arena.add_word(class_label{obs.tag()}, obs.symbol());
     }
 }
 
-state::state(stack_type stack, std::shared_ptr<queue_type> queue, size_t q_idx,
-             bool done)
-    : stack_{std::move(stack)},
-      queue_{std::move(queue)},
-      q_idx_{q_idx},
-      done_{done}
+state::state(state_arena* arena, uint64_t stack, size_t q_idx, bool done)
+    : arena_{arena}, stack_{stack}, q_idx_{q_idx}, done_{done}
 {
     // nothing
 }
@@ -58,52 +51,38 @@ state state::advance(const transition& trans) const
     {
         case transition::type_t::SHIFT:
         {
-            auto stack = stack_.push(queue_item(0)->clone());
-            return {stack, queue_, q_idx_ + 1, done_};
+            auto stack = arena_->push(stack_, queue_item(0));
+            return {arena_, stack, q_idx_ + 1, done_};
         }
 
         case transition::type_t::REDUCE_L:
         case transition::type_t::REDUCE_R:
         {
-            auto right = stack_.peek()->clone();
-            auto stack = stack_.pop();
-            auto left = stack.peek()->clone();
-            stack = stack.pop();
+            auto right = arena_->top(stack_);
+            auto stack = arena_->pop(stack_);
+            auto left = arena_->top(stack);
+            stack = arena_->pop(stack);
 
-            auto bin = make_unique<internal_node>(trans.label());
-            bin->add_child(std::move(left));
-            bin->add_child(std::move(right));
+            auto head = trans.type() == transition::type_t::REDUCE_L ? left
+                                                                      : right;
+            auto bin = arena_->make_node(trans.label(), left, right, head);
 
-            if (trans.type() == transition::type_t::REDUCE_L)
-            {
-                bin->head(bin->child(0));
-            }
-            else
-            {
-                bin->head(bin->child(1));
-            }
-
-            stack = stack.push(std::move(bin));
-
-            return {stack, queue_, q_idx_, done_};
+            return {arena_, arena_->push(stack, bin), q_idx_, done_};
         }
 
         case transition::type_t::UNARY:
         {
-            auto child = stack_.peek()->clone();
-            auto stack = stack_.pop();
+            auto child = arena_->top(stack_);
+            auto stack = arena_->pop(stack_);
 
-            auto un = make_unique<internal_node>(trans.label());
-            un->add_child(std::move(child));
-            un->head(un->child(0));
+            auto un = arena_->make_node(trans.label(), child, nullptr, child);
 
-            stack = stack.push(std::move(un));
-            return {stack, queue_, q_idx_, done_};
+            return {arena_, arena_->push(stack, un), q_idx_, done_};
         }
 
         case transition::type_t::FINALIZE:
         {
-            return {stack_, queue_, q_idx_, true};
+            return {arena_, stack_, q_idx_, true};
         }
 
         case transition::type_t::IDLE:
@@ -139,8 +118,8 @@ bool shift_legal(const state& state)
         auto top = state.stack_item(0);
         if (top->is_temporary())
         {
-            const auto& in = top->as<internal_node>();
-            if (in.num_children() == 2 && in.head_constituent() == in.child(1))
+            if (top->num_children() == 2
+                && top->head_constituent() == top->child(1))
                 return false;
         }
     }
@@ -173,19 +152,16 @@ bool unary_legal(const state& state, const transition& trans)
 
     // From Zhang and Clark (2009): no more than three unary reduce actions
     // can be performed consecutively
-    if (!state.stack_item(0)->is_leaf())
+    auto in = state.stack_item(0);
+    if (!in->is_leaf() && in->num_children() == 1)
     {
-        const auto& in = state.stack_item(0)->as<internal_node>();
-        if (in.num_children() == 1)
+        auto child = in->child(0);
+        if (!child->is_leaf() && child->num_children() == 1)
         {
-            const auto& child = in.child(0)->as<internal_node>();
-            if (!child.is_leaf() && child.num_children() == 1)
+            auto grand_child = child->child(0);
+            if (!grand_child->is_leaf() && grand_child->num_children() == 1)
             {
-                const auto& grand_child = child.child(0)->as<internal_node>();
-                if (!grand_child.is_leaf() && grand_child.num_children() == 1)
-                {
-                    return false;
-                }
+                return false;
             }
         }
     }
@@ -349,29 +325,29 @@ transition state::emergency_transition() const
 
 size_t state::stack_size() const
 {
-    return stack_.size();
+    return arena_->size(stack_);
 }
 
 size_t state::queue_size() const
 {
-    return queue_->size() - q_idx_;
+    return arena_->num_words() - q_idx_;
 }
 
-const node* state::stack_item(size_t depth) const
+const state_node* state::stack_item(size_t depth) const
 {
     if (depth >= stack_size())
         return nullptr;
 
     auto st = stack_;
     for (uint64_t i = 0; i < depth; ++i)
-        st = st.pop();
-    return st.peek().get();
+        st = arena_->pop(st);
+    return arena_->top(st);
 }
 
-const leaf_node* state::queue_item(ssize_t depth) const
+const state_node* state::queue_item(ssize_t depth) const
 {
-    if (q_idx_ + depth < queue_->size())
-        return queue_->at(q_idx_ + depth).get();
+    if (q_idx_ + depth < arena_->num_words())
+        return arena_->word(q_idx_ + depth);
     return nullptr;
 }
 
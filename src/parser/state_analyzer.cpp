@@ -3,12 +3,12 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
 #include <cassert>
 
 #include "parser/state_analyzer.h"
 #include "parser/state.h"
-#include "parser/trees/internal_node.h"
-#include "parser/trees/leaf_node.h"
+#include "sequence/feature_hash.h"
 
 namespace meta
 {
@@ -17,39 +17,80 @@ namespace parser
 
 namespace
 {
+/// The value of a feature of a missing node
+const std::string null_value = "-NULL-";
+
 struct node_info
 {
-    std::string head_tag = "-NULL-";
-    std::string head_word = "-NULL-";
-    std::string category = "-NULL-";
+    const std::string* head_tag = &null_value;
+    const std::string* head_word = &null_value;
+    const std::string* category = &null_value;
 
-    node_info(const node* n)
+    node_info(const state_node* n)
     {
         if (!n)
             return;
 
-        category = n->category();
-        if (n->is_leaf())
-        {
-            head_tag = n->category();
-            head_word = *n->as<leaf_node>().word();
-        }
-        else
-        {
-            const auto& in = n->as<internal_node>();
-
-            head_tag = in.head_lexicon()->category();
-            head_word = *in.head_lexicon()->word();
-        }
+        category = &static_cast<const std::string&>(n->category());
+        head_tag = &static_cast<const std::string&>(
+            n->head_lexicon()->category());
+        head_word = &n->word();
     }
 };
+
+/**
+ * Starts a feature with the given prefix: as a string for string
+ * features, or as a hash for hashed ones.
+ */
+std::string key(const sr_parser::feature_vector&, const std::string& prefix)
+{
+    return prefix;
+}
+
+sequence::feature_hash key(const sr_parser::hashed_feature_vector&,
+                           const std::string& prefix)
+{
+    return sequence::feature_hash{prefix};
+}
+
+/**
+ * Adds a feature, with value 1.
+ */
+void add(sr_parser::feature_vector& feats, const std::string& key)
+{
+    feats[key] = 1;
+}
+
+void add(sr_parser::hashed_feature_vector& feats,
+         const sequence::feature_hash& key)
+{
+    feats.push_back(key.value());
+}
 }
 
 auto sr_parser::state_analyzer::featurize(
     const state& state) const -> feature_vector
 {
     feature_vector feats;
+    all_features(state, feats);
+    return feats;
+}
+
+void sr_parser::state_analyzer::featurize(const state& state,
+                                          hashed_feature_vector& feats) const
+{
+    feats.clear();
+    all_features(state, feats);
 
+    // a feature added twice is still one feature, as in a feature_vector
+    std::sort(feats.begin(), feats.end());
+    feats.erase(std::unique(feats.begin(), feats.end()), feats.end());
+}
+
+template <class FeatureVector>
+void sr_parser::state_analyzer::all_features(const state& state,
+                                             FeatureVector& feats) const
+{
     unigram_featurize(state, feats);
     bigram_featurize(state, feats);
     trigram_featurize(state, feats);
@@ -58,16 +99,15 @@ auto sr_parser::state_analyzer::featurize(
 
     if (state.queue_size() == 0)
     {
-        feats["queue_empty"] = 1;
+        add(feats, key(feats, "queue_empty"));
         if (state.stack_size() == 1)
-            feats["queue_empty_stack_single"] = 1;
+            add(feats, key(feats, "queue_empty_stack_single"));
     }
-
-    return feats;
 }
 
+template <class FeatureVector>
 void sr_parser::state_analyzer::unigram_featurize(const state& state,
-                                                  feature_vector& feats) const
+                                                  FeatureVector& feats) const
 {
     auto s0 = state.stack_item(0);
     unigram_stack_feats(s0, "s0", feats);
@@ -84,41 +124,70 @@ void sr_parser::state_analyzer::unigram_featurize(const state& state,
     for (ssize_t i = -2; i <= 3; ++i)
     {
         node_info info{state.queue_item(i)};
-        feats["q" + std::to_string(i) + "wt=" + info.head_word + "-"
-              + info.head_tag] = 1;
+        add(feats, key(feats, "q" + std::to_string(i) + "wt=")
+                       .append(*info.head_word)
+                       .append("-")
+                       .append(*info.head_tag));
     }
 }
 
-void sr_parser::state_analyzer::unigram_stack_feats(const node* n,
-                                                    std::string prefix,
-                                                    feature_vector& feats) const
+template <class FeatureVector>
+void sr_parser::state_analyzer::unigram_stack_feats(const state_node* n,
+                                                    const std::string& prefix,
+                                                    FeatureVector& feats) const
 {
     node_info hi{n};
 
-    feats[prefix + "c=" + hi.category] = 1;
-    feats[prefix + "t=" + hi.head_tag] = 1;
-    feats[prefix + "wc=" + hi.head_word + "-" + hi.category] = 1;
-    feats[prefix + "wt=" + hi.head_word + "-" + hi.head_tag] = 1;
-    feats[prefix + "tc=" + hi.head_tag + "-" + hi.category] = 1;
+    add(feats, key(feats, prefix).append("c=").append(*hi.category));
+    add(feats, key(feats, prefix).append("t=").append(*hi.head_tag));
+    add(feats, key(feats, prefix)
+                   .append("wc=")
+                   .append(*hi.head_word)
+                   .append("-")
+                   .append(*hi.category));
+    add(feats, key(feats, prefix)
+                   .append("wt=")
+                   .append(*hi.head_word)
+                   .append("-")
+                   .append(*hi.head_tag));
+    add(feats, key(feats, prefix)
+                   .append("tc=")
+                   .append(*hi.head_tag)
+                   .append("-")
+                   .append(*hi.category));
 }
 
-void sr_parser::state_analyzer::bigram_features(const node* n1,
-                                                std::string name1,
-                                                const node* n2,
-                                                std::string name2,
-                                                feature_vector& feats) const
+template <class FeatureVector>
+void sr_parser::state_analyzer::bigram_features(const state_node* n1,
+                                                const std::string& name1,
+                                                const state_node* n2,
+                                                const std::string& name2,
+                                                FeatureVector& feats) const
 {
     node_info n1h{n1};
     node_info n2h{n2};
 
-    feats[name1 + "w" + name2 + "w=" + n1h.head_word + "-" + n2h.head_word] = 1;
-    feats[name1 + "w" + name2 + "c=" + n1h.head_word + "-" + n2h.category] = 1;
-    feats[name1 + "c" + name2 + "w=" + n1h.category + "-" + n2h.head_word] = 1;
-    feats[name1 + "c" + name2 + "c=" + n1h.category + "-" + n2h.category] = 1;
+    auto bigram = [&](const char* part1, const std::string& value1,
+                      const char* part2, const std::string& value2)
+    {
+        add(feats, key(feats, name1)
+                       .append(part1)
+                       .append(name2)
+                       .append(part2)
+                       .append(value1)
+                       .append("-")
+                       .append(value2));
+    };
+
+    bigram("w", *n1h.head_word, "w=", *n2h.head_word);
+    bigram("w", *n1h.head_word, "c=", *n2h.category);
+    bigram("c", *n1h.category, "w=", *n2h.head_word);
+    bigram("c", *n1h.category, "c=", *n2h.category);
 }
 
+template <class FeatureVector>
 void sr_parser::state_analyzer::bigram_featurize(const state& state,
-                                                 feature_vector& feats) const
+                                                 FeatureVector& feats) const
 {
     bigram_features(state.stack_item(0), "s0", state.queue_item(0), "q0",
                     feats);
@@ -130,8 +199,9 @@ void sr_parser::state_analyzer::bigram_featurize(const state& state,
                     feats);
 }
 
+template <class FeatureVector>
 void sr_parser::state_analyzer::trigram_featurize(const state& state,
-                                                  feature_vector& feats) const
+                                                  FeatureVector& feats) const
 {
     auto s0 = state.stack_item(0);
     auto s1 = state.stack_item(1);
@@ -143,36 +213,31 @@ void sr_parser::state_analyzer::trigram_featurize(const state& state,
     node_info s2h{s2};
     node_info q0h{q0};
 
-    feats["s0cs1cs2c=" + s0h.category + "-" + s1h.category + "-" + s2h.category]
-        = 1;
-
-    feats["s0ws1cs2c=" + s0h.head_word + "-" + s1h.category + "-"
-          + s2h.category] = 1;
-
-    feats["s0cs1ws2c=" + s0h.category + "-" + s1h.head_word + "-"
-          + s2h.category] = 1;
-
-    feats["s0cs1cs2w=" + s0h.category + "-" + s1h.category + "-"
-          + s2h.head_word] = 1;
-
-    feats["s0cs1wq0t=" + s0h.category + "-" + s1h.head_word + "-"
-          + q0h.head_tag] = 1;
-
-    feats["s0cs1cq0t=" + s0h.category + "-" + s1h.category + "-" + q0h.head_tag]
-        = 1;
-
-    feats["s0ws1cq0t=" + s0h.head_word + "-" + s1h.category + "-"
-          + q0h.head_tag] = 1;
-
-    feats["s0cs1wq0t=" + s0h.category + "-" + s1h.head_word + "-"
-          + q0h.head_tag] = 1;
-
-    feats["s0cs1cq0w=" + s0h.category + "-" + s1h.category + "-"
-          + q0h.head_word] = 1;
+    auto trigram = [&](const char* name, const std::string& value1,
+                       const std::string& value2, const std::string& value3)
+    {
+        add(feats, key(feats, name)
+                       .append(value1)
+                       .append("-")
+                       .append(value2)
+                       .append("-")
+                       .append(value3));
+    };
+
+    trigram("s0cs1cs2c=", *s0h.category, *s1h.category, *s2h.category);
+    trigram("s0ws1cs2c=", *s0h.head_word, *s1h.category, *s2h.category);
+    trigram("s0cs1ws2c=", *s0h.category, *s1h.head_word, *s2h.category);
+    trigram("s0cs1cs2w=", *s0h.category, *s1h.category, *s2h.head_word);
+    trigram("s0cs1wq0t=", *s0h.category, *s1h.head_word, *q0h.head_tag);
+    trigram("s0cs1cq0t=", *s0h.category, *s1h.category, *q0h.head_tag);
+    trigram("s0ws1cq0t=", *s0h.head_word, *s1h.category, *q0h.head_tag);
+    trigram("s0cs1wq0t=", *s0h.category, *s1h.head_word, *q0h.head_tag);
+    trigram("s0cs1cq0w=", *s0h.category, *s1h.category, *q0h.head_word);
 }
 
+template <class FeatureVector>
 void sr_parser::state_analyzer::children_featurize(const state& state,
-                                                   feature_vector& feats) const
+                                                   FeatureVector& feats) const
 {
     if (state.stack_size() > 0)
     {
@@ -187,14 +252,16 @@ void sr_parser::state_analyzer::children_featurize(const state& state,
     }
 }
 
-void sr_parser::state_analyzer::child_feats(const node* n, std::string prefix,
-                                            feature_vector& feats,
+template <class FeatureVector>
+void sr_parser::state_analyzer::child_feats(const state_node* n,
+                                            const std::string& prefix,
+                                            FeatureVector& feats,
                                             bool doubs) const
 {
     if (n->is_leaf())
         return;
 
-    const auto& in = n->as<internal_node>();
+    const auto& in = *n;
 
     assert(in.num_children() <= 2);
 
@@ -223,7 +290,7 @@ void sr_parser::state_analyzer::child_feats(const node* n, std::string prefix,
 
 namespace
 {
-const node* left_dependent(const node* n)
+const state_node* left_dependent(const state_node* n)
 {
     if (n)
     {
@@ -231,11 +298,11 @@ const node* left_dependent(const node* n)
 
         while (!n->is_leaf())
         {
-            const auto& in = n->as<internal_node>();
+            const auto& in = *n;
             auto child = in.child(0);
             node_info chi{child};
 
-            if (chi.head_word != hi.head_word)
+            if (*chi.head_word != *hi.head_word)
                 return child;
 
             n = child;
@@ -245,7 +312,7 @@ const node* left_dependent(const node* n)
     return nullptr;
 }
 
-const node* right_dependent(const node* n)
+const state_node* right_dependent(const state_node* n)
 {
     if (n)
     {
@@ -253,7 +320,7 @@ const node* right_dependent(const node* n)
 
         while (!n->is_leaf())
         {
-            const auto& in = n->as<internal_node>();
+            const auto& in = *n;
             if (in.num_children() == 1)
             {
                 n = in.child(0);
@@ -265,7 +332,7 @@ const node* right_dependent(const node* n)
                 auto child = in.child(1);
                 node_info chi{child};
 
-                if (chi.head_word != hi.head_word)
+                if (*chi.head_word != *hi.head_word)
                     return child;
 
                 n = child;
@@ -277,9 +344,10 @@ const node* right_dependent(const node* n)
 }
 }
 
+template <class FeatureVector>
 void
     sr_parser::state_analyzer::dependents_featurize(const state& state,
-                                                    feature_vector& feats) const
+                                                    FeatureVector& feats) const
 {
     unigram_stack_feats(left_dependent(state.stack_item(0)), "rs0l", feats);
     unigram_stack_feats(left_dependent(state.stack_item(1)), "rs1l", feats);
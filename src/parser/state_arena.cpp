@@ -0,0 +1,102 @@
+/**
+ * @file state_arena.cpp
+ */
+
+#include "parser/state_arena.h"
+#include "parser/trees/internal_node.h"
+#include "parser/trees/leaf_node.h"
+
+namespace meta
+{
+namespace parser
+{
+
+state_node::state_node(class_label tag, const std::string* word)
+    : category_{std::move(tag)}, word_{word}
+{
+    // nothing
+}
+
+state_node::state_node(class_label cat, const state_node* left,
+                       const state_node* right, const state_node* head)
+    : category_{std::move(cat)},
+      children_{left, right},
+      num_children_{right ? 2u : 1u},
+      head_{head},
+      lexicon_{head->head_lexicon()}
+{
+    // nothing
+}
+
+bool state_node::is_temporary() const
+{
+    if (is_leaf())
+        return false;
+
+    const std::string& cat = category_;
+    return cat[cat.length() - 1] == '*';
+}
+
+std::unique_ptr<node> state_node::tree() const
+{
+    if (is_leaf())
+        return make_unique<leaf_node>(category_, *word_);
+
+    auto in = make_unique<internal_node>(category_);
+    for (uint64_t i = 0; i < num_children_; ++i)
+        in->add_child(children_[i]->tree());
+    in->head(in->child(head_ == children_[0] ? 0 : 1));
+    return in;
+}
+
+const uint64_t state_arena::empty_stack;
+const uint64_t state_arena::block_size;
+
+state_arena::state_arena() : num_nodes_{0}
+{
+    clear();
+}
+
+void state_arena::clear()
+{
+    // the blocks are kept; the nodes in them are assigned over
+    num_nodes_ = 0;
+    cells_.clear();
+    cells_.push_back({nullptr, empty_stack, 0});
+    words_.clear();
+    queue_.clear();
+}
+
+void state_arena::add_word(class_label tag, std::string word)
+{
+    words_.push_back(std::move(word));
+    auto& leaf = allocate();
+    leaf = state_node{std::move(tag), &words_.back()};
+    queue_.push_back(&leaf);
+}
+
+const state_node* state_arena::make_node(class_label cat,
+                                         const state_node* left,
+                                         const state_node* right,
+                                         const state_node* head)
+{
+    auto& n = allocate();
+    n = state_node{std::move(cat), left, right, head};
+    return &n;
+}
+
+uint64_t state_arena::push(uint64_t stack, const state_node* item)
+{
+    cells_.push_back({item, stack, cells_[stack].size + 1});
+    return cells_.size() - 1;
+}
+
+state_node& state_arena::allocate()
+{
+    auto block = num_nodes_ / block_size;
+    if (block == blocks_.size())
+        blocks_.emplace_back(new state_node[block_size]);
+    return blocks_[block][num_nodes_++ % block_size];
+}
+}
+}
@@ -7,6 +7,7 @@
 
 #include "cpptoml.h"
 #include "logging/logger.h"
+#include "parallel/default_pool.h"
 #include "parser/io/ptb_reader.h"
 #include "parser/sr_parser.h"
 #include "parser/trees/evalb.h"
@@ -37,6 +38,7 @@ int main(int argc, char** argv)
     logging::set_cerr_logging();
 
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
 
     auto prefix = config.get_as<std::string>("prefix");
     if (!prefix)
@@ -124,21 +126,19 @@ int main(int argc, char** argv)
     LOG(info) << testing.size() << " test examples" << ENDLG;
 
     parser::sr_parser parser{*parser_prefix};
+    auto dense = parser_grp->get_as<bool>("dense");
+    if (dense && *dense)
+        parser.densify();
 
-    parser::evalb eval;
-    std::ofstream output{argv[2]};
-    printing::progress progress{" > Parsing: ", testing.size()};
-    for (uint64_t i = 0; i < testing.size(); ++i)
-    {
-        progress(i);
-        auto tree = parser.parse(testing[i]);
+    LOG(info) << "Parsing " << testing.size() << " sentences" << ENDLG;
+    auto& pool = parallel::default_pool();
+    std::vector<parser::parse_tree> trees;
+    auto eval = parser.evaluate(testing, gold_trees, pool, &trees);
 
+    std::ofstream output{argv[2]};
+    for (const auto& tree : trees)
         output << tree << "\n";
 
-        eval.add_tree(tree, gold_trees[i]);
-    }
-    progress.end();
-
     std::cout << "Matched: " << eval.matched() << "\n"
               << "Gold:    " << eval.gold_total() << "\n"
               << "Test:    " << eval.proposed_total() << std::endl;
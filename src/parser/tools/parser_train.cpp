@@ -7,10 +7,11 @@
 
 #include "cpptoml.h"
 #include "logging/logger.h"
+#include "parallel/parallel_for.h"
 #include "parser/io/ptb_reader.h"
 #include "parser/sr_parser.h"
 #include "util/filesystem.h"
-#include "util/progress.h"
+#include "util/range.h"
 
 using namespace meta;
 
@@ -98,25 +99,42 @@ int main(int argc, char** argv)
     std::string path = *prefix + "/" + *treebank + "/treebank-3/parsed/mrg/"
                        + *corpus;
 
+    auto cache = parser_grp->get_as<std::string>("train-cache");
+
+    parallel::thread_pool pool{num_threads
+                                   ? static_cast<uint64_t>(*num_threads)
+                                   : std::thread::hardware_concurrency()};
+
+    // the trees need not be read if they were preprocessed before
     std::vector<parser::parse_tree> training;
+    if (!cache || !parser::sr_parser::cached(*cache))
     {
         auto begin = train_sections->at(0)->as<int64_t>()->get();
         auto end = train_sections->at(1)->as<int64_t>()->get();
-        printing::progress progress(" > Reading training data: ",
-                                    (end - begin + 1) * *section_size);
+
+        std::vector<std::string> files;
         for (uint8_t i = begin; i <= end; ++i)
         {
             auto folder = two_digit(i);
             for (uint8_t j = 0; j <= *section_size; ++j)
             {
-                progress((i - begin) * 99 + j);
                 auto file = *corpus + "_" + folder + two_digit(j) + ".mrg";
-                auto filename = path + "/" + folder + "/" + file;
-                auto trees = parser::io::extract_trees(filename);
-                for (auto& tree : trees)
-                    training.emplace_back(std::move(tree));
+                files.push_back(path + "/" + folder + "/" + file);
             }
         }
+
+        LOG(info) << "Reading " << files.size() << " training files" << ENDLG;
+        std::vector<std::vector<parser::parse_tree>> file_trees(files.size());
+        auto range = util::range<uint64_t>(0, files.size() - 1);
+        parallel::parallel_for(range.begin(), range.end(), pool,
+                               [&](uint64_t i)
+                               {
+            file_trees[i] = parser::io::extract_trees(files[i]);
+        });
+
+        for (auto& trees : file_trees)
+            for (auto& tree : trees)
+                training.emplace_back(std::move(tree));
     }
     LOG(info) << training.size() << " training examples" << ENDLG;
 
@@ -126,6 +144,16 @@ int main(int argc, char** argv)
     parser::sr_parser::training_options options{};
     if (num_threads)
         options.num_threads = *num_threads;
+    if (cache)
+        options.cache = *cache;
+
+    auto hash_bits = parser_grp->get_as<int64_t>("hash-bits");
+    if (hash_bits)
+    {
+        options.hash_bits = *hash_bits;
+        LOG(info) << "Hashing features to 2^" << options.hash_bits << " rows"
+                  << ENDLG;
+    }
 
     if (algorithm)
     {
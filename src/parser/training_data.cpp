@@ -3,6 +3,10 @@
  * @author Chase Geigle
  */
 
+#include <atomic>
+#include <fstream>
+#include <future>
+
 #include "parser/training_data.h"
 #include "parser/trees/visitors/annotation_remover.h"
 #include "parser/trees/visitors/empty_remover.h"
@@ -13,44 +17,162 @@
 #include "parser/trees/visitors/debinarizer.h"
 #include "parser/trees/visitors/transition_finder.h"
 #include "parser/trees/visitors/leaf_node_finder.h"
+#include "io/binary.h"
+#include "logging/logger.h"
+#include "util/filesystem.h"
 #include "util/progress.h"
 
+#ifdef META_HAS_ZLIB
+#include "io/gzstream.h"
+#endif
+
 namespace meta
 {
 namespace parser
 {
 
+namespace
+{
+/**
+ * @param prefix The directory the data is saved in
+ * @return the file the data is saved to
+ */
+std::string data_file(const std::string& prefix)
+{
+#ifdef META_HAS_ZLIB
+    return prefix + "/parser.training.gz";
+#else
+    return prefix + "/parser.training";
+#endif
+}
+}
+
 sr_parser::training_data::training_data(
     std::vector<parse_tree>& trs, std::default_random_engine::result_type seed)
-    : trees_(trs), indices_(trs.size()), rng_{seed}
+    : trees_(&trs), indices_(trs.size()), rng_{seed}
 {
     std::iota(indices_.begin(), indices_.end(), 0ul);
 }
 
-auto sr_parser::training_data::preprocess() -> transition_map
+sr_parser::training_data::training_data(
+    const std::string& prefix, std::default_random_engine::result_type seed)
+    : trees_{nullptr}, rng_{seed}
 {
-    transition_map trans_map;
+#ifdef META_HAS_ZLIB
+    io::gzifstream store{data_file(prefix)};
+#else
+    std::ifstream store{data_file(prefix), std::ios::binary};
+#endif
+    if (!store)
+        throw exception{"no preprocessed training data in " + prefix};
+
+    uint64_t num_sentences;
+    io::read_binary(store, num_sentences);
+    sentences_.resize(num_sentences);
+    all_transitions_.resize(num_sentences);
 
-    multi_transformer<annotation_remover, empty_remover, unary_chain_remover>
-        transformer;
+    printing::progress progress{" > Loading preprocessed trees: ",
+                                num_sentences};
+    for (uint64_t i = 0; i < num_sentences; ++i)
+    {
+        progress(i);
+        uint64_t num_words;
+        io::read_binary(store, num_words);
+        for (uint64_t w = 0; w < num_words; ++w)
+        {
+            std::string word;
+            std::string tag;
+            io::read_binary(store, word);
+            io::read_binary(store, tag);
+            sentences_[i].add_observation(
+                {sequence::symbol_t{std::move(word)},
+                 sequence::tag_t{std::move(tag)}});
+        }
+
+        uint64_t num_transitions;
+        io::read_binary(store, num_transitions);
+        auto& tids = all_transitions_[i];
+        tids.resize(num_transitions);
+        for (auto& tid : tids)
+            io::read_binary(store, tid);
+    }
 
-    head_finder hf;
-    binarizer bin;
+    if (!store)
+        throw exception{"preprocessed training data in " + prefix
+                        + " is truncated"};
 
-    printing::progress progress{" > Preprocessing training trees: ",
-                                trees_.size()};
-    size_t idx = 0;
-    for (auto& tree : trees_)
+    indices_.resize(num_sentences);
+    std::iota(indices_.begin(), indices_.end(), 0ul);
+}
+
+bool sr_parser::training_data::exists(const std::string& prefix)
+{
+    return filesystem::file_exists(data_file(prefix));
+}
+
+auto sr_parser::training_data::preprocess(parallel::thread_pool& pool)
+    -> transition_map
+{
+    auto& trees = *trees_;
+    sentences_.resize(trees.size());
+    std::vector<std::vector<transition>> found(trees.size());
+
+    LOG(info) << "Preprocessing " << trees.size() << " training trees"
+              << ENDLG;
+
+    // the threads take batches of trees from a shared counter, each with
+    // its own visitors
+    const uint64_t batch_size = 64;
+    std::atomic<uint64_t> next{0};
+    std::vector<std::future<void>> futures;
+    for (uint64_t t = 0; t < pool.thread_ids().size(); ++t)
     {
-        progress(++idx);
-        tree.transform(transformer);
-        tree.visit(hf);
-        tree.transform(bin);
+        futures.emplace_back(pool.submit_task([&]()
+        {
+            multi_transformer<annotation_remover, empty_remover,
+                              unary_chain_remover> transformer;
+            head_finder hf;
+            binarizer bin;
 
-        transition_finder trans;
-        tree.visit(trans);
+            while (true)
+            {
+                auto begin = next.fetch_add(batch_size);
+                if (begin >= trees.size())
+                    break;
+                auto last = std::min<uint64_t>(begin + batch_size,
+                                               trees.size());
+                for (auto i = begin; i < last; ++i)
+                {
+                    auto& tree = trees[i];
+                    tree.transform(transformer);
+                    tree.visit(hf);
+                    tree.transform(bin);
 
-        auto transitions = trans.transitions();
+                    transition_finder trans;
+                    tree.visit(trans);
+                    found[i] = trans.transitions();
+
+                    leaf_node_finder lnf;
+                    tree.visit(lnf);
+                    for (const auto& leaf : lnf.leaves())
+                        sentences_[i].add_observation(
+                            {sequence::symbol_t{*leaf->word()},
+                             sequence::tag_t{static_cast<std::string>(
+                                 leaf->category())}});
+                }
+            }
+        }));
+    }
+    for (auto& fut : futures)
+        fut.get();
+
+    // ids are given in the order of the trees, so they are the same
+    // however the work was split
+    transition_map trans_map;
+    all_transitions_.clear();
+    all_transitions_.reserve(trees.size());
+    for (const auto& transitions : found)
+    {
         std::vector<trans_id> tids;
         tids.reserve(transitions.size());
         for (const auto& trans : transitions)
@@ -61,6 +183,34 @@ auto sr_parser::training_data::preprocess() -> transition_map
     return trans_map;
 }
 
+void sr_parser::training_data::save(const std::string& prefix,
+                                    const transition_map& trans) const
+{
+    trans.save(prefix);
+
+#ifdef META_HAS_ZLIB
+    io::gzofstream store{data_file(prefix)};
+#else
+    std::ofstream store{data_file(prefix), std::ios::binary};
+#endif
+
+    io::write_binary(store, static_cast<uint64_t>(sentences_.size()));
+    for (uint64_t i = 0; i < sentences_.size(); ++i)
+    {
+        io::write_binary(store, static_cast<uint64_t>(sentences_[i].size()));
+        for (const auto& obs : sentences_[i])
+        {
+            io::write_binary(store, static_cast<std::string>(obs.symbol()));
+            io::write_binary(store, static_cast<std::string>(obs.tag()));
+        }
+
+        const auto& tids = all_transitions_[i];
+        io::write_binary(store, static_cast<uint64_t>(tids.size()));
+        for (const auto& tid : tids)
+            io::write_binary(store, tid);
+    }
+}
+
 void sr_parser::training_data::shuffle()
 {
     std::shuffle(indices_.begin(), indices_.end(), rng_);
@@ -71,9 +221,10 @@ size_t sr_parser::training_data::size() const
     return indices_.size();
 }
 
-const parse_tree& sr_parser::training_data::tree(size_t idx) const
+const sequence::sequence&
+    sr_parser::training_data::sentence(size_t idx) const
 {
-    return trees_[indices_[idx]];
+    return sentences_[indices_[idx]];
 }
 
 auto sr_parser::training_data::transitions(
@@ -3,10 +3,13 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
 #include <iostream>
 #include <set>
+#include <stdexcept>
 #include <unordered_set>
 #include "util/comparable.h"
+#include "parallel/parallel_for.h"
 #include "parser/trees/evalb.h"
 #include "parser/trees/visitors/visitor.h"
 #include "parser/trees/visitors/annotation_remover.h"
@@ -130,8 +133,8 @@ class collinizer : public tree_transformer
 void evalb::add_tree(parse_tree proposed, parse_tree gold)
 {
 
-    static multi_transformer<annotation_remover, collinizer, empty_remover>
-        trnsfm;
+    thread_local multi_transformer<annotation_remover, collinizer,
+                                   empty_remover> trnsfm;
 
     proposed.transform(trnsfm);
     gold.transform(trnsfm);
@@ -175,5 +178,38 @@ void evalb::add_tree(parse_tree proposed, parse_tree gold)
     gold_total_ += gold_total;
     proposed_correct_ += matched;
 }
+void evalb::add_trees(const std::vector<parse_tree>& proposed,
+                      const std::vector<parse_tree>& gold,
+                      parallel::thread_pool& pool)
+{
+    if (proposed.size() != gold.size())
+        throw std::invalid_argument{"evalb: " + std::to_string(proposed.size())
+                                    + " proposed trees but "
+                                    + std::to_string(gold.size())
+                                    + " gold trees"};
+
+    const uint64_t chunk_size = 64;
+    std::vector<evalb> evals(pool.thread_ids().size());
+    parallel::parallel_chunks(pool, proposed.size(), chunk_size,
+                              [&](uint64_t task, uint64_t first, uint64_t last)
+                              {
+        for (auto i = first; i < last; ++i)
+            evals[task].add_tree(proposed[i], gold[i]);
+    });
+
+    for (const auto& eval : evals)
+        merge(eval);
+}
+
+void evalb::merge(const evalb& other)
+{
+    proposed_correct_ += other.proposed_correct_;
+    proposed_total_ += other.proposed_total_;
+    gold_total_ += other.gold_total_;
+    perfect_ += other.perfect_;
+    crossed_ += other.crossed_;
+    zero_crossing_ += other.zero_crossing_;
+    total_trees_ += other.total_trees_;
+}
 }
 }
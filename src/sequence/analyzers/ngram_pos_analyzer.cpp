@@ -44,7 +44,7 @@ ngram_pos_analyzer::ngram_pos_analyzer(const ngram_pos_analyzer& other)
 void ngram_pos_analyzer::tokenize(corpus::document& doc)
 {
     // first, get tokens
-    stream_->set_content(get_content(doc));
+    set_content(*stream_, doc);
     std::vector<sequence::sequence> sentences;
     sequence::sequence seq;
 
@@ -4,13 +4,16 @@
  */
 
 #include <algorithm>
+#include <atomic>
 #include <random>
 #include <numeric>
 #include <map>
+#include <mutex>
 #include <set>
 #include "sequence/crf/crf.h"
 #include "sequence/crf/scorer.h"
 #include "util/mapping.h"
+#include "util/metrics.h"
 #include "util/optional.h"
 #include "util/progress.h"
 #include "util/time.h"
@@ -55,6 +58,7 @@ void crf::initialize(const std::vector<sequence>& examples)
 {
     std::map<feature_id, std::set<label_id>> obs_feats;
     std::map<label_id, std::set<label_id>> trans_feats;
+    num_labels_ = 0;
 
     {
         printing::progress progress{" > Feature generation: ", examples.size()};
@@ -67,6 +71,7 @@ void crf::initialize(const std::vector<sequence>& examples)
             {
                 // build label id mapping by side-effect
                 auto lbl = seq[t].label();
+                num_labels_ = std::max<uint64_t>(num_labels_, lbl + 1);
 
                 // observation features
                 for (const auto& pair : seq[t].features())
@@ -81,12 +86,10 @@ void crf::initialize(const std::vector<sequence>& examples)
         }
     }
 
-    num_labels_ = trans_feats.size();
-
     observation_ranges_ = util::disk_vector<crf_feature_id>{
         prefix_ + "/observation_ranges.vector", obs_feats.size() + 1};
     transition_ranges_ = util::disk_vector<crf_feature_id>{
-        prefix_ + "/transition_ranges.vector", trans_feats.size() + 1};
+        prefix_ + "/transition_ranges.vector", num_labels_ + 1};
 
     uint64_t obs_size = 0;
     for (const auto& pair : obs_feats)
@@ -112,11 +115,15 @@ void crf::initialize(const std::vector<sequence>& examples)
         }
     }
 
+    // a label that never precedes another one (like the tag for a
+    // sentence-final full stop) still gets an (empty) transition range
     uint64_t trans_size = 0;
-    for (const auto& pair : trans_feats)
+    for (label_id lbl{0}; lbl < num_labels_; ++lbl)
     {
-        (*transition_ranges_)[pair.first] = trans_size;
-        trans_size += pair.second.size();
+        (*transition_ranges_)[lbl] = trans_size;
+        auto it = trans_feats.find(lbl);
+        if (it != trans_feats.end())
+            trans_size += it->second.size();
     }
     (*transition_ranges_)[transition_ranges_->size() - 1] = trans_size;
 
@@ -154,6 +161,21 @@ uint64_t crf::num_labels() const
     return num_labels_;
 }
 
+double crf::score(const sequence& seq) const
+{
+    scorer scr;
+    scr.transition_scores(*this);
+    scr.state_scores(*this, seq);
+    double total = 0;
+    for (uint64_t t = 0; t < seq.size(); ++t)
+    {
+        total += scr.state(t, seq[t].label());
+        if (t > 0)
+            total += scr.trans(seq[t - 1].label(), seq[t].label());
+    }
+    return total;
+}
+
 const double& crf::obs_weight(crf_feature_id idx) const
 {
     return (*observation_weights_)[idx];
@@ -196,8 +218,74 @@ label_id crf::transition(crf_feature_id fid) const
     return (*transitions_)[fid];
 }
 
+template <class ObsUpdate, class TransUpdate>
+void crf::gradient_observation_expectation(const sequence& seq, double gain,
+                                           ObsUpdate&& obs_update,
+                                           TransUpdate&& trans_update) const
+{
+    util::optional<label_id> prev;
+    for (const auto& obs : seq)
+    {
+        auto lbl = obs.label();
+        for (const auto& pair : obs.features())
+        {
+            for (const auto& idx : obs_range(pair.first))
+            {
+                if (observation(idx) == lbl)
+                {
+                    obs_update(idx, gain * pair.second);
+                    break;
+                }
+            }
+        }
+
+        if (prev)
+        {
+            for (const auto& idx : trans_range(*prev))
+            {
+                if (transition(idx) == lbl)
+                {
+                    trans_update(idx, gain);
+                    break;
+                }
+            }
+        }
+
+        prev = lbl;
+    }
+}
+
+template <class ObsUpdate, class TransUpdate>
+void crf::gradient_model_expectation(const sequence& seq, double gain,
+                                     const scorer& scr, ObsUpdate&& obs_update,
+                                     TransUpdate&& trans_update) const
+{
+    for (uint64_t t = 0; t < seq.size(); ++t)
+    {
+        for (const auto& pair : seq[t].features())
+        {
+            for (const auto& idx : obs_range(pair.first))
+            {
+                auto lbl = observation(idx);
+                obs_update(idx, gain * pair.second
+                                    * scr.state_marginal(t, lbl));
+            }
+        }
+    }
+
+    for (label_id i{0}; i < num_labels(); ++i)
+    {
+        for (const auto& idx : trans_range(i))
+        {
+            auto j = transition(idx);
+            trans_update(idx, gain * scr.trans_marginal(i, j));
+        }
+    }
+}
+
 double crf::calibrate(parameters params, const std::vector<uint64_t>& indices,
-                      const std::vector<sequence>& examples)
+                      const std::vector<sequence>& examples,
+                      parallel::thread_pool* pool)
 {
     auto num_samples =
         std::min<uint64_t>(params.calibration_samples, indices.size());
@@ -209,14 +297,41 @@ double crf::calibrate(parameters params, const std::vector<uint64_t>& indices,
     progress.print_endline(false);
 
     scorer scorer;
-    for (uint64_t idx = 0; idx < num_samples; ++idx)
+    if (pool)
     {
-        progress(idx);
+        // each thread sums the loss of every num_threads-th sample
+        auto num_threads = pool->thread_ids().size();
+        std::vector<double> losses(num_threads, 0.0);
+        std::vector<std::future<void>> futures;
+        for (uint64_t t = 0; t < num_threads; ++t)
+        {
+            futures.emplace_back(pool->submit_task([&, t]()
+            {
+                crf::scorer scr;
+                for (auto idx = t; idx < num_samples; idx += num_threads)
+                {
+                    const auto& seq = examples[samples[idx]];
+                    scr.score(*this, seq);
+                    scr.forward();
+                    losses[t] += scr.loss(seq);
+                }
+            }));
+        }
+        for (auto& fut : futures)
+            fut.get();
+        initial_loss = std::accumulate(losses.begin(), losses.end(), 0.0);
+    }
+    else
+    {
+        for (uint64_t idx = 0; idx < num_samples; ++idx)
+        {
+            progress(idx);
 
-        const auto& seq = examples[samples[idx]];
-        scorer.score(*this, seq);
-        scorer.forward();
-        initial_loss += scorer.loss(seq);
+            const auto& seq = examples[samples[idx]];
+            scorer.score(*this, seq);
+            scorer.forward();
+            initial_loss += scorer.loss(seq);
+        }
     }
     progress.end();
     progress.clear();
@@ -237,7 +352,8 @@ double crf::calibrate(parameters params, const std::vector<uint64_t>& indices,
         ss << " > Trial " << trial + 1 << ": ";
         printing::progress progress{ss.str(), num_samples};
         progress.print_endline(false);
-        auto loss = epoch(params, progress, 0, samples, examples, scorer);
+        auto loss = pool ? epoch(params, progress, 0, samples, examples, *pool)
+                         : epoch(params, progress, 0, samples, examples, scorer);
         loss += 0.5 * l2norm() * params.lambda * examples.size();
         progress.end();
         progress.clear();
@@ -285,7 +401,11 @@ double crf::train(parameters params, const std::vector<sequence>& examples)
     std::mt19937 rng{std::random_device{}()};
     std::shuffle(indices.begin(), indices.end(), rng);
 
-    params.t0 = calibrate(params, indices, examples);
+    std::unique_ptr<parallel::thread_pool> pool;
+    if (params.num_threads > 1)
+        pool.reset(new parallel::thread_pool{params.num_threads});
+
+    params.t0 = calibrate(params, indices, examples, pool.get());
 
     std::vector<double> old_loss(params.period);
 
@@ -301,8 +421,15 @@ double crf::train(parameters params, const std::vector<sequence>& examples)
         std::shuffle(indices.begin(), indices.end(), rng);
         auto time = common::time<std::chrono::milliseconds>([&]()
         {
-            loss = epoch(params, progress, iter - 1, indices, examples, scorer);
+            if (pool)
+                loss = epoch(params, progress, iter - 1, indices, examples,
+                             *pool);
+            else
+                loss = epoch(params, progress, iter - 1, indices, examples,
+                             scorer);
         });
+        if (metrics::enabled())
+            metrics::get_histogram("crf_epoch_ns").record(time);
         if (scale_ < 1e-9)
             rescale();
         auto l2 = l2norm();
@@ -347,80 +474,193 @@ double crf::epoch(parameters params, printing::progress& progress,
     return sum_loss;
 }
 
-double crf::iteration(parameters params, uint64_t iter,
-                      const sequence& seq, scorer& scorer)
+double crf::epoch(parameters params, printing::progress& progress,
+                  uint64_t iter, const std::vector<uint64_t>& indices,
+                  const std::vector<sequence>& examples,
+                  parallel::thread_pool& pool)
 {
-    double lr = 1 / (params.lambda * (params.t0 + iter));
-    scale_ *= (1 - params.lambda * lr);
-    auto gain = lr / scale_;
-
-    scorer.score(*this, seq);
-    scorer.marginals();
-
-    gradient_observation_expectation(seq, gain);
-    gradient_model_expectation(seq, -1.0 * gain, scorer);
-
-    return scorer.loss(seq);
+    if (params.strategy == update_strategy::lock_free)
+        return lock_free_epoch(params, progress, iter, indices, examples,
+                               pool);
+    return minibatch_epoch(params, progress, iter, indices, examples, pool);
 }
 
-void crf::gradient_observation_expectation(const sequence& seq, double gain)
+double crf::minibatch_epoch(parameters params, printing::progress& progress,
+                            uint64_t iter, const std::vector<uint64_t>& indices,
+                            const std::vector<sequence>& examples,
+                            parallel::thread_pool& pool)
 {
-    util::optional<label_id> prev;
-    for (const auto& obs : seq)
+    auto num_threads = pool.thread_ids().size();
+    auto batch_size = std::max<uint64_t>(params.batch_size, 1);
+
+    // the updates each thread finds are split by the thread that will
+    // apply them, which owns every num_threads-th feature, so that
+    // applying them needs no locks
+    using update_list = std::vector<std::pair<crf_feature_id, double>>;
+    std::vector<std::vector<update_list>> obs_updates(
+        num_threads, std::vector<update_list>(num_threads));
+    auto trans_updates = obs_updates;
+    std::vector<scorer> scorers(num_threads);
+    std::vector<double> losses(num_threads, 0.0);
+    std::vector<double> gains;
+    std::vector<std::future<void>> futures;
+
+    for (uint64_t begin = 0; begin < indices.size(); begin += batch_size)
     {
-        auto lbl = obs.label();
-        for (const auto& pair : obs.features())
+        progress(begin);
+        auto end = std::min<uint64_t>(begin + batch_size, indices.size());
+
+        // every step of the minibatch decays the weights as it would in
+        // serial training, and the update of each sequence is scaled by
+        // the gain of its own step
+        gains.clear();
+        auto scale = scale_;
+        for (auto i = begin; i < end; ++i)
         {
-            for (const auto& idx : obs_range(pair.first))
+            double lr = 1 / (params.lambda
+                             * (params.t0 + iter * indices.size() + i));
+            scale *= (1 - params.lambda * lr);
+            gains.push_back(lr / scale);
+        }
+
+        // every sequence is scored against the weights as they were at
+        // the start of the minibatch
+        for (uint64_t t = 0; t < num_threads; ++t)
+        {
+            futures.emplace_back(pool.submit_task([&, t]()
             {
-                if (observation(idx) == lbl)
+                auto& scr = scorers[t];
+                auto obs = [&](crf_feature_id idx, double amount)
                 {
-                    obs_weight(idx) += gain * pair.second;
-                    break;
+                    obs_updates[t][idx % num_threads].emplace_back(idx,
+                                                                   amount);
+                };
+                auto trans = [&](crf_feature_id idx, double amount)
+                {
+                    trans_updates[t][idx % num_threads].emplace_back(idx,
+                                                                     amount);
+                };
+                for (auto i = begin + t; i < end; i += num_threads)
+                {
+                    const auto& seq = examples[indices[i]];
+                    auto gain = gains[i - begin];
+                    scr.score(*this, seq);
+                    scr.marginals();
+                    gradient_observation_expectation(seq, gain, obs, trans);
+                    gradient_model_expectation(seq, -1.0 * gain, scr, obs,
+                                               trans);
+                    losses[t] += scr.loss(seq);
                 }
-            }
+            }));
         }
+        for (auto& fut : futures)
+            fut.get();
+        futures.clear();
 
-        if (prev)
+        // each thread applies the updates to the features it owns
+        scale_ = scale;
+        for (uint64_t t = 0; t < num_threads; ++t)
         {
-            for (const auto& idx : trans_range(*prev))
+            futures.emplace_back(pool.submit_task([&, t]()
             {
-                if (transition(idx) == lbl)
+                for (auto& lists : obs_updates)
                 {
-                    trans_weight(idx) += gain;
-                    break;
+                    for (const auto& update : lists[t])
+                        obs_weight(update.first) += update.second;
+                    lists[t].clear();
                 }
-            }
+                for (auto& lists : trans_updates)
+                {
+                    for (const auto& update : lists[t])
+                        trans_weight(update.first) += update.second;
+                    lists[t].clear();
+                }
+            }));
         }
-
-        prev = lbl;
+        for (auto& fut : futures)
+            fut.get();
+        futures.clear();
     }
+    return std::accumulate(losses.begin(), losses.end(), 0.0);
 }
 
-void crf::gradient_model_expectation(const sequence& seq, double gain,
-                                     const scorer& scr)
+double crf::lock_free_epoch(parameters params, printing::progress& progress,
+                            uint64_t iter, const std::vector<uint64_t>& indices,
+                            const std::vector<sequence>& examples,
+                            parallel::thread_pool& pool)
 {
-    for (uint64_t t = 0; t < seq.size(); ++t)
+    auto num_threads = pool.thread_ids().size();
+
+    // the threads take sequences in the shuffled order from a shared
+    // counter; only the decay of the weights, which every step makes, is
+    // done under a lock
+    std::atomic<uint64_t> next{0};
+    std::mutex scale_mutex;
+    std::vector<double> losses(num_threads, 0.0);
+    std::vector<std::future<void>> futures;
+    for (uint64_t t = 0; t < num_threads; ++t)
     {
-        for (const auto& pair : seq[t].features())
+        futures.emplace_back(pool.submit_task([&, t]()
         {
-            for (const auto& idx : obs_range(pair.first))
+            scorer scr;
+            auto obs = [&](crf_feature_id idx, double amount)
             {
-                auto lbl = observation(idx);
-                obs_weight(idx) += gain * pair.second
-                                   * scr.state_marginal(t, lbl);
+                obs_weight(idx) += amount;
+            };
+            auto trans = [&](crf_feature_id idx, double amount)
+            {
+                trans_weight(idx) += amount;
+            };
+            for (auto i = next++; i < indices.size(); i = next++)
+            {
+                if (t == 0)
+                    progress(i);
+
+                double gain;
+                {
+                    std::lock_guard<std::mutex> lock{scale_mutex};
+                    double lr = 1 / (params.lambda
+                                     * (params.t0 + iter * indices.size() + i));
+                    scale_ *= (1 - params.lambda * lr);
+                    gain = lr / scale_;
+                }
+
+                const auto& seq = examples[indices[i]];
+                scr.score(*this, seq);
+                scr.marginals();
+                gradient_observation_expectation(seq, gain, obs, trans);
+                gradient_model_expectation(seq, -1.0 * gain, scr, obs, trans);
+                losses[t] += scr.loss(seq);
             }
-        }
+        }));
     }
+    for (auto& fut : futures)
+        fut.get();
+    return std::accumulate(losses.begin(), losses.end(), 0.0);
+}
 
-    for (label_id i{0}; i < num_labels(); ++i)
+double crf::iteration(parameters params, uint64_t iter,
+                      const sequence& seq, scorer& scorer)
+{
+    double lr = 1 / (params.lambda * (params.t0 + iter));
+    scale_ *= (1 - params.lambda * lr);
+    auto gain = lr / scale_;
+
+    scorer.score(*this, seq);
+    scorer.marginals();
+
+    auto obs = [&](crf_feature_id idx, double amount)
     {
-        for (const auto& idx : trans_range(i))
-        {
-            auto j = transition(idx);
-            trans_weight(idx) += gain * scr.trans_marginal(i, j);
-        }
-    }
+        obs_weight(idx) += amount;
+    };
+    auto trans = [&](crf_feature_id idx, double amount)
+    {
+        trans_weight(idx) += amount;
+    };
+    gradient_observation_expectation(seq, gain, obs, trans);
+    gradient_model_expectation(seq, -1.0 * gain, scorer, obs, trans);
+
+    return scorer.loss(seq);
 }
 
 double crf::l2norm() const
@@ -3,7 +3,12 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
 #include "sequence/crf/scorer.h"
+#include "util/dense_ops.h"
 
 namespace meta
 {
@@ -32,9 +37,8 @@ void crf::scorer::transition_scores(const crf& model)
                                                    * model.scale_;
 
         // exponentiate and store in trans_exp_
-        std::transform(trans_.begin(outer), trans_.end(outer),
-                       trans_exp_.begin(outer), [](double val)
-        { return std::exp(val); });
+        util::dense::exp(trans_.row(outer), trans_exp_.row(outer),
+                         num_labels);
     }
 }
 
@@ -45,46 +49,37 @@ void crf::scorer::state_scores(const crf& model, const sequence& seq)
     state_exp_.resize(seq.size(), num_labels);
     for (uint64_t t = 0; t < seq.size(); ++t)
     {
+        auto row = state_.row(t);
         for (const auto& pair : seq[t].features())
         {
             auto value = model.scale_ * pair.second;
             for (const auto& idx : model.obs_range(pair.first))
-            {
-                auto lbl = model.observation(idx);
-                state_(t, lbl) += model.obs_weight(idx) * value;
-            }
+                row[model.observation(idx)] += model.obs_weight(idx) * value;
         }
 
         // exponentiate and store in state_exp_
-        std::transform(state_.begin(t), state_.end(t),
-                       state_exp_.begin(t), [](double val)
-        { return std::exp(val); });
+        util::dense::exp(row, state_exp_.row(t), num_labels);
     }
 }
 
 void crf::scorer::forward()
 {
-    fwd_ = forward_trellis{state_exp_.rows(), state_exp_.columns()};
+    auto num_labels = state_exp_.columns();
+    fwd_ = forward_trellis{state_exp_.rows(), num_labels};
 
     // initialize first column of trellis
-    for (label_id lbl{0}; lbl < state_exp_.columns(); ++lbl)
-        fwd_->probability(0, lbl, state_exp(0, lbl));
+    std::copy(state_exp_.begin(0), state_exp_.end(0), fwd_->row(0));
     // normalize to avoid underflow
     fwd_->normalize(0);
 
-    // compute remaining columns of trellis using recursive formulation
+    // compute remaining columns of trellis using recursive formulation:
+    // alpha[t] = state_exp[t] .* (alpha[t - 1] * trans_exp)
     for (uint64_t t = 1; t < state_exp_.rows(); ++t)
     {
-        for (label_id lbl{0}; lbl < state_exp_.columns(); ++lbl)
-        {
-            auto score = state_exp(t ,lbl);
-            double sum = 0;
-            for (label_id in{0}; in < state_exp_.columns(); ++in)
-            {
-                sum += fwd_->probability(t - 1, in) * trans_exp(in, lbl);
-            }
-            fwd_->probability(t, lbl, score * sum);
-        }
+        auto curr = fwd_->row(t);
+        util::dense::vector_matrix(fwd_->row(t - 1), trans_exp_, curr);
+        util::dense::multiply(curr, state_exp_.row(t), curr, num_labels);
+
         // normalize to avoid underflow
         fwd_->normalize(t);
     }
@@ -95,29 +90,26 @@ void crf::scorer::backward()
     if (!fwd_)
         forward();
 
-    bwd_ = trellis{state_exp_.rows(), state_exp_.columns()};
+    auto num_labels = state_exp_.columns();
+    bwd_ = trellis{state_exp_.rows(), num_labels};
 
     // initialize last column of the trellis
-    for (label_id lbl{0}; lbl < state_exp_.columns(); ++lbl)
-    {
-        auto val = fwd_->normalizer(state_exp_.rows() - 1);
-        bwd_->probability(state_exp_.rows() - 1, lbl, val);
-    }
+    auto last = state_exp_.rows() - 1;
+    std::fill_n(bwd_->row(last), num_labels, fwd_->normalizer(last));
 
     // to avoid unsigned weirdness, t is really t+1, so we are actually
-    // going to compute for index t-1 here to compute beta[t]
-    for (uint64_t t = state_exp_.rows() - 1; t > 0; --t)
+    // going to compute for index t-1 here to compute beta[t]. Each
+    // beta[t - 1][i] is the dot product of row i of trans_exp with
+    // beta[t] .* state_exp[t]
+    std::vector<double> weighted(num_labels);
+    for (uint64_t t = last; t > 0; --t)
     {
-        for (label_id i{0}; i < state_exp_.columns(); ++i)
-        {
-            double sum = 0;
-            for (label_id j{0}; j < state_exp_.columns(); ++j)
-            {
-                sum += bwd_->probability(t, j) * state_exp(t, j)
-                       * trans_exp(i, j);
-            }
-            bwd_->probability(t - 1, i, fwd_->normalizer(t - 1) * sum);
-        }
+        util::dense::multiply(bwd_->row(t), state_exp_.row(t),
+                              weighted.data(), num_labels);
+
+        auto curr = bwd_->row(t - 1);
+        util::dense::matrix_vector(trans_exp_, weighted.data(), curr);
+        util::dense::scale(fwd_->normalizer(t - 1), curr, num_labels);
     }
 }
 
@@ -135,34 +127,42 @@ void crf::scorer::marginals()
 
 void crf::scorer::transition_marginals()
 {
-    trans_mrg_ = double_matrix{trans_exp_.rows(), trans_exp_.rows()};
+    auto num_labels = trans_exp_.rows();
+    trans_mrg_ = double_matrix{num_labels, num_labels};
 
+    // trans_exp(lbl, in) does not depend on t, so sum the outer products
+    // alpha[t] x (beta[t + 1] .* state_exp[t + 1]) over t first and scale
+    // by it once at the end
+    std::vector<double> weighted(num_labels);
     for (uint64_t t = 0; t < state_exp_.rows() - 1; ++t)
     {
-        for (label_id lbl{0}; lbl < trans_mrg_->rows(); ++lbl)
-        {
-            for (label_id in{0}; in < trans_mrg_->columns(); ++in)
-            {
-                (*trans_mrg_)(lbl, in)
-                    += fwd_->probability(t, lbl) * trans_exp(lbl, in)
-                       * state_exp(t + 1, in) * bwd_->probability(t + 1, in);
-            }
-        }
+        util::dense::multiply(bwd_->row(t + 1), state_exp_.row(t + 1),
+                              weighted.data(), num_labels);
+
+        auto curr = fwd_->row(t);
+        for (label_id lbl{0}; lbl < num_labels; ++lbl)
+            util::dense::axpy(curr[lbl], weighted.data(),
+                              trans_mrg_->row(lbl), num_labels);
     }
+
+    for (label_id lbl{0}; lbl < num_labels; ++lbl)
+        util::dense::multiply(trans_mrg_->row(lbl), trans_exp_.row(lbl),
+                              trans_mrg_->row(lbl), num_labels);
 }
 
 void crf::scorer::state_marginals()
 {
-    state_mrg_ = double_matrix{state_exp_.rows(), state_exp_.columns()};
+    auto num_labels = state_exp_.columns();
+    state_mrg_ = double_matrix{state_exp_.rows(), num_labels};
 
     for (uint64_t t = 0; t < state_mrg_->rows(); ++t)
     {
-        for (label_id lbl{0}; lbl < state_mrg_->columns(); ++lbl)
-        {
-            (*state_mrg_)(t, lbl) = fwd_->probability(t, lbl)
-                                    * bwd_->probability(t, lbl)
-                                    * (1.0 / fwd_->normalizer(t));
-        }
+        auto row = state_mrg_->row(t);
+        auto alpha = fwd_->row(t);
+        auto beta = bwd_->row(t);
+        auto scale = 1.0 / fwd_->normalizer(t);
+        for (uint64_t lbl = 0; lbl < num_labels; ++lbl)
+            row[lbl] = alpha[lbl] * beta[lbl] * scale;
     }
 }
 
@@ -191,6 +191,11 @@ double crf::scorer::state(uint64_t time, label_id lbl) const
     return state_(time, lbl);
 }
 
+const double* crf::scorer::state_row(uint64_t time) const
+{
+    return &state_(time, 0);
+}
+
 double crf::scorer::state_exp(uint64_t time, label_id lbl) const
 {
     return state_exp_(time, lbl);
@@ -201,6 +206,11 @@ double crf::scorer::trans(label_id from, label_id to) const
     return trans_(from, to);
 }
 
+const double* crf::scorer::trans_row(label_id from) const
+{
+    return &trans_(from, 0);
+}
+
 double crf::scorer::trans_exp(label_id from, label_id to) const
 {
     return trans_exp_(from, to);
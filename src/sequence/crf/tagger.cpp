@@ -3,6 +3,10 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+#include <atomic>
+
+#include "parallel/default_pool.h"
 #include "sequence/crf/tagger.h"
 #include "util/functional.h"
 
@@ -16,15 +20,34 @@ auto crf::make_tagger() const -> tagger
     return tagger{*this};
 }
 
+auto crf::make_tagger(const decoding_options& options) const -> tagger
+{
+    return tagger{*this, options};
+}
+
 crf::tagger::tagger(const crf& model)
-    : scorer_{model}, num_labels_{model.num_labels()}
+    : tagger{model, decoding_options{}}
+{
+    // nothing
+}
+
+crf::tagger::tagger(const crf& model, const decoding_options& options)
+    : scorer_{model, options}, num_labels_{model.num_labels()}
 {
     // nothing
 }
 
 void crf::tagger::tag(sequence& seq)
 {
-    auto trellis = scorer_.viterbi(seq);
+    tag(seq, scorer_);
+}
+
+void crf::tagger::tag(sequence& seq, crf::viterbi_scorer& scorer) const
+{
+    if (seq.size() == 0)
+        return;
+
+    const auto& trellis = scorer.viterbi(seq);
 
     auto lbls = util::range(label_id{0}, label_id(num_labels_ - 1));
     auto last_lbl = functional::argmax(lbls.begin(), lbls.end(),
@@ -38,5 +61,40 @@ void crf::tagger::tag(sequence& seq)
         seq[t - 1].label(trellis.previous_tag(t, seq[t].label()));
 }
 
+void crf::tagger::tag(std::vector<sequence>& seqs,
+                      parallel::thread_pool& pool) const
+{
+    // the threads take batches of sequences from a shared counter; the
+    // batches are small since sentences vary a lot in length
+    const uint64_t batch_size = 16;
+    std::atomic<uint64_t> next{0};
+    std::vector<std::future<void>> futures;
+    for (uint64_t t = 0; t < pool.thread_ids().size(); ++t)
+    {
+        futures.emplace_back(pool.submit_task([&]()
+        {
+            // the copy keeps the transition scores already computed
+            auto scorer = scorer_;
+            while (true)
+            {
+                auto begin = next.fetch_add(batch_size);
+                if (begin >= seqs.size())
+                    break;
+                auto last = std::min<uint64_t>(begin + batch_size,
+                                               seqs.size());
+                for (auto i = begin; i < last; ++i)
+                    tag(seqs[i], scorer);
+            }
+        }));
+    }
+    for (auto& fut : futures)
+        fut.get();
+}
+
+void crf::tagger::tag(std::vector<sequence>& seqs) const
+{
+    tag(seqs, parallel::default_pool());
+}
+
 }
 }
@@ -5,6 +5,7 @@
 #include "sequence/io/ptb_parser.h"
 #include "cpptoml.h"
 #include "classify/confusion_matrix.h"
+#include "parallel/default_pool.h"
 
 using namespace meta;
 
@@ -26,6 +27,7 @@ int main(int argc, char** argv)
     logging::set_cerr_logging();
 
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
 
     auto prefix = config.get_as<std::string>("prefix");
     if (!prefix)
@@ -80,27 +82,26 @@ int main(int argc, char** argv)
     std::string path =
         *prefix + "/" + *treebank + "/treebank-2/tagged/" + *corpus;
 
-    std::vector<sequence::sequence> testing;
+    std::vector<std::string> filenames;
     {
         auto begin = train_sections->at(0)->as<int64_t>()->get();
         auto end = train_sections->at(1)->as<int64_t>()->get();
-        printing::progress progress(" > Reading training data: ",
-                                    (end - begin + 1) * *section_size);
         for (uint8_t i = begin; i <= end; ++i)
         {
             auto folder = two_digit(i);
             for (uint8_t j = 0; j <= *section_size; ++j)
             {
-                progress((i - begin) * 99 + j);
                 auto file = *corpus + "_" + folder + two_digit(j) + ".pos";
-                auto filename = path + "/" + folder + "/" + file;
-                auto sequences = sequence::extract_sequences(filename);
-                for (auto & seq : sequences)
-                    testing.emplace_back(std::move(seq));
+                filenames.push_back(path + "/" + folder + "/" + file);
             }
         }
     }
 
+    // each file is parsed by a thread of the default pool
+    LOG(info) << "Reading testing data from " << filenames.size()
+              << " files..." << ENDLG;
+    auto testing = sequence::extract_sequences(filenames);
+
     auto analyzer = sequence::default_pos_analyzer();
     analyzer.load(*crf_prefix);
     {
@@ -123,8 +124,15 @@ int main(int argc, char** argv)
     // load the model
     sequence::crf crf{*crf_prefix};
 
-    // make a tagger
-    auto tagger = crf.make_tagger();
+    // make a tagger, decoding as the configuration asks
+    sequence::crf::decoding_options options;
+    if (auto beam_size = crf_grp->get_as<int64_t>("beam-size"))
+        options.beam_size = static_cast<uint64_t>(*beam_size);
+    if (auto compact = crf_grp->get_as<bool>("compact-weights"))
+        options.compact = *compact;
+    if (auto mask = crf_grp->get_as<bool>("mask-transitions"))
+        options.mask_transitions = *mask;
+    auto tagger = crf.make_tagger(options);
 
     // run the tagger on every sequence, measuring statistics for
     // token-level accuracy, F1, etc.
@@ -2,10 +2,11 @@
 
 #include "logging/logger.h"
 #include "sequence/sequence.h"
-#include "util/progress.h"
 #include "sequence/sequence_analyzer.h"
 #include "sequence/crf/crf.h"
 #include "sequence/io/ptb_parser.h"
+#include "sequence/io/sequence_cache.h"
+#include "parallel/default_pool.h"
 #include "util/filesystem.h"
 #include "cpptoml.h"
 
@@ -29,6 +30,7 @@ int main(int argc, char** argv)
     logging::set_cerr_logging();
 
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
 
     auto prefix = config.get_as<std::string>("prefix");
     if (!prefix)
@@ -83,43 +85,69 @@ int main(int argc, char** argv)
     std::string path =
         *prefix + "/" + *treebank + "/treebank-2/tagged/" + *corpus;
 
+    // with a feature cache, the sequences are parsed and analyzed only once
+    // and the analyzer that numbered their features is saved beside them
+    auto cache = crf_grp->get_as<std::string>("feature-cache");
+    filesystem::make_directory(*crf_prefix);
+
     std::vector<sequence::sequence> training;
+    auto analyzer = sequence::default_pos_analyzer();
+    if (cache && filesystem::file_exists(*cache)
+        && filesystem::file_exists(*crf_prefix + "/label.mapping"))
+    {
+        LOG(info) << "Loading analyzed training data from " << *cache
+                  << ENDLG;
+        analyzer.load(*crf_prefix);
+        training = sequence::load_sequences(*cache);
+    }
+    else
     {
-        auto begin = train_sections->at(0)->as<int64_t>()->get();
-        auto end = train_sections->at(1)->as<int64_t>()->get();
-        printing::progress progress(" > Reading training data: ",
-                                    (end - begin + 1) * *section_size);
-        for (uint8_t i = begin; i <= end; ++i)
+        std::vector<std::string> filenames;
         {
-            auto folder = two_digit(i);
-            for (uint8_t j = 0; j <= *section_size; ++j)
+            auto begin = train_sections->at(0)->as<int64_t>()->get();
+            auto end = train_sections->at(1)->as<int64_t>()->get();
+            for (uint8_t i = begin; i <= end; ++i)
             {
-                progress((i - begin) * 99 + j);
-                auto file = *corpus + "_" + folder + two_digit(j) + ".pos";
-                auto filename = path + "/" + folder + "/" + file;
-                auto sequences = sequence::extract_sequences(filename);
-                for (auto & seq : sequences)
-                    training.emplace_back(std::move(seq));
+                auto folder = two_digit(i);
+                for (uint8_t j = 0; j <= *section_size; ++j)
+                {
+                    auto file = *corpus + "_" + folder + two_digit(j) + ".pos";
+                    filenames.push_back(path + "/" + folder + "/" + file);
+                }
             }
         }
+
+        // each file is parsed by a thread of the default pool
+        LOG(info) << "Reading training data from " << filenames.size()
+                  << " files..." << ENDLG;
+        training = sequence::extract_sequences(filenames);
+
+        LOG(info) << "Generating features..." << ENDLG;
+        analyzer.analyze(training);
+        analyzer.save(*crf_prefix);
+        if (cache)
+            sequence::save_sequences(training, *cache);
     }
 
-    filesystem::make_directory(*crf_prefix);
-    auto analyzer = sequence::default_pos_analyzer();
+    sequence::crf::parameters params;
+    if (auto threads = crf_grp->get_as<int64_t>("threads"))
+        params.num_threads = static_cast<uint64_t>(*threads);
+    if (auto strategy = crf_grp->get_as<std::string>("update-strategy"))
     {
-        printing::progress progress{" > Generating features: ",
-                                    training.size()};
-        uint64_t idx = 0;
-        for (auto& seq : training)
+        if (*strategy == "lock-free")
+            params.strategy = sequence::crf::update_strategy::lock_free;
+        else if (*strategy != "minibatch")
         {
-            progress(++idx);
-            analyzer.analyze(seq);
+            LOG(fatal) << "[crf] update-strategy must be minibatch or "
+                          "lock-free" << ENDLG;
+            return 1;
         }
     }
-    analyzer.save(*crf_prefix);
+    if (auto batch_size = crf_grp->get_as<int64_t>("batch-size"))
+        params.batch_size = static_cast<uint64_t>(*batch_size);
 
     sequence::crf crf{*crf_prefix};
-    crf.train({}, training);
+    crf.train(params, training);
 
     return 0;
 }
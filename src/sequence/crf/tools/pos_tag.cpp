@@ -11,6 +11,7 @@
 #include "analyzers/tokenizers/icu_tokenizer.h"
 #include "classify/confusion_matrix.h"
 #include "cpptoml.h"
+#include "parallel/default_pool.h"
 
 using namespace meta;
 
@@ -25,6 +26,7 @@ int main(int argc, char* argv[])
     logging::set_cerr_logging();
 
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
     auto crf_group = config.get_table("crf");
     if (!crf_group)
     {
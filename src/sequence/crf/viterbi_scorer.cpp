@@ -3,6 +3,9 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+#include <limits>
+
 #include "sequence/crf/viterbi_scorer.h"
 
 namespace meta
@@ -11,47 +14,164 @@ namespace sequence
 {
 
 crf::viterbi_scorer::viterbi_scorer(const crf& model)
-    : model_{&model}
+    : viterbi_scorer{model, decoding_options{}}
+{
+    // nothing
+}
+
+crf::viterbi_scorer::viterbi_scorer(const crf& model,
+                                    const decoding_options& options)
+    : options_(options),
+      table_{0, model.num_labels()},
+      best_(model.num_labels()),
+      model_{&model}
 {
     // these only ever need computing once because the underlying model is
     // not changing
     scorer_.transition_scores(*model_);
+
+    auto num_labels = model_->num_labels();
+    if (options_.mask_transitions)
+    {
+        successor_offsets_.reserve(num_labels + 1);
+        successor_offsets_.push_back(0);
+        for (label_id lbl{0}; lbl < num_labels; ++lbl)
+        {
+            for (const auto& idx : model_->trans_range(lbl))
+                successors_.push_back(model_->transition(idx));
+            successor_offsets_.push_back(successors_.size());
+        }
+    }
+
+    if (options_.compact)
+    {
+        auto compact = std::make_shared<compact_weights>();
+        auto num_features = model_->observation_ranges_->size() - 1;
+        compact->offsets.reserve(num_features + 1);
+        compact->offsets.push_back(0);
+        for (feature_id fid{0}; fid < num_features; ++fid)
+        {
+            for (const auto& idx : model_->obs_range(fid))
+            {
+                compact->labels.push_back(model_->observation(idx));
+                compact->weights.push_back(static_cast<float>(
+                    model_->obs_weight(idx) * model_->scale_));
+            }
+            compact->offsets.push_back(compact->labels.size());
+        }
+        compact_ = std::move(compact);
+    }
+
+    beam_.reserve(num_labels);
+}
+
+void crf::viterbi_scorer::compact_state_scores(const sequence& seq)
+{
+    auto num_features = compact_->offsets.size() - 1;
+    state_.resize(seq.size(), model_->num_labels());
+    for (uint64_t t = 0; t < seq.size(); ++t)
+    {
+        auto row = &state_(t, 0);
+        for (const auto& pair : seq[t].features())
+        {
+            if (pair.first >= num_features)
+                continue;
+            auto end = compact_->offsets[pair.first + 1];
+            for (auto i = compact_->offsets[pair.first]; i < end; ++i)
+                row[compact_->labels[i]] += compact_->weights[i] * pair.second;
+        }
+    }
 }
 
-viterbi_trellis crf::viterbi_scorer::viterbi(const sequence& seq)
+const viterbi_trellis& crf::viterbi_scorer::viterbi(const sequence& seq)
 {
     // we only need the scores for the states as the transition scores, set
     // up during construction, will never change between sequences
-    scorer_.state_scores(*model_, seq);
+    if (compact_)
+        compact_state_scores(seq);
+    else
+        scorer_.state_scores(*model_, seq);
+    auto state_row = [&](uint64_t t)
+    {
+        return compact_ ? &state_(t, 0) : scorer_.state_row(t);
+    };
 
-    viterbi_trellis table{seq.size(), model_->num_labels()};
+    table_.resize(seq.size(), model_->num_labels());
 
     // initialize first column of trellis. We use the original state() and
     // trans() matrices because we are working in the log domain.
-    for (label_id lbl{0}; lbl < model_->num_labels(); ++lbl)
-        table.probability(0, lbl, scorer_.state(0, lbl));
+    auto num_labels = model_->num_labels();
+    std::copy_n(state_row(0), num_labels, table_.row(0));
+
+    auto beam = options_.beam_size > 0 && options_.beam_size < num_labels;
 
-    // compute remaining columns of trellis using recursive formulation
+    // compute remaining columns of trellis using recursive formulation.
+    // The max over the previous label is taken a row of trans() at a time,
+    // updating every label's best score at once, so that the inner loop
+    // runs over contiguous labels; ties keep the earliest previous label
     for (uint64_t t = 1; t < seq.size(); ++t)
     {
-        for (label_id lbl{0}; lbl < model_->num_labels(); ++lbl)
+        auto prev = table_.row(t - 1);
+        auto curr = table_.row(t);
+        std::fill_n(curr, num_labels, std::numeric_limits<double>::lowest());
+        std::fill(best_.begin(), best_.end(), label_id{0});
+
+        // the previous labels to extend: all of them, or the best few,
+        // in order of label so that ties are broken the same way
+        beam_.clear();
+        for (label_id in{0}; in < num_labels; ++in)
+            beam_.push_back(in);
+        if (beam)
         {
-            double max_score = std::numeric_limits<double>::lowest();
-            for (label_id in{0}; in < model_->num_labels(); ++in)
+            auto last = beam_.begin() + options_.beam_size;
+            std::nth_element(beam_.begin(), last - 1, beam_.end(),
+                             [&](label_id a, label_id b)
             {
-                auto score = table.probability(t - 1, in)
-                             + scorer_.trans(in, lbl);
+                return prev[a] > prev[b];
+            });
+            beam_.erase(last, beam_.end());
+            std::sort(beam_.begin(), beam_.end());
+        }
 
-                if (score > max_score)
+        for (const auto& in : beam_)
+        {
+            auto from = prev[in];
+            auto trans = scorer_.trans_row(in);
+            if (options_.mask_transitions)
+            {
+                auto end = successor_offsets_[in + 1];
+                for (auto i = successor_offsets_[in]; i < end; ++i)
                 {
-                    max_score = score;
-                    table.previous_tag(t, lbl, in);
+                    auto lbl = successors_[i];
+                    auto score = from + trans[lbl];
+                    if (score > curr[lbl])
+                    {
+                        curr[lbl] = score;
+                        best_[lbl] = in;
+                    }
                 }
+                continue;
             }
-            table.probability(t, lbl, max_score + scorer_.state(t, lbl));
+
+            for (uint64_t lbl = 0; lbl < num_labels; ++lbl)
+            {
+                auto score = from + trans[lbl];
+                if (score > curr[lbl])
+                {
+                    curr[lbl] = score;
+                    best_[lbl] = in;
+                }
+            }
+        }
+
+        auto state = state_row(t);
+        for (label_id lbl{0}; lbl < num_labels; ++lbl)
+        {
+            curr[lbl] += state[lbl];
+            table_.previous_tag(t, lbl, best_[lbl]);
         }
     }
-    return table;
+    return table_;
 }
 
 }
@@ -1,6 +1,8 @@
 #include <fstream>
+#include <future>
 
 #include "logging/logger.h"
+#include "parallel/default_pool.h"
 #include "sequence/io/ptb_parser.h"
 
 namespace meta
@@ -72,5 +74,38 @@ std::vector<sequence> extract_sequences(const std::string& filename)
     return results;
 }
 
+std::vector<sequence>
+    extract_sequences(const std::vector<std::string>& filenames,
+                      parallel::thread_pool& pool)
+{
+    std::vector<std::future<std::vector<sequence>>> futures;
+    futures.reserve(filenames.size());
+    for (const auto& filename : filenames)
+    {
+        futures.emplace_back(pool.submit_task([&filename]()
+                                              {
+            return extract_sequences(filename);
+        }));
+    }
+
+    // the files are joined in order as they finish, so the sequences of
+    // the first files are moved while the later ones are still parsed
+    std::vector<sequence> results;
+    for (auto& fut : futures)
+    {
+        auto sequences = fut.get();
+        results.insert(results.end(),
+                       std::make_move_iterator(sequences.begin()),
+                       std::make_move_iterator(sequences.end()));
+    }
+    return results;
+}
+
+std::vector<sequence>
+    extract_sequences(const std::vector<std::string>& filenames)
+{
+    return extract_sequences(filenames, parallel::default_pool());
+}
+
 }
 }
@@ -0,0 +1,138 @@
+/**
+ * @file sequence_cache.cpp
+ */
+
+#include <fstream>
+
+#include "io/binary.h"
+#include "sequence/io/sequence_cache.h"
+
+namespace meta
+{
+namespace sequence
+{
+
+namespace
+{
+/// Marks the start of a file of sequences
+const uint64_t magic = 0x5345515543414348; // "SEQUCACH"
+
+/// The observation has a tag
+const uint8_t has_tag = 1;
+
+/// The observation has a label
+const uint8_t has_label = 2;
+}
+
+void save_sequences(const std::vector<sequence>& sequences,
+                    const std::string& filename)
+{
+    std::ofstream out{filename, std::ios::binary};
+    io::write_binary(out, magic);
+    io::write_binary(out, static_cast<uint64_t>(sequences.size()));
+    for (const auto& seq : sequences)
+    {
+        io::write_binary(out, static_cast<uint64_t>(seq.size()));
+        for (const auto& obs : seq)
+        {
+            uint8_t flags = 0;
+            if (obs.tagged())
+                flags |= has_tag;
+
+            // an observation only has a label once it has been analyzed
+            label_id lbl{0};
+            try
+            {
+                lbl = obs.label();
+                flags |= has_label;
+            }
+            catch (const observation::exception&)
+            {
+                // no label
+            }
+
+            io::write_binary(out, flags);
+            io::write_binary(out, static_cast<std::string>(obs.symbol()));
+            if (flags & has_tag)
+                io::write_binary(out, static_cast<std::string>(obs.tag()));
+            if (flags & has_label)
+                io::write_binary(out, static_cast<uint32_t>(lbl));
+
+            const auto& feats = obs.features();
+            io::write_binary(out, static_cast<uint64_t>(feats.size()));
+            for (const auto& feat : feats)
+            {
+                io::write_binary(out, static_cast<uint64_t>(feat.first));
+                io::write_binary(out, feat.second);
+            }
+        }
+    }
+    if (!out)
+        throw sequence_cache_exception{"could not write sequences to "
+                                       + filename};
+}
+
+std::vector<sequence> load_sequences(const std::string& filename)
+{
+    std::ifstream in{filename, std::ios::binary};
+    if (!in)
+        throw sequence_cache_exception{"sequence cache not found: "
+                                       + filename};
+
+    uint64_t file_magic = 0;
+    uint64_t num_sequences = 0;
+    io::read_binary(in, file_magic);
+    io::read_binary(in, num_sequences);
+    if (!in || file_magic != magic)
+        throw sequence_cache_exception{"not a sequence cache: " + filename};
+
+    std::vector<sequence> sequences(num_sequences);
+    for (auto& seq : sequences)
+    {
+        uint64_t size = 0;
+        io::read_binary(in, size);
+        for (uint64_t t = 0; t < size && in; ++t)
+        {
+            uint8_t flags = 0;
+            std::string symbol;
+            io::read_binary(in, flags);
+            io::read_binary(in, symbol);
+            if (flags & has_tag)
+            {
+                std::string tag;
+                io::read_binary(in, tag);
+                seq.add_observation({symbol_t{symbol}, tag_t{tag}});
+            }
+            else
+            {
+                seq.add_symbol(symbol_t{symbol});
+            }
+
+            auto& obs = seq[seq.size() - 1];
+            if (flags & has_label)
+            {
+                uint32_t lbl = 0;
+                io::read_binary(in, lbl);
+                obs.label(label_id{lbl});
+            }
+
+            uint64_t num_feats = 0;
+            io::read_binary(in, num_feats);
+            observation::feature_vector feats(num_feats);
+            for (auto& feat : feats)
+            {
+                uint64_t id = 0;
+                io::read_binary(in, id);
+                io::read_binary(in, feat.second);
+                feat.first = feature_id{id};
+            }
+            obs.features(std::move(feats));
+        }
+        if (!in)
+            throw sequence_cache_exception{"truncated sequence cache: "
+                                           + filename};
+    }
+    return sequences;
+}
+}
+}
@@ -70,5 +70,12 @@ void observation::features(feature_vector feats)
 {
     features_ = std::move(feats);
 }
+
+auto observation::release_features() -> feature_vector
+{
+    auto feats = std::move(features_);
+    features_.clear();
+    return feats;
+}
 }
 }
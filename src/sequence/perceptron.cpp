@@ -3,11 +3,18 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+#include <atomic>
 #include <fstream>
+#include <mutex>
+#include <unordered_map>
 
+#include "parallel/default_pool.h"
 #include "sequence/perceptron.h"
 #include "utf/utf.h"
+#include "util/filesystem.h"
 #include "util/progress.h"
+#include "util/shim.h"
 #include "util/time.h"
 
 #if META_HAS_ZLIB
@@ -38,11 +45,18 @@ perceptron::perceptron() : analyzer_{default_pos_analyzer()}
                     prev2 = "<s>";
             }
 
-            coll.add("q[t-2]=" + prev2, 1);
-            coll.add("q[t-1]=" + prev, 1);
-            coll.add("q[t-2]q[t-1]=" + prev2 + "-" + prev, 1);
-            coll.add(
-                "q[t-1]w[t]=" + prev + "-" + utf::foldcase(seq[t].symbol()), 1);
+            coll.add(feature_hash{"q[t-2]="}.append(prev2), 1);
+            coll.add(feature_hash{"q[t-1]="}.append(prev), 1);
+            coll.add(feature_hash{"q[t-2]q[t-1]="}
+                         .append(prev2)
+                         .append('-')
+                         .append(prev),
+                     1);
+            coll.add(feature_hash{"q[t-1]w[t]="}
+                         .append(prev)
+                         .append('-')
+                         .append(utf::foldcase(seq[t].symbol())),
+                     1);
         });
 }
 
@@ -50,6 +64,14 @@ perceptron::perceptron(const std::string& prefix) : perceptron()
 {
     analyzer_.load(prefix);
 
+    if (filesystem::file_exists(prefix + "/tagger.model.frozen"))
+    {
+        frozen_ = make_unique<
+            classify::frozen_linear_model<feature_id, label_id>>(
+            prefix + "/tagger.model.frozen");
+        return;
+    }
+
 #if META_HAS_ZLIB
     io::gzifstream file{prefix + "/tagger.model.gz"};
 #else
@@ -63,19 +85,65 @@ void perceptron::tag(sequence& seq) const
     for (uint64_t t = 0; t < seq.size(); ++t)
     {
         analyzer_.analyze(seq, t);
-        seq[t].label(model_.best_class(seq[t].features()));
+        seq[t].label(frozen_ ? frozen_->best_class(seq[t].features())
+                             : model_.best_class(seq[t].features()));
         seq[t].tag(analyzer_.tag(seq[t].label()));
     }
 }
 
+void perceptron::tag(std::vector<sequence>& seqs,
+                     parallel::thread_pool& pool) const
+{
+    // the threads take batches of sequences from a shared counter; the
+    // batches are small since sentences vary a lot in length
+    const uint64_t batch_size = 16;
+    std::atomic<uint64_t> next{0};
+    std::vector<std::future<void>> futures;
+    for (uint64_t t = 0; t < pool.thread_ids().size(); ++t)
+    {
+        futures.emplace_back(pool.submit_task([&]()
+        {
+            while (true)
+            {
+                auto begin = next.fetch_add(batch_size);
+                if (begin >= seqs.size())
+                    break;
+                auto last = std::min<uint64_t>(begin + batch_size,
+                                               seqs.size());
+                for (auto i = begin; i < last; ++i)
+                    tag(seqs[i]);
+            }
+        }));
+    }
+    for (auto& fut : futures)
+        fut.get();
+}
+
+void perceptron::tag(std::vector<sequence>& seqs) const
+{
+    tag(seqs, parallel::default_pool());
+}
+
 void perceptron::train(std::vector<sequence>& sequences,
                        const training_options& options)
 {
+    if (options.num_threads > 1)
+    {
+        train_parallel(sequences, options);
+        return;
+    }
+
     std::default_random_engine rng{options.seed};
 
     std::vector<size_t> indices(sequences.size());
     std::iota(indices.begin(), indices.end(), 0);
 
+    if (frozen_)
+    {
+        frozen_->thaw(model_);
+        frozen_ = nullptr;
+    }
+
     classify::linear_model<feature_id, double, label_id> for_avg;
     uint64_t total_updates = 0;
     for (uint64_t epoch = 1; epoch <= options.max_iterations; ++epoch)
@@ -142,6 +210,238 @@ void perceptron::train(std::vector<sequence>& sequences,
     model_.update(for_avg.weights(), -1.0 / total_updates);
 }
 
+namespace
+{
+/// The weights of every label of one feature, in order of label
+using label_weights = std::vector<double>;
+
+/// Sparse weights of some features, each dense by label
+using sparse_weights = std::unordered_map<feature_id, label_weights>;
+
+/**
+ * What one shard learned in an epoch of iterative parameter mixing.
+ */
+struct shard_result
+{
+    /// The change to the weights of each feature the shard updated
+    sparse_weights delta;
+    /// Each change, scaled by the number of tokens the shard had seen
+    /// before making it, for averaging
+    sparse_weights timed;
+    /// The number of tokens the shard learned from
+    uint64_t steps = 0;
+    /// The number of those tokens that were already tagged correctly
+    uint64_t correct = 0;
+};
+
+/**
+ * @return the weights of a feature in a sparse set, which are created as
+ * zeros if the feature has none yet
+ */
+label_weights& weights_of(sparse_weights& weights, feature_id fid,
+                          uint64_t num_labels)
+{
+    auto& row = weights[fid];
+    if (row.empty())
+        row.resize(num_labels, 0.0);
+    return row;
+}
+}
+
+void perceptron::train_parallel(std::vector<sequence>& sequences,
+                                const training_options& options)
+{
+    if (frozen_)
+    {
+        frozen_->thaw(model_);
+        frozen_ = nullptr;
+    }
+
+    // the features of a token depend on the previous tokens' true tags
+    // only, so they are the same every epoch: extract them once, growing
+    // the feature dictionary that every shard then shares read-only
+    {
+        printing::progress progress{" > Analyzing: ", sequences.size()};
+        for (uint64_t i = 0; i < sequences.size(); ++i)
+        {
+            progress(i);
+            analyzer_.analyze(sequences[i]);
+        }
+    }
+
+    auto num_features = analyzer_.num_features();
+    auto num_labels = analyzer_.num_labels();
+
+    // the mixed weights, dense by label: a row of labels per feature,
+    // starting from whatever the model already had
+    std::vector<double> weights(num_features * num_labels, 0.0);
+    for (const auto& feat : model_.weights())
+    {
+        if (feat.first >= num_features)
+            continue;
+        for (const auto& weight : feat.second)
+        {
+            if (weight.first < num_labels)
+                weights[feat.first * num_labels + weight.first]
+                    = weight.second;
+        }
+    }
+
+    // the sum of the weights after every token of every epoch, for the
+    // averaged perceptron
+    std::vector<double> sum(weights.size(), 0.0);
+    uint64_t total_steps = 0;
+
+    std::default_random_engine rng{options.seed};
+    std::vector<size_t> indices(sequences.size());
+    std::iota(indices.begin(), indices.end(), 0);
+
+    auto num_shards = std::max<uint64_t>(
+        1, std::min<uint64_t>(options.num_threads, sequences.size()));
+    parallel::thread_pool pool{num_shards};
+    std::vector<shard_result> results(num_shards);
+
+    for (uint64_t epoch = 1; epoch <= options.max_iterations; ++epoch)
+    {
+        std::shuffle(indices.begin(), indices.end(), rng);
+
+        auto time = common::time([&]()
+        {
+            printing::progress progress{
+                " > Iteration " + std::to_string(epoch) + ": ",
+                sequences.size()};
+            std::mutex progress_mutex;
+            uint64_t done = 0;
+
+            std::vector<std::future<void>> futures;
+            for (uint64_t s = 0; s < num_shards; ++s)
+            {
+                futures.emplace_back(pool.submit_task([&, s]()
+                {
+                    auto& result = results[s];
+                    result = shard_result{};
+                    std::vector<double> scores(num_labels);
+
+                    auto begin = indices.size() * s / num_shards;
+                    auto end = indices.size() * (s + 1) / num_shards;
+                    for (auto i = begin; i < end; ++i)
+                    {
+                        const auto& seq = sequences[indices[i]];
+                        for (const auto& obs : seq)
+                        {
+                            // score with the mixed weights plus this
+                            // shard's changes to them
+                            std::fill(scores.begin(), scores.end(), 0.0);
+                            for (const auto& feat : obs.features())
+                            {
+                                auto row = &weights[feat.first * num_labels];
+                                for (uint64_t l = 0; l < num_labels; ++l)
+                                    scores[l] += feat.second * row[l];
+
+                                auto it = result.delta.find(feat.first);
+                                if (it == result.delta.end())
+                                    continue;
+                                for (uint64_t l = 0; l < num_labels; ++l)
+                                    scores[l] += feat.second * it->second[l];
+                            }
+                            auto lbl = static_cast<uint64_t>(
+                                std::max_element(scores.begin(), scores.end())
+                                - scores.begin());
+                            uint64_t correct = obs.label();
+
+                            ++result.steps;
+                            if (lbl == correct)
+                            {
+                                ++result.correct;
+                                continue;
+                            }
+
+                            auto before = static_cast<double>(result.steps - 1);
+                            for (const auto& feat : obs.features())
+                            {
+                                auto& delta = weights_of(
+                                    result.delta, feat.first, num_labels);
+                                delta[lbl] -= feat.second;
+                                delta[correct] += feat.second;
+
+                                auto& timed = weights_of(
+                                    result.timed, feat.first, num_labels);
+                                timed[lbl] -= before * feat.second;
+                                timed[correct] += before * feat.second;
+                            }
+                        }
+
+                        std::lock_guard<std::mutex> lock{progress_mutex};
+                        progress(++done);
+                    }
+                }));
+            }
+            for (auto& fut : futures)
+                fut.get();
+        });
+
+        // a shard that learned from n tokens, starting from weights w and
+        // changing them by d, had weights summing to n * (w + d) minus its
+        // timed changes over those tokens
+        uint64_t steps = 0;
+        uint64_t correct = 0;
+        for (const auto& result : results)
+        {
+            steps += result.steps;
+            correct += result.correct;
+        }
+        for (uint64_t i = 0; i < weights.size(); ++i)
+            sum[i] += steps * weights[i];
+        for (const auto& result : results)
+        {
+            for (const auto& feat : result.delta)
+            {
+                auto row = &sum[feat.first * num_labels];
+                for (uint64_t l = 0; l < num_labels; ++l)
+                    row[l] += result.steps * feat.second[l];
+            }
+            for (const auto& feat : result.timed)
+            {
+                auto row = &sum[feat.first * num_labels];
+                for (uint64_t l = 0; l < num_labels; ++l)
+                    row[l] -= feat.second[l];
+            }
+        }
+        total_steps += steps;
+
+        // mix: the new weights are the average of the shards' weights
+        for (const auto& result : results)
+        {
+            for (const auto& feat : result.delta)
+            {
+                auto row = &weights[feat.first * num_labels];
+                for (uint64_t l = 0; l < num_labels; ++l)
+                    row[l] += feat.second[l] / num_shards;
+            }
+        }
+
+        LOG(info) << "Took " << time.count() / 1000.0 << "s" << ENDLG;
+        LOG(info) << "Training accuracy: "
+                  << static_cast<double>(correct) / steps * 100 << "%"
+                  << ENDLG;
+    }
+
+    if (total_steps == 0)
+        return;
+
+    // the weights are the average over all tokens of all epochs
+    model_ = classify::linear_model<feature_id, double, label_id>{};
+    for (uint64_t f = 0; f < num_features; ++f)
+    {
+        for (uint64_t l = 0; l < num_labels; ++l)
+        {
+            auto avg = sum[f * num_labels + l] / total_steps;
+            if (avg != 0)
+                model_.update(label_id(l), feature_id(f), avg);
+        }
+    }
+}
+
 void perceptron::save(const std::string& prefix) const
 {
     analyzer_.save(prefix);
@@ -151,7 +451,16 @@ void perceptron::save(const std::string& prefix) const
 #else
     std::ofstream file{prefix + "/tagger.model"};
 #endif
-    model_.save(file);
+
+    // the weights of a tagger loaded from a frozen model are all in it
+    classify::linear_model<feature_id, double, label_id> thawed;
+    if (frozen_)
+        frozen_->thaw(thawed);
+    const auto& model = frozen_ ? thawed : model_;
+
+    model.save(file);
+    classify::frozen_linear_model<feature_id, label_id>::save(
+        model, prefix + "/tagger.model.frozen");
 }
 }
 }
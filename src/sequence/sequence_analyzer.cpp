@@ -5,11 +5,14 @@
 
 #include <algorithm>
 #include <fstream>
+#include <future>
 #include <sstream>
+#include <unordered_set>
 #include "io/binary.h"
 #if META_HAS_ZLIB
 #include "io/gzstream.h"
 #endif
+#include "parallel/default_pool.h"
 #include "sequence/sequence_analyzer.h"
 #include "utf/utf.h"
 #include "util/filesystem.h"
@@ -36,6 +39,39 @@ void sequence_analyzer::load(const std::string& prefix)
 
 void sequence_analyzer::load_feature_id_mapping(const std::string& prefix)
 {
+#if META_HAS_ZLIB
+    io::gzifstream input{prefix + "/feature.hashes.gz"};
+#else
+    std::ifstream input{prefix + "/feature.hashes", std::ios::binary};
+#endif
+
+    if (!input)
+    {
+        load_legacy_feature_id_mapping(prefix);
+        return;
+    }
+
+    uint64_t num_keys;
+    io::read_binary(input, num_keys);
+    printing::progress progress{" > Loading feature mapping: ", num_keys};
+    feature_id_mapping_.reserve(num_keys);
+    for (uint64_t i = 0; i < num_keys; ++i)
+    {
+        progress(i + 1);
+        uint64_t key;
+        feature_id value;
+        io::read_binary(input, key);
+        io::read_binary(input, value);
+        feature_id_mapping_[key] = value;
+    }
+
+    if (!input)
+        throw exception{"truncated feature id mapping"};
+}
+
+void sequence_analyzer::load_legacy_feature_id_mapping(
+    const std::string& prefix)
+{
 #if META_HAS_ZLIB
     io::gzifstream input{prefix + "/feature.mapping.gz"};
 #else
@@ -56,7 +92,7 @@ void sequence_analyzer::load_feature_id_mapping(const std::string& prefix)
         feature_id value;
         io::read_binary(input, key);
         io::read_binary(input, value);
-        feature_id_mapping_[key] = value;
+        feature_id_mapping_[feature_hash{key}.value()] = value;
     }
 }
 
@@ -74,9 +110,9 @@ void sequence_analyzer::save(const std::string& prefix) const
                                 feature_id_mapping_.size()};
 
 #if META_HAS_ZLIB
-    io::gzofstream output{prefix + "/feature.mapping.gz"};
+    io::gzofstream output{prefix + "/feature.hashes.gz"};
 #else
-    std::ofstream output{prefix + "/feature.mapping", std::ios::binary};
+    std::ofstream output{prefix + "/feature.hashes", std::ios::binary};
 #endif
     uint64_t sze = feature_id_mapping_.size();
     io::write_binary(output, sze);
@@ -109,6 +145,163 @@ void sequence_analyzer::analyze(sequence& sequence, uint64_t t)
     sequence[t].label(label_id_mapping_.get_value(sequence[t].tag()));
 }
 
+namespace
+{
+/**
+ * Collects the features of an observation by their hashes rather than
+ * their feature ids, noting the hashes not seen before in the order they
+ * are added.
+ */
+class hash_collector : public sequence_analyzer::collector
+{
+  public:
+    /**
+     * @param obs The observation to be analyzed
+     * @param seen The hashes seen so far
+     * @param first Where to append the hashes not seen before
+     */
+    hash_collector(observation* obs, std::unordered_set<uint64_t>& seen,
+                   std::vector<uint64_t>& first)
+        : collector{obs}, seen_(seen), first_(first)
+    {
+        // nothing
+    }
+
+    using collector::add;
+
+    void add(const feature_hash& feat, double amount) override
+    {
+        if (seen_.insert(feat.value()).second)
+            first_.push_back(feat.value());
+        feats_.emplace_back(feature(feat), amount);
+    }
+
+  protected:
+    feature_id feature(const feature_hash& feat) override
+    {
+        return feature_id{feat.value()};
+    }
+
+  private:
+    /// The hashes seen so far
+    std::unordered_set<uint64_t>& seen_;
+    /// The hashes not seen before, in order
+    std::vector<uint64_t>& first_;
+};
+}
+
+void sequence_analyzer::analyze(std::vector<sequence>& sequences,
+                                parallel::thread_pool& pool)
+{
+    // the sequences are split into contiguous chunks, several for each
+    // thread since sentences vary a lot in length
+    auto num_chunks = std::min<uint64_t>(sequences.size(),
+                                         pool.thread_ids().size() * 4);
+    if (num_chunks == 0)
+        return;
+    auto chunk_size = (sequences.size() + num_chunks - 1) / num_chunks;
+
+    struct chunk
+    {
+        uint64_t begin;
+        uint64_t end;
+        std::vector<uint64_t> features;
+        std::vector<tag_t> tags;
+    };
+    std::vector<chunk> chunks;
+    for (uint64_t begin = 0; begin < sequences.size(); begin += chunk_size)
+        chunks.push_back(
+            {begin, std::min<uint64_t>(begin + chunk_size, sequences.size()),
+             {},
+             {}});
+
+    auto for_each_chunk = [&](std::function<void(chunk&)> fn)
+    {
+        std::vector<std::future<void>> futures;
+        for (auto& c : chunks)
+            futures.emplace_back(pool.submit_task([&fn, &c]()
+                                                  {
+                fn(c);
+            }));
+        // every chunk is finished before any error is thrown
+        for (auto& fut : futures)
+            fut.wait();
+        for (auto& fut : futures)
+            fut.get();
+    };
+
+    // the features are hashed, and the new features and tags of each
+    // chunk noted in the order analyze() would meet them
+    for_each_chunk([&](chunk& c)
+                   {
+        std::unordered_set<uint64_t> seen;
+        std::unordered_set<tag_t> seen_tags;
+        for (auto i = c.begin; i < c.end; ++i)
+        {
+            auto& seq = sequences[i];
+            for (uint64_t t = 0; t < seq.size(); ++t)
+            {
+                {
+                    hash_collector coll{&seq[t], seen, c.features};
+                    for (const auto& fn : obs_fns_)
+                        fn(seq, t, coll);
+                }
+                if (seen_tags.insert(seq[t].tag()).second)
+                    c.tags.push_back(seq[t].tag());
+            }
+        }
+    });
+
+    // the ids are given out in order of the chunks, as they would be one
+    // sequence at a time
+    for (const auto& c : chunks)
+    {
+        for (const auto& hash : c.features)
+        {
+            if (feature_id_mapping_.find(hash) == feature_id_mapping_.end())
+            {
+                auto sze = feature_id_mapping_.size();
+                feature_id_mapping_[hash] = feature_id{sze};
+            }
+        }
+        for (const auto& tag : c.tags)
+        {
+            if (!label_id_mapping_.contains_key(tag))
+            {
+                label_id id(label_id_mapping_.size());
+                label_id_mapping_.insert(tag, id);
+            }
+        }
+    }
+
+    // the mappings are only read from now on
+    for_each_chunk([&](chunk& c)
+                   {
+        using pair = std::pair<feature_id, double>;
+        for (auto i = c.begin; i < c.end; ++i)
+        {
+            for (auto& obs : sequences[i])
+            {
+                auto feats = obs.release_features();
+                for (auto& feat : feats)
+                    feat.first = feature_id_mapping_.find(feat.first)->second;
+                std::sort(feats.begin(), feats.end(),
+                          [](const pair& lhs, const pair& rhs)
+                          {
+                    return lhs.first < rhs.first;
+                });
+                obs.features(std::move(feats));
+                obs.label(label_id_mapping_.get_value(obs.tag()));
+            }
+        }
+    });
+}
+
+void sequence_analyzer::analyze(std::vector<sequence>& sequences)
+{
+    analyze(sequences, parallel::default_pool());
+}
+
 void sequence_analyzer::analyze(sequence& sequence) const
 {
     for (uint64_t t = 0; t < sequence.size(); ++t)
@@ -130,17 +323,27 @@ void sequence_analyzer::analyze(sequence& sequence, uint64_t t) const
 
 feature_id sequence_analyzer::feature(const std::string& feature)
 {
-    auto it = feature_id_mapping_.find(feature);
+    return this->feature(feature_hash{feature});
+}
+
+feature_id sequence_analyzer::feature(const std::string& feature) const
+{
+    return this->feature(feature_hash{feature});
+}
+
+feature_id sequence_analyzer::feature(const feature_hash& feature)
+{
+    auto it = feature_id_mapping_.find(feature.value());
     if (it != feature_id_mapping_.end())
         return it->second;
     auto sze = feature_id_mapping_.size();
-    feature_id_mapping_[feature] = sze;
+    feature_id_mapping_[feature.value()] = sze;
     return feature_id{sze};
 }
 
-feature_id sequence_analyzer::feature(const std::string& feature) const
+feature_id sequence_analyzer::feature(const feature_hash& feature) const
 {
-    auto it = feature_id_mapping_.find(feature);
+    auto it = feature_id_mapping_.find(feature.value());
     if (it != feature_id_mapping_.end())
         return it->second;
     return feature_id{feature_id_mapping_.size()};
@@ -173,18 +376,26 @@ uint64_t sequence_analyzer::num_labels() const
 
 namespace
 {
-std::string suffix(const std::string& input, uint64_t length)
+/**
+ * Appends the last characters of a word to a feature, or the whole word
+ * if it is shorter.
+ */
+feature_hash& suffix(feature_hash& hash, const std::string& input,
+                     uint64_t length)
 {
     if (length > input.size())
-        return input;
-    return input.substr(input.size() - length);
+        return hash.append(input);
+    return hash.append(input.data() + input.size() - length, length);
 }
 
-std::string prefix(const std::string& input, uint64_t length)
+/**
+ * Appends the first characters of a word to a feature, or the whole word
+ * if it is shorter.
+ */
+feature_hash& prefix(feature_hash& hash, const std::string& input,
+                     uint64_t length)
 {
-    if (length > input.size())
-        return {input.begin(), input.end()};
-    return {input.begin(), input.begin() + length};
+    return hash.append(input.data(), std::min<uint64_t>(length, input.size()));
 }
 }
 
@@ -198,11 +409,15 @@ sequence_analyzer default_pos_analyzer()
         auto norm = utf::foldcase(word);
         for (int i = 1; i <= 4; i++)
         {
-            auto len = std::to_string(i);
-            coll.add("w[t]_suffix_" + len + "=" + suffix(norm, i), 1);
-            coll.add("w[t]_prefix_" + len + "=" + prefix(norm, i), 1);
+            auto len = static_cast<char>('0' + i);
+            feature_hash suf{"w[t]_suffix_"};
+            suf.append(len).append('=');
+            coll.add(suffix(suf, norm, i), 1);
+            feature_hash pre{"w[t]_prefix_"};
+            pre.append(len).append('=');
+            coll.add(prefix(pre, norm, i), 1);
         }
-        coll.add("w[t]=" + norm, 1);
+        coll.add(feature_hash{"w[t]="}.append(norm), 1);
 
         // additional binary word features
         if (std::any_of(word.begin(), word.end(), [](char c)
@@ -210,21 +425,23 @@ sequence_analyzer default_pos_analyzer()
                 return std::isdigit(c);
             }))
         {
-            coll.add("w[t]_has_digit=1", 1);
+            coll.add(feature_hash{"w[t]_has_digit=1"}, 1);
         }
 
         if (std::find(word.begin(), word.end(), '-') != word.end())
-            coll.add("w[t]_has_hyphen=1", 1);
+            coll.add(feature_hash{"w[t]_has_hyphen=1"}, 1);
 
         if (std::any_of(word.begin(), word.end(), [](char c)
                         {
                 return std::isupper(c);
             }))
         {
-            coll.add("w[t]_has_upper=1", 1);
+            coll.add(feature_hash{"w[t]_has_upper=1"}, 1);
             if (t != 0)
             {
-                coll.add("w[t]_has_upper_and_not_sentence_start=1", 1);
+                coll.add(
+                    feature_hash{"w[t]_has_upper_and_not_sentence_start=1"},
+                    1);
             }
         }
 
@@ -233,7 +450,7 @@ sequence_analyzer default_pos_analyzer()
                 return std::isupper(c);
             }))
         {
-            coll.add("w[t]_all_upper=1", 1);
+            coll.add(feature_hash{"w[t]_all_upper=1"}, 1);
         }
     };
 
@@ -241,33 +458,33 @@ sequence_analyzer default_pos_analyzer()
     analyzer.add_observation_function(
         [=](const sequence& seq, uint64_t t, sequence_analyzer::collector& coll)
         {
-            std::string word = seq[t].symbol();
-            word_feats(word, t, coll);
+            word_feats(seq[t].symbol(), t, coll);
         });
 
     // previous word features
     analyzer.add_observation_function(
         [](const sequence& seq, uint64_t t, sequence_analyzer::collector& coll)
         {
-            std::string word = seq[t].symbol();
             if (t > 0)
             {
-                auto prevword = seq[t - 1].symbol();
-                coll.add("w[t-1]=" + utf::foldcase(prevword), 1);
+                coll.add(feature_hash{"w[t-1]="}.append(
+                             utf::foldcase(seq[t - 1].symbol())),
+                         1);
                 if (t > 1)
                 {
-                    auto prev2word = seq[t - 2].symbol();
-                    coll.add("w[t-2]=" + utf::foldcase(prev2word), 1);
+                    coll.add(feature_hash{"w[t-2]="}.append(
+                                 utf::foldcase(seq[t - 2].symbol())),
+                             1);
                 }
                 else
                 {
-                    coll.add("w[t-2]=<s>", 1);
+                    coll.add(feature_hash{"w[t-2]=<s>"}, 1);
                 }
             }
             else
             {
-                coll.add("w[t-1]=<s>", 1);
-                coll.add("w[t-2]=<s1>", 1);
+                coll.add(feature_hash{"w[t-1]=<s>"}, 1);
+                coll.add(feature_hash{"w[t-2]=<s1>"}, 1);
             }
         });
 
@@ -277,22 +494,24 @@ sequence_analyzer default_pos_analyzer()
         {
             if (t + 1 < seq.size())
             {
-                auto nextword = seq[t + 1].symbol();
-                coll.add("w[t+1]=" + utf::foldcase(nextword), 1);
+                coll.add(feature_hash{"w[t+1]="}.append(
+                             utf::foldcase(seq[t + 1].symbol())),
+                         1);
                 if (t + 2 < seq.size())
                 {
-                    auto next2word = seq[t + 2].symbol();
-                    coll.add("w[t+2]=" + utf::foldcase(next2word), 1);
+                    coll.add(feature_hash{"w[t+2]="}.append(
+                                 utf::foldcase(seq[t + 2].symbol())),
+                             1);
                 }
                 else
                 {
-                    coll.add("w[t+2]=</s>", 1);
+                    coll.add(feature_hash{"w[t+2]=</s>"}, 1);
                 }
             }
             else
             {
-                coll.add("w[t+1]=</s>", 1);
-                coll.add("w[t+2]=</s1>", 1);
+                coll.add(feature_hash{"w[t+1]=</s>"}, 1);
+                coll.add(feature_hash{"w[t+2]=</s1>"}, 1);
             }
         });
 
@@ -300,7 +519,7 @@ sequence_analyzer default_pos_analyzer()
     analyzer.add_observation_function(
         [](const sequence&, uint64_t, sequence_analyzer::collector& coll)
         {
-            coll.add("bias", 1);
+            coll.add(feature_hash{"bias"}, 1);
         });
 
     return analyzer;
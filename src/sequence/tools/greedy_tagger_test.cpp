@@ -12,6 +12,7 @@
 #include "sequence/io/ptb_parser.h"
 #include "util/filesystem.h"
 #include "util/progress.h"
+#include "parallel/default_pool.h"
 
 using namespace meta;
 
@@ -33,6 +34,7 @@ int main(int argc, char** argv)
     logging::set_cerr_logging();
 
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
 
     auto prefix = config.get_as<std::string>("prefix");
     if (!prefix)
@@ -88,27 +90,26 @@ int main(int argc, char** argv)
     std::string path = *prefix + "/" + *treebank + "/treebank-2/tagged/"
                        + *corpus;
 
-    std::vector<sequence::sequence> testing;
+    std::vector<std::string> filenames;
     {
         auto begin = test_sections->at(0)->as<int64_t>()->get();
         auto end = test_sections->at(1)->as<int64_t>()->get();
-        printing::progress progress(" > Reading testing data: ",
-                                    (end - begin + 1) * *section_size);
         for (uint8_t i = begin; i <= end; ++i)
         {
             auto folder = two_digit(i);
             for (uint8_t j = 0; j <= *section_size; ++j)
             {
-                progress((i - begin) * 99 + j);
                 auto file = *corpus + "_" + folder + two_digit(j) + ".pos";
-                auto filename = path + "/" + folder + "/" + file;
-                auto sequences = sequence::extract_sequences(filename);
-                for (auto& seq : sequences)
-                    testing.emplace_back(std::move(seq));
+                filenames.push_back(path + "/" + folder + "/" + file);
             }
         }
     }
 
+    // each file is parsed by a thread of the default pool
+    LOG(info) << "Reading testing data from " << filenames.size()
+              << " files..." << ENDLG;
+    auto testing = sequence::extract_sequences(filenames);
+
     sequence::perceptron tagger{*seq_prefix};
 
     // run the tagger on every sequence, measuring statistics for
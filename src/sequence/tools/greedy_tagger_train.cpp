@@ -4,13 +4,14 @@
  */
 
 #include <iostream>
+#include <thread>
 
 #include "cpptoml.h"
 #include "logging/logger.h"
 #include "sequence/perceptron.h"
 #include "sequence/io/ptb_parser.h"
 #include "util/filesystem.h"
-#include "util/progress.h"
+#include "parallel/default_pool.h"
 
 using namespace meta;
 
@@ -32,6 +33,7 @@ int main(int argc, char** argv)
     logging::set_cerr_logging();
 
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
 
     auto prefix = config.get_as<std::string>("prefix");
     if (!prefix)
@@ -87,31 +89,35 @@ int main(int argc, char** argv)
     std::string path = *prefix + "/" + *treebank + "/treebank-2/tagged/"
                        + *corpus;
 
-    std::vector<sequence::sequence> training;
+    std::vector<std::string> filenames;
     {
         auto begin = train_sections->at(0)->as<int64_t>()->get();
         auto end = train_sections->at(1)->as<int64_t>()->get();
-        printing::progress progress(" > Reading training data: ",
-                                    (end - begin + 1) * *section_size);
         for (uint8_t i = begin; i <= end; ++i)
         {
             auto folder = two_digit(i);
             for (uint8_t j = 0; j <= *section_size; ++j)
             {
-                progress((i - begin) * 99 + j);
                 auto file = *corpus + "_" + folder + two_digit(j) + ".pos";
-                auto filename = path + "/" + folder + "/" + file;
-                auto sequences = sequence::extract_sequences(filename);
-                for (auto& seq : sequences)
-                    training.emplace_back(std::move(seq));
+                filenames.push_back(path + "/" + folder + "/" + file);
             }
         }
     }
 
+    // each file is parsed by a thread of the default pool
+    LOG(info) << "Reading training data from " << filenames.size()
+              << " files..." << ENDLG;
+    auto training = sequence::extract_sequences(filenames);
+
     filesystem::make_directory(*seq_prefix);
 
+    sequence::perceptron::training_options options;
+    auto threads = seq_grp->get_as<int64_t>("train-threads");
+    options.num_threads = threads ? static_cast<uint64_t>(*threads)
+                                  : std::thread::hardware_concurrency();
+
     sequence::perceptron tagger;
-    tagger.train(training, {});
+    tagger.train(training, options);
     tagger.save(*seq_prefix);
 
     return 0;
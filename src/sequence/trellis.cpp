@@ -3,9 +3,8 @@
  * @author Chase Geigle
  */
 
-#include <numeric>
-#include <algorithm>
 #include "sequence/trellis.h"
+#include "util/dense_ops.h"
 
 namespace meta
 {
@@ -18,6 +17,11 @@ trellis::trellis(uint64_t size, uint64_t labels)
     // nothing
 }
 
+void trellis::resize(uint64_t size, uint64_t labels)
+{
+    trellis_.resize(size, labels);
+}
+
 uint64_t trellis::size() const
 {
     return trellis_.rows();
@@ -33,12 +37,28 @@ double trellis::probability(uint64_t idx, const label_id& tag) const
     return trellis_(idx, tag);
 }
 
+double* trellis::row(uint64_t idx)
+{
+    return trellis_.row(idx);
+}
+
+const double* trellis::row(uint64_t idx) const
+{
+    return trellis_.row(idx);
+}
+
 viterbi_trellis::viterbi_trellis(uint64_t size, uint64_t labels)
     : trellis{size, labels}, paths_{size, labels}
 {
     // nothing
 }
 
+void viterbi_trellis::resize(uint64_t size, uint64_t labels)
+{
+    trellis::resize(size, labels);
+    paths_.resize(size, labels);
+}
+
 void viterbi_trellis::previous_tag(uint64_t idx, const label_id& current,
                                    const label_id& previous)
 {
@@ -64,14 +84,8 @@ double forward_trellis::normalizer(uint64_t idx) const
 
 void forward_trellis::normalize(uint64_t idx)
 {
-    auto beg = trellis_.begin(idx);
-    auto end = trellis_.end(idx);
-    auto sum = std::accumulate(beg, end, 0.0);
-    auto normalizer = sum != 0 ? 1.0 / sum : 1;
-
-    std::transform(beg, end, beg, [&](double val) { return val * normalizer; });
-
-    normalizers_[idx] = normalizer;
+    normalizers_[idx]
+        = util::dense::normalize(trellis_.row(idx), trellis_.columns());
 }
 }
 }
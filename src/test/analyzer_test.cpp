@@ -3,10 +3,16 @@
  * @author Sean Massung
  */
 
+#include <fstream>
+#include <iterator>
+#include <random>
+
 #include "test/analyzer_test.h"
 #include "test/inverted_index_test.h"
 #include "analyzers/token_stream.h"
+#include "analyzers/tokenizers/icu_tokenizer.h"
 #include "corpus/document.h"
+#include "utf/utf.h"
 #include "util/shim.h"
 
 namespace meta
@@ -98,14 +104,278 @@ int file_tokenize()
         check_analyzer_expected(tok, doc, 159, 166);
     });
 
+    num_failed += testing::run_test("file-multi-ngram-word-analyzer", [&]()
+    {
+        // several orders at once count what each order counts on its own
+        analyzers::ngram_word_analyzer multi{{3, 1, 2, 1}, make_filter()};
+        ASSERT_EQUAL(multi.n_value(), 3);
+        corpus::document all = doc;
+        multi.tokenize(all);
+
+        uint64_t num_unique = 0;
+        uint64_t length = 0;
+        for (uint16_t n = 1; n <= 3; ++n)
+        {
+            analyzers::ngram_word_analyzer tok{n, make_filter()};
+            corpus::document one = doc;
+            tok.tokenize(one);
+            num_unique += one.counts().size();
+            length += one.length();
+            for (const auto& count : one.counts())
+                ASSERT_EQUAL(all.count(count.first), count.second);
+        }
+        ASSERT_EQUAL(all.counts().size(), num_unique);
+        ASSERT_EQUAL(all.length(), length);
+    });
+
     return num_failed;
 }
 
+int feature_tokenize()
+{
+    return testing::run_test("feature-vocabulary", [&]()
+    {
+        corpus::feature_vocabulary vocab;
+        uint64_t num_terms = 0;
+        for (uint16_t n = 1; n <= 3; ++n)
+        {
+            analyzers::ngram_word_analyzer tok{n, make_filter()};
+            corpus::document by_text{"../data/sample-document.txt"};
+            tok.tokenize(by_text);
+            num_terms += by_text.counts().size();
+
+            // the same document twice gives the same features, and the
+            // vocabulary holds each term once
+            for (int i = 0; i < 2; ++i)
+            {
+                corpus::document doc{"../data/sample-document.txt"};
+                doc.vocabulary(&vocab);
+                tok.tokenize(doc);
+                ASSERT(doc.counts().empty());
+                ASSERT_EQUAL(doc.length(), by_text.length());
+                ASSERT_EQUAL(doc.unique_terms(), by_text.counts().size());
+
+                const auto& features = doc.features();
+                for (auto it = features.begin(); it != features.end(); ++it)
+                {
+                    if (it != features.begin())
+                        ASSERT((it - 1)->first < it->first);
+                    const auto& term = vocab.term(it->first);
+                    ASSERT_EQUAL(vocab.intern(term), it->first);
+                    ASSERT_EQUAL(it->second, by_text.count(term));
+                }
+            }
+        }
+        ASSERT_EQUAL(vocab.size(), num_terms);
+        ASSERT(vocab.id_bound() >= vocab.size());
+        auto ids = vocab.ids_by_term();
+        ASSERT_EQUAL(ids.size(), num_terms);
+        for (uint64_t i = 1; i < ids.size(); ++i)
+            ASSERT(vocab.term(ids[i - 1]) < vocab.term(ids[i]));
+
+        bool threw = false;
+        try
+        {
+            corpus::feature_vocabulary empty;
+            empty.term(47);
+        }
+        catch (corpus::feature_vocabulary::feature_vocabulary_exception&)
+        {
+            threw = true;
+        }
+        ASSERT(threw);
+    });
+}
+
+int parallel_tokenize()
+{
+    return testing::run_test("analyzer-tokenize-all", [&]()
+    {
+        std::vector<std::string> words
+            = {"one", "two",   "three", "four", "five",  "six",
+               "the", "quick", "brown", "fox",  "jumps", "connected"};
+        std::vector<corpus::document> docs;
+        for (uint64_t i = 0; i < 250; ++i)
+        {
+            corpus::document doc{"/home/person/filename.txt", doc_id{i}};
+            std::string content;
+            for (uint64_t j = 0; j <= i % 40; ++j)
+                content += words[(i * 7 + j * j) % words.size()] + ". ";
+            doc.content(content);
+            docs.push_back(doc);
+        }
+
+        analyzers::ngram_word_analyzer tok{2, make_filter()};
+        auto expected = docs;
+        for (auto& doc : expected)
+            tok.tokenize(doc);
+
+        parallel::thread_pool pool{3};
+        tok.tokenize_all(docs.begin(), docs.end(), pool);
+        ASSERT_EQUAL(docs.size(), expected.size());
+        for (uint64_t i = 0; i < docs.size(); ++i)
+        {
+            ASSERT_EQUAL(docs[i].id(), expected[i].id());
+            ASSERT_EQUAL(docs[i].length(), expected[i].length());
+            ASSERT(docs[i].counts() == expected[i].counts());
+        }
+
+        // a document that cannot be read fails the whole batch, once
+        // every thread is done
+        docs[100] = corpus::document{"../data/no-such-file.txt", doc_id{100}};
+        bool threw = false;
+        try
+        {
+            tok.tokenize_all(docs.begin(), docs.end(), pool);
+        }
+        catch (std::exception&)
+        {
+            threw = true;
+        }
+        ASSERT(threw);
+    });
+}
+
+int utf8_content()
+{
+    return testing::run_test("analyzer-utf8-content", [&]()
+    {
+        std::vector<std::string> valid
+            = {"", "plain ASCII text that is longer than a word",
+               "na\xc3\xafve caf\xc3\xa9", "\xe2\x82\xac and \xf0\x9f\x98\x80",
+               "\xed\x9f\xbf\xee\x80\x80\xf4\x8f\xbf\xbf"};
+        std::vector<std::string> invalid
+            = {"\xc0\x80", "\xc1\xbf", "\xe0\x9f\xbf", "\xed\xa0\x80",
+               "\xf0\x8f\xbf\xbf", "\xf4\x90\x80\x80", "\xf5\x80\x80\x80",
+               "ends early \xe2\x82", "\x80 stray", "\xc3("};
+        for (const auto& str : valid)
+        {
+            ASSERT(utf::is_valid_utf8(str));
+            ASSERT_EQUAL(utf::to_utf8(str, "utf-8"), str);
+        }
+        for (const auto& str : invalid)
+            ASSERT(!utf::is_valid_utf8(str));
+
+        // random bytes are valid exactly when ICU leaves them as they are
+        const std::string bytes = "aZ \x80\x8f\x90\x9f\xa0\xbf\xc0\xc2\xdf"
+                                  "\xe0\xed\xef\xf0\xf4\xf5\xff";
+        std::mt19937 rng{47};
+        for (int i = 0; i < 2000; ++i)
+        {
+            std::string str(rng() % 12, ' ');
+            for (auto& c : str)
+                c = bytes[rng() % bytes.size()];
+            ASSERT_EQUAL(utf::is_valid_utf8(str),
+                         utf::to_utf8(str, "utf-8") == str);
+
+            corpus::document doc;
+            doc.content(str, "UTF-8");
+            ASSERT_EQUAL(analyzers::analyzer::get_content(doc),
+                         utf::to_utf8(str, "utf-8"));
+        }
+
+        // content in another encoding is still converted
+        corpus::document latin;
+        latin.content("caf\xe9", "latin1");
+        ASSERT_EQUAL(analyzers::analyzer::get_content(latin),
+                     "caf\xc3\xa9");
+
+        corpus::document file{"../data/sample-document.txt"};
+        std::ifstream in{"../data/sample-document.txt"};
+        std::string text{std::istreambuf_iterator<char>{in},
+                         std::istreambuf_iterator<char>{}};
+        ASSERT_EQUAL(analyzers::analyzer::get_content(file), text);
+    });
+}
+
+int icu_tokenize()
+{
+    return testing::run_test("icu-tokenizer", [&]()
+    {
+        analyzers::tokenizers::icu_tokenizer tok;
+        std::vector<std::string> expected
+            = {"<s>", "Hello", "world", ".",    "</s>", "<s>",
+               "Second", "line", "here", ".", "</s>"};
+
+        // the tokenizer is reused, as it is for each document of a corpus
+        for (int i = 0; i < 2; ++i)
+        {
+            tok.set_content("Hello world.\nSecond \t line here.");
+            std::vector<std::string> tokens;
+            while (tok)
+                tokens.push_back(tok.next());
+            ASSERT(tokens == expected);
+        }
+
+        tok.set_content("");
+        ASSERT(!tok);
+    });
+}
+
+namespace
+{
+/**
+ * @param tok A tokenizer
+ * @param content The content to tokenize
+ * @return the tokens of the content
+ */
+std::vector<std::string> tokens(analyzers::token_stream& tok,
+                                const std::string& content)
+{
+    tok.set_content(content);
+    std::vector<std::string> result;
+    while (tok)
+        result.push_back(tok.next());
+    return result;
+}
+}
+
+int ascii_tokenize()
+{
+    return testing::run_test("icu-tokenizer-ascii", [&]()
+    {
+        analyzers::tokenizers::icu_tokenizer fast{false, true};
+        analyzers::tokenizers::icu_tokenizer icu{false, false};
+
+        std::vector<std::string> contents
+            = {"Mr. Smith went to Washington. He said: \"Hi!\" (then left.) "
+               "and so on... e.g. 3.14, 1,000,000; U.S.A. is big.",
+               "can't won't rock'n'roll foo_bar 12ab a1 x.y:z? 5.5.5 a_1_ "
+               "me@example.com 'quoted' \"double\" [braces] {curly} end.",
+               "What?! Really!? no. Yes. ok.\tTabs\there.\n\nNew para",
+               "  leading space. trailing space.   ", "...", "a.B c.d E",
+               "He left.) She came. (Why?) \"Nobody knows.\" she said."};
+        std::ifstream in{"../data/sample-document.txt"};
+        contents.emplace_back(std::istreambuf_iterator<char>{in},
+                              std::istreambuf_iterator<char>{});
+
+        // and some ASCII noise made of the characters the rules treat
+        // specially
+        const std::string alphabet = "aAzZ09.!?,;:'\"()[]_- \t\n\r\f#@";
+        std::mt19937 rng{47};
+        for (int i = 0; i < 500; ++i)
+        {
+            std::string noise(rng() % 40, ' ');
+            for (auto& c : noise)
+                c = alphabet[rng() % alphabet.size()];
+            contents.push_back(noise);
+        }
+
+        for (const auto& content : contents)
+            ASSERT(tokens(fast, content) == tokens(icu, content));
+    });
+}
+
 int analyzer_tests()
 {
     int num_failed = 0;
     num_failed += content_tokenize();
     num_failed += file_tokenize();
+    num_failed += feature_tokenize();
+    num_failed += parallel_tokenize();
+    num_failed += utf8_content();
+    num_failed += icu_tokenize();
+    num_failed += ascii_tokenize();
     return num_failed;
 }
 }
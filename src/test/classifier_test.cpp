@@ -3,10 +3,17 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+#include <atomic>
 #include <random>
+#include <thread>
 
 #include "test/classifier_test.h"
+#include "classify/feature_selector.h"
 #include "classify/loss/all.h"
+#include "classify/models/frozen_linear_model.h"
+#include "classify/online_classifier.h"
+#include "util/filesystem.h"
 
 namespace meta
 {
@@ -69,6 +76,26 @@ int run_tests(const std::string& type)
             check_split(*f_idx, nb, 0.83);
         });
 
+        num_failed += testing::run_test("parallel-cross-validate-" + type,
+                                        [&]()
+                                        {
+            naive_bayes nb{f_idx};
+            auto docs = f_idx->docs();
+            auto serial = nb.cross_validate(docs, 5);
+            auto parallel = classifier::cross_validate(
+                [&](uint64_t)
+                {
+                    return make_unique<naive_bayes>(f_idx);
+                },
+                docs, 5, false, 1, 3);
+            ASSERT_APPROX_EQUAL(parallel.accuracy(), serial.accuracy());
+            ASSERT_EQUAL(parallel.predictions().size(),
+                         serial.predictions().size());
+            for (const auto& pred : serial.predictions())
+                ASSERT_EQUAL(parallel.predictions().at(pred.first),
+                             pred.second);
+        });
+
         num_failed += testing::run_test("knn-cv-" + type, [&]()
                                         {
             knn kn{i_idx, f_idx, 10, make_unique<index::okapi_bm25>()};
@@ -81,6 +108,35 @@ int run_tests(const std::string& type)
             check_split(*f_idx, kn, 0.88);
         });
 
+        num_failed += testing::run_test("knn-hnsw-cv-" + type, [&]()
+                                        {
+            knn kn{i_idx, f_idx, 10, make_unique<index::okapi_bm25>(), false,
+                   index::hnsw_options{}};
+            check_cv(*f_idx, kn, 0.80);
+        });
+
+        num_failed += testing::run_test("classify-batch-" + type, [&]()
+                                        {
+            knn kn{i_idx, f_idx, 10, make_unique<index::okapi_bm25>()};
+            auto docs = f_idx->docs();
+            std::vector<doc_id> train_docs{docs.begin() + docs.size() / 8,
+                                           docs.end()};
+            std::vector<doc_id> test_docs{docs.begin(),
+                                          docs.begin() + docs.size() / 8};
+            kn.train(train_docs);
+
+            auto labels = kn.classify_batch(test_docs, 4);
+            ASSERT_EQUAL(labels.size(), test_docs.size());
+            confusion_matrix serial;
+            for (uint64_t i = 0; i < test_docs.size(); ++i)
+            {
+                ASSERT_EQUAL(labels[i], kn.classify(test_docs[i]));
+                serial.add(labels[i], f_idx->label(test_docs[i]));
+            }
+            ASSERT_APPROX_EQUAL(kn.test(test_docs).accuracy(),
+                                serial.accuracy());
+        });
+
         num_failed += testing::run_test("nearest-centroid-cv-" + type, [&]()
                                         {
             nearest_centroid nc{i_idx, f_idx};
@@ -93,6 +149,12 @@ int run_tests(const std::string& type)
             check_split(*f_idx, nc, 0.84);
         });
 
+        num_failed += testing::run_test("dual-perceptron-split-" + type, [&]()
+                                        {
+            dual_perceptron dp{f_idx, kernel::polynomial{}, 0.1, 0.05, 0, 20};
+            check_split(*f_idx, dp, 0.80);
+        });
+
         num_failed += testing::run_test("sgd-cv-" + type, [&]()
                                         {
             one_vs_all hinge_sgd{f_idx, [&](class_label positive)
@@ -111,6 +173,20 @@ int run_tests(const std::string& type)
             check_cv(*f_idx, perceptron, 0.89);
         });
 
+        num_failed += testing::run_test("sgd-hogwild-" + type, [&]()
+                                        {
+            one_vs_all hinge_sgd{f_idx, [&](class_label positive)
+                                 {
+                return make_unique<sgd>(
+                    "sgd-model-test", f_idx, positive, class_label{"negative"},
+                    make_unique<loss::hinge>(), sgd::default_alpha,
+                    sgd::default_gamma, sgd::default_bias,
+                    sgd::default_lambda, sgd::default_max_iter, 4);
+            }};
+            check_cv(*f_idx, hinge_sgd, 0.91);
+            check_split(*f_idx, hinge_sgd, 0.87);
+        });
+
         num_failed += testing::run_test("sgd-split-" + type, [&]()
                                         {
             one_vs_all hinge_sgd{f_idx, [&](class_label positive)
@@ -129,6 +205,157 @@ int run_tests(const std::string& type)
             check_split(*f_idx, perceptron, 0.85);
         });
 
+        num_failed += testing::run_test("sgd-feature-selection-" + type, [&]()
+                                        {
+            one_vs_all hinge_sgd{f_idx, [&](class_label positive)
+                                 {
+                return make_unique<sgd>(
+                    "sgd-model-test", f_idx, positive, class_label{"negative"},
+                    make_unique<loss::hinge>(), sgd::default_alpha,
+                    sgd::default_gamma, sgd::default_bias, sgd::default_lambda,
+                    sgd::default_max_iter, sgd::default_num_threads, 2000);
+            }};
+            check_cv(*f_idx, hinge_sgd, 0.90);
+        });
+
+        num_failed += testing::run_test("sgd-adagrad-" + type, [&]()
+                                        {
+            one_vs_all hinge_sgd{f_idx, [&](class_label positive)
+                                 {
+                return make_unique<sgd>(
+                    "sgd-model-test", f_idx, positive, class_label{"negative"},
+                    make_unique<loss::hinge>(), 0.1, sgd::default_gamma,
+                    sgd::default_bias, sgd::default_lambda,
+                    sgd::default_max_iter, sgd::default_num_threads, 0,
+                    selection_method::chi_square, sgd::update_rule::adagrad);
+            }};
+            check_cv(*f_idx, hinge_sgd, 0.90);
+        });
+
+        num_failed += testing::run_test("sgd-ftrl-" + type, [&]()
+                                        {
+            one_vs_all hinge_sgd{f_idx, [&](class_label positive)
+                                 {
+                return make_unique<sgd>(
+                    "sgd-model-test", f_idx, positive, class_label{"negative"},
+                    make_unique<loss::hinge>(), 0.1, sgd::default_gamma,
+                    sgd::default_bias, sgd::default_lambda,
+                    sgd::default_max_iter, sgd::default_num_threads, 0,
+                    selection_method::chi_square, sgd::update_rule::ftrl, 1,
+                    0.01);
+            }};
+            check_cv(*f_idx, hinge_sgd, 0.90);
+        });
+
+        num_failed += testing::run_test("sgd-mini-batch-" + type, [&]()
+                                        {
+            one_vs_all hinge_sgd{f_idx, [&](class_label positive)
+                                 {
+                return make_unique<sgd>(
+                    "sgd-model-test", f_idx, positive, class_label{"negative"},
+                    make_unique<loss::hinge>(), 0.1, sgd::default_gamma,
+                    sgd::default_bias, sgd::default_lambda,
+                    sgd::default_max_iter, 4, 0, selection_method::chi_square,
+                    sgd::update_rule::ftrl, 8);
+            }};
+            check_cv(*f_idx, hinge_sgd, 0.90);
+        });
+
+        num_failed += testing::run_test("feature-selector-" + type, [&]()
+                                        {
+            auto docs = f_idx->docs();
+            classify::feature_selector selector{*f_idx, docs};
+
+            // count the documents of each class containing each term
+            auto matrix = f_idx->materialize(docs);
+            std::unordered_map<term_id, std::unordered_map<label_id, double>>
+                counts;
+            std::unordered_map<label_id, double> class_docs;
+            for (uint64_t r = 0; r < matrix.rows(); ++r)
+            {
+                auto lbl = f_idx->lbl_id(matrix.doc(r));
+                class_docs[lbl] += 1;
+                for (const auto& count : matrix[r])
+                    counts[count.first][lbl] += 1;
+            }
+
+            double n = docs.size();
+            for (uint64_t i = 0; i < f_idx->unique_terms(); i += 97)
+            {
+                term_id t{i};
+                double df = 0;
+                for (const auto& c : counts[t])
+                    df += c.second;
+                ASSERT_APPROX_EQUAL(
+                    selector.score(t, classify::selection_method::doc_freq),
+                    df);
+
+                double chi = 0;
+                double gain = 0;
+                for (const auto& c : class_docs)
+                {
+                    double a = counts[t][c.first];
+                    double b = df - a;
+                    double cc = c.second - a;
+                    double d = n - c.second - b;
+                    chi = std::max(chi, n * std::pow(a * d - cc * b, 2)
+                                            / ((a + cc) * (b + d) * (a + b)
+                                               * (cc + d)));
+                    auto plogp = [](double p)
+                    {
+                        return p > 0 ? p * std::log(p) : 0;
+                    };
+                    gain += -plogp(c.second / n) + df / n * plogp(a / df)
+                            + (n - df) / n * plogp(cc / (n - df));
+                }
+                ASSERT_APPROX_EQUAL(
+                    selector.score(t, classify::selection_method::chi_square),
+                    chi);
+                ASSERT_APPROX_EQUAL(
+                    selector.score(
+                        t, classify::selection_method::information_gain),
+                    gain);
+            }
+
+            auto selected
+                = selector.select(classify::selection_method::doc_freq, 50);
+            ASSERT_EQUAL(selected.size(), uint64_t{50});
+            ASSERT(std::is_sorted(selected.begin(), selected.end()));
+            double least = docs.size();
+            for (const auto& t : selected)
+                least = std::min(least, selector.score(
+                            t, classify::selection_method::doc_freq));
+            for (term_id t{0}; t < f_idx->unique_terms(); ++t)
+            {
+                if (!std::binary_search(selected.begin(), selected.end(), t))
+                    ASSERT(selector.score(t, classify::selection_method::
+                                                 doc_freq) <= least);
+            }
+
+            classify::feature_projection projection{selected,
+                                                    f_idx->unique_terms()};
+            auto projected = projection.project(matrix);
+            ASSERT_EQUAL(projected.rows(), matrix.rows());
+            for (uint64_t r = 0; r < matrix.rows(); ++r)
+            {
+                std::vector<std::pair<term_id, double>> expected;
+                for (const auto& count : matrix[r])
+                {
+                    if (std::binary_search(selected.begin(), selected.end(),
+                                           count.first))
+                        expected.emplace_back(term_id{projection(count.first)},
+                                              count.second);
+                }
+                ASSERT_EQUAL(projected[r].size(), expected.size());
+                for (uint64_t i = 0; i < expected.size(); ++i)
+                {
+                    ASSERT_EQUAL(projected[r].term(i), expected[i].first);
+                    ASSERT_APPROX_EQUAL(projected[r].value(i),
+                                        expected[i].second);
+                }
+            }
+        });
+
         num_failed += testing::run_test("log-reg-cv-" + type, [&]()
                                         {
             logistic_regression logreg{"logreg-model-test", f_idx};
@@ -141,6 +368,19 @@ int run_tests(const std::string& type)
             check_split(*f_idx, logreg, 0.87);
         });
 
+        num_failed += testing::run_test("softmax-regression-cv-" + type, [&]()
+                                        {
+            softmax_regression softmax{"softmax-model-test", f_idx};
+            check_cv(*f_idx, softmax, 0.90);
+        });
+
+        num_failed += testing::run_test("softmax-regression-split-" + type,
+                                        [&]()
+                                        {
+            softmax_regression softmax{"softmax-model-test", f_idx};
+            check_split(*f_idx, softmax, 0.87);
+        });
+
         num_failed += testing::run_test("winnow-cv-" + type, [&]()
                                         {
             winnow win{f_idx};
@@ -177,6 +417,239 @@ int classifier_tests()
     num_failed += run_tests("file");
     create_config("line");
     num_failed += run_tests("line");
+
+    num_failed += testing::run_test("frozen-linear-model", [&]()
+    {
+        std::mt19937 rng{1};
+        std::uniform_real_distribution<float> dist{-1, 1};
+        classify::linear_model<std::string, float, label_id> model;
+        for (uint64_t f = 0; f < 200; ++f)
+        {
+            for (uint32_t c = 0; c < 5; ++c)
+            {
+                if (rng() % 2)
+                    model.update(label_id{c}, "f" + std::to_string(f),
+                                 dist(rng));
+            }
+        }
+
+        using frozen_model = classify::frozen_linear_model<std::string,
+                                                           label_id>;
+        frozen_model::save(model, "frozen-test.model");
+        frozen_model::save(model, "frozen-test-quantized.model", true);
+        frozen_model frozen{"frozen-test.model"};
+        frozen_model quantized{"frozen-test-quantized.model"};
+        ASSERT_EQUAL(frozen.num_features(), model.weights().size());
+        ASSERT(!frozen.quantized());
+        ASSERT(quantized.quantized());
+
+        for (uint64_t i = 0; i < 100; ++i)
+        {
+            std::unordered_map<std::string, float> features;
+            for (uint64_t j = 0; j < 10; ++j)
+                features["f" + std::to_string(rng() % 250)] = dist(rng) + 1;
+
+            ASSERT_EQUAL(frozen.best_class(features),
+                         model.best_class(features));
+            auto expected = model.best_classes(features, 3);
+            auto found = frozen.best_classes(features, 3);
+            auto approx = quantized.best_classes(features, 5);
+            ASSERT_EQUAL(found.size(), expected.size());
+            for (uint64_t k = 0; k < found.size(); ++k)
+            {
+                ASSERT_EQUAL(found[k].first, expected[k].first);
+                ASSERT_APPROX_EQUAL(found[k].second, expected[k].second);
+            }
+            for (const auto& score : approx)
+            {
+                auto exact = std::find_if(
+                    found.begin(), found.end(), [&](const decltype(score)& s)
+                    {
+                        return s.first == score.first;
+                    });
+                if (exact != found.end())
+                    ASSERT_LESS(std::abs(exact->second - score.second), 0.1);
+            }
+        }
+
+        classify::linear_model<std::string, float, label_id> thawed;
+        quantized.thaw(thawed);
+        for (const auto& weights : model.weights())
+        {
+            for (const auto& weight : weights.second)
+                ASSERT_LESS(std::abs(thawed.weights().at(weights.first).at(
+                                         weight.first) - weight.second),
+                            0.01);
+        }
+
+        // features that are not strings are stored directly
+        classify::linear_model<term_id, double, label_id> numeric;
+        for (uint64_t f = 0; f < 100; ++f)
+            numeric.update(label_id{static_cast<uint32_t>(f % 3)},
+                           term_id{f * 7}, dist(rng));
+        classify::frozen_linear_model<term_id, label_id>::save(
+            numeric, "frozen-test.model");
+        classify::frozen_linear_model<term_id, label_id> frozen_numeric{
+            "frozen-test.model"};
+        for (uint64_t i = 0; i < 100; ++i)
+        {
+            std::vector<std::pair<term_id, double>> features;
+            for (uint64_t j = 0; j < 10; ++j)
+                features.emplace_back(term_id{rng() % 800}, 1);
+            ASSERT_EQUAL(frozen_numeric.best_class(features),
+                         numeric.best_class(features));
+        }
+
+        filesystem::delete_file("frozen-test.model");
+        filesystem::delete_file("frozen-test-quantized.model");
+    });
+
+    num_failed += testing::run_test("svm-wrapper-models", [&]()
+    {
+        // the models in data/svm-wrapper are read instead of trained, and
+        // each has the label it gives every document of the corpus
+        filesystem::remove_all("svm-wrapper-test");
+        filesystem::make_directory("svm-wrapper-test");
+        {
+            std::ofstream config{"svm-wrapper-test/config.toml"};
+            config << "prefix = \"../data\"\n"
+                   << "corpus-type = \"line-corpus\"\n"
+                   << "dataset = \"svm-wrapper\"\n"
+                   << "forward-index = \"svm-wrapper-test/fwd\"\n"
+                   << "inverted-index = \"svm-wrapper-test/inv\"\n"
+                   << "[[analyzers]]\n"
+                   << "method = \"libsvm\"\n";
+        }
+        auto idx = index::make_index<index::forward_index>(
+            "svm-wrapper-test/config.toml");
+        ASSERT_EQUAL(idx->num_docs(), uint64_t{10});
+        ASSERT_EQUAL(idx->id(class_label{"a"}), label_id{1});
+        ASSERT_EQUAL(idx->id(class_label{"b"}), label_id{2});
+        ASSERT_EQUAL(idx->id(class_label{"c"}), label_id{3});
+
+        using classify::svm_wrapper;
+        auto check_model = [&](const std::string& name,
+                               svm_wrapper::kernel kernel_opt)
+        {
+            svm_wrapper svm{idx, "", kernel_opt, "svm-wrapper-test/svm"};
+            bool thrown = false;
+            try
+            {
+                svm.classify(doc_id{0});
+            }
+            catch (svm_wrapper::svm_wrapper_exception&)
+            {
+                thrown = true;
+            }
+            ASSERT(thrown);
+
+            svm.load_model("../data/svm-wrapper/" + name + ".model");
+            std::ifstream expected{"../data/svm-wrapper/" + name
+                                   + ".labels"};
+            std::string label;
+            uint64_t d_id = 0;
+            while (std::getline(expected, label))
+                ASSERT_EQUAL(svm.classify(doc_id{d_id++}), class_label{label});
+            ASSERT_EQUAL(d_id, idx->num_docs());
+
+            svm.reset();
+            thrown = false;
+            try
+            {
+                svm.classify(doc_id{0});
+            }
+            catch (svm_wrapper::svm_wrapper_exception&)
+            {
+                thrown = true;
+            }
+            ASSERT(thrown);
+        };
+        check_model("linear", svm_wrapper::kernel::None);
+        check_model("linear-bias", svm_wrapper::kernel::None);
+        check_model("multiclass", svm_wrapper::kernel::None);
+        check_model("rbf", svm_wrapper::kernel::RBF);
+
+        // missing and truncated models are errors
+        {
+            std::ifstream in{"../data/svm-wrapper/rbf.model"};
+            std::ofstream out{"svm-wrapper-test/truncated.model"};
+            std::string line;
+            for (uint64_t i = 0; i < 12 && std::getline(in, line); ++i)
+                out << line << "\n";
+        }
+        svm_wrapper svm{idx, "", svm_wrapper::kernel::RBF};
+        for (const auto& name : {"missing", "truncated"})
+        {
+            bool thrown = false;
+            try
+            {
+                svm.load_model("svm-wrapper-test/" + std::string{name}
+                               + ".model");
+            }
+            catch (svm_wrapper::svm_wrapper_exception&)
+            {
+                thrown = true;
+            }
+            ASSERT(thrown);
+        }
+
+        idx = nullptr;
+        filesystem::remove_all("svm-wrapper-test");
+    });
+
+    num_failed += testing::run_test("online-classifier", [&]()
+    {
+        // three classes, each with its own features and some shared noise
+        using classify::online_classifier;
+        using feature_vector = online_classifier::feature_vector;
+        std::mt19937 rng{47};
+        std::vector<class_label> labels{class_label{"a"}, class_label{"b"},
+                                        class_label{"c"}};
+        auto example = [&](uint64_t k)
+        {
+            feature_vector features;
+            features.emplace_back(term_id{k * 10 + rng() % 10}, 1);
+            features.emplace_back(term_id{100 + rng() % 50}, 1);
+            return features;
+        };
+
+        online_classifier online{make_unique<classify::loss::hinge>(), 0.1,
+                                 online_classifier::default_lambda, 0};
+        ASSERT_EQUAL(online.classify(example(0)), class_label{});
+
+        // predictions served while training only ever see published
+        // weights
+        std::atomic<bool> done{false};
+        std::thread reader{[&]()
+        {
+            feature_vector features{{term_id{0}, 1}};
+            while (!done)
+                online.classify(features);
+        }};
+        for (uint64_t i = 0; i < 3000; ++i)
+        {
+            online.train(example(i % 3), labels[i % 3]);
+            if (i % 100 == 0)
+                online.publish();
+        }
+        done = true;
+        reader.join();
+        ASSERT_EQUAL(online.num_updates(), 3000ul);
+
+        online.publish();
+        uint64_t correct = 0;
+        for (uint64_t i = 0; i < 300; ++i)
+            correct += online.classify(example(i % 3)) == labels[i % 3];
+        ASSERT_GREATER(correct, 290ul);
+
+        // nothing trained after publishing is seen until the next one
+        for (uint64_t i = 0; i < 20; ++i)
+            online.train({{term_id{200}, 1}}, class_label{"d"});
+        ASSERT(online.classify({{term_id{200}, 1}}) != class_label{"d"});
+        online.publish();
+        ASSERT_EQUAL(online.classify({{term_id{200}, 1}}), class_label{"d"});
+    });
+
     return num_failed;
 }
 }
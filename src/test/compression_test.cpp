@@ -4,11 +4,21 @@
  */
 
 #include <algorithm>
+#include <fstream>
+#include <limits>
 #include <numeric>
 #include <random>
+#include "util/disk_vector.h"
+#include "util/elias_fano.h"
 #include "util/filesystem.h"
+#include "util/offset_vector.h"
 #include "io/compressed_file_reader.h"
 #include "io/compressed_file_writer.h"
+#include "io/mmap_file.h"
+#include "io/stream_vbyte.h"
+#include "index/compact_postings.h"
+#include "index/postings_cursor.h"
+#include "index/postings_data.h"
 #include "test/compression_test.h"
 
 namespace meta
@@ -51,6 +61,474 @@ int compression_tests()
     if (filesystem::file_exists(filename))
         filesystem::delete_file(filename);
 
+    num_failed += testing::run_test("stream-vbyte", [&]()
+    {
+        // exercise every byte length, with a count that isn't a multiple
+        // of four
+        std::vector<uint32_t> values;
+        for (uint32_t i = 0; i < 1001; ++i)
+            values.push_back(g() >> (8 * (i % 4)));
+
+        std::vector<uint8_t> buffer(
+            io::stream_vbyte::max_encoded_size(values.size()));
+        auto bytes = io::stream_vbyte::encode(values.data(), values.size(),
+                                              buffer.data());
+        ASSERT_EQUAL(io::stream_vbyte::encoded_size(buffer.data(),
+                                                    values.size()),
+                     bytes);
+
+        std::vector<uint32_t> decoded(values.size());
+        ASSERT_EQUAL(io::stream_vbyte::decode(buffer.data(), values.size(),
+                                              decoded.data()),
+                     bytes);
+        ASSERT(decoded == values);
+    });
+
+    num_failed += testing::run_test("packed-postings", [&]()
+    {
+        using pdata_t = index::postings_data<term_id, doc_id>;
+        pdata_t::count_t counts;
+        uint64_t id = 0;
+        for (uint64_t i = 0; i < 3 * pdata_t::block_size + 7; ++i)
+        {
+            id += 1 + g() % 1000;
+            counts.emplace_back(doc_id{id}, 1 + g() % 50);
+        }
+
+        pdata_t pdata{term_id{0}};
+        pdata.set_counts(counts);
+        std::stringstream ss;
+        auto bytes = pdata.write_packed(ss);
+        auto str = ss.str();
+        ASSERT_EQUAL(str.size(), bytes);
+
+        pdata_t read{term_id{0}};
+        read.read_packed(str.data());
+        ASSERT(read.counts() == counts);
+
+        // walking the packed and decoded cursors should agree
+        index::postings_cursor packed{str.data()};
+        index::postings_cursor decoded{counts};
+        ASSERT_EQUAL(packed.size(), counts.size());
+        for (const auto& p : counts)
+        {
+            ASSERT(!packed.at_end() && !decoded.at_end());
+            ASSERT_EQUAL(packed.doc(), p.first);
+            ASSERT_EQUAL(packed.count(), static_cast<uint64_t>(p.second));
+            ASSERT(packed.count() <= packed.block_max_count());
+            ASSERT_EQUAL(packed.block_max_count(), decoded.block_max_count());
+            packed.next();
+            decoded.next();
+        }
+        ASSERT(packed.at_end() && decoded.at_end());
+
+        // skipping should land on the first doc_id >= the target
+        index::postings_cursor skipper{str.data()};
+        for (uint64_t i = 5; i < counts.size(); i += 97)
+        {
+            skipper.skip_to(doc_id{counts[i].first - 1});
+            ASSERT_EQUAL(skipper.doc(),
+                         counts[i].first - 1 == counts[i - 1].first
+                             ? counts[i - 1].first
+                             : counts[i].first);
+            skipper.skip_to(counts[i].first);
+            ASSERT_EQUAL(skipper.doc(), counts[i].first);
+        }
+        skipper.skip_to(doc_id{counts.back().first + 1});
+        ASSERT(skipper.at_end());
+
+        // short skips gallop through the current block
+        for (uint64_t stride = 1; stride < 40; stride += 3)
+        {
+            index::postings_cursor galloper{str.data()};
+            for (uint64_t i = 0; i < counts.size(); i += stride)
+            {
+                galloper.skip_to(counts[i].first);
+                ASSERT_EQUAL(galloper.doc(), counts[i].first);
+            }
+        }
+    });
+
+    num_failed += testing::run_test("elias-fano", [&]()
+    {
+        // sizes around the sample rate of 256; gaps of at most one give
+        // no low bits, wider gaps several, and the last reaches 2^40
+        std::vector<std::vector<uint64_t>> sequences(3);
+        for (uint64_t i = 0; i < 1000; ++i)
+            sequences[1].push_back(i / 2);
+        for (uint64_t i = 0; i < 600; ++i)
+            sequences[2].push_back((uint64_t{1} << 40) / 600 * i);
+        uint64_t value = 0;
+        for (uint64_t size : {1, 255, 256, 257, 5000})
+        {
+            sequences.emplace_back();
+            for (uint64_t i = 0; i < size; ++i)
+            {
+                value += g() % 1000;
+                sequences.back().push_back(value);
+            }
+        }
+
+        std::string ef_file{"meta-tmp-elias-fano.ef"};
+        for (const auto& seq : sequences)
+        {
+            util::elias_fano_vector ef{seq.begin(), seq.end()};
+            ef.save(ef_file);
+            util::elias_fano_vector loaded{ef_file};
+            ASSERT_EQUAL(ef.size(), seq.size());
+            ASSERT_EQUAL(loaded.size(), seq.size());
+            for (uint64_t i = 0; i < seq.size(); ++i)
+            {
+                ASSERT_EQUAL(ef[i], seq[i]);
+                ASSERT_EQUAL(loaded.at(i), seq[i]);
+            }
+
+            bool thrown = false;
+            try
+            {
+                loaded.at(seq.size());
+            }
+            catch (util::elias_fano_vector::elias_fano_exception&)
+            {
+                thrown = true;
+            }
+            ASSERT(thrown);
+        }
+
+        std::vector<uint64_t> decreasing{1, 5, 4};
+        bool thrown = false;
+        try
+        {
+            util::elias_fano_vector{decreasing.begin(), decreasing.end()};
+        }
+        catch (util::elias_fano_vector::elias_fano_exception&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+
+        {
+            std::ofstream garbage{ef_file, std::ios::binary};
+            garbage << "not an Elias-Fano vector";
+        }
+        thrown = false;
+        try
+        {
+            util::elias_fano_vector{ef_file};
+        }
+        catch (util::elias_fano_vector::elias_fano_exception&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+        filesystem::delete_file(ef_file);
+    });
+
+    num_failed += testing::run_test("offset-vector", [&]()
+    {
+        std::string table{"meta-tmp-offsets.bin"};
+        auto write_table = [&](const std::vector<uint64_t>& offsets)
+        {
+            if (offsets.empty())
+            {
+                std::ofstream empty{table, std::ios::binary};
+                return;
+            }
+            util::disk_vector<uint64_t> flat{table, offsets.size()};
+            for (uint64_t i = 0; i < offsets.size(); ++i)
+                flat[i] = offsets[i];
+        };
+        auto out_of_range = [](const util::offset_vector& offsets)
+        {
+            try
+            {
+                offsets.at(offsets.size());
+            }
+            catch (std::exception&)
+            {
+                return true;
+            }
+            return false;
+        };
+
+        std::vector<uint64_t> monotone;
+        uint64_t value = 0;
+        for (uint64_t i = 0; i < 3000; ++i)
+        {
+            value += g() % 800;
+            monotone.push_back(value);
+        }
+
+        // a monotone table is replaced by its Elias-Fano form
+        write_table(monotone);
+        ASSERT(util::offset_vector::compact(table));
+        ASSERT(!filesystem::file_exists(table));
+        ASSERT(filesystem::file_exists(table + ".ef"));
+        ASSERT(util::offset_vector::exists(table));
+        {
+            util::offset_vector offsets{table};
+            ASSERT_EQUAL(offsets.size(), monotone.size());
+            for (uint64_t i = 0; i < monotone.size(); ++i)
+                ASSERT_EQUAL(offsets[i], monotone[i]);
+            ASSERT(out_of_range(offsets));
+        }
+
+        // any other is left as it was, and a stale Elias-Fano form of an
+        // earlier table is removed
+        auto shuffled = monotone;
+        std::swap(shuffled[10], shuffled[2000]);
+        write_table(shuffled);
+        ASSERT(!util::offset_vector::compact(table));
+        ASSERT(filesystem::file_exists(table));
+        ASSERT(!filesystem::file_exists(table + ".ef"));
+        {
+            util::offset_vector offsets{table};
+            ASSERT_EQUAL(offsets.size(), shuffled.size());
+            for (uint64_t i = 0; i < shuffled.size(); ++i)
+                ASSERT_EQUAL(offsets.at(i), shuffled[i]);
+            ASSERT(out_of_range(offsets));
+        }
+        filesystem::delete_file(table);
+
+        write_table({});
+        ASSERT(util::offset_vector::compact(table));
+        {
+            util::offset_vector offsets{table};
+            ASSERT_EQUAL(offsets.size(), uint64_t{0});
+            ASSERT(out_of_range(offsets));
+        }
+        filesystem::delete_file(table + ".ef");
+        ASSERT(!util::offset_vector::exists(table));
+    });
+
+    num_failed += testing::run_test("gamma-writer", [&]()
+    {
+        // every code length, around each power of two, and the largest
+        // value the default mapping can shift up
+        std::vector<uint64_t> values{0, 1};
+        for (uint64_t k = 1; k < 64; ++k)
+        {
+            uint64_t p = uint64_t{1} << k;
+            values.push_back(p - 3);
+            values.push_back(p - 2);
+            values.push_back(p - 1);
+            values.push_back(p);
+        }
+        values.push_back(std::numeric_limits<uint64_t>::max() - 2);
+        for (uint64_t i = 0; i < 5000; ++i)
+            values.push_back(g() >> (i % 32));
+
+        // buffers smaller than a word, unaligned, and the default, which
+        // must all write the same file
+        std::string expected;
+        for (uint64_t buffer_size : {uint64_t{1}, uint64_t{13}, uint64_t{1000},
+                                     io::default_compressed_file_writer::
+                                         default_buffer_size})
+        {
+            std::vector<uint64_t> locations;
+            {
+                io::default_compressed_file_writer writer{
+                    filename, io::default_compression_writer_mapping{},
+                    buffer_size};
+                writer.write(str);
+                for (const auto& v : values)
+                {
+                    locations.push_back(writer.bit_location());
+                    writer.write(v);
+                }
+                writer.write(str);
+                writer.close();
+            }
+
+            auto contents = filesystem::file_text(filename);
+            if (expected.empty())
+                expected = contents;
+            ASSERT(contents == expected);
+
+            io::compressed_file_reader reader{
+                filename, io::default_compression_reader_func};
+            ASSERT_EQUAL(reader.next_string(), str);
+            for (const auto& v : values)
+                ASSERT_EQUAL(reader.next(), v);
+            ASSERT_EQUAL(reader.next_string(), str);
+
+            // seeking to a recorded location reads the value written there
+            for (uint64_t i = 0; i < values.size(); i += 37)
+            {
+                reader.seek(locations[i]);
+                ASSERT_EQUAL(reader.next(), values[i]);
+            }
+        }
+        filesystem::delete_file(filename);
+
+        try
+        {
+            io::default_compressed_file_writer writer{"no-such-dir/file"};
+            FAIL("opening a file in a missing directory should throw");
+        }
+        catch (const io::default_compressed_file_writer::
+                   compressed_file_writer_exception&)
+        {
+            // expected
+        }
+    });
+
+    num_failed += testing::run_test("gamma-postings", [&]()
+    {
+        using pdata_t = index::postings_data<term_id, doc_id>;
+
+        // lists around the block size, with gaps wider than 32 bits and
+        // counts of every size
+        std::vector<pdata_t::count_t> lists;
+        for (uint64_t n : {1, 127, 128, 129, 3 * 128 + 7})
+        {
+            pdata_t::count_t counts;
+            uint64_t id = 1 + g() % 3;
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                counts.emplace_back(doc_id{id}, 1 + (g() >> (g() % 32)));
+                id += i % 50 == 49 ? uint64_t{1} << 33 : 1 + g() % 1000;
+            }
+            lists.push_back(std::move(counts));
+        }
+
+        std::vector<uint64_t> locations;
+        {
+            io::default_compressed_file_writer writer{filename};
+            for (const auto& counts : lists)
+            {
+                pdata_t pdata{term_id{locations.size()}};
+                pdata.set_counts(counts);
+                locations.push_back(writer.bit_location());
+                pdata.write_compressed(writer);
+            }
+        }
+
+        io::mmap_file file{filename};
+        auto cursor = [&](uint64_t i)
+        {
+            return index::postings_cursor{file.begin(), file.size(),
+                                          locations[i]};
+        };
+        for (uint64_t l = 0; l < lists.size(); ++l)
+        {
+            const auto& counts = lists[l];
+
+            // walking the gamma and decoded cursors should agree
+            auto gamma = cursor(l);
+            index::postings_cursor decoded{counts};
+            ASSERT_EQUAL(gamma.size(), counts.size());
+            for (const auto& p : counts)
+            {
+                ASSERT(!gamma.at_end());
+                ASSERT_EQUAL(gamma.doc(), p.first);
+                ASSERT_EQUAL(gamma.count(), static_cast<uint64_t>(p.second));
+                ASSERT_EQUAL(gamma.block_max_count(),
+                             decoded.block_max_count());
+                gamma.next();
+                decoded.next();
+            }
+            ASSERT(gamma.at_end() && decoded.at_end());
+
+            // skipping lands on the first doc_id >= the target, across
+            // blocks that are never decoded
+            for (uint64_t stride : {1, 5, 97, 200})
+            {
+                auto skipper = cursor(l);
+                for (uint64_t i = 0; i < counts.size(); i += stride)
+                {
+                    skipper.skip_to(doc_id{counts[i].first - 1});
+                    ASSERT_EQUAL(skipper.doc(),
+                                 i > 0 && counts[i].first - 1
+                                              == counts[i - 1].first
+                                     ? counts[i - 1].first
+                                     : counts[i].first);
+                    skipper.skip_to(counts[i].first);
+                    ASSERT_EQUAL(skipper.doc(), counts[i].first);
+                    ASSERT_EQUAL(skipper.count(),
+                                 static_cast<uint64_t>(counts[i].second));
+                }
+                skipper.skip_to(doc_id{counts.back().first + 1});
+                ASSERT(skipper.at_end());
+            }
+        }
+        filesystem::delete_file(filename);
+    });
+
+    num_failed += testing::run_test("compact-postings", [&]()
+    {
+        using pdata_t = index::postings_data<term_id, doc_id>;
+        using values = index::compact_cache_values<pdata_t>;
+
+        // encodes the postings as a cache would, checks that they are
+        // recovered exactly, and returns the size of the encoding
+        auto round_trip = [&](const pdata_t::count_t& counts)
+        {
+            auto pdata = std::make_shared<pdata_t>(term_id{7});
+            pdata->set_counts(counts);
+            auto compact = values::store(pdata);
+            ASSERT_EQUAL(compact->primary_key(), term_id{7});
+            ASSERT_EQUAL(compact->size(), counts.size());
+
+            auto decoded = values::load(compact);
+            ASSERT_EQUAL(decoded->primary_key(), term_id{7});
+            ASSERT(decoded->counts() == counts);
+
+            uint64_t i = 0;
+            compact->for_each([&](doc_id d_id, double count)
+                              {
+                ASSERT(i < counts.size());
+                ASSERT_EQUAL(d_id, counts[i].first);
+                ASSERT(count == counts[i].second);
+                ++i;
+            });
+            ASSERT_EQUAL(i, counts.size());
+            return compact->bytes_used();
+        };
+
+        // the sizes straddle the 128-posting blocks
+        for (uint64_t n : {0, 1, 127, 128, 129, 1000})
+        {
+            pdata_t::count_t integral, wide, single, full, mixed;
+            uint64_t id = 0;
+            uint64_t far = 0;
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                id += 1 + g() % 100;
+                far += (uint64_t{1} << 32) + g() % 1000;
+                integral.emplace_back(doc_id{id}, 1 + g() % 50);
+                wide.emplace_back(doc_id{far}, 1 + g() % 50);
+                single.emplace_back(doc_id{id}, 0.25 + 0.5 * (g() % 400));
+                full.emplace_back(doc_id{id}, 0.1 + g() % 50);
+
+                // a fraction late in the list widens every block
+                mixed.emplace_back(doc_id{id}, i + 1 == n ? 0.5 : i);
+            }
+
+            // packed gaps and counts take a byte each, plus a control byte
+            // for every four values
+            ASSERT(round_trip(integral) <= 2 * n + 2 * ((n + 3) / 4));
+            ASSERT(round_trip(wide) >= 8 * n);
+            auto single_bytes = round_trip(single);
+            ASSERT(single_bytes >= 4 * n && single_bytes <= 7 * n);
+            ASSERT(round_trip(full) >= 9 * n);
+            ASSERT(round_trip(mixed) >= 4 * n);
+        }
+
+        // gaps just within and just beyond 32 bits
+        uint64_t max_gap = std::numeric_limits<uint32_t>::max();
+        ASSERT(round_trip({{doc_id{0}, 1}, {doc_id{max_gap}, 1}}) < 16);
+        ASSERT(round_trip({{doc_id{0}, 1}, {doc_id{max_gap + 1}, 1}}) >= 16);
+        ASSERT(round_trip({{doc_id{max_gap + 1}, 1}}) >= 8);
+
+        // counts at the edge of 32 bits, beyond it, exact as floats or not
+        // at all, and negative
+        round_trip({{doc_id{1}, max_gap}, {doc_id{2}, 1}});
+        round_trip({{doc_id{1}, max_gap + 1.0}, {doc_id{2}, 1}});
+        ASSERT(round_trip({{doc_id{1}, 5e9 + 1}}) >= 8);
+        round_trip({{doc_id{1}, 1e300}, {doc_id{2}, -1.5}, {doc_id{3}, 0}});
+    });
+
     return num_failed;
 }
 }
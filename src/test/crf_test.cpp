@@ -0,0 +1,401 @@
+/**
+ * @file crf_test.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <random>
+
+#include "sequence/crf/crf.h"
+#include "sequence/crf/tagger.h"
+#include "sequence/sequence_analyzer.h"
+#include "test/crf_test.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace testing
+{
+
+namespace
+{
+
+/**
+ * Draws a tagged sentence from a tiny grammar: a noun phrase, a verb, an
+ * optional second noun phrase and a full stop. "run" and "walk" may be
+ * either nouns or verbs, so tagging them needs the context.
+ */
+sequence::sequence make_sentence(std::mt19937& rng)
+{
+    static const std::vector<std::string> determiners{"the", "a"};
+    static const std::vector<std::string> adjectives{"big", "small", "red"};
+    static const std::vector<std::string> nouns{"cat", "dog", "run", "walk"};
+    static const std::vector<std::string> verbs{"saw", "chased", "run",
+                                                "walk"};
+
+    auto pick = [&](const std::vector<std::string>& words)
+    {
+        return words[std::uniform_int_distribution<uint64_t>{
+            0, words.size() - 1}(rng)];
+    };
+
+    sequence::sequence seq;
+    auto add = [&](const std::string& word, const std::string& tag)
+    {
+        seq.add_observation({sequence::symbol_t{word}, sequence::tag_t{tag}});
+    };
+    auto noun_phrase = [&]()
+    {
+        add(pick(determiners), "DT");
+        for (auto n = std::uniform_int_distribution<int>{0, 2}(rng); n > 0;
+             --n)
+            add(pick(adjectives), "JJ");
+        add(pick(nouns), "NN");
+    };
+
+    noun_phrase();
+    add(pick(verbs), "VB");
+    if (std::bernoulli_distribution{0.5}(rng))
+        noun_phrase();
+    add(".", ".");
+    return seq;
+}
+
+/**
+ * @param num The number of sentences to draw
+ * @param seed The seed for the sentences
+ * @return the sentences
+ */
+std::vector<sequence::sequence> make_sentences(uint64_t num, uint64_t seed)
+{
+    std::mt19937 rng{static_cast<std::mt19937::result_type>(seed)};
+    std::vector<sequence::sequence> sentences;
+    for (uint64_t i = 0; i < num; ++i)
+        sentences.push_back(make_sentence(rng));
+    return sentences;
+}
+
+/**
+ * @return crf parameters that train quickly on the synthetic sentences
+ */
+sequence::crf::parameters make_params()
+{
+    sequence::crf::parameters params;
+    params.max_iters = 15;
+    params.calibration_samples = 100;
+    return params;
+}
+
+/**
+ * The fraction of observations in the given test sentences that a tagger
+ * labels with their true tags.
+ */
+double accuracy(const sequence::crf& model,
+                const sequence::sequence_analyzer& analyzer,
+                std::vector<sequence::sequence> sentences)
+{
+    for (auto& seq : sentences)
+        analyzer.analyze(seq);
+    auto tagger = model.make_tagger();
+    uint64_t correct = 0;
+    uint64_t total = 0;
+    for (auto& seq : sentences)
+    {
+        tagger.tag(seq);
+        for (const auto& obs : seq)
+        {
+            if (analyzer.tag(obs.label()) == obs.tag())
+                ++correct;
+            ++total;
+        }
+    }
+    return static_cast<double>(correct) / total;
+}
+
+/**
+ * Trains a crf in its own folder under meta-tmp-crf with the given
+ * parameters, and checks its loss and its accuracy on held-out sentences.
+ */
+void check_training(const std::string& name, sequence::crf::parameters params)
+{
+    auto training = make_sentences(300, 47);
+    auto testing = make_sentences(100, 48);
+
+    auto analyzer = sequence::default_pos_analyzer();
+    analyzer.analyze(training);
+
+    // the crf holds on to its prefix, so the string must outlive it
+    std::string prefix = "meta-tmp-crf/" + name;
+    filesystem::make_directory(prefix);
+    sequence::crf model{prefix};
+    auto loss = model.train(params, training);
+    ASSERT(std::isfinite(loss));
+    ASSERT_GREATER(loss, 0.0);
+    ASSERT_EQUAL(model.num_labels(), uint64_t{5});
+    ASSERT_GREATER(accuracy(model, analyzer, testing), 0.95);
+}
+}
+
+int crf_tests()
+{
+    int num_failed = 0;
+    filesystem::remove_all("meta-tmp-crf");
+    filesystem::make_directory("meta-tmp-crf");
+
+    num_failed += testing::run_test("crf-train-serial", [&]()
+    {
+        check_training("serial", make_params());
+    });
+
+    num_failed += testing::run_test("crf-train-minibatch", [&]()
+    {
+        auto params = make_params();
+        params.num_threads = 4;
+        params.strategy = sequence::crf::update_strategy::minibatch;
+        params.batch_size = 8;
+        check_training("minibatch", params);
+    });
+
+    num_failed += testing::run_test("crf-train-lock-free", [&]()
+    {
+        auto params = make_params();
+        params.num_threads = 4;
+        params.strategy = sequence::crf::update_strategy::lock_free;
+        check_training("lock-free", params);
+    });
+
+    num_failed += testing::run_test("crf-batch-tagging", [&]()
+    {
+        auto training = make_sentences(300, 47);
+        auto analyzer = sequence::default_pos_analyzer();
+        analyzer.analyze(training);
+
+        std::string prefix = "meta-tmp-crf/tagging";
+        filesystem::make_directory(prefix);
+        sequence::crf model{prefix};
+        model.train(make_params(), training);
+
+        auto serial = make_sentences(100, 48);
+        for (auto& seq : serial)
+            analyzer.analyze(seq);
+        auto batched = serial;
+
+        auto tagger = model.make_tagger();
+        for (auto& seq : serial)
+            tagger.tag(seq);
+        parallel::thread_pool pool{3};
+        tagger.tag(batched, pool);
+
+        ASSERT_EQUAL(batched.size(), serial.size());
+        for (uint64_t i = 0; i < serial.size(); ++i)
+        {
+            ASSERT_EQUAL(batched[i].size(), serial[i].size());
+            for (uint64_t t = 0; t < serial[i].size(); ++t)
+                ASSERT_EQUAL(batched[i][t].label(), serial[i][t].label());
+        }
+    });
+
+    num_failed += testing::run_test("crf-decoding-options", [&]()
+    {
+        auto training = make_sentences(300, 47);
+        auto analyzer = sequence::default_pos_analyzer();
+        analyzer.analyze(training);
+
+        std::string prefix = "meta-tmp-crf/decoding";
+        filesystem::make_directory(prefix);
+        sequence::crf model{prefix};
+        model.train(make_params(), training);
+        auto num_labels = model.num_labels();
+
+        // the transitions seen in training, which masking allows
+        std::vector<bool> seen(num_labels * num_labels, false);
+        for (const auto& seq : training)
+            for (uint64_t t = 1; t < seq.size(); ++t)
+                seen[seq[t - 1].label() * num_labels + seq[t].label()] = true;
+
+        using options_type = sequence::crf::decoding_options;
+        auto make_options = [](uint64_t beam_size, bool compact, bool mask)
+        {
+            options_type options;
+            options.beam_size = beam_size;
+            options.compact = compact;
+            options.mask_transitions = mask;
+            return options;
+        };
+        auto exact = model.make_tagger();
+        auto wide = model.make_tagger(make_options(num_labels, false, false));
+        auto wider = model.make_tagger(make_options(100, false, false));
+        auto compact = model.make_tagger(make_options(0, true, false));
+        auto masked = model.make_tagger(make_options(0, false, true));
+        auto all = model.make_tagger(make_options(num_labels, true, true));
+        auto narrow = model.make_tagger(make_options(2, false, false));
+        auto greedy = model.make_tagger(make_options(1, true, false));
+
+        auto labels = [](const sequence::sequence& seq)
+        {
+            std::vector<label_id> lbls;
+            for (const auto& obs : seq)
+                lbls.push_back(obs.label());
+            return lbls;
+        };
+        auto tagged = [&](sequence::crf::tagger& tagger,
+                          sequence::sequence seq)
+        {
+            tagger.tag(seq);
+            return seq;
+        };
+
+        // beam search by scoring every extension of each kept path: the
+        // paths ending in the beam_size best labels, or in every label if
+        // it is zero, are extended, and ties keep the earlier label
+        auto beam_search = [&](const sequence::sequence& seq,
+                               uint64_t beam_size, bool mask)
+        {
+            if (beam_size == 0)
+                beam_size = num_labels;
+            std::vector<std::vector<label_id>> paths(num_labels);
+            std::vector<double> scores(num_labels);
+            sequence::sequence prefix;
+            prefix.add_observation(seq[0]);
+            for (uint32_t lbl = 0; lbl < num_labels; ++lbl)
+            {
+                paths[lbl] = {label_id{lbl}};
+                prefix[0].label(label_id{lbl});
+                scores[lbl] = model.score(prefix);
+            }
+            for (uint64_t t = 1; t < seq.size(); ++t)
+            {
+                prefix.add_observation(seq[t]);
+                std::vector<uint32_t> beam(num_labels);
+                std::iota(beam.begin(), beam.end(), 0);
+                std::stable_sort(beam.begin(), beam.end(),
+                                 [&](uint32_t a, uint32_t b)
+                                 {
+                                     return scores[a] > scores[b];
+                                 });
+                beam.resize(std::min<uint64_t>(beam_size, num_labels));
+                std::sort(beam.begin(), beam.end());
+
+                std::vector<std::vector<label_id>> next(num_labels,
+                                                        paths[0]);
+                std::vector<double> next_scores(
+                    num_labels, std::numeric_limits<double>::lowest());
+                for (const auto& in : beam)
+                {
+                    for (uint32_t out = 0; out < num_labels; ++out)
+                    {
+                        if (mask && !seen[in * num_labels + out])
+                            continue;
+                        for (uint64_t i = 0; i < t; ++i)
+                            prefix[i].label(paths[in][i]);
+                        prefix[t].label(label_id{out});
+                        auto score = model.score(prefix);
+                        if (score > next_scores[out])
+                        {
+                            next_scores[out] = score;
+                            next[out] = paths[in];
+                        }
+                    }
+                }
+                for (uint32_t out = 0; out < num_labels; ++out)
+                    next[out].push_back(label_id{out});
+                paths = std::move(next);
+                scores = std::move(next_scores);
+            }
+            return paths[std::max_element(scores.begin(), scores.end())
+                         - scores.begin()];
+        };
+
+        // the sentences, and their words out of order, so that the best
+        // labels sometimes need a transition never seen in training
+        std::vector<sequence::sequence> sentences;
+        std::mt19937 rng{49};
+        for (const auto& seq : make_sentences(200, 49))
+        {
+            if (seq.size() > 6)
+                continue;
+            sentences.push_back(seq);
+            std::vector<sequence::observation> words{seq.begin(),
+                                                     seq.end() - 1};
+            std::shuffle(words.begin(), words.end(), rng);
+            sequence::sequence shuffled;
+            for (const auto& word : words)
+                shuffled.add_observation(word);
+            shuffled.add_observation(seq[seq.size() - 1]);
+            sentences.push_back(shuffled);
+        }
+
+        uint64_t checked = 0;
+        uint64_t unseen = 0;
+        for (auto& seq : sentences)
+        {
+            analyzer.analyze(seq);
+            ++checked;
+
+            // the best labels, and the best that use only seen
+            // transitions, by scoring every labeling
+            std::vector<label_id> best;
+            std::vector<label_id> best_masked;
+            double best_score = std::numeric_limits<double>::lowest();
+            double best_masked_score = best_score;
+            std::vector<uint32_t> path(seq.size(), 0);
+            while (true)
+            {
+                bool allowed = true;
+                for (uint64_t t = 0; t < seq.size(); ++t)
+                {
+                    seq[t].label(label_id{path[t]});
+                    if (t > 0)
+                        allowed = allowed
+                                  && seen[path[t - 1] * num_labels + path[t]];
+                }
+                auto score = model.score(seq);
+                if (score > best_score)
+                {
+                    best_score = score;
+                    best = labels(seq);
+                }
+                if (allowed && score > best_masked_score)
+                {
+                    best_masked_score = score;
+                    best_masked = labels(seq);
+                }
+
+                uint64_t t = 0;
+                while (t < path.size() && ++path[t] == num_labels)
+                    path[t++] = 0;
+                if (t == path.size())
+                    break;
+            }
+
+            auto result = tagged(exact, seq);
+            ASSERT(labels(result) == best);
+            ASSERT_LESS(std::abs(model.score(result) - best_score), 1e-9);
+
+            // a beam at least as wide as the labels is exact
+            ASSERT(labels(tagged(wide, seq)) == best);
+            ASSERT(labels(tagged(wider, seq)) == best);
+
+            // float weights round the scores only
+            ASSERT(labels(tagged(compact, seq)) == best);
+
+            unseen += best != best_masked;
+            ASSERT(labels(tagged(masked, seq)) == best_masked);
+            ASSERT(labels(tagged(all, seq)) == best_masked);
+
+            ASSERT(beam_search(seq, 0, false) == best);
+            ASSERT(beam_search(seq, 0, true) == best_masked);
+            ASSERT(labels(tagged(narrow, seq)) == beam_search(seq, 2, false));
+            ASSERT(labels(tagged(greedy, seq)) == beam_search(seq, 1, false));
+        }
+        ASSERT_GREATER(checked, 40ul);
+        ASSERT_GREATER(unseen, 0ul);
+    });
+
+    filesystem::remove_all("meta-tmp-crf");
+    return num_failed;
+}
+}
+}
@@ -3,6 +3,8 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+
 #include "test/filesystem_test.h"
 #include "util/filesystem.h"
 
@@ -32,6 +34,36 @@ void num_lines_notrailing()
     }
     ASSERT_EQUAL(filesystem::num_lines("filesystem-temp.txt"), uint64_t{2});
 }
+
+void num_lines_threads()
+{
+    std::string data;
+    for (uint64_t i = 0; i < 1000; ++i)
+        data += std::string(i % 7, 'x') + "\n";
+    {
+        std::ofstream file{"filesystem-temp.txt", std::ios::binary};
+        file.write(data.c_str(), data.length());
+    }
+    for (uint64_t threads : {1, 2, 8})
+        ASSERT_EQUAL(filesystem::num_lines("filesystem-temp.txt", '\n',
+                                           threads),
+                     uint64_t{1000});
+
+    // delimiters are found on either side of word boundaries
+    for (uint64_t first = 0; first < 16; ++first)
+    {
+        auto expected = std::count(data.begin() + first, data.end(), '\n');
+        ASSERT_EQUAL(filesystem::count_delimiters(data.data() + first,
+                                                  data.data() + data.size(),
+                                                  '\n'),
+                     static_cast<uint64_t>(expected));
+    }
+
+    {
+        std::ofstream file{"filesystem-temp.txt", std::ios::binary};
+    }
+    ASSERT_EQUAL(filesystem::num_lines("filesystem-temp.txt"), uint64_t{0});
+}
 }
 
 int filesystem_tests()
@@ -42,6 +74,8 @@ int filesystem_tests()
     filesystem::delete_file("filessytem-temp.txt");
     failed += testing::run_test("num-lines-notrailing", num_lines_notrailing);
     filesystem::delete_file("filessytem-temp.txt");
+    failed += testing::run_test("num-lines-threads", num_lines_threads);
+    filesystem::delete_file("filessytem-temp.txt");
     return failed;
 }
 }
@@ -3,12 +3,26 @@
  * @author Chase Geigle
  */
 
+#include <cstdio>
+#include <fstream>
+#include <iterator>
 #include <vector>
 #include <iostream>
 
+#include "analyzers/analyzer.h"
+#include "analyzers/tokenizers/icu_tokenizer.h"
 #include "analyzers/tokenizers/whitespace_tokenizer.h"
+#include "analyzers/filters/alpha_filter.h"
+#include "analyzers/filters/empty_sentence_filter.h"
 #include "analyzers/filters/english_normalizer.h"
+#include "analyzers/filters/fused_chain.h"
+#include "analyzers/filters/length_filter.h"
+#include "analyzers/filters/list_filter.h"
+#include "analyzers/filters/lowercase_alpha_filter.h"
+#include "analyzers/filters/lowercase_filter.h"
+#include "analyzers/filters/porter2_stemmer.h"
 #include "corpus/document.h"
+#include "cpptoml.h"
 #include "util/shim.h"
 #include "test/filter_test.h"
 #include "test/unit_test.h"
@@ -28,6 +42,43 @@ void check_expected(analyzers::token_stream& filter,
         ASSERT(filter.next() == s);
     ASSERT(!filter);
 }
+
+/**
+ * Checks that a filter chain gives the same tokens through next_into(),
+ * reusing one buffer, as through next().
+ */
+void check_next_into(analyzers::token_stream& filter,
+                     const std::string& content)
+{
+    auto copy = filter.clone();
+    filter.set_content(content);
+    copy->set_content(content);
+    std::string token = "a buffer longer than any of the tokens";
+    while (filter)
+    {
+        ASSERT(*copy);
+        copy->next_into(token);
+        ASSERT_EQUAL(token, filter.next());
+    }
+    ASSERT(!*copy);
+}
+
+/**
+ * Checks that two filter chains give the same tokens.
+ */
+void check_same(analyzers::token_stream& expected,
+                analyzers::token_stream& actual, const std::string& content)
+{
+    expected.set_content(content);
+    actual.set_content(content);
+    while (expected)
+    {
+        ASSERT(actual);
+        ASSERT_EQUAL(actual.next(), expected.next());
+    }
+    ASSERT(!actual);
+    check_next_into(actual, content);
+}
 }
 
 int filter_tests()
@@ -66,6 +117,177 @@ int filter_tests()
         check_expected(*norm, expected);
     });
 
+    num_failed += testing::run_test("filter_next_into", []()
+    {
+        using namespace analyzers;
+        std::unique_ptr<token_stream> stream
+            = make_unique<tokenizers::whitespace_tokenizer>();
+        stream = make_unique<filters::lowercase_filter>(std::move(stream));
+        stream = make_unique<filters::alpha_filter>(std::move(stream));
+        stream = make_unique<filters::length_filter>(std::move(stream), 2, 35);
+        stream = make_unique<filters::list_filter>(
+            std::move(stream), "../data/lemur-stopwords.txt");
+        stream = make_unique<filters::porter2_stemmer>(std::move(stream));
+        stream = make_unique<filters::empty_sentence_filter>(std::move(stream));
+
+        check_next_into(*stream, "The Quick, brown fox's 42 jumps over "
+                                 "the LAZY dogs;\tconnected Connections.");
+        check_next_into(*stream, "Another document, shorter");
+        check_next_into(*stream, "");
+    });
+
+    num_failed += testing::run_test("lowercase_alpha_filter", []()
+    {
+        using namespace analyzers;
+        std::unique_ptr<token_stream> separate
+            = make_unique<tokenizers::whitespace_tokenizer>();
+        separate = make_unique<filters::lowercase_filter>(std::move(separate));
+        separate = make_unique<filters::alpha_filter>(std::move(separate));
+        std::unique_ptr<token_stream> fused
+            = make_unique<tokenizers::whitespace_tokenizer>();
+        fused = make_unique<filters::lowercase_alpha_filter>(std::move(fused));
+
+        for (const auto& content :
+             {"The Quick, brown fox's 42 jumps over the LAZY dogs;",
+              "<s> Tags </s> stay, as-is... ()", "ÉCOLE naïve Straße ΣΊΣΥΦΟΣ",
+              "Mixed ÀSCII and 123 numbers", ""})
+        {
+            separate->set_content(content);
+            fused->set_content(content);
+            while (*separate)
+            {
+                ASSERT(*fused);
+                ASSERT_EQUAL(fused->next(), separate->next());
+            }
+            ASSERT(!*fused);
+            check_next_into(*fused, content);
+        }
+    });
+
+    num_failed += testing::run_test("porter2_stemmer_cache", []()
+    {
+        using namespace analyzers;
+        std::unique_ptr<token_stream> plain
+            = make_unique<tokenizers::whitespace_tokenizer>();
+        plain = make_unique<filters::porter2_stemmer>(std::move(plain));
+        auto cached = make_unique<filters::porter2_stemmer>(
+            make_unique<tokenizers::whitespace_tokenizer>(), 4);
+
+        std::string content = "connected connections connected running "
+                              "runs connected ran connections running "
+                              "generously generous connected";
+        plain->set_content(content);
+        cached->set_content(content);
+        while (*plain)
+        {
+            ASSERT(*cached);
+            ASSERT_EQUAL(cached->next(), plain->next());
+        }
+        ASSERT(!*cached);
+        auto first = cached->cache_stats();
+        ASSERT(first.hits > 0);
+
+        // a clone has a cache of the same size, but its own entries
+        auto copy = cached->clone();
+        check_next_into(*cached, content);
+
+        auto stats = cached->cache_stats();
+        ASSERT_EQUAL(stats.hits + stats.misses,
+                     2 * (first.hits + first.misses));
+        ASSERT(stats.evictions > 0);
+        ASSERT(stats.entries <= cached->cache_size());
+
+        auto& stemmer = dynamic_cast<filters::porter2_stemmer&>(*copy);
+        ASSERT_EQUAL(stemmer.cache_size(), 4ul);
+        ASSERT_EQUAL(stemmer.cache_stats().hits, 0ul);
+        ASSERT_EQUAL(stemmer.cache_stats().entries, 0ul);
+    });
+
+    num_failed += testing::run_test("fused_chain", []()
+    {
+        using namespace analyzers;
+        std::vector<std::string> contents
+            = {"The Quick, brown fox's 42 jumps over the LAZY dogs.",
+               "Hello. The. Of the a. World. Connected connections!", "",
+               "ÉCOLE naïve Straße. Ωmega a-b-c x. The."};
+        std::ifstream in{"../data/sample-document.txt"};
+        contents.emplace_back(std::istreambuf_iterator<char>{in},
+                              std::istreambuf_iterator<char>{});
+
+        auto separate = [](bool empty_sentences, uint64_t cache_size)
+        {
+            std::unique_ptr<token_stream> stream
+                = make_unique<tokenizers::icu_tokenizer>();
+            stream = make_unique<filters::lowercase_filter>(std::move(stream));
+            stream = make_unique<filters::alpha_filter>(std::move(stream));
+            stream
+                = make_unique<filters::length_filter>(std::move(stream), 2, 35);
+            stream = make_unique<filters::list_filter>(
+                std::move(stream), "../data/lemur-stopwords.txt");
+            stream = make_unique<filters::porter2_stemmer>(std::move(stream),
+                                                           cache_size);
+            if (empty_sentences)
+                stream = make_unique<filters::empty_sentence_filter>(
+                    std::move(stream));
+            return stream;
+        };
+
+        {
+            std::ofstream config{"fused-chain-test.toml"};
+            config << "stop-words = \"../data/lemur-stopwords.txt\"\n"
+                   << "[[filter]]\ntype = \"icu-tokenizer\"\n"
+                   << "[[filter]]\ntype = \"lowercase\"\n"
+                   << "[[filter]]\ntype = \"alpha\"\n"
+                   << "[[filter]]\ntype = \"length\"\nmin = 2\nmax = 35\n"
+                   << "[[filter]]\ntype = \"list\"\n"
+                   << "file = \"../data/lemur-stopwords.txt\"\n"
+                   << "[[filter]]\ntype = \"porter2-stemmer\"\n"
+                   << "[[filter]]\ntype = \"empty-sentence\"\n";
+        }
+        auto config = cpptoml::parse_file("fused-chain-test.toml");
+        auto loaded = analyzer::load_filters(config, config);
+        ASSERT(dynamic_cast<filters::fused_chain*>(loaded.get()));
+        auto default_chain = analyzer::default_filter_chain(config);
+        auto unigram_chain = analyzer::default_unigram_chain(config);
+        auto expected = separate(true, 0);
+        for (const auto& content : contents)
+        {
+            check_same(*expected, *loaded, content);
+            check_same(*expected, *default_chain, content);
+        }
+
+        // a stemmer with a cache splits the chain in two fused parts
+        {
+            std::ofstream config{"fused-chain-test.toml"};
+            config << "[[filter]]\ntype = \"icu-tokenizer\"\n"
+                   << "[[filter]]\ntype = \"lowercase-alpha\"\n"
+                   << "[[filter]]\ntype = \"length\"\nmin = 2\nmax = 35\n"
+                   << "[[filter]]\ntype = \"list\"\n"
+                   << "file = \"../data/lemur-stopwords.txt\"\n"
+                   << "[[filter]]\ntype = \"porter2-stemmer\"\n"
+                   << "cache-size = 16\n"
+                   << "[[filter]]\ntype = \"empty-sentence\"\n";
+        }
+        config = cpptoml::parse_file("fused-chain-test.toml");
+        loaded = analyzer::load_filters(config, config);
+        ASSERT(dynamic_cast<filters::fused_chain*>(loaded.get()));
+        expected = separate(true, 16);
+        for (const auto& content : contents)
+            check_same(*expected, *loaded, content);
+
+        std::unique_ptr<token_stream> unigram
+            = make_unique<tokenizers::icu_tokenizer>(true);
+        unigram = make_unique<filters::lowercase_alpha_filter>(
+            std::move(unigram));
+        unigram = make_unique<filters::length_filter>(std::move(unigram), 2, 35);
+        unigram = make_unique<filters::list_filter>(
+            std::move(unigram), "../data/lemur-stopwords.txt");
+        unigram = make_unique<filters::porter2_stemmer>(std::move(unigram));
+        for (const auto& content : contents)
+            check_same(*unigram, *unigram_chain, content);
+        std::remove("fused-chain-test.toml");
+    });
+
     return num_failed;
 }
 }
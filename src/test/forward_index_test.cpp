@@ -3,7 +3,13 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <random>
+
 #include "test/forward_index_test.h"
+#include "util/filesystem.h"
 
 namespace meta
 {
@@ -78,6 +84,16 @@ void check_bcancer_doc_id(Index& idx)
         ASSERT_EQUAL(first - 1, count.first); // - 1 because libsvm format
         ASSERT_APPROX_EQUAL(second, count.second);
     }
+
+    // the libsvm export should round trip through the parser
+    auto line = idx.liblinear_data(d_id);
+    auto exported = io::libsvm_parser::counts(line);
+    ASSERT_EQUAL(exported.size(), pdata->counts().size());
+    for (uint64_t i = 0; i < exported.size(); ++i)
+    {
+        ASSERT_EQUAL(exported[i].first, pdata->counts()[i].first);
+        ASSERT_APPROX_EQUAL(exported[i].second, pdata->counts()[i].second);
+    }
 }
 
 template <class Index>
@@ -95,6 +111,11 @@ void check_ceeaus_doc_id(Index& idx)
         ASSERT_EQUAL(first, count.first);
         ASSERT_APPROX_EQUAL(second, count.second);
     }
+
+    // decoding into a reused buffer gives the same postings
+    std::vector<std::pair<term_id, double>> counts{{term_id{1}, 1.0}};
+    idx.read_counts(d_id, counts);
+    ASSERT(counts == pdata->counts());
 }
 
 void ceeaus_forward_test()
@@ -113,6 +134,141 @@ void bcancer_forward_test()
     check_bcancer_doc_id(*idx);
 }
 
+void check_near_duplicates()
+{
+    filesystem::remove_all("dedup-tmp");
+    filesystem::make_directory("dedup-tmp");
+    filesystem::make_directory("dedup-tmp/dedup");
+
+    // groups of one to four documents whose term sets differ by a term or
+    // two, so every pair is either near or nothing alike; SimHash needs
+    // long documents with varied counts to tell the near ones apart well
+    std::mt19937 rng{47};
+    std::uniform_int_distribution<uint64_t> term_dist{1, 20000};
+    std::vector<std::vector<uint64_t>> docs;
+    for (uint64_t group = 0; group < 80; ++group)
+    {
+        std::vector<uint64_t> base;
+        while (base.size() < 200)
+        {
+            auto term = term_dist(rng);
+            if (std::find(base.begin(), base.end(), term) == base.end())
+                base.push_back(term);
+        }
+        docs.push_back(base);
+        for (uint64_t i = 0; i < group % 4; ++i)
+        {
+            auto variant = base;
+            variant[rng() % variant.size()] = 20001 + docs.size();
+            docs.push_back(variant);
+        }
+    }
+    docs.push_back(docs[7]);
+    std::shuffle(docs.begin(), docs.end(), rng);
+    {
+        std::ofstream corpus{"dedup-tmp/dedup/dedup.dat"};
+        for (auto& doc : docs)
+        {
+            std::sort(doc.begin(), doc.end());
+            corpus << "x";
+            for (const auto& term : doc)
+                corpus << ' ' << term << ':' << 1 + term % 3;
+            corpus << '\n';
+        }
+    }
+    {
+        std::ofstream config{"dedup-tmp/config.toml"};
+        config << "prefix = \"dedup-tmp\"\n"
+               << "corpus-type = \"line-corpus\"\n"
+               << "dataset = \"dedup\"\n"
+               << "forward-index = \"dedup-tmp/fwd\"\n"
+               << "inverted-index = \"dedup-tmp/inv\"\n"
+               << "[[analyzers]]\n"
+               << "method = \"libsvm\"\n";
+    }
+    auto idx = index::make_index<index::forward_index>("dedup-tmp/config.toml");
+    ASSERT_EQUAL(idx->num_docs(), docs.size());
+
+    // a deleted document is never a duplicate, not even of its copy
+    uint64_t deleted = 0;
+    while (std::count(docs.begin(), docs.end(), docs[deleted]) == 1)
+        ++deleted;
+    idx->delete_docs({doc_id{deleted}});
+
+    // the clusters of the pairs whose term sets have a Jaccard similarity
+    // of at least the threshold, found by comparing every pair
+    std::vector<uint64_t> root(docs.size());
+    std::iota(root.begin(), root.end(), 0);
+    auto find = [&](uint64_t d)
+    {
+        while (root[d] != d)
+            d = root[d];
+        return d;
+    };
+    for (uint64_t a = 0; a < docs.size(); ++a)
+    {
+        if (a == deleted)
+            continue;
+        for (uint64_t b = a + 1; b < docs.size(); ++b)
+        {
+            if (b == deleted)
+                continue;
+            std::vector<uint64_t> shared;
+            std::set_intersection(docs[a].begin(), docs[a].end(),
+                                  docs[b].begin(), docs[b].end(),
+                                  std::back_inserter(shared));
+            auto total = docs[a].size() + docs[b].size() - shared.size();
+            if (shared.size() >= 0.8 * total)
+            {
+                auto ra = find(a);
+                auto rb = find(b);
+                root[std::max(ra, rb)] = std::min(ra, rb);
+            }
+        }
+    }
+    std::vector<std::vector<doc_id>> expected;
+    std::vector<uint64_t> cluster_of(docs.size(), docs.size());
+    for (uint64_t d = 0; d < docs.size(); ++d)
+    {
+        auto r = find(d);
+        if (r == d)
+            continue;
+        if (cluster_of[r] == docs.size())
+        {
+            cluster_of[r] = expected.size();
+            expected.push_back({doc_id{r}});
+        }
+        expected[cluster_of[r]].push_back(doc_id{d});
+    }
+    ASSERT_GREATER(expected.size(), 50ul);
+
+    for (auto method : {index::signature_method::minhash,
+                        index::signature_method::simhash})
+    {
+        index::dedup_options options;
+        options.method = method;
+        options.num_threads = 3;
+        if (method == index::signature_method::simhash)
+            options.bands = 8;
+        auto dups = index::find_near_duplicates(*idx, options);
+        ASSERT(dups.clusters() == expected);
+
+        auto filter = dups.filter();
+        uint64_t num_duplicates = 0;
+        for (uint64_t d = 0; d < docs.size(); ++d)
+        {
+            bool duplicate = find(d) != d;
+            num_duplicates += duplicate;
+            ASSERT_EQUAL(dups.is_duplicate(doc_id{d}), duplicate);
+            ASSERT_EQUAL(filter(doc_id{d}), !duplicate);
+        }
+        ASSERT_EQUAL(dups.duplicates().size(), num_duplicates);
+    }
+
+    idx = nullptr;
+    filesystem::remove_all("dedup-tmp");
+}
+
 int forward_index_tests()
 {
     create_config("file");
@@ -139,12 +295,133 @@ int forward_index_tests()
         ceeaus_forward_test();
     });
 
+    num_failed += testing::run_test("forward-index-csr-matrix", [&]()
+    {
+        auto idx = index::make_index<index::forward_index>("test-config.toml");
+
+        // every other document, out of order
+        std::vector<doc_id> docs;
+        for (uint64_t i = idx->num_docs(); i-- > 0;)
+        {
+            if (i % 2 == 0)
+                docs.push_back(doc_id{i});
+        }
+
+        auto check = [&](const index::csr_matrix& matrix)
+        {
+            ASSERT_EQUAL(matrix.rows(), docs.size());
+            uint64_t nonzeros = 0;
+            for (uint64_t r = 0; r < matrix.rows(); ++r)
+            {
+                ASSERT_EQUAL(matrix.doc(r), docs[r]);
+                auto counts = idx->search_primary(docs[r])->counts();
+                auto row = matrix[r];
+                ASSERT_EQUAL(row.size(), counts.size());
+                uint64_t j = 0;
+                for (const auto& count : row)
+                {
+                    ASSERT_EQUAL(count.first, counts[j].first);
+                    ASSERT_APPROX_EQUAL(count.second, counts[j].second);
+                    ASSERT_EQUAL(row.term(j), counts[j].first);
+                    ++j;
+                }
+                ASSERT_EQUAL(j, counts.size());
+                nonzeros += counts.size();
+            }
+            ASSERT_EQUAL(matrix.nonzeros(), nonzeros);
+        };
+
+        auto in_memory = idx->materialize(docs);
+        ASSERT(!in_memory.mapped());
+        check(in_memory);
+
+        {
+            auto mapped = idx->materialize(docs, "ceeaus-matrix");
+            ASSERT(mapped.mapped());
+            check(mapped);
+        }
+
+        auto empty = idx->materialize({});
+        ASSERT_EQUAL(empty.rows(), 0ul);
+        ASSERT_EQUAL(empty.nonzeros(), 0ul);
+        system("rm -f ceeaus-matrix.terms ceeaus-matrix.values");
+    });
+
+    num_failed += testing::run_test("forward-index-hnsw-index", [&]()
+    {
+        auto idx = index::make_index<index::forward_index>("test-config.toml");
+        auto docs = idx->docs();
+        index::hnsw_index hnsw{*idx, docs};
+        ASSERT_EQUAL(hnsw.size(), docs.size());
+
+        // an indexed document is its own nearest neighbor
+        for (uint64_t i = 0; i < docs.size(); i += 37)
+        {
+            auto neighbors
+                = hnsw.neighbors(idx->search_primary(docs[i])->counts(), 5);
+            ASSERT_EQUAL(neighbors.size(), 5ul);
+            ASSERT_APPROX_EQUAL(neighbors[0].second, 1.0);
+            bool found = false;
+            for (uint64_t j = 0; j < neighbors.size(); ++j)
+            {
+                found = found || neighbors[j].first == docs[i];
+                if (j > 0)
+                    ASSERT(neighbors[j].second <= neighbors[j - 1].second);
+            }
+            ASSERT(found);
+        }
+
+        index::hnsw_options opts;
+        opts.links = 1;
+        bool thrown = false;
+        try
+        {
+            index::hnsw_index bad{*idx, docs, opts};
+        }
+        catch (index::hnsw_index::hnsw_index_exception&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+    });
+
     num_failed += testing::run_test("forward-index-read-line-corpus", [&]()
     {
         ceeaus_forward_test();
         system("rm -rf ceeaus-* test-config.toml");
     });
 
+    create_config("line");
+
+    num_failed += testing::run_test("forward-index-build-uninverted", [&]()
+    {
+        system("rm -rf ceeaus-*");
+        std::vector<std::vector<std::pair<term_id, double>>> direct;
+        {
+            auto idx = index::make_index<index::forward_index>(
+                "test-config.toml");
+            for (const auto& d_id : idx->docs())
+                direct.push_back(idx->search_primary(d_id)->counts());
+        }
+
+        system("rm -rf ceeaus-*");
+        {
+            auto config = filesystem::file_text("test-config.toml");
+            std::ofstream out{"test-config.toml"};
+            out << "uninvert = true\n" << config;
+        }
+        ceeaus_forward_test();
+
+        auto idx = index::make_index<index::forward_index>("test-config.toml");
+        ASSERT_EQUAL(direct.size(), idx->num_docs());
+        for (const auto& d_id : idx->docs())
+            ASSERT(direct[d_id] == idx->search_primary(d_id)->counts());
+        system("rm -rf ceeaus-* test-config.toml");
+    });
+
+    num_failed += testing::run_test("forward-index-near-duplicates",
+                                    check_near_duplicates);
+
     create_libsvm_config();
 
     num_failed += testing::run_test("forward-index-build-libsvm", [&]()
@@ -3,8 +3,16 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <queue>
+
 #include "test/graph_test.h"
 #include "graph/algorithms/algorithms.h"
+#include "graph/compressed_graph.h"
+#include "graph/disk_graph.h"
+#include "util/filesystem.h"
 
 namespace meta
 {
@@ -33,6 +41,120 @@ void check_sizes(const Graph& g, uint64_t num_nodes, uint64_t num_edges)
     ASSERT_EQUAL(num_edges, count_edges);
 }
 
+namespace
+{
+
+/**
+ * @return the neighbors of a node, sorted
+ */
+template <class Graph>
+std::vector<node_id> neighbors(const Graph& g, node_id id)
+{
+    std::vector<node_id> ids;
+    for (const auto& p : g.adjacent(id))
+        ids.push_back(p.first);
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+/**
+ * Checks that two graphs have the same nodes and edges.
+ */
+template <class Graph, class Expected>
+void check_same_graph(const Graph& g, const Expected& expected)
+{
+    ASSERT_EQUAL(g.size(), expected.size());
+    ASSERT_EQUAL(g.num_edges(), expected.num_edges());
+    for (uint64_t i = 0; i < expected.size(); ++i)
+        ASSERT(neighbors(g, node_id{i}) == neighbors(expected, node_id{i}));
+}
+
+/**
+ * @return the scores of a centrality result, indexed by node_id
+ */
+std::vector<double> by_id(const graph::algorithms::centrality_result& res)
+{
+    std::vector<double> scores(res.size());
+    for (const auto& p : res)
+        scores[p.first] = p.second;
+    return scores;
+}
+
+/**
+ * Checks that two lists of scores are approximately equal.
+ */
+void check_scores(const std::vector<double>& scores,
+                  const std::vector<double>& expected, double epsilon)
+{
+    ASSERT_EQUAL(scores.size(), expected.size());
+    for (uint64_t i = 0; i < scores.size(); ++i)
+        ASSERT(std::abs(scores[i] - expected[i]) <= epsilon);
+}
+
+/**
+ * @return a random undirected graph (see random_graph)
+ */
+graph::undirected_graph<> random_undirected(uint64_t num_nodes,
+                                            uint64_t num_edges)
+{
+    graph::undirected_graph<> g;
+    graph::algorithms::random_graph(g, num_nodes, num_edges);
+    return g;
+}
+
+/**
+ * @return a random directed graph (see random_graph)
+ */
+graph::directed_graph<> random_directed(uint64_t num_nodes,
+                                        uint64_t num_edges)
+{
+    graph::directed_graph<> g;
+    graph::algorithms::random_graph(g, num_nodes, num_edges);
+    return g;
+}
+
+/**
+ * Finds the distance of every node from a source with a plain, serial
+ * breadth-first search.
+ */
+template <class Graph>
+std::vector<uint64_t> serial_levels(const Graph& g, node_id src)
+{
+    std::vector<uint64_t> levels(g.size(), graph::algorithms::unreachable);
+    std::queue<node_id> queue;
+    levels[src] = 0;
+    queue.push(src);
+    while (!queue.empty())
+    {
+        auto v = queue.front();
+        queue.pop();
+        for (const auto& p : g.adjacent(v))
+        {
+            if (levels[p.first] == graph::algorithms::unreachable)
+            {
+                levels[p.first] = levels[v] + 1;
+                queue.push(p.first);
+            }
+        }
+    }
+    return levels;
+}
+
+/**
+ * Finds the betweenness centrality of every node by adding up the
+ * dependencies on each source one after another.
+ */
+template <class Graph>
+std::vector<double> serial_betweenness(const Graph& g)
+{
+    std::vector<double> cb(g.size(), 0.0);
+    for (uint64_t i = 0; i < g.size(); ++i)
+        graph::algorithms::internal::betweenness_step(g, cb, node_id{i});
+    return cb;
+}
+
+}
+
 int test_undirected()
 {
     return testing::run_test("undirected-graph", [&]()
@@ -160,12 +282,459 @@ int test_betweenness()
     return num_failed;
 }
 
+int test_compressed()
+{
+    return testing::run_test("compressed-graph", [&]()
+    {
+        using namespace graph;
+        auto g = random_undirected(200, 600);
+        compressed_graph<> cg{g};
+        ASSERT(!cg.directed());
+                check_same_graph(cg, g);
+        for (uint64_t i = 0; i < g.size(); ++i)
+        {
+            node_id id{i};
+            for (const auto& p : g.adjacent(id))
+            {
+                ASSERT(cg.edge(id, p.first));
+                ASSERT(cg.edge(p.first, id));
+            }
+            ASSERT(!cg.edge(id, id));
+        }
+
+        auto dg = random_directed(200, 600);
+        compressed_graph<> cdg{dg};
+        ASSERT(cdg.directed());
+                check_same_graph(cdg, dg);
+        // the incoming rows are the transpose of the outgoing ones
+        std::vector<std::vector<node_id>> transpose(dg.size());
+        for (uint64_t i = 0; i < dg.size(); ++i)
+            for (const auto& p : dg.adjacent(node_id{i}))
+                transpose[p.first].push_back(node_id{i});
+        for (uint64_t i = 0; i < dg.size(); ++i)
+        {
+            std::vector<node_id> in;
+            for (const auto& p : cdg.incoming(node_id{i}))
+                in.push_back(p.first);
+            std::sort(in.begin(), in.end());
+            ASSERT(in == transpose[i]);
+        }
+
+        // the algorithms give the same results on either form
+        check_scores(by_id(algorithms::betweenness_centrality(cg)),
+                     by_id(algorithms::betweenness_centrality(g)), 1e-9);
+        for (uint64_t i = 0; i < g.size(); i += 7)
+            ASSERT_APPROX_EQUAL(
+                algorithms::clustering_coefficient(cg, node_id{i}),
+                algorithms::clustering_coefficient(g, node_id{i}));
+    });
+}
+
+int test_betweenness_sampled()
+{
+    int num_failed = 0;
+
+    num_failed += testing::run_test("betweenness-parallel", [&]()
+    {
+        using namespace graph;
+        auto g = random_undirected(300, 900);
+        check_scores(by_id(algorithms::betweenness_centrality(g)),
+                     serial_betweenness(g), 1e-6);
+        auto dg = random_directed(300, 900);
+        check_scores(by_id(algorithms::betweenness_centrality(dg)),
+                     serial_betweenness(dg), 1e-6);
+    });
+
+    num_failed += testing::run_test("betweenness-sampled", [&]()
+    {
+        using namespace graph;
+        auto g = random_undirected(300, 900);
+        auto exact = serial_betweenness(g);
+
+        // sampling every node is the exact computation
+        check_scores(by_id(algorithms::betweenness_centrality(g, 300)), exact,
+                     1e-6);
+        ASSERT_EQUAL(algorithms::betweenness_error_bound(300, 300, 0.1), 0.0);
+
+        // the estimate depends only on the seed, and is within its bound
+        auto estimate = by_id(algorithms::betweenness_centrality(g, 100, 7));
+        check_scores(by_id(algorithms::betweenness_centrality(g, 100, 7)),
+                     estimate, 0.0);
+        auto bound = algorithms::betweenness_error_bound(300, 100, 0.01 / 300);
+        ASSERT(bound > 0.0);
+        check_scores(estimate, exact, bound);
+
+        // more samples tighten the bound
+        ASSERT(algorithms::betweenness_error_bound(300, 200, 0.01) < bound);
+
+        bool thrown = false;
+        try
+        {
+            algorithms::betweenness_centrality(g, 0);
+        }
+        catch (algorithms::graph_algorithm_exception&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+    });
+
+    return num_failed;
+}
+
+int test_pagerank()
+{
+    int num_failed = 0;
+
+    num_failed += testing::run_test("pagerank", [&]()
+    {
+        using namespace graph;
+
+        // a directed cycle leaves every node equally ranked
+        directed_graph<> cycle;
+        for (uint64_t i = 0; i < 5; ++i)
+            cycle.emplace(std::to_string(i));
+        for (uint64_t i = 0; i < 5; ++i)
+            cycle.add_edge(node_id{i}, node_id{(i + 1) % 5});
+        check_scores(by_id(algorithms::pagerank(cycle)),
+                     std::vector<double>(5, 0.2), 1e-9);
+
+        // a serial power iteration, with the score of nodes without
+        // outgoing edges spread over the graph
+        auto g = random_directed(200, 500);
+        auto n = g.size();
+        double damping = 0.85;
+        std::vector<double> v(n, 1.0 / n);
+        for (uint64_t iter = 0; iter < 200; ++iter)
+        {
+            double dangling = 0.0;
+            std::vector<double> w(n, 0.0);
+            for (uint64_t i = 0; i < n; ++i)
+            {
+                const auto& adj = g.adjacent(node_id{i});
+                if (adj.empty())
+                    dangling += v[i];
+                for (const auto& p : adj)
+                    w[p.first] += damping * v[i] / adj.size();
+            }
+            for (auto& score : w)
+                score += (1.0 - damping + damping * dangling) / n;
+            v.swap(w);
+        }
+
+        auto ranks = algorithms::pagerank(g, damping, 200, 1e-12);
+        for (uint64_t i = 1; i < ranks.size(); ++i)
+            ASSERT(ranks[i - 1].second >= ranks[i].second);
+        auto scores = by_id(ranks);
+        ASSERT_APPROX_EQUAL(
+            std::accumulate(scores.begin(), scores.end(), 0.0), 1.0);
+        check_scores(scores, v, 1e-9);
+        check_scores(by_id(algorithms::pagerank(compressed_graph<>{g}, damping,
+                                                200, 1e-12)),
+                     v, 1e-9);
+    });
+
+    num_failed += testing::run_test("eigenvector-centrality", [&]()
+    {
+        using namespace graph;
+
+        // the power iteration of the serial implementation, which
+        // normalized only at the end
+        auto g = random_undirected(100, 400);
+        std::vector<double> v(g.size(), 1.0);
+        for (uint64_t iter = 0; iter < 100; ++iter)
+        {
+            std::vector<double> w(g.size(), 0.0);
+            for (uint64_t i = 0; i < g.size(); ++i)
+                for (const auto& p : g.adjacent(node_id{i}))
+                    w[p.first] += v[i];
+            auto sum = std::accumulate(w.begin(), w.end(), 0.0);
+            for (auto& score : w)
+                score /= sum;
+            v.swap(w);
+        }
+
+        auto scores = by_id(algorithms::eigenvector_centrality(g, 1000, 1e-12));
+        ASSERT_APPROX_EQUAL(
+            std::accumulate(scores.begin(), scores.end(), 0.0), 1.0);
+        check_scores(scores, v, 1e-6);
+
+        // without edges, every node is equally central
+        undirected_graph<> empty;
+        for (uint64_t i = 0; i < 4; ++i)
+            empty.emplace(std::to_string(i));
+        check_scores(by_id(algorithms::eigenvector_centrality(empty)),
+                     std::vector<double>(4, 0.25), 1e-12);
+    });
+
+    return num_failed;
+}
+
+int test_bfs_levels()
+{
+    return testing::run_test("bfs-levels", [&]()
+    {
+        using namespace graph;
+
+        // a sparse graph, with nodes that cannot be reached, and a dense
+        // one, whose large frontiers are expanded bottom-up
+        auto sparse = random_directed(2000, 2500);
+        auto dense = random_undirected(2000, 30000);
+        std::vector<node_id> sources;
+        for (uint64_t i = 0; i < 2000; i += 29)
+            sources.push_back(node_id{i});
+        ASSERT(sources.size() > 64);
+
+        auto sparse_levels = algorithms::bfs_levels(sparse, sources);
+        auto dense_levels = algorithms::bfs_levels(dense, sources);
+        ASSERT_EQUAL(sparse_levels.size(), sources.size());
+        ASSERT_EQUAL(dense_levels.size(), sources.size());
+        bool some_unreachable = false;
+        for (uint64_t i = 0; i < sources.size(); ++i)
+        {
+            auto expected = serial_levels(sparse, sources[i]);
+            ASSERT(sparse_levels[i] == expected);
+            if (i % 10 == 0)
+                ASSERT(algorithms::bfs_levels(sparse, sources[i]) == expected);
+            some_unreachable |= std::count(expected.begin(), expected.end(),
+                                           algorithms::unreachable)
+                                > 0;
+
+            expected = serial_levels(dense, sources[i]);
+            ASSERT(dense_levels[i] == expected);
+            if (i % 10 == 0)
+                ASSERT(algorithms::bfs_levels(dense, sources[i]) == expected);
+        }
+        ASSERT(some_unreachable);
+    });
+}
+
+int test_disk_graph()
+{
+    return testing::run_test("disk-graph", [&]()
+    {
+        using namespace graph;
+        filesystem::remove_all("meta-tmp-graph");
+        ASSERT(!disk_graph::exists("meta-tmp-graph"));
+
+        // a weighted directed graph
+        directed_graph<> dg;
+        for (uint64_t i = 0; i < 50; ++i)
+            dg.emplace(std::to_string(i));
+        for (uint64_t i = 0; i < 50; ++i)
+        {
+            for (uint64_t j = 1; j <= i % 4; ++j)
+            {
+                auto dest = node_id{(i * 7 + j * 13) % 50};
+                if (dest != i && !dg.edge(node_id{i}, dest))
+                    dg.add_edge(default_edge{i + j / 4.0}, node_id{i}, dest);
+            }
+        }
+        compressed_graph<> cdg{dg};
+        disk_graph::save(cdg, "meta-tmp-graph", true);
+        {
+            ASSERT(disk_graph::exists("meta-tmp-graph"));
+            disk_graph loaded{"meta-tmp-graph"};
+            ASSERT(loaded.directed());
+            ASSERT(loaded.weighted());
+            check_same_graph(loaded, cdg);
+            for (uint64_t i = 0; i < 50; ++i)
+            {
+                node_id id{i};
+                for (const auto& p : cdg.adjacent(id))
+                {
+                    auto e = loaded.edge(id, p.first);
+                    ASSERT(e);
+                    ASSERT_APPROX_EQUAL(e->weight, p.second.weight);
+                }
+                ASSERT_EQUAL(loaded.incoming(id).size(),
+                             cdg.incoming(id).size());
+            }
+            check_scores(by_id(algorithms::pagerank(loaded)),
+                         by_id(algorithms::pagerank(cdg)), 1e-12);
+        }
+
+        // an unweighted undirected graph replaces it
+        auto g = random_undirected(300, 900);
+        disk_graph::save(compressed_graph<>{g}, "meta-tmp-graph");
+        {
+            disk_graph loaded{"meta-tmp-graph"};
+            ASSERT(!loaded.directed());
+            ASSERT(!loaded.weighted());
+            check_same_graph(loaded, g);
+            check_scores(by_id(algorithms::betweenness_centrality(loaded)),
+                         by_id(algorithms::betweenness_centrality(g)), 1e-6);
+            ASSERT(algorithms::bfs_levels(loaded, node_id{0})
+                   == serial_levels(g, node_id{0}));
+            ASSERT_APPROX_EQUAL(algorithms::clustering_coefficient(loaded),
+                                algorithms::clustering_coefficient(g));
+        }
+
+        // a graph without edges
+        undirected_graph<> empty;
+        for (uint64_t i = 0; i < 3; ++i)
+            empty.emplace(std::to_string(i));
+        disk_graph::save(compressed_graph<>{empty}, "meta-tmp-graph");
+        {
+            disk_graph loaded{"meta-tmp-graph"};
+            ASSERT_EQUAL(loaded.size(), 3ul);
+            ASSERT_EQUAL(loaded.num_edges(), 0ul);
+        }
+        filesystem::remove_all("meta-tmp-graph");
+    });
+}
+
+int test_triangles()
+{
+    return testing::run_test("triangles", [&]()
+    {
+        using namespace graph;
+
+        // every three nodes of a complete graph form a triangle
+        undirected_graph<> complete;
+        for (uint64_t i = 0; i < 6; ++i)
+            complete.emplace(std::to_string(i));
+        for (uint64_t i = 0; i < 6; ++i)
+            for (uint64_t j = i + 1; j < 6; ++j)
+                complete.add_edge(node_id{i}, node_id{j});
+        ASSERT_EQUAL(algorithms::num_triangles(complete), 20ul);
+        for (const auto& count : algorithms::triangle_counts(complete))
+            ASSERT_EQUAL(count, 10ul);
+        ASSERT_APPROX_EQUAL(algorithms::clustering_coefficient(complete), 1.0);
+
+        // the counts and coefficients of each node, by brute force
+        auto g = random_undirected(150, 1200);
+        std::vector<uint64_t> counts(g.size(), 0);
+        std::vector<double> coefficients(g.size(), 0.0);
+        uint64_t total = 0;
+        for (uint64_t i = 0; i < g.size(); ++i)
+        {
+            auto adj = neighbors(g, node_id{i});
+            uint64_t links = 0;
+            for (uint64_t a = 0; a < adj.size(); ++a)
+                for (uint64_t b = a + 1; b < adj.size(); ++b)
+                    links += static_cast<bool>(g.edge(adj[a], adj[b]));
+            counts[i] = links;
+            total += links;
+            if (adj.size() > 1)
+                coefficients[i]
+                    = 2.0 * links / (adj.size() * (adj.size() - 1));
+        }
+
+        ASSERT(algorithms::triangle_counts(g) == counts);
+        ASSERT_EQUAL(algorithms::num_triangles(g), total / 3);
+        check_scores(algorithms::clustering_coefficients(g), coefficients,
+                     1e-12);
+        for (uint64_t i = 0; i < g.size(); i += 11)
+            ASSERT_APPROX_EQUAL(
+                algorithms::clustering_coefficient(g, node_id{i}),
+                coefficients[i]);
+        ASSERT_APPROX_EQUAL(algorithms::clustering_coefficient(g),
+                            std::accumulate(coefficients.begin(),
+                                            coefficients.end(), 0.0)
+                                / g.size());
+    });
+}
+
+int test_generators()
+{
+    int num_failed = 0;
+
+    num_failed += testing::run_test("erdos-renyi", [&]()
+    {
+        using namespace graph;
+        uint64_t n = 2000;
+        double p = 0.005;
+        auto g = algorithms::erdos_renyi_graph(n, p, false, 3);
+        ASSERT(!g.directed());
+        ASSERT_EQUAL(g.size(), n);
+        check_same_graph(algorithms::erdos_renyi_graph(n, p, false, 3), g);
+
+        // the number of edges is binomial, so within six deviations
+        double pairs = n * (n - 1) / 2.0;
+        double mean = pairs * p;
+        double sd = std::sqrt(pairs * p * (1 - p));
+        ASSERT(std::abs(g.num_edges() - mean) < 6 * sd);
+        for (uint64_t i = 0; i < n; ++i)
+        {
+            for (const auto& p : g.adjacent(node_id{i}))
+            {
+                ASSERT(p.first != i);
+                ASSERT(g.edge(p.first, node_id{i}));
+            }
+        }
+
+        auto dg = algorithms::erdos_renyi_graph(n, p, true, 3);
+        ASSERT(dg.directed());
+        ASSERT(std::abs(dg.num_edges() - 2 * mean) < 6 * std::sqrt(2.0) * sd);
+
+        ASSERT_EQUAL(algorithms::erdos_renyi_graph(50, 0.0).num_edges(), 0ul);
+        ASSERT_EQUAL(algorithms::erdos_renyi_graph(50, 1.0).num_edges(),
+                     50ul * 49 / 2);
+    });
+
+    num_failed += testing::run_test("rmat", [&]()
+    {
+        using namespace graph;
+        auto g = algorithms::rmat_graph(12, 20000, true, 0.57, 0.19, 0.19, 5);
+        ASSERT_EQUAL(g.size(), 4096ul);
+        ASSERT(g.num_edges() <= 20000ul);
+        ASSERT(g.num_edges() > 10000ul);
+        check_same_graph(
+            algorithms::rmat_graph(12, 20000, true, 0.57, 0.19, 0.19, 5), g);
+
+        // no repeated edges or self-loops, and skewed degrees
+        uint64_t max_degree = 0;
+        for (uint64_t i = 0; i < g.size(); ++i)
+        {
+            auto adj = neighbors(g, node_id{i});
+            ASSERT(std::adjacent_find(adj.begin(), adj.end()) == adj.end());
+            ASSERT(!std::binary_search(adj.begin(), adj.end(), node_id{i}));
+            max_degree = std::max<uint64_t>(max_degree, adj.size());
+        }
+        ASSERT(max_degree > 10 * g.num_edges() / g.size());
+    });
+
+    num_failed += testing::run_test("barabasi-albert", [&]()
+    {
+        using namespace graph;
+        uint64_t n = 3000;
+        uint64_t m = 3;
+        auto g = algorithms::barabasi_albert_graph(n, m, 9);
+        ASSERT(!g.directed());
+        ASSERT_EQUAL(g.size(), n);
+        ASSERT(g.num_edges() <= n * m);
+        ASSERT(g.num_edges() > n * m * 3 / 4);
+        check_same_graph(algorithms::barabasi_albert_graph(n, m, 9), g);
+
+        // early nodes gather far more than the average degree
+        uint64_t max_degree = 0;
+        for (uint64_t i = 0; i < g.size(); ++i)
+        {
+            auto adj = neighbors(g, node_id{i});
+            ASSERT(std::adjacent_find(adj.begin(), adj.end()) == adj.end());
+            ASSERT(!std::binary_search(adj.begin(), adj.end(), node_id{i}));
+            max_degree = std::max<uint64_t>(max_degree, adj.size());
+        }
+        ASSERT(max_degree > 5 * 2 * g.num_edges() / g.size());
+    });
+
+    return num_failed;
+}
+
 int graph_tests()
 {
     int num_failed = 0;
     num_failed += test_undirected();
     num_failed += test_directed();
     num_failed += test_betweenness();
+    num_failed += test_compressed();
+    num_failed += test_betweenness_sampled();
+    num_failed += test_pagerank();
+    num_failed += test_bfs_levels();
+    num_failed += test_disk_graph();
+    num_failed += test_triangles();
+    num_failed += test_generators();
     return num_failed;
 }
 }
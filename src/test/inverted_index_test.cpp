@@ -93,13 +93,1130 @@ void check_term_id(Index& idx)
     double second;
     std::ifstream in{"../data/ceeaus-term-count.txt"};
     auto pdata = idx.search_primary(t_id);
+    uint64_t total = 0;
     for (auto& count : pdata->counts())
     {
         in >> first;
         in >> second;
         ASSERT_EQUAL(first, count.first);
         ASSERT_APPROX_EQUAL(second, count.second);
+        total += static_cast<uint64_t>(count.second);
     }
+    ASSERT_EQUAL(idx.doc_freq(t_id), pdata->counts().size());
+    ASSERT_EQUAL(idx.total_num_occurences(t_id), total);
+}
+
+template <class Index>
+void check_term_ids(Index& idx)
+{
+    // every term, in reverse order, with unknown and repeated terms mixed in
+    std::vector<std::string> terms{"not-a-term"};
+    for (uint64_t i = idx.unique_terms(); i > 0; --i)
+    {
+        terms.push_back(idx.term_text(term_id{i - 1}));
+        if (i % 100 == 0)
+            terms.push_back("zzz-not-a-term");
+    }
+    terms.push_back(terms[1]);
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        auto ids = idx.get_term_ids(terms);
+        ASSERT_EQUAL(ids.size(), terms.size());
+        for (uint64_t i = 0; i < terms.size(); ++i)
+            ASSERT_EQUAL(ids[i], idx.get_term_id(terms[i]));
+    }
+    ASSERT_EQUAL(idx.get_term_ids(terms).front(), term_id{idx.unique_terms()});
+    ASSERT_EQUAL(idx.get_term_ids(terms)[1], term_id{idx.unique_terms() - 1});
+    ASSERT(idx.get_term_ids({}).empty());
+}
+
+template <class Index>
+void check_cache_warm_up(Index& idx)
+{
+    auto sorted = [](std::vector<term_id> ids)
+    {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    idx.clear_cache();
+    std::istringstream queries{"Japanese people\n\nJapanese students\n"};
+    auto terms = index::hot_terms_from_queries(idx, queries, 10);
+    auto t_id = idx.get_term_id("japanes");
+    ASSERT(!terms.empty());
+    ASSERT(std::find(terms.begin(), terms.end(), t_id) != terms.end());
+
+    idx.warm_cache(terms, 2);
+    ASSERT(sorted(idx.cached_keys()) == sorted(terms));
+    check_term_id(idx);
+
+    auto saved = sorted(idx.cached_keys());
+    idx.save_cache_keys("cache-keys.txt");
+    idx.clear_cache();
+    ASSERT(idx.cached_keys().empty());
+    ASSERT_EQUAL(idx.load_cache_keys("cache-keys.txt", 2), saved.size());
+    ASSERT(sorted(idx.cached_keys()) == saved);
+    check_term_id(idx);
+
+    auto stats = idx.cache_stats();
+    ASSERT_EQUAL(stats.entries, saved.size());
+    ASSERT(stats.bytes > 0);
+    ASSERT(stats.hits > 0);
+    ASSERT(stats.insertions >= saved.size());
+    filesystem::delete_file("cache-keys.txt");
+    ASSERT_EQUAL(idx.load_cache_keys("cache-keys.txt"), 0ul);
+
+    ASSERT(terms.size() > 1);
+    auto other = terms.front() == t_id ? terms.back() : terms.front();
+    std::istringstream counts{idx.term_text(t_id) + " 5\n"
+                              + idx.term_text(other) + " 9\n"
+                              + "not-a-term 100\n"};
+    auto top = index::hot_terms_from_counts(idx, counts, 10);
+    ASSERT_EQUAL(top.size(), 2ul);
+    ASSERT_EQUAL(top.front(), other);
+    ASSERT_EQUAL(top.back(), t_id);
+}
+
+namespace
+{
+/**
+ * Makes queries of two or three terms spread over the vocabulary of an
+ * index, some of them sharing terms with each other.
+ * @param idx The index to take the terms from
+ * @param terms Receives each distinct term used
+ */
+std::vector<corpus::document> spread_queries(index::inverted_index& idx,
+                                             std::vector<term_id>& terms)
+{
+    std::vector<corpus::document> queries;
+    auto num_terms = idx.unique_terms();
+    for (uint64_t i = 0; i < 8; ++i)
+    {
+        corpus::document query;
+        for (uint64_t j = 0; j < 2 + i % 2; ++j)
+        {
+            term_id t_id{(i * 37 + j * 101) % num_terms};
+            query.increment(idx.term_text(t_id), 1);
+            if (std::find(terms.begin(), terms.end(), t_id) == terms.end())
+                terms.push_back(t_id);
+        }
+        queries.push_back(std::move(query));
+    }
+    return queries;
+}
+}
+
+void check_cursor_cache()
+{
+    auto plain = index::make_index<index::inverted_index>("test-config.toml");
+    auto cached
+        = index::make_index<index::inverted_index, caching::no_evict_cache>(
+            "test-config.toml");
+    ASSERT(!plain->caches_postings());
+    ASSERT(cached->caches_postings());
+    cached->clear_cache();
+
+    std::vector<term_id> terms;
+    auto queries = spread_queries(*plain, terms);
+    index::okapi_bm25 ranker;
+    auto score_all = [&]()
+    {
+        for (auto& query : queries)
+        {
+            auto expected = ranker.score(*plain, query, 20);
+            auto results = ranker.score(*cached, query, 20);
+            ASSERT_EQUAL(results.size(), expected.size());
+            for (std::size_t i = 0; i < results.size(); ++i)
+            {
+                ASSERT_EQUAL(results[i].first, expected[i].first);
+                ASSERT_APPROX_EQUAL(results[i].second, expected[i].second);
+            }
+        }
+    };
+
+    // every term is read from disk once, and is found in the cache after
+    score_all();
+    auto first = cached->cache_stats();
+    ASSERT_EQUAL(first.misses, terms.size());
+    ASSERT_EQUAL(first.entries, terms.size());
+
+    score_all();
+    auto second = cached->cache_stats();
+    ASSERT_EQUAL(second.misses, first.misses);
+    ASSERT(second.hits >= first.hits + terms.size());
+}
+
+void check_index_handle()
+{
+    using cached_type
+        = index::cached_index<index::inverted_index, caching::no_evict_cache>;
+    auto open = []()
+    {
+        return index::make_index<index::inverted_index,
+                                 caching::no_evict_cache>("test-config.toml");
+    };
+
+    auto first = open();
+    first->clear_cache();
+    index::index_handle<cached_type> handle{first};
+    ASSERT_EQUAL(handle.version(), 0ul);
+    ASSERT(handle.snapshot() == first);
+
+    // warm the first version by serving queries from it
+    std::vector<term_id> terms;
+    auto queries = spread_queries(*first, terms);
+    index::okapi_bm25 ranker;
+    std::vector<std::vector<std::pair<doc_id, double>>> expected;
+    for (auto& query : queries)
+        expected.push_back(ranker.score(*handle.snapshot(), query, 20));
+    ASSERT_EQUAL(first->cached_keys().size(), terms.size());
+
+    // a snapshot keeps its version open after it is replaced
+    auto snap = handle.snapshot();
+    std::weak_ptr<cached_type> watch = first;
+    auto second = open();
+    auto replaced = handle.swap(second);
+    ASSERT(replaced == first);
+    ASSERT_EQUAL(handle.version(), 1ul);
+    ASSERT(handle.snapshot() == second);
+    replaced.reset();
+    first.reset();
+    ASSERT(!watch.expired());
+    ASSERT(ranker.score(*snap, queries.front(), 20) == expected.front());
+    snap.reset();
+    ASSERT(watch.expired());
+
+    // a reload carries the cached terms over, so the new version serves
+    // the same queries without reading postings from disk
+    parallel::thread_pool pool{2};
+    second->clear_cache();
+    for (auto& query : queries)
+        ranker.score(*second, query, 20);
+    auto misses = second->cache_stats().misses;
+    auto carry = index::index_handle<cached_type>::carry_cache;
+    auto previous = handle.reload(open, pool, carry).get();
+    ASSERT(previous == second);
+    ASSERT_EQUAL(handle.version(), 2ul);
+    auto third = handle.snapshot();
+    ASSERT(third != second);
+    ASSERT_EQUAL(third->cached_keys().size(), terms.size());
+    ASSERT_EQUAL(second->cache_stats().misses, misses);
+    for (std::size_t i = 0; i < queries.size(); ++i)
+        ASSERT(ranker.score(*third, queries[i], 20) == expected[i]);
+    auto stats = third->cache_stats();
+    ASSERT_EQUAL(stats.misses, 0ul);
+    ASSERT(stats.hits >= terms.size());
+
+    // a reload that fails to open publishes nothing
+    auto failed = handle.reload([]() -> std::shared_ptr<cached_type>
+                                {
+        throw index::inverted_index::inverted_index_exception{"no index"};
+    }, pool);
+    try
+    {
+        failed.get();
+        FAIL("a failed reload should throw");
+    }
+    catch (const index::inverted_index::inverted_index_exception&)
+    {
+        // expected
+    }
+    ASSERT_EQUAL(handle.version(), 2ul);
+    ASSERT(handle.snapshot() == third);
+}
+
+void check_hot_tier()
+{
+    auto idx = index::make_index<index::inverted_index>("test-config.toml");
+
+    // the postings of a sample of terms, read from the postings file
+    auto walk = [](index::postings_cursor cursor)
+    {
+        std::vector<std::pair<doc_id, uint64_t>> postings;
+        for (; !cursor.at_end(); cursor.next())
+            postings.emplace_back(cursor.doc(), cursor.count());
+        return postings;
+    };
+    std::vector<term_id> sample;
+    for (uint64_t t = 0; t < idx->unique_terms(); t += 7)
+        sample.push_back(term_id{t});
+    std::vector<index::inverted_index::postings_data_type::count_t> cold;
+    std::vector<std::vector<std::pair<doc_id, uint64_t>>> cold_walks;
+    for (const auto& t_id : sample)
+    {
+        ASSERT(!idx->in_hot_tier(t_id));
+        cold.push_back(idx->search_primary(t_id)->counts());
+        cold_walks.push_back(walk(idx->cursor(t_id)));
+    }
+
+    // the longest lists, and a few short ones
+    auto hot = index::hot_terms_by_doc_freq(*idx, 20);
+    ASSERT_EQUAL(hot.size(), 20ul);
+    for (uint64_t i = 1; i < hot.size(); ++i)
+        ASSERT(idx->doc_freq(hot[i - 1]) >= idx->doc_freq(hot[i]));
+    hot.push_back(term_id{idx->unique_terms() - 1});
+    hot.push_back(sample[sample.size() / 2]);
+
+    auto check = [&](index::inverted_index& tiered)
+    {
+        for (const auto& t_id : hot)
+            ASSERT(tiered.in_hot_tier(t_id));
+        for (uint64_t i = 0; i < sample.size(); ++i)
+        {
+            auto t_id = sample[i];
+            ASSERT_EQUAL(tiered.in_hot_tier(t_id),
+                         std::find(hot.begin(), hot.end(), t_id)
+                             != hot.end());
+            ASSERT(tiered.search_primary(t_id)->counts() == cold[i]);
+            ASSERT(walk(tiered.cursor(t_id)) == cold_walks[i]);
+            ASSERT_EQUAL(tiered.doc_freq(t_id), cold[i].size());
+
+            // skipping within a hot list lands where it does in a cold one
+            auto cursor = tiered.cursor(t_id);
+            auto middle = cold[i][cold[i].size() / 2].first;
+            cursor.skip_to(middle);
+            ASSERT(!cursor.at_end());
+            ASSERT_EQUAL(cursor.doc(), middle);
+        }
+    };
+
+    ASSERT(idx->tier_postings(hot) > 0);
+    ASSERT(filesystem::file_exists("ceeaus-inv/postings.hot"));
+    check(*idx);
+
+    // the tier is kept with the index
+    {
+        auto reloaded
+            = index::make_index<index::inverted_index>("test-config.toml");
+        check(*reloaded);
+    }
+
+    ASSERT_EQUAL(idx->tier_postings({}), 0ul);
+    ASSERT(!filesystem::file_exists("ceeaus-inv/postings.hot"));
+    for (uint64_t i = 0; i < sample.size(); ++i)
+    {
+        ASSERT(!idx->in_hot_tier(sample[i]));
+        ASSERT(idx->search_primary(sample[i])->counts() == cold[i]);
+    }
+}
+
+namespace
+{
+/**
+ * Writes a configuration for an index of the line corpus of the test
+ * configuration.
+ * @param filename The file to write the configuration to
+ * @param index_name The directory of the index
+ * @param checkpoints The number of parts to build the index in
+ */
+void write_line_config(const std::string& filename,
+                       const std::string& index_name, uint64_t checkpoints)
+{
+    auto config = filesystem::file_text("test-config.toml");
+    auto name = config.find("\"ceeaus-inv\"");
+    config.replace(name, 12, "\"" + index_name + "\"");
+    auto type = config.find("corpus-type = \"");
+    auto end = config.find('"', type + 15);
+    config.replace(type, end - type + 1, "corpus-type = \"line-corpus\"");
+
+    std::ofstream out{filename};
+    out << "build-checkpoints = " << checkpoints << "\n" << config;
+}
+
+/**
+ * Checks that two indexes hold the same documents and postings.
+ * @param idx The index to check
+ * @param expected The index it should equal
+ */
+void check_same_index(index::inverted_index& idx,
+                      index::inverted_index& expected)
+{
+    ASSERT_EQUAL(idx.num_docs(), expected.num_docs());
+    ASSERT_EQUAL(idx.unique_terms(), expected.unique_terms());
+    ASSERT_EQUAL(idx.total_corpus_terms(), expected.total_corpus_terms());
+    for (const auto& d_id : expected.docs())
+    {
+        ASSERT_EQUAL(idx.doc_path(d_id), expected.doc_path(d_id));
+        ASSERT_EQUAL(idx.label(d_id), expected.label(d_id));
+        ASSERT_EQUAL(idx.doc_size(d_id), expected.doc_size(d_id));
+        ASSERT_EQUAL(idx.unique_terms(d_id), expected.unique_terms(d_id));
+    }
+    for (uint64_t t = 0; t < expected.unique_terms(); ++t)
+    {
+        term_id t_id{t};
+        ASSERT_EQUAL(idx.term_text(t_id), expected.term_text(t_id));
+        ASSERT_EQUAL(idx.doc_freq(t_id), expected.doc_freq(t_id));
+        ASSERT(idx.search_primary(t_id)->counts()
+               == expected.search_primary(t_id)->counts());
+    }
+}
+}
+
+void check_completions()
+{
+    auto idx = index::make_index<index::inverted_index>("test-config.toml");
+    auto num_terms = idx->unique_terms();
+
+    // a log of some terms, with repeated queries, queries without a
+    // count, and a query that is not a term
+    {
+        std::ofstream log{"completion-log.txt"};
+        for (uint64_t t = 0; t < num_terms; t += 13)
+        {
+            auto text = idx->term_text(term_id{t});
+            log << text << "\t" << t % 5 << "\n";
+            if (t % 3 == 0)
+                log << text << "\n";
+        }
+        log << "not a term in the index\t1000\n";
+    }
+    std::vector<uint64_t> logged(num_terms, 0);
+    for (uint64_t t = 0; t < num_terms; t += 13)
+        logged[t] = t % 5 + (t % 3 == 0);
+
+    using completion_list = std::vector<std::pair<std::string, uint64_t>>;
+    for (const auto& source : {"term-count", "doc-freq", "query-log"})
+    {
+        index::completion_options options;
+        if (std::string{source} == "doc-freq")
+            options.weight = index::completion_weight::doc_freq;
+        if (std::string{source} == "query-log")
+            options.query_log = "completion-log.txt";
+        index::completion_index::build(*idx, options);
+        ASSERT(index::completion_index::exists(*idx));
+        index::completion_index completions{*idx};
+
+        // every term's weight, computed directly
+        std::vector<uint64_t> weights(num_terms);
+        for (uint64_t t = 0; t < num_terms; ++t)
+        {
+            term_id t_id{t};
+            weights[t] = options.weight == index::completion_weight::doc_freq
+                             ? idx->doc_freq(t_id)
+                             : idx->total_num_occurences(t_id);
+            if (!options.query_log.empty())
+                weights[t] |= logged[t] << 32;
+            ASSERT_EQUAL(completions.weight(t_id), weights[t]);
+        }
+
+        // the heaviest terms of [first, last), lowest ids first among
+        // equals
+        auto scan = [&](uint64_t first, uint64_t last, uint64_t n)
+        {
+            std::vector<std::pair<term_id, uint64_t>> terms;
+            for (auto t = first; t < last; ++t)
+                terms.emplace_back(term_id{t}, weights[t]);
+            std::stable_sort(terms.begin(), terms.end(),
+                             [](const std::pair<term_id, uint64_t>& a,
+                                const std::pair<term_id, uint64_t>& b)
+                             {
+                return a.second > b.second;
+            });
+            if (terms.size() > n)
+                terms.resize(n);
+            return terms;
+        };
+
+        std::vector<std::pair<uint64_t, uint64_t>> ranges{
+            {0, num_terms}, {0, 1}, {5, 5}, {63, 65}, {1, num_terms - 1}};
+        for (uint64_t first = 0; first < num_terms; first += 97)
+            ranges.emplace_back(first, std::min(num_terms, first * 3 + 200));
+        for (const auto& range : ranges)
+        {
+            for (uint64_t n : {1, 10, 1000})
+            {
+                ASSERT(completions.top_terms(term_id{range.first},
+                                             term_id{range.second}, n)
+                       == scan(range.first, range.second, n));
+            }
+        }
+
+        // the prefixes of a sample of terms, and the empty prefix
+        std::vector<std::string> prefixes{""};
+        for (uint64_t t = 0; t < num_terms; t += 31)
+        {
+            auto text = idx->term_text(term_id{t});
+            for (uint64_t len = 1; len <= std::min<uint64_t>(3, text.size());
+                 ++len)
+                prefixes.push_back(text.substr(0, len));
+        }
+        auto ranked = scan(0, num_terms, num_terms);
+        for (const auto& prefix : prefixes)
+        {
+            for (uint64_t n : {1, 10})
+            {
+                completion_list expected;
+                for (const auto& term : ranked)
+                {
+                    if (expected.size() == n)
+                        break;
+                    auto text = idx->term_text(term.first);
+                    if (text.compare(0, prefix.size(), prefix) == 0)
+                        expected.emplace_back(text, term.second);
+                }
+                ASSERT(completions.complete(prefix, n) == expected);
+            }
+        }
+    }
+    filesystem::delete_file("completion-log.txt");
+}
+
+void check_checkpoints()
+{
+    write_line_config("ckpt-ref-config.toml", "ceeaus-ckpt-ref", 0);
+    write_line_config("ckpt-config.toml", "ceeaus-ckpt", 3);
+    filesystem::remove_all("ceeaus-ckpt-ref");
+    filesystem::remove_all("ceeaus-ckpt");
+    auto expected
+        = index::make_index<index::inverted_index>("ckpt-ref-config.toml");
+
+    auto rebuild = [&]()
+    {
+        {
+            auto idx
+                = index::make_index<index::inverted_index>("ckpt-config.toml");
+            check_same_index(*idx, *expected);
+        }
+        ASSERT(!filesystem::file_exists("ceeaus-ckpt.plan"));
+        for (uint64_t i = 0; i < 3; ++i)
+            ASSERT(!filesystem::file_exists(
+                index::part_name("ckpt-config.toml", i)));
+        filesystem::remove_all("ceeaus-ckpt");
+    };
+
+    // uninterrupted
+    rebuild();
+
+    // interrupted after the first and last parts were built
+    index::plan_build("ckpt-config.toml", 3);
+    index::build_part("ckpt-config.toml", 0);
+    index::build_part("ckpt-config.toml", 2);
+    ASSERT(index::part_built("ckpt-config.toml", 0));
+    ASSERT(!index::part_built("ckpt-config.toml", 1));
+    rebuild();
+
+    // interrupted while merging the parts, leaving an incomplete index
+    index::plan_build("ckpt-config.toml", 3);
+    for (uint64_t i = 0; i < 3; ++i)
+        index::build_part("ckpt-config.toml", i);
+    filesystem::make_directory("ceeaus-ckpt");
+    filesystem::copy_file("ckpt-config.toml", "ceeaus-ckpt/config.toml");
+    rebuild();
+
+    // a plan left by a build with other settings is replaced
+    index::plan_build("ckpt-config.toml", 2);
+    index::build_part("ckpt-config.toml", 0);
+    rebuild();
+
+    expected = nullptr;
+    filesystem::remove_all("ceeaus-ckpt-ref");
+    filesystem::delete_file("ckpt-ref-config.toml");
+    filesystem::delete_file("ckpt-config.toml");
+}
+
+void check_distributed_build()
+{
+    write_line_config("dist-ref-config.toml", "ceeaus-dist-ref", 0);
+    write_line_config("dist-config.toml", "ceeaus-dist", 0);
+    filesystem::remove_all("ceeaus-dist-ref");
+    auto expected
+        = index::make_index<index::inverted_index>("dist-ref-config.toml");
+
+    for (uint64_t num_parts : {1, 2, 5})
+    {
+        filesystem::remove_all("ceeaus-dist");
+        auto plan = index::plan_build("dist-config.toml", num_parts);
+        ASSERT_EQUAL(plan.num_docs, expected->num_docs());
+        ASSERT_EQUAL(plan.parts.size(), num_parts);
+        ASSERT_EQUAL(index::load_build_plan("dist-config.toml").parts.size(),
+                     num_parts);
+
+        // the parts are independent, so their order does not matter
+        for (uint64_t i = num_parts; i > 0; --i)
+        {
+            ASSERT(!index::part_built("dist-config.toml", i - 1));
+            index::build_part("dist-config.toml", i - 1);
+            ASSERT(index::part_built("dist-config.toml", i - 1));
+        }
+
+        // each part holds its documents' postings, numbered from zero
+        auto parts = index::load_parts("dist-config.toml");
+        ASSERT_EQUAL(parts.size(), num_parts);
+        for (uint64_t i = 0; i < num_parts; ++i)
+        {
+            auto& part = *parts[i];
+            uint64_t first{plan.parts[i].first_id};
+            ASSERT_EQUAL(part.num_docs(), plan.parts[i].num_docs);
+            ASSERT(part.unique_terms() <= expected->unique_terms());
+            for (uint64_t t = 0; t < part.unique_terms(); ++t)
+            {
+                term_id t_id{t};
+                auto text = part.term_text(t_id);
+                auto pdata
+                    = expected->search_primary(expected->get_term_id(text));
+                std::vector<std::pair<doc_id, uint64_t>> in_part;
+                for (const auto& count : pdata->counts())
+                {
+                    uint64_t d{count.first};
+                    if (d >= first && d < first + part.num_docs())
+                        in_part.emplace_back(doc_id{d - first},
+                                             count.second);
+                }
+                std::vector<std::pair<doc_id, uint64_t>> actual;
+                auto part_pdata = part.search_primary(t_id);
+                for (const auto& count : part_pdata->counts())
+                    actual.emplace_back(count.first, count.second);
+                ASSERT(actual == in_part);
+            }
+        }
+        parts.clear();
+
+        index::write_shard_configs("dist-config.toml", "dist-shards.toml");
+        {
+            auto sharded = index::sharded_index::load("dist-shards.toml");
+            ASSERT_EQUAL(sharded->num_shards(), num_parts);
+            ASSERT_EQUAL(sharded->num_docs(), expected->num_docs());
+            for (const auto& d_id : expected->docs())
+                ASSERT_EQUAL(sharded->doc_path(d_id),
+                             expected->doc_path(d_id));
+        }
+
+        {
+            auto merged = index::merge_parts("dist-config.toml");
+            check_same_index(*merged, *expected);
+        }
+        index::remove_build("dist-config.toml");
+        ASSERT(!filesystem::file_exists("ceeaus-dist.plan"));
+        for (uint64_t i = 0; i < num_parts; ++i)
+            ASSERT(!filesystem::file_exists(
+                index::part_name("dist-config.toml", i)));
+    }
+
+    expected = nullptr;
+    filesystem::remove_all("ceeaus-dist");
+    filesystem::remove_all("ceeaus-dist-ref");
+    filesystem::delete_file("dist-config.toml");
+    filesystem::delete_file("dist-ref-config.toml");
+    filesystem::delete_file("dist-shards.toml");
+}
+
+void check_doc_metadata(index::inverted_index& idx)
+{
+    uint64_t total = 0;
+    for (const auto& d_id : idx.docs())
+    {
+        auto info = idx.doc_info(d_id);
+        ASSERT_EQUAL(info.length, idx.doc_size(d_id));
+        ASSERT_EQUAL(info.unique_terms, idx.unique_terms(d_id));
+        ASSERT(info.unique_terms <= info.length);
+        total += info.length;
+    }
+    ASSERT_EQUAL(total, idx.total_corpus_terms());
+    for (uint64_t t = 0; t < idx.unique_terms(); t += 13)
+    {
+        term_id t_id{t};
+        ASSERT_APPROX_EQUAL(idx.collection_probability(t_id),
+                            static_cast<double>(idx.total_num_occurences(t_id))
+                                / total);
+    }
+
+    // lengths that need 41 bits (so records straddle words) and unique
+    // term counts that are all zero (so that field takes no bits)
+    std::vector<uint64_t> lengths;
+    {
+        util::disk_vector<double> length_col{"meta-tmp-lengths.bin", 1000};
+        util::disk_vector<uint64_t> unique_col{"meta-tmp-unique.bin", 1000};
+        for (uint64_t i = 0; i < 1000; ++i)
+        {
+            lengths.push_back((i * 2654435761ul) % (uint64_t{1} << 41));
+            length_col[i] = static_cast<double>(lengths.back());
+            unique_col[i] = 0;
+        }
+        length_col[999] = static_cast<double>(uint64_t{1} << 40);
+        lengths[999] = uint64_t{1} << 40;
+        index::doc_metadata::write("meta-tmp-metadata.bin", length_col,
+                                   unique_col);
+    }
+    {
+        index::doc_metadata meta{"meta-tmp-metadata.bin"};
+        ASSERT_EQUAL(meta.size(), 1000ul);
+        ASSERT_EQUAL(meta.record_bits(), 41ul);
+        for (uint64_t i = 0; i < 1000; ++i)
+        {
+            auto record = meta.at(doc_id{i});
+            ASSERT_EQUAL(record.length, lengths[i]);
+            ASSERT_EQUAL(record.unique_terms, 0ul);
+            ASSERT_EQUAL(meta.length(doc_id{i}), lengths[i]);
+        }
+    }
+    filesystem::delete_file("meta-tmp-lengths.bin");
+    filesystem::delete_file("meta-tmp-unique.bin");
+    filesystem::delete_file("meta-tmp-metadata.bin");
+}
+
+void check_fields()
+{
+    filesystem::remove_all("meta-tmp-fields");
+    filesystem::make_directory("meta-tmp-fields");
+    filesystem::make_directory("meta-tmp-fields/tiny");
+    {
+        std::ofstream docs{"meta-tmp-fields/tiny/tiny.dat"};
+        docs << "cat sat\ndog ran\ncat ran\nbird flew\n";
+        std::ofstream fields{"meta-tmp-fields/tiny/tiny.fields"};
+        fields << "1990\t0.5\ten\n2000\t1.5\tde\n2010\t-2\ten\n"
+               << "2020\t3.25\tfr\n";
+    }
+
+    // the test configuration, pointed at the tiny corpus
+    {
+        std::istringstream base{filesystem::file_text("test-config.toml")};
+        std::ofstream config{"meta-tmp-fields/config.toml"};
+        std::string line;
+        while (std::getline(base, line))
+        {
+            if (line.find("prefix") == 0)
+                line = "prefix = \"meta-tmp-fields\"";
+            else if (line.find("dataset") == 0)
+                line = "dataset = \"tiny\"";
+            else if (line.find("corpus-type") == 0)
+                line = "corpus-type = \"line-corpus\"";
+            else if (line.find("forward-index") == 0)
+                line = "forward-index = \"meta-tmp-fields/fwd\"";
+            else if (line.find("inverted-index") == 0)
+                line = "inverted-index = \"meta-tmp-fields/inv\"";
+            config << line << "\n";
+        }
+        config << "\n[[fields]]\nname = \"year\"\ntype = \"int\"\n"
+               << "[[fields]]\nname = \"score\"\ntype = \"double\"\n"
+               << "[[fields]]\nname = \"lang\"\ntype = \"string\"\n";
+    }
+
+    auto check = [](const index::disk_index& idx)
+    {
+        ASSERT(idx.has_fields());
+        const auto& fields = idx.fields();
+        ASSERT_EQUAL(fields.fields().size(), 3ul);
+        ASSERT(fields.contains("year"));
+        ASSERT(!fields.contains("month"));
+        ASSERT_EQUAL(fields.int_value("year", doc_id{2}), 2010);
+        ASSERT_APPROX_EQUAL(fields.real_value("score", doc_id{3}), 3.25);
+        ASSERT_EQUAL(fields.string_value("lang", doc_id{1}), "de");
+
+        auto values = fields.values(doc_id{2});
+        ASSERT_EQUAL(values.size(), 3ul);
+        ASSERT_EQUAL(values[0], "2010");
+        ASSERT_EQUAL(values[2], "en");
+
+        auto recent = fields.int_range("year", 2000, 2015);
+        ASSERT(!recent(doc_id{0}));
+        ASSERT(recent(doc_id{1}));
+        ASSERT(recent(doc_id{2}));
+        ASSERT(!recent(doc_id{3}));
+        ASSERT(!recent(doc_id{4}));
+        auto positive = fields.real_range("score", 0, 10);
+        ASSERT(!positive(doc_id{2}));
+        auto english = fields.string_equals("lang", "en");
+        ASSERT(english(doc_id{0}) && english(doc_id{2}));
+        ASSERT(!english(doc_id{3}));
+
+        bool thrown = false;
+        try
+        {
+            fields.int_value("lang", doc_id{0});
+        }
+        catch (index::field_store::field_store_exception&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+    };
+
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        // built on the first pass, and loaded on the second
+        auto idx
+            = index::make_index<index::inverted_index>(
+                "meta-tmp-fields/config.toml");
+        check(*idx);
+
+        index::okapi_bm25 ranker;
+        corpus::document query;
+        query.content(idx->term_text(*idx->vocabulary().find("cat")));
+        auto all = ranker.score(*idx, query, 10);
+        ASSERT_EQUAL(all.size(), 4ul);
+        auto results = ranker.score(*idx, query, 10,
+                                    idx->fields().int_range("year", 2000,
+                                                            2020));
+        ASSERT(!results.empty());
+        ASSERT_EQUAL(results[0].first, doc_id{2});
+        for (const auto& result : results)
+            ASSERT(result.first != doc_id{0});
+
+        auto fwd = index::make_index<index::forward_index>(
+            "meta-tmp-fields/config.toml");
+        check(*fwd);
+    }
+    filesystem::remove_all("meta-tmp-fields");
+}
+
+void check_gdsf_cache()
+{
+    using pdata_t = index::postings_data<term_id, doc_id>;
+    auto make = [](uint64_t t, uint64_t length)
+    {
+        auto pdata = std::make_shared<pdata_t>(term_id{t});
+        pdata_t::count_t counts;
+        for (uint64_t i = 0; i < length; ++i)
+            counts.emplace_back(doc_id{i}, 1.0);
+        pdata->set_counts(std::move(counts));
+        return pdata;
+    };
+    auto bytes = [](const std::shared_ptr<pdata_t>& pdata)
+    {
+        return sizeof(pdata_t) + pdata->bytes_used();
+    };
+    auto contains = [](const std::vector<term_id>& keys, uint64_t t)
+    {
+        return std::find(keys.begin(), keys.end(), term_id{t}) != keys.end();
+    };
+
+    auto small_bytes = bytes(make(0, 10));
+    auto large_bytes = bytes(make(0, 1000));
+    auto max_bytes = large_bytes + 4 * small_bytes;
+    caching::gdsf_cache<term_id, std::shared_ptr<pdata_t>> cache{max_bytes};
+
+    // four popular short lists, then a long one that still fits
+    for (uint64_t t = 2; t < 6; ++t)
+    {
+        for (uint64_t i = 0; i < 3; ++i)
+            cache.find(term_id{t});
+        cache.insert(term_id{t}, make(t, 10));
+    }
+    cache.find(term_id{1});
+    cache.insert(term_id{1}, make(1, 1000));
+    ASSERT_EQUAL(cache.size(), 5ul);
+    ASSERT_EQUAL(cache.bytes_used(), max_bytes);
+    ASSERT(cache.find(term_id{3}));
+
+    // a second long list replaces the first, not the popular short ones
+    cache.find(term_id{7});
+    cache.insert(term_id{7}, make(7, 1000));
+    auto keys = cache.keys();
+    ASSERT(!contains(keys, 1) && contains(keys, 7));
+    ASSERT_EQUAL(cache.bytes_used(), max_bytes);
+
+    // a short list is worth more per byte than a long one
+    cache.find(term_id{8});
+    cache.insert(term_id{8}, make(8, 10));
+    keys = cache.keys();
+    ASSERT(!contains(keys, 7) && contains(keys, 8));
+    for (uint64_t t = 2; t < 6; ++t)
+        ASSERT(contains(keys, t));
+
+    // a long list seen once is not admitted over the short ones, and a
+    // value larger than the cache never is
+    cache.find(term_id{9});
+    cache.insert(term_id{9}, make(9, 1000));
+    cache.insert(term_id{10}, make(10, 2000));
+    keys = cache.keys();
+    ASSERT_EQUAL(keys.size(), 5ul);
+    ASSERT(!contains(keys, 9) && !contains(keys, 10));
+    ASSERT(cache.bytes_used() <= max_bytes);
+
+    auto stats = cache.stats();
+    ASSERT_EQUAL(stats.entries, 5ul);
+    ASSERT_EQUAL(stats.bytes, cache.bytes_used());
+    ASSERT_EQUAL(stats.evictions, 2ul);
+    ASSERT_EQUAL(stats.insertions, 7ul);
+    ASSERT_EQUAL(stats.hits, 1ul);
+    ASSERT_EQUAL(stats.misses, 16ul);
+
+    cache.clear();
+    ASSERT_EQUAL(cache.size(), 0ul);
+    ASSERT_EQUAL(cache.bytes_used(), 0ul);
+}
+
+void check_concurrent_map()
+{
+    // few buckets, so that the writers often race on the same one
+    caching::concurrent_map<uint64_t, uint64_t> map{16};
+    std::atomic<bool> found_all{true};
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&, t]()
+                             {
+            for (uint64_t i = t; i < 2000; i += 4)
+            {
+                map.insert(i, i * 2);
+                auto found = map.find(i);
+                if (!found || *found != i * 2)
+                    found_all = false;
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    ASSERT(found_all);
+
+    auto keys = map.keys();
+    std::sort(keys.begin(), keys.end());
+    ASSERT_EQUAL(keys.size(), 2000ul);
+    for (uint64_t i = 0; i < keys.size(); ++i)
+    {
+        ASSERT_EQUAL(keys[i], i);
+        ASSERT_EQUAL(*map.find(i), i * 2);
+    }
+
+    map.emplace(uint64_t{7}, uint64_t{1});
+    ASSERT_EQUAL(*map.find(7), 14ul);
+    map.insert(7, 1);
+    ASSERT_EQUAL(*map.find(7), 1ul);
+    ASSERT(!map.find(2000));
+}
+
+void check_positions(index::inverted_index& idx)
+{
+    auto config = cpptoml::parse_file("test-config.toml");
+    auto analyzer = analyzers::analyzer::load(config);
+    auto docs = corpus::corpus::load("test-config.toml");
+
+    auto contains = [](const std::vector<std::pair<doc_id, uint64_t>>& results,
+                       doc_id d_id)
+    {
+        return std::any_of(results.begin(), results.end(),
+                           [&](const std::pair<doc_id, uint64_t>& result)
+                           {
+            return result.first == d_id;
+        });
+    };
+
+    while (docs->has_next())
+    {
+        auto doc = docs->next();
+        if (doc.id() % 50 != 0)
+            continue;
+
+        analyzers::analyzer::position_map positions;
+        analyzer->tokenize_positions(doc, positions);
+
+        std::vector<term_id> sequence(doc.length());
+        for (const auto& term : positions)
+        {
+            auto t_id = idx.get_term_id(term.first);
+            auto cursor = idx.positions(t_id);
+            cursor.skip_to(doc.id());
+            ASSERT(!cursor.at_end());
+            ASSERT_EQUAL(cursor.doc(), doc.id());
+            ASSERT_EQUAL(cursor.count(), term.second.size());
+            ASSERT(cursor.positions() == term.second);
+            for (const auto& position : term.second)
+                sequence[position] = t_id;
+        }
+
+        if (sequence.size() < 3)
+            continue;
+
+        auto mid = sequence.size() / 2;
+        index::phrase_query phrase{
+            {sequence[mid - 1], sequence[mid], sequence[mid + 1]}};
+        ASSERT(contains(phrase.search(idx), doc.id()));
+
+        // dropping the middle term still matches once a gap is allowed
+        index::phrase_query exact{{sequence[mid - 1], sequence[mid + 1]}};
+        index::phrase_query near{{sequence[mid - 1], sequence[mid + 1]}, 1};
+        auto near_results = near.search(idx);
+        ASSERT(contains(near_results, doc.id()));
+        ASSERT(exact.search(idx).size() <= near_results.size());
+    }
+}
+
+void check_postings_buffer()
+{
+    // many keys share long prefixes so that the radix sort recurses
+    std::map<std::string, std::map<doc_id, double>> expected;
+    index::postings_buffer<std::string, doc_id> buffer;
+    std::mt19937 rng{47};
+    for (uint64_t i = 0; i < 20000; ++i)
+    {
+        std::string key(rng() % 40, 'a');
+        key += std::to_string(rng() % 1000);
+        doc_id d_id{rng() % 500};
+        double amount = rng() % 3 + 1;
+        buffer.increase_count(key, d_id, amount);
+        expected[key][d_id] += amount;
+    }
+    ASSERT(!buffer.empty());
+    ASSERT_GREATER(buffer.bytes_used(), 0ul);
+
+    auto pdata = buffer.extract();
+    ASSERT(buffer.empty());
+    ASSERT_EQUAL(pdata.size(), expected.size());
+
+    auto it = expected.begin();
+    for (const auto& pd : pdata)
+    {
+        ASSERT_EQUAL(pd.primary_key(), it->first);
+        ASSERT_EQUAL(pd.counts().size(), it->second.size());
+        auto count_it = it->second.begin();
+        for (const auto& count : pd.counts())
+        {
+            ASSERT_EQUAL(count.first, count_it->first);
+            ASSERT_APPROX_EQUAL(count.second, count_it->second);
+            ++count_it;
+        }
+        ++it;
+    }
+}
+
+/**
+ * Chunks of (string, doc_id) postings, for testing chunk merging.
+ */
+struct string_chunks
+{
+    using index_pdata_type = index::postings_data<std::string, doc_id>;
+};
+
+void check_chunk_merge(uint64_t num_parts)
+{
+    system("rm -rf chunk-test && mkdir chunk-test");
+    std::map<std::string, std::map<doc_id, double>> expected;
+    index::chunk_handler<string_chunks> handler{"chunk-test"};
+    std::mt19937 rng{47};
+    for (uint64_t c = 0; c < 6; ++c)
+    {
+        // each producer writes its own chunk when it is destroyed, and the
+        // chunks share both primary and secondary keys
+        auto producer = handler.make_producer();
+        for (uint64_t i = 0; i < 200; ++i)
+        {
+            doc_id d_id{rng() % 300};
+            std::unordered_map<std::string, double> counts;
+            for (uint64_t j = 0; j < 20; ++j)
+                counts[std::to_string(rng() % 2000)] += 1;
+            producer(d_id, counts);
+            for (const auto& count : counts)
+                expected[count.first][d_id] += count.second;
+        }
+    }
+    ASSERT_EQUAL(handler.size(), 6u);
+
+    std::vector<std::vector<string_chunks::index_pdata_type>> parts(
+        num_parts);
+    handler.merge_chunks(num_parts,
+                         [&](uint64_t part,
+                             string_chunks::index_pdata_type&& pdata)
+                         {
+        parts[part].push_back(std::move(pdata));
+    });
+    ASSERT_EQUAL(handler.unique_primary_keys(), expected.size());
+
+    auto it = expected.begin();
+    for (const auto& part : parts)
+    {
+        for (const auto& pd : part)
+        {
+            ASSERT(it != expected.end());
+            ASSERT_EQUAL(pd.primary_key(), it->first);
+            ASSERT_EQUAL(pd.counts().size(), it->second.size());
+            auto count_it = it->second.begin();
+            for (const auto& count : pd.counts())
+            {
+                ASSERT_EQUAL(count.first, count_it->first);
+                ASSERT_APPROX_EQUAL(count.second, count_it->second);
+                ++count_it;
+            }
+            ++it;
+        }
+    }
+    ASSERT(it == expected.end());
+    system("rm -rf chunk-test");
+}
+
+void check_term_freqs(index::inverted_index& idx)
+{
+    // pairs from some postings lists, with documents that follow each
+    // posting (and may not contain the term) mixed in
+    std::vector<std::pair<term_id, doc_id>> pairs;
+    for (uint64_t t = 0; t < idx.unique_terms(); t += 53)
+    {
+        term_id t_id{t};
+        auto pdata = idx.search_primary(t_id);
+        for (const auto& posting : pdata->counts())
+        {
+            pairs.emplace_back(t_id, posting.first);
+            if (posting.first + 1 < idx.num_docs())
+                pairs.emplace_back(t_id, doc_id{posting.first + 1});
+        }
+    }
+    pairs.emplace_back(term_id{0}, doc_id{0});
+
+    std::reverse(pairs.begin(), pairs.end());
+    auto freqs = idx.term_freqs(pairs);
+    ASSERT_EQUAL(freqs.size(), pairs.size());
+    uint64_t found = 0;
+    for (uint64_t i = 0; i < pairs.size(); ++i)
+    {
+        ASSERT_EQUAL(freqs[i], idx.term_freq(pairs[i].first, pairs[i].second));
+        found += freqs[i] > 0;
+    }
+    ASSERT(found > 0 && found < pairs.size());
+
+    std::sort(pairs.begin(), pairs.end());
+    auto sorted = idx.term_freqs(pairs);
+    for (uint64_t i = 0; i < pairs.size(); ++i)
+        ASSERT_EQUAL(sorted[i],
+                     idx.term_freq(pairs[i].first, pairs[i].second));
+}
+
+void check_merge(const std::shared_ptr<index::inverted_index>& idx)
+{
+    auto config = filesystem::file_text("test-config.toml");
+    auto name = config.find("\"ceeaus-inv\"");
+    config.replace(name, 12, "\"ceeaus-merged\"");
+    {
+        std::ofstream out{"merge-config.toml"};
+        out << config;
+    }
+
+    auto merged = index::merge_indexes({idx, idx}, "merge-config.toml");
+    auto num_docs = idx->num_docs();
+    ASSERT_EQUAL(merged->num_docs(), 2 * num_docs);
+    ASSERT_EQUAL(merged->unique_terms(), idx->unique_terms());
+    ASSERT_EQUAL(merged->total_corpus_terms(), 2 * idx->total_corpus_terms());
+    ASSERT(merged->has_positions());
+    for (uint64_t d = 0; d < num_docs; d += 37)
+    {
+        doc_id d_id{d};
+        doc_id copy{d + num_docs};
+        ASSERT_EQUAL(merged->doc_size(copy), idx->doc_size(d_id));
+        ASSERT_EQUAL(merged->doc_path(copy), idx->doc_path(d_id));
+        ASSERT_EQUAL(merged->label(copy), idx->label(d_id));
+    }
+
+    for (uint64_t t = 0; t < idx->unique_terms(); t += 11)
+    {
+        term_id t_id{t};
+        ASSERT_EQUAL(merged->term_text(t_id), idx->term_text(t_id));
+        ASSERT_EQUAL(merged->doc_freq(t_id), 2 * idx->doc_freq(t_id));
+        auto expected = idx->search_primary(t_id)->counts();
+        auto size = expected.size();
+        for (uint64_t i = 0; i < size; ++i)
+            expected.emplace_back(doc_id{expected[i].first + num_docs},
+                                  expected[i].second);
+        ASSERT(merged->search_primary(t_id)->counts() == expected);
+
+        auto cur = idx->positions(t_id);
+        auto merged_cur = merged->positions(t_id);
+        merged_cur.skip_to(doc_id{cur.doc() + num_docs});
+        ASSERT_EQUAL(merged_cur.doc(), doc_id{cur.doc() + num_docs});
+        ASSERT(merged_cur.positions() == cur.positions());
+    }
+
+    merged = nullptr;
+    filesystem::remove_all("ceeaus-merged");
+    filesystem::delete_file("merge-config.toml");
 }
 
 int inverted_index_tests()
@@ -107,6 +1224,16 @@ int inverted_index_tests()
     create_config("file");
 
     int num_failed = 0;
+
+    num_failed += testing::run_test("postings-buffer", [&]()
+                                    {
+        check_postings_buffer();
+    });
+    num_failed += testing::run_test("chunk-merge", [&]()
+                                    {
+        check_chunk_merge(1);
+        check_chunk_merge(4);
+    });
     num_failed += testing::run_test("inverted-index-build-file-corpus", [&]()
                                     {
         system("rm -rf ceeaus-inv");
@@ -116,6 +1243,35 @@ int inverted_index_tests()
         check_ceeaus_expected(*idx);
     });
 
+    num_failed += testing::run_test("file-corpus-prefetch", [&]()
+    {
+        auto config = cpptoml::parse_file("test-config.toml");
+        auto ana = analyzers::analyzer::load(config);
+        auto prefix = *config.get_as<std::string>("prefix") + "/ceeaus/";
+        auto list = prefix + "ceeaus-full-corpus.txt";
+
+        // a small window, and one larger than the corpus
+        for (uint64_t prefetch : {3, 2000})
+        {
+            corpus::file_corpus plain{prefix, list, "shift_jis"};
+            corpus::file_corpus ahead{prefix, list, "shift_jis", prefetch, 2};
+            ASSERT_EQUAL(ahead.size(), plain.size());
+            while (plain.has_next())
+            {
+                ASSERT(ahead.has_next());
+                auto expected = plain.next();
+                auto doc = ahead.next();
+                ASSERT_EQUAL(doc.id(), expected.id());
+                ASSERT_EQUAL(doc.label(), expected.label());
+                ASSERT(doc.contains_content());
+                ana->tokenize(doc);
+                ana->tokenize(expected);
+                ASSERT(doc.counts() == expected.counts());
+            }
+            ASSERT(!ahead.has_next());
+        }
+    });
+
     num_failed += testing::run_test("inverted-index-read-file-corpus", [&]()
                                     {
         {
@@ -149,6 +1305,174 @@ int inverted_index_tests()
         check_term_id(*idx); // twice to check splay_caching
     });
 
+    num_failed += testing::run_test("line-corpus-partitions", [&]()
+    {
+        auto check = [](corpus::line_corpus& docs)
+        {
+            std::vector<corpus::document> expected;
+            while (docs.has_next())
+                expected.push_back(docs.next());
+
+            for (uint64_t k : {1, 2, 3, 7, 1000})
+            {
+                auto parts = docs.partitions(k);
+                ASSERT_EQUAL(parts.size(), k);
+                uint64_t next_id = 0;
+                uint64_t offset = 0;
+                for (const auto& part : parts)
+                {
+                    ASSERT_EQUAL(part.first_id, doc_id{next_id});
+                    ASSERT_EQUAL(part.begin, offset);
+                    auto reader = docs.open(part);
+                    ASSERT_EQUAL(reader->size(), part.num_docs);
+                    while (reader->has_next())
+                    {
+                        auto doc = reader->next();
+                        ASSERT(next_id < expected.size());
+                        const auto& exp = expected[next_id++];
+                        ASSERT_EQUAL(doc.id(), exp.id());
+                        ASSERT_EQUAL(doc.name(), exp.name());
+                        ASSERT_EQUAL(doc.label(), exp.label());
+                        ASSERT_EQUAL(doc.content(), exp.content());
+                    }
+                    offset = part.end;
+                }
+                ASSERT_EQUAL(next_id, expected.size());
+            }
+        };
+
+        auto docs = corpus::corpus::load("test-config.toml");
+        auto line = dynamic_cast<corpus::line_corpus*>(docs.get());
+        ASSERT(line != nullptr);
+        check(*line);
+
+        // empty lines, and a last line without a newline
+        {
+            std::ofstream out{"line-corpus-parts.dat"};
+            out << "first line\n\nthird line here\n\n\nsixth\nlast";
+        }
+        {
+            std::ofstream out{"line-corpus-parts.dat.labels"};
+            out << "a\nb\nc\nd\ne\nf\ng\n";
+        }
+        {
+            corpus::line_corpus small{"line-corpus-parts.dat", "utf-8"};
+            check(small);
+        }
+        std::remove("line-corpus-parts.dat");
+        std::remove("line-corpus-parts.dat.labels");
+    });
+
+    num_failed += testing::run_test("tokenized-corpus", [&]()
+    {
+        {
+            auto config = cpptoml::parse_file("test-config.toml");
+            auto ana = analyzers::analyzer::load(config);
+            auto docs = corpus::corpus::load("test-config.toml");
+            corpus::tokenized_corpus_writer writer{"ceeaus.tok"};
+            while (docs->has_next())
+            {
+                auto doc = docs->next();
+                ana->tokenize(doc);
+                writer.write(doc);
+            }
+        }
+
+        // the same configuration, reading the tokenized corpus
+        {
+            std::ifstream in{"test-config.toml"};
+            std::ofstream out{"tokenized-config.toml"};
+            std::string line;
+            while (std::getline(in, line))
+            {
+                if (line.find("corpus-type") == 0)
+                    out << "corpus-type = \"tokenized-corpus\"\n"
+                        << "tokenized-file = \"ceeaus.tok\"\n";
+                else if (line.find("inverted-index") == 0)
+                    out << "inverted-index = \"ceeaus-tok-inv\"\n";
+                else if (line.find("forward-index") == 0)
+                    out << "forward-index = \"ceeaus-tok-fwd\"\n";
+                else
+                    out << line << "\n";
+            }
+        }
+
+        {
+            auto docs = corpus::corpus::load("tokenized-config.toml");
+            ASSERT_EQUAL(docs->size(), 1008ul);
+            auto tok = dynamic_cast<corpus::tokenized_corpus*>(docs.get());
+            ASSERT(tok != nullptr);
+            ASSERT(!tok->sequences());
+            auto doc = docs->next();
+            ASSERT(doc.pretokenized());
+            ASSERT(tok->sequence().empty());
+        }
+
+        system("rm -rf ceeaus-tok-inv ceeaus-tok-fwd");
+        {
+            auto idx = index::make_index<index::inverted_index,
+                                         caching::splay_cache>(
+                "tokenized-config.toml", uint32_t{10000});
+            check_ceeaus_expected(*idx);
+            check_term_id(*idx);
+
+            auto fwd = index::make_index<index::forward_index>(
+                "tokenized-config.toml");
+            ASSERT_EQUAL(fwd->num_docs(), idx->num_docs());
+            ASSERT_EQUAL(fwd->unique_terms(), idx->unique_terms());
+            for (const auto& d_id : idx->docs())
+            {
+                ASSERT_EQUAL(fwd->doc_size(d_id), idx->doc_size(d_id));
+                ASSERT_EQUAL(fwd->label(d_id), idx->label(d_id));
+            }
+        }
+
+        // a file of token sequences
+        {
+            corpus::tokenized_corpus_writer writer{"sequences.tok", true};
+            corpus::document doc{"a/first", doc_id{0}, class_label{"x"}};
+            writer.write(doc, {"<s>", "the", "cat", "the", "</s>"});
+            corpus::document empty{"a/second", doc_id{1}, class_label{"y"}};
+            writer.write(empty, {});
+
+            bool thrown = false;
+            try
+            {
+                writer.write(doc);
+            }
+            catch (corpus::tokenized_corpus::tokenized_corpus_exception&)
+            {
+                thrown = true;
+            }
+            ASSERT(thrown);
+        }
+        {
+            corpus::tokenized_corpus docs{"sequences.tok"};
+            ASSERT(docs.sequences());
+            ASSERT_EQUAL(docs.size(), 2ul);
+            auto doc = docs.next();
+            ASSERT_EQUAL(doc.id(), doc_id{0});
+            ASSERT_EQUAL(doc.name(), std::string{"first"});
+            ASSERT_EQUAL(doc.label(), class_label{"x"});
+            ASSERT_EQUAL(doc.count("the"), 2.0);
+            ASSERT_EQUAL(doc.length(), 5ul);
+            std::vector<std::string> tokens;
+            for (const auto& id : docs.sequence())
+                tokens.push_back(docs.term(id));
+            ASSERT(tokens == (std::vector<std::string>{"<s>", "the", "cat",
+                                                        "the", "</s>"}));
+            auto empty = docs.next();
+            ASSERT_EQUAL(empty.path(), std::string{"a/second"});
+            ASSERT(docs.sequence().empty());
+            ASSERT(!docs.has_next());
+        }
+
+        system("rm -rf ceeaus-tok-inv ceeaus-tok-fwd");
+        std::remove("ceeaus.tok");
+        std::remove("sequences.tok");
+        std::remove("tokenized-config.toml");
+    });
+
 #if META_HAS_ZLIB
     create_config("gz");
     system("rm -rf ceeaus-inv");
@@ -169,6 +1493,87 @@ int inverted_index_tests()
         check_ceeaus_expected(*idx);
         check_term_id(*idx);
     });
+
+    num_failed += testing::run_test("bgzf-round-trip", [&]()
+    {
+        std::mt19937 rng{47};
+        std::vector<std::string> lines;
+        for (int i = 0; i < 300; ++i)
+        {
+            // some lines are empty, and some span several blocks
+            std::string line(rng() % 3 == 0 ? 0 : rng() % 400, 'a');
+            for (auto& c : line)
+                c = static_cast<char>('a' + rng() % 26);
+            lines.push_back(line);
+        }
+
+        {
+            io::bgzf_writer out{"bgzf-test.gz", 100};
+            for (const auto& line : lines)
+                out.write(line + "\n");
+            out.write("no newline");
+        }
+        lines.push_back("no newline");
+        ASSERT(io::bgzf_reader::is_bgzf("bgzf-test.gz"));
+
+        for (uint64_t threads : {1, 4})
+        {
+            io::bgzf_reader in{"bgzf-test.gz", threads};
+            std::string line;
+            for (const auto& expected : lines)
+            {
+                ASSERT(in.getline(line));
+                ASSERT_EQUAL(line, expected);
+            }
+            ASSERT(!in.getline(line));
+        }
+
+        // it is still a gzip file
+        io::gzifstream gz{"bgzf-test.gz"};
+        std::string line;
+        for (const auto& expected : lines)
+        {
+            ASSERT(std::getline(gz, line));
+            ASSERT_EQUAL(line, expected);
+        }
+        std::remove("bgzf-test.gz");
+    });
+
+    num_failed += testing::run_test("bgzf-gz-corpus", [&]()
+    {
+        auto config = cpptoml::parse_file("test-config.toml");
+        auto base = *config.get_as<std::string>("prefix") + "/ceeaus/ceeaus.dat";
+        {
+            std::ifstream docs{base};
+            std::ifstream labels{base + ".labels"};
+            io::bgzf_writer docs_out{"bgzf-ceeaus.dat.gz"};
+            io::bgzf_writer labels_out{"bgzf-ceeaus.dat.labels.gz"};
+            std::string line;
+            while (std::getline(docs, line))
+                docs_out.write(line + "\n");
+            while (std::getline(labels, line))
+                labels_out.write(line + "\n");
+            std::ofstream numdocs{"bgzf-ceeaus.dat.numdocs"};
+            numdocs << filesystem::file_text(base + ".numdocs");
+        }
+
+        corpus::gz_corpus expected{base, "shift_jis"};
+        corpus::gz_corpus actual{"bgzf-ceeaus.dat", "shift_jis", 3};
+        ASSERT_EQUAL(actual.size(), expected.size());
+        while (expected.has_next())
+        {
+            ASSERT(actual.has_next());
+            auto exp = expected.next();
+            auto doc = actual.next();
+            ASSERT_EQUAL(doc.id(), exp.id());
+            ASSERT_EQUAL(doc.label(), exp.label());
+            ASSERT_EQUAL(doc.content(), exp.content());
+        }
+        ASSERT(!actual.has_next());
+        std::remove("bgzf-ceeaus.dat.gz");
+        std::remove("bgzf-ceeaus.dat.labels.gz");
+        std::remove("bgzf-ceeaus.dat.numdocs");
+    });
 #endif
 
     // test different caches
@@ -182,6 +1587,17 @@ int inverted_index_tests()
         check_term_id(*idx);
     });
 
+    num_failed += testing::run_test("inverted-index-concurrent-dblru-cache",
+                                    [&]()
+                                    {
+        check_concurrent_map();
+        auto idx = index::make_index<index::inverted_index,
+                                     caching::concurrent_dblru_cache>(
+            "test-config.toml", uint64_t{1000});
+        check_term_id(*idx);
+        check_term_id(*idx);
+    });
+
     num_failed += testing::run_test("inverted-index-no-evict-cache", [&]()
                                     {
         auto idx
@@ -189,6 +1605,10 @@ int inverted_index_tests()
                 "test-config.toml");
         check_term_id(*idx);
         check_term_id(*idx);
+        auto stats = idx->cache_stats();
+        ASSERT_EQUAL(stats.misses, 1ul);
+        ASSERT_EQUAL(stats.hits, 1ul);
+        ASSERT_EQUAL(stats.entries, 1ul);
     });
 
     num_failed += testing::run_test("inverted-index-shard-cache", [&]()
@@ -198,6 +1618,178 @@ int inverted_index_tests()
             "test-config.toml", uint8_t{8});
         check_term_id(*idx);
         check_term_id(*idx);
+        auto stats = idx->cache_stats();
+        ASSERT_EQUAL(stats.misses, 1ul);
+        ASSERT_EQUAL(stats.hits, 1ul);
+        ASSERT_EQUAL(stats.entries, 1ul);
+    });
+
+    num_failed += testing::run_test("inverted-index-doc-metadata", [&]()
+                                    {
+        auto idx = index::make_index<index::inverted_index>("test-config.toml");
+        check_doc_metadata(*idx);
+
+        // statistics that do not describe the index are computed again
+        auto stats = filesystem::file_text("ceeaus-inv/corpus.stats");
+        {
+            std::ofstream out{"ceeaus-inv/corpus.stats"};
+            out << "1 1 1\n";
+        }
+        auto stale
+            = index::make_index<index::inverted_index>("test-config.toml");
+        ASSERT_EQUAL(stale->total_corpus_terms(), idx->total_corpus_terms());
+        std::ofstream out{"ceeaus-inv/corpus.stats"};
+        out << stats;
+    });
+
+    num_failed += testing::run_test("inverted-index-fields", [&]()
+                                    {
+        check_fields();
+    });
+
+    num_failed += testing::run_test("inverted-index-gdsf-cache", [&]()
+                                    {
+        check_gdsf_cache();
+        auto idx
+            = index::make_index<index::inverted_index, caching::gdsf_cache>(
+                "test-config.toml", uint64_t{1} << 20);
+        check_term_id(*idx);
+        check_term_id(*idx);
+        check_cache_warm_up(*idx);
+    });
+
+    num_failed += testing::run_test("inverted-index-cursor-cache", [&]()
+                                    {
+        check_cursor_cache();
+    });
+
+    num_failed += testing::run_test("inverted-index-handle", [&]()
+                                    {
+        check_index_handle();
+    });
+
+    num_failed += testing::run_test("inverted-index-cache-warm-up", [&]()
+                                    {
+        auto dblru = index::make_index<index::inverted_index,
+                                       caching::default_dblru_cache>(
+            "test-config.toml", uint64_t{1000});
+        check_cache_warm_up(*dblru);
+
+        auto splay
+            = index::make_index<index::inverted_index, caching::splay_cache>(
+                "test-config.toml", uint32_t{10000});
+        check_cache_warm_up(*splay);
+    });
+
+    num_failed += testing::run_test("inverted-index-positions", [&]()
+                                    {
+        system("rm -rf ceeaus-inv");
+        {
+            auto config = filesystem::file_text("test-config.toml");
+            std::ofstream out{"test-config.toml"};
+            out << "store-positions = true\n" << config;
+        }
+        auto idx = index::make_index<index::inverted_index>("test-config.toml");
+        ASSERT(idx->has_positions());
+        check_ceeaus_expected(*idx);
+        check_term_id(*idx);
+        check_positions(*idx);
+    });
+
+    num_failed += testing::run_test("inverted-index-merge", [&]()
+                                    {
+        auto idx = index::make_index<index::inverted_index>("test-config.toml");
+        check_merge(idx);
+    });
+
+    num_failed += testing::run_test("inverted-index-residency", [&]()
+                                    {
+        // the positional index built above is reopened in memory
+        auto config = filesystem::file_text("test-config.toml");
+        for (const auto& residency : {"prefault", "memory"})
+        {
+            {
+                std::ofstream out{"test-config.toml"};
+                out << "index-residency = \"" << residency << "\"\n"
+                    << config;
+            }
+            auto idx
+                = index::make_index<index::inverted_index>("test-config.toml");
+            check_ceeaus_expected(*idx);
+            check_term_id(*idx);
+            check_positions(*idx);
+        }
+    });
+
+    num_failed += testing::run_test("inverted-index-term-freqs", [&]()
+                                    {
+        auto config = filesystem::file_text("test-config.toml");
+        for (const auto& codec : {"gamma", "block"})
+        {
+            system("rm -rf ceeaus-inv");
+            {
+                std::ofstream out{"test-config.toml"};
+                out << "postings-codec = \"" << codec << "\"\n" << config;
+            }
+            auto idx
+                = index::make_index<index::inverted_index>("test-config.toml");
+            check_term_freqs(*idx);
+        }
+        std::ofstream out{"test-config.toml"};
+        out << config;
+    });
+
+    num_failed += testing::run_test("inverted-index-term-id-lookups", [&]()
+                                    {
+        auto config = filesystem::file_text("test-config.toml");
+        for (const auto& cache_size : {0, 16})
+        {
+            {
+                std::ofstream out{"test-config.toml"};
+                out << "term-id-cache-size = " << cache_size << "\n"
+                    << config;
+            }
+            auto idx
+                = index::make_index<index::inverted_index>("test-config.toml");
+            check_term_ids(*idx);
+            check_term_id(*idx);
+        }
+    });
+
+    num_failed += testing::run_test("inverted-index-hot-tier", [&]()
+                                    {
+        check_hot_tier();
+    });
+
+    num_failed += testing::run_test("inverted-index-feature-hashing", [&]()
+                                    {
+        system("rm -rf ceeaus-inv");
+        auto config = filesystem::file_text("test-config.toml");
+        {
+            std::ofstream out{"test-config.toml"};
+            out << "feature-hashing = true\n" << config;
+        }
+        auto idx = index::make_index<index::inverted_index>("test-config.toml");
+        check_ceeaus_expected(*idx);
+        check_term_id(*idx);
+        check_term_freqs(*idx);
+        std::ofstream out{"test-config.toml"};
+        out << config;
+    });
+
+    num_failed += testing::run_test("inverted-index-completions", [&]()
+                                    {
+        check_completions();
+    });
+
+    num_failed += testing::run_test("inverted-index-checkpoints", [&]()
+                                    {
+        check_checkpoints();
+    });
+
+    num_failed += testing::run_test("inverted-index-distributed-build", [&]()
+                                    {
+        check_distributed_build();
     });
 
     system("rm -rf ceeaus-inv test-config.toml");
@@ -137,11 +137,94 @@ int ir_eval_results()
         });
 }
 
+int ir_eval_evaluate()
+{
+    return testing::run_test(
+        "ir-eval-evaluate", [&]()
+        {
+            create_config("file");
+            using result_type = index::ir_eval::result_type;
+
+            // query 0 has 10 relevant documents, query 1 has 5 (1, 4, 24,
+            // 38 and 45), and query 9 has no judgements
+            std::vector<result_type> results
+                = {{{doc_id{0}, 3.0}, {doc_id{2}, 2.0}, {doc_id{1}, 1.0}},
+                   {{doc_id{2}, 1.0}},
+                   {},
+                   {{doc_id{1}, 5.0},
+                    {doc_id{3}, 4.0},
+                    {doc_id{4}, 3.0},
+                    {doc_id{14}, 2.0},
+                    {doc_id{24}, 1.0}},
+                   {{doc_id{0}, 1.0}}};
+            std::vector<query_id> q_ids
+                = {query_id{0}, query_id{0}, query_id{0}, query_id{1},
+                   query_id{9}};
+
+            auto idcg_5 = 1.0 + 1.0 / std::log2(3.0) + 1.0 / std::log2(4.0)
+                          + 1.0 / std::log2(5.0) + 1.0 / std::log2(6.0);
+            auto avg_p_0 = (1.0 + 2.0 / 3.0) / 5.0;
+            auto avg_p_3 = (1.0 + 2.0 / 3.0 + 3.0 / 5.0) / 5.0;
+            std::vector<index::ir_eval::query_stats> expected(results.size(),
+                                                              {0, 0, 0, 0, 0});
+            expected[0] = {2.0 / 3.0, 0.2,
+                           (2.0 * (2.0 / 3.0) * 0.2) / (2.0 / 3.0 + 0.2),
+                           1.5 / idcg_5, avg_p_0};
+            expected[3] = {0.6, 0.6, 0.6,
+                           (1.0 + 1.0 / std::log2(4.0) + 1.0 / std::log2(6.0))
+                               / idcg_5,
+                           avg_p_3};
+
+            for (uint64_t num_threads : {1, 3})
+            {
+                index::ir_eval eval{"test-config.toml"};
+                parallel::thread_pool pool{num_threads};
+                auto stats = eval.evaluate(results, q_ids, 5, pool);
+                ASSERT_EQUAL(stats.size(), expected.size());
+                for (uint64_t i = 0; i < stats.size(); ++i)
+                {
+                    ASSERT_APPROX_EQUAL(stats[i].precision,
+                                        expected[i].precision);
+                    ASSERT_APPROX_EQUAL(stats[i].recall, expected[i].recall);
+                    ASSERT_APPROX_EQUAL(stats[i].f1, expected[i].f1);
+                    ASSERT_APPROX_EQUAL(stats[i].ndcg, expected[i].ndcg);
+                    ASSERT_APPROX_EQUAL(stats[i].avg_p, expected[i].avg_p);
+                }
+
+                // every query counts towards the aggregates, even those
+                // with an average precision of zero
+                ASSERT_APPROX_EQUAL(eval.map(), (avg_p_0 + avg_p_3) / 5.0);
+                ASSERT_APPROX_EQUAL(
+                    eval.gmap(),
+                    std::exp((std::log(avg_p_0) + std::log(avg_p_3)) / 5.0));
+
+                // the aggregates continue from the serial ones
+                eval.avg_p(results[3], q_ids[3], 5);
+                ASSERT_APPROX_EQUAL(eval.map(), (avg_p_0 + 2 * avg_p_3) / 6.0);
+
+                bool thrown = false;
+                try
+                {
+                    q_ids.push_back(query_id{0});
+                    eval.evaluate(results, q_ids, 5, pool);
+                }
+                catch (index::ir_eval::ir_eval_exception&)
+                {
+                    thrown = true;
+                }
+                q_ids.pop_back();
+                ASSERT(thrown);
+            }
+            system("rm test-config.toml");
+        });
+}
+
 int ir_eval_tests()
 {
     int num_failed = 0;
     num_failed += ir_eval_bounds();
     num_failed += ir_eval_results();
+    num_failed += ir_eval_evaluate();
     return num_failed;
 }
 }
@@ -0,0 +1,668 @@
+/**
+ * @file language_model_test.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+#include "corpus/tokenized_corpus.h"
+#include "lm/language_model.h"
+#include "lm/ngram_trie.h"
+#include "parallel/thread_pool.h"
+#include "test/language_model_test.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace testing
+{
+
+namespace
+{
+
+/// The order of the models that are learned
+const uint64_t order = 3;
+
+/// The interpolation coefficient language_model smooths with
+const double lambda = 0.7;
+
+/**
+ * Writes a line corpus of short sentences over a small vocabulary, along
+ * with configurations that learn a trigram model from it directly and
+ * from its tokenized form in meta-tmp-lm/lm.tok.
+ */
+void make_corpus()
+{
+    filesystem::remove_all("meta-tmp-lm");
+    filesystem::make_directory("meta-tmp-lm");
+    filesystem::make_directory("meta-tmp-lm/lm");
+
+    std::vector<std::string> words{"the", "cat",  "dog",   "sat", "ran",
+                                   "on",  "mat",  "a",     "big", "small",
+                                   "red", "fast", "house", "saw"};
+    std::mt19937 rng{47};
+    std::uniform_int_distribution<uint64_t> word_dist{0, words.size() - 1};
+    std::uniform_int_distribution<uint64_t> length_dist{2, 7};
+    std::uniform_int_distribution<uint64_t> sentences_dist{1, 3};
+    {
+        std::ofstream corpus{"meta-tmp-lm/lm/lm.dat"};
+        for (uint64_t line = 0; line < 200; ++line)
+        {
+            auto sentences = sentences_dist(rng);
+            for (uint64_t s = 0; s < sentences; ++s)
+            {
+                auto length = length_dist(rng);
+                for (uint64_t i = 0; i < length; ++i)
+                    corpus << (i == 0 ? "" : " ") << words[word_dist(rng)];
+                corpus << (s + 1 == sentences ? ".\n" : ". ");
+            }
+        }
+    }
+
+    for (const auto& type : {"line", "tokenized"})
+    {
+        std::ofstream config{std::string{"meta-tmp-lm/"} + type + ".toml"};
+        config << "prefix = \"meta-tmp-lm\"\n"
+               << "dataset = \"lm\"\n"
+               << "corpus-type = \"" << type << "-corpus\"\n"
+               << "tokenized-file = \"meta-tmp-lm/lm.tok\"\n"
+               << "[language-model]\n"
+               << "n-value = " << order << "\n";
+    }
+}
+
+/**
+ * Checks that two probabilities agree up to a relative error.
+ */
+void check_relative(double actual, double expected, double error)
+{
+    ASSERT(std::abs(actual - expected) <= error * std::abs(expected));
+}
+
+/**
+ * @return the whitespace-separated tokens of a string
+ */
+std::vector<std::string> split(const std::string& str)
+{
+    std::vector<std::string> tokens;
+    std::stringstream ss{str};
+    std::string token;
+    while (ss >> token)
+        tokens.push_back(token);
+    return tokens;
+}
+
+/**
+ * A language model computed directly from the n-gram counts of a
+ * tokenized corpus, the slow way.
+ */
+class reference_model
+{
+  public:
+    /**
+     * Counts the n-grams of every order in a tokenized corpus of
+     * sequences, each sequence starting from a history of <s>.
+     * @param filename The tokenized corpus
+     */
+    reference_model(const std::string& filename) : counts_(order)
+    {
+        corpus::tokenized_corpus corpus{filename};
+        while (corpus.has_next())
+        {
+            corpus.next();
+            std::vector<std::string> tokens(order - 1, "<s>");
+            for (const auto& id : corpus.sequence())
+            {
+                tokens.push_back(corpus.term(id));
+                std::vector<std::string> ngram{tokens.end() - order,
+                                               tokens.end()};
+                ngrams_.push_back(ngram);
+                for (uint64_t n = 0; n < order; ++n)
+                    ++counts_[n][context(ngram, n)][ngram.back()];
+            }
+        }
+    }
+
+    /**
+     * @return every n-gram of the corpus, in order
+     */
+    const std::vector<std::vector<std::string>>& ngrams() const
+    {
+        return ngrams_;
+    }
+
+    /**
+     * @return every token of the corpus
+     */
+    std::vector<std::string> vocabulary() const
+    {
+        std::vector<std::string> vocab;
+        for (const auto& end : counts_[0].at(""))
+            vocab.push_back(end.first);
+        return vocab;
+    }
+
+    /**
+     * @return the probability of the last token of an n-gram: the
+     * interpolated probability after the longest context it was seen
+     * after, times 1 - lambda for each longer context that was seen
+     */
+    double prob(const std::vector<std::string>& ngram) const
+    {
+        uint64_t depth = 0;
+        while (depth + 1 < order && counts_[depth + 1].count(
+                                        context(ngram, depth + 1)))
+            ++depth;
+
+        double backoff = 1.0;
+        for (auto d = depth; d > 0; --d)
+        {
+            const auto& endings = counts_[d].at(context(ngram, d));
+            if (endings.count(ngram.back()))
+                return backoff * interpolated(d, context(ngram, d),
+                                              ngram.back());
+            backoff *= 1.0 - lambda;
+        }
+
+        // a token that was never seen is scored as <unk>
+        if (!counts_[0].at("").count(ngram.back()))
+            return backoff * (1.0 - lambda);
+        return backoff * interpolated(0, "", ngram.back());
+    }
+
+  private:
+    /**
+     * @return the n tokens before the last one, joined by spaces
+     */
+    static std::string context(const std::vector<std::string>& ngram,
+                               uint64_t n)
+    {
+        std::string ctx;
+        for (auto i = ngram.size() - 1 - n; i + 1 < ngram.size(); ++i)
+            ctx += (ctx.empty() ? "" : " ") + ngram[i];
+        return ctx;
+    }
+
+    /**
+     * @return the probability of a token after a context of n tokens,
+     * interpolated with that of the context one token shorter
+     */
+    double interpolated(uint64_t n, const std::string& ctx,
+                        const std::string& token) const
+    {
+        const auto& endings = counts_[n].at(ctx);
+        double total = 0;
+        for (const auto& end : endings)
+            total += end.second;
+        double lower = 1.0;
+        if (n > 0)
+        {
+            auto space = ctx.find(' ');
+            lower = interpolated(n - 1, space == std::string::npos
+                                            ? std::string{}
+                                            : ctx.substr(space + 1),
+                                 token);
+        }
+        return lambda * endings.at(token) / total + (1.0 - lambda) * lower;
+    }
+
+    /// The count of each token after each context, for each order
+    std::vector<std::unordered_map<std::string,
+                                   std::unordered_map<std::string, double>>>
+        counts_;
+    /// Every n-gram of the corpus
+    std::vector<std::vector<std::string>> ngrams_;
+};
+
+/**
+ * @return the n-gram as the deque language_model::prob takes
+ */
+std::deque<std::string> to_deque(const std::vector<std::string>& ngram)
+{
+    return {ngram.begin(), ngram.end()};
+}
+
+/**
+ * @return n-grams drawn from the vocabulary, most of them never seen, and
+ * some with a token that is not in the vocabulary at all
+ */
+std::vector<std::vector<std::string>>
+    random_ngrams(const std::vector<std::string>& vocab)
+{
+    auto words = vocab;
+    words.push_back("zebra");
+    std::mt19937 rng{7};
+    std::uniform_int_distribution<uint64_t> dist{0, words.size() - 1};
+    std::vector<std::vector<std::string>> ngrams;
+    for (uint64_t i = 0; i < 500; ++i)
+    {
+        std::vector<std::string> ngram;
+        for (uint64_t n = 0; n < order; ++n)
+            ngram.push_back(words[dist(rng)]);
+        ngrams.push_back(ngram);
+    }
+    return ngrams;
+}
+
+/**
+ * @return the sentences of the corpus, one per sequence, plus a few
+ * with tokens that are not in it
+ */
+std::vector<std::string> make_sequences()
+{
+    std::vector<std::string> sequences;
+    std::ifstream corpus{"meta-tmp-lm/lm/lm.dat"};
+    std::string line;
+    while (std::getline(corpus, line))
+    {
+        std::string seq;
+        for (auto& token : split(line))
+        {
+            if (token.back() == '.')
+                token.pop_back();
+            seq += (seq.empty() ? "" : " ") + token;
+        }
+        sequences.push_back(seq);
+    }
+    sequences.push_back("the zebra sat on the mat");
+    sequences.push_back("zebra zebra zebra");
+    sequences.push_back("");
+    return sequences;
+}
+
+/**
+ * @return the perplexity of a sequence computed from prob() at every
+ * position
+ */
+double reference_perplexity(const lm::language_model& model,
+                            const std::string& sequence)
+{
+    std::deque<std::string> window(order, "<s>");
+    double perp = 0;
+    for (const auto& token : split(sequence))
+    {
+        window.pop_front();
+        window.push_back(token);
+        perp += std::log(1.0 + 1.0 / model.prob(window));
+    }
+    return std::pow(perp, 1.0 / order);
+}
+
+/**
+ * Builds a trigram ngram_trie by hand:
+ *  - unigrams a, b, c, and <unk>, with 0.5, 0.3, 0.15 and 0.05;
+ *  - "a" followed by b or c, and "b" followed by a;
+ *  - "a b" followed by c, and "a c" followed by a, whose context "c" is
+ *    not given.
+ * "a" has a back-off weight of 0.25, and the other contexts the default
+ * of 0.5.
+ */
+lm::ngram_trie make_trie()
+{
+    std::vector<lm::ngram_trie::distribution> dists(3);
+    dists[0][""] = {{"a", 0.5}, {"b", 0.3}, {"c", 0.15}, {"<unk>", 0.05}};
+    dists[1]["a"] = {{"b", 0.6}, {"c", 0.4}};
+    dists[1]["b"] = {{"a", 1.0}};
+    dists[2]["a b"] = {{"c", 0.9}};
+    dists[2]["a c"] = {{"a", 0.8}};
+    std::vector<lm::ngram_trie::backoff_weights> backoffs(2);
+    backoffs[1]["a"] = 0.25;
+    return lm::ngram_trie{dists, backoffs, 0.5};
+}
+}
+
+int counting_tests()
+{
+    return testing::run_test("language-model-counts", [&]()
+    {
+        make_corpus();
+        lm::language_model model{"meta-tmp-lm/line.toml"};
+        lm::language_model::write_tokenized_corpus("meta-tmp-lm/line.toml",
+                                                   "meta-tmp-lm/lm.tok");
+        lm::language_model serial{"meta-tmp-lm/tokenized.toml"};
+        reference_model ref{"meta-tmp-lm/lm.tok"};
+        ASSERT(!ref.ngrams().empty());
+
+        // counting on the pool gives the same model as counting the
+        // tokenized sequences serially, and both match the counts
+        for (const auto& ngram : ref.ngrams())
+        {
+            auto prob = model.prob(to_deque(ngram));
+            ASSERT_EQUAL(prob, serial.prob(to_deque(ngram)));
+            check_relative(prob, ref.prob(ngram), 1e-4);
+        }
+        filesystem::remove_all("meta-tmp-lm");
+    });
+}
+
+int trie_tests()
+{
+    int num_failed = 0;
+    num_failed += testing::run_test("ngram-trie", [&]()
+    {
+        auto trie = make_trie();
+        ASSERT_EQUAL(trie.order(), uint64_t{3});
+
+        // ids are the positions of the tokens in sorted order
+        ASSERT_EQUAL(trie.vocab_size(), uint32_t{4});
+        std::vector<std::string> sorted{"<unk>", "a", "b", "c"};
+        for (uint32_t id = 0; id < sorted.size(); ++id)
+        {
+            ASSERT_EQUAL(trie.id(sorted[id]), id);
+            ASSERT_EQUAL(trie.word(id), sorted[id]);
+        }
+        ASSERT_EQUAL(trie.id("d"), trie.vocab_size());
+        ASSERT_EQUAL(trie.id("ab", 1), trie.id("a"));
+        ASSERT_EQUAL(trie.id("ab", 2), trie.vocab_size());
+
+        auto a = trie.id("a");
+        auto b = trie.id("b");
+        auto c = trie.id("c");
+        auto root = trie.root();
+        check_relative(trie.prob(root, a), 0.5, 1e-4);
+        check_relative(trie.prob(root, c), 0.15, 1e-4);
+        check_relative(trie.prob(root, trie.id("<unk>")), 0.05, 1e-4);
+
+        // the endings of a node come in id order
+        std::vector<uint32_t> ids;
+        trie.each_ending(root, [&](uint32_t id, double)
+                         {
+            ids.push_back(id);
+        });
+        ASSERT(ids == std::vector<uint32_t>({0, a, b, c}));
+
+        // contexts are read from their last token back
+        auto node_a = root;
+        ASSERT(trie.extend(node_a, a));
+        check_relative(trie.prob(node_a, b), 0.6, 1e-4);
+        ASSERT_LESS(trie.prob(node_a, a), 0.0);
+        check_relative(trie.backoff(node_a), 0.25, 1e-4);
+
+        auto node_b = root;
+        ASSERT(trie.extend(node_b, b));
+        check_relative(trie.backoff(node_b), 0.5, 1e-4);
+        auto node_ab = node_b;
+        ASSERT(trie.extend(node_ab, a));
+        check_relative(trie.prob(node_ab, c), 0.9, 1e-4);
+        ASSERT_LESS(trie.prob(node_ab, b), 0.0);
+        auto missing = node_ab;
+        ASSERT(!trie.extend(missing, a));
+        ASSERT_EQUAL(missing, node_ab);
+
+        // "a c" is reachable through a "c" that was never given
+        auto node_c = root;
+        ASSERT(trie.extend(node_c, c));
+        ASSERT_LESS(trie.prob(node_c, a), 0.0);
+        check_relative(trie.backoff(node_c), 0.5, 1e-4);
+        auto node_ac = node_c;
+        ASSERT(trie.extend(node_ac, a));
+        check_relative(trie.prob(node_ac, a), 0.8, 1e-4);
+    });
+
+    num_failed += testing::run_test("language-model-backoff", [&]()
+    {
+        make_corpus();
+        lm::language_model model{"meta-tmp-lm/line.toml"};
+        lm::language_model::write_tokenized_corpus("meta-tmp-lm/line.toml",
+                                                   "meta-tmp-lm/lm.tok");
+        reference_model ref{"meta-tmp-lm/lm.tok"};
+
+        // an unknown token after two <s> backs off through both contexts
+        // to the <unk> unigram
+        check_relative(model.prob({"<s>", "<s>", "zebra"}),
+                       std::pow(1.0 - lambda, 3), 1e-4);
+
+        // once a context is unseen, the tokens before it do not matter
+        check_relative(model.prob({"zebra", "zebra", "cat"}),
+                       model.prob({"dog", "zebra", "cat"}), 1e-12);
+
+        for (const auto& ngram : random_ngrams(ref.vocabulary()))
+            check_relative(model.prob(to_deque(ngram)), ref.prob(ngram),
+                           1e-4);
+
+        try
+        {
+            model.prob({"the", "cat"});
+            FAIL("prob() of a bigram should throw for a trigram model");
+        }
+        catch (std::runtime_error&)
+        {
+            // expected
+        }
+        filesystem::remove_all("meta-tmp-lm");
+    });
+    return num_failed;
+}
+
+int file_tests()
+{
+    int num_failed = 0;
+    num_failed += testing::run_test("language-model-save-load", [&]()
+    {
+        make_corpus();
+        lm::language_model model{"meta-tmp-lm/line.toml"};
+        lm::language_model::write_tokenized_corpus("meta-tmp-lm/line.toml",
+                                                   "meta-tmp-lm/lm.tok");
+        reference_model ref{"meta-tmp-lm/lm.tok"};
+        auto sequences = make_sequences();
+
+        // a saved model is mapped back bit for bit
+        model.save("meta-tmp-lm/model.bin");
+        auto loaded = lm::language_model::load("meta-tmp-lm/model.bin");
+        auto ngrams = random_ngrams(ref.vocabulary());
+        ngrams.insert(ngrams.end(), ref.ngrams().begin(),
+                      ref.ngrams().end());
+        for (const auto& ngram : ngrams)
+            ASSERT_EQUAL(loaded.prob(to_deque(ngram)),
+                         model.prob(to_deque(ngram)));
+        for (const auto& seq : sequences)
+            ASSERT_EQUAL(loaded.perplexity(seq), model.perplexity(seq));
+
+        // an ARPA file keeps about seven digits of each log probability
+        model.save_arpa("meta-tmp-lm/model.arpa");
+        auto arpa = lm::language_model::load_arpa("meta-tmp-lm/model.arpa");
+        for (const auto& ngram : ngrams)
+            check_relative(arpa.prob(to_deque(ngram)),
+                           model.prob(to_deque(ngram)), 1e-3);
+        for (const auto& seq : sequences)
+            check_relative(arpa.perplexity(seq), model.perplexity(seq),
+                           1e-3);
+        filesystem::remove_all("meta-tmp-lm");
+    });
+
+    num_failed += testing::run_test("language-model-bad-files", [&]()
+    {
+        filesystem::remove_all("meta-tmp-lm");
+        filesystem::make_directory("meta-tmp-lm");
+        make_trie().save("meta-tmp-lm/model.bin");
+        auto text = filesystem::file_text("meta-tmp-lm/model.bin");
+        {
+            std::ofstream out{"meta-tmp-lm/short.bin", std::ios::binary};
+            out.write(text.data(),
+                      static_cast<std::streamsize>(text.size() - 8));
+        }
+        {
+            std::ofstream out{"meta-tmp-lm/magic.bin", std::ios::binary};
+            out << "not a model";
+            out.write(text.data(),
+                      static_cast<std::streamsize>(text.size()));
+        }
+        {
+            std::ofstream out{"meta-tmp-lm/bad.arpa"};
+            out << "\\data\\\nngram 1=1\n\n\\1-grams:\n-0.5\ta b c d\n"
+                << "\\end\\\n";
+        }
+
+        for (const auto& file : {"meta-tmp-lm/missing.bin",
+                                 "meta-tmp-lm/short.bin",
+                                 "meta-tmp-lm/magic.bin"})
+        {
+            try
+            {
+                lm::ngram_trie{file};
+                FAIL(std::string{"loading "} + file + " should throw");
+            }
+            catch (lm::ngram_trie_exception&)
+            {
+                // expected
+            }
+        }
+        for (const auto& file : {"meta-tmp-lm/missing.arpa",
+                                 "meta-tmp-lm/bad.arpa"})
+        {
+            try
+            {
+                lm::ngram_trie::read_arpa(file);
+                FAIL(std::string{"reading "} + file + " should throw");
+            }
+            catch (lm::ngram_trie_exception&)
+            {
+                // expected
+            }
+        }
+
+        // the intact file still loads
+        lm::ngram_trie trie{"meta-tmp-lm/model.bin"};
+        ASSERT_EQUAL(trie.vocab_size(), uint32_t{4});
+        auto node = trie.root();
+        ASSERT(trie.extend(node, trie.id("a")));
+        check_relative(trie.backoff(node), 0.25, 1e-4);
+        filesystem::remove_all("meta-tmp-lm");
+    });
+    return num_failed;
+}
+
+int perplexity_tests()
+{
+    return testing::run_test("language-model-perplexity", [&]()
+    {
+        make_corpus();
+        lm::language_model model{"meta-tmp-lm/line.toml"};
+        auto sequences = make_sequences();
+
+        // the bounded walk down the trie finds what prob() finds
+        for (const auto& seq : sequences)
+            check_relative(model.perplexity(seq),
+                           reference_perplexity(model, seq), 1e-12);
+        ASSERT_EQUAL(model.perplexity(" the\tcat  sat\n on "),
+                     model.perplexity("the cat sat on"));
+
+        // scoring on a pool, in batches, gives the same scores
+        parallel::thread_pool pool{3};
+        auto perps = model.perplexity(sequences, pool);
+        auto per_word = model.perplexity_per_word(sequences, pool);
+        auto default_perps = model.perplexity(sequences);
+        ASSERT_EQUAL(perps.size(), sequences.size());
+        ASSERT_EQUAL(per_word.size(), sequences.size());
+        for (uint64_t i = 0; i < sequences.size(); ++i)
+        {
+            ASSERT_EQUAL(perps[i], model.perplexity(sequences[i]));
+            ASSERT_EQUAL(default_perps[i], perps[i]);
+            if (!sequences[i].empty())
+                ASSERT_EQUAL(per_word[i],
+                             model.perplexity_per_word(sequences[i]));
+        }
+        filesystem::remove_all("meta-tmp-lm");
+    });
+}
+
+int sampling_tests()
+{
+    int num_failed = 0;
+    num_failed += testing::run_test("ngram-trie-sample", [&]()
+    {
+        auto trie = make_trie();
+        auto unk = trie.id("<unk>");
+
+        // evenly spaced draws follow the distribution, without <unk>
+        const uint64_t draws = 100000;
+        auto check_draws = [&](uint64_t node)
+        {
+            std::vector<uint64_t> counts(trie.vocab_size(), 0);
+            for (uint64_t i = 0; i < draws; ++i)
+                ++counts[trie.sample(node, (i + 0.5) / draws)];
+            double total = 0;
+            trie.each_ending(node, [&](uint32_t id, double prob)
+                             {
+                if (id != unk)
+                    total += prob;
+            });
+            ASSERT_EQUAL(counts[unk], uint64_t{0});
+            trie.each_ending(node, [&](uint32_t id, double prob)
+                             {
+                if (id != unk)
+                    ASSERT_LESS(std::abs(static_cast<double>(counts[id])
+                                         / draws - prob / total),
+                                1e-4);
+            });
+        };
+        check_draws(trie.root());
+        auto node = trie.root();
+        ASSERT(trie.extend(node, trie.id("a")));
+        check_draws(node);
+
+        // the ends of the range are still tokens
+        ASSERT_EQUAL(trie.sample(trie.root(), 0.0), trie.id("a"));
+        ASSERT_EQUAL(trie.sample(trie.root(), 1.0), trie.id("c"));
+
+        // a context with no endings has nothing to sample
+        auto node_c = trie.root();
+        ASSERT(trie.extend(node_c, trie.id("c")));
+        ASSERT_EQUAL(trie.sample(node_c, 0.5), trie.vocab_size());
+    });
+
+    num_failed += testing::run_test("language-model-generate", [&]()
+    {
+        make_corpus();
+        lm::language_model model{"meta-tmp-lm/line.toml"};
+        lm::language_model::write_tokenized_corpus("meta-tmp-lm/line.toml",
+                                                   "meta-tmp-lm/lm.tok");
+        reference_model ref{"meta-tmp-lm/lm.tok"};
+        auto vocab = ref.vocabulary();
+        std::sort(vocab.begin(), vocab.end());
+
+        model.save("meta-tmp-lm/model.bin");
+        auto loaded = lm::language_model::load("meta-tmp-lm/model.bin");
+        for (unsigned int seed = 1; seed < 20; ++seed)
+        {
+            auto sentence = model.generate(seed);
+            ASSERT_EQUAL(model.generate(seed), sentence);
+            ASSERT_EQUAL(loaded.generate(seed), sentence);
+            // tokens are separated by single spaces, without the padding
+            ASSERT(sentence.empty()
+                   || (sentence.front() != ' ' && sentence.back() != ' '));
+            ASSERT(sentence.find("  ") == std::string::npos);
+            for (const auto& token : split(sentence))
+            {
+                ASSERT(token != "<s>" && token != "</s>" && token != "<unk>");
+                ASSERT(std::binary_search(vocab.begin(), vocab.end(),
+                                          token));
+            }
+        }
+
+        // an unknown context backs off to the unigrams
+        auto token = model.next_token({"zebra", "zebra"}, 0.5);
+        ASSERT(std::binary_search(vocab.begin(), vocab.end(), token));
+        ASSERT(token != "<unk>");
+        filesystem::remove_all("meta-tmp-lm");
+    });
+    return num_failed;
+}
+
+int language_model_tests()
+{
+    int num_failed = 0;
+    num_failed += counting_tests();
+    num_failed += trie_tests();
+    num_failed += file_tests();
+    num_failed += perplexity_tests();
+    num_failed += sampling_tests();
+    return num_failed;
+}
+}
+}
@@ -3,7 +3,13 @@
  * @author Sean Massung
  */
 
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <random>
+
 #include "test/libsvm_parser_test.h"
+#include "util/filesystem.h"
 
 namespace meta
 {
@@ -80,6 +86,272 @@ void bad_counts()
     }
 }
 
+void exact_values()
+{
+    // signs, leading zeros, bare points, exact powers of ten, more than
+    // 19 digits, subnormals, and tokens too long to copy to the stack
+    std::vector<std::string> values
+        = {"0", "-0", "+1", "1.", ".5", "0.000", "007", "1e0", "1E-3",
+           "2.5e+22", "1e23", "1e-22", "1e-23", "0.1", "0.3",
+           "123456789012345678", "9007199254740993",
+           "12345678901234567890123", "4.9e-324", "1.7976931348623157e308",
+           "0.0000000000000000000000000001234", std::string(200, '9'),
+           "0." + std::string(150, '0') + "1"};
+
+    // random values of every number of significant digits, around every
+    // exponent the fast path handles
+    std::mt19937_64 rng{17};
+    for (int digits = 1; digits <= 21; ++digits)
+    {
+        for (int exp = -26; exp <= 26; ++exp)
+        {
+            std::string mantissa;
+            for (int d = 0; d < digits; ++d)
+                mantissa += static_cast<char>('0' + rng() % 10);
+            auto point = rng() % (mantissa.size() + 1);
+            values.push_back(mantissa.substr(0, point) + "."
+                             + mantissa.substr(point) + "e"
+                             + std::to_string(exp));
+            values.push_back("-" + mantissa + "e" + std::to_string(exp));
+        }
+    }
+
+    for (const auto& value : values)
+    {
+        auto counts = io::libsvm_parser::counts("a 1:" + value);
+        ASSERT_EQUAL(counts.size(), size_t{1});
+        auto expected = std::strtod(value.c_str(), nullptr);
+        ASSERT(std::memcmp(&counts[0].second, &expected, sizeof(double))
+               == 0);
+    }
+}
+
+void malformed_lines()
+{
+    auto bad = {"a 5:1x",     "a 5:1e",   "a 5:e5",      "a 5:.",
+                "a 5:1.2.3",  "a 5:--1",  "a 5:1e+",     "a x5:1",
+                "a -5:1",     "a 5:1:2",  "a 0:1",       "a 5:1 :2",
+                "a 18446744073709551616:1", "a 5:1 7"};
+    for (auto& text : bad)
+    {
+        try
+        {
+            io::libsvm_parser::counts(text);
+            FAIL("An exception was not thrown on invalid input");
+        }
+        catch (io::libsvm_parser::libsvm_parser_exception&)
+        {
+            // nothing, we want an exception!
+        }
+    }
+
+    auto bad_labels = {"", "a", " a 1:1", "a "};
+    for (auto& text : bad_labels)
+    {
+        try
+        {
+            io::libsvm_parser::label(text);
+            FAIL("An exception was not thrown on invalid input");
+        }
+        catch (io::libsvm_parser::libsvm_parser_exception&)
+        {
+            // nothing, we want an exception!
+        }
+    }
+
+    // any whitespace separates pairs, and may trail the line
+    auto same = {"a 3:1.5 18446744073709551615:2",
+                 "a\t3:1.5\t\t18446744073709551615:2\n",
+                 "a 3:1.5 18446744073709551615:2 \r\n",
+                 "a   3:1.5\v18446744073709551615:2\f"};
+    for (auto& text : same)
+    {
+        auto counts = io::libsvm_parser::counts(text);
+        ASSERT_EQUAL(counts.size(), size_t{2});
+        ASSERT_EQUAL(counts[0].first, 2ul);
+        ASSERT_EQUAL(counts[0].second, 1.5);
+        ASSERT_EQUAL(counts[1].first, 18446744073709551614ul);
+        ASSERT_EQUAL(counts[1].second, 2.0);
+    }
+    ASSERT(io::libsvm_parser::counts("a").empty());
+    ASSERT(io::libsvm_parser::counts("a \n").empty());
+    ASSERT(io::libsvm_parser::counts("  \t", false).empty());
+}
+
+void in_place()
+{
+    // the ranges end inside the buffer, with more text after them
+    std::string buffer = "b 2:0.25 9:3 10:75\nc 4:1";
+    auto first = buffer.data();
+    auto newline = first + buffer.find('\n');
+
+    ASSERT_EQUAL(io::libsvm_parser::label(first, newline), class_label{"b"});
+    std::vector<std::pair<term_id, double>> out{{term_id{99}, 1.0}};
+    io::libsvm_parser::counts(first, newline, out);
+    ASSERT_EQUAL(out.size(), size_t{3});
+    ASSERT_EQUAL(out[0].first, 1ul);
+    ASSERT_EQUAL(out[0].second, 0.25);
+    ASSERT_EQUAL(out[2].first, 9ul);
+    ASSERT_EQUAL(out[2].second, 75.0);
+
+    // the vector is reused, and a range may end in the middle of a value
+    io::libsvm_parser::counts(first, newline - 1, out);
+    ASSERT_EQUAL(out.size(), size_t{3});
+    ASSERT_EQUAL(out[2].second, 7.0);
+    io::libsvm_parser::counts(first + 2, first + 8, out, false);
+    ASSERT_EQUAL(out.size(), size_t{1});
+    ASSERT_EQUAL(out[0].second, 0.25);
+
+    ASSERT_EQUAL(io::libsvm_parser::label(newline + 1, first + buffer.size()),
+                 class_label{"c"});
+    io::libsvm_parser::counts(newline + 1, first + buffer.size(), out);
+    ASSERT_EQUAL(out.size(), size_t{1});
+    ASSERT_EQUAL(out[0].first, 3ul);
+}
+
+void delimiter_scanning()
+{
+    // no delimiters, one, a few, bytes of multi-byte UTF-8 characters,
+    // and a set spanning more high nibbles than the vectors handle
+    std::vector<std::string> sets = {"", "\n", " \t\n", "\xe2\x80\xa8\xc2\x85",
+                                     ",;|\x7f\x80\xff"};
+    std::string spread;
+    for (int high = 0; high < 16; ++high)
+        spread += static_cast<char>(high * 16 + 3);
+    sets.push_back(spread);
+
+    std::mt19937 rng{5};
+    for (const auto& delims : sets)
+    {
+        io::delimiter_scanner scanner{delims};
+        for (int ch = 0; ch < 256; ++ch)
+            ASSERT_EQUAL(scanner.is_delimiter(static_cast<char>(ch)),
+                         delims.find(static_cast<char>(ch))
+                             != std::string::npos);
+
+        for (uint64_t size = 0; size < 70; ++size)
+        {
+            // delimiters are rare, so most matches are far into the text
+            std::string text;
+            for (uint64_t i = 0; i < size; ++i)
+            {
+                if (!delims.empty() && rng() % 20 == 0)
+                    text += delims[rng() % delims.size()];
+                else
+                    text += static_cast<char>(rng() % 256);
+            }
+            auto first = text.data();
+            auto last = first + text.size();
+            for (auto it = first; it <= last; ++it)
+            {
+                auto expected = it;
+                while (expected != last && !scanner.is_delimiter(*expected))
+                    ++expected;
+                ASSERT(scanner.find(it, last) == expected);
+            }
+        }
+
+        // a delimiter just past the end of the range is not found
+        if (!delims.empty())
+        {
+            std::string text(40, 'x');
+            text[32] = delims.back();
+            ASSERT(scanner.find(&text[0], &text[32]) == &text[32]);
+            ASSERT(scanner.find(&text[0], &text[33]) == &text[32]);
+        }
+    }
+}
+
+namespace
+{
+/**
+ * Splits text the way io::parser always has: each delimiter ends a
+ * token, possibly an empty one, and the last token need not end with one.
+ */
+std::vector<std::string> split(const std::string& text,
+                               const std::string& delims)
+{
+    std::vector<std::string> tokens;
+    size_t start = 0;
+    for (size_t i = 0; i < text.size(); ++i)
+    {
+        if (delims.find(text[i]) != std::string::npos)
+        {
+            tokens.push_back(text.substr(start, i - start));
+            start = i + 1;
+        }
+    }
+    if (start != text.size())
+        tokens.push_back(text.substr(start));
+    return tokens;
+}
+
+/**
+ * Checks that a parser returns the expected tokens, then runs out.
+ */
+void check_tokens(io::parser& parser, const std::vector<std::string>& tokens)
+{
+    for (uint64_t i = 0; i < tokens.size(); ++i)
+    {
+        ASSERT(parser.has_next());
+        ASSERT_EQUAL(parser.peek(), tokens[i]);
+        if (i % 2 == 0)
+            ASSERT_EQUAL(parser.next(), tokens[i]);
+        else
+            ASSERT_EQUAL(parser.next_token().str(), tokens[i]);
+    }
+    ASSERT(!parser.has_next());
+    try
+    {
+        parser.next_token();
+        FAIL("An exception was not thrown with no tokens left");
+    }
+    catch (io::parser_exception&)
+    {
+        // nothing, we want an exception!
+    }
+}
+}
+
+void tokenizing()
+{
+    std::vector<std::string> texts
+        = {"",
+           "word",
+           " leading and trailing ",
+           "a  b\n\nc\n",
+           "\n\n",
+           "caf\xc3\xa9 na\xc3\xafve\xe2\x80\xa8x",
+           "one,two;;three|four\n"};
+    std::string long_text;
+    std::mt19937 rng{11};
+    for (int i = 0; i < 5000; ++i)
+        long_text += rng() % 7 == 0 ? " ,\n"[rng() % 3]
+                                    : static_cast<char>('a' + rng() % 26);
+    texts.push_back(long_text);
+
+    for (const std::string delims : {" ", " \n", ",;|\n", "\xa8 "})
+    {
+        for (const auto& text : texts)
+        {
+            auto tokens = split(text, delims);
+            io::parser parser{text, delims, io::parser::input_type::String};
+            check_tokens(parser, tokens);
+
+            if (text.empty())
+                continue;
+            {
+                std::ofstream file{"meta-tmp-tokens.txt", std::ios::binary};
+                file << text;
+            }
+            io::parser file_parser{"meta-tmp-tokens.txt", delims};
+            ASSERT_EQUAL(file_parser.filename(), "meta-tmp-tokens.txt");
+            check_tokens(file_parser, tokens);
+        }
+    }
+    filesystem::delete_file("meta-tmp-tokens.txt");
+}
+
 int libsvm_parser_tests()
 {
     int num_failed = 0;
@@ -92,6 +364,16 @@ int libsvm_parser_tests()
         { missing_label(); });
     num_failed += testing::run_test("libsvm-parser-bad-counts", [&]()
         { bad_counts(); });
+    num_failed += testing::run_test("libsvm-parser-exact-values", [&]()
+        { exact_values(); });
+    num_failed += testing::run_test("libsvm-parser-malformed-lines", [&]()
+        { malformed_lines(); });
+    num_failed += testing::run_test("libsvm-parser-in-place", [&]()
+        { in_place(); });
+    num_failed += testing::run_test("delimiter-scanner", [&]()
+        { delimiter_scanning(); });
+    num_failed += testing::run_test("io-parser-tokens", [&]()
+        { tokenizing(); });
 
     return num_failed;
 }
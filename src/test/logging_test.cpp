@@ -0,0 +1,129 @@
+/**
+ * @file logging_test.cpp
+ */
+
+#include <algorithm>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "logging/logger.h"
+#include "test/logging_test.h"
+
+namespace meta
+{
+namespace testing
+{
+
+namespace
+{
+using logger = logging::logger;
+
+/**
+ * @param log The logger to log to
+ * @param thread The number of the logging thread
+ * @param i The number of the line within the thread
+ */
+void log_one(logger& log, uint64_t thread, uint64_t i)
+{
+    logger::log_line line{log, logger::severity_level::info, __LINE__,
+                          __FILE__};
+    line << thread << ' ' << i << logger::log_line::endlg;
+}
+
+/**
+ * @param out The text the sink wrote
+ * @param num_threads The number of threads that logged
+ * @param lines_per_thread The number of lines each thread logged
+ * @param ordered Whether each thread's lines must be in the order it
+ * logged them
+ */
+void check_lines(const std::string& out, uint64_t num_threads,
+                 uint64_t lines_per_thread, bool ordered)
+{
+    std::vector<std::vector<uint64_t>> lines(num_threads);
+    std::istringstream in{out};
+    uint64_t thread;
+    uint64_t i;
+    while (in >> thread >> i)
+    {
+        ASSERT(thread < num_threads);
+        lines[thread].push_back(i);
+    }
+
+    // every line is written exactly once
+    for (auto& thread_lines : lines)
+    {
+        if (!ordered)
+            std::sort(thread_lines.begin(), thread_lines.end());
+        ASSERT_EQUAL(thread_lines.size(), lines_per_thread);
+        for (uint64_t j = 0; j < lines_per_thread; ++j)
+            ASSERT_EQUAL(thread_lines[j], j);
+    }
+}
+
+void async_lines()
+{
+    std::ostringstream out;
+    logger log;
+    log.add_sink({out, logger::severity_level::info,
+                  [](const logger::log_line& line)
+                  {
+                      return line.str() + "\n";
+                  }});
+    log.start_async(16);
+    for (uint64_t i = 0; i < 1000; ++i)
+        log_one(log, 0, i);
+    log.flush();
+    check_lines(out.str(), 1, 1000, true);
+    log.stop_async();
+}
+
+void restart_while_logging()
+{
+    std::ostringstream out;
+    logger log;
+    log.add_sink({out, logger::severity_level::info,
+                  [](const logger::log_line& line)
+                  {
+                      return line.str() + "\n";
+                  }});
+
+    // the writer is started and stopped over and over while other threads
+    // log, so that lines are handed over while the queue is replaced; a
+    // line written synchronously may pass one still queued for a writer
+    // that is stopping, so only the set of lines is checked
+    const uint64_t num_threads = 4;
+    const uint64_t lines_per_thread = 5000;
+    std::vector<std::thread> threads;
+    for (uint64_t t = 0; t < num_threads; ++t)
+    {
+        threads.emplace_back([&log, t]()
+                             {
+            for (uint64_t i = 0; i < lines_per_thread; ++i)
+                log_one(log, t, i);
+        });
+    }
+    for (uint64_t round = 0; round < 200; ++round)
+    {
+        log.start_async(round % 7 + 1);
+        std::this_thread::yield();
+        log.stop_async();
+    }
+    for (auto& thread : threads)
+        thread.join();
+    log.stop_async();
+    check_lines(out.str(), num_threads, lines_per_thread, false);
+}
+}
+
+int logging_tests()
+{
+    int failed = 0;
+    failed += testing::run_test("logging-async-lines", async_lines);
+    failed += testing::run_test("logging-restart-while-logging",
+                                restart_while_logging);
+    return failed;
+}
+}
+}
@@ -78,6 +78,495 @@ int test_threadpool()
     });
 }
 
+int test_nested_wait()
+{
+    return testing::run_test("parallel-nested-wait", []()
+    {
+        // every worker blocks in a task that waits for tasks of its own;
+        // blocking in future::wait() instead would deadlock the pool
+        for (size_t num_threads : {1, 2, 4})
+        {
+            parallel::thread_pool pool{num_threads};
+            std::function<uint64_t(uint64_t)> fib = [&](uint64_t n)
+            {
+                if (n < 2)
+                    return n;
+                auto left = pool.submit_task([&, n]() { return fib(n - 1); });
+                auto right = pool.submit_task([&, n]() { return fib(n - 2); });
+                pool.wait(left);
+                pool.wait(right);
+                return left.get() + right.get();
+            };
+
+            std::vector<std::future<uint64_t>> futures;
+            for (size_t i = 0; i < 2 * num_threads; ++i)
+                futures.emplace_back(
+                    pool.submit_task([&]() { return fib(12); }));
+            for (auto& fut : futures)
+                ASSERT_EQUAL(fut.get(), uint64_t{144});
+        }
+    });
+}
+
+int test_stealing()
+{
+    return testing::run_test("parallel-stealing", []()
+    {
+        // a task submitted from a worker goes on that worker's queue, so
+        // the other workers only get these tasks by stealing them
+        parallel::thread_pool pool{4};
+        auto ids = pool.thread_ids();
+        std::mutex mtx;
+        std::set<std::thread::id> ran_on;
+        std::vector<std::future<size_t>> futures;
+        auto outer = pool.submit_task([&]()
+        {
+            for (size_t i = 0; i < 64; ++i)
+            {
+                futures.emplace_back(pool.submit_task([&, i]()
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                    std::lock_guard<std::mutex> lock{mtx};
+                    ran_on.insert(std::this_thread::get_id());
+                    return i;
+                }));
+            }
+            for (const auto& fut : futures)
+                pool.wait(fut);
+        });
+        outer.get();
+
+        for (size_t i = 0; i < futures.size(); ++i)
+            ASSERT_EQUAL(futures[i].get(), i);
+        ASSERT(ran_on.size() > 1);
+        for (const auto& id : ran_on)
+            ASSERT(std::find(ids.begin(), ids.end(), id) != ids.end());
+        ASSERT_EQUAL(pool.tasks(), size_t{0});
+    });
+}
+
+int test_shutdown()
+{
+    return testing::run_test("parallel-shutdown", []()
+    {
+        std::atomic<size_t> done{0};
+        std::vector<std::future<void>> futures;
+        std::promise<void> gate;
+        auto opened = gate.get_future().share();
+        std::thread opener;
+        size_t queued;
+        {
+            // the workers hold on to the first tasks they take until the
+            // pool is being destroyed, so the rest are still queued then
+            parallel::thread_pool pool{2};
+            for (size_t i = 0; i < 100; ++i)
+            {
+                futures.emplace_back(pool.submit_task([&, opened]()
+                {
+                    opened.wait();
+                    ++done;
+                }));
+            }
+            queued = pool.tasks();
+
+            opener = std::thread{[&]()
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(50));
+                gate.set_value();
+            }};
+        }
+        opener.join();
+
+        ASSERT(queued >= 98);
+        ASSERT_EQUAL(done.load(), size_t{100});
+        for (auto& fut : futures)
+            ASSERT(fut.wait_for(std::chrono::seconds(0))
+                   == std::future_status::ready);
+    });
+}
+
+int test_default_pool()
+{
+    return testing::run_test("parallel-default-pool", []()
+    {
+        auto& pool = parallel::default_pool();
+        ASSERT(&pool == &parallel::default_pool());
+        auto ids = pool.thread_ids();
+
+        // algorithms not given a pool run on the default one, with the
+        // same results as serial code
+        std::vector<std::thread::id> ran_on(10000);
+        parallel::parallel_for(ran_on.begin(), ran_on.end(),
+                               [](std::thread::id& id)
+                               {
+            id = std::this_thread::get_id();
+        });
+        for (const auto& id : ran_on)
+            ASSERT(std::find(ids.begin(), ids.end(), id) != ids.end());
+
+        std::vector<uint64_t> v(100000);
+        std::iota(v.begin(), v.end(), 1);
+        auto square = [](uint64_t x)
+        {
+            return x * x % 1009;
+        };
+        std::vector<uint64_t> expected(v.size());
+        std::transform(v.begin(), v.end(), expected.begin(), square);
+        std::vector<uint64_t> actual(v.size());
+        parallel::parallel_transform(v.begin(), v.end(), actual.begin(),
+                                     square);
+        ASSERT(actual == expected);
+
+        auto sum = parallel::parallel_reduce(
+            v.begin(), v.end(), uint64_t{0},
+            [](uint64_t& acc, uint64_t x) { acc += x; },
+            [](uint64_t& total, uint64_t part) { total += part; });
+        ASSERT_EQUAL(sum, std::accumulate(v.begin(), v.end(), uint64_t{0}));
+
+        // the running pool keeps its size
+        parallel::set_default_threads(ids.size());
+        for (size_t num_threads : {size_t{0}, ids.size() + 1})
+        {
+            bool thrown = false;
+            try
+            {
+                parallel::set_default_threads(num_threads);
+            }
+            catch (parallel::default_pool_exception&)
+            {
+                thrown = true;
+            }
+            ASSERT(thrown);
+        }
+
+        for (const std::string& line :
+             {std::string{"thread-placement = \"sideways\""},
+              std::string{"num-threads = 0"},
+              "num-threads = " + std::to_string(ids.size() + 1)})
+        {
+            {
+                std::ofstream config{"default-pool-test.toml"};
+                config << line << "\n";
+            }
+            auto config = cpptoml::parse_file("default-pool-test.toml");
+            bool thrown = false;
+            try
+            {
+                parallel::configure_default_pool(config);
+            }
+            catch (parallel::default_pool_exception&)
+            {
+                thrown = true;
+            }
+            ASSERT(thrown);
+        }
+        filesystem::delete_file("default-pool-test.toml");
+        ASSERT(&pool == &parallel::default_pool());
+        ASSERT_EQUAL(pool.thread_ids().size(), ids.size());
+    });
+}
+
+int test_chunks()
+{
+    return testing::run_test("parallel-chunks", []()
+    {
+        for (size_t num_threads : {1, 3})
+        {
+            parallel::thread_pool pool{num_threads};
+            for (uint64_t size : {0, 1, 7, 1000, 100003})
+            {
+                for (uint64_t grain : {0, 1, 7, 5000, 200000})
+                {
+                    std::vector<std::atomic<uint32_t>> hits(size);
+                    for (auto& hit : hits)
+                        hit = 0;
+                    std::vector<std::atomic<bool>> busy(num_threads);
+                    for (auto& b : busy)
+                        b = false;
+                    std::atomic<bool> ok{true};
+
+                    parallel::parallel_chunks(
+                        pool, size, grain,
+                        [&](uint64_t task, uint64_t first, uint64_t last)
+                        {
+                        // no two chunks run on one task at the same time
+                        if (task >= num_threads || busy[task].exchange(true))
+                        {
+                            ok = false;
+                            return;
+                        }
+                        if (first >= last || last > size
+                            || (grain > 0 && last - first > grain))
+                            ok = false;
+                        for (auto i = first; i < last; ++i)
+                            ++hits[i];
+                        busy[task] = false;
+                    });
+
+                    ASSERT(ok.load());
+                    for (const auto& hit : hits)
+                        ASSERT_EQUAL(hit.load(), uint32_t{1});
+                }
+            }
+        }
+    });
+}
+
+int test_reduce_transform()
+{
+    return testing::run_test("parallel-reduce-transform", []()
+    {
+        parallel::thread_pool pool{3};
+        std::vector<uint64_t> v(100003);
+        std::mt19937_64 rng{47};
+        for (auto& x : v)
+            x = rng() % 1000;
+
+        std::vector<uint64_t> histogram(1000, 0);
+        for (const auto& x : v)
+            ++histogram[x];
+        auto sum = std::accumulate(v.begin(), v.end(), uint64_t{0});
+        auto max = *std::max_element(v.begin(), v.end());
+
+        std::vector<double> roots(v.size());
+        std::transform(v.begin(), v.end(), roots.begin(), [](uint64_t x)
+        {
+            return std::sqrt(static_cast<double>(x));
+        });
+
+        for (uint64_t grain : {0, 1, 13, 200000})
+        {
+            ASSERT_EQUAL(parallel::parallel_reduce(
+                             v.begin(), v.end(), pool, uint64_t{0},
+                             [](uint64_t& acc, uint64_t x) { acc += x; },
+                             [](uint64_t& total, uint64_t part)
+                             { total += part; },
+                             grain),
+                         sum);
+
+            ASSERT_EQUAL(parallel::parallel_reduce(
+                             v.begin(), v.end(), pool, uint64_t{0},
+                             [](uint64_t& acc, uint64_t x)
+                             { acc = std::max(acc, x); },
+                             [](uint64_t& total, uint64_t part)
+                             { total = std::max(total, part); },
+                             grain),
+                         max);
+
+            // the identity is copied into each accumulator
+            auto counts = parallel::parallel_reduce(
+                v.begin(), v.end(), pool, std::vector<uint64_t>(1000, 0),
+                [](std::vector<uint64_t>& acc, uint64_t x) { ++acc[x]; },
+                [](std::vector<uint64_t>& total,
+                   const std::vector<uint64_t>& part)
+                {
+                    for (size_t i = 0; i < part.size(); ++i)
+                        total[i] += part[i];
+                },
+                grain);
+            ASSERT(counts == histogram);
+
+            std::vector<double> out(v.size(), -1);
+            parallel::parallel_transform(v.begin(), v.end(), out.begin(),
+                                         pool, [](uint64_t x)
+                                         {
+                return std::sqrt(static_cast<double>(x));
+            }, grain);
+            ASSERT(out == roots);
+        }
+
+        // a range that can only be walked forward is split into blocks
+        std::list<uint64_t> list(v.begin(), v.end());
+        parallel::parallel_for(list.begin(), list.end(), pool,
+                               [](uint64_t& x)
+                               {
+            x = x * x % 1009;
+        });
+        auto it = list.begin();
+        for (const auto& x : v)
+            ASSERT_EQUAL(*it++, x * x % 1009);
+    });
+}
+
+int test_algorithms()
+{
+    return testing::run_test("parallel-algorithms", []()
+    {
+        using item = std::pair<uint64_t, uint64_t>;
+        auto by_key = [](const item& a, const item& b)
+        {
+            return a.first < b.first;
+        };
+
+        // sizes on both sides of the serial cutoff, with many equal keys
+        std::mt19937_64 rng{47};
+        for (size_t num_threads : {1, 3})
+        {
+            parallel::thread_pool pool{num_threads};
+            for (uint64_t size : {0, 1000, 100003})
+            {
+                std::vector<item> items(size);
+                for (uint64_t i = 0; i < size; ++i)
+                    items[i] = {rng() % 5000, i};
+
+                auto expected = items;
+                std::sort(expected.begin(), expected.end());
+                auto sorted = items;
+                parallel::sort(sorted.begin(), sorted.end(), pool,
+                               std::less<item>{});
+                ASSERT(sorted == expected);
+
+                std::vector<uint64_t> keys(size);
+                for (uint64_t i = 0; i < size; ++i)
+                    keys[i] = items[i].first;
+                auto expected_keys = keys;
+                std::sort(expected_keys.begin(), expected_keys.end(),
+                          std::greater<uint64_t>{});
+                parallel::sort(keys.begin(), keys.end(), pool,
+                               std::greater<uint64_t>{});
+                ASSERT(keys == expected_keys);
+
+                // equal keys must come from the first range first
+                auto mid = items.begin() + static_cast<std::ptrdiff_t>(
+                                               size / 3);
+                std::stable_sort(items.begin(), mid, by_key);
+                std::stable_sort(mid, items.end(), by_key);
+                std::vector<item> merged(size);
+                std::merge(items.begin(), mid, mid, items.end(),
+                           merged.begin(), by_key);
+                std::vector<item> out(size);
+                auto end = parallel::merge(items.begin(), mid, mid,
+                                           items.end(), out.begin(), pool,
+                                           by_key);
+                ASSERT(end == out.end());
+                ASSERT(out == merged);
+
+                auto odd = [](const item& x)
+                {
+                    return x.first % 2 == 1;
+                };
+                auto partitioned = items;
+                auto expected_end = std::stable_partition(
+                    items.begin(), items.end(), odd);
+                auto actual_end = parallel::stable_partition(
+                    partitioned.begin(), partitioned.end(), pool, odd);
+                ASSERT_EQUAL(actual_end - partitioned.begin(),
+                             expected_end - items.begin());
+                ASSERT(partitioned == items);
+            }
+        }
+    });
+}
+
+int test_placement()
+{
+    return testing::run_test("parallel-placement", []()
+    {
+        using parallel::internal::parse_cpu_list;
+        ASSERT(parse_cpu_list("0-3,8,10-11\n")
+               == (std::vector<unsigned>{0, 1, 2, 3, 8, 10, 11}));
+        ASSERT(parse_cpu_list("5") == std::vector<unsigned>{5});
+        ASSERT(parse_cpu_list("").empty());
+
+        auto topo = parallel::detect_topology();
+        ASSERT(!topo.nodes.empty());
+        for (const auto& cpus : topo.nodes)
+            ASSERT(!cpus.empty());
+
+        for (auto where : {parallel::placement::none,
+                           parallel::placement::nodes,
+                           parallel::placement::cpus})
+        {
+            parallel::thread_pool pool{5, where};
+            auto ids = pool.thread_ids();
+            auto num_nodes = where == parallel::placement::none
+                                 ? size_t{1}
+                                 : topo.nodes.size();
+            ASSERT_EQUAL(pool.num_nodes(), num_nodes);
+            ASSERT_EQUAL(pool.current_node(), size_t{0});
+
+            // the workers of a node are numbered together
+            for (size_t w = 0; w < ids.size(); ++w)
+            {
+                ASSERT(pool.node(w) < num_nodes);
+                if (w > 0)
+                    ASSERT(pool.node(w - 1) <= pool.node(w));
+            }
+
+            // tasks given to a worker run with the same results as
+            // serial code, on a worker that knows its node
+            std::vector<std::future<uint64_t>> futures;
+            for (uint64_t i = 0; i < 100; ++i)
+            {
+                futures.emplace_back(pool.submit_to(i, [&, i]()
+                {
+                    auto self = std::find(ids.begin(), ids.end(),
+                                          std::this_thread::get_id());
+                    if (self == ids.end()
+                        || pool.current_node()
+                               != pool.node(static_cast<size_t>(
+                                      self - ids.begin())))
+                        return uint64_t{0};
+                    return i * i + 1;
+                }));
+            }
+            for (uint64_t i = 0; i < futures.size(); ++i)
+                ASSERT_EQUAL(futures[i].get(), i * i + 1);
+
+            std::vector<std::atomic<uint32_t>> calls(ids.size());
+            for (auto& c : calls)
+                c = 0;
+            parallel::for_each_worker(pool, [&](uint64_t w)
+            {
+                ++calls[w];
+            });
+            for (const auto& c : calls)
+                ASSERT_EQUAL(c.load(), uint32_t{1});
+        }
+    });
+}
+
+int test_bounded_queue()
+{
+    return testing::run_test("parallel-bounded-queue", []()
+    {
+        // a small capacity makes the producers block on a full queue
+        parallel::bounded_queue<size_t> queue{4};
+        parallel::thread_pool pool{};
+        std::vector<std::future<size_t>> consumers;
+        for (size_t i = 0; i < 4; ++i)
+        {
+            consumers.emplace_back(pool.submit_task([&]()
+            {
+                size_t sum = 0;
+                size_t item;
+                while (queue.pop(item))
+                    sum += item;
+                return sum;
+            }));
+        }
+
+        std::vector<std::thread> producers;
+        for (size_t i = 0; i < 2; ++i)
+        {
+            producers.emplace_back([&]()
+            {
+                for (size_t j = 1; j <= 1000; ++j)
+                    queue.push(j);
+            });
+        }
+        for (auto& producer : producers)
+            producer.join();
+        queue.close();
+
+        size_t sum = 0;
+        for (auto& fut : consumers)
+            sum += fut.get();
+        ASSERT_EQUAL(sum, size_t{2 * 500500});
+        ASSERT(!queue.push(1));
+    });
+}
+
 int parallel_tests()
 {
     size_t n = 10000000;
@@ -90,6 +579,15 @@ int parallel_tests()
 
     num_failed += test_correctness(v);
     num_failed += test_threadpool();
+    num_failed += test_nested_wait();
+    num_failed += test_stealing();
+    num_failed += test_shutdown();
+    num_failed += test_default_pool();
+    num_failed += test_chunks();
+    num_failed += test_reduce_transform();
+    num_failed += test_algorithms();
+    num_failed += test_placement();
+    num_failed += test_bounded_queue();
     return num_failed;
 }
 }
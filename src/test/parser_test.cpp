@@ -3,6 +3,9 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+#include <fstream>
+#include <random>
 #include <sstream>
 #include "test/parser_test.h"
 #include "test/unit_test.h"
@@ -17,6 +20,11 @@
 #include "parser/trees/visitors/debinarizer.h"
 #include "parser/trees/internal_node.h"
 #include "parser/trees/leaf_node.h"
+#include "parser/trees/evalb.h"
+#include "parser/trees/visitors/sequence_extractor.h"
+#include "parser/sr_parser.h"
+#include "parser/state_arena.h"
+#include "util/filesystem.h"
 
 namespace meta
 {
@@ -253,6 +261,505 @@ int debinarizer_tests()
     return num_failed;
 }
 
+namespace
+{
+/**
+ * Generates trees from a small grammar of noun and verb phrases, with a
+ * few words for every tag.
+ */
+class treebank_generator
+{
+  public:
+    treebank_generator(uint64_t seed) : rng_{seed}
+    {
+    }
+
+    parser::parse_tree operator()()
+    {
+        return tree("((S " + noun_phrase(2) + " " + verb_phrase() + " (. .)))");
+    }
+
+  private:
+    std::string word(const std::string& tag,
+                     const std::vector<std::string>& words)
+    {
+        return "(" + tag + " " + words[rng_() % words.size()] + ")";
+    }
+
+    std::string noun_phrase(uint64_t depth)
+    {
+        auto choice = rng_() % (depth > 0 ? 4 : 3);
+        if (choice == 0)
+            return "(NP " + word("NNP", {"Alice", "Bob", "Carol"}) + ")";
+        if (choice == 3)
+            return "(NP " + noun_phrase(depth - 1) + " (PP "
+                   + word("IN", {"with", "near", "of"}) + " "
+                   + noun_phrase(depth - 1) + "))";
+
+        auto np = "(NP " + word("DT", {"the", "a", "every"}) + " ";
+        if (choice == 2)
+            np += word("JJ", {"big", "red", "old", "quiet"}) + " ";
+        return np + word("NN", {"dog", "cat", "park", "telescope", "tree"})
+               + ")";
+    }
+
+    std::string verb_phrase()
+    {
+        auto verb = word("VBD", {"saw", "liked", "found", "chased"});
+        switch (rng_() % 3)
+        {
+            case 0:
+                return "(VP " + word("VBD", {"slept", "left", "ran"}) + ")";
+            case 1:
+                return "(VP " + verb + " " + noun_phrase(1) + ")";
+            default:
+                return "(VP " + verb + " " + noun_phrase(1) + " (PP "
+                       + word("IN", {"with", "near"}) + " " + noun_phrase(0)
+                       + "))";
+        }
+    }
+
+    std::mt19937 rng_;
+};
+
+/**
+ * @param num_trees The number of trees to generate
+ * @param seed The seed for the generator
+ * @return trees generated from a small grammar
+ */
+std::vector<parser::parse_tree> treebank(uint64_t num_trees, uint64_t seed)
+{
+    treebank_generator gen{seed};
+    std::vector<parser::parse_tree> trees;
+    for (uint64_t i = 0; i < num_trees; ++i)
+        trees.push_back(gen());
+    return trees;
+}
+
+/**
+ * @param trees The trees to read the sentences from
+ * @return the tagged sentences of the trees
+ */
+std::vector<sequence::sequence>
+    sentences(const std::vector<parser::parse_tree>& trees)
+{
+    std::vector<sequence::sequence> seqs;
+    for (const auto& tr : trees)
+    {
+        parser::sequence_extractor seq_ex;
+        tr.visit(seq_ex);
+        seqs.push_back(seq_ex.sequence());
+    }
+    return seqs;
+}
+
+/**
+ * @return options that train deterministically, and quickly
+ */
+parser::sr_parser::training_options training_options()
+{
+    parser::sr_parser::training_options options;
+    options.batch_size = 10;
+    options.max_iterations = 4;
+    options.seed = 47;
+    options.num_threads = 1;
+    return options;
+}
+
+/**
+ * @param options The options to train with
+ * @return a parser trained on the generated training trees
+ */
+parser::sr_parser train_parser(parser::sr_parser::training_options options)
+{
+    auto trees = treebank(150, 1);
+    parser::sr_parser parser;
+    parser.train(trees, options);
+    return parser;
+}
+
+/**
+ * @return the parses of the sentences, parsed one at a time
+ */
+std::vector<parser::parse_tree>
+    parse_serially(const parser::sr_parser& parser,
+                   const std::vector<sequence::sequence>& sentences)
+{
+    std::vector<parser::parse_tree> trees;
+    for (const auto& sent : sentences)
+        trees.push_back(parser.parse(sent));
+    return trees;
+}
+
+/**
+ * Checks that two lists of parses are the same.
+ */
+void check_parses(const std::vector<parser::parse_tree>& parses,
+                  const std::vector<parser::parse_tree>& expected)
+{
+    ASSERT_EQUAL(parses.size(), expected.size());
+    for (uint64_t i = 0; i < parses.size(); ++i)
+        ASSERT(parses[i] == expected[i]);
+}
+
+/**
+ * @return the labeled F1 of parses against the gold trees
+ */
+double f1(const std::vector<parser::parse_tree>& parses,
+          const std::vector<parser::parse_tree>& gold)
+{
+    parser::evalb eval;
+    for (uint64_t i = 0; i < parses.size(); ++i)
+        eval.add_tree(parses[i], gold[i]);
+    return eval.labeled_f1();
+}
+}
+
+int hashed_parser_tests()
+{
+    using namespace parser;
+
+    auto gold = treebank(40, 2);
+    auto sents = sentences(gold);
+    auto expected = parse_serially(train_parser(training_options()), sents);
+
+    return testing::run_test("sr_parser_hashed_features", [&]()
+                             {
+        // the grammar is learned well enough to tell a broken parser apart
+        ASSERT(f1(expected, gold) > 90.0);
+
+        // hashing the features into a table loses little accuracy, and
+        // training on it is as deterministic as before
+        auto options = training_options();
+        options.hash_bits = 16;
+        auto hashed = parse_serially(train_parser(options), sents);
+        ASSERT(f1(hashed, gold) > f1(expected, gold) - 5.0);
+        check_parses(parse_serially(train_parser(options), sents), hashed);
+
+        // a small table collides, but still parses every sentence
+        options.hash_bits = 2;
+        auto small = parse_serially(train_parser(options), sents);
+        ASSERT_EQUAL(small.size(), sents.size());
+    });
+}
+
+int dense_parser_tests()
+{
+    using namespace parser;
+
+    auto gold = treebank(40, 2);
+    auto sents = sentences(gold);
+
+    return testing::run_test("sr_parser_densify", [&]()
+                             {
+        auto parser = train_parser(training_options());
+        auto expected = parse_serially(parser, sents);
+
+        parser.densify();
+        check_parses(parse_serially(parser, sents), expected);
+        parser.densify();
+        check_parses(parse_serially(parser, sents), expected);
+
+        // a dense parser saves its weights as a frozen model
+        filesystem::remove_all("meta-tmp-parser");
+        filesystem::make_directory("meta-tmp-parser");
+        parser.save("meta-tmp-parser");
+        {
+            sr_parser loaded{"meta-tmp-parser"};
+            check_parses(parse_serially(loaded, sents), expected);
+            loaded.densify();
+            check_parses(parse_serially(loaded, sents), expected);
+        }
+        filesystem::remove_all("meta-tmp-parser");
+    });
+}
+
+int batch_parse_tests()
+{
+    using namespace parser;
+
+    auto gold = treebank(40, 2);
+    auto sents = sentences(gold);
+
+    return testing::run_test("sr_parser_batch_parse", [&]()
+                             {
+        auto parser = train_parser(training_options());
+        auto expected = parse_serially(parser, sents);
+        for (uint64_t num_threads : {1, 2, 4})
+        {
+            parallel::thread_pool pool{num_threads};
+            check_parses(parser.parse(sents, pool), expected);
+        }
+        check_parses(parser.parse(sents), expected);
+
+        // a beam search parser keeps a beam in each thread's workspace
+        auto options = training_options();
+        options.algorithm = sr_parser::training_algorithm::BEAM_SEARCH;
+        options.beam_size = 4;
+        options.max_iterations = 2;
+        auto beam = train_parser(options);
+        parallel::thread_pool pool{3};
+        check_parses(beam.parse(sents, pool), parse_serially(beam, sents));
+
+        ASSERT(parser.parse(std::vector<sequence::sequence>{}, pool).empty());
+        auto empty = parser.parse(sequence::sequence{});
+        ASSERT(empty == parse_tree{make_unique<internal_node>("ROOT"_cl)});
+    });
+}
+
+int state_arena_tests()
+{
+    using namespace parser;
+
+    auto num_failed = int{0};
+
+    num_failed += testing::run_test("state_arena_stacks", [&]()
+                                    {
+        state_arena arena;
+        arena.add_word("DT"_cl, "the");
+        arena.add_word("NN"_cl, "dog");
+        arena.add_word("VBD"_cl, "ran");
+        ASSERT_EQUAL(arena.num_words(), 3ul);
+        ASSERT(arena.word(1)->is_leaf());
+        ASSERT_EQUAL(arena.word(1)->word(), "dog");
+
+        auto np = arena.make_node("NP"_cl, arena.word(0), arena.word(1),
+                                  arena.word(1));
+        ASSERT(!np->is_leaf());
+        ASSERT_EQUAL(np->num_children(), 2ul);
+        ASSERT(np->head_constituent() == arena.word(1));
+        ASSERT(np->head_lexicon() == arena.word(1));
+        ASSERT_EQUAL(np->word(), "dog");
+        ASSERT(!np->is_temporary());
+        ASSERT(arena.make_node("S*"_cl, np, arena.word(2), np)->is_temporary());
+
+        // stacks share the cells below them, so pushing onto a stack
+        // leaves the other stacks built on it as they were
+        auto empty = state_arena::empty_stack;
+        auto one = arena.push(empty, arena.word(0));
+        auto two = arena.push(one, arena.word(1));
+        auto other = arena.push(one, np);
+        ASSERT_EQUAL(arena.size(empty), 0ul);
+        ASSERT_EQUAL(arena.size(two), 2ul);
+        ASSERT_EQUAL(arena.size(other), 2ul);
+        ASSERT(arena.top(two) == arena.word(1));
+        ASSERT(arena.top(other) == np);
+        ASSERT_EQUAL(arena.pop(two), one);
+        ASSERT_EQUAL(arena.pop(other), one);
+        ASSERT(arena.top(arena.pop(other)) == arena.word(0));
+        ASSERT_EQUAL(arena.pop(one), empty);
+
+        auto expected = make_unique<internal_node>("NP"_cl);
+        expected->add_child(make_unique<leaf_node>("DT"_cl, "the"));
+        expected->add_child(make_unique<leaf_node>("NN"_cl, "dog"));
+        ASSERT(parse_tree{np->tree()} == parse_tree{std::move(expected)});
+
+        // nodes and words do not move as the arena grows, and are reused
+        // once it is cleared
+        for (uint64_t round = 0; round < 2; ++round)
+        {
+            arena.clear();
+            ASSERT_EQUAL(arena.num_words(), 0ul);
+            for (uint64_t i = 0; i < 3000; ++i)
+                arena.add_word("NN"_cl, std::to_string(i));
+            auto stack = empty;
+            for (uint64_t i = 1; i < 3000; ++i)
+                stack = arena.push(stack,
+                                   arena.make_node("NP"_cl, arena.word(i - 1),
+                                                   arena.word(i),
+                                                   arena.word(i)));
+            ASSERT_EQUAL(arena.size(stack), 2999ul);
+            for (uint64_t i = 0; i < 3000; ++i)
+                ASSERT_EQUAL(arena.word(i)->word(), std::to_string(i));
+            for (uint64_t i = 2999; i > 0; --i, stack = arena.pop(stack))
+                ASSERT_EQUAL(arena.top(stack)->word(), std::to_string(i));
+        }
+    });
+
+    num_failed += testing::run_test("state_arena_parses", [&]()
+                                    {
+        // each thread parses many sentences with one arena, so parsing
+        // them in another order must not change any parse
+        auto sents = sentences(treebank(40, 2));
+        auto parser = train_parser(training_options());
+        auto expected = parse_serially(parser, sents);
+        std::reverse(sents.begin(), sents.end());
+        std::reverse(expected.begin(), expected.end());
+        parallel::thread_pool pool{1};
+        check_parses(parser.parse(sents, pool), expected);
+        check_parses(parse_serially(parser, sents), expected);
+    });
+
+    return num_failed;
+}
+
+int parser_model_tests()
+{
+    using namespace parser;
+
+    auto gold = treebank(40, 2);
+    auto sents = sentences(gold);
+
+    return testing::run_test("sr_parser_hashed_model", [&]()
+                             {
+        auto options = training_options();
+        options.hash_bits = 12;
+        auto hashed = train_parser(options);
+        auto expected = parse_serially(hashed, sents);
+
+        filesystem::remove_all("meta-tmp-parser");
+        filesystem::remove_all("meta-tmp-parser-copy");
+        filesystem::make_directory("meta-tmp-parser");
+        filesystem::make_directory("meta-tmp-parser-copy");
+        hashed.save("meta-tmp-parser");
+        ASSERT(filesystem::file_exists("meta-tmp-parser/parser.hashed"));
+        {
+            sr_parser loaded{"meta-tmp-parser"};
+            check_parses(parse_serially(loaded, sents), expected);
+
+            // a parser saves the table it maps
+            loaded.save("meta-tmp-parser-copy");
+            sr_parser copy{"meta-tmp-parser-copy"};
+            check_parses(parse_serially(copy, sents), expected);
+        }
+
+        // saving an unhashed model removes the table
+        auto plain = train_parser(training_options());
+        plain.save("meta-tmp-parser");
+        ASSERT(!filesystem::file_exists("meta-tmp-parser/parser.hashed"));
+        {
+            sr_parser loaded{"meta-tmp-parser"};
+            check_parses(parse_serially(loaded, sents),
+                         parse_serially(plain, sents));
+        }
+
+        // a table cut short is not mapped
+        hashed.save("meta-tmp-parser");
+        auto size = filesystem::file_size("meta-tmp-parser/parser.hashed");
+        {
+            std::string table(size / 2, '\0');
+            std::ifstream in{"meta-tmp-parser/parser.hashed",
+                             std::ios::binary};
+            in.read(&table[0], static_cast<std::streamsize>(table.size()));
+            std::ofstream out{"meta-tmp-parser/parser.hashed",
+                              std::ios::binary};
+            out.write(table.data(),
+                      static_cast<std::streamsize>(table.size()));
+        }
+        bool thrown = false;
+        try
+        {
+            sr_parser loaded{"meta-tmp-parser"};
+        }
+        catch (sr_parser::exception&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+
+        filesystem::remove_all("meta-tmp-parser");
+        filesystem::remove_all("meta-tmp-parser-copy");
+    });
+}
+
+int training_data_tests()
+{
+    using namespace parser;
+
+    auto sents = sentences(treebank(40, 2));
+
+    return testing::run_test("sr_parser_training_cache", [&]()
+                             {
+        auto expected = parse_serially(train_parser(training_options()),
+                                       sents);
+
+        // preprocessing on several threads gives the same transitions,
+        // and so the same model
+        auto options = training_options();
+        options.num_threads = 4;
+        check_parses(parse_serially(train_parser(options), sents), expected);
+
+        // the preprocessed trees are cached, and read back in place of
+        // the trees given to train()
+        filesystem::remove_all("meta-tmp-parser-cache");
+        ASSERT(!sr_parser::cached("meta-tmp-parser-cache"));
+        options = training_options();
+        options.cache = "meta-tmp-parser-cache";
+        check_parses(parse_serially(train_parser(options), sents), expected);
+        ASSERT(sr_parser::cached("meta-tmp-parser-cache"));
+
+        std::vector<parse_tree> none;
+        sr_parser parser;
+        parser.train(none, options);
+        check_parses(parse_serially(parser, sents), expected);
+        filesystem::remove_all("meta-tmp-parser-cache");
+    });
+}
+
+/**
+ * Checks that two evaluations counted the same brackets and trees.
+ */
+void check_evalb(const parser::evalb& eval, const parser::evalb& expected)
+{
+    ASSERT_EQUAL(eval.matched(), expected.matched());
+    ASSERT_EQUAL(eval.proposed_total(), expected.proposed_total());
+    ASSERT_EQUAL(eval.gold_total(), expected.gold_total());
+    ASSERT_APPROX_EQUAL(eval.perfect(), expected.perfect());
+    ASSERT_APPROX_EQUAL(eval.average_crossing(), expected.average_crossing());
+    ASSERT_APPROX_EQUAL(eval.zero_crossing(), expected.zero_crossing());
+}
+
+int evalb_tests()
+{
+    using namespace parser;
+
+    auto gold = treebank(100, 2);
+    auto sents = sentences(gold);
+
+    return testing::run_test("evalb_parallel", [&]()
+                             {
+        auto parser = train_parser(training_options());
+        auto expected = parse_serially(parser, sents);
+        evalb serial;
+        for (uint64_t i = 0; i < gold.size(); ++i)
+            serial.add_tree(expected[i], gold[i]);
+        ASSERT(serial.matched() < serial.gold_total());
+
+        for (uint64_t num_threads : {1, 3})
+        {
+            parallel::thread_pool pool{num_threads};
+            std::vector<parse_tree> proposed;
+            check_evalb(parser.evaluate(sents, gold, pool, &proposed), serial);
+            check_parses(proposed, expected);
+            check_evalb(parser.evaluate(sents, gold, pool), serial);
+
+            evalb eval;
+            eval.add_trees(expected, gold, pool);
+            check_evalb(eval, serial);
+        }
+
+        evalb first;
+        evalb second;
+        for (uint64_t i = 0; i < gold.size(); ++i)
+            (i < 30 ? first : second).add_tree(expected[i], gold[i]);
+        first.merge(second);
+        check_evalb(first, serial);
+
+        bool thrown = false;
+        try
+        {
+            parallel::thread_pool pool{2};
+            sents.pop_back();
+            parser.evaluate(sents, gold, pool);
+        }
+        catch (sr_parser::exception&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+    });
+}
+
 int parser_tests()
 {
     logging::set_cerr_logging();
@@ -261,6 +768,13 @@ int parser_tests()
     num_failed += head_finder_tests();
     num_failed += binarizer_tests();
     num_failed += debinarizer_tests();
+    num_failed += hashed_parser_tests();
+    num_failed += dense_parser_tests();
+    num_failed += batch_parse_tests();
+    num_failed += state_arena_tests();
+    num_failed += parser_model_tests();
+    num_failed += training_data_tests();
+    num_failed += evalb_tests();
     return num_failed;
 }
 }
@@ -3,8 +3,20 @@
  * @author Sean Massung
  */
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
 #include "test/ranker_test.h"
+#include "corpus/corpus.h"
 #include "corpus/document.h"
+#include "index/score_data.h"
+#include "parallel/parallel_for.h"
+#include "parallel/thread_pool.h"
+#include "util/filesystem.h"
+#include "util/shim.h"
 
 namespace meta
 {
@@ -34,6 +46,984 @@ void test_rank(Ranker& r, Index& idx, const std::string& encoding)
     }
 }
 
+/**
+ * A ranker that cannot bound its scores, forcing term-at-a-time scoring.
+ */
+template <class Ranker>
+class unbounded_ranker : public Ranker
+{
+  public:
+    double score_upper_bound(const index::score_data&) const override
+    {
+        return std::numeric_limits<double>::infinity();
+    }
+};
+
+template <class Ranker>
+void test_score_postings(Ranker& r, index::inverted_index& idx)
+{
+    corpus::document query;
+    query.increment("term", 2);
+    index::score_data sd{idx, idx.avg_doc_length(), idx.num_docs(),
+                         idx.total_corpus_terms(), query};
+    sd.query_term_weight = 2;
+
+    index::posting_block block;
+    double scores[index::posting_block::capacity];
+    for (uint64_t t = 0; t < idx.unique_terms(); t += 41)
+    {
+        term_id t_id{t};
+        sd.t_id = t_id;
+        sd.doc_count = idx.doc_freq(t_id);
+        sd.corpus_term_count = idx.total_num_occurences(t_id);
+        sd.corpus_term_prob = idx.collection_probability(t_id);
+        block.size = 0;
+        auto pdata = idx.search_primary(t_id);
+        for (const auto& posting : pdata->counts())
+        {
+            if (block.size == index::posting_block::capacity)
+                break;
+            auto info = idx.doc_info(posting.first);
+            auto i = block.size++;
+            block.d_ids[i] = posting.first;
+            block.doc_term_counts[i] = static_cast<uint64_t>(posting.second);
+            block.doc_sizes[i] = info.length;
+            block.doc_unique_terms[i] = info.unique_terms;
+        }
+
+        r.score_postings(sd, block, scores);
+        for (uint64_t i = 0; i < block.size; ++i)
+        {
+            sd.d_id = block.d_ids[i];
+            sd.doc_term_count = block.doc_term_counts[i];
+            sd.doc_size = block.doc_sizes[i];
+            sd.doc_unique_terms = block.doc_unique_terms[i];
+            ASSERT(scores[i] == r.score_one(sd));
+        }
+    }
+}
+
+template <class Ranker, class Index>
+void test_document_at_a_time(Ranker& r, Index& idx,
+                             const std::string& encoding)
+{
+    unbounded_ranker<Ranker> exhaustive;
+    for (size_t i = 0; i < idx.num_docs(); i += 10)
+    {
+        auto d_id = idx.docs()[i];
+        corpus::document query{idx.doc_path(d_id), doc_id{i}};
+        query.encoding(encoding);
+
+        for (uint64_t num_results : {1, 10, 100})
+        {
+            auto ranking = r.score(idx, query, num_results);
+            auto expected = exhaustive.score(idx, query, num_results);
+            ASSERT_EQUAL(ranking.size(), expected.size());
+            for (size_t j = 0; j < ranking.size(); ++j)
+                ASSERT_APPROX_EQUAL(ranking[j].second, expected[j].second);
+        }
+    }
+}
+
+template <class Ranker>
+void test_conjunctive(Ranker& r, index::inverted_index& idx,
+                      const std::string& encoding)
+{
+    unbounded_ranker<Ranker> exhaustive;
+    for (uint64_t i = 0; i < idx.num_docs(); i += 50)
+    {
+        corpus::document doc{idx.doc_path(doc_id{i}), doc_id{i}};
+        doc.encoding(encoding);
+        idx.tokenize(doc);
+
+        // a few of the document's terms, so the intersection holds it
+        std::vector<std::string> words;
+        for (const auto& count : doc.counts())
+            words.push_back(count.first);
+        std::sort(words.begin(), words.end());
+        for (uint64_t num_terms = 1; num_terms <= 3; ++num_terms)
+        {
+            corpus::document query;
+            for (uint64_t j = 0; j < num_terms && j < words.size(); ++j)
+                query.increment(words[(j * 7 + i) % words.size()], 1);
+
+            // the documents containing every query term
+            std::vector<uint64_t> num_matched(idx.num_docs(), 0);
+            for (const auto& count : query.counts())
+            {
+                auto pdata = idx.search_primary(idx.get_term_id(count.first));
+                for (const auto& posting : pdata->counts())
+                    ++num_matched[posting.first];
+            }
+            std::vector<doc_id> expected;
+            for (uint64_t d = 0; d < num_matched.size(); ++d)
+            {
+                if (num_matched[d] == query.counts().size())
+                    expected.push_back(doc_id{d});
+            }
+
+            auto ranking = r.score_conjunctive(idx, query, idx.num_docs());
+            ASSERT_EQUAL(ranking.size(), expected.size());
+            std::vector<doc_id> found;
+            for (const auto& result : ranking)
+                found.push_back(result.first);
+            std::sort(found.begin(), found.end());
+            ASSERT(found == expected);
+            ASSERT(std::binary_search(found.begin(), found.end(), doc_id{i}));
+
+            // the intersection's scores are those of the full ranking
+            auto full = exhaustive.score(idx, query, idx.num_docs());
+            std::unordered_map<doc_id, double> scores{full.begin(),
+                                                      full.end()};
+            for (const auto& result : ranking)
+                ASSERT_APPROX_EQUAL(result.second, scores[result.first]);
+
+            auto top = r.score_conjunctive(idx, query, 3);
+            ASSERT_EQUAL(top.size(), std::min<uint64_t>(3, expected.size()));
+            for (uint64_t j = 0; j < top.size(); ++j)
+                ASSERT_APPROX_EQUAL(top[j].second, ranking[j].second);
+        }
+    }
+}
+
+template <class Ranker, class Index>
+void test_concurrent_queries(Ranker& r, Index& idx,
+                             const std::string& encoding)
+{
+    // queries are tokenized up front, since the index's analyzer is not
+    // meant to be shared between threads
+    std::vector<corpus::document> queries;
+    for (size_t i = 0; i < idx.num_docs(); i += 10)
+    {
+        auto d_id = idx.docs()[i];
+        queries.emplace_back(idx.doc_path(d_id), doc_id{i});
+        queries.back().encoding(encoding);
+        idx.tokenize(queries.back());
+    }
+
+    std::vector<std::vector<std::pair<doc_id, double>>> expected;
+    for (auto& query : queries)
+        expected.push_back(r.score(idx, query));
+
+    std::vector<std::vector<std::pair<doc_id, double>>> rankings(
+        queries.size());
+    std::vector<size_t> ids(queries.size());
+    std::iota(ids.begin(), ids.end(), 0);
+    parallel::parallel_for(ids.begin(), ids.end(), [&](size_t i)
+    {
+        rankings[i] = r.score(idx, queries[i]);
+    });
+
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        ASSERT_EQUAL(rankings[i].size(), expected[i].size());
+        for (size_t j = 0; j < rankings[i].size(); ++j)
+        {
+            ASSERT_EQUAL(rankings[i][j].first, expected[i][j].first);
+            ASSERT_APPROX_EQUAL(rankings[i][j].second, expected[i][j].second);
+        }
+    }
+}
+
+template <class Ranker, class Index>
+void test_score_batch(Ranker& r, Index& idx, const std::string& encoding)
+{
+    // every query appears twice, so that some postings are shared
+    std::vector<corpus::document> queries;
+    for (size_t i = 0; i < idx.num_docs(); i += 20)
+    {
+        for (int copy = 0; copy < 2; ++copy)
+        {
+            queries.emplace_back(idx.doc_path(doc_id{i}), doc_id{i});
+            queries.back().encoding(encoding);
+        }
+    }
+
+    auto rankings = r.score_batch(idx, queries, 10, 3);
+    ASSERT_EQUAL(rankings.size(), queries.size());
+    for (size_t i = 0; i < queries.size(); ++i)
+    {
+        auto expected = r.score(idx, queries[i]);
+        ASSERT_EQUAL(rankings[i].size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j)
+        {
+            ASSERT_EQUAL(rankings[i][j].first, expected[j].first);
+            ASSERT_APPROX_EQUAL(rankings[i][j].second, expected[j].second);
+        }
+    }
+}
+
+template <class Ranker, class Index>
+void test_budgeted(Ranker& r, Index& idx, const std::string& encoding)
+{
+    parallel::thread_pool pool{2};
+    for (size_t i = 0; i < idx.num_docs(); i += 20)
+    {
+        corpus::document query{idx.doc_path(doc_id{i}), doc_id{i}};
+        query.encoding(encoding);
+        auto expected = r.score(idx, query);
+
+        // a budget that never runs out gives the results of score()
+        for (uint64_t max_postings : {std::numeric_limits<uint64_t>::max(),
+                                      uint64_t{1} << 40})
+        {
+            index::query_budget budget;
+            budget.max_postings(max_postings);
+            auto budgeted = r.score(idx, query, budget);
+            ASSERT(!budgeted.terminated_early);
+            ASSERT_EQUAL(budgeted.results.size(), expected.size());
+            for (size_t j = 0; j < expected.size(); ++j)
+            {
+                ASSERT_EQUAL(budgeted.results[j].first, expected[j].first);
+                ASSERT_APPROX_EQUAL(budgeted.results[j].second,
+                                    expected[j].second);
+            }
+        }
+
+        index::query_budget unlimited;
+        auto async = r.score_async(idx, query, pool, unlimited).get();
+        ASSERT(!async.terminated_early);
+        ASSERT_EQUAL(async.results.size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j)
+            ASSERT_EQUAL(async.results[j].first, expected[j].first);
+
+        // running out stops the query with at most num_results documents
+        index::query_budget tight;
+        tight.max_postings(1);
+        auto stopped = r.score(idx, query, tight);
+        ASSERT(stopped.terminated_early);
+        ASSERT(stopped.results.size() <= 10);
+
+        index::query_budget cancelled;
+        cancelled.cancel();
+        ASSERT(r.score(idx, query, cancelled).terminated_early);
+    }
+}
+
+template <class Ranker, class Index>
+void test_score_parallel(Ranker& r, Index& idx, const std::string& encoding)
+{
+    // orders results by decreasing score and then by doc_id, since the
+    // order of documents with equal scores may differ
+    auto canonical = [](std::vector<std::pair<doc_id, double>> results)
+    {
+        std::sort(results.begin(), results.end(),
+                  [](const std::pair<doc_id, double>& a,
+                     const std::pair<doc_id, double>& b)
+                  {
+            return a.second == b.second ? a.first < b.first
+                                        : a.second > b.second;
+        });
+        return results;
+    };
+
+    for (uint64_t num_threads : {1, 2, 4})
+    {
+        parallel::thread_pool pool{num_threads};
+        for (size_t i = 0; i < idx.num_docs(); i += 25)
+        {
+            corpus::document query{idx.doc_path(doc_id{i}), doc_id{i}};
+            query.encoding(encoding);
+            for (uint64_t num_results : {1, 10, 100})
+            {
+                auto expected
+                    = canonical(r.score(idx, query, num_results));
+                auto ranking = canonical(
+                    r.score_parallel(idx, query, pool, num_results));
+                ASSERT_EQUAL(ranking.size(), expected.size());
+                if (expected.empty())
+                    continue;
+
+                // the documents scoring above the last one are the same;
+                // those tied with it may be any of the tied documents
+                auto last = expected.back().second;
+                for (size_t j = 0; j < expected.size(); ++j)
+                {
+                    ASSERT_APPROX_EQUAL(ranking[j].second, expected[j].second);
+                    if (expected[j].second > last)
+                        ASSERT_EQUAL(ranking[j].first, expected[j].first);
+                }
+            }
+        }
+    }
+}
+
+template <class Ranker, class Index>
+void test_seeded(Ranker& r, Index& idx, const std::string& encoding)
+{
+    using results_type = std::vector<std::pair<doc_id, double>>;
+    index::dirichlet_prior first_stage;
+    auto check_equal = [](const results_type& actual,
+                          const results_type& expected)
+    {
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j)
+        {
+            ASSERT_EQUAL(actual[j].first, expected[j].first);
+            ASSERT_APPROX_EQUAL(actual[j].second, expected[j].second);
+        }
+    };
+
+    for (size_t i = 0; i < idx.num_docs(); i += 20)
+    {
+        corpus::document query{idx.doc_path(doc_id{i}), doc_id{i}};
+        query.encoding(encoding);
+        auto expected = r.score(idx, query, 20);
+        ASSERT(!expected.empty());
+
+        // candidates only change how soon the threshold rises, whether
+        // they are the results themselves, another ranker's, or none
+        check_equal(r.score(idx, query, index::score_seed{}, 20), expected);
+        check_equal(r.score(idx, query,
+                            index::score_seed::from_results(expected), 20),
+                    expected);
+        auto other = first_stage.score(idx, query, 20);
+        check_equal(
+            r.score(idx, query, index::score_seed::from_results(other), 20),
+            expected);
+
+        // a threshold just below the k-th score leaves the results as
+        // they are
+        auto seed = index::score_seed::from_results(other);
+        auto kth = expected.back().second;
+        seed.threshold = kth - 1e-6 * std::max(1.0, std::abs(kth));
+        check_equal(r.score(idx, query, seed, 20), expected);
+
+        // a threshold above the k-th score keeps only the documents that
+        // score above it
+        seed.threshold = (expected.front().second + kth) / 2;
+        results_type above;
+        for (const auto& result : expected)
+        {
+            if (result.second > seed.threshold)
+                above.push_back(result);
+        }
+        check_equal(r.score(idx, query, seed, 20), above);
+
+        seed.threshold = expected.front().second + 1;
+        ASSERT(r.score(idx, query, seed, 20).empty());
+    }
+}
+
+template <class Ranker>
+void test_prepared(Ranker& r, index::inverted_index& idx,
+                   const std::string& encoding)
+{
+    using results_type = std::vector<std::pair<doc_id, double>>;
+    auto check_equal = [](const results_type& actual,
+                          const results_type& expected)
+    {
+        ASSERT_EQUAL(actual.size(), expected.size());
+        for (size_t j = 0; j < expected.size(); ++j)
+        {
+            ASSERT_EQUAL(actual[j].first, expected[j].first);
+            ASSERT_APPROX_EQUAL(actual[j].second, expected[j].second);
+        }
+    };
+    auto even = [](doc_id d_id)
+    {
+        uint64_t d{d_id};
+        return d % 2 == 0;
+    };
+
+    std::vector<corpus::document> queries;
+    for (size_t i = 0; i < idx.num_docs(); i += 50)
+    {
+        queries.emplace_back(idx.doc_path(doc_id{i}), doc_id{i});
+        queries.back().encoding(encoding);
+    }
+    // a query with a term the index does not have
+    queries.emplace_back();
+    queries.back().increment("not-a-term-of-the-index", 1);
+    queries.back().increment(idx.term_text(term_id{0}), 2);
+
+    for (auto& query : queries)
+    {
+        index::prepared_query prepared{idx, query};
+        for (uint64_t num_results : {1, 10, 100})
+        {
+            auto expected = r.score(idx, query, num_results);
+            check_equal(r.score(idx, prepared, num_results), expected);
+            check_equal(r.score(idx, prepared, num_results, even),
+                        r.score(idx, query, num_results, even));
+
+            auto seed = index::score_seed::from_results(expected);
+            check_equal(r.score(idx, prepared, seed, num_results),
+                        r.score(idx, query, seed, num_results));
+        }
+    }
+}
+
+void test_prepared_other_index(index::inverted_index& idx,
+                               const std::string& encoding)
+{
+    auto other = index::make_index<index::inverted_index>("test-config.toml");
+    corpus::document query{idx.doc_path(doc_id{0}), doc_id{0}};
+    query.encoding(encoding);
+    index::prepared_query prepared{*other, query};
+
+    index::okapi_bm25 bm25;
+    std::vector<std::function<void()>> uses{
+        [&]()
+        {
+            bm25.score(idx, prepared);
+        },
+        [&]()
+        {
+            bm25.score(idx, prepared, index::score_seed{});
+        },
+        [&]()
+        {
+            index::score_sweep({&bm25}, idx, prepared);
+        }};
+    for (const auto& use : uses)
+    {
+        bool thrown = false;
+        try
+        {
+            use();
+        }
+        catch (index::ranker_exception&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+    }
+
+    // the index it was prepared for scores it
+    ASSERT_EQUAL(bm25.score(*other, prepared).size(), 10ul);
+}
+
+void test_score_sweep(index::inverted_index& idx, const std::string& encoding)
+{
+    index::okapi_bm25 bm25;
+    index::okapi_bm25 low_b{1.2, 0.25, 500};
+    index::okapi_bm25 high_k1{2.0, 0.75, 500};
+    index::dirichlet_prior dp;
+    index::pivoted_length pl{0.1};
+    std::vector<index::ranker*> sweep{&bm25, &low_b, &high_k1, &dp, &pl};
+
+    for (size_t i = 0; i < idx.num_docs(); i += 25)
+    {
+        corpus::document query{idx.doc_path(doc_id{i}), doc_id{i}};
+        query.encoding(encoding);
+        auto rankings = index::score_sweep(sweep, idx, query);
+        ASSERT_EQUAL(rankings.size(), sweep.size());
+        for (size_t r = 0; r < sweep.size(); ++r)
+        {
+            // ties may be broken differently than document-at-a-time
+            // scoring breaks them, so only the scores are compared
+            auto expected = sweep[r]->score(idx, query);
+            ASSERT_EQUAL(rankings[r].size(), expected.size());
+            for (size_t j = 0; j < expected.size(); ++j)
+                ASSERT_APPROX_EQUAL(rankings[r][j].second,
+                                    expected[j].second);
+        }
+    }
+}
+
+namespace
+{
+/**
+ * A corpus of a range of the documents of an index.
+ */
+class index_range_corpus : public corpus::corpus
+{
+  public:
+    index_range_corpus(index::inverted_index& idx, uint64_t first,
+                       uint64_t last, const std::string& encoding)
+        : corpus::corpus{encoding}, idx_(idx), first_{first}, cur_{first},
+          last_{last}
+    {
+        // nothing
+    }
+
+    bool has_next() const override
+    {
+        return cur_ < last_;
+    }
+
+    meta::corpus::document next() override
+    {
+        doc_id d_id{cur_++};
+        meta::corpus::document doc{idx_.doc_path(d_id), doc_id{d_id - first_},
+                             idx_.label(d_id)};
+        doc.encoding(encoding());
+        return doc;
+    }
+
+    uint64_t size() const override
+    {
+        return last_ - first_;
+    }
+
+  private:
+    index::inverted_index& idx_;
+    uint64_t first_;
+    uint64_t cur_;
+    uint64_t last_;
+};
+}
+
+template <class Ranker>
+void test_segmented_index(Ranker& r, index::segmented_index& seg,
+                          index::inverted_index& idx,
+                          const std::string& encoding)
+{
+    ASSERT_EQUAL(seg.num_docs(), idx.num_docs());
+    for (size_t i = 0; i < idx.num_docs(); i += 10)
+    {
+        ASSERT_EQUAL(seg.doc_path(doc_id{i}), idx.doc_path(doc_id{i}));
+        ASSERT_EQUAL(seg.doc_size(doc_id{i}), idx.doc_size(doc_id{i}));
+
+        corpus::document query{idx.doc_path(doc_id{i}), doc_id{i}};
+        query.encoding(encoding);
+        idx.tokenize(query);
+
+        for (uint64_t num_results : {1, 10, 100})
+        {
+            auto ranking = seg.score(r, query, num_results);
+            auto expected = r.score(idx, query, num_results);
+            ASSERT_EQUAL(ranking.size(), expected.size());
+            for (size_t j = 0; j < ranking.size(); ++j)
+                ASSERT_APPROX_EQUAL(ranking[j].second, expected[j].second);
+        }
+    }
+}
+
+void test_segments(index::inverted_index& idx, const std::string& encoding)
+{
+    {
+        std::ifstream in{"test-config.toml"};
+        std::ofstream out{"seg-config.toml"};
+        out << "segment-merge-factor = 2\n";
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.find("inverted-index") == 0)
+                line = "inverted-index = \"ceeaus-seg\"";
+            out << line << "\n";
+        }
+    }
+
+    // the first two segments are merged, leaving two segments
+    auto num_docs = idx.num_docs();
+    std::vector<uint64_t> bounds = {0, num_docs / 2, num_docs * 4 / 5,
+                                    num_docs};
+    {
+        index::segmented_index seg{"seg-config.toml"};
+        for (uint64_t i = 0; i + 1 < bounds.size(); ++i)
+        {
+            index_range_corpus docs{idx, bounds[i], bounds[i + 1], encoding};
+            seg.add_segment(docs);
+        }
+        seg.wait_for_merges();
+        ASSERT_EQUAL(seg.num_segments(), 2ul);
+
+        index::okapi_bm25 bm25;
+        test_segmented_index(bm25, seg, idx, encoding);
+        index::dirichlet_prior dp;
+        test_segmented_index(dp, seg, idx, encoding);
+    }
+
+    // the segments are found again when the index is reopened
+    index::segmented_index seg{"seg-config.toml"};
+    ASSERT_EQUAL(seg.num_segments(), 2ul);
+    index::pivoted_length pl;
+    test_segmented_index(pl, seg, idx, encoding);
+
+    // a deleted document keeps its doc_id across a merge, but its
+    // postings are left out of the merged segment
+    doc_id victim{num_docs - 1};
+    seg.delete_doc(victim);
+    ASSERT(seg.is_deleted(victim));
+    index_range_corpus docs{idx, bounds[2], bounds[3], encoding};
+    seg.add_segment(docs);
+    seg.wait_for_merges();
+    ASSERT_EQUAL(seg.num_segments(), 2ul);
+    ASSERT_EQUAL(seg.num_deleted(), 1ul);
+    ASSERT(seg.is_deleted(victim));
+
+    auto merged = seg.segment(1);
+    doc_id local{victim - bounds[2]};
+    for (term_id t_id{0}; t_id < merged->unique_terms(); ++t_id)
+    {
+        auto pdata = merged->search_primary(t_id);
+        for (const auto& posting : pdata->counts())
+            ASSERT(posting.first != local);
+    }
+
+    corpus::document query{idx.doc_path(victim), victim};
+    query.encoding(encoding);
+    for (const auto& result : seg.score(pl, query, seg.num_docs()))
+        ASSERT(result.first != victim);
+}
+
+void test_live_segments(index::inverted_index& idx,
+                        const std::string& encoding)
+{
+    {
+        std::ifstream in{"test-config.toml"};
+        std::ofstream out{"live-config.toml"};
+        out << "live-flush-docs = 40\n";
+        out << "live-flush-seconds = 0\n";
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.find("inverted-index") == 0)
+                line = "inverted-index = \"ceeaus-live\"";
+            out << line << "\n";
+        }
+    }
+
+    // half of the documents are on disk, and the rest are added one at a
+    // time, some of them being flushed in the background as they are
+    auto num_docs = idx.num_docs();
+    index::segmented_index seg{"live-config.toml"};
+    index_range_corpus disk{idx, 0, num_docs / 2, encoding};
+    seg.add_segment(disk);
+    index_range_corpus docs{idx, num_docs / 2, num_docs, encoding};
+    for (uint64_t d = num_docs / 2; d < num_docs; ++d)
+        ASSERT_EQUAL(seg.add_document(docs.next()), doc_id{d});
+    ASSERT(seg.num_live_docs() <= num_docs - num_docs / 2);
+
+    index::okapi_bm25 bm25;
+    test_segmented_index(bm25, seg, idx, encoding);
+
+    // a deleted live document stays deleted once it is on disk
+    doc_id victim{num_docs - 1};
+    seg.delete_doc(victim);
+    ASSERT(seg.is_deleted(victim));
+    seg.flush();
+    ASSERT_EQUAL(seg.num_live_docs(), 0ul);
+    ASSERT(seg.num_segments() > 1);
+    ASSERT_EQUAL(seg.num_docs(), num_docs);
+    ASSERT(seg.is_deleted(victim));
+    ASSERT_EQUAL(seg.num_deleted(), 1ul);
+    ASSERT_EQUAL(seg.label(victim), idx.label(victim));
+
+    corpus::document query{idx.doc_path(victim), victim};
+    query.encoding(encoding);
+    for (const auto& result : seg.score(bm25, query, num_docs))
+        ASSERT(result.first != victim);
+}
+
+template <class Ranker>
+void test_sharded_index(Ranker& r, index::sharded_index& sharded,
+                        index::inverted_index& idx,
+                        const std::string& encoding)
+{
+    ASSERT_EQUAL(sharded.num_docs(), idx.num_docs());
+    for (size_t i = 0; i < idx.num_docs(); i += 10)
+    {
+        ASSERT_EQUAL(sharded.doc_path(doc_id{i}), idx.doc_path(doc_id{i}));
+        ASSERT_EQUAL(sharded.label(doc_id{i}), idx.label(doc_id{i}));
+
+        corpus::document query{idx.doc_path(doc_id{i}), doc_id{i}};
+        query.encoding(encoding);
+
+        for (uint64_t num_results : {1, 10, 100})
+        {
+            auto ranking = sharded.score(r, query, num_results);
+            auto expected = r.score(idx, query, num_results);
+
+            // the expected results may be padded with unmatched documents
+            ASSERT(ranking.size() <= expected.size());
+            for (size_t j = 0; j < ranking.size(); ++j)
+                ASSERT_APPROX_EQUAL(ranking[j].second, expected[j].second);
+            for (size_t j = ranking.size(); j < expected.size(); ++j)
+                ASSERT_EQUAL(expected[j].second,
+                             std::numeric_limits<double>::lowest());
+        }
+    }
+}
+
+void test_shards(index::inverted_index& idx, const std::string& encoding)
+{
+    // the shards are built as the segments of a segmented_index, which
+    // are never merged here since there are fewer than ten of them
+    {
+        std::ifstream in{"test-config.toml"};
+        std::ofstream out{"shard-config.toml"};
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.find("inverted-index") == 0)
+                line = "inverted-index = \"ceeaus-shards\"";
+            out << line << "\n";
+        }
+    }
+
+    auto num_docs = idx.num_docs();
+    std::vector<uint64_t> bounds = {0, num_docs / 3, num_docs / 2, num_docs};
+    index::segmented_index seg{"shard-config.toml"};
+    for (uint64_t i = 0; i + 1 < bounds.size(); ++i)
+    {
+        index_range_corpus docs{idx, bounds[i], bounds[i + 1], encoding};
+        seg.add_segment(docs);
+    }
+    ASSERT_EQUAL(seg.num_segments(), 3ul);
+
+    std::vector<std::unique_ptr<index::shard>> shards;
+    for (uint64_t i = 0; i < seg.num_segments(); ++i)
+        shards.push_back(make_unique<index::local_shard>(seg.segment(i)));
+    index::sharded_index sharded{std::move(shards), 2};
+    ASSERT_EQUAL(sharded.num_shards(), 3ul);
+
+    index::okapi_bm25 bm25;
+    test_sharded_index(bm25, sharded, idx, encoding);
+    index::dirichlet_prior dp;
+    test_sharded_index(dp, sharded, idx, encoding);
+
+    // the same shards, opened from a configuration file
+    {
+        std::ofstream out{"sharded.toml"};
+        for (uint64_t i = 0; i < seg.num_segments(); ++i)
+        {
+            auto shard_config = "shard-" + std::to_string(i) + ".toml";
+            std::ifstream in{"test-config.toml"};
+            std::ofstream shard_out{shard_config};
+            std::string line;
+            while (std::getline(in, line))
+            {
+                if (line.find("inverted-index") == 0)
+                    line = "inverted-index = \""
+                           + seg.segment(i)->index_name() + "\"";
+                shard_out << line << "\n";
+            }
+            out << "[[shards]]\nconfig = \"" << shard_config << "\"\n";
+        }
+    }
+    auto loaded = index::sharded_index::load("sharded.toml");
+    ASSERT_EQUAL(loaded->num_shards(), 3ul);
+    index::pivoted_length pl;
+    test_sharded_index(pl, *loaded, idx, encoding);
+}
+
+template <class Ranker>
+void test_deleted_docs(Ranker& r, index::inverted_index& idx,
+                       const std::string& encoding)
+{
+    for (size_t i = 0; i < idx.num_docs(); i += 50)
+    {
+        corpus::document query{idx.doc_path(doc_id{i}), doc_id{i}};
+        query.encoding(encoding);
+
+        // every document that is not deleted is returned, either as a
+        // match or as padding
+        auto ranking = r.score(idx, query, idx.num_docs());
+        ASSERT_EQUAL(ranking.size(), idx.num_docs() - idx.num_deleted());
+        for (const auto& result : ranking)
+            ASSERT(!idx.is_deleted(result.first));
+    }
+}
+
+void test_query_cache(index::inverted_index& idx, const std::string& encoding)
+{
+    index::query_cache<> cache{uint64_t{64}};
+    index::okapi_bm25 bm25;
+    index::okapi_bm25 steep{2.0};
+    ASSERT(bm25.parameters() != steep.parameters());
+
+    auto query_for = [&](uint64_t i)
+    {
+        corpus::document query{idx.doc_path(doc_id{i}), doc_id{i}};
+        query.encoding(encoding);
+        return query;
+    };
+
+    for (uint64_t i = 0; i < idx.num_docs(); i += 100)
+    {
+        for (int repeat = 0; repeat < 2; ++repeat)
+        {
+            auto query = query_for(i);
+            auto expected = bm25.score(idx, query);
+            auto query_again = query_for(i);
+            ASSERT(cache.score(idx, bm25, query_again) == expected);
+
+            query = query_for(i);
+            expected = steep.score(idx, query);
+            query_again = query_for(i);
+            ASSERT(cache.score(idx, steep, query_again) == expected);
+        }
+    }
+    auto stats = cache.stats();
+    ASSERT(stats.misses > 0);
+    ASSERT_EQUAL(stats.hits, stats.misses);
+
+    // deleting the best match must not leave it in the cached results
+    auto query = query_for(0);
+    auto best = cache.score(idx, bm25, query)[0].first;
+    idx.delete_doc(best);
+    query = query_for(0);
+    for (const auto& result : cache.score(idx, bm25, query))
+        ASSERT(result.first != best);
+}
+
+void test_feedback(index::inverted_index& idx, index::forward_index& fwd,
+                   const std::string& encoding)
+{
+    index::okapi_bm25 bm25;
+    for (uint64_t i = 0; i < idx.num_docs(); i += 100)
+    {
+        corpus::document query{idx.doc_path(doc_id{i}), doc_id{i}};
+        query.encoding(encoding);
+        auto results = bm25.score(idx, query, 10);
+
+        for (auto model : {index::feedback_model::rocchio,
+                           index::feedback_model::rm3})
+        {
+            index::feedback_options options;
+            options.model = model;
+            options.num_docs = 5;
+            options.num_terms = 10;
+            auto expanded = index::expand_query(idx, fwd, query, results,
+                                                options);
+
+            double length = 0;
+            for (const auto& count : expanded.counts())
+                length += count.second;
+            ASSERT_APPROX_EQUAL(length, static_cast<double>(query.length()));
+            for (const auto& count : query.counts())
+                ASSERT(expanded.count(count.first) > 0);
+            ASSERT(expanded.counts().size() <= query.counts().size() + 10);
+
+            auto ranking = index::score_with_feedback(idx, fwd, bm25, query,
+                                                      10, options);
+            ASSERT_EQUAL(ranking.size(), 10ul);
+
+            // with all of the weight on the original query, nothing changes
+            options.original_weight = 1.0;
+            auto unexpanded = index::score_with_feedback(idx, fwd, bm25,
+                                                         query, 10, options);
+            ASSERT_EQUAL(unexpanded.size(), results.size());
+            for (uint64_t j = 0; j < results.size(); ++j)
+            {
+                ASSERT_EQUAL(unexpanded[j].first, results[j].first);
+                ASSERT_APPROX_EQUAL(unexpanded[j].second, results[j].second);
+            }
+        }
+    }
+}
+
+void test_impacts(index::inverted_index& idx, const std::string& encoding)
+{
+    index::okapi_bm25 bm25;
+    index::impact_index impacts{idx, bm25};
+    ASSERT_EQUAL(impacts.parameters(), bm25.parameters());
+
+    for (uint64_t i = 0; i < idx.num_docs(); i += 50)
+    {
+        corpus::document query{idx.doc_path(doc_id{i}), doc_id{i}};
+        query.encoding(encoding);
+
+        // the query document, or a duplicate of it, is ranked first
+        auto ranking = impacts.score(query, 10);
+        ASSERT_EQUAL(ranking.size(), 10ul);
+        for (uint64_t j = 1; j < ranking.size(); ++j)
+            ASSERT(ranking[j - 1].second >= ranking[j].second);
+        auto exact = bm25.score(idx, query, 2);
+        ASSERT(ranking[0].first == exact[0].first
+               || ranking[0].first == exact[1].first);
+
+        // processing every posting (which asking for more documents than
+        // there are forces) leaves the same documents on top
+        auto full = impacts.score(query, idx.num_docs() + 1);
+        std::unordered_map<doc_id, double> scores{full.begin(), full.end()};
+        for (const auto& result : ranking)
+            ASSERT(scores[result.first] >= full[9].second - 1e-9);
+
+        auto budgeted = impacts.score(query, 10, 100);
+        ASSERT(budgeted.size() <= 10);
+    }
+
+    // different parameters need different impacts
+    index::okapi_bm25 steep{2.0};
+    index::impact_index rebuilt{idx, steep};
+    ASSERT_EQUAL(rebuilt.parameters(), steep.parameters());
+    ASSERT(filesystem::file_text(idx.index_name() + "/impacts/signature")
+               .find(steep.parameters())
+           == 0);
+}
+
+void test_pruning(const std::shared_ptr<index::inverted_index>& idx)
+{
+    {
+        std::ifstream in{"test-config.toml"};
+        std::ofstream out{"prune-config.toml"};
+        std::string line;
+        while (std::getline(in, line))
+        {
+            if (line.find("inverted-index") == 0)
+                line = "inverted-index = \"ceeaus-pruned\"";
+            out << line << "\n";
+        }
+    }
+
+    auto num_postings = [](index::inverted_index& index)
+    {
+        uint64_t total = 0;
+        for (term_id t_id{0}; t_id < index.unique_terms(); ++t_id)
+            total += index.cursor(t_id).size();
+        return total;
+    };
+    auto total = num_postings(*idx);
+
+    index::okapi_bm25 bm25;
+    index::pruning_options options;
+    options.keep = 0.4;
+    auto pruned = index::prune_index(idx, bm25, "prune-config.toml", options);
+    auto kept = num_postings(*pruned);
+    ASSERT(kept < total);
+    ASSERT(kept >= 0.4 * total);
+
+    // the pruned index scores with the source's statistics
+    ASSERT_EQUAL(pruned->num_docs(), idx->num_docs());
+    ASSERT_EQUAL(pruned->total_corpus_terms(), idx->total_corpus_terms());
+    ASSERT_APPROX_EQUAL(pruned->avg_doc_length(), idx->avg_doc_length());
+    for (term_id t_id{0}; t_id < pruned->unique_terms(); ++t_id)
+    {
+        auto src_id = idx->get_term_id(pruned->term_text(t_id));
+        ASSERT_EQUAL(pruned->doc_freq(t_id), idx->doc_freq(src_id));
+        ASSERT_EQUAL(pruned->total_num_occurences(t_id),
+                     idx->total_num_occurences(src_id));
+    }
+
+    // every term keeps its top ten documents
+    for (uint64_t t = 0; t < idx->unique_terms(); t += 97)
+    {
+        term_id t_id{t};
+        corpus::document query;
+        query.increment(idx->term_text(t_id), 1);
+        auto expected = bm25.score(*idx, query, 10);
+        auto ranking = bm25.score(*pruned, query, 10);
+        ASSERT_EQUAL(ranking.size(), expected.size());
+        for (uint64_t i = 0; i < ranking.size(); ++i)
+            ASSERT_APPROX_EQUAL(ranking[i].second, expected[i].second);
+    }
+    pruned = nullptr;
+
+    options.method = index::pruning_method::document_centric;
+    options.keep = 0.25;
+    pruned = index::prune_index(idx, bm25, "prune-config.toml", options);
+    kept = num_postings(*pruned);
+    ASSERT(kept < total / 2);
+    ASSERT(kept >= 0.25 * total);
+    pruned = nullptr;
+
+    options.keep = 0;
+    bool thrown = false;
+    try
+    {
+        index::prune_index(idx, bm25, "prune-config.toml", options);
+    }
+    catch (index::pruning_exception&)
+    {
+        thrown = true;
+    }
+    ASSERT(thrown);
+}
+
 int ranker_tests()
 {
     create_config("file");
@@ -77,6 +1067,184 @@ int ranker_tests()
         test_rank(r, *idx, encoding);
     });
 
+    num_failed += testing::run_test("ranker-score-postings", [&]()
+    {
+        index::absolute_discount ad;
+        test_score_postings(ad, *idx);
+        index::dirichlet_prior dp;
+        test_score_postings(dp, *idx);
+        index::jelinek_mercer jm;
+        test_score_postings(jm, *idx);
+        index::okapi_bm25 bm25;
+        test_score_postings(bm25, *idx);
+        index::pivoted_length pl;
+        test_score_postings(pl, *idx);
+    });
+
+    num_failed += testing::run_test("ranker-document-at-a-time", [&]()
+    {
+        index::absolute_discount ad;
+        test_document_at_a_time(ad, *idx, encoding);
+        index::dirichlet_prior dp;
+        test_document_at_a_time(dp, *idx, encoding);
+        index::jelinek_mercer jm;
+        test_document_at_a_time(jm, *idx, encoding);
+        index::okapi_bm25 bm25;
+        test_document_at_a_time(bm25, *idx, encoding);
+        index::pivoted_length pl;
+        test_document_at_a_time(pl, *idx, encoding);
+    });
+
+    num_failed += testing::run_test("ranker-conjunctive", [&]()
+    {
+        index::okapi_bm25 bm25;
+        test_conjunctive(bm25, *idx, encoding);
+        index::dirichlet_prior dp;
+        test_conjunctive(dp, *idx, encoding);
+    });
+
+    num_failed += testing::run_test("ranker-concurrent-queries", [&]()
+    {
+        index::okapi_bm25 r;
+        test_concurrent_queries(r, *idx, encoding);
+        unbounded_ranker<index::dirichlet_prior> exhaustive;
+        test_concurrent_queries(exhaustive, *idx, encoding);
+    });
+
+    num_failed += testing::run_test("ranker-score-batch", [&]()
+    {
+        index::okapi_bm25 bm25;
+        test_score_batch(bm25, *idx, encoding);
+        unbounded_ranker<index::dirichlet_prior> exhaustive;
+        test_score_batch(exhaustive, *idx, encoding);
+    });
+
+    num_failed += testing::run_test("ranker-budgeted", [&]()
+    {
+        index::okapi_bm25 bm25;
+        test_budgeted(bm25, *idx, encoding);
+        unbounded_ranker<index::dirichlet_prior> exhaustive;
+        test_budgeted(exhaustive, *idx, encoding);
+    });
+
+    num_failed += testing::run_test("ranker-score-parallel", [&]()
+    {
+        index::okapi_bm25 bm25;
+        test_score_parallel(bm25, *idx, encoding);
+        unbounded_ranker<index::dirichlet_prior> exhaustive;
+        test_score_parallel(exhaustive, *idx, encoding);
+    });
+
+    num_failed += testing::run_test("ranker-seeded", [&]()
+    {
+        index::okapi_bm25 bm25;
+        test_seeded(bm25, *idx, encoding);
+        index::pivoted_length pl;
+        test_seeded(pl, *idx, encoding);
+        unbounded_ranker<index::okapi_bm25> exhaustive;
+        test_seeded(exhaustive, *idx, encoding);
+    });
+
+    num_failed += testing::run_test("ranker-prepared", [&]()
+    {
+        index::absolute_discount ad;
+        test_prepared(ad, *idx, encoding);
+        index::dirichlet_prior dp;
+        test_prepared(dp, *idx, encoding);
+        index::jelinek_mercer jm;
+        test_prepared(jm, *idx, encoding);
+        index::okapi_bm25 bm25;
+        test_prepared(bm25, *idx, encoding);
+        index::pivoted_length pl;
+        test_prepared(pl, *idx, encoding);
+        unbounded_ranker<index::okapi_bm25> exhaustive;
+        test_prepared(exhaustive, *idx, encoding);
+    });
+
+    num_failed += testing::run_test("ranker-prepared-other-index", [&]()
+    {
+        test_prepared_other_index(*idx, encoding);
+    });
+
+    num_failed += testing::run_test("ranker-sweep", [&]()
+    {
+        test_score_sweep(*idx, encoding);
+    });
+
+    num_failed += testing::run_test("ranker-feedback", [&]()
+    {
+        system("rm -rf ceeaus-fwd");
+        auto fwd = index::make_index<index::forward_index>("test-config.toml");
+        test_feedback(*idx, *fwd, encoding);
+        fwd = nullptr;
+        system("rm -rf ceeaus-fwd");
+    });
+
+    num_failed += testing::run_test("ranker-impacts", [&]()
+    {
+        test_impacts(*idx, encoding);
+    });
+
+    num_failed += testing::run_test("ranker-pruning", [&]()
+    {
+        system("rm -rf ceeaus-pruned");
+        test_pruning(idx);
+        system("rm -rf ceeaus-pruned prune-config.toml");
+    });
+
+    num_failed += testing::run_test("ranker-segmented-index", [&]()
+    {
+        system("rm -rf ceeaus-seg");
+        test_segments(*idx, encoding);
+        system("rm -rf ceeaus-seg seg-config.toml");
+    });
+
+    num_failed += testing::run_test("ranker-live-segment", [&]()
+    {
+        system("rm -rf ceeaus-live");
+        test_live_segments(*idx, encoding);
+        system("rm -rf ceeaus-live live-config.toml");
+    });
+
+    num_failed += testing::run_test("ranker-sharded-index", [&]()
+    {
+        system("rm -rf ceeaus-shards");
+        test_shards(*idx, encoding);
+        system("rm -rf ceeaus-shards shard-config.toml shard-*.toml "
+               "sharded.toml");
+    });
+
+    num_failed += testing::run_test("ranker-deleted-docs", [&]()
+    {
+        // delete the best match for some of the documents
+        index::okapi_bm25 bm25;
+        for (size_t i = 0; i < idx->num_docs(); i += 50)
+        {
+            corpus::document query{idx->doc_path(doc_id{i}), doc_id{i}};
+            query.encoding(encoding);
+            auto ranking = bm25.score(*idx, query, 1);
+            idx->delete_doc(ranking[0].first);
+            ASSERT(idx->is_deleted(ranking[0].first));
+        }
+        ASSERT(idx->num_deleted() > 0);
+
+        test_deleted_docs(bm25, *idx, encoding);
+        unbounded_ranker<index::okapi_bm25> exhaustive;
+        test_deleted_docs(exhaustive, *idx, encoding);
+
+        // the deletions are saved with the index
+        auto reloaded = index::make_index<index::inverted_index>(
+            "test-config.toml");
+        ASSERT_EQUAL(reloaded->num_deleted(), idx->num_deleted());
+        for (const auto& d_id : idx->docs())
+            ASSERT_EQUAL(reloaded->is_deleted(d_id), idx->is_deleted(d_id));
+    });
+
+    num_failed += testing::run_test("ranker-query-cache", [&]()
+    {
+        test_query_cache(*idx, encoding);
+    });
+
     idx = nullptr;
 
     system("rm -rf ceeaus-inv test-config.toml");
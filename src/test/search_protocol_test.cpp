@@ -0,0 +1,309 @@
+/**
+ * @file search_protocol_test.cpp
+ */
+
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "index/search_protocol.h"
+#include "test/search_protocol_test.h"
+
+namespace meta
+{
+namespace testing
+{
+
+namespace
+{
+namespace protocol = index::protocol;
+using index::protocol_exception;
+
+/**
+ * The two ends of a connected stream socket, closed when it goes out of
+ * scope.
+ */
+class socket_pair
+{
+  public:
+    socket_pair()
+    {
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, fds_) != 0)
+            throw protocol_exception{"cannot create socket pair"};
+    }
+
+    ~socket_pair()
+    {
+        close_writer();
+        ::close(fds_[1]);
+    }
+
+    int writer() const
+    {
+        return fds_[0];
+    }
+
+    int reader() const
+    {
+        return fds_[1];
+    }
+
+    /**
+     * Closes the writing end, as a peer that hangs up.
+     */
+    void close_writer()
+    {
+        if (fds_[0] >= 0)
+            ::close(fds_[0]);
+        fds_[0] = -1;
+    }
+
+    /**
+     * Writes bytes as they are, without framing them.
+     */
+    void write_raw(const std::string& bytes)
+    {
+        if (::send(fds_[0], bytes.data(), bytes.size(), MSG_NOSIGNAL)
+            != static_cast<ssize_t>(bytes.size()))
+            throw protocol_exception{"cannot write to socket pair"};
+    }
+
+  private:
+    int fds_[2];
+};
+
+/**
+ * @param size A frame length
+ * @return the little-endian header of a frame of that length
+ */
+std::string header(uint32_t size)
+{
+    std::string bytes;
+    for (uint32_t i = 0; i < 4; ++i)
+        bytes.push_back(static_cast<char>((size >> (8 * i)) & 0xff));
+    return bytes;
+}
+
+/**
+ * @param fn A function
+ * @return whether it throws a protocol_exception
+ */
+template <class Function>
+bool rejects(Function&& fn)
+{
+    try
+    {
+        fn();
+    }
+    catch (protocol_exception&)
+    {
+        return true;
+    }
+    return false;
+}
+
+protocol::request make_request()
+{
+    protocol::request req;
+    req.id = 0xfedcba9876543210;
+    req.index = "ceeaus";
+    req.num_results = 25;
+    req.with_paths = true;
+    req.queries = {"the quick brown fox", "", u8"naïve café",
+                   std::string(1000, 'x')};
+    return req;
+}
+
+protocol::response make_response()
+{
+    protocol::response resp;
+    resp.id = 17;
+    resp.results.resize(3);
+    resp.results[0].push_back({doc_id{0}, 1.5, "a/b.txt"});
+    resp.results[0].push_back(
+        {doc_id{std::numeric_limits<uint64_t>::max()}, -0.25, ""});
+    resp.results[2].push_back({doc_id{42}, 1e300, u8"déjà.txt"});
+    return resp;
+}
+
+void check_equal(const protocol::request& a, const protocol::request& b)
+{
+    ASSERT_EQUAL(a.id, b.id);
+    ASSERT_EQUAL(a.index, b.index);
+    ASSERT_EQUAL(a.num_results, b.num_results);
+    ASSERT_EQUAL(a.with_paths, b.with_paths);
+    ASSERT(a.queries == b.queries);
+}
+
+void check_equal(const protocol::response& a, const protocol::response& b)
+{
+    ASSERT_EQUAL(a.id, b.id);
+    ASSERT_EQUAL(a.error, b.error);
+    ASSERT_EQUAL(a.results.size(), b.results.size());
+    for (uint64_t q = 0; q < a.results.size(); ++q)
+    {
+        ASSERT_EQUAL(a.results[q].size(), b.results[q].size());
+        for (uint64_t i = 0; i < a.results[q].size(); ++i)
+        {
+            ASSERT_EQUAL(a.results[q][i].d_id, b.results[q][i].d_id);
+            ASSERT_EQUAL(a.results[q][i].score, b.results[q][i].score);
+            ASSERT_EQUAL(a.results[q][i].path, b.results[q][i].path);
+        }
+    }
+}
+
+int round_trip()
+{
+    return run_test("search-protocol-round-trip", []()
+    {
+        auto req = make_request();
+        check_equal(protocol::decode_request(protocol::encode(req)), req);
+        check_equal(protocol::decode_request(
+                        protocol::encode(protocol::request{})),
+                    protocol::request{});
+
+        auto resp = make_response();
+        check_equal(protocol::decode_response(protocol::encode(resp)), resp);
+        protocol::response failed;
+        failed.id = 3;
+        failed.error = "no such index";
+        check_equal(protocol::decode_response(protocol::encode(failed)),
+                    failed);
+
+        // frames arrive whole and in order, and a hang up between frames
+        // is not an error
+        socket_pair sockets;
+        std::vector<std::string> payloads{protocol::encode(req), "",
+                                          protocol::encode(resp),
+                                          std::string(100000, '\0')};
+        for (const auto& payload : payloads)
+            protocol::write_frame(sockets.writer(), payload);
+        sockets.close_writer();
+
+        std::string payload;
+        for (const auto& expected : payloads)
+        {
+            ASSERT(protocol::read_frame(sockets.reader(), payload));
+            ASSERT(payload == expected);
+        }
+        ASSERT(!protocol::read_frame(sockets.reader(), payload));
+    });
+}
+
+int truncated()
+{
+    return run_test("search-protocol-truncated", []()
+    {
+        // every proper prefix of a message, and a message with a byte
+        // too many, is rejected
+        auto req = protocol::encode(make_request());
+        auto resp = protocol::encode(make_response());
+        for (uint64_t size = 0; size < req.size(); ++size)
+            ASSERT(rejects([&]()
+            {
+                protocol::decode_request(req.substr(0, size));
+            }));
+        for (uint64_t size = 0; size < resp.size(); ++size)
+            ASSERT(rejects([&]()
+            {
+                protocol::decode_response(resp.substr(0, size));
+            }));
+        ASSERT(rejects([&]() { protocol::decode_request(req + "!"); }));
+        ASSERT(rejects([&]() { protocol::decode_response(resp + "!"); }));
+
+        // a peer that hangs up inside a header or a payload
+        for (const auto& partial : {header(10).substr(0, 3),
+                                    header(10) + "12345"})
+        {
+            socket_pair sockets;
+            sockets.write_raw(partial);
+            sockets.close_writer();
+            std::string payload;
+            ASSERT(rejects([&]()
+            {
+                protocol::read_frame(sockets.reader(), payload);
+            }));
+        }
+    });
+}
+
+int oversized()
+{
+    return run_test("search-protocol-oversized", []()
+    {
+        // the length is checked before the payload is read or allocated
+        for (uint32_t size : {protocol::max_frame_bytes + 1,
+                              std::numeric_limits<uint32_t>::max()})
+        {
+            socket_pair sockets;
+            sockets.write_raw(header(size));
+            std::string payload;
+            ASSERT(rejects([&]()
+            {
+                protocol::read_frame(sockets.reader(), payload);
+            }));
+            ASSERT(payload.empty());
+        }
+
+        // a payload over the limit is refused before anything is sent
+        socket_pair sockets;
+        std::string big(protocol::max_frame_bytes + 1, 'x');
+        ASSERT(rejects([&]()
+        {
+            protocol::write_frame(sockets.writer(), big);
+        }));
+        sockets.close_writer();
+        std::string payload;
+        ASSERT(!protocol::read_frame(sockets.reader(), payload));
+    });
+}
+
+int malformed()
+{
+    return run_test("search-protocol-malformed", []()
+    {
+        auto req = protocol::encode(make_request());
+        auto resp = protocol::encode(make_response());
+
+        // each kind of message is refused as the other
+        ASSERT(rejects([&]() { protocol::decode_request(resp); }));
+        ASSERT(rejects([&]() { protocol::decode_response(req); }));
+        ASSERT(rejects([&]() { protocol::decode_request(""); }));
+
+        // counts and lengths larger than the rest of the message are
+        // refused before anything is allocated for them
+        std::string huge_count = req.substr(0, 1 + 8 + 4 + 6 + 4 + 1)
+                                 + header(0xffffffff);
+        ASSERT(rejects([&]() { protocol::decode_request(huge_count); }));
+
+        std::string huge_string = req.substr(0, 1 + 8) + header(0x7fffffff)
+                                  + "ceeaus";
+        ASSERT(rejects([&]() { protocol::decode_request(huge_string); }));
+
+        std::string huge_results = resp.substr(0, 1 + 8 + 4 + 4)
+                                   + header(0xffffffff);
+        ASSERT(rejects([&]() { protocol::decode_response(huge_results); }));
+
+        // a request for too many results still decodes; the server
+        // decides what to do with it
+        auto wide = make_request();
+        wide.num_results = std::numeric_limits<uint32_t>::max();
+        check_equal(protocol::decode_request(protocol::encode(wide)), wide);
+    });
+}
+}
+
+int search_protocol_tests()
+{
+    int num_failed = 0;
+    num_failed += round_trip();
+    num_failed += truncated();
+    num_failed += oversized();
+    num_failed += malformed();
+    return num_failed;
+}
+}
+}
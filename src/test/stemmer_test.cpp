@@ -3,6 +3,15 @@
  * @author Sean Massung
  */
 
+#include <random>
+#include <sstream>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "analyzers/analyzer.h"
+#include "analyzers/filters/porter2_stemmer.h"
+#include "analyzers/tokenizers/whitespace_tokenizer.h"
+#include "cpptoml.h"
 #include "porter2_stemmer.h"
 #include "test/stemmer_test.h"
 
@@ -39,6 +48,100 @@ int stemmer_tests()
         }
     });
 
+    num_failed += testing::run_test("porter2-stemmer-cache", [&]()
+    {
+        using namespace analyzers;
+        std::ifstream in{"../data/porter2_stems.txt"};
+        std::unordered_map<std::string, std::string> stems;
+        std::vector<std::string> words;
+        std::string to_stem;
+        std::string stemmed;
+        while (in >> to_stem >> stemmed)
+        {
+            stems[to_stem] = stemmed;
+            words.push_back(to_stem);
+        }
+
+        // the whole vocabulary, then a skewed sample of it, as in text
+        std::mt19937 rng{3};
+        std::string content;
+        for (const auto& word : words)
+            content += word + " ";
+        for (uint64_t i = 0; i < 50000; ++i)
+            content += words[(rng() % 200) * (rng() % 150)] + " ";
+
+        // the whitespace between the words is passed through unstemmed
+        std::vector<std::string> expected;
+        std::unordered_set<std::string> distinct;
+        tokenizers::whitespace_tokenizer tok;
+        tok.set_content(content);
+        while (tok)
+        {
+            auto token = tok.next();
+            distinct.insert(token);
+            auto it = stems.find(token);
+            expected.push_back(it == stems.end() ? token : it->second);
+        }
+
+        for (uint64_t cache_size : {0, 1, 7, 1000, 100000})
+        {
+            std::stringstream config_ss{
+                "[[filter]]\ntype = \"whitespace-tokenizer\"\n"
+                "[[filter]]\ntype = \"porter2-stemmer\"\ncache-size = "
+                + std::to_string(cache_size) + "\n"};
+            auto config = cpptoml::parser{config_ss}.parse();
+            auto stream = analyzer::load_filters(config, config);
+            stream->set_content(content);
+            for (const auto& stem : expected)
+            {
+                ASSERT(*stream);
+                ASSERT_EQUAL(stream->next(), stem);
+            }
+            ASSERT(!*stream);
+
+            // without a cache, the stemmer is fused with the tokenizer
+            if (cache_size == 0)
+                continue;
+
+            auto& stemmer = dynamic_cast<filters::porter2_stemmer&>(*stream);
+            ASSERT_EQUAL(stemmer.cache_size(), cache_size);
+            auto stats = stemmer.cache_stats();
+            ASSERT(stats.entries <= cache_size);
+            ASSERT_EQUAL(stats.hits + stats.misses, expected.size());
+            ASSERT_EQUAL(stats.insertions, stats.misses);
+            ASSERT_EQUAL(stats.evictions + stats.entries, stats.insertions);
+            if (cache_size < distinct.size())
+                continue;
+
+            // a cache larger than the vocabulary stems each word once
+            ASSERT_EQUAL(stats.misses, distinct.size());
+            ASSERT_EQUAL(stats.evictions, 0ul);
+            uint64_t bytes = 0;
+            for (const auto& token : distinct)
+            {
+                auto it = stems.find(token);
+                bytes += token.size()
+                         + (it == stems.end() ? token : it->second).size();
+            }
+            ASSERT_EQUAL(stats.bytes, bytes);
+        }
+
+        bool thrown = false;
+        try
+        {
+            std::stringstream config_ss{
+                "[[filter]]\ntype = \"whitespace-tokenizer\"\n"
+                "[[filter]]\ntype = \"porter2-stemmer\"\ncache-size = -1\n"};
+            auto config = cpptoml::parser{config_ss}.parse();
+            analyzer::load_filters(config, config);
+        }
+        catch (token_stream::token_stream_exception&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+    });
+
     return num_failed;
 }
 }
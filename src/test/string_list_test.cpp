@@ -10,11 +10,10 @@ namespace meta
 namespace testing
 {
 
-void assert_read(std::ifstream& file, const std::string& expect)
+void assert_read(io::front_coding::block_reader& reader,
+                 const std::string& expect)
 {
-    std::string str;
-    io::read_binary(file, str);
-    ASSERT_EQUAL(str, expect);
+    ASSERT_EQUAL(reader.next(), expect);
 }
 
 int string_list_tests()
@@ -35,13 +34,29 @@ int string_list_tests()
             writer.insert(4, "dog");
             writer.insert(3, "a no good very dead ex-parrot");
         }
-        std::ifstream file{"meta-tmp-string-list.bin", std::ios::binary};
-        assert_read(file, "wat woah this is neato");
-        assert_read(file, "things and stuff");
-        assert_read(file, "other stuff");
-        assert_read(file, "cat");
-        assert_read(file, "dog");
-        assert_read(file, "a no good very dead ex-parrot");
+        // the strings are written in index order, all in one block
+        {
+            io::mmap_file file{"meta-tmp-string-list.bin"};
+            io::front_coding::block_reader reader{file.begin()};
+            assert_read(reader, "things and stuff");
+            assert_read(reader, "cat");
+            assert_read(reader, "other stuff");
+            assert_read(reader, "a no good very dead ex-parrot");
+            assert_read(reader, "dog");
+            assert_read(reader, "wat woah this is neato");
+        }
+
+        std::ifstream index{"meta-tmp-string-list.bin_index", std::ios::binary};
+        uint64_t value;
+        io::read_binary(index, value);
+        ASSERT_EQUAL(value, 6ul);
+        io::read_binary(index, value);
+        ASSERT_EQUAL(value, 16ul);
+        io::read_binary(index, value);
+        ASSERT_EQUAL(value, 0ul);
+        index.peek();
+        ASSERT(index.eof());
+        ASSERT(!filesystem::file_exists("meta-tmp-string-list.bin.tmp"));
     });
 
     num_failed += testing::run_test("string_list_read_basic", [&]()
@@ -60,13 +75,46 @@ int string_list_tests()
         }
 
         string_list list{"meta-tmp-string-list.bin"};
-        ASSERT_EQUAL(std::strcmp(list.at(5), "wat woah this is neato"), 0);
-        ASSERT_EQUAL(std::strcmp(list.at(0), "things and stuff"), 0);
-        ASSERT_EQUAL(std::strcmp(list.at(2), "other stuff"), 0);
-        ASSERT_EQUAL(std::strcmp(list.at(1), "cat"), 0);
-        ASSERT_EQUAL(std::strcmp(list.at(4), "dog"), 0);
-        ASSERT_EQUAL(std::strcmp(list.at(3), "a no good very dead ex-parrot"),
-                     0);
+        ASSERT_EQUAL(list.at(5), "wat woah this is neato");
+        ASSERT_EQUAL(list.at(0), "things and stuff");
+        ASSERT_EQUAL(list.at(2), "other stuff");
+        ASSERT_EQUAL(list.at(1), "cat");
+        ASSERT_EQUAL(list.at(4), "dog");
+        ASSERT_EQUAL(list.at(3), "a no good very dead ex-parrot");
+        ASSERT_EQUAL(list.size(), 6ul);
+    });
+
+    num_failed += testing::run_test("string_list_front_coding", [&]()
+    {
+        file_guard f{"meta-tmp-string-list.bin"};
+        file_guard fi{"meta-tmp-string-list.bin_index"};
+        using namespace index;
+        std::vector<std::string> paths;
+        uint64_t raw_size = 0;
+        for (uint64_t i = 0; i < 100; ++i)
+        {
+            paths.push_back("/data/corpora/ceeaus/chn/file-"
+                            + std::to_string(i) + ".txt");
+            raw_size += paths.back().size() + 1;
+        }
+        // every tenth string is left out, and the rest are inserted in
+        // reverse
+        {
+            string_list_writer writer{"meta-tmp-string-list.bin",
+                                      paths.size(), 4};
+            for (uint64_t i = paths.size(); i > 0; --i)
+            {
+                if ((i - 1) % 10 != 0)
+                    writer.insert(i - 1, paths[i - 1]);
+            }
+        }
+        ASSERT(filesystem::file_size("meta-tmp-string-list.bin")
+               < raw_size / 2);
+
+        string_list list{"meta-tmp-string-list.bin"};
+        ASSERT_EQUAL(list.size(), paths.size());
+        for (uint64_t i = 0; i < paths.size(); ++i)
+            ASSERT_EQUAL(list.at(i), i % 10 == 0 ? "" : paths[i]);
     });
 
     return num_failed;
@@ -22,6 +22,12 @@
 #include "test/compression_test.h"
 #include "test/parser_test.h"
 #include "test/filesystem_test.h"
+#include "test/logging_test.h"
+#include "test/search_protocol_test.h"
+#include "test/topics_test.h"
+#include "test/language_model_test.h"
+#include "test/crf_test.h"
+#include "test/vector_test.h"
 #include "util/printing.h"
 
 using namespace meta;
@@ -49,6 +55,12 @@ int main(int argc, char* argv[])
         std::cerr << " \"graph\": runs undirected and directed graph tests" << std::endl;
         std::cerr << " \"parser\": runs parser tests" << std::endl;
         std::cerr << " \"filesystem\": runs filesystem tests" << std::endl;
+        std::cerr << " \"logging\": runs logging tests" << std::endl;
+        std::cerr << " \"search-protocol\": runs search protocol tests" << std::endl;
+        std::cerr << " \"topics\": runs topic model tests" << std::endl;
+        std::cerr << " \"language-model\": runs language model tests" << std::endl;
+        std::cerr << " \"crf\": runs CRF tests" << std::endl;
+        std::cerr << " \"vectors\": runs dense vector and hybrid retrieval tests" << std::endl;
         return 1;
     }
 
@@ -88,6 +100,18 @@ int main(int argc, char* argv[])
         num_failed += testing::parser_tests();
     if (all || args.find("filesystem") != args.end())
         num_failed += testing::filesystem_tests();
+    if (all || args.find("logging") != args.end())
+        num_failed += testing::logging_tests();
+    if (all || args.find("search-protocol") != args.end())
+        num_failed += testing::search_protocol_tests();
+    if (all || args.find("topics") != args.end())
+        num_failed += testing::topics_tests();
+    if (all || args.find("language-model") != args.end())
+        num_failed += testing::language_model_tests();
+    if (all || args.find("crf") != args.end())
+        num_failed += testing::crf_tests();
+    if (all || args.find("vectors") != args.end())
+        num_failed += testing::vector_tests();
 
     return num_failed;
 }
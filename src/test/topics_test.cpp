@@ -0,0 +1,1120 @@
+/**
+ * @file topics_test.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <random>
+#include <sstream>
+
+#include "index/forward_index.h"
+#include "io/binary.h"
+#include "stats/frozen_multinomial.h"
+#include "test/topics_test.h"
+#include "topics/lda_cvb.h"
+#include "topics/lda_gibbs.h"
+#include "topics/lda_scvb.h"
+#include "topics/log_gamma_table.h"
+#include "topics/parallel_lda_cvb.h"
+#include "topics/parallel_lda_gibbs.h"
+#include "topics/sparse_lda_gibbs.h"
+#include "topics/spherical_kmeans.h"
+#include "topics/topic_assignments.h"
+#include "topics/topic_inferencer.h"
+#include "topics/topic_model_file.h"
+#include "util/filesystem.h"
+
+namespace meta
+{
+namespace testing
+{
+
+namespace
+{
+
+/// The number of topics the synthetic corpus is drawn from
+const uint64_t true_topics = 3;
+
+/// The number of terms that belong to each of those topics
+const uint64_t terms_per_topic = 10;
+
+/**
+ * Writes a libsvm corpus whose documents each use the terms of one of
+ * true_topics disjoint topics, and builds a forward index over it in
+ * meta-tmp-topics.
+ * @return the forward index
+ */
+std::shared_ptr<index::forward_index> make_corpus()
+{
+    filesystem::remove_all("meta-tmp-topics");
+    filesystem::make_directory("meta-tmp-topics");
+    filesystem::make_directory("meta-tmp-topics/lda");
+
+    std::mt19937 rng{47};
+    std::uniform_int_distribution<uint64_t> term_dist{0, terms_per_topic - 1};
+    std::uniform_int_distribution<uint64_t> length_dist{1, 6};
+    {
+        std::ofstream corpus{"meta-tmp-topics/lda/lda.dat"};
+        for (uint64_t doc = 0; doc < 60; ++doc)
+        {
+            // libsvm term ids are one-based and increasing within a line
+            std::vector<uint64_t> counts(terms_per_topic, 0);
+            for (uint64_t i = 0; i < 25; ++i)
+                counts[term_dist(rng)] += length_dist(rng) == 1 ? 2 : 1;
+            corpus << doc % true_topics;
+            for (uint64_t t = 0; t < terms_per_topic; ++t)
+            {
+                if (counts[t] > 0)
+                    corpus << ' '
+                           << (doc % true_topics) * terms_per_topic + t + 1
+                           << ':' << counts[t];
+            }
+            corpus << '\n';
+        }
+    }
+
+    {
+        std::ofstream config{"meta-tmp-topics/config.toml"};
+        config << "prefix = \"meta-tmp-topics\"\n"
+               << "corpus-type = \"line-corpus\"\n"
+               << "dataset = \"lda\"\n"
+               << "forward-index = \"meta-tmp-topics/lda-fwd\"\n"
+               << "inverted-index = \"meta-tmp-topics/lda-inv\"\n"
+               << "[[analyzers]]\n"
+               << "method = \"libsvm\"\n";
+    }
+    return index::make_index<index::forward_index>(
+        "meta-tmp-topics/config.toml");
+}
+
+/**
+ * Checks that two accumulated quantities agree up to rounding.
+ */
+void check_close(double actual, double expected)
+{
+    ASSERT_LESS(std::abs(actual - expected),
+                1e-6 * std::max(1.0, std::abs(expected)));
+}
+
+/**
+ * Reads a text model file, a line per row of a row id and then
+ * id:value pairs, separated by tabs.
+ * @param filename The file
+ * @return the values of each row, by id
+ */
+std::vector<std::map<uint64_t, double>>
+    read_text_rows(const std::string& filename)
+{
+    std::vector<std::map<uint64_t, double>> rows;
+    std::ifstream file{filename};
+    std::string line;
+    while (std::getline(file, line))
+    {
+        std::istringstream fields{line};
+        uint64_t row;
+        fields >> row;
+        ASSERT_EQUAL(row, rows.size());
+        rows.emplace_back();
+        std::string pair;
+        while (fields >> pair)
+        {
+            auto colon = pair.find(':');
+            rows.back()[std::stoull(pair.substr(0, colon))]
+                = std::stod(pair.substr(colon + 1));
+        }
+    }
+    return rows;
+}
+
+/**
+ * A random number generator whose values are evenly spaced over its
+ * range, so that uniform samples drawn from it cover [0, 1) in even
+ * steps rather than at random.
+ */
+class grid_generator
+{
+  public:
+    using result_type = uint64_t;
+
+    /**
+     * @param steps The number of values before they repeat
+     */
+    grid_generator(uint64_t steps)
+        : step_{std::numeric_limits<uint64_t>::max() / steps}
+    {
+        // nothing
+    }
+
+    /**
+     * @return the middle of the next step
+     */
+    result_type operator()()
+    {
+        return step_ * next_++ + step_ / 2;
+    }
+
+    /**
+     * @return the smallest value
+     */
+    static constexpr result_type min()
+    {
+        return 0;
+    }
+
+    /**
+     * @return the largest value
+     */
+    static constexpr result_type max()
+    {
+        return std::numeric_limits<uint64_t>::max();
+    }
+
+  private:
+    /// The width of each step
+    uint64_t step_;
+
+    /// The number of values given so far
+    uint64_t next_ = 0;
+};
+
+/**
+ * Exposes the counts of a Gibbs sampler, so that they can be checked
+ * against its topic assignments.
+ */
+template <class Model>
+class gibbs_probe : public Model
+{
+  public:
+    using Model::Model;
+
+    /**
+     * Recounts the topic assignments and checks that every count the
+     * sampler keeps agrees with them.
+     */
+    void check_counts() const
+    {
+        auto num_docs = this->idx_->num_docs();
+        auto k = this->num_topics_;
+        std::vector<uint64_t> doc_counts(num_docs * k, 0);
+        std::vector<uint64_t> term_counts(this->num_words_ * k, 0);
+        std::vector<uint64_t> totals(k, 0);
+        for (doc_id doc{0}; doc < num_docs; ++doc)
+        {
+            uint64_t n = 0;
+            for (const auto& freq : this->doc_terms_[doc])
+            {
+                for (uint64_t j = 0; j < freq.second; ++j)
+                {
+                    auto topic = this->doc_word_topic_(doc, n++);
+                    ASSERT_LESS(topic, k);
+                    ++doc_counts[doc * k + topic];
+                    ++term_counts[freq.first * k + topic];
+                    ++totals[topic];
+                }
+            }
+            ASSERT_EQUAL(this->doc_word_topic_.size(doc), n);
+            ASSERT_EQUAL(n, this->idx_->doc_size(doc));
+        }
+
+        for (doc_id doc{0}; doc < num_docs; ++doc)
+            for (topic_id topic{0}; topic < k; ++topic)
+                ASSERT_EQUAL(uint64_t{this->doc_topics_(doc, topic)},
+                             doc_counts[doc * k + topic]);
+        for (term_id term{0}; term < this->num_words_; ++term)
+            for (topic_id topic{0}; topic < k; ++topic)
+                ASSERT_EQUAL(uint64_t{this->term_topics_(term, topic)},
+                             term_counts[term * k + topic]);
+        for (topic_id topic{0}; topic < k; ++topic)
+            ASSERT_EQUAL(this->topic_totals_[topic], totals[topic]);
+    }
+
+    /**
+     * Seeds the sampler's random number generator.
+     */
+    void seed(uint64_t value)
+    {
+        this->rng_.seed(value);
+    }
+
+    /**
+     * @return whether both samplers assigned every word the same topic
+     */
+    bool same_assignments(const gibbs_probe& other) const
+    {
+        for (doc_id doc{0}; doc < this->idx_->num_docs(); ++doc)
+        {
+            for (uint64_t i = 0; i < this->doc_word_topic_.size(doc); ++i)
+            {
+                if (this->doc_word_topic_(doc, i)
+                    != other.doc_word_topic_(doc, i))
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    /**
+     * @return the log likelihood the sampler evaluates
+     */
+    double likelihood() const
+    {
+        return this->corpus_log_likelihood();
+    }
+
+    /**
+     * @return log P(W|Z) computed from the counts with lgamma directly
+     */
+    double expected_likelihood() const
+    {
+        auto beta = this->beta_;
+        double vbeta = this->num_words_ * beta;
+        double likelihood = this->num_topics_ * std::lgamma(vbeta);
+        for (topic_id topic{0}; topic < this->num_topics_; ++topic)
+        {
+            likelihood -= std::lgamma(this->topic_totals_[topic] + vbeta);
+            for (term_id term{0}; term < this->num_words_; ++term)
+                likelihood += std::lgamma(this->term_topics_(term, topic)
+                                          + beta)
+                              - std::lgamma(beta);
+        }
+        return likelihood;
+    }
+};
+
+/**
+ * Exposes the sparse counts of a SparseLDA sampler, so that they can be
+ * checked against its topic assignments.
+ */
+class sparse_probe : public topics::sparse_lda_gibbs
+{
+  public:
+    using topics::sparse_lda_gibbs::sparse_lda_gibbs;
+
+    /**
+     * Recounts the topic assignments and checks that the topics of each
+     * document are exactly its nonzero counts, by topic id, that the
+     * topics of each term are exactly its nonzero counts, by decreasing
+     * count, and that the likelihood is the one of the counts.
+     */
+    void check_counts() const
+    {
+        auto num_docs = idx_->num_docs();
+        auto k = num_topics_;
+        std::vector<uint64_t> term_counts(num_words_ * k, 0);
+        std::vector<uint64_t> totals(k, 0);
+        for (doc_id doc{0}; doc < num_docs; ++doc)
+        {
+            std::vector<uint64_t> doc_counts(k, 0);
+            uint64_t n = 0;
+            for (const auto& freq : doc_terms_[doc])
+            {
+                for (uint64_t j = 0; j < freq.second; ++j)
+                {
+                    auto topic = doc_word_topic_(doc, n++);
+                    ASSERT_LESS(topic, k);
+                    ++doc_counts[topic];
+                    ++term_counts[freq.first * k + topic];
+                    ++totals[topic];
+                }
+            }
+            ASSERT_EQUAL(doc_word_topic_.size(doc), n);
+            ASSERT_EQUAL(n, idx_->doc_size(doc));
+
+            uint64_t i = 0;
+            for (topic_id topic{0}; topic < k; ++topic)
+            {
+                if (doc_counts[topic] == 0)
+                    continue;
+                ASSERT_LESS(i, doc_topics_[doc].size());
+                ASSERT_EQUAL(doc_topics_[doc][i].topic, topic);
+                ASSERT_EQUAL(doc_topics_[doc][i].count, doc_counts[topic]);
+                ++i;
+            }
+            ASSERT_EQUAL(doc_topics_[doc].size(), i);
+        }
+
+        double likelihood = k * std::lgamma(num_words_ * beta_);
+        for (term_id term{0}; term < num_words_; ++term)
+        {
+            const auto& topics = term_topics_[term];
+            uint64_t nonzero = 0;
+            for (topic_id topic{0}; topic < k; ++topic)
+            {
+                auto count = term_counts[term * k + topic];
+                likelihood += std::lgamma(count + beta_) - std::lgamma(beta_);
+                if (count == 0)
+                    continue;
+                ++nonzero;
+                auto it = std::find_if(topics.begin(), topics.end(),
+                                       [&](const topic_count& tc)
+                                       {
+                                           return tc.topic == topic;
+                                       });
+                ASSERT(it != topics.end());
+                ASSERT_EQUAL(it->count, count);
+            }
+            ASSERT_EQUAL(topics.size(), nonzero);
+            for (uint64_t i = 1; i < topics.size(); ++i)
+                ASSERT(topics[i - 1].count >= topics[i].count);
+        }
+        for (topic_id topic{0}; topic < k; ++topic)
+        {
+            ASSERT_EQUAL(topic_totals_[topic], totals[topic]);
+            likelihood -= std::lgamma(totals[topic] + num_words_ * beta_);
+        }
+        check_close(corpus_log_likelihood(), likelihood);
+    }
+};
+
+/**
+ * Exposes the expected counts of a CVB0 model, so that they can be
+ * checked against its gamma distributions.
+ */
+class cvb_probe : public topics::parallel_lda_cvb
+{
+  public:
+    using topics::parallel_lda_cvb::parallel_lda_cvb;
+
+    /**
+     * Checks that every gamma is a distribution and that the expected
+     * counts are the sums of the gammas weighted by the term counts.
+     */
+    void check_counts() const
+    {
+        auto num_docs = idx_->num_docs();
+        auto k = num_topics_;
+        std::vector<double> term_counts(num_words_ * k, 0.0);
+        std::vector<double> totals(k, 0.0);
+        double num_words = 0;
+        for (doc_id doc{0}; doc < num_docs; ++doc)
+        {
+            std::vector<double> doc_counts(k, 0.0);
+            uint64_t i = 0;
+            for (const auto& freq : doc_terms_[doc])
+            {
+                auto gamma = &gamma_[doc][i * k];
+                double sum = 0;
+                for (topic_id topic{0}; topic < k; ++topic)
+                {
+                    ASSERT(gamma[topic] >= 0);
+                    sum += gamma[topic];
+                    auto count = freq.second * gamma[topic];
+                    doc_counts[topic] += count;
+                    term_counts[freq.first * k + topic] += count;
+                    totals[topic] += count;
+                }
+                check_close(sum, 1.0);
+                num_words += freq.second;
+                ++i;
+            }
+            ASSERT_EQUAL(gamma_[doc].size(), i * k);
+            for (topic_id topic{0}; topic < k; ++topic)
+                check_close(doc_topics_(doc, topic), doc_counts[topic]);
+        }
+
+        for (term_id term{0}; term < num_words_; ++term)
+            for (topic_id topic{0}; topic < k; ++topic)
+                check_close(term_topics_(term, topic),
+                            term_counts[term * k + topic]);
+        double total = 0;
+        for (topic_id topic{0}; topic < k; ++topic)
+        {
+            check_close(topic_totals_[topic], totals[topic]);
+            total += topic_totals_[topic];
+        }
+        check_close(total, num_words);
+    }
+};
+
+/**
+ * Writes a model file in the format of
+ * lda_model::save_topic_term_probabilities, in which each of the
+ * true_topics topics puts most of its mass on its own block of terms.
+ * @param filename The file to write
+ */
+void write_block_model(const std::string& filename)
+{
+    auto num_words = true_topics * terms_per_topic;
+    std::ofstream file{filename, std::ios::binary};
+    io::write_binary(file, true_topics);
+    io::write_binary(file, num_words);
+
+    // each topic gives 0.97 to its own terms and 0.03 to the others
+    auto own = static_cast<float>(0.97 / terms_per_topic);
+    auto other
+        = static_cast<float>(0.03 / (num_words - terms_per_topic));
+    for (uint64_t term = 0; term < num_words; ++term)
+    {
+        for (uint64_t topic = 0; topic < true_topics; ++topic)
+        {
+            float prob = term / terms_per_topic == topic ? own : other;
+            file.write(reinterpret_cast<const char*>(&prob), sizeof(float));
+        }
+    }
+}
+
+/**
+ * Checks that a vector of proportions is a distribution.
+ */
+void check_distribution(const std::vector<double>& theta)
+{
+    double sum = 0;
+    for (const auto& prob : theta)
+    {
+        ASSERT(prob > 0);
+        sum += prob;
+    }
+    check_close(sum, 1.0);
+}
+}
+
+int gibbs_count_tests()
+{
+    int num_failed = 0;
+    num_failed += testing::run_test("parallel-lda-gibbs-counts", [&]()
+    {
+        auto idx = make_corpus();
+        // run() starts over from a random initialization every time
+        for (uint64_t iters : {uint64_t{0}, uint64_t{1}, uint64_t{5}})
+        {
+            gibbs_probe<topics::parallel_lda_gibbs> model{idx, 4, 0.1, 0.1};
+            model.run(iters, -1.0);
+            model.check_counts();
+        }
+        filesystem::remove_all("meta-tmp-topics");
+    });
+
+    num_failed += testing::run_test("sparse-lda-gibbs-counts", [&]()
+    {
+        auto idx = make_corpus();
+        for (uint64_t iters : {uint64_t{0}, uint64_t{1}, uint64_t{5}})
+        {
+            sparse_probe model{idx, 4, 0.1, 0.1};
+            model.run(iters, -1.0);
+            model.check_counts();
+
+            // large priors spread every term over many topics, whose
+            // order then changes often
+            sparse_probe spread{idx, 8, 5.0, 5.0};
+            spread.run(iters, -1.0);
+            spread.check_counts();
+        }
+        filesystem::remove_all("meta-tmp-topics");
+    });
+
+    num_failed += testing::run_test("parallel-lda-gibbs-assignments-file",
+                                    [&]()
+    {
+        auto idx = make_corpus();
+        {
+            gibbs_probe<topics::parallel_lda_gibbs> model{
+                idx, 4, 0.1, 0.1, "meta-tmp-topics/assignments"};
+            model.run(3, -1.0);
+            model.check_counts();
+        }
+        ASSERT(filesystem::file_exists("meta-tmp-topics/assignments"));
+        filesystem::remove_all("meta-tmp-topics");
+    });
+    return num_failed;
+}
+
+int cvb_tests()
+{
+    return testing::run_test("parallel-lda-cvb-counts", [&]()
+    {
+        auto idx = make_corpus();
+        for (uint64_t iters : {uint64_t{0}, uint64_t{1}, uint64_t{10}})
+        {
+            cvb_probe model{idx, 4, 0.1, 0.1};
+            model.run(iters, 1e-4);
+            model.check_counts();
+        }
+        filesystem::remove_all("meta-tmp-topics");
+    });
+}
+
+int scvb_tests()
+{
+    return testing::run_test("lda-scvb-distributions", [&]()
+    {
+        auto idx = make_corpus();
+        topics::lda_scvb model{idx, 4, 0.1, 0.1, 16};
+        model.run(10);
+
+        // saving the doc-topic probabilities throws unless they sum to one
+        model.save_doc_topic_probabilities("meta-tmp-topics/lda.theta.bin");
+        model.save_topic_term_probabilities("meta-tmp-topics/lda.topics");
+
+        topics::topic_matrix theta{"meta-tmp-topics/lda.theta.bin"};
+        ASSERT_EQUAL(theta.num_topics(), uint64_t{4});
+        ASSERT_EQUAL(theta.num_rows(), idx->num_docs());
+        for (uint64_t doc = 0; doc < theta.num_rows(); ++doc)
+        {
+            double sum = 0;
+            for (topic_id topic{0}; topic < theta.num_topics(); ++topic)
+                sum += theta.probability(doc, topic);
+            ASSERT_LESS(std::abs(sum - 1.0), 1e-4);
+        }
+
+        topics::topic_matrix phi{"meta-tmp-topics/lda.topics"};
+        ASSERT_EQUAL(phi.num_topics(), uint64_t{4});
+        ASSERT_EQUAL(phi.num_rows(), idx->unique_terms());
+        for (topic_id topic{0}; topic < phi.num_topics(); ++topic)
+        {
+            double sum = 0;
+            for (uint64_t term = 0; term < phi.num_rows(); ++term)
+            {
+                ASSERT(phi.probability(term, topic) > 0);
+                sum += phi.probability(term, topic);
+            }
+            ASSERT_LESS(std::abs(sum - 1.0), 1e-4);
+        }
+        filesystem::remove_all("meta-tmp-topics");
+    });
+}
+
+int inferencer_tests()
+{
+    int num_failed = 0;
+    num_failed += testing::run_test("topic-inferencer-block-model", [&]()
+    {
+        filesystem::remove_all("meta-tmp-topics");
+        filesystem::make_directory("meta-tmp-topics");
+        write_block_model("meta-tmp-topics/block.topics");
+
+        topics::topic_inferencer inferencer{"meta-tmp-topics/block.topics",
+                                            0.1, 50, 1e-6};
+        ASSERT_EQUAL(inferencer.num_topics(), true_topics);
+        ASSERT_EQUAL(inferencer.num_words(), true_topics * terms_per_topic);
+
+        // a document written with the terms of one topic is assigned to it
+        for (uint64_t topic = 0; topic < true_topics; ++topic)
+        {
+            auto first = topic * terms_per_topic;
+            auto theta = inferencer.infer(
+                {{term_id{first}, 3.0}, {term_id{first + 4}, 2.0},
+                 {term_id{first + 9}, 1.0}});
+            ASSERT_EQUAL(theta.size(), true_topics);
+            check_distribution(theta);
+            ASSERT_GREATER(theta[topic], 0.9);
+        }
+
+        // a mixed document gets both topics in proportion
+        auto mixed = inferencer.infer({{term_id{0}, 10.0}, {term_id{1}, 10.0},
+                                       {term_id{25}, 10.0}});
+        check_distribution(mixed);
+        ASSERT_GREATER(mixed[0], mixed[2]);
+        ASSERT_GREATER(mixed[2], mixed[1]);
+
+        // unknown terms are skipped, and an empty document is uniform
+        auto known = inferencer.infer({{term_id{12}, 3.0}});
+        auto with_unknown
+            = inferencer.infer({{term_id{12}, 3.0}, {term_id{1000}, 5.0}});
+        for (uint64_t topic = 0; topic < true_topics; ++topic)
+            ASSERT_APPROX_EQUAL(known[topic], with_unknown[topic]);
+        for (const auto& prob : inferencer.infer({}))
+            ASSERT_APPROX_EQUAL(prob, 1.0 / true_topics);
+        filesystem::remove_all("meta-tmp-topics");
+    });
+
+    num_failed += testing::run_test("topic-inferencer-saved-model", [&]()
+    {
+        auto idx = make_corpus();
+        topics::lda_cvb model{idx, 3, 0.1, 0.1};
+        model.run(20);
+        model.save("meta-tmp-topics/lda");
+        ASSERT(filesystem::file_exists("meta-tmp-topics/lda.topics"));
+
+        topics::topic_inferencer inferencer{"meta-tmp-topics/lda.topics",
+                                            0.1};
+        ASSERT_EQUAL(inferencer.num_topics(), uint64_t{3});
+        ASSERT_EQUAL(inferencer.num_words(), idx->unique_terms());
+        for (uint64_t d = 0; d < idx->num_docs(); d += 7)
+        {
+            std::vector<std::pair<term_id, double>> counts;
+            auto pdata = idx->search_primary(doc_id{d});
+            for (const auto& freq : pdata->counts())
+                counts.emplace_back(freq.first, freq.second);
+            auto theta = inferencer.infer(counts);
+            ASSERT_EQUAL(theta.size(), uint64_t{3});
+            check_distribution(theta);
+        }
+        filesystem::remove_all("meta-tmp-topics");
+    });
+
+    num_failed += testing::run_test("topic-inferencer-bad-model", [&]()
+    {
+        filesystem::remove_all("meta-tmp-topics");
+        filesystem::make_directory("meta-tmp-topics");
+        try
+        {
+            topics::topic_inferencer{"meta-tmp-topics/missing.topics", 0.1};
+            FAIL("a missing model should throw");
+        }
+        catch (topics::topic_inferencer::topic_inferencer_exception&)
+        {
+            // expected
+        }
+
+        // a header promising more probabilities than the file holds
+        {
+            std::ofstream file{"meta-tmp-topics/short.topics",
+                               std::ios::binary};
+            io::write_binary(file, uint64_t{3});
+            io::write_binary(file, uint64_t{30});
+            float prob = 0.5f;
+            file.write(reinterpret_cast<const char*>(&prob), sizeof(float));
+        }
+        try
+        {
+            topics::topic_inferencer{"meta-tmp-topics/short.topics", 0.1};
+            FAIL("a truncated model should throw");
+        }
+        catch (topics::topic_inferencer::topic_inferencer_exception&)
+        {
+            // expected
+        }
+        filesystem::remove_all("meta-tmp-topics");
+    });
+    return num_failed;
+}
+
+int assignments_tests()
+{
+    int num_failed = 0;
+    std::vector<uint64_t> lengths{3, 0, 5, 1000, 1};
+    uint64_t total = 1009;
+
+    auto fill = [&](topics::topic_assignments& assignments, uint64_t k)
+    {
+        for (uint64_t doc = 0; doc < lengths.size(); ++doc)
+            for (uint64_t i = 0; i < lengths[doc]; ++i)
+                assignments.assign(doc, i, topic_id{(doc * 7919 + i * 104729)
+                                                    % k});
+        // the largest topic must survive the narrowing
+        assignments.assign(3, 999, topic_id{k - 1});
+    };
+
+    auto check = [&](const topics::topic_assignments& assignments, uint64_t k)
+    {
+        for (uint64_t doc = 0; doc < lengths.size(); ++doc)
+        {
+            ASSERT_EQUAL(assignments.size(doc), lengths[doc]);
+            for (uint64_t i = 0; i < lengths[doc]; ++i)
+            {
+                if (doc == 3 && i == 999)
+                    continue;
+                ASSERT_EQUAL(assignments(doc, i),
+                             topic_id{(doc * 7919 + i * 104729) % k});
+            }
+        }
+        ASSERT_EQUAL(assignments(3, 999), topic_id{k - 1});
+    };
+
+    num_failed += testing::run_test("topic-assignments-memory", [&]()
+    {
+        // 65536 topics is the most a 16-bit topic can hold
+        topics::topic_assignments narrow{lengths, 65536};
+        fill(narrow, 65536);
+        check(narrow, 65536);
+
+        topics::topic_assignments wide{lengths, 65537};
+        fill(wide, 65537);
+        check(wide, 65537);
+
+        auto narrow_bytes = narrow.memory_usage().heap_bytes;
+        auto wide_bytes = wide.memory_usage().heap_bytes;
+        ASSERT(narrow_bytes >= total * sizeof(uint16_t));
+        ASSERT(wide_bytes >= total * sizeof(uint32_t));
+        ASSERT_LESS(narrow_bytes, wide_bytes);
+    });
+
+    num_failed += testing::run_test("topic-assignments-file", [&]()
+    {
+        filesystem::remove_all("meta-tmp-topics");
+        filesystem::make_directory("meta-tmp-topics");
+        for (uint64_t k : {uint64_t{50}, uint64_t{100000}})
+        {
+            auto path = "meta-tmp-topics/assignments-" + std::to_string(k);
+            {
+                topics::topic_assignments assignments{lengths, k, path};
+                fill(assignments, k);
+                check(assignments, k);
+                auto usage = assignments.memory_usage();
+                ASSERT_EQUAL(usage.mapped_bytes,
+                             total * (k == 50 ? sizeof(uint16_t)
+                                              : sizeof(uint32_t)));
+            }
+
+            // the mapped topics are still there when the file is reopened
+            topics::topic_assignments reopened{lengths, k, path};
+            check(reopened, k);
+        }
+
+        // empty documents need no storage, in memory or on disk
+        topics::topic_assignments empty{{0, 0}, 10,
+                                        "meta-tmp-topics/assignments-empty"};
+        ASSERT_EQUAL(empty.size(0), uint64_t{0});
+        ASSERT_EQUAL(empty.size(1), uint64_t{0});
+        filesystem::remove_all("meta-tmp-topics");
+    });
+    return num_failed;
+}
+
+int likelihood_tests()
+{
+    int num_failed = 0;
+    num_failed += testing::run_test("log-gamma-table", [&]()
+    {
+        for (double beta : {0.01, 0.1, 1.0})
+        {
+            topics::log_gamma_table table{beta, 1024};
+            for (uint64_t n : {uint64_t{0}, uint64_t{1}, uint64_t{2},
+                               uint64_t{17}, uint64_t{1023}, uint64_t{1024},
+                               uint64_t{100000}})
+            {
+                auto expected = std::lgamma(n + beta) - std::lgamma(beta);
+                check_close(table(n), expected);
+            }
+        }
+    });
+
+    num_failed += testing::run_test("lda-gibbs-likelihood", [&]()
+    {
+        auto idx = make_corpus();
+        gibbs_probe<topics::lda_gibbs> serial{idx, 4, 0.1, 0.1};
+        serial.run(3, -1.0);
+        check_close(serial.likelihood(), serial.expected_likelihood());
+
+        // the parallel sampler sums the same terms in blocks
+        gibbs_probe<topics::parallel_lda_gibbs> parallel{idx, 4, 0.1, 0.1};
+        parallel.run(3, -1.0);
+        check_close(parallel.likelihood(), parallel.expected_likelihood());
+        filesystem::remove_all("meta-tmp-topics");
+    });
+
+    num_failed += testing::run_test("lda-gibbs-evaluation-interval", [&]()
+    {
+        // evaluating the likelihood less often must not change the samples
+        auto idx = make_corpus();
+        gibbs_probe<topics::lda_gibbs> every{idx, 4, 0.1, 0.1};
+        every.seed(47);
+        every.run(7, -1.0);
+
+        gibbs_probe<topics::lda_gibbs> sometimes{idx, 4, 0.1, 0.1};
+        sometimes.seed(47);
+        sometimes.evaluation_interval(3);
+        sometimes.run(7, -1.0);
+        ASSERT(every.same_assignments(sometimes));
+        sometimes.check_counts();
+
+        // an interval of zero is treated as one
+        gibbs_probe<topics::lda_gibbs> zero{idx, 4, 0.1, 0.1};
+        zero.seed(47);
+        zero.evaluation_interval(0);
+        zero.run(7, -1.0);
+        ASSERT(every.same_assignments(zero));
+        filesystem::remove_all("meta-tmp-topics");
+    });
+    return num_failed;
+}
+
+int model_file_tests()
+{
+    return testing::run_test("lda-binary-model-round-trip", [&]()
+    {
+        auto idx = make_corpus();
+        topics::lda_cvb model{idx, 4, 0.1, 0.1};
+        model.run(10);
+        model.save("meta-tmp-topics/text");
+        model.binary_output(5);
+        model.save("meta-tmp-topics/bin");
+        ASSERT(!filesystem::file_exists("meta-tmp-topics/bin.theta"));
+        ASSERT(!filesystem::file_exists("meta-tmp-topics/bin.phi"));
+        ASSERT_EQUAL(filesystem::file_text("meta-tmp-topics/bin.topics"),
+                     filesystem::file_text("meta-tmp-topics/text.topics"));
+
+        // the text files hold six significant digits
+        auto check_value = [](double actual, double expected)
+        {
+            ASSERT_LESS(std::abs(actual - expected),
+                        1e-5 * std::abs(expected) + 1e-7);
+        };
+
+        auto text_theta = read_text_rows("meta-tmp-topics/text.theta");
+        topics::topic_matrix theta{"meta-tmp-topics/bin.theta.bin"};
+        ASSERT_EQUAL(theta.num_topics(), uint64_t{4});
+        ASSERT_EQUAL(theta.num_rows(), idx->num_docs());
+        ASSERT_EQUAL(text_theta.size(), theta.num_rows());
+        for (uint64_t doc = 0; doc < theta.num_rows(); ++doc)
+        {
+            for (topic_id topic{0}; topic < theta.num_topics(); ++topic)
+            {
+                auto it = text_theta[doc].find(topic);
+                check_value(theta.probability(doc, topic),
+                            it == text_theta[doc].end() ? 0 : it->second);
+            }
+        }
+
+        // each topic keeps its best terms of the text file, best first
+        auto text_phi = read_text_rows("meta-tmp-topics/text.phi");
+        topics::topic_top_terms phi{"meta-tmp-topics/bin.phi.bin"};
+        ASSERT_EQUAL(phi.num_topics(), uint64_t{4});
+        ASSERT_EQUAL(phi.terms_per_topic(), uint64_t{5});
+        ASSERT_EQUAL(text_phi.size(), phi.num_topics());
+        for (topic_id topic{0}; topic < phi.num_topics(); ++topic)
+        {
+            std::vector<double> best;
+            for (const auto& entry : text_phi[topic])
+                best.push_back(entry.second);
+            std::sort(best.begin(), best.end(), std::greater<double>());
+            ASSERT(best.size() >= phi.terms_per_topic());
+            for (uint64_t i = 0; i < phi.terms_per_topic(); ++i)
+            {
+                auto t_id = phi.term(topic, i);
+                ASSERT_EQUAL(text_phi[topic].count(t_id), uint64_t{1});
+                check_value(phi.score(topic, i), text_phi[topic][t_id]);
+                check_value(phi.score(topic, i), best[i]);
+            }
+        }
+
+        // asking for more terms than there are keeps all of them
+        model.binary_output(1000);
+        model.save("meta-tmp-topics/all");
+        topics::topic_top_terms all{"meta-tmp-topics/all.phi.bin"};
+        ASSERT_EQUAL(all.terms_per_topic(), idx->unique_terms());
+        filesystem::remove_all("meta-tmp-topics");
+    });
+}
+
+int kmeans_tests()
+{
+    return testing::run_test("spherical-kmeans-reference", [&]()
+    {
+        auto idx = make_corpus();
+        std::vector<std::vector<double>> docs;
+        for (const auto& d_id : idx->docs())
+        {
+            // the documents as unit vectors
+            std::vector<double> doc(idx->unique_terms(), 0.0);
+            auto pdata = idx->search_primary(d_id);
+            double norm = 0;
+            for (const auto& count : pdata->counts())
+            {
+                doc[count.first] = count.second;
+                norm += count.second * count.second;
+            }
+            for (auto& weight : doc)
+                weight /= std::sqrt(norm);
+            docs.push_back(doc);
+        }
+        auto cosine = [](const std::vector<double>& doc,
+                         const std::vector<double>& centroid)
+        {
+            double dot = 0;
+            double norm = 0;
+            for (uint64_t t = 0; t < doc.size(); ++t)
+            {
+                dot += doc[t] * centroid[t];
+                norm += centroid[t] * centroid[t];
+            }
+            return norm > 0 ? dot / std::sqrt(norm) : -1.0;
+        };
+
+        parallel::thread_pool pool{3};
+        for (uint64_t batch_size : {uint64_t{0}, uint64_t{8}})
+        {
+            topics::kmeans_options options;
+            options.num_clusters = 5;
+            options.batch_size = batch_size;
+            options.max_iters = batch_size == 0 ? 100 : 50;
+            topics::spherical_kmeans kmeans{idx, options};
+            kmeans.run(pool);
+
+            // full batches run until no document moves, so each centroid
+            // is then the sum of its documents
+            std::vector<std::vector<double>> centroids(
+                options.num_clusters,
+                std::vector<double>(idx->unique_terms(), 0.0));
+            for (uint64_t d = 0; d < docs.size(); ++d)
+            {
+                uint64_t c{kmeans.cluster(doc_id{d})};
+                for (uint64_t t = 0; t < docs[d].size(); ++t)
+                    centroids[c][t] += docs[d][t];
+            }
+            for (topic_id c{0}; c < options.num_clusters; ++c)
+            {
+                double total = 0;
+                for (uint64_t t = 0; t < idx->unique_terms(); ++t)
+                {
+                    auto weight = kmeans.term_weight(c, term_id{t});
+                    total += weight;
+                    if (batch_size == 0)
+                    {
+                        double sum = 0;
+                        for (const auto& w : centroids[c])
+                            sum += w;
+                        ASSERT_LESS(std::abs(weight - centroids[c][t] / sum),
+                                    1e-5);
+                    }
+                    else
+                    {
+                        centroids[c][t] = weight;
+                    }
+                }
+                ASSERT_LESS(std::abs(total - 1.0), 1e-4);
+            }
+
+            // each document is with its most similar centroid
+            double objective = 0;
+            for (uint64_t d = 0; d < docs.size(); ++d)
+            {
+                uint64_t c{kmeans.cluster(doc_id{d})};
+                auto sim = cosine(docs[d], centroids[c]);
+                for (const auto& centroid : centroids)
+                    ASSERT(cosine(docs[d], centroid) <= sim + 1e-5);
+                ASSERT_LESS(std::abs(kmeans.similarity(doc_id{d}) - sim),
+                            1e-5);
+                objective += kmeans.similarity(doc_id{d});
+            }
+            ASSERT_LESS(std::abs(kmeans.objective()
+                                 - objective / docs.size()),
+                        1e-9);
+        }
+
+        // there cannot be more clusters than documents
+        {
+            topics::kmeans_options options;
+            options.num_clusters = idx->num_docs() + 1;
+            bool thrown = false;
+            try
+            {
+                topics::spherical_kmeans kmeans{idx, options};
+            }
+            catch (topics::kmeans_exception&)
+            {
+                thrown = true;
+            }
+            ASSERT(thrown);
+        }
+        filesystem::remove_all("meta-tmp-topics");
+    });
+}
+
+int frozen_multinomial_tests()
+{
+    return testing::run_test("frozen-multinomial", [&]()
+    {
+        std::mt19937 rng{47};
+        for (uint64_t size : {1, 2, 7, 100})
+        {
+            // some events cannot happen at all
+            std::vector<double> weights(size);
+            for (auto& weight : weights)
+                weight = rng() % 4 == 0 ? 0.0 : (rng() % 1000) / 10.0 + 0.1;
+            weights[rng() % size] = 5;
+            double total = 0;
+            for (const auto& weight : weights)
+                total += weight;
+
+            stats::frozen_multinomial<uint64_t> dist{weights};
+            ASSERT_EQUAL(dist.size(), size);
+            for (uint64_t i = 0; i < size; ++i)
+            {
+                ASSERT_EQUAL(dist.events()[i], i);
+                check_close(dist.probability(i), weights[i] / total);
+            }
+
+            // the first event whose running share of the total exceeds
+            // the quantile, by a scan
+            for (uint64_t step = 0; step <= 1000; ++step)
+            {
+                auto quantile = step / 1000.0;
+                uint64_t expected = 0;
+                double sum = weights[0];
+                while (expected + 1 < size && sum / total <= quantile)
+                    sum += weights[++expected];
+                ASSERT_EQUAL(dist.quantile(quantile), expected);
+            }
+
+            // samples from values evenly spread over [0, 1) come out in
+            // proportion to the weights, but for a value or two at the
+            // edges of each column of the alias table
+            uint64_t num_samples = size * 10000;
+            std::vector<uint64_t> counts(size, 0);
+            grid_generator grid{num_samples};
+            std::vector<uint64_t> samples;
+            dist.sample(grid, num_samples, std::back_inserter(samples));
+            ASSERT_EQUAL(samples.size(), num_samples);
+            for (const auto& sample : samples)
+                ++counts[sample];
+            for (uint64_t i = 0; i < size; ++i)
+            {
+                if (weights[i] == 0)
+                    ASSERT_EQUAL(counts[i], 0ul);
+                ASSERT_LESS(std::abs(counts[i] - num_samples * weights[i]
+                                                     / total),
+                            2.0 * size + 1);
+            }
+        }
+
+        // a multinomial's observed events keep their probabilities
+        stats::multinomial<std::string> words;
+        words.increment("a", 3);
+        words.increment("b", 1);
+        words.increment("c", 6);
+        stats::frozen_multinomial<std::string> frozen{words};
+        ASSERT_EQUAL(frozen.size(), 3ul);
+        for (uint64_t i = 0; i < frozen.size(); ++i)
+            check_close(frozen.probability(i),
+                        words.probability(frozen.events()[i]));
+
+        for (const auto& weights : {std::vector<double>{1, -1},
+                                    std::vector<double>{0, 0},
+                                    std::vector<double>{}})
+        {
+            bool thrown = false;
+            try
+            {
+                stats::frozen_multinomial<uint64_t> bad{weights};
+            }
+            catch (std::runtime_error&)
+            {
+                thrown = true;
+            }
+            ASSERT(thrown);
+        }
+
+        bool thrown = false;
+        try
+        {
+            stats::frozen_multinomial<std::string> bad{{"a", "b"}, {1.0}};
+        }
+        catch (std::runtime_error&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+    });
+}
+
+int topics_tests()
+{
+    int num_failed = 0;
+    num_failed += gibbs_count_tests();
+    num_failed += cvb_tests();
+    num_failed += scvb_tests();
+    num_failed += inferencer_tests();
+    num_failed += assignments_tests();
+    num_failed += likelihood_tests();
+    num_failed += model_file_tests();
+    num_failed += kmeans_tests();
+    num_failed += frozen_multinomial_tests();
+    return num_failed;
+}
+}
+}
@@ -57,3 +57,27 @@ set_tests_properties(parser PROPERTIES TIMEOUT 10 WORKING_DIRECTORY
 add_test(filesystem ${UNIT_TEST_EXE} filesystem)
 set_tests_properties(filesystem PROPERTIES TIMEOUT 10 WORKING_DIRECTORY
                          ${CMAKE_RUNTIME_OUTPUT_DIRECTORY})
+
+add_test(logging ${UNIT_TEST_EXE} logging)
+set_tests_properties(logging PROPERTIES TIMEOUT 30 WORKING_DIRECTORY
+                         ${CMAKE_RUNTIME_OUTPUT_DIRECTORY})
+
+add_test(search-protocol ${UNIT_TEST_EXE} search-protocol)
+set_tests_properties(search-protocol PROPERTIES TIMEOUT 10 WORKING_DIRECTORY
+                         ${CMAKE_RUNTIME_OUTPUT_DIRECTORY})
+
+add_test(topics ${UNIT_TEST_EXE} topics)
+set_tests_properties(topics PROPERTIES TIMEOUT 60 WORKING_DIRECTORY
+                         ${CMAKE_RUNTIME_OUTPUT_DIRECTORY})
+
+add_test(language-model ${UNIT_TEST_EXE} language-model)
+set_tests_properties(language-model PROPERTIES TIMEOUT 60 WORKING_DIRECTORY
+                         ${CMAKE_RUNTIME_OUTPUT_DIRECTORY})
+
+add_test(crf ${UNIT_TEST_EXE} crf)
+set_tests_properties(crf PROPERTIES TIMEOUT 60 WORKING_DIRECTORY
+                         ${CMAKE_RUNTIME_OUTPUT_DIRECTORY})
+
+add_test(vectors ${UNIT_TEST_EXE} vectors)
+set_tests_properties(vectors PROPERTIES TIMEOUT 60 WORKING_DIRECTORY
+                         ${CMAKE_RUNTIME_OUTPUT_DIRECTORY})
@@ -0,0 +1,875 @@
+/**
+ * @file vector_test.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "cpptoml.h"
+#include "corpus/document.h"
+#include "index/hybrid_ranker.h"
+#include "index/inverted_index.h"
+#include "index/ivf_index.h"
+#include "index/ranker/okapi_bm25.h"
+#include "index/vector_store.h"
+#include "parallel/thread_pool.h"
+#include "test/inverted_index_test.h"
+#include "test/vector_test.h"
+#include "util/dense_ops.h"
+#include "util/sparse_ops.h"
+
+namespace meta
+{
+namespace testing
+{
+
+namespace
+{
+/// A list of documents and their scores
+using results_type = std::vector<std::pair<doc_id, double>>;
+
+/**
+ * @param results A list of results
+ * @param d_id A document
+ * @return the document's score in the results; fails the test if it is
+ * not there
+ */
+double score_of(const results_type& results, doc_id d_id)
+{
+    auto it = std::find_if(results.begin(), results.end(),
+                           [&](const std::pair<doc_id, double>& result)
+                           {
+        return result.first == d_id;
+    });
+    ASSERT(it != results.end());
+    return it->second;
+}
+
+/**
+ * @param rng A random number generator
+ * @param dims The number of elements
+ * @return a vector of elements uniform in [-1, 1]
+ */
+std::vector<float> random_vector(std::mt19937& rng, uint64_t dims)
+{
+    std::uniform_real_distribution<float> dist{-1, 1};
+    std::vector<float> vec(dims);
+    for (auto& x : vec)
+        x = dist(rng);
+    return vec;
+}
+
+/**
+ * @param a A vector
+ * @param b A vector of the same length
+ * @return their dot product, summed in double precision
+ */
+double naive_dot(const std::vector<float>& a, const std::vector<float>& b)
+{
+    double result = 0;
+    for (uint64_t i = 0; i < a.size(); ++i)
+        result += static_cast<double>(a[i]) * b[i];
+    return result;
+}
+
+/**
+ * Writes random vectors for every other document of a store.
+ * @param dir The directory of the store
+ * @param num_docs The number of documents
+ * @param dims The number of elements of every vector
+ * @param encoding How the vectors are stored
+ * @return the vectors, empty for the documents without one
+ */
+std::vector<std::vector<float>> write_store(const std::string& dir,
+                                            uint64_t num_docs, uint64_t dims,
+                                            index::vector_encoding encoding)
+{
+    std::mt19937 rng{47};
+    std::vector<std::vector<float>> vecs(num_docs);
+    index::vector_store_writer writer{dir, num_docs, dims, encoding};
+    for (uint64_t d = 0; d < num_docs; d += 2)
+    {
+        vecs[d] = random_vector(rng, dims);
+        writer.insert(doc_id{d}, vecs[d]);
+    }
+    return vecs;
+}
+
+/**
+ * Checks that a store reads back the vectors it was written with: exactly
+ * as float32, and within half a quantization step of each element as
+ * int8, whose scores are the dot products with the decoded vectors.
+ * @param encoding How the vectors are stored
+ */
+void check_round_trip(index::vector_encoding encoding)
+{
+    system("rm -rf vectors-test");
+    uint64_t num_docs = 101;
+    uint64_t dims = 37;
+    auto vecs = write_store("vectors-test", num_docs, dims, encoding);
+
+    index::vector_store store{"vectors-test"};
+    ASSERT_EQUAL(store.size(), num_docs);
+    ASSERT_EQUAL(store.dims(), dims);
+    ASSERT(store.encoding() == encoding);
+    ASSERT(!store.contains(doc_id{num_docs}));
+
+    std::mt19937 rng{1};
+    auto query = random_vector(rng, dims);
+    for (uint64_t d = 0; d < num_docs; ++d)
+    {
+        doc_id d_id{d};
+        auto vec = store.vector(d_id);
+        ASSERT_EQUAL(vec.size(), dims);
+        if (vecs[d].empty())
+        {
+            ASSERT(!store.contains(d_id));
+            for (const auto& x : vec)
+                ASSERT_EQUAL(x, 0.0f);
+            continue;
+        }
+
+        ASSERT(store.contains(d_id));
+        float max_abs = 0;
+        for (const auto& x : vecs[d])
+            max_abs = std::max(max_abs, std::abs(x));
+        auto step = encoding == index::vector_encoding::int8 ? max_abs / 127
+                                                             : 0.0f;
+        for (uint64_t i = 0; i < dims; ++i)
+            ASSERT(std::abs(vec[i] - vecs[d][i]) <= step / 2 + 1e-6f);
+        ASSERT(std::abs(store.score(query.data(), d_id)
+                        - naive_dot(query, vec))
+               < 1e-4);
+    }
+}
+
+void float32_round_trip()
+{
+    check_round_trip(index::vector_encoding::float32);
+}
+
+void int8_round_trip()
+{
+    check_round_trip(index::vector_encoding::int8);
+}
+
+/**
+ * Checks the int8 dot products, with vector instructions when they are
+ * built and without, against a plain loop, including lengths that are not
+ * a multiple of the vector width.
+ */
+void dot_int8()
+{
+    std::mt19937 rng{47};
+    std::uniform_int_distribution<int> bytes{-127, 127};
+    for (uint64_t size : {0, 1, 3, 4, 7, 8, 15, 16, 17, 31, 32, 33, 100, 257})
+    {
+        auto query = random_vector(rng, size);
+        std::vector<int8_t> x(size);
+        double expected = 0;
+        double magnitude = 0;
+        for (uint64_t i = 0; i < size; ++i)
+        {
+            x[i] = static_cast<int8_t>(bytes(rng));
+            expected += static_cast<double>(query[i]) * x[i];
+            magnitude += std::abs(static_cast<double>(query[i]) * x[i]);
+        }
+        auto tolerance = 1e-5 * magnitude + 1e-6;
+        ASSERT(std::abs(index::internal::dot_int8(query.data(), x.data(), size)
+                        - expected)
+               <= tolerance);
+        ASSERT(std::abs(index::internal::dot_int8_scalar(query.data(),
+                                                         x.data(), size)
+                        - expected)
+               <= tolerance);
+    }
+}
+
+/**
+ * Checks that searching a store with a thread pool finds the same
+ * documents, with the same scores, as searching it serially, with and
+ * without a filter, for both encodings.
+ */
+void parallel_search()
+{
+    parallel::thread_pool pool{3};
+    std::mt19937 rng{1};
+    for (auto encoding :
+         {index::vector_encoding::float32, index::vector_encoding::int8})
+    {
+        system("rm -rf vectors-test");
+        write_store("vectors-test", 1000, 24, encoding);
+        index::vector_store store{"vectors-test"};
+        auto odd_tens = [](doc_id d_id)
+        {
+            return (d_id / 10) % 2 == 1;
+        };
+        for (uint64_t q = 0; q < 10; ++q)
+        {
+            auto query = random_vector(rng, 24);
+            for (uint64_t k : {1, 10, 100, 1000})
+            {
+                auto serial = store.search(query, k);
+                auto parallel = store.search(query, k, pool);
+                ASSERT_EQUAL(serial.size(), std::min<uint64_t>(k, 500));
+                ASSERT(serial == parallel);
+
+                serial = store.search(query, k, odd_tens);
+                parallel = store.search(query, k, pool, odd_tens);
+                ASSERT(serial == parallel);
+                for (const auto& result : serial)
+                    ASSERT(odd_tens(result.first));
+            }
+        }
+    }
+}
+
+/**
+ * Checks that an IVF index finds most of the true nearest neighbors of
+ * queries near clustered vectors, all of them when it probes every list,
+ * and the same ones after it is saved and loaded.
+ */
+void ivf_recall()
+{
+    system("rm -rf vectors-test ivf-test");
+    uint64_t num_docs = 2000;
+    uint64_t dims = 16;
+    uint64_t num_clusters = 20;
+    std::mt19937 rng{47};
+    std::vector<std::vector<float>> centers;
+    for (uint64_t c = 0; c < num_clusters; ++c)
+        centers.push_back(random_vector(rng, dims));
+    std::normal_distribution<float> noise{0, 0.1f};
+    auto near = [&](uint64_t c)
+    {
+        auto vec = centers[c];
+        for (auto& x : vec)
+            x += noise(rng);
+        return vec;
+    };
+    {
+        index::vector_store_writer writer{"vectors-test", num_docs, dims,
+                                          index::vector_encoding::float32};
+        for (uint64_t d = 0; d < num_docs; ++d)
+            writer.insert(doc_id{d}, near(d % num_clusters));
+    }
+    index::vector_store store{"vectors-test"};
+
+    parallel::thread_pool pool{2};
+    index::ivf_options options;
+    index::ivf_index ivf{store, options, pool};
+    ASSERT(ivf.lists() > options.probes);
+    ivf.save("ivf-test");
+    index::ivf_index loaded{store, "ivf-test"};
+    ASSERT_EQUAL(loaded.lists(), ivf.lists());
+
+    uint64_t k = 10;
+    uint64_t found = 0;
+    uint64_t num_queries = 50;
+    for (uint64_t q = 0; q < num_queries; ++q)
+    {
+        auto query = near(q % num_clusters);
+        auto exact = store.search(query, k);
+        auto approx = ivf.search(query, k);
+        ASSERT_EQUAL(approx.size(), k);
+        ASSERT(approx == loaded.search(query, k));
+
+        std::unordered_set<doc_id> truth;
+        for (const auto& result : exact)
+            truth.insert(result.first);
+        for (const auto& result : approx)
+            found += truth.count(result.first);
+
+        // every list holds every document it would find
+        ivf.probes(ivf.lists());
+        ASSERT(ivf.search(query, k) == exact);
+        ivf.probes(options.probes);
+    }
+    ASSERT(found >= 0.9 * k * num_queries);
+    system("rm -rf ivf-test");
+}
+
+/**
+ * Fuses the scores of a hybrid query as hybrid_ranker is documented to,
+ * from every document's exact lexical and dense scores.
+ * @param idx The index
+ * @param query The query terms
+ * @param store The vectors of the documents
+ * @param embedding The query's vector
+ * @param options How the scores are combined
+ * @param num_results The number of results
+ * @return the best documents by fused score, best first
+ */
+results_type reference_fusion(index::inverted_index& idx,
+                              corpus::document& query,
+                              const index::vector_store& store,
+                              const std::vector<float>& embedding,
+                              const index::hybrid_options& options,
+                              uint64_t num_results)
+{
+    index::okapi_bm25 bm25;
+    auto depth = std::max(options.candidates, num_results);
+    auto matched = [](const std::pair<doc_id, double>& result)
+    {
+        return result.second != std::numeric_limits<double>::lowest();
+    };
+    results_type lexical;
+    for (const auto& result : bm25.score(idx, query, depth))
+        if (matched(result))
+            lexical.push_back(result);
+    auto dense = store.search(embedding, depth);
+
+    std::unordered_map<doc_id, double> fused;
+    if (options.fusion == index::fusion_method::reciprocal_rank)
+    {
+        for (uint64_t i = 0; i < lexical.size(); ++i)
+            fused[lexical[i].first] += 1 / (options.rank_constant + i + 1);
+        for (uint64_t i = 0; i < dense.size(); ++i)
+            fused[dense[i].first] += 1 / (options.rank_constant + i + 1);
+    }
+    else
+    {
+        std::unordered_map<doc_id, double> all_lexical;
+        for (const auto& result : bm25.score(idx, query, idx.num_docs()))
+            if (matched(result))
+                all_lexical[result.first] = result.second;
+        std::unordered_map<doc_id, std::pair<double, double>> scores;
+        for (const auto& result : lexical)
+            scores[result.first];
+        for (const auto& result : dense)
+            scores[result.first];
+        auto lex_low = std::numeric_limits<double>::infinity();
+        auto lex_high = -lex_low;
+        auto dense_low = lex_low;
+        auto dense_high = -lex_low;
+        for (auto& entry : scores)
+        {
+            auto it = all_lexical.find(entry.first);
+            entry.second.first = it == all_lexical.end() ? 0 : it->second;
+            entry.second.second = store.score(embedding.data(), entry.first);
+            lex_low = std::min(lex_low, entry.second.first);
+            lex_high = std::max(lex_high, entry.second.first);
+            dense_low = std::min(dense_low, entry.second.second);
+            dense_high = std::max(dense_high, entry.second.second);
+        }
+        for (const auto& entry : scores)
+        {
+            auto lex = (entry.second.first - lex_low) / (lex_high - lex_low);
+            auto vec = (entry.second.second - dense_low)
+                       / (dense_high - dense_low);
+            fused[entry.first] = (1 - options.dense_weight) * lex
+                                 + options.dense_weight * vec;
+        }
+    }
+
+    results_type results{fused.begin(), fused.end()};
+    std::sort(results.begin(), results.end(),
+              [](const std::pair<doc_id, double>& a,
+                 const std::pair<doc_id, double>& b)
+              {
+        if (a.second != b.second)
+            return a.second > b.second;
+        return a.first < b.first;
+    });
+    if (results.size() > num_results)
+        results.resize(num_results);
+    return results;
+}
+
+/**
+ * Checks that both fusion methods order the documents of queries as a
+ * direct computation of their fused scores does.
+ */
+void hybrid_fusion_order()
+{
+    auto idx = index::make_index<index::inverted_index>("test-config.toml");
+    system("rm -rf vectors-test");
+    {
+        std::mt19937 rng{47};
+        index::vector_store_writer writer{"vectors-test", idx->num_docs(), 8,
+                                          index::vector_encoding::float32};
+        for (uint64_t d = 0; d < idx->num_docs(); ++d)
+            writer.insert(doc_id{d}, random_vector(rng, 8));
+    }
+    index::vector_store store{"vectors-test"};
+    index::okapi_bm25 bm25;
+
+    auto config = cpptoml::parse_file("test-config.toml");
+    std::string encoding = "utf-8";
+    if (auto enc = config.get_as<std::string>("encoding"))
+        encoding = *enc;
+
+    std::mt19937 rng{1};
+    for (auto fusion : {index::fusion_method::linear,
+                        index::fusion_method::reciprocal_rank})
+    {
+        index::hybrid_options options;
+        options.fusion = fusion;
+        options.dense_weight = 0.3;
+        options.candidates = 20;
+        index::hybrid_ranker hybrid{bm25, store, nullptr, options};
+        for (uint64_t i = 0; i < idx->num_docs(); i += 50)
+        {
+            corpus::document query{idx->doc_path(doc_id{i}), doc_id{i}};
+            query.encoding(encoding);
+            auto embedding = random_vector(rng, 8);
+            auto results = hybrid.score(*idx, query, embedding, 10);
+            auto expected = reference_fusion(*idx, query, store, embedding,
+                                             options, 10);
+            ASSERT_EQUAL(results.size(), expected.size());
+            for (uint64_t j = 0; j < results.size(); ++j)
+            {
+                ASSERT_APPROX_EQUAL(results[j].second, expected[j].second);
+                if (j + 1 < results.size()
+                    && expected[j].second != expected[j + 1].second
+                    && (j == 0
+                        || expected[j].second != expected[j - 1].second))
+                    ASSERT_EQUAL(results[j].first, expected[j].first);
+            }
+        }
+    }
+}
+/**
+ * A dense-only candidate of a hybrid query, which matches no query term,
+ * must not make the lexical scores of the documents that do match equal,
+ * and the documents a lexical ranker returns only to fill its results
+ * must not become candidates.
+ */
+void hybrid_unmatched_candidates()
+{
+    auto idx = index::make_index<index::inverted_index>("test-config.toml");
+    index::okapi_bm25 bm25;
+
+    // a term only two documents contain, which bm25 scores differently
+    corpus::document query;
+    results_type matches;
+    for (uint64_t t = 0; t < idx->unique_terms() && matches.size() != 2; ++t)
+    {
+        term_id t_id{t};
+        if (idx->doc_freq(t_id) != 2)
+            continue;
+        query = corpus::document{};
+        query.increment(idx->term_text(t_id), 1);
+        matches = bm25.score(*idx, query, 2);
+        if (matches.size() == 2 && matches[0].second == matches[1].second)
+            matches.clear();
+    }
+    ASSERT_EQUAL(matches.size(), 2ul);
+    auto best = matches[0].first;
+    auto second = matches[1].first;
+    uint64_t d = 0;
+    while (doc_id{d} == best || doc_id{d} == second)
+        ++d;
+    doc_id unmatched{d};
+
+    // only the document matching no term is near the query's vector
+    {
+        index::vector_store_writer writer{"vectors-test", idx->num_docs(), 2,
+                                          index::vector_encoding::float32};
+        writer.insert(best, {0, 1});
+        writer.insert(second, {0, 1});
+        writer.insert(unmatched, {1, 0});
+    }
+    index::vector_store store{"vectors-test"};
+    std::vector<float> embedding{1, 0};
+
+    index::hybrid_options options;
+    options.candidates = 5;
+    {
+        index::hybrid_ranker hybrid{bm25, store, nullptr, options};
+        auto results = hybrid.score(*idx, query, embedding, 10);
+        ASSERT_EQUAL(results.size(), 3ul);
+        ASSERT(score_of(results, best) > score_of(results, second));
+        ASSERT_APPROX_EQUAL(score_of(results, best), 0.5);
+        ASSERT_APPROX_EQUAL(score_of(results, unmatched), 0.5);
+    }
+
+    options.fusion = index::fusion_method::reciprocal_rank;
+    {
+        index::hybrid_ranker hybrid{bm25, store, nullptr, options};
+        auto results = hybrid.score(*idx, query, embedding, 10);
+        ASSERT_EQUAL(results.size(), 3ul);
+        ASSERT(score_of(results, best) > score_of(results, second));
+    }
+}
+
+/// A sparse vector, as (index, value) pairs in order of index
+using sparse_type = std::vector<std::pair<uint64_t, double>>;
+
+/**
+ * @param rng A random number generator
+ * @param size The number of pairs
+ * @param dims The number of indices; index zero is never drawn
+ * @return a sparse vector with values in [-1, 1]
+ */
+sparse_type random_sparse(std::mt19937& rng, uint64_t size, uint64_t dims)
+{
+    std::uniform_real_distribution<double> dist{-1, 1};
+    std::map<uint64_t, double> pairs;
+    while (pairs.size() < size)
+        pairs[1 + rng() % (dims - 1)] = dist(rng);
+    return {pairs.begin(), pairs.end()};
+}
+
+/**
+ * @param x A sparse vector
+ * @param dims The number of indices
+ * @return x as a dense vector
+ */
+std::vector<double> to_dense(const sparse_type& x, uint64_t dims)
+{
+    std::vector<double> dense(dims, 0.0);
+    for (const auto& p : x)
+        dense[p.first] = p.second;
+    return dense;
+}
+
+/**
+ * Fails unless a value is within a relative error of a reference one.
+ * @param actual The value
+ * @param expected The reference
+ */
+void check_near(double actual, double expected)
+{
+    ASSERT_LESS(std::abs(actual - expected),
+                1e-9 * std::max(1.0, std::abs(expected)));
+}
+
+void sparse_kernels()
+{
+    // sizes that step through both vectors and that gallop through the
+    // longer one, both as vectors and as ranges without random access
+    const uint64_t dims = 5000;
+    std::mt19937 rng{47};
+    std::vector<uint64_t> sizes{0, 1, 3, 10, 100, 1000, 3000};
+    std::vector<sparse_type> vectors;
+    for (const auto& size : sizes)
+    {
+        vectors.push_back(random_sparse(rng, size, dims));
+        vectors.push_back(random_sparse(rng, size, dims));
+    }
+
+    auto weights = random_vector(rng, dims);
+    std::vector<double> dense_weights{weights.begin(), weights.end()};
+    for (const auto& a : vectors)
+    {
+        auto dense_a = to_dense(a, dims);
+        std::map<uint64_t, double> list_a{a.begin(), a.end()};
+
+        double dot_weights = 0;
+        double squared = 0;
+        for (uint64_t i = 0; i < dims; ++i)
+        {
+            dot_weights += dense_a[i] * dense_weights[i];
+            squared += dense_a[i] * dense_a[i];
+        }
+        check_near(util::sparse::dot_dense(a, dense_weights), dot_weights);
+        check_near(util::sparse::dot_dense(list_a, dense_weights),
+                   dot_weights);
+        check_near(util::sparse::squared_norm(a), squared);
+        check_near(util::sparse::norm(a), std::sqrt(squared));
+
+        auto axpy = dense_weights;
+        util::sparse::axpy(0.5, a, axpy);
+        for (uint64_t i = 0; i < dims; ++i)
+            check_near(axpy[i], dense_weights[i] + 0.5 * dense_a[i]);
+
+        for (const auto& b : vectors)
+        {
+            auto dense_b = to_dense(b, dims);
+            std::map<uint64_t, double> list_b{b.begin(), b.end()};
+            double dot = 0;
+            double distance = 0;
+            for (uint64_t i = 0; i < dims; ++i)
+            {
+                dot += dense_a[i] * dense_b[i];
+                distance += (dense_a[i] - dense_b[i])
+                            * (dense_a[i] - dense_b[i]);
+            }
+            check_near(util::sparse::dot(a, b), dot);
+            check_near(util::sparse::dot(list_a, b), dot);
+            check_near(util::sparse::dot(a, list_b), dot);
+            check_near(util::sparse::squared_distance(a, b), distance);
+            check_near(util::sparse::squared_distance(list_a, b), distance);
+
+            // the sum goes after what is already there, with a pair for
+            // each index of either vector
+            sparse_type merged{{0, 7.0}};
+            util::sparse::merge(a, b, merged);
+            ASSERT_EQUAL(merged.front().first, 0ul);
+            ASSERT_EQUAL(merged.front().second, 7.0);
+            std::set<uint64_t> indices;
+            for (const auto& p : a)
+                indices.insert(p.first);
+            for (const auto& p : b)
+                indices.insert(p.first);
+            ASSERT_EQUAL(merged.size(), indices.size() + 1);
+            for (uint64_t i = 1; i < merged.size(); ++i)
+            {
+                ASSERT_LESS(merged[i - 1].first, merged[i].first);
+                auto idx = merged[i].first;
+                check_near(merged[i].second, dense_a[idx] + dense_b[idx]);
+            }
+        }
+    }
+}
+
+/**
+ * Fails unless a value computed in T is within a bound on its rounding
+ * error of a reference computed in double precision.
+ * @param actual The value
+ * @param expected The reference
+ * @param terms The number of terms summed for the value
+ * @param magnitude The sum of the magnitudes of those terms
+ */
+template <class T>
+void check_rounding(T actual, double expected, uint64_t terms,
+                    double magnitude)
+{
+    auto bound = 4 * std::numeric_limits<T>::epsilon() * (terms + 1)
+                 * magnitude;
+    ASSERT_LESS(std::abs(actual - expected),
+                bound + std::numeric_limits<T>::min());
+}
+
+/**
+ * @param rng A random number generator
+ * @param size The number of elements
+ * @return a vector of elements uniform in [-1, 1]
+ */
+template <class T>
+std::vector<T> random_dense(std::mt19937& rng, uint64_t size)
+{
+    std::uniform_real_distribution<T> dist{-1, 1};
+    std::vector<T> x(size);
+    for (auto& v : x)
+        v = dist(rng);
+    return x;
+}
+
+/**
+ * @param rng A random number generator
+ * @param rows The number of rows
+ * @param columns The number of columns
+ * @return a matrix of elements uniform in [-1, 1]
+ */
+template <class T>
+util::dense_matrix<T> random_matrix(std::mt19937& rng, uint64_t rows,
+                                    uint64_t columns)
+{
+    std::uniform_real_distribution<T> dist{-1, 1};
+    util::dense_matrix<T> m{rows, columns};
+    for (uint64_t r = 0; r < rows; ++r)
+        for (uint64_t c = 0; c < columns; ++c)
+            m(r, c) = dist(rng);
+    return m;
+}
+
+/**
+ * Fails unless every row of a matrix starts on a cache line and the
+ * padding after each row is still zero.
+ * @param m The matrix
+ */
+template <class T>
+void check_rows(const util::dense_matrix<T>& m)
+{
+    const uint64_t per_line = util::cache_line_size / sizeof(T);
+    for (uint64_t r = 0; r < m.rows(); ++r)
+    {
+        auto address = reinterpret_cast<std::uintptr_t>(m.row(r));
+        ASSERT_EQUAL(address % util::cache_line_size, 0ul);
+        auto padded = (m.columns() + per_line - 1) / per_line * per_line;
+        for (uint64_t c = m.columns(); c < padded; ++c)
+            ASSERT_EQUAL(m.row(r)[c], T{0});
+        if (r + 1 < m.rows())
+            ASSERT_EQUAL(m.row(r + 1) - m.row(r),
+                         static_cast<std::ptrdiff_t>(padded));
+    }
+}
+
+template <class T>
+void dense_kernels()
+{
+    // lengths on both sides of the four partial sums of the reductions
+    std::mt19937 rng{47};
+    for (uint64_t size : {0, 1, 3, 4, 5, 7, 63, 64, 65, 130, 1000})
+    {
+        auto a = random_dense<T>(rng, size);
+        auto b = random_dense<T>(rng, size);
+        const T alpha = T(0.75);
+
+        std::vector<T> out(size);
+        util::dense::exp(a.data(), out.data(), size);
+        for (uint64_t i = 0; i < size; ++i)
+        {
+            auto expected = std::exp(static_cast<double>(a[i]));
+            check_rounding(out[i], expected, 0, expected);
+        }
+        util::dense::exp(out.data(), out.data(), size);
+        for (uint64_t i = 0; i < size; ++i)
+        {
+            auto expected = std::exp(std::exp(static_cast<double>(a[i])));
+            check_rounding(out[i], expected, 2, expected);
+        }
+
+        out = a;
+        util::dense::scale(alpha, out.data(), size);
+        for (uint64_t i = 0; i < size; ++i)
+            check_rounding(out[i], double{alpha} * a[i], 0,
+                           std::abs(double{alpha} * a[i]));
+
+        util::dense::multiply(a.data(), b.data(), out.data(), size);
+        for (uint64_t i = 0; i < size; ++i)
+            check_rounding(out[i], double{a[i]} * b[i], 0,
+                           std::abs(double{a[i]} * b[i]));
+        out = a;
+        util::dense::multiply(out.data(), b.data(), out.data(), size);
+        for (uint64_t i = 0; i < size; ++i)
+            check_rounding(out[i], double{a[i]} * b[i], 0,
+                           std::abs(double{a[i]} * b[i]));
+
+        out = b;
+        util::dense::axpy(alpha, a.data(), out.data(), size);
+        for (uint64_t i = 0; i < size; ++i)
+        {
+            auto product = double{alpha} * a[i];
+            check_rounding(out[i], b[i] + product, 1,
+                           std::abs(b[i]) + std::abs(product));
+        }
+
+        double dot = 0;
+        double dot_magnitude = 0;
+        double sum = 0;
+        double sum_magnitude = 0;
+        for (uint64_t i = 0; i < size; ++i)
+        {
+            dot += double{a[i]} * b[i];
+            dot_magnitude += std::abs(double{a[i]} * b[i]);
+            sum += a[i];
+            sum_magnitude += std::abs(a[i]);
+        }
+        check_rounding(util::dense::dot(a.data(), b.data(), size), dot, size,
+                       dot_magnitude);
+        check_rounding(util::dense::sum(a.data(), size), sum, size,
+                       sum_magnitude);
+
+        // positive elements, so that the sum is far from zero
+        out = a;
+        for (auto& v : out)
+            v = std::abs(v) + T(0.5);
+        auto total = util::dense::sum(out.data(), size);
+        auto factor = util::dense::normalize(out.data(), size);
+        if (size == 0)
+            ASSERT_EQUAL(factor, T{1});
+        else
+            check_rounding(factor, 1 / double{total}, 0, 1 / double{total});
+        check_rounding(util::dense::sum(out.data(), size),
+                       size == 0 ? 0.0 : 1.0, 2 * size, 1.0);
+    }
+
+    // a vector of zeros is left as it is
+    std::vector<T> zeros(10, T{0});
+    ASSERT_EQUAL(util::dense::normalize(zeros.data(), zeros.size()), T{1});
+    for (const auto& v : zeros)
+        ASSERT_EQUAL(v, T{0});
+
+    // shapes on both sides of a block of matrix_matrix, with one product
+    // matrix reused across them all
+    std::vector<std::vector<uint64_t>> shapes{{1, 1, 1},    {3, 65, 2},
+                                              {70, 64, 129}, {5, 130, 67},
+                                              {0, 3, 4},     {17, 1, 200},
+                                              {2, 200, 1}};
+    util::dense_matrix<T> c;
+    for (const auto& shape : shapes)
+    {
+        auto a = random_matrix<T>(rng, shape[0], shape[1]);
+        auto b = random_matrix<T>(rng, shape[1], shape[2]);
+        check_rows(a);
+        check_rows(b);
+
+        auto x = random_dense<T>(rng, shape[1]);
+        std::vector<T> y(shape[0]);
+        util::dense::matrix_vector(a, x.data(), y.data());
+        for (uint64_t r = 0; r < shape[0]; ++r)
+        {
+            double expected = 0;
+            double magnitude = 0;
+            for (uint64_t k = 0; k < shape[1]; ++k)
+            {
+                expected += double{a(r, k)} * x[k];
+                magnitude += std::abs(double{a(r, k)} * x[k]);
+            }
+            check_rounding(y[r], expected, shape[1], magnitude);
+        }
+
+        auto z = random_dense<T>(rng, shape[0]);
+        // filled with garbage, which must be overwritten
+        std::vector<T> w(shape[1], T(3));
+        util::dense::vector_matrix(z.data(), a, w.data());
+        for (uint64_t k = 0; k < shape[1]; ++k)
+        {
+            double expected = 0;
+            double magnitude = 0;
+            for (uint64_t r = 0; r < shape[0]; ++r)
+            {
+                expected += double{z[r]} * a(r, k);
+                magnitude += std::abs(double{z[r]} * a(r, k));
+            }
+            check_rounding(w[k], expected, shape[0], magnitude);
+        }
+
+        util::dense::matrix_matrix(a, b, c);
+        ASSERT_EQUAL(c.rows(), shape[0]);
+        ASSERT_EQUAL(c.columns(), shape[2]);
+        check_rows(c);
+        for (uint64_t i = 0; i < shape[0]; ++i)
+        {
+            for (uint64_t j = 0; j < shape[2]; ++j)
+            {
+                double expected = 0;
+                double magnitude = 0;
+                for (uint64_t k = 0; k < shape[1]; ++k)
+                {
+                    expected += double{a(i, k)} * b(k, j);
+                    magnitude += std::abs(double{a(i, k)} * b(k, j));
+                }
+                check_rounding(c(i, j), expected, shape[1], magnitude);
+            }
+        }
+    }
+}
+}
+
+int vector_tests()
+{
+    create_config("file");
+    system("rm -rf ceeaus-inv vectors-test");
+
+    int failed = 0;
+    failed += testing::run_test("vector-store-float32", float32_round_trip);
+    failed += testing::run_test("vector-store-int8", int8_round_trip);
+    failed += testing::run_test("vector-store-dot-int8", dot_int8);
+    failed += testing::run_test("vector-store-parallel-search",
+                                parallel_search);
+    failed += testing::run_test("ivf-index-recall", ivf_recall);
+    failed += testing::run_test("hybrid-fusion-order", hybrid_fusion_order);
+    failed += testing::run_test("hybrid-unmatched-candidates",
+                                hybrid_unmatched_candidates);
+    failed += testing::run_test("sparse-kernels", sparse_kernels);
+    failed += testing::run_test("dense-kernels-float", dense_kernels<float>);
+    failed += testing::run_test("dense-kernels-double",
+                                dense_kernels<double>);
+
+    system("rm -rf ceeaus-inv vectors-test test-config.toml");
+    return failed;
+}
+}
+}
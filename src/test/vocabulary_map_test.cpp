@@ -1,5 +1,5 @@
 /**
- * @file vocabulary_map_writer.cpp
+ * @file vocabulary_map_test.cpp
  * @author Chase Geigle
  */
 
@@ -11,18 +11,17 @@ namespace meta
 namespace testing
 {
 
-void write_file(uint16_t size)
+void write_file(uint64_t block_terms)
 {
-    index::vocabulary_map_writer writer{"meta-tmp-test.bin", size};
+    index::vocabulary_map_writer writer{"meta-tmp-test.bin", block_terms};
     auto str = std::string{"abcdefghijklmn"};
     for (const auto& c : str)
         writer.insert(std::string(1, c));
 }
 
-void assert_correctness(uint16_t size)
+void read_file()
 {
     std::vector<std::pair<std::string, uint64_t>> expected = {
-        // first level
         {"a", 0},
         {"b", 1},
         {"c", 2},
@@ -38,119 +37,231 @@ void assert_correctness(uint16_t size)
         {"m", 12},
         {"n", 13}};
 
-    // second level
-    expected.push_back({"a", size * 0});
-    expected.push_back({"c", size * 1});
-    expected.push_back({"e", size * 2});
-    expected.push_back({"g", size * 3});
-    expected.push_back({"i", size * 4});
-    expected.push_back({"k", size * 5});
-    expected.push_back({"m", size * 6});
-
-    // third level
-    expected.push_back({"a", size * 7});
-    expected.push_back({"e", size * 8});
-    expected.push_back({"i", size * 9});
-    expected.push_back({"m", size * 10});
-
-    // root
-    expected.push_back({"a", size * 11});
-    expected.push_back({"i", size * 12});
-
     {
-        std::ifstream file{"meta-tmp-test.bin", std::ios::binary};
-        util::disk_vector<uint64_t> inverse{"meta-tmp-test.bin.inverse", 14};
-        size_t idx = 0;
-        while (file)
+        index::vocabulary_map map{"meta-tmp-test.bin"};
+        for (const auto& p : expected)
         {
-            // skip over padding
-            if (file.tellg() % size != 0 && file.peek() == '\0')
-                file.seekg(size - (file.tellg() % size), file.cur);
-
-            // checks that the inverse map contains the correct position of
-            // the terms in the lowest level
-            if (idx < 14)
-                ASSERT_EQUAL(inverse[idx], static_cast<uint64_t>(file.tellg()));
-
-            std::string term;
-            uint64_t num;
-            io::read_binary(file, term);
-            if (!file)
-                break;
-            io::read_binary(file, num);
-            if (!file)
-                break;
-            ASSERT_EQUAL(term, expected[idx].first);
-            ASSERT_EQUAL(num, expected[idx].second);
-            ++idx;
+            auto elem = map.find(p.first);
+            ASSERT(elem);
+            ASSERT_EQUAL(*elem, p.second);
+
+            ASSERT_EQUAL(map.find_term(term_id{p.second}), p.first);
         }
-        ASSERT(!file);
-        ASSERT_EQUAL(idx, expected.size());
+        ASSERT(!map.find("0"));
+        ASSERT(!map.find("zabawe"));
+        ASSERT_EQUAL(map.size(), 14ul);
     }
+    delete_files();
+}
 
-    filesystem::delete_file("meta-tmp-test.bin");
-    filesystem::delete_file("meta-tmp-test.bin.inverse");
+void check_lookups(uint64_t block_terms)
+{
+    std::vector<std::string> terms = {
+        "car",  "card",  "care", "cared", "careful", "cart",  "cat",
+        "cats", "dog",   "dot",  "dote",  "zebra",   "zebu"};
+    {
+        index::vocabulary_map_writer writer{"meta-tmp-test.bin", block_terms};
+        for (const auto& term : terms)
+            writer.insert(term);
+    }
+
+    {
+        index::vocabulary_map map{"meta-tmp-test.bin"};
+        ASSERT_EQUAL(map.size(), terms.size());
+        for (uint64_t i = 0; i < terms.size(); ++i)
+        {
+            ASSERT_EQUAL(map.find_term(term_id{i}), terms[i]);
+            ASSERT_EQUAL(*map.find(terms[i]), term_id{i});
+        }
+        ASSERT(!map.find("ca"));
+        ASSERT(!map.find("carefully"));
+
+        auto all = map.find_all({"zebu", "ca", "cart", "car", "zz", "cart"});
+        ASSERT_EQUAL(all.size(), 6ul);
+        ASSERT_EQUAL(*all[0], term_id{12});
+        ASSERT(!all[1]);
+        ASSERT_EQUAL(*all[2], term_id{5});
+        ASSERT_EQUAL(*all[3], term_id{0});
+        ASSERT(!all[4]);
+        ASSERT_EQUAL(*all[5], term_id{5});
+        auto every = map.find_all(terms);
+        for (uint64_t i = 0; i < terms.size(); ++i)
+            ASSERT_EQUAL(*every[i], term_id{i});
+
+        ASSERT_EQUAL(map.lower_bound("a"), term_id{0});
+        ASSERT_EQUAL(map.lower_bound("care"), term_id{2});
+        ASSERT_EQUAL(map.lower_bound("caref"), term_id{4});
+        ASSERT_EQUAL(map.lower_bound("zz"), term_id{13});
+
+        auto car = map.prefix_range("car");
+        ASSERT_EQUAL(car.first, term_id{0});
+        ASSERT_EQUAL(car.second, term_id{6});
+        auto d = map.prefix_range("d");
+        ASSERT_EQUAL(d.first, term_id{8});
+        ASSERT_EQUAL(d.second, term_id{11});
+        auto none = map.prefix_range("e");
+        ASSERT_EQUAL(none.first, none.second);
+
+        auto range = map.range("cat", "dot");
+        ASSERT_EQUAL(range.first, term_id{6});
+        ASSERT_EQUAL(range.second, term_id{9});
+
+        std::vector<std::string> seen;
+        map.for_each(term_id{3}, term_id{9},
+                     [&](term_id id, const std::string& term)
+                     {
+            ASSERT_EQUAL(term, terms[id]);
+            seen.push_back(term);
+        });
+        ASSERT_EQUAL(seen.size(), 6ul);
+
+        auto wild = map.wildcard("ca*e");
+        ASSERT_EQUAL(wild.size(), 1ul);
+        ASSERT_EQUAL(wild[0], term_id{2});
+        wild = map.wildcard("*t");
+        ASSERT_EQUAL(wild.size(), 3ul);
+        wild = map.wildcard("do?");
+        ASSERT_EQUAL(wild.size(), 2ul);
+        wild = map.wildcard("zebu");
+        ASSERT_EQUAL(wild.size(), 1ul);
+        ASSERT(map.wildcard("q*").empty());
+
+        auto fuzzy = map.fuzzy("cart", 0);
+        ASSERT_EQUAL(fuzzy.size(), 1ul);
+        ASSERT_EQUAL(fuzzy[0], term_id{5});
+        fuzzy = map.fuzzy("cart", 1);
+        // car, card, care, cart, and cat, but not cats
+        ASSERT_EQUAL(fuzzy.size(), 5ul);
+        fuzzy = map.fuzzy("zebr", 1);
+        ASSERT_EQUAL(fuzzy.size(), 2ul);
+    }
+    delete_files();
 }
 
-void read_file(uint16_t size)
+void check_async_writer(uint64_t block_terms)
 {
-    std::vector<std::pair<std::string, uint64_t>> expected = {
-        // first level
-        {"a", 0},
-        {"b", 1},
-        {"c", 2},
-        {"d", 3},
-        {"e", 4},
-        {"f", 5},
-        {"g", 6},
-        {"h", 7},
-        {"i", 8},
-        {"j", 9},
-        {"k", 10},
-        {"l", 11},
-        {"m", 12},
-        {"n", 13}};
+    // enough terms for several batches, sharing prefixes of every length
+    std::vector<std::string> terms;
+    for (uint64_t i = 0; i < 10000; ++i)
+    {
+        auto num = std::to_string(i);
+        terms.push_back("term" + std::string(5 - num.size(), '0') + num);
+    }
 
-    index::vocabulary_map map{"meta-tmp-test.bin", size};
-    for (const auto& p : expected)
     {
-        auto elem = map.find(p.first);
-        ASSERT(elem);
-        ASSERT_EQUAL(*elem, p.second);
+        index::vocabulary_map_writer writer{"meta-tmp-sync.bin", block_terms};
+        for (const auto& term : terms)
+            writer.insert(term);
+    }
+    {
+        index::async_vocabulary_writer writer{"meta-tmp-test.bin",
+                                              block_terms};
+        for (const auto& term : terms)
+            writer.insert(term);
+        ASSERT_EQUAL(writer.finish(), terms.size());
+    }
 
-        ASSERT_EQUAL(map.find_term(term_id{p.second}), p.first);
+    ASSERT(filesystem::file_text("meta-tmp-test.bin")
+           == filesystem::file_text("meta-tmp-sync.bin"));
+    ASSERT(filesystem::file_text("meta-tmp-test.bin.inverse")
+           == filesystem::file_text("meta-tmp-sync.bin.inverse"));
+    {
+        index::vocabulary_map map{"meta-tmp-test.bin"};
+        ASSERT_EQUAL(map.size(), terms.size());
+        for (uint64_t i = 0; i < terms.size(); i += 97)
+        {
+            auto elem = map.find(terms[i]);
+            ASSERT(elem);
+            ASSERT_EQUAL(*elem, i);
+        }
     }
-    ASSERT(!map.find("0"));
-    ASSERT(!map.find("zabawe"));
-    ASSERT_EQUAL(map.size(), 14ul);
+    filesystem::delete_file("meta-tmp-sync.bin");
+    filesystem::delete_file("meta-tmp-sync.bin.inverse");
+    delete_files();
+}
+
+void delete_files()
+{
+    filesystem::delete_file("meta-tmp-test.bin");
+    filesystem::delete_file("meta-tmp-test.bin.inverse");
 }
 
 int vocabulary_map_tests()
 {
     int num_failed = 0;
 
-    num_failed += testing::run_test("vocabulary_writer_full_block", [&]()
+    num_failed += testing::run_test("vocabulary_map_full_block", [&]()
     {
-        write_file();
-        assert_correctness();
+        write_file(16);
+        read_file();
     });
 
-    num_failed += testing::run_test("vocabulary_writer_partial_blocks", [&]()
+    num_failed += testing::run_test("vocabulary_map_partial_blocks", [&]()
     {
-        write_file(23);
-        assert_correctness(23);
+        write_file(4);
+        read_file();
     });
 
-    num_failed += testing::run_test("vocabulary_map_full_block", [&]()
+    num_failed += testing::run_test("vocabulary_map_single_term_blocks", [&]()
     {
-        write_file();
+        write_file(1);
         read_file();
     });
 
-    num_failed += testing::run_test("vocabulary_map_partial_blocks", [&]()
+    num_failed += testing::run_test("vocabulary_map_lookups", [&]()
     {
-        write_file(23);
-        read_file(23);
+        check_lookups(1);
+        check_lookups(3);
+        check_lookups(16);
+    });
+
+    num_failed += testing::run_test("vocabulary_writer_out_of_order", [&]()
+    {
+        bool thrown = false;
+        try
+        {
+            index::vocabulary_map_writer writer{"meta-tmp-test.bin"};
+            writer.insert("b");
+            writer.insert("a");
+        }
+        catch (index::vocabulary_map_writer::vocabulary_map_writer_exception&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+        delete_files();
+    });
+
+    num_failed += testing::run_test("vocabulary_async_writer", [&]()
+    {
+        check_async_writer(1);
+        check_async_writer(16);
+
+        // an empty map, and an error on the writing thread, are seen by
+        // finish()
+        {
+            index::async_vocabulary_writer writer{"meta-tmp-test.bin"};
+            ASSERT_EQUAL(writer.finish(), 0ul);
+        }
+        {
+            index::vocabulary_map map{"meta-tmp-test.bin"};
+            ASSERT_EQUAL(map.size(), 0ul);
+        }
+
+        bool thrown = false;
+        try
+        {
+            index::async_vocabulary_writer writer{"meta-tmp-test.bin"};
+            writer.insert("b");
+            writer.insert("a");
+            writer.finish();
+        }
+        catch (index::vocabulary_map_writer::vocabulary_map_writer_exception&)
+        {
+            thrown = true;
+        }
+        ASSERT(thrown);
+        delete_files();
     });
 
     return num_failed;
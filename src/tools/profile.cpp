@@ -3,7 +3,9 @@
  * @author Sean Massung
  */
 
+#include <fstream>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <unordered_set>
 #include <string>
@@ -19,6 +21,10 @@
 #include "sequence/perceptron.h"
 #include "sequence/io/ptb_parser.h"
 #include "sequence/sequence.h"
+#include "parallel/default_pool.h"
+#if META_HAS_ZLIB
+#include "io/bgzf.h"
+#endif
 
 using namespace meta;
 
@@ -44,6 +50,9 @@ int print_usage(const std::string& prog)
     std::cerr << "\t--freq-bigram\tsort and count bigram words" << std::endl;
     std::cerr << "\t--freq-trigram\tsort and count trigram words" << std::endl;
     std::cerr << "\t--all\trun all options" << std::endl;
+#if META_HAS_ZLIB
+    std::cerr << "\t--gzip\tcompress output files on every core" << std::endl;
+#endif
     std::cerr << std::endl;
     return 1;
 }
@@ -58,6 +67,34 @@ std::string no_ext(const std::string& file)
     return file.substr(0, idx);
 }
 
+/// Whether output files are compressed, as given by --gzip
+bool gzip_output = false;
+
+/**
+ * @param name The name of an output file
+ * @return the name the file is written to, which ends in ".gz" if output
+ * files are compressed
+ */
+std::string output_name(const std::string& name)
+{
+    return gzip_output ? name + ".gz" : name;
+}
+
+/**
+ * Opens an output file. Compressed files are written in BGZF, deflated on
+ * every core, and can be read by zcat or gz_corpus.
+ * @param name The name of the file
+ * @return the stream to write the file with
+ */
+std::unique_ptr<std::ostream> open_output(const std::string& name)
+{
+#if META_HAS_ZLIB
+    if (gzip_output)
+        return make_unique<io::bgzf_ofstream>(name);
+#endif
+    return make_unique<std::ofstream>(name);
+}
+
 /**
  * @param stream Token stream to read from
  * @param in_name Input filename
@@ -67,7 +104,8 @@ template <class Stream>
 void write_file(Stream& stream, const std::string& in_name,
                 const std::string& out_name)
 {
-    std::ofstream outfile{out_name};
+    auto out = open_output(out_name);
+    auto& outfile = *out;
     stream->set_content(filesystem::file_text(in_name));
     while (*stream)
     {
@@ -97,7 +135,7 @@ void stem(const std::string& file, const cpptoml::table&)
     stream = make_unique<filters::porter2_stemmer>(std::move(stream));
     stream = make_unique<filters::empty_sentence_filter>(std::move(stream));
 
-    auto out_name = no_ext(file) + ".stems.txt";
+    auto out_name = output_name(no_ext(file) + ".stems.txt");
     write_file(stream, file, out_name);
     std::cout << " -> file saved as " << out_name << std::endl;
 }
@@ -119,11 +157,41 @@ void stop(const std::string& file, const cpptoml::table& config)
     stream = make_unique<filters::list_filter>(std::move(stream), *stopwords);
     stream = make_unique<filters::empty_sentence_filter>(std::move(stream));
 
-    auto out_name = no_ext(file) + ".stops.txt";
+    auto out_name = output_name(no_ext(file) + ".stops.txt");
     write_file(stream, file, out_name);
     std::cout << " -> file saved as " << out_name << std::endl;
 }
 
+/**
+ * Reads every sentence of a token stream that marks sentence boundaries
+ * with <s> and </s>, so that the sentences can be tagged as a batch.
+ * @param stream The token stream
+ * @return the sentences
+ */
+std::vector<sequence::sequence> sentences(analyzers::token_stream& stream)
+{
+    std::vector<sequence::sequence> seqs;
+    sequence::sequence seq;
+    while (stream)
+    {
+        auto token = stream.next();
+        if (token == "<s>")
+        {
+            seq = {};
+        }
+        else if (token == "</s>")
+        {
+            seqs.push_back(std::move(seq));
+            seq = {};
+        }
+        else
+        {
+            seq.add_symbol(sequence::symbol_t{token});
+        }
+    }
+    return seqs;
+}
+
 /**
  * Performs part-of-speech tagging on a text file.
  * @param file The input file
@@ -161,33 +229,22 @@ void pos(const std::string& file, const cpptoml::table& config, bool replace)
 
     // tag each sentence in the file
     // and write its output to the output file
-    auto out_name = no_ext(file)
-                    + (replace ? ".pos-replace.txt" : ".pos-tagged.txt");
-    std::ofstream outfile{out_name};
-    sequence::sequence seq;
-    while (*stream)
+    auto out_name = output_name(
+        no_ext(file) + (replace ? ".pos-replace.txt" : ".pos-tagged.txt"));
+    auto out = open_output(out_name);
+    auto& outfile = *out;
+    auto seqs = sentences(*stream);
+    tagger.tag(seqs);
+    for (const auto& seq : seqs)
     {
-        auto token = stream->next();
-        if (token == "<s>")
+        for (const auto& obs : seq)
         {
-            seq = {};
-        }
-        else if (token == "</s>")
-        {
-            tagger.tag(seq);
-            for (const auto& obs : seq)
-            {
-                if (replace)
-                    outfile << obs.tag() << " ";
-                else
-                    outfile << obs.symbol() << "_" << obs.tag() << " ";
-            }
-            outfile << std::endl;
-        }
-        else
-        {
-            seq.add_symbol(sequence::symbol_t{token});
+            if (replace)
+                outfile << obs.tag() << " ";
+            else
+                outfile << obs.symbol() << "_" << obs.tag() << " ";
         }
+        outfile << std::endl;
     }
 
     std::cout << " -> file saved as " << out_name << std::endl;
@@ -235,6 +292,9 @@ void parse(const std::string& file, const cpptoml::table& config)
     std::cout << "Loading parser model" << std::endl;
     // load parser model
     parser::sr_parser parser{*parser_prefix};
+    auto dense = parser_grp->get_as<bool>("dense");
+    if (dense && *dense)
+        parser.densify();
 
     // construct the token filter chain
     std::unique_ptr<analyzers::token_stream> stream
@@ -245,26 +305,13 @@ void parse(const std::string& file, const cpptoml::table& config)
 
     // parse each sentence in the file
     // and write its output to the output file
-    auto out_name = no_ext(file) + ".parsed.txt";
-    std::ofstream outfile{out_name};
-    sequence::sequence seq;
-    while (*stream)
-    {
-        auto token = stream->next();
-        if (token == "<s>")
-        {
-            seq = {};
-        }
-        else if (token == "</s>")
-        {
-            tagger.tag(seq);
-            parser.parse(seq).pretty_print(outfile);
-        }
-        else
-        {
-            seq.add_symbol(sequence::symbol_t{token});
-        }
-    }
+    auto out_name = output_name(no_ext(file) + ".parsed.txt");
+    auto out = open_output(out_name);
+    auto& outfile = *out;
+    auto seqs = sentences(*stream);
+    tagger.tag(seqs);
+    for (const auto& tree : parser.parse(seqs))
+        tree.pretty_print(outfile);
 
     std::cout << " -> file saved as " << out_name << std::endl;
 }
@@ -294,8 +341,10 @@ void freq(const std::string& file, const cpptoml::table&, uint16_t n)
         return a.second > b.second;
     });
 
-    auto out_name = no_ext(file) + ".freq." + std::to_string(n) + ".txt";
-    std::ofstream outfile{out_name};
+    auto out_name = output_name(no_ext(file) + ".freq." + std::to_string(n)
+                                + ".txt");
+    auto out = open_output(out_name);
+    auto& outfile = *out;
     for (auto& token : sorted)
         outfile << token.first << " " << token.second << std::endl;
 
@@ -308,9 +357,11 @@ int main(int argc, char* argv[])
         return print_usage(argv[0]);
 
     auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
     std::string file = argv[2];
     std::unordered_set<std::string> args{argv + 3, argv + argc};
     bool all = args.find("--all") != args.end();
+    gzip_output = args.find("--gzip") != args.end();
 
     if (all || args.find("--stem") != args.end())
         stem(file, config);
@@ -0,0 +1,393 @@
+/** @file distributed_lda_gibbs.cpp */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include "index/postings_data.h"
+#include "io/binary.h"
+#include "logging/logger.h"
+#include "topics/distributed_lda_gibbs.h"
+#include "util/filesystem.h"
+#include "util/metrics.h"
+#include "util/progress.h"
+
+namespace meta
+{
+namespace topics
+{
+
+namespace
+{
+/**
+ * @param num_docs The number of documents
+ * @param shard A shard, or num_shards
+ * @param num_shards The number of shards
+ * @return the first document of the shard
+ */
+doc_id shard_begin(uint64_t num_docs, uint64_t shard, uint64_t num_shards)
+{
+    if (num_shards == 0)
+        return doc_id{0};
+    auto block_size = (num_docs + num_shards - 1) / num_shards;
+    return doc_id{std::min(shard * block_size, num_docs)};
+}
+
+/**
+ * @param idx The index holding the documents
+ * @param first The first document of a shard
+ * @param last Just past the last document of the shard
+ * @return the number of words in each document of the shard
+ */
+std::vector<uint64_t> doc_lengths(const index::forward_index& idx,
+                                  doc_id first, doc_id last)
+{
+    std::vector<uint64_t> lengths;
+    lengths.reserve(last - first);
+    for (auto d = first; d < last; ++d)
+        lengths.push_back(idx.doc_size(d));
+    return lengths;
+}
+}
+
+distributed_lda_gibbs::distributed_lda_gibbs(
+    std::shared_ptr<index::forward_index> idx, uint64_t num_topics,
+    double alpha, double beta, uint64_t shard, uint64_t num_shards,
+    const std::string& sync_dir, const std::string& run_id,
+    uint64_t staleness)
+    : lda_model{idx, num_topics,
+                shard_begin(idx->num_docs(), shard, num_shards),
+                shard_begin(idx->num_docs(), shard + 1, num_shards)},
+      alpha_{alpha},
+      beta_{beta},
+      count_log_gammas_{beta_},
+      shard_{shard},
+      num_shards_{num_shards},
+      sync_dir_{sync_dir + "/" + run_id},
+      staleness_{staleness},
+      doc_word_topic_{doc_lengths(*idx_, first_doc_, last_doc_), num_topics_},
+      term_topics_{num_words_, num_topics_},
+      doc_topics_{doc_lengths(*idx_, first_doc_, last_doc_), num_topics_},
+      topic_totals_(num_topics_, 0),
+      deltas_(num_words_ * num_topics_, 0),
+      next_iters_(num_shards_, 0),
+      weights_(num_topics_)
+{
+    if (shard_ >= num_shards_)
+        throw distributed_lda_exception{"shard " + std::to_string(shard_)
+                                        + " is not less than the number of "
+                                          "shards"};
+
+    if (run_id.empty())
+        throw distributed_lda_exception{"a distributed run needs a run id"};
+
+    // a worker of this shard has already published here if an earlier run
+    // used the same id, and the other workers would read its changes as
+    // this run's
+    if (filesystem::file_exists(delta_file(shard_, 0))
+        || filesystem::file_exists(theta_file(shard_)))
+        throw distributed_lda_exception{
+            "run " + run_id + " already has files for shard "
+            + std::to_string(shard_) + " in " + sync_dir
+            + "; every run needs its own run id"};
+
+    filesystem::make_directory(sync_dir);
+    filesystem::make_directory(sync_dir_);
+
+    std::random_device dev;
+    rng_.seed(dev());
+}
+
+util::memory_report distributed_lda_gibbs::memory_usage() const
+{
+    auto report = lda_model::memory_usage();
+    report.add("assignments", doc_word_topic_.memory_usage());
+    report.add("term-topics", term_topics_.memory_usage());
+    report.add("term-topics", util::heap_memory(topic_totals_));
+    report.add("term-topics", util::heap_memory(deltas_));
+    report.add("doc-topics", doc_topics_.memory_usage());
+
+    auto scratch = util::heap_memory(weights_);
+    scratch += util::heap_memory(next_iters_);
+    report.add("scratch", scratch);
+    return report;
+}
+
+void distributed_lda_gibbs::run(uint64_t num_iters, double convergence)
+{
+    perform_iteration(0, true);
+    publish(0);
+    if (staleness_ == 0)
+        synchronize(0);
+    double likelihood = corpus_log_likelihood();
+    std::stringstream ss;
+    ss << "Initialization log likelihood (log P(W|Z)): " << likelihood;
+    std::string spacing(std::max<int>(0, 80 - ss.tellp()), ' ');
+    ss << spacing;
+    LOG(progress) << '\r' << ss.str() << '\n' << ENDLG;
+
+    uint64_t iter = 0;
+    while (iter < num_iters)
+    {
+        ++iter;
+        {
+            metrics::scoped_timer timer{"lda_iteration_ns"};
+            perform_iteration(iter, false);
+        }
+        publish(iter);
+        if (iter >= staleness_)
+            synchronize(iter - staleness_);
+        // the likelihood is a pass over all of the counts, so it is only
+        // evaluated every eval_interval_ iterations
+        if (iter % eval_interval_ != 0 && iter != num_iters)
+            continue;
+        double likelihood_update = corpus_log_likelihood();
+        double ratio = std::fabs((likelihood - likelihood_update) / likelihood);
+        likelihood = likelihood_update;
+        std::stringstream ss;
+        ss << "Iteration " << iter << " log likelihood (log P(W|Z)): "
+           << likelihood;
+        std::string spacing(std::max<int>(0, 80 - ss.tellp()), ' ');
+        ss << spacing;
+        LOG(progress) << '\r' << ss.str() << '\n' << ENDLG;
+        if (staleness_ == 0 && ratio <= convergence)
+        {
+            LOG(progress) << "Found convergence after " << iter
+                          << " iterations!\n" << ENDLG;
+            break;
+        }
+    }
+
+    // the stale changes of the other workers are added in at the end, so
+    // that every worker has the same counts to save
+    synchronize(iter);
+    LOG(info) << "Finished maximum iterations, or found convergence!" << ENDLG;
+}
+
+void distributed_lda_gibbs::perform_iteration(uint64_t iter, bool init)
+{
+    std::string str;
+    if (init)
+        str = "Initialization: ";
+    else
+        str = "Iteration " + std::to_string(iter) + ": ";
+    printing::progress progress{str, doc_terms_.rows()};
+    progress.print_endline(false);
+    for (uint64_t row = 0; row < doc_terms_.rows(); ++row)
+    {
+        progress(row);
+        uint64_t n = 0; // term number within document---constructed
+                        // so that each occurrence of the same term
+                        // can still be assigned a different topic
+        for (const auto& freq : doc_terms_[row])
+        {
+            auto counts = term_topics_.dense_row(freq.first);
+            auto deltas = &deltas_[freq.first * num_topics_];
+            for (uint64_t j = 0; j < freq.second; ++j)
+            {
+                // don't include current topic assignment in
+                // probability calculation
+                if (!init)
+                {
+                    auto old_topic = doc_word_topic_(row, n);
+                    --counts[old_topic];
+                    --deltas[old_topic];
+                    --topic_totals_[old_topic];
+                    doc_topics_.decrement(row, old_topic);
+                }
+
+                // sample a new topic assignment
+                auto topic = sample_topic(freq.first, row);
+                doc_word_topic_.assign(row, n, topic);
+
+                // increase counts
+                ++counts[topic];
+                ++deltas[topic];
+                ++topic_totals_[topic];
+                doc_topics_.increment(row, topic);
+                n += 1;
+            }
+        }
+    }
+}
+
+topic_id distributed_lda_gibbs::sample_topic(term_id term, uint64_t row)
+{
+    auto counts = term_topics_.dense_row(term);
+    double vbeta = num_words_ * beta_;
+    double total = 0;
+    for (topic_id topic{0}; topic < num_topics_; ++topic)
+    {
+        total += (counts[topic] + beta_) / (topic_totals_[topic] + vbeta)
+                 * (doc_topics_(row, topic) + alpha_);
+        weights_[topic] = total;
+    }
+
+    std::uniform_real_distribution<double> dist{0, total};
+    auto it = std::upper_bound(weights_.begin(), weights_.end(), dist(rng_));
+    return topic_id{
+        std::min<uint64_t>(it - weights_.begin(), num_topics_ - 1)};
+}
+
+void distributed_lda_gibbs::publish(uint64_t iter)
+{
+    // the changes are written under a temporary name, so that the other
+    // workers only ever see complete files
+    auto filename = delta_file(shard_, iter);
+    {
+        std::ofstream out{filename + ".tmp", std::ios::binary};
+        uint64_t size = 0;
+        for (const auto& delta : deltas_)
+            size += delta != 0;
+        io::write_binary(out, size);
+        for (uint64_t i = 0; i < deltas_.size(); ++i)
+        {
+            if (deltas_[i] == 0)
+                continue;
+            io::write_binary(out, i);
+            io::write_binary(out, deltas_[i]);
+            deltas_[i] = 0;
+        }
+        if (!out)
+            throw distributed_lda_exception{"failed to write " + filename};
+    }
+    filesystem::rename_file(filename + ".tmp", filename);
+
+    // a worker publishing iteration t has the changes of everyone else
+    // through t - 1 - s, which they published after adding in its own
+    // through t - 2 - 2s, so no one will read those again
+    auto lag = 2 + 2 * staleness_;
+    if (iter >= lag)
+        filesystem::delete_file(delta_file(shard_, iter - lag));
+}
+
+void distributed_lda_gibbs::synchronize(uint64_t iter)
+{
+    for (uint64_t shard = 0; shard < num_shards_; ++shard)
+    {
+        if (shard == shard_)
+            continue;
+        for (; next_iters_[shard] <= iter; ++next_iters_[shard])
+        {
+            auto filename = delta_file(shard, next_iters_[shard]);
+            wait_for(filename);
+            std::ifstream in{filename, std::ios::binary};
+            uint64_t size;
+            io::read_binary(in, size);
+            for (uint64_t j = 0; j < size; ++j)
+            {
+                uint64_t i;
+                int32_t delta;
+                io::read_binary(in, i);
+                io::read_binary(in, delta);
+                term_topics_.dense_row(i / num_topics_)[i % num_topics_]
+                    += delta;
+                topic_totals_[i % num_topics_] += delta;
+            }
+            if (!in)
+                throw distributed_lda_exception{"failed to read " + filename};
+        }
+    }
+}
+
+std::string distributed_lda_gibbs::delta_file(uint64_t shard,
+                                              uint64_t iter) const
+{
+    return sync_dir_ + "/delta-" + std::to_string(iter) + "-"
+           + std::to_string(shard);
+}
+
+std::string distributed_lda_gibbs::theta_file(uint64_t shard) const
+{
+    return sync_dir_ + "/theta-" + std::to_string(shard);
+}
+
+void distributed_lda_gibbs::wait_for(const std::string& filename) const
+{
+    while (!filesystem::file_exists(filename))
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+}
+
+double distributed_lda_gibbs::compute_term_topic_probability(
+    term_id term, topic_id topic) const
+{
+    return (term_topics_(term, topic) + beta_)
+           / (topic_totals_[topic] + num_words_ * beta_);
+}
+
+double distributed_lda_gibbs::compute_doc_topic_probability(
+    doc_id doc, topic_id topic) const
+{
+    auto row = doc - first_doc_;
+    return (doc_topics_(row, topic) + alpha_)
+           / (doc_word_topic_.size(row) + num_topics_ * alpha_);
+}
+
+double distributed_lda_gibbs::corpus_log_likelihood() const
+{
+    // terms with no words in a topic contribute nothing
+    double vbeta = num_words_ * beta_;
+    double likelihood = num_topics_ * std::lgamma(vbeta);
+    for (term_id t{0}; t < num_words_; ++t)
+    {
+        auto counts = term_topics_.dense_row(t);
+        for (topic_id j{0}; j < num_topics_; ++j)
+        {
+            if (counts[j] > 0)
+                likelihood += count_log_gammas_(counts[j]);
+        }
+    }
+    for (const auto& total : topic_totals_)
+        likelihood -= std::lgamma(total + vbeta);
+    return likelihood;
+}
+
+void distributed_lda_gibbs::save(const std::string& prefix) const
+{
+    auto filename = theta_file(shard_);
+    if (binary_top_terms_ > 0)
+        save_doc_topic_probabilities(filename + ".tmp");
+    else
+        save_doc_topic_distributions(filename + ".tmp");
+    filesystem::rename_file(filename + ".tmp", filename);
+    if (shard_ != 0)
+        return;
+
+    // the shards are contiguous, so joining their documents in order of
+    // shard gives the same file as a single lda_model; in binary, the
+    // rows of every shard follow a header for all of the documents
+    uint64_t header = 0;
+    std::ofstream theta;
+    if (binary_top_terms_ > 0)
+    {
+        header = 2 * sizeof(uint64_t);
+        theta.open(prefix + ".theta.bin", std::ios::binary);
+        io::write_binary(theta, static_cast<uint64_t>(num_topics_));
+        io::write_binary(theta, idx_->num_docs());
+    }
+    else
+    {
+        theta.open(prefix + ".theta");
+    }
+    for (uint64_t shard = 0; shard < num_shards_; ++shard)
+    {
+        wait_for(theta_file(shard));
+        if (filesystem::file_size(theta_file(shard)) <= header)
+            continue;
+        std::ifstream in{theta_file(shard), std::ios::binary};
+        in.seekg(static_cast<std::streamoff>(header));
+        theta << in.rdbuf();
+    }
+
+    if (binary_top_terms_ > 0)
+        save_topic_top_terms(prefix + ".phi.bin", binary_top_terms_);
+    else
+        save_topic_term_distributions(prefix + ".phi");
+    save_topic_term_probabilities(prefix + ".topics");
+    filesystem::remove_all(sync_dir_);
+}
+}
+}
@@ -3,9 +3,11 @@
  * @author Chase Geigle
  */
 
+#include <cmath>
 #include <random>
 #include "index/postings_data.h"
 #include "topics/lda_cvb.h"
+#include "util/metrics.h"
 #include "util/progress.h"
 
 namespace meta
@@ -15,25 +17,28 @@ namespace topics
 
 lda_cvb::lda_cvb(std::shared_ptr<index::forward_index> idx, uint64_t num_topics,
                  double alpha, double beta)
-    : lda_model{std::move(idx), num_topics}
+    : lda_model{std::move(idx), num_topics},
+      alpha_{alpha},
+      beta_{beta},
+      term_topics_{num_words_, num_topics_},
+      doc_topics_{idx_->num_docs(), num_topics_},
+      topic_totals_(num_topics_, 0.0),
+      weights_(num_topics_)
 {
     gamma_.resize(idx_->num_docs());
-
-    // each theta_ is a multinomial over topics with a symmetric
-    // Dirichlet(\alpha) prior
-    theta_.reserve(idx_->num_docs());
     for (doc_id doc{0}; doc < idx_->num_docs(); ++doc)
-    {
-        theta_.emplace_back(stats::dirichlet<topic_id>{alpha, num_topics_});
-        gamma_[doc].resize(idx_->doc_size(doc));
-    }
+        gamma_[doc].resize(doc_terms_[doc].size() * num_topics_);
+}
 
-    // each phi_ is a multinomial over terms with a symmetric
-    // Dirichlet(\beta) prior
-    phi_.reserve(num_topics_);
-    for (topic_id topic{0}; topic < num_topics_; ++topic)
-        phi_.emplace_back(
-            stats::dirichlet<term_id>{beta, idx_->unique_terms()});
+util::memory_report lda_cvb::memory_usage() const
+{
+    auto report = lda_model::memory_usage();
+    report.add("assignments", util::heap_memory(gamma_));
+    report.add("term-topics", term_topics_.memory_usage());
+    report.add("term-topics", util::heap_memory(topic_totals_));
+    report.add("doc-topics", doc_topics_.memory_usage());
+    report.add("scratch", util::heap_memory(weights_));
+    return report;
 }
 
 void lda_cvb::run(uint64_t num_iters, double convergence)
@@ -42,7 +47,11 @@ void lda_cvb::run(uint64_t num_iters, double convergence)
     for (uint64_t i = 0; i < num_iters; ++i)
     {
         std::stringstream ss;
-        double max_change = perform_iteration(i);
+        double max_change;
+        {
+            metrics::scoped_timer timer{"lda_iteration_ns"};
+            max_change = perform_iteration(i);
+        }
         ss << "Iteration " << i + 1
            << " maximum change in gamma: " << max_change;
         std::string spacing(std::max<int>(0, 80 - ss.tellp()), ' ');
@@ -68,28 +77,32 @@ void lda_cvb::initialize()
     {
         progress(d);
 
-        uint64_t i = 0; // i here is the inter-document term id, since we need
-                        // to handle each word occurrence separately
-        for (auto& freq : idx_->search_primary(d)->counts())
+        auto topics = doc_topics_.dense_row(d);
+        uint64_t i = 0; // position of the term within the document
+        for (const auto& freq : doc_terms_[d])
         {
-            for (uint64_t count = 0; count < freq.second; ++count)
+            // create a random gamma distribution, shared by every
+            // occurrence of the term
+            auto terms = term_topics_.dense_row(freq.first);
+            auto gamma = &gamma_[d][i * num_topics_];
+            double sum = 0;
+            for (topic_id k{0}; k < num_topics_; ++k)
             {
-                // create random gamma distributions
-                for (topic_id k{0}; k < num_topics_; ++k)
-                {
-                    gamma_[d][i].increment(k, rng());
-                }
-
-                // contribute expected counts to phi_ and theta_
-                for (topic_id k{0}; k < num_topics_; ++k)
-                {
-                    auto prob = gamma_[d][i].probability(k);
-                    phi_[k].increment(freq.first, prob);
-                    theta_[d].increment(k, prob);
-                }
-
-                i += 1;
+                gamma[k] = rng();
+                sum += gamma[k];
             }
+
+            // contribute expected counts to the topic counts
+            for (topic_id k{0}; k < num_topics_; ++k)
+            {
+                gamma[k] /= sum;
+                auto count = freq.second * gamma[k];
+                terms[k] += count;
+                topics[k] += count;
+                topic_totals_[k] += count;
+            }
+
+            i += 1;
         }
     }
 }
@@ -99,51 +112,52 @@ double lda_cvb::perform_iteration(uint64_t iter)
     printing::progress progress{"Iteration " + std::to_string(iter) + ": ",
                                 idx_->num_docs()};
     progress.print_endline(false);
+    double vbeta = num_words_ * beta_;
     double max_change = 0;
     for (doc_id d{0}; d < idx_->num_docs(); ++d)
     {
         progress(d);
 
-        uint64_t i = 0; // term number within document---constructed
-                        // so that each occurrence of the same term
-                        // can still be assigned a different topic
-        for (auto& freq : idx_->search_primary(d)->counts())
+        auto topics = doc_topics_.dense_row(d);
+        uint64_t i = 0; // position of the term within the document
+        for (const auto& freq : doc_terms_[d])
         {
-            for (uint64_t count = 0; count < freq.second; ++count)
+            // every occurrence of the term is updated at once, as a
+            // single occurrence weighted by the term's count
+            auto terms = term_topics_.dense_row(freq.first);
+            auto gamma = &gamma_[d][i * num_topics_];
+            double sum = 0;
+            for (topic_id k{0}; k < num_topics_; ++k)
+            {
+                // remove this word's occurrences from the counts
+                auto count = freq.second * gamma[k];
+                terms[k] -= count;
+                topics[k] -= count;
+                topic_totals_[k] -= count;
+
+                // "sample" the next topic: we are doing soft-assignment
+                // here so we actually just compute the probability of
+                // this topic
+                weights_[k] = (terms[k] + beta_) / (topic_totals_[k] + vbeta)
+                              * (topics[k] + alpha_);
+                sum += weights_[k];
+            }
+
+            double delta = 0;
+            for (topic_id k{0}; k < num_topics_; ++k)
             {
-                auto old_gamma = gamma_[d][i];
-                for (topic_id k{0}; k < num_topics_; ++k)
-                {
-                    // remove this word occurrence from the distributions
-                    auto prob = gamma_[d][i].probability(k);
-                    phi_[k].decrement(freq.first, prob);
-                    theta_[d].decrement(k, prob);
-                }
-
-                gamma_[d][i].clear();
-                for (topic_id k{0}; k < num_topics_; ++k)
-                {
-                    // "sample" the next topic: we are doing
-                    // soft-assignment here so we actually just compute the
-                    // probability of this topic
-                    auto weight = phi_[k].probability(freq.first)
-                                  * theta_[d].probability(k);
-                    gamma_[d][i].increment(k, weight);
-                }
-
-                double delta = 0;
-                for (topic_id k{0}; k < num_topics_; ++k)
-                {
-                    // recontribute expected counts, keep track of gamma
-                    // changes for convergence
-                    auto prob = gamma_[d][i].probability(k);
-                    phi_[k].increment(freq.first, prob);
-                    theta_[d].increment(k, prob);
-                    delta += std::abs(prob - old_gamma.probability(k));
-                }
-                max_change = std::max(max_change, delta);
-                i += 1;
+                // recontribute expected counts, keep track of gamma
+                // changes for convergence
+                auto prob = weights_[k] / sum;
+                delta += std::abs(prob - gamma[k]);
+                gamma[k] = prob;
+                auto count = freq.second * prob;
+                terms[k] += count;
+                topics[k] += count;
+                topic_totals_[k] += count;
             }
+            max_change = std::max(max_change, delta);
+            i += 1;
         }
     }
     return max_change;
@@ -152,12 +166,14 @@ double lda_cvb::perform_iteration(uint64_t iter)
 double lda_cvb::compute_term_topic_probability(term_id term,
                                                topic_id topic) const
 {
-    return phi_[topic].probability(term);
+    return (term_topics_(term, topic) + beta_)
+           / (topic_totals_[topic] + num_words_ * beta_);
 }
 
 double lda_cvb::compute_doc_topic_probability(doc_id doc, topic_id topic) const
 {
-    return theta_[doc].probability(topic);
+    return (doc_topics_(doc, topic) + alpha_)
+           / (idx_->doc_size(doc) + num_topics_ * alpha_);
 }
 }
 }
@@ -8,6 +8,7 @@
 
 #include "index/postings_data.h"
 #include "topics/lda_gibbs.h"
+#include "util/metrics.h"
 #include "util/progress.h"
 
 namespace meta
@@ -15,32 +16,66 @@ namespace meta
 namespace topics
 {
 
-lda_gibbs::lda_gibbs(std::shared_ptr<index::forward_index> idx,
-                     uint64_t num_topics, double alpha, double beta)
-    : lda_model{std::move(idx), num_topics}
+namespace
 {
-    doc_word_topic_.resize(idx_->num_docs());
-
-    // each theta_ is a multinomial over topics with a symmetric
-    // Dirichlet(\alpha) prior
-    theta_.reserve(idx_->num_docs());
-    for (doc_id doc{0}; doc < idx_->num_docs(); ++doc)
+/**
+ * @param docs The (term id, count) pairs of the documents
+ * @param num_terms The number of terms
+ * @return the number of occurrences of each term
+ */
+std::vector<uint64_t> term_frequencies(const index::csr_matrix& docs,
+                                       uint64_t num_terms)
+{
+    std::vector<uint64_t> freqs(num_terms, 0);
+    for (uint64_t r = 0; r < docs.rows(); ++r)
     {
-        theta_.emplace_back(stats::dirichlet<topic_id>{alpha, num_topics_});
-        doc_word_topic_[doc].resize(idx_->doc_size(doc));
+        for (const auto& freq : docs[r])
+            freqs[freq.first] += static_cast<uint64_t>(freq.second);
     }
+    return freqs;
+}
 
-    // each phi_ is a multinomial over terms with a symmetric
-    // Dirichlet(\beta) prior
-    phi_.reserve(num_topics_);
-    for (topic_id topic{0}; topic < num_topics_; ++topic)
-        phi_.emplace_back(
-            stats::dirichlet<term_id>{beta, idx_->unique_terms()});
+/**
+ * @param idx The index holding the documents
+ * @return the number of words in each document
+ */
+std::vector<uint64_t> doc_lengths(const index::forward_index& idx)
+{
+    std::vector<uint64_t> lengths(idx.num_docs());
+    for (doc_id doc{0}; doc < idx.num_docs(); ++doc)
+        lengths[doc] = idx.doc_size(doc);
+    return lengths;
+}
+}
 
+lda_gibbs::lda_gibbs(std::shared_ptr<index::forward_index> idx,
+                     uint64_t num_topics, double alpha, double beta,
+                     const std::string& assignments_path /* = "" */)
+    : lda_model{std::move(idx), num_topics},
+      doc_word_topic_{doc_lengths(*idx_), num_topics_, assignments_path},
+      alpha_{alpha},
+      beta_{beta},
+      count_log_gammas_{beta_},
+      term_topics_{term_frequencies(doc_terms_, num_words_), num_topics_},
+      doc_topics_{doc_lengths(*idx_), num_topics_},
+      topic_totals_(num_topics_, 0),
+      weights_(num_topics_)
+{
     std::random_device dev;
     rng_.seed(dev());
 }
 
+util::memory_report lda_gibbs::memory_usage() const
+{
+    auto report = lda_model::memory_usage();
+    report.add("assignments", doc_word_topic_.memory_usage());
+    report.add("term-topics", term_topics_.memory_usage());
+    report.add("term-topics", util::heap_memory(topic_totals_));
+    report.add("doc-topics", doc_topics_.memory_usage());
+    report.add("scratch", util::heap_memory(weights_));
+    return report;
+}
+
 void lda_gibbs::run(uint64_t num_iters, double convergence /* = 1e-6 */)
 {
     initialize();
@@ -53,7 +88,14 @@ void lda_gibbs::run(uint64_t num_iters, double convergence /* = 1e-6 */)
 
     for (uint64_t i = 0; i < num_iters; ++i)
     {
-        perform_iteration(i + 1);
+        {
+            metrics::scoped_timer timer{"lda_iteration_ns"};
+            perform_iteration(i + 1);
+        }
+        // the likelihood is a pass over all of the counts, so it is only
+        // evaluated every eval_interval_ iterations
+        if ((i + 1) % eval_interval_ != 0 && i + 1 != num_iters)
+            continue;
         double likelihood_update = corpus_log_likelihood();
         double ratio = std::fabs((likelihood - likelihood_update) / likelihood);
         likelihood = likelihood_update;
@@ -75,13 +117,17 @@ void lda_gibbs::run(uint64_t num_iters, double convergence /* = 1e-6 */)
 
 topic_id lda_gibbs::sample_topic(term_id term, doc_id doc)
 {
-    stats::multinomial<topic_id> full_conditional;
+    double total = 0;
     for (topic_id topic{0}; topic < num_topics_; ++topic)
     {
-        auto weight = compute_sampling_weight(term, doc, topic);
-        full_conditional.increment(topic, weight);
+        total += compute_sampling_weight(term, doc, topic);
+        weights_[topic] = total;
     }
-    return full_conditional(rng_);
+
+    std::uniform_real_distribution<double> dist{0, total};
+    auto it = std::upper_bound(weights_.begin(), weights_.end(), dist(rng_));
+    return topic_id{
+        std::min<uint64_t>(it - weights_.begin(), num_topics_ - 1)};
 }
 
 double lda_gibbs::compute_sampling_weight(term_id term, doc_id doc,
@@ -94,13 +140,15 @@ double lda_gibbs::compute_sampling_weight(term_id term, doc_id doc,
 double lda_gibbs::compute_term_topic_probability(term_id term,
                                                  topic_id topic) const
 {
-    return phi_[topic].probability(term);
+    return (term_topics_(term, topic) + beta_)
+           / (topic_totals_[topic] + num_words_ * beta_);
 }
 
 double lda_gibbs::compute_doc_topic_probability(doc_id doc,
                                                 topic_id topic) const
 {
-    return theta_[doc].probability(topic);
+    return (doc_topics_(doc, topic) + alpha_)
+           / (doc_word_topic_.size(doc) + num_topics_ * alpha_);
 }
 
 void lda_gibbs::initialize()
@@ -123,11 +171,11 @@ void lda_gibbs::perform_iteration(uint64_t iter, bool init /* = false */)
         uint64_t n = 0; // term number within document---constructed
                         // so that each occurrence of the same term
                         // can still be assigned a different topic
-        for (const auto& freq : idx_->search_primary(i)->counts())
+        for (const auto& freq : doc_terms_[i])
         {
             for (uint64_t j = 0; j < freq.second; ++j)
             {
-                auto old_topic = doc_word_topic_[i][n];
+                auto old_topic = doc_word_topic_(i, n);
                 // don't include current topic assignment in
                 // probability calculation
                 if (!init)
@@ -135,7 +183,7 @@ void lda_gibbs::perform_iteration(uint64_t iter, bool init /* = false */)
 
                 // sample a new topic assignment
                 auto topic = sample_topic(freq.first, i);
-                doc_word_topic_[i][n] = topic;
+                doc_word_topic_.assign(i, n, topic);
 
                 // increase counts
                 increase_counts(topic, freq.first, i);
@@ -147,34 +195,45 @@ void lda_gibbs::perform_iteration(uint64_t iter, bool init /* = false */)
 
 void lda_gibbs::decrease_counts(topic_id topic, term_id term, doc_id doc)
 {
-    phi_[topic].decrement(term, 1);
-    theta_[doc].decrement(topic, 1);
+    term_topics_.decrement(term, topic);
+    doc_topics_.decrement(doc, topic);
+    --topic_totals_[topic];
 }
 
 void lda_gibbs::increase_counts(topic_id topic, term_id term, doc_id doc)
 {
-    phi_[topic].increment(term, 1);
-    theta_[doc].increment(topic, 1);
+    term_topics_.increment(term, topic);
+    doc_topics_.increment(doc, topic);
+    ++topic_totals_[topic];
 }
 
 double lda_gibbs::corpus_log_likelihood() const
 {
-    auto tid0 = topic_id{0};
-    // V * \beta if symmetric, \sum_{r=1}^V \beta_r otherwise
-    auto total_pcs = phi_[tid0].prior().pseudo_counts();
-
-    double likelihood = num_topics_ * std::lgamma(total_pcs);
+    return term_log_likelihood(term_id{0}, term_id{num_words_})
+           + topic_log_likelihood();
+}
 
-    for (topic_id j{0}; j < num_topics_; ++j)
+double lda_gibbs::term_log_likelihood(term_id first, term_id last) const
+{
+    // terms with no words in a topic contribute nothing
+    double likelihood = 0;
+    for (auto t = first; t < last; ++t)
     {
-        for (term_id t{0}; t < num_words_; ++t)
-        {
-            likelihood += std::lgamma(phi_[j].counts(t))
-                          - std::lgamma(phi_[j].prior().pseudo_counts(t));
-        }
-        likelihood -= std::lgamma(phi_[j].counts());
+        term_topics_.each_topic(t, [&](topic_id, uint32_t count)
+                                {
+            likelihood += count_log_gammas_(count);
+        });
     }
     return likelihood;
 }
+
+double lda_gibbs::topic_log_likelihood() const
+{
+    double vbeta = num_words_ * beta_;
+    double likelihood = num_topics_ * std::lgamma(vbeta);
+    for (const auto& total : topic_totals_)
+        likelihood -= std::lgamma(total + vbeta);
+    return likelihood;
+}
 }
 }
@@ -3,6 +3,11 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "io/binary.h"
 #include "topics/lda_model.h"
 
 namespace meta
@@ -13,16 +18,43 @@ namespace topics
 lda_model::lda_model(std::shared_ptr<index::forward_index> idx,
                      uint64_t num_topics)
     : idx_{std::move(idx)},
+      first_doc_{0},
+      last_doc_{idx_->num_docs()},
+      doc_terms_{idx_->materialize(idx_->docs())},
       num_topics_{num_topics},
-      num_words_{idx_->unique_terms()}
+      num_words_{idx_->unique_terms()},
+      eval_interval_{1},
+      binary_top_terms_{0}
 {
     /* nothing */
 }
 
+lda_model::lda_model(std::shared_ptr<index::forward_index> idx,
+                     uint64_t num_topics, doc_id first, doc_id last)
+    : idx_{std::move(idx)},
+      first_doc_{first},
+      last_doc_{last},
+      num_topics_{num_topics},
+      num_words_{idx_->unique_terms()},
+      eval_interval_{1},
+      binary_top_terms_{0}
+{
+    std::vector<doc_id> docs;
+    docs.reserve(last - first);
+    for (auto d = first; d < last; ++d)
+        docs.push_back(d);
+    doc_terms_ = idx_->materialize(docs);
+}
+
+void lda_model::evaluation_interval(uint64_t interval)
+{
+    eval_interval_ = std::max<uint64_t>(interval, 1);
+}
+
 void lda_model::save_doc_topic_distributions(const std::string& filename) const
 {
     std::ofstream file{filename};
-    for (const auto& d_id : idx_->docs())
+    for (auto d_id = first_doc_; d_id < last_doc_; ++d_id)
     {
         file << d_id << "\t";
         double sum = 0;
@@ -39,14 +71,11 @@ void lda_model::save_doc_topic_distributions(const std::string& filename) const
     }
 }
 
-void lda_model::save_topic_term_distributions(const std::string& filename) const
+std::vector<double> lda_model::term_score_denominators() const
 {
-    std::ofstream file{filename};
-
-    // first, compute the denominators for each term's normalized score
     std::vector<double> denoms;
-    denoms.reserve(idx_->unique_terms());
-    for (term_id t_id{0}; t_id < idx_->unique_terms(); ++t_id)
+    denoms.reserve(num_words_);
+    for (term_id t_id{0}; t_id < num_words_; ++t_id)
     {
         double denom = 1.0;
         for (topic_id j{0}; j < num_topics_; ++j)
@@ -54,12 +83,21 @@ void lda_model::save_topic_term_distributions(const std::string& filename) const
         denom = std::pow(denom, 1.0 / num_topics_);
         denoms.push_back(denom);
     }
+    return denoms;
+}
+
+void lda_model::save_topic_term_distributions(const std::string& filename) const
+{
+    std::ofstream file{filename};
+
+    // first, compute the denominators for each term's normalized score
+    auto denoms = term_score_denominators();
 
     // then, calculate and save each term's score
     for (topic_id j{0}; j < num_topics_; ++j)
     {
         file << j << "\t";
-        for (term_id t_id{0}; t_id < idx_->unique_terms(); ++t_id)
+        for (term_id t_id{0}; t_id < num_words_; ++t_id)
         {
             double prob = compute_term_topic_probability(t_id, j);
             double norm_prob = prob * std::log(prob / denoms[t_id]);
@@ -70,10 +108,118 @@ void lda_model::save_topic_term_distributions(const std::string& filename) const
     }
 }
 
+void lda_model::save_topic_term_probabilities(
+    const std::string& filename) const
+{
+    std::ofstream file{filename, std::ios::binary};
+    io::write_binary(file, static_cast<uint64_t>(num_topics_));
+    io::write_binary(file, static_cast<uint64_t>(num_words_));
+
+    // each term's probabilities are written as one block
+    std::vector<float> row(num_topics_);
+    for (term_id t_id{0}; t_id < num_words_; ++t_id)
+    {
+        for (topic_id j{0}; j < num_topics_; ++j)
+            row[j] = static_cast<float>(
+                compute_term_topic_probability(t_id, j));
+        file.write(reinterpret_cast<const char*>(row.data()),
+                   static_cast<std::streamsize>(row.size() * sizeof(float)));
+    }
+}
+
+void lda_model::save_doc_topic_probabilities(const std::string& filename) const
+{
+    std::ofstream file{filename, std::ios::binary};
+    io::write_binary(file, static_cast<uint64_t>(num_topics_));
+    io::write_binary(file, static_cast<uint64_t>(last_doc_ - first_doc_));
+
+    std::vector<float> row(num_topics_);
+    for (auto d_id = first_doc_; d_id < last_doc_; ++d_id)
+    {
+        double sum = 0;
+        for (topic_id j{0}; j < num_topics_; ++j)
+        {
+            double prob = compute_doc_topic_probability(d_id, j);
+            row[j] = static_cast<float>(prob);
+            sum += prob;
+        }
+        if (std::abs(sum - 1) > 1e-6)
+            throw std::runtime_error{"invalid probability distribution"};
+        file.write(reinterpret_cast<const char*>(row.data()),
+                   static_cast<std::streamsize>(row.size() * sizeof(float)));
+    }
+}
+
+void lda_model::save_topic_top_terms(const std::string& filename,
+                                     uint64_t num_terms) const
+{
+    num_terms = std::min<uint64_t>(num_terms, num_words_);
+    auto denoms = term_score_denominators();
+
+    std::vector<uint64_t> terms;
+    std::vector<float> scores;
+    terms.reserve(num_topics_ * num_terms);
+    scores.reserve(num_topics_ * num_terms);
+
+    std::vector<std::pair<double, term_id>> topic_scores(num_words_);
+    for (topic_id j{0}; j < num_topics_; ++j)
+    {
+        for (term_id t_id{0}; t_id < num_words_; ++t_id)
+        {
+            double prob = compute_term_topic_probability(t_id, j);
+            topic_scores[t_id]
+                = std::make_pair(prob * std::log(prob / denoms[t_id]), t_id);
+        }
+        std::partial_sort(topic_scores.begin(),
+                          topic_scores.begin() + num_terms, topic_scores.end(),
+                          [](const std::pair<double, term_id>& a,
+                             const std::pair<double, term_id>& b)
+                          {
+                              return a.first > b.first;
+                          });
+        for (uint64_t i = 0; i < num_terms; ++i)
+        {
+            terms.push_back(topic_scores[i].second);
+            scores.push_back(static_cast<float>(topic_scores[i].first));
+        }
+    }
+
+    // all of the ids come before all of the scores, so that both are
+    // aligned when the file is mapped
+    std::ofstream file{filename, std::ios::binary};
+    io::write_binary(file, static_cast<uint64_t>(num_topics_));
+    io::write_binary(file, num_terms);
+    file.write(reinterpret_cast<const char*>(terms.data()),
+               static_cast<std::streamsize>(terms.size() * sizeof(uint64_t)));
+    file.write(reinterpret_cast<const char*>(scores.data()),
+               static_cast<std::streamsize>(scores.size() * sizeof(float)));
+}
+
+void lda_model::binary_output(uint64_t top_terms)
+{
+    binary_top_terms_ = std::max<uint64_t>(top_terms, 1);
+}
+
+util::memory_report lda_model::memory_usage() const
+{
+    util::memory_report report;
+    report.add("doc-terms", doc_terms_.memory_usage());
+    return report;
+}
+
 void lda_model::save(const std::string& prefix) const
 {
-    save_doc_topic_distributions(prefix + ".theta");
-    save_topic_term_distributions(prefix + ".phi");
+    if (binary_top_terms_ > 0)
+    {
+        save_doc_topic_probabilities(prefix + ".theta.bin");
+        save_topic_top_terms(prefix + ".phi.bin", binary_top_terms_);
+    }
+    else
+    {
+        save_doc_topic_distributions(prefix + ".theta");
+        save_topic_term_distributions(prefix + ".phi");
+    }
+    save_topic_term_probabilities(prefix + ".topics");
 }
 }
 }
@@ -3,9 +3,13 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+#include <cmath>
 #include <random>
 #include "index/postings_data.h"
+#include "parallel/parallel_for.h"
 #include "topics/lda_scvb.h"
+#include "util/metrics.h"
 #include "util/progress.h"
 
 namespace meta
@@ -17,45 +21,91 @@ lda_scvb::lda_scvb(std::shared_ptr<index::forward_index> idx,
                    uint64_t num_topics, double alpha, double beta,
                    uint64_t minibatch_size)
     : lda_model{std::move(idx), num_topics},
+      term_topic_count_{num_words_, num_topics_},
+      scale_{1.0},
+      topic_count_(num_topics_, 0.0),
+      topic_norms_(num_topics_),
+      cached_doc_{last_doc_},
       alpha_{alpha},
       beta_{beta},
       minibatch_size_{std::min(minibatch_size, idx_->num_docs())}
 {
-    // nothing
+    workers_.resize(pool_.thread_ids().size());
+    for (auto& w : workers_)
+    {
+        w.theta.resize(num_topics_);
+        w.gamma.resize(num_topics_);
+        w.batch_topics.assign(num_topics_, 0.0);
+    }
+}
+
+util::memory_report lda_scvb::memory_usage() const
+{
+    auto report = lda_model::memory_usage();
+    report.add("term-topics", term_topic_count_.memory_usage());
+    report.add("term-topics", util::heap_memory(topic_count_));
+    report.add("term-topics", util::heap_memory(topic_norms_));
+
+    // the slots of a worker are estimated as a node and a bucket each
+    util::memory_usage scratch;
+    for (const auto& w : workers_)
+    {
+        scratch += util::heap_memory(w.theta);
+        scratch += util::heap_memory(w.gamma);
+        scratch += util::heap_memory(w.terms);
+        scratch += util::heap_memory(w.batch_terms);
+        scratch += util::heap_memory(w.batch_topics);
+        scratch.heap_bytes += w.slots.size()
+                                  * (sizeof(*w.slots.begin()) + sizeof(void*))
+                              + w.slots.bucket_count() * sizeof(void*);
+    }
+    scratch += util::heap_memory(cached_theta_);
+    scratch += util::heap_memory(cached_gamma_);
+    report.add("scratch", scratch);
+    return report;
 }
 
 void lda_scvb::run(uint64_t num_iters, double)
 {
     std::mt19937 gen{std::random_device{}()};
-    initialize(gen);
     auto docs = idx_->docs();
+
+    // only the minibatch needs to be shuffled into the front of docs, so
+    // choosing one is not linear in the size of the dataset
+    auto choose_minibatch = [&]()
+    {
+        for (uint64_t j = 0; j < minibatch_size_; ++j)
+        {
+            std::uniform_int_distribution<uint64_t> dist{j, docs.size() - 1};
+            std::swap(docs[j], docs[dist(gen)]);
+        }
+    };
+
+    choose_minibatch();
+    initialize(gen, docs);
     for (uint64_t iter = 0; iter < num_iters; ++iter)
     {
-        std::shuffle(docs.begin(), docs.end(), gen);
+        choose_minibatch();
+        metrics::scoped_timer timer{"lda_iteration_ns"};
         perform_iteration(iter + 1, docs);
     }
+    cached_doc_ = last_doc_;
 }
 
-void lda_scvb::initialize(std::mt19937& rng)
+void lda_scvb::initialize(std::mt19937& rng, const std::vector<doc_id>& docs)
 {
-    // TODO: Don't actually iterate through whole dataset here
-    doc_topic_count_.resize(idx_->num_docs());
-    topic_term_count_.resize(num_topics_);
-    for (auto& v : topic_term_count_)
-        v.resize(idx_->unique_terms());
-    topic_count_.resize(num_topics_);
-
-    printing::progress progress{" > Initialization: ", idx_->num_docs()};
-    for (doc_id d{0}; d < idx_->num_docs(); ++d)
+    // the statistics of the minibatch are scaled up to estimate those of
+    // the whole dataset, as they are in perform_iteration
+    printing::progress progress{" > Initialization: ", minibatch_size_};
+    double factor = static_cast<double>(idx_->num_docs()) / minibatch_size_;
+    std::vector<double> gamma(num_topics_);
+    for (uint64_t j = 0; j < minibatch_size_; ++j)
     {
-        progress(d);
-
-        doc_topic_count_[d].resize(num_topics_);
-
-        for (auto& freq : idx_->search_primary(d)->counts())
+        progress(j);
+        for (const auto& freq : doc_terms_[docs[j]])
         {
+            auto terms = term_topic_count_.dense_row(freq.first);
             double sum = 0;
-            std::vector<double> gamma(num_topics_);
             for (topic_id k{0}; k < num_topics_; ++k)
             {
                 auto random = rng();
@@ -64,118 +114,207 @@ void lda_scvb::initialize(std::mt19937& rng)
             }
             for (topic_id k{0}; k < num_topics_; ++k)
             {
-                gamma[k] = gamma[k] * freq.second / sum;
-                topic_term_count_[k][freq.first] += gamma[k];
-                doc_topic_count_[d][k] += gamma[k];
+                gamma[k] = gamma[k] * factor * freq.second / sum;
+                terms[k] += static_cast<float>(gamma[k]);
                 topic_count_[k] += gamma[k];
             }
         }
     }
+
+    for (topic_id k{0}; k < num_topics_; ++k)
+        topic_norms_[k] = 1.0 / (topic_count_[k] + num_words_ * beta_);
 }
 
 void lda_scvb::perform_iteration(uint64_t iter, const std::vector<doc_id>& docs)
 {
-    printing::progress progress{"Minibatch " + std::to_string(iter) + ": ",
-                                minibatch_size_, 100, 1};
+    printing::concurrent_progress progress{
+        "Minibatch " + std::to_string(iter) + ": ", minibatch_size_, 100};
 
-    std::vector<std::unordered_map<term_id, double>> batch_topic_term_count_(
-        num_topics_);
-    std::vector<double> batch_topic_count_(num_topics_, 0.0);
-    std::vector<double> gamma(num_topics_);
+    // the threads claim blocks of the minibatch as they go, since
+    // documents vary a lot in length; each gathers its estimates in its
+    // own worker, whose terms are sorted once all blocks are done
+    parallel::parallel_chunks(pool_, minibatch_size_, 0,
+                              [&](uint64_t task, uint64_t first, uint64_t last)
+                              {
+        process_block(workers_[task], docs.data() + first,
+                      docs.data() + last);
+        progress.increment(last - first);
+    });
+    progress.end();
+    parallel::parallel_for(workers_.begin(), workers_.end(), pool_,
+                           [](worker& w)
+                           {
+        std::sort(w.terms.begin(), w.terms.end());
+    }, 1);
 
-    for (uint64_t j = 0; j < minibatch_size_; ++j)
+    // compute the learning schedule
+    auto lr = 10.0 / std::pow(1000 + iter * minibatch_size_, 0.9);
+
+    // every topic-term statistic decays by (1 - lr), which is done by
+    // scaling all of them at once; only the terms of the minibatch then
+    // need to be touched to add in its estimates
+    scale_ *= 1 - lr;
+    auto rate = lr / (minibatch_size_ * scale_);
+    std::vector<std::future<void>> futures;
+    auto terms_per_task = (num_words_ + workers_.size() - 1)
+                          / workers_.size();
+    for (uint64_t first = 0; first < num_words_; first += terms_per_task)
     {
-        progress(j);
-        auto d = docs[j];
-        // burn-in phase
-        double t = 0;
-        for (const auto& freq : idx_->search_primary(d)->counts())
+        auto last = std::min<uint64_t>(first + terms_per_task, num_words_);
+        futures.emplace_back(pool_.submit_task([this, first, last, rate]()
         {
-            double sum = 0;
-            for (topic_id k{0}; k < num_topics_; ++k)
+            merge(term_id{first}, term_id{last}, rate);
+        }));
+    }
+    for (auto& fut : futures)
+        fut.get();
+
+    for (topic_id k{0}; k < num_topics_; ++k)
+    {
+        double batch_count = 0;
+        for (auto& w : workers_)
+        {
+            batch_count += w.batch_topics[k];
+            w.batch_topics[k] = 0;
+        }
+        topic_count_[k] = (1 - lr) * topic_count_[k]
+                          + lr * (batch_count / minibatch_size_);
+        topic_norms_[k] = 1.0 / (topic_count_[k] + num_words_ * beta_);
+    }
+
+    for (auto& w : workers_)
+    {
+        w.slots.clear();
+        w.terms.clear();
+        w.batch_terms.clear();
+    }
+
+    // keep the stored statistics well within the range of a float
+    if (scale_ < 1e-6)
+        rescale();
+}
+
+void lda_scvb::process_block(worker& w, const doc_id* first,
+                             const doc_id* last)
+{
+    double num_docs = idx_->num_docs();
+    for (auto it = first; it != last; ++it)
+    {
+        infer_doc(*it, w.theta.data(), w.gamma.data(),
+                  [&](term_id term, double count, const double* gamma)
+                  {
+            auto slot = w.slots.emplace(term, w.terms.size());
+            if (slot.second)
             {
-                gamma[k] = (topic_term_count_[k][freq.first] + beta_)
-                           / (topic_count_[k] + num_words_ * beta_)
-                           * (doc_topic_count_[d][k] + alpha_);
-                sum += gamma[k];
+                w.terms.push_back(term);
+                w.batch_terms.resize(w.batch_terms.size() + num_topics_, 0.0);
             }
+
+            auto batch = &w.batch_terms[slot.first->second * num_topics_];
+            auto amount = num_docs * count;
             for (topic_id k{0}; k < num_topics_; ++k)
             {
-                gamma[k] /= sum;
-                auto lr = 1.0 / std::pow(10 + t, 0.9);
-                auto weight = std::pow(1 - lr, freq.second);
-                doc_topic_count_[d][k] =
-                    weight * doc_topic_count_[d][k]
-                    + (1 - weight) * idx_->doc_size(d) * gamma[k];
+                batch[k] += amount * gamma[k];
+                w.batch_topics[k] += amount * gamma[k];
             }
-            t += freq.second;
-        }
+        });
+    }
+}
 
-        // normal phase
-        for (const auto& freq : idx_->search_primary(d)->counts())
+template <class Function>
+void lda_scvb::infer_doc(doc_id doc, double* theta, double* gamma,
+                         Function&& fn) const
+{
+    double doc_size = idx_->doc_size(doc);
+    for (topic_id k{0}; k < num_topics_; ++k)
+        theta[k] = doc_size / num_topics_;
+
+    // the loops over the topics that update values are kept apart from
+    // the one that sums over them, so that the former can be vectorized
+    // without reassociating floating point additions
+    auto row = doc_terms_[doc];
+    double t = 0;
+    for (uint64_t pass = 0; pass < 2; ++pass)
+    {
+        // the first pass is the burn-in phase, the second the normal one
+        for (const auto& freq : row)
         {
-            double sum = 0;
+            const float* terms = term_topic_count_.dense_row(freq.first);
             for (topic_id k{0}; k < num_topics_; ++k)
             {
-                gamma[k] = (topic_term_count_[k][freq.first] + beta_)
-                           / (topic_count_[k] + num_words_ * beta_)
-                           * (doc_topic_count_[d][k] + alpha_);
-                sum += gamma[k];
+                gamma[k] = (scale_ * terms[k] + beta_) * topic_norms_[k]
+                           * (theta[k] + alpha_);
             }
+
+            double sum = 0;
+            for (topic_id k{0}; k < num_topics_; ++k)
+                sum += gamma[k];
+
+            // compute the learning schedule
+            auto lr = 1.0 / std::pow(10 + t, 0.9);
+            auto weight = std::pow(1 - lr, freq.second);
+
             for (topic_id k{0}; k < num_topics_; ++k)
             {
                 // renormalize gamma
                 gamma[k] /= sum;
-
-                // compute the learning schedule
-                auto lr = 1.0 / std::pow(10 + t, 0.9);
-                auto weight = std::pow(1 - lr, freq.second);
-
-                doc_topic_count_[d][k] =
-                    weight * doc_topic_count_[d][k]
-                    + (1 - weight) * idx_->doc_size(d) * gamma[k];
-
-                batch_topic_term_count_[k][freq.first] +=
-                    idx_->num_docs() * gamma[k];
-
-                batch_topic_count_[k] += idx_->num_docs() * gamma[k];
+                theta[k] = weight * theta[k]
+                           + (1 - weight) * doc_size * gamma[k];
             }
+
+            if (pass == 1)
+                fn(freq.first, freq.second, gamma);
             t += freq.second;
         }
     }
-    progress.end();
-
-    // compute the learning schedule
-    auto lr = 10.0 / std::pow(1000 + iter * minibatch_size_, 0.9);
+}
 
-    // TODO: better weight decay here? We can represent the vectors as the
-    // product of a scalar and a vector to efficiently scale by (1 - lr)
-    // when the batch count is 0, and we can cancel the factor out in the
-    // addition when it is nonzero. Not sure if this will help, but I think
-    // it may...
-    for (topic_id k{0}; k < num_topics_; ++k)
+void lda_scvb::merge(term_id first, term_id last, double rate)
+{
+    for (auto& w : workers_)
     {
-        for (term_id i{0}; i < num_words_; ++i)
+        auto it = std::lower_bound(w.terms.begin(), w.terms.end(), first);
+        for (; it != w.terms.end() && *it < last; ++it)
         {
-            topic_term_count_[k][i] =
-                (1 - lr) * topic_term_count_[k][i]
-                + lr * (batch_topic_term_count_[k][i] / minibatch_size_);
+            auto terms = term_topic_count_.dense_row(*it);
+            auto batch = &w.batch_terms[w.slots.at(*it) * num_topics_];
+            for (topic_id k{0}; k < num_topics_; ++k)
+                terms[k] += static_cast<float>(rate * batch[k]);
         }
-        topic_count_[k] = (1 - lr) * topic_count_[k]
-                          + lr * (batch_topic_count_[k] / minibatch_size_);
     }
 }
 
+void lda_scvb::rescale()
+{
+    for (term_id i{0}; i < num_words_; ++i)
+    {
+        auto terms = term_topic_count_.dense_row(i);
+        for (topic_id k{0}; k < num_topics_; ++k)
+            terms[k] = static_cast<float>(scale_ * terms[k]);
+    }
+    scale_ = 1.0;
+}
+
 double lda_scvb::compute_term_topic_probability(term_id term,
                                                 topic_id topic) const
 {
-    return (topic_term_count_.at(topic).at(term) + beta_)
+    return (scale_ * term_topic_count_(term, topic) + beta_)
            / (topic_count_.at(topic) + num_words_ * beta_);
 }
 
 double lda_scvb::compute_doc_topic_probability(doc_id doc, topic_id topic) const
 {
-    return (doc_topic_count_.at(doc).at(topic) + alpha_)
+    if (cached_doc_ != doc)
+    {
+        cached_theta_.resize(num_topics_);
+        cached_gamma_.resize(num_topics_);
+        infer_doc(doc, cached_theta_.data(), cached_gamma_.data(),
+                  [](term_id, double, const double*)
+                  {
+        });
+        cached_doc_ = doc;
+    }
+    return (cached_theta_[topic] + alpha_)
            / (idx_->doc_size(doc) + num_topics_ * alpha_);
 }
 }
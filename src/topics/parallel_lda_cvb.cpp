@@ -0,0 +1,170 @@
+/**
+ * @file parallel_lda_cvb.cpp
+ * @author Chase Geigle
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "index/postings_data.h"
+#include "parallel/parallel_for.h"
+#include "topics/parallel_lda_cvb.h"
+#include "util/progress.h"
+
+namespace meta
+{
+namespace topics
+{
+
+util::memory_report parallel_lda_cvb::memory_usage() const
+{
+    auto report = lda_cvb::memory_usage();
+    util::memory_usage scratch;
+    for (const auto& w : workers_)
+    {
+        scratch += util::heap_memory(w.term_deltas);
+        scratch += util::heap_memory(w.topic_deltas);
+        scratch += util::heap_memory(w.weights);
+    }
+    report.add("scratch", scratch);
+    return report;
+}
+
+void parallel_lda_cvb::initialize()
+{
+    // each worker allocates its own deltas, so they are placed near it
+    workers_.resize(pool_.thread_ids().size());
+    parallel::for_each_worker(pool_, [&](uint64_t idx)
+                              {
+        auto& w = workers_[idx];
+        w.term_deltas.assign(num_words_ * num_topics_, 0.0);
+        w.topic_deltas.assign(num_topics_, 0.0);
+        w.weights.resize(num_topics_);
+    });
+    lda_cvb::initialize();
+}
+
+double parallel_lda_cvb::perform_iteration(uint64_t iter)
+{
+    printing::concurrent_progress progress{
+        "Iteration " + std::to_string(iter) + ": ", idx_->num_docs()};
+    progress.print_endline(false);
+
+    // the threads claim blocks of documents as they go, since documents
+    // vary a lot in length; each updates into its own worker's deltas
+    for (auto& w : workers_)
+        w.max_change = 0;
+    parallel::parallel_chunks(pool_, idx_->num_docs(), 0,
+                              [&](uint64_t task, uint64_t first, uint64_t last)
+                              {
+        update_block(workers_[task], doc_id{first}, doc_id{last});
+        progress.increment(last - first);
+    });
+
+    // reduce down the count changes into the global topic-term counts,
+    // with each block of terms reduced by a single thread
+    std::vector<std::future<void>> futures;
+    auto terms_per_task = (num_words_ + workers_.size() - 1)
+                          / workers_.size();
+    for (uint64_t first = 0; first < num_words_; first += terms_per_task)
+    {
+        auto last = std::min<uint64_t>(first + terms_per_task, num_words_);
+        futures.emplace_back(pool_.submit_task([this, first, last]()
+        {
+            reduce(term_id{first}, term_id{last});
+        }));
+    }
+    for (auto& fut : futures)
+        fut.get();
+
+    double max_change = 0;
+    for (auto& w : workers_)
+    {
+        for (topic_id k{0}; k < num_topics_; ++k)
+        {
+            topic_totals_[k] += w.topic_deltas[k];
+            w.topic_deltas[k] = 0;
+        }
+        max_change = std::max(max_change, w.max_change);
+    }
+    return max_change;
+}
+
+void parallel_lda_cvb::update_block(worker& w, doc_id first, doc_id last)
+{
+    // the loops over the topics that update counts are kept apart from
+    // the ones that sum over them, so that the former can be vectorized
+    // without reassociating floating point additions
+    double vbeta = num_words_ * beta_;
+    auto totals = topic_totals_.data();
+    auto topic_deltas = w.topic_deltas.data();
+    auto weights = w.weights.data();
+    for (auto d = first; d < last; ++d)
+    {
+        auto topics = doc_topics_.dense_row(d);
+        uint64_t i = 0; // position of the term within the document
+        for (const auto& freq : doc_terms_[d])
+        {
+            // the counts the thread sees for the term are the global ones
+            // plus its own changes to them
+            const double* terms = term_topics_.dense_row(freq.first);
+            auto deltas = &w.term_deltas[freq.first * num_topics_];
+            auto gamma = &gamma_[d][i * num_topics_];
+            auto weight = freq.second;
+
+            // remove this word's occurrences from the counts and compute
+            // the unnormalized probability of each topic
+            for (topic_id k{0}; k < num_topics_; ++k)
+            {
+                auto count = weight * gamma[k];
+                deltas[k] -= count;
+                topic_deltas[k] -= count;
+                topics[k] -= count;
+                weights[k] = (terms[k] + deltas[k] + beta_)
+                             / (totals[k] + topic_deltas[k] + vbeta)
+                             * (topics[k] + alpha_);
+            }
+
+            double sum = 0;
+            for (topic_id k{0}; k < num_topics_; ++k)
+                sum += weights[k];
+            for (topic_id k{0}; k < num_topics_; ++k)
+                weights[k] /= sum;
+
+            double delta = 0;
+            for (topic_id k{0}; k < num_topics_; ++k)
+                delta += std::abs(weights[k] - gamma[k]);
+            w.max_change = std::max(w.max_change, delta);
+
+            // recontribute expected counts
+            for (topic_id k{0}; k < num_topics_; ++k)
+            {
+                gamma[k] = weights[k];
+                auto count = weight * weights[k];
+                deltas[k] += count;
+                topic_deltas[k] += count;
+                topics[k] += count;
+            }
+            i += 1;
+        }
+    }
+}
+
+void parallel_lda_cvb::reduce(term_id first, term_id last)
+{
+    for (auto term = first; term < last; ++term)
+    {
+        auto terms = term_topics_.dense_row(term);
+        for (auto& w : workers_)
+        {
+            auto deltas = &w.term_deltas[term * num_topics_];
+            for (topic_id k{0}; k < num_topics_; ++k)
+            {
+                terms[k] += deltas[k];
+                deltas[k] = 0;
+            }
+        }
+    }
+}
+}
+}
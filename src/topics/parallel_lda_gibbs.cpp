@@ -3,20 +3,45 @@
  * @author Chase Geigle
  */
 
+#include <algorithm>
+
 #include "index/postings_data.h"
 #include "parallel/parallel_for.h"
 #include "topics/parallel_lda_gibbs.h"
-#include "util/range.h"
 
 namespace meta
 {
 namespace topics
 {
 
+util::memory_report parallel_lda_gibbs::memory_usage() const
+{
+    auto report = lda_gibbs::memory_usage();
+    util::memory_usage scratch;
+    for (const auto& w : workers_)
+    {
+        scratch += util::heap_memory(w.phi_deltas);
+        scratch += util::heap_memory(w.topic_deltas);
+        scratch += util::heap_memory(w.weights);
+    }
+    report.add("scratch", scratch);
+    return report;
+}
+
 void parallel_lda_gibbs::initialize()
 {
-    for (auto& id : pool_.thread_ids())
-        phi_diffs_[id].resize(num_topics_);
+    workers_.resize(pool_.thread_ids().size());
+    for (auto& w : workers_)
+        w.rng.seed(rng_());
+
+    // each worker allocates its own deltas, so they are placed near it
+    parallel::for_each_worker(pool_, [&](uint64_t idx)
+                              {
+        auto& w = workers_[idx];
+        w.phi_deltas.assign(num_words_ * num_topics_, 0);
+        w.topic_deltas.assign(num_topics_, 0);
+        w.weights.resize(num_topics_);
+    });
     lda_gibbs::initialize();
 }
 
@@ -28,81 +53,159 @@ void parallel_lda_gibbs::perform_iteration(uint64_t iter,
         str = "Initialization: ";
     else
         str = "Iteration " + std::to_string(iter) + ": ";
-    printing::progress progress{str, idx_->num_docs()};
+    printing::concurrent_progress progress{str, idx_->num_docs()};
     progress.print_endline(false);
 
-    auto range = util::range<doc_id>(doc_id{0}, doc_id{idx_->num_docs() - 1});
+    // the threads claim blocks of documents as they go, since documents
+    // vary a lot in length; each samples into its own worker's deltas
+    parallel::parallel_chunks(pool_, idx_->num_docs(), 0,
+                              [&](uint64_t task, uint64_t first, uint64_t last)
+                              {
+        sample_block(workers_[task], doc_id{first}, doc_id{last}, init);
+        progress.increment(last - first);
+    });
 
-    // clear out diffs
-    for (auto& phis : phi_diffs_)
-        for (auto& phi : phis.second)
-            phi.clear();
+    // reduce down the count changes into the global topic-term counts,
+    // with each block of terms reduced by a single thread
+    std::vector<std::future<void>> futures;
+    auto terms_per_task = (num_words_ + workers_.size() - 1)
+                          / workers_.size();
+    for (uint64_t first = 0; first < num_words_; first += terms_per_task)
+    {
+        auto last = std::min<uint64_t>(first + terms_per_task, num_words_);
+        futures.emplace_back(pool_.submit_task([this, first, last]()
+        {
+            reduce(term_id{first}, term_id{last});
+        }));
+    }
+    for (auto& fut : futures)
+        fut.get();
 
-    std::mutex mutex;
-    uint64_t assigned = 0;
-    parallel::parallel_for(range.begin(), range.end(), pool_, [&](doc_id i)
-                           {
+    for (topic_id topic{0}; topic < num_topics_; ++topic)
+    {
+        for (auto& w : workers_)
         {
-            std::lock_guard<std::mutex> lock{mutex};
-            progress(assigned++);
+            topic_totals_[topic] += w.topic_deltas[topic];
+            w.topic_deltas[topic] = 0;
         }
+    }
+}
+
+void parallel_lda_gibbs::sample_block(worker& w, doc_id first, doc_id last,
+                                      bool init)
+{
+    for (auto i = first; i < last; ++i)
+    {
         size_t n = 0; // term number within document---constructed
                       // so that each occurrence of the same term
                       // can still be assigned a different topic
-        for (const auto& freq : idx_->search_primary(i)->counts())
+        for (const auto& freq : doc_terms_[i])
         {
+            auto deltas = &w.phi_deltas[freq.first * num_topics_];
             for (size_t j = 0; j < freq.second; ++j)
             {
-                auto old_topic = doc_word_topic_[i][n];
                 // don't include current topic assignment in
                 // probability calculation
                 if (!init)
-                    decrease_counts(old_topic, freq.first, i);
+                {
+                    auto old_topic = doc_word_topic_(i, n);
+                    --deltas[old_topic];
+                    --w.topic_deltas[old_topic];
+                    doc_topics_.decrement(i, old_topic);
+                }
 
                 // sample a new topic assignment
-                auto topic = sample_topic(freq.first, i);
-                doc_word_topic_[i][n] = topic;
+                auto topic = sample_topic(w, freq.first, i);
+                doc_word_topic_.assign(i, n, topic);
 
                 // increase counts
-                increase_counts(topic, freq.first, i);
+                ++deltas[topic];
+                ++w.topic_deltas[topic];
+                doc_topics_.increment(i, topic);
                 n += 1;
             }
         }
-    });
-
-    // reduce down the distribution diffs for phi into the global
-    // distributions for phi
-    for (const auto& phis_pair : phi_diffs_)
-    {
-        const auto& phis = phis_pair.second;
-        for (topic_id topic{0}; topic < phis.size(); ++topic)
-            phi_[topic] += phis[topic];
     }
 }
 
-void parallel_lda_gibbs::decrease_counts(topic_id topic, term_id term,
-                                         doc_id doc)
+double parallel_lda_gibbs::corpus_log_likelihood() const
 {
-    auto tid = std::this_thread::get_id();
-    phi_diffs_[tid][topic].decrement(term, 1);
-    theta_[doc].decrement(topic, 1);
+    std::vector<std::future<double>> futures;
+    auto terms_per_task = (num_words_ + workers_.size() - 1)
+                          / workers_.size();
+    for (uint64_t first = 0; first < num_words_; first += terms_per_task)
+    {
+        auto last = std::min<uint64_t>(first + terms_per_task, num_words_);
+        futures.emplace_back(pool_.submit_task([this, first, last]()
+        {
+            return term_log_likelihood(term_id{first}, term_id{last});
+        }));
+    }
+
+    auto likelihood = topic_log_likelihood();
+    for (auto& fut : futures)
+        likelihood += fut.get();
+    return likelihood;
 }
 
-void parallel_lda_gibbs::increase_counts(topic_id topic, term_id term,
-                                         doc_id doc)
+topic_id parallel_lda_gibbs::sample_topic(worker& w, term_id term,
+                                          doc_id doc)
 {
-    auto tid = std::this_thread::get_id();
-    phi_diffs_[tid][topic].increment(term, 1);
-    theta_[doc].increment(topic, 1);
+    // the counts the thread sees for the term are the global ones plus its
+    // own changes to them
+    const auto deltas = &w.phi_deltas[term * num_topics_];
+    for (topic_id topic{0}; topic < num_topics_; ++topic)
+        w.weights[topic] = deltas[topic] + beta_;
+    term_topics_.each_topic(term, [&](topic_id topic, uint32_t count)
+                            {
+        w.weights[topic] += count;
+    });
+
+    double vbeta = num_words_ * beta_;
+    double total = 0;
+    for (topic_id topic{0}; topic < num_topics_; ++topic)
+    {
+        total += w.weights[topic]
+                 / (topic_totals_[topic] + w.topic_deltas[topic] + vbeta)
+                 * (doc_topics_(doc, topic) + alpha_);
+        w.weights[topic] = total;
+    }
+
+    std::uniform_real_distribution<double> dist{0, total};
+    auto it = std::upper_bound(w.weights.begin(), w.weights.end(), dist(w.rng));
+    return topic_id{std::min<uint64_t>(it - w.weights.begin(),
+                                       num_topics_ - 1)};
 }
 
-double parallel_lda_gibbs::compute_sampling_weight(term_id term, doc_id doc,
-                                                   topic_id topic) const
+void parallel_lda_gibbs::reduce(term_id first, term_id last)
 {
-    auto tid = std::this_thread::get_id();
-    return (phi_[topic].counts(term) + phi_diffs_.at(tid)[topic].counts(term))
-           / (phi_[topic].counts() + phi_diffs_.at(tid)[topic].counts())
-           * compute_doc_topic_probability(doc, topic);
+    std::vector<int64_t> deltas(num_topics_);
+    for (auto term = first; term < last; ++term)
+    {
+        for (topic_id topic{0}; topic < num_topics_; ++topic)
+        {
+            deltas[topic] = 0;
+            for (auto& w : workers_)
+            {
+                auto& d = w.phi_deltas[term * num_topics_ + topic];
+                deltas[topic] += d;
+                d = 0;
+            }
+        }
+
+        // removals go first, so that a full sparse row has room for the
+        // topics the term moved to
+        for (topic_id topic{0}; topic < num_topics_; ++topic)
+        {
+            if (deltas[topic] < 0)
+                term_topics_.decrement(term, topic, -deltas[topic]);
+        }
+        for (topic_id topic{0}; topic < num_topics_; ++topic)
+        {
+            if (deltas[topic] > 0)
+                term_topics_.increment(term, topic, deltas[topic]);
+        }
+    }
 }
 }
 }
@@ -0,0 +1,353 @@
+/** @file sparse_lda_gibbs.cpp */
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+#include "index/postings_data.h"
+#include "logging/logger.h"
+#include "topics/sparse_lda_gibbs.h"
+#include "util/metrics.h"
+#include "util/progress.h"
+
+namespace meta
+{
+namespace topics
+{
+
+namespace
+{
+/**
+ * @param idx The index holding the documents
+ * @return the number of words in each document
+ */
+std::vector<uint64_t> doc_lengths(const index::forward_index& idx)
+{
+    std::vector<uint64_t> lengths(idx.num_docs());
+    for (doc_id doc{0}; doc < idx.num_docs(); ++doc)
+        lengths[doc] = idx.doc_size(doc);
+    return lengths;
+}
+}
+
+sparse_lda_gibbs::sparse_lda_gibbs(std::shared_ptr<index::forward_index> idx,
+                                   uint64_t num_topics, double alpha,
+                                   double beta)
+    : lda_model{std::move(idx), num_topics},
+      alpha_{alpha},
+      beta_{beta},
+      count_log_gammas_{beta_},
+      doc_word_topic_{doc_lengths(*idx_), num_topics_},
+      term_topics_(num_words_),
+      doc_topics_(idx_->num_docs()),
+      topic_totals_(num_topics_, 0),
+      doc_counts_(num_topics_, 0),
+      doc_positions_(num_topics_, 0),
+      coefficients_(num_topics_, 0.0),
+      smoothing_mass_{0},
+      doc_mass_{0}
+{
+    std::random_device dev;
+    rng_.seed(dev());
+}
+
+util::memory_report sparse_lda_gibbs::memory_usage() const
+{
+    auto report = lda_model::memory_usage();
+    report.add("assignments", doc_word_topic_.memory_usage());
+    report.add("term-topics", util::heap_memory(term_topics_));
+    report.add("term-topics", util::heap_memory(topic_totals_));
+    report.add("doc-topics", util::heap_memory(doc_topics_));
+
+    auto scratch = util::heap_memory(doc_counts_);
+    scratch += util::heap_memory(doc_nonzero_);
+    scratch += util::heap_memory(doc_positions_);
+    scratch += util::heap_memory(coefficients_);
+    scratch += util::heap_memory(term_weights_);
+    report.add("scratch", scratch);
+    return report;
+}
+
+void sparse_lda_gibbs::run(uint64_t num_iters, double convergence)
+{
+    perform_iteration(0, true);
+    double likelihood = corpus_log_likelihood();
+    std::stringstream ss;
+    ss << "Initialization log likelihood (log P(W|Z)): " << likelihood;
+    std::string spacing(std::max<int>(0, 80 - ss.tellp()), ' ');
+    ss << spacing;
+    LOG(progress) << '\r' << ss.str() << '\n' << ENDLG;
+
+    for (uint64_t i = 0; i < num_iters; ++i)
+    {
+        {
+            metrics::scoped_timer timer{"lda_iteration_ns"};
+            perform_iteration(i + 1, false);
+        }
+        // the likelihood is a pass over all of the counts, so it is only
+        // evaluated every eval_interval_ iterations
+        if ((i + 1) % eval_interval_ != 0 && i + 1 != num_iters)
+            continue;
+        double likelihood_update = corpus_log_likelihood();
+        double ratio = std::fabs((likelihood - likelihood_update) / likelihood);
+        likelihood = likelihood_update;
+        std::stringstream ss;
+        ss << "Iteration " << i + 1
+           << " log likelihood (log P(W|Z)): " << likelihood;
+        std::string spacing(std::max<int>(0, 80 - ss.tellp()), ' ');
+        ss << spacing;
+        LOG(progress) << '\r' << ss.str() << '\n' << ENDLG;
+        if (ratio <= convergence)
+        {
+            LOG(progress) << "Found convergence after " << i + 1
+                          << " iterations!\n" << ENDLG;
+            break;
+        }
+    }
+    LOG(info) << "Finished maximum iterations, or found convergence!" << ENDLG;
+}
+
+void sparse_lda_gibbs::perform_iteration(uint64_t iter, bool init)
+{
+    std::string str;
+    if (init)
+        str = "Initialization: ";
+    else
+        str = "Iteration " + std::to_string(iter) + ": ";
+    printing::progress progress{str, idx_->num_docs()};
+    progress.print_endline(false);
+
+    // the smoothing mass drifts as it is updated, so it is recomputed
+    // exactly once per iteration
+    double vbeta = num_words_ * beta_;
+    smoothing_mass_ = 0;
+    for (topic_id j{0}; j < num_topics_; ++j)
+    {
+        smoothing_mass_ += alpha_ * beta_ / (vbeta + topic_totals_[j]);
+        coefficients_[j] = alpha_ / (vbeta + topic_totals_[j]);
+    }
+
+    for (const auto& i : idx_->docs())
+    {
+        progress(i);
+        load_doc(i, init);
+        uint64_t n = 0; // term number within document---constructed
+                        // so that each occurrence of the same term
+                        // can still be assigned a different topic
+        for (const auto& freq : doc_terms_[i])
+        {
+            for (uint64_t j = 0; j < freq.second; ++j)
+            {
+                // don't include current topic assignment in
+                // probability calculation
+                if (!init)
+                    decrease_counts(doc_word_topic_(i, n), freq.first);
+
+                auto topic = sample_topic(freq.first);
+                doc_word_topic_.assign(i, n, topic);
+                increase_counts(topic, freq.first);
+                n += 1;
+            }
+        }
+        store_doc(i);
+    }
+}
+
+void sparse_lda_gibbs::load_doc(doc_id doc, bool init)
+{
+    // topics of the previous document go back to a zero count
+    double vbeta = num_words_ * beta_;
+    for (const auto& j : doc_nonzero_)
+    {
+        doc_counts_[j] = 0;
+        coefficients_[j] = alpha_ / (vbeta + topic_totals_[j]);
+    }
+    doc_nonzero_.clear();
+
+    doc_mass_ = 0;
+    if (init)
+        return;
+    for (const auto& tc : doc_topics_[doc])
+    {
+        doc_counts_[tc.topic] = tc.count;
+        doc_positions_[tc.topic] = doc_nonzero_.size();
+        doc_nonzero_.push_back(tc.topic);
+        auto denom = vbeta + topic_totals_[tc.topic];
+        doc_mass_ += tc.count * beta_ / denom;
+        coefficients_[tc.topic] = (alpha_ + tc.count) / denom;
+    }
+}
+
+void sparse_lda_gibbs::store_doc(doc_id doc)
+{
+    auto& topics = doc_topics_[doc];
+    topics.clear();
+    for (const auto& j : doc_nonzero_)
+        topics.push_back({j, doc_counts_[j]});
+    std::sort(topics.begin(), topics.end(),
+              [](const topic_count& a, const topic_count& b)
+              {
+        return a.topic < b.topic;
+    });
+}
+
+topic_id sparse_lda_gibbs::sample_topic(term_id term)
+{
+    const auto& topics = term_topics_[term];
+    term_weights_.resize(topics.size());
+    double term_mass = 0;
+    for (uint64_t i = 0; i < topics.size(); ++i)
+    {
+        term_weights_[i] = coefficients_[topics[i].topic] * topics[i].count;
+        term_mass += term_weights_[i];
+    }
+
+    std::uniform_real_distribution<double> dist{
+        0, smoothing_mass_ + doc_mass_ + term_mass};
+    auto u = dist(rng_);
+
+    // the term bucket usually holds most of the mass
+    if (u < term_mass)
+    {
+        for (uint64_t i = 0; i < topics.size(); ++i)
+        {
+            u -= term_weights_[i];
+            if (u <= 0)
+                return topics[i].topic;
+        }
+        return topics.back().topic;
+    }
+    u -= term_mass;
+
+    double vbeta = num_words_ * beta_;
+    if (u < doc_mass_ && !doc_nonzero_.empty())
+    {
+        for (const auto& j : doc_nonzero_)
+        {
+            u -= doc_counts_[j] * beta_ / (vbeta + topic_totals_[j]);
+            if (u <= 0)
+                return j;
+        }
+        return doc_nonzero_.back();
+    }
+    u -= doc_mass_;
+
+    for (topic_id j{0}; j < num_topics_; ++j)
+    {
+        u -= alpha_ * beta_ / (vbeta + topic_totals_[j]);
+        if (u <= 0)
+            return j;
+    }
+    return topic_id{num_topics_ - 1};
+}
+
+void sparse_lda_gibbs::update_masses(topic_id topic, double sign)
+{
+    auto denom = num_words_ * beta_ + topic_totals_[topic];
+    smoothing_mass_ += sign * alpha_ * beta_ / denom;
+    doc_mass_ += sign * doc_counts_[topic] * beta_ / denom;
+    coefficients_[topic] = (alpha_ + doc_counts_[topic]) / denom;
+}
+
+void sparse_lda_gibbs::decrease_counts(topic_id topic, term_id term)
+{
+    update_masses(topic, -1);
+    --topic_totals_[topic];
+    if (--doc_counts_[topic] == 0)
+    {
+        // swap the topic out of the document's nonzero topics
+        auto pos = doc_positions_[topic];
+        doc_nonzero_[pos] = doc_nonzero_.back();
+        doc_positions_[doc_nonzero_[pos]] = pos;
+        doc_nonzero_.pop_back();
+    }
+    update_masses(topic, 1);
+
+    // move the topic towards the back of the term's topics, dropping it
+    // once its count reaches zero
+    auto& topics = term_topics_[term];
+    auto it = std::find_if(topics.begin(), topics.end(),
+                           [&](const topic_count& tc)
+                           {
+        return tc.topic == topic;
+    });
+    --it->count;
+    for (; it + 1 != topics.end() && (it + 1)->count > it->count; ++it)
+        std::swap(*it, *(it + 1));
+    if (topics.back().count == 0)
+        topics.pop_back();
+}
+
+void sparse_lda_gibbs::increase_counts(topic_id topic, term_id term)
+{
+    update_masses(topic, -1);
+    ++topic_totals_[topic];
+    if (doc_counts_[topic]++ == 0)
+    {
+        doc_positions_[topic] = doc_nonzero_.size();
+        doc_nonzero_.push_back(topic);
+    }
+    update_masses(topic, 1);
+
+    // move the topic towards the front of the term's topics
+    auto& topics = term_topics_[term];
+    auto it = std::find_if(topics.begin(), topics.end(),
+                           [&](const topic_count& tc)
+                           {
+        return tc.topic == topic;
+    });
+    if (it == topics.end())
+    {
+        topics.push_back({topic, 0});
+        it = topics.end() - 1;
+    }
+    ++it->count;
+    for (; it != topics.begin() && (it - 1)->count < it->count; --it)
+        std::swap(*it, *(it - 1));
+}
+
+double sparse_lda_gibbs::compute_term_topic_probability(term_id term,
+                                                        topic_id topic) const
+{
+    uint64_t count = 0;
+    for (const auto& tc : term_topics_[term])
+    {
+        if (tc.topic == topic)
+        {
+            count = tc.count;
+            break;
+        }
+    }
+    return (count + beta_) / (topic_totals_[topic] + num_words_ * beta_);
+}
+
+double sparse_lda_gibbs::compute_doc_topic_probability(doc_id doc,
+                                                       topic_id topic) const
+{
+    const auto& topics = doc_topics_[doc];
+    auto it = std::lower_bound(topics.begin(), topics.end(), topic,
+                               [](const topic_count& tc, topic_id j)
+                               {
+        return tc.topic < j;
+    });
+    uint64_t count = it != topics.end() && it->topic == topic ? it->count : 0;
+    return (count + alpha_)
+           / (doc_word_topic_.size(doc) + num_topics_ * alpha_);
+}
+
+double sparse_lda_gibbs::corpus_log_likelihood() const
+{
+    // terms with no words in a topic contribute nothing
+    double vbeta = num_words_ * beta_;
+    double likelihood = num_topics_ * std::lgamma(vbeta);
+    for (const auto& topics : term_topics_)
+    {
+        for (const auto& tc : topics)
+            likelihood += count_log_gammas_(tc.count);
+    }
+    for (const auto& total : topic_totals_)
+        likelihood -= std::lgamma(total + vbeta);
+    return likelihood;
+}
+}
+}
@@ -0,0 +1,402 @@
+/**
+ * @file spherical_kmeans.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <numeric>
+#include <random>
+
+#include "io/binary.h"
+#include "logging/logger.h"
+#include "parallel/default_pool.h"
+#include "parallel/parallel_for.h"
+#include "topics/spherical_kmeans.h"
+#include "util/dense_ops.h"
+
+namespace meta
+{
+namespace topics
+{
+
+spherical_kmeans::spherical_kmeans(std::shared_ptr<index::forward_index> idx,
+                                   const kmeans_options& options)
+    : idx_{std::move(idx)},
+      options_(options),
+      doc_terms_{idx_->materialize(idx_->docs())},
+      doc_norms_(doc_terms_.rows(), 0.0),
+      centroids_{idx_->unique_terms(), options.num_clusters},
+      centroid_norms_(options.num_clusters, 0.0),
+      centroid_scales_(options.num_clusters, 1.0),
+      centroid_counts_(options.num_clusters, 0),
+      centroid_sums_(options.num_clusters, 0.0),
+      assignments_(doc_terms_.rows(), 0),
+      similarities_(doc_terms_.rows(), 0.0f)
+{
+    if (options_.num_clusters == 0)
+        throw kmeans_exception{"k-means needs at least one cluster"};
+    if (options_.num_clusters > doc_terms_.rows())
+        throw kmeans_exception{"k-means cannot make more clusters than "
+                               "there are documents"};
+
+    for (uint64_t r = 0; r < doc_terms_.rows(); ++r)
+    {
+        double norm = 0;
+        for (const auto& count : doc_terms_[r])
+            norm += count.second * count.second;
+        doc_norms_[r] = std::sqrt(norm);
+    }
+}
+
+void spherical_kmeans::run()
+{
+    run(parallel::default_pool());
+}
+
+void spherical_kmeans::run(parallel::thread_pool& pool)
+{
+    seed(pool);
+
+    std::vector<uint64_t> all(doc_terms_.rows());
+    std::iota(all.begin(), all.end(), 0);
+
+    if (options_.batch_size == 0)
+    {
+        for (uint64_t iter = 0;; ++iter)
+        {
+            auto changed = assign(all, pool);
+            LOG(progress) << "> Iteration " << iter + 1 << ": " << changed
+                          << " documents moved, mean similarity "
+                          << objective() << '\n' << ENDLG;
+            if (changed <= options_.convergence * all.size()
+                || iter == options_.max_iters)
+                break;
+            update(pool);
+        }
+    }
+    else
+    {
+        std::mt19937_64 rng{options_.seed + 1};
+        std::uniform_int_distribution<uint64_t> pick{0, all.size() - 1};
+        std::vector<uint64_t> batch;
+        for (uint64_t iter = 0; iter < options_.max_iters; ++iter)
+        {
+            // a document drawn twice is assigned once, so that no two
+            // threads assign it at once
+            batch.resize(options_.batch_size);
+            for (auto& row : batch)
+                row = pick(rng);
+            std::sort(batch.begin(), batch.end());
+            batch.erase(std::unique(batch.begin(), batch.end()), batch.end());
+            assign(batch, pool);
+            for (const auto& row : batch)
+                step(row);
+        }
+        assign(all, pool);
+        LOG(progress) << "> " << options_.max_iters
+                      << " mini-batches: mean similarity " << objective()
+                      << '\n' << ENDLG;
+    }
+
+    for (uint64_t c = 0; c < options_.num_clusters; ++c)
+        fold_scale(c);
+    LOG(info) << "Finished clustering" << ENDLG;
+}
+
+void spherical_kmeans::seed(parallel::thread_pool& pool)
+{
+    // k-means++: each centroid after the first is a document drawn with
+    // probability proportional to its distance from the nearest centroid
+    // so far; documents without terms are never drawn
+    std::mt19937_64 rng{options_.seed};
+    auto num_docs = doc_terms_.rows();
+    std::vector<float> nearest(num_docs, -1.0f);
+    std::vector<double> distance(num_docs, 0.0);
+
+    uint64_t row = std::uniform_int_distribution<uint64_t>{0, num_docs - 1}(
+        rng);
+    for (uint64_t c = 0; c < options_.num_clusters; ++c)
+    {
+        set_centroid(c, row);
+        parallel::parallel_chunks(
+            pool, num_docs, 0, [&](uint64_t, uint64_t first, uint64_t last)
+            {
+                for (auto r = first; r < last; ++r)
+                {
+                    if (doc_norms_[r] == 0)
+                        continue;
+                    double dot = 0;
+                    for (const auto& count : doc_terms_[r])
+                        dot += count.second * centroids_(count.first, c);
+                    auto sim = static_cast<float>(dot / doc_norms_[r]);
+                    nearest[r] = std::max(nearest[r], sim);
+                    distance[r] = std::max(0.0, 1.0 - nearest[r]);
+                }
+            });
+
+        double total = 0;
+        for (const auto& d : distance)
+            total += d;
+        if (total <= 0)
+        {
+            // every document is on a centroid already
+            row = std::uniform_int_distribution<uint64_t>{0, num_docs - 1}(
+                rng);
+            continue;
+        }
+        auto target = std::uniform_real_distribution<double>{0, total}(rng);
+        for (row = 0; row + 1 < num_docs; ++row)
+        {
+            target -= distance[row];
+            if (target < 0)
+                break;
+        }
+    }
+}
+
+void spherical_kmeans::set_centroid(uint64_t cluster, uint64_t row)
+{
+    for (uint64_t t = 0; t < centroids_.rows(); ++t)
+        centroids_(t, cluster) = 0;
+    for (const auto& count : doc_terms_[row])
+        centroids_(count.first, cluster)
+            = static_cast<float>(count.second / doc_norms_[row]);
+    centroid_norms_[cluster] = doc_norms_[row] == 0 ? 0.0 : 1.0;
+    centroid_scales_[cluster] = 1.0;
+    centroid_counts_[cluster] = 1;
+}
+
+void spherical_kmeans::dot_products(uint64_t row,
+                                    std::vector<float>& sims) const
+{
+    sims.assign(options_.num_clusters, 0.0f);
+    for (const auto& count : doc_terms_[row])
+        util::dense::axpy(static_cast<float>(count.second),
+                          centroids_.row(count.first), sims.data(),
+                          sims.size());
+}
+
+uint64_t spherical_kmeans::assign(const std::vector<uint64_t>& rows,
+                                  parallel::thread_pool& pool)
+{
+    auto num_tasks = pool.thread_ids().size();
+    std::vector<std::vector<float>> sims(num_tasks);
+    std::vector<uint64_t> changed(num_tasks, 0);
+    parallel::parallel_chunks(
+        pool, rows.size(), 0, [&](uint64_t task, uint64_t first, uint64_t last)
+        {
+            for (auto i = first; i < last; ++i)
+            {
+                auto row = rows[i];
+                if (doc_norms_[row] == 0)
+                    continue;
+                dot_products(row, sims[task]);
+
+                uint64_t best = 0;
+                double best_sim = -1;
+                for (uint64_t c = 0; c < options_.num_clusters; ++c)
+                {
+                    if (centroid_norms_[c] == 0)
+                        continue;
+                    auto sim = sims[task][c] / centroid_norms_[c];
+                    if (sim > best_sim)
+                    {
+                        best = c;
+                        best_sim = sim;
+                    }
+                }
+                if (best != assignments_[row])
+                    ++changed[task];
+                assignments_[row] = best;
+                similarities_[row]
+                    = static_cast<float>(std::max(0.0, best_sim)
+                                         / doc_norms_[row]);
+            }
+        });
+
+    uint64_t total = 0;
+    for (const auto& c : changed)
+        total += c;
+    return total;
+}
+
+void spherical_kmeans::update(parallel::thread_pool& pool)
+{
+    std::vector<std::vector<uint64_t>> members(options_.num_clusters);
+    for (uint64_t r = 0; r < doc_terms_.rows(); ++r)
+        if (doc_norms_[r] > 0)
+            members[assignments_[r]].push_back(r);
+
+    // each task sums the unit vectors of one cluster's documents at a
+    // time into a dense buffer, then writes that cluster's weights
+    std::vector<std::vector<double>> sums(pool.thread_ids().size());
+    parallel::parallel_chunks(
+        pool, options_.num_clusters, 1,
+        [&](uint64_t task, uint64_t first, uint64_t last)
+        {
+            auto& sum = sums[task];
+            for (auto c = first; c < last; ++c)
+            {
+                // a cluster that lost all of its documents keeps its
+                // centroid, so that it may win some back
+                if (members[c].empty())
+                    continue;
+                sum.assign(centroids_.rows(), 0.0);
+                for (const auto& r : members[c])
+                    for (const auto& count : doc_terms_[r])
+                        sum[count.first] += count.second / doc_norms_[r];
+
+                double norm = 0;
+                for (uint64_t t = 0; t < sum.size(); ++t)
+                {
+                    centroids_(t, c) = static_cast<float>(sum[t]);
+                    norm += sum[t] * sum[t];
+                }
+                centroid_norms_[c] = std::sqrt(norm);
+                centroid_scales_[c] = 1.0;
+                centroid_counts_[c] = members[c].size();
+            }
+        });
+}
+
+void spherical_kmeans::step(uint64_t row)
+{
+    if (doc_norms_[row] == 0)
+        return;
+
+    // the centroid becomes (1 - rate) * centroid + rate * document; the
+    // shrinking goes into the scale, and the stored weights only gain the
+    // document, so the norm is updated from the document's terms alone
+    auto c = assignments_[row];
+    auto rate = 1.0 / ++centroid_counts_[c];
+    centroid_scales_[c] *= 1 - rate;
+    auto weight = rate / centroid_scales_[c];
+
+    double dot = 0;
+    for (const auto& count : doc_terms_[row])
+        dot += centroids_(count.first, c) * count.second / doc_norms_[row];
+    auto norm = centroid_norms_[c];
+    centroid_norms_[c]
+        = std::sqrt(std::max(0.0, norm * norm + 2 * weight * dot
+                                      + weight * weight));
+    for (const auto& count : doc_terms_[row])
+        centroids_(count.first, c) += static_cast<float>(
+            weight * count.second / doc_norms_[row]);
+
+    // keep the stored weights from growing without bound as the scale
+    // shrinks
+    if (centroid_scales_[c] < 1e-6)
+        fold_scale(c);
+}
+
+void spherical_kmeans::fold_scale(uint64_t cluster)
+{
+    auto scale = centroid_scales_[cluster];
+    double norm = 0;
+    double sum = 0;
+    for (uint64_t t = 0; t < centroids_.rows(); ++t)
+    {
+        auto& weight = centroids_(t, cluster);
+        weight = static_cast<float>(weight * scale);
+        norm += static_cast<double>(weight) * weight;
+        sum += weight;
+    }
+    centroid_norms_[cluster] = std::sqrt(norm);
+    centroid_sums_[cluster] = sum;
+    centroid_scales_[cluster] = 1.0;
+}
+
+topic_id spherical_kmeans::cluster(doc_id d_id) const
+{
+    return topic_id{assignments_.at(d_id)};
+}
+
+double spherical_kmeans::similarity(doc_id d_id) const
+{
+    return similarities_.at(d_id);
+}
+
+double spherical_kmeans::term_weight(topic_id cluster, term_id t_id) const
+{
+    auto sum = centroid_sums_.at(cluster);
+    return sum > 0 ? centroids_(t_id, cluster) / sum : 0.0;
+}
+
+double spherical_kmeans::objective() const
+{
+    double total = 0;
+    for (const auto& sim : similarities_)
+        total += sim;
+    return similarities_.empty() ? 0.0 : total / similarities_.size();
+}
+
+void spherical_kmeans::save(const std::string& prefix) const
+{
+    {
+        std::ofstream file{prefix + ".assignments"};
+        for (uint64_t r = 0; r < doc_terms_.rows(); ++r)
+            file << doc_terms_.doc(r) << "\t" << assignments_[r] << "\t"
+                 << similarities_[r] << "\n";
+    }
+
+    {
+        std::vector<uint64_t> sizes(options_.num_clusters, 0);
+        for (const auto& c : assignments_)
+            ++sizes[c];
+
+        std::ofstream file{prefix + ".clusters"};
+        std::vector<std::pair<double, term_id>> weights;
+        for (topic_id c{0}; c < options_.num_clusters; ++c)
+        {
+            weights.clear();
+            for (term_id t{0}; t < centroids_.rows(); ++t)
+            {
+                auto weight = term_weight(c, t);
+                if (weight > 0)
+                    weights.emplace_back(weight, t);
+            }
+            std::sort(weights.begin(), weights.end(),
+                      [](const std::pair<double, term_id>& a,
+                         const std::pair<double, term_id>& b)
+                      {
+                return a.first > b.first;
+            });
+
+            file << c << "\t" << sizes[c];
+            for (const auto& weight : weights)
+                file << "\t" << weight.second << ":" << weight.first;
+            file << "\n";
+        }
+    }
+
+    std::ofstream file{prefix + ".topics", std::ios::binary};
+    io::write_binary(file, static_cast<uint64_t>(options_.num_clusters));
+    io::write_binary(file, static_cast<uint64_t>(centroids_.rows()));
+    for (term_id t{0}; t < centroids_.rows(); ++t)
+        for (topic_id c{0}; c < options_.num_clusters; ++c)
+            io::write_binary(file, static_cast<float>(term_weight(c, t)));
+}
+
+util::memory_report spherical_kmeans::memory_usage() const
+{
+    util::memory_report report;
+    report.add("doc-terms", doc_terms_.memory_usage());
+
+    util::memory_usage centroids;
+    centroids.heap_bytes
+        = centroids_.rows() * centroids_.columns() * sizeof(float);
+    centroids += util::heap_memory(centroid_norms_);
+    centroids += util::heap_memory(centroid_scales_);
+    centroids += util::heap_memory(centroid_counts_);
+    centroids += util::heap_memory(centroid_sums_);
+    report.add("centroids", centroids);
+
+    util::memory_usage assignments = util::heap_memory(assignments_);
+    assignments += util::heap_memory(similarities_);
+    assignments += util::heap_memory(doc_norms_);
+    report.add("assignments", assignments);
+    return report;
+}
+}
+}
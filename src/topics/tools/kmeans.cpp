@@ -0,0 +1,73 @@
+#include <iostream>
+#include <string>
+
+#include "cpptoml.h"
+
+#include "caching/no_evict_cache.h"
+#include "index/forward_index.h"
+#include "logging/logger.h"
+#include "parallel/default_pool.h"
+#include "topics/spherical_kmeans.h"
+
+using namespace meta;
+
+/**
+ * Clusters the documents of a forward index with spherical k-means, as
+ * set by the `[kmeans]` table of the config file: `clusters` and
+ * `model-prefix` are required, and `max-iters`, `convergence`,
+ * `batch-size`, and `seed` are optional.
+ */
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        std::cerr << "Usage:\t" << argv[0] << " configFile" << std::endl;
+        return 1;
+    }
+
+    logging::set_cerr_logging();
+
+    auto config = cpptoml::parse_file(argv[1]);
+    parallel::configure_default_pool(config);
+
+    auto group = config.get_table("kmeans");
+    if (!group)
+    {
+        std::cerr << "Missing kmeans configuration group in " << argv[1]
+                  << std::endl;
+        return 1;
+    }
+
+    auto clusters = group->get_as<int64_t>("clusters");
+    auto prefix = group->get_as<std::string>("model-prefix");
+    if (!clusters || !prefix)
+    {
+        std::cerr << "kmeans configuration group needs clusters and "
+                     "model-prefix" << std::endl;
+        return 1;
+    }
+
+    topics::kmeans_options options;
+    options.num_clusters = static_cast<uint64_t>(*clusters);
+    if (auto iters = group->get_as<int64_t>("max-iters"))
+        options.max_iters = static_cast<uint64_t>(*iters);
+    if (auto convergence = group->get_as<double>("convergence"))
+        options.convergence = *convergence;
+    if (auto batch_size = group->get_as<int64_t>("batch-size"))
+        options.batch_size = static_cast<uint64_t>(*batch_size);
+    if (auto seed = group->get_as<int64_t>("seed"))
+        options.seed = static_cast<uint64_t>(*seed);
+
+    auto f_idx
+        = index::make_index<index::forward_index, caching::no_evict_cache>(
+            argv[1]);
+
+    std::cout << "Beginning spherical k-means with " << options.num_clusters
+              << " clusters..." << std::endl;
+    topics::spherical_kmeans model{f_idx, options};
+    model.run();
+    model.save(*prefix);
+    std::cout << "Mean similarity to centroids: " << model.objective()
+              << std::endl;
+    return 0;
+}
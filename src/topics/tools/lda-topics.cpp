@@ -5,6 +5,7 @@
 
 #include "caching/no_evict_cache.h"
 #include "index/forward_index.h"
+#include "topics/topic_model_file.h"
 
 using namespace meta;
 
@@ -14,13 +15,44 @@ int print_usage(const std::string& name)
         << "Usage: " << name
         << " config_file model.phi num_words \n"
            "\tPrints the top num_words words in each topic in the given model"
+           "\n\t(model.phi or model.phi.bin)"
         << std::endl;
     return 1;
 }
 
+int print_binary_topics(const std::string& config_file,
+                        const std::string& filename, size_t num_words)
+{
+    auto idx = index::make_index<index::forward_index, caching::no_evict_cache>(
+        config_file);
+
+    // the terms of each topic are already in decreasing order of score
+    topics::topic_top_terms top_terms{filename};
+    num_words = std::min<uint64_t>(num_words, top_terms.terms_per_topic());
+    for (topic_id k{0}; k < top_terms.num_topics(); ++k)
+    {
+        std::cout << "Topic " << k << ":" << std::endl;
+        std::cout << "-----------------------" << std::endl;
+        for (uint64_t i = 0; i < num_words; ++i)
+        {
+            auto term = top_terms.term(k, i);
+            std::cout << idx->term_text(term) << " (" << term
+                      << "): " << top_terms.score(k, i) << std::endl;
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
 int print_topics(const std::string& config_file, const std::string& filename,
                  size_t num_words)
 {
+    auto ext = std::string{".bin"};
+    if (filename.size() >= ext.size()
+        && filename.compare(filename.size() - ext.size(), ext.size(), ext)
+               == 0)
+        return print_binary_topics(config_file, filename, num_words);
+
     auto idx = index::make_index<index::forward_index, caching::no_evict_cache>(
         config_file);
 
@@ -2,24 +2,32 @@
 #include <string>
 #include <vector>
 
+#include "topics/distributed_lda_gibbs.h"
 #include "topics/lda_gibbs.h"
+#include "topics/parallel_lda_cvb.h"
 #include "topics/parallel_lda_gibbs.h"
 #include "topics/lda_cvb.h"
 #include "topics/lda_scvb.h"
+#include "topics/sparse_lda_gibbs.h"
 
 #include "cpptoml.h"
 
 #include "caching/no_evict_cache.h"
 #include "index/forward_index.h"
 #include "logging/logger.h"
+#include "parallel/default_pool.h"
 
 using namespace meta;
 
-template <class Model, class Index>
-int run_lda(Index& idx, uint64_t num_iters, uint64_t topics, double alpha,
-            double beta, const std::string& save_prefix)
+template <class Model, class Index, class... Args>
+int run_lda(Index& idx, uint64_t num_iters, uint64_t eval_interval,
+            uint64_t top_terms, uint64_t topics, double alpha, double beta,
+            const std::string& save_prefix, Args&&... args)
 {
-    Model model{idx, topics, alpha, beta};
+    Model model{idx, topics, alpha, beta, std::forward<Args>(args)...};
+    model.evaluation_interval(eval_interval);
+    if (top_terms > 0)
+        model.binary_output(top_terms);
     model.run(num_iters);
     model.save(save_prefix);
     return 0;
@@ -41,6 +49,7 @@ int run_lda(const std::string& config_file)
 {
     using namespace meta::topics;
     auto config = cpptoml::parse_file(config_file);
+    parallel::configure_default_pool(config);
 
     if (!config.contains("lda"))
     {
@@ -66,6 +75,37 @@ int run_lda(const std::string& config_file)
     uint64_t topics = *lda_group->get_as<int64_t>("topics");
     auto save_prefix = *lda_group->get_as<std::string>("model-prefix");
 
+    // the Gibbs samplers' log likelihood may be evaluated only every few
+    // iterations, since it is a pass over all of the counts
+    uint64_t eval_interval = 1;
+    if (auto interval = lda_group->get_as<int64_t>("eval-interval"))
+        eval_interval = *interval;
+
+    // the Gibbs samplers' topic assignments may be memory-mapped from a
+    // file, for corpora whose assignments do not fit in memory
+    std::string assignments_file;
+    if (auto file = lda_group->get_as<std::string>("assignments-file"))
+        assignments_file = *file;
+
+    // the model may be saved in binary, keeping only the best terms of
+    // each topic, for models too large to format and parse as text
+    uint64_t top_terms = 0;
+    if (auto format = lda_group->get_as<std::string>("model-format"))
+    {
+        if (*format == "binary")
+        {
+            top_terms = 100;
+            if (auto c_top_terms = lda_group->get_as<int64_t>("top-terms"))
+                top_terms = static_cast<uint64_t>(*c_top_terms);
+        }
+        else if (*format != "text")
+        {
+            std::cerr << "Incorrect model-format selected: must be text or "
+                         "binary" << std::endl;
+            return 1;
+        }
+    }
+
     auto f_idx
         = index::make_index<index::forward_index, caching::no_evict_cache>(
             config_file);
@@ -73,31 +113,81 @@ int run_lda(const std::string& config_file)
     {
         std::cout << "Beginning LDA using serial Gibbs sampling..."
                   << std::endl;
-        return run_lda<lda_gibbs>(f_idx, iters, topics, alpha, beta,
-                                  save_prefix);
+        return run_lda<lda_gibbs>(f_idx, iters, eval_interval, top_terms,
+                                  topics, alpha, beta, save_prefix,
+                                  assignments_file);
     }
     else if (type == "pargibbs")
     {
         std::cout << "Beginning LDA using parallel Gibbs sampling..."
                   << std::endl;
-        return run_lda<parallel_lda_gibbs>(f_idx, iters, topics, alpha, beta,
-                                           save_prefix);
+        return run_lda<parallel_lda_gibbs>(f_idx, iters, eval_interval,
+                                           top_terms, topics, alpha, beta,
+                                           save_prefix, assignments_file);
+    }
+    else if (type == "sparsegibbs")
+    {
+        std::cout << "Beginning LDA using SparseLDA Gibbs sampling..."
+                  << std::endl;
+        return run_lda<sparse_lda_gibbs>(f_idx, iters, eval_interval,
+                                         top_terms, topics, alpha, beta,
+                                         save_prefix);
     }
     else if (type == "cvb")
     {
         std::cout << "Beginning LDA using serial collapsed variational bayes..."
                   << std::endl;
-        return run_lda<lda_cvb>(f_idx, iters, topics, alpha, beta, save_prefix);
+        return run_lda<lda_cvb>(f_idx, iters, eval_interval, top_terms,
+                                topics, alpha, beta, save_prefix);
+    }
+    else if (type == "parcvb")
+    {
+        std::cout
+            << "Beginning LDA using parallel collapsed variational bayes..."
+            << std::endl;
+        return run_lda<parallel_lda_cvb>(f_idx, iters, eval_interval,
+                                         top_terms, topics, alpha, beta,
+                                         save_prefix);
     }
     else if (type == "scvb")
     {
         std::cout
             << "Beginning LDA using stochastic collapsed variational bayes..."
             << std::endl;
-        return run_lda<lda_scvb>(f_idx, iters, topics, alpha, beta,
-                                 save_prefix);
+        return run_lda<lda_scvb>(f_idx, iters, eval_interval, top_terms,
+                                 topics, alpha, beta, save_prefix);
+    }
+    else if (type == "distgibbs")
+    {
+        // every worker process runs with the same configuration, except
+        // for its shard
+        if (!check_parameter(config_file, *lda_group, "shard")
+            || !check_parameter(config_file, *lda_group, "num-shards")
+            || !check_parameter(config_file, *lda_group, "sync-dir")
+            || !check_parameter(config_file, *lda_group, "run-id"))
+            return 1;
+        uint64_t shard = *lda_group->get_as<int64_t>("shard");
+        uint64_t num_shards = *lda_group->get_as<int64_t>("num-shards");
+        auto sync_dir = *lda_group->get_as<std::string>("sync-dir");
+        auto run_id = *lda_group->get_as<std::string>("run-id");
+        uint64_t staleness = 0;
+        if (auto c_staleness = lda_group->get_as<int64_t>("staleness"))
+            staleness = *c_staleness;
+
+        std::cout << "Beginning LDA using distributed Gibbs sampling (shard "
+                  << shard << " of " << num_shards << ")..." << std::endl;
+        distributed_lda_gibbs model{f_idx, topics, alpha, beta, shard,
+                                    num_shards, sync_dir, run_id,
+                                    staleness};
+        model.evaluation_interval(eval_interval);
+        if (top_terms > 0)
+            model.binary_output(top_terms);
+        model.run(iters);
+        model.save(save_prefix);
+        return 0;
     }
-    std::cout << "Incorrect method selected: must be gibbs, pargibbs, or cvb"
+    std::cout << "Incorrect method selected: must be gibbs, pargibbs, "
+                 "sparsegibbs, distgibbs, cvb, parcvb, or scvb"
               << std::endl;
     return 1;
 }
@@ -0,0 +1,63 @@
+/**
+ * @file topic_assignments.cpp
+ */
+
+#include <limits>
+
+#include "topics/topic_assignments.h"
+
+namespace meta
+{
+namespace topics
+{
+
+topic_assignments::topic_assignments(const std::vector<uint64_t>& lengths,
+                                     uint64_t num_topics,
+                                     const std::string& path /* = "" */)
+    : offsets_(lengths.size() + 1, 0), narrow_{nullptr}, wide_{nullptr}
+{
+    for (uint64_t doc = 0; doc < lengths.size(); ++doc)
+        offsets_[doc + 1] = offsets_[doc] + lengths[doc];
+    auto total = offsets_.back();
+
+    // a disk_vector cannot map an empty file, and an empty array needs no
+    // storage anyway
+    bool narrow = num_topics - 1 <= std::numeric_limits<uint16_t>::max();
+    if (!path.empty() && total > 0)
+    {
+        if (narrow)
+        {
+            narrow_file_.reset(new util::disk_vector<uint16_t>{path, total});
+            narrow_ = &(*narrow_file_)[0];
+        }
+        else
+        {
+            wide_file_.reset(new util::disk_vector<uint32_t>{path, total});
+            wide_ = &(*wide_file_)[0];
+        }
+    }
+    else if (narrow)
+    {
+        narrow_memory_.resize(total);
+        narrow_ = narrow_memory_.data();
+    }
+    else
+    {
+        wide_memory_.resize(total);
+        wide_ = wide_memory_.data();
+    }
+}
+
+util::memory_usage topic_assignments::memory_usage() const
+{
+    auto usage = util::heap_memory(offsets_);
+    usage += util::heap_memory(narrow_memory_);
+    usage += util::heap_memory(wide_memory_);
+    if (narrow_file_)
+        usage += narrow_file_->memory_usage();
+    if (wide_file_)
+        usage += wide_file_->memory_usage();
+    return usage;
+}
+}
+}
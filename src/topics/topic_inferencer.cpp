@@ -0,0 +1,130 @@
+/**
+ * @file topic_inferencer.cpp
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "topics/topic_inferencer.h"
+
+namespace meta
+{
+namespace topics
+{
+
+namespace
+{
+/**
+ * Maps the probabilities of a model, reporting any failure as a
+ * topic_inferencer_exception.
+ * @param filename The file written by
+ *  lda_model::save_topic_term_probabilities
+ * @return the mapped probabilities
+ */
+topic_matrix open_model(const std::string& filename)
+{
+    try
+    {
+        return topic_matrix{filename};
+    }
+    catch (const topic_model_file_exception& ex)
+    {
+        throw topic_inferencer::topic_inferencer_exception{ex.what()};
+    }
+}
+}
+
+topic_inferencer::topic_inferencer(const std::string& filename, double alpha,
+                                   uint64_t max_iters, double convergence)
+    : probs_{open_model(filename)},
+      num_topics_{probs_.num_topics()},
+      num_words_{probs_.num_rows()},
+      alpha_{alpha},
+      max_iters_{max_iters},
+      convergence_{convergence}
+{
+    /* nothing */
+}
+
+std::vector<double> topic_inferencer::infer(
+    const std::vector<std::pair<term_id, double>>& counts) const
+{
+    double length = 0;
+    for (const auto& count : counts)
+    {
+        if (count.first < num_words_)
+            length += count.second;
+    }
+
+    std::vector<double> theta(num_topics_, length / num_topics_);
+    std::vector<double> next(num_topics_);
+    std::vector<double> gamma(num_topics_);
+    for (uint64_t iter = 0; iter < max_iters_ && length > 0; ++iter)
+    {
+        std::fill(next.begin(), next.end(), 0.0);
+        for (const auto& count : counts)
+        {
+            if (count.first >= num_words_)
+                continue;
+
+            // the loops over the topics are kept apart from the one that
+            // sums over them, so that they can be vectorized
+            auto probs = probs_.row(count.first);
+            for (topic_id k{0}; k < num_topics_; ++k)
+                gamma[k] = probs[k] * (theta[k] + alpha_);
+
+            double sum = 0;
+            for (topic_id k{0}; k < num_topics_; ++k)
+                sum += gamma[k];
+
+            auto weight = count.second / sum;
+            for (topic_id k{0}; k < num_topics_; ++k)
+                next[k] += weight * gamma[k];
+        }
+
+        double change = 0;
+        for (topic_id k{0}; k < num_topics_; ++k)
+            change += std::abs(next[k] - theta[k]);
+        theta.swap(next);
+        if (change / length <= convergence_)
+            break;
+    }
+
+    auto denom = length + num_topics_ * alpha_;
+    for (auto& count : theta)
+        count = (count + alpha_) / denom;
+    return theta;
+}
+
+std::vector<double> topic_inferencer::infer(const corpus::document& doc,
+                                            index::disk_index& idx) const
+{
+    std::vector<std::string> terms;
+    std::vector<double> amounts;
+    terms.reserve(doc.counts().size());
+    amounts.reserve(doc.counts().size());
+    for (const auto& count : doc.counts())
+    {
+        terms.push_back(count.first);
+        amounts.push_back(count.second);
+    }
+
+    auto ids = idx.get_term_ids(terms);
+    std::vector<std::pair<term_id, double>> counts;
+    counts.reserve(ids.size());
+    for (uint64_t i = 0; i < ids.size(); ++i)
+        counts.emplace_back(ids[i], amounts[i]);
+    return infer(counts);
+}
+
+uint64_t topic_inferencer::num_topics() const
+{
+    return num_topics_;
+}
+
+uint64_t topic_inferencer::num_words() const
+{
+    return num_words_;
+}
+}
+}
@@ -0,0 +1,123 @@
+/**
+ * @file topic_model_file.cpp
+ */
+
+#include <cstring>
+
+#include "topics/topic_model_file.h"
+
+namespace meta
+{
+namespace topics
+{
+
+namespace
+{
+/// The size of the header of both files: two uint64_ts
+const uint64_t header_size = 2 * sizeof(uint64_t);
+
+/**
+ * Maps a model file, reporting a missing or unreadable file as a
+ * topic_model_file_exception.
+ * @param filename The file to map
+ * @param res How the file is brought into memory
+ * @return the mapped file
+ */
+io::mmap_file open_model(const std::string& filename, io::residency res)
+{
+    try
+    {
+        return io::mmap_file{filename, res};
+    }
+    catch (const io::mmap_file::mmap_file_exception& ex)
+    {
+        throw topic_model_file_exception{"model not found: " + filename
+                                         + " (" + ex.what() + ")"};
+    }
+}
+
+/**
+ * Reads the two uint64_ts at the start of a model file.
+ * @param file The mapped file
+ * @param first Set to the first value
+ * @param second Set to the second value
+ */
+void read_header(const io::mmap_file& file, uint64_t& first,
+                 uint64_t& second)
+{
+    if (file.size() < header_size)
+        throw topic_model_file_exception{"malformed model file: "
+                                         + file.path()};
+    std::memcpy(&first, file.begin(), sizeof(uint64_t));
+    std::memcpy(&second, file.begin() + sizeof(uint64_t), sizeof(uint64_t));
+}
+}
+
+topic_matrix::topic_matrix(const std::string& filename, io::residency res)
+    : file_{open_model(filename, res)}
+{
+    read_header(file_, num_topics_, num_rows_);
+    if (num_topics_ == 0
+        || file_.size()
+               != header_size + num_topics_ * num_rows_ * sizeof(float))
+        throw topic_model_file_exception{"malformed model file: " + filename};
+
+    // the mapping is page aligned, so the floats after the header are too
+    probs_ = reinterpret_cast<const float*>(file_.begin() + header_size);
+}
+
+uint64_t topic_matrix::num_topics() const
+{
+    return num_topics_;
+}
+
+uint64_t topic_matrix::num_rows() const
+{
+    return num_rows_;
+}
+
+const float* topic_matrix::row(uint64_t r) const
+{
+    return probs_ + r * num_topics_;
+}
+
+float topic_matrix::probability(uint64_t r, topic_id k) const
+{
+    return probs_[r * num_topics_ + k];
+}
+
+topic_top_terms::topic_top_terms(const std::string& filename,
+                                 io::residency res)
+    : file_{open_model(filename, res)}
+{
+    read_header(file_, num_topics_, num_terms_);
+    auto entries = num_topics_ * num_terms_;
+    if (file_.size()
+        != header_size + entries * (sizeof(uint64_t) + sizeof(float)))
+        throw topic_model_file_exception{"malformed model file: " + filename};
+
+    terms_ = reinterpret_cast<const uint64_t*>(file_.begin() + header_size);
+    scores_ = reinterpret_cast<const float*>(terms_ + entries);
+}
+
+uint64_t topic_top_terms::num_topics() const
+{
+    return num_topics_;
+}
+
+uint64_t topic_top_terms::terms_per_topic() const
+{
+    return num_terms_;
+}
+
+term_id topic_top_terms::term(topic_id k, uint64_t i) const
+{
+    return term_id{terms_[k * num_terms_ + i]};
+}
+
+float topic_top_terms::score(topic_id k, uint64_t i) const
+{
+    return scores_[k * num_terms_ + i];
+}
+}
+}
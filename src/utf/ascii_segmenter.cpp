@@ -0,0 +1,340 @@
+/**
+ * @file ascii_segmenter.cpp
+ */
+
+#include "utf/ascii_segmenter.h"
+
+namespace meta
+{
+namespace utf
+{
+
+namespace
+{
+/**
+ * The Sentence_Break property values of the ASCII characters.
+ */
+enum class sentence_break
+{
+    other,
+    cr,
+    lf,
+    sp,
+    lower,
+    upper,
+    numeric,
+    aterm,
+    sterm,
+    close,
+    scontinue
+};
+
+/**
+ * @param c An ASCII character
+ * @return its Sentence_Break property value
+ */
+sentence_break sentence_class(char c)
+{
+    if (c >= 'a' && c <= 'z')
+        return sentence_break::lower;
+    if (c >= 'A' && c <= 'Z')
+        return sentence_break::upper;
+    if (c >= '0' && c <= '9')
+        return sentence_break::numeric;
+    switch (c)
+    {
+        case '\r':
+            return sentence_break::cr;
+        case '\n':
+            return sentence_break::lf;
+        case ' ':
+        case '\t':
+        case '\v':
+        case '\f':
+            return sentence_break::sp;
+        case '.':
+            return sentence_break::aterm;
+        case '!':
+        case '?':
+            return sentence_break::sterm;
+        case '"':
+        case '\'':
+        case '(':
+        case ')':
+        case '[':
+        case ']':
+        case '{':
+        case '}':
+            return sentence_break::close;
+        case ',':
+        case '-':
+        case ':':
+            return sentence_break::scontinue;
+        default:
+            return sentence_break::other;
+    }
+}
+
+/**
+ * The Word_Break property values of the ASCII characters, as ICU tailors
+ * them.
+ */
+enum class word_break
+{
+    other,
+    cr,
+    lf,
+    newline,
+    space,
+    aletter,
+    numeric,
+    mid_num,
+    mid_num_let,
+    single_quote,
+    extend_num_let
+};
+
+/**
+ * @param c An ASCII character
+ * @return its Word_Break property value
+ */
+word_break word_class(char c)
+{
+    // ICU counts '@' as a letter, so that email addresses stay whole
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '@')
+        return word_break::aletter;
+    if (c >= '0' && c <= '9')
+        return word_break::numeric;
+    switch (c)
+    {
+        case '\r':
+            return word_break::cr;
+        case '\n':
+            return word_break::lf;
+        case '\v':
+        case '\f':
+            return word_break::newline;
+        case ' ':
+            return word_break::space;
+        case ',':
+        case ';':
+            return word_break::mid_num;
+        case '.':
+            return word_break::mid_num_let;
+        case '\'':
+            return word_break::single_quote;
+        case '_':
+            return word_break::extend_num_let;
+        default:
+            // ICU does not treat ':' as MidLetter
+            return word_break::other;
+    }
+}
+
+/**
+ * @param wb A Word_Break value
+ * @return whether it may join two letters (MidLetter, MidNumLet, or
+ * Single_Quote)
+ */
+bool mid_letter(word_break wb)
+{
+    return wb == word_break::mid_num_let || wb == word_break::single_quote;
+}
+
+/**
+ * @param wb A Word_Break value
+ * @return whether it may join two numbers (MidNum, MidNumLet, or
+ * Single_Quote)
+ */
+bool mid_number(word_break wb)
+{
+    return wb == word_break::mid_num || wb == word_break::mid_num_let
+           || wb == word_break::single_quote;
+}
+
+/**
+ * @param before2 The character two before the position, or other
+ * @param before The character before the position
+ * @param after The character after the position
+ * @param after2 The character two after the position, or other
+ * @return whether there is a word boundary at the position
+ */
+bool word_boundary(word_break before2, word_break before, word_break after,
+                   word_break after2)
+{
+    using wb = word_break;
+    // WB3: CR x LF, WB3a and WB3b: break around newlines
+    if (before == wb::cr && after == wb::lf)
+        return false;
+    if (before == wb::cr || before == wb::lf || before == wb::newline
+        || after == wb::cr || after == wb::lf || after == wb::newline)
+        return true;
+    // WB3d: keep horizontal whitespace together
+    if (before == wb::space && after == wb::space)
+        return false;
+    // WB5 through WB7: letters
+    if (before == wb::aletter && after == wb::aletter)
+        return false;
+    if (before == wb::aletter && mid_letter(after) && after2 == wb::aletter)
+        return false;
+    if (before2 == wb::aletter && mid_letter(before) && after == wb::aletter)
+        return false;
+    // WB8 through WB12: numbers
+    if ((before == wb::numeric || before == wb::aletter)
+        && (after == wb::numeric || after == wb::aletter))
+        return false;
+    if (before2 == wb::numeric && mid_number(before) && after == wb::numeric)
+        return false;
+    if (before == wb::numeric && mid_number(after) && after2 == wb::numeric)
+        return false;
+    // WB13a and WB13b: connectors
+    if (after == wb::extend_num_let
+        && (before == wb::aletter || before == wb::numeric
+            || before == wb::extend_num_let))
+        return false;
+    if (before == wb::extend_num_let
+        && (after == wb::aletter || after == wb::numeric))
+        return false;
+    return true;
+}
+}
+
+void ascii_segmenter::set_content(std::string str)
+{
+    content_ = std::move(str);
+}
+
+auto ascii_segmenter::sentences() const -> std::vector<segment>
+{
+    using sb = sentence_break;
+    std::vector<segment> results;
+    int32_t size = content_.size();
+    auto cls = [&](int32_t i)
+    {
+        return sentence_class(content_[i]);
+    };
+    auto para_sep = [&](int32_t i)
+    {
+        return cls(i) == sb::cr || cls(i) == sb::lf;
+    };
+
+    int32_t start = 0;
+    int32_t i = 0;
+    while (i < size)
+    {
+        // SB4: break after paragraph separators
+        if (para_sep(i))
+        {
+            i += cls(i) == sb::cr && i + 1 < size && cls(i + 1) == sb::lf
+                     ? 2
+                     : 1;
+            results.emplace_back(start, i);
+            start = i;
+            continue;
+        }
+
+        if (cls(i) != sb::aterm && cls(i) != sb::sterm)
+        {
+            ++i;
+            continue;
+        }
+
+        // SB9 and SB10: the terminator's sentence goes on through
+        // Close* Sp*, and a paragraph separator after them (SB11)
+        auto term = i;
+        auto end = term + 1;
+        while (end < size && cls(end) == sb::close)
+            ++end;
+        while (end < size && cls(end) == sb::sp)
+            ++end;
+        if (end < size && para_sep(end))
+        {
+            i = end;
+            continue;
+        }
+
+        auto no_break = end == size;
+        if (cls(term) == sb::aterm && end == term + 1 && end < size)
+        {
+            // SB6: ATerm x Numeric
+            if (cls(end) == sb::numeric)
+                no_break = true;
+            // SB7: (Upper | Lower) ATerm x Upper
+            if (term > 0 && cls(end) == sb::upper
+                && (cls(term - 1) == sb::upper || cls(term - 1) == sb::lower))
+                no_break = true;
+        }
+        if (cls(term) == sb::aterm && !no_break)
+        {
+            // SB8: ATerm Close* Sp* x (not a letter or terminator)* Lower
+            auto next = end;
+            while (next < size && cls(next) != sb::upper
+                   && cls(next) != sb::lower && cls(next) != sb::aterm
+                   && cls(next) != sb::sterm && !para_sep(next))
+                ++next;
+            if (next < size && cls(next) == sb::lower)
+                no_break = true;
+        }
+        // SB8a: SATerm Close* Sp* x (SContinue | SATerm)
+        if (!no_break && (cls(end) == sb::scontinue || cls(end) == sb::aterm
+                          || cls(end) == sb::sterm))
+            no_break = true;
+
+        if (no_break)
+        {
+            i = term + 1;
+            continue;
+        }
+
+        // SB11: break after the terminator's Close* Sp*
+        results.emplace_back(start, end);
+        start = end;
+        i = end;
+    }
+
+    if (start < size)
+        results.emplace_back(start, size);
+    return results;
+}
+
+auto ascii_segmenter::words(const segment& seg) const -> std::vector<segment>
+{
+    std::vector<segment> results;
+    words(seg, results);
+    return results;
+}
+
+void ascii_segmenter::words(const segment& seg,
+                            std::vector<segment>& results) const
+{
+    results.clear();
+    auto cls = [&](int32_t i)
+    {
+        return i >= seg.begin_ && i < seg.end_ ? word_class(content_[i])
+                                               : word_break::other;
+    };
+
+    auto start = seg.begin_;
+    for (auto i = seg.begin_ + 1; i < seg.end_; ++i)
+    {
+        if (word_boundary(cls(i - 2), cls(i - 1), cls(i), cls(i + 1)))
+        {
+            results.emplace_back(start, i);
+            start = i;
+        }
+    }
+    if (start < seg.end_)
+        results.emplace_back(start, seg.end_);
+}
+
+std::string ascii_segmenter::content(const segment& seg) const
+{
+    return content_.substr(seg.begin_, seg.end_ - seg.begin_);
+}
+
+void ascii_segmenter::content(const segment& seg, std::string& buffer) const
+{
+    buffer.assign(content_, seg.begin_, seg.end_ - seg.begin_);
+}
+}
+}
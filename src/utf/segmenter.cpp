@@ -4,6 +4,7 @@
  */
 
 #include <unicode/brkiter.h>
+#include <unicode/utext.h>
 
 #include "detail.h"
 #include "utf/segmenter.h"
@@ -60,7 +61,7 @@ class segmenter::impl
      * @param other The impl to copy.
      */
     impl(const impl& other)
-        : u_str_{other.u_str_},
+        : content_{other.content_},
           sentence_iter_{other.sentence_iter_->clone()},
           word_iter_{other.word_iter_->clone()}
     {
@@ -74,28 +75,21 @@ class segmenter::impl
      * Sets the content of the segmenter.
      * @param str The content to be set
      */
-    void set_content(const std::string& str)
+    void set_content(std::string str)
     {
-        u_str_ = icu::UnicodeString::fromUTF8(str);
+        content_ = std::move(str);
     }
 
     /**
-     * Obtains a utf-8 encoded string by first extracting the utf-16
-     * encoded substring between the given indices and converting that
-     * substring to utf-8.
-     *
-     * @param begin The beginning index
-     * @param end The ending index
-     * @return the substring between begin and end
+     * @param begin The beginning byte offset
+     * @param end The ending byte offset
+     * @param buffer The string to assign the bytes between begin and end
+     * to
      */
-    std::string substr(int32_t begin, int32_t end) const
+    void substr(int32_t begin, int32_t end, std::string& buffer) const
     {
-#ifdef META_ICU_NO_TEMP_SUBSTRING
-        icu::UnicodeString substring{u_str_, begin, end - begin};
-#else
-        auto substring = u_str_.tempSubStringBetween(begin, end);
-#endif
-        return icu_to_u8str(substring);
+        buffer.assign(content_, static_cast<std::size_t>(begin),
+                      static_cast<std::size_t>(end - begin));
     }
 
     /**
@@ -113,7 +107,9 @@ class segmenter::impl
      */
     std::vector<segment> sentences() const
     {
-        return segments(0, u_str_.length(), segment_t::SENTENCES);
+        std::vector<segment> results;
+        segments(0, size(), segment_t::SENTENCES, results);
+        return results;
     }
 
     /**
@@ -122,24 +118,27 @@ class segmenter::impl
      */
     std::vector<segment> words() const
     {
-        return segments(0, u_str_.length(), segment_t::WORDS);
+        std::vector<segment> results;
+        segments(0, size(), segment_t::WORDS, results);
+        return results;
     }
 
     /**
-     * Generic segmentation method that operates on the substring between
-     * the given indices, using the given strategy for segmenting that
-     * substring.
+     * Generic segmentation method that operates on the bytes between
+     * the given offsets, using the given strategy for segmenting them.
+     * The break iterator reads the utf-8 bytes in place through a UText,
+     * so its boundaries are byte offsets and no utf-16 copy is made.
      *
-     * @param first The index of the beginning of the string to work on
-     * @param last The index of the end of the string to work on
+     * @param first The offset of the beginning of the string to work on
+     * @param last The offset of the end of the string to work on
      * @param type The type of segmentation to perform
-     * @return a vector of segments (whose meaning depends on `type`)
+     * @param results The vector to replace the contents of with the
+     * segments (whose meaning depends on `type`)
      */
-    std::vector<segment> segments(int32_t first, int32_t last,
-                                  segment_t type) const
+    void segments(int32_t first, int32_t last, segment_t type,
+                  std::vector<segment>& results) const
     {
-        std::vector<segment> results;
-        auto status = U_ZERO_ERROR;
+        results.clear();
         icu::BreakIterator* iter;
         if (type == segment_t::SENTENCES)
             iter = sentence_iter_.get();
@@ -148,6 +147,14 @@ class segmenter::impl
         else
             throw std::runtime_error{"Unknown segmentation type"};
 
+        // the iterator keeps its own shallow clone of the UText, which
+        // only needs the bytes it points to to stay alive
+        auto status = U_ZERO_ERROR;
+        UText text = UTEXT_INITIALIZER;
+        utext_openUTF8(&text, content_.data() + first, last - first,
+                       &status);
+        iter->setText(&text, status);
+        utext_close(&text);
         if (!U_SUCCESS(status))
         {
             std::string err = "Failed to segment: ";
@@ -155,13 +162,6 @@ class segmenter::impl
             throw std::runtime_error{err};
         }
 
-#ifdef META_ICU_NO_TEMP_SUBSTRING
-        icu::UnicodeString substring{u_str_, first, last - first};
-        iter->setText(substring);
-#else
-        iter->setText(u_str_.tempSubStringBetween(first, last));
-#endif
-
         auto start = iter->first();
         auto end = iter->next();
         while (end != icu::BreakIterator::DONE)
@@ -170,12 +170,19 @@ class segmenter::impl
             start = end;
             end = iter->next();
         }
-        return results;
     }
 
   private:
-    /// The internal ICU string
-    icu::UnicodeString u_str_;
+    /**
+     * @return the number of bytes of the content
+     */
+    int32_t size() const
+    {
+        return static_cast<int32_t>(content_.size());
+    }
+
+    /// The utf-8 content being segmented
+    std::string content_;
     /// A pointer to a sentence break iterator
     std::unique_ptr<icu::BreakIterator> sentence_iter_;
     /// A pointer to a word break iterator
@@ -201,9 +208,9 @@ segmenter::segmenter(const segmenter& other) : impl_{*other.impl_}
 
 segmenter::~segmenter() = default;
 
-void segmenter::set_content(const std::string& str)
+void segmenter::set_content(std::string str)
 {
-    impl_->set_content(str);
+    impl_->set_content(std::move(str));
 }
 
 auto segmenter::sentences() const -> std::vector<segment>
@@ -218,12 +225,26 @@ auto segmenter::words() const -> std::vector<segment>
 
 auto segmenter::words(const segment& seg) const -> std::vector<segment>
 {
-    return impl_->segments(seg.begin_, seg.end_, impl::segment_t::WORDS);
+    std::vector<segment> results;
+    words(seg, results);
+    return results;
+}
+
+void segmenter::words(const segment& seg, std::vector<segment>& words) const
+{
+    impl_->segments(seg.begin_, seg.end_, impl::segment_t::WORDS, words);
 }
 
 std::string segmenter::content(const segment& seg) const
 {
-    return impl_->substr(seg.begin_, seg.end_);
+    std::string result;
+    content(seg, result);
+    return result;
+}
+
+void segmenter::content(const segment& seg, std::string& buffer) const
+{
+    impl_->substr(seg.begin_, seg.end_, buffer);
 }
 
 segmenter::segment::segment(int32_t begin, int32_t end)
@@ -4,6 +4,7 @@
  */
 
 #include <array>
+#include <cstring>
 #include <stdexcept>
 #include <unicode/brkiter.h>
 #include <unicode/uchar.h>
@@ -133,6 +134,100 @@ bool isblank(uint32_t codepoint)
     return u_isblank(codepoint);
 }
 
+bool is_ascii(const std::string& str)
+{
+    // eight bytes are checked at a time for a set high bit
+    const uint64_t high_bits = 0x8080808080808080ull;
+    const char* s = str.data();
+    auto size = str.size();
+    std::size_t i = 0;
+    for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, s + i, sizeof(uint64_t));
+        if (word & high_bits)
+            return false;
+    }
+    for (; i < size; ++i)
+    {
+        if (static_cast<unsigned char>(s[i]) & 0x80)
+            return false;
+    }
+    return true;
+}
+
+bool is_valid_utf8(const std::string& str)
+{
+    return is_valid_utf8(str.data(), str.size());
+}
+
+bool is_valid_utf8(const char* data, std::size_t size)
+{
+    const uint64_t high_bits = 0x8080808080808080ull;
+    auto s = reinterpret_cast<const unsigned char*>(data);
+    std::size_t i = 0;
+    while (i < size)
+    {
+        // runs of ASCII are skipped eight bytes at a time
+        if (i + sizeof(uint64_t) <= size)
+        {
+            uint64_t word;
+            std::memcpy(&word, s + i, sizeof(uint64_t));
+            if (!(word & high_bits))
+            {
+                i += sizeof(uint64_t);
+                continue;
+            }
+        }
+
+        auto lead = s[i];
+        if (lead < 0x80)
+        {
+            ++i;
+            continue;
+        }
+
+        // the number of continuation bytes, and the range of the first
+        // one, which rules out overlong forms, surrogates, and code points
+        // past U+10FFFF
+        std::size_t num_cont;
+        unsigned char low = 0x80;
+        unsigned char high = 0xBF;
+        if (lead >= 0xC2 && lead <= 0xDF)
+            num_cont = 1;
+        else if (lead >= 0xE0 && lead <= 0xEF)
+        {
+            num_cont = 2;
+            if (lead == 0xE0)
+                low = 0xA0;
+            else if (lead == 0xED)
+                high = 0x9F;
+        }
+        else if (lead >= 0xF0 && lead <= 0xF4)
+        {
+            num_cont = 3;
+            if (lead == 0xF0)
+                low = 0x90;
+            else if (lead == 0xF4)
+                high = 0x8F;
+        }
+        else
+            return false;
+
+        if (size - i <= num_cont)
+            return false;
+        if (s[i + 1] < low || s[i + 1] > high)
+            return false;
+        for (std::size_t j = 2; j <= num_cont; ++j)
+        {
+            if ((s[i + j] & 0xC0) != 0x80)
+                return false;
+        }
+        i += num_cont + 1;
+    }
+    return true;
+}
+
 uint64_t length(const std::string& str)
 {
     const char* s = str.c_str();
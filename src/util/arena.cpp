@@ -0,0 +1,73 @@
+/**
+ * @file arena.cpp
+ */
+
+#include <algorithm>
+
+#include "util/arena.h"
+
+namespace meta
+{
+namespace util
+{
+
+const uint64_t arena::default_block_size;
+
+arena::arena(uint64_t block_size)
+    : current_{0},
+      offset_{0},
+      block_size_{std::max<uint64_t>(block_size, 1)},
+      used_{0}
+{
+    // nothing
+}
+
+void* arena::allocate(uint64_t size, uint64_t alignment)
+{
+    while (current_ < blocks_.size())
+    {
+        auto& blk = blocks_[current_];
+        auto base = reinterpret_cast<uintptr_t>(blk.data.get());
+        auto start = (base + offset_ + alignment - 1) & ~(alignment - 1);
+        auto offset = start - base;
+        if (offset + size <= blk.size)
+        {
+            offset_ = offset + size;
+            used_ += size;
+            return blk.data.get() + offset;
+        }
+
+        // the rest of this block is wasted until the next reset
+        ++current_;
+        offset_ = 0;
+    }
+
+    auto block_size = std::max(block_size_, size + alignment);
+    blocks_.push_back({std::unique_ptr<char[]>{new char[block_size]},
+                       block_size});
+    current_ = blocks_.size() - 1;
+    offset_ = 0;
+    return allocate(size, alignment);
+}
+
+void arena::reset()
+{
+    current_ = 0;
+    offset_ = 0;
+    used_ = 0;
+}
+
+uint64_t arena::bytes_used() const
+{
+    return used_;
+}
+
+uint64_t arena::capacity() const
+{
+    uint64_t total = 0;
+    for (const auto& blk : blocks_)
+        total += blk.size;
+    return total;
+}
+}
+}
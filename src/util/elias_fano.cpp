@@ -0,0 +1,172 @@
+/**
+ * @file elias_fano.cpp
+ */
+
+#include <fstream>
+
+#include "io/binary.h"
+#include "util/elias_fano.h"
+
+namespace meta
+{
+namespace util
+{
+
+namespace
+{
+/// The number of elements between two samples of the high bits
+const uint64_t sample_rate = 256;
+
+/// Marks a file written by elias_fano_vector::save()
+const uint64_t magic = 0x4546564543544f52; // "EFVECTOR"
+
+/**
+ * Writes the words of a bit vector.
+ * @param out The stream to write to
+ * @param words The words
+ */
+void write_words(std::ostream& out, const std::vector<uint64_t>& words)
+{
+    io::write_binary(out, static_cast<uint64_t>(words.size()));
+    out.write(reinterpret_cast<const char*>(words.data()),
+              static_cast<std::streamsize>(words.size() * sizeof(uint64_t)));
+}
+
+/**
+ * Reads the words of a bit vector written by write_words().
+ * @param in The stream to read from
+ * @param words Where to put the words
+ */
+void read_words(std::istream& in, std::vector<uint64_t>& words)
+{
+    uint64_t num_words = 0;
+    io::read_binary(in, num_words);
+    if (!in)
+        return;
+    words.resize(num_words);
+    in.read(reinterpret_cast<char*>(words.data()),
+            static_cast<std::streamsize>(num_words * sizeof(uint64_t)));
+}
+}
+
+elias_fano_vector::elias_fano_vector(const std::string& path)
+{
+    std::ifstream in{path, std::ios::binary};
+    uint64_t header = 0;
+    io::read_binary(in, header);
+    io::read_binary(in, size_);
+    io::read_binary(in, low_bits_);
+    read_words(in, low_);
+    read_words(in, high_);
+    read_words(in, samples_);
+    if (!in || header != magic || low_bits_ >= 64
+        || low_.size() != (size_ * low_bits_ + 63) / 64
+        || samples_.size() != (size_ + sample_rate - 1) / sample_rate)
+        throw elias_fano_exception{"invalid Elias-Fano file " + path};
+}
+
+void elias_fano_vector::save(const std::string& path) const
+{
+    std::ofstream out{path, std::ios::binary};
+    io::write_binary(out, magic);
+    io::write_binary(out, size_);
+    io::write_binary(out, low_bits_);
+    write_words(out, low_);
+    write_words(out, high_);
+    write_words(out, samples_);
+    if (!out)
+        throw elias_fano_exception{"failed to write " + path};
+}
+
+void elias_fano_vector::reserve(uint64_t size, uint64_t max)
+{
+    size_ = size;
+    low_bits_ = 0;
+    if (size > 0)
+    {
+        for (auto ratio = max / size; ratio > 1; ratio >>= 1)
+            ++low_bits_;
+    }
+    low_.assign((size * low_bits_ + 63) / 64, 0);
+    high_.assign((size + (max >> low_bits_) + 1 + 63) / 64, 0);
+}
+
+void elias_fano_vector::set(uint64_t idx, uint64_t value)
+{
+    if (low_bits_ > 0)
+    {
+        auto low = value & ((uint64_t{1} << low_bits_) - 1);
+        auto pos = idx * low_bits_;
+        auto offset = pos % 64;
+        low_[pos / 64] |= low << offset;
+        if (offset + low_bits_ > 64)
+            low_[pos / 64 + 1] |= low >> (64 - offset);
+    }
+
+    auto pos = (value >> low_bits_) + idx;
+    high_[pos / 64] |= uint64_t{1} << (pos % 64);
+}
+
+void elias_fano_vector::sample()
+{
+    samples_.clear();
+    samples_.reserve((size_ + sample_rate - 1) / sample_rate);
+    uint64_t ones = 0;
+    for (uint64_t w = 0; w < high_.size(); ++w)
+    {
+        for (auto bits = high_[w]; bits != 0; bits &= bits - 1, ++ones)
+        {
+            if (ones % sample_rate == 0)
+                samples_.push_back(
+                    w * 64
+                    + static_cast<uint64_t>(__builtin_ctzll(bits)));
+        }
+    }
+}
+
+uint64_t elias_fano_vector::operator[](uint64_t idx) const
+{
+    // start at the sampled element and count set bits a word at a time
+    // until the word holding the idx-th one
+    auto pos = samples_[idx / sample_rate];
+    auto remaining = idx % sample_rate;
+    auto w = pos / 64;
+    auto bits = high_[w] & (~uint64_t{0} << (pos % 64));
+    for (auto ones = static_cast<uint64_t>(__builtin_popcountll(bits));
+         remaining >= ones;
+         ones = static_cast<uint64_t>(__builtin_popcountll(bits)))
+    {
+        remaining -= ones;
+        bits = high_[++w];
+    }
+    for (; remaining > 0; --remaining)
+        bits &= bits - 1;
+    auto high = w * 64 + static_cast<uint64_t>(__builtin_ctzll(bits)) - idx;
+
+    if (low_bits_ == 0)
+        return high;
+
+    auto low_pos = idx * low_bits_;
+    auto offset = low_pos % 64;
+    auto low = low_[low_pos / 64] >> offset;
+    if (offset + low_bits_ > 64)
+        low |= low_[low_pos / 64 + 1] << (64 - offset);
+    return (high << low_bits_) | (low & ((uint64_t{1} << low_bits_) - 1));
+}
+
+uint64_t elias_fano_vector::at(uint64_t idx) const
+{
+    if (idx >= size_)
+        throw elias_fano_exception{"index out of range"};
+    return (*this)[idx];
+}
+
+util::memory_usage elias_fano_vector::memory_usage() const
+{
+    auto usage = heap_memory(low_);
+    usage += heap_memory(high_);
+    usage += heap_memory(samples_);
+    return usage;
+}
+}
+}
@@ -0,0 +1,89 @@
+/**
+ * @file memory_usage.cpp
+ */
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "util/memory_usage.h"
+#include "util/printing.h"
+
+namespace meta
+{
+namespace util
+{
+
+memory_usage mapped_memory(const void* start, uint64_t bytes)
+{
+    memory_usage usage;
+    usage.mapped_bytes = bytes;
+    if (start == nullptr || bytes == 0)
+        return usage;
+
+    // mincore wants the start of a page, and reports on whole pages
+    auto page_size = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+    auto first = reinterpret_cast<uintptr_t>(start) & ~(page_size - 1);
+    auto last = reinterpret_cast<uintptr_t>(start) + bytes;
+    auto num_pages = (last - first + page_size - 1) / page_size;
+
+#if defined(__APPLE__)
+    std::vector<char> pages(num_pages);
+#else
+    std::vector<unsigned char> pages(num_pages);
+#endif
+    // a region that cannot be queried is counted as not resident
+    if (::mincore(reinterpret_cast<void*>(first), last - first, pages.data())
+        != 0)
+        return usage;
+
+    uint64_t resident = 0;
+    for (const auto& page : pages)
+        resident += page & 1;
+    usage.resident_bytes = std::min<uint64_t>(resident * page_size, bytes);
+    return usage;
+}
+
+void memory_report::add(const std::string& component,
+                        const memory_usage& usage)
+{
+    components_[component] += usage;
+}
+
+void memory_report::add(const memory_report& other)
+{
+    for (const auto& component : other.components_)
+        add(component.first, component.second);
+}
+
+const std::map<std::string, memory_usage>& memory_report::components() const
+{
+    return components_;
+}
+
+memory_usage memory_report::total() const
+{
+    memory_usage total;
+    for (const auto& component : components_)
+        total += component.second;
+    return total;
+}
+
+std::ostream& operator<<(std::ostream& out, const memory_report& report)
+{
+    auto print = [&](const std::string& name, const memory_usage& usage)
+    {
+        out << name << ": heap " << printing::bytes_to_units(usage.heap_bytes)
+            << ", mapped " << printing::bytes_to_units(usage.mapped_bytes)
+            << " (" << printing::bytes_to_units(usage.resident_bytes)
+            << " resident)\n";
+    };
+    for (const auto& component : report.components())
+        print(component.first, component.second);
+    print("total", report.total());
+    return out;
+}
+}
+}
@@ -0,0 +1,322 @@
+/**
+ * @file metrics.cpp
+ */
+
+#include <cctype>
+#include <cmath>
+#include <fstream>
+
+#include "util/metrics.h"
+
+namespace meta
+{
+namespace metrics
+{
+
+namespace internal
+{
+std::atomic<bool> enabled_flag{false};
+}
+
+namespace
+{
+/**
+ * @param value A value to record in a histogram
+ * @return the bucket the value belongs in
+ */
+uint64_t bucket_of(uint64_t value)
+{
+    uint64_t idx = 0;
+    while (value > 0)
+    {
+        value >>= 1;
+        ++idx;
+    }
+    return idx;
+}
+}
+
+void enable(bool on)
+{
+    internal::enabled_flag.store(on, std::memory_order_relaxed);
+}
+
+counter::counter() : slots_{new slot[num_slots]}
+{
+    reset();
+}
+
+uint64_t counter::value() const
+{
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < num_slots; ++i)
+        total += slots_[i].count.load(std::memory_order_relaxed);
+    return total;
+}
+
+void counter::reset()
+{
+    for (uint64_t i = 0; i < num_slots; ++i)
+        slots_[i].count.store(0, std::memory_order_relaxed);
+}
+
+gauge::gauge() : value_{0.0}
+{
+    // nothing
+}
+
+histogram::histogram() : buckets_{new std::atomic<uint64_t>[num_buckets]}
+{
+    reset();
+}
+
+void histogram::record(uint64_t value)
+{
+    buckets_[bucket_of(value)].fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t histogram::count() const
+{
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < num_buckets; ++i)
+        total += bucket(i);
+    return total;
+}
+
+uint64_t histogram::sum() const
+{
+    return sum_.load(std::memory_order_relaxed);
+}
+
+uint64_t histogram::bucket(uint64_t idx) const
+{
+    return buckets_[idx].load(std::memory_order_relaxed);
+}
+
+double histogram::upper_bound(uint64_t idx)
+{
+    return std::ldexp(1.0, static_cast<int>(idx));
+}
+
+double histogram::quantile(double quantile) const
+{
+    uint64_t counts[num_buckets];
+    uint64_t total = 0;
+    for (uint64_t i = 0; i < num_buckets; ++i)
+    {
+        counts[i] = bucket(i);
+        total += counts[i];
+    }
+    if (total == 0)
+        return 0;
+
+    auto rank = quantile * total;
+    uint64_t seen = 0;
+    for (uint64_t i = 0; i < num_buckets; ++i)
+    {
+        seen += counts[i];
+        if (seen > 0 && seen >= rank)
+            return upper_bound(i);
+    }
+    return upper_bound(num_buckets - 1);
+}
+
+void histogram::reset()
+{
+    for (uint64_t i = 0; i < num_buckets; ++i)
+        buckets_[i].store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+}
+
+registry& registry::global()
+{
+    static registry reg;
+    return reg;
+}
+
+void registry::check_name(const std::string& name) const
+{
+    bool valid = !name.empty()
+                 && !std::isdigit(static_cast<unsigned char>(name[0]));
+    for (const auto& c : name)
+        valid = valid
+                && (std::isalnum(static_cast<unsigned char>(c)) || c == '_');
+    if (!valid)
+        throw metrics_exception{"invalid metric name: " + name};
+
+    if (counters_.count(name) || gauges_.count(name)
+        || histograms_.count(name))
+        throw metrics_exception{"metric " + name
+                                + " is already of another kind"};
+}
+
+counter& registry::counter(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto it = counters_.find(name);
+    if (it != counters_.end())
+        return *it->second;
+    check_name(name);
+    auto& ctr = counters_[name];
+    ctr.reset(new metrics::counter);
+    return *ctr;
+}
+
+gauge& registry::gauge(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto it = gauges_.find(name);
+    if (it != gauges_.end())
+        return *it->second;
+    check_name(name);
+    auto& gge = gauges_[name];
+    gge.reset(new metrics::gauge);
+    return *gge;
+}
+
+histogram& registry::histogram(const std::string& name)
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    auto it = histograms_.find(name);
+    if (it != histograms_.end())
+        return *it->second;
+    check_name(name);
+    auto& hist = histograms_[name];
+    hist.reset(new metrics::histogram);
+    return *hist;
+}
+
+void registry::write_json(std::ostream& out) const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    out << "{\"counters\":{";
+    bool first = true;
+    for (const auto& ctr : counters_)
+    {
+        out << (first ? "" : ",") << '"' << ctr.first
+            << "\":" << ctr.second->value();
+        first = false;
+    }
+
+    out << "},\"gauges\":{";
+    first = true;
+    for (const auto& gge : gauges_)
+    {
+        out << (first ? "" : ",") << '"' << gge.first
+            << "\":" << gge.second->value();
+        first = false;
+    }
+
+    // only the buckets that hold values are written, as [upper bound,
+    // count] pairs
+    out << "},\"histograms\":{";
+    first = true;
+    for (const auto& hist : histograms_)
+    {
+        const auto& h = *hist.second;
+        out << (first ? "" : ",") << '"' << hist.first
+            << "\":{\"count\":" << h.count() << ",\"sum\":" << h.sum()
+            << ",\"p50\":" << h.quantile(0.5)
+            << ",\"p99\":" << h.quantile(0.99) << ",\"buckets\":[";
+        bool first_bucket = true;
+        for (uint64_t i = 0; i < metrics::histogram::num_buckets; ++i)
+        {
+            auto count = h.bucket(i);
+            if (count == 0)
+                continue;
+            out << (first_bucket ? "" : ",") << '['
+                << metrics::histogram::upper_bound(i) << ',' << count << ']';
+            first_bucket = false;
+        }
+        out << "]}";
+        first = false;
+    }
+    out << "}}\n";
+}
+
+void registry::write_prometheus(std::ostream& out) const
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (const auto& ctr : counters_)
+    {
+        out << "# TYPE " << ctr.first << " counter\n";
+        out << ctr.first << ' ' << ctr.second->value() << '\n';
+    }
+
+    for (const auto& gge : gauges_)
+    {
+        out << "# TYPE " << gge.first << " gauge\n";
+        out << gge.first << ' ' << gge.second->value() << '\n';
+    }
+
+    // Prometheus buckets are cumulative and bounded above inclusively;
+    // every value in bucket i is at most 2^i - 1
+    for (const auto& hist : histograms_)
+    {
+        const auto& h = *hist.second;
+        out << "# TYPE " << hist.first << " histogram\n";
+        uint64_t cumulative = 0;
+        uint64_t total = h.count();
+        for (uint64_t i = 0; i < metrics::histogram::num_buckets - 1
+                             && cumulative < total;
+             ++i)
+        {
+            cumulative += h.bucket(i);
+            out << hist.first << "_bucket{le=\""
+                << metrics::histogram::upper_bound(i) - 1 << "\"} "
+                << cumulative << '\n';
+        }
+        out << hist.first << "_bucket{le=\"+Inf\"} " << total << '\n';
+        out << hist.first << "_sum " << h.sum() << '\n';
+        out << hist.first << "_count " << total << '\n';
+    }
+}
+
+void registry::reset()
+{
+    std::lock_guard<std::mutex> lock{mutex_};
+    for (auto& ctr : counters_)
+        ctr.second->reset();
+    for (auto& gge : gauges_)
+        gge.second->set(0);
+    for (auto& hist : histograms_)
+        hist.second->reset();
+}
+
+periodic_dump::periodic_dump(const std::string& path,
+                             std::chrono::milliseconds interval, format fmt)
+    : path_{path}, interval_{interval}, format_{fmt}, stopped_{false}
+{
+    thread_ = std::thread{[this]()
+                          {
+        std::unique_lock<std::mutex> lock{mutex_};
+        while (!cond_.wait_for(lock, interval_, [this]()
+                               {
+                                   return stopped_;
+                               }))
+            dump();
+    }};
+}
+
+periodic_dump::~periodic_dump()
+{
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stopped_ = true;
+    }
+    cond_.notify_all();
+    thread_.join();
+    dump();
+}
+
+void periodic_dump::dump() const
+{
+    std::ofstream out{path_};
+    if (format_ == format::json)
+        registry::global().write_json(out);
+    else
+        registry::global().write_prometheus(out);
+}
+}
+}
@@ -0,0 +1,77 @@
+/**
+ * @file offset_vector.cpp
+ */
+
+#include <algorithm>
+#include <functional>
+
+#include "util/filesystem.h"
+#include "util/offset_vector.h"
+
+namespace meta
+{
+namespace util
+{
+
+bool offset_vector::compact(const std::string& path)
+{
+    // the table was just rewritten, so any Elias-Fano form beside it is
+    // from an earlier build
+    if (filesystem::file_exists(path + ".ef"))
+        filesystem::delete_file(path + ".ef");
+
+    // a disk_vector cannot map an empty file
+    if (filesystem::file_size(path) == 0)
+    {
+        std::vector<uint64_t> none;
+        elias_fano_vector{none.begin(), none.end()}.save(path + ".ef");
+    }
+    else
+    {
+        disk_vector<uint64_t> flat{path};
+        const uint64_t* first = &flat[0];
+        const uint64_t* last = first + flat.size();
+        if (std::adjacent_find(first, last, std::greater<uint64_t>{}) != last)
+            return false;
+        elias_fano_vector{first, last}.save(path + ".ef");
+    }
+    filesystem::delete_file(path);
+    return true;
+}
+
+bool offset_vector::exists(const std::string& path)
+{
+    return filesystem::file_exists(path)
+           || filesystem::file_exists(path + ".ef");
+}
+
+offset_vector::offset_vector(const std::string& path)
+{
+    if (filesystem::file_exists(path + ".ef"))
+        packed_ = elias_fano_vector{path + ".ef"};
+    else
+        flat_ = disk_vector<uint64_t>{path};
+}
+
+uint64_t offset_vector::at(uint64_t idx) const
+{
+    return packed_ ? packed_->at(idx) : flat_->at(idx);
+}
+
+uint64_t offset_vector::size() const
+{
+    return packed_ ? packed_->size() : flat_->size();
+}
+
+util::memory_usage offset_vector::memory_usage() const
+{
+    return packed_ ? packed_->memory_usage() : flat_->memory_usage();
+}
+
+void offset_vector::prefault() const
+{
+    if (flat_)
+        flat_->prefault();
+}
+}
+}
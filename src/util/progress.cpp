@@ -122,5 +122,65 @@ progress::~progress()
     if (!finished_)
         end();
 }
+
+concurrent_progress::concurrent_progress(const std::string& prefix,
+                                         uint64_t length, int interval)
+    : progress_{prefix, length, 0, 0},
+      done_{0},
+      interval_{interval},
+      stop_{false},
+      finished_{false},
+      timer_{[this]()
+             {
+                 run();
+             }}
+{
+    // nothing
+}
+
+void concurrent_progress::print_endline(bool endline)
+{
+    progress_.print_endline(endline);
+}
+
+void concurrent_progress::increment(uint64_t count)
+{
+    done_.fetch_add(count, std::memory_order_relaxed);
+}
+
+void concurrent_progress::run()
+{
+    std::unique_lock<std::mutex> lock{mutex_};
+    while (!stopped_.wait_for(lock, interval_, [&]()
+                              {
+        return stop_;
+    }))
+    {
+        // nothing is drawn before the first iteration finishes, as there
+        // is no rate to estimate the time left from yet
+        auto done = done_.load(std::memory_order_relaxed);
+        if (done > 0)
+            progress_(done);
+    }
+}
+
+void concurrent_progress::end()
+{
+    if (finished_)
+        return;
+    finished_ = true;
+    {
+        std::lock_guard<std::mutex> lock{mutex_};
+        stop_ = true;
+    }
+    stopped_.notify_one();
+    timer_.join();
+    progress_.end();
+}
+
+concurrent_progress::~concurrent_progress()
+{
+    end();
+}
 }
 }
@@ -0,0 +1,335 @@
+/**
+ * @file trace.cpp
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cpptoml.h"
+#include "util/trace.h"
+
+namespace meta
+{
+namespace trace
+{
+
+namespace internal
+{
+std::atomic<bool> enabled_flag{false};
+}
+
+namespace
+{
+using clock = std::chrono::steady_clock;
+
+/**
+ * An event of one thread.
+ */
+struct event
+{
+    /// The name of the event
+    const char* name;
+    /// The category of the event
+    const char* category;
+    /// When the event started, in nanoseconds since the trace began
+    int64_t start_ns;
+    /// How long the event took, in nanoseconds
+    int64_t duration_ns;
+};
+
+/**
+ * The events of one thread. Only its thread records into it, so its
+ * mutex is only ever contended while the trace is written or cleared.
+ */
+struct thread_buffer
+{
+    /// Guards the other members
+    std::mutex mutex;
+    /// The id of the thread in the timeline
+    uint64_t tid;
+    /// The name of the thread, if it was given one
+    std::string name;
+    /// The number of events kept
+    uint64_t capacity;
+    /// The events, as a ring once it is full
+    std::vector<event> events;
+    /// The number of events recorded, including those overwritten
+    uint64_t recorded = 0;
+};
+
+/**
+ * The state of the trace, shared by the whole process.
+ */
+struct trace_state
+{
+    /// Guards the other members
+    std::mutex mutex;
+    /// The buffer of every thread that has recorded an event, kept after
+    /// their threads exit
+    std::vector<std::shared_ptr<thread_buffer>> buffers;
+    /// The number of events each new buffer keeps
+    uint64_t events_per_thread = default_events_per_thread;
+    /// When the trace began
+    clock::time_point epoch = clock::now();
+    /// The file the trace is written to when the program exits, if any
+    std::string output;
+    /// Whether write_output() has been registered with std::atexit
+    bool registered = false;
+};
+
+/**
+ * @return the state of the trace
+ */
+trace_state& state()
+{
+    static trace_state st;
+    return st;
+}
+
+/**
+ * @return the buffer of the calling thread, made on its first call
+ */
+thread_buffer& local_buffer()
+{
+    static thread_local std::shared_ptr<thread_buffer> buffer;
+    if (!buffer)
+    {
+        auto& st = state();
+        std::lock_guard<std::mutex> lock{st.mutex};
+        buffer = std::make_shared<thread_buffer>();
+        buffer->tid = st.buffers.size() + 1;
+        buffer->capacity = st.events_per_thread;
+        st.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+/**
+ * Writes a string as a JSON string.
+ * @param out The stream to write to
+ * @param str The string to write
+ */
+void write_string(std::ostream& out, const std::string& str)
+{
+    out << '"';
+    for (const auto& c : str)
+    {
+        if (c == '"' || c == '\\')
+            out << '\\' << c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+        {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        }
+        else
+            out << c;
+    }
+    out << '"';
+}
+
+/**
+ * Writes a number of nanoseconds in microseconds, the unit of the Chrome
+ * trace event format.
+ * @param out The stream to write to
+ * @param ns The number of nanoseconds
+ */
+void write_micros(std::ostream& out, int64_t ns)
+{
+    char micros[32];
+    std::snprintf(micros, sizeof(micros), "%lld.%03lld",
+                  static_cast<long long>(ns / 1000),
+                  static_cast<long long>(ns % 1000));
+    out << micros;
+}
+
+/**
+ * Writes the trace to the file given by configure() or META_TRACE, when
+ * the program exits.
+ */
+void write_output()
+{
+    std::string path;
+    {
+        auto& st = state();
+        std::lock_guard<std::mutex> lock{st.mutex};
+        path = st.output;
+    }
+    try
+    {
+        write_chrome_json(path);
+    }
+    catch (const trace_exception& ex)
+    {
+        std::cerr << ex.what() << std::endl;
+    }
+}
+
+/**
+ * Starts recording events, to be written to a file when the program
+ * exits.
+ * @param path The file to write to
+ * @param events_per_thread The number of events each thread keeps
+ */
+void trace_to(const std::string& path, uint64_t events_per_thread)
+{
+    auto& st = state();
+    {
+        std::lock_guard<std::mutex> lock{st.mutex};
+        st.output = path;
+        if (!st.registered)
+        {
+            std::atexit(write_output);
+            st.registered = true;
+        }
+    }
+    enable(true, events_per_thread);
+}
+
+/**
+ * Starts tracing when the program starts if META_TRACE is set, so that
+ * any program can be traced without being changed.
+ */
+struct environment_trace
+{
+    environment_trace()
+    {
+        if (auto path = std::getenv("META_TRACE"))
+            trace_to(path, default_events_per_thread);
+    }
+} from_environment;
+}
+
+void enable(bool on, uint64_t events_per_thread)
+{
+    if (on)
+    {
+        if (events_per_thread == 0)
+            throw trace_exception{"a thread must keep at least one event"};
+        auto& st = state();
+        std::lock_guard<std::mutex> lock{st.mutex};
+        st.events_per_thread = events_per_thread;
+    }
+    internal::enabled_flag.store(on, std::memory_order_relaxed);
+}
+
+void record(const char* name, const char* category, clock::time_point start,
+            clock::time_point end)
+{
+    auto epoch = state().epoch;
+    event ev{name, category,
+             std::chrono::duration_cast<std::chrono::nanoseconds>(start
+                                                                  - epoch)
+                 .count(),
+             std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+                 .count()};
+
+    auto& buffer = local_buffer();
+    std::lock_guard<std::mutex> lock{buffer.mutex};
+    if (buffer.events.size() < buffer.capacity)
+        buffer.events.push_back(ev);
+    else
+        buffer.events[buffer.recorded % buffer.capacity] = ev;
+    ++buffer.recorded;
+}
+
+void name_thread(const std::string& name)
+{
+    auto& buffer = local_buffer();
+    std::lock_guard<std::mutex> lock{buffer.mutex};
+    buffer.name = name;
+}
+
+void write_chrome_json(std::ostream& out)
+{
+    std::vector<std::shared_ptr<thread_buffer>> buffers;
+    {
+        auto& st = state();
+        std::lock_guard<std::mutex> lock{st.mutex};
+        buffers = st.buffers;
+    }
+
+    out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto& buffer : buffers)
+    {
+        std::lock_guard<std::mutex> lock{buffer->mutex};
+        if (!buffer->name.empty())
+        {
+            out << (first ? "" : ",")
+                << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,"
+                   "\"tid\":" << buffer->tid << ",\"args\":{\"name\":";
+            write_string(out, buffer->name);
+            out << "}}";
+            first = false;
+        }
+
+        // the oldest event kept is the next one to be overwritten
+        auto size = buffer->events.size();
+        auto oldest = buffer->recorded > size ? buffer->recorded % size : 0;
+        for (uint64_t i = 0; i < size; ++i)
+        {
+            const auto& ev = buffer->events[(oldest + i) % size];
+            out << (first ? "" : ",") << "\n{\"name\":";
+            write_string(out, ev.name);
+            out << ",\"cat\":";
+            write_string(out, ev.category);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->tid
+                << ",\"ts\":";
+            write_micros(out, ev.start_ns);
+            out << ",\"dur\":";
+            write_micros(out, ev.duration_ns);
+            out << "}";
+            first = false;
+        }
+    }
+    out << "\n]}\n";
+}
+
+void write_chrome_json(const std::string& path)
+{
+    std::ofstream out{path};
+    if (!out)
+        throw trace_exception{"failed to open " + path + " for writing"};
+    write_chrome_json(out);
+}
+
+void clear()
+{
+    auto& st = state();
+    std::lock_guard<std::mutex> lock{st.mutex};
+    for (const auto& buffer : st.buffers)
+    {
+        std::lock_guard<std::mutex> buffer_lock{buffer->mutex};
+        buffer->events.clear();
+        buffer->recorded = 0;
+    }
+}
+
+void configure(const cpptoml::table& config)
+{
+    auto events = default_events_per_thread;
+    std::string output;
+    if (auto table = config.get_table("trace"))
+    {
+        if (auto out = table->get_as<std::string>("output"))
+            output = *out;
+        if (auto num = table->get_as<int64_t>("events-per-thread"))
+        {
+            if (*num <= 0)
+                throw trace_exception{"events-per-thread must be positive"};
+            events = static_cast<uint64_t>(*num);
+        }
+    }
+    if (auto path = std::getenv("META_TRACE"))
+        output = path;
+    if (!output.empty())
+        trace_to(output, events);
+}
+}
+}